@@ -0,0 +1,317 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  arena.hpp
+ * \brief host-owned scratch memory for plug-in callbacks
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/memory.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \class suzu::sdk::Arena
+     * \brief bump allocator whose memory is released in bulk
+     *
+     * Allocating is a pointer increment; individual allocations are never freed. Instead, the
+     * arena is rewound to a previously taken *mark()*, typically by a *Scope*. Memory blocks are
+     * kept for reuse after rewinding, so an arena that is repeatedly rewound stops allocating from
+     * the heap once it has grown to its working size. Blocks are tracked in the memory account
+     * *"scratch"* (see *suzu::sdk::MemoryAccounts*).
+     *
+     * \note  An arena must only be used by one thread at a time.
+     */
+    class Arena {
+    public:
+        static constexpr size_t gl_blocksize = 64 * 1024; /**< minimum size of a memory block, in bytes */
+
+        /**
+         * \struct suzu::sdk::Arena::Mark
+         * \brief  allocation position of an arena
+         */
+        struct Mark {
+            size_t block; /**< index of the current block */
+            size_t used;  /**< number of bytes used in the current block */
+        };
+
+        /**
+         * \class suzu::sdk::Arena::Scope
+         * \brief makes the arena usable and releases all memory allocated during the lifetime of this object
+         */
+        class Scope {
+            Arena *m_arena; /**< rewound arena */
+            Mark   m_mark;  /**< position to rewind to */
+
+        public:
+            explicit Scope(Arena &arena) noexcept
+                : m_arena(&arena), m_mark(arena.mark())
+            {
+                ++arena.m_depth;
+            }
+            Scope(Scope const &) = delete;
+            Scope &operator =(Scope const &) = delete;
+            ~Scope() {
+                --m_arena->m_depth;
+
+                m_arena->rewind(m_mark);
+            }
+        };
+
+    private:
+        /**
+         * \struct suzu::sdk::Arena::Block
+         * \brief  a single memory block
+         */
+        struct Block {
+            std::unique_ptr<char[]> mem;  /**< memory of the block */
+            size_t                  size; /**< size of *mem*, in bytes */
+        };
+
+        std::vector<Block> m_blocks; /**< all blocks, including unused ones */
+        size_t             m_curr;   /**< index of the block allocations are taken from */
+        size_t             m_used;   /**< number of bytes used in the current block */
+        uint32_t           m_depth;  /**< number of active scopes */
+
+    public:
+        Arena() noexcept
+            : m_curr(0), m_used(0), m_depth(0)
+        { }
+        Arena(Arena const &) = delete;
+        Arena &operator =(Arena const &) = delete;
+        ~Arena() {
+            int64_t total = 0;
+            for (Block const &blk : m_blocks)
+                total += static_cast<int64_t>(blk.size);
+
+            internal::TrackMemory(Account(), -total);
+        }
+
+        /**
+         * \brief  retrieves the arena of the calling thread in the current module
+         *
+         * \return reference to the arena
+         */
+        static Arena &ThreadLocal() noexcept {
+            static thread_local Arena gl_arena;
+
+            return gl_arena;
+        }
+
+        /**
+         * \brief  retrieves whether or not a scope is active on the arena
+         *
+         * \return *true* if memory allocated now is released by a scope
+         */
+        bool isActive() const noexcept { return m_depth != 0; }
+
+        /**
+         * \brief  allocates memory from the arena
+         *
+         * \param  [in] size number of bytes to allocate
+         * \param  [in] align alignment of the memory; power of two
+         *
+         * \return pointer to the memory, or *nullptr* if *align* is invalid or memory is exhausted
+         */
+        void *allocate(size_t const size, size_t const align) noexcept {
+            if (align == 0 || (align & (align - 1)) != 0 || size > SIZE_MAX / 2 - align)
+                return nullptr;
+
+            for (;;) {
+                if (m_curr < m_blocks.size()) {
+                    Block &blk = m_blocks[m_curr];
+
+                    uintptr_t const base   = reinterpret_cast<uintptr_t>(blk.mem.get());
+                    size_t const    offset = static_cast<size_t>(((base + m_used + align - 1) & ~static_cast<uintptr_t>(align - 1)) - base);
+                    if (offset <= blk.size && size <= blk.size - offset) {
+                        m_used = offset + size;
+
+                        return blk.mem.get() + offset;
+                    }
+
+                    /* Blocks skipped here are reused once the arena is rewound. */
+                    if (m_curr + 1 < m_blocks.size()) {
+                        ++m_curr;
+                        m_used = 0;
+
+                        continue;
+                    }
+                }
+
+                size_t const last = m_blocks.empty() ? 0 : m_blocks.back().size;
+                size_t const want = std::max({ gl_blocksize, last * 2, size + align });
+                try {
+                    MemoryScope const memory(Account());
+
+                    m_blocks.push_back({ std::unique_ptr<char[]>(new char[want]), want });
+                } catch (...) {
+                    return nullptr;
+                }
+
+                internal::TrackMemory(Account(), static_cast<int64_t>(want));
+
+                m_curr = m_blocks.size() - 1;
+                m_used = 0;
+            }
+        }
+
+        /**
+         * \brief  retrieves the current allocation position
+         *
+         * \return position to pass to *rewind()*
+         */
+        Mark mark() const noexcept { return { m_curr, m_used }; }
+
+        /**
+         * \brief releases all memory allocated since *pos* was taken
+         *
+         * \param [in] pos position returned by *mark()*
+         */
+        void rewind(Mark const &pos) noexcept {
+            m_curr = pos.block;
+            m_used = pos.used;
+        }
+
+        /**
+         * \brief  allocates from the calling thread's arena, provided a scope is active on it
+         *
+         * \param  [in] size number of bytes to allocate
+         * \param  [in] align alignment of the memory; power of two
+         *
+         * \return pointer to the memory, or *nullptr* if no scope is active or allocating failed
+         */
+        static void *AllocateThreadLocal(size_t const size, size_t const align) noexcept {
+            Arena &arena = ThreadLocal();
+
+            return arena.isActive() ? arena.allocate(size, align) : nullptr;
+        }
+
+    private:
+        /**
+         * \brief  retrieves the memory account of all arenas
+         *
+         * \return id of the account
+         */
+        static uint32_t Account() noexcept {
+            static uint32_t const gl_account = internal::RegisterAccount("scratch");
+
+            return gl_account;
+        }
+    };
+
+
+    /**
+     * \struct suzu::sdk::ArenaInterface
+     * \brief  ABI-stable view on the scratch arenas owned by the host application
+     *
+     * Like *suzu::sdk::SinkRegistry*, this is a plain struct so that it can be passed to plug-ins
+     * regardless of their STL or CRT. All scratch memory is allocated and released by the host, so
+     * plug-ins never free memory from another module's heap.
+     */
+    struct ArenaInterface {
+        static constexpr uint32_t gl_version = 1; /**< current ABI version */
+
+        uint32_t version;                           /**< must be *gl_version* */
+        void  *(*alloc)(size_t size, size_t align); /**< allocates from the calling thread's arena; *nullptr* outside of callbacks */
+
+        /**
+         * \brief  retrieves the interface to the arenas of the current module
+         *
+         * \return arena interface; valid for the lifetime of the module
+         */
+        static ArenaInterface Local() noexcept { return { gl_version, &Arena::AllocateThreadLocal }; }
+    };
+
+
+    namespace internal {
+        /**
+         * Arenas used by the current instance, set by *InitializeInstanceArena()*. Until then, the
+         * module's own arenas are used.
+         */
+        inline ArenaInterface gl_arena = ArenaInterface::Local();
+    }
+
+    /**
+     * \brief  sets the arenas to use for scratch memory in the current instance
+     *
+     * \param  [in] iface arena interface passed by the host
+     *
+     * \return *true* on success, *false* if the interface has an incompatible ABI version
+     */
+    inline bool InitializeInstanceArena(ArenaInterface const &iface) noexcept {
+        if (iface.version != ArenaInterface::gl_version || iface.alloc == nullptr)
+            return false;
+
+        internal::gl_arena = iface;
+        return true;
+    }
+
+    /**
+     * \brief  allocates scratch memory that lives until the current plug-in callback returns
+     *
+     * The host releases all scratch memory of a callback at once after the callback has returned
+     * and its results have been consumed. Scratch memory may therefore also be used for buffers
+     * returned to the host.
+     *
+     * \param  [in] size number of bytes to allocate
+     * \param  [in] align alignment of the memory; power of two
+     *
+     * \return pointer to the memory, or *nullptr* if not called during a callback on the thread
+     *         the callback was invoked on
+     */
+    inline void *ScratchAllocate(size_t const size, size_t const align = alignof(std::max_align_t)) noexcept {
+        return internal::gl_arena.alloc(size, align);
+    }
+
+
+    /**
+     * \class suzu::sdk::ScratchAllocator
+     * \brief standard allocator taking its memory from *suzu::sdk::ScratchAllocate()*
+     *
+     * Deallocation is a no-op; containers using this allocator must not outlive the callback.
+     */
+    template<class T> class ScratchAllocator {
+    public:
+        using value_type = T;
+
+        ScratchAllocator() noexcept = default;
+        template<class U> ScratchAllocator(ScratchAllocator<U> const &) noexcept { }
+
+        T *allocate(size_t const n) {
+            if (n > SIZE_MAX / sizeof(T))
+                throw std::bad_alloc();
+
+            if (void *const mem = ScratchAllocate(n * sizeof(T), alignof(T)))
+                return static_cast<T *>(mem);
+            throw std::bad_alloc();
+        }
+        void deallocate(T *, size_t) noexcept { }
+
+        template<class U> bool operator ==(ScratchAllocator<U> const &) const noexcept { return true; }
+        template<class U> bool operator !=(ScratchAllocator<U> const &) const noexcept { return false; }
+    };
+
+    using ScratchString = std::basic_string<char, std::char_traits<char>, ScratchAllocator<char>>; /**< string in scratch memory */
+    template<class T> using ScratchVector = std::vector<T, ScratchAllocator<T>>;                  /**< vector in scratch memory */
+}
+
+
@@ -0,0 +1,118 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  changes.hpp
+ * \brief batched notifications of model changes for plug-ins
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+
+
+namespace suzu::sdk {
+    constexpr inline char const *gl_pluginchanges = "SuzuPluginOnChanges"; /**< name of the optional change callback */
+
+
+    /**
+     * \enum  suzu::sdk::ChangeKind
+     * \brief kind of a single model change
+     */
+    enum ChangeKind : uint32_t {
+        ElementAdded = 0, /**< *element* was inserted into *parent* */
+        ElementRemoved,   /**< *element* was removed from *parent* */
+        ElementModified,  /**< property *args[0]* of *element* was changed */
+        ElementMoved,     /**< *element* was moved to *parent*; *args* hold the new position */
+
+        __NumChangeKinds__ /**< (only used internally) */
+    };
+
+    /**
+     * \enum  suzu::sdk::ChangeProperty
+     * \brief property reported by *ElementModified* changes in *args[0]*
+     */
+    enum ChangeProperty : uint32_t {
+        PropertyBounds = 0, /**< bounding box */
+        PropertyStyle,      /**< style id */
+        PropertyFlags,      /**< *suzu::sdk::ElementFlags* */
+        PropertyName,       /**< name */
+        PropertyOrder,      /**< position in the drawing order */
+
+        __NumChangeProperties__ /**< (only used internally) */
+    };
+
+
+    /**
+     * \struct suzu::sdk::ChangeRecord
+     * \brief  a single model change
+     *
+     * The layout is fixed so that records can be passed across the plug-in boundary (and copied into
+     * the rings of out-of-process plug-ins) as a plain array.
+     */
+    struct ChangeRecord {
+        uint32_t kind;    /**< kind of change, see *suzu::sdk::ChangeKind* */
+        uint32_t flags;   /**< reserved; 0 */
+        uint64_t element; /**< handle of the changed element, see *suzu::sdk::ElementHandle::value()* */
+        uint64_t parent;  /**< handle of the (new) parent of the element; *gl_nullelement* for the diagram root */
+        int64_t  args[2]; /**< kind-specific arguments */
+    };
+    static_assert(sizeof(ChangeRecord) == 40, "change record layout must not change");
+
+    /**
+     * \struct suzu::sdk::ChangeBatch
+     * \brief  ABI-stable view on a contiguous array of changes
+     *
+     * All changes of a batch belong to the same operation, e.g. pasting many elements. The
+     * plug-in either accepts the batch as a whole or rejects it, in which case the host rolls back
+     * the entire operation.
+     */
+    struct ChangeBatch {
+        static constexpr uint32_t gl_version = 1; /**< current ABI version */
+
+        uint32_t            version; /**< must be *gl_version* */
+        uint32_t            count;   /**< number of elements in *records* */
+        ChangeRecord const *records; /**< C-array of changes, in the order they were applied */
+    };
+
+    /**
+     * \brief  signature of the optional change callback of a plug-in, exported as *gl_pluginchanges*
+     *
+     * \param  [in] batch changes of a single operation; only valid during the call
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* to accept the batch; any other value rolls it back
+     */
+    using ChangeBatchFn = ErrorCode (*)(ChangeBatch const *batch);
+}
+
+
+/**
+ * \ingroup  Macros
+ * \brief    declares the change callback of a plug-in
+ *
+ * Usage:
+ *
+ *     SZSDK_PLUGIN_ON_CHANGES(batch) {
+ *         for (uint32_t i = 0; i < batch->count; ++i)
+ *             ...
+ *
+ *         return suzu::sdk::ErrorCode::Ok;
+ *     }
+ *
+ * \note     Requires *sdk/plugin.hpp* for *SZSDK_PLUGIN_EXPORT*.
+ */
+#define SZSDK_PLUGIN_ON_CHANGES(batch) \
+    extern "C" SZSDK_PLUGIN_EXPORT suzu::sdk::ErrorCode SuzuPluginOnChanges(suzu::sdk::ChangeBatch const *batch)
+
+
@@ -0,0 +1,348 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  codegen.hpp
+ * \brief pipeline generating source files from diagrams, e.g. class skeletons
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+#include <sdk/task.hpp>
+#include <sdk/util.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \struct suzu::sdk::CodeUnit
+     * \brief  a generated source file
+     */
+    struct CodeUnit {
+        std::string path; /**< path relative to the output directory, using '/' as separator; must not leave it */
+        std::string text; /**< contents, written as-is */
+    };
+
+    /**
+     * \struct suzu::sdk::CodeGenStats
+     * \brief  outcome of a run of *suzu::sdk::CodeGenerator*
+     */
+    struct CodeGenStats {
+        size_t units;   /**< number of files generated */
+        size_t written; /**< number of files written because their contents changed */
+        size_t skipped; /**< number of files left untouched because their contents did not change */
+        size_t failed;  /**< number of files that could not be written, or had invalid or duplicate paths */
+    };
+
+
+    /**
+     * \class suzu::sdk::CodeGenerator
+     * \brief generates the source files of many model elements in parallel and writes only those that changed
+     *
+     * The generator function is invoked once per element (e.g. per class of a diagram), distributed
+     * over the task scheduler. Each generated file is hashed right away: if its hash matches the
+     * one recorded by the previous run and the file still exists, it is left untouched. Without a
+     * recorded hash, e.g. on the first run into an existing directory, the file on disk is read
+     * and compared instead. Regenerating thousands of classes thus only writes the few files whose
+     * contents actually differ, and keeps their modification times, so build systems do not
+     * recompile the rest.
+     *
+     * Changed files are collected into batches of *gl_writebatch* files; each batch is a single
+     * request to the I/O thread, which writes files atomically (see *util::WriteFileAtomic()*)
+     * while generation continues. Once all batches are done, the hashes of all generated files
+     * are stored in a manifest (*gl_manifest*) in the output directory for the next run.
+     *
+     * \note  Files generated by earlier runs but not by the current one are not removed.
+     */
+    class CodeGenerator {
+    public:
+        /**
+         * \brief generates the files of an element; invoked concurrently for different elements
+         *
+         * \param [in] index index of the element
+         * \param [out] out receives the generated files
+         */
+        using GenerateFn = std::function<void(size_t index, std::vector<CodeUnit> &out)>;
+
+        static constexpr size_t      gl_writebatch = 64;              /**< number of changed files written per I/O request */
+        static constexpr char const *gl_manifest   = ".suzu-codegen"; /**< name of the manifest of content hashes */
+
+    private:
+        /**
+         * \struct suzu::sdk::CodeGenerator::Pending
+         * \brief  changed file waiting to be written
+         */
+        struct Pending {
+            std::string      path; /**< path relative to the output directory */
+            uint64_t         hash; /**< hash of *data* */
+            util::FileBuffer data; /**< contents */
+        };
+
+        /**
+         * \struct suzu::sdk::CodeGenerator::Written
+         * \brief  outcome of writing a file
+         */
+        struct Written {
+            std::string path; /**< path relative to the output directory */
+            uint64_t    hash; /**< hash of the contents */
+            bool        ok;   /**< whether or not the file was written */
+        };
+
+        std::string                               m_dir;    /**< output directory */
+        std::unordered_map<std::string, uint64_t> m_hashes; /**< hash of every file written by the previous run, by relative path */
+
+    public:
+        /**
+         * \brief constructs a new generator
+         *
+         * \param [in] dir output directory; created on demand
+         */
+        explicit CodeGenerator(std::string dir) noexcept
+            : m_dir(std::move(dir))
+        { }
+
+        /**
+         * \brief  generates the files of all elements and writes those that changed
+         *
+         * Blocks until all files have been written; call it from a task or a job.
+         *
+         * \param  [in] count number of elements
+         * \param  [in] fn generator function; must be thread-safe
+         * \param  [out] stats receives the numbers of generated, written and skipped files
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if all files are up-to-date, *suzu::sdk::ErrorCode::WriteFile*
+         *         if any file failed, or *suzu::sdk::ErrorCode::CriticalResource* if the generator
+         *         function threw or memory ran out; files written until then are kept
+         */
+        ErrorCode run(size_t const count, GenerateFn const &fn, CodeGenStats &stats) noexcept {
+            stats = {};
+
+            try {
+                loadManifest();
+
+                std::mutex                                            lock;
+                std::vector<Pending>                                  batch;
+                std::vector<std::future<std::vector<Written>>>        requests;
+                std::vector<Written>                                  done;
+                std::unordered_set<std::string>                       seen;
+                std::atomic<size_t>                                   units(0), skipped(0), failed(0);
+
+                ParallelFor(count, [&](size_t const index) {
+                    std::vector<CodeUnit> out;
+                    fn(index, out);
+                    units += out.size();
+
+                    for (CodeUnit &unit : out) {
+                        if (!IsValidPath(unit.path)) {
+                            ++failed;
+
+                            continue;
+                        }
+
+                        uint64_t const hash = util::HashBytes(unit.text.data(), unit.text.size());
+                        bool const     same = isUnchanged(unit.path, hash, unit.text.size());
+
+                        std::lock_guard<std::mutex> guard(lock);
+                        if (!seen.insert(unit.path).second) {
+                            ++failed;
+
+                            continue;
+                        }
+                        if (same) {
+                            ++skipped;
+                            done.push_back({ std::move(unit.path), hash, true });
+
+                            continue;
+                        }
+
+                        batch.push_back({ std::move(unit.path), hash, util::FileBuffer(unit.text.begin(), unit.text.end()) });
+                        if (batch.size() >= gl_writebatch) {
+                            requests.push_back(post(std::move(batch)));
+                            batch.clear();
+                        }
+                    }
+                }, TaskPriority::Normal);
+                if (!batch.empty())
+                    requests.push_back(post(std::move(batch)));
+
+                size_t written = 0;
+                for (std::future<std::vector<Written>> &request : requests)
+                    for (Written &file : request.get()) {
+                        if (file.ok)
+                            ++written;
+                        else
+                            ++failed;
+
+                        done.push_back(std::move(file));
+                    }
+
+                stats = { units, written, skipped, failed };
+                if (saveManifest(done) != ErrorCode::Ok)
+                    return ErrorCode::WriteFile;
+
+                return failed == 0 ? ErrorCode::Ok : ErrorCode::WriteFile;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+    private:
+        /**
+         * \brief  checks whether a relative path stays within the output directory
+         *
+         * \param  [in] path relative path
+         *
+         * \return *true* if the path is relative, not empty and contains no ".." components
+         */
+        static bool IsValidPath(std::string const &path) {
+            std::filesystem::path const rel = std::filesystem::u8path(path);
+            if (path.empty() || rel.is_absolute() || rel.has_root_name())
+                return false;
+
+            return std::none_of(rel.begin(), rel.end(), [](std::filesystem::path const &part) { return part == ".."; });
+        }
+
+        /**
+         * \brief  checks whether a file on disk already has the generated contents
+         *
+         * \param  [in] path relative path
+         * \param  [in] hash hash of the generated contents
+         * \param  [in] size size of the generated contents, in bytes
+         *
+         * \return *true* if the file need not be written
+         */
+        bool isUnchanged(std::string const &path, uint64_t const hash, size_t const size) const {
+            std::filesystem::path const full = std::filesystem::u8path(m_dir) / std::filesystem::u8path(path);
+
+            std::error_code   err;
+            uintmax_t const   ondisk = std::filesystem::file_size(full, err);
+            if (err || ondisk != size)
+                return false;
+
+            auto const it = m_hashes.find(path);
+            if (it != m_hashes.end())
+                return it->second == hash;
+
+            /* Without a recorded hash, the file itself is compared. */
+            Result<util::FileBuffer> const contents = util::ReadFile(full.u8string().c_str(), true);
+            if (!contents)
+                return false;
+
+            return util::HashBytes(contents->data(), contents->size()) == hash;
+        }
+
+        /**
+         * \brief  queues a batch of changed files on the I/O thread
+         *
+         * \param  [in] batch files to write; moved into the request
+         *
+         * \return future that becomes ready with the outcome of every file
+         */
+        std::future<std::vector<Written>> post(std::vector<Pending> &&batch) {
+            auto task = std::make_shared<std::packaged_task<std::vector<Written>()>>([dir = m_dir, batch = std::move(batch)]() mutable {
+                std::vector<Written> res;
+                res.reserve(batch.size());
+
+                for (Pending &file : batch) {
+                    std::filesystem::path const full = std::filesystem::u8path(dir) / std::filesystem::u8path(file.path);
+
+                    std::error_code err;
+                    std::filesystem::create_directories(full.parent_path(), err);
+
+                    bool const ok = util::WriteFileAtomic(full.u8string().c_str(), file.data.data(), file.data.size(), true) == ErrorCode::Ok;
+                    res.push_back({ std::move(file.path), file.hash, ok });
+                }
+
+                return res;
+            });
+
+            std::future<std::vector<Written>> res = task->get_future();
+            util::internal::IOThread::Instance().post([task]() { (*task)(); });
+
+            return res;
+        }
+
+        /**
+         * \brief reads the hashes recorded by the previous run; a missing or malformed manifest is treated as empty
+         *
+         * \throw std::bad_alloc
+         */
+        void loadManifest() {
+            m_hashes.clear();
+
+            Result<util::FileBuffer> const text = util::ReadFile((std::filesystem::u8path(m_dir) / gl_manifest).u8string().c_str(), true);
+            if (!text)
+                return;
+
+            /* Every line holds the hash in hexadecimal and the relative path, separated by a space. */
+            std::string_view rest(text->data(), text->size());
+            while (!rest.empty()) {
+                size_t const     eol  = rest.find('\n');
+                std::string_view line = rest.substr(0, eol);
+                rest = eol == std::string_view::npos ? std::string_view() : rest.substr(eol + 1);
+
+                uint64_t hash = 0;
+                if (line.size() < 18 || line[16] != ' ' || std::sscanf(std::string(line.substr(0, 16)).c_str(), "%16" SCNx64, &hash) != 1)
+                    continue;
+
+                m_hashes[std::string(line.substr(17))] = hash;
+            }
+        }
+
+        /**
+         * \brief  stores the hashes of all up-to-date files for the next run
+         *
+         * \param  [in] files generated files; those that failed are left out
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or the error of *util::WriteFileAtomic()*
+         * \throw  std::bad_alloc
+         */
+        ErrorCode saveManifest(std::vector<Written> &files) const {
+            std::sort(files.begin(), files.end(), [](Written const &a, Written const &b) { return a.path < b.path; });
+
+            std::string text;
+            for (Written const &file : files) {
+                if (!file.ok)
+                    continue;
+
+                char hash[20];
+                std::snprintf(hash, sizeof hash, "%016" PRIx64 " ", file.hash);
+                text.append(hash).append(file.path).push_back('\n');
+            }
+
+            std::error_code err;
+            std::filesystem::create_directories(std::filesystem::u8path(m_dir), err);
+
+            return util::WriteFileAtomic((std::filesystem::u8path(m_dir) / gl_manifest).u8string().c_str(), text.data(), text.size(), true);
+        }
+    };
+}
+
+
@@ -0,0 +1,225 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  compress.hpp
+ * \brief block compression of project chunks
+ *
+ * Blocks are stored in the LZ4 block format: a sequence of literal runs, each followed by a
+ * back-reference of at least four bytes into the preceding 64 KiB, except for the last run. The
+ * format decodes at memory speed, so compressed projects load faster from slow storage such as
+ * network shares than uncompressed ones. Both compression levels produce the same format; they
+ * only differ in how hard they search for matches.
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+namespace suzu::sdk {
+    /**
+     * \enum  suzu::sdk::Compression
+     * \brief how hard to compress blocks
+     */
+    enum class Compression : uint32_t {
+        None, /**< blocks are stored as they are */
+        Fast, /**< first match found; costs little more than copying */
+        High  /**< longest of many candidate matches; several times slower, noticeably smaller */
+    };
+
+
+    namespace internal {
+        static constexpr size_t   gl_lz4minmatch = 4;        /**< shortest back-reference */
+        static constexpr size_t   gl_lz4mflimit  = 12;       /**< no match may start within this many bytes of the end */
+        static constexpr size_t   gl_lz4lastlits = 5;        /**< the last bytes of a block are always literals */
+        static constexpr size_t   gl_lz4window   = 65535;    /**< farthest back-reference */
+        static constexpr uint32_t gl_lz4hashbits = 16;       /**< size of the match finder's hash table, as a power of 2 */
+        static constexpr uint32_t gl_lz4depth    = 64;       /**< candidates examined per position by *Compression::High* */
+        static constexpr size_t   gl_lz4none     = SIZE_MAX; /**< marks empty hash table entries */
+
+        inline uint32_t Lz4Hash(char const *const pos) noexcept {
+            uint32_t value;
+            std::memcpy(&value, pos, sizeof(value));
+
+            return (value * 2654435761u) >> (32 - gl_lz4hashbits);
+        }
+
+        inline void Lz4PutLength(std::vector<char> &out, size_t len) {
+            for (; len >= 255; len -= 255)
+                out.push_back(static_cast<char>(255));
+
+            out.push_back(static_cast<char>(len));
+        }
+
+        /**
+         * \brief appends a sequence
+         *
+         * \param [in,out] out block to append to
+         * \param [in] lits literals of the sequence
+         * \param [in] nlits number of literals
+         * \param [in] offset distance of the back-reference; ignored for the last sequence
+         * \param [in] match length of the back-reference; 0 for the last sequence
+         * \throw std::bad_alloc
+         */
+        inline void Lz4PutSequence(std::vector<char> &out, char const *const lits, size_t const nlits, size_t const offset, size_t const match) {
+            size_t const extra = match == 0 ? 0 : match - gl_lz4minmatch;
+
+            out.push_back(static_cast<char>((nlits < 15 ? nlits : 15) << 4 | (extra < 15 ? extra : 15)));
+            if (nlits >= 15)
+                Lz4PutLength(out, nlits - 15);
+            out.insert(out.end(), lits, lits + nlits);
+            if (match == 0)
+                return;
+
+            out.push_back(static_cast<char>(offset & 0xFF));
+            out.push_back(static_cast<char>(offset >> 8));
+            if (extra >= 15)
+                Lz4PutLength(out, extra - 15);
+        }
+    }
+
+
+    /**
+     * \brief compresses a block
+     *
+     * \param [in] src bytes to compress
+     * \param [in] size number of bytes
+     * \param [in] level how hard to compress; *Compression::None* is treated as *Compression::Fast*
+     * \param [out] out compressed block is appended to it
+     * \throw std::bad_alloc
+     * \note  Incompressible data grows by about 0.4%.
+     */
+    inline void CompressBlock(char const *const src, size_t const size, Compression const level, std::vector<char> &out) {
+        size_t anchor = 0;
+        if (size > internal::gl_lz4mflimit) {
+            /*
+             * Every position is linked to the previous one with the same hash, so that the high
+             * level can walk the candidates from nearest to farthest. Links are distances within
+             * the window; 0 ends a chain.
+             */
+            std::vector<size_t>   head(size_t(1) << internal::gl_lz4hashbits, internal::gl_lz4none);
+            std::vector<uint16_t> chain(level == Compression::High ? internal::gl_lz4window + 1 : 0);
+            uint32_t const        depth = level == Compression::High ? internal::gl_lz4depth : 1;
+            auto const            insert = [&](size_t const pos) {
+                uint32_t const h    = internal::Lz4Hash(src + pos);
+                size_t const   prev = head[h];
+
+                head[h] = pos;
+                if (!chain.empty())
+                    chain[pos & internal::gl_lz4window] = static_cast<uint16_t>(prev != internal::gl_lz4none && pos - prev <= internal::gl_lz4window ? pos - prev : 0);
+                return prev;
+            };
+
+            size_t const limit    = size - internal::gl_lz4mflimit;
+            size_t const matchend = size - internal::gl_lz4lastlits;
+            for (size_t pos = 0; pos < limit; ) {
+                size_t cand = insert(pos), best = 0, offset = 0;
+                for (uint32_t i = 0; i < depth && cand != internal::gl_lz4none && pos - cand <= internal::gl_lz4window; ++i) {
+                    size_t len = 0;
+                    while (pos + len < matchend && src[cand + len] == src[pos + len])
+                        ++len;
+                    if (len > best) {
+                        best   = len;
+                        offset = pos - cand;
+                    }
+
+                    uint16_t const link = chain.empty() ? 0 : chain[cand & internal::gl_lz4window];
+                    cand = link == 0 ? internal::gl_lz4none : cand - link;
+                }
+
+                if (best < internal::gl_lz4minmatch) {
+                    /* Skip ahead faster the longer nothing matched, to get through incompressible data. */
+                    pos += 1 + ((pos - anchor) >> 6);
+
+                    continue;
+                }
+
+                internal::Lz4PutSequence(out, src + anchor, pos - anchor, offset, best);
+                if (level == Compression::High)
+                    for (size_t i = pos + 1; i < pos + best && i < limit; ++i)
+                        insert(i);
+                pos   += best;
+                anchor = pos;
+            }
+        }
+
+        internal::Lz4PutSequence(out, src + anchor, size - anchor, 0, 0);
+    }
+
+    /**
+     * \brief  decompresses a block
+     *
+     * \param  [in] src compressed block
+     * \param  [in] size size of the compressed block, in bytes
+     * \param  [out] dst receives the decompressed bytes
+     * \param  [in] capacity exact size of the decompressed block, in bytes
+     *
+     * \return *true* if the block is valid and decompresses to exactly *capacity* bytes
+     * \note   Corrupt blocks never read or write out of bounds.
+     */
+    inline bool DecompressBlock(char const *const src, size_t const size, char *const dst, size_t const capacity) noexcept {
+        auto const length = [&](size_t &ip, size_t &len) {
+            for (unsigned char byte = 255; byte == 255; len += byte) {
+                if (ip >= size)
+                    return false;
+
+                byte = static_cast<unsigned char>(src[ip++]);
+            }
+
+            return true;
+        };
+
+        size_t ip = 0, op = 0;
+        for (;;) {
+            if (ip >= size)
+                return false;
+
+            unsigned char const token = static_cast<unsigned char>(src[ip++]);
+            size_t              nlits = token >> 4;
+            if (nlits == 15 && !length(ip, nlits))
+                return false;
+            if (nlits > size - ip || nlits > capacity - op)
+                return false;
+
+            std::memcpy(dst + op, src + ip, nlits);
+            ip += nlits;
+            op += nlits;
+            if (ip == size)
+                return op == capacity;
+
+            if (size - ip < 2)
+                return false;
+            size_t const offset = static_cast<unsigned char>(src[ip]) | static_cast<size_t>(static_cast<unsigned char>(src[ip + 1])) << 8;
+            ip += 2;
+
+            size_t match = token & 15;
+            if (match == 15 && !length(ip, match))
+                return false;
+            match += internal::gl_lz4minmatch;
+            if (offset == 0 || offset > op || match > capacity - op)
+                return false;
+
+            /* Matches may overlap their own output, e.g. to repeat a single byte. */
+            if (offset >= match)
+                std::memcpy(dst + op, dst + op - offset, match);
+            else
+                for (size_t i = 0; i < match; ++i)
+                    dst[op + i] = dst[op + i - offset];
+            op += match;
+        }
+    }
+}
+
+
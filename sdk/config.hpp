@@ -15,12 +15,33 @@
 
 #pragma once
 
+/* stdlib includes */
+#include <atomic>
+#include <memory>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
+
 /* external includes */
-#include <QReadWriteLock>
+#include <QMutex>
+#include <QMetaObject>
+#include <QCoreApplication>
+#include <QFileSystemWatcher>
+#include <QTimer>
 
 #include <sdk/external/json/nlohmann/json.hpp>
 
 /* sdk includes */
+#include <sdk/intern.hpp>
 #include <sdk/util.hpp>
 
 
@@ -28,6 +49,720 @@ namespace suzu::sdk {
     using JSON = nlohmann::json; /**< raw JSON values; not serialized */
 
 
+    /**
+     * \class suzu::sdk::ConfigKey
+     * \brief pre-compiled handle of a configuration key
+     *
+     * Parsing a JSON pointer is comparatively expensive. Keys that are read frequently should
+     * therefore be compiled once into a *ConfigKey* which can then be passed to all lookup
+     * functions of *suzu::sdk::Configuration*. Looking up a value through a compiled key requires
+     * exactly one traversal of the document.
+     *
+     * \note  Instances of this class are immutable and can be shared between threads.
+     */
+    class ConfigKey {
+        static constexpr size_t gl_noindex = static_cast<size_t>(-1); /**< token is not an array index */
+
+        std::string                   m_path;    /**< original JSON pointer */
+        std::vector<std::string_view> m_tokens;  /**< unescaped reference tokens; interned */
+        std::vector<size_t>           m_indices; /**< pre-parsed array indices; *gl_noindex* if not an index */
+        bool                          m_isValid; /**< whether or not the key is a valid JSON pointer */
+
+    public:
+        /**
+         * \brief compiles a new configuration key
+         *
+         * The path must be of the form /path/to/val where / denotes the root element. The
+         * empty path refers to the whole document.
+         *
+         * \param [in] path JSON pointer to compile
+         */
+        explicit ConfigKey(char const *const path) noexcept
+            : m_isValid(false)
+        {
+            try {
+                if (path == nullptr || (*path != '\0' && *path != '/'))
+                    return;
+                m_path = std::string{ path };
+
+                /* Split the pointer into its reference tokens, unescaping "~1" and "~0". */
+                for (size_t pos = 0; pos < m_path.length(); ) {
+                    size_t const end = std::min(m_path.find('/', pos + 1), m_path.length());
+
+                    std::string token;
+                    for (size_t i = pos + 1; i < end; ++i) {
+                        if (m_path[i] != '~') {
+                            token.push_back(m_path[i]);
+
+                            continue;
+                        }
+
+                        /* Reject malformed escape sequences. */
+                        if (i + 1 >= end || (m_path[i + 1] != '0' && m_path[i + 1] != '1'))
+                            return;
+                        token.push_back(m_path[++i] == '0' ? '~' : '/');
+                    }
+
+                    /* Keys share the same few tokens; store each of them only once. */
+                    StringTable &strings = StringTable::Local();
+
+                    m_indices.push_back(ParseIndex(token));
+                    m_tokens.push_back(strings.view(strings.intern(token)));
+                    pos = end;
+                }
+
+                m_isValid = true;
+            } catch (...) { m_isValid = false; }
+        }
+
+
+        /**
+         * \brief  retrieves whether or not the key could be compiled
+         * 
+         * \return *true* if the key is a valid JSON pointer
+         */
+        bool isValid() const noexcept { return m_isValid; }
+        /**
+         * \brief  retrieves the JSON pointer this key was compiled from
+         * 
+         * \return JSON pointer as C-string
+         */
+        char const *path() const noexcept { return m_path.c_str(); }
+        /**
+         * \brief  retrieves the JSON pointer this key was compiled from
+         *
+         * \return JSON pointer as string; valid for the lifetime of the key
+         */
+        std::string const &str() const noexcept { return m_path; }
+        /**
+         * \brief  retrieves the first reference token, i.e. the top-level key
+         *
+         * \return unescaped token; empty if the key refers to the whole document
+         */
+        std::string_view head() const noexcept { return m_tokens.empty() ? std::string_view{} : m_tokens.front(); }
+
+        /**
+         * \brief  looks up the value this key refers to inside *doc*
+         * 
+         * \param  [in] doc JSON document to search
+         * 
+         * \return pointer to the value inside *doc*, or *nullptr* if the key does not exist
+         * \note   The returned pointer is only valid for as long as *doc* is not modified.
+         */
+        JSON const *find(JSON const &doc) const noexcept {
+            if (!m_isValid)
+                return nullptr;
+
+            JSON const *curr = &doc;
+            for (size_t i = 0; i < m_tokens.size(); ++i) {
+                if (curr->is_object()) {
+                    auto const it = curr->find(m_tokens[i]);
+                    if (it == curr->end())
+                        return nullptr;
+
+                    curr = &*it;
+                } else if (curr->is_array()) {
+                    if (m_indices[i] >= curr->size())
+                        return nullptr;
+
+                    curr = &(*curr)[m_indices[i]];
+                } else
+                    return nullptr;
+            }
+
+            return curr;
+        }
+
+    private:
+        /**
+         * \brief  parses a reference token as an array index
+         * 
+         * \param  [in] token unescaped reference token
+         * 
+         * \return array index, or *gl_noindex* if *token* is not a valid index
+         */
+        static size_t ParseIndex(std::string const &token) noexcept {
+            /* As per RFC 6901, indices must not have leading zeros. */
+            if (token.empty() || token.length() > 19 || (token.length() > 1 && token[0] == '0'))
+                return gl_noindex;
+
+            size_t res = 0;
+            for (char const c : token) {
+                if (c < '0' || c > '9')
+                    return gl_noindex;
+
+                res = res * 10 + static_cast<size_t>(c - '0');
+            }
+
+            return res;
+        }
+    };
+
+
+    /**
+     * \class suzu::sdk::JSONValueConverter
+     * \brief converts raw values to concrete, mostly primitive types
+     */
+    struct JSONValueConverter {
+        /**
+         * \brief  converts a given JSON value to the desired type
+         * 
+         * \param  [in] val raw JSON value to convert
+         * \param  [in] fallback fallback value in case of errors
+         * 
+         * \return converted value, or *fallback* if *val* is not of the desired type
+         * \note   Enumerations are converted from their underlying integer type.
+         * \note   The *std::string_view* conversion references the string stored inside *val*;
+         *         the view is only valid for as long as *val* is.
+         */
+        template<class TargetVal> static TargetVal to(JSON const &val, TargetVal fallback) noexcept {
+            if constexpr (std::is_enum_v<TargetVal>) {
+                using Underlying = std::underlying_type_t<TargetVal>;
+
+                return static_cast<TargetVal>(to(val, static_cast<Underlying>(fallback)));
+            } else {
+                /*
+                 * Generic conversion function. The purpose of this return statement is to cause
+                 * a compilation error. This is a bit ugly, but it does work.
+                 */
+                return TargetVal::not_implemented_handler;
+            }
+        }
+
+        template<> static bool             to(JSON const &val, bool fallback)             noexcept { if (!val.is_boolean()) return fallback; return val.get<bool>(); }
+        template<> static int32_t          to(JSON const &val, int32_t fallback)          noexcept { if (!val.is_number_integer()) return fallback; return val.get<int32_t>(); }
+        template<> static int64_t          to(JSON const &val, int64_t fallback)          noexcept { if (!val.is_number_integer()) return fallback; return val.get<int64_t>(); }
+        template<> static uint32_t         to(JSON const &val, uint32_t fallback)         noexcept { if (!val.is_number_integer() || (!val.is_number_unsigned() && val.get<int64_t>() < 0)) return fallback; return val.get<uint32_t>(); }
+        template<> static uint64_t         to(JSON const &val, uint64_t fallback)         noexcept { if (!val.is_number_integer() || (!val.is_number_unsigned() && val.get<int64_t>() < 0)) return fallback; return val.get<uint64_t>(); }
+        template<> static float            to(JSON const &val, float fallback)            noexcept { if (!val.is_number_float()) return fallback; return val.get<float>(); }
+        template<> static double           to(JSON const &val, double fallback)           noexcept { if (!val.is_number_float()) return fallback; return val.get<double>(); }
+        template<> static std::string      to(JSON const &val, std::string fallback)      noexcept { if (!val.is_string()) return fallback; return val.get<std::string>(); }
+        template<> static std::string_view to(JSON const &val, std::string_view fallback) noexcept { if (!val.is_string()) return fallback; return val.get_ref<std::string const &>(); }
+
+
+        /**
+         * \brief converts mostly primitive values to a JSON value which can be fed into
+         *        the suzu::sdk::Configuration's methods
+         */
+        template<class SourceVal> static JSON from(SourceVal val) noexcept {
+            if constexpr (std::is_enum_v<SourceVal>)
+                return JSON(static_cast<std::underlying_type_t<SourceVal>>(val));
+            else {
+                /*
+                 * Generic conversion function. The purpose of this return statement is to cause
+                 * a compilation error. This is a bit ugly, but it does work.
+                 */
+                return SourceVal::not_implemented_handler;
+            }
+        }
+
+        template<> static JSON from(bool val)             noexcept { return JSON(val); }
+        template<> static JSON from(int32_t val)          noexcept { return JSON(val); }
+        template<> static JSON from(int64_t val)          noexcept { return JSON(val); }
+        template<> static JSON from(uint32_t val)         noexcept { return JSON(val); }
+        template<> static JSON from(uint64_t val)         noexcept { return JSON(val); }
+        template<> static JSON from(float val)            noexcept { return JSON(val); }
+        template<> static JSON from(double val)           noexcept { return JSON(val); }
+        template<> static JSON from(char const *val)      noexcept { return JSON(val); }
+        template<> static JSON from(std::string val)      noexcept { return JSON(val); }
+        template<> static JSON from(std::string_view val) noexcept { return JSON(val); }
+    };
+    using JSONCVT = JSONValueConverter;
+
+
+    /**
+     * \class suzu::sdk::ConfigSnapshot
+     * \brief immutable generation of a configuration document
+     *
+     * Snapshots are handed out by *suzu::sdk::Configuration::snapshot()*. A snapshot keeps its
+     * generation of the document alive for as long as it exists, regardless of whether or not the
+     * configuration has been modified in the meantime. References obtained from a snapshot are
+     * therefore valid for the lifetime of the snapshot.
+     *
+     * \note  Snapshots are cheap to copy and can be shared between threads.
+     */
+    class ConfigSnapshot {
+        std::shared_ptr<JSON const> m_doc; /**< referenced generation */
+
+    public:
+        ConfigSnapshot() noexcept = default;
+        /**
+         * \brief constructs a new snapshot of the given document generation
+         * 
+         * \param [in] doc document generation to reference
+         */
+        explicit ConfigSnapshot(std::shared_ptr<JSON const> doc) noexcept
+            : m_doc(std::move(doc))
+        { }
+
+
+        /**
+         * \brief  retrieves whether or not the snapshot references a document
+         * 
+         * \return *true* if the snapshot is valid
+         */
+        bool isValid() const noexcept { return m_doc != nullptr; }
+        /**
+         * \brief  retrieves the whole document of this generation
+         * 
+         * \return reference to the document
+         * \note   The snapshot must be valid.
+         */
+        JSON const &document() const noexcept { return *m_doc; }
+
+        /**
+         * \brief  looks up the value referred to by *key*
+         * 
+         * \param  [in] key pre-compiled key of the desired value
+         * 
+         * \return pointer to the value, or *nullptr* if the key does not exist
+         * \note   The pointer is valid for as long as this snapshot exists.
+         */
+        JSON const *find(ConfigKey const &key) const noexcept {
+            return m_doc == nullptr ? nullptr : key.find(*m_doc);
+        }
+        /**
+         * \brief  checks whether the value referred to by *key* exists
+         * 
+         * \param  [in] key pre-compiled key of the value
+         * 
+         * \return *true* if the key exists
+         */
+        bool contains(ConfigKey const &key) const noexcept { return find(key) != nullptr; }
+
+        /**
+         * \brief  retrieves the value referred to by *key*, converted to *TargetVal*
+         * 
+         * The value is converted in place; no intermediate JSON value is created.
+         * 
+         * \param  [in] key pre-compiled key of the desired value
+         * \param  [in] fallback value returned if the key does not exist or has the wrong type
+         * 
+         * \return converted value
+         * \note   Views (such as *std::string_view*) are valid for as long as this snapshot exists.
+         */
+        template<class TargetVal> TargetVal get(ConfigKey const &key, TargetVal fallback) const noexcept {
+            JSON const *val = find(key);
+
+            return val == nullptr ? fallback : JSONCVT::to(*val, std::move(fallback));
+        }
+    };
+
+
+    /**
+     * \brief callback invoked when configuration values have changed
+     *
+     * The parameter holds the (deduplicated) JSON pointers of all values that have been written
+     * since the last notification and that lie at or below the prefix of the subscription.
+     */
+    using ConfigObserver   = std::function<void(std::vector<std::string> const &)>;
+    using ConfigObserverId = uint64_t; /**< identifies a subscription; 0 is never used */
+
+    class Configuration;
+    class ConfigView;
+
+
+    namespace internal {
+        /**
+         * \class suzu::sdk::internal::ConfigNotifier
+         * \brief dispatches coalesced change notifications of a configuration object
+         *
+         * Writes are collected until control returns to the event loop of the application
+         * instance. All writes made in the meantime are then delivered as one notification per
+         * subscription. If no application instance exists, notifications are delivered
+         * immediately.
+         *
+         * \note  Notifications are always delivered on the thread of the application instance.
+         */
+        class ConfigNotifier : public std::enable_shared_from_this<ConfigNotifier> {
+            /**
+             * \struct suzu::sdk::internal::ConfigNotifier::Subscription
+             * \brief  a single registered observer
+             */
+            struct Subscription {
+                ConfigObserverId id;     /**< subscription id */
+                std::string      prefix; /**< JSON pointer prefix */
+                ConfigObserver   fn;     /**< callback */
+            };
+
+            QMutex                    m_lock;      /**< guards all members */
+            std::vector<Subscription> m_subs;      /**< registered observers */
+            std::vector<std::string>  m_pending;   /**< paths written since the last dispatch */
+            ConfigObserverId          m_nextid;    /**< next subscription id */
+            bool                      m_scheduled; /**< whether or not a dispatch is pending */
+
+        public:
+            ConfigNotifier() noexcept
+                : m_nextid(1), m_scheduled(false)
+            { }
+
+
+            ConfigObserverId subscribe(char const *const prefix, ConfigObserver fn) {
+                QMutexLocker lock(&m_lock);
+
+                m_subs.push_back({ m_nextid, std::string{ prefix == nullptr ? "" : prefix }, std::move(fn) });
+                return m_nextid++;
+            }
+
+            void unsubscribe(ConfigObserverId const id) {
+                QMutexLocker lock(&m_lock);
+
+                m_subs.erase(std::remove_if(m_subs.begin(), m_subs.end(), [id](Subscription const &sub) { return sub.id == id; }), m_subs.end());
+            }
+
+            /**
+             * \brief records the given written paths and schedules a dispatch if necessary
+             * 
+             * \param [in] paths JSON pointers of all written values
+             */
+            void post(std::vector<std::string> &&paths) {
+                {
+                    QMutexLocker lock(&m_lock);
+                    if (m_subs.empty() || paths.empty())
+                        return;
+
+                    m_pending.insert(m_pending.end(), std::make_move_iterator(paths.begin()), std::make_move_iterator(paths.end()));
+                    if (m_scheduled)
+                        return;
+
+                    m_scheduled = true;
+                }
+
+                /* Defer the dispatch to the next iteration of the event loop. */
+                if (QCoreApplication *app = QCoreApplication::instance()) {
+                    std::weak_ptr<ConfigNotifier> self = weak_from_this();
+
+                    QMetaObject::invokeMethod(app, [self]() {
+                        if (auto notifier = self.lock())
+                            notifier->dispatch();
+                    }, Qt::QueuedConnection);
+
+                    return;
+                }
+
+                dispatch();
+            }
+
+        private:
+            /**
+             * \brief  checks whether a write to *path* affects values at or below *prefix*
+             * 
+             * \param  [in] path written JSON pointer
+             * \param  [in] prefix subscribed JSON pointer prefix
+             * 
+             * \return *true* if one of the pointers is a prefix of the other
+             */
+            static bool Overlaps(std::string const &path, std::string const &prefix) noexcept {
+                std::string const &shorter = path.length() < prefix.length() ? path : prefix;
+                std::string const &longer  = path.length() < prefix.length() ? prefix : path;
+
+                return longer.compare(0, shorter.length(), shorter) == 0
+                    && (longer.length() == shorter.length() || longer[shorter.length()] == '/');
+            }
+
+            void dispatch() {
+                std::vector<Subscription> subs;
+                std::vector<std::string>  paths;
+                {
+                    QMutexLocker lock(&m_lock);
+
+                    subs  = m_subs;
+                    paths = std::move(m_pending);
+                    m_pending.clear();
+                    m_scheduled = false;
+                }
+
+                /* Coalesce multiple writes to the same value. */
+                std::sort(paths.begin(), paths.end());
+                paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+                for (Subscription const &sub : subs) {
+                    std::vector<std::string> matches;
+                    for (std::string const &path : paths)
+                        if (Overlaps(path, sub.prefix))
+                            matches.push_back(path);
+
+                    if (!matches.empty())
+                        sub.fn(matches);
+                }
+            }
+        };
+
+        /**
+         * \struct suzu::sdk::internal::ReloadTarget
+         * \brief  configuration object a pending reload is applied to
+         *
+         * Reloads run on the I/O thread and may outlive the watcher that scheduled them. The target
+         * is reset when the configuration stops watching its file, so that late reloads are dropped.
+         */
+        struct ReloadTarget {
+            std::mutex     lock; /**< guards *cfg* */
+            Configuration *cfg;  /**< target; *nullptr* if the reload is to be dropped */
+        };
+
+        /**
+         * \class suzu::sdk::internal::ConfigWatcher
+         * \brief watches a configuration file and reports bursts of changes once
+         *
+         * Every change restarts the debounce timer; *fn* is invoked once the file has not changed for
+         * the duration of the debounce interval.
+         *
+         * \note  Must be created and destroyed on the thread of the application instance.
+         */
+        class ConfigWatcher {
+            QFileSystemWatcher m_watcher; /**< file system watcher */
+            QTimer             m_timer;   /**< debounce timer */
+            QString            m_path;    /**< watched file */
+
+        public:
+            ConfigWatcher(std::string const &path, uint32_t const debounce, std::function<void()> fn)
+                : m_path(QString::fromStdString(path))
+            {
+                m_timer.setSingleShot(true);
+                m_timer.setInterval(static_cast<int>(debounce));
+
+                /*
+                 * Many editors save by replacing the file, which removes it from the watch list. The
+                 * path is therefore re-added whenever it has gone missing.
+                 */
+                QObject::connect(&m_watcher, &QFileSystemWatcher::fileChanged, &m_timer, [this]() {
+                    rewatch();
+
+                    m_timer.start();
+                });
+                QObject::connect(&m_timer, &QTimer::timeout, &m_timer, [this, fn = std::move(fn)]() {
+                    rewatch();
+
+                    fn();
+                });
+
+                m_watcher.addPath(m_path);
+            }
+            ConfigWatcher(ConfigWatcher const &) = delete;
+            ConfigWatcher &operator =(ConfigWatcher const &) = delete;
+
+        private:
+            void rewatch() {
+                if (!m_watcher.files().contains(m_path))
+                    m_watcher.addPath(m_path);
+            }
+        };
+
+        /**
+         * \struct suzu::sdk::internal::LazyDocument
+         * \brief  top-level values of a configuration file whose parsing has been deferred
+         *
+         * On load, the top level of the document is only scanned for the byte ranges of its values.
+         * Small values are parsed right away; larger ones are kept as text until they are first
+         * accessed.
+         */
+        struct LazyDocument {
+            static constexpr size_t gl_threshold = 1024; /**< size of a top-level value from which on its parsing is deferred, in bytes */
+
+            /**
+             * \struct suzu::sdk::internal::LazyDocument::Span
+             * \brief  byte range of an unparsed value inside *text*
+             */
+            struct Span {
+                size_t begin; /**< offset of the first byte */
+                size_t end;   /**< offset past the last byte */
+            };
+
+            std::string                           text;    /**< copy of the source file */
+            std::unordered_map<std::string, Span> pending; /**< unparsed values, by top-level key */
+
+
+            /**
+             * \brief  scans the top level of a document
+             *
+             * \param  [in] data text of the document
+             * \param  [in] len number of bytes in *data*
+             * \param  [out] eager object receiving all small top-level values
+             * \param  [out] lazy receives the ranges of all large top-level values
+             *
+             * \return *true* if the top level is well-formed; sub-trees are only checked when parsed
+             * \throw  std::bad_alloc
+             */
+            static bool Index(char const *const data, size_t const len, JSON &eager, LazyDocument &lazy) {
+                char const *pos = data;
+                char const *end = data + len;
+                if (!SkipSpace(pos, end) || pos == end || *pos != '{')
+                    return false;
+                ++pos;
+                if (!SkipSpace(pos, end) || pos == end)
+                    return false;
+
+                if (*pos == '}')
+                    ++pos;
+                else
+                    for (;;) {
+                        char const *const keybegin = pos;
+                        if (*pos != '"' || !SkipString(pos, end))
+                            return false;
+
+                        /* Keys rarely contain escape sequences; only those are unescaped by the parser. */
+                        std::string key(keybegin + 1, pos - 1);
+                        if (key.find('\\') != std::string::npos) {
+                            JSON const unescaped = JSON::parse(keybegin, pos, nullptr, false);
+                            if (!unescaped.is_string())
+                                return false;
+                            key = unescaped.get<std::string>();
+                        }
+
+                        if (!SkipSpace(pos, end) || pos == end || *pos != ':')
+                            return false;
+                        ++pos;
+                        if (!SkipSpace(pos, end))
+                            return false;
+
+                        char const *const valbegin = pos;
+                        if (!SkipValue(pos, end))
+                            return false;
+
+                        /* As with the parser, the last of several equal keys wins. */
+                        if (static_cast<size_t>(pos - valbegin) >= gl_threshold) {
+                            eager.erase(key);
+                            lazy.pending[key] = { static_cast<size_t>(valbegin - data), static_cast<size_t>(pos - data) };
+                        } else {
+                            JSON val = JSON::parse(valbegin, pos, nullptr, false, true);
+                            if (val.is_discarded())
+                                return false;
+
+                            lazy.pending.erase(key);
+                            eager[key] = std::move(val);
+                        }
+
+                        if (!SkipSpace(pos, end) || pos == end)
+                            return false;
+                        if (*pos == '}') {
+                            ++pos;
+
+                            break;
+                        }
+                        if (*pos != ',')
+                            return false;
+                        ++pos;
+                        if (!SkipSpace(pos, end) || pos == end)
+                            return false;
+                    }
+
+                return SkipSpace(pos, end) && pos == end;
+            }
+
+            /**
+             * \brief  parses a deferred value
+             *
+             * \param  [in] span range of the value
+             *
+             * \return parsed value; discarded if it is malformed
+             * \throw  std::bad_alloc
+             */
+            JSON parse(Span const &span) const {
+                return JSON::parse(text.data() + span.begin, text.data() + span.end, nullptr, false, true);
+            }
+
+        private:
+            /**
+             * \brief  skips whitespace and comments
+             *
+             * \param  [in,out] pos current position
+             * \param  [in] end end of the text
+             *
+             * \return *false* if a block comment is not terminated
+             */
+            static bool SkipSpace(char const *&pos, char const *const end) noexcept {
+                while (pos != end) {
+                    if (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r')
+                        ++pos;
+                    else if (*pos == '/' && end - pos >= 2 && pos[1] == '/') {
+                        while (pos != end && *pos != '\n')
+                            ++pos;
+                    } else if (*pos == '/' && end - pos >= 2 && pos[1] == '*') {
+                        for (pos += 2; ; ++pos) {
+                            if (end - pos < 2)
+                                return false;
+                            if (pos[0] == '*' && pos[1] == '/')
+                                break;
+                        }
+                        pos += 2;
+                    } else
+                        break;
+                }
+
+                return true;
+            }
+
+            /**
+             * \brief  skips a string, including its quotes
+             *
+             * \param  [in,out] pos position of the opening quote
+             * \param  [in] end end of the text
+             *
+             * \return *false* if the string is not terminated
+             */
+            static bool SkipString(char const *&pos, char const *const end) noexcept {
+                for (++pos; pos != end; ++pos) {
+                    if (*pos == '\\') {
+                        if (++pos == end)
+                            return false;
+                    } else if (*pos == '"') {
+                        ++pos;
+
+                        return true;
+                    }
+                }
+
+                return false;
+            }
+
+            /**
+             * \brief  skips a value without validating it
+             *
+             * \param  [in,out] pos position of the first byte of the value
+             * \param  [in] end end of the text
+             *
+             * \return *false* if the value is not terminated
+             */
+            static bool SkipValue(char const *&pos, char const *const end) noexcept {
+                if (pos == end)
+                    return false;
+                if (*pos == '"')
+                    return SkipString(pos, end);
+
+                /* Scalars end where the next token begins. */
+                if (*pos != '{' && *pos != '[') {
+                    char const *const begin = pos;
+                    while (pos != end && std::strchr(",}] \t\r\n/", *pos) == nullptr)
+                        ++pos;
+
+                    return pos != begin;
+                }
+
+                /* Brackets are balanced without checking their kind; the parser does so once the value is accessed. */
+                size_t depth = 0;
+                do {
+                    if (!SkipSpace(pos, end) || pos == end)
+                        return false;
+
+                    if (*pos == '"') {
+                        if (!SkipString(pos, end))
+                            return false;
+
+                        continue;
+                    }
+                    if (*pos == '{' || *pos == '[')
+                        ++depth;
+                    else if ((*pos == '}' || *pos == ']') && depth-- == 0)
+                        return false;
+                    ++pos;
+                } while (depth != 0);
+
+                return true;
+            }
+        };
+    }
+
+
     /**
      * \class suzu::sdk::Configuration
      * \brief class interfacing with configuration objects and files
@@ -35,55 +770,133 @@ namespace suzu::sdk {
      * Suzu uses JSON as its primary configuration format. This class allows the application
      * to load, read, and write values to these configuration files.
      * 
+     * Internally, the document is stored as a sequence of immutable generations. Readers
+     * atomically acquire the current generation and never wait for writers. Writers are
+     * serialized, copy the current generation, apply their modification to the copy and
+     * publish the result as the new generation. Writes are therefore comparatively expensive
+     * and should be batched where possible.
+     * 
      * \note  Instances of this class are thread-safe after being constructed. File flushes
      *        are NOT thread-safe.
      */
     class Configuration {
-        mutable QReadWriteLock m_lock;       /**< synchronization object */
-                JSON           m_dict;       /**< raw JSON key-value store */
-                std::string    m_path;       /**< (optional) file path */
-                bool           m_isOk;       /**< whether or not the config state is normal */
-                bool           m_writeOnDel; /**< whether or not to flush the file when the object is deleted */
+        mutable std::shared_ptr<JSON const>                     m_dict;       /**< current generation; only accessed atomically */
+        mutable QMutex                                          m_wrlock;     /**< serializes writers */
+                std::string                                     m_path;       /**< (optional) file path */
+                std::atomic<bool>                               m_isOk;       /**< whether or not the config state is normal */
+                bool                                            m_writeOnDel; /**< whether or not to flush the file when the object is deleted */
+                uint32_t                                        m_flags;      /**< combination of *Flags* */
+                std::shared_ptr<internal::ConfigNotifier>       m_notify;     /**< change notification channel */
+        mutable std::atomic<uint64_t>                           m_hash;       /**< content hash of the file as last read or written */
+                std::atomic<uint64_t>                           m_gen;        /**< number of modifications since construction */
+        mutable std::atomic<uint64_t>                           m_savedgen;   /**< value of *m_gen* the source file corresponds to */
+                std::shared_ptr<internal::ReloadTarget>         m_target;     /**< target of pending reloads; *nullptr* if not watching */
+                std::unique_ptr<internal::ConfigWatcher>        m_watcher;    /**< file watcher; *nullptr* if not watching */
+        mutable std::unique_ptr<internal::LazyDocument>         m_lazy;       /**< top-level values not parsed yet; *nullptr* if there are none; guarded by *m_wrlock* */
+        mutable std::atomic<bool>                               m_partial;    /**< whether or not *m_lazy* holds values */
+        mutable std::shared_ptr<std::vector<std::string> const> m_deferred;   /**< sorted keys of the values in *m_lazy*; *nullptr* if there are none; only accessed atomically */
 
     public:
+        /**
+         * \enum  suzu::sdk::Configuration::Flags
+         * \brief optional behavior of configuration objects
+         */
+        enum Flags : uint32_t {
+            NoFlags     = 0,      /**< default behavior */
+            BinaryCache = 1 << 0, /**< maintain a binary sidecar cache of the source file */
+            LazyLoad    = 1 << 1, /**< defer parsing large top-level values until they are accessed */
+        };
+
+
         /**
          * \brief constructs a new configuration object
          *
          * The configuration supports two forms of input. A new configuration object can
          * be generated from an empty object, or from a file path.
+         * 
+         * If *BinaryCache* is set, the parsed document is additionally stored as CBOR in a
+         * sidecar file next to the source file (*<path>.cache*). The cache is keyed by the
+         * modification time and the size of the source file; as long as the source file is
+         * unchanged, subsequent loads read the cache instead of parsing the JSON text.
+         *
+         * If *LazyLoad* is set, large top-level values are only parsed once a key below them is
+         * accessed, e.g. by *get()* or *lookup()*; *snapshot()* and all writes parse the rest of
+         * the document first. A malformed top-level value is only detected when it is accessed, and
+         * then reads as missing. *LazyLoad* has no effect together with *BinaryCache*, as the cache
+         * has to hold the whole document.
          *
          * \param [in] path (optional) file path, must be *nullptr* if the config object
          *        should be initially empty
          * \param [in] writedest whether or not to flush the file when the object is destroyed;
          *        ignored if *path* is *nullptr*
+         * \param [in] flags combination of *suzu::sdk::Configuration::Flags*
          */
-        explicit Configuration(char const *const path = nullptr, bool writedest = false) noexcept
-            : m_lock(QReadWriteLock::RecursionMode::Recursive), m_isOk(true), m_writeOnDel(writedest)
+        explicit Configuration(char const *const path = nullptr, bool writedest = false, uint32_t flags = NoFlags) noexcept
+            : m_isOk(true), m_writeOnDel(writedest), m_flags(flags), m_notify(std::make_shared<internal::ConfigNotifier>()), m_hash(0), m_gen(0), m_savedgen(0), m_partial(false)
         {
             try {
+                publish(std::make_shared<JSON const>());
+
                 /* If *path* is not *nullptr*, copy the filename. */
                 if (path != nullptr) {
                     m_path = std::string{ path };
 
+                    /* Try the binary cache first, if enabled. */
+                    JSON doc;
+                    if ((flags & BinaryCache) && ReadCache(m_path, doc)) {
+                        publish(std::make_shared<JSON const>(std::move(doc)));
+
+                        return;
+                    }
+
                     /* Load config file from the given path. */
-                    util::FileBuffer buf;
-                    if (util::ReadFile(path, buf) != ErrorCode::Ok)
+                    util::MappedFile file;
+                    if (util::MapFile(path, file) != ErrorCode::Ok)
                         return;
 
-                    m_dict = JSON::parse(buf.data(), nullptr, false, true);
-                    if (m_dict.is_discarded())
+                    m_hash = util::HashBytes(file.data(), file.size());
+
+                    /* Documents whose top level cannot be scanned are parsed as a whole, so that errors are reported alike. */
+                    if ((flags & LazyLoad) && !(flags & BinaryCache)) {
+                        auto lazy = std::make_unique<internal::LazyDocument>();
+                        doc       = JSON::object();
+                        if (internal::LazyDocument::Index(file.data(), file.size(), doc, *lazy)) {
+                            if (!lazy->pending.empty()) {
+                                lazy->text.assign(file.data(), file.size());
+
+                                m_lazy    = std::move(lazy);
+                                m_partial = true;
+                                publishDeferred();
+                            }
+                            publish(std::make_shared<JSON const>(std::move(doc)));
+
+                            return;
+                        }
+                    }
+
+                    doc = JSON::parse(file.data(), file.data() + file.size(), nullptr, false, true);
+                    if (doc.is_discarded()) {
                         reset();
+
+                        return;
+                    }
+
+                    if (flags & BinaryCache)
+                        WriteCache(m_path, doc);
+                    publish(std::make_shared<JSON const>(std::move(doc)));
                 }
             } catch (...) { m_isOk = false; }
         }
 
         virtual ~Configuration() {
+            unwatch();
+
             /*
              * If the path is not empty and the corresponding flag is set, write the current
-             * state to the file at the saved file path.
+             * state to the file at the saved file path, unless the file is up to date.
              */
-            if (m_writeOnDel && !m_path.empty())
-                writeToFile(m_path.c_str());
+            if (m_writeOnDel && !m_path.empty() && isDirty())
+                writeToFile();
         }
 
 
@@ -93,59 +906,430 @@ namespace suzu::sdk {
          * \return *true* if the state is healthy
          */
         bool isOk() const noexcept { return m_isOk; }
+        /**
+         * \brief  retrieves whether the document has been modified since it was last loaded
+         *         from or written to the source file
+         * 
+         * \return *true* if the source file is out of date
+         */
+        bool isDirty() const noexcept { return m_gen.load(std::memory_order_acquire) != m_savedgen.load(std::memory_order_acquire); }
+
+        /**
+         * \brief  acquires the current generation of the document
+         * 
+         * This never blocks on concurrent writers. Subsequent modifications of the configuration
+         * are not visible through the returned snapshot. With *LazyLoad*, all values not parsed
+         * yet are parsed first.
+         * 
+         * \return snapshot of the current generation; invalid if the config state is not normal
+         */
+        ConfigSnapshot snapshot() const noexcept {
+            if (m_partial.load(std::memory_order_acquire))
+                complete({}, true);
+
+            return current();
+        }
+
+
+        /**
+         * \brief  looks up the value referred to by *key* without copying it
+         * 
+         * \param  [in] key pre-compiled key of the desired value
+         * \param  [out] pin snapshot keeping the value alive; replaced by the current generation
+         * 
+         * \return pointer to the value, or *nullptr* if the key does not exist
+         * \note   The pointer is valid for as long as *pin* references the same generation.
+         */
+        JSON const *find(ConfigKey const &key, ConfigSnapshot &pin) const noexcept {
+            pin = snapshotOf(key);
+
+            return pin.find(key);
+        }
+
+        /**
+         * \brief  checks whether the value referred to by *key* exists
+         * 
+         * Neither the value nor the document is copied, so the check never allocates.
+         * 
+         * \param  [in] key pre-compiled key of the value
+         * 
+         * \return *true* if the key exists
+         */
+        bool contains(ConfigKey const &key) const noexcept {
+            return snapshotOf(key).contains(key);
+        }
+        /**
+         * \brief  checks whether the value at the given path exists
+         * 
+         * \param  [in] path path to the value; see *lookup()*
+         * 
+         * \return *true* if the value exists
+         * \note   Checks that are made frequently should use a pre-compiled *suzu::sdk::ConfigKey*.
+         */
+        bool contains(char const *const path) const noexcept {
+            return contains(ConfigKey{ path });
+        }
+
+        /**
+         * \brief  retrieves the raw JSON value at the given path
+         * 
+         * The path must be of the form /path/to/val where / denotes the root
+         * element.
+         * 
+         * \param  [in] path path to the desired value, in the above form
+         * 
+         * \return copy of the raw JSON value, *suzu::sdk::ErrorCode::InvalidParameter* if it does
+         *         not exist, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out
+         * \note   To get the actual underlying primitive value, use *suzu::sdk::JSONCVT*'s
+         * \note   Values that are read frequently should be accessed through a pre-compiled
+         *         *suzu::sdk::ConfigKey* instead.
+         */
+        Result<JSON> lookup(char const *const path) const noexcept {
+            return lookup(ConfigKey{ path });
+        }
+        /**
+         * \brief  retrieves the raw JSON value referred to by the pre-compiled key *key*
+         * 
+         * \param  [in] key pre-compiled key of the desired value
+         * 
+         * \return copy of the raw JSON value, *suzu::sdk::ErrorCode::InvalidParameter* if it does
+         *         not exist, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out
+         */
+        Result<JSON> lookup(ConfigKey const &key) const noexcept {
+            try {
+                ConfigSnapshot const snap = snapshotOf(key);
+
+                JSON const *val = snap.find(key);
+                if (val == nullptr)
+                    return ErrorCode::InvalidParameter;
+
+                return *val;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  retrieves the raw JSON value at the given path
+         * 
+         * \param  [in] path path to the desired value; see *lookup()*
+         * 
+         * \return raw JSON value; on error this return value's *is_discarded()*
+         *         method will return *true*
+         * \note   Prefer *lookup()*, which tells why no value was found.
+         */
+        JSON getValue(char const *const path) const noexcept {
+            return getValue(ConfigKey{ path });
+        }
+        /**
+         * \brief  retrieves the raw JSON value referred to by the pre-compiled key *key*
+         * 
+         * \param  [in] key pre-compiled key of the desired value
+         * 
+         * \return raw JSON value; on error this return value's *is_discarded()*
+         *         method will return *true*
+         * \note   Prefer *lookup()*, which tells why no value was found.
+         */
+        JSON getValue(ConfigKey const &key) const noexcept {
+            /* Discarded values hold no data, so returning one does not allocate. */
+            try {
+                return lookup(key).valueOr(JSON(JSON::value_t::discarded));
+            } catch (...) { }
+
+            return JSON(JSON::value_t::discarded);
+        }
+
+        /**
+         * \brief  invokes *fn* with a reference to the value referred to by *key*
+         * 
+         * Contrary to *getValue()*, this function does not copy the value. The reference that
+         * is passed to *fn* is only valid for the duration of the call and must not be stored.
+         * 
+         * \param  [in] key pre-compiled key of the desired value
+         * \param  [in] fn callable of the form *void(suzu::sdk::JSON const &)*
+         * 
+         * \return *true* if the value exists and *fn* was invoked
+         * \note   To keep values alive beyond the call, use *snapshot()* instead.
+         */
+        template<class Fn> bool visitValue(ConfigKey const &key, Fn &&fn) const noexcept {
+            try {
+                ConfigSnapshot const snap = snapshotOf(key);
+
+                JSON const *val = snap.find(key);
+                if (val == nullptr)
+                    return false;
+
+                fn(*val);
+                return true;
+            } catch (...) { }
+
+            return false;
+        }
+
+        /**
+         * \brief  retrieves the value referred to by *key*, converted to *TargetVal*
+         * 
+         * The value is converted in place; no intermediate JSON value is created. Reading
+         * primitive values therefore never allocates.
+         * 
+         * \param  [in] key pre-compiled key of the desired value
+         * \param  [in] fallback value returned if the key does not exist or has the wrong type
+         * 
+         * \return converted value
+         * \note   Views into the document cannot outlive the call. To read views such as
+         *         *std::string_view*, use *suzu::sdk::ConfigSnapshot::get()*.
+         */
+        template<class TargetVal> TargetVal get(ConfigKey const &key, TargetVal fallback) const noexcept {
+            static_assert(!std::is_same_v<TargetVal, std::string_view>, "views must be read through a ConfigSnapshot");
+
+            return snapshotOf(key).get(key, std::move(fallback));
+        }
+
+        /**
+         * \brief updates or insertes the given value *val* at *path*
+         * 
+         * \param [in] path path of the JSON value
+         * \param [in] val raw JSON value
+         * 
+         * \note  A copy of *val* will be inserted.
+         */
+        void setValue(char const *const path, JSON const &val) noexcept {
+            try {
+                Transaction tx = transaction();
+
+                tx.setValue(path, JSON(val));
+                tx.commit();
+            } catch (...) { }
+        }
+
+        /**
+         * \brief  applies all given values at once
+         * 
+         * Contrary to calling *setValue()* for each value, the writer lock is only taken once and
+         * only one new generation of the document is created.
+         * 
+         * \param  [in] vals list of (path, value) pairs
+         * 
+         * \return *suzu::sdk::ErrorCode::Ok* on success
+         * \note   Values of an initializer list cannot be moved from. To move large values into
+         *         the configuration, use *transaction()* directly.
+         */
+        ErrorCode apply(std::initializer_list<std::pair<char const *, JSON>> vals) noexcept {
+            try {
+                Transaction tx = transaction();
+
+                for (auto const &[path, val] : vals)
+                    tx.setValue(path, JSON(val));
+
+                return tx.commit();
+            } catch (...) { }
+
+            return ErrorCode::Unknown;
+        }
+
+
+        /**
+         * \brief  registers an observer for all values at or below *prefix*
+         * 
+         * Writes are coalesced: however many values are written within one iteration of the
+         * event loop, each observer is notified at most once per iteration with the list of
+         * affected paths. Resetting the configuration is reported as a write to the root ("").
+         * 
+         * \param  [in] prefix JSON pointer prefix; "" subscribes to the whole document
+         * \param  [in] fn callback to invoke
+         * 
+         * \return subscription id, or 0 on error
+         * \note   Observers are invoked on the thread of the application instance.
+         */
+        ConfigObserverId subscribe(char const *const prefix, ConfigObserver fn) noexcept {
+            try {
+                return m_notify->subscribe(prefix, std::move(fn));
+            } catch (...) { }
+
+            return 0;
+        }
+        /**
+         * \brief removes the subscription identified by *id*
+         * 
+         * \param [in] id subscription id returned by *subscribe()*
+         * 
+         * \note  An observer may still be invoked once if a dispatch is already in progress.
+         */
+        void unsubscribe(ConfigObserverId const id) noexcept {
+            try {
+                m_notify->unsubscribe(id);
+            } catch (...) { }
+        }
 
 
         /**
-         * \brief  retrieves the raw JSON value at the given path
+         * \brief  starts reloading the configuration whenever its source file changes on disk
          * 
-         * The path must be of the form /path/to/val where / denotes the root
-         * element.
+         * Bursts of changes are coalesced; the file is reloaded once it has not changed for
+         * *debounce* milliseconds. The file is read and parsed on the I/O thread, so reloading
+         * never blocks the thread of the application instance. The new document only replaces
+         * the current one if it could be parsed and differs from it. Successful reloads are
+         * reported to observers as a write to the root ("").
          * 
-         * \param  [in] path path to the desired value, in the above form
+         * \param  [in] debounce quiet period before reloading, in milliseconds
          * 
-         * \return raw JSON value; on error this return value's *is_discarded()*
-         *         method will return *true*
-         * \note   To get the actual underlying primitive value, use *suzu::sdk::JSONCVT*'s
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation*
+         *         if the file is already watched
+         * \note   Requires an application instance and must be called from its thread.
+         * \note   Files written by *writeToFile()* do not trigger a reload.
          */
-        JSON getValue(char const *const path) const noexcept {
-            /* Initialize discarded value. */
-            static JSON const gl_discval = JSON::parse("{" /* invalid JSON */, nullptr, false, true);
+        ErrorCode watch(uint32_t const debounce = 250) noexcept {
+            if (m_path.empty() || QCoreApplication::instance() == nullptr)
+                return ErrorCode::InvalidState;
+            else if (m_watcher != nullptr)
+                return ErrorCode::NoOperation;
 
             try {
-                QReadLocker lock(&m_lock);
+                auto target = std::make_shared<internal::ReloadTarget>();
+                target->cfg = this;
 
-                /* Initialize path. */
-                nlohmann::json_pointer<std::string> ptr(path);
-                if (!m_isOk || !m_dict.contains(ptr))
-                    return gl_discval;
+                m_watcher = std::make_unique<internal::ConfigWatcher>(m_path, debounce, [target]() {
+                    util::internal::IOThread::Instance().post([target]() { Reload(*target); });
+                });
+                m_target  = std::move(target);
+            } catch (...) {
+                return ErrorCode::Unknown;
+            }
 
-                return m_dict[ptr].get<JSON>();
-            } catch (...) { }
+            return ErrorCode::Ok;
+        }
+        /**
+         * \brief stops watching the source file
+         * 
+         * \note  Reloads that are still pending are dropped.
+         */
+        void unwatch() noexcept {
+            m_watcher.reset();
+
+            if (m_target != nullptr) {
+                std::lock_guard<std::mutex> lock(m_target->lock);
 
-            return gl_discval;
+                m_target->cfg = nullptr;
+            }
+            m_target.reset();
         }
 
+
         /**
-         * \brief updates or insertes the given value *val* at *path*
+         * \class suzu::sdk::Configuration::Transaction
+         * \brief batch of modifications that is published as one new generation
          * 
-         * \param [in] path path of the JSON value
-         * \param [in] val raw JSON value
+         * A transaction holds the writer lock of its configuration for its entire lifetime.
+         * Modifications are applied to a private copy of the document which is published when
+         * *commit()* is called. Transactions that are destroyed without being committed are
+         * rolled back.
          * 
-         * \note  A copy of *val* will be inserted.
+         * \note  Transactions must be short-lived; other writers are blocked until the transaction
+         *        finishes. Readers are never blocked.
          */
-        void setValue(char const *const path, JSON const &val) noexcept {
-            try {
-                QWriteLocker lock(&m_lock);
-                if (!m_isOk)
-                    return;
+        class Transaction {
+            friend class Configuration;
 
-                /* Initialize path. */
-                nlohmann::json_pointer<std::string> ptr(path);
+            Configuration            *m_cfg;     /**< owning configuration */
+            std::unique_lock<QMutex>  m_lock;    /**< held writer lock */
+            std::shared_ptr<JSON>     m_next;    /**< next generation being built */
+            std::vector<std::string>  m_changed; /**< written paths, for change notification */
 
-                /* Update or insert JSON value. */
-                m_dict[ptr] = val;
-            } catch (...) { }
-        }
+            explicit Transaction(Configuration &cfg)
+                : m_cfg(&cfg), m_lock(cfg.m_wrlock)
+            {
+                if (cfg.m_isOk) {
+                    cfg.completeLocked({}, true);
+
+                    m_next = std::make_shared<JSON>(*std::atomic_load_explicit(&cfg.m_dict, std::memory_order_relaxed));
+                }
+            }
+
+        public:
+            Transaction(Transaction &&) noexcept = default;
+            Transaction &operator =(Transaction &&) noexcept = default;
+
+
+            /**
+             * \brief  updates or inserts the given value *val* at *path*
+             * 
+             * \param  [in] path path of the JSON value
+             * \param  [in] val raw JSON value; moved into the document
+             * 
+             * \return *suzu::sdk::ErrorCode::Ok* on success
+             */
+            ErrorCode setValue(char const *const path, JSON &&val) noexcept {
+                if (path == nullptr)
+                    return ErrorCode::InvalidParameter;
+                else if (m_next == nullptr)
+                    return ErrorCode::InvalidState;
+
+                try {
+                    (*m_next)[nlohmann::json_pointer<std::string>(path)] = std::move(val);
+
+                    m_changed.emplace_back(path);
+                } catch (...) {
+                    return ErrorCode::InvalidParameter;
+                }
+
+                return ErrorCode::Ok;
+            }
+            /**
+             * \brief  updates or inserts the given value *val* at *key*
+             * 
+             * \param  [in] key pre-compiled key of the JSON value
+             * \param  [in] val raw JSON value; moved into the document
+             * 
+             * \return *suzu::sdk::ErrorCode::Ok* on success
+             */
+            ErrorCode setValue(ConfigKey const &key, JSON &&val) noexcept {
+                if (!key.isValid())
+                    return ErrorCode::InvalidParameter;
+
+                return setValue(key.path(), std::move(val));
+            }
+
+            /**
+             * \brief  publishes all modifications and releases the writer lock
+             * 
+             * Observers are notified once for the whole transaction.
+             * 
+             * \return *suzu::sdk::ErrorCode::Ok* on success
+             * \note   The transaction cannot be used anymore after this function returns.
+             */
+            ErrorCode commit() noexcept {
+                if (m_next == nullptr)
+                    return ErrorCode::InvalidState;
+
+                m_cfg->publish(std::move(m_next));
+                m_cfg->m_gen.fetch_add(1, std::memory_order_release);
+                m_lock.unlock();
+
+                try {
+                    m_cfg->m_notify->post(std::move(m_changed));
+                } catch (...) { }
+
+                return ErrorCode::Ok;
+            }
+        };
+
+        /**
+         * \brief  begins a new transaction on this configuration
+         * 
+         * \return transaction object; holds the writer lock until it is committed or destroyed
+         */
+        Transaction transaction() { return Transaction{ *this }; }
+
+        /**
+         * \brief  retrieves a view of the section at *prefix*, e.g. "/plugins/<id>"
+         *
+         * \param  [in] prefix JSON pointer of the section; "" for the whole document
+         *
+         * \return view reading and writing relative to *prefix*
+         * \throw  std::bad_alloc
+         * \note   The view references this configuration, which must outlive it.
+         */
+        ConfigView view(char const *prefix);
 
 
         /**
@@ -162,11 +1346,11 @@ namespace suzu::sdk {
             static std::string const gl_emptydoc = std::string{ "{}" };
 
             try {
-                QReadLocker lock(&m_lock);
-                if (!m_isOk)
+                ConfigSnapshot const snap = snapshot();
+                if (!snap.isValid())
                     return gl_emptydoc;
 
-                return m_dict.dump(pretty ? 4 : -1);
+                return snap.document().dump(pretty ? 4 : -1);
             } catch (...) { }
 
             return gl_emptydoc;
@@ -180,27 +1364,63 @@ namespace suzu::sdk {
          * passed, if any is present. If *path* is *nullptr* and no path was saved, the function
          * does nothing.
          * 
+         * The document is serialized directly into the file; no intermediate string is built.
+         * Unless *append* is set, the file is replaced atomically.
+         * 
          * \param  [in] path to the file to override the saved path
          * \param  [in] append whether or not to append the contents to the file
          * 
-         * \return *suzu::sdk::ErrorCode::Ok* on success
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if
+         *         there is no file to write to
          */
         ErrorCode writeToFile(char const *const path = nullptr, bool append = false) const noexcept {
-            if (path == nullptr)
-                return ErrorCode::InvalidParameter;
+            char const *const dest = path == nullptr ? m_path.c_str() : path;
+            if (*dest == '\0')
+                return ErrorCode::NoOperation;
 
-            ErrorCode code = ErrorCode::Ok;
             try {
-                QReadLocker lock(&m_lock);
                 if (!m_isOk)
                     return ErrorCode::InvalidState;
 
+                /* Read the generation first; a concurrent write then leaves the file marked dirty. */
+                uint64_t const       gen    = m_gen.load(std::memory_order_acquire);
+                ConfigSnapshot const snap   = snapshot();
+                bool const           source = !append && m_path == dest;
+
+                util::AtomicFile file;
+                std::FILE       *handle = nullptr;
+                if (append)
+                    handle = std::fopen(dest, "a");
+                else if (file.open(dest) == ErrorCode::Ok)
+                    handle = file.handle();
+                if (handle == nullptr)
+                    return ErrorCode::OpenFile;
+
                 /* Write serialized JSON document. */
-                std::string const serjson = writeToString(false);
-                code = util::WriteFile(path == nullptr ? m_path.c_str() : path, serjson.c_str(), serjson.length());
+                util::FileStreamBuffer buf(handle);
+                std::ostream           stream(&buf);
+                stream << snap.document();
+
+                bool const      written = stream.good();
+                ErrorCode const code    = append
+                    ? (std::fclose(handle) == 0 && written ? ErrorCode::Ok : ErrorCode::WriteFile)
+                    : (written ? file.commit() : ErrorCode::WriteFile)
+                ;
+                if (code != ErrorCode::Ok || !source)
+                    return code;
+
+                /* Remember what was written, so that the file watcher does not reload it. */
+                m_hash     = buf.hash();
+                m_savedgen = gen;
+
+                /* Keep the binary cache fresh if the source file itself was overwritten. */
+                if (m_flags & BinaryCache)
+                    WriteCache(m_path, snap.document());
+
+                return ErrorCode::Ok;
             } catch (...) { }
 
-            return code;
+            return ErrorCode::Unknown;
         }
 
         /**
@@ -209,68 +1429,470 @@ namespace suzu::sdk {
          * If the source of the configuration object is a file, the disk file will
          * not be updated.
          * 
-         * \note  All references to values from within this object are invalidated.
+         * \note  Existing snapshots are not affected.
          */
         void reset() noexcept {
             try {
-                QWriteLocker lock(&m_lock);
+                {
+                    QMutexLocker lock(&m_wrlock);
+
+                    /* Reset value by replacing it with an empty JSON document. */
+                    publish(std::make_shared<JSON const>(JSON::object()));
+                    m_lazy.reset();
+                    m_partial = false;
+                    publishDeferred();
+                    m_gen.fetch_add(1, std::memory_order_release);
+                    m_isOk = true;
+                }
+
+                m_notify->post({ std::string{} });
+            } catch (...) { }
+        }
+
+    private:
+        /**
+         * \struct suzu::sdk::Configuration::CacheHeader
+         * \brief  header of a binary config cache file; followed by the CBOR document
+         */
+        struct CacheHeader {
+            static constexpr uint32_t gl_magic   = 0x43435A53; /**< "SZCC" */
+            static constexpr uint32_t gl_version = 1;          /**< current cache version */
+
+            uint32_t magic;   /**< must be *gl_magic* */
+            uint32_t version; /**< must be *gl_version* */
+            int64_t  mtime;   /**< modification time of the source file */
+            uint64_t size;    /**< size of the source file, in bytes */
+        };
+
+        /**
+         * \brief  retrieves the cache key of the source file at *path*
+         * 
+         * \param  [in] path path of the source file
+         * \param  [out] header header whose *mtime* and *size* fields will be populated
+         * 
+         * \return *true* if the file could be queried
+         */
+        static bool QuerySourceStamp(std::string const &path, CacheHeader &header) noexcept {
+            std::error_code ec;
+
+            auto const mtime = std::filesystem::last_write_time(path, ec);
+            if (ec)
+                return false;
+            auto const size = std::filesystem::file_size(path, ec);
+            if (ec)
+                return false;
+
+            header = { CacheHeader::gl_magic, CacheHeader::gl_version, static_cast<int64_t>(mtime.time_since_epoch().count()), static_cast<uint64_t>(size) };
+            return true;
+        }
+
+        /**
+         * \brief  loads the binary cache of the source file at *path*
+         * 
+         * \param  [in] path path of the source file
+         * \param  [out] doc document read from the cache
+         * 
+         * \return *true* if the cache exists, is fresh and could be decoded
+         */
+        static bool ReadCache(std::string const &path, JSON &doc) noexcept {
+            try {
+                CacheHeader expected;
+                if (!QuerySourceStamp(path, expected))
+                    return false;
+
+                util::MappedFile file;
+                if (util::MapFile((path + ".cache").c_str(), file) != ErrorCode::Ok || file.size() < sizeof(CacheHeader))
+                    return false;
+
+                CacheHeader actual;
+                std::memcpy(&actual, file.data(), sizeof(CacheHeader));
+                if (std::memcmp(&actual, &expected, sizeof(CacheHeader)) != 0)
+                    return false;
+
+                doc = JSON::from_cbor(file.data() + sizeof(CacheHeader), file.data() + file.size(), true, false);
+                return !doc.is_discarded();
+            } catch (...) { }
+
+            return false;
+        }
+
+        /**
+         * \brief writes *doc* as the binary cache of the source file at *path*
+         * 
+         * \param [in] path path of the source file
+         * \param [in] doc document to cache
+         * 
+         * \note  Failing to write the cache is not an error.
+         */
+        static void WriteCache(std::string const &path, JSON const &doc) noexcept {
+            try {
+                CacheHeader header;
+                if (!QuerySourceStamp(path, header))
+                    return;
+
+                util::FileBuffer buf(sizeof(CacheHeader));
+                std::memcpy(buf.data(), &header, sizeof(CacheHeader));
+                JSON::to_cbor(doc, buf);
+
+                util::WriteFileAtomic((path + ".cache").c_str(), buf.data(), buf.size(), true);
+            } catch (...) { }
+        }
+
+        /**
+         * \brief re-reads the source file of the target of *target*; executed on the I/O thread
+         * 
+         * \param [in] target reload target
+         */
+        static void Reload(internal::ReloadTarget &target) noexcept {
+            try {
+                std::string path;
+                uint32_t    flags;
+                uint64_t    prevhash;
+                {
+                    std::lock_guard<std::mutex> lock(target.lock);
+                    if (target.cfg == nullptr)
+                        return;
+
+                    path     = target.cfg->m_path;
+                    flags    = target.cfg->m_flags;
+                    prevhash = target.cfg->m_hash;
+                }
+
+                /* Skip files whose contents did not change, e.g. if only the timestamp was updated. */
+                util::MappedFile file;
+                if (util::MapFile(path.c_str(), file) != ErrorCode::Ok)
+                    return;
+                uint64_t const hash = util::HashBytes(file.data(), file.size());
+                if (hash == prevhash)
+                    return;
+
+                /* Keep the current document if the file is malformed, e.g. while it is being edited. */
+                JSON doc = JSON::parse(file.data(), file.data() + file.size(), nullptr, false, true);
+                if (doc.is_discarded())
+                    return;
+                file.close();
+                if (flags & BinaryCache)
+                    WriteCache(path, doc);
+
+                std::lock_guard<std::mutex> lock(target.lock);
+                if (target.cfg != nullptr)
+                    target.cfg->replace(std::make_shared<JSON const>(std::move(doc)), hash);
+            } catch (...) { }
+        }
+
+        /**
+         * \brief replaces the whole document by *next* if it differs from the current document
+         * 
+         * \param [in] next new document
+         * \param [in] hash content hash of the file *next* was read from
+         */
+        void replace(std::shared_ptr<JSON const> next, uint64_t const hash) {
+            {
+                QMutexLocker lock(&m_wrlock);
+
+                m_hash = hash;
+                if (m_isOk && m_lazy == nullptr && *next == *std::atomic_load_explicit(&m_dict, std::memory_order_relaxed))
+                    return;
 
-                /* Reset value by replacing it with an empty JSON document. */
-                m_dict = JSON::parse("{}", nullptr, false, true);
+                publish(std::move(next));
+                m_lazy.reset();
+                m_partial = false;
+                publishDeferred();
+                m_savedgen = m_gen.fetch_add(1, std::memory_order_release) + 1;
                 m_isOk = true;
+            }
+
+            m_notify->post({ std::string{} });
+        }
+
+        /**
+         * \brief publishes *next* as the current generation of the document
+         * 
+         * \param [in] next new generation
+         * 
+         * \note  Must be called with the writer lock held, or during construction.
+         */
+        void publish(std::shared_ptr<JSON const> next) const noexcept {
+            std::atomic_store_explicit(&m_dict, std::move(next), std::memory_order_release);
+        }
+
+        /**
+         * \brief  acquires the current generation of the document as it is
+         *
+         * \return snapshot of the current generation; invalid if the config state is not normal
+         */
+        ConfigSnapshot current() const noexcept {
+            if (!m_isOk)
+                return ConfigSnapshot{};
+
+            return ConfigSnapshot{ std::atomic_load_explicit(&m_dict, std::memory_order_acquire) };
+        }
+
+        /**
+         * \brief  acquires the current generation, parsing the top-level value *key* lies below first
+         *
+         * \param  [in] key pre-compiled key about to be read
+         *
+         * \return snapshot of the current generation
+         */
+        ConfigSnapshot snapshotOf(ConfigKey const &key) const noexcept {
+            if (!m_partial.load(std::memory_order_acquire) || !key.isValid())
+                return current();
+            if (key.str().empty()) {
+                complete({}, true);
+
+                return current();
+            }
+
+            /* Values that were never deferred are read without taking the writer lock. */
+            std::shared_ptr<std::vector<std::string> const> const deferred = std::atomic_load_explicit(&m_deferred, std::memory_order_acquire);
+            if (deferred != nullptr && std::binary_search(deferred->begin(), deferred->end(), key.head()))
+                complete(key.head(), false);
+            return current();
+        }
+
+        /**
+         * \brief parses deferred top-level values and publishes them; see *LazyLoad*
+         *
+         * \param [in] head top-level key to parse
+         * \param [in] all whether to parse all deferred values instead
+         */
+        void complete(std::string_view const head, bool const all) const noexcept {
+            QMutexLocker lock(&m_wrlock);
+
+            completeLocked(head, all);
+        }
+        /**
+         * \brief same as *complete()*, but *m_wrlock* must be held
+         *
+         * Parsing does not modify the configuration, so the generation counter is left unchanged.
+         */
+        void completeLocked(std::string_view const head, bool const all) const noexcept {
+            if (m_lazy == nullptr)
+                return;
+
+            try {
+                auto it = m_lazy->pending.end();
+                if (!all && (it = m_lazy->pending.find(std::string(head))) == m_lazy->pending.end())
+                    return;
+
+                auto next = std::make_shared<JSON>(*std::atomic_load_explicit(&m_dict, std::memory_order_relaxed));
+                if (all) {
+                    for (auto const &[key, span] : m_lazy->pending)
+                        if (JSON val = m_lazy->parse(span); !val.is_discarded())
+                            (*next)[key] = std::move(val);
+
+                    m_lazy->pending.clear();
+                } else {
+                    if (JSON val = m_lazy->parse(it->second); !val.is_discarded())
+                        (*next)[it->first] = std::move(val);
+
+                    m_lazy->pending.erase(it);
+                }
+
+                /* Readers that see no deferred values left must see the values parsed last. */
+                publish(std::move(next));
+                if (m_lazy->pending.empty()) {
+                    m_lazy.reset();
+                    m_partial.store(false, std::memory_order_release);
+                }
+                publishDeferred();
             } catch (...) { }
         }
+
+        /**
+         * \brief publishes the keys of the values in *m_lazy*, so that reading any other value does
+         *        not take the writer lock; see *snapshotOf()*
+         *
+         * If memory runs out, the previous keys stay published; they include all deferred values.
+         *
+         * \throw std::bad_alloc
+         * \note  Must be called with the writer lock held, or during construction.
+         */
+        void publishDeferred() const {
+            std::shared_ptr<std::vector<std::string>> keys;
+            if (m_lazy != nullptr && !m_lazy->pending.empty()) {
+                keys = std::make_shared<std::vector<std::string>>();
+                keys->reserve(m_lazy->pending.size());
+                for (auto const &[key, span] : m_lazy->pending)
+                    keys->push_back(key);
+
+                std::sort(keys->begin(), keys->end());
+            }
+
+            std::atomic_store_explicit(&m_deferred, std::shared_ptr<std::vector<std::string> const>(std::move(keys)), std::memory_order_release);
+        }
     };
 
 
     /**
-     * \class suzu::sdk::JSONValueConverter
-     * \brief converts raw values to concrete, mostly primitive types
+     * \class suzu::sdk::ConfigView
+     * \brief section of a configuration, addressed with paths relative to its prefix
+     *
+     * Views are handed out by *suzu::sdk::Configuration::view()*, e.g. to give each plug-in its own
+     * section. A view holds no document of its own: reads and writes go to the generations, writer
+     * lock and observers of the configuration, and the file is flushed once for all sections.
+     *
+     *     ConfigView const settings = cfg.view("/plugins/xmi");
+     *     ConfigKey const  indent   = settings.key("/indent");
+     *     int const        width    = settings.get(indent, 4);
+     *
+     * \note  Paths passed to a view must be empty or begin with '/'. Like the configuration, views
+     *        are thread-safe.
      */
-    struct JSONValueConverter {
+    class ConfigView {
+        Configuration *m_cfg;    /**< configuration the section belongs to */
+        std::string    m_prefix; /**< JSON pointer of the section */
+
+    public:
         /**
-         * \brief  converts a given JSON value to the desired type
-         * 
-         * \param  [in] val raw JSON value to convert
-         * \param  [in] fallback fallback value in case of errors
-         * 
-         * \return 
+         * \brief constructs a view of the section at *prefix*
+         *
+         * \param [in] cfg configuration; must outlive the view
+         * \param [in] prefix JSON pointer of the section
          */
-        template<class TargetVal> static TargetVal to(JSON const &val, TargetVal fallback) noexcept {
-            /*
-             * Generic conversion function. The purpose of this return statement is to cause
-             * a compilation error. This is a bit ugly, but it does work.
-             */
-            return TargetVal::not_implemented_handler;
+        ConfigView(Configuration &cfg, std::string prefix) noexcept
+            : m_cfg(&cfg), m_prefix(std::move(prefix))
+        { }
+
+        Configuration &configuration() const noexcept { return *m_cfg; }
+        std::string const &prefix() const noexcept { return m_prefix; }
+
+        /**
+         * \brief  compiles a key relative to the section
+         *
+         * \param  [in] path relative JSON pointer
+         *
+         * \return key of the absolute path; usable with the configuration, too
+         */
+        ConfigKey key(char const *const path) const noexcept {
+            try {
+                return ConfigKey{ absolute(path).c_str() };
+            } catch (...) { }
+
+            return ConfigKey{ nullptr };
+        }
+
+        /**
+         * \brief  converts a relative path into a path of the configuration
+         *
+         * \param  [in] path relative JSON pointer
+         *
+         * \return absolute JSON pointer
+         * \throw  std::bad_alloc
+         */
+        std::string absolute(char const *const path) const {
+            return path == nullptr ? m_prefix : m_prefix + path;
         }
 
-        template<> static int32_t      to(JSON const &val, int32_t fallback)     noexcept { if (!val.is_number_integer()) return fallback; return val.get<int32_t>(); }
-        template<> static int64_t      to(JSON const &val, int64_t fallback)     noexcept { if (!val.is_number_integer()) return fallback; return val.get<int64_t>(); }
-        template<> static float        to(JSON const &val, float fallback)       noexcept { if (!val.is_number_float()) return fallback; return val.get<float>(); }
-        template<> static double       to(JSON const &val, double fallback)      noexcept { if (!val.is_number_float()) return fallback; return val.get<double>(); }
-        template<> static std::string  to(JSON const &val, std::string fallback) noexcept { if (!val.is_string()) return fallback; return val.get<std::string>(); }
+        /**
+         * \brief  retrieves the value referred to by *key*; see *suzu::sdk::Configuration::get()*
+         *
+         * \param  [in] key key compiled by *key()*
+         * \param  [in] fallback value returned if the key does not exist or has the wrong type
+         *
+         * \return converted value
+         */
+        template<class TargetVal> TargetVal get(ConfigKey const &key, TargetVal fallback) const noexcept {
+            return m_cfg->get(key, std::move(fallback));
+        }
+        /**
+         * \brief  retrieves the value at the relative *path*
+         *
+         * \param  [in] path relative JSON pointer
+         * \param  [in] fallback value returned if the value does not exist or has the wrong type
+         *
+         * \return converted value
+         * \note   Values that are read frequently should be read through a key compiled by *key()*.
+         */
+        template<class TargetVal> TargetVal get(char const *const path, TargetVal fallback) const noexcept {
+            return m_cfg->get(key(path), std::move(fallback));
+        }
 
+        /**
+         * \brief  retrieves a copy of the value at the relative *path*
+         *
+         * \param  [in] path relative JSON pointer
+         *
+         * \return see *suzu::sdk::Configuration::lookup()*
+         */
+        Result<JSON> lookup(char const *const path) const noexcept {
+            return m_cfg->lookup(key(path));
+        }
 
         /**
-         * \brief converts mostly primitive values to a JSON value which can be fed into
-         *        the suzu::sdk::Configuration's methods
+         * \brief  checks whether a value exists at the relative *path*
+         *
+         * \param  [in] path relative JSON pointer
+         *
+         * \return *true* if the value exists
          */
-        template<class SourceVal> static JSON from(SourceVal val) noexcept {
-            /*
-             * Generic conversion function. The purpose of this return statement is to cause
-             * a compilation error. This is a bit ugly, but it does work.
-             */
-            return SourceVal::not_implemented_handler;
+        bool contains(char const *const path) const noexcept {
+            return m_cfg->contains(key(path));
+        }
+
+        /**
+         * \brief updates or inserts *val* at the relative *path*
+         *
+         * \param [in] path relative JSON pointer
+         * \param [in] val raw JSON value
+         */
+        void setValue(char const *const path, JSON const &val) noexcept {
+            try {
+                m_cfg->setValue(absolute(path).c_str(), val);
+            } catch (...) { }
+        }
+
+        /**
+         * \brief  applies all given values at once; see *suzu::sdk::Configuration::apply()*
+         *
+         * \param  [in] vals list of (relative path, value) pairs
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success
+         */
+        ErrorCode apply(std::initializer_list<std::pair<char const *, JSON>> vals) noexcept {
+            try {
+                Configuration::Transaction tx = m_cfg->transaction();
+
+                for (auto const &[path, val] : vals)
+                    if (ErrorCode const err = tx.setValue(absolute(path).c_str(), JSON(val)); err != ErrorCode::Ok)
+                        return err;
+
+                return tx.commit();
+            } catch (...) { }
+
+            return ErrorCode::Unknown;
         }
 
-        template<> static JSON from(int32_t val)     noexcept { return JSON(val); }
-        template<> static JSON from(int64_t val)     noexcept { return JSON(val); }
-        template<> static JSON from(float val)       noexcept { return JSON(val); }
-        template<> static JSON from(double val)      noexcept { return JSON(val); }
-        template<> static JSON from(char const *val) noexcept { return JSON(val); }
-        template<> static JSON from(std::string val) noexcept { return JSON(val); }
+        /**
+         * \brief  registers an observer for all values at or below the relative *prefix*
+         *
+         * \param  [in] prefix relative JSON pointer prefix; "" for the whole section
+         * \param  [in] fn callback; receives the written paths relative to the section
+         *
+         * \return subscription id for *suzu::sdk::Configuration::unsubscribe()*, or 0 on error
+         * \note   Resetting the configuration is reported as a write to the section itself ("").
+         */
+        ConfigObserverId subscribe(char const *const prefix, ConfigObserver fn) noexcept {
+            try {
+                return m_cfg->subscribe(absolute(prefix).c_str(), [fn = std::move(fn), len = m_prefix.length()](std::vector<std::string> const &paths) {
+                    std::vector<std::string> rel;
+                    rel.reserve(paths.size());
+                    for (std::string const &path : paths)
+                        rel.push_back(path.length() > len ? path.substr(len) : std::string{});
+
+                    fn(rel);
+                });
+            } catch (...) { }
+
+            return 0;
+        }
     };
-    using JSONCVT = JSONValueConverter;
+
+
+    inline ConfigView Configuration::view(char const *const prefix) {
+        return ConfigView{ *this, prefix == nullptr ? std::string{} : std::string{ prefix } };
+    }
 }
 
 
@@ -0,0 +1,554 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  crdt.hpp
+ * \brief replicated diagram state and the compact binary encoding of its operations
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/intern.hpp>
+
+
+/**
+ * \namespace suzu::sdk::crdt
+ * \brief     conflict-free replication of a diagram between concurrent editors
+ *
+ * Every replica of a diagram is identified by a *site*. Elements carry an id made of the site that
+ * created them and a per-site counter, so ids never clash and are never reused. Every property of an
+ * element is a last-writer-wins register: an operation carries a Lamport stamp, and a property only
+ * takes the value of an operation whose stamp is greater than that of its current value. Removals
+ * are permanent. Replicas that have applied the same operations thus hold the same diagram, no
+ * matter in which order the operations arrived.
+ */
+namespace suzu::sdk::crdt {
+    /**
+     * \enum  suzu::sdk::crdt::Field
+     * \brief replicated properties of an element
+     */
+    enum Field : uint8_t {
+        FieldBounds = 0, /**< bounding box */
+        FieldStyle,      /**< style id */
+        FieldFlags,      /**< *suzu::sdk::ElementFlags*, without *ElementSelected* */
+        FieldName,       /**< name */
+        FieldParent,     /**< owner */
+
+        __NumFields__ /**< (only used internally) */
+    };
+
+    /**
+     * \enum  suzu::sdk::crdt::OpType
+     * \brief kinds of operations
+     */
+    enum OpType : uint8_t {
+        OpCreate = 0, /**< creates an element with all of its properties */
+        OpRemove,     /**< removes an element for good */
+        OpSet,        /**< sets a single property of an element */
+
+        __NumOpTypes__ /**< (only used internally) */
+    };
+
+    /**
+     * \struct suzu::sdk::crdt::ElementId
+     * \brief  identity of an element across all replicas
+     */
+    struct ElementId {
+        uint32_t site;    /**< site that created the element; 0 for none */
+        uint32_t counter; /**< number of elements the site created before */
+
+        uint64_t key() const noexcept { return static_cast<uint64_t>(site) << 32 | counter; }
+
+        bool operator ==(ElementId const &other) const noexcept { return site == other.site && counter == other.counter; }
+        bool operator !=(ElementId const &other) const noexcept { return !(*this == other); }
+    };
+    constexpr ElementId gl_noelement = { 0, 0 }; /**< id of no element, e.g. the owner of top-level elements */
+
+    /**
+     * \struct suzu::sdk::crdt::Stamp
+     * \brief  Lamport timestamp ordering concurrent operations
+     */
+    struct Stamp {
+        uint64_t clock; /**< logical time */
+        uint32_t site;  /**< site that issued the operation; breaks ties */
+
+        bool operator <(Stamp const &other) const noexcept { return clock < other.clock || (clock == other.clock && site < other.site); }
+    };
+
+    /**
+     * \struct suzu::sdk::crdt::Operation
+     * \brief  single replicated edit
+     *
+     * *OpCreate* carries all values, *OpSet* only that of *field*, *OpRemove* none.
+     */
+    struct Operation {
+        OpType      type;   /**< kind of operation */
+        Field       field;  /**< property set by *OpSet* */
+        ElementId   id;     /**< affected element */
+        Stamp       stamp;  /**< time of the operation */
+        ElementKind kind;   /**< kind of the element */
+        ElementRect bounds; /**< bounding box */
+        uint32_t    style;  /**< style id */
+        uint32_t    flags;  /**< *suzu::sdk::ElementFlags* */
+        StringId    name;   /**< name */
+        ElementId   parent; /**< owner; *gl_noelement* for none */
+    };
+
+
+    /**
+     * \class suzu::sdk::crdt::Replica
+     * \brief replicated state of a diagram, as seen by one site
+     *
+     * The replica holds the values and stamps of every element ever created, and a tombstone for
+     * removed ones. Local edits are turned into operations with *next()* and *tick()* and applied
+     * like remote ones, so both take the same path.
+     */
+    class Replica {
+    public:
+        /**
+         * \struct suzu::sdk::crdt::Replica::Element
+         * \brief  replicated state of a single element
+         */
+        struct Element {
+            ElementKind kind;                  /**< kind */
+            ElementRect bounds;                /**< bounding box */
+            uint32_t    style;                 /**< style id */
+            uint32_t    flags;                 /**< *suzu::sdk::ElementFlags* */
+            StringId    name;                  /**< name */
+            ElementId   parent;                /**< owner */
+            Stamp       created;               /**< stamp of the *OpCreate* operation */
+            Stamp       stamps[__NumFields__]; /**< stamp of the value of every property */
+            bool        removed;               /**< whether or not the element was removed */
+        };
+
+    private:
+        uint32_t                               m_site;     /**< site of the replica; 0 until assigned */
+        uint64_t                               m_clock;    /**< greatest logical time seen */
+        uint32_t                               m_counter;  /**< number of elements created by this site */
+        std::unordered_map<uint64_t, Element>  m_elements; /**< all elements, by *ElementId::key()* */
+
+    public:
+        Replica() noexcept
+            : m_site(0), m_clock(0), m_counter(0)
+        { }
+
+        /**
+         * \brief discards all state and starts over as a site
+         *
+         * \param [in] site site of the replica; must be unique among all replicas
+         */
+        void reset(uint32_t const site) noexcept {
+            m_site    = site;
+            m_clock   = 0;
+            m_counter = 0;
+            m_elements.clear();
+        }
+
+        uint32_t site() const noexcept { return m_site; }
+        size_t size() const noexcept { return m_elements.size(); }
+
+        /**
+         * \brief  allocates the id of a new element created by this site
+         *
+         * \return id
+         */
+        ElementId next() noexcept { return { m_site, m_counter++ }; }
+
+        /**
+         * \brief  advances the clock for a local operation
+         *
+         * \return stamp of the operation
+         */
+        Stamp tick() noexcept { return { ++m_clock, m_site }; }
+
+        /**
+         * \brief  looks up an element
+         *
+         * \param  [in] id id of the element
+         *
+         * \return element, or *nullptr* if it was never created; valid until the next *apply()*
+         */
+        Element const *find(ElementId const id) const noexcept {
+            auto const it = m_elements.find(id.key());
+
+            return it != m_elements.end() ? &it->second : nullptr;
+        }
+
+        /**
+         * \brief  applies an operation
+         *
+         * Operations on unknown or removed elements, duplicate creations, and values older than the
+         * current ones are ignored.
+         *
+         * \param  [in] op operation
+         *
+         * \return *true* if the operation changed the state
+         * \throw  std::bad_alloc
+         */
+        bool apply(Operation const &op) {
+            m_clock = std::max(m_clock, op.stamp.clock);
+
+            auto it = m_elements.find(op.id.key());
+            if (op.type == OpCreate) {
+                if (it != m_elements.end())
+                    return false;
+
+                Element elem = { op.kind, op.bounds, op.style, op.flags & ~static_cast<uint32_t>(ElementSelected), op.name, op.parent, op.stamp, {}, false };
+                for (Stamp &stamp : elem.stamps)
+                    stamp = op.stamp;
+                m_elements.emplace(op.id.key(), elem);
+
+                return true;
+            }
+            if (it == m_elements.end() || it->second.removed)
+                return false;
+
+            Element &elem = it->second;
+            if (op.type == OpRemove) {
+                elem.removed = true;
+
+                return true;
+            }
+            if (op.type != OpSet || op.field >= __NumFields__ || !(elem.stamps[op.field] < op.stamp))
+                return false;
+
+            elem.stamps[op.field] = op.stamp;
+            switch (op.field) {
+                case FieldBounds: elem.bounds = op.bounds; break;
+                case FieldStyle:  elem.style  = op.style; break;
+                case FieldFlags:  elem.flags  = op.flags & ~static_cast<uint32_t>(ElementSelected); break;
+                case FieldName:   elem.name   = op.name; break;
+                case FieldParent: elem.parent = op.parent; break;
+                default:          break;
+            }
+            return true;
+        }
+
+        /**
+         * \brief  produces the operations that rebuild the state on another replica, e.g. one that joins
+         *
+         * Every live element yields its *OpCreate* operation, carrying its current values, and an
+         * *OpSet* operation with the original stamp for every property changed since, so that the
+         * other replica converges with later operations exactly like this one. Owners are produced
+         * before the elements they own, unless ownership is cyclic.
+         *
+         * \param  [in] fn called with every operation
+         *
+         * \throw  std::bad_alloc, or whatever *fn* throws
+         */
+        template<class Fn> void replay(Fn &&fn) const {
+            std::unordered_set<uint64_t> done;
+            std::vector<uint64_t>        chain;
+
+            for (auto const &entry : m_elements) {
+                /* Walk up to the first owner already produced; the chain is then produced top-down. */
+                chain.clear();
+                for (auto it = m_elements.find(entry.first); it != m_elements.end() && !it->second.removed && done.insert(it->first).second;) {
+                    chain.push_back(it->first);
+                    it = it->second.parent != gl_noelement ? m_elements.find(it->second.parent.key()) : m_elements.end();
+                }
+
+                for (auto key = chain.rbegin(); key != chain.rend(); ++key) {
+                    Element const  &elem = m_elements.find(*key)->second;
+                    ElementId const id   = { static_cast<uint32_t>(*key >> 32), static_cast<uint32_t>(*key) };
+
+                    Operation op = { OpCreate, FieldBounds, id, elem.created, elem.kind, elem.bounds, elem.style, elem.flags, elem.name, elem.parent };
+                    fn(static_cast<Operation const &>(op));
+
+                    op.type = OpSet;
+                    for (uint8_t f = 0; f < __NumFields__; ++f)
+                        if (elem.created < elem.stamps[f]) {
+                            op.field = static_cast<Field>(f);
+                            op.stamp = elem.stamps[f];
+                            fn(static_cast<Operation const &>(op));
+                        }
+                }
+            }
+        }
+    };
+
+
+    namespace internal {
+        /**
+         * \brief appends an unsigned LEB128 varint
+         *
+         * \param [in,out] out buffer
+         * \param [in] value value
+         * \throw std::bad_alloc
+         */
+        inline void PutVarint(std::vector<uint8_t> &out, uint64_t value) {
+            for (; value >= 0x80; value >>= 7)
+                out.push_back(static_cast<uint8_t>(value | 0x80));
+            out.push_back(static_cast<uint8_t>(value));
+        }
+
+        /**
+         * \brief  reads an unsigned LEB128 varint
+         *
+         * \param  [in,out] pos current position; advanced past the varint
+         * \param  [in] end end of the buffer
+         * \param  [out] value receives the value
+         *
+         * \return *true* if a complete varint of at most 64 bits was read
+         */
+        inline bool GetVarint(uint8_t const *&pos, uint8_t const *const end, uint64_t &value) noexcept {
+            value = 0;
+            for (unsigned shift = 0; pos != end && shift < 64; shift += 7) {
+                uint8_t const byte = *pos++;
+
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                    return true;
+            }
+
+            return false;
+        }
+    }
+
+
+    /**
+     * \class suzu::sdk::crdt::Encoder
+     * \brief encodes the operations sent over one connection
+     *
+     * Every operation starts with a byte holding its type and field, followed by varints: the id
+     * of the element, the clock of its stamp as the difference to the previous operation of the
+     * frame, and the site of the stamp. Values follow as varints, bounds as four little-endian
+     * floats. Strings are sent once per connection and referred to by a varint from then on, so
+     * renaming many elements after a common name costs a few bytes each. A frame of operations
+     * is typically a few bytes per edit.
+     *
+     * Encoders and decoders are paired: every connection direction needs one of each, fed the same
+     * frames in the same order.
+     */
+    class Encoder {
+        std::unordered_map<uint32_t, uint64_t> m_strings; /**< reference of every string sent, by *suzu::sdk::StringId::value()* */
+        std::vector<uint8_t>                   m_frame;   /**< operations of the current frame */
+        uint64_t                               m_clock;   /**< clock of the previous operation of the frame */
+
+    public:
+        Encoder() noexcept
+            : m_clock(0)
+        { }
+
+        bool empty() const noexcept { return m_frame.empty(); }
+
+        /**
+         * \brief appends an operation to the current frame
+         *
+         * \param [in] op operation
+         * \throw std::bad_alloc
+         */
+        void put(Operation const &op) {
+            m_frame.push_back(static_cast<uint8_t>(op.type | op.field << 2));
+            putId(op.id);
+            internal::PutVarint(m_frame, op.stamp.clock >= m_clock ? (op.stamp.clock - m_clock) << 1 : (m_clock - op.stamp.clock) << 1 | 1);
+            internal::PutVarint(m_frame, op.stamp.site);
+            m_clock = op.stamp.clock;
+
+            if (op.type == OpCreate) {
+                internal::PutVarint(m_frame, static_cast<uint32_t>(op.kind));
+                putBounds(op.bounds);
+                internal::PutVarint(m_frame, op.style);
+                internal::PutVarint(m_frame, op.flags);
+                putString(op.name);
+                putId(op.parent);
+            } else if (op.type == OpSet)
+                switch (op.field) {
+                    case FieldBounds: putBounds(op.bounds); break;
+                    case FieldStyle:  internal::PutVarint(m_frame, op.style); break;
+                    case FieldFlags:  internal::PutVarint(m_frame, op.flags); break;
+                    case FieldName:   putString(op.name); break;
+                    case FieldParent: putId(op.parent); break;
+                    default:          break;
+                }
+        }
+
+        /**
+         * \brief  ends the current frame
+         *
+         * \param  [out] frame receives the encoded operations; replaced
+         */
+        void take(std::vector<uint8_t> &frame) noexcept {
+            frame.clear();
+            frame.swap(m_frame);
+
+            m_clock = 0;
+        }
+
+    private:
+        void putId(ElementId const id) {
+            internal::PutVarint(m_frame, id.site);
+            internal::PutVarint(m_frame, id.counter);
+        }
+
+        void putBounds(ElementRect const &bounds) {
+            static_assert(sizeof(ElementRect) == 16, "bounds are sent as four floats");
+
+            uint8_t bytes[sizeof(ElementRect)];
+            std::memcpy(bytes, &bounds, sizeof(bytes));
+            m_frame.insert(m_frame.end(), bytes, bytes + sizeof(bytes));
+        }
+
+        /**
+         * \brief sends a string, or its reference if it was sent before
+         *
+         * References are 0 for the empty string, 1 for a new string, which is followed by its length
+         * and characters, and 2 plus the number of strings sent before it otherwise.
+         */
+        void putString(StringId const str) {
+            if (str.empty()) {
+                internal::PutVarint(m_frame, 0);
+
+                return;
+            }
+
+            auto const [it, inserted] = m_strings.try_emplace(str.value(), m_strings.size() + 2);
+            if (!inserted) {
+                internal::PutVarint(m_frame, it->second);
+
+                return;
+            }
+
+            std::string_view const view = str.view();
+            internal::PutVarint(m_frame, 1);
+            internal::PutVarint(m_frame, view.size());
+            m_frame.insert(m_frame.end(), view.begin(), view.end());
+        }
+    };
+
+
+    /**
+     * \class suzu::sdk::crdt::Decoder
+     * \brief decodes the operations received over one connection; see *Encoder*
+     */
+    class Decoder {
+        static constexpr uint64_t gl_maxstring = 1 << 20; /**< longest string accepted, in bytes */
+
+        std::vector<StringId> m_strings; /**< strings received, by reference minus 2 */
+
+    public:
+        /**
+         * \brief  decodes a frame
+         *
+         * \param  [in] data encoded frame
+         * \param  [in] size size of *data*, in bytes
+         * \param  [in] fn called with every operation, in order
+         *
+         * \return *true* if the frame was well-formed; operations up to the malformed one have been
+         *         passed to *fn*, and the connection should be closed otherwise
+         * \throw  std::bad_alloc, or whatever *fn* throws
+         */
+        template<class Fn> bool decode(uint8_t const *const data, size_t const size, Fn &&fn) {
+            uint8_t const *pos   = data;
+            uint8_t const *end   = data + size;
+            uint64_t       clock = 0;
+
+            while (pos != end) {
+                uint8_t const head = *pos++;
+
+                Operation op  = {};
+                uint64_t  val = 0;
+                op.type  = static_cast<OpType>(head & 3);
+                op.field = static_cast<Field>(head >> 2);
+                if (op.type >= __NumOpTypes__ || op.field >= __NumFields__ || !getId(pos, end, op.id))
+                    return false;
+                if (!internal::GetVarint(pos, end, val))
+                    return false;
+                clock = val & 1 ? clock - (val >> 1) : clock + (val >> 1);
+                if (!internal::GetVarint(pos, end, val) || val > UINT32_MAX)
+                    return false;
+                op.stamp = { clock, static_cast<uint32_t>(val) };
+
+                bool ok = true;
+                if (op.type == OpCreate) {
+                    ok = internal::GetVarint(pos, end, val) && val < static_cast<uint64_t>(ElementKind::__NumElementKinds__);
+                    op.kind = static_cast<ElementKind>(val);
+                    ok = ok && getBounds(pos, end, op.bounds) && getValue(pos, end, op.style) && getValue(pos, end, op.flags);
+                    ok = ok && getString(pos, end, op.name) && getId(pos, end, op.parent);
+                } else if (op.type == OpSet)
+                    switch (op.field) {
+                        case FieldBounds: ok = getBounds(pos, end, op.bounds); break;
+                        case FieldStyle:  ok = getValue(pos, end, op.style); break;
+                        case FieldFlags:  ok = getValue(pos, end, op.flags); break;
+                        case FieldName:   ok = getString(pos, end, op.name); break;
+                        case FieldParent: ok = getId(pos, end, op.parent); break;
+                        default:          ok = false; break;
+                    }
+                if (!ok)
+                    return false;
+
+                fn(static_cast<Operation const &>(op));
+            }
+
+            return true;
+        }
+
+    private:
+        static bool getValue(uint8_t const *&pos, uint8_t const *const end, uint32_t &value) noexcept {
+            uint64_t val;
+            if (!internal::GetVarint(pos, end, val) || val > UINT32_MAX)
+                return false;
+
+            value = static_cast<uint32_t>(val);
+            return true;
+        }
+
+        static bool getId(uint8_t const *&pos, uint8_t const *const end, ElementId &id) noexcept {
+            return getValue(pos, end, id.site) && getValue(pos, end, id.counter);
+        }
+
+        static bool getBounds(uint8_t const *&pos, uint8_t const *const end, ElementRect &bounds) noexcept {
+            if (static_cast<size_t>(end - pos) < sizeof(ElementRect))
+                return false;
+
+            std::memcpy(&bounds, pos, sizeof(ElementRect));
+            pos += sizeof(ElementRect);
+            return true;
+        }
+
+        bool getString(uint8_t const *&pos, uint8_t const *const end, StringId &str) {
+            uint64_t ref;
+            if (!internal::GetVarint(pos, end, ref))
+                return false;
+
+            if (ref == 0)
+                str = {};
+            else if (ref >= 2) {
+                if (ref - 2 >= m_strings.size())
+                    return false;
+
+                str = m_strings[static_cast<size_t>(ref - 2)];
+            } else {
+                uint64_t len;
+                if (!internal::GetVarint(pos, end, len) || len > gl_maxstring || len > static_cast<uint64_t>(end - pos))
+                    return false;
+
+                str = StringId(std::string_view(reinterpret_cast<char const *>(pos), static_cast<size_t>(len)));
+                pos += len;
+                m_strings.push_back(str);
+            }
+
+            return true;
+        }
+    };
+}
+
+
@@ -0,0 +1,881 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  depgraph.hpp
+ * \brief dependency graph of the elements of a diagram, with incrementally maintained cycles
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/changes.hpp>
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \enum  suzu::sdk::DependencyKind
+     * \brief kind of the relationship an edge of a *suzu::sdk::DependencyGraph* stems from
+     */
+    enum class DependencyKind : uint32_t {
+        Association,    /**< the source refers to the target */
+        Generalization, /**< the source specializes or realizes the target */
+        Usage,          /**< the source uses the target, e.g. as parameter type */
+
+        __NumDependencyKinds__ /**< (only used internally) */
+    };
+
+
+    /**
+     * \class suzu::sdk::DependencyGraph
+     * \brief which elements depend on which, directly or transitively
+     *
+     * Every edge states that its source depends on its target; edges are identified by the handle
+     * of the association, generalization or usage element they stem from. Elements without edges
+     * are not part of the graph.
+     *
+     * The graph is kept *condensed*: elements that depend on each other in a cycle form a strongly
+     * connected component, and the components form an acyclic graph whose edges count the
+     * element edges between them. Both are updated with every change instead of being recomputed:
+     *  - an edge between components that closes no cycle only increments a count;
+     *  - an edge closing a cycle merges the components on it, i.e. those reachable from its
+     *    target that also reach its source;
+     *  - removing an edge within a component recomputes the components of its elements only
+     *    (Tarjan's algorithm); removing any other edge only decrements a count.
+     *
+     * The components are kept *ranked* in topological order, i.e. every component is ranked before
+     * those it depends on. An edge that agrees with the ranks cannot close a cycle and is added at
+     * once; otherwise only the components ranked between its ends are searched and reordered. New
+     * elements are ranked at either end, so building a graph edge by edge rarely reorders any.
+     *
+     * Transitive queries (*dependents()*, *dependencies()*) walk the acyclic graph of
+     * components, so their cost grows with the size of the answer, not of the diagram, and
+     * cycles of any length are visited once.
+     *
+     * \note  Edges are added explicitly (*connect()*), since changes do not carry the end points of
+     *        associations; *apply()* drops edges and elements removed from the diagram.
+     */
+    class DependencyGraph {
+        static constexpr uint32_t gl_none = UINT32_MAX;       /**< marks unset indices */
+        static constexpr int64_t  gl_gap  = int64_t(1) << 16; /**< distance between the ranks of new components, leaving room for splitting */
+
+        /**
+         * \struct suzu::sdk::DependencyGraph::Node
+         * \brief  element with at least one edge
+         */
+        struct Node {
+            ElementHandle         element; /**< element */
+            uint32_t              comp;    /**< component */
+            std::vector<uint32_t> out;     /**< edges to the elements this one depends on */
+            std::vector<uint32_t> in;      /**< edges from the elements depending on this one */
+        };
+
+        /**
+         * \struct suzu::sdk::DependencyGraph::Edge
+         * \brief  direct dependency
+         */
+        struct Edge {
+            ElementHandle  handle; /**< element the edge stems from; null while the slot is free */
+            uint32_t       source; /**< depending node */
+            uint32_t       target; /**< node depended on */
+            DependencyKind kind;   /**< kind of the relationship */
+        };
+
+        /**
+         * \struct suzu::sdk::DependencyGraph::Rank
+         * \brief  position of a component in topological order
+         */
+        struct Rank {
+            int64_t  order;  /**< position; components split off are placed in between others */
+            uint64_t serial; /**< distinguishes unrelated components placed at the same position */
+
+            bool operator <(Rank const &other) const noexcept  { return order < other.order || (order == other.order && serial < other.serial); }
+            bool operator ==(Rank const &other) const noexcept { return order == other.order && serial == other.serial; }
+        };
+
+        /**
+         * \struct suzu::sdk::DependencyGraph::Component
+         * \brief  strongly connected component
+         */
+        struct Component {
+            std::vector<uint32_t>                  nodes; /**< members; empty while the slot is free */
+            std::unordered_map<uint32_t, uint32_t> out;   /**< number of edges to every other component */
+            std::unordered_map<uint32_t, uint32_t> in;    /**< number of edges from every other component */
+            Rank                                   rank;  /**< position in topological order; less than that of every component depended on */
+            uint64_t                               visit; /**< stamp of the last search that reached the component */
+        };
+
+        std::vector<Node>                           m_nodes;     /**< nodes; slots listed in *m_freenodes* are unused */
+        std::vector<Edge>                           m_edges;     /**< edges; slots listed in *m_freeedges* are unused */
+        std::vector<Component>                      m_comps;     /**< components; slots listed in *m_freecomps* are unused */
+        std::vector<uint32_t>                       m_freenodes; /**< unused node slots */
+        std::vector<uint32_t>                       m_freeedges; /**< unused edge slots */
+        std::vector<uint32_t>                       m_freecomps; /**< unused component slots */
+        std::unordered_map<ElementHandle, uint32_t> m_nodeids;   /**< node of every element in the graph */
+        std::unordered_map<ElementHandle, uint32_t> m_edgeids;   /**< edge of every relationship element */
+        int64_t                                     m_first;     /**< lowest rank given to a new component */
+        int64_t                                     m_last;      /**< highest rank given to a new component */
+        uint64_t                                    m_visit;     /**< stamp of the last search */
+        uint64_t                                    m_serial;    /**< serial of the last rank created */
+
+    public:
+        /**
+         * \brief constructs a new, empty graph
+         */
+        DependencyGraph() noexcept
+            : m_first(0), m_last(0), m_visit(0), m_serial(0)
+        { }
+
+        /**
+         * \brief  adds an edge, or moves it if the relationship is connected already
+         *
+         * \param  [in] edge relationship element, e.g. an association
+         * \param  [in] source element that depends on *target*
+         * \param  [in] target element depended on
+         * \param  [in] kind kind of the relationship
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         a handle is null, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out;
+         *         the graph has to be cleared and rebuilt then
+         */
+        ErrorCode connect(ElementHandle const edge, ElementHandle const source, ElementHandle const target, DependencyKind const kind = DependencyKind::Association) noexcept {
+            if (edge.isNull() || source.isNull() || target.isNull())
+                return ErrorCode::InvalidParameter;
+
+            try {
+                auto const it = m_edgeids.find(edge);
+                if (it != m_edgeids.end()) {
+                    Edge const &prev = m_edges[it->second];
+                    if (m_nodes[prev.source].element == source && m_nodes[prev.target].element == target) {
+                        m_edges[it->second].kind = kind;
+
+                        return ErrorCode::Ok;
+                    }
+
+                    removeEdge(it->second);
+                }
+
+                uint32_t const u = nodeOf(source, true);
+                uint32_t const v = nodeOf(target, false);
+                uint32_t const e = slotOf(m_edges, m_freeedges);
+                m_edges[e] = { edge, u, v, kind };
+                m_edgeids[edge] = e;
+
+                m_nodes[u].out.push_back(e);
+                m_nodes[v].in.push_back(e);
+                link(m_nodes[u].comp, m_nodes[v].comp);
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  removes an edge
+         *
+         * \param  [in] edge relationship element
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the edge is not connected, or *suzu::sdk::ErrorCode::CriticalResource* if memory
+         *         ran out; the graph has to be cleared and rebuilt then
+         */
+        ErrorCode disconnect(ElementHandle const edge) noexcept {
+            auto const it = m_edgeids.find(edge);
+            if (it == m_edgeids.end())
+                return ErrorCode::InvalidParameter;
+
+            try {
+                removeEdge(it->second);
+
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  drops the edges and elements removed from the diagram
+         *
+         * Removing an element removes all of its edges. All other changes are ignored.
+         *
+         * \param  [in] records changes of an operation, in the order they were applied
+         * \param  [in] count number of changes
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if memory ran out; the graph has to be cleared and rebuilt then
+         */
+        ErrorCode apply(ChangeRecord const *const records, size_t const count) noexcept {
+            try {
+                for (size_t i = 0; i < count; ++i) {
+                    if (records[i].kind != ElementRemoved)
+                        continue;
+
+                    ElementHandle const handle = ElementHandle::FromValue(records[i].element);
+                    auto const          edge   = m_edgeids.find(handle);
+                    if (edge != m_edgeids.end())
+                        removeEdge(edge->second);
+
+                    /* Removing the last edge of a node removes the node, so it is looked up again every time. */
+                    for (auto node = m_nodeids.find(handle); node != m_nodeids.end(); node = m_nodeids.find(handle)) {
+                        Node const &curr = m_nodes[node->second];
+
+                        removeEdge(curr.out.empty() ? curr.in.back() : curr.out.back());
+                    }
+                }
+
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  collects all elements depending on any of the given ones, directly or
+         *         transitively, e.g. for the impact of changing a package and its contents
+         *
+         * \param  [in] targets elements depended on
+         * \param  [out] res receives the depending elements, in no particular order, without
+         *               *targets*; existing contents are dropped
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if memory ran out
+         */
+        ErrorCode dependents(std::vector<ElementHandle> const &targets, std::vector<ElementHandle> &res) const noexcept {
+            return reachable(targets, false, res);
+        }
+
+        /**
+         * \brief  collects all elements any of the given ones depend on, directly or transitively
+         *
+         * \param  [in] sources depending elements
+         * \param  [out] res receives the elements depended on, in no particular order, without
+         *               *sources*; existing contents are dropped
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if memory ran out
+         */
+        ErrorCode dependencies(std::vector<ElementHandle> const &sources, std::vector<ElementHandle> &res) const noexcept {
+            return reachable(sources, true, res);
+        }
+
+        /**
+         * \brief  checks whether an element depends on another one, directly or transitively
+         *
+         * \param  [in] source depending element
+         * \param  [in] target element depended on
+         *
+         * \return *true* if there is a path of edges from *source* to *target*, *false* otherwise or
+         *         if memory ran out
+         */
+        bool dependsOn(ElementHandle const source, ElementHandle const target) const noexcept {
+            auto const u = m_nodeids.find(source);
+            auto const v = m_nodeids.find(target);
+            if (u == m_nodeids.end() || v == m_nodeids.end())
+                return false;
+
+            uint32_t const cu = m_nodes[u->second].comp;
+            uint32_t const cv = m_nodes[v->second].comp;
+            if (cu == cv)
+                return source != target || m_comps[cu].nodes.size() > 1 || hasSelfLoop(u->second);
+
+            try {
+                return reaches(cu, cv);
+            } catch (...) { }
+
+            return false;
+        }
+
+        /**
+         * \brief  collects the elements an element depends on in a cycle, including itself
+         *
+         * \param  [in] element element
+         * \param  [out] res receives the members of its component; empty if the element is part of
+         *               no cycle; existing contents are dropped
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if memory ran out
+         */
+        ErrorCode cycleOf(ElementHandle const element, std::vector<ElementHandle> &res) const noexcept {
+            res.clear();
+
+            auto const it = m_nodeids.find(element);
+            if (it == m_nodeids.end())
+                return ErrorCode::Ok;
+
+            try {
+                Component const &comp = m_comps[m_nodes[it->second].comp];
+                if (comp.nodes.size() > 1 || hasSelfLoop(it->second))
+                    for (uint32_t const n : comp.nodes)
+                        res.push_back(m_nodes[n].element);
+
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief removes all edges
+         */
+        void clear() noexcept {
+            m_nodes.clear();
+            m_edges.clear();
+            m_comps.clear();
+            m_freenodes.clear();
+            m_freeedges.clear();
+            m_freecomps.clear();
+            m_nodeids.clear();
+            m_edgeids.clear();
+
+            m_first  = 0;
+            m_last   = 0;
+            m_serial = 0;
+        }
+
+        size_t nodes() const noexcept      { return m_nodeids.size(); }
+        size_t edges() const noexcept      { return m_edgeids.size(); }
+        size_t components() const noexcept { return m_comps.size() - m_freecomps.size(); }
+
+    private:
+        /**
+         * \brief  claims an unused slot of a table, or appends one
+         *
+         * \param  [in,out] table table
+         * \param  [in,out] free unused slots of the table
+         *
+         * \return index of the slot
+         * \throw  std::bad_alloc
+         */
+        template<class T> static uint32_t slotOf(std::vector<T> &table, std::vector<uint32_t> &free) {
+            if (!free.empty()) {
+                uint32_t const res = free.back();
+                free.pop_back();
+
+                return res;
+            }
+
+            table.emplace_back();
+            return static_cast<uint32_t>(table.size() - 1);
+        }
+
+        /**
+         * \brief  retrieves the node of an element, adding it as a component of its own if needed
+         *
+         * A new component has no edges yet, so it is ranked before all others if it is the source
+         * of the edge being added and after all others if it is the target; either way, the edge
+         * keeps the order.
+         *
+         * \param  [in] element element
+         * \param  [in] source whether or not the element is the source of the edge being added
+         *
+         * \return index of the node
+         * \throw  std::bad_alloc
+         */
+        uint32_t nodeOf(ElementHandle const element, bool const source) {
+            auto const it = m_nodeids.find(element);
+            if (it != m_nodeids.end())
+                return it->second;
+
+            uint32_t const n = slotOf(m_nodes, m_freenodes);
+            uint32_t const c = slotOf(m_comps, m_freecomps);
+            m_nodes[n] = { element, c, {}, {} };
+            m_comps[c] = { { n }, {}, {}, { source ? m_first -= gl_gap : m_last += gl_gap, ++m_serial }, 0 };
+
+            m_nodeids.emplace(element, n);
+            return n;
+        }
+
+        /**
+         * \brief  checks whether a node has an edge to itself
+         *
+         * \param  [in] n node
+         *
+         * \return *true* if it does
+         */
+        bool hasSelfLoop(uint32_t const n) const noexcept {
+            return std::any_of(m_nodes[n].out.begin(), m_nodes[n].out.end(), [&](uint32_t const e) { return m_edges[e].target == n; });
+        }
+
+        /**
+         * \brief  checks whether a component reaches another one in the graph of components
+         *
+         * Only components ranked between the two can be on a path, so no others are visited.
+         *
+         * \param  [in] from first component
+         * \param  [in] to second component
+         *
+         * \return *true* if there is a path
+         * \throw  std::bad_alloc
+         */
+        bool reaches(uint32_t const from, uint32_t const to) const {
+            Rank const bound = m_comps[to].rank;
+            if (!(m_comps[from].rank < bound))
+                return false;
+
+            std::unordered_set<uint32_t> seen  = { from };
+            std::vector<uint32_t>        stack = { from };
+            while (!stack.empty()) {
+                uint32_t const c = stack.back();
+                stack.pop_back();
+
+                for (auto const &[d, count] : m_comps[c].out) {
+                    if (d == to)
+                        return true;
+
+                    if (m_comps[d].rank < bound && seen.insert(d).second)
+                        stack.push_back(d);
+                }
+            }
+
+            return false;
+        }
+
+        /**
+         * \brief  collects the elements of all components reachable from those of some elements
+         *
+         * \param  [in] seeds elements to start from; elements not in the graph are skipped
+         * \param  [in] forward *true* to follow dependencies, *false* to follow dependents
+         * \param  [out] res receives the reached elements, without *seeds*
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if memory ran out
+         */
+        ErrorCode reachable(std::vector<ElementHandle> const &seeds, bool const forward, std::vector<ElementHandle> &res) const noexcept {
+            res.clear();
+
+            try {
+                std::unordered_set<uint32_t> seen;
+                std::unordered_set<uint32_t> seed;
+                std::vector<uint32_t>        stack;
+                for (ElementHandle const element : seeds) {
+                    auto const it = m_nodeids.find(element);
+                    if (it == m_nodeids.end())
+                        continue;
+
+                    /* Members of a cycle depend on each other, so a seed's own component counts. */
+                    seed.insert(it->second);
+                    if (seen.insert(m_nodes[it->second].comp).second)
+                        stack.push_back(m_nodes[it->second].comp);
+                }
+
+                while (!stack.empty()) {
+                    uint32_t const c = stack.back();
+                    stack.pop_back();
+
+                    for (uint32_t const n : m_comps[c].nodes)
+                        if (seed.find(n) == seed.end())
+                            res.push_back(m_nodes[n].element);
+                    for (auto const &[d, count] : forward ? m_comps[c].out : m_comps[c].in)
+                        if (seen.insert(d).second)
+                            stack.push_back(d);
+                }
+
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  visits the components reachable from one, in one direction, that are ranked no
+         *         further than a bound, and stamps them with a new visit
+         *
+         * \param  [in] from component to start from
+         * \param  [in] forward *true* to follow dependencies up to rank *bound*, *false* to follow
+         *                      dependents down to rank *bound*
+         * \param  [in] bound rank not to go beyond
+         * \param  [out] res receives the visited components, including *from*
+         *
+         * \return stamp of the visit
+         * \throw  std::bad_alloc
+         */
+        uint64_t visit(uint32_t const from, bool const forward, Rank const bound, std::vector<uint32_t> &res) {
+            uint64_t const stamp = ++m_visit;
+
+            m_comps[from].visit = stamp;
+            res = { from };
+            for (size_t i = 0; i < res.size(); ++i)
+                for (auto const &[d, count] : forward ? m_comps[res[i]].out : m_comps[res[i]].in) {
+                    Component &comp = m_comps[d];
+
+                    if (comp.visit != stamp && (forward ? !(bound < comp.rank) : !(comp.rank < bound))) {
+                        comp.visit = stamp;
+                        res.push_back(d);
+                    }
+                }
+
+            return stamp;
+        }
+
+        /**
+         * \brief  adds the count of an edge between two components, reordering the components or
+         *         merging those on the cycle it closes, if any
+         *
+         * Only the components ranked between the target and the source are affected, see
+         * Pearce and Kelly's algorithm: those reachable from the target (*forward*) are moved
+         * after those reaching the source (*backward*), reusing their ranks. Components in both
+         * are on a cycle through the new edge and are merged in between.
+         *
+         * \param  [in] cu component of the source
+         * \param  [in] cv component of the target
+         *
+         * \throw  std::bad_alloc
+         */
+        void link(uint32_t const cu, uint32_t const cv) {
+            if (cu == cv)
+                return;
+
+            Rank const lower = m_comps[cv].rank;
+            Rank const upper = m_comps[cu].rank;
+            if (upper < lower) {
+                ++m_comps[cu].out[cv];
+                ++m_comps[cv].in[cu];
+
+                return;
+            }
+
+            std::vector<uint32_t> forward, backward;
+            uint64_t const        reached = visit(cv, true, upper, forward);
+            bool const            closes  = m_comps[cu].visit == reached;
+            visit(cu, false, lower, backward);
+
+            /* Both searches reach the components on the cycle, so their ranks are deduplicated. */
+            std::vector<Rank> ranks;
+            for (uint32_t const c : forward)
+                ranks.push_back(m_comps[c].rank);
+            for (uint32_t const c : backward)
+                ranks.push_back(m_comps[c].rank);
+            std::sort(ranks.begin(), ranks.end());
+            ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+
+            std::vector<uint32_t> cycle;
+            if (closes) {
+                std::unordered_set<uint32_t> const ahead(forward.begin(), forward.end());
+                for (uint32_t const c : backward)
+                    if (ahead.find(c) != ahead.end())
+                        cycle.push_back(c);
+
+                std::unordered_set<uint32_t> const merged(cycle.begin(), cycle.end());
+                auto const                         onCycle = [&](uint32_t const c) { return merged.find(c) != merged.end(); };
+                forward.erase(std::remove_if(forward.begin(), forward.end(), onCycle), forward.end());
+                backward.erase(std::remove_if(backward.begin(), backward.end(), onCycle), backward.end());
+            }
+
+            auto const byRank = [&](uint32_t const a, uint32_t const b) { return m_comps[a].rank < m_comps[b].rank; };
+            std::sort(forward.begin(), forward.end(), byRank);
+            std::sort(backward.begin(), backward.end(), byRank);
+
+            size_t slot = 0;
+            for (uint32_t const c : backward)
+                m_comps[c].rank = ranks[slot++];
+            if (closes) {
+                uint32_t const keep = merge(cycle);
+
+                m_comps[keep].rank = ranks[slot];
+            } else {
+                ++m_comps[cu].out[cv];
+                ++m_comps[cv].in[cu];
+            }
+
+            slot = ranks.size() - forward.size();
+            for (uint32_t const c : forward)
+                m_comps[c].rank = ranks[slot++];
+        }
+
+        /**
+         * \brief  merges components into one
+         *
+         * \param  [in] comps components to merge; at least two
+         *
+         * \return component the others were merged into; its rank is to be set by the caller
+         * \throw  std::bad_alloc
+         */
+        uint32_t merge(std::vector<uint32_t> const &comps) {
+            /* The largest component is kept, so the fewest nodes move. */
+            uint32_t const keep = *std::max_element(comps.begin(), comps.end(), [&](uint32_t const a, uint32_t const b) {
+                return m_comps[a].nodes.size() < m_comps[b].nodes.size();
+            });
+
+            std::unordered_set<uint32_t> const merged(comps.begin(), comps.end());
+
+            std::unordered_map<uint32_t, uint32_t> out, in;
+            for (uint32_t const c : comps) {
+                for (auto const &[d, count] : m_comps[c].out)
+                    if (merged.find(d) == merged.end()) {
+                        out[d] += count;
+                        m_comps[d].in.erase(c);
+                    }
+                for (auto const &[d, count] : m_comps[c].in)
+                    if (merged.find(d) == merged.end()) {
+                        in[d] += count;
+                        m_comps[d].out.erase(c);
+                    }
+            }
+
+            Component &target = m_comps[keep];
+            for (uint32_t const c : comps) {
+                if (c == keep)
+                    continue;
+
+                for (uint32_t const n : m_comps[c].nodes)
+                    m_nodes[n].comp = keep;
+                target.nodes.insert(target.nodes.end(), m_comps[c].nodes.begin(), m_comps[c].nodes.end());
+
+                m_comps[c] = {};
+                m_freecomps.push_back(c);
+            }
+
+            for (auto const &[d, count] : out)
+                m_comps[d].in[keep] += count;
+            for (auto const &[d, count] : in)
+                m_comps[d].out[keep] += count;
+            target.out.swap(out);
+            target.in.swap(in);
+            return keep;
+        }
+
+        /**
+         * \brief  splits a component into the strongly connected components of its nodes, e.g.
+         *         after an edge inside of it was removed
+         *
+         * The new components are ranked in topological order between the dependents and the
+         * dependencies of the old one; if the ranks in between are used up, all components are
+         * ranked again.
+         *
+         * \param  [in] comp component
+         *
+         * \throw  std::bad_alloc
+         */
+        void split(uint32_t const comp) {
+            std::vector<uint32_t> const nodes = m_comps[comp].nodes;
+            if (nodes.size() < 2)
+                return;
+
+            /* Iterative Tarjan over the edges between members of the component. */
+            std::unordered_map<uint32_t, uint32_t> local;
+            for (uint32_t i = 0; i < nodes.size(); ++i)
+                local.emplace(nodes[i], i);
+
+            uint32_t const                           n = static_cast<uint32_t>(nodes.size());
+            std::vector<uint32_t>                    index(n, gl_none), low(n, 0);
+            std::vector<char>                        onstack(n, 0);
+            std::vector<uint32_t>                    stack;
+            std::vector<std::pair<uint32_t, size_t>> calls;
+            std::vector<std::vector<uint32_t>>       sccs;
+            uint32_t                                 counter = 0;
+            for (uint32_t root = 0; root < n; ++root) {
+                if (index[root] != gl_none)
+                    continue;
+
+                calls.push_back({ root, 0 });
+                while (!calls.empty()) {
+                    auto &[v, next] = calls.back();
+                    if (next == 0 && index[v] == gl_none) {
+                        index[v] = low[v] = counter++;
+                        stack.push_back(v);
+                        onstack[v] = 1;
+                    }
+
+                    std::vector<uint32_t> const &out     = m_nodes[nodes[v]].out;
+                    bool                         descend = false;
+                    while (next < out.size()) {
+                        auto const w = local.find(m_edges[out[next++]].target);
+                        if (w == local.end())
+                            continue;
+
+                        if (index[w->second] == gl_none) {
+                            calls.push_back({ w->second, 0 });
+                            descend = true;
+
+                            break;
+                        }
+                        if (onstack[w->second])
+                            low[v] = std::min(low[v], index[w->second]);
+                    }
+                    if (descend)
+                        continue;
+
+                    uint32_t const done = v;
+                    if (low[done] == index[done]) {
+                        sccs.emplace_back();
+                        for (uint32_t w = gl_none; w != done; ) {
+                            w = stack.back();
+                            stack.pop_back();
+                            onstack[w] = 0;
+                            sccs.back().push_back(nodes[w]);
+                        }
+                    }
+                    calls.pop_back();
+                    if (!calls.empty())
+                        low[calls.back().first] = std::min(low[calls.back().first], low[done]);
+                }
+            }
+            if (sccs.size() == 1)
+                return;
+
+            /* The counts of the old component are replaced by those of the new ones. */
+            int64_t lower = INT64_MIN;
+            int64_t upper = INT64_MAX;
+            for (auto const &[d, count] : m_comps[comp].out) {
+                upper = std::min(upper, m_comps[d].rank.order);
+                m_comps[d].in.erase(comp);
+            }
+            for (auto const &[d, count] : m_comps[comp].in) {
+                lower = std::max(lower, m_comps[d].rank.order);
+                m_comps[d].out.erase(comp);
+            }
+
+            /* New ranks are strictly between the positions of all neighbours, whatever their serials. */
+            int64_t const k = static_cast<int64_t>(sccs.size());
+            if (lower == INT64_MIN)
+                lower = (upper == INT64_MAX ? m_comps[comp].rank.order : upper) - (k + 1) * gl_gap;
+            if (upper == INT64_MAX)
+                upper = lower + (k + 1) * gl_gap;
+            m_comps[comp] = {};
+            m_freecomps.push_back(comp);
+
+            /* Tarjan's algorithm finds dependencies first, so the last component found is ranked first. */
+            int64_t const         step = (upper - lower) / (k + 1);
+            std::vector<uint32_t> ids(sccs.size());
+            for (size_t s = 0; s < sccs.size(); ++s) {
+                ids[s] = slotOf(m_comps, m_freecomps);
+                for (uint32_t const node : sccs[s])
+                    m_nodes[node].comp = ids[s];
+                m_comps[ids[s]].nodes = std::move(sccs[s]);
+                m_comps[ids[s]].rank  = { lower + step * (k - static_cast<int64_t>(s)), ++m_serial };
+            }
+
+            /* Edges among the new components are counted at their source, all others at the new end. */
+            for (uint32_t const c : ids)
+                for (uint32_t const node : m_comps[c].nodes) {
+                    for (uint32_t const e : m_nodes[node].out) {
+                        uint32_t const d = m_nodes[m_edges[e].target].comp;
+                        if (d != c) {
+                            ++m_comps[c].out[d];
+                            ++m_comps[d].in[c];
+                        }
+                    }
+                    for (uint32_t const e : m_nodes[node].in) {
+                        uint32_t const d = m_nodes[m_edges[e].source].comp;
+                        if (d != c && local.find(m_edges[e].source) == local.end()) {
+                            ++m_comps[c].in[d];
+                            ++m_comps[d].out[c];
+                        }
+                    }
+                }
+
+            if (step == 0)
+                rerank();
+        }
+
+        /**
+         * \brief ranks all components again in topological order, spaced by *gl_gap*
+         *
+         * \throw std::bad_alloc
+         */
+        void rerank() {
+            std::unordered_map<uint32_t, size_t> pending;
+            std::vector<uint32_t>                order;
+            for (uint32_t c = 0; c < m_comps.size(); ++c) {
+                if (m_comps[c].nodes.empty())
+                    continue;
+
+                if (m_comps[c].in.empty())
+                    order.push_back(c);
+                else
+                    pending.emplace(c, m_comps[c].in.size());
+            }
+
+            for (size_t i = 0; i < order.size(); ++i)
+                for (auto const &[d, count] : m_comps[order[i]].out)
+                    if (--pending[d] == 0)
+                        order.push_back(d);
+
+            for (size_t i = 0; i < order.size(); ++i)
+                m_comps[order[i]].rank = { static_cast<int64_t>(i) * gl_gap, 0 };
+            m_first = 0;
+            m_last  = static_cast<int64_t>(order.size()) * gl_gap;
+        }
+
+        /**
+         * \brief  removes an edge and the nodes left without edges
+         *
+         * Removing an edge closes no cycle, so the ranks stay in order.
+         *
+         * \param  [in] e edge
+         *
+         * \throw  std::bad_alloc
+         */
+        void removeEdge(uint32_t const e) {
+            Edge const     edge = m_edges[e];
+            uint32_t const cu   = m_nodes[edge.source].comp;
+            uint32_t const cv   = m_nodes[edge.target].comp;
+
+            auto const drop = [e](std::vector<uint32_t> &list) {
+                auto const it = std::find(list.begin(), list.end(), e);
+                if (it != list.end()) {
+                    *it = list.back();
+                    list.pop_back();
+                }
+            };
+            drop(m_nodes[edge.source].out);
+            drop(m_nodes[edge.target].in);
+
+            m_edgeids.erase(edge.handle);
+            m_edges[e] = { gl_nullelement, gl_none, gl_none, DependencyKind::Association };
+            m_freeedges.push_back(e);
+
+            if (cu != cv) {
+                if (--m_comps[cu].out[cv] == 0)
+                    m_comps[cu].out.erase(cv);
+                if (--m_comps[cv].in[cu] == 0)
+                    m_comps[cv].in.erase(cu);
+            } else {
+                split(cu);
+            }
+
+            dropIfIsolated(edge.source);
+            if (edge.target != edge.source)
+                dropIfIsolated(edge.target);
+        }
+
+        /**
+         * \brief removes a node without edges, along with its component
+         *
+         * \param [in] n node
+         */
+        void dropIfIsolated(uint32_t const n) noexcept {
+            Node &node = m_nodes[n];
+            if (!node.out.empty() || !node.in.empty())
+                return;
+
+            /* Without edges, the node forms a component of its own. */
+            uint32_t const c = node.comp;
+            m_comps[c] = {};
+            m_freecomps.push_back(c);
+
+            m_nodeids.erase(node.element);
+            node = { gl_nullelement, gl_none, {}, {} };
+            m_freenodes.push_back(n);
+        }
+    };
+}
+
+
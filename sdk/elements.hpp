@@ -0,0 +1,1001 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  elements.hpp
+ * \brief data-oriented storage of diagram elements
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+#include <sdk/handle.hpp>
+#include <sdk/intern.hpp>
+#include <sdk/memory.hpp>
+#include <sdk/spatial.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \enum  suzu::sdk::ElementKind
+     * \brief kind of a diagram element
+     */
+    enum class ElementKind : uint32_t {
+        Class,       /**< class or struct */
+        Interface,   /**< interface */
+        Enumeration, /**< enumeration */
+        Package,     /**< package containing other elements */
+        Association, /**< association between two elements */
+        Note,        /**< free-standing note */
+
+        __NumElementKinds__ /**< (only used internally) */
+    };
+
+    constexpr inline char const *gl_kindnames[]  = { "class", "interface", "enumeration", "package", "association", "note" }; /**< names of the element kinds in documents and queries, by *suzu::sdk::ElementKind* */
+    constexpr inline char const *gl_kindlabels[] = { "Class", "Interface", "Enumeration", "Package", "Association", "Note" }; /**< names of the element kinds shown to the user, by *suzu::sdk::ElementKind* */
+
+    static_assert(std::size(gl_kindnames) == static_cast<size_t>(ElementKind::__NumElementKinds__), "every element kind needs a name");
+    static_assert(std::size(gl_kindlabels) == static_cast<size_t>(ElementKind::__NumElementKinds__), "every element kind needs a label");
+
+    /**
+     * \brief  maps the name of an element kind to the kind
+     *
+     * \param  [in] name name of the kind, e.g. "class" (see *suzu::sdk::gl_kindnames*)
+     * \param  [out] res receives the kind; unchanged if the name is unknown
+     *
+     * \return *true* if the name is known
+     */
+    inline bool KindOfName(std::string_view const name, ElementKind &res) noexcept {
+        for (size_t i = 0; i < std::size(gl_kindnames); ++i)
+            if (name == gl_kindnames[i]) {
+                res = static_cast<ElementKind>(i);
+
+                return true;
+            }
+
+        return false;
+    }
+
+    /**
+     * \enum  suzu::sdk::ElementFlags
+     * \brief state flags of a diagram element
+     */
+    enum ElementFlags : uint32_t {
+        ElementHidden   = 1 << 0, /**< element is not drawn and cannot be hit */
+        ElementSelected = 1 << 1, /**< element is part of the selection */
+        ElementLocked   = 1 << 2  /**< element cannot be moved or resized */
+    };
+
+
+    /**
+     * \brief stable reference to an element of a *suzu::sdk::ElementStore*
+     *
+     * A handle stays valid while its element exists, no matter how the element's data is moved
+     * around inside the store. Across the plug-in boundary, handles are passed as *value()*.
+     */
+    using ElementHandle = Handle<struct ElementTag>;
+    constexpr ElementHandle gl_nullelement = ElementHandle(); /**< handle that never refers to an element */
+
+
+    /**
+     * \class suzu::sdk::ElementBatch
+     * \brief elements to be created at once, e.g. by an importer or a plug-in
+     *
+     * Elements refer to their parents by their index in the batch, or by the handle of an element
+     * that exists already; parents have to be added before their children. Associations between two
+     * elements of the batch (see *connect()*) are elements whose bounds span both ends. Neither the
+     * batch nor the store records the ends; whoever tracks them, e.g. a
+     * *suzu::sdk::DependencyGraph*, is given them along with the new handles.
+     *
+     * Creating a batch (see *suzu::sdk::ElementStore::insert()*) grows every component array and
+     * the spatial index once, instead of once per element, and records the whole batch as a single
+     * change.
+     */
+    class ElementBatch {
+    public:
+        static constexpr uint32_t gl_nobatch = UINT32_MAX; /**< parent index of elements whose parent is not in the batch */
+
+        /**
+         * \struct suzu::sdk::ElementBatch::Item
+         * \brief  element to create
+         */
+        struct Item {
+            ElementKind   kind;   /**< kind of the element */
+            ElementRect   bounds; /**< bounding box */
+            uint32_t      style;  /**< style id */
+            uint32_t      flags;  /**< *suzu::sdk::ElementFlags* */
+            uint32_t      parent; /**< index of the parent in the batch, or *gl_nobatch* */
+            ElementHandle outer;  /**< parent outside of the batch if *parent* is *gl_nobatch*; *gl_nullelement* for top-level elements */
+            StringId      name;   /**< name */
+        };
+
+    private:
+        std::vector<Item> m_items; /**< elements, in order of creation */
+
+    public:
+        /**
+         * \brief reserves memory for elements
+         *
+         * \param [in] elements number of elements, including associations
+         * \throw std::bad_alloc
+         */
+        void reserve(uint32_t const elements) { m_items.reserve(elements); }
+
+        /**
+         * \brief  adds an element
+         *
+         * \param  [in] kind kind of the element
+         * \param  [in] bounds bounding box of the element
+         * \param  [in] style style id of the element
+         * \param  [in] parent index of the parent in the batch; *gl_nobatch* for top-level elements
+         * \param  [in] name name of the element
+         *
+         * \return index of the element in the batch
+         * \throw  std::out_of_range if *parent* has not been added, std::bad_alloc
+         */
+        uint32_t add(ElementKind const kind, ElementRect const &bounds, uint32_t const style = 0, uint32_t const parent = gl_nobatch, StringId const name = {}) {
+            if (parent != gl_nobatch && parent >= size())
+                throw std::out_of_range("parent must be added before its children");
+
+            m_items.push_back({ kind, bounds, style, 0, parent, gl_nullelement, name });
+            return size() - 1;
+        }
+
+        /**
+         * \brief  adds an element to an element that exists already
+         *
+         * \param  [in] parent parent element
+         * \param  [in] kind kind of the element
+         * \param  [in] bounds bounding box of the element
+         * \param  [in] style style id of the element
+         * \param  [in] name name of the element
+         *
+         * \return index of the element in the batch
+         * \throw  std::bad_alloc
+         */
+        uint32_t addTo(ElementHandle const parent, ElementKind const kind, ElementRect const &bounds, uint32_t const style = 0, StringId const name = {}) {
+            m_items.push_back({ kind, bounds, style, 0, gl_nobatch, parent, name });
+
+            return size() - 1;
+        }
+
+        /**
+         * \brief  adds an association between two elements of the batch, as a top-level element
+         *
+         * Only the bounds of the association are derived from its ends; the ends themselves are
+         * not kept.
+         *
+         * \param  [in] source index of the source element
+         * \param  [in] target index of the target element
+         * \param  [in] style style id of the association
+         * \param  [in] name name of the association
+         *
+         * \return index of the association in the batch
+         * \throw  std::out_of_range if an end point has not been added, std::bad_alloc
+         */
+        uint32_t connect(uint32_t const source, uint32_t const target, uint32_t const style = 0, StringId const name = {}) {
+            if (source >= size() || target >= size())
+                throw std::out_of_range("end points must be added before their edges");
+
+            ElementRect const &a  = m_items[source].bounds;
+            ElementRect const &b  = m_items[target].bounds;
+            float const        x0 = std::min(a.x, b.x);
+            float const        y0 = std::min(a.y, b.y);
+
+            return add(ElementKind::Association, { x0, y0, std::max(a.x + a.w, b.x + b.w) - x0, std::max(a.y + a.h, b.y + b.h) - y0 }, style, gl_nobatch, name);
+        }
+
+        /**
+         * \brief sets the flags of an element
+         *
+         * \param [in] item index of the element in the batch
+         * \param [in] flags *suzu::sdk::ElementFlags*
+         */
+        void setFlags(uint32_t const item, uint32_t const flags) noexcept { m_items[item].flags = flags; }
+
+        /**
+         * \brief removes all elements, keeping the memory for the next batch
+         */
+        void clear() noexcept { m_items.clear(); }
+
+        uint32_t                 size() const noexcept  { return static_cast<uint32_t>(m_items.size()); }
+        bool                     empty() const noexcept { return m_items.empty(); }
+        std::vector<Item> const &items() const noexcept { return m_items; }
+    };
+
+
+    /**
+     * \class suzu::sdk::ElementStore
+     * \brief structure-of-arrays storage of all elements of a diagram
+     *
+     * Every component (kind, bounds, style, flags, parent, name) is kept in its own contiguous
+     * array, and all arrays are indexed by the same *dense index*. Passes over all elements, e.g.
+     * layout or rendering, therefore only touch the components they need, in memory order.
+     * Hit-testing and region queries go through a *SpatialIndex* over all bounding boxes, which
+     * is kept up-to-date as elements are created, moved and destroyed.
+     *
+     * Every change is recorded in a log of changed regions, numbered by revision. Views remember
+     * the last revision they have seen and repaint only the regions changed since then (see
+     * *changesSince()*).
+     *
+     * Destroying an element moves the last element into its place, so the arrays never contain
+     * holes. Dense indices are thus not stable; elements are referred to by *ElementHandle*s, which
+     * are translated to dense indices through a *HandleTable*. Moving elements around, be it to fill
+     * holes or to change their drawing order, only updates the slots of the moved elements.
+     *
+     * Kinds and bounds, the bulk of a diagram, can be borrowed from read-only memory such as a
+     * mapped project file (see *map()*). They are copied into the store on the first edit that
+     * changes them or the set of elements; until then, all stores mapping the same file share the
+     * same pages.
+     *
+     * Growing the arrays charges heap memory to the memory account *"model"* (see
+     * *suzu::sdk::MemoryAccounts*).
+     *
+     * \note  The store is not thread-safe.
+     */
+    class ElementStore {
+        static constexpr size_t gl_maxlog = 4096; /**< maximum number of entries in the change log */
+
+        HandleTable<ElementHandle>  m_slots;   /**< dense index of every element, by handle */
+        std::vector<ElementKind>    m_kinds;   /**< kinds, by dense index */
+        std::vector<ElementRect>    m_bounds;  /**< bounding boxes, by dense index */
+        std::vector<uint32_t>       m_styles;  /**< style ids, by dense index */
+        std::vector<uint32_t>       m_flags;   /**< *suzu::sdk::ElementFlags*, by dense index */
+        std::vector<ElementHandle>  m_parent;  /**< parent elements, by dense index */
+        std::vector<StringId>       m_names;   /**< names, by dense index */
+        std::vector<ElementHandle>  m_owner;   /**< handle of each element, by dense index */
+        std::shared_ptr<void const> m_backing; /**< keeps borrowed kinds and bounds alive; *nullptr* while they are owned */
+        ElementKind const          *m_kindref; /**< borrowed kinds, if *m_backing* */
+        ElementRect const          *m_rectref; /**< borrowed bounds, if *m_backing* */
+        SpatialIndex<ElementHandle> m_spatial; /**< bounds of all elements, if *m_indexed* */
+        bool                        m_indexed; /**< whether or not *m_spatial* is maintained */
+        std::vector<ElementRect>    m_log;     /**< regions changed by the most recent revisions */
+        uint64_t                    m_logbase; /**< revision of the first entry in *m_log* */
+        uint64_t                    m_rev;     /**< number of changes since construction */
+
+    public:
+        ElementStore() noexcept
+            : m_kindref(nullptr), m_rectref(nullptr), m_indexed(true), m_logbase(0), m_rev(0)
+        { }
+
+        /**
+         * \brief  retrieves the number of elements
+         *
+         * \return number of elements; dense indices range from 0 to *size() - 1*
+         */
+        uint32_t size() const noexcept { return static_cast<uint32_t>(m_owner.size()); }
+
+        /**
+         * \brief reserves memory for *n* elements
+         *
+         * \param [in] n number of elements
+         */
+        void reserve(uint32_t const n) {
+            SZSDK_MEMORY_SCOPE("model");
+
+            own();
+
+            m_slots.reserve(n);
+            m_kinds.reserve(n);
+            m_bounds.reserve(n);
+            m_styles.reserve(n);
+            m_flags.reserve(n);
+            m_parent.reserve(n);
+            m_names.reserve(n);
+            m_owner.reserve(n);
+            m_spatial.reserve(n);
+        }
+
+        /**
+         * \brief enables or disables maintaining the spatial index
+         *
+         * Bulk-loading many elements, e.g. when opening a file, is faster with the index disabled;
+         * enabling it builds the index in one pass.
+         *
+         * \param [in] enabled whether or not to maintain the index
+         * \note  While disabled, *hitTest()* and *query()* scan all elements.
+         */
+        void setIndexed(bool const enabled) {
+            if (enabled == m_indexed)
+                return;
+
+            SZSDK_MEMORY_SCOPE("model");
+
+            m_spatial.clear();
+            if (enabled) {
+                m_spatial.reserve(m_owner.size());
+
+                for (uint32_t i = 0, n = size(); i < n; ++i)
+                    m_spatial.insert(m_owner[i], bounds()[i]);
+            }
+
+            m_indexed = enabled;
+        }
+
+        /**
+         * \brief destroys all elements and returns the memory of all component arrays to the heap
+         *
+         * \note  The slot table is kept, so that handles of the destroyed elements remain stale.
+         */
+        void clear() noexcept {
+            for (ElementHandle const handle : m_owner)
+                m_slots.release(handle);
+
+            m_kinds  = {};
+            m_bounds = {};
+            m_styles = {};
+            m_flags  = {};
+            m_parent = {};
+            m_names  = {};
+            m_owner  = {};
+            m_spatial.clear();
+
+            m_backing.reset();
+            m_kindref = nullptr;
+            m_rectref = nullptr;
+
+            /* Views cannot catch up with a cleared store and have to repaint completely. */
+            m_log     = {};
+            m_logbase = ++m_rev;
+        }
+
+        /**
+         * \brief  creates a new element
+         *
+         * \param  [in] kind kind of the element
+         * \param  [in] bounds bounding box of the element
+         * \param  [in] style style id of the element
+         * \param  [in] parent parent element; *gl_nullelement* for top-level elements
+         * \param  [in] name name of the element
+         *
+         * \return handle of the new element
+         * \note   New elements are drawn on top of all existing elements.
+         */
+        ElementHandle create(ElementKind const kind, ElementRect const &bounds, uint32_t const style = 0, ElementHandle const parent = gl_nullelement, StringId const name = {}) {
+            SZSDK_MEMORY_SCOPE("model");
+
+            own();
+
+            uint32_t const      dense  = size();
+            ElementHandle const handle = m_slots.allocate(dense);
+            if (handle.isNull())
+                throw std::length_error("too many elements");
+
+            try {
+                m_kinds.push_back(kind);
+                m_bounds.push_back(bounds);
+                m_styles.push_back(style);
+                m_flags.push_back(0);
+                m_parent.push_back(parent);
+                m_names.push_back(name);
+                m_owner.push_back(handle);
+
+                if (m_indexed)
+                    m_spatial.insert(handle, bounds);
+                record(bounds);
+            } catch (...) {
+                truncate(dense);
+                m_slots.release(handle);
+
+                throw;
+            }
+
+            return handle;
+        }
+
+        /**
+         * \brief  creates all elements of a batch in one pass
+         *
+         * Every component array grows once, the spatial index is bulk-loaded once all elements have
+         * been appended, and the change log receives a single region covering the whole batch.
+         * Elements are created in batch order, on top of all existing elements. The ends of
+         * associations are not stored (see *suzu::sdk::ElementBatch*).
+         *
+         * \param  [in] batch elements to create
+         * \param  [out] handles receives the handles of the new elements, by index in the batch
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         a parent outside of the batch is stale, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if memory or handles ran out; the store is unchanged then
+         */
+        ErrorCode insert(ElementBatch const &batch, std::vector<ElementHandle> &handles) noexcept {
+            handles.clear();
+
+            uint32_t const base = size();
+            uint32_t const n    = batch.size();
+            for (ElementBatch::Item const &item : batch.items())
+                if (item.parent == ElementBatch::gl_nobatch && !item.outer.isNull() && !isValid(item.outer))
+                    return ErrorCode::InvalidParameter;
+            if (n == 0)
+                return ErrorCode::Ok;
+
+            ElementRect region = batch.items().front().bounds;
+            try {
+                SZSDK_MEMORY_SCOPE("model");
+
+                reserve(base + n);
+                handles.reserve(n);
+                for (uint32_t i = 0; i < n; ++i) {
+                    ElementHandle const handle = m_slots.allocate(base + i);
+                    if (handle.isNull())
+                        throw std::length_error("too many elements");
+
+                    handles.push_back(handle);
+                }
+
+                /* The arrays have room for the whole batch; appending cannot fail. */
+                for (uint32_t i = 0; i < n; ++i) {
+                    ElementBatch::Item const &item = batch.items()[i];
+
+                    m_kinds.push_back(item.kind);
+                    m_bounds.push_back(item.bounds);
+                    m_styles.push_back(item.style);
+                    m_flags.push_back(item.flags);
+                    m_parent.push_back(item.parent != ElementBatch::gl_nobatch ? handles[item.parent] : item.outer);
+                    m_names.push_back(item.name);
+                    m_owner.push_back(handles[i]);
+
+                    float const x1 = std::max(region.x + region.w, item.bounds.x + item.bounds.w);
+                    float const y1 = std::max(region.y + region.h, item.bounds.y + item.bounds.h);
+                    region.x = std::min(region.x, item.bounds.x);
+                    region.y = std::min(region.y, item.bounds.y);
+                    region.w = x1 - region.x;
+                    region.h = y1 - region.y;
+                }
+
+                if (m_indexed)
+                    m_spatial.insert(m_owner.data() + base, m_bounds.data() + base, n);
+            } catch (...) {
+                for (ElementHandle const handle : handles) {
+                    m_spatial.remove(handle);
+                    m_slots.release(handle);
+                }
+                truncate(base);
+                handles.clear();
+
+                return ErrorCode::CriticalResource;
+            }
+
+            record(region);
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief  destroys an element
+         *
+         * \param  [in] handle element to destroy
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the handle is stale, or *suzu::sdk::ErrorCode::CriticalResource* if borrowed
+         *         components could not be copied
+         * \note   Children of the element are not destroyed; their parent handle becomes stale.
+         */
+        ErrorCode destroy(ElementHandle const handle) noexcept {
+            if (!isValid(handle))
+                return ErrorCode::InvalidParameter;
+            else if (!tryOwn())
+                return ErrorCode::CriticalResource;
+
+            /* Fill the hole with the last element. */
+            uint32_t const dense = m_slots.resolve(handle);
+            uint32_t const last  = size() - 1;
+            record(m_bounds[dense]);
+            if (dense != last)
+                move(last, dense);
+            m_spatial.remove(handle);
+
+            truncate(last);
+            m_slots.release(handle);
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief  creates elements whose kinds and bounds are borrowed from external memory
+         *
+         * The borrowed arrays are not copied, so this only allocates handles and the remaining
+         * components, which are zero-initialized and have to be filled in through their accessors.
+         * Elements are created in array order. The spatial index is disabled, since building it
+         * would read all bounds; enable it with *setIndexed()* before many hit tests.
+         *
+         * \param  [in] n number of elements
+         * \param  [in] kinds kinds of the elements; valid for as long as *backing* exists
+         * \param  [in] bounds bounding boxes of the elements; valid for as long as *backing* exists
+         * \param  [in] backing owner of the borrowed memory, e.g. a file mapping; kept alive until the
+         *         arrays are copied or the store is cleared
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if the
+         *         store is not empty, *suzu::sdk::ErrorCode::InvalidParameter* if *backing* is
+         *         *nullptr*, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out
+         */
+        ErrorCode map(uint32_t const n, ElementKind const *const kinds, ElementRect const *const bounds, std::shared_ptr<void const> backing) noexcept {
+            if (size() != 0)
+                return ErrorCode::InvalidState;
+            else if (backing == nullptr)
+                return ErrorCode::InvalidParameter;
+
+            SZSDK_MEMORY_SCOPE("model");
+
+            std::vector<ElementHandle> owner;
+            uint32_t                   allocated = 0;
+            try {
+                std::vector<uint32_t>      styles(n, 0);
+                std::vector<uint32_t>      flags(n, 0);
+                std::vector<ElementHandle> parents(n, gl_nullelement);
+                std::vector<StringId>      names(n);
+
+                owner.resize(n);
+                m_slots.reserve(n);
+                for (; allocated < n; ++allocated) {
+                    owner[allocated] = m_slots.allocate(allocated);
+                    if (owner[allocated].isNull())
+                        throw std::length_error("too many elements");
+                }
+
+                m_styles.swap(styles);
+                m_flags.swap(flags);
+                m_parent.swap(parents);
+                m_names.swap(names);
+                m_owner.swap(owner);
+            } catch (...) {
+                for (uint32_t i = 0; i < allocated; ++i)
+                    m_slots.release(owner[i]);
+
+                return ErrorCode::CriticalResource;
+            }
+
+            m_kinds   = {};
+            m_bounds  = {};
+            m_backing = std::move(backing);
+            m_kindref = kinds;
+            m_rectref = bounds;
+
+            m_spatial.clear();
+            m_indexed = false;
+
+            m_log     = {};
+            m_logbase = ++m_rev;
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief  retrieves whether or not kinds and bounds are currently borrowed
+         *
+         * \return *true* if the store was filled by *map()* and has not been edited since
+         */
+        bool isMapped() const noexcept { return m_backing != nullptr; }
+
+        /**
+         * \brief  copies the elements into a new store, e.g. to save them on another thread
+         *
+         * Borrowed kinds and bounds are not copied but shared with the snapshot, which keeps the
+         * backing alive. Neither the spatial index nor the change log are copied, so the snapshot
+         * costs little more than copying the component arrays; it can be queried, but *hitTest()*
+         * and *query()* scan all elements.
+         *
+         * \return independent store with the same elements, handles and revision
+         * \throw  std::bad_alloc
+         */
+        ElementStore snapshot() const {
+            ElementStore res;
+
+            res.m_slots   = m_slots;
+            res.m_kinds   = m_kinds;
+            res.m_bounds  = m_bounds;
+            res.m_styles  = m_styles;
+            res.m_flags   = m_flags;
+            res.m_parent  = m_parent;
+            res.m_names   = m_names;
+            res.m_owner   = m_owner;
+            res.m_backing = m_backing;
+            res.m_kindref = m_kindref;
+            res.m_rectref = m_rectref;
+            res.m_indexed = false;
+            res.m_logbase = m_rev;
+            res.m_rev     = m_rev;
+            return res;
+        }
+
+        /**
+         * \brief  checks whether a handle refers to an existing element
+         *
+         * \param  [in] handle handle to check
+         *
+         * \return *true* if the element exists
+         */
+        bool isValid(ElementHandle const handle) const noexcept { return m_slots.isValid(handle); }
+
+        /**
+         * \brief  translates a handle to the element's current dense index
+         *
+         * \param  [in] handle handle of the element
+         *
+         * \return dense index, or *UINT32_MAX* if the handle is stale
+         * \note   Dense indices are invalidated when any element is destroyed.
+         */
+        uint32_t indexOf(ElementHandle const handle) const noexcept { return m_slots.resolve(handle); }
+
+        /**
+         * \brief  retrieves the handle of the element at a dense index
+         *
+         * \param  [in] dense dense index; must be less than *size()*
+         *
+         * \return handle of the element
+         */
+        ElementHandle handleAt(uint32_t const dense) const noexcept { return m_owner[dense]; }
+
+        /**
+         * \brief  moves an element on top of all other elements
+         *
+         * The elements above it move down by one; all handles stay valid.
+         *
+         * \param  [in] handle element to raise
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the handle is stale, or *suzu::sdk::ErrorCode::CriticalResource* if borrowed
+         *         components could not be copied
+         */
+        ErrorCode raise(ElementHandle const handle) noexcept {
+            uint32_t const dense = m_slots.resolve(handle);
+            if (dense == HandleTable<ElementHandle>::gl_invalid)
+                return ErrorCode::InvalidParameter;
+            else if (!tryOwn())
+                return ErrorCode::CriticalResource;
+
+            record(m_bounds[dense]);
+            for (uint32_t i = dense, last = size() - 1; i < last; ++i)
+                swap(i, i + 1);
+
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief  moves an element to a given position in the drawing order
+         *
+         * The elements in between move by one towards the old position; all handles stay valid.
+         *
+         * \param  [in] handle element to move
+         * \param  [in] dense new dense index; must be less than *size()*
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the handle is stale or *dense* is out of range, or
+         *         *suzu::sdk::ErrorCode::CriticalResource* if borrowed components could not be copied
+         */
+        ErrorCode reorder(ElementHandle const handle, uint32_t const dense) noexcept {
+            uint32_t const from = m_slots.resolve(handle);
+            if (from == HandleTable<ElementHandle>::gl_invalid || dense >= size())
+                return ErrorCode::InvalidParameter;
+            else if (!tryOwn())
+                return ErrorCode::CriticalResource;
+
+            record(m_bounds[from]);
+            for (uint32_t i = from; i < dense; ++i)
+                swap(i, i + 1);
+            for (uint32_t i = from; i > dense; --i)
+                swap(i, i - 1);
+
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief  moves or resizes an element
+         *
+         * \param  [in] handle element to change
+         * \param  [in] bounds new bounding box
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the handle is stale
+         */
+        ErrorCode setBounds(ElementHandle const handle, ElementRect const &bounds) {
+            uint32_t const dense = m_slots.resolve(handle);
+            if (dense == HandleTable<ElementHandle>::gl_invalid)
+                return ErrorCode::InvalidParameter;
+            own();
+
+            if (m_indexed)
+                m_spatial.update(handle, bounds);
+            record(m_bounds[dense]);
+            record(bounds);
+
+            m_bounds[dense] = bounds;
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief  moves many elements by the same offset, e.g. when a dragged selection is dropped
+         *
+         * The spatial index is updated in bulk, and the change log receives two regions, the old
+         * and the new bounds of all elements together, however many elements move.
+         *
+         * \param  [in] handles elements to move; each at most once
+         * \param  [in] n number of elements
+         * \param  [in] dx horizontal offset
+         * \param  [in] dy vertical offset
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if
+         *         there is nothing to move, or *suzu::sdk::ErrorCode::InvalidParameter* if a handle
+         *         is stale, in which case no element is moved
+         * \throw  std::bad_alloc
+         */
+        ErrorCode translate(ElementHandle const *const handles, size_t const n, float const dx, float const dy) {
+            if (n == 0 || (dx == 0.0f && dy == 0.0f))
+                return ErrorCode::NoOperation;
+            for (size_t i = 0; i < n; ++i)
+                if (!isValid(handles[i]))
+                    return ErrorCode::InvalidParameter;
+            own();
+
+            std::vector<ElementRect> moved(n);
+            ElementRect              region = m_bounds[m_slots.resolve(handles[0])];
+            for (size_t i = 0; i < n; ++i) {
+                ElementRect &bounds = m_bounds[m_slots.resolve(handles[i])];
+
+                float const x1 = std::max(region.x + region.w, bounds.x + bounds.w);
+                float const y1 = std::max(region.y + region.h, bounds.y + bounds.h);
+                region.x = std::min(region.x, bounds.x);
+                region.y = std::min(region.y, bounds.y);
+                region.w = x1 - region.x;
+                region.h = y1 - region.y;
+
+                moved[i] = { bounds.x + dx, bounds.y + dy, bounds.w, bounds.h };
+            }
+
+            if (m_indexed)
+                m_spatial.update(handles, moved.data(), n);
+            for (size_t i = 0; i < n; ++i)
+                m_bounds[m_slots.resolve(handles[i])] = moved[i];
+
+            record(region);
+            record({ region.x + dx, region.y + dy, region.w, region.h });
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief  records that an element has changed in place, e.g. its flags, style or name
+         *
+         * Components modified through the pointers returned by *flags()*, *styles()* or *names()*
+         * are not tracked automatically; call this function afterwards.
+         *
+         * \param  [in] handle changed element
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the handle is stale
+         */
+        ErrorCode touch(ElementHandle const handle) noexcept {
+            uint32_t const dense = m_slots.resolve(handle);
+            if (dense == HandleTable<ElementHandle>::gl_invalid)
+                return ErrorCode::InvalidParameter;
+
+            record(bounds()[dense]);
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief  retrieves the current revision
+         *
+         * \return number of changes since the store was constructed
+         */
+        uint64_t revision() const noexcept { return m_rev; }
+
+        /**
+         * \brief  collects all regions changed after a revision
+         *
+         * \param  [in] rev revision the caller has seen last
+         * \param  [out] res receives the changed regions; existing contents are kept
+         *
+         * \return *true* on success, *false* if the changes are no longer recorded, in which case
+         *         everything has to be considered changed
+         */
+        bool changesSince(uint64_t const rev, std::vector<ElementRect> &res) const {
+            if (rev < m_logbase || rev > m_rev)
+                return false;
+
+            res.insert(res.end(), m_log.begin() + static_cast<ptrdiff_t>(rev - m_logbase), m_log.end());
+            return true;
+        }
+
+        /*
+         * Component arrays, indexed by dense index. Pointers are invalidated when elements are
+         * created or destroyed, and when borrowed components are copied. Bounds can only be
+         * changed through *setBounds()*.
+         */
+        ElementKind const   *kinds() const noexcept   { return m_backing != nullptr ? m_kindref : m_kinds.data(); }
+        ElementRect const   *bounds() const noexcept  { return m_backing != nullptr ? m_rectref : m_bounds.data(); }
+        uint32_t            *styles() noexcept        { return m_styles.data(); }
+        uint32_t const      *styles() const noexcept  { return m_styles.data(); }
+        uint32_t            *flags() noexcept         { return m_flags.data(); }
+        uint32_t const      *flags() const noexcept   { return m_flags.data(); }
+        ElementHandle       *parents() noexcept       { return m_parent.data(); }
+        ElementHandle const *parents() const noexcept { return m_parent.data(); }
+        StringId            *names() noexcept         { return m_names.data(); }
+        StringId const      *names() const noexcept   { return m_names.data(); }
+
+        /**
+         * \brief  finds the topmost visible element containing a point
+         *
+         * \param  [in] x x-coordinate of the point, in scene coordinates
+         * \param  [in] y y-coordinate of the point, in scene coordinates
+         *
+         * \return handle of the element, or *gl_nullelement* if no element was hit
+         */
+        ElementHandle hitTest(float const x, float const y) const noexcept {
+            if (m_indexed) {
+                uint32_t top = UINT32_MAX;
+                m_spatial.query({ x, y, 0.0f, 0.0f }, [&](ElementHandle const handle, ElementRect const &bounds) {
+                    uint32_t const dense = m_slots.resolve(handle);
+
+                    if (bounds.contains(x, y) && (m_flags[dense] & ElementHidden) == 0 && (top == UINT32_MAX || dense > top))
+                        top = dense;
+                });
+
+                return top == UINT32_MAX ? gl_nullelement : m_owner[top];
+            }
+
+            ElementRect const *const rects = bounds();
+            for (uint32_t i = size(); i-- > 0; )
+                if ((m_flags[i] & ElementHidden) == 0 && rects[i].contains(x, y))
+                    return m_owner[i];
+
+            return gl_nullelement;
+        }
+
+        /**
+         * \brief  collects all visible elements intersecting a rectangle
+         *
+         * \param  [in] rect rectangle, in scene coordinates
+         * \param  [out] res receives the handles of all intersecting elements, bottom-most first;
+         *               existing contents are kept
+         */
+        void query(ElementRect const &rect, std::vector<ElementHandle> &res) const {
+            if (m_indexed) {
+                std::vector<uint32_t> hits;
+                m_spatial.query(rect, [&](ElementHandle const handle, ElementRect const &bounds) {
+                    uint32_t const dense = m_slots.resolve(handle);
+
+                    if (bounds.intersects(rect) && (m_flags[dense] & ElementHidden) == 0)
+                        hits.push_back(dense);
+                });
+
+                std::sort(hits.begin(), hits.end());
+                for (uint32_t const dense : hits)
+                    res.push_back(m_owner[dense]);
+                return;
+            }
+
+            ElementRect const *const rects = bounds();
+            for (uint32_t i = 0, n = size(); i < n; ++i)
+                if ((m_flags[i] & ElementHidden) == 0 && rects[i].intersects(rect))
+                    res.push_back(m_owner[i]);
+        }
+
+    private:
+        /**
+         * \brief copies borrowed kinds and bounds into the store, so that they can be changed
+         *
+         * \throw std::bad_alloc
+         */
+        void own() {
+            if (m_backing == nullptr)
+                return;
+
+            SZSDK_MEMORY_SCOPE("model");
+
+            std::vector<ElementKind> kinds(m_kindref, m_kindref + size());
+            std::vector<ElementRect> rects(m_rectref, m_rectref + size());
+            m_kinds.swap(kinds);
+            m_bounds.swap(rects);
+
+            m_backing.reset();
+            m_kindref = nullptr;
+            m_rectref = nullptr;
+        }
+
+        /**
+         * \brief  like *own()*, but reports failure instead of throwing
+         *
+         * \return *true* if the store owns all components
+         */
+        bool tryOwn() noexcept {
+            try {
+                own();
+            } catch (...) {
+                return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * \brief appends a changed region to the change log
+         *
+         * \param [in] rect changed region
+         */
+        void record(ElementRect const &rect) noexcept {
+            if (m_log.size() >= gl_maxlog) {
+                m_log.erase(m_log.begin(), m_log.begin() + gl_maxlog / 2);
+
+                m_logbase += gl_maxlog / 2;
+            }
+
+            ++m_rev;
+            try {
+                m_log.push_back(rect);
+            } catch (...) {
+                m_log.clear();
+
+                m_logbase = m_rev;
+            }
+        }
+
+        /**
+         * \brief moves the element at *from* to *to*, overwriting the element there
+         *
+         * \param [in] from dense index of the element to move
+         * \param [in] to dense index to move it to
+         */
+        void move(uint32_t const from, uint32_t const to) noexcept {
+            m_kinds[to]  = m_kinds[from];
+            m_bounds[to] = m_bounds[from];
+            m_styles[to] = m_styles[from];
+            m_flags[to]  = m_flags[from];
+            m_parent[to] = m_parent[from];
+            m_names[to]  = m_names[from];
+            m_owner[to]  = m_owner[from];
+
+            m_slots.relocate(m_owner[to], to);
+        }
+
+        /**
+         * \brief exchanges the elements at two dense indices
+         *
+         * \param [in] a dense index of the first element
+         * \param [in] b dense index of the second element
+         */
+        void swap(uint32_t const a, uint32_t const b) noexcept {
+            std::swap(m_kinds[a], m_kinds[b]);
+            std::swap(m_bounds[a], m_bounds[b]);
+            std::swap(m_styles[a], m_styles[b]);
+            std::swap(m_flags[a], m_flags[b]);
+            std::swap(m_parent[a], m_parent[b]);
+            std::swap(m_names[a], m_names[b]);
+            std::swap(m_owner[a], m_owner[b]);
+
+            m_slots.relocate(m_owner[a], a);
+            m_slots.relocate(m_owner[b], b);
+        }
+
+        /**
+         * \brief shrinks all component arrays to *n* elements
+         *
+         * \param [in] n new number of elements
+         */
+        void truncate(size_t const n) noexcept {
+            m_kinds.resize(std::min(m_kinds.size(), n));
+            m_bounds.resize(std::min(m_bounds.size(), n));
+            m_styles.resize(std::min(m_styles.size(), n));
+            m_flags.resize(std::min(m_flags.size(), n));
+            m_parent.resize(std::min(m_parent.size(), n));
+            m_names.resize(std::min(m_names.size(), n));
+            m_owner.resize(std::min(m_owner.size(), n));
+        }
+    };
+}
+
+
@@ -9,7 +9,7 @@
 
 /**
  * \file  error.hpp
- * \brief SDK error codes and string representations
+ * \brief SDK error codes, their descriptions, error contexts and results
  */
 
 
@@ -17,7 +17,12 @@
 
 /* stdlib includes */
 #include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <string_view>
+#include <type_traits>
+#include <utility>
 
 
 namespace suzu::sdk {
@@ -27,7 +32,8 @@ namespace suzu::sdk {
      *
      * Suzu does not use exceptions. Therefore, most functions return an integer value indicating
      * whether or not the function finished successfully. Based on the information given by the error
-     * code, the application may choose to recover from the failure.
+     * code, the application may choose to recover from the failure. Functions that also produce
+     * a value return a *suzu::sdk::Result* instead.
      * Plug-ins should return the same error codes and should also adhere to the specification of the
      * plug-in interface regarding error codes in case certain conditions apply.
      *
@@ -48,6 +54,201 @@ namespace suzu::sdk {
 
         __NumErrors__          /**< (only used internally) */
     };
+
+
+    namespace internal {
+        /**
+         * descriptions of all error codes, indexed by *suzu::sdk::ErrorCode*
+         */
+        constexpr std::array<std::string_view, ErrorCode::__NumErrors__> gl_errordescs = {
+            "no error",
+            "unknown error",
+            "no operation was carried out",
+            "invalid parameter",
+            "invalid state",
+            "operation-critical resource unavailable",
+            "could not open file",
+            "could not read file",
+            "could not write file"
+        };
+
+        /**
+         * \brief  checks that every error code has a description
+         *
+         * \return *true* if no description is empty
+         */
+        constexpr bool AreErrorsDescribed() noexcept {
+            for (std::string_view const desc : gl_errordescs)
+                if (desc.empty())
+                    return false;
+
+            return true;
+        }
+
+        static_assert(AreErrorsDescribed(), "every error code needs a description in gl_errordescs");
+    }
+
+
+    /**
+     * \brief  retrieves the description of an error code
+     *
+     * \param  [in] code error code
+     *
+     * \return static description; "invalid error code" if *code* is out of range
+     */
+    constexpr std::string_view ErrorDescription(ErrorCode const code) noexcept {
+        if (static_cast<int>(code) < 0 || static_cast<int>(code) >= ErrorCode::__NumErrors__)
+            return "invalid error code";
+
+        return internal::gl_errordescs[code];
+    }
+
+
+    /**
+     * \struct suzu::sdk::ErrorContext
+     * \brief  where and why an operation failed, captured without allocating or formatting
+     *
+     * Contexts are captured with *SZSDK_ERROR_CONTEXT()* on the failure path and turned into text
+     * only once the failure has been dealt with, e.g. after an operation has been rolled back.
+     */
+    struct ErrorContext {
+        char const *file;     /**< source file of the failure; static string */
+        char const *function; /**< function the failure occurred in; static string */
+        uint32_t    line;     /**< source line of the failure */
+        ErrorCode   code;     /**< error code */
+        int64_t     payload;  /**< detail, e.g. the index or handle of the item that failed */
+    };
+
+    /**
+     * \class suzu::sdk::ErrorTrail
+     * \brief fixed-capacity list of error contexts, e.g. all failures of a rollback
+     *
+     * If more than *N* contexts are added, the first *N* are kept and the others only counted.
+     */
+    template<size_t N> class ErrorTrail {
+        static_assert(N != 0, "an error trail must hold at least one context");
+
+        std::array<ErrorContext, N> m_entries; /**< recorded contexts */
+        size_t                      m_count;   /**< number of contexts added, including dropped ones */
+
+    public:
+        constexpr ErrorTrail() noexcept
+            : m_entries{}, m_count(0)
+        { }
+
+        /**
+         * \brief adds a context
+         *
+         * \param [in] ctx context; see *SZSDK_ERROR_CONTEXT()*
+         */
+        constexpr void add(ErrorContext const &ctx) noexcept {
+            if (m_count < N)
+                m_entries[m_count] = ctx;
+
+            ++m_count;
+        }
+
+        constexpr bool empty() const noexcept { return m_count == 0; }
+        constexpr size_t size() const noexcept { return m_count < N ? m_count : N; }
+        constexpr size_t dropped() const noexcept { return m_count - size(); }
+        constexpr ErrorContext const *begin() const noexcept { return m_entries.data(); }
+        constexpr ErrorContext const *end() const noexcept { return m_entries.data() + size(); }
+        constexpr void clear() noexcept { m_count = 0; }
+    };
+
+
+    /**
+     * \class suzu::sdk::Result
+     * \brief the value computed by a function, or the reason it could not be computed
+     *
+     * Functions that produce a value return it through a *Result* instead of an out-parameter or a
+     * sentinel value. The caller tests the result and either uses the value or passes the error on:
+     *
+     *     Result<FileBuffer> file = util::ReadFile(path);
+     *     if (!file)
+     *         return file.error();
+     *     Consume(*file);
+     *
+     * \note  Accessing the value of a failed result is undefined behavior; it does not throw.
+     */
+    template<class T> class [[nodiscard]] Result {
+        static_assert(!std::is_reference_v<T> && !std::is_same_v<std::decay_t<T>, ErrorCode>, "results hold values other than error codes");
+
+        std::optional<T> m_value; /**< value; empty on error */
+        ErrorCode        m_error; /**< *suzu::sdk::ErrorCode::Ok*, or the reason *m_value* is empty */
+
+    public:
+        /**
+         * \brief constructs a successful result
+         *
+         * \param [in] value the value
+         */
+        Result(T value) noexcept(std::is_nothrow_move_constructible_v<T>)
+            : m_value(std::move(value)), m_error(ErrorCode::Ok)
+        { }
+        /**
+         * \brief constructs a failed result
+         *
+         * \param [in] error reason of the failure; *suzu::sdk::ErrorCode::Ok* is stored as
+         *            *suzu::sdk::ErrorCode::Unknown*, as there is no value
+         */
+        Result(ErrorCode const error) noexcept
+            : m_error(error == ErrorCode::Ok ? ErrorCode::Unknown : error)
+        { }
+
+        bool ok() const noexcept { return m_error == ErrorCode::Ok; }
+        explicit operator bool() const noexcept { return ok(); }
+        ErrorCode error() const noexcept { return m_error; }
+
+        T &value() & noexcept { return *m_value; }
+        T const &value() const & noexcept { return *m_value; }
+        T &&value() && noexcept { return std::move(*m_value); }
+
+        T &operator *() & noexcept { return *m_value; }
+        T const &operator *() const & noexcept { return *m_value; }
+        T &&operator *() && noexcept { return std::move(*m_value); }
+        T *operator ->() noexcept { return &*m_value; }
+        T const *operator ->() const noexcept { return &*m_value; }
+
+        /**
+         * \brief  retrieves the value, or *fallback* on error
+         *
+         * \param  [in] fallback value returned if the result failed
+         *
+         * \return the value or *fallback*
+         */
+        T valueOr(T fallback) const & { return ok() ? *m_value : std::move(fallback); }
+        T valueOr(T fallback) && { return ok() ? std::move(*m_value) : std::move(fallback); }
+    };
+
+    /**
+     * \class suzu::sdk::Result<void>
+     * \brief the outcome of a function that produces no value; interchangeable with *ErrorCode*
+     */
+    template<> class [[nodiscard]] Result<void> {
+        ErrorCode m_error; /**< outcome */
+
+    public:
+        Result() noexcept
+            : m_error(ErrorCode::Ok)
+        { }
+        Result(ErrorCode const error) noexcept
+            : m_error(error)
+        { }
+
+        bool ok() const noexcept { return m_error == ErrorCode::Ok; }
+        explicit operator bool() const noexcept { return ok(); }
+        ErrorCode error() const noexcept { return m_error; }
+    };
 }
 
 
+/**
+ * \brief captures an error context at the current source location
+ *
+ * \param code error code
+ * \param payload integer detail of the failure
+ */
+#define SZSDK_ERROR_CONTEXT(code, payload) (::suzu::sdk::ErrorContext{ __FILE__, __func__, static_cast<uint32_t>(__LINE__), (code), static_cast<int64_t>(payload) })
+
+
@@ -0,0 +1,244 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  eventlog.hpp
+ * \brief structured binary event log for high-frequency telemetry
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <functional>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+
+
+/**
+ * \namespace suzu::sdk::events
+ * \brief     binary event channel for per-frame and per-edit telemetry
+ *
+ * Contrary to the text loggers, events are fixed-size binary records which are never formatted at
+ * run-time. Each thread collects its events in a private buffer which is appended to the event log
+ * file in bulk once it is full. Event logs can be turned back into text with the *eventdecode* tool.
+ */
+namespace suzu::sdk::events {
+    /**
+     * \struct suzu::sdk::events::EventRecord
+     * \brief  a single event, as stored in the event log file
+     */
+    struct EventRecord {
+        uint64_t time;    /**< steady-clock timestamp, in nanoseconds */
+        uint32_t id;      /**< application-defined event id */
+        uint32_t thread;  /**< hashed id of the recording thread */
+        int64_t  args[3]; /**< event arguments */
+    };
+    static_assert(sizeof(EventRecord) == 40, "event record layout must not change");
+
+    /**
+     * \struct suzu::sdk::events::EventLogHeader
+     * \brief  header of an event log file; followed by an arbitrary number of *EventRecord*s
+     *
+     * The header stores the steady-clock and system-clock times of the moment the log was opened,
+     * so that the decoder can convert the steady-clock timestamps of the records into wall-clock time.
+     */
+    struct EventLogHeader {
+        static constexpr uint32_t gl_magic   = 0x56455A53; /**< "SZEV" */
+        static constexpr uint32_t gl_version = 1;          /**< current file format version */
+
+        uint32_t magic;      /**< must be *gl_magic* */
+        uint32_t version;    /**< must be *gl_version* */
+        uint64_t steadyref;  /**< steady-clock time at opening, in nanoseconds */
+        int64_t  systemref;  /**< system-clock time at opening, in nanoseconds since the epoch */
+    };
+    static_assert(sizeof(EventLogHeader) == 24, "event log header layout must not change");
+
+
+    namespace internal {
+        /**
+         * \class suzu::sdk::events::internal::EventWriter
+         * \brief shared destination of all thread-local event buffers of the current module
+         */
+        class EventWriter {
+            std::mutex        m_lock;    /**< guards *m_file* */
+            std::FILE        *m_file;    /**< event log file; *nullptr* if closed */
+            std::atomic<bool> m_enabled; /**< whether or not events are recorded */
+
+            EventWriter() noexcept
+                : m_file(nullptr), m_enabled(false)
+            { }
+
+        public:
+            ~EventWriter() { close(); }
+
+            static EventWriter &Instance() noexcept {
+                static EventWriter gl_writer;
+
+                return gl_writer;
+            }
+
+            bool isEnabled() const noexcept { return m_enabled.load(std::memory_order_relaxed); }
+
+            ErrorCode open(char const *const path) noexcept {
+                if (path == nullptr)
+                    return ErrorCode::InvalidParameter;
+
+                std::lock_guard<std::mutex> lock(m_lock);
+                if (m_file != nullptr)
+                    return ErrorCode::InvalidState;
+
+                m_file = std::fopen(path, "wb");
+                if (m_file == nullptr)
+                    return ErrorCode::OpenFile;
+
+                EventLogHeader const header{
+                    EventLogHeader::gl_magic,
+                    EventLogHeader::gl_version,
+                    static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()),
+                    static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count())
+                };
+                if (std::fwrite(&header, sizeof header, 1, m_file) != 1) {
+                    std::fclose(m_file);
+                    m_file = nullptr;
+
+                    return ErrorCode::WriteFile;
+                }
+
+                m_enabled.store(true, std::memory_order_relaxed);
+                return ErrorCode::Ok;
+            }
+
+            void close() noexcept {
+                std::lock_guard<std::mutex> lock(m_lock);
+
+                m_enabled.store(false, std::memory_order_relaxed);
+                if (m_file != nullptr)
+                    std::fclose(m_file);
+                m_file = nullptr;
+            }
+
+            void append(EventRecord const *records, size_t const count) noexcept {
+                std::lock_guard<std::mutex> lock(m_lock);
+
+                if (m_file != nullptr && count != 0)
+                    std::fwrite(records, sizeof(EventRecord), count, m_file);
+            }
+        };
+
+        /**
+         * \class suzu::sdk::events::internal::ThreadBuffer
+         * \brief per-thread buffer of recorded events
+         *
+         * The buffer is appended to the event log once it is full, when *FlushEvents()* is called on its
+         * thread, and when its thread exits.
+         */
+        class ThreadBuffer {
+            static constexpr size_t gl_capacity = 512; /**< number of records per buffer */
+
+            std::array<EventRecord, gl_capacity> m_records; /**< buffered records */
+            size_t                               m_count;   /**< number of buffered records */
+            uint32_t                             m_thread;  /**< hashed id of the owning thread */
+
+        public:
+            ThreadBuffer() noexcept
+                : m_count(0), m_thread(static_cast<uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id())))
+            { }
+            ~ThreadBuffer() { flush(); }
+
+            static ThreadBuffer &Instance() noexcept {
+                thread_local ThreadBuffer gl_buffer;
+
+                return gl_buffer;
+            }
+
+            void push(uint32_t const id, int64_t const a0, int64_t const a1, int64_t const a2) noexcept {
+                uint64_t const now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+
+                m_records[m_count++] = EventRecord{ now, id, m_thread, { a0, a1, a2 } };
+                if (m_count == gl_capacity)
+                    flush();
+            }
+
+            void flush() noexcept {
+                EventWriter::Instance().append(m_records.data(), m_count);
+
+                m_count = 0;
+            }
+        };
+    }
+
+
+    /**
+     * \brief  starts recording events of the current module into the file at *path*
+     *
+     * \param  [in] path file path of the event log; overwritten if it exists
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success
+     * \note   Events recorded while no event log is open are discarded without being buffered.
+     */
+    inline ErrorCode OpenEventLog(char const *const path) noexcept {
+        return internal::EventWriter::Instance().open(path);
+    }
+
+    /**
+     * \brief stops recording events and closes the event log
+     *
+     * \note  Events that are still buffered by other threads are lost; call *FlushEvents()* on these
+     *        threads first if that matters.
+     */
+    inline void CloseEventLog() noexcept {
+        internal::ThreadBuffer::Instance().flush();
+
+        internal::EventWriter::Instance().close();
+    }
+
+    /**
+     * \brief records the event *id* with up to three integer arguments
+     *
+     * \param [in] id application-defined event id
+     * \param [in] a0 first argument
+     * \param [in] a1 second argument
+     * \param [in] a2 third argument
+     *
+     * \note  This function never blocks unless the buffer of the calling thread is full.
+     */
+    inline void RecordEvent(uint32_t const id, int64_t const a0 = 0, int64_t const a1 = 0, int64_t const a2 = 0) noexcept {
+        if (!internal::EventWriter::Instance().isEnabled())
+            return;
+
+        internal::ThreadBuffer::Instance().push(id, a0, a1, a2);
+    }
+
+    /**
+     * \brief appends all events buffered by the calling thread to the event log
+     */
+    inline void FlushEvents() noexcept {
+        internal::ThreadBuffer::Instance().flush();
+    }
+}
+
+
+/**
+ * \ingroup  Macros
+ * \brief    records a telemetry event with up to three integer arguments
+ *
+ * \param    [in] id event id
+ * \param    [in] ... up to three integer arguments
+ */
+#define SZSDK_EVENT(id, ...) suzu::sdk::events::RecordEvent((id), ##__VA_ARGS__)
+
+
@@ -0,0 +1,509 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  forcelayout.hpp
+ * \brief force-directed layout with Barnes-Hut approximation
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX__)
+    #include <immintrin.h>
+
+    #define SZSDK_FORCE_AVX
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+
+    #define SZSDK_FORCE_SSE
+#endif
+
+/* sdk includes */
+#include <sdk/error.hpp>
+#include <sdk/layout.hpp>
+#include <sdk/spatial.hpp>
+#include <sdk/task.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \struct suzu::sdk::ForceOptions
+     * \brief  parameters of *suzu::sdk::ForceLayout*
+     */
+    struct ForceOptions {
+        float distance = 120.0f; /**< preferred distance between the borders of connected nodes */
+        float theta    = 0.8f;   /**< Barnes-Hut opening criterion; 0 computes all forces exactly */
+        float gravity  = 0.02f;  /**< strength of the pull towards the center of the graph */
+        float cooling  = 0.96f;  /**< factor applied to the temperature after every step */
+        float mintemp  = 0.5f;   /**< temperature, i.e. maximum step length, below which the layout is settled */
+    };
+
+
+    /**
+     * \class suzu::sdk::ForceLayout
+     * \brief Fruchterman-Reingold style spring embedder
+     *
+     * All nodes repel each other and edges act as springs. Repulsion is approximated with a
+     * Barnes-Hut quadtree: distant groups of nodes act as a single node at their center of mass,
+     * so a step takes O(n log n) time. For every node, the tree walk gathers the groups it
+     * interacts with into contiguous arrays, which are then summed up by a vectorized kernel (AVX
+     * or SSE2, depending on the target); nodes are processed in blocks on the task scheduler.
+     *
+     * The state is kept as separate coordinate arrays, gathered from the bounds of the nodes by
+     * *reset()* and scattered back by *apply()*. The maximum distance a node may move per step (the
+     * *temperature*) decreases after every step; the layout is settled once it drops below
+     * *ForceOptions::mintemp*.
+     *
+     * \note  The layout is not thread-safe; a step itself may use the task scheduler.
+     */
+    class ForceLayout {
+        static constexpr uint32_t gl_none      = UINT32_MAX; /**< marks unset indices */
+        static constexpr uint32_t gl_blocksize = 256;        /**< nodes per repulsion task */
+        static constexpr float    gl_mincell   = 1e-3f;      /**< size below which cells are not subdivided */
+
+        /**
+         * \struct suzu::sdk::ForceLayout::Cell
+         * \brief  node of the Barnes-Hut quadtree
+         */
+        struct Cell {
+            float    x;     /**< left edge */
+            float    y;     /**< top edge */
+            float    size;  /**< side length */
+            float    mass;  /**< total mass of all nodes in the cell */
+            float    cx;    /**< center of mass, x-coordinate; weighted sum while building */
+            float    cy;    /**< center of mass, y-coordinate; weighted sum while building */
+            uint32_t child; /**< index of the first of four children; *gl_none* for leaves */
+            uint32_t body;  /**< node stored in a leaf; *gl_none* if empty */
+        };
+
+        ForceOptions            m_opts;   /**< layout parameters */
+        std::vector<float>      m_x;      /**< center x-coordinates, by node */
+        std::vector<float>      m_y;      /**< center y-coordinates, by node */
+        std::vector<float>      m_dx;     /**< accumulated horizontal force, by node */
+        std::vector<float>      m_dy;     /**< accumulated vertical force, by node */
+        std::vector<float>      m_mass;   /**< mass, by node; larger nodes repel more */
+        std::vector<uint8_t>    m_pinned; /**< whether or not a node stays in place, by node */
+        std::vector<LayoutEdge> m_edges;  /**< springs */
+        std::vector<Cell>       m_cells;  /**< quadtree of the current step */
+        float                   m_k;      /**< preferred distance between node centers */
+        float                   m_temp;   /**< current temperature */
+
+    public:
+        explicit ForceLayout(ForceOptions const &opts = {}) noexcept
+            : m_opts(opts), m_k(1.0f), m_temp(0.0f)
+        { }
+
+        /**
+         * \brief  starts a new layout
+         *
+         * Nodes sharing the same position, e.g. freshly imported ones, are spread on a small spiral
+         * first, since coincident nodes exert no force on each other.
+         *
+         * \param  [in] nodes bounds of all nodes
+         * \param  [in] edges springs between indices into *nodes*; self-loops are ignored
+         * \param  [in] pinned (optional) whether or not a node stays in place, by node
+         *
+         * \return *ErrorCode::Ok* on success, *ErrorCode::InvalidParameter* if an edge refers to a
+         *         missing node or *pinned* has the wrong size, or *ErrorCode::CriticalResource* if
+         *         memory ran out
+         */
+        ErrorCode reset(std::vector<ElementRect> const &nodes, std::vector<LayoutEdge> const &edges, std::vector<uint8_t> const &pinned = {}) noexcept {
+            if (!pinned.empty() && pinned.size() != nodes.size())
+                return ErrorCode::InvalidParameter;
+            for (LayoutEdge const &edge : edges)
+                if (edge.from >= nodes.size() || edge.to >= nodes.size())
+                    return ErrorCode::InvalidParameter;
+
+            try {
+                size_t const n = nodes.size();
+                m_x.resize(n);
+                m_y.resize(n);
+                m_dx.assign(n, 0.0f);
+                m_dy.assign(n, 0.0f);
+                m_mass.resize(n);
+                m_pinned = pinned.empty() ? std::vector<uint8_t>(n, 0) : pinned;
+                m_edges.clear();
+                for (LayoutEdge const &edge : edges)
+                    if (edge.from != edge.to)
+                        m_edges.push_back(edge);
+
+                float extent = 0.0f;
+                for (size_t i = 0; i < n; ++i) {
+                    m_x[i] = nodes[i].x + nodes[i].w * 0.5f;
+                    m_y[i] = nodes[i].y + nodes[i].h * 0.5f;
+                    extent += std::max(nodes[i].w, nodes[i].h);
+                }
+                m_k = m_opts.distance + (n > 0 ? extent / static_cast<float>(n) : 0.0f);
+                for (size_t i = 0; i < n; ++i)
+                    m_mass[i] = 1.0f + nodes[i].w * nodes[i].h / (m_k * m_k);
+
+                separate();
+                m_temp = m_k * (1.0f + std::sqrt(static_cast<float>(n)) * 0.1f);
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            m_temp = 0.0f;
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  advances the layout by one step
+         *
+         * \return *true* if the layout has not settled yet; *false* if it has, or if memory ran out
+         */
+        bool step() noexcept {
+            if (isSettled())
+                return false;
+
+            try {
+                build();
+
+                size_t const n = m_x.size();
+                ParallelFor((n + gl_blocksize - 1) / gl_blocksize, [&](size_t const block) { repulse(block); });
+            } catch (...) {
+                m_temp = 0.0f;
+
+                return false;
+            }
+
+            /* Springs pull with d^2 / k, so that they balance the repulsion k^2 / d at distance k. */
+            for (LayoutEdge const &edge : m_edges) {
+                float const dx = m_x[edge.to] - m_x[edge.from];
+                float const dy = m_y[edge.to] - m_y[edge.from];
+                float const f  = std::sqrt(dx * dx + dy * dy) / m_k;
+
+                m_dx[edge.from] += dx * f;
+                m_dy[edge.from] += dy * f;
+                m_dx[edge.to]   -= dx * f;
+                m_dy[edge.to]   -= dy * f;
+            }
+
+            /* Gravity keeps disconnected parts from drifting apart. */
+            Cell const &root = m_cells.front();
+            float const gx   = root.cx;
+            float const gy   = root.cy;
+
+            for (size_t i = 0, n = m_x.size(); i < n; ++i) {
+                float const dx = m_dx[i] + (gx - m_x[i]) * m_opts.gravity * m_mass[i];
+                float const dy = m_dy[i] + (gy - m_y[i]) * m_opts.gravity * m_mass[i];
+                float const d  = std::sqrt(dx * dx + dy * dy);
+                m_dx[i] = 0.0f;
+                m_dy[i] = 0.0f;
+
+                if (m_pinned[i] || d <= 0.0f || !std::isfinite(d))
+                    continue;
+
+                float const len = std::min(d, m_temp) / d;
+                m_x[i] += dx * len;
+                m_y[i] += dy * len;
+            }
+
+            m_temp *= m_opts.cooling;
+            return !isSettled();
+        }
+
+        /**
+         * \brief  advances the layout until it has settled
+         *
+         * \param  [in] maxsteps maximum number of steps
+         *
+         * \return number of steps taken
+         */
+        uint32_t run(uint32_t const maxsteps) noexcept {
+            uint32_t steps = 0;
+            while (steps < maxsteps && step())
+                ++steps;
+
+            return steps;
+        }
+
+        /**
+         * \brief  retrieves whether or not the layout has settled
+         *
+         * \return *true* if further steps would not move any node noticeably
+         */
+        bool isSettled() const noexcept { return m_temp < m_opts.mintemp || m_x.empty(); }
+
+        /*
+         * Center coordinates of all nodes, by node. Pointers are invalidated by *reset()*.
+         */
+        size_t       size() const noexcept { return m_x.size(); }
+        float const *xs() const noexcept   { return m_x.data(); }
+        float const *ys() const noexcept   { return m_y.data(); }
+
+        /**
+         * \brief moves the bounds of all nodes to their current position
+         *
+         * \param [in,out] nodes bounds passed to *reset()*; only the positions are changed
+         */
+        void apply(std::vector<ElementRect> &nodes) const noexcept {
+            for (size_t i = 0, n = std::min(nodes.size(), m_x.size()); i < n; ++i) {
+                nodes[i].x = m_x[i] - nodes[i].w * 0.5f;
+                nodes[i].y = m_y[i] - nodes[i].h * 0.5f;
+            }
+        }
+
+    private:
+        /**
+         * \brief moves nodes off positions occupied by another node
+         */
+        void separate() {
+            size_t const          n = m_x.size();
+            std::vector<uint32_t> order(n);
+            for (uint32_t i = 0; i < n; ++i)
+                order[i] = i;
+            std::sort(order.begin(), order.end(), [&](uint32_t const a, uint32_t const b) {
+                return m_x[a] < m_x[b] || (m_x[a] == m_x[b] && m_y[a] < m_y[b]);
+            });
+
+            /* The n-th duplicate goes to the n-th point of a Fermat spiral around the position. */
+            for (size_t i = 1, dup = 0; i < n; ++i) {
+                uint32_t const a = order[i - 1 - dup];
+                uint32_t const b = order[i];
+                if (m_x[a] != m_x[b] || m_y[a] != m_y[b] || m_pinned[b]) {
+                    dup = 0;
+
+                    continue;
+                }
+
+                ++dup;
+                float const r   = m_k * 0.5f * std::sqrt(static_cast<float>(dup));
+                float const phi = 2.39996323f * static_cast<float>(dup);
+                m_x[b] += r * std::cos(phi);
+                m_y[b] += r * std::sin(phi);
+            }
+        }
+
+        /**
+         * \brief builds the quadtree over the current positions
+         */
+        void build() {
+            float x0 = m_x.front(), x1 = x0;
+            float y0 = m_y.front(), y1 = y0;
+            for (size_t i = 1, n = m_x.size(); i < n; ++i) {
+                x0 = std::min(x0, m_x[i]);
+                x1 = std::max(x1, m_x[i]);
+                y0 = std::min(y0, m_y[i]);
+                y1 = std::max(y1, m_y[i]);
+            }
+
+            m_cells.clear();
+            m_cells.reserve(m_x.size() * 2);
+            m_cells.push_back({ x0, y0, std::max(x1 - x0, y1 - y0) * 1.001f + 1.0f, 0.0f, 0.0f, 0.0f, gl_none, gl_none });
+
+            for (uint32_t i = 0, n = static_cast<uint32_t>(m_x.size()); i < n; ++i)
+                insert(i);
+
+            for (Cell &cell : m_cells)
+                if (cell.mass > 0.0f) {
+                    cell.cx /= cell.mass;
+                    cell.cy /= cell.mass;
+                }
+        }
+
+        /**
+         * \brief adds a node to the quadtree
+         *
+         * Every cell on the way accumulates the node's mass. Nodes too close to each other to be
+         * told apart share a leaf, which then only stores the first of them.
+         *
+         * \param [in] b node to add
+         */
+        void insert(uint32_t const b) {
+            auto const add = [&](uint32_t const c, uint32_t const v) {
+                Cell &cell = m_cells[c];
+
+                cell.mass += m_mass[v];
+                cell.cx   += m_mass[v] * m_x[v];
+                cell.cy   += m_mass[v] * m_y[v];
+            };
+            auto const quadrant = [&](uint32_t const c, uint32_t const v) {
+                Cell const &cell = m_cells[c];
+                float const half = cell.size * 0.5f;
+
+                return cell.child + (m_x[v] >= cell.x + half ? 1u : 0u) + (m_y[v] >= cell.y + half ? 2u : 0u);
+            };
+
+            uint32_t c = 0;
+            add(c, b);
+            for (;;) {
+                if (m_cells[c].child == gl_none) {
+                    if (m_cells[c].body == gl_none) {
+                        m_cells[c].body = b;
+
+                        return;
+                    }
+                    if (m_cells[c].size < gl_mincell)
+                        return;
+
+                    /* Split the leaf and move its node down. */
+                    Cell const     leaf  = m_cells[c];
+                    float const    half  = leaf.size * 0.5f;
+                    uint32_t const first = static_cast<uint32_t>(m_cells.size());
+                    for (uint32_t q = 0; q < 4; ++q)
+                        m_cells.push_back({ leaf.x + (q & 1 ? half : 0.0f), leaf.y + (q & 2 ? half : 0.0f), half, 0.0f, 0.0f, 0.0f, gl_none, gl_none });
+
+                    m_cells[c].child = first;
+                    m_cells[c].body  = gl_none;
+
+                    uint32_t const o = quadrant(c, leaf.body);
+                    m_cells[o].body = leaf.body;
+                    add(o, leaf.body);
+                }
+
+                c = quadrant(c, b);
+                add(c, b);
+            }
+        }
+
+        /**
+         * \brief sums up the repulsion acting on the nodes of a block
+         *
+         * \param [in] block index of the block of *gl_blocksize* nodes
+         */
+        void repulse(size_t const block) {
+            std::vector<float>    ix, iy, im;
+            std::vector<uint32_t> stack;
+            float const           theta2 = m_opts.theta * m_opts.theta;
+            float const           k2     = m_k * m_k;
+
+            size_t const end = std::min(m_x.size(), (block + 1) * gl_blocksize);
+            for (size_t i = block * gl_blocksize; i < end; ++i) {
+                float const px = m_x[i];
+                float const py = m_y[i];
+
+                /* Gather all cells that are far enough away, or leaves. */
+                ix.clear();
+                iy.clear();
+                im.clear();
+                stack.assign(1, 0);
+                while (!stack.empty()) {
+                    Cell const &cell = m_cells[stack.back()];
+                    stack.pop_back();
+                    if (cell.mass <= 0.0f)
+                        continue;
+
+                    float const dx = cell.cx - px;
+                    float const dy = cell.cy - py;
+                    if (cell.child == gl_none || cell.size * cell.size < theta2 * (dx * dx + dy * dy)) {
+                        /* A leaf holding this node only repels with the mass of the others in it. */
+                        float const mass = cell.body == i ? cell.mass - m_mass[i] : cell.mass;
+
+                        if (mass > 1e-6f) {
+                            ix.push_back(cell.cx);
+                            iy.push_back(cell.cy);
+                            im.push_back(mass);
+                        }
+                        continue;
+                    }
+
+                    for (uint32_t q = 0; q < 4; ++q)
+                        stack.push_back(cell.child + q);
+                }
+
+                float fx = 0.0f;
+                float fy = 0.0f;
+                Kernel(px, py, ix.data(), iy.data(), im.data(), ix.size(), fx, fy);
+
+                m_dx[i] = fx * k2 * m_mass[i];
+                m_dy[i] = fy * k2 * m_mass[i];
+            }
+        }
+
+        /**
+         * \brief sums up *m * d / |d|^2* over all interactions, where *d* points from a group to the node
+         *
+         * \param [in] px x-coordinate of the node
+         * \param [in] py y-coordinate of the node
+         * \param [in] ix x-coordinates of the groups
+         * \param [in] iy y-coordinates of the groups
+         * \param [in] im masses of the groups
+         * \param [in] n number of groups
+         * \param [out] fx sum of the x-components
+         * \param [out] fy sum of the y-components
+         */
+        static void Kernel(float const px, float const py, float const *ix, float const *iy, float const *im, size_t const n, float &fx, float &fy) noexcept {
+            constexpr float gl_eps = 1e-2f; /**< softening; avoids division by zero for coincident nodes */
+            size_t          i      = 0;
+
+#if defined(SZSDK_FORCE_AVX)
+            {
+                __m256 const vpx = _mm256_set1_ps(px);
+                __m256 const vpy = _mm256_set1_ps(py);
+                __m256 const eps = _mm256_set1_ps(gl_eps);
+                __m256       sx  = _mm256_setzero_ps();
+                __m256       sy  = _mm256_setzero_ps();
+
+                for (; i + 8 <= n; i += 8) {
+                    __m256 const dx = _mm256_sub_ps(vpx, _mm256_loadu_ps(ix + i));
+                    __m256 const dy = _mm256_sub_ps(vpy, _mm256_loadu_ps(iy + i));
+                    __m256 const d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), eps);
+                    __m256 const f  = _mm256_div_ps(_mm256_loadu_ps(im + i), d2);
+
+                    sx = _mm256_add_ps(sx, _mm256_mul_ps(dx, f));
+                    sy = _mm256_add_ps(sy, _mm256_mul_ps(dy, f));
+                }
+
+                alignas(32) float lx[8], ly[8];
+                _mm256_store_ps(lx, sx);
+                _mm256_store_ps(ly, sy);
+                for (uint32_t l = 0; l < 8; ++l) {
+                    fx += lx[l];
+                    fy += ly[l];
+                }
+            }
+#endif
+#if defined(SZSDK_FORCE_SSE)
+            {
+                __m128 const vpx = _mm_set1_ps(px);
+                __m128 const vpy = _mm_set1_ps(py);
+                __m128 const eps = _mm_set1_ps(gl_eps);
+                __m128       sx  = _mm_setzero_ps();
+                __m128       sy  = _mm_setzero_ps();
+
+                for (; i + 4 <= n; i += 4) {
+                    __m128 const dx = _mm_sub_ps(vpx, _mm_loadu_ps(ix + i));
+                    __m128 const dy = _mm_sub_ps(vpy, _mm_loadu_ps(iy + i));
+                    __m128 const d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), eps);
+                    __m128 const f  = _mm_div_ps(_mm_loadu_ps(im + i), d2);
+
+                    sx = _mm_add_ps(sx, _mm_mul_ps(dx, f));
+                    sy = _mm_add_ps(sy, _mm_mul_ps(dy, f));
+                }
+
+                alignas(16) float lx[4], ly[4];
+                _mm_store_ps(lx, sx);
+                _mm_store_ps(ly, sy);
+                fx += (lx[0] + lx[1]) + (lx[2] + lx[3]);
+                fy += (ly[0] + ly[1]) + (ly[2] + ly[3]);
+            }
+#endif
+
+            for (; i < n; ++i) {
+                float const dx = px - ix[i];
+                float const dy = py - iy[i];
+                float const f  = im[i] / (dx * dx + dy * dy + gl_eps);
+
+                fx += dx * f;
+                fy += dy * f;
+            }
+        }
+    };
+}
+
+
@@ -0,0 +1,226 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  handle.hpp
+ * \brief generational handles and the slot table resolving them
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+
+namespace suzu::sdk {
+    /**
+     * \class suzu::sdk::Handle
+     * \brief reference to an object, consisting of a slot index and the slot's generation
+     *
+     * Handles are plain integers; they can be copied, hashed, stored across callbacks and passed
+     * across the plug-in boundary via *value()*. Resolving a handle is a single array access into
+     * a *HandleTable*. Once the object is destroyed, the generation of its slot changes, so a stale
+     * handle is detected even if the slot has been reused in the meantime.
+     *
+     * \tparam Tag type distinguishing handles of different object types
+     * \tparam Int underlying integer; *uint32_t* or *uint64_t*
+     * \tparam IndexBits number of bits used for the slot index; the rest holds the generation
+     */
+    template<class Tag, class Int = uint64_t, unsigned IndexBits = sizeof(Int) * 4>
+    class Handle {
+        static_assert(std::is_same_v<Int, uint32_t> || std::is_same_v<Int, uint64_t>, "handles must be 32 or 64 bits wide");
+        static_assert(IndexBits > 0 && IndexBits < sizeof(Int) * 8, "handles need index and generation bits");
+
+    public:
+        using value_type = Int;
+
+        static constexpr unsigned gl_indexbits = IndexBits;                                   /**< number of index bits */
+        static constexpr Int      gl_maxindex  = (Int(1) << IndexBits) - 1;                   /**< largest index; reserved for the null handle */
+        static constexpr Int      gl_maxgen    = (Int(1) << (sizeof(Int) * 8 - IndexBits)) - 1; /**< largest generation */
+
+    private:
+        Int m_value; /**< generation in the upper, index in the lower bits */
+
+    public:
+        /**
+         * \brief constructs the null handle, which never refers to an object
+         */
+        constexpr Handle() noexcept
+            : m_value(gl_maxindex)
+        { }
+        constexpr Handle(Int const index, Int const generation) noexcept
+            : m_value((generation << IndexBits) | (index & gl_maxindex))
+        { }
+
+        /**
+         * \brief  reconstructs a handle from its integer representation
+         *
+         * \param  [in] value value returned by *value()*
+         *
+         * \return handle
+         */
+        static constexpr Handle FromValue(Int const value) noexcept {
+            Handle res;
+            res.m_value = value;
+
+            return res;
+        }
+
+        constexpr Int  value() const noexcept      { return m_value; }
+        constexpr Int  index() const noexcept      { return m_value & gl_maxindex; }
+        constexpr Int  generation() const noexcept { return m_value >> IndexBits; }
+        constexpr bool isNull() const noexcept     { return index() == gl_maxindex; }
+
+        constexpr bool operator ==(Handle const &other) const noexcept { return m_value == other.m_value; }
+        constexpr bool operator !=(Handle const &other) const noexcept { return m_value != other.m_value; }
+    };
+
+
+    /**
+     * \class suzu::sdk::HandleTable
+     * \brief slot table mapping handles to the current location of their objects
+     *
+     * The table does not store objects, only their location (e.g. an index into packed arrays).
+     * Objects may thus be compacted or reordered freely: only the moved objects' slots have to be
+     * updated via *relocate()*, and all handles stay valid.
+     *
+     * Slots whose generation is exhausted are retired instead of being reused, so a stale handle is
+     * never mistaken for a live one.
+     *
+     * \tparam H handle type, see *suzu::sdk::Handle*
+     */
+    template<class H> class HandleTable {
+        using Int = typename H::value_type;
+
+        /**
+         * \struct suzu::sdk::HandleTable::Slot
+         * \brief  entry of the slot table
+         */
+        struct Slot {
+            uint32_t location;   /**< location of the object; next free slot if unused */
+            Int      generation; /**< incremented every time the slot is released */
+            bool     used;       /**< whether or not the slot refers to an object */
+        };
+
+        std::vector<Slot> m_slots; /**< all slots, indexed by handle index */
+        uint32_t          m_free;  /**< first unused slot; *UINT32_MAX* if none */
+
+    public:
+        static constexpr uint32_t gl_invalid = UINT32_MAX; /**< location returned for stale handles */
+
+        HandleTable() noexcept
+            : m_free(UINT32_MAX)
+        { }
+
+        /**
+         * \brief reserves memory for *n* slots
+         *
+         * \param [in] n number of slots
+         */
+        void reserve(size_t const n) { m_slots.reserve(n); }
+
+        /**
+         * \brief  creates a handle for a new object
+         *
+         * \param  [in] location location of the object
+         *
+         * \return new handle; the null handle if the index space is exhausted
+         */
+        H allocate(uint32_t const location) {
+            uint32_t index = m_free;
+            if (index == UINT32_MAX) {
+                if (m_slots.size() >= static_cast<size_t>(H::gl_maxindex))
+                    return H();
+
+                index = static_cast<uint32_t>(m_slots.size());
+                m_slots.push_back({ location, 0, true });
+            } else {
+                m_free = m_slots[index].location;
+
+                m_slots[index].location = location;
+                m_slots[index].used     = true;
+            }
+
+            return H(static_cast<Int>(index), m_slots[index].generation);
+        }
+
+        /**
+         * \brief  invalidates a handle
+         *
+         * \param  [in] handle handle to release
+         *
+         * \return *true* on success, *false* if the handle was stale
+         */
+        bool release(H const handle) noexcept {
+            if (!isValid(handle))
+                return false;
+
+            Slot &slot = m_slots[handle.index()];
+            slot.used = false;
+            if (slot.generation == H::gl_maxgen)
+                return true;
+
+            ++slot.generation;
+            slot.location = m_free;
+            m_free        = static_cast<uint32_t>(handle.index());
+            return true;
+        }
+
+        /**
+         * \brief  checks whether a handle refers to a live object
+         *
+         * \param  [in] handle handle to check
+         *
+         * \return *true* if the object exists
+         */
+        bool isValid(H const handle) const noexcept {
+            if (handle.index() >= m_slots.size())
+                return false;
+
+            Slot const &slot = m_slots[handle.index()];
+            return slot.used && slot.generation == handle.generation();
+        }
+
+        /**
+         * \brief  retrieves the location of an object
+         *
+         * \param  [in] handle handle of the object
+         *
+         * \return location, or *gl_invalid* if the handle is stale
+         */
+        uint32_t resolve(H const handle) const noexcept {
+            return isValid(handle) ? m_slots[handle.index()].location : gl_invalid;
+        }
+
+        /**
+         * \brief updates the location of an object after it was moved
+         *
+         * \param [in] handle handle of the object; must be valid
+         * \param [in] location new location
+         */
+        void relocate(H const handle, uint32_t const location) noexcept {
+            m_slots[handle.index()].location = location;
+        }
+    };
+}
+
+
+namespace std {
+    template<class Tag, class Int, unsigned IndexBits> struct hash<suzu::sdk::Handle<Tag, Int, IndexBits>> {
+        size_t operator ()(suzu::sdk::Handle<Tag, Int, IndexBits> const &handle) const noexcept {
+            return std::hash<Int>{}(handle.value());
+        }
+    };
+}
+
+
@@ -0,0 +1,454 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  history.hpp
+ * \brief local history of a project, stored as content-addressed diagram chunks
+ *
+ * A history directory holds one file per distinct diagram and an index of all snapshots:
+ *
+ *     <dir>/index
+ *     <dir>/chunks/<16 hex digits>.szp
+ *
+ * Every chunk file is a project file (see *sdk/project.hpp*) holding a single diagram with its
+ * own string table, named after the hash of that diagram's contents. A snapshot is a list of diagram
+ * names and chunk hashes, so taking a snapshot only writes the diagrams no earlier snapshot
+ * contained, and restoring a diagram reads just its chunk.
+ *
+ * The index is a text file rewritten atomically with every snapshot. Each snapshot starts with
+ * a line *S <seconds since the epoch> <label>*, followed by a line *D <chunk> <name>* for every
+ * diagram, in order. Backslashes and line breaks in labels and names are escaped as *\\\\* and *\\n*.
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/compress.hpp>
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/project.hpp>
+#include <sdk/util.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \struct suzu::sdk::HistorySnapshot
+     * \brief  state of a project at some point in time
+     */
+    struct HistorySnapshot {
+        /**
+         * \struct suzu::sdk::HistorySnapshot::Diagram
+         * \brief  diagram of a snapshot
+         */
+        struct Diagram {
+            std::string name;  /**< name of the diagram */
+            uint64_t    chunk; /**< hash of the contents, which names the chunk file */
+        };
+
+        int64_t              time;     /**< time the snapshot was taken, in seconds since the epoch */
+        std::string          label;    /**< description, e.g. "Before refactoring"; may be empty */
+        std::vector<Diagram> diagrams; /**< diagrams, in project order */
+    };
+
+
+    namespace internal {
+        /**
+         * \brief  escapes backslashes and line breaks for the history index
+         *
+         * \param  [in] str raw string
+         * \param  [in,out] out receives the escaped string; appended to
+         *
+         * \throw  std::bad_alloc
+         */
+        inline void EscapeHistory(std::string_view const str, std::string &out) {
+            for (char const c : str)
+                if (c == '\\')
+                    out.append("\\\\");
+                else if (c == '\n')
+                    out.append("\\n");
+                else
+                    out.push_back(c);
+        }
+
+        /**
+         * \brief  reverts *EscapeHistory()*
+         *
+         * \param  [in] str escaped string
+         *
+         * \return raw string
+         * \throw  std::bad_alloc
+         */
+        inline std::string UnescapeHistory(std::string_view const str) {
+            std::string res;
+            res.reserve(str.size());
+
+            for (size_t i = 0; i < str.size(); ++i)
+                if (str[i] == '\\' && i + 1 < str.size())
+                    res.push_back(str[++i] == 'n' ? '\n' : str[i]);
+                else
+                    res.push_back(str[i]);
+
+            return res;
+        }
+    }
+
+
+    /**
+     * \class suzu::sdk::ProjectHistory
+     * \brief deduplicating store of project snapshots
+     *
+     * Diagrams are deduplicated at the chunk boundaries of the project format. The hash of a
+     * diagram covers its encoded elements and their names, but not its name, selection state, or
+     * the string indices of the project it came from, so unchanged diagrams map to the same chunk
+     * in every snapshot, even if other diagrams were renamed meanwhile. Chunks are written
+     * atomically before the index refers to them, so a crash while taking a snapshot at worst
+     * leaves an unreferenced chunk behind, which *prune()* removes.
+     *
+     * \note  The history is not thread-safe; at most one instance may use a directory at a time.
+     */
+    class ProjectHistory {
+        std::string                  m_dir;         /**< history directory; empty while closed */
+        std::vector<HistorySnapshot> m_snapshots;   /**< all snapshots, oldest first */
+        Compression                  m_compression; /**< how hard to compress new chunks */
+
+    public:
+        ProjectHistory() noexcept
+            : m_compression(Compression::Fast)
+        { }
+
+        /**
+         * \brief  opens a history directory, reading its index
+         *
+         * \param  [in] dir history directory; created on the first snapshot
+         * \param  [in] compression (optional) how hard to compress new chunks
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         *dir* is empty, *suzu::sdk::ErrorCode::ReadFile* if the index is malformed, or
+         *         *suzu::sdk::ErrorCode::CriticalResource* if memory ran out; the history is closed then
+         * \note   A missing index is an empty history.
+         */
+        ErrorCode open(std::string dir, Compression const compression = Compression::Fast) noexcept {
+            close();
+            if (dir.empty())
+                return ErrorCode::InvalidParameter;
+
+            try {
+                m_dir         = std::move(dir);
+                m_compression = compression;
+
+                std::error_code err;
+                if (!std::filesystem::exists(indexPath(), err))
+                    return ErrorCode::Ok;
+
+                Result<util::FileBuffer> const text = util::ReadFile(indexPath().c_str(), true);
+                if (!text || !parseIndex(std::string_view(text->data(), text->size()))) {
+                    close();
+
+                    return ErrorCode::ReadFile;
+                }
+
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            close();
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief closes the history, keeping its files
+         */
+        void close() noexcept {
+            m_dir.clear();
+            m_snapshots.clear();
+        }
+
+        bool isOpen() const noexcept { return !m_dir.empty(); }
+        size_t size() const noexcept { return m_snapshots.size(); }
+
+        /**
+         * \brief  retrieves a snapshot
+         *
+         * \param  [in] snapshot index of the snapshot, oldest first; less than *size()*
+         *
+         * \return snapshot; valid until the history is modified or closed
+         */
+        HistorySnapshot const &at(size_t const snapshot) const noexcept { return m_snapshots[snapshot]; }
+
+        /**
+         * \brief  takes a snapshot of a project
+         *
+         * Only diagrams whose contents no earlier snapshot had are written.
+         *
+         * \param  [in] diagrams name and elements of every diagram, in project order
+         * \param  [in] label (optional) description of the snapshot
+         * \param  [in] durable (optional) whether or not to flush all files to the storage device
+         * \param  [out] written (optional) receives the number of chunks written
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if the
+         *         history is not open, *suzu::sdk::ErrorCode::WriteFile* if a chunk or the index could
+         *         not be written, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out; the
+         *         history is unchanged then
+         */
+        ErrorCode snapshot(std::vector<std::pair<std::string_view, ElementStore const *>> const &diagrams, std::string_view const label = {}, bool const durable = false, size_t *const written = nullptr) noexcept {
+            if (m_dir.empty())
+                return ErrorCode::InvalidState;
+            if (written != nullptr)
+                *written = 0;
+
+            try {
+                std::error_code err;
+                std::filesystem::create_directories(std::filesystem::u8path(m_dir) / "chunks", err);
+
+                HistorySnapshot snap;
+                snap.time  = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+                snap.label = std::string(label);
+
+                std::vector<std::string_view>          strings;
+                std::unordered_map<uint32_t, uint32_t> ids;
+                std::vector<char>                      chunk;
+                std::vector<char>                      table;
+                for (auto const &[name, store] : diagrams) {
+                    /* The key is the chunk as the journal would store it, with a string table of its own. */
+                    strings.assign(1, {});
+                    ids.clear();
+                    internal::EncodeDiagram(*store, [&](StringId const str) { return internal::AddString(str, strings, ids); }, chunk);
+                    internal::EncodeStrings(strings, table);
+
+                    uint64_t const key  = util::HashBytes(chunk.data(), chunk.size(), util::HashBytes(table.data(), table.size()));
+                    std::string const path = chunkPath(key);
+                    if (!std::filesystem::exists(path, err)) {
+                        ProjectWriter writer;
+                        if (writer.open(path.c_str(), m_compression) != ErrorCode::Ok || writer.addDiagram({}, *store) != ErrorCode::Ok || writer.commit(durable) != ErrorCode::Ok)
+                            return ErrorCode::WriteFile;
+
+                        if (written != nullptr)
+                            ++*written;
+                    }
+
+                    snap.diagrams.push_back({ std::string(name), key });
+                }
+
+                m_snapshots.push_back(std::move(snap));
+                if (saveIndex(durable) == ErrorCode::Ok)
+                    return ErrorCode::Ok;
+
+                m_snapshots.pop_back();
+                return ErrorCode::WriteFile;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  loads a diagram of a snapshot
+         *
+         * \param  [in] snapshot index of the snapshot; less than *size()*
+         * \param  [in] diagram index of the diagram in the snapshot
+         * \param  [out] store receives the elements; cleared first
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         either index is out of range, or the error of reading the chunk
+         */
+        ErrorCode load(size_t const snapshot, size_t const diagram, ElementStore &store) const noexcept {
+            if (snapshot >= m_snapshots.size() || diagram >= m_snapshots[snapshot].diagrams.size())
+                return ErrorCode::InvalidParameter;
+
+            try {
+                ProjectReader reader;
+
+                ErrorCode const err = reader.open(chunkPath(m_snapshots[snapshot].diagrams[diagram].chunk).c_str());
+                if (err != ErrorCode::Ok)
+                    return err;
+                return reader.diagramCount() == 1 ? reader.loadDiagram(0, store) : ErrorCode::ReadFile;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  writes a snapshot as a project file
+         *
+         * \param  [in] snapshot index of the snapshot; less than *size()*
+         * \param  [in] path path of the project file; replaced once it is complete
+         * \param  [in] compression (optional) how hard to compress the project file
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         *snapshot* is out of range, the error of reading a chunk, or
+         *         *suzu::sdk::ErrorCode::WriteFile* if the project could not be written
+         */
+        ErrorCode restore(size_t const snapshot, char const *const path, Compression const compression = Compression::None) const noexcept {
+            if (snapshot >= m_snapshots.size())
+                return ErrorCode::InvalidParameter;
+
+            try {
+                ProjectWriter writer;
+                ErrorCode     err = writer.open(path, compression);
+
+                ElementStore store;
+                store.setIndexed(false);
+                for (size_t i = 0; err == ErrorCode::Ok && i < m_snapshots[snapshot].diagrams.size(); ++i)
+                    if ((err = load(snapshot, i, store)) == ErrorCode::Ok)
+                        err = writer.addDiagram(m_snapshots[snapshot].diagrams[i].name, store);
+
+                return err == ErrorCode::Ok ? writer.commit() : err;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  drops the oldest snapshots and deletes the chunks no other snapshot refers to
+         *
+         * \param  [in] keep number of most recent snapshots to keep
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if the
+         *         history is not open, *suzu::sdk::ErrorCode::WriteFile* if the index could not be
+         *         written, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out; the history
+         *         is unchanged then
+         * \note   Chunks left behind by interrupted snapshots are deleted as well.
+         */
+        ErrorCode prune(size_t const keep) noexcept {
+            if (m_dir.empty())
+                return ErrorCode::InvalidState;
+
+            try {
+                std::vector<HistorySnapshot> kept(m_snapshots.end() - static_cast<ptrdiff_t>(std::min(keep, m_snapshots.size())), m_snapshots.end());
+                std::swap(kept, m_snapshots);
+                if (saveIndex(false) != ErrorCode::Ok) {
+                    std::swap(kept, m_snapshots);
+
+                    return ErrorCode::WriteFile;
+                }
+
+                /* Chunks are only deleted once the index no longer refers to them. */
+                std::unordered_set<std::string> used;
+                for (HistorySnapshot const &snap : m_snapshots)
+                    for (HistorySnapshot::Diagram const &diagram : snap.diagrams)
+                        used.insert(std::filesystem::u8path(chunkPath(diagram.chunk)).filename().u8string());
+
+                std::error_code err;
+                for (auto it = std::filesystem::directory_iterator(std::filesystem::u8path(m_dir) / "chunks", err); !err && it != std::filesystem::directory_iterator(); it.increment(err))
+                    if (used.count(it->path().filename().u8string()) == 0)
+                        std::filesystem::remove(it->path(), err);
+
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+    private:
+        std::string indexPath() const { return (std::filesystem::u8path(m_dir) / "index").u8string(); }
+
+        /**
+         * \brief  builds the path of a chunk file
+         *
+         * \param  [in] chunk hash of the contents
+         *
+         * \return path
+         * \throw  std::bad_alloc
+         */
+        std::string chunkPath(uint64_t const chunk) const {
+            char name[24];
+            std::snprintf(name, sizeof name, "%016" PRIx64 ".szp", chunk);
+
+            return (std::filesystem::u8path(m_dir) / "chunks" / name).u8string();
+        }
+
+        /**
+         * \brief  parses the index
+         *
+         * \param  [in] text contents of the index
+         *
+         * \return *true* if the index is well-formed
+         * \throw  std::bad_alloc
+         */
+        bool parseIndex(std::string_view text) {
+            while (!text.empty()) {
+                size_t const     eol  = text.find('\n');
+                std::string_view line = text.substr(0, eol);
+                text = eol == std::string_view::npos ? std::string_view() : text.substr(eol + 1);
+                if (line.empty())
+                    continue;
+
+                size_t const sep = line.find(' ', 2);
+                if (line.size() < 3 || line[1] != ' ' || sep == std::string_view::npos)
+                    return false;
+
+                std::string const field(line.substr(2, sep - 2));
+                if (line[0] == 'S') {
+                    int64_t time;
+                    if (std::sscanf(field.c_str(), "%" SCNd64, &time) != 1)
+                        return false;
+
+                    m_snapshots.push_back({ time, internal::UnescapeHistory(line.substr(sep + 1)), {} });
+                } else if (line[0] == 'D' && !m_snapshots.empty()) {
+                    uint64_t chunk;
+                    if (field.size() != 16 || std::sscanf(field.c_str(), "%16" SCNx64, &chunk) != 1)
+                        return false;
+
+                    m_snapshots.back().diagrams.push_back({ internal::UnescapeHistory(line.substr(sep + 1)), chunk });
+                } else
+                    return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * \brief  writes the index
+         *
+         * \param  [in] durable whether or not to flush it to the storage device
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or the error of *util::WriteFileAtomic()*
+         * \throw  std::bad_alloc
+         */
+        ErrorCode saveIndex(bool const durable) const {
+            std::string text;
+            for (HistorySnapshot const &snap : m_snapshots) {
+                text.append("S ").append(std::to_string(snap.time)).push_back(' ');
+                internal::EscapeHistory(snap.label, text);
+                text.push_back('\n');
+
+                for (HistorySnapshot::Diagram const &diagram : snap.diagrams) {
+                    char chunk[24];
+                    std::snprintf(chunk, sizeof chunk, "D %016" PRIx64 " ", diagram.chunk);
+
+                    text.append(chunk);
+                    internal::EscapeHistory(diagram.name, text);
+                    text.push_back('\n');
+                }
+            }
+
+            std::error_code err;
+            std::filesystem::create_directories(std::filesystem::u8path(m_dir), err);
+
+            return util::WriteFileAtomic(indexPath().c_str(), text.data(), text.size(), true, durable);
+        }
+    };
+}
+
+
@@ -0,0 +1,288 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  intern.hpp
+ * \brief thread-safe table of interned strings
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+namespace suzu::sdk {
+    /**
+     * \class suzu::sdk::StringTable
+     * \brief stores every distinct string once and identifies it by a 32-bit id
+     *
+     * Strings are copied into large, append-only blocks and never move or get freed, so views
+     * returned by *view()* are valid for the lifetime of the table. Id 0 always denotes the empty
+     * string.
+     *
+     * \note  All functions are thread-safe. Looking up strings that are interned already only takes
+     *        a shared lock.
+     */
+    class StringTable {
+        static constexpr size_t gl_blocksize = 64 * 1024; /**< minimum size of a character block */
+
+        mutable std::shared_mutex                      m_lock;   /**< guards all other members */
+        std::vector<std::unique_ptr<char[]>>           m_blocks; /**< character storage */
+        char                                          *m_next;   /**< first free character in the last block */
+        size_t                                         m_left;   /**< number of free characters in the last block */
+        std::vector<std::string_view>                  m_views;  /**< strings, by id */
+        std::unordered_map<std::string_view, uint32_t> m_ids;    /**< ids, by string */
+
+    public:
+        StringTable()
+            : m_next(nullptr), m_left(0), m_views{ std::string_view{} }, m_ids{ { std::string_view{}, 0 } }
+        { }
+        StringTable(StringTable const &) = delete;
+        StringTable &operator =(StringTable const &) = delete;
+
+        /**
+         * \brief  retrieves the string table of the current module
+         *
+         * \return reference to the table
+         */
+        static StringTable &Local() {
+            static StringTable gl_table;
+
+            return gl_table;
+        }
+
+        /**
+         * \brief  interns a string
+         *
+         * \param  [in] str string to intern
+         *
+         * \return id of the string; equal strings always receive the same id
+         */
+        uint32_t intern(std::string_view const str) {
+            {
+                std::shared_lock<std::shared_mutex> lock(m_lock);
+
+                auto const it = m_ids.find(str);
+                if (it != m_ids.end())
+                    return it->second;
+            }
+
+            std::unique_lock<std::shared_mutex> lock(m_lock);
+            auto const it = m_ids.find(str);
+            if (it != m_ids.end())
+                return it->second;
+
+            if (str.length() > m_left) {
+                size_t const size = std::max(gl_blocksize, str.length());
+
+                m_blocks.push_back(std::make_unique<char[]>(size));
+                m_next = m_blocks.back().get();
+                m_left = size;
+            }
+            std::memcpy(m_next, str.data(), str.length());
+
+            std::string_view const stored(m_next, str.length());
+            uint32_t const         id = static_cast<uint32_t>(m_views.size());
+            m_next += str.length();
+            m_left -= str.length();
+
+            m_views.push_back(stored);
+            m_ids.emplace(stored, id);
+            return id;
+        }
+
+        /**
+         * \brief  retrieves the string of an id
+         *
+         * \param  [in] id id returned by *intern()*
+         *
+         * \return view on the string; empty if the id is unknown
+         */
+        std::string_view view(uint32_t const id) const noexcept {
+            std::shared_lock<std::shared_mutex> lock(m_lock);
+
+            return id < m_views.size() ? m_views[id] : std::string_view{};
+        }
+
+        /**
+         * \brief  retrieves the number of distinct strings, including the empty string
+         *
+         * \return number of strings
+         */
+        size_t size() const noexcept {
+            std::shared_lock<std::shared_mutex> lock(m_lock);
+
+            return m_views.size();
+        }
+    };
+
+
+    /**
+     * \struct suzu::sdk::StringTableInterface
+     * \brief  ABI-stable view on the string table owned by the host application
+     *
+     * All modules share the host's table, so ids can be compared and passed across the plug-in
+     * boundary. Like *suzu::sdk::SinkRegistry*, this is a plain struct of raw pointers.
+     */
+    struct StringTableInterface {
+        static constexpr uint32_t gl_version = 1; /**< current ABI version */
+
+        uint32_t      version;                                            /**< must be *gl_version* */
+        void         *table;                                              /**< opaque table object */
+        uint32_t    (*intern)(void *table, char const *str, size_t len);  /**< interns *str*; returns its id, or 0 on failure */
+        char const *(*view)(void const *table, uint32_t id, size_t *len); /**< retrieves the string of *id* */
+
+        /**
+         * \brief  retrieves the interface to the string table of the current module
+         *
+         * \return string table interface; valid for the lifetime of the module
+         */
+        static StringTableInterface Local() noexcept {
+            return {
+                gl_version,
+                &StringTable::Local(),
+                [](void *table, char const *str, size_t len) -> uint32_t {
+                    try {
+                        return static_cast<StringTable *>(table)->intern({ str, len });
+                    } catch (...) { }
+
+                    return 0;
+                },
+                [](void const *table, uint32_t id, size_t *len) -> char const * {
+                    std::string_view const res = static_cast<StringTable const *>(table)->view(id);
+
+                    *len = res.length();
+                    return res.data();
+                }
+            };
+        }
+    };
+
+
+    namespace internal {
+        /**
+         * String table used by the current instance, set by *InitializeInstanceStrings()*. Until
+         * then, the module's own table is used.
+         *
+         * The variable is constant-initialized, so that ids can be created during static
+         * initialization.
+         */
+        inline StringTableInterface gl_strings = { StringTableInterface::gl_version, nullptr, nullptr, nullptr };
+
+        /**
+         * \brief  retrieves the string table used by the current instance
+         *
+         * \return string table interface
+         */
+        inline StringTableInterface CurrentStrings() noexcept {
+            return gl_strings.intern != nullptr ? gl_strings : StringTableInterface::Local();
+        }
+    }
+
+    /**
+     * \brief  sets the string table used by the current instance
+     *
+     * \param  [in] iface string table interface passed by the host
+     *
+     * \return *true* on success, *false* if the interface has an incompatible ABI version
+     * \note   Ids obtained before this call refer to the module's own table and must be discarded.
+     */
+    inline bool InitializeInstanceStrings(StringTableInterface const &iface) noexcept {
+        if (iface.version != StringTableInterface::gl_version || iface.intern == nullptr || iface.view == nullptr)
+            return false;
+
+        internal::gl_strings = iface;
+        return true;
+    }
+
+
+    /**
+     * \class suzu::sdk::StringId
+     * \brief interned string, e.g. an element name, stereotype or style key
+     *
+     * Comparing and hashing ids only compares and hashes integers. The default-constructed id
+     * denotes the empty string.
+     */
+    class StringId {
+        uint32_t m_id; /**< id in the string table of the instance */
+
+    public:
+        constexpr StringId() noexcept
+            : m_id(0)
+        { }
+        /**
+         * \brief interns *str* in the string table of the instance
+         *
+         * \param [in] str string to intern
+         */
+        explicit StringId(std::string_view const str) noexcept
+            : m_id(0)
+        {
+            StringTableInterface const iface = internal::CurrentStrings();
+
+            m_id = iface.intern(iface.table, str.data(), str.length());
+        }
+
+        /**
+         * \brief  reconstructs an id from its integer representation
+         *
+         * \param  [in] value value returned by *value()*
+         *
+         * \return id
+         */
+        static constexpr StringId FromValue(uint32_t const value) noexcept {
+            StringId res;
+            res.m_id = value;
+
+            return res;
+        }
+
+        /**
+         * \brief  retrieves the interned string
+         *
+         * \return view on the string; valid for the lifetime of the string table
+         */
+        std::string_view view() const noexcept {
+            StringTableInterface const iface = internal::CurrentStrings();
+
+            size_t            len = 0;
+            char const *const str = iface.view(iface.table, m_id, &len);
+
+            return { str, len };
+        }
+
+        constexpr uint32_t value() const noexcept { return m_id; }
+        constexpr bool     empty() const noexcept { return m_id == 0; }
+
+        constexpr bool operator ==(StringId const &other) const noexcept { return m_id == other.m_id; }
+        constexpr bool operator !=(StringId const &other) const noexcept { return m_id != other.m_id; }
+    };
+}
+
+
+namespace std {
+    template<> struct hash<suzu::sdk::StringId> {
+        size_t operator ()(suzu::sdk::StringId const &id) const noexcept {
+            return std::hash<uint32_t>{}(id.value());
+        }
+    };
+}
+
+
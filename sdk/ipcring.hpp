@@ -0,0 +1,283 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  ipcring.hpp
+ * \brief single-producer/single-consumer message ring for shared memory
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+
+/**
+ * \namespace suzu::sdk::ipc
+ * \brief     transport between the application and out-of-process plug-in hosts
+ *
+ * The application and a plug-in host share one memory segment containing two message rings, one
+ * per direction. Messages are appended to a ring without any system call and become visible to the
+ * reader in batches, when the writer calls *flush()*. A (comparatively expensive) wake-up signal is
+ * only required if the reader went to sleep because its ring was empty.
+ */
+namespace suzu::sdk::ipc {
+    /**
+     * \enum  suzu::sdk::ipc::MessageType
+     * \brief types of messages exchanged with a plug-in host
+     */
+    enum MessageType : uint32_t {
+        Wrap     = 0, /**< (only used internally) skip to the beginning of the ring */
+        Hello,        /**< host to application: the plug-in was loaded; payload is an *ErrorCode* (int32) */
+        Shutdown,     /**< application to host: unload the plug-in and exit */
+        Ping,         /**< application to host: request a *Pong* with the same payload */
+        Pong,         /**< host to application: reply to *Ping* */
+        Changes,      /**< application to host: payload is an array of *suzu::sdk::ChangeRecord* */
+        ChangeResult, /**< host to application: reply to *Changes*; payload is an *ErrorCode* (int32) */
+
+        __NumMessageTypes__ /**< (only used internally) */
+    };
+
+
+    /**
+     * \struct suzu::sdk::ipc::MessageHeader
+     * \brief  header preceding every message in a ring
+     */
+    struct MessageHeader {
+        uint32_t type; /**< message type, see *suzu::sdk::ipc::MessageType* */
+        uint32_t size; /**< size of the payload, in bytes */
+    };
+
+    /**
+     * \struct suzu::sdk::ipc::RingControl
+     * \brief  shared state of a ring, stored at the beginning of the ring's memory
+     *
+     * Positions grow monotonically; the offset into the data area is the position modulo the
+     * capacity. Reader and writer positions are kept on separate cache lines.
+     */
+    struct RingControl {
+        alignas(64) std::atomic<uint64_t> head;     /**< read position; written by the reader only */
+        alignas(64) std::atomic<uint64_t> tail;     /**< published write position; written by the writer only */
+        alignas(64) std::atomic<uint32_t> sleeping; /**< set by the reader before it waits for a signal */
+        uint64_t                          capacity; /**< size of the data area, in bytes */
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "rings in shared memory require lock-free atomics");
+
+
+    /**
+     * \class suzu::sdk::ipc::MessageRing
+     * \brief view on a ring stored in (shared) memory
+     *
+     * Only one thread may write to, and only one thread may read from a ring at a time.
+     */
+    class MessageRing {
+        static constexpr uint64_t gl_align = 8; /**< alignment of messages within the ring */
+
+        RingControl *m_ctl;  /**< shared state */
+        char        *m_data; /**< beginning of the data area */
+        uint64_t     m_next; /**< writer-local write position; published by *flush()* */
+
+    public:
+        MessageRing() noexcept
+            : m_ctl(nullptr), m_data(nullptr), m_next(0)
+        { }
+
+        /**
+         * \brief  computes the number of bytes required to store a ring
+         *
+         * \param  [in] capacity size of the data area, in bytes; multiple of 8
+         *
+         * \return size of the memory block to pass to *Create()*
+         */
+        static constexpr size_t RequiredSize(uint64_t const capacity) noexcept {
+            return sizeof(RingControl) + static_cast<size_t>(capacity);
+        }
+
+        /**
+         * \brief  initializes a new, empty ring in *mem*
+         *
+         * \param  [in] mem memory block of at least *RequiredSize(capacity)* bytes; aligned to 64 bytes
+         * \param  [in] capacity size of the data area, in bytes; multiple of 8
+         *
+         * \return view on the ring
+         */
+        static MessageRing Create(void *mem, uint64_t const capacity) noexcept {
+            RingControl *const ctl = new (mem) RingControl{};
+            ctl->capacity = capacity;
+
+            return Attach(mem);
+        }
+
+        /**
+         * \brief  attaches to a ring initialized by *Create()*, possibly in another process
+         *
+         * \param  [in] mem memory block containing the ring
+         *
+         * \return view on the ring
+         */
+        static MessageRing Attach(void *mem) noexcept {
+            MessageRing ring;
+            ring.m_ctl  = static_cast<RingControl *>(mem);
+            ring.m_data = static_cast<char *>(mem) + sizeof(RingControl);
+            ring.m_next = ring.m_ctl->tail.load(std::memory_order_acquire);
+
+            return ring;
+        }
+
+        /**
+         * \brief  retrieves whether or not the view refers to a ring
+         *
+         * \return *true* if the view is valid
+         */
+        bool isValid() const noexcept { return m_ctl != nullptr; }
+
+        /**
+         * \brief  appends a message to the ring without publishing it
+         *
+         * \param  [in] type message type
+         * \param  [in] data payload; may be *nullptr* if *size* is 0
+         * \param  [in] size size of the payload, in bytes
+         *
+         * \return *true* if the message was appended, *false* if the ring is full
+         */
+        bool push(uint32_t const type, void const *data, uint32_t const size) noexcept {
+            uint64_t const cap  = m_ctl->capacity;
+            uint64_t const len  = Align(sizeof(MessageHeader) + size);
+            uint64_t const head = m_ctl->head.load(std::memory_order_acquire);
+
+            /* A message never wraps around; the rest of the ring is skipped instead. */
+            uint64_t const offset = m_next % cap;
+            uint64_t const skip   = cap - offset < len ? cap - offset : 0;
+            if (len > cap || m_next + skip + len - head > cap)
+                return false;
+
+            if (skip != 0) {
+                write(offset, { MessageType::Wrap, 0 }, nullptr);
+
+                m_next += skip;
+            }
+
+            write(m_next % cap, { type, size }, data);
+            m_next += len;
+            return true;
+        }
+
+        /**
+         * \brief  publishes all appended messages to the reader
+         *
+         * \return *true* if the reader is waiting for a signal, which the caller has to send
+         */
+        bool flush() noexcept {
+            m_ctl->tail.store(m_next, std::memory_order_seq_cst);
+
+            return m_ctl->sleeping.exchange(0, std::memory_order_seq_cst) != 0;
+        }
+
+        /**
+         * \brief  invokes *fn(type, data, size)* for every published message and consumes them
+         *
+         * \param  [in] fn message handler; *data* is only valid during the call
+         *
+         * \return number of messages consumed
+         */
+        template<class Fn> size_t drain(Fn &&fn) {
+            uint64_t const cap  = m_ctl->capacity;
+            uint64_t const tail = m_ctl->tail.load(std::memory_order_acquire);
+            uint64_t       head = m_ctl->head.load(std::memory_order_relaxed);
+
+            size_t n = 0;
+            while (head != tail) {
+                uint64_t const offset = head % cap;
+
+                MessageHeader hdr;
+                std::memcpy(&hdr, m_data + offset, sizeof(MessageHeader));
+                if (hdr.type == MessageType::Wrap) {
+                    head += cap - offset;
+
+                    continue;
+                }
+
+                fn(hdr.type, static_cast<void const *>(m_data + offset + sizeof(MessageHeader)), hdr.size);
+                head += Align(sizeof(MessageHeader) + hdr.size);
+                ++n;
+            }
+
+            m_ctl->head.store(head, std::memory_order_release);
+            return n;
+        }
+
+        /**
+         * \brief  announces that the reader is about to wait for a signal
+         *
+         * \return *true* if the reader may wait, *false* if messages were published in the meantime
+         */
+        bool prepareSleep() noexcept {
+            m_ctl->sleeping.store(1, std::memory_order_seq_cst);
+            if (m_ctl->tail.load(std::memory_order_seq_cst) == m_ctl->head.load(std::memory_order_relaxed))
+                return true;
+
+            m_ctl->sleeping.store(0, std::memory_order_relaxed);
+            return false;
+        }
+
+    private:
+        static constexpr uint64_t Align(uint64_t const len) noexcept {
+            return (len + gl_align - 1) & ~(gl_align - 1);
+        }
+
+        void write(uint64_t const offset, MessageHeader const &hdr, void const *data) noexcept {
+            std::memcpy(m_data + offset, &hdr, sizeof(MessageHeader));
+            if (hdr.size != 0)
+                std::memcpy(m_data + offset + sizeof(MessageHeader), data, hdr.size);
+        }
+    };
+
+
+    /**
+     * \struct suzu::sdk::ipc::ChannelLayout
+     * \brief  layout of the memory segment shared with a plug-in host
+     *
+     * The segment holds the ring from the application to the host, followed by the ring from the
+     * host to the application.
+     */
+    struct ChannelLayout {
+        static constexpr uint64_t gl_capacity = 1 << 20; /**< capacity of each ring, in bytes */
+
+        /**
+         * \brief  retrieves the size of the shared segment
+         *
+         * \return size, in bytes
+         */
+        static constexpr size_t Size() noexcept { return 2 * MessageRing::RequiredSize(gl_capacity); }
+
+        /**
+         * \brief  retrieves the memory of the ring from the application to the host
+         *
+         * \param  [in] base beginning of the segment
+         *
+         * \return pointer to the ring
+         */
+        static void *Requests(void *base) noexcept { return base; }
+
+        /**
+         * \brief  retrieves the memory of the ring from the host to the application
+         *
+         * \param  [in] base beginning of the segment
+         *
+         * \return pointer to the ring
+         */
+        static void *Replies(void *base) noexcept { return static_cast<char *>(base) + MessageRing::RequiredSize(gl_capacity); }
+    };
+}
+
+
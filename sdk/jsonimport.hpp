@@ -0,0 +1,401 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  jsonimport.hpp
+ * \brief streaming import of diagrams from JSON documents
+ *
+ * Diagrams exported by other tools are read in the following form:
+ *
+ *     {
+ *         "name": "Overview",
+ *         "elements": [
+ *             { "id": "p", "kind": "package", "bounds": [0, 0, 400, 300], "name": "model" },
+ *             { "id": 7, "kind": "class", "bounds": [20, 40, 120, 80], "parent": "p", "style": 2, "locked": true }
+ *         ]
+ *     }
+ *
+ * *kind* and *bounds* (x, y, width, height) are required; *id*, *parent*, *name*, *style*,
+ * *hidden* and *locked* are optional. Parents may be referenced before they are defined. Keys
+ * that are not listed here are skipped, whatever their value.
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/* external includes */
+#include <sdk/external/json/nlohmann/json.hpp>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/intern.hpp>
+#include <sdk/util.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \class suzu::sdk::JsonDiagramImporter
+     * \brief SAX handler building the elements of a diagram while the document is parsed
+     *
+     * No DOM is built: every element is created as soon as its object has been read, so the
+     * memory needed besides the diagram itself is bounded by the largest element object. Only the
+     * ids of the elements are kept until the end, to resolve parent references.
+     */
+    class JsonDiagramImporter {
+        /**
+         * \enum  suzu::sdk::JsonDiagramImporter::State
+         * \brief position of the parser in the document
+         */
+        enum class State {
+            Root,     /**< before the document */
+            Document, /**< in the document object */
+            Elements, /**< in the *elements* array */
+            Element,  /**< in an element object */
+            Bounds,   /**< in the *bounds* array of an element */
+            Done      /**< after the document */
+        };
+
+        /**
+         * \struct suzu::sdk::JsonDiagramImporter::Pending
+         * \brief  values of the element object being read
+         */
+        struct Pending {
+            uint32_t    kind;    /**< kind of the element; *__NumElementKinds__* if not given */
+            ElementRect bounds;  /**< bounding box */
+            uint32_t    nbounds; /**< number of values read into *bounds* */
+            uint32_t    style;   /**< style id */
+            uint32_t    flags;   /**< *suzu::sdk::ElementFlags* */
+            std::string name;    /**< name of the element */
+            std::string id;      /**< id of the element; empty if it has none */
+            std::string parent;  /**< id of the parent; empty if it has none */
+        };
+
+        static constexpr uint32_t gl_nokind = static_cast<uint32_t>(ElementKind::__NumElementKinds__); /**< marks elements without kind */
+
+        ElementStore                                       &m_store;   /**< receives the elements */
+        State                                               m_state;   /**< current position */
+        uint32_t                                            m_skip;    /**< nesting depth within a skipped value; 0 if not skipping */
+        std::string                                         m_key;     /**< key of the current value */
+        Pending                                             m_element; /**< element being read */
+        std::string                                         m_name;    /**< name of the diagram */
+        std::string                                         m_error;   /**< description of the first error */
+        std::unordered_map<std::string, ElementHandle>      m_ids;     /**< elements, by id */
+        std::vector<std::pair<ElementHandle, std::string>>  m_parents; /**< parent id of every element that has a parent */
+
+    public:
+        /**
+         * \brief constructs a new importer
+         *
+         * \param [in] store receives the elements; must be empty
+         */
+        explicit JsonDiagramImporter(ElementStore &store) noexcept
+            : m_store(store), m_state(State::Root), m_skip(0), m_element{ gl_nokind, {}, 0, 0, 0, {}, {}, {} }
+        { }
+
+        /**
+         * \brief  links every element to its parent once the whole document has been read
+         *
+         * \return *true* if all parents exist
+         * \throw  std::bad_alloc
+         */
+        bool finish() {
+            if (m_state != State::Done)
+                return fail("incomplete document");
+
+            for (auto const &[handle, parent] : m_parents) {
+                auto const it = m_ids.find(parent);
+                if (it == m_ids.end() || it->second == handle)
+                    return fail("invalid parent \"" + parent + "\"");
+
+                m_store.parents()[m_store.indexOf(handle)] = it->second;
+            }
+
+            m_ids.clear();
+            m_parents.clear();
+            return true;
+        }
+
+        std::string const &name() const noexcept  { return m_name; }
+        std::string const &error() const noexcept { return m_error; }
+
+        /*
+         * SAX interface, see *nlohmann::json_sax*. Returning *false* stops the parser.
+         */
+        bool null() { return scalar(); }
+        bool boolean(bool const value) {
+            if (m_skip != 0 || m_state != State::Element)
+                return scalar();
+
+            uint32_t const flag = m_key == "hidden" ? static_cast<uint32_t>(ElementHidden) : m_key == "locked" ? static_cast<uint32_t>(ElementLocked) : 0u;
+            m_element.flags = value ? m_element.flags | flag : m_element.flags & ~flag;
+            return true;
+        }
+        bool number_integer(nlohmann::json::number_integer_t const value) {
+            return number(static_cast<double>(value), value >= 0 && static_cast<uint64_t>(value) <= UINT32_MAX, std::to_string(value));
+        }
+        bool number_unsigned(nlohmann::json::number_unsigned_t const value) {
+            return number(static_cast<double>(value), value <= UINT32_MAX, std::to_string(value));
+        }
+        bool number_float(nlohmann::json::number_float_t const value, nlohmann::json::string_t const &) {
+            return number(value, false, {});
+        }
+        bool string(nlohmann::json::string_t &value) {
+            if (m_skip != 0)
+                return true;
+
+            if (m_state == State::Document) {
+                if (m_key == "name")
+                    m_name = std::move(value);
+                return true;
+            } else if (m_state != State::Element)
+                return scalar();
+
+            if (m_key == "kind") {
+                m_element.kind = KindOf(value);
+                if (m_element.kind == gl_nokind)
+                    return fail("unknown element kind \"" + value + "\"");
+            } else if (m_key == "name")
+                m_element.name = std::move(value);
+            else if (m_key == "id")
+                m_element.id = std::move(value);
+            else if (m_key == "parent")
+                m_element.parent = std::move(value);
+            return true;
+        }
+        bool binary(nlohmann::json::binary_t &) { return scalar(); }
+
+        bool start_object(std::size_t) {
+            if (m_skip != 0) {
+                ++m_skip;
+
+                return true;
+            }
+
+            switch (m_state) {
+                case State::Root:
+                    m_state = State::Document;
+                    return true;
+                case State::Elements:
+                    m_element = { gl_nokind, {}, 0, 0, 0, {}, {}, {} };
+                    m_state   = State::Element;
+                    return true;
+                case State::Document:
+                case State::Element:
+                    m_skip = 1;
+                    return true;
+                default:
+                    return fail("unexpected object");
+            }
+        }
+        bool end_object() {
+            if (m_skip != 0) {
+                --m_skip;
+
+                return true;
+            } else if (m_state == State::Document) {
+                m_state = State::Done;
+
+                return true;
+            }
+
+            m_state = State::Elements;
+            return create();
+        }
+        bool start_array(std::size_t) {
+            if (m_skip != 0) {
+                ++m_skip;
+
+                return true;
+            }
+
+            if (m_state == State::Document && m_key == "elements")
+                m_state = State::Elements;
+            else if (m_state == State::Element && m_key == "bounds")
+                m_state = State::Bounds;
+            else if (m_state == State::Document || m_state == State::Element)
+                m_skip = 1;
+            else
+                return fail("unexpected array");
+            return true;
+        }
+        bool end_array() {
+            if (m_skip != 0) {
+                --m_skip;
+
+                return true;
+            } else if (m_state == State::Elements) {
+                m_state = State::Document;
+
+                return true;
+            }
+
+            m_state = State::Element;
+            return m_element.nbounds == 4 || fail("bounds need four values");
+        }
+        bool key(nlohmann::json::string_t &key) {
+            if (m_skip == 0)
+                m_key = std::move(key);
+
+            return true;
+        }
+        bool parse_error(std::size_t, std::string const &, nlohmann::json::exception const &ex) {
+            return fail(ex.what());
+        }
+
+    private:
+        /**
+         * \brief  handles a number
+         *
+         * \param  [in] value value of the number
+         * \param  [in] index whether or not the number is a valid style id
+         * \param  [in] text number as an id; empty if it cannot be used as one
+         *
+         * \return *true* to continue parsing
+         * \throw  std::bad_alloc
+         */
+        bool number(double const value, bool const index, std::string text) {
+            if (m_skip != 0)
+                return true;
+
+            if (m_state == State::Bounds) {
+                if (m_element.nbounds == 4)
+                    return fail("bounds need four values");
+
+                float *const fields[] = { &m_element.bounds.x, &m_element.bounds.y, &m_element.bounds.w, &m_element.bounds.h };
+                *fields[m_element.nbounds++] = static_cast<float>(value);
+                return true;
+            } else if (m_state != State::Element)
+                return scalar();
+
+            if (m_key == "style") {
+                if (!index)
+                    return fail("invalid style");
+
+                m_element.style = static_cast<uint32_t>(value);
+            } else if (m_key == "id" || m_key == "parent") {
+                if (text.empty())
+                    return fail("invalid " + m_key);
+
+                (m_key == "id" ? m_element.id : m_element.parent) = std::move(text);
+            }
+            return true;
+        }
+
+        /**
+         * \brief  handles a value that is not used
+         *
+         * \return *true* if the value may be skipped at the current position
+         */
+        bool scalar() {
+            return m_skip != 0 || m_state == State::Document || m_state == State::Element || fail("unexpected value");
+        }
+
+        /**
+         * \brief  creates the element that has just been read
+         *
+         * \return *true* if the element is complete
+         * \throw  std::bad_alloc, std::length_error
+         */
+        bool create() {
+            if (m_element.kind == gl_nokind)
+                return fail("element without kind");
+            else if (m_element.nbounds != 4)
+                return fail("element without bounds");
+
+            ElementHandle const handle = m_store.create(static_cast<ElementKind>(m_element.kind), m_element.bounds, m_element.style, gl_nullelement, StringId(m_element.name));
+            m_store.flags()[m_store.size() - 1] = m_element.flags;
+
+            if (!m_element.id.empty() && !m_ids.try_emplace(std::move(m_element.id), handle).second)
+                return fail("duplicate element id");
+            if (!m_element.parent.empty())
+                m_parents.emplace_back(handle, std::move(m_element.parent));
+            return true;
+        }
+
+        /**
+         * \brief  records an error
+         *
+         * \param  [in] error description of the error
+         *
+         * \return *false*, to stop the parser
+         */
+        bool fail(std::string error) {
+            if (m_error.empty())
+                m_error = std::move(error);
+
+            return false;
+        }
+
+        /**
+         * \brief  maps the name of a kind to the kind
+         *
+         * \param  [in] name name of the kind, e.g. "class" (see *suzu::sdk::gl_kindnames*)
+         *
+         * \return *suzu::sdk::ElementKind*; *gl_nokind* if the name is unknown
+         */
+        static uint32_t KindOf(std::string_view const name) noexcept {
+            ElementKind kind;
+
+            return KindOfName(name, kind) ? static_cast<uint32_t>(kind) : gl_nokind;
+        }
+    };
+
+
+    /**
+     * \brief  imports a diagram from a JSON document, streaming it from a mapping of the file
+     *
+     * \param  [in] path path of the JSON document
+     * \param  [out] store receives the elements; cleared first
+     * \param  [out] name (optional) receives the name of the diagram
+     * \param  [out] error (optional) receives a description of the error, if any
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::OpenFile* if the file
+     *         could not be opened, *suzu::sdk::ErrorCode::ReadFile* if it is not a valid diagram,
+     *         or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out; *store* is empty then
+     * \note   Comments are allowed in the document.
+     */
+    inline ErrorCode ImportJsonDiagram(char const *const path, ElementStore &store, std::string *const name = nullptr, std::string *const error = nullptr) noexcept {
+        store.clear();
+
+        ErrorCode err = ErrorCode::ReadFile;
+        try {
+            util::MappedFile file;
+            err = util::MapFile(path, file);
+            if (err == ErrorCode::Ok) {
+                JsonDiagramImporter importer(store);
+
+                bool const ok = nlohmann::json::sax_parse(file.data(), file.data() + file.size(), &importer, nlohmann::json::input_format_t::json, true, true) && importer.finish();
+                if (ok && name != nullptr)
+                    *name = importer.name();
+                if (!ok && error != nullptr)
+                    *error = importer.error();
+                err = ok ? ErrorCode::Ok : ErrorCode::ReadFile;
+            } else if (error != nullptr)
+                *error = "could not read file";
+        } catch (...) {
+            err = ErrorCode::CriticalResource;
+        }
+
+        if (err != ErrorCode::Ok)
+            store.clear();
+        return err;
+    }
+}
+
+
@@ -0,0 +1,367 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  layeredconfig.hpp
+ * \brief stack of configuration layers with a merged, pre-flattened view
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/config.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \class suzu::sdk::LayeredConfiguration
+     * \brief stack of configuration objects where higher layers override lower layers
+     *
+     * Typical stacks consist of built-in defaults, the global configuration, the user configuration,
+     * and the configuration of the current project, in that order. Objects are merged recursively;
+     * any other value (including arrays) of a higher layer replaces whatever lower layers store at
+     * the same path.
+     *
+     * The merged result is kept as a flat table mapping the JSON pointer of every non-object value to
+     * the value itself. Lookups therefore cost one hash lookup, regardless of how many layers there
+     * are. When a layer changes, only the entries at or below the written paths are resolved again.
+     * Like *suzu::sdk::Configuration*, the table is stored as immutable generations; readers never
+     * wait for updates.
+     *
+     * \note  The merged view is updated when the change notifications of the layers are delivered,
+     *        i.e. on the next iteration of the application's event loop.
+     * \note  Only non-object values can be looked up. To retrieve whole objects, use *merged()*.
+     */
+    class LayeredConfiguration {
+        /**
+         * \brief flattened generation of the merged view; maps JSON pointers to values
+         */
+        using View = std::unordered_map<std::string, JSON>;
+
+        std::vector<std::shared_ptr<Configuration>> m_layers;  /**< layers, lowest priority first */
+        std::vector<ConfigObserverId>               m_subs;    /**< subscriptions, one per layer */
+        std::shared_ptr<View const>                 m_view;    /**< current merged view; only accessed atomically */
+        QMutex                                      m_wrlock;  /**< serializes updates of the view */
+        std::shared_ptr<internal::ConfigNotifier>   m_notify;  /**< change notification channel */
+
+    public:
+        /**
+         * \brief constructs a new layered configuration
+         *
+         * \param [in] layers configuration layers, ordered from lowest to highest priority;
+         *        *nullptr* entries are ignored
+         */
+        explicit LayeredConfiguration(std::vector<std::shared_ptr<Configuration>> layers) noexcept
+            : m_view(std::make_shared<View const>()), m_notify(std::make_shared<internal::ConfigNotifier>())
+        {
+            try {
+                for (std::shared_ptr<Configuration> &layer : layers)
+                    if (layer != nullptr)
+                        m_layers.push_back(std::move(layer));
+
+                for (std::shared_ptr<Configuration> const &layer : m_layers)
+                    m_subs.push_back(layer->subscribe("", [this](std::vector<std::string> const &paths) { update(paths); }));
+
+                update({ std::string{} });
+            } catch (...) { }
+        }
+        LayeredConfiguration(LayeredConfiguration const &) = delete;
+        LayeredConfiguration &operator =(LayeredConfiguration const &) = delete;
+
+        ~LayeredConfiguration() {
+            for (size_t i = 0; i < m_subs.size(); ++i)
+                m_layers[i]->unsubscribe(m_subs[i]);
+        }
+
+
+        /**
+         * \brief  retrieves the number of layers
+         *
+         * \return number of layers
+         */
+        size_t layerCount() const noexcept { return m_layers.size(); }
+        /**
+         * \brief  retrieves the layer at *index*, e.g. to modify it
+         *
+         * \param  [in] index layer index; 0 is the layer with the lowest priority
+         *
+         * \return layer configuration
+         * \note   *index* must be smaller than *layerCount()*.
+         */
+        Configuration &layer(size_t const index) const noexcept { return *m_layers[index]; }
+
+
+        /**
+         * \brief  retrieves the merged value referred to by *key*, converted to *TargetVal*
+         *
+         * \param  [in] key pre-compiled key of the desired value
+         * \param  [in] fallback value returned if the key does not exist, refers to an object,
+         *         or has the wrong type
+         *
+         * \return converted value
+         */
+        template<class TargetVal> TargetVal get(ConfigKey const &key, TargetVal fallback) const noexcept {
+            static_assert(!std::is_same_v<TargetVal, std::string_view>, "views cannot outlive the merged view");
+
+            std::shared_ptr<View const> const view = std::atomic_load_explicit(&m_view, std::memory_order_acquire);
+
+            auto const it = view->find(key.str());
+            return it == view->end() ? fallback : JSONCVT::to(it->second, std::move(fallback));
+        }
+
+        /**
+         * \brief  retrieves the raw merged value referred to by *key*
+         *
+         * \param  [in] key pre-compiled key of the desired value
+         *
+         * \return copy of the raw JSON value, *suzu::sdk::ErrorCode::InvalidParameter* if it does
+         *         not exist, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out
+         */
+        Result<JSON> lookup(ConfigKey const &key) const noexcept {
+            try {
+                std::shared_ptr<View const> const view = std::atomic_load_explicit(&m_view, std::memory_order_acquire);
+
+                auto const it = view->find(key.str());
+                if (it == view->end())
+                    return ErrorCode::InvalidParameter;
+
+                return it->second;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  retrieves the raw merged value referred to by *key*
+         *
+         * \param  [in] key pre-compiled key of the desired value
+         *
+         * \return raw JSON value; on error this return value's *is_discarded()* method will return
+         *         *true*
+         * \note   Prefer *lookup()*, which tells why no value was found.
+         */
+        JSON getValue(ConfigKey const &key) const noexcept {
+            try {
+                return lookup(key).valueOr(JSON(JSON::value_t::discarded));
+            } catch (...) { }
+
+            return JSON(JSON::value_t::discarded);
+        }
+
+        /**
+         * \brief  checks whether the merged value referred to by *key* exists
+         *
+         * \param  [in] key pre-compiled key of the value
+         *
+         * \return *true* if the key exists in any layer
+         */
+        bool contains(ConfigKey const &key) const noexcept {
+            std::shared_ptr<View const> const view = std::atomic_load_explicit(&m_view, std::memory_order_acquire);
+
+            return view->find(key.str()) != view->end();
+        }
+
+        /**
+         * \brief  assembles the whole merged document
+         *
+         * \return merged document; an empty object on error
+         * \note   This is comparatively expensive, as the document is rebuilt from the flat view.
+         */
+        JSON merged() const noexcept {
+            try {
+                std::shared_ptr<View const> const view = std::atomic_load_explicit(&m_view, std::memory_order_acquire);
+
+                JSON doc = JSON::object();
+                for (auto const &[path, val] : *view) {
+                    JSON *curr = &doc;
+
+                    /* Follow the path token by token; all intermediate values are objects. */
+                    for (size_t pos = 0; pos < path.length(); ) {
+                        size_t const end = std::min(path.find('/', pos + 1), path.length());
+
+                        curr = &(*curr)[Unescape(path.substr(pos + 1, end - pos - 1))];
+                        pos  = end;
+                    }
+
+                    *curr = val;
+                }
+
+                return doc;
+            } catch (...) { }
+
+            return JSON::object();
+        }
+
+
+        /**
+         * \brief  registers an observer for all merged values at or below *prefix*
+         *
+         * \param  [in] prefix JSON pointer prefix; "" subscribes to the whole document
+         * \param  [in] fn callback to invoke
+         *
+         * \return subscription id, or 0 on error
+         * \note   Observers are notified after the merged view has been updated. Paths are
+         *         reported as written to the layers, even if a higher layer shadows the write.
+         */
+        ConfigObserverId subscribe(char const *const prefix, ConfigObserver fn) noexcept {
+            try {
+                return m_notify->subscribe(prefix, std::move(fn));
+            } catch (...) { }
+
+            return 0;
+        }
+        /**
+         * \brief removes the subscription identified by *id*
+         *
+         * \param [in] id subscription id returned by *subscribe()*
+         */
+        void unsubscribe(ConfigObserverId const id) noexcept {
+            try {
+                m_notify->unsubscribe(id);
+            } catch (...) { }
+        }
+
+    private:
+        /**
+         * \brief resolves all entries affected by writes to *paths* and publishes the result
+         *
+         * \param [in] paths JSON pointers written to any of the layers
+         */
+        void update(std::vector<std::string> const &paths) noexcept {
+            try {
+                {
+                    QMutexLocker lock(&m_wrlock);
+
+                    std::vector<ConfigSnapshot> snaps;
+                    for (std::shared_ptr<Configuration> const &layer : m_layers)
+                        snaps.push_back(layer->snapshot());
+
+                    auto next = std::make_shared<View>(*std::atomic_load_explicit(&m_view, std::memory_order_relaxed));
+                    for (std::string const &path : paths)
+                        Resolve(*next, snaps, RegionOf(*next, path));
+
+                    std::atomic_store_explicit(&m_view, std::shared_ptr<View const>{ std::move(next) }, std::memory_order_release);
+                }
+
+                m_notify->post(std::vector<std::string>{ paths });
+            } catch (...) { }
+        }
+
+        /**
+         * \brief  determines the part of the view that has to be resolved after a write to *path*
+         *
+         * If an ancestor of *path* has been resolved to a non-object value, the write may turn it
+         * into an object; the region then starts at the outermost such ancestor.
+         *
+         * \param  [in] view current view
+         * \param  [in] path written JSON pointer
+         *
+         * \return JSON pointer of the region root
+         */
+        static std::string RegionOf(View const &view, std::string const &path) {
+            for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1))
+                if (std::string prefix = path.substr(0, pos); view.count(prefix) != 0)
+                    return prefix;
+
+            return path;
+        }
+
+        /**
+         * \brief re-resolves all entries at or below *root*
+         *
+         * \param [in,out] view view to update
+         * \param [in] snaps snapshots of all layers, lowest priority first
+         * \param [in] root JSON pointer of the region to resolve
+         */
+        static void Resolve(View &view, std::vector<ConfigSnapshot> const &snaps, std::string const &root) {
+            /* Drop the previous resolution of the region. */
+            for (auto it = view.begin(); it != view.end(); )
+                if (it->first.compare(0, root.length(), root) == 0 && (it->first.length() == root.length() || it->first[root.length()] == '/'))
+                    it = view.erase(it);
+                else
+                    ++it;
+
+            /* Visit the layers top-down; the first layer to define a path wins. */
+            ConfigKey const                 key{ root.c_str() };
+            std::unordered_set<std::string> interior;
+            std::string                     path = root;
+            for (auto it = snaps.rbegin(); it != snaps.rend(); ++it)
+                if (JSON const *val = it->find(key))
+                    Merge(view, interior, path, *val);
+        }
+
+        /**
+         * \brief adds all values of *val* that are not shadowed by higher layers to *view*
+         *
+         * \param [in,out] view view to update
+         * \param [in,out] interior paths already claimed as objects by higher layers
+         * \param [in,out] path JSON pointer of *val*; restored when the function returns
+         * \param [in] val value to merge
+         */
+        static void Merge(View &view, std::unordered_set<std::string> &interior, std::string &path, JSON const &val) {
+            /* A higher layer has already resolved this path to a non-object value. */
+            if (view.count(path) != 0)
+                return;
+
+            if (!val.is_object()) {
+                /* Empty configurations store *null* instead of an empty root object. */
+                if (!path.empty() && interior.count(path) == 0)
+                    view.emplace(path, val);
+
+                return;
+            }
+
+            interior.insert(path);
+            for (auto const &[name, child] : val.items()) {
+                size_t const len = path.length();
+
+                path.push_back('/');
+                for (char const c : name)
+                    if (c == '~')
+                        path.append("~0");
+                    else if (c == '/')
+                        path.append("~1");
+                    else
+                        path.push_back(c);
+                Merge(view, interior, path, child);
+
+                path.resize(len);
+            }
+        }
+
+        /**
+         * \brief  unescapes a single JSON pointer reference token
+         *
+         * \param  [in] token escaped token
+         *
+         * \return unescaped token
+         */
+        static std::string Unescape(std::string const &token) {
+            std::string res;
+
+            for (size_t i = 0; i < token.length(); ++i)
+                if (token[i] == '~' && i + 1 < token.length())
+                    res.push_back(token[++i] == '0' ? '~' : '/');
+                else
+                    res.push_back(token[i]);
+
+            return res;
+        }
+    };
+}
+
+
@@ -0,0 +1,877 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  layout.hpp
+ * \brief hierarchical (layered) auto-layout of class diagrams
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+#include <sdk/spatial.hpp>
+#include <sdk/task.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \struct suzu::sdk::LayoutEdge
+     * \brief  directed edge of a layout graph, e.g. from a base class to a derived class
+     */
+    struct LayoutEdge {
+        uint32_t from; /**< node placed above */
+        uint32_t to;   /**< node placed below */
+    };
+
+    /**
+     * \struct suzu::sdk::LayoutOptions
+     * \brief  parameters of *suzu::sdk::HierarchicalLayout*
+     */
+    struct LayoutOptions {
+        float    layergap     = 60.0f; /**< vertical distance between layers */
+        float    nodegap      = 30.0f; /**< horizontal distance between nodes of a layer */
+        float    componentgap = 80.0f; /**< distance between connected components */
+        uint32_t sweeps       = 12;    /**< number of crossing minimization sweeps */
+        uint32_t refinements  = 4;     /**< number of coordinate refinement passes */
+        bool     parallel     = true;  /**< whether or not to use the task scheduler */
+    };
+
+    /**
+     * \struct suzu::sdk::LayoutTimings
+     * \brief  time spent in every stage of a layout run, in microseconds
+     */
+    struct LayoutTimings {
+        int64_t components = 0; /**< splitting the graph into connected components */
+        int64_t layout     = 0; /**< cycle removal, layering, crossing minimization and coordinates */
+        int64_t packing    = 0; /**< arranging the components */
+    };
+
+    /**
+     * \struct suzu::sdk::LayoutState
+     * \brief  layering of a previous layout, kept for incremental updates
+     *
+     * Every layer of every component is a horizontal *band*. Nodes are identified by their index,
+     * like in *suzu::sdk::HierarchicalLayout::Run()*.
+     */
+    struct LayoutState {
+        static constexpr uint32_t gl_none = UINT32_MAX; /**< marks nodes without band and missing neighbor bands */
+
+        /**
+         * \struct suzu::sdk::LayoutState::Band
+         * \brief  a single layer of a component
+         */
+        struct Band {
+            float    top;    /**< top edge */
+            float    height; /**< height of the highest node of the layer at the time it was laid out */
+            uint32_t above;  /**< band of the layer above in the same component; *gl_none* if none */
+            uint32_t below;  /**< band of the layer below in the same component; *gl_none* if none */
+        };
+
+        std::vector<uint32_t> band;  /**< band, by node */
+        std::vector<Band>     bands; /**< all bands */
+
+        /**
+         * \brief removes a node by moving the last node into its place
+         *
+         * This mirrors how *suzu::sdk::ElementStore* fills the hole of a destroyed element, so the
+         * state can be indexed by dense indices.
+         *
+         * \param [in] v node to remove; ignored if out of range
+         */
+        void erase(uint32_t const v) noexcept {
+            if (v >= band.size())
+                return;
+
+            band[v] = band.back();
+            band.pop_back();
+        }
+
+        void clear() noexcept {
+            band  = {};
+            bands = {};
+        }
+    };
+
+
+    /**
+     * \class suzu::sdk::HierarchicalLayout
+     * \brief Sugiyama-style layered layout
+     *
+     * The graph is split into connected components, which are laid out independently and then
+     * packed into rows. Every component goes through the classic stages:
+     *  1. *cycle removal*: edges closing a cycle in depth-first order are reversed;
+     *  2. *layering*: longest-path layering; edges spanning several layers are split by dummy nodes;
+     *  3. *crossing minimization*: barycenter sweeps; the best ordering found is kept;
+     *  4. *coordinate assignment*: nodes are pulled towards the barycenter of their neighbors while
+     *     keeping the order and gaps of their layer.
+     *
+     * Components are distributed over the task scheduler. Within a large component, the sweeps
+     * alternately reorder all odd and all even layers against their (fixed) neighbor layers; as
+     * layers of the same parity never share edges, they are reordered in parallel. Since the order
+     * of operations does not depend on the number of threads, the result is deterministic.
+     *
+     * After a full layout, *Update()* places added or changed nodes into the layers recorded in a
+     * *suzu::sdk::LayoutState* without moving any other node, so the diagram stays recognizable.
+     *
+     * \note  If no scheduler is attached to the instance, everything runs on the calling thread.
+     */
+    class HierarchicalLayout {
+        static constexpr size_t   gl_parallelmin = 2048;       /**< nodes of a component from which its layers are processed in parallel */
+        static constexpr uint32_t gl_none        = UINT32_MAX; /**< marks unset indices */
+
+        /**
+         * \struct suzu::sdk::HierarchicalLayout::Component
+         * \brief  connected component of the input graph
+         */
+        struct Component {
+            std::vector<uint32_t>                      nodes;   /**< input nodes, by local index */
+            std::vector<std::pair<uint32_t, uint32_t>> edges;   /**< edges between local indices */
+            float                                      w;       /**< width of the laid-out component */
+            float                                      h;       /**< height of the laid-out component */
+            float                                      y;       /**< top edge of the component, once packed */
+            std::vector<uint32_t>                      layer;   /**< layer, by local index */
+            std::vector<float>                         tops;    /**< top edge of every layer, relative to the component */
+            std::vector<float>                         heights; /**< height of every layer */
+        };
+
+        /**
+         * \struct suzu::sdk::HierarchicalLayout::Graph
+         * \brief  proper layered graph of a component, including dummy nodes
+         */
+        struct Graph {
+            std::vector<uint32_t>              layer; /**< layer, by vertex */
+            std::vector<float>                 width; /**< width, by vertex; 0 for dummy nodes */
+            std::vector<std::vector<uint32_t>> up;    /**< neighbors in the layer above, by vertex */
+            std::vector<std::vector<uint32_t>> down;  /**< neighbors in the layer below, by vertex */
+            std::vector<std::vector<uint32_t>> order; /**< vertices, by layer and position */
+            std::vector<uint32_t>              pos;   /**< position in its layer, by vertex */
+        };
+
+    public:
+        /**
+         * \brief  lays out a graph
+         *
+         * \param  [in,out] nodes bounds of all nodes; the sizes are read, the positions are written
+         * \param  [in] edges edges between indices into *nodes*; self-loops are ignored
+         * \param  [in] opts layout parameters
+         * \param  [out] timings optional time spent per stage
+         * \param  [out] state optional layering, for later calls to *Update()*
+         *
+         * \return *ErrorCode::Ok* on success, *ErrorCode::InvalidParameter* if an edge refers to a
+         *         missing node, or *ErrorCode::CriticalResource* if memory ran out; *nodes* and
+         *         *state* are left unchanged on failure
+         */
+        static ErrorCode Run(std::vector<ElementRect> &nodes, std::vector<LayoutEdge> const &edges, LayoutOptions const &opts = {}, LayoutTimings *timings = nullptr, LayoutState *state = nullptr) noexcept {
+            for (LayoutEdge const &edge : edges)
+                if (edge.from >= nodes.size() || edge.to >= nodes.size())
+                    return ErrorCode::InvalidParameter;
+
+            try {
+                auto const start = std::chrono::steady_clock::now();
+                std::vector<Component> comps = Split(nodes.size(), edges);
+                auto const split = std::chrono::steady_clock::now();
+
+                /* Every component writes to its own nodes only. */
+                std::vector<ElementRect> res(nodes);
+                ParallelFor(comps.size(), opts.parallel, [&](size_t const i) { LayoutComponent(comps[i], res, opts); });
+                auto const laid = std::chrono::steady_clock::now();
+
+                Pack(comps, res, opts);
+                auto const end = std::chrono::steady_clock::now();
+
+                if (state != nullptr) {
+                    LayoutState next;
+                    next.band.resize(nodes.size());
+
+                    for (Component const &comp : comps) {
+                        uint32_t const first = static_cast<uint32_t>(next.bands.size());
+                        uint32_t const count = static_cast<uint32_t>(comp.tops.size());
+
+                        for (uint32_t l = 0; l < count; ++l)
+                            next.bands.push_back({ comp.y + comp.tops[l], comp.heights[l], l > 0 ? first + l - 1 : LayoutState::gl_none, l + 1 < count ? first + l + 1 : LayoutState::gl_none });
+                        for (uint32_t v = 0; v < comp.nodes.size(); ++v)
+                            next.band[comp.nodes[v]] = first + comp.layer[v];
+                    }
+                    *state = std::move(next);
+                }
+                nodes.swap(res);
+                if (timings != nullptr) {
+                    auto const us = [](auto const from, auto const to) {
+                        return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(to - from).count());
+                    };
+
+                    *timings = { us(start, split), us(split, laid), us(laid, end) };
+                }
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  places new and changed nodes without moving any other node
+         *
+         * Nodes with an index beyond the previous layout are new. Both they and the nodes listed in
+         * *changed*, e.g. because their edges changed, are placed one layer below the lowest of
+         * their parents, or else one layer above the highest of their children, reusing the bands
+         * of the previous layout and adding bands where needed. Horizontally, they go to the free
+         * spot of their band closest to the mean position of their neighbors, which is where the
+         * barycenter sweeps would have put them. Nodes without placed neighbors are placed to the
+         * right of the diagram. All other nodes keep their bounds exactly.
+         *
+         * The work grows with the number of placed nodes times the number of nodes, so updates for a
+         * few nodes take well under a millisecond even for large diagrams.
+         *
+         * \param  [in,out] nodes bounds of all nodes; only the positions of placed nodes are written
+         * \param  [in] edges edges between indices into *nodes*
+         * \param  [in] changed nodes to place in addition to the new ones
+         * \param  [in,out] state layering of the previous layout; updated for the placed nodes
+         * \param  [in] opts layout parameters
+         *
+         * \return *ErrorCode::Ok* on success, *ErrorCode::NoOperation* if there was nothing to place,
+         *         *ErrorCode::InvalidParameter* if an index is out of range or *state* has more nodes
+         *         than *nodes*, or *ErrorCode::CriticalResource* if memory ran out
+         */
+        static ErrorCode Update(std::vector<ElementRect> &nodes, std::vector<LayoutEdge> const &edges, std::vector<uint32_t> const &changed, LayoutState &state, LayoutOptions const &opts = {}) noexcept {
+            size_t const n = nodes.size();
+            if (state.band.size() > n)
+                return ErrorCode::InvalidParameter;
+            for (LayoutEdge const &edge : edges)
+                if (edge.from >= n || edge.to >= n)
+                    return ErrorCode::InvalidParameter;
+            for (uint32_t const v : changed)
+                if (v >= n)
+                    return ErrorCode::InvalidParameter;
+
+            try {
+                std::vector<uint32_t> todo(changed);
+                for (uint32_t v = static_cast<uint32_t>(state.band.size()); v < n; ++v)
+                    todo.push_back(v);
+                std::sort(todo.begin(), todo.end());
+                todo.erase(std::unique(todo.begin(), todo.end()), todo.end());
+                if (todo.empty())
+                    return ErrorCode::NoOperation;
+
+                std::vector<uint32_t> band(state.band);
+                band.resize(n, LayoutState::gl_none);
+                for (uint32_t const v : todo)
+                    band[v] = LayoutState::gl_none;
+
+                std::vector<uint32_t> slot(n, LayoutState::gl_none);
+                for (uint32_t i = 0; i < todo.size(); ++i)
+                    slot[todo[i]] = i;
+                std::vector<std::vector<uint32_t>> up(todo.size());
+                std::vector<std::vector<uint32_t>> down(todo.size());
+                for (LayoutEdge const &edge : edges) {
+                    if (edge.from == edge.to)
+                        continue;
+
+                    if (slot[edge.to] != LayoutState::gl_none)
+                        up[slot[edge.to]].push_back(edge.from);
+                    if (slot[edge.from] != LayoutState::gl_none)
+                        down[slot[edge.from]].push_back(edge.to);
+                }
+
+                std::vector<LayoutState::Band> bands(state.bands);
+                std::vector<ElementRect>       res(nodes);
+                std::vector<uint8_t>           done(todo.size(), 0);
+                size_t                         left = todo.size();
+                while (left > 0) {
+                    /* Nodes attached to placed nodes go first; then one detached node starts anew. */
+                    bool progress = false;
+                    for (uint32_t i = 0; i < todo.size(); ++i)
+                        if (!done[i] && PlaceNode(todo[i], up[i], down[i], false, band, bands, res, opts)) {
+                            done[i]  = 1;
+                            progress = true;
+                            --left;
+                        }
+                    if (progress || left == 0)
+                        continue;
+
+                    for (uint32_t i = 0; i < todo.size(); ++i)
+                        if (!done[i]) {
+                            PlaceNode(todo[i], up[i], down[i], true, band, bands, res, opts);
+                            done[i] = 1;
+                            --left;
+
+                            break;
+                        }
+                }
+
+                nodes.swap(res);
+                state.band.swap(band);
+                state.bands.swap(bands);
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+    private:
+        /**
+         * \brief  places a single node next to its placed neighbors
+         *
+         * \param  [in] v node to place
+         * \param  [in] up parents of the node
+         * \param  [in] down children of the node
+         * \param  [in] detached whether to place the node even if it has no placed neighbors
+         * \param  [in,out] band band, by node; *gl_none* for unplaced nodes
+         * \param  [in,out] bands all bands; new bands are appended
+         * \param  [in,out] nodes bounds of all nodes
+         * \param  [in] opts layout parameters
+         *
+         * \return *true* if the node was placed
+         */
+        static bool PlaceNode(uint32_t const v, std::vector<uint32_t> const &up, std::vector<uint32_t> const &down, bool const detached, std::vector<uint32_t> &band, std::vector<LayoutState::Band> &bands, std::vector<ElementRect> &nodes, LayoutOptions const &opts) {
+            uint32_t parent = LayoutState::gl_none;
+            uint32_t child  = LayoutState::gl_none;
+            float    sum    = 0.0f;
+            uint32_t count  = 0;
+            for (uint32_t const w : up)
+                if (band[w] != LayoutState::gl_none) {
+                    if (parent == LayoutState::gl_none || bands[band[w]].top > bands[parent].top)
+                        parent = band[w];
+
+                    sum += nodes[w].x + nodes[w].w * 0.5f;
+                    ++count;
+                }
+            for (uint32_t const w : down)
+                if (band[w] != LayoutState::gl_none) {
+                    if (child == LayoutState::gl_none || bands[band[w]].top < bands[child].top)
+                        child = band[w];
+
+                    sum += nodes[w].x + nodes[w].w * 0.5f;
+                    ++count;
+                }
+            if (count == 0 && !detached)
+                return false;
+
+            ElementRect &rect = nodes[v];
+            uint32_t     b    = LayoutState::gl_none;
+            float        want = 0.0f;
+            if (parent != LayoutState::gl_none) {
+                b = bands[parent].below;
+                if (b == LayoutState::gl_none) {
+                    b = static_cast<uint32_t>(bands.size());
+                    bands.push_back({ bands[parent].top + bands[parent].height + opts.layergap, rect.h, parent, LayoutState::gl_none });
+                    bands[parent].below = b;
+                }
+            } else if (child != LayoutState::gl_none) {
+                b = bands[child].above;
+                if (b == LayoutState::gl_none) {
+                    b = static_cast<uint32_t>(bands.size());
+                    bands.push_back({ bands[child].top - opts.layergap - rect.h, rect.h, LayoutState::gl_none, child });
+                    bands[child].above = b;
+                }
+            } else {
+                /* A detached node starts a band of its own, to the right of and level with the diagram. */
+                float top   = INFINITY;
+                float right = -INFINITY;
+                for (uint32_t w = 0; w < nodes.size(); ++w)
+                    if (band[w] != LayoutState::gl_none) {
+                        top   = std::min(top, nodes[w].y);
+                        right = std::max(right, nodes[w].x + nodes[w].w);
+                    }
+
+                b = static_cast<uint32_t>(bands.size());
+                bands.push_back({ std::isfinite(top) ? top : 0.0f, rect.h, LayoutState::gl_none, LayoutState::gl_none });
+                want = (std::isfinite(right) ? right + opts.componentgap : 0.0f) + rect.w * 0.5f;
+            }
+            if (count > 0)
+                want = sum / static_cast<float>(count);
+
+            LayoutState::Band const &home = bands[b];
+            rect.y = home.top + std::max(0.0f, (home.height - rect.h) * 0.5f);
+
+            /* Collect the horizontal extents of all placed nodes sharing the vertical range. */
+            std::vector<std::pair<float, float>> taken;
+            for (uint32_t w = 0; w < nodes.size(); ++w) {
+                ElementRect const &other = nodes[w];
+
+                if (band[w] != LayoutState::gl_none && other.y < rect.y + rect.h && rect.y < other.y + other.h)
+                    taken.emplace_back(other.x - opts.nodegap, other.x + other.w + opts.nodegap);
+            }
+            std::sort(taken.begin(), taken.end());
+
+            /* Pick the position closest to *want* among all gaps wide enough for the node. */
+            float const ideal = want - rect.w * 0.5f;
+            float       best  = ideal;
+            float       cost  = INFINITY;
+            float       from  = -INFINITY;
+            for (size_t i = 0; i <= taken.size(); ++i) {
+                float const to = i < taken.size() ? taken[i].first : INFINITY;
+                if (to - from >= rect.w) {
+                    float const x = std::clamp(ideal, from, to - rect.w);
+
+                    if (std::abs(x - ideal) < cost) {
+                        best = x;
+                        cost = std::abs(x - ideal);
+                    }
+                }
+                if (i < taken.size())
+                    from = std::max(from, taken[i].second);
+            }
+
+            rect.x  = best;
+            band[v] = b;
+            return true;
+        }
+
+        /**
+         * \brief invokes *fn(i)* for all *i* in [0, *n*), on the task scheduler if *parallel* is set
+         *
+         * \param [in] n number of iterations
+         * \param [in] parallel whether or not to use the scheduler
+         * \param [in] fn loop body
+         */
+        template<class Fn> static void ParallelFor(size_t const n, bool const parallel, Fn &&fn) {
+            if (parallel) {
+                sdk::ParallelFor(n, std::forward<Fn>(fn));
+
+                return;
+            }
+
+            for (size_t i = 0; i < n; ++i)
+                fn(i);
+        }
+
+        /**
+         * \brief  splits a graph into its connected components
+         *
+         * \param  [in] n number of nodes
+         * \param  [in] edges edges of the graph
+         *
+         * \return components, ordered by their lowest node
+         */
+        static std::vector<Component> Split(size_t const n, std::vector<LayoutEdge> const &edges) {
+            std::vector<uint32_t> parent(n);
+            std::iota(parent.begin(), parent.end(), 0u);
+
+            auto const find = [&](uint32_t v) {
+                while (parent[v] != v)
+                    v = parent[v] = parent[parent[v]];
+
+                return v;
+            };
+            for (LayoutEdge const &edge : edges) {
+                uint32_t const a = find(edge.from);
+                uint32_t const b = find(edge.to);
+
+                if (a != b)
+                    parent[std::max(a, b)] = std::min(a, b);
+            }
+
+            std::vector<Component> res;
+            std::vector<uint32_t>  compof(n, gl_none);
+            std::vector<uint32_t>  local(n);
+            for (uint32_t v = 0; v < n; ++v) {
+                uint32_t const root = find(v);
+                if (compof[root] == gl_none) {
+                    compof[root] = static_cast<uint32_t>(res.size());
+
+                    res.push_back({ {}, {}, 0.0f, 0.0f, 0.0f, {}, {}, {} });
+                }
+
+                Component &comp = res[compof[root]];
+                local[v] = static_cast<uint32_t>(comp.nodes.size());
+                comp.nodes.push_back(v);
+            }
+            for (LayoutEdge const &edge : edges)
+                if (edge.from != edge.to)
+                    res[compof[find(edge.from)]].edges.emplace_back(local[edge.from], local[edge.to]);
+
+            return res;
+        }
+
+        /**
+         * \brief lays out a single component relative to the origin
+         *
+         * \param [in,out] comp component to lay out; receives its size
+         * \param [in,out] nodes bounds of all nodes; only the nodes of *comp* are written
+         * \param [in] opts layout parameters
+         */
+        static void LayoutComponent(Component &comp, std::vector<ElementRect> &nodes, LayoutOptions const &opts) {
+            bool const parallel = opts.parallel && comp.nodes.size() >= gl_parallelmin;
+
+            Graph graph = BuildLayers(comp, nodes);
+            MinimizeCrossings(graph, opts.sweeps, parallel);
+
+            std::vector<float> xs = AssignCoordinates(graph, opts);
+
+            /* Layers are as high as their highest node; nodes are centered vertically. */
+            std::vector<float> heights(graph.order.size(), 0.0f);
+            for (uint32_t v = 0; v < comp.nodes.size(); ++v)
+                heights[graph.layer[v]] = std::max(heights[graph.layer[v]], nodes[comp.nodes[v]].h);
+
+            std::vector<float> tops(graph.order.size(), 0.0f);
+            for (size_t l = 1; l < tops.size(); ++l)
+                tops[l] = tops[l - 1] + heights[l - 1] + opts.layergap;
+
+            float left  = INFINITY;
+            float right = -INFINITY;
+            for (uint32_t v = 0; v < comp.nodes.size(); ++v) {
+                left  = std::min(left, xs[v] - graph.width[v] * 0.5f);
+                right = std::max(right, xs[v] + graph.width[v] * 0.5f);
+            }
+            for (uint32_t v = 0; v < comp.nodes.size(); ++v) {
+                ElementRect &rect = nodes[comp.nodes[v]];
+
+                rect.x = xs[v] - rect.w * 0.5f - left;
+                rect.y = tops[graph.layer[v]] + (heights[graph.layer[v]] - rect.h) * 0.5f;
+            }
+
+            comp.w = right - left;
+            comp.h = tops.back() + heights.back();
+            comp.layer.assign(graph.layer.begin(), graph.layer.begin() + comp.nodes.size());
+            comp.tops.swap(tops);
+            comp.heights.swap(heights);
+        }
+
+        /**
+         * \brief  removes cycles, assigns layers and inserts dummy nodes
+         *
+         * \param  [in] comp component to layer
+         * \param  [in] nodes bounds of all nodes
+         *
+         * \return layered graph; its first vertices are the nodes of *comp*, in order
+         */
+        static Graph BuildLayers(Component const &comp, std::vector<ElementRect> const &nodes) {
+            uint32_t const n = static_cast<uint32_t>(comp.nodes.size());
+
+            std::vector<std::vector<uint32_t>> out(n);
+            for (auto const &[from, to] : comp.edges)
+                out[from].push_back(to);
+
+            /* Iterative depth-first search; edges to nodes on the stack close a cycle. */
+            enum : uint8_t { White, Gray, Black };
+            std::vector<uint8_t>                       color(n, White);
+            std::vector<std::pair<uint32_t, uint32_t>> dag;
+            std::vector<std::pair<uint32_t, size_t>>   stack;
+            dag.reserve(comp.edges.size());
+            for (uint32_t root = 0; root < n; ++root) {
+                if (color[root] != White)
+                    continue;
+
+                color[root] = Gray;
+                stack.emplace_back(root, 0);
+                while (!stack.empty()) {
+                    auto &[v, next] = stack.back();
+                    if (next == out[v].size()) {
+                        color[v] = Black;
+                        stack.pop_back();
+
+                        continue;
+                    }
+
+                    uint32_t const w = out[v][next++];
+                    if (color[w] == Gray) {
+                        dag.emplace_back(w, v);
+
+                        continue;
+                    }
+                    dag.emplace_back(v, w);
+
+                    if (color[w] == White) {
+                        color[w] = Gray;
+                        stack.emplace_back(w, 0);
+                    }
+                }
+            }
+
+            /* Longest-path layering in topological order. */
+            std::vector<std::vector<uint32_t>> succ(n);
+            std::vector<uint32_t>              indeg(n, 0);
+            for (auto const &[from, to] : dag) {
+                succ[from].push_back(to);
+                ++indeg[to];
+            }
+
+            Graph graph;
+            graph.layer.assign(n, 0);
+            std::vector<uint32_t> topo;
+            topo.reserve(n);
+            for (uint32_t v = 0; v < n; ++v)
+                if (indeg[v] == 0)
+                    topo.push_back(v);
+            for (size_t i = 0; i < topo.size(); ++i)
+                for (uint32_t const w : succ[topo[i]]) {
+                    graph.layer[w] = std::max(graph.layer[w], graph.layer[topo[i]] + 1);
+
+                    if (--indeg[w] == 0)
+                        topo.push_back(w);
+                }
+
+            graph.width.resize(n);
+            for (uint32_t v = 0; v < n; ++v)
+                graph.width[v] = nodes[comp.nodes[v]].w;
+            graph.up.resize(n);
+            graph.down.resize(n);
+
+            /* Long edges become chains of dummy nodes, one per spanned layer. */
+            auto const link = [&](uint32_t const a, uint32_t const b) {
+                graph.down[a].push_back(b);
+                graph.up[b].push_back(a);
+            };
+            for (auto const &[from, to] : dag) {
+                uint32_t prev = from;
+
+                for (uint32_t l = graph.layer[from] + 1; l < graph.layer[to]; ++l) {
+                    uint32_t const dummy = static_cast<uint32_t>(graph.layer.size());
+                    graph.layer.push_back(l);
+                    graph.width.push_back(0.0f);
+                    graph.up.emplace_back();
+                    graph.down.emplace_back();
+
+                    link(prev, dummy);
+                    prev = dummy;
+                }
+                link(prev, to);
+            }
+
+            /* Start from the depth-first order, which keeps subtrees together. */
+            uint32_t const nlayers = 1 + *std::max_element(graph.layer.begin(), graph.layer.end());
+            std::vector<uint8_t> seen(graph.layer.size(), 0);
+            graph.order.resize(nlayers);
+            graph.pos.resize(graph.layer.size());
+
+            std::vector<uint32_t> todo;
+            for (uint32_t const root : topo) {
+                if (seen[root])
+                    continue;
+
+                seen[root] = 1;
+                todo.push_back(root);
+                while (!todo.empty()) {
+                    uint32_t const v = todo.back();
+                    todo.pop_back();
+
+                    graph.pos[v] = static_cast<uint32_t>(graph.order[graph.layer[v]].size());
+                    graph.order[graph.layer[v]].push_back(v);
+                    for (auto it = graph.down[v].rbegin(); it != graph.down[v].rend(); ++it)
+                        if (!seen[*it]) {
+                            seen[*it] = 1;
+                            todo.push_back(*it);
+                        }
+                }
+            }
+            return graph;
+        }
+
+        /**
+         * \brief  counts the crossings between two adjacent layers
+         *
+         * \param  [in] graph layered graph
+         * \param  [in] l upper layer
+         *
+         * \return number of crossings
+         */
+        static uint64_t CountCrossings(Graph const &graph, size_t const l) {
+            std::vector<std::pair<uint32_t, uint32_t>> ends;
+            for (uint32_t const v : graph.order[l])
+                for (uint32_t const w : graph.down[v])
+                    ends.emplace_back(graph.pos[v], graph.pos[w]);
+            std::sort(ends.begin(), ends.end());
+
+            /* Crossings are inversions of the lower end points; counted with a Fenwick tree. */
+            size_t const          size = graph.order[l + 1].size();
+            std::vector<uint32_t> tree(size + 1, 0);
+            uint64_t              res  = 0;
+            for (size_t i = 0; i < ends.size(); ++i) {
+                uint64_t below = 0;
+                for (size_t j = ends[i].second + 1; j > 0; j -= j & (~j + 1))
+                    below += tree[j];
+                res += i - below;
+
+                for (size_t j = ends[i].second + 1; j <= size; j += j & (~j + 1))
+                    ++tree[j];
+            }
+            return res;
+        }
+
+        /**
+         * \brief reorders the layers to reduce the number of edge crossings
+         *
+         * \param [in,out] graph layered graph
+         * \param [in] sweeps number of sweeps
+         * \param [in] parallel whether or not to reorder layers in parallel
+         */
+        static void MinimizeCrossings(Graph &graph, uint32_t const sweeps, bool const parallel) {
+            size_t const nlayers = graph.order.size();
+            if (nlayers < 2)
+                return;
+
+            std::vector<uint64_t> pairs(nlayers - 1);
+            auto const count = [&]() {
+                ParallelFor(nlayers - 1, parallel, [&](size_t const l) { pairs[l] = CountCrossings(graph, l); });
+
+                return std::accumulate(pairs.begin(), pairs.end(), uint64_t(0));
+            };
+
+            /* Both neighbor layers of a layer have the other parity, and are fixed meanwhile. */
+            auto const reorder = [&](size_t const l) {
+                std::vector<uint32_t>                    &layer = graph.order[l];
+                std::vector<std::pair<double, uint32_t>>  keys(layer.size());
+
+                for (size_t i = 0; i < layer.size(); ++i) {
+                    uint32_t const v   = layer[i];
+                    size_t const   deg = graph.up[v].size() + graph.down[v].size();
+
+                    double sum = 0.0;
+                    for (uint32_t const w : graph.up[v])
+                        sum += graph.pos[w];
+                    for (uint32_t const w : graph.down[v])
+                        sum += graph.pos[w];
+
+                    /* Vertices without neighbors keep their position. */
+                    keys[i] = { deg == 0 ? static_cast<double>(i) : sum / static_cast<double>(deg), v };
+                }
+                std::stable_sort(keys.begin(), keys.end(), [](auto const &a, auto const &b) { return a.first < b.first; });
+
+                for (size_t i = 0; i < layer.size(); ++i) {
+                    layer[i] = keys[i].second;
+
+                    graph.pos[layer[i]] = static_cast<uint32_t>(i);
+                }
+            };
+
+            std::vector<std::vector<uint32_t>> best = graph.order;
+            uint64_t                           least = count();
+            for (uint32_t s = 0; s < sweeps && least > 0; ++s) {
+                for (size_t parity : { size_t(1), size_t(0) })
+                    ParallelFor((nlayers - parity + 1) / 2, parallel, [&](size_t const i) { reorder(2 * i + parity); });
+
+                uint64_t const crossings = count();
+                if (crossings < least) {
+                    least = crossings;
+                    best  = graph.order;
+                }
+            }
+
+            graph.order.swap(best);
+            for (std::vector<uint32_t> const &layer : graph.order)
+                for (size_t i = 0; i < layer.size(); ++i)
+                    graph.pos[layer[i]] = static_cast<uint32_t>(i);
+        }
+
+        /**
+         * \brief  assigns horizontal coordinates to all vertices
+         *
+         * Each refinement pass visits the layers top-down and then bottom-up, and moves the vertices
+         * of every layer towards the mean position of their neighbors in the previous layer. Pushing
+         * the desired positions apart from the left and from the right yields two placements that
+         * keep the required gaps; their mean keeps the gaps as well and is not biased to either side.
+         *
+         * \param  [in] graph layered graph, in its final order
+         * \param  [in] opts layout parameters
+         *
+         * \return center coordinates, by vertex
+         */
+        static std::vector<float> AssignCoordinates(Graph const &graph, LayoutOptions const &opts) {
+            std::vector<float> xs(graph.layer.size(), 0.0f);
+            auto const gap = [&](uint32_t const a, uint32_t const b) {
+                return (graph.width[a] + graph.width[b]) * 0.5f + (graph.width[a] == 0.0f || graph.width[b] == 0.0f ? opts.nodegap * 0.5f : opts.nodegap);
+            };
+
+            for (std::vector<uint32_t> const &layer : graph.order)
+                for (size_t i = 1; i < layer.size(); ++i)
+                    xs[layer[i]] = xs[layer[i - 1]] + gap(layer[i - 1], layer[i]);
+
+            std::vector<float> want, lo, hi;
+            auto const place = [&](std::vector<uint32_t> const &layer, bool const fromabove) {
+                if (layer.empty())
+                    return;
+
+                want.resize(layer.size());
+                for (size_t i = 0; i < layer.size(); ++i) {
+                    std::vector<uint32_t> const &adj = fromabove ? graph.up[layer[i]] : graph.down[layer[i]];
+
+                    float sum = 0.0f;
+                    for (uint32_t const w : adj)
+                        sum += xs[w];
+                    want[i] = adj.empty() ? xs[layer[i]] : sum / static_cast<float>(adj.size());
+                }
+
+                lo = want;
+                for (size_t i = 1; i < layer.size(); ++i)
+                    lo[i] = std::max(lo[i], lo[i - 1] + gap(layer[i - 1], layer[i]));
+                hi = want;
+                for (size_t i = layer.size() - 1; i > 0; --i)
+                    hi[i - 1] = std::min(hi[i - 1], hi[i] - gap(layer[i - 1], layer[i]));
+
+                for (size_t i = 0; i < layer.size(); ++i)
+                    xs[layer[i]] = (lo[i] + hi[i]) * 0.5f;
+            };
+
+            for (uint32_t r = 0; r < opts.refinements; ++r) {
+                for (size_t l = 1; l < graph.order.size(); ++l)
+                    place(graph.order[l], true);
+                for (size_t l = graph.order.size() - 1; l > 0; --l)
+                    place(graph.order[l - 1], false);
+            }
+            return xs;
+        }
+
+        /**
+         * \brief arranges the laid-out components in rows
+         *
+         * Components are placed by decreasing height, so that every row is about as wide as the
+         * whole arrangement is high.
+         *
+         * \param [in,out] comps laid-out components; receive their position
+         * \param [in,out] nodes bounds of all nodes; moved to the position of their component
+         * \param [in] opts layout parameters
+         */
+        static void Pack(std::vector<Component> &comps, std::vector<ElementRect> &nodes, LayoutOptions const &opts) {
+            double area   = 0.0;
+            float  widest = 0.0f;
+            for (Component const &comp : comps) {
+                area  += static_cast<double>(comp.w + opts.componentgap) * static_cast<double>(comp.h + opts.componentgap);
+                widest = std::max(widest, comp.w);
+            }
+            float const rowwidth = std::max(widest, static_cast<float>(std::sqrt(area)));
+
+            std::vector<size_t> order(comps.size());
+            std::iota(order.begin(), order.end(), size_t(0));
+            std::stable_sort(order.begin(), order.end(), [&](size_t const a, size_t const b) { return comps[a].h > comps[b].h; });
+
+            float x   = 0.0f;
+            float y   = 0.0f;
+            float row = 0.0f;
+            for (size_t const i : order) {
+                Component &comp = comps[i];
+                if (x > 0.0f && x + comp.w > rowwidth) {
+                    x    = 0.0f;
+                    y   += row + opts.componentgap;
+                    row  = 0.0f;
+                }
+
+                for (uint32_t const v : comp.nodes) {
+                    nodes[v].x += x;
+                    nodes[v].y += y;
+                }
+                comp.y = y;
+                x     += comp.w + opts.componentgap;
+                row    = std::max(row, comp.h);
+            }
+        }
+    };
+}
+
+
@@ -16,14 +16,22 @@
 #pragma once
 
 /* stdlib includes */
-#include <initializer_list>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <vector>
 
 /* external includes */
 #include <sdk/external/spdlog/spdlog.h>
+#include <sdk/external/spdlog/async.h>
 
 #include <sdk/external/spdlog/sinks/basic_file_sink.h>
 #include <sdk/external/spdlog/sinks/ansicolor_sink.h>
 
+/* sdk includes */
+#include <sdk/profile.hpp>
+
 
 /**
  * \namespace suzu::sdk
@@ -34,6 +42,111 @@ namespace suzu::sdk {
     constexpr inline char const *gl_pluginlog = "suzu-plugin"; /**< plug-in logger name */
 
 
+    namespace internal {
+        /*
+         * Loggers of the current instance, cached by *InitializeInstanceLoggers()* so that the logging
+         * macros do not have to query the (mutex-protected) logger registry for every message. Both
+         * pointers are *nullptr* until the loggers have been initialized; logging is a no-op until then.
+         * The loggers themselves are kept alive by the registry.
+         */
+        inline spdlog::logger *gl_applogger    = nullptr; /**< cached application logger */
+        inline spdlog::logger *gl_pluginlogger = nullptr; /**< cached plug-in logger */
+
+        /*
+         * Rate limit of every call site of the logging macros, set by *InitializeInstanceLoggers()*.
+         * A site may log one message every *gl_siteinterval* nanoseconds on average, and up to
+         * *gl_sitetolerance* nanoseconds ahead of that, i.e. in bursts. An interval of 0 disables
+         * the limit.
+         */
+        inline std::atomic<int64_t> gl_siteinterval  = 0; /**< nanoseconds per message and call site */
+        inline std::atomic<int64_t> gl_sitetolerance = 0; /**< nanoseconds a call site may log ahead */
+
+
+        /**
+         * \struct suzu::sdk::internal::LogSite
+         * \brief  state of the rate limit of a single call site of the logging macros
+         *
+         * The limit is a token bucket kept as a single timestamp (the "generic cell rate
+         * algorithm"): *next* is the time at which the bucket would be full again. Every call site
+         * owns one instance as a function-local static, so sites never contend with one another,
+         * and admitting a message is a clock read and one compare-and-swap.
+         */
+        struct LogSite {
+            std::atomic<int64_t>  next       = INT64_MIN; /**< time at which the bucket is full, in nanoseconds */
+            std::atomic<uint32_t> suppressed = 0;         /**< messages suppressed since the last admitted one */
+        };
+
+        /**
+         * \brief  decides whether or not a call site may log a message now
+         *
+         * \param  [in,out] site state of the call site
+         * \param  [out] suppressed receives the number of messages of the site suppressed since
+         *               the last admitted one, if the message is admitted
+         *
+         * \return *true* if the message is to be logged
+         * \note   This function never throws any exceptions.
+         */
+        inline bool AdmitLogSite(LogSite &site, uint32_t &suppressed) noexcept {
+            int64_t const interval = gl_siteinterval.load(std::memory_order_relaxed);
+            if (interval == 0)
+                return true;
+
+            int64_t const now       = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            int64_t const tolerance = gl_sitetolerance.load(std::memory_order_relaxed);
+
+            int64_t next = site.next.load(std::memory_order_relaxed);
+            for (;;) {
+                int64_t const from = next > now ? next : now;
+                if (from - now > tolerance) {
+                    site.suppressed.fetch_add(1, std::memory_order_relaxed);
+
+                    return false;
+                }
+
+                if (site.next.compare_exchange_weak(next, from + interval, std::memory_order_relaxed))
+                    break;
+            }
+
+            suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+
+        /**
+         * \brief  swallows the arguments of a logging macro that is compiled out
+         *
+         * Only ever named in unevaluated operands, so that variables used for logging alone are
+         * still considered used, yet nothing is evaluated.
+         *
+         * \return 0
+         */
+        template<class... Args> constexpr int IgnoreLog(Args const &...) noexcept { return 0; }
+    }
+
+
+    /**
+     * \struct suzu::sdk::LoggerOptions
+     * \brief  options controlling how the loggers of an instance dispatch messages
+     *
+     * In asynchronous mode, log calls only format the message and push it into a bounded queue;
+     * a background thread hands the messages to the sinks. Sinks are flushed whenever a message of
+     * at least *flushlvl* is logged, and additionally every *flushinterval* seconds.
+     * Every call site of the logging macros may log *siterate* messages per second, in bursts of up
+     * to *siteburst* messages; further messages of the site are dropped and reported in a summary
+     * ("suppressed N similar message(s)") before the next message the site logs.
+     *
+     * \note  This is a plain struct so that it can be passed to plug-ins safely.
+     */
+    struct LoggerOptions {
+        bool                          async         = false;                                  /**< whether or not to log asynchronously */
+        size_t                        queuesize     = 8192;                                   /**< capacity of the message queue; only used if *async* is set */
+        spdlog::async_overflow_policy overflow      = spdlog::async_overflow_policy::block;   /**< behavior if the queue is full; only used if *async* is set */
+        spdlog::level::level_enum     flushlvl      = spdlog::level::warn;                    /**< minimum level that forces a flush */
+        uint32_t                      flushinterval = 3;                                      /**< periodic flush interval, in seconds; 0 to disable */
+        uint32_t                      siterate      = 0;                                      /**< messages per second allowed per call site; 0 to disable the limit */
+        uint32_t                      siteburst     = 1;                                      /**< messages a call site may log at once; only used if *siterate* is not 0 */
+    };
+
+
     /**
      * \brief  initializes the loggers for the current instance
      * 
@@ -47,11 +160,12 @@ namespace suzu::sdk {
      * \param  [in] nsinks number of sinks to register
      * \param  [in] sinks C-array, holding exactly *nsinks* sink pointers
      * \param  [in] minlvl minimum log level used by the application
+     * \param  [in] opts dispatch options; in asynchronous mode, each instance owns one logging thread
      * 
      * \return *true* if all sinks could be initialized properly
      * \note   This function never throws any exceptions.
      */
-    inline bool InitializeInstanceLoggers(size_t const nsinks, spdlog::sink_ptr const *sinks, spdlog::level::level_enum const minlvl = spdlog::level::trace) noexcept {
+    inline bool InitializeInstanceLoggers(size_t const nsinks, spdlog::sink_ptr const *sinks, spdlog::level::level_enum const minlvl = spdlog::level::trace, LoggerOptions const &opts = {}) noexcept {
         /* Not initializing anything is not an error. */
         if (nsinks == 0 || sinks == nullptr)
             return true;
@@ -60,21 +174,123 @@ namespace suzu::sdk {
             /* Set global settings. When the loggers are initialized, global settings are inherited by them. */
             spdlog::set_pattern("[%D %r] %^%n::%l%$: %v");
             spdlog::set_level(minlvl);
-            spdlog::flush_on(minlvl);
+            spdlog::flush_on(opts.flushlvl);
+            if (opts.flushinterval != 0)
+                spdlog::flush_every(std::chrono::seconds(opts.flushinterval));
 
-            /* Construct view on C-array. */
-            std::initializer_list<spdlog::sink_ptr> const ilsinks(sinks, sinks + nsinks);
+            /* Set the rate limit of the call sites. */
+            int64_t const interval = opts.siterate != 0 ? INT64_C(1000000000) / opts.siterate : 0;
+            internal::gl_siteinterval.store(interval, std::memory_order_relaxed);
+            internal::gl_sitetolerance.store(opts.siteburst > 1 ? interval * (opts.siteburst - 1) : 0, std::memory_order_relaxed);
 
             /* Initialize and register loggers. */
-            spdlog::initialize_logger(std::make_shared<spdlog::logger>(gl_applog, ilsinks));
-            spdlog::initialize_logger(std::make_shared<spdlog::logger>(gl_pluginlog, ilsinks));
-        } catch (...) { }
+            std::shared_ptr<spdlog::logger> applog, pluginlog;
+            if (opts.async) {
+                spdlog::init_thread_pool(opts.queuesize, 1);
+
+                applog    = std::make_shared<spdlog::async_logger>(gl_applog, sinks, sinks + nsinks, spdlog::thread_pool(), opts.overflow);
+                pluginlog = std::make_shared<spdlog::async_logger>(gl_pluginlog, sinks, sinks + nsinks, spdlog::thread_pool(), opts.overflow);
+            } else {
+                applog    = std::make_shared<spdlog::logger>(gl_applog, sinks, sinks + nsinks);
+                pluginlog = std::make_shared<spdlog::logger>(gl_pluginlog, sinks, sinks + nsinks);
+            }
+            spdlog::initialize_logger(applog);
+            spdlog::initialize_logger(pluginlog);
+
+            /* Cache the loggers for the logging macros. */
+            internal::gl_applogger    = applog.get();
+            internal::gl_pluginlogger = pluginlog.get();
+        } catch (...) {
+            return false;
+        }
 
         return true;
     }
+
+
+    /**
+     * \struct suzu::sdk::SinkRegistry
+     * \brief  ABI-stable view on the sinks owned by the host application
+     *
+     * The host creates all sinks once and keeps them alive for the lifetime of the process. Plug-ins
+     * only receive raw pointers through this plain struct; no standard container or *std::shared_ptr*
+     * crosses the plug-in boundary, so debug and release builds of plug-ins can share the sinks of the
+     * host regardless of their STL ABI, and attaching a sink to a plug-in logger never touches the
+     * host's reference counts.
+     *
+     * \note  All sinks must be thread-safe (i.e., *_mt* sinks), as they are shared by all instances.
+     */
+    struct SinkRegistry {
+        static constexpr uint32_t gl_version = 1; /**< current ABI version */
+
+        uint32_t                    version; /**< must be *gl_version* */
+        uint32_t                    nsinks;  /**< number of elements in *sinks* */
+        spdlog::sinks::sink *const *sinks;   /**< C-array of host-owned sinks */
+    };
+
+    /**
+     * \brief  initializes the loggers for the current instance from the host's sink registry
+     * 
+     * The sinks are referenced through non-owning handles which carry no reference count; copying
+     * them is free. The host guarantees that the sinks outlive all instances.
+     * 
+     * \param  [in] reg sink registry provided by the host
+     * \param  [in] minlvl minimum log level used by the application
+     * \param  [in] opts dispatch options
+     * 
+     * \return *true* if all sinks could be initialized properly
+     * \note   This function never throws any exceptions.
+     */
+    inline bool InitializeInstanceLoggers(SinkRegistry const &reg, spdlog::level::level_enum const minlvl = spdlog::level::trace, LoggerOptions const &opts = {}) noexcept {
+        if (reg.version != SinkRegistry::gl_version)
+            return false;
+        else if (reg.nsinks == 0 || reg.sinks == nullptr)
+            return true;
+
+        try {
+            /* Wrap raw sinks into non-owning handles (aliasing an empty owner): no control block is created. */
+            std::vector<spdlog::sink_ptr> sinks;
+            sinks.reserve(reg.nsinks);
+            for (uint32_t i = 0; i < reg.nsinks; ++i)
+                sinks.emplace_back(spdlog::sink_ptr{}, reg.sinks[i]);
+
+            return InitializeInstanceLoggers(sinks.size(), sinks.data(), minlvl, opts);
+        } catch (...) { }
+
+        return false;
+    }
 }
 
 
+/**
+ * \ingroup  Macros
+ * \defgroup LogLevels
+ * \brief    compile-time log level threshold
+ *
+ * Call sites of the logging macros below *SZSDK_ACTIVE_LEVEL* are compiled to nothing; their arguments are not
+ * evaluated. The threshold can be raised per project (application or plug-in) by defining
+ * *SZSDK_ACTIVE_LEVEL* before including this header. By default, every call site is compiled in, in release
+ * builds as well, so that trace messages can still be enabled in production (see
+ * *suzu::sdk::sinks::RingBufferSink*); the runtime level check keeps disabled levels cheap. The runtime level
+ * passed to *suzu::sdk::InitializeInstanceLoggers()* applies to all call sites that are compiled in.
+ *
+ * \note The values mirror *SPDLOG_LEVEL_\** from the vendored spdlog.
+ */
+/** @{ */
+#define SZSDK_LEVEL_TRACE    0
+#define SZSDK_LEVEL_DEBUG    1
+#define SZSDK_LEVEL_INFO     2
+#define SZSDK_LEVEL_WARNING  3
+#define SZSDK_LEVEL_ERROR    4
+#define SZSDK_LEVEL_CRITICAL 5
+#define SZSDK_LEVEL_OFF      6
+
+#if !defined SZSDK_ACTIVE_LEVEL
+    #define SZSDK_ACTIVE_LEVEL SZSDK_LEVEL_TRACE
+#endif
+/** @} */
+
+
 /**
  * \ingroup  Macros
  * \defgroup Logging
@@ -83,6 +299,13 @@ namespace suzu::sdk {
  * These macros should be used pretty much everywhere where logging is desired. They take no logger parameter,
  * the used logger is determined based on what macro is used. The logger used for each macro can be read from
  * the macro name, the schema is SZSDK_<logger-name>_<log-level>().
+ * The macros use the loggers cached by *suzu::sdk::InitializeInstanceLoggers()* and check the log level before
+ * evaluating their arguments, so disabled levels cost neither formatting nor a registry lookup. Levels below
+ * *SZSDK_ACTIVE_LEVEL* are removed entirely at compile-time.
+ * Every use of a macro is a call site with its own rate limit (see *suzu::sdk::LoggerOptions*), so a message
+ * logged from a paint or hover handler cannot flood the sinks; suppressed messages are neither formatted nor
+ * dispatched. Unlike spdlog's *dup_filter_sink*, sites keep their state in a static of their own instead of
+ * behind a mutex shared by all messages.
  *
  * \param    [in] format format string, allows fmtlib format specifiers
  * \param    [in] ... format arguments
@@ -90,19 +313,101 @@ namespace suzu::sdk {
  * \note For fmtlib documentation, visit https://fmt.dev/latest/index.html.
  */
 /** @{ */
-#define SZSDK_APP_TRACE(format, ...)       spdlog::get(suzu::sdk::gl_applog)->trace(format, ##__VA_ARGS__)
-#define SZSDK_APP_DEBUG(format, ...)       spdlog::get(suzu::sdk::gl_applog)->debug(format, ##__VA_ARGS__)
-#define SZSDK_APP_INFO(format, ...)        spdlog::get(suzu::sdk::gl_applog)->info(format, ##__VA_ARGS__)
-#define SZSDK_APP_WARNING(format, ...)     spdlog::get(suzu::sdk::gl_applog)->warn(format, ##__VA_ARGS__)
-#define SZSDK_APP_ERROR(format, ...)       spdlog::get(suzu::sdk::gl_applog)->error(format, ##__VA_ARGS__)
-#define SZSDK_APP_CRITICAL(format, ...)    spdlog::get(suzu::sdk::gl_applog)->critical(format, ##__VA_ARGS__)
-
-#define SZSDK_PLUGIN_TRACE(format, ...)    spdlog::get(suzu::sdk::gl_pluginlog)->trace(format, ##__VA_ARGS__)
-#define SZSDK_PLUGIN_DEBUG(format, ...)    spdlog::get(suzu::sdk::gl_pluginlog)->debug(format, ##__VA_ARGS__)
-#define SZSDK_PLUGIN_INFO(format, ...)     spdlog::get(suzu::sdk::gl_pluginlog)->info(format, ##__VA_ARGS__)
-#define SZSDK_PLUGIN_WARNING(format, ...)  spdlog::get(suzu::sdk::gl_pluginlog)->warn(format, ##__VA_ARGS__)
-#define SZSDK_PLUGIN_ERROR(format, ...)    spdlog::get(suzu::sdk::gl_pluginlog)->error(format, ##__VA_ARGS__)
-#define SZSDK_PLUGIN_CRITICAL(format, ...) spdlog::get(suzu::sdk::gl_pluginlog)->critical(format, ##__VA_ARGS__)
+#define SZSDK_LOG_IMPL(inst, lvl, format, ...)                                                                    \
+    do {                                                                                                         \
+        if (spdlog::logger *const szsdk_logger = (inst);                                                        \
+            szsdk_logger != nullptr && szsdk_logger->should_log(lvl)                                            \
+        ) {                                                                                                      \
+            static suzu::sdk::internal::LogSite szsdk_site;                                                      \
+            uint32_t                            szsdk_suppressed = 0;                                            \
+            if (suzu::sdk::internal::AdmitLogSite(szsdk_site, szsdk_suppressed)) {                               \
+                if (szsdk_suppressed != 0)                                                                       \
+                    szsdk_logger->log(lvl, "suppressed {} similar message(s) from {}:{}",                       \
+                        szsdk_suppressed, __FILE__, __LINE__                                                     \
+                    );                                                                                           \
+                szsdk_logger->log(lvl, format, ##__VA_ARGS__);                                                   \
+            }                                                                                                    \
+        }                                                                                                        \
+    } while (0)
+#define SZSDK_LOG_NONE(format, ...) do { (void)sizeof(suzu::sdk::internal::IgnoreLog(format, ##__VA_ARGS__)); } while (0)
+
+#if SZSDK_ACTIVE_LEVEL <= SZSDK_LEVEL_TRACE
+    #define SZSDK_APP_TRACE(format, ...)       SZSDK_LOG_IMPL(suzu::sdk::internal::gl_applogger, spdlog::level::trace, format, ##__VA_ARGS__)
+    #define SZSDK_PLUGIN_TRACE(format, ...)    SZSDK_LOG_IMPL(suzu::sdk::internal::gl_pluginlogger, spdlog::level::trace, format, ##__VA_ARGS__)
+#else
+    #define SZSDK_APP_TRACE(format, ...)       SZSDK_LOG_NONE(format, ##__VA_ARGS__)
+    #define SZSDK_PLUGIN_TRACE(format, ...)    SZSDK_LOG_NONE(format, ##__VA_ARGS__)
+#endif
+
+#if SZSDK_ACTIVE_LEVEL <= SZSDK_LEVEL_DEBUG
+    #define SZSDK_APP_DEBUG(format, ...)       SZSDK_LOG_IMPL(suzu::sdk::internal::gl_applogger, spdlog::level::debug, format, ##__VA_ARGS__)
+    #define SZSDK_PLUGIN_DEBUG(format, ...)    SZSDK_LOG_IMPL(suzu::sdk::internal::gl_pluginlogger, spdlog::level::debug, format, ##__VA_ARGS__)
+#else
+    #define SZSDK_APP_DEBUG(format, ...)       SZSDK_LOG_NONE(format, ##__VA_ARGS__)
+    #define SZSDK_PLUGIN_DEBUG(format, ...)    SZSDK_LOG_NONE(format, ##__VA_ARGS__)
+#endif
+
+#if SZSDK_ACTIVE_LEVEL <= SZSDK_LEVEL_INFO
+    #define SZSDK_APP_INFO(format, ...)        SZSDK_LOG_IMPL(suzu::sdk::internal::gl_applogger, spdlog::level::info, format, ##__VA_ARGS__)
+    #define SZSDK_PLUGIN_INFO(format, ...)     SZSDK_LOG_IMPL(suzu::sdk::internal::gl_pluginlogger, spdlog::level::info, format, ##__VA_ARGS__)
+#else
+    #define SZSDK_APP_INFO(format, ...)        SZSDK_LOG_NONE(format, ##__VA_ARGS__)
+    #define SZSDK_PLUGIN_INFO(format, ...)     SZSDK_LOG_NONE(format, ##__VA_ARGS__)
+#endif
+
+#if SZSDK_ACTIVE_LEVEL <= SZSDK_LEVEL_WARNING
+    #define SZSDK_APP_WARNING(format, ...)     SZSDK_LOG_IMPL(suzu::sdk::internal::gl_applogger, spdlog::level::warn, format, ##__VA_ARGS__)
+    #define SZSDK_PLUGIN_WARNING(format, ...)  SZSDK_LOG_IMPL(suzu::sdk::internal::gl_pluginlogger, spdlog::level::warn, format, ##__VA_ARGS__)
+#else
+    #define SZSDK_APP_WARNING(format, ...)     SZSDK_LOG_NONE(format, ##__VA_ARGS__)
+    #define SZSDK_PLUGIN_WARNING(format, ...)  SZSDK_LOG_NONE(format, ##__VA_ARGS__)
+#endif
+
+#if SZSDK_ACTIVE_LEVEL <= SZSDK_LEVEL_ERROR
+    #define SZSDK_APP_ERROR(format, ...)       SZSDK_LOG_IMPL(suzu::sdk::internal::gl_applogger, spdlog::level::err, format, ##__VA_ARGS__)
+    #define SZSDK_PLUGIN_ERROR(format, ...)    SZSDK_LOG_IMPL(suzu::sdk::internal::gl_pluginlogger, spdlog::level::err, format, ##__VA_ARGS__)
+#else
+    #define SZSDK_APP_ERROR(format, ...)       SZSDK_LOG_NONE(format, ##__VA_ARGS__)
+    #define SZSDK_PLUGIN_ERROR(format, ...)    SZSDK_LOG_NONE(format, ##__VA_ARGS__)
+#endif
+
+#if SZSDK_ACTIVE_LEVEL <= SZSDK_LEVEL_CRITICAL
+    #define SZSDK_APP_CRITICAL(format, ...)    SZSDK_LOG_IMPL(suzu::sdk::internal::gl_applogger, spdlog::level::critical, format, ##__VA_ARGS__)
+    #define SZSDK_PLUGIN_CRITICAL(format, ...) SZSDK_LOG_IMPL(suzu::sdk::internal::gl_pluginlogger, spdlog::level::critical, format, ##__VA_ARGS__)
+#else
+    #define SZSDK_APP_CRITICAL(format, ...)    SZSDK_LOG_NONE(format, ##__VA_ARGS__)
+    #define SZSDK_PLUGIN_CRITICAL(format, ...) SZSDK_LOG_NONE(format, ##__VA_ARGS__)
+#endif
+/** @} */
+
+
+/**
+ * \ingroup  Macros
+ * \defgroup Profiling
+ * \brief    instrumentation of hot paths with nested profiling zones
+ *
+ * *SZSDK_PROFILE_SCOPE()* records a zone from the point of its use to the end of the enclosing scope on the
+ * profiler of the current instance (see *suzu::sdk::Profiler*); plug-ins record into the host's profiler once
+ * *suzu::sdk::InitializePluginInstance()* has run. Every call site registers its zone once, on first use; entering
+ * a zone afterwards costs a clock read and a store while recording, and a single load while not.
+ * The macros are compiled to nothing unless *SZSDK_PROFILE* is defined, per project, before including this
+ * header. The application defines it in all of its configurations, so that whether zones are recorded is only
+ * decided at run time (keys "/profile/trace" and "/hud/visible").
+ *
+ * \param    [in] name name of the zone; a string literal
+ */
+/** @{ */
+#define SZSDK_PROFILE_CONCAT_IMPL(a, b) a##b
+#define SZSDK_PROFILE_CONCAT(a, b)      SZSDK_PROFILE_CONCAT_IMPL(a, b)
+
+#if defined SZSDK_PROFILE
+    #define SZSDK_PROFILE_SCOPE_IMPL(name, id)                                                                                     \
+        static uint32_t const SZSDK_PROFILE_CONCAT(szsdk_zone_, id) = suzu::sdk::internal::RegisterZone(name, __FILE__, __LINE__); \
+        suzu::sdk::ProfileScope const SZSDK_PROFILE_CONCAT(szsdk_scope_, id)(SZSDK_PROFILE_CONCAT(szsdk_zone_, id))
+    #define SZSDK_PROFILE_SCOPE(name) SZSDK_PROFILE_SCOPE_IMPL(name, __COUNTER__)
+#else
+    #define SZSDK_PROFILE_SCOPE(name) static_cast<void>(0)
+#endif
 /** @} */
 
 
@@ -0,0 +1,491 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  memory.hpp
+ * \brief per-subsystem memory accounting, shared by the host application and its plug-ins
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace suzu::sdk {
+    /**
+     * \class suzu::sdk::MemoryAccounts
+     * \brief counters of the memory used by every subsystem, e.g. the model, caches, the undo
+     *        history or a plug-in
+     *
+     * Every account has two counters:
+     *
+     *  - *tracked*: memory reported explicitly, by the pools and arenas of the SDK and by
+     *    subsystems that know the size of what they keep, e.g. caches; always counted;
+     *  - *heap*: memory allocated through the global *operator new* while the account was active
+     *    on the allocating thread (see *suzu::sdk::MemoryScope*), and not freed yet; only counted in
+     *    modules built with *SZSDK_MEMTRACK* (see *SZSDK_DEFINE_ALLOCATION_HOOK()*).
+     *
+     * Memory is always returned to the account it was charged to, wherever it is freed. Untagged
+     * allocations are charged to account 0 (*"other"*).
+     *
+     * Nothing here allocates after registration, so counting is safe from within *operator new*.
+     */
+    class MemoryAccounts {
+    public:
+        static constexpr uint32_t gl_maxaccounts = 256; /**< maximum number of accounts, including *"other"* */
+        static constexpr size_t   gl_maxname     = 48;  /**< maximum length of account names, including the terminator */
+
+        /**
+         * \struct suzu::sdk::MemoryAccounts::Usage
+         * \brief  snapshot of a single account
+         */
+        struct Usage {
+            std::string name;    /**< name of the account */
+            int64_t     tracked; /**< explicitly reported memory, in bytes */
+            int64_t     heap;    /**< live heap memory, in bytes */
+            int64_t     peak;    /**< largest value *heap* ever had, in bytes */
+            uint64_t    allocs;  /**< number of heap allocations, including freed ones */
+        };
+
+        /**
+         * \struct suzu::sdk::MemoryAccounts::Allocations
+         * \brief  heap allocations charged by a single thread
+         */
+        struct Allocations {
+            uint64_t count; /**< number of allocations */
+            uint64_t bytes; /**< number of bytes allocated */
+        };
+
+    private:
+        /**
+         * \struct suzu::sdk::MemoryAccounts::Account
+         * \brief  counters of a single account
+         */
+        struct Account {
+            char                  name[gl_maxname]; /**< name; never changed after registration */
+            std::atomic<int64_t>  tracked;          /**< explicitly reported memory, in bytes */
+            std::atomic<int64_t>  heap;             /**< live heap memory, in bytes */
+            std::atomic<int64_t>  peak;             /**< largest value *heap* ever had, in bytes */
+            std::atomic<uint64_t> allocs;           /**< number of heap allocations */
+        };
+
+        std::mutex            m_lock;                     /**< guards registration */
+        Account               m_accounts[gl_maxaccounts]; /**< accounts, by id */
+        std::atomic<uint32_t> m_naccounts;                /**< number of registered accounts */
+
+    public:
+        MemoryAccounts() noexcept
+            : m_accounts(), m_naccounts(1)
+        {
+            std::memcpy(m_accounts[0].name, "other", sizeof("other"));
+        }
+        MemoryAccounts(MemoryAccounts const &) = delete;
+        MemoryAccounts &operator =(MemoryAccounts const &) = delete;
+
+        /**
+         * \brief  retrieves the accounts of the current module
+         *
+         * \return reference to the accounts
+         */
+        static MemoryAccounts &Local() noexcept {
+            static MemoryAccounts gl_accounts;
+
+            return gl_accounts;
+        }
+
+        /**
+         * \brief  retrieves the heap allocations the calling thread has charged to the accounts of
+         *         the current module, e.g. to measure a call into a plug-in
+         *
+         * Allocations are counted by *charge()*, i.e., only in modules built with *SZSDK_MEMTRACK*.
+         * Plug-ins charge the accounts of the host (see *suzu::sdk::MemoryInterface*), so the
+         * counters of the host include their allocations, whatever C runtime they link.
+         *
+         * \return counters, since the thread started
+         */
+        static Allocations ThreadAllocations() noexcept {
+            return Counter();
+        }
+
+        /**
+         * \brief  retrieves the id of an account, registering it on first use
+         *
+         * Lookups do not lock, so this is cheap enough to be called on every call into a plug-in.
+         *
+         * \param  [in] name name of the account; truncated to *gl_maxname* - 1 bytes
+         *
+         * \return id of the account, or 0 (*"other"*) if too many accounts were registered
+         */
+        uint32_t account(std::string_view name) noexcept {
+            name = name.substr(0, gl_maxname - 1);
+
+            if (name == m_accounts[0].name)
+                return 0;
+
+            uint32_t const n = m_naccounts.load(std::memory_order_acquire);
+            if (uint32_t const id = find(name, 1, n))
+                return id;
+
+            std::lock_guard<std::mutex> lock(m_lock);
+            uint32_t const now = m_naccounts.load(std::memory_order_relaxed);
+            if (uint32_t const id = find(name, n, now))
+                return id;
+            if (now == gl_maxaccounts)
+                return 0;
+
+            std::memcpy(m_accounts[now].name, name.data(), name.size());
+            m_accounts[now].name[name.size()] = '\0';
+            m_naccounts.store(now + 1, std::memory_order_release);
+            return now;
+        }
+
+        /**
+         * \brief adjusts the explicitly reported memory of an account
+         *
+         * \param [in] id id of the account
+         * \param [in] delta change, in bytes; negative when memory is released
+         */
+        void track(uint32_t const id, int64_t const delta) noexcept {
+            if (id < gl_maxaccounts)
+                m_accounts[id].tracked.fetch_add(delta, std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief charges a heap allocation to an account
+         *
+         * \param [in] id id of the account
+         * \param [in] bytes size of the allocation, in bytes
+         */
+        void charge(uint32_t const id, int64_t const bytes) noexcept {
+            Allocations &thread = Counter();
+            ++thread.count;
+            thread.bytes += static_cast<uint64_t>(bytes);
+
+            if (id >= gl_maxaccounts)
+                return;
+
+            Account &acc  = m_accounts[id];
+            int64_t  live = acc.heap.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+            int64_t  peak = acc.peak.load(std::memory_order_relaxed);
+            while (live > peak && !acc.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+                ;
+
+            acc.allocs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief returns a heap allocation to the account it was charged to
+         *
+         * \param [in] id id of the account
+         * \param [in] bytes size of the allocation, in bytes
+         */
+        void release(uint32_t const id, int64_t const bytes) noexcept {
+            if (id < gl_maxaccounts)
+                m_accounts[id].heap.fetch_sub(bytes, std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief  retrieves a snapshot of all accounts
+         *
+         * \return one entry per account, by id
+         * \throw  std::bad_alloc
+         */
+        std::vector<Usage> usage() const {
+            std::vector<Usage> res;
+
+            uint32_t const n = m_naccounts.load(std::memory_order_acquire);
+            res.reserve(n);
+            for (uint32_t i = 0; i < n; ++i) {
+                Account const &acc = m_accounts[i];
+
+                res.push_back({
+                    acc.name,
+                    acc.tracked.load(std::memory_order_relaxed),
+                    acc.heap.load(std::memory_order_relaxed),
+                    acc.peak.load(std::memory_order_relaxed),
+                    acc.allocs.load(std::memory_order_relaxed)
+                });
+            }
+
+            return res;
+        }
+
+    private:
+        /**
+         * \brief  looks up a registered account
+         *
+         * \param  [in] name name of the account
+         * \param  [in] begin first id to check
+         * \param  [in] end id after the last one to check
+         *
+         * \return id of the account, or 0 if not found
+         */
+        uint32_t find(std::string_view const name, uint32_t const begin, uint32_t const end) const noexcept {
+            for (uint32_t i = begin; i < end; ++i)
+                if (name == m_accounts[i].name)
+                    return i;
+
+            return 0;
+        }
+
+        /**
+         * \brief  retrieves the counters behind *ThreadAllocations()*
+         *
+         * \return counters of the calling thread
+         */
+        static Allocations &Counter() noexcept {
+            thread_local Allocations tl_allocs = { 0, 0 };
+
+            return tl_allocs;
+        }
+    };
+
+
+    /**
+     * \struct suzu::sdk::MemoryInterface
+     * \brief  ABI-stable view on the memory accounts owned by the host application
+     *
+     * Like *suzu::sdk::ProfilerInterface*, this is a plain struct of raw pointers.
+     */
+    struct MemoryInterface {
+        static constexpr uint32_t gl_version = 1; /**< current ABI version */
+
+        uint32_t   version;                                                 /**< must be *gl_version* */
+        void      *accounts;                                                /**< opaque accounts object */
+        uint32_t (*account)(void *accounts, char const *name, size_t len);  /**< retrieves the id of an account, registering it on first use */
+        void     (*track)(void *accounts, uint32_t id, int64_t delta);      /**< adjusts the explicitly reported memory of an account */
+        void     (*charge)(void *accounts, uint32_t id, int64_t bytes);     /**< charges a heap allocation to an account */
+        void     (*release)(void *accounts, uint32_t id, int64_t bytes);    /**< returns a heap allocation to its account */
+        uint32_t (*current)();                                              /**< retrieves the account active on the calling thread in the host */
+
+        /**
+         * \brief  retrieves the interface to the accounts of the current module
+         *
+         * \return memory interface; valid for the lifetime of the module
+         */
+        static MemoryInterface Local() noexcept;
+    };
+
+
+    namespace internal {
+        inline thread_local uint32_t gl_account = 0; /**< account active on the calling thread in the current module; see *suzu::sdk::MemoryScope* */
+
+        /**
+         * Accounts used by the current instance, set by *InitializeInstanceMemory()*. Until then,
+         * the module's own accounts are used.
+         */
+        inline MemoryInterface gl_memory = { MemoryInterface::gl_version, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+
+        /**
+         * \brief  retrieves the accounts used by the current instance
+         *
+         * \return memory interface
+         */
+        inline MemoryInterface CurrentMemory() noexcept {
+            return gl_memory.charge != nullptr ? gl_memory : MemoryInterface::Local();
+        }
+
+        /**
+         * \brief  retrieves the account active on the calling thread
+         *
+         * Scopes entered in the current module take precedence over those of the host, e.g. the
+         * plug-in a call of the host is attributed to.
+         *
+         * \return id of the account; 0 for *"other"*
+         */
+        inline uint32_t CurrentAccount() noexcept {
+            if (gl_account != 0 || gl_memory.current == nullptr)
+                return gl_account;
+
+            return gl_memory.current();
+        }
+
+        /**
+         * \brief  retrieves the id of an account of the current instance
+         *
+         * \param  [in] name name of the account
+         *
+         * \return id of the account, or 0 on failure
+         */
+        inline uint32_t RegisterAccount(std::string_view const name) noexcept {
+            MemoryInterface const iface = CurrentMemory();
+
+            return iface.account(iface.accounts, name.data(), name.size());
+        }
+
+        /**
+         * \brief adjusts the explicitly reported memory of an account of the current instance
+         *
+         * \param [in] id id of the account
+         * \param [in] delta change, in bytes
+         */
+        inline void TrackMemory(uint32_t const id, int64_t const delta) noexcept {
+            MemoryInterface const iface = CurrentMemory();
+
+            iface.track(iface.accounts, id, delta);
+        }
+
+
+        /**
+         * \struct suzu::sdk::internal::AllocationHeader
+         * \brief  prefix of every allocation made through *TrackedAlloc()*
+         */
+        struct alignas(16) AllocationHeader {
+            uint64_t size;    /**< requested size, in bytes */
+            uint32_t account; /**< account the allocation was charged to */
+        };
+
+        /**
+         * \brief  allocates memory and charges it to the account active on the calling thread
+         *
+         * \param  [in] size number of bytes to allocate
+         *
+         * \return pointer to the memory, or *nullptr* if out of memory
+         * \note   The memory must be freed with *TrackedFree()*, by any module built with
+         *         *SZSDK_MEMTRACK* that shares the C runtime of the allocating one.
+         */
+        inline void *TrackedAlloc(size_t const size) noexcept {
+            if (size > SIZE_MAX - sizeof(AllocationHeader))
+                return nullptr;
+
+            void *const mem = std::malloc(sizeof(AllocationHeader) + size);
+            if (mem == nullptr)
+                return nullptr;
+
+            AllocationHeader *const hdr = static_cast<AllocationHeader *>(mem);
+            hdr->size    = size;
+            hdr->account = CurrentAccount();
+
+            MemoryInterface const iface = CurrentMemory();
+            iface.charge(iface.accounts, hdr->account, static_cast<int64_t>(size));
+            return hdr + 1;
+        }
+
+        /**
+         * \brief frees memory allocated with *TrackedAlloc()* and returns it to its account
+         *
+         * \param [in] ptr memory to free; may be *nullptr*
+         */
+        inline void TrackedFree(void *const ptr) noexcept {
+            if (ptr == nullptr)
+                return;
+
+            AllocationHeader *const hdr   = static_cast<AllocationHeader *>(ptr) - 1;
+            MemoryInterface const   iface = CurrentMemory();
+            iface.release(iface.accounts, hdr->account, static_cast<int64_t>(hdr->size));
+
+            std::free(hdr);
+        }
+    }
+
+    inline MemoryInterface MemoryInterface::Local() noexcept {
+        return {
+            gl_version,
+            &MemoryAccounts::Local(),
+            [](void *accounts, char const *name, size_t len) { return static_cast<MemoryAccounts *>(accounts)->account({ name, len }); },
+            [](void *accounts, uint32_t id, int64_t delta) { static_cast<MemoryAccounts *>(accounts)->track(id, delta); },
+            [](void *accounts, uint32_t id, int64_t bytes) { static_cast<MemoryAccounts *>(accounts)->charge(id, bytes); },
+            [](void *accounts, uint32_t id, int64_t bytes) { static_cast<MemoryAccounts *>(accounts)->release(id, bytes); },
+            []() { return internal::gl_account; }
+        };
+    }
+
+    /**
+     * \brief  sets the memory accounts used by the current instance
+     *
+     * \param  [in] iface memory interface passed by the host
+     *
+     * \return *true* on success, *false* if the interface has an incompatible ABI version
+     * \note   Memory tracked before this call belongs to the module's own accounts; this should be
+     *         called before anything is allocated through the pools or the allocation hook.
+     */
+    inline bool InitializeInstanceMemory(MemoryInterface const &iface) noexcept {
+        if (iface.version != MemoryInterface::gl_version || iface.account == nullptr || iface.track == nullptr || iface.charge == nullptr || iface.release == nullptr || iface.current == nullptr)
+            return false;
+
+        internal::gl_memory = iface;
+        return true;
+    }
+
+
+    /**
+     * \class suzu::sdk::MemoryScope
+     * \brief charges heap allocations of the calling thread to an account for the lifetime of this
+     *        object; see *SZSDK_MEMORY_SCOPE()*
+     */
+    class MemoryScope {
+        uint32_t m_prev; /**< account active before */
+
+    public:
+        explicit MemoryScope(uint32_t const id) noexcept
+            : m_prev(internal::gl_account)
+        {
+            internal::gl_account = id;
+        }
+        MemoryScope(MemoryScope const &) = delete;
+        MemoryScope &operator =(MemoryScope const &) = delete;
+        ~MemoryScope() { internal::gl_account = m_prev; }
+    };
+}
+
+
+/**
+ * \brief charges heap allocations of the enclosing scope to the account *name*
+ *
+ * The account is registered the first time the scope is entered.
+ *
+ * \param [in] name name of the account; a string literal
+ */
+#define SZSDK_MEMORY_CONCAT_IMPL(a, b) a##b
+#define SZSDK_MEMORY_CONCAT(a, b)      SZSDK_MEMORY_CONCAT_IMPL(a, b)
+#define SZSDK_MEMORY_SCOPE_IMPL(name, id)                                                                           \
+    static uint32_t const SZSDK_MEMORY_CONCAT(szsdk_account_, id) = ::suzu::sdk::internal::RegisterAccount(name);  \
+    ::suzu::sdk::MemoryScope const SZSDK_MEMORY_CONCAT(szsdk_memscope_, id)(SZSDK_MEMORY_CONCAT(szsdk_account_, id))
+#define SZSDK_MEMORY_SCOPE(name)       SZSDK_MEMORY_SCOPE_IMPL(name, __COUNTER__)
+
+/**
+ * \brief replaces the global allocation functions of the module including it, so that heap
+ *        memory is charged to the active account (see *suzu::sdk::MemoryAccounts*)
+ *
+ * Must be expanded in exactly one source file of a module, at global scope. Expands to nothing
+ * unless *SZSDK_MEMTRACK* is defined, e.g. in profiling builds; the application defines it in its
+ * Debug configuration.
+ */
+#if defined SZSDK_MEMTRACK
+    #define SZSDK_DEFINE_ALLOCATION_HOOK()                                                                                       \
+        void *operator new(size_t size) {                                                                                       \
+            if (void *const ptr = ::suzu::sdk::internal::TrackedAlloc(size))                                                   \
+                return ptr;                                                                                                     \
+                                                                                                                                \
+            throw std::bad_alloc{};                                                                                             \
+        }                                                                                                                       \
+        void *operator new[](size_t size) { return ::operator new(size); }                                                      \
+        void *operator new(size_t size, std::nothrow_t const &) noexcept { return ::suzu::sdk::internal::TrackedAlloc(size); }  \
+        void *operator new[](size_t size, std::nothrow_t const &) noexcept { return ::suzu::sdk::internal::TrackedAlloc(size); }\
+        void operator delete(void *ptr) noexcept { ::suzu::sdk::internal::TrackedFree(ptr); }                                   \
+        void operator delete[](void *ptr) noexcept { ::suzu::sdk::internal::TrackedFree(ptr); }                                 \
+        void operator delete(void *ptr, size_t) noexcept { ::suzu::sdk::internal::TrackedFree(ptr); }                           \
+        void operator delete[](void *ptr, size_t) noexcept { ::suzu::sdk::internal::TrackedFree(ptr); }                         \
+        void operator delete(void *ptr, std::nothrow_t const &) noexcept { ::suzu::sdk::internal::TrackedFree(ptr); }           \
+        void operator delete[](void *ptr, std::nothrow_t const &) noexcept { ::suzu::sdk::internal::TrackedFree(ptr); }
+#else
+    #define SZSDK_DEFINE_ALLOCATION_HOOK()
+#endif
+
+
@@ -0,0 +1,917 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  merge.hpp
+ * \brief structural diff and three-way merge of diagrams and project files
+ *
+ * Elements are compared by identity rather than by position in the file. The identity of an
+ * element is its path in the ownership tree: the kinds and names of the element and its owners,
+ * plus the position among equally named siblings, which tells unnamed notes and associations
+ * apart. Renaming or moving an element to another owner thus reads as removing it and adding a
+ * new one.
+ *
+ * Every element carries a Merkle hash of itself and everything it owns (see *DiagramTree*).
+ * Comparisons descend the ownership trees of both sides in parallel and stop at the first equal
+ * hash, so the cost of a diff or merge grows with the size of the changes, not of the diagrams.
+ * Whole diagrams are compared by their digests in the project file first (see
+ * *ProjectReader::diagramDigest()*); unchanged diagrams are not even read.
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/changes.hpp>
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/project.hpp>
+#include <sdk/util.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \enum  suzu::sdk::DiffKind
+     * \brief how an element or a diagram differs between two revisions
+     */
+    enum class DiffKind {
+        Added,   /**< only exists in the newer revision */
+        Removed, /**< only exists in the older revision */
+        Modified /**< exists in both, with different properties */
+    };
+
+    /**
+     * \struct suzu::sdk::DiffEntry
+     * \brief  single difference between two revisions
+     */
+    struct DiffEntry {
+        DiffKind    kind;       /**< kind of the difference */
+        ElementKind element;    /**< kind of the element; unspecified for whole diagrams */
+        uint32_t    properties; /**< changed properties, as bits *1 << suzu::sdk::ChangeProperty*; 0 unless modified */
+        std::string diagram;    /**< name of the diagram */
+        std::string path;       /**< path of the element, see *DiagramTree::pathOf()*; empty for whole diagrams */
+    };
+
+    /**
+     * \enum  suzu::sdk::ConflictKind
+     * \brief how both sides of a merge contradict each other
+     */
+    enum class ConflictKind {
+        BothModified,    /**< both sides changed or added the element differently; ours was kept */
+        ModifiedRemoved, /**< ours changed what theirs removed; ours was kept */
+        RemovedModified  /**< ours removed what theirs changed; theirs was kept */
+    };
+
+    /**
+     * \struct suzu::sdk::MergeConflict
+     * \brief  conflict resolved by a merge, to be reviewed by the user
+     */
+    struct MergeConflict {
+        ConflictKind kind;       /**< kind of the conflict */
+        uint32_t     properties; /**< properties changed by both sides, as bits *1 << suzu::sdk::ChangeProperty* */
+        std::string  diagram;    /**< name of the diagram */
+        std::string  path;       /**< path of the element, see *DiagramTree::pathOf()*; empty for whole diagrams */
+    };
+
+
+    namespace internal {
+        /**
+         * \brief  continues a hash with the bytes of a value
+         *
+         * \param  [in] value value without padding
+         * \param  [in] hash hash so far
+         *
+         * \return new hash
+         */
+        template<class T> uint64_t HashValue(T const &value, uint64_t const hash) noexcept {
+            return util::HashBytes(reinterpret_cast<char const *>(&value), sizeof(T), hash);
+        }
+    }
+
+
+    /**
+     * \class suzu::sdk::DiagramTree
+     * \brief ownership tree of a diagram with the identity and Merkle hash of every element
+     *
+     * Nodes are dense indices of the store. The children of every node, and the top-level
+     * elements, are sorted by identity, so that two trees are compared by merging their child
+     * lists. Owners that form a cycle are cut at the first element found on it, which becomes a
+     * top-level element.
+     */
+    class DiagramTree {
+    public:
+        static constexpr uint32_t gl_none = UINT32_MAX; /**< marks absent nodes */
+
+    private:
+        /**
+         * \struct suzu::sdk::DiagramTree::Node
+         * \brief  element in the tree
+         */
+        struct Node {
+            uint64_t key;    /**< identity; hash of the path of the element */
+            uint64_t own;    /**< hash of the properties of the element */
+            uint64_t tree;   /**< hash of the identity and the properties of the element and all it owns */
+            uint32_t parent; /**< owner, after cutting cycles; *gl_none* for top-level elements */
+            uint32_t occurs; /**< number of earlier siblings of the same kind and name */
+        };
+
+        ElementStore const   *m_store;    /**< elements; not owned */
+        std::vector<Node>     m_nodes;    /**< nodes, by dense index */
+        std::vector<uint32_t> m_first;    /**< position of the first child of every node in *m_children*; top level last */
+        std::vector<uint32_t> m_children; /**< children of all nodes, grouped by owner and sorted by identity */
+        uint64_t              m_digest;   /**< hash of all top-level trees */
+
+    public:
+        DiagramTree() noexcept
+            : m_store(nullptr), m_digest(util::gl_hashseed)
+        { }
+
+        /**
+         * \brief  builds the tree of a diagram
+         *
+         * \param  [in] store elements; must outlive the tree and not change while it is used
+         *
+         * \throw  std::bad_alloc
+         */
+        void build(ElementStore const &store) {
+            uint32_t const n = store.size();
+
+            m_store = &store;
+            m_nodes.assign(n, Node{ 0, 0, 0, gl_none, 0 });
+            for (uint32_t i = 0; i < n; ++i)
+                if (store.isValid(store.parents()[i]))
+                    m_nodes[i].parent = store.indexOf(store.parents()[i]);
+
+            /* Walks up from every element; reaching an element of the current walk again closes a cycle. */
+            std::vector<uint8_t>  state(n, 0);
+            std::vector<uint32_t> walk;
+            for (uint32_t i = 0; i < n; ++i) {
+                uint32_t curr = i;
+                for (; curr != gl_none && state[curr] == 0; curr = m_nodes[curr].parent) {
+                    state[curr] = 1;
+                    walk.push_back(curr);
+                }
+                if (curr != gl_none && state[curr] == 1)
+                    m_nodes[curr].parent = gl_none;
+
+                for (uint32_t const visited : walk)
+                    state[visited] = 2;
+                walk.clear();
+            }
+
+            /* Children are grouped by owner, in drawing order; the top level is stored as the children of node *n*. */
+            m_first.assign(static_cast<size_t>(n) + 2, 0);
+            for (uint32_t i = 0; i < n; ++i)
+                ++m_first[(m_nodes[i].parent == gl_none ? n : m_nodes[i].parent) + 1];
+            for (size_t k = 1; k < m_first.size(); ++k)
+                m_first[k] += m_first[k - 1];
+
+            std::vector<uint32_t> fill(m_first.begin(), m_first.end() - 1);
+            m_children.resize(n);
+            for (uint32_t i = 0; i < n; ++i)
+                m_children[fill[m_nodes[i].parent == gl_none ? n : m_nodes[i].parent]++] = i;
+
+            /* Identities are derived top-down, from the identity of the owner. */
+            std::unordered_map<uint64_t, uint32_t> seen;
+            std::vector<uint32_t>                  order;
+            order.reserve(n);
+            for (uint32_t k = m_first[n]; k < m_first[n + 1]; ++k)
+                order.push_back(m_children[k]);
+            for (size_t k = 0; k < order.size(); ++k) {
+                uint32_t const   i      = order[k];
+                uint32_t const   parent = m_nodes[i].parent;
+                ElementKind const kind  = store.kinds()[i];
+                std::string_view const name = store.names()[i].view();
+
+                uint64_t const pkey = parent == gl_none ? util::gl_hashseed : m_nodes[parent].key;
+                uint64_t const base = util::HashBytes(name.data(), name.size(), internal::HashValue(kind, pkey));
+                Node          &node = m_nodes[i];
+
+                node.occurs = seen[base]++;
+                node.key    = internal::HashValue(node.occurs, base);
+                node.own    = ownHash(i);
+
+                for (uint32_t c = m_first[i]; c < m_first[i + 1]; ++c)
+                    order.push_back(m_children[c]);
+            }
+
+            /* Subtree hashes are derived bottom-up, from the sorted children. */
+            for (size_t k = order.size(); k-- > 0;) {
+                uint32_t const i = order[k];
+                sortChildren(i);
+
+                uint64_t hash = internal::HashValue(m_nodes[i].own, m_nodes[i].key);
+                for (uint32_t c = m_first[i]; c < m_first[i + 1]; ++c)
+                    hash = internal::HashValue(m_nodes[m_children[c]].tree, hash);
+                m_nodes[i].tree = hash;
+            }
+            sortChildren(n);
+
+            m_digest = util::gl_hashseed;
+            for (uint32_t c = m_first[n]; c < m_first[n + 1]; ++c)
+                m_digest = internal::HashValue(m_nodes[m_children[c]].tree, m_digest);
+        }
+
+        ElementStore const *store() const noexcept { return m_store; }
+        uint32_t size() const noexcept { return static_cast<uint32_t>(m_nodes.size()); }
+
+        /**
+         * \brief  retrieves the hash of the whole diagram
+         *
+         * \return digest; equal for diagrams with the same elements, regardless of their order
+         */
+        uint64_t digest() const noexcept { return m_digest; }
+
+        /**
+         * \brief  retrieves the node whose children are the top-level elements
+         *
+         * \return pseudo-node; only valid for *childrenOf()*
+         */
+        uint32_t root() const noexcept { return size(); }
+
+        uint64_t keyOf(uint32_t const node) const noexcept { return m_nodes[node].key; }
+        uint64_t hashOf(uint32_t const node) const noexcept { return m_nodes[node].tree; }
+
+        /**
+         * \brief  retrieves the children of a node, sorted by identity
+         *
+         * \param  [in] node node, *root()*, or *gl_none*, which has no children
+         *
+         * \return first and last child, as a range
+         */
+        std::pair<uint32_t const *, uint32_t const *> childrenOf(uint32_t const node) const noexcept {
+            if (node == gl_none)
+                return { nullptr, nullptr };
+
+            return { m_children.data() + m_first[node], m_children.data() + m_first[static_cast<size_t>(node) + 1] };
+        }
+
+        /**
+         * \brief  compares the properties of two elements
+         *
+         * \param  [in] node element of this tree
+         * \param  [in] other tree of the other element
+         * \param  [in] onode other element
+         *
+         * \return differing properties, as bits *1 << suzu::sdk::ChangeProperty*
+         */
+        uint32_t compare(uint32_t const node, DiagramTree const &other, uint32_t const onode) const noexcept {
+            ElementStore const &a = *m_store;
+            ElementStore const &b = *other.m_store;
+
+            uint32_t res = 0;
+            if (std::memcmp(&a.bounds()[node], &b.bounds()[onode], sizeof(ElementRect)) != 0)
+                res |= 1u << PropertyBounds;
+            if (a.styles()[node] != b.styles()[onode])
+                res |= 1u << PropertyStyle;
+            if ((a.flags()[node] & ~static_cast<uint32_t>(ElementSelected)) != (b.flags()[onode] & ~static_cast<uint32_t>(ElementSelected)))
+                res |= 1u << PropertyFlags;
+
+            return res;
+        }
+
+        /**
+         * \brief  builds the readable path of an element, e.g. *Model::Shapes::Circle*
+         *
+         * Unnamed elements appear as their kind, e.g. *<Note>*; siblings of the same kind and name
+         * are numbered from the second one on, e.g. *<Note>#2*.
+         *
+         * \param  [in] node element
+         *
+         * \return path
+         * \throw  std::bad_alloc
+         */
+        std::string pathOf(uint32_t const node) const {
+            std::vector<uint32_t> chain;
+            for (uint32_t curr = node; curr != gl_none; curr = m_nodes[curr].parent)
+                chain.push_back(curr);
+
+            std::string res;
+            for (size_t k = chain.size(); k-- > 0;) {
+                uint32_t const         i    = chain[k];
+                std::string_view const name = m_store->names()[i].view();
+
+                if (!res.empty())
+                    res.append("::");
+                if (name.empty())
+                    res.append("<").append(gl_kindlabels[static_cast<size_t>(m_store->kinds()[i])]).append(">");
+                else
+                    res.append(name);
+                if (m_nodes[i].occurs != 0)
+                    res.append("#").append(std::to_string(m_nodes[i].occurs + 1));
+            }
+
+            return res;
+        }
+
+    private:
+        /**
+         * \brief  hashes the properties of an element, as compared by *compare()*, and its kind and name
+         *
+         * \param  [in] i dense index of the element
+         *
+         * \return hash
+         */
+        uint64_t ownHash(uint32_t const i) const noexcept {
+            std::string_view const name = m_store->names()[i].view();
+
+            uint64_t hash = internal::HashValue(m_store->kinds()[i], util::gl_hashseed);
+            hash = internal::HashValue(m_store->bounds()[i], hash);
+            hash = internal::HashValue(m_store->styles()[i], hash);
+            hash = internal::HashValue(m_store->flags()[i] & ~static_cast<uint32_t>(ElementSelected), hash);
+            return util::HashBytes(name.data(), name.size(), hash);
+        }
+
+        /**
+         * \brief sorts the children of a node by identity
+         *
+         * \param [in] node node or *root()*
+         */
+        void sortChildren(uint32_t const node) noexcept {
+            std::sort(m_children.begin() + m_first[node], m_children.begin() + m_first[static_cast<size_t>(node) + 1], [this](uint32_t const a, uint32_t const b) {
+                return m_nodes[a].key < m_nodes[b].key;
+            });
+        }
+    };
+
+
+    namespace internal {
+        /**
+         * \brief  merges the sorted child lists of up to three nodes by identity
+         *
+         * \param  [in] trees trees of the nodes
+         * \param  [in] nodes nodes; *DiagramTree::gl_none* for absent ones
+         * \param  [in] fn called with the children of equal identity, *DiagramTree::gl_none* where a
+         *                 side has none, in ascending order of identity
+         */
+        template<size_t N, class Fn> void JoinChildren(DiagramTree const *const (&trees)[N], uint32_t const (&nodes)[N], Fn &&fn) {
+            std::pair<uint32_t const *, uint32_t const *> lists[N];
+            for (size_t s = 0; s < N; ++s)
+                lists[s] = trees[s]->childrenOf(nodes[s]);
+
+            for (;;) {
+                bool     any = false;
+                uint64_t key = UINT64_MAX;
+                for (size_t s = 0; s < N; ++s)
+                    if (lists[s].first != lists[s].second && (!any || trees[s]->keyOf(*lists[s].first) < key)) {
+                        key = trees[s]->keyOf(*lists[s].first);
+                        any = true;
+                    }
+                if (!any)
+                    return;
+
+                uint32_t match[N];
+                for (size_t s = 0; s < N; ++s)
+                    match[s] = lists[s].first != lists[s].second && trees[s]->keyOf(*lists[s].first) == key ? *lists[s].first++ : DiagramTree::gl_none;
+                fn(match);
+            }
+        }
+
+        /**
+         * \brief  reports an element and everything it owns
+         *
+         * \param  [in] tree tree of the element
+         * \param  [in] node element
+         * \param  [in] kind *suzu::sdk::DiffKind::Added* or *suzu::sdk::DiffKind::Removed*
+         * \param  [in] diagram name of the diagram
+         * \param  [out] out receives the differences
+         *
+         * \throw  std::bad_alloc
+         */
+        inline void DiffSubtree(DiagramTree const &tree, uint32_t const node, DiffKind const kind, std::string const &diagram, std::vector<DiffEntry> &out) {
+            std::vector<uint32_t> stack = { node };
+
+            while (!stack.empty()) {
+                uint32_t const curr = stack.back();
+                stack.pop_back();
+
+                out.push_back({ kind, tree.store()->kinds()[curr], 0, diagram, tree.pathOf(curr) });
+                for (auto [it, end] = tree.childrenOf(curr); it != end; ++it)
+                    stack.push_back(*it);
+            }
+        }
+    }
+
+
+    /**
+     * \brief  compares two revisions of a diagram
+     *
+     * \param  [in] before older revision
+     * \param  [in] after newer revision
+     * \param  [in] diagram name of the diagram, for the entries
+     * \param  [out] out receives the differences; appended to
+     *
+     * \throw  std::bad_alloc
+     */
+    inline void DiffDiagrams(DiagramTree const &before, DiagramTree const &after, std::string const &diagram, std::vector<DiffEntry> &out) {
+        if (before.digest() == after.digest())
+            return;
+
+        DiagramTree const *const                  trees[2] = { &before, &after };
+        std::vector<std::pair<uint32_t, uint32_t>> stack    = { { before.root(), after.root() } };
+        while (!stack.empty()) {
+            uint32_t const nodes[2] = { stack.back().first, stack.back().second };
+            stack.pop_back();
+
+            internal::JoinChildren(trees, nodes, [&](uint32_t const (&match)[2]) {
+                if (match[1] == DiagramTree::gl_none)
+                    internal::DiffSubtree(before, match[0], DiffKind::Removed, diagram, out);
+                else if (match[0] == DiagramTree::gl_none)
+                    internal::DiffSubtree(after, match[1], DiffKind::Added, diagram, out);
+                else if (before.hashOf(match[0]) != after.hashOf(match[1])) {
+                    uint32_t const props = before.compare(match[0], after, match[1]);
+                    if (props != 0)
+                        out.push_back({ DiffKind::Modified, after.store()->kinds()[match[1]], props, diagram, after.pathOf(match[1]) });
+
+                    stack.emplace_back(match[0], match[1]);
+                }
+            });
+        }
+    }
+
+    /**
+     * \brief  merges two revisions of a diagram derived from a common ancestor
+     *
+     * Every element and property changed by only one side is taken from that side. Properties
+     * changed by both sides to different values are taken from ours and reported as conflicts,
+     * as are elements removed by one side and changed, or given changed children, by the other;
+     * those are kept. Elements keep the drawing order of ours; elements only theirs has are drawn
+     * on top, in their order.
+     *
+     * \param  [in] base common ancestor; an empty tree if there is none
+     * \param  [in] ours revision of the local side
+     * \param  [in] theirs revision of the other side
+     * \param  [in] diagram name of the diagram, for the conflicts
+     * \param  [out] out receives the merged elements; cleared first
+     * \param  [out] conflicts receives the conflicts; appended to
+     *
+     * \throw  std::bad_alloc
+     */
+    inline void MergeDiagrams(DiagramTree const &base, DiagramTree const &ours, DiagramTree const &theirs, std::string const &diagram, ElementStore &out, std::vector<MergeConflict> &conflicts) {
+        static constexpr size_t gl_base   = 0; /**< side of the common ancestor */
+        static constexpr size_t gl_ours   = 1; /**< side of the local revision */
+        static constexpr size_t gl_theirs = 2; /**< side of the other revision */
+
+        /**
+         * \struct Merged
+         * \brief  element of the merged diagram
+         */
+        struct Merged {
+            ElementKind kind;   /**< kind */
+            ElementRect bounds; /**< bounding box */
+            uint32_t    style;  /**< style id */
+            uint32_t    flags;  /**< *suzu::sdk::ElementFlags* */
+            StringId    name;   /**< name */
+            uint32_t    parent; /**< owner, as index into the merged elements; *DiagramTree::gl_none* for none */
+            uint64_t    order;  /**< position in the drawing order */
+        };
+
+        DiagramTree const *const trees[3] = { &base, &ours, &theirs };
+        std::vector<Merged>      merged;
+
+        /* Elements taken from theirs are ordered after their counterparts in ours, if any. */
+        std::unordered_map<uint64_t, uint32_t> inours;
+        inours.reserve(ours.size());
+        for (uint32_t i = 0; i < ours.size(); ++i)
+            inours.emplace(ours.keyOf(i), i);
+
+        auto const emit = [&](size_t const side, uint32_t const node, uint32_t const parent) {
+            ElementStore const &store = *trees[side]->store();
+
+            uint64_t order = node;
+            if (side == gl_theirs) {
+                auto const it = inours.find(theirs.keyOf(node));
+                order = it != inours.end() ? it->second : static_cast<uint64_t>(ours.size()) + node;
+            }
+
+            merged.push_back({ store.kinds()[node], store.bounds()[node], store.styles()[node], store.flags()[node] & ~static_cast<uint32_t>(ElementSelected), store.names()[node], parent, order });
+            return static_cast<uint32_t>(merged.size() - 1);
+        };
+        auto const copy = [&](size_t const side, uint32_t const node, uint32_t const parent) {
+            std::vector<std::pair<uint32_t, uint32_t>> stack = { { node, parent } };
+
+            while (!stack.empty()) {
+                auto const [curr, owner] = stack.back();
+                stack.pop_back();
+
+                uint32_t const slot = emit(side, curr, owner);
+                for (auto [it, end] = trees[side]->childrenOf(curr); it != end; ++it)
+                    stack.emplace_back(*it, slot);
+            }
+        };
+
+        /**
+         * \struct Job
+         * \brief  elements of equal identity whose children are yet to be merged
+         */
+        struct Job {
+            uint32_t nodes[3]; /**< element on every side; *DiagramTree::gl_none* where absent */
+            uint32_t slot;     /**< merged element; *DiagramTree::gl_none* for the top level */
+        };
+
+        std::vector<Job> stack = { { { base.root(), ours.root(), theirs.root() }, DiagramTree::gl_none } };
+        while (!stack.empty()) {
+            Job const job = stack.back();
+            stack.pop_back();
+
+            internal::JoinChildren(trees, job.nodes, [&](uint32_t const (&match)[3]) {
+                uint32_t const b = match[gl_base];
+                uint32_t const o = match[gl_ours];
+                uint32_t const t = match[gl_theirs];
+
+                if (o != DiagramTree::gl_none && t != DiagramTree::gl_none) {
+                    /* Identical subtrees, or subtrees only one side changed, are taken as they are. */
+                    if (ours.hashOf(o) == theirs.hashOf(t) || (b != DiagramTree::gl_none && theirs.hashOf(t) == base.hashOf(b)))
+                        return copy(gl_ours, o, job.slot);
+                    if (b != DiagramTree::gl_none && ours.hashOf(o) == base.hashOf(b))
+                        return copy(gl_theirs, t, job.slot);
+
+                    uint32_t const diff   = ours.compare(o, theirs, t);
+                    uint32_t const mine   = b != DiagramTree::gl_none ? base.compare(b, ours, o) : diff;
+                    uint32_t const others = b != DiagramTree::gl_none ? base.compare(b, theirs, t) : diff;
+                    uint32_t const clash  = diff & mine & others;
+                    uint32_t const slot   = emit(gl_ours, o, job.slot);
+
+                    Merged                   &elem  = merged[slot];
+                    ElementStore const       &store = *theirs.store();
+                    uint32_t const            take  = diff & others & ~mine;
+                    if (take & (1u << PropertyBounds))
+                        elem.bounds = store.bounds()[t];
+                    if (take & (1u << PropertyStyle))
+                        elem.style = store.styles()[t];
+                    if (take & (1u << PropertyFlags))
+                        elem.flags = store.flags()[t] & ~static_cast<uint32_t>(ElementSelected);
+                    if (clash != 0)
+                        conflicts.push_back({ ConflictKind::BothModified, clash, diagram, ours.pathOf(o) });
+
+                    stack.push_back({ { b, o, t }, slot });
+                } else if (o != DiagramTree::gl_none) {
+                    if (b == DiagramTree::gl_none)
+                        copy(gl_ours, o, job.slot);
+                    else if (ours.hashOf(o) != base.hashOf(b)) {
+                        conflicts.push_back({ ConflictKind::ModifiedRemoved, 0, diagram, ours.pathOf(o) });
+                        copy(gl_ours, o, job.slot);
+                    }
+                } else if (t != DiagramTree::gl_none) {
+                    if (b == DiagramTree::gl_none)
+                        copy(gl_theirs, t, job.slot);
+                    else if (theirs.hashOf(t) != base.hashOf(b)) {
+                        conflicts.push_back({ ConflictKind::RemovedModified, 0, diagram, theirs.pathOf(t) });
+                        copy(gl_theirs, t, job.slot);
+                    }
+                }
+            });
+        }
+
+        /* Elements are created in drawing order; owners may come after the elements they own. */
+        std::vector<uint32_t> order(merged.size());
+        for (uint32_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&](uint32_t const a, uint32_t const b) {
+            return std::make_pair(merged[a].order, a) < std::make_pair(merged[b].order, b);
+        });
+
+        out.clear();
+        out.reserve(static_cast<uint32_t>(merged.size()));
+
+        std::vector<ElementHandle> handles(merged.size());
+        for (uint32_t const i : order) {
+            Merged const &elem = merged[i];
+
+            handles[i] = out.create(elem.kind, elem.bounds, elem.style, gl_nullelement, elem.name);
+            out.flags()[out.indexOf(handles[i])] = elem.flags;
+        }
+        for (uint32_t i = 0; i < merged.size(); ++i)
+            if (merged[i].parent != DiagramTree::gl_none)
+                out.parents()[out.indexOf(handles[i])] = handles[merged[i].parent];
+    }
+
+
+    namespace internal {
+        /**
+         * \class suzu::sdk::internal::MergeInput
+         * \brief project file taking part in a diff or merge, whose diagrams are read on demand
+         */
+        class MergeInput {
+            ProjectReader                              m_reader; /**< opened project */
+            std::vector<std::unique_ptr<ElementStore>> m_stores; /**< diagrams read so far, by index */
+            std::vector<std::unique_ptr<DiagramTree>>  m_trees;  /**< trees of the diagrams read so far, by index */
+            std::map<std::pair<std::string_view, uint32_t>, uint32_t> m_names; /**< diagram index, by name and number of earlier diagrams of that name */
+
+        public:
+            /**
+             * \brief  opens a project file
+             *
+             * \param  [in] path path of the project file
+             *
+             * \return *suzu::sdk::ErrorCode::Ok* on success, or the error of *ProjectReader::open()*
+             * \throw  std::bad_alloc
+             */
+            ErrorCode open(char const *const path) {
+                ErrorCode const err = m_reader.open(path);
+                if (err != ErrorCode::Ok)
+                    return err;
+
+                std::map<std::string_view, uint32_t> occurs;
+                for (uint32_t i = 0; i < m_reader.diagramCount(); ++i)
+                    m_names.emplace(std::make_pair(m_reader.diagramName(i), occurs[m_reader.diagramName(i)]++), i);
+
+                m_stores.resize(m_reader.diagramCount());
+                m_trees.resize(m_reader.diagramCount());
+                return ErrorCode::Ok;
+            }
+
+            /**
+             * \brief releases all diagrams and closes the project file, e.g. before it is replaced
+             */
+            void close() noexcept {
+                m_trees.clear();
+                m_stores.clear();
+                m_names.clear();
+                m_reader.close();
+            }
+
+            ProjectReader const &reader() const noexcept { return m_reader; }
+            std::map<std::pair<std::string_view, uint32_t>, uint32_t> const &names() const noexcept { return m_names; }
+
+            /**
+             * \brief  finds a diagram by name
+             *
+             * \param  [in] key name and number of earlier diagrams of that name
+             *
+             * \return index of the diagram, or *DiagramTree::gl_none* if there is none
+             */
+            uint32_t find(std::pair<std::string_view, uint32_t> const &key) const noexcept {
+                auto const it = m_names.find(key);
+
+                return it != m_names.end() ? it->second : DiagramTree::gl_none;
+            }
+
+            /**
+             * \brief  reads a diagram and builds its tree
+             *
+             * \param  [in] diagram index of the diagram
+             * \param  [out] tree receives the tree; owned by the input
+             *
+             * \return *suzu::sdk::ErrorCode::Ok* on success, or the error of *ProjectReader::mapDiagram()*
+             * \throw  std::bad_alloc
+             */
+            ErrorCode tree(uint32_t const diagram, DiagramTree const *&tree) {
+                if (m_trees[diagram] == nullptr) {
+                    auto store = std::make_unique<ElementStore>();
+                    store->setIndexed(false);
+
+                    ErrorCode const err = m_reader.mapDiagram(diagram, *store);
+                    if (err != ErrorCode::Ok)
+                        return err;
+
+                    auto res = std::make_unique<DiagramTree>();
+                    res->build(*store);
+                    m_stores[diagram] = std::move(store);
+                    m_trees[diagram]  = std::move(res);
+                }
+
+                tree = m_trees[diagram].get();
+                return ErrorCode::Ok;
+            }
+
+            /**
+             * \brief  checks whether two diagrams are equal, reading them only if their digests differ
+             *
+             * \param  [in] diagram index of the diagram
+             * \param  [in] other other project
+             * \param  [in] odiagram index of the other diagram
+             * \param  [out] equal receives whether or not the diagrams are equal
+             *
+             * \return *suzu::sdk::ErrorCode::Ok* on success, or the error of *tree()*
+             * \throw  std::bad_alloc
+             */
+            ErrorCode equals(uint32_t const diagram, MergeInput &other, uint32_t const odiagram, bool &equal) {
+                equal = m_reader.diagramDigest(diagram) == other.m_reader.diagramDigest(odiagram);
+                if (equal)
+                    return ErrorCode::Ok;
+
+                DiagramTree const *a;
+                DiagramTree const *b;
+                ErrorCode          err = tree(diagram, a);
+                if (err == ErrorCode::Ok)
+                    err = other.tree(odiagram, b);
+                if (err == ErrorCode::Ok)
+                    equal = a->digest() == b->digest();
+
+                return err;
+            }
+
+            /**
+             * \brief  writes a diagram as it is
+             *
+             * \param  [in] diagram index of the diagram
+             * \param  [in,out] writer output project
+             *
+             * \return *suzu::sdk::ErrorCode::Ok* on success, or the error of reading or writing it
+             * \throw  std::bad_alloc
+             */
+            ErrorCode copy(uint32_t const diagram, ProjectWriter &writer) {
+                DiagramTree const *res;
+
+                ErrorCode const err = tree(diagram, res);
+                return err == ErrorCode::Ok ? writer.addDiagram(m_reader.diagramName(diagram), *res->store()) : err;
+            }
+        };
+    }
+
+
+    /**
+     * \brief  compares two revisions of a project file
+     *
+     * Diagrams are matched by name; diagrams of the same name are matched in file order.
+     *
+     * \param  [in] before path of the older revision
+     * \param  [in] after path of the newer revision
+     * \param  [out] out receives the differences, diagram by diagram; cleared first
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, the error of *ProjectReader::open()* or
+     *         *ProjectReader::mapDiagram()* if a file could not be read, or
+     *         *suzu::sdk::ErrorCode::CriticalResource* if memory ran out
+     */
+    inline ErrorCode DiffProjects(char const *const before, char const *const after, std::vector<DiffEntry> &out) noexcept {
+        out.clear();
+
+        try {
+            internal::MergeInput inputs[2];
+            for (size_t s = 0; s < 2; ++s) {
+                ErrorCode const err = inputs[s].open(s == 0 ? before : after);
+                if (err != ErrorCode::Ok)
+                    return err;
+            }
+
+            for (auto const &[key, diagram] : inputs[0].names())
+                if (inputs[1].find(key) == DiagramTree::gl_none)
+                    out.push_back({ DiffKind::Removed, ElementKind::Package, 0, std::string(key.first), {} });
+
+            for (auto const &[key, diagram] : inputs[1].names()) {
+                uint32_t const older = inputs[0].find(key);
+                if (older == DiagramTree::gl_none) {
+                    out.push_back({ DiffKind::Added, ElementKind::Package, 0, std::string(key.first), {} });
+
+                    continue;
+                }
+
+                bool      equal;
+                ErrorCode err = inputs[0].equals(older, inputs[1], diagram, equal);
+                if (err != ErrorCode::Ok)
+                    return err;
+                if (equal)
+                    continue;
+
+                DiagramTree const *a;
+                DiagramTree const *b;
+                if ((err = inputs[0].tree(older, a)) != ErrorCode::Ok || (err = inputs[1].tree(diagram, b)) != ErrorCode::Ok)
+                    return err;
+                DiffDiagrams(*a, *b, std::string(key.first), out);
+            }
+
+            return ErrorCode::Ok;
+        } catch (...) { }
+
+        out.clear();
+        return ErrorCode::CriticalResource;
+    }
+
+    /**
+     * \brief  merges two revisions of a project file derived from a common ancestor
+     *
+     * Diagrams are merged as by *MergeDiagrams()*. Diagrams only one side changed are copied
+     * without being merged, and those neither changed are not even read. Diagrams removed by one
+     * side and changed by the other are kept and reported as conflicts. The merged project keeps
+     * the diagram order of ours; diagrams only theirs has come last.
+     *
+     * The output may be one of the inputs, as with the merge drivers of git; it is only replaced
+     * once the merged project is complete.
+     *
+     * \param  [in] base path of the common ancestor
+     * \param  [in] ours path of the local revision
+     * \param  [in] theirs path of the other revision
+     * \param  [in] output path of the merged project
+     * \param  [out] conflicts receives the conflicts, resolved in favor of ours where possible; cleared first
+     * \param  [in] compression (optional) how hard to compress the merged project
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* if the merged project was written, even with conflicts,
+     *         the error of *ProjectReader::open()* or *ProjectReader::mapDiagram()* if a file could
+     *         not be read, *suzu::sdk::ErrorCode::WriteFile* if the output could not be written, or
+     *         *suzu::sdk::ErrorCode::CriticalResource* if memory ran out
+     */
+    inline ErrorCode MergeProjects(char const *const base, char const *const ours, char const *const theirs, char const *const output, std::vector<MergeConflict> &conflicts, Compression const compression = Compression::None) noexcept {
+        conflicts.clear();
+
+        try {
+            internal::MergeInput inputs[3];
+            char const *const    paths[3] = { base, ours, theirs };
+            for (size_t s = 0; s < 3; ++s) {
+                ErrorCode const err = inputs[s].open(paths[s]);
+                if (err != ErrorCode::Ok)
+                    return err;
+            }
+
+            ProjectWriter writer;
+            ErrorCode     err = writer.open(output, compression);
+            if (err != ErrorCode::Ok)
+                return err;
+
+            /* Diagrams of ours come first, in file order, followed by those only theirs has. */
+            std::vector<std::pair<size_t, uint32_t>> order;
+            for (uint32_t i = 0; i < inputs[1].reader().diagramCount(); ++i)
+                order.emplace_back(1, i);
+            for (uint32_t i = 0; i < inputs[2].reader().diagramCount(); ++i)
+                order.emplace_back(2, i);
+
+            std::vector<std::pair<std::pair<std::string_view, uint32_t>, uint32_t>> keys[3];
+            for (size_t s = 1; s < 3; ++s) {
+                keys[s].resize(inputs[s].reader().diagramCount());
+                for (auto const &[key, diagram] : inputs[s].names())
+                    keys[s][diagram] = { key, diagram };
+            }
+
+            for (auto const &[side, index] : order) {
+                auto const &key = keys[side][index].first;
+                uint32_t    at[3];
+                for (size_t s = 0; s < 3; ++s)
+                    at[s] = inputs[s].find(key);
+                if (side == 2 && at[1] != DiagramTree::gl_none)
+                    continue;
+
+                std::string const name(key.first);
+                /* Whether or not ours equals theirs, base equals ours, and base equals theirs. */
+                bool              same[3] = { false, false, false };
+                if (at[1] != DiagramTree::gl_none && at[2] != DiagramTree::gl_none && (err = inputs[1].equals(at[1], inputs[2], at[2], same[0])) != ErrorCode::Ok)
+                    break;
+                if (at[0] != DiagramTree::gl_none && at[1] != DiagramTree::gl_none && !same[0] && (err = inputs[0].equals(at[0], inputs[1], at[1], same[1])) != ErrorCode::Ok)
+                    break;
+                if (at[0] != DiagramTree::gl_none && at[2] != DiagramTree::gl_none && !same[0] && !same[1] && (err = inputs[0].equals(at[0], inputs[2], at[2], same[2])) != ErrorCode::Ok)
+                    break;
+
+                if (at[1] != DiagramTree::gl_none && at[2] != DiagramTree::gl_none) {
+                    if (same[0] || same[2])
+                        err = inputs[1].copy(at[1], writer);
+                    else if (same[1])
+                        err = inputs[2].copy(at[2], writer);
+                    else {
+                        DiagramTree const *trees[3];
+                        DiagramTree        none;
+                        trees[0] = &none;
+                        if ((at[0] == DiagramTree::gl_none || (err = inputs[0].tree(at[0], trees[0])) == ErrorCode::Ok) && (err = inputs[1].tree(at[1], trees[1])) == ErrorCode::Ok && (err = inputs[2].tree(at[2], trees[2])) == ErrorCode::Ok) {
+                            ElementStore store;
+                            store.setIndexed(false);
+
+                            MergeDiagrams(*trees[0], *trees[1], *trees[2], name, store, conflicts);
+                            err = writer.addDiagram(name, store);
+                        }
+                    }
+                } else if (at[0] == DiagramTree::gl_none)
+                    err = inputs[side].copy(index, writer);
+                else if (!same[side]) {
+                    /* One side removed the diagram, the other changed it; the change is kept. */
+                    conflicts.push_back({ side == 1 ? ConflictKind::ModifiedRemoved : ConflictKind::RemovedModified, 0, name, {} });
+                    err = inputs[side].copy(index, writer);
+                }
+
+                if (err != ErrorCode::Ok)
+                    break;
+            }
+            if (err != ErrorCode::Ok) {
+                conflicts.clear();
+                writer.discard();
+
+                return err;
+            }
+
+            /* Inputs are released first, so that the output may replace one of them. */
+            for (internal::MergeInput &input : inputs)
+                input.close();
+            return writer.commit();
+        } catch (...) { }
+
+        conflicts.clear();
+        return ErrorCode::CriticalResource;
+    }
+}
+
+
@@ -0,0 +1,183 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  plugin.hpp
+ * \brief binary interface between the host application and its plug-ins
+ */
+
+
+#pragma once
+
+/* sdk includes */
+#include <sdk/arena.hpp>
+#include <sdk/error.hpp>
+#include <sdk/intern.hpp>
+#include <sdk/log.hpp>
+#include <sdk/memory.hpp>
+#include <sdk/task.hpp>
+
+
+namespace suzu::sdk {
+    constexpr inline char const *gl_pluginentry   = "SuzuPluginInitialize";   /**< name of the plug-in entry point */
+    constexpr inline char const *gl_pluginsave    = "SuzuPluginSaveState";    /**< name of the state serializer; required for reloading */
+    constexpr inline char const *gl_pluginrestore = "SuzuPluginRestoreState"; /**< name of the optional state deserializer */
+
+
+    /**
+     * \struct suzu::sdk::PluginHost
+     * \brief  resources of the host application shared with a plug-in upon loading it
+     *
+     * \note  This is a plain struct of ABI-stable members; see *suzu::sdk::SinkRegistry*.
+     */
+    struct PluginHost {
+        static constexpr uint32_t gl_version = 6; /**< current ABI version */
+
+        uint32_t                  version;  /**< must be *gl_version* */
+        SinkRegistry              sinks;    /**< sinks owned by the host */
+        spdlog::level::level_enum minlvl;   /**< minimum log level used by the host */
+        LoggerOptions             logopts;  /**< logger dispatch options */
+        TaskSchedulerInterface    tasks;    /**< task scheduler owned by the host */
+        ArenaInterface            scratch;  /**< scratch arenas owned by the host */
+        StringTableInterface      strings;  /**< string table owned by the host */
+        ProfilerInterface         profiler; /**< profiler owned by the host */
+        MemoryInterface           memory;   /**< memory accounts owned by the host */
+    };
+
+    /**
+     * \brief  signature of the plug-in entry point, exported as *gl_pluginentry*
+     *
+     * The entry point is invoked once, right after the plug-in's library has been loaded.
+     *
+     * \param  [in] host resources of the host; the pointer is only valid during the call
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success; the library is unloaded otherwise
+     */
+    using PluginEntryFn = ErrorCode (*)(PluginHost const *host);
+
+    /**
+     * \struct suzu::sdk::PluginStateWriter
+     * \brief  buffer owned by the host receiving the state of a plug-in before it is reloaded
+     *
+     * \note  This is a plain struct of ABI-stable members; see *suzu::sdk::SinkRegistry*.
+     */
+    struct PluginStateWriter {
+        static constexpr uint32_t gl_version = 1; /**< current ABI version */
+
+        uint32_t version;                                                  /**< must be *gl_version* */
+        void    *context;                                                  /**< host-defined; passed to *write* */
+        ErrorCode (*write)(void *context, void const *data, size_t size); /**< appends *size* bytes to the buffer */
+    };
+
+    /**
+     * \struct suzu::sdk::PluginState
+     * \brief  ABI-stable view on the state written by the previous instance of a plug-in
+     */
+    struct PluginState {
+        static constexpr uint32_t gl_version = 1; /**< current ABI version */
+
+        uint32_t       version; /**< must be *gl_version* */
+        size_t         size;    /**< number of bytes in *data* */
+        uint8_t const *data;    /**< state, as written to the *suzu::sdk::PluginStateWriter* */
+    };
+
+    /**
+     * \brief  signature of the state serializer of a plug-in, exported as *gl_pluginsave*
+     *
+     * Invoked right before the library is unloaded to be reloaded. The plug-in must finish or
+     * cancel all tasks it submitted, remove all callbacks it registered and stop its I/O thread
+     * (see *suzu::sdk::util::ShutdownIO()*) before returning, since its code is gone afterwards. Plug-ins that do not export it cannot be reloaded, even
+     * if they have no state; they write nothing then.
+     *
+     * \param  [in] writer buffer receiving the state; only valid during the call
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success; the library is kept loaded otherwise
+     */
+    using PluginSaveFn    = ErrorCode (*)(PluginStateWriter const *writer);
+    /**
+     * \brief  signature of the optional state deserializer of a plug-in, exported as *gl_pluginrestore*
+     *
+     * Invoked right after the entry point of a reloaded library, with the state its previous
+     * instance wrote. The format of the state is up to the plug-in; it should carry a version in
+     * case the layout changes between two builds.
+     *
+     * \param  [in] state state of the previous instance; only valid during the call
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success; the plug-in runs without its state otherwise
+     */
+    using PluginRestoreFn = ErrorCode (*)(PluginState const *state);
+
+
+    /**
+     * \brief  initializes the SDK of the current plug-in instance
+     *
+     * Plug-ins should call this first from their entry point.
+     *
+     * \param  [in] host resources of the host
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+     *         the host uses an incompatible ABI, *suzu::sdk::ErrorCode::CriticalResource* if the
+     *         loggers could not be initialized
+     */
+    inline ErrorCode InitializePluginInstance(PluginHost const *host) noexcept {
+        if (host == nullptr || host->version != PluginHost::gl_version)
+            return ErrorCode::InvalidParameter;
+
+        if (!InitializeInstanceLoggers(host->sinks, host->minlvl, host->logopts))
+            return ErrorCode::CriticalResource;
+        if (!InitializeInstanceTasks(host->tasks) || !InitializeInstanceArena(host->scratch) || !InitializeInstanceStrings(host->strings) || !InitializeInstanceProfiler(host->profiler) || !InitializeInstanceMemory(host->memory))
+            return ErrorCode::InvalidParameter;
+
+        return ErrorCode::Ok;
+    }
+}
+
+
+/**
+ * \ingroup  Macros
+ * \brief    declares the entry point of a plug-in
+ *
+ * Usage:
+ *
+ *     SZSDK_PLUGIN_ENTRY(host) {
+ *         return suzu::sdk::InitializePluginInstance(host);
+ *     }
+ */
+#if defined _WIN32
+    #define SZSDK_PLUGIN_EXPORT __declspec(dllexport)
+#else
+    #define SZSDK_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+#define SZSDK_PLUGIN_ENTRY(host) \
+    extern "C" SZSDK_PLUGIN_EXPORT suzu::sdk::ErrorCode SuzuPluginInitialize(suzu::sdk::PluginHost const *host)
+
+/**
+ * \ingroup  Macros
+ * \brief    declares the state serializer and deserializer of a plug-in that supports reloading
+ *
+ * Usage:
+ *
+ *     SZSDK_PLUGIN_SAVE_STATE(writer) {
+ *         return writer->write(writer->context, &gl_state, sizeof gl_state);
+ *     }
+ *
+ *     SZSDK_PLUGIN_RESTORE_STATE(state) {
+ *         if (state->size != sizeof gl_state)
+ *             return suzu::sdk::ErrorCode::InvalidParameter;
+ *
+ *         std::memcpy(&gl_state, state->data, sizeof gl_state);
+ *         return suzu::sdk::ErrorCode::Ok;
+ *     }
+ */
+#define SZSDK_PLUGIN_SAVE_STATE(writer) \
+    extern "C" SZSDK_PLUGIN_EXPORT suzu::sdk::ErrorCode SuzuPluginSaveState(suzu::sdk::PluginStateWriter const *writer)
+#define SZSDK_PLUGIN_RESTORE_STATE(state) \
+    extern "C" SZSDK_PLUGIN_EXPORT suzu::sdk::ErrorCode SuzuPluginRestoreState(suzu::sdk::PluginState const *state)
+
+
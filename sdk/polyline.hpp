@@ -0,0 +1,350 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  polyline.hpp
+ * \brief packed line segments and vectorized point-to-segment distance kernels
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX__)
+    #include <immintrin.h>
+
+    #define SZSDK_POLYLINE_AVX
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+
+    #define SZSDK_POLYLINE_SSE
+#endif
+
+/* sdk includes */
+#include <sdk/error.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \enum  suzu::sdk::SimdLevel
+     * \brief widest instruction set a kernel may use
+     */
+    enum class SimdLevel : uint32_t {
+        Scalar, /**< plain C++ */
+        SSE,    /**< 4 lanes; only used if compiled with SSE2 */
+        AVX,    /**< 8 lanes; only used if compiled with AVX */
+
+        __NumSimdLevels__ /**< (only used internally) */
+    };
+
+
+    /**
+     * \struct suzu::sdk::SegmentHit
+     * \brief  segment closest to a point
+     */
+    struct SegmentHit {
+        uint32_t segment; /**< index of the segment; *UINT32_MAX* if there was none */
+        uint32_t owner;   /**< owner of the segment, as passed to *SegmentArray::add()* */
+        float    dist2;   /**< squared distance between the point and the segment */
+    };
+
+
+    namespace internal {
+        /**
+         * \struct suzu::sdk::internal::SegmentLanes
+         * \brief  components of packed segments, as read by the kernels
+         */
+        struct SegmentLanes {
+            float const *x;   /**< horizontal start positions */
+            float const *y;   /**< vertical start positions */
+            float const *dx;  /**< horizontal extents */
+            float const *dy;  /**< vertical extents */
+            float const *inv; /**< inverse squared lengths; 0 for degenerate segments */
+        };
+
+        /**
+         * \brief merges the closest segment found by a lane into the overall result
+         *
+         * \param [in] d2 squared distance found by the lane
+         * \param [in] i index found by the lane
+         * \param [in,out] best squared distance of the closest segment so far
+         * \param [in,out] at index of the closest segment so far
+         */
+        inline void MergeLane(float const d2, size_t const i, float &best, size_t &at) noexcept {
+            if (d2 < best || (d2 == best && d2 != HUGE_VALF && i < at)) {
+                best = d2;
+                at   = i;
+            }
+        }
+
+        /**
+         * \brief  computes the squared distance between a point and a segment
+         *
+         * \param  [in] segs segments
+         * \param  [in] i index of the segment
+         * \param  [in] px horizontal position of the point
+         * \param  [in] py vertical position of the point
+         *
+         * \return squared distance
+         */
+        inline float SegmentDistance2(SegmentLanes const &segs, size_t const i, float const px, float const py) noexcept {
+            float const ox = px - segs.x[i];
+            float const oy = py - segs.y[i];
+            float const t  = std::clamp((ox * segs.dx[i] + oy * segs.dy[i]) * segs.inv[i], 0.0f, 1.0f);
+            float const ex = ox - t * segs.dx[i];
+            float const ey = oy - t * segs.dy[i];
+
+            return ex * ex + ey * ey;
+        }
+
+#if defined(SZSDK_POLYLINE_AVX)
+        /**
+         * \brief finds the closest of the segments in [0, *end*), eight at a time
+         *
+         * \param [in] segs segments
+         * \param [in] px horizontal position of the point
+         * \param [in] py vertical position of the point
+         * \param [in] end end of the range; a multiple of 8 and at most *SegmentArray::gl_maxsegments*
+         * \param [in,out] best squared distance of the closest segment so far
+         * \param [in,out] at index of the closest segment so far
+         */
+        inline void NearestAVX(SegmentLanes const &segs, float const px, float const py, size_t const end, float &best, size_t &at) noexcept {
+            __m256 const vpx  = _mm256_set1_ps(px);
+            __m256 const vpy  = _mm256_set1_ps(py);
+            __m256 const zero = _mm256_setzero_ps();
+            __m256 const one  = _mm256_set1_ps(1.0f);
+            __m256 const step = _mm256_set1_ps(8.0f);
+            __m256       idx  = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+            __m256       min  = _mm256_set1_ps(HUGE_VALF);
+            __m256       arg  = _mm256_setzero_ps();
+
+            /* Indices are counted in floats, which are exact up to 2^24. */
+            for (size_t i = 0; i < end; i += 8) {
+                __m256 const dx  = _mm256_loadu_ps(segs.dx + i);
+                __m256 const dy  = _mm256_loadu_ps(segs.dy + i);
+                __m256 const ox  = _mm256_sub_ps(vpx, _mm256_loadu_ps(segs.x + i));
+                __m256 const oy  = _mm256_sub_ps(vpy, _mm256_loadu_ps(segs.y + i));
+                __m256 const dot = _mm256_add_ps(_mm256_mul_ps(ox, dx), _mm256_mul_ps(oy, dy));
+                __m256 const t   = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(dot, _mm256_loadu_ps(segs.inv + i)), zero), one);
+                __m256 const ex  = _mm256_sub_ps(ox, _mm256_mul_ps(t, dx));
+                __m256 const ey  = _mm256_sub_ps(oy, _mm256_mul_ps(t, dy));
+                __m256 const d2  = _mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey));
+
+                /* Only the minimum is carried from one block to the next, not the blend. */
+                __m256 const closer = _mm256_cmp_ps(d2, min, _CMP_LT_OQ);
+                min = _mm256_min_ps(d2, min);
+                arg = _mm256_blendv_ps(arg, idx, closer);
+                idx = _mm256_add_ps(idx, step);
+            }
+
+            alignas(32) float lmin[8];
+            alignas(32) float larg[8];
+            _mm256_store_ps(lmin, min);
+            _mm256_store_ps(larg, arg);
+            for (uint32_t l = 0; l < 8; ++l)
+                MergeLane(lmin[l], static_cast<size_t>(larg[l]), best, at);
+        }
+#endif
+
+#if defined(SZSDK_POLYLINE_SSE)
+        /**
+         * \brief finds the closest of the segments in [*begin*, *end*), four at a time
+         *
+         * \param [in] segs segments
+         * \param [in] px horizontal position of the point
+         * \param [in] py vertical position of the point
+         * \param [in] begin start of the range
+         * \param [in] end end of the range; *end - begin* is a multiple of 4
+         * \param [in,out] best squared distance of the closest segment so far
+         * \param [in,out] at index of the closest segment so far
+         */
+        inline void NearestSSE(SegmentLanes const &segs, float const px, float const py, size_t const begin, size_t const end, float &best, size_t &at) noexcept {
+            __m128 const  vpx  = _mm_set1_ps(px);
+            __m128 const  vpy  = _mm_set1_ps(py);
+            __m128 const  zero = _mm_setzero_ps();
+            __m128 const  one  = _mm_set1_ps(1.0f);
+            __m128i const step = _mm_set1_epi32(4);
+            __m128i       idx  = _mm_setr_epi32(0, 1, 2, 3);
+            __m128        min  = _mm_set1_ps(HUGE_VALF);
+            __m128i       arg  = _mm_setzero_si128();
+
+            for (size_t i = begin; i < end; i += 4) {
+                __m128 const dx  = _mm_loadu_ps(segs.dx + i);
+                __m128 const dy  = _mm_loadu_ps(segs.dy + i);
+                __m128 const ox  = _mm_sub_ps(vpx, _mm_loadu_ps(segs.x + i));
+                __m128 const oy  = _mm_sub_ps(vpy, _mm_loadu_ps(segs.y + i));
+                __m128 const dot = _mm_add_ps(_mm_mul_ps(ox, dx), _mm_mul_ps(oy, dy));
+                __m128 const t   = _mm_min_ps(_mm_max_ps(_mm_mul_ps(dot, _mm_loadu_ps(segs.inv + i)), zero), one);
+                __m128 const ex  = _mm_sub_ps(ox, _mm_mul_ps(t, dx));
+                __m128 const ey  = _mm_sub_ps(oy, _mm_mul_ps(t, dy));
+                __m128 const d2  = _mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey));
+
+                /* SSE2 has no blend instruction; select through the comparison mask instead. */
+                __m128 const  closer = _mm_cmplt_ps(d2, min);
+                __m128i const mask   = _mm_castps_si128(closer);
+                min = _mm_or_ps(_mm_and_ps(closer, d2), _mm_andnot_ps(closer, min));
+                arg = _mm_or_si128(_mm_and_si128(mask, idx), _mm_andnot_si128(mask, arg));
+                idx = _mm_add_epi32(idx, step);
+            }
+
+            alignas(16) float   lmin[4];
+            alignas(16) int32_t larg[4];
+            _mm_store_ps(lmin, min);
+            _mm_store_si128(reinterpret_cast<__m128i *>(larg), arg);
+            for (uint32_t l = 0; l < 4; ++l)
+                MergeLane(lmin[l], begin + static_cast<size_t>(larg[l]), best, at);
+        }
+#endif
+    }
+
+
+    /**
+     * \class suzu::sdk::SegmentArray
+     * \brief line segments of many polylines, stored component by component
+     *
+     * Every component of the segments (start point, extent, inverse squared length, owner) is kept
+     * in an array of its own, so the distance kernels load four or eight segments with one
+     * instruction per component. The inverse squared length is computed once when adding, so the
+     * kernels need no division. Meant as the narrow phase after a spatial index has found the
+     * polylines near a point: pack their segments, then call *nearest()*.
+     *
+     * \note  The array is not thread-safe; *nearest()* only reads it.
+     */
+    class SegmentArray {
+    public:
+        static constexpr size_t gl_maxsegments = size_t(1) << 24; /**< maximum number of segments; the AVX kernel counts them in floats */
+
+    private:
+        std::vector<float>    m_x;     /**< horizontal start positions */
+        std::vector<float>    m_y;     /**< vertical start positions */
+        std::vector<float>    m_dx;    /**< horizontal extents */
+        std::vector<float>    m_dy;    /**< vertical extents */
+        std::vector<float>    m_inv;   /**< inverse squared lengths; 0 for degenerate segments */
+        std::vector<uint32_t> m_owner; /**< owners */
+
+    public:
+        /**
+         * \brief  retrieves the number of segments
+         *
+         * \return number of segments
+         */
+        size_t size() const noexcept { return m_x.size(); }
+
+        /**
+         * \brief removes all segments; the memory is kept for reuse
+         */
+        void clear() noexcept {
+            m_x.clear();
+            m_y.clear();
+            m_dx.clear();
+            m_dy.clear();
+            m_inv.clear();
+            m_owner.clear();
+        }
+
+        /**
+         * \brief reserves memory for *n* segments
+         *
+         * \param [in] n number of segments
+         * \throw std::bad_alloc
+         */
+        void reserve(size_t const n) {
+            m_x.reserve(n);
+            m_y.reserve(n);
+            m_dx.reserve(n);
+            m_dy.reserve(n);
+            m_inv.reserve(n);
+            m_owner.reserve(n);
+        }
+
+        /**
+         * \brief  adds the segments of a polyline
+         *
+         * \param  [in] owner value reported for the segments, e.g. the index of the polyline
+         * \param  [in] points vertices as pairs of horizontal and vertical positions
+         * \param  [in] n number of vertices; polylines with fewer than two add nothing
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::InvalidParameter*
+         *         if the array would exceed *gl_maxsegments*
+         * \throw  std::bad_alloc
+         */
+        ErrorCode add(uint32_t const owner, float const *const points, size_t const n) {
+            if (n < 2)
+                return ErrorCode::Ok;
+            else if (size() + n - 1 > gl_maxsegments)
+                return ErrorCode::InvalidParameter;
+
+            for (size_t i = 0; i + 1 < n; ++i) {
+                float const x  = points[2 * i];
+                float const y  = points[2 * i + 1];
+                float const dx = points[2 * i + 2] - x;
+                float const dy = points[2 * i + 3] - y;
+                float const l2 = dx * dx + dy * dy;
+
+                m_x.push_back(x);
+                m_y.push_back(y);
+                m_dx.push_back(dx);
+                m_dy.push_back(dy);
+                m_inv.push_back(l2 > 0.0f ? 1.0f / l2 : 0.0f);
+                m_owner.push_back(owner);
+            }
+
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief  finds the segment closest to a point
+         *
+         * Uses AVX for blocks of eight segments if compiled with it, then SSE2 for blocks of four,
+         * then plain C++ for the rest.
+         *
+         * \param  [in] px horizontal position of the point
+         * \param  [in] py vertical position of the point
+         * \param  [in] simd (optional) widest instruction set to use, e.g. for benchmarks
+         *
+         * \return closest segment; of equally close ones, the first added
+         */
+        SegmentHit nearest(float const px, float const py, SimdLevel const simd = SimdLevel::AVX) const noexcept {
+            internal::SegmentLanes const segs = { m_x.data(), m_y.data(), m_dx.data(), m_dy.data(), m_inv.data() };
+            size_t const                 n    = size();
+            size_t                       i    = 0;
+            float                        best = HUGE_VALF;
+            size_t                       at   = SIZE_MAX;
+
+#if defined(SZSDK_POLYLINE_AVX)
+            if (simd >= SimdLevel::AVX && n >= 8) {
+                internal::NearestAVX(segs, px, py, n - n % 8, best, at);
+
+                i = n - n % 8;
+            }
+#endif
+#if defined(SZSDK_POLYLINE_SSE)
+            if (simd >= SimdLevel::SSE && n - i >= 4) {
+                internal::NearestSSE(segs, px, py, i, n - (n - i) % 4, best, at);
+
+                i = n - (n - i) % 4;
+            }
+#endif
+            for (; i < n; ++i)
+                internal::MergeLane(internal::SegmentDistance2(segs, i, px, py), i, best, at);
+
+            if (at == SIZE_MAX)
+                return { UINT32_MAX, 0, HUGE_VALF };
+            return { static_cast<uint32_t>(at), m_owner[at], best };
+        }
+    };
+}
+
+
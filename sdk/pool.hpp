@@ -0,0 +1,181 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  pool.hpp
+ * \brief slab allocator for objects of a single type
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/memory.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \class suzu::sdk::ObjectPool
+     * \brief allocates objects of type *T* from slabs of *SlabSize* objects each
+     *
+     * Objects of the same type are packed next to each other instead of being scattered over the
+     * heap, and destroyed objects leave a slot that is reused by the next *create()*. Creating and
+     * destroying many objects, e.g. during paste, undo or import, thus neither fragments the heap
+     * nor calls the global allocator per object. *clear()* destroys all remaining objects and
+     * returns all slabs to the heap at once, e.g. when a diagram is closed.
+     *
+     * Objects never move; pointers stay valid until the object is destroyed or the pool is cleared.
+     * Slabs are tracked in a memory account (see *suzu::sdk::MemoryAccounts*), by default the one
+     * active when the first slab is allocated.
+     *
+     * \note  The pool is not thread-safe.
+     */
+    template<class T, size_t SlabSize = 256> class ObjectPool {
+        static_assert(SlabSize > 0, "slabs must hold at least one object");
+
+        /**
+         * \struct suzu::sdk::ObjectPool::Node
+         * \brief  a single slot of a slab
+         */
+        struct Node {
+            union {
+                Node                    *next;           /**< next free slot, if unused */
+                alignas(T) unsigned char obj[sizeof(T)]; /**< storage of the object, if used */
+            };
+            bool used; /**< whether or not the slot holds an object */
+        };
+
+        /**
+         * \struct suzu::sdk::ObjectPool::Slab
+         * \brief  a block of *SlabSize* slots
+         */
+        struct Slab {
+            Node nodes[SlabSize]; /**< slots */
+        };
+
+        std::vector<std::unique_ptr<Slab>> m_slabs;   /**< all slabs */
+        Node                              *m_free;    /**< first free slot in any slab; *nullptr* if none */
+        size_t                             m_size;    /**< number of live objects */
+        uint32_t                           m_account; /**< memory account of the slabs; 0 until the first slab is allocated, unless given */
+
+    public:
+        /**
+         * \brief constructs an empty pool
+         *
+         * \param [in] account (optional) memory account of the slabs, see
+         *             *suzu::sdk::internal::RegisterAccount()*; 0 for the one active when the first
+         *             slab is allocated
+         */
+        explicit ObjectPool(uint32_t const account = 0) noexcept
+            : m_free(nullptr), m_size(0), m_account(account)
+        { }
+        ObjectPool(ObjectPool const &) = delete;
+        ObjectPool &operator =(ObjectPool const &) = delete;
+        ~ObjectPool() { clear(); }
+
+        /**
+         * \brief  retrieves the number of live objects
+         *
+         * \return number of objects
+         */
+        size_t size() const noexcept { return m_size; }
+
+        /**
+         * \brief  retrieves the number of objects the pool can hold without allocating
+         *
+         * \return number of slots in all slabs
+         */
+        size_t capacity() const noexcept { return m_slabs.size() * SlabSize; }
+
+        /**
+         * \brief  constructs a new object in the pool
+         *
+         * \param  [in] args arguments forwarded to the constructor of *T*
+         *
+         * \return pointer to the new object
+         */
+        template<class ...Args> T *create(Args &&...args) {
+            if (m_free == nullptr)
+                grow();
+
+            Node *const node = m_free;
+            Node *const next = node->next;
+            T    *const obj  = new (node->obj) T(std::forward<Args>(args)...);
+
+            m_free     = next;
+            node->used = true;
+            ++m_size;
+            return obj;
+        }
+
+        /**
+         * \brief destroys an object created by this pool
+         *
+         * \param [in] obj object to destroy; may be *nullptr*
+         */
+        void destroy(T *const obj) noexcept {
+            if (obj == nullptr)
+                return;
+
+            obj->~T();
+
+            /* The object is stored at the beginning of its slot. */
+            Node *const node = reinterpret_cast<Node *>(obj);
+            node->used = false;
+            node->next = m_free;
+            m_free     = node;
+            --m_size;
+        }
+
+        /**
+         * \brief destroys all objects and releases all slabs
+         */
+        void clear() noexcept {
+            for (auto const &slab : m_slabs)
+                for (size_t i = 0; i < SlabSize; ++i)
+                    if (slab->nodes[i].used)
+                        reinterpret_cast<T *>(slab->nodes[i].obj)->~T();
+
+            internal::TrackMemory(m_account, -static_cast<int64_t>(m_slabs.size() * sizeof(Slab)));
+            m_slabs.clear();
+            m_slabs.shrink_to_fit();
+            m_free = nullptr;
+            m_size = 0;
+        }
+
+    private:
+        /**
+         * \brief adds a slab and links its slots into the free list
+         */
+        void grow() {
+            m_slabs.push_back(std::make_unique<Slab>());
+            if (m_account == 0)
+                m_account = internal::CurrentAccount();
+            internal::TrackMemory(m_account, static_cast<int64_t>(sizeof(Slab)));
+
+            Node *const nodes = m_slabs.back()->nodes;
+            for (size_t i = 0; i < SlabSize; ++i) {
+                nodes[i].next = i + 1 < SlabSize ? &nodes[i + 1] : m_free;
+                nodes[i].used = false;
+            }
+
+            m_free = nodes;
+        }
+    };
+}
+
+
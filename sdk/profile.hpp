@@ -0,0 +1,644 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  profile.hpp
+ * \brief recorder of nested profiling zones, shared by the host application and its plug-ins
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined SZSDK_PROFILE_TRACY
+    #include <tracy/TracyC.h>
+#endif
+
+/* sdk includes */
+#include <sdk/error.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \class suzu::sdk::Profiler
+     * \brief recorder of nested zones, e.g. hot paths, per thread
+     *
+     * Every thread records into a ring buffer of its own, without locks: entering and leaving a
+     * zone each cost a clock read and a store. Buffers are allocated on the first zone a thread
+     * enters and kept for the lifetime of the profiler; *collect()* drains them while threads keep
+     * recording. A full buffer drops whole zones, never only their end, so the recorded zones of a
+     * thread always nest properly.
+     *
+     * *collect()* is the only consumer of the buffers. While a trace is being recorded (see
+     * *setRetaining()*), it keeps a copy of every event it passes on, so that a caller collecting
+     * for its own use, e.g. a heads-up display, does not take the events away from the trace.
+     *
+     * Zones are registered once per call site (see *SZSDK_PROFILE_SCOPE()*) and identified by id
+     * afterwards. Plug-ins record into the host's profiler through *suzu::sdk::ProfilerInterface*,
+     * so the zones of the host and of all plug-ins end up on a single timeline.
+     *
+     * If *SZSDK_PROFILE_TRACY* is defined when compiling the host, zones are also reported to a
+     * Tracy client (C API of Tracy 0.11), which has to be linked in.
+     *
+     * \note  The profiler must outlive all threads recording into it.
+     */
+    class Profiler {
+    public:
+        static constexpr size_t   gl_capacity = size_t(1) << 16; /**< events buffered per thread until they are collected; a power of two */
+        static constexpr uint32_t gl_maxzones = 8192;            /**< maximum number of registered zones */
+        static constexpr uint32_t gl_maxdepth = 64;              /**< nesting depth up to which the active zone of a thread is tracked */
+
+        /**
+         * \struct suzu::sdk::Profiler::Zone
+         * \brief  registered call site
+         */
+        struct Zone {
+            std::string name; /**< name of the zone */
+            std::string file; /**< source file of the call site */
+            uint32_t    line; /**< line of the call site */
+        };
+
+        /**
+         * \struct suzu::sdk::Profiler::Event
+         * \brief  a thread entering or leaving a zone
+         */
+        struct Event {
+            int64_t  time;   /**< nanoseconds since the origin of the profiler */
+            uint32_t zone;   /**< id of the zone entered; 0 when leaving the innermost zone */
+            uint32_t thread; /**< id of the recording thread, counted from 1 */
+        };
+
+    private:
+        /**
+         * \struct suzu::sdk::Profiler::ThreadBuffer
+         * \brief  events of a single thread, written by it and read by *collect()*
+         */
+        struct ThreadBuffer {
+            std::unique_ptr<Event[]> events;             /**< ring of *gl_capacity* events */
+            std::atomic<uint64_t>    head;               /**< number of events written; only written by the owning thread */
+            std::atomic<uint64_t>    tail;               /**< number of events collected; only written by *collect()* */
+            uint32_t                 thread;             /**< id of the owning thread */
+            uint32_t                 depth;              /**< number of recorded zones not left yet */
+            uint32_t                 skip;               /**< number of dropped zones not left yet */
+            uint32_t                 open;               /**< number of zones entered and not left yet, recorded or not */
+            uint32_t                 stack[gl_maxdepth]; /**< ids of the zones entered and not left yet, outermost first */
+            std::atomic<uint32_t>    active;             /**< id of the innermost zone in *stack*; 0 outside of zones */
+#if defined SZSDK_PROFILE_TRACY
+            std::vector<TracyCZoneCtx> tracy; /**< zones reported to Tracy and not left yet */
+#endif
+        };
+
+        mutable std::mutex                         m_lock;    /**< guards registration and *m_buffers* */
+        std::unique_ptr<Zone[]>                    m_zones;   /**< registered zones, by id - 1; never moved, so that they can be read without the lock */
+        std::atomic<uint32_t>                      m_nzones;  /**< number of registered zones */
+        std::vector<std::unique_ptr<ThreadBuffer>> m_buffers; /**< buffers of all threads that recorded */
+        std::atomic<bool>                          m_enabled; /**< whether or not zones are recorded */
+        std::atomic<uint64_t>                      m_dropped; /**< number of zones dropped because a buffer was full */
+        std::chrono::steady_clock::time_point      m_origin;  /**< time point all timestamps are relative to */
+        std::vector<Event>                         m_kept;    /**< events collected while retaining, for *exportChromeTrace()*; guarded by *m_lock* */
+        bool                                       m_retain;  /**< whether or not collected events are kept; guarded by *m_lock* */
+
+    public:
+        Profiler() noexcept
+            : m_nzones(0), m_enabled(false), m_dropped(0), m_origin(std::chrono::steady_clock::now()), m_retain(false)
+        { }
+        Profiler(Profiler const &) = delete;
+        Profiler &operator =(Profiler const &) = delete;
+
+        /**
+         * \brief  retrieves the profiler of the current module
+         *
+         * \return reference to the profiler
+         */
+        static Profiler &Local() noexcept {
+            static Profiler gl_profiler;
+
+            return gl_profiler;
+        }
+
+        /**
+         * \brief enables or disables recording
+         *
+         * Zones entered while disabled are not recorded, even if left after enabling again.
+         *
+         * \param [in] enabled whether or not to record zones
+         */
+        void setEnabled(bool const enabled) noexcept { m_enabled.store(enabled, std::memory_order_relaxed); }
+        bool isEnabled() const noexcept { return m_enabled.load(std::memory_order_relaxed); }
+
+        /**
+         * \brief sets whether or not *collect()* keeps a copy of the events it collects, for
+         *        *exportChromeTrace()*, e.g. while a trace is being recorded
+         *
+         * \param [in] retain whether or not to keep collected events; *false* also discards those
+         *        kept so far
+         */
+        void setRetaining(bool const retain) noexcept {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            m_retain = retain;
+            if (!retain)
+                m_kept = {};
+        }
+
+        /**
+         * \brief  retrieves the number of zones dropped because a buffer was full
+         *
+         * \return number of zones; collecting more often avoids drops
+         */
+        uint64_t dropped() const noexcept { return m_dropped.load(std::memory_order_relaxed); }
+
+        /**
+         * \brief  registers a zone
+         *
+         * \param  [in] name name of the zone
+         * \param  [in] file source file of the call site
+         * \param  [in] line line of the call site
+         *
+         * \return id of the zone, or 0 if too many zones were registered or memory ran out
+         */
+        uint32_t zone(char const *const name, char const *const file, uint32_t const line) noexcept {
+            try {
+                std::lock_guard<std::mutex> lock(m_lock);
+                if (m_zones == nullptr)
+                    m_zones = std::make_unique<Zone[]>(gl_maxzones);
+
+                uint32_t const n = m_nzones.load(std::memory_order_relaxed);
+                if (n == gl_maxzones)
+                    return 0;
+
+                m_zones[n] = { name != nullptr ? name : "", file != nullptr ? file : "", line };
+                m_nzones.store(n + 1, std::memory_order_release);
+                return n + 1;
+            } catch (...) { }
+
+            return 0;
+        }
+
+        /**
+         * \brief  enters a zone on the calling thread
+         *
+         * \param  [in] zone id returned by *zone()*
+         *
+         * \return *true* if *end()* has to be called when leaving the zone; *false* if recording is
+         *         disabled or *zone* is 0
+         */
+        bool begin(uint32_t const zone) noexcept {
+            if (zone == 0 || !isEnabled())
+                return false;
+
+            ThreadBuffer *const buf = buffer();
+            if (buf == nullptr)
+                return false;
+
+#if defined SZSDK_PROFILE_TRACY
+            Zone const &info = m_zones[zone - 1];
+            try {
+                uint64_t const srcloc = ___tracy_alloc_srcloc_name(info.line, info.file.data(), info.file.size(), info.name.data(), info.name.size(), info.name.data(), info.name.size(), 0);
+
+                buf->tracy.push_back(___tracy_emit_zone_begin_alloc(srcloc, 1));
+            } catch (...) {
+                return false;
+            }
+#endif
+
+            if (buf->open < gl_maxdepth) {
+                buf->stack[buf->open] = zone;
+                buf->active.store(zone, std::memory_order_relaxed);
+            }
+            ++buf->open;
+
+            /* Every recorded zone keeps a slot free for its end; zones inside dropped ones are dropped, too. */
+            uint64_t const head = buf->head.load(std::memory_order_relaxed);
+            if (buf->skip != 0 || head - buf->tail.load(std::memory_order_acquire) + buf->depth + 2 > gl_capacity) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                ++buf->skip;
+
+                return true;
+            }
+
+            push(*buf, head, zone);
+            ++buf->depth;
+            return true;
+        }
+
+        /**
+         * \brief leaves the zone entered last on the calling thread
+         *
+         * Must only be called if the matching *begin()* returned *true*.
+         */
+        void end() noexcept {
+            ThreadBuffer *const buf = buffer();
+            if (buf == nullptr)
+                return;
+
+#if defined SZSDK_PROFILE_TRACY
+            if (!buf->tracy.empty()) {
+                ___tracy_emit_zone_end(buf->tracy.back());
+                buf->tracy.pop_back();
+            }
+#endif
+
+            if (buf->open != 0 && --buf->open < gl_maxdepth)
+                buf->active.store(buf->open != 0 ? buf->stack[buf->open - 1] : 0, std::memory_order_relaxed);
+
+            if (buf->skip != 0) {
+                --buf->skip;
+
+                return;
+            }
+            if (buf->depth == 0)
+                return;
+
+            push(*buf, buf->head.load(std::memory_order_relaxed), 0);
+            --buf->depth;
+        }
+
+        /**
+         * \brief  retrieves the id of the calling thread, as used in recorded events
+         *
+         * \return id of the thread, counted from 1, or 0 if memory ran out
+         */
+        uint32_t thread() noexcept {
+            ThreadBuffer const *const buf = buffer();
+
+            return buf != nullptr ? buf->thread : 0;
+        }
+
+        /**
+         * \brief  retrieves the innermost zone a thread is in, e.g. to tell what a stuck thread is doing
+         *
+         * Zones are only tracked while recording is enabled, and down to *gl_maxdepth* levels.
+         * The result may be outdated as soon as it is returned.
+         *
+         * \param  [in] thread id returned by *thread()* on the thread
+         *
+         * \return id of the zone, or 0 if the thread is outside of all zones or *thread* is unknown
+         */
+        uint32_t active(uint32_t const thread) const noexcept {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            return thread != 0 && thread <= m_buffers.size() ? m_buffers[thread - 1]->active.load(std::memory_order_relaxed) : 0;
+        }
+
+        /**
+         * \brief  retrieves a registered zone
+         *
+         * \param  [in] zone id returned by *zone()*
+         *
+         * \return zone, or *nullptr* if *zone* is not a registered id
+         */
+        Zone const *info(uint32_t const zone) const noexcept {
+            return zone != 0 && zone <= m_nzones.load(std::memory_order_acquire) ? &m_zones[zone - 1] : nullptr;
+        }
+
+        /**
+         * \brief  removes all buffered events and passes them to a function
+         *
+         * Events are passed thread by thread, each thread's in the order they were recorded.
+         * Threads keep recording meanwhile; their new events are left for the next call. While
+         * retaining (see *setRetaining()*), the events are also kept for *exportChromeTrace()*.
+         *
+         * \param  [in] fn function of the form *void(suzu::sdk::Profiler::Event const &)*
+         *
+         * \return number of events collected
+         */
+        template<class Fn> size_t collect(Fn &&fn) {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            return drain(std::forward<Fn>(fn), m_retain);
+        }
+
+        /**
+         * \brief  collects all kept and buffered events as a trace in the Chrome trace event format
+         *
+         * The trace can be viewed with *chrome://tracing* or *Perfetto*. Zones still open on a
+         * thread have no end in the trace; those left since the previous call have no beginning.
+         *
+         * \param  [out] res receives the JSON document
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if memory ran out
+         */
+        ErrorCode exportChromeTrace(std::string &res) noexcept {
+            try {
+                res = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+                bool       first  = true;
+                auto const append = [&](Event const &event) {
+                    if (!first)
+                        res += ',';
+                    first = false;
+
+                    appendEvent(res, event);
+                };
+
+                /* Kept events were recorded before those still buffered, so every thread's stay in order. */
+                std::lock_guard<std::mutex> lock(m_lock);
+                for (Event const &event : m_kept)
+                    append(event);
+                m_kept.clear();
+                drain(append, false);
+
+                res += "]}";
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            res.clear();
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  writes previously collected events as a trace in the Chrome trace event format
+         *
+         * \param  [in] events events, e.g. those kept by a caller of *collect()*
+         * \param  [in] count number of elements in *events*
+         * \param  [out] res receives the JSON document; *']}'* are its last two characters, so that
+         *              callers can insert events of their own before them
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if memory ran out
+         */
+        ErrorCode exportChromeTrace(Event const *const events, size_t const count, std::string &res) const noexcept {
+            try {
+                res = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+                for (size_t i = 0; i < count; ++i) {
+                    if (i != 0)
+                        res += ',';
+
+                    appendEvent(res, events[i]);
+                }
+
+                res += "]}";
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            res.clear();
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  retrieves the current time on the clock of the recorded events
+         *
+         * \return nanoseconds since the origin of the profiler
+         */
+        int64_t now() const noexcept {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_origin).count();
+        }
+
+    private:
+        /**
+         * \brief  removes all buffered events and passes them to a function; *m_lock* must be held
+         *
+         * \param  [in] fn function of the form *void(suzu::sdk::Profiler::Event const &)*
+         * \param  [in] keep whether or not to keep a copy of the events in *m_kept*; events are
+         *         not kept if memory runs out
+         *
+         * \return number of events collected
+         */
+        template<class Fn> size_t drain(Fn &&fn, bool keep) {
+            size_t res = 0;
+            for (std::unique_ptr<ThreadBuffer> const &buf : m_buffers) {
+                uint64_t const tail = buf->tail.load(std::memory_order_relaxed);
+                uint64_t const head = buf->head.load(std::memory_order_acquire);
+
+                if (keep) {
+                    try {
+                        m_kept.reserve(m_kept.size() + static_cast<size_t>(head - tail));
+                    } catch (...) {
+                        keep = false;
+                    }
+                }
+
+                for (uint64_t i = tail; i < head; ++i) {
+                    Event const &event = buf->events[i & (gl_capacity - 1)];
+
+                    if (keep)
+                        m_kept.push_back(event);
+                    fn(event);
+                }
+                buf->tail.store(head, std::memory_order_release);
+                res += static_cast<size_t>(head - tail);
+            }
+
+            return res;
+        }
+
+        /**
+         * \brief  retrieves the buffer of the calling thread, creating it on first use
+         *
+         * \return buffer, or *nullptr* if memory ran out
+         */
+        ThreadBuffer *buffer() noexcept {
+            thread_local Profiler     *tl_owner  = nullptr;
+            thread_local ThreadBuffer *tl_buffer = nullptr;
+            if (tl_owner == this)
+                return tl_buffer;
+
+            try {
+                auto buf = std::make_unique<ThreadBuffer>();
+                buf->events = std::make_unique<Event[]>(gl_capacity);
+                buf->head   = 0;
+                buf->tail   = 0;
+                buf->depth  = 0;
+                buf->skip   = 0;
+                buf->open   = 0;
+                buf->active = 0;
+
+                std::lock_guard<std::mutex> lock(m_lock);
+                buf->thread = static_cast<uint32_t>(m_buffers.size() + 1);
+                m_buffers.push_back(std::move(buf));
+
+                tl_owner  = this;
+                tl_buffer = m_buffers.back().get();
+                return tl_buffer;
+            } catch (...) { }
+
+            return nullptr;
+        }
+
+        /**
+         * \brief appends an event to a buffer of the calling thread; the buffer must not be full
+         *
+         * \param [in,out] buf buffer
+         * \param [in] head current head of *buf*
+         * \param [in] zone id of the zone entered; 0 when leaving
+         */
+        void push(ThreadBuffer &buf, uint64_t const head, uint32_t const zone) noexcept {
+            buf.events[head & (gl_capacity - 1)] = { now(), zone, buf.thread };
+            buf.head.store(head + 1, std::memory_order_release);
+        }
+
+        /**
+         * \brief appends an event in the Chrome trace event format
+         *
+         * \param [in,out] res text to append to
+         * \param [in] event event to append
+         * \throw std::bad_alloc
+         */
+        void appendEvent(std::string &res, Event const &event) const {
+            char         buf[96];
+            double const us = static_cast<double>(event.time) / 1000.0;
+            if (event.zone == 0) {
+                std::snprintf(buf, sizeof(buf), "{\"ph\":\"E\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}", event.thread, us);
+                res += buf;
+
+                return;
+            }
+
+            Zone const *const zone = info(event.zone);
+            res += "{\"name\":";
+            AppendString(res, zone != nullptr ? zone->name : std::string_view());
+            res += ",\"args\":{\"file\":";
+            AppendString(res, zone != nullptr ? zone->file : std::string_view());
+            std::snprintf(buf, sizeof(buf), ",\"line\":%u},\"ph\":\"B\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}", zone != nullptr ? zone->line : 0, event.thread, us);
+            res += buf;
+        }
+
+        /**
+         * \brief appends a string as a JSON string literal
+         *
+         * \param [in,out] res text to append to
+         * \param [in] str string to append
+         * \throw std::bad_alloc
+         */
+        static void AppendString(std::string &res, std::string_view const str) {
+            res += '"';
+            for (char const c : str) {
+                if (c == '"' || c == '\\') {
+                    res += '\\';
+                    res += c;
+                } else if (static_cast<unsigned char>(c) < 0x20) {
+                    char esc[8];
+                    std::snprintf(esc, sizeof(esc), "\\u%04x", static_cast<unsigned>(c));
+                    res += esc;
+                } else
+                    res += c;
+            }
+            res += '"';
+        }
+    };
+
+
+    /**
+     * \struct suzu::sdk::ProfilerInterface
+     * \brief  ABI-stable view on the profiler owned by the host application
+     *
+     * Like *suzu::sdk::StringTableInterface*, this is a plain struct of raw pointers.
+     */
+    struct ProfilerInterface {
+        static constexpr uint32_t gl_version = 1; /**< current ABI version */
+
+        uint32_t   version;                                                             /**< must be *gl_version* */
+        void      *profiler;                                                            /**< opaque profiler object */
+        uint32_t (*zone)(void *profiler, char const *name, char const *file, uint32_t line); /**< registers a zone; returns its id, or 0 on failure */
+        bool     (*begin)(void *profiler, uint32_t zone);                               /**< enters a zone; returns whether *end* has to be called */
+        void     (*end)(void *profiler);                                                /**< leaves the zone entered last on the calling thread */
+
+        /**
+         * \brief  retrieves the interface to the profiler of the current module
+         *
+         * \return profiler interface; valid for the lifetime of the module
+         */
+        static ProfilerInterface Local() noexcept {
+            return {
+                gl_version,
+                &Profiler::Local(),
+                [](void *profiler, char const *name, char const *file, uint32_t line) { return static_cast<Profiler *>(profiler)->zone(name, file, line); },
+                [](void *profiler, uint32_t zone) { return static_cast<Profiler *>(profiler)->begin(zone); },
+                [](void *profiler) { static_cast<Profiler *>(profiler)->end(); }
+            };
+        }
+    };
+
+
+    namespace internal {
+        /**
+         * Profiler used by the current instance, set by *InitializeInstanceProfiler()*. Until then,
+         * the module's own profiler is used.
+         */
+        inline ProfilerInterface gl_profiler = { ProfilerInterface::gl_version, nullptr, nullptr, nullptr, nullptr };
+
+        /**
+         * \brief  retrieves the profiler used by the current instance
+         *
+         * \return profiler interface
+         */
+        inline ProfilerInterface CurrentProfiler() noexcept {
+            return gl_profiler.begin != nullptr ? gl_profiler : ProfilerInterface::Local();
+        }
+
+        /**
+         * \brief  registers a zone with the profiler of the current instance
+         *
+         * \param  [in] name name of the zone
+         * \param  [in] file source file of the call site
+         * \param  [in] line line of the call site
+         *
+         * \return id of the zone, or 0 on failure
+         */
+        inline uint32_t RegisterZone(char const *const name, char const *const file, uint32_t const line) noexcept {
+            ProfilerInterface const iface = CurrentProfiler();
+
+            return iface.zone(iface.profiler, name, file, line);
+        }
+    }
+
+    /**
+     * \brief  sets the profiler used by the current instance
+     *
+     * \param  [in] iface profiler interface passed by the host
+     *
+     * \return *true* on success, *false* if the interface has an incompatible ABI version
+     * \note   Zones registered before this call belong to the module's own profiler; as call sites
+     *         register on first use, this should be called before any zone is entered.
+     */
+    inline bool InitializeInstanceProfiler(ProfilerInterface const &iface) noexcept {
+        if (iface.version != ProfilerInterface::gl_version || iface.zone == nullptr || iface.begin == nullptr || iface.end == nullptr)
+            return false;
+
+        internal::gl_profiler = iface;
+        return true;
+    }
+
+
+    /**
+     * \class suzu::sdk::ProfileScope
+     * \brief records a zone covering the lifetime of this object; see *SZSDK_PROFILE_SCOPE()*
+     */
+    class ProfileScope {
+        ProfilerInterface m_iface;  /**< profiler the zone was entered in */
+        bool              m_active; /**< whether or not the zone has to be left */
+
+    public:
+        explicit ProfileScope(uint32_t const zone) noexcept
+            : m_iface(internal::CurrentProfiler())
+        {
+            m_active = m_iface.begin(m_iface.profiler, zone);
+        }
+        ProfileScope(ProfileScope const &) = delete;
+        ProfileScope &operator =(ProfileScope const &) = delete;
+        ~ProfileScope() {
+            if (m_active)
+                m_iface.end(m_iface.profiler);
+        }
+    };
+}
+
+
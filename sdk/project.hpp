@@ -0,0 +1,1513 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  project.hpp
+ * \brief native binary project format
+ *
+ * A project file is a container of independent chunks:
+ *
+ *     [header][chunk 0]...[chunk n - 1][index]
+ *
+ * The header stores the position of the index, which describes every chunk (type, name, size,
+ * position and hash). Every diagram is a chunk of its own, holding the component arrays of its
+ * elements back-to-back. Names are not stored in the diagrams but as indices into the string
+ * table chunk, which holds every distinct string of the project once.
+ *
+ * Opening a project only reads the header and the index. Loading a diagram maps in its chunk and
+ * the strings it uses, so the cost of displaying a diagram does not depend on the size of the
+ * project. Diagrams can even be opened without copying their kinds and bounds (see
+ * *ProjectReader::mapDiagram()*). All values are stored in little-endian byte order; chunks start
+ * at 8-byte boundaries, so all arrays are suitably aligned for direct access.
+ *
+ * Chunks may be stored compressed (see *ChunkEncoding* and *sdk/compress.hpp*), which shrinks the
+ * redundant component arrays to a fraction of their size. Compressed diagrams are decoded into
+ * memory when they are opened, so they cannot be mapped.
+ *
+ * Saves do not have to rewrite the project. Changed diagrams are appended to the journal
+ * *<project>.journal* instead (see *ProjectJournal*):
+ *
+ *     [journal header][record 0]...[record n - 1]
+ *
+ * Every record replaces one diagram as a whole and carries its own strings, so replaying a
+ * record twice is harmless. *ProjectReader* overlays the newest record of every diagram onto the
+ * project file. Compacting the journal writes a new project file and starts a new journal.
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/compress.hpp>
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/intern.hpp>
+#include <sdk/util.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \brief  builds a four-character chunk type
+     *
+     * \param  [in] tag four characters
+     *
+     * \return type, which reads as *tag* in a hex dump of the file
+     */
+    constexpr uint32_t MakeChunkType(char const (&tag)[5]) noexcept {
+        return static_cast<uint32_t>(static_cast<unsigned char>(tag[0]))
+            | static_cast<uint32_t>(static_cast<unsigned char>(tag[1])) << 8
+            | static_cast<uint32_t>(static_cast<unsigned char>(tag[2])) << 16
+            | static_cast<uint32_t>(static_cast<unsigned char>(tag[3])) << 24;
+    }
+
+    constexpr uint32_t gl_chunkstrings = MakeChunkType("STRS"); /**< type of the string table chunk */
+    constexpr uint32_t gl_chunkdiagram = MakeChunkType("DIAG"); /**< type of diagram chunks */
+
+
+    /**
+     * \enum  suzu::sdk::ChunkEncoding
+     * \brief how the bytes of a chunk are stored
+     */
+    enum class ChunkEncoding : uint32_t {
+        Raw, /**< as they are */
+        Lz4  /**< *u64 size of the decoded chunk*, followed by the chunk compressed as a single block */
+    };
+
+
+    /**
+     * \struct suzu::sdk::ProjectHeader
+     * \brief  first bytes of every project file
+     */
+    struct ProjectHeader {
+        static constexpr char     gl_magic[8] = { 'S', 'U', 'Z', 'U', 'P', 'R', 'O', 'J' }; /**< identifies project files */
+        static constexpr uint32_t gl_version  = 2;                                          /**< current format version; 2 added compressed chunks */
+
+        char     magic[8];  /**< must be *gl_magic* */
+        uint32_t version;   /**< format version; files of newer versions are rejected */
+        uint32_t chunks;    /**< number of entries in the index */
+        uint64_t index;     /**< position of the index */
+        uint64_t indexhash; /**< *suzu::sdk::util::HashBytes()* of the index */
+    };
+    static_assert(sizeof(ProjectHeader) == 32, "project header layout must not change");
+
+    /**
+     * \struct suzu::sdk::ProjectChunk
+     * \brief  index entry describing a single chunk
+     *
+     * Diagram chunks hold *u32 count, u32 0* followed by the arrays *kinds (u32)*, *bounds (4 x f32)*,
+     * *styles (u32)*, *flags (u32)*, *parents (u32 element index; UINT32_MAX for none)* and *names (u32
+     * string index)*, each with *count* entries.
+     *
+     * The string table chunk holds *u32 count, u32 0*, *count + 1* u32 offsets and the characters of
+     * all strings. String *i* spans the characters from *offsets[i]* to *offsets[i + 1]*; string 0
+     * is the empty string.
+     *
+     * Position, size and hash always refer to the bytes as stored in the file, so that compressed
+     * chunks can be validated before they are decoded.
+     */
+    struct ProjectChunk {
+        uint32_t type;     /**< type of the chunk, e.g. *gl_chunkdiagram* */
+        uint32_t name;     /**< string index of the name of the chunk; 0 if it has none */
+        uint32_t count;    /**< number of items in the chunk, e.g. elements */
+        uint32_t encoding; /**< *suzu::sdk::ChunkEncoding* of the chunk; 0 in files of version 1 */
+        uint64_t offset;   /**< position of the chunk */
+        uint64_t size;     /**< size of the chunk in the file, in bytes */
+        uint64_t hash;     /**< *suzu::sdk::util::HashBytes()* of the chunk in the file */
+    };
+    static_assert(sizeof(ProjectChunk) == 40, "project chunk layout must not change");
+    static_assert(sizeof(ElementKind) == 4 && sizeof(ElementRect) == 16 && alignof(ElementRect) <= 4, "diagram chunks are mapped as component arrays");
+
+    /**
+     * \struct suzu::sdk::JournalHeader
+     * \brief  first bytes of every journal
+     */
+    struct JournalHeader {
+        static constexpr char     gl_magic[8] = { 'S', 'U', 'Z', 'U', 'J', 'R', 'N', 'L' }; /**< identifies journals */
+        static constexpr uint32_t gl_version  = 1;                                          /**< current format version */
+
+        char     magic[8]; /**< must be *gl_magic* */
+        uint32_t version;  /**< format version; journals of newer versions are ignored */
+        uint32_t reserved; /**< reserved; 0 */
+        uint64_t base;     /**< *suzu::sdk::ProjectHeader::indexhash* of the project file the journal applies to */
+        uint64_t padding;  /**< reserved; 0 */
+    };
+    static_assert(sizeof(JournalHeader) == 32, "journal header layout must not change");
+
+    /**
+     * \struct suzu::sdk::JournalRecord
+     * \brief  header of a journal record
+     *
+     * The header is followed by *size* bytes: a string table laid out like the string table chunk,
+     * and, at offset *strings*, a diagram laid out like a diagram chunk. String indices of the
+     * record refer to its own string table.
+     */
+    struct JournalRecord {
+        uint32_t type;    /**< type of the record; *gl_chunkdiagram* */
+        uint32_t diagram; /**< index of the replaced diagram; *suzu::sdk::ProjectReader::diagramCount()* adds a diagram */
+        uint32_t name;    /**< string index of the name of the diagram */
+        uint32_t count;   /**< number of elements */
+        uint64_t strings; /**< offset of the diagram from the end of the header, in bytes; a multiple of 8 */
+        uint64_t size;    /**< number of bytes following the header; a multiple of 8 */
+        uint64_t hash;    /**< *suzu::sdk::util::HashBytes()* of the preceding header fields and the following bytes */
+    };
+    static_assert(sizeof(JournalRecord) == 40, "journal record layout must not change");
+
+
+    namespace internal {
+        static constexpr size_t gl_projecteltsize = 36; /**< bytes per element in a diagram chunk */
+
+        template<class T> void PutValue(char *&pos, T const &value) noexcept {
+            std::memcpy(pos, &value, sizeof(T));
+
+            pos += sizeof(T);
+        }
+
+        template<class T> T GetValue(char const *const base, size_t const index) noexcept {
+            T value;
+            std::memcpy(&value, base + index * sizeof(T), sizeof(T));
+
+            return value;
+        }
+
+        /**
+         * \brief  encodes the elements of a diagram as a diagram chunk
+         *
+         * Selection state is not saved.
+         *
+         * \param  [in] store elements of the diagram
+         * \param  [in] addString maps the names of the elements to string indices
+         * \param  [out] out receives the chunk
+         *
+         * \throw  std::bad_alloc
+         */
+        template<class Fn> void EncodeDiagram(ElementStore const &store, Fn &&addString, std::vector<char> &out) {
+            uint32_t const n = store.size();
+
+            out.assign(8 + gl_projecteltsize * static_cast<size_t>(n), 0);
+            char *pos = out.data();
+            PutValue(pos, n);
+            PutValue(pos, uint32_t(0));
+
+            for (uint32_t i = 0; i < n; ++i)
+                PutValue(pos, static_cast<uint32_t>(store.kinds()[i]));
+            for (uint32_t i = 0; i < n; ++i)
+                PutValue(pos, store.bounds()[i]);
+            for (uint32_t i = 0; i < n; ++i)
+                PutValue(pos, store.styles()[i]);
+            for (uint32_t i = 0; i < n; ++i)
+                PutValue(pos, store.flags()[i] & ~static_cast<uint32_t>(ElementSelected));
+            for (uint32_t i = 0; i < n; ++i)
+                PutValue(pos, store.indexOf(store.parents()[i]));
+            for (uint32_t i = 0; i < n; ++i)
+                PutValue(pos, addString(store.names()[i]));
+        }
+
+        /**
+         * \brief  encodes strings as a string table chunk
+         *
+         * \param  [in] strings strings, by string index; string 0 must be empty
+         * \param  [out] out receives the chunk
+         *
+         * \throw  std::bad_alloc
+         */
+        inline void EncodeStrings(std::vector<std::string_view> const &strings, std::vector<char> &out) {
+            uint32_t const count = static_cast<uint32_t>(strings.size());
+            size_t         chars = 0;
+            for (std::string_view const str : strings)
+                chars += str.size();
+
+            out.assign(8 + 4 * (static_cast<size_t>(count) + 1) + chars, 0);
+            char    *pos    = out.data();
+            char    *text   = pos + 8 + 4 * (static_cast<size_t>(count) + 1);
+            uint32_t offset = 0;
+            PutValue(pos, count);
+            PutValue(pos, uint32_t(0));
+            for (std::string_view const str : strings) {
+                PutValue(pos, offset);
+
+                if (!str.empty())
+                    std::memcpy(text + offset, str.data(), str.size());
+                offset += static_cast<uint32_t>(str.size());
+            }
+            PutValue(pos, offset);
+        }
+
+        /**
+         * \brief  retrieves the string index of a string, adding it to a string table if necessary
+         *
+         * \param  [in] str interned string
+         * \param  [in,out] strings strings, by string index; views into the string table
+         * \param  [in,out] ids string index, by *suzu::sdk::StringId::value()*
+         *
+         * \return string index
+         * \throw  std::bad_alloc
+         */
+        inline uint32_t AddString(StringId const str, std::vector<std::string_view> &strings, std::unordered_map<uint32_t, uint32_t> &ids) {
+            if (str.empty())
+                return 0;
+            if (strings.empty())
+                strings.push_back({});
+
+            auto const [it, inserted] = ids.try_emplace(str.value(), static_cast<uint32_t>(strings.size()));
+            if (inserted) {
+                try {
+                    strings.push_back(str.view());
+                } catch (...) {
+                    ids.erase(it);
+
+                    throw;
+                }
+            }
+
+            return it->second;
+        }
+
+        /**
+         * \brief  decodes a compressed chunk
+         *
+         * \param  [in] data chunk as stored in the file
+         * \param  [in] size size of *data*, in bytes
+         * \param  [out] out receives the decoded chunk
+         *
+         * \return *true* if the chunk is valid
+         * \throw  std::bad_alloc
+         */
+        inline bool DecodeChunk(char const *const data, uint64_t const size, std::vector<char> &out) {
+            static constexpr uint64_t gl_maxratio = 255; /**< largest expansion of an LZ4 block */
+
+            uint64_t decoded;
+            if (size < sizeof(decoded))
+                return false;
+            std::memcpy(&decoded, data, sizeof(decoded));
+            if (decoded > (size - sizeof(decoded)) * gl_maxratio || decoded > SIZE_MAX)
+                return false;
+
+            out.resize(static_cast<size_t>(decoded));
+            return DecompressBlock(data + sizeof(decoded), static_cast<size_t>(size - sizeof(decoded)), out.data(), out.size());
+        }
+
+        /**
+         * \brief  computes the hash of a journal record
+         *
+         * \param  [in] record header of the record
+         * \param  [in] data bytes following the header
+         *
+         * \return hash, as stored in *suzu::sdk::JournalRecord::hash*
+         */
+        inline uint64_t HashRecord(JournalRecord const &record, char const *const data) noexcept {
+            uint64_t const hash = util::HashBytes(reinterpret_cast<char const *>(&record), offsetof(JournalRecord, hash));
+
+            return util::HashBytes(data, static_cast<size_t>(record.size), hash);
+        }
+    }
+
+
+    /**
+     * \class suzu::sdk::ProjectWriter
+     * \brief writes a project file, one diagram at a time
+     *
+     * Diagrams are encoded and written as they are added, so memory use does not grow with the
+     * size of the project. The file is written to a temporary location and only replaces the
+     * previous project on *commit()*.
+     */
+    class ProjectWriter {
+        static constexpr size_t gl_minpacked = 256; /**< chunks smaller than this are never compressed, in bytes */
+
+        util::AtomicFile                       m_file;        /**< output file */
+        uint64_t                               m_offset;      /**< number of bytes written */
+        Compression                            m_compression; /**< how hard to compress chunks */
+        std::vector<ProjectChunk>              m_index;       /**< chunks written so far */
+        std::vector<std::string_view>          m_strings;     /**< strings, by string index; views into the string table */
+        std::unordered_map<uint32_t, uint32_t> m_ids;         /**< string index, by *suzu::sdk::StringId::value()* */
+        std::vector<char>                      m_buffer;      /**< encoded chunk */
+        std::vector<char>                      m_packed;      /**< compressed chunk */
+
+    public:
+        ProjectWriter() noexcept
+            : m_offset(0), m_compression(Compression::None)
+        { }
+
+        /**
+         * \brief  starts writing a project
+         *
+         * \param  [in] path path of the project file
+         * \param  [in] compression (optional) how hard to compress chunks; chunks that do not
+         *              shrink are stored as they are
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::OpenFile* if the
+         *         temporary file could not be created
+         */
+        ErrorCode open(char const *const path, Compression const compression = Compression::None) noexcept {
+            discard();
+
+            ErrorCode const err = m_file.open(path, true);
+            if (err != ErrorCode::Ok)
+                return err;
+            m_compression = compression;
+
+            /* The header is written last, once the position of the index is known. */
+            ProjectHeader const header = {};
+            m_offset = 0;
+            return write(&header, sizeof(header));
+        }
+
+        /**
+         * \brief  writes a diagram
+         *
+         * Selection state is not saved.
+         *
+         * \param  [in] name name of the diagram
+         * \param  [in] store elements of the diagram
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if no
+         *         file is open, or *suzu::sdk::ErrorCode::WriteFile* if the diagram could not be
+         *         written; the project is discarded then
+         */
+        ErrorCode addDiagram(std::string_view const name, ElementStore const &store) noexcept {
+            if (m_file.handle() == nullptr)
+                return ErrorCode::InvalidState;
+
+            try {
+                internal::EncodeDiagram(store, [this](StringId const str) { return addString(str); }, m_buffer);
+
+                ErrorCode const err = writeChunk(gl_chunkdiagram, addString(StringId(name)), store.size());
+                if (err == ErrorCode::Ok)
+                    return err;
+            } catch (...) { }
+
+            discard();
+            return ErrorCode::WriteFile;
+        }
+
+        /**
+         * \brief  writes a chunk of another type, e.g. data derived from the diagrams
+         *
+         * Readers skip chunks of types they do not know; *suzu::sdk::ProjectReader::chunk()*
+         * retrieves them.
+         *
+         * \param  [in] type type of the chunk; neither *gl_chunkdiagram* nor *gl_chunkstrings*
+         * \param  [in] name name of the chunk
+         * \param  [in] data bytes of the chunk
+         * \param  [in] size number of bytes
+         * \param  [in] count number of items in the chunk
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         *type* is reserved, *suzu::sdk::ErrorCode::InvalidState* if no file is open, or
+         *         *suzu::sdk::ErrorCode::WriteFile* if the chunk could not be written; the project is
+         *         discarded then
+         */
+        ErrorCode addChunk(uint32_t const type, std::string_view const name, char const *const data, size_t const size, uint32_t const count) noexcept {
+            if (type == gl_chunkdiagram || type == gl_chunkstrings)
+                return ErrorCode::InvalidParameter;
+            if (m_file.handle() == nullptr)
+                return ErrorCode::InvalidState;
+
+            try {
+                m_buffer.assign(data, data + size);
+
+                ErrorCode const err = writeChunk(type, addString(StringId(name)), count);
+                if (err == ErrorCode::Ok)
+                    return err;
+            } catch (...) { }
+
+            discard();
+            return ErrorCode::WriteFile;
+        }
+
+        /**
+         * \brief  writes the string table and the index, and replaces the previous project file
+         *
+         * \param  [in] durable whether or not to flush the file to the storage device first
+         * \param  [in] prepare (optional) called with the *suzu::sdk::ProjectHeader::indexhash* of
+         *         the new file once it is complete, right before it replaces the previous one, e.g.
+         *         to start a journal for it; an error aborts the commit
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if no
+         *         file is open, *suzu::sdk::ErrorCode::WriteFile* if the file could not be written,
+         *         or the error returned by *prepare*
+         * \note   On failure, the previous project file remains untouched.
+         */
+        ErrorCode commit(bool const durable = false, std::function<ErrorCode(uint64_t identity)> const &prepare = {}) noexcept {
+            if (m_file.handle() == nullptr)
+                return ErrorCode::InvalidState;
+
+            try {
+                /* String table. */
+                if (m_strings.empty())
+                    m_strings.push_back({});
+                uint32_t const count = static_cast<uint32_t>(m_strings.size());
+                internal::EncodeStrings(m_strings, m_buffer);
+
+                ErrorCode err = writeChunk(gl_chunkstrings, 0, count);
+
+                /* Index and header. */
+                ProjectHeader header;
+                std::memcpy(header.magic, ProjectHeader::gl_magic, sizeof(header.magic));
+                header.version   = ProjectHeader::gl_version;
+                header.chunks    = static_cast<uint32_t>(m_index.size());
+                header.index     = m_offset;
+                header.indexhash = util::HashBytes(reinterpret_cast<char const *>(m_index.data()), m_index.size() * sizeof(ProjectChunk));
+
+                if (err == ErrorCode::Ok)
+                    err = write(m_index.data(), m_index.size() * sizeof(ProjectChunk));
+                if (err == ErrorCode::Ok && std::fseek(m_file.handle(), 0, SEEK_SET) != 0)
+                    err = ErrorCode::WriteFile;
+                if (err == ErrorCode::Ok)
+                    err = m_file.write(reinterpret_cast<char const *>(&header), sizeof(header));
+
+                if (err == ErrorCode::Ok && prepare) {
+                    err = prepare(header.indexhash);
+                    if (err != ErrorCode::Ok) {
+                        discard();
+
+                        return err;
+                    }
+                }
+                if (err == ErrorCode::Ok) {
+                    err = m_file.commit(durable);
+
+                    reset();
+                    return err;
+                }
+            } catch (...) { }
+
+            discard();
+            return ErrorCode::WriteFile;
+        }
+
+        /**
+         * \brief abandons the project being written; the previous project file remains untouched
+         */
+        void discard() noexcept {
+            m_file.discard();
+
+            reset();
+        }
+
+    private:
+        /**
+         * \brief drops all state of the project being written
+         */
+        void reset() noexcept {
+            m_offset = 0;
+            m_index.clear();
+            m_strings.clear();
+            m_ids.clear();
+            m_buffer.clear();
+            m_packed.clear();
+        }
+
+        /**
+         * \brief  retrieves the string index of a string, adding it to the string table if necessary
+         *
+         * \param  [in] str interned string
+         *
+         * \return string index
+         * \throw  std::bad_alloc
+         */
+        uint32_t addString(StringId const str) {
+            return internal::AddString(str, m_strings, m_ids);
+        }
+
+        /**
+         * \brief  appends *m_buffer* as a chunk, starting at the next 8-byte boundary
+         *
+         * The chunk is compressed first, unless compression is disabled or does not pay off.
+         *
+         * \param  [in] type type of the chunk
+         * \param  [in] name string index of the name of the chunk
+         * \param  [in] count number of items in the chunk
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::WriteFile* if the
+         *         chunk could not be written
+         * \throw  std::bad_alloc
+         */
+        ErrorCode writeChunk(uint32_t const type, uint32_t const name, uint32_t const count) {
+            static constexpr char gl_padding[8] = {};
+
+            ErrorCode err = write(gl_padding, static_cast<size_t>((8 - m_offset % 8) % 8));
+            if (err != ErrorCode::Ok)
+                return err;
+
+            ChunkEncoding            encoding = ChunkEncoding::Raw;
+            std::vector<char> const *stored   = &m_buffer;
+            if (m_compression != Compression::None && m_buffer.size() >= gl_minpacked) {
+                uint64_t const decoded = m_buffer.size();
+
+                m_packed.resize(sizeof(decoded));
+                std::memcpy(m_packed.data(), &decoded, sizeof(decoded));
+                CompressBlock(m_buffer.data(), m_buffer.size(), m_compression, m_packed);
+                if (m_packed.size() < m_buffer.size()) {
+                    encoding = ChunkEncoding::Lz4;
+                    stored   = &m_packed;
+                }
+            }
+
+            m_index.push_back({ type, name, count, static_cast<uint32_t>(encoding), m_offset, stored->size(), util::HashBytes(stored->data(), stored->size()) });
+            err = write(stored->data(), stored->size());
+            if (err != ErrorCode::Ok)
+                m_index.pop_back();
+
+            return err;
+        }
+
+        /**
+         * \brief  appends bytes to the file
+         *
+         * \param  [in] data bytes to append
+         * \param  [in] len number of bytes
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::WriteFile* on failure
+         */
+        ErrorCode write(void const *const data, size_t const len) noexcept {
+            ErrorCode const err = m_file.write(static_cast<char const *>(data), len);
+            if (err == ErrorCode::Ok)
+                m_offset += len;
+
+            return err;
+        }
+    };
+
+
+    /**
+     * \class suzu::sdk::ProjectJournal
+     * \brief appends changed diagrams to the journal of a project
+     *
+     * Saving a diagram through the journal costs a single append and a flush, no matter how large
+     * the rest of the project is. A record that could not be written completely is cut off again,
+     * so that the journal always ends with a complete record.
+     *
+     * The journal can be folded into a new project file while saves go on: *stage()* copies the
+     * records the new file does not contain into *<journal>.next*, based on the new file, and
+     * *promote()* replaces the journal with it once the new file is in place. Readers fall back to
+     * *<journal>.next* if the journal does not match the project file, so no save is lost if the
+     * application stops in between.
+     *
+     * \note  The journal is not thread-safe.
+     */
+    class ProjectJournal {
+        std::string                            m_path;    /**< path of the journal */
+        std::FILE                             *m_handle;  /**< journal, opened for appending; *nullptr* if closed */
+        uint64_t                               m_size;    /**< size of the journal, in bytes */
+        std::vector<std::string_view>          m_strings; /**< strings of the record being written, by string index */
+        std::unordered_map<uint32_t, uint32_t> m_ids;     /**< string index, by *suzu::sdk::StringId::value()* */
+        std::vector<char>                      m_buffer;  /**< record being written, without its header */
+        std::vector<char>                      m_diagram; /**< encoded diagram of the record being written */
+
+    public:
+        ProjectJournal() noexcept
+            : m_handle(nullptr), m_size(0)
+        { }
+        ProjectJournal(ProjectJournal const &) = delete;
+        ProjectJournal &operator =(ProjectJournal const &) = delete;
+        ~ProjectJournal() { close(); }
+
+        /**
+         * \brief  retrieves the path of the journal of a project
+         *
+         * \param  [in] project path of the project file
+         *
+         * \return path of the journal
+         * \throw  std::bad_alloc
+         */
+        static std::string PathOf(char const *const project) { return std::string{ project } + ".journal"; }
+
+        /**
+         * \brief  opens the journal of a project for appending, creating it if necessary
+         *
+         * A journal that does not belong to *base* is replaced by an empty one. Anything after the
+         * first *valid* bytes, e.g. a record torn by a crash, is cut off.
+         *
+         * \param  [in] project path of the project file
+         * \param  [in] base *suzu::sdk::ProjectReader::identity()* of the project file
+         * \param  [in] valid *suzu::sdk::ProjectReader::journalSize()*; 0 to start an empty journal
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::OpenFile* if the
+         *         journal could not be opened
+         */
+        ErrorCode open(char const *const project, uint64_t const base, uint64_t const valid) noexcept {
+            close();
+            if (project == nullptr)
+                return ErrorCode::InvalidParameter;
+
+            try {
+                m_path = PathOf(project);
+                std::string const next = m_path + ".next";
+
+                /* A compaction was interrupted right after the new project file was put in place. */
+                std::error_code ec;
+                if (std::filesystem::exists(next, ec)) {
+                    uint64_t current;
+                    uint64_t staged;
+
+                    if ((!ReadBase(m_path.c_str(), current) || current != base) && ReadBase(next.c_str(), staged) && staged == base)
+                        std::filesystem::rename(next, m_path, ec);
+                    else
+                        std::filesystem::remove(next, ec);
+                }
+
+                uint64_t current;
+                if (valid < sizeof(JournalHeader) || !ReadBase(m_path.c_str(), current) || current != base)
+                    return create(base);
+
+                std::filesystem::resize_file(m_path, valid, ec);
+                if (!ec)
+                    m_handle = std::fopen(m_path.c_str(), "ab");
+                if (m_handle == nullptr) {
+                    close();
+
+                    return ErrorCode::OpenFile;
+                }
+
+                m_size = valid;
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            close();
+            return ErrorCode::OpenFile;
+        }
+
+        /**
+         * \brief closes the journal
+         */
+        void close() noexcept {
+            if (m_handle != nullptr)
+                std::fclose(m_handle);
+
+            m_handle = nullptr;
+            m_size   = 0;
+            m_path.clear();
+        }
+
+        bool isOpen() const noexcept { return m_handle != nullptr; }
+
+        /**
+         * \brief  retrieves the size of the journal
+         *
+         * \return number of bytes, including the header
+         */
+        uint64_t size() const noexcept { return m_size; }
+
+        /**
+         * \brief  appends a diagram, replacing its previous contents
+         *
+         * Selection state is not saved.
+         *
+         * \param  [in] diagram index of the diagram; the number of diagrams to add one
+         * \param  [in] name name of the diagram
+         * \param  [in] store elements of the diagram
+         * \param  [in] durable whether or not to flush the journal to the storage device
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if the
+         *         journal is not open, or *suzu::sdk::ErrorCode::WriteFile* if the record could not
+         *         be written; the journal is unchanged then, or closed if it could not be restored
+         */
+        ErrorCode append(uint32_t const diagram, std::string_view const name, ElementStore const &store, bool const durable = false) noexcept {
+            if (m_handle == nullptr)
+                return ErrorCode::InvalidState;
+
+            JournalRecord record;
+            try {
+                m_strings.assign(1, {});
+                m_ids.clear();
+                internal::EncodeDiagram(store, [this](StringId const str) { return internal::AddString(str, m_strings, m_ids); }, m_diagram);
+
+                record.type    = gl_chunkdiagram;
+                record.diagram = diagram;
+                record.name    = internal::AddString(StringId(name), m_strings, m_ids);
+                record.count   = store.size();
+                internal::EncodeStrings(m_strings, m_buffer);
+
+                record.strings = Align(m_buffer.size());
+                record.size    = Align(record.strings + m_diagram.size());
+                m_buffer.resize(static_cast<size_t>(record.strings), 0);
+                m_buffer.insert(m_buffer.end(), m_diagram.begin(), m_diagram.end());
+                m_buffer.resize(static_cast<size_t>(record.size), 0);
+                record.hash = internal::HashRecord(record, m_buffer.data());
+            } catch (...) {
+                return ErrorCode::WriteFile;
+            }
+
+            bool ok = std::fwrite(&record, 1, sizeof(record), m_handle) == sizeof(record);
+            ok = ok && std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_handle) == m_buffer.size();
+            ok = std::fflush(m_handle) == 0 && ok;
+            if (ok && durable)
+#if defined _WIN32
+                ok = _commit(_fileno(m_handle)) == 0;
+#else
+                ok = fsync(fileno(m_handle)) == 0;
+#endif
+            if (ok) {
+                m_size += sizeof(record) + m_buffer.size();
+
+                return ErrorCode::Ok;
+            }
+
+            /* Records after a torn one would be ignored by readers. The handle is closed before the
+             * cut, so that nothing it still buffers is written past it. */
+            std::fclose(m_handle);
+            m_handle = nullptr;
+
+            std::error_code ec;
+            std::filesystem::resize_file(m_path, m_size, ec);
+            if (!ec)
+                m_handle = std::fopen(m_path.c_str(), "ab");
+            return ErrorCode::WriteFile;
+        }
+
+        /**
+         * \brief  writes *<journal>.next*, a journal for a new project file holding the records that
+         *         are not part of it
+         *
+         * \param  [in] base *suzu::sdk::ProjectHeader::indexhash* of the new project file
+         * \param  [in] from size of the journal when the new project file was started, i.e. the
+         *         *suzu::sdk::ProjectReader::journalSize()* it was read with
+         * \param  [in] durable whether or not to flush the file to the storage device
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if the
+         *         journal is not open, *suzu::sdk::ErrorCode::InvalidParameter* if *from* is not a
+         *         valid position, or *suzu::sdk::ErrorCode::WriteFile* on failure
+         */
+        ErrorCode stage(uint64_t const base, uint64_t const from, bool const durable = false) noexcept {
+            if (m_handle == nullptr)
+                return ErrorCode::InvalidState;
+            else if (from < sizeof(JournalHeader) || from > m_size)
+                return ErrorCode::InvalidParameter;
+
+            try {
+                util::MappedFile current;
+                util::AtomicFile next;
+                if (current.open(m_path.c_str()) != ErrorCode::Ok || current.size() < m_size)
+                    return ErrorCode::WriteFile;
+                if (next.open((m_path + ".next").c_str(), true) != ErrorCode::Ok)
+                    return ErrorCode::WriteFile;
+
+                JournalHeader const header = MakeHeader(base);
+                ErrorCode err = next.write(reinterpret_cast<char const *>(&header), sizeof(header));
+                if (err == ErrorCode::Ok)
+                    err = next.write(current.data() + from, static_cast<size_t>(m_size - from));
+
+                /* The journal must not stay mapped, or *promote()* could not replace it. */
+                current.close();
+                if (err == ErrorCode::Ok)
+                    err = next.commit(durable);
+
+                return err == ErrorCode::Ok ? ErrorCode::Ok : ErrorCode::WriteFile;
+            } catch (...) { }
+
+            return ErrorCode::WriteFile;
+        }
+
+        /**
+         * \brief  replaces the journal with the one written by *stage()*
+         *
+         * Must be called once the new project file is in place, and without appending to the
+         * journal since *stage()*.
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if the
+         *         journal is not open, or *suzu::sdk::ErrorCode::WriteFile* on failure; the journal
+         *         is closed then and the project has to be saved as a whole
+         */
+        ErrorCode promote() noexcept {
+            if (m_handle == nullptr)
+                return ErrorCode::InvalidState;
+
+            std::fclose(m_handle);
+            m_handle = nullptr;
+            try {
+                std::error_code ec;
+                std::filesystem::rename(m_path + ".next", m_path, ec);
+
+                uint64_t const size = ec ? 0 : std::filesystem::file_size(m_path, ec);
+                if (!ec)
+                    m_handle = std::fopen(m_path.c_str(), "ab");
+                if (m_handle != nullptr) {
+                    m_size = size;
+
+                    return ErrorCode::Ok;
+                }
+            } catch (...) { }
+
+            close();
+            return ErrorCode::WriteFile;
+        }
+
+    private:
+        /**
+         * \brief  starts an empty journal, replacing any existing one
+         *
+         * \param  [in] base *suzu::sdk::ProjectHeader::indexhash* of the project file
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::OpenFile* on failure
+         */
+        ErrorCode create(uint64_t const base) noexcept {
+            JournalHeader const header = MakeHeader(base);
+
+            m_handle = std::fopen(m_path.c_str(), "wb");
+            if (m_handle == nullptr || std::fwrite(&header, 1, sizeof(header), m_handle) != sizeof(header) || std::fflush(m_handle) != 0) {
+                close();
+
+                return ErrorCode::OpenFile;
+            }
+
+            m_size = sizeof(header);
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief  reads the project file a journal belongs to
+         *
+         * \param  [in] path path of the journal
+         * \param  [out] base receives *suzu::sdk::JournalHeader::base*
+         *
+         * \return *true* if the file is a journal of a supported version
+         */
+        static bool ReadBase(char const *const path, uint64_t &base) noexcept {
+            JournalHeader header;
+
+            std::FILE *const file = std::fopen(path, "rb");
+            if (file == nullptr)
+                return false;
+            bool const ok = std::fread(&header, 1, sizeof(header), file) == sizeof(header);
+            std::fclose(file);
+
+            if (!ok || std::memcmp(header.magic, JournalHeader::gl_magic, sizeof(header.magic)) != 0 || header.version > JournalHeader::gl_version)
+                return false;
+
+            base = header.base;
+            return true;
+        }
+
+        static JournalHeader MakeHeader(uint64_t const base) noexcept {
+            JournalHeader header = {};
+            std::memcpy(header.magic, JournalHeader::gl_magic, sizeof(header.magic));
+            header.version = JournalHeader::gl_version;
+            header.base    = base;
+
+            return header;
+        }
+
+        static constexpr uint64_t Align(uint64_t const size) noexcept { return (size + 7) & ~uint64_t(7); }
+    };
+
+
+    /**
+     * \class suzu::sdk::ProjectReader
+     * \brief reads diagrams from a project file on demand
+     *
+     * The file is mapped into memory; only the pages that are actually accessed are read from disk.
+     * Strings are interned on first use and shared by all diagrams loaded afterwards. Diagrams
+     * opened with *mapDiagram()* keep the mapping alive, even after the reader is closed.
+     *
+     * The journal of the project, if any, is validated and mapped as well. Diagrams saved to it
+     * are read from their newest record instead of the project file.
+     *
+     * \note  The reader is not thread-safe.
+     */
+    class ProjectReader {
+        static constexpr uint32_t gl_unresolved = UINT32_MAX; /**< marks strings that have not been interned yet */
+
+        /**
+         * \struct suzu::sdk::ProjectReader::Strings
+         * \brief  string table in a mapping
+         */
+        struct Strings {
+            char const           *offsets; /**< string offsets; *nullptr* if there are no strings */
+            char const           *chars;   /**< string characters */
+            uint32_t              nchars;  /**< number of characters */
+            std::vector<uint32_t> ids;     /**< *suzu::sdk::StringId::value()*, by string index */
+        };
+
+        /**
+         * \struct suzu::sdk::ProjectReader::Diagram
+         * \brief  location of the newest version of a diagram
+         */
+        struct Diagram {
+            char const   *data;     /**< diagram chunk in the mapping */
+            uint64_t      size;     /**< size of the chunk in the mapping, in bytes */
+            uint64_t      hash;     /**< hash of the chunk, or of the journal record; only verified for chunks of the project file */
+            uint32_t      count;    /**< number of elements */
+            uint32_t      name;     /**< string index of the name */
+            uint32_t      strings;  /**< string table of the diagram; 0 for the project file, others are journal records */
+            ChunkEncoding encoding; /**< how the chunk is stored */
+        };
+
+        std::shared_ptr<util::MappedFile> m_file;        /**< mapped project file; shared with mapped diagrams */
+        std::shared_ptr<util::MappedFile> m_journal;     /**< mapped journal; *nullptr* if there is none */
+        std::vector<Diagram>              m_diagrams;    /**< all diagrams, in file order; new ones from the journal last */
+        std::vector<ProjectChunk>         m_chunks;      /**< index entries of chunks of other types */
+        std::vector<Strings>              m_strings;     /**< string tables; the one of the project file first */
+        std::vector<char>                 m_stringdata;  /**< decoded string table of the project file, if it is compressed */
+        uint64_t                          m_identity;    /**< *suzu::sdk::ProjectHeader::indexhash* */
+        uint64_t                          m_journalsize; /**< number of valid bytes of the journal */
+        uint64_t                          m_stringshash; /**< hash of the string table chunk of the project file */
+
+    public:
+        ProjectReader() noexcept
+            : m_identity(0), m_journalsize(0), m_stringshash(0)
+        { }
+
+        /**
+         * \brief  opens a project file, reading its index and its journal
+         *
+         * \param  [in] path path of the project file
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::OpenFile* if the file
+         *         could not be opened, or *suzu::sdk::ErrorCode::ReadFile* if it is not a valid
+         *         project file of a supported version
+         * \note   Any previously opened project is closed, even if the function fails. A journal
+         *         that does not belong to the file is ignored, as are records after a corrupt one.
+         */
+        ErrorCode open(char const *const path) noexcept {
+            close();
+
+            try {
+                m_file = std::make_shared<util::MappedFile>();
+
+                ErrorCode const err = m_file->open(path);
+                if (err != ErrorCode::Ok) {
+                    close();
+
+                    return err;
+                }
+
+                if (readIndex()) {
+                    std::string const journal = ProjectJournal::PathOf(path);
+
+                    if (!readJournal(journal))
+                        readJournal(journal + ".next");
+                    return ErrorCode::Ok;
+                }
+            } catch (...) { }
+
+            close();
+            return ErrorCode::ReadFile;
+        }
+
+        /**
+         * \brief closes the project file
+         *
+         * \note  Loaded diagrams are not affected; their names stay interned.
+         */
+        void close() noexcept {
+            m_file.reset();
+            m_journal.reset();
+            m_diagrams.clear();
+            m_chunks.clear();
+            m_strings.clear();
+            m_stringdata.clear();
+
+            m_identity    = 0;
+            m_journalsize = 0;
+            m_stringshash = 0;
+        }
+
+        bool isOpen() const noexcept { return m_file != nullptr && m_file->isOpen(); }
+
+        /**
+         * \brief  retrieves the identity of the project file, which journals refer to
+         *
+         * \return *suzu::sdk::ProjectHeader::indexhash*
+         */
+        uint64_t identity() const noexcept { return m_identity; }
+
+        /**
+         * \brief  retrieves the size of the part of the journal that was read
+         *
+         * \return number of bytes up to the end of the last valid record; 0 if no journal was read
+         */
+        uint64_t journalSize() const noexcept { return m_journalsize; }
+
+        /**
+         * \brief  retrieves a hash of the contents of the project, including its journal
+         *
+         * Combines the identity of the file with the hashes of the newest version of every diagram,
+         * which are known from opening it; no diagram is read. Any save changes the hash.
+         *
+         * \return content hash; 0 if no project is open
+         */
+        uint64_t contentHash() const noexcept {
+            if (!isOpen())
+                return 0;
+
+            uint64_t res = util::HashBytes(reinterpret_cast<char const *>(&m_identity), sizeof(m_identity));
+            for (Diagram const &diagram : m_diagrams)
+                res = util::HashBytes(reinterpret_cast<char const *>(&diagram.hash), sizeof(diagram.hash), res);
+
+            return res;
+        }
+
+        /**
+         * \brief  retrieves a chunk of a type other than diagrams and strings, e.g. written with
+         *         *suzu::sdk::ProjectWriter::addChunk()*
+         *
+         * \param  [in] type type of the chunk
+         * \param  [in] name name of the chunk
+         * \param  [out] buffer receives the decoded chunk if it is compressed
+         *
+         * \return bytes of the chunk in the mapping or in *buffer*, valid until the project is closed
+         *         or *buffer* is changed; *suzu::sdk::ErrorCode::InvalidParameter* if there is no such
+         *         chunk, or *suzu::sdk::ErrorCode::ReadFile* if it is corrupt
+         * \note   The whole chunk is read to verify its hash.
+         */
+        Result<std::string_view> chunk(uint32_t const type, std::string_view const name, std::vector<char> &buffer) const noexcept {
+            if (ProjectChunk const *const found = findChunk(type, name); found != nullptr) {
+                ProjectChunk const &entry = *found;
+
+                char const *const data = m_file->data() + entry.offset;
+                if (util::HashBytes(data, static_cast<size_t>(entry.size)) != entry.hash)
+                    return ErrorCode::ReadFile;
+                if (static_cast<ChunkEncoding>(entry.encoding) == ChunkEncoding::Raw)
+                    return std::string_view(data, static_cast<size_t>(entry.size));
+
+                try {
+                    if (!internal::DecodeChunk(data, entry.size, buffer))
+                        return ErrorCode::ReadFile;
+                } catch (...) {
+                    return ErrorCode::CriticalResource;
+                }
+                return std::string_view(buffer.data(), buffer.size());
+            }
+
+            return ErrorCode::InvalidParameter;
+        }
+
+        /**
+         * \brief  looks up the index entry of a chunk of a type other than diagrams and strings,
+         *         without reading the chunk
+         *
+         * \param  [in] type type of the chunk
+         * \param  [in] name name of the chunk
+         *
+         * \return index entry, valid until the project is closed; *nullptr* if there is no such chunk
+         */
+        ProjectChunk const *findChunk(uint32_t const type, std::string_view const name) const noexcept {
+            for (ProjectChunk const &entry : m_chunks)
+                if (entry.type == type && view(0, entry.name) == name)
+                    return &entry;
+
+            return nullptr;
+        }
+
+        /**
+         * \brief  retrieves the number of diagrams in the project
+         *
+         * \return number of diagrams
+         */
+        uint32_t diagramCount() const noexcept { return static_cast<uint32_t>(m_diagrams.size()); }
+
+        /**
+         * \brief  retrieves the name of a diagram
+         *
+         * \param  [in] diagram index of the diagram; less than *diagramCount()*
+         *
+         * \return view on the name in the mapping; valid until the project is closed
+         */
+        std::string_view diagramName(uint32_t const diagram) const noexcept {
+            return diagram < m_diagrams.size() ? view(m_diagrams[diagram].strings, m_diagrams[diagram].name) : std::string_view{};
+        }
+
+        /**
+         * \brief  retrieves the number of elements of a diagram without loading it
+         *
+         * \param  [in] diagram index of the diagram; less than *diagramCount()*
+         *
+         * \return number of elements
+         */
+        uint32_t diagramSize(uint32_t const diagram) const noexcept {
+            return diagram < m_diagrams.size() ? m_diagrams[diagram].count : 0;
+        }
+
+        /**
+         * \brief  retrieves a digest of the stored form of a diagram without reading it
+         *
+         * The digest combines the hash of the chunk, as recorded in the index, with that of the
+         * string table its names refer to. Equal digests thus imply equal diagrams, even across
+         * different project files; diagrams with different digests may still be equal, e.g. if
+         * a name elsewhere in the project changed.
+         *
+         * \param  [in] diagram index of the diagram; less than *diagramCount()*
+         *
+         * \return digest; 0 if *diagram* is out of range
+         */
+        uint64_t diagramDigest(uint32_t const diagram) const noexcept {
+            if (diagram >= m_diagrams.size())
+                return 0;
+
+            /* Journal records carry their own strings, which their hash covers already. */
+            Diagram const &chunk = m_diagrams[diagram];
+            return chunk.strings == 0 ? util::HashBytes(reinterpret_cast<char const *>(&chunk.hash), sizeof(chunk.hash), m_stringshash) : chunk.hash;
+        }
+
+        /**
+         * \brief  loads a diagram
+         *
+         * \param  [in] diagram index of the diagram; less than *diagramCount()*
+         * \param  [out] store receives the elements; cleared first
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         *diagram* is out of range, *suzu::sdk::ErrorCode::ReadFile* if the chunk is corrupt,
+         *         or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out; *store* is empty then
+         */
+        ErrorCode loadDiagram(uint32_t const diagram, ElementStore &store) noexcept {
+            if (diagram >= m_diagrams.size())
+                return ErrorCode::InvalidParameter;
+
+            store.clear();
+
+            Diagram           chunk = m_diagrams[diagram];
+            std::vector<char> decoded;
+            if (chunk.strings == 0 && util::HashBytes(chunk.data, static_cast<size_t>(chunk.size)) != chunk.hash)
+                return ErrorCode::ReadFile;
+            if (chunk.encoding != ChunkEncoding::Raw) {
+                ErrorCode const err = Decode(chunk, decoded);
+                if (err != ErrorCode::Ok)
+                    return err;
+            }
+            if (!IsIntact(chunk))
+                return ErrorCode::ReadFile;
+
+            uint32_t const    n       = chunk.count;
+            char const *const kinds   = chunk.data + 8;
+            char const *const bounds  = kinds + 4 * static_cast<size_t>(n);
+            char const *const styles  = bounds + 16 * static_cast<size_t>(n);
+            char const *const flags   = styles + 4 * static_cast<size_t>(n);
+            char const *const parents = flags + 4 * static_cast<size_t>(n);
+            char const *const names   = parents + 4 * static_cast<size_t>(n);
+            try {
+                std::vector<ElementHandle> handles(n);
+
+                for (uint32_t i = 0; i < n; ++i) {
+                    uint32_t const kind = internal::GetValue<uint32_t>(kinds, i);
+                    if (kind >= static_cast<uint32_t>(ElementKind::__NumElementKinds__)) {
+                        store.clear();
+
+                        return ErrorCode::ReadFile;
+                    }
+
+                    handles[i] = store.create(static_cast<ElementKind>(kind), internal::GetValue<ElementRect>(bounds, i), internal::GetValue<uint32_t>(styles, i), gl_nullelement, string(chunk.strings, internal::GetValue<uint32_t>(names, i)));
+                    store.flags()[i] = internal::GetValue<uint32_t>(flags, i);
+                }
+
+                /* Parents may come after their children in the drawing order. */
+                for (uint32_t i = 0; i < n; ++i) {
+                    uint32_t const parent = internal::GetValue<uint32_t>(parents, i);
+
+                    if (parent < n)
+                        store.parents()[i] = handles[parent];
+                }
+            } catch (...) {
+                store.clear();
+
+                return ErrorCode::CriticalResource;
+            }
+
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief  opens a diagram without copying its kinds and bounds
+         *
+         * The store borrows both arrays from the mapping (see *suzu::sdk::ElementStore::map()*) and
+         * copies them on its first edit, so opening a large diagram for viewing only touches the
+         * pages of its styles, flags, parents and names. Windows showing the same project share
+         * the pages of the mapping.
+         *
+         * \param  [in] diagram index of the diagram; less than *diagramCount()*
+         * \param  [out] store receives the elements; cleared first
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         *diagram* is out of range, *suzu::sdk::ErrorCode::ReadFile* if the chunk is corrupt,
+         *         or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out; *store* is empty then
+         * \note   The hash of the chunk is not verified, as that would read all of it. Kinds are
+         *         validated; corrupt bounds only show up as misplaced elements. Compressed chunks
+         *         cannot be mapped; they are loaded with *loadDiagram()* instead.
+         */
+        ErrorCode mapDiagram(uint32_t const diagram, ElementStore &store) noexcept {
+            if (diagram >= m_diagrams.size())
+                return ErrorCode::InvalidParameter;
+            if (m_diagrams[diagram].encoding != ChunkEncoding::Raw)
+                return loadDiagram(diagram, store);
+
+            store.clear();
+
+            Diagram const &chunk = m_diagrams[diagram];
+            if (!IsIntact(chunk))
+                return ErrorCode::ReadFile;
+
+            uint32_t const    n       = chunk.count;
+            char const *const kinds   = chunk.data + 8;
+            char const *const bounds  = kinds + 4 * static_cast<size_t>(n);
+            char const *const styles  = bounds + 16 * static_cast<size_t>(n);
+            char const *const flags   = styles + 4 * static_cast<size_t>(n);
+            char const *const parents = flags + 4 * static_cast<size_t>(n);
+            char const *const names   = parents + 4 * static_cast<size_t>(n);
+            for (uint32_t i = 0; i < n; ++i)
+                if (internal::GetValue<uint32_t>(kinds, i) >= static_cast<uint32_t>(ElementKind::__NumElementKinds__))
+                    return ErrorCode::ReadFile;
+
+            std::shared_ptr<util::MappedFile> const &file = chunk.strings == 0 ? m_file : m_journal;
+            ErrorCode const err = store.map(
+                n,
+                reinterpret_cast<ElementKind const *>(kinds),
+                reinterpret_cast<ElementRect const *>(bounds),
+                std::shared_ptr<void const>(file, file->data())
+            );
+            if (err != ErrorCode::Ok)
+                return err;
+
+            if (n != 0) {
+                std::memcpy(store.styles(), styles, 4 * static_cast<size_t>(n));
+                std::memcpy(store.flags(), flags, 4 * static_cast<size_t>(n));
+            }
+            for (uint32_t i = 0; i < n; ++i) {
+                uint32_t const parent = internal::GetValue<uint32_t>(parents, i);
+
+                if (parent < n)
+                    store.parents()[i] = store.handleAt(parent);
+                store.names()[i] = string(chunk.strings, internal::GetValue<uint32_t>(names, i));
+            }
+
+            return ErrorCode::Ok;
+        }
+
+    private:
+        /**
+         * \brief  validates the header and reads the index
+         *
+         * \return *true* if the file is a valid project file of a supported version
+         * \throw  std::bad_alloc
+         */
+        bool readIndex() {
+            ProjectHeader  header;
+            uint64_t const size = m_file->size();
+            if (size < sizeof(header))
+                return false;
+            std::memcpy(&header, m_file->data(), sizeof(header));
+
+            uint64_t const bytes = static_cast<uint64_t>(header.chunks) * sizeof(ProjectChunk);
+            if (std::memcmp(header.magic, ProjectHeader::gl_magic, sizeof(header.magic)) != 0 || header.version > ProjectHeader::gl_version)
+                return false;
+            if (header.index > size || bytes > size - header.index)
+                return false;
+            if (util::HashBytes(m_file->data() + header.index, static_cast<size_t>(bytes)) != header.indexhash)
+                return false;
+
+            std::vector<ProjectChunk> index(header.chunks);
+            std::memcpy(index.data(), m_file->data() + header.index, static_cast<size_t>(bytes));
+
+            m_strings.push_back({ nullptr, nullptr, 0, {} });
+            for (ProjectChunk const &chunk : index) {
+                if (chunk.offset > size || chunk.size > size - chunk.offset)
+                    return false;
+
+                ChunkEncoding const encoding = static_cast<ChunkEncoding>(chunk.encoding);
+                if (encoding != ChunkEncoding::Raw && encoding != ChunkEncoding::Lz4)
+                    return false;
+
+                char const *const data = m_file->data() + chunk.offset;
+                if (chunk.type == gl_chunkdiagram)
+                    m_diagrams.push_back({ data, chunk.size, chunk.hash, chunk.count, chunk.name, 0, encoding });
+                else if (chunk.type == gl_chunkstrings) {
+                    if (util::HashBytes(data, static_cast<size_t>(chunk.size)) != chunk.hash)
+                        return false;
+                    m_stringshash = chunk.hash;
+                    if (encoding == ChunkEncoding::Raw && !ReadStrings(data, chunk.size, m_strings[0]))
+                        return false;
+                    if (encoding == ChunkEncoding::Lz4 && (!internal::DecodeChunk(data, chunk.size, m_stringdata) || !ReadStrings(m_stringdata.data(), m_stringdata.size(), m_strings[0])))
+                        return false;
+                } else
+                    m_chunks.push_back(chunk);
+            }
+
+            m_identity = header.indexhash;
+            return true;
+        }
+
+        /**
+         * \brief  reads a journal, overlaying its records onto the diagrams of the project file
+         *
+         * \param  [in] path path of the journal
+         *
+         * \return *true* if the journal exists and belongs to the project file
+         * \throw  std::bad_alloc
+         */
+        bool readJournal(std::string const &path) {
+            auto file = std::make_shared<util::MappedFile>();
+            if (file->open(path.c_str()) != ErrorCode::Ok)
+                return false;
+
+            JournalHeader  header;
+            uint64_t const size = file->size();
+            if (size < sizeof(header))
+                return false;
+            std::memcpy(&header, file->data(), sizeof(header));
+            if (std::memcmp(header.magic, JournalHeader::gl_magic, sizeof(header.magic)) != 0 || header.version > JournalHeader::gl_version || header.base != m_identity)
+                return false;
+
+            /* Records are appended one after the other; a crash may leave the last one torn. */
+            uint64_t pos = sizeof(header);
+            while (size - pos >= sizeof(JournalRecord)) {
+                JournalRecord record;
+                std::memcpy(&record, file->data() + pos, sizeof(record));
+
+                char const *const data = file->data() + pos + sizeof(record);
+                if (record.size > size - pos - sizeof(record) || internal::HashRecord(record, data) != record.hash)
+                    break;
+                if (record.type != gl_chunkdiagram || record.diagram > m_diagrams.size() || record.strings > record.size)
+                    break;
+                if (record.size - record.strings < 8 + internal::gl_projecteltsize * static_cast<uint64_t>(record.count))
+                    break;
+
+                Strings strings;
+                if (!ReadStrings(data, record.strings, strings))
+                    break;
+
+                Diagram const diagram = { data + record.strings, 8 + internal::gl_projecteltsize * static_cast<uint64_t>(record.count), record.hash, record.count, record.name, static_cast<uint32_t>(m_strings.size()), ChunkEncoding::Raw };
+                m_strings.push_back(std::move(strings));
+                if (record.diagram == m_diagrams.size())
+                    m_diagrams.push_back(diagram);
+                else
+                    m_diagrams[record.diagram] = diagram;
+
+                pos += sizeof(record) + record.size;
+            }
+
+            m_journal     = std::move(file);
+            m_journalsize = pos;
+            return true;
+        }
+
+        /**
+         * \brief  decodes a compressed diagram chunk
+         *
+         * \param  [in,out] chunk diagram chunk; refers to *buffer* afterwards
+         * \param  [out] buffer receives the decoded chunk
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::ReadFile* if the chunk
+         *         is corrupt, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out
+         */
+        static ErrorCode Decode(Diagram &chunk, std::vector<char> &buffer) noexcept {
+            try {
+                /* The size is known from the number of elements; anything else is corrupt. */
+                uint64_t decoded;
+                if (chunk.size < sizeof(decoded))
+                    return ErrorCode::ReadFile;
+                std::memcpy(&decoded, chunk.data, sizeof(decoded));
+                if (decoded != 8 + internal::gl_projecteltsize * static_cast<uint64_t>(chunk.count) || !internal::DecodeChunk(chunk.data, chunk.size, buffer))
+                    return ErrorCode::ReadFile;
+            } catch (...) {
+                return ErrorCode::CriticalResource;
+            }
+
+            chunk.data     = buffer.data();
+            chunk.size     = buffer.size();
+            chunk.encoding = ChunkEncoding::Raw;
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief  checks the size of a diagram chunk against its number of elements
+         *
+         * \param  [in] chunk diagram chunk
+         *
+         * \return *true* if the chunk holds exactly *count* elements
+         */
+        static bool IsIntact(Diagram const &chunk) noexcept {
+            uint32_t n;
+            if (chunk.size < 8)
+                return false;
+            std::memcpy(&n, chunk.data, sizeof(n));
+
+            return n == chunk.count && chunk.size == 8 + internal::gl_projecteltsize * static_cast<uint64_t>(n);
+        }
+
+        /**
+         * \brief  validates a string table and remembers its position
+         *
+         * \param  [in] data string table in the mapping
+         * \param  [in] size size of the string table, in bytes
+         * \param  [out] strings receives the position of the strings
+         *
+         * \return *true* if the table is valid
+         * \throw  std::bad_alloc
+         */
+        static bool ReadStrings(char const *const data, uint64_t const size, Strings &strings) {
+            if (size < 12)
+                return false;
+
+            uint32_t count;
+            std::memcpy(&count, data, sizeof(count));
+            uint64_t const table = 8 + 4 * (static_cast<uint64_t>(count) + 1);
+            if (count == 0 || table > size)
+                return false;
+
+            strings.offsets = data + 8;
+            strings.chars   = data + table;
+            strings.nchars  = static_cast<uint32_t>(size - table);
+            strings.ids.assign(count, gl_unresolved);
+            strings.ids[0] = 0;
+            return true;
+        }
+
+        /**
+         * \brief  retrieves a string of a string table
+         *
+         * \param  [in] table string table
+         * \param  [in] index string index
+         *
+         * \return view on the string in the mapping; empty if the index is out of range
+         */
+        std::string_view view(uint32_t const table, uint32_t const index) const noexcept {
+            Strings const &strings = m_strings[table];
+            if (index >= strings.ids.size())
+                return {};
+
+            uint32_t const begin = internal::GetValue<uint32_t>(strings.offsets, index);
+            uint32_t const end   = internal::GetValue<uint32_t>(strings.offsets, static_cast<size_t>(index) + 1);
+            if (begin > end || end > strings.nchars)
+                return {};
+
+            return { strings.chars + begin, end - begin };
+        }
+
+        /**
+         * \brief  interns a string of a string table
+         *
+         * \param  [in] table string table
+         * \param  [in] index string index
+         *
+         * \return interned string; empty if the index is out of range
+         */
+        StringId string(uint32_t const table, uint32_t const index) noexcept {
+            std::vector<uint32_t> &ids = m_strings[table].ids;
+            if (index >= ids.size())
+                return {};
+            if (ids[index] == gl_unresolved)
+                ids[index] = StringId(view(table, index)).value();
+
+            return StringId::FromValue(ids[index]);
+        }
+    };
+}
+
+
@@ -0,0 +1,880 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  query.hpp
+ * \brief query language over the elements of a diagram, planned against secondary indexes
+ *
+ * A query is a conjunction of terms, e.g.
+ *
+ *     kind = class and in "Persistence" and children > 20 and not locked
+ *
+ * Supported terms:
+ *  - *kind = K*, *kind != K*: kind of the element; *K* is one of *class*, *interface*,
+ *    *enumeration*, *package*, *association* and *note*
+ *  - *style = N*, *style != N*: style id, e.g. assigned per stereotype
+ *  - *name = "S"*, *name != "S"*: exact name; *name ~ "S"*: name contains *S*, ignoring ASCII case
+ *  - *parent = "S"*: owned directly by an element named *S*
+ *  - *in "S"*: owned directly or indirectly by an element named *S*, e.g. a package
+ *  - *children OP N*: number of directly owned elements, e.g. members; *OP* is one of *=*, *!=*,
+ *    *<*, *<=*, *>* and *>=*
+ *  - *hidden*, *locked*, *selected*: state flags
+ *
+ * Every term may be preceded by *not*. Strings without spaces or quotes may be given as bare words.
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/changes.hpp>
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/intern.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \enum  suzu::sdk::QueryField
+     * \brief property a query term tests
+     */
+    enum class QueryField : uint32_t {
+        Kind,     /**< *suzu::sdk::ElementKind* */
+        Style,    /**< style id */
+        Name,     /**< name */
+        Parent,   /**< name of the owner */
+        In,       /**< name of any owner up to the diagram root */
+        Children, /**< number of directly owned elements */
+        Hidden,   /**< *suzu::sdk::ElementHidden* */
+        Locked,   /**< *suzu::sdk::ElementLocked* */
+        Selected, /**< *suzu::sdk::ElementSelected* */
+
+        __NumQueryFields__ /**< (only used internally) */
+    };
+
+    /**
+     * \enum  suzu::sdk::QueryOp
+     * \brief comparison of a query term
+     */
+    enum class QueryOp : uint32_t {
+        Equal,        /**< *=*; also used by flags and *in* */
+        NotEqual,     /**< *!=* */
+        Contains,     /**< *~* */
+        Less,         /**< *<* */
+        LessEqual,    /**< *<=* */
+        Greater,      /**< *>* */
+        GreaterEqual  /**< *>=* */
+    };
+
+    /**
+     * \struct suzu::sdk::QueryTerm
+     * \brief  single term of a query
+     */
+    struct QueryTerm {
+        QueryField  field;   /**< tested property */
+        QueryOp     op;      /**< comparison */
+        bool        negated; /**< whether or not the term was preceded by *not* */
+        uint32_t    number;  /**< kind, style id or number of children compared to */
+        std::string text;    /**< string compared to */
+        StringId    name;    /**< *text*, interned; used by exact comparisons */
+    };
+
+
+    /**
+     * \class suzu::sdk::ModelQuery
+     * \brief parsed query; see *sdk/query.hpp* for the language
+     */
+    class ModelQuery {
+        static constexpr char const *gl_opnames[] = { "=", "!=", "~", "<", "<=", ">", ">=" }; /**< words of the comparisons, by *suzu::sdk::QueryOp* */
+
+        std::vector<QueryTerm> m_terms; /**< terms, all of which have to hold */
+
+    public:
+        /**
+         * \brief  parses a query
+         *
+         * \param  [in] text query
+         * \param  [out] error (optional) receives a description of the first error
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the query is malformed or empty, or *suzu::sdk::ErrorCode::CriticalResource* if
+         *         memory ran out; the previous query is kept on failure
+         */
+        ErrorCode parse(std::string_view const text, std::string *const error = nullptr) noexcept {
+            try {
+                std::vector<QueryTerm> terms;
+                std::string            msg;
+                size_t                 pos = 0;
+
+                for (;;) {
+                    QueryTerm term = { QueryField::Kind, QueryOp::Equal, false, 0, std::string(), StringId() };
+                    if (!parseTerm(text, pos, term, msg)) {
+                        if (error != nullptr)
+                            *error = std::move(msg);
+
+                        return ErrorCode::InvalidParameter;
+                    }
+                    terms.push_back(std::move(term));
+
+                    std::string_view const word = Next(text, pos);
+                    if (word.empty())
+                        break;
+                    if (word != "and") {
+                        if (error != nullptr)
+                            *error = "expected 'and' instead of '" + std::string(word) + "'";
+
+                        return ErrorCode::InvalidParameter;
+                    }
+                }
+
+                m_terms.swap(terms);
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        std::vector<QueryTerm> const &terms() const noexcept { return m_terms; }
+
+        /**
+         * \brief  retrieves the name of a kind in the language, e.g. *class*
+         *
+         * \param  [in] kind kind
+         *
+         * \return name; empty for invalid kinds
+         */
+        static std::string_view KindName(ElementKind const kind) noexcept {
+            return kind < ElementKind::__NumElementKinds__ ? gl_kindnames[static_cast<size_t>(kind)] : "";
+        }
+
+        /**
+         * \brief  describes a term in the syntax of the language, e.g. for query plans
+         *
+         * \param  [in] term term
+         *
+         * \return description
+         * \throw  std::bad_alloc
+         */
+        static std::string Describe(QueryTerm const &term) {
+            static constexpr char const *gl_fieldnames[] = { "kind", "style", "name", "parent", "in", "children", "hidden", "locked", "selected" }; /**< names of the fields, by *suzu::sdk::QueryField* */
+
+            std::string res = term.negated ? "not " : "";
+            res.append(gl_fieldnames[static_cast<size_t>(term.field)]);
+
+            switch (term.field) {
+                case QueryField::Kind:     return res.append(" ").append(gl_opnames[static_cast<size_t>(term.op)]).append(" ").append(gl_kindnames[term.number]);
+                case QueryField::Style:
+                case QueryField::Children: return res.append(" ").append(gl_opnames[static_cast<size_t>(term.op)]).append(" ").append(std::to_string(term.number));
+                case QueryField::Name:
+                case QueryField::Parent:   return res.append(" ").append(gl_opnames[static_cast<size_t>(term.op)]).append(" \"").append(term.text).append("\"");
+                case QueryField::In:       return res.append(" \"").append(term.text).append("\"");
+                default:                   return res;
+            }
+        }
+
+    private:
+        /**
+         * \brief  reads the next word of a query: a name, a number, an operator or a quoted string
+         *
+         * \param  [in] text query
+         * \param  [in,out] pos position to read from; receives the position after the word
+         *
+         * \return word, including the quotes of strings; empty at the end of the query
+         */
+        static std::string_view Next(std::string_view const text, size_t &pos) noexcept {
+            while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+                ++pos;
+            if (pos >= text.size())
+                return {};
+
+            size_t const start = pos;
+            char const   c     = text[pos];
+            if (c == '"') {
+                for (++pos; pos < text.size() && text[pos] != '"'; ++pos)
+                    if (text[pos] == '\\')
+                        ++pos;
+
+                pos = std::min(text.size(), pos + 1);
+            } else if (c == '=' || c == '~') {
+                ++pos;
+            } else if (c == '!' || c == '<' || c == '>') {
+                pos += pos + 1 < text.size() && text[pos + 1] == '=' ? 2 : 1;
+            } else {
+                while (pos < text.size() && !std::isspace(static_cast<unsigned char>(text[pos])) && std::string_view("\"=~!<>").find(text[pos]) == std::string_view::npos)
+                    ++pos;
+            }
+
+            return text.substr(start, pos - start);
+        }
+
+        /**
+         * \brief  converts a word to a string, removing quotes and escapes
+         *
+         * \param  [in] word word returned by *Next()*
+         * \param  [out] res receives the string
+         *
+         * \return *true* if the word is a bare word or a terminated quoted string
+         * \throw  std::bad_alloc
+         */
+        static bool Unquote(std::string_view const word, std::string &res) {
+            res.clear();
+            if (word.empty() || word.front() != '"') {
+                res.assign(word);
+
+                return !word.empty() && std::string_view("=~!<>").find(word.front()) == std::string_view::npos;
+            }
+            if (word.size() < 2 || word.back() != '"')
+                return false;
+
+            for (size_t i = 1; i + 1 < word.size(); ++i)
+                res.push_back(word[i] == '\\' && i + 2 < word.size() ? word[++i] : word[i]);
+
+            return true;
+        }
+
+        /**
+         * \brief  reads a single term
+         *
+         * \param  [in] text query
+         * \param  [in,out] pos position to read from; receives the position after the term
+         * \param  [out] term receives the term
+         * \param  [out] msg receives a description of the error, if any
+         *
+         * \return *true* if a term was read
+         * \throw  std::bad_alloc
+         */
+        static bool parseTerm(std::string_view const text, size_t &pos, QueryTerm &term, std::string &msg) {
+            std::string_view word = Next(text, pos);
+            while (word == "not") {
+                term.negated = !term.negated;
+                word         = Next(text, pos);
+            }
+            if (word.empty()) {
+                msg = "expected a term at the end of the query";
+
+                return false;
+            }
+
+            if (word == "hidden" || word == "locked" || word == "selected") {
+                term.field = word == "hidden" ? QueryField::Hidden : word == "locked" ? QueryField::Locked : QueryField::Selected;
+
+                return true;
+            }
+            if (word == "in") {
+                term.field = QueryField::In;
+                if (!Unquote(Next(text, pos), term.text)) {
+                    msg = "expected a name after 'in'";
+
+                    return false;
+                }
+
+                term.name = StringId(term.text);
+                return true;
+            }
+
+            if (word == "kind")
+                term.field = QueryField::Kind;
+            else if (word == "style")
+                term.field = QueryField::Style;
+            else if (word == "name")
+                term.field = QueryField::Name;
+            else if (word == "parent")
+                term.field = QueryField::Parent;
+            else if (word == "children")
+                term.field = QueryField::Children;
+            else {
+                msg = "unknown term '" + std::string(word) + "'";
+
+                return false;
+            }
+
+            std::string_view const op   = Next(text, pos);
+            auto const             iter = std::find(std::begin(gl_opnames), std::end(gl_opnames), op);
+            if (op.empty() || iter == std::end(gl_opnames)) {
+                msg = "expected a comparison after '" + std::string(word) + "'";
+
+                return false;
+            }
+            term.op = static_cast<QueryOp>(iter - std::begin(gl_opnames));
+
+            bool const ordered = term.op == QueryOp::Less || term.op == QueryOp::LessEqual || term.op == QueryOp::Greater || term.op == QueryOp::GreaterEqual;
+            if ((term.op == QueryOp::Contains && term.field != QueryField::Name) || (ordered && term.field != QueryField::Children)
+                || (term.op == QueryOp::NotEqual && term.field == QueryField::Parent)
+            ) {
+                msg = "'" + std::string(op) + "' cannot be applied to '" + std::string(word) + "'";
+
+                return false;
+            }
+
+            std::string_view const value = Next(text, pos);
+            if (!Unquote(value, term.text)) {
+                msg = "expected a value after '" + std::string(word) + " " + std::string(op) + "'";
+
+                return false;
+            }
+
+            if (term.field == QueryField::Kind) {
+                auto const kind = std::find(std::begin(gl_kindnames), std::end(gl_kindnames), term.text);
+                if (kind == std::end(gl_kindnames)) {
+                    msg = "unknown kind '" + term.text + "'";
+
+                    return false;
+                }
+
+                term.number = static_cast<uint32_t>(kind - std::begin(gl_kindnames));
+            } else if (term.field == QueryField::Style || term.field == QueryField::Children) {
+                if (term.text.empty() || term.text.size() > 9 || !std::all_of(term.text.begin(), term.text.end(), [](char const c) { return std::isdigit(static_cast<unsigned char>(c)); })) {
+                    msg = "expected a number instead of '" + term.text + "'";
+
+                    return false;
+                }
+
+                term.number = static_cast<uint32_t>(std::stoul(term.text));
+            } else if (term.op != QueryOp::Contains) {
+                term.name = StringId(term.text);
+            }
+
+            return true;
+        }
+    };
+
+
+    /**
+     * \class suzu::sdk::ModelIndex
+     * \brief secondary indexes over the elements of a diagram, and the planner running queries
+     *        against them
+     *
+     * The elements are indexed by kind, style id, name and owner. Instead of scanning all
+     * elements, a query starts from the candidates of its most selective indexed term:
+     *  - *kind =*, *style =* and *name =* look up their index directly;
+     *  - *parent =* takes the children of all elements of that name;
+     *  - *in* walks the owned elements of all elements of that name; the walk stops as soon as it
+     *    exceeds the candidates of another term.
+     *
+     * All other terms, negated ones and those of the remaining indexes are checked per candidate;
+     * only queries without any indexed term scan the whole diagram. *children* compares to the
+     * size of an owner index entry, so it never scans.
+     *
+     * *build()* indexes a diagram once; afterwards, *apply()* keeps the indexes up to date with
+     * the changes of every operation, e.g. the records of a *suzu::ChangeSet* in the host, or the
+     * *suzu::sdk::ChangeBatch* passed to the change callback of a plug-in (see
+     * *sdk/changes.hpp*). Both read the current properties from the diagram, so the changes have
+     * to be applied before the diagram changes any further.
+     *
+     * \note  The index refers to the diagram, which must outlive it.
+     */
+    class ModelIndex {
+        /**
+         * \struct suzu::sdk::ModelIndex::Entry
+         * \brief  indexed properties of an element, to remove it from the indexes again
+         */
+        struct Entry {
+            ElementKind kind;   /**< kind */
+            uint32_t    style;  /**< style id */
+            StringId    name;   /**< name */
+            uint64_t    parent; /**< handle of the owner; the null handle for the diagram root */
+        };
+
+        using Set = std::unordered_set<uint64_t>; /**< handles of elements */
+
+        ElementStore const                 *m_store;   /**< indexed diagram; not owned */
+        std::unordered_map<uint64_t, Entry> m_entries; /**< indexed properties, by handle */
+        std::vector<Set>                    m_kinds;   /**< elements, by kind */
+        std::unordered_map<uint32_t, Set>   m_styles;  /**< elements, by style id */
+        std::unordered_map<StringId, Set>   m_names;   /**< elements, by name */
+        std::unordered_map<uint64_t, Set>   m_owners;  /**< directly owned elements, by handle of the owner */
+
+    public:
+        ModelIndex() noexcept
+            : m_store(nullptr)
+        { }
+
+        /**
+         * \brief  indexes all elements of a diagram; the previous contents are dropped
+         *
+         * \param  [in] store diagram; must outlive the index
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if memory ran out; the index is empty then
+         */
+        ErrorCode build(ElementStore const &store) noexcept {
+            clear();
+            m_store = &store;
+
+            try {
+                m_kinds.resize(static_cast<size_t>(ElementKind::__NumElementKinds__));
+                m_entries.reserve(store.size());
+
+                for (uint32_t i = 0; i < store.size(); ++i)
+                    insert(store.handleAt(i));
+
+                return ErrorCode::Ok;
+            } catch (...) {
+                clear();
+            }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  updates the indexes with the changes of an operation
+         *
+         * \param  [in] records changes, in the order they were applied
+         * \param  [in] count number of changes
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if no
+         *         diagram has been indexed, or *suzu::sdk::ErrorCode::CriticalResource* if memory
+         *         ran out; the index has to be built again then
+         * \note   Sets of changes that mark everything as changed, see *suzu::ChangeSet::everything()*,
+         *         have no records; build the index again instead.
+         */
+        ErrorCode apply(ChangeRecord const *const records, size_t const count) noexcept {
+            if (m_store == nullptr)
+                return ErrorCode::InvalidState;
+
+            try {
+                for (size_t i = 0; i < count; ++i) {
+                    ChangeRecord const &change = records[i];
+                    ElementHandle const handle = ElementHandle::FromValue(change.element);
+
+                    switch (change.kind) {
+                        case ElementAdded:
+                            erase(change.element);
+                            insert(handle);
+                            break;
+                        case ElementRemoved:
+                            erase(change.element);
+                            break;
+                        case ElementModified:
+                            if (change.args[0] != PropertyStyle && change.args[0] != PropertyName)
+                                break;
+                            [[fallthrough]];
+                        case ElementMoved:
+                            erase(change.element);
+                            insert(handle);
+                            break;
+                        default:
+                            break;
+                    }
+                }
+
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  runs a query
+         *
+         * \param  [in] query parsed query
+         * \param  [out] res receives the matching elements, in drawing order; existing contents
+         *               are dropped
+         * \param  [out] plan (optional) receives a description of the plan, e.g. *index kind =
+         *                    class (412 candidates); filter children > 20*
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if no
+         *         diagram has been indexed, or *suzu::sdk::ErrorCode::CriticalResource* if memory
+         *         ran out
+         */
+        ErrorCode run(ModelQuery const &query, std::vector<ElementHandle> &res, std::string *const plan = nullptr) const noexcept {
+            res.clear();
+            if (m_store == nullptr)
+                return ErrorCode::InvalidState;
+
+            try {
+                std::vector<QueryTerm> const &terms = query.terms();
+
+                /* The term with the fewest candidates drives the query. */
+                size_t driver = terms.size();
+                size_t best   = m_store->size();
+                for (size_t t = 0; t < terms.size(); ++t) {
+                    size_t const estimate = this->estimate(terms[t], best);
+
+                    if (estimate < best) {
+                        driver = t;
+                        best   = estimate;
+                    }
+                }
+
+                std::vector<uint32_t> dense;
+                if (driver == terms.size()) {
+                    for (uint32_t i = 0; i < m_store->size(); ++i)
+                        if (matches(terms, terms.size(), i))
+                            dense.push_back(i);
+                } else {
+                    std::vector<uint64_t> candidates;
+                    collect(terms[driver], candidates);
+                    for (uint64_t const handle : candidates) {
+                        ElementHandle const element = ElementHandle::FromValue(handle);
+                        if (m_store->isValid(element) && matches(terms, driver, m_store->indexOf(element)))
+                            dense.push_back(m_store->indexOf(element));
+                    }
+
+                    std::sort(dense.begin(), dense.end());
+                }
+
+                res.reserve(dense.size());
+                for (uint32_t const i : dense)
+                    res.push_back(m_store->handleAt(i));
+
+                if (plan != nullptr) {
+                    *plan = driver == terms.size() ? "scan (" + std::to_string(m_store->size()) + " elements)" : "index " + ModelQuery::Describe(terms[driver]) + " (" + std::to_string(best) + " candidates)";
+                    for (size_t t = 0; t < terms.size(); ++t)
+                        if (t != driver)
+                            plan->append(plan->find("; filter ") == std::string::npos ? "; filter " : ", ").append(ModelQuery::Describe(terms[t]));
+                }
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief drops all indexes
+         */
+        void clear() noexcept {
+            m_store = nullptr;
+            m_entries.clear();
+            m_kinds.clear();
+            m_styles.clear();
+            m_names.clear();
+            m_owners.clear();
+        }
+
+        ElementStore const *store() const noexcept { return m_store; }
+        size_t size() const noexcept { return m_entries.size(); }
+
+    private:
+        /**
+         * \brief  checks whether a term can be answered from an index
+         *
+         * \param  [in] term term
+         *
+         * \return *true* if it can drive a query
+         */
+        static bool IsIndexed(QueryTerm const &term) noexcept {
+            if (term.negated)
+                return false;
+
+            switch (term.field) {
+                case QueryField::Kind:
+                case QueryField::Style:
+                case QueryField::Name:
+                case QueryField::Parent:
+                    return term.op == QueryOp::Equal;
+                case QueryField::In:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        /**
+         * \brief  estimates the number of candidates of a term
+         *
+         * \param  [in] term term
+         * \param  [in] limit number of candidates of the best term so far; walks stop beyond it
+         *
+         * \return number of candidates, more than *limit* if they exceed it, or *SIZE_MAX* if the
+         *         term is not indexed
+         */
+        size_t estimate(QueryTerm const &term, size_t const limit) const {
+            if (!IsIndexed(term))
+                return SIZE_MAX;
+
+            switch (term.field) {
+                case QueryField::Kind:
+                    return m_kinds[term.number].size();
+                case QueryField::Style: {
+                    auto const it = m_styles.find(term.number);
+
+                    return it == m_styles.end() ? 0 : it->second.size();
+                }
+                case QueryField::Name: {
+                    auto const it = m_names.find(term.name);
+
+                    return it == m_names.end() ? 0 : it->second.size();
+                }
+                case QueryField::Parent: {
+                    size_t     res = 0;
+                    auto const it  = m_names.find(term.name);
+                    if (it != m_names.end())
+                        for (uint64_t const owner : it->second)
+                            res += childrenOf(owner);
+
+                    return res;
+                }
+                default: {
+                    std::vector<uint64_t> walked;
+
+                    return walk(term.name, walked, limit);
+                }
+            }
+        }
+
+        /**
+         * \brief  collects the candidates of an indexed term
+         *
+         * \param  [in] term indexed term
+         * \param  [out] res receives the handles of the candidates
+         *
+         * \throw  std::bad_alloc
+         */
+        void collect(QueryTerm const &term, std::vector<uint64_t> &res) const {
+            Set const *set = nullptr;
+            switch (term.field) {
+                case QueryField::Kind:
+                    set = &m_kinds[term.number];
+                    break;
+                case QueryField::Style: {
+                    auto const it = m_styles.find(term.number);
+
+                    set = it == m_styles.end() ? nullptr : &it->second;
+                    break;
+                }
+                case QueryField::Name: {
+                    auto const it = m_names.find(term.name);
+
+                    set = it == m_names.end() ? nullptr : &it->second;
+                    break;
+                }
+                case QueryField::Parent: {
+                    auto const it = m_names.find(term.name);
+                    if (it != m_names.end())
+                        for (uint64_t const owner : it->second) {
+                            auto const children = m_owners.find(owner);
+
+                            if (children != m_owners.end())
+                                res.insert(res.end(), children->second.begin(), children->second.end());
+                        }
+
+                    return;
+                }
+                default:
+                    walk(term.name, res, SIZE_MAX);
+
+                    return;
+            }
+
+            if (set != nullptr)
+                res.assign(set->begin(), set->end());
+        }
+
+        /**
+         * \brief  collects all elements owned directly or indirectly by the elements of a name
+         *
+         * \param  [in] name name of the owners
+         * \param  [out] res receives the handles of the owned elements
+         * \param  [in] limit number of elements after which the walk stops
+         *
+         * \return number of elements collected; more than *limit* if the walk stopped early
+         * \throw  std::bad_alloc
+         */
+        size_t walk(StringId const name, std::vector<uint64_t> &res, size_t const limit) const {
+            auto const it = m_names.find(name);
+            if (it == m_names.end())
+                return 0;
+
+            /* Every element is collected once, even if owners of the name are nested or ownership forms a cycle. */
+            std::vector<uint64_t> stack(it->second.begin(), it->second.end());
+            Set                   seen;
+            size_t const          first = res.size();
+            while (!stack.empty() && res.size() - first <= limit) {
+                auto const children = m_owners.find(stack.back());
+                stack.pop_back();
+
+                if (children != m_owners.end())
+                    for (uint64_t const child : children->second)
+                        if (seen.insert(child).second) {
+                            res.push_back(child);
+                            stack.push_back(child);
+                        }
+            }
+
+            return res.size() - first;
+        }
+
+        /**
+         * \brief  retrieves the number of elements an element owns directly
+         *
+         * \param  [in] owner handle of the owner
+         *
+         * \return number of children
+         */
+        size_t childrenOf(uint64_t const owner) const noexcept {
+            auto const it = m_owners.find(owner);
+
+            return it == m_owners.end() ? 0 : it->second.size();
+        }
+
+        /**
+         * \brief  checks whether an element matches all terms but one
+         *
+         * \param  [in] terms terms of the query
+         * \param  [in] skip term answered by the index already; *terms.size()* for none
+         * \param  [in] i dense index of the element
+         *
+         * \return *true* if it matches
+         */
+        bool matches(std::vector<QueryTerm> const &terms, size_t const skip, uint32_t const i) const noexcept {
+            for (size_t t = 0; t < terms.size(); ++t)
+                if (t != skip && matches(terms[t], i) == terms[t].negated)
+                    return false;
+
+            return true;
+        }
+
+        /**
+         * \brief  checks a single term, disregarding its negation
+         *
+         * \param  [in] term term
+         * \param  [in] i dense index of the element
+         *
+         * \return *true* if the term holds
+         */
+        bool matches(QueryTerm const &term, uint32_t const i) const noexcept {
+            ElementStore const &store = *m_store;
+
+            switch (term.field) {
+                case QueryField::Kind:
+                    return (static_cast<uint32_t>(store.kinds()[i]) == term.number) == (term.op == QueryOp::Equal);
+                case QueryField::Style:
+                    return (store.styles()[i] == term.number) == (term.op == QueryOp::Equal);
+                case QueryField::Name:
+                    if (term.op == QueryOp::Contains)
+                        return ContainsNoCase(store.names()[i].view(), term.text);
+
+                    return (store.names()[i] == term.name) == (term.op == QueryOp::Equal);
+                case QueryField::Parent: {
+                    ElementHandle const parent = store.parents()[i];
+
+                    return store.isValid(parent) && store.names()[store.indexOf(parent)] == term.name;
+                }
+                case QueryField::In: {
+                    ElementHandle parent = store.parents()[i];
+                    for (uint32_t depth = 0; depth < store.size() && store.isValid(parent); ++depth) {
+                        uint32_t const p = store.indexOf(parent);
+                        if (store.names()[p] == term.name)
+                            return true;
+
+                        parent = store.parents()[p];
+                    }
+
+                    return false;
+                }
+                case QueryField::Children: {
+                    size_t const n = childrenOf(store.handleAt(i).value());
+
+                    switch (term.op) {
+                        case QueryOp::Equal:     return n == term.number;
+                        case QueryOp::NotEqual:  return n != term.number;
+                        case QueryOp::Less:      return n < term.number;
+                        case QueryOp::LessEqual: return n <= term.number;
+                        case QueryOp::Greater:   return n > term.number;
+                        default:                 return n >= term.number;
+                    }
+                }
+                case QueryField::Hidden:
+                    return (store.flags()[i] & ElementHidden) != 0;
+                case QueryField::Locked:
+                    return (store.flags()[i] & ElementLocked) != 0;
+                case QueryField::Selected:
+                    return (store.flags()[i] & ElementSelected) != 0;
+                default:
+                    return false;
+            }
+        }
+
+        /**
+         * \brief  checks whether a string contains another one, ignoring ASCII case
+         *
+         * \param  [in] text string to search
+         * \param  [in] part string to find
+         *
+         * \return *true* if *part* is found
+         */
+        static bool ContainsNoCase(std::string_view const text, std::string_view const part) noexcept {
+            auto const lower = [](char const c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); };
+
+            return std::search(text.begin(), text.end(), part.begin(), part.end(), [&](char const a, char const b) { return lower(a) == lower(b); }) != text.end();
+        }
+
+        /**
+         * \brief  adds an element to all indexes
+         *
+         * \param  [in] handle element; ignored if it does not exist
+         *
+         * \throw  std::bad_alloc
+         */
+        void insert(ElementHandle const handle) {
+            if (!m_store->isValid(handle))
+                return;
+
+            uint32_t const i     = m_store->indexOf(handle);
+            Entry const    entry = { m_store->kinds()[i], m_store->styles()[i], m_store->names()[i], m_store->parents()[i].value() };
+
+            m_entries[handle.value()] = entry;
+            m_kinds[static_cast<size_t>(entry.kind)].insert(handle.value());
+            m_styles[entry.style].insert(handle.value());
+            m_names[entry.name].insert(handle.value());
+            m_owners[entry.parent].insert(handle.value());
+        }
+
+        /**
+         * \brief  removes an element from all indexes
+         *
+         * \param  [in] handle handle of the element; ignored if it is not indexed
+         */
+        void erase(uint64_t const handle) noexcept {
+            auto const it = m_entries.find(handle);
+            if (it == m_entries.end())
+                return;
+
+            Entry const entry = it->second;
+            m_entries.erase(it);
+
+            m_kinds[static_cast<size_t>(entry.kind)].erase(handle);
+            Remove(m_styles, entry.style, handle);
+            Remove(m_names, entry.name, handle);
+            Remove(m_owners, entry.parent, handle);
+        }
+
+        /**
+         * \brief removes an element from an index entry, dropping the entry once it is empty
+         *
+         * \param [in,out] index index
+         * \param [in] key key of the entry
+         * \param [in] handle handle of the element
+         */
+        template<class Key> static void Remove(std::unordered_map<Key, Set> &index, Key const &key, uint64_t const handle) noexcept {
+            auto const it = index.find(key);
+            if (it == index.end())
+                return;
+
+            it->second.erase(handle);
+            if (it->second.empty())
+                index.erase(it);
+        }
+    };
+}
+
+
@@ -0,0 +1,979 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  reverse.hpp
+ * \brief incremental reverse engineering of C++ sources into class diagrams
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <cctype>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/intern.hpp>
+#include <sdk/layout.hpp>
+#include <sdk/task.hpp>
+#include <sdk/util.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \struct suzu::sdk::CppType
+     * \brief  type defined in a C++ source file
+     */
+    struct CppType {
+        std::string              name;  /**< fully qualified name, e.g. *suzu::sdk::CppType*, without template arguments */
+        ElementKind              kind;  /**< *Class*, *Interface* (only pure virtual member functions) or *Enumeration* */
+        std::vector<std::string> bases; /**< names of the base classes as written, without template arguments */
+    };
+
+    /**
+     * \struct suzu::sdk::ReverseStats
+     * \brief  outcome of a run of *suzu::sdk::ReverseEngineer*
+     */
+    struct ReverseStats {
+        size_t files;  /**< number of files given */
+        size_t parsed; /**< number of files scanned because their contents changed */
+        size_t cached; /**< number of files whose types were taken from the cache */
+        size_t failed; /**< number of files that could not be read */
+        size_t types;  /**< number of types found in all files */
+    };
+
+
+    namespace internal {
+        /**
+         * \class suzu::sdk::internal::CppScanner
+         * \brief extracts the types defined in a C++ source file, without preprocessing it
+         *
+         * The scanner only tracks what a class diagram needs: namespaces, class, struct, union and
+         * enum definitions, their base classes, and whether a class declares nothing but pure
+         * virtual member functions. Comments, literals and preprocessor directives are skipped;
+         * function bodies are only matched by their braces. Unknown identifiers in front of a
+         * class name, e.g. export macros, are ignored. Forward declarations, anonymous types and
+         * types local to functions are not reported.
+         */
+        class CppScanner {
+            /**
+             * \enum  suzu::sdk::internal::CppScanner::TokenType
+             * \brief kinds of tokens the scanner distinguishes
+             */
+            enum class TokenType {
+                Ident,  /**< identifier or keyword */
+                Number, /**< number or character literal */
+                String, /**< string literal */
+                Punct   /**< *::* or any other single character */
+            };
+
+            /**
+             * \struct suzu::sdk::internal::CppScanner::Token
+             * \brief  token of the source
+             */
+            struct Token {
+                TokenType        type; /**< kind of the token */
+                std::string_view text; /**< text, pointing into the source */
+            };
+
+            /**
+             * \enum  suzu::sdk::internal::CppScanner::ScopeKind
+             * \brief kinds of brace-delimited scopes
+             */
+            enum class ScopeKind {
+                Namespace, /**< namespace, *extern "C"* block or the file itself */
+                Class,     /**< body of a reported class */
+                Other      /**< anything else, e.g. a function body or an enumerator list; only braces are matched */
+            };
+
+            /**
+             * \struct suzu::sdk::internal::CppScanner::Statement
+             * \brief  declaration being read in a namespace or class body
+             */
+            struct Statement {
+                std::string_view first;   /**< first token */
+                std::string_view prev;    /**< last token */
+                std::string_view prev2;   /**< token before the last one */
+                bool             virt;    /**< whether or not *virtual* or *override* was read */
+                bool             dtor;    /**< whether or not *~* was read, i.e. the member is a destructor */
+                bool             neutral; /**< whether or not the declaration counts neither as pure nor as other member */
+            };
+
+            /**
+             * \struct suzu::sdk::internal::CppScanner::Scope
+             * \brief  open scope
+             */
+            struct Scope {
+                ScopeKind   kind;    /**< kind of the scope */
+                std::string prefix;  /**< qualification of names defined in the scope, e.g. *a::b::* */
+                size_t      type;    /**< index of the class in the result; only used for *ScopeKind::Class* */
+                uint32_t    pure;    /**< number of pure virtual member functions declared so far */
+                uint32_t    other;   /**< number of other members declared so far, not counting destructors */
+                uint32_t    parens;  /**< nesting of parentheses in the current declaration */
+                bool        restore; /**< whether or not the scope is the body of a type, after which *outer* goes on */
+                Statement   outer;   /**< declaration of the enclosing scope the type is part of, e.g. "struct S { ... } s;" */
+            };
+
+            std::vector<Token> m_tokens; /**< tokens of the source */
+
+        public:
+            /**
+             * \brief  scans a source file
+             *
+             * \param  [in] text contents of the file
+             * \param  [out] types receives the types defined in the file, appended in order of
+             *               definition
+             *
+             * \throw  std::bad_alloc
+             */
+            void scan(std::string_view const text, std::vector<CppType> &types) {
+                tokenize(text);
+
+                std::vector<Scope> scopes = { { ScopeKind::Namespace, std::string(), 0, 0, 0, 0, false, {} } };
+                Statement          stmt   = {};
+                for (size_t i = 0; i < m_tokens.size(); ++i) {
+                    Token const &tok   = m_tokens[i];
+                    Scope       &scope = scopes.back();
+
+                    if (scope.kind == ScopeKind::Other) {
+                        if (tok.text == "{")
+                            scopes.push_back({ ScopeKind::Other, std::string(), 0, 0, 0, 0, false, {} });
+                        else if (tok.text == "}")
+                            close(scopes, types, stmt);
+
+                        continue;
+                    }
+
+                    if (tok.text == "}") {
+                        close(scopes, types, stmt);
+
+                        continue;
+                    }
+                    if (tok.text == "{") {
+                        /* Function bodies and braced initializers; a class declaring them is no interface. */
+                        if (scope.kind == ScopeKind::Class && !stmt.dtor && !stmt.neutral)
+                            ++scope.other;
+
+                        scopes.push_back({ ScopeKind::Other, std::string(), 0, 0, 0, 0, false, {} });
+                        stmt = {};
+                        continue;
+                    }
+                    if (tok.text == "(")
+                        ++scope.parens;
+                    else if (tok.text == ")")
+                        scope.parens -= scope.parens > 0 ? 1 : 0;
+
+                    if (scope.parens == 0 && tok.type == TokenType::Ident) {
+                        size_t open = 0;
+
+                        if (tok.text == "template" && i + 1 < m_tokens.size() && m_tokens[i + 1].text == "<") {
+                            i = skipAngles(i + 1) - 1;
+
+                            continue;
+                        }
+                        if (tok.text == "namespace" && parseNamespace(i, open)) {
+                            std::string prefix = scope.prefix;
+                            for (size_t j = i + 1; j < open; ++j)
+                                prefix.append(m_tokens[j].text);
+                            if (open > i + 1)
+                                prefix.append("::");
+
+                            scopes.push_back({ ScopeKind::Namespace, std::move(prefix), 0, 0, 0, 0, false, {} });
+                            stmt = {};
+                            i    = open;
+                            continue;
+                        }
+                        if (tok.text == "extern" && i + 2 < m_tokens.size() && m_tokens[i + 1].type == TokenType::String && m_tokens[i + 2].text == "{") {
+                            scopes.push_back({ ScopeKind::Namespace, scope.prefix, 0, 0, 0, 0, false, {} });
+                            stmt = {};
+                            i   += 2;
+                            continue;
+                        }
+
+                        std::string              name;
+                        std::vector<std::string> bases;
+                        bool const               isenum = tok.text == "enum";
+                        if ((isenum && parseEnumHead(i, name, open)) || ((tok.text == "class" || tok.text == "struct" || tok.text == "union") && parseClassHead(i, name, bases, open))) {
+                            /* The enclosing declaration goes on after the body, but counts as neither member. */
+                            Statement outer = stmt;
+                            outer.neutral   = true;
+                            stmt            = {};
+                            i               = open;
+
+                            if (name.empty()) {
+                                scopes.push_back({ ScopeKind::Other, std::string(), 0, 0, 0, 0, true, outer });
+
+                                continue;
+                            }
+
+                            std::string qualified = scope.prefix + name;
+                            types.push_back({ qualified, isenum ? ElementKind::Enumeration : ElementKind::Class, std::move(bases) });
+                            if (isenum)
+                                scopes.push_back({ ScopeKind::Other, std::string(), 0, 0, 0, 0, true, outer });
+                            else
+                                scopes.push_back({ ScopeKind::Class, std::move(qualified.append("::")), types.size() - 1, 0, 0, 0, true, outer });
+                            continue;
+                        }
+                    }
+
+                    if (tok.text == ";" && scope.parens == 0) {
+                        if (scope.kind == ScopeKind::Class && !stmt.first.empty())
+                            classify(scope, stmt);
+
+                        stmt = {};
+                        continue;
+                    }
+                    if (tok.text == ":" && scope.kind == ScopeKind::Class && scope.parens == 0 && IsAccessLabel(stmt.prev)) {
+                        stmt = {};
+
+                        continue;
+                    }
+
+                    if (stmt.first.empty())
+                        stmt.first = tok.text;
+                    stmt.prev2 = stmt.prev;
+                    stmt.prev  = tok.text;
+                    stmt.virt |= tok.text == "virtual" || tok.text == "override";
+                    stmt.dtor |= tok.text == "~";
+                }
+            }
+
+        private:
+            /**
+             * \brief  checks whether a token ends an access label, e.g. *public:* or *signals:*
+             *
+             * \param  [in] text token in front of the colon
+             *
+             * \return *true* if it does
+             */
+            static bool IsAccessLabel(std::string_view const text) noexcept {
+                return text == "public" || text == "protected" || text == "private" || text == "signals" || text == "slots" || text == "Q_SIGNALS" || text == "Q_SLOTS";
+            }
+
+            /**
+             * \brief counts a finished member declaration of a class
+             *
+             * \param [in,out] scope body of the class
+             * \param [in] stmt declaration
+             */
+            static void classify(Scope &scope, Statement const &stmt) noexcept {
+                if (stmt.prev2 == "=" && stmt.prev == "0" && stmt.virt)
+                    ++scope.pure;
+                else if (stmt.dtor || stmt.neutral || (stmt.prev2 == "=" && (stmt.prev == "default" || stmt.prev == "delete")))
+                    return;
+                else if (stmt.first != "using" && stmt.first != "friend" && stmt.first != "typedef" && stmt.first != "static_assert")
+                    ++scope.other;
+            }
+
+            /**
+             * \brief closes the innermost scope; unbalanced braces are ignored
+             *
+             * \param [in,out] scopes open scopes
+             * \param [in,out] types types found so far; the kind of a closed class is updated
+             * \param [out] stmt receives the declaration of the enclosing scope; reset after function
+             *                  bodies
+             */
+            static void close(std::vector<Scope> &scopes, std::vector<CppType> &types, Statement &stmt) noexcept {
+                if (scopes.size() < 2)
+                    return;
+
+                Scope const &scope = scopes.back();
+                if (scope.kind == ScopeKind::Class && scope.pure > 0 && scope.other == 0)
+                    types[scope.type].kind = ElementKind::Interface;
+
+                stmt = scope.restore ? scope.outer : Statement();
+                scopes.pop_back();
+            }
+
+            /**
+             * \brief  skips a balanced list of template arguments or parameters
+             *
+             * \param  [in] i index of the opening *<*
+             *
+             * \return index one past the closing *>*, or of the *;*, *{* or *}* ending a malformed list
+             */
+            size_t skipAngles(size_t i) const noexcept {
+                uint32_t angles = 0, parens = 0;
+                for (; i < m_tokens.size(); ++i) {
+                    std::string_view const text = m_tokens[i].text;
+
+                    if (text == ";" || text == "{" || text == "}")
+                        return i;
+                    if (text == "(" || text == "[")
+                        ++parens;
+                    else if ((text == ")" || text == "]") && parens > 0)
+                        --parens;
+                    else if (parens == 0 && text == "<")
+                        ++angles;
+                    else if (parens == 0 && text == ">" && --angles == 0)
+                        return i + 1;
+                }
+
+                return i;
+            }
+
+            /**
+             * \brief  skips attributes and specifiers like *[[nodiscard]]*, *alignas(8)* or
+             *         *__declspec(dllexport)*
+             *
+             * \param  [in] i index of a token
+             *
+             * \return index of the first token after them; *i* if there are none
+             */
+            size_t skipAttributes(size_t i) const noexcept {
+                for (;;) {
+                    if (i + 1 < m_tokens.size() && m_tokens[i].text == "[" && m_tokens[i + 1].text == "[") {
+                        uint32_t depth = 0;
+                        for (; i < m_tokens.size(); ++i)
+                            if (m_tokens[i].text == "[")
+                                ++depth;
+                            else if (m_tokens[i].text == "]" && --depth == 0)
+                                break;
+
+                        ++i;
+                        continue;
+                    }
+                    if (i + 1 < m_tokens.size() && m_tokens[i + 1].text == "(" && (m_tokens[i].text == "alignas" || m_tokens[i].text == "__declspec" || m_tokens[i].text == "__attribute__")) {
+                        uint32_t depth = 0;
+                        for (++i; i < m_tokens.size(); ++i)
+                            if (m_tokens[i].text == "(")
+                                ++depth;
+                            else if (m_tokens[i].text == ")" && --depth == 0)
+                                break;
+
+                        ++i;
+                        continue;
+                    }
+
+                    return i;
+                }
+            }
+
+            /**
+             * \brief  reads the name of a namespace definition, e.g. *namespace a::b {*
+             *
+             * \param  [in] i index of *namespace*
+             * \param  [out] open receives the index of the opening brace
+             *
+             * \return *true* if a namespace is defined, *false* e.g. for aliases and *using namespace*
+             */
+            bool parseNamespace(size_t const i, size_t &open) const noexcept {
+                if (i > 0 && m_tokens[i - 1].text == "using")
+                    return false;
+
+                for (size_t j = i + 1; j < m_tokens.size(); ++j) {
+                    Token const &tok = m_tokens[j];
+
+                    if (tok.text == "{") {
+                        open = j;
+
+                        return true;
+                    }
+                    if (tok.type != TokenType::Ident && tok.text != "::")
+                        return false;
+                }
+
+                return false;
+            }
+
+            /**
+             * \brief  reads a possibly qualified name, e.g. *a::B* or *::C*
+             *
+             * \param  [in,out] i index of its first token; receives the index one past its last
+             * \param  [out] name receives the name
+             *
+             * \return *true* if a name was read
+             */
+            bool parseName(size_t &i, std::string &name) const {
+                name.clear();
+                while (i < m_tokens.size()) {
+                    Token const &tok = m_tokens[i];
+
+                    if (tok.text == "::")
+                        name.append("::");
+                    else if (tok.type == TokenType::Ident && (name.empty() || name.back() == ':'))
+                        name.append(tok.text);
+                    else
+                        break;
+
+                    ++i;
+                }
+
+                return !name.empty() && name.back() != ':';
+            }
+
+            /**
+             * \brief  reads the head of a class definition, e.g. *class SZ_API Foo final : public Bar<T> {*
+             *
+             * \param  [in] i index of *class*, *struct* or *union*
+             * \param  [out] name receives the name of the class; empty if it is anonymous
+             * \param  [out] bases receives the names of the base classes
+             * \param  [out] open receives the index of the opening brace
+             *
+             * \return *true* if a class is defined, *false* e.g. for forward declarations and
+             *         elaborated type specifiers
+             * \throw  std::bad_alloc
+             */
+            bool parseClassHead(size_t i, std::string &name, std::vector<std::string> &bases, size_t &open) const {
+                name.clear();
+
+                for (++i; (i = skipAttributes(i)) < m_tokens.size(); ) {
+                    Token const &tok = m_tokens[i];
+
+                    if (tok.text == "{")
+                        break;
+                    if (tok.text == "<") {
+                        i = skipAngles(i);
+
+                        continue;
+                    }
+                    if (tok.text == ":") {
+                        if (!parseBases(i + 1, bases, i))
+                            return false;
+
+                        break;
+                    }
+                    if (tok.type != TokenType::Ident && tok.text != "::")
+                        return false;
+
+                    /* Of several names, e.g. behind an export macro, the last one is the class. */
+                    if (tok.text == "final") {
+                        ++i;
+
+                        continue;
+                    }
+                    if (!parseName(i, name))
+                        return false;
+                }
+                if (i >= m_tokens.size())
+                    return false;
+
+                open = i;
+                return true;
+            }
+
+            /**
+             * \brief  reads the base classes of a class definition
+             *
+             * \param  [in] i index of the first token after the colon
+             * \param  [out] bases receives the names of the base classes
+             * \param  [out] open receives the index of the opening brace
+             *
+             * \return *true* if the list ends with the opening brace of the class
+             * \throw  std::bad_alloc
+             */
+            bool parseBases(size_t i, std::vector<std::string> &bases, size_t &open) const {
+                std::string base;
+                while (i < m_tokens.size()) {
+                    Token const &tok = m_tokens[i];
+
+                    if (tok.text == "{" || tok.text == ",") {
+                        if (!base.empty())
+                            bases.push_back(std::move(base));
+                        base.clear();
+
+                        if (tok.text == "{") {
+                            open = i;
+
+                            return true;
+                        }
+                        ++i;
+                    } else if (tok.text == "<") {
+                        i = skipAngles(i);
+                    } else if (tok.text == "(") {
+                        /* e.g. decltype(...); the base is not named. */
+                        uint32_t depth = 0;
+                        for (; i < m_tokens.size(); ++i)
+                            if (m_tokens[i].text == "(")
+                                ++depth;
+                            else if (m_tokens[i].text == ")" && --depth == 0)
+                                break;
+
+                        ++i;
+                    } else if (tok.text == "public" || tok.text == "protected" || tok.text == "private" || tok.text == "virtual") {
+                        ++i;
+                    } else if (tok.type == TokenType::Ident || tok.text == "::") {
+                        if (!parseName(i, base))
+                            base.clear();
+                    } else if (tok.text == ";" || tok.text == "}") {
+                        return false;
+                    } else {
+                        ++i;
+                    }
+                }
+
+                return false;
+            }
+
+            /**
+             * \brief  reads the head of an enumeration definition, e.g. *enum class Color : uint8_t {*
+             *
+             * \param  [in] i index of *enum*
+             * \param  [out] name receives the name of the enumeration; empty if it is anonymous
+             * \param  [out] open receives the index of the opening brace
+             *
+             * \return *true* if an enumeration is defined, *false* e.g. for opaque declarations
+             * \throw  std::bad_alloc
+             */
+            bool parseEnumHead(size_t i, std::string &name, size_t &open) const {
+                name.clear();
+
+                ++i;
+                if (i < m_tokens.size() && (m_tokens[i].text == "class" || m_tokens[i].text == "struct"))
+                    ++i;
+
+                i = skipAttributes(i);
+                if (i < m_tokens.size() && (m_tokens[i].type == TokenType::Ident || m_tokens[i].text == "::"))
+                    parseName(i, name);
+
+                /* The underlying type, if any, is skipped up to the brace. */
+                for (; i < m_tokens.size(); ++i) {
+                    if (m_tokens[i].text == "{") {
+                        open = i;
+
+                        return true;
+                    }
+                    if (m_tokens[i].text == ";" || m_tokens[i].text == "}" || m_tokens[i].text == "(" || m_tokens[i].text == "=")
+                        return false;
+                }
+
+                return false;
+            }
+
+            /**
+             * \brief  splits a source into tokens, skipping comments and preprocessor directives
+             *
+             * \param  [in] text contents of the file
+             *
+             * \throw  std::bad_alloc
+             */
+            void tokenize(std::string_view const text) {
+                m_tokens.clear();
+                m_tokens.reserve(text.size() / 6);
+
+                auto const isident = [](char const c) {
+                    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' || static_cast<unsigned char>(c) >= 0x80;
+                };
+
+                size_t const n   = text.size();
+                bool         bol = true;
+                for (size_t i = 0; i < n; ) {
+                    char const c = text[i];
+
+                    if (c == '\n') {
+                        bol = true;
+                        ++i;
+                    } else if (std::isspace(static_cast<unsigned char>(c))) {
+                        ++i;
+                    } else if (c == '#' && bol) {
+                        /* Directives end at the first line break not preceded by a backslash. */
+                        for (; i < n && text[i] != '\n'; ++i)
+                            if (text[i] == '\\' && i + 1 < n && text[i + 1] == '\n')
+                                ++i;
+                    } else if (c == '/' && i + 1 < n && text[i + 1] == '/') {
+                        i = std::min(n, text.find('\n', i));
+                    } else if (c == '/' && i + 1 < n && text[i + 1] == '*') {
+                        size_t const end = text.find("*/", i + 2);
+                        i = end == std::string_view::npos ? n : end + 2;
+                    } else if (c == '"' || c == '\'') {
+                        size_t const start = i;
+                        for (++i; i < n && text[i] != c && text[i] != '\n'; ++i)
+                            if (text[i] == '\\')
+                                ++i;
+
+                        i = std::min(n, i + 1);
+                        m_tokens.push_back({ c == '"' ? TokenType::String : TokenType::Number, text.substr(start, i - start) });
+                        bol = false;
+                    } else if (std::isdigit(static_cast<unsigned char>(c))) {
+                        /* Includes digit separators and suffixes, e.g. 1'000ull. */
+                        size_t const start = i;
+                        while (i < n && (isident(text[i]) || text[i] == '.' || text[i] == '\''))
+                            ++i;
+
+                        m_tokens.push_back({ TokenType::Number, text.substr(start, i - start) });
+                        bol = false;
+                    } else if (isident(c)) {
+                        size_t const start = i;
+                        while (i < n && isident(text[i]))
+                            ++i;
+
+                        std::string_view const word = text.substr(start, i - start);
+                        if (i < n && text[i] == '"' && (word == "R" || word == "LR" || word == "uR" || word == "UR" || word == "u8R")) {
+                            /* Raw strings end at the delimiter given in front of the parenthesis. */
+                            size_t const paren = text.find('(', i);
+                            std::string  delim = ")";
+                            if (paren != std::string_view::npos)
+                                delim.append(text.substr(i + 1, paren - i - 1)).push_back('"');
+
+                            size_t const end = paren == std::string_view::npos ? std::string_view::npos : text.find(delim, paren);
+                            i = end == std::string_view::npos ? n : end + delim.size();
+                            m_tokens.push_back({ TokenType::String, text.substr(start, i - start) });
+                        } else if (i < n && text[i] == '"' && (word == "L" || word == "u" || word == "U" || word == "u8")) {
+                            continue;
+                        } else {
+                            m_tokens.push_back({ TokenType::Ident, word });
+                        }
+                        bol = false;
+                    } else {
+                        size_t const len = c == ':' && i + 1 < n && text[i + 1] == ':' ? 2 : 1;
+
+                        m_tokens.push_back({ TokenType::Punct, text.substr(i, len) });
+                        i  += len;
+                        bol = false;
+                    }
+                }
+            }
+        };
+    }
+
+
+    /**
+     * \class suzu::sdk::ReverseEngineer
+     * \brief builds class diagrams from C++ sources, rescanning only the files that changed
+     *
+     * Files are read and scanned in parallel on the task scheduler (see
+     * *suzu::sdk::internal::CppScanner*). The types found in every file are cached by the hash of
+     * the file's contents, so after a commit only the files it touched are scanned again; all
+     * others merely have to be hashed. The cache can be stored next to the diagram (*save()*) and
+     * is restored by *load()*; entries of files that were not part of the last run are dropped.
+     *
+     * *build()* merges the types of all files by their qualified name, lays them out with
+     * *suzu::sdk::HierarchicalLayout*, base classes above, and fills a
+     * *suzu::sdk::ElementBatch* with one element per type and one association per resolved base
+     * class, pointing from the derived class to its base. The batch is inserted at once via
+     * *suzu::sdk::ElementStore::insert()* or the undo stack of the host.
+     *
+     * \note  Base classes are resolved like unqualified names in C++, from the innermost enclosing
+     *        namespace outwards; bases not defined in any of the files, e.g. of libraries, are
+     *        left out.
+     */
+    class ReverseEngineer {
+    public:
+        static constexpr char const *gl_cachename = ".suzu-reverse"; /**< conventional file name of the cache, in the directory of the diagram */
+        static constexpr float       gl_charwidth = 7.0f;            /**< width of an element per character of its name */
+        static constexpr float       gl_minwidth  = 120.0f;          /**< minimum width of an element */
+        static constexpr float       gl_height    = 60.0f;           /**< height of an element */
+
+    private:
+        using TypeList = std::shared_ptr<std::vector<CppType> const>; /**< types of a file; shared between the cache and the last run */
+
+        /**
+         * \struct suzu::sdk::ReverseEngineer::Entry
+         * \brief  cached result of a file
+         */
+        struct Entry {
+            uint64_t size;  /**< size of the file, in bytes; guards against hash collisions */
+            TypeList types; /**< types defined in the file */
+        };
+
+        std::unordered_map<uint64_t, Entry> m_cache; /**< results, by hash of the file contents */
+        std::vector<TypeList>               m_files; /**< types of every file of the last run, in the order given */
+
+    public:
+        /**
+         * \brief  restores the cache of a previous run
+         *
+         * \param  [in] path path of the cache
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or the error of *util::ReadFile()*; a
+         *         malformed cache is left empty
+         */
+        ErrorCode load(char const *const path) noexcept {
+            m_cache.clear();
+
+            try {
+                Result<util::FileBuffer> const text = util::ReadFile(path, true);
+                if (!text)
+                    return text.error();
+
+                /*
+                 * Every file is a line holding the hash in hexadecimal, its size and its number of
+                 * types, followed by one line per type: its kind (c, i or e), name and bases,
+                 * separated by spaces.
+                 */
+                std::string_view rest(text->data(), text->size());
+                auto const       line = [&rest]() {
+                    size_t const     eol = rest.find('\n');
+                    std::string_view res = rest.substr(0, eol);
+
+                    rest = eol == std::string_view::npos ? std::string_view() : rest.substr(eol + 1);
+                    return res;
+                };
+                while (!rest.empty()) {
+                    uint64_t           hash = 0, size = 0;
+                    unsigned long long count = 0;
+                    if (std::sscanf(std::string(line()).c_str(), "%16" SCNx64 " %" SCNu64 " %llu", &hash, &size, &count) != 3 || count > rest.size()) {
+                        m_cache.clear();
+
+                        return ErrorCode::Ok;
+                    }
+
+                    auto types = std::make_shared<std::vector<CppType>>();
+                    types->reserve(static_cast<size_t>(count));
+                    for (unsigned long long i = 0; i < count; ++i) {
+                        std::vector<std::string> words = Split(line());
+                        if (words.size() < 2 || words[0].size() != 1 || std::string_view("cie").find(words[0][0]) == std::string_view::npos) {
+                            m_cache.clear();
+
+                            return ErrorCode::Ok;
+                        }
+
+                        ElementKind const kind = words[0][0] == 'c' ? ElementKind::Class : words[0][0] == 'i' ? ElementKind::Interface : ElementKind::Enumeration;
+                        types->push_back({ std::move(words[1]), kind, std::vector<std::string>(std::make_move_iterator(words.begin() + 2), std::make_move_iterator(words.end())) });
+                    }
+                    m_cache[hash] = { size, std::move(types) };
+                }
+
+                return ErrorCode::Ok;
+            } catch (...) {
+                m_cache.clear();
+            }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  stores the cache for the next run
+         *
+         * \param  [in] path path of the cache
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or the error of *util::WriteFileAtomic()*
+         */
+        ErrorCode save(char const *const path) const noexcept {
+            try {
+                std::vector<uint64_t> hashes;
+                hashes.reserve(m_cache.size());
+                for (auto const &[hash, entry] : m_cache)
+                    hashes.push_back(hash);
+                std::sort(hashes.begin(), hashes.end());
+
+                std::string text;
+                for (uint64_t const hash : hashes) {
+                    Entry const &entry = m_cache.at(hash);
+
+                    char head[64];
+                    std::snprintf(head, sizeof head, "%016" PRIx64 " %" PRIu64 " %llu\n", hash, entry.size, static_cast<unsigned long long>(entry.types->size()));
+                    text.append(head);
+
+                    for (CppType const &type : *entry.types) {
+                        text.push_back(type.kind == ElementKind::Interface ? 'i' : type.kind == ElementKind::Enumeration ? 'e' : 'c');
+                        text.append(" ").append(type.name);
+                        for (std::string const &base : type.bases)
+                            text.append(" ").append(base);
+                        text.push_back('\n');
+                    }
+                }
+
+                return util::WriteFileAtomic(path, text.data(), text.size(), true);
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  reads all files and scans those not found in the cache
+         *
+         * Blocks until all files have been processed; call it from a task or a job. Afterwards,
+         * the cache only holds the files of this run.
+         *
+         * \param  [in] files paths of the source files, e.g. all headers of a project
+         * \param  [out] stats receives the numbers of scanned, cached and failed files
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if all files were read, *suzu::sdk::ErrorCode::ReadFile*
+         *         if any file could not be read, or *suzu::sdk::ErrorCode::CriticalResource* if
+         *         memory ran out; the results of the previous run are kept then
+         */
+        ErrorCode run(std::vector<std::string> const &files, ReverseStats &stats) noexcept {
+            stats = { files.size(), 0, 0, 0, 0 };
+
+            try {
+                std::vector<TypeList> results(files.size());
+                std::vector<uint64_t> hashes(files.size()), sizes(files.size());
+                std::vector<char>     parsed(files.size(), 0);
+
+                /* The cache is only read while the files are processed. */
+                ParallelFor(files.size(), [&](size_t const i) {
+                    util::MappedFile file;
+                    if (util::MapFile(files[i].c_str(), file) != ErrorCode::Ok)
+                        return;
+
+                    hashes[i] = util::HashBytes(file.data(), file.size());
+                    sizes[i]  = file.size();
+
+                    auto const it = m_cache.find(hashes[i]);
+                    if (it != m_cache.end() && it->second.size == sizes[i]) {
+                        results[i] = it->second.types;
+
+                        return;
+                    }
+
+                    auto                 types = std::make_shared<std::vector<CppType>>();
+                    internal::CppScanner scanner;
+                    scanner.scan(file.view(), *types);
+
+                    results[i] = std::move(types);
+                    parsed[i]  = 1;
+                }, TaskPriority::Normal);
+
+                std::unordered_map<uint64_t, Entry> cache;
+                cache.reserve(files.size());
+                for (size_t i = 0; i < files.size(); ++i) {
+                    if (results[i] == nullptr) {
+                        ++stats.failed;
+
+                        continue;
+                    }
+
+                    ++(parsed[i] ? stats.parsed : stats.cached);
+                    stats.types += results[i]->size();
+                    cache[hashes[i]] = { sizes[i], results[i] };
+                }
+
+                m_cache.swap(cache);
+                m_files.swap(results);
+                return stats.failed == 0 ? ErrorCode::Ok : ErrorCode::ReadFile;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  lays out the types of the last run and adds them to a batch
+         *
+         * \param  [out] batch receives one element per type, followed by the associations to the
+         *                     base classes; appended to its contents
+         * \param  [in] opts layout parameters
+         * \param  [out] edges optional number of associations added
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if memory ran out; *batch* may be partially filled then
+         */
+        ErrorCode build(ElementBatch &batch, LayoutOptions const &opts = {}, size_t *edges = nullptr) const noexcept {
+            try {
+                /* Types defined more than once, e.g. by partial specializations, are merged. */
+                std::unordered_map<std::string_view, uint32_t> index;
+                std::vector<CppType const *>                     types;
+                for (TypeList const &file : m_files)
+                    if (file != nullptr)
+                        for (CppType const &type : *file)
+                            if (index.emplace(type.name, static_cast<uint32_t>(types.size())).second)
+                                types.push_back(&type);
+
+                /* The bases of all definitions of a type are collected as edges from base to derived. */
+                std::vector<LayoutEdge>      graph;
+                std::unordered_set<uint64_t> seen;
+                for (TypeList const &file : m_files)
+                    if (file != nullptr)
+                        for (CppType const &type : *file) {
+                            uint32_t const derived = index.at(type.name);
+
+                            for (std::string const &base : type.bases) {
+                                uint32_t const res = Resolve(index, type.name, base);
+
+                                if (res != UINT32_MAX && res != derived && seen.insert(static_cast<uint64_t>(res) << 32 | derived).second)
+                                    graph.push_back({ res, derived });
+                            }
+                        }
+
+                std::vector<ElementRect> nodes(types.size());
+                for (size_t i = 0; i < types.size(); ++i)
+                    nodes[i] = { 0.0f, 0.0f, std::max(gl_minwidth, gl_charwidth * static_cast<float>(types[i]->name.size() + 4)), gl_height };
+
+                ErrorCode const err = HierarchicalLayout::Run(nodes, graph, opts);
+                if (err != ErrorCode::Ok)
+                    return err;
+
+                uint32_t const first = batch.size();
+                batch.reserve(first + static_cast<uint32_t>(types.size() + graph.size()));
+                for (size_t i = 0; i < types.size(); ++i)
+                    batch.add(types[i]->kind, nodes[i], 0, ElementBatch::gl_nobatch, StringId(types[i]->name));
+                for (LayoutEdge const &edge : graph)
+                    batch.connect(first + edge.to, first + edge.from);
+
+                if (edges != nullptr)
+                    *edges = graph.size();
+                return ErrorCode::Ok;
+            } catch (...) { }
+
+            return ErrorCode::CriticalResource;
+        }
+
+        size_t files() const noexcept  { return m_files.size(); }
+        size_t cached() const noexcept { return m_cache.size(); }
+
+    private:
+        /**
+         * \brief  splits a line of the cache into words
+         *
+         * \param  [in] line line
+         *
+         * \return words, separated by single spaces
+         * \throw  std::bad_alloc
+         */
+        static std::vector<std::string> Split(std::string_view line) {
+            std::vector<std::string> res;
+            while (!line.empty()) {
+                size_t const end = line.find(' ');
+
+                if (end != 0)
+                    res.emplace_back(line.substr(0, end));
+                line = end == std::string_view::npos ? std::string_view() : line.substr(end + 1);
+            }
+
+            return res;
+        }
+
+        /**
+         * \brief  looks up the base class of a type
+         *
+         * \param  [in] index types, by qualified name
+         * \param  [in] derived qualified name of the derived type
+         * \param  [in] base name of the base class as written
+         *
+         * \return index of the base class, or *UINT32_MAX* if it is not defined in any file
+         */
+        static uint32_t Resolve(std::unordered_map<std::string_view, uint32_t> const &index, std::string_view derived, std::string_view const base) {
+            if (base.substr(0, 2) == "::") {
+                auto const it = index.find(base.substr(2));
+
+                return it == index.end() ? UINT32_MAX : it->second;
+            }
+
+            /* The derived type's own scope is searched first, then every enclosing namespace. */
+            std::string name;
+            for (;;) {
+                name.assign(derived).append(derived.empty() ? "" : "::").append(base);
+
+                auto const it = index.find(name);
+                if (it != index.end())
+                    return it->second;
+                if (derived.empty())
+                    return UINT32_MAX;
+
+                size_t const sep = derived.rfind("::");
+                derived = sep == std::string_view::npos ? std::string_view() : derived.substr(0, sep);
+            }
+        }
+    };
+}
+
+
@@ -0,0 +1,530 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  sequence.hpp
+ * \brief data-oriented storage of sequence diagrams
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+#include <sdk/intern.hpp>
+#include <sdk/memory.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \enum  suzu::sdk::MessageKind
+     * \brief kind of a message between two lifelines
+     */
+    enum class MessageKind : uint32_t {
+        Sync,  /**< synchronous call; filled arrow head */
+        Async, /**< asynchronous signal; open arrow head */
+        Reply  /**< return of a call; dashed line */
+    };
+
+    /**
+     * \struct suzu::sdk::SequenceActivation
+     * \brief  period during which a lifeline is active, drawn as a bar on top of it
+     */
+    struct SequenceActivation {
+        uint32_t lifeline; /**< index of the lifeline */
+        double   begin;    /**< time the activation starts */
+        double   end;      /**< time the activation ends; not less than *begin* */
+    };
+
+    /**
+     * \struct suzu::sdk::SequenceFragment
+     * \brief  combined fragment of kind *loop*, framing the messages of its first iteration
+     *
+     * Importers fold repeated iterations into the fragment, so that only the first is kept as
+     * messages.
+     */
+    struct SequenceFragment {
+        uint32_t first;      /**< leftmost lifeline of the frame */
+        uint32_t last;       /**< rightmost lifeline of the frame; not less than *first* */
+        uint32_t iterations; /**< number of iterations */
+        double   begin;      /**< time of the first message of the first iteration */
+        double   end;        /**< time of the last message of the first iteration; not less than *begin* */
+    };
+
+    /**
+     * \struct suzu::sdk::SequenceMessage
+     * \brief  message between two lifelines, as added to a *suzu::sdk::SequenceModel*
+     */
+    struct SequenceMessage {
+        double      time;  /**< time the message is sent */
+        uint32_t    from;  /**< sending lifeline */
+        uint32_t    to;    /**< receiving lifeline; equal to *from* for messages to self */
+        MessageKind kind;  /**< kind of the message */
+        StringId    label; /**< label of the message; empty if it has none */
+    };
+
+    /**
+     * \struct suzu::sdk::SequenceBatch
+     * \brief  part of a sequence diagram, e.g. as delivered by a streaming importer
+     *
+     * Lifelines are appended to those of the model in order; all other entries may refer to them.
+     */
+    struct SequenceBatch {
+        std::vector<StringId>           lifelines;   /**< names of new lifelines */
+        std::vector<SequenceMessage>    messages;    /**< messages, in any order */
+        std::vector<SequenceActivation> activations; /**< activations, in any order */
+        std::vector<SequenceFragment>   fragments;   /**< combined fragments, in any order */
+
+        bool empty() const noexcept { return lifelines.empty() && messages.empty() && activations.empty() && fragments.empty(); }
+
+        void clear() noexcept {
+            lifelines.clear();
+            messages.clear();
+            activations.clear();
+            fragments.clear();
+        }
+    };
+
+
+    namespace internal {
+        /**
+         * \class suzu::sdk::internal::IntervalList
+         * \brief intervals ordered by their start and indexed by blocks of *gl_blocksize*, each
+         *        knowing the latest end of its intervals
+         *
+         * Finding the intervals overlapping a window skips every block that ends before the window,
+         * so it costs about one check per block plus the intervals found.
+         *
+         * \tparam T interval; has the members *double begin* and *double end*
+         */
+        template<class T> class IntervalList {
+            static constexpr size_t gl_blocksize = 64; /**< intervals per block */
+
+            std::vector<T>      m_items;    /**< intervals, ordered by start */
+            std::vector<double> m_blockend; /**< latest end of the intervals of every block */
+
+        public:
+            /**
+             * \brief inserts an interval after all intervals starting at the same time or earlier
+             *
+             * \param [in] item the interval
+             * \throw std::bad_alloc
+             */
+            void insert(T const &item) {
+                auto const   pos   = std::upper_bound(m_items.begin(), m_items.end(), item.begin, [](double const begin, T const &other) { return begin < other.begin; });
+                size_t const index = static_cast<size_t>(pos - m_items.begin());
+
+                m_blockend.reserve(m_items.size() / gl_blocksize + 1);
+                m_items.insert(pos, item);
+
+                refresh(index);
+            }
+
+            /**
+             * \brief inserts intervals in one pass, each after all intervals starting at the same
+             *        time or earlier
+             *
+             * Only the intervals starting after the earliest new one move, once each.
+             *
+             * \param [in] items the intervals, in any order; equal starts keep their order
+             * \throw std::bad_alloc
+             */
+            void insert(std::vector<T> items) {
+                if (items.empty())
+                    return;
+
+                std::stable_sort(items.begin(), items.end(), [](T const &a, T const &b) { return a.begin < b.begin; });
+                m_blockend.reserve((m_items.size() + items.size()) / gl_blocksize + 1);
+
+                size_t i = m_items.size();
+                size_t j = items.size();
+                m_items.resize(i + j);
+                for (size_t k = m_items.size(); j > 0; --k)
+                    if (i > 0 && m_items[i - 1].begin > items[j - 1].begin)
+                        m_items[k - 1] = m_items[--i];
+                    else
+                        m_items[k - 1] = items[--j];
+
+                refresh(i);
+            }
+
+            void clear() noexcept {
+                m_items    = {};
+                m_blockend = {};
+            }
+
+            size_t size() const noexcept { return m_items.size(); }
+
+            /**
+             * \brief visits all intervals overlapping a window
+             *
+             * \param [in] begin start of the window
+             * \param [in] end end of the window
+             * \param [in] fn called with every interval that starts at or before *end* and ends at
+             *             or after *begin*, in order of start
+             */
+            template<class Fn> void visit(double const begin, double const end, Fn &&fn) const {
+                auto const   last  = std::upper_bound(m_items.begin(), m_items.end(), end, [](double const time, T const &other) { return time < other.begin; });
+                size_t const count = static_cast<size_t>(last - m_items.begin());
+
+                for (size_t block = 0; block * gl_blocksize < count; ++block) {
+                    if (m_blockend[block] < begin)
+                        continue;
+
+                    for (size_t i = block * gl_blocksize, n = std::min((block + 1) * gl_blocksize, count); i < n; ++i)
+                        if (m_items[i].end >= begin)
+                            fn(m_items[i]);
+                }
+            }
+
+        private:
+            /**
+             * \brief recomputes the latest ends of the blocks from an interval on
+             *
+             * \param [in] index first interval that moved; the blocks before it are unchanged
+             */
+            void refresh(size_t const index) noexcept {
+                /* The capacity has been reserved by the caller. */
+                m_blockend.resize((m_items.size() + gl_blocksize - 1) / gl_blocksize);
+                for (size_t block = index / gl_blocksize; block < m_blockend.size(); ++block) {
+                    size_t const first = block * gl_blocksize;
+                    size_t const last  = std::min(first + gl_blocksize, m_items.size());
+
+                    m_blockend[block] = m_items[first].end;
+                    for (size_t i = first + 1; i < last; ++i)
+                        m_blockend[block] = std::max(m_blockend[block], m_items[i].end);
+                }
+            }
+        };
+    }
+
+
+    /**
+     * \class suzu::sdk::SequenceModel
+     * \brief structure-of-arrays storage of a sequence diagram, e.g. generated from a trace
+     *
+     * Messages are kept in one array per component (time, sender, receiver, kind, label), ordered by
+     * time; the position of a message in this order is its *row*. A view showing a window of rows
+     * thus finds the messages to draw by index, without looking at any other message, however long
+     * the diagram.
+     *
+     * Activations and combined fragments are kept ordered by their start and indexed by blocks
+     * (see *suzu::sdk::internal::IntervalList*), so finding those overlapping a window of time
+     * costs about one check per 64 of them plus the ones found.
+     *
+     * Growing the arrays charges heap memory to the memory account *"model"* (see
+     * *suzu::sdk::MemoryAccounts*).
+     *
+     * \note  The model is not thread-safe.
+     */
+    class SequenceModel {
+        std::vector<StringId>                      m_lifelines;   /**< names, by lifeline index */
+        std::vector<double>                        m_times;       /**< times, by row; ascending */
+        std::vector<uint32_t>                      m_from;        /**< sending lifelines, by row */
+        std::vector<uint32_t>                      m_to;          /**< receiving lifelines, by row */
+        std::vector<MessageKind>                   m_kinds;       /**< kinds, by row */
+        std::vector<StringId>                      m_labels;      /**< labels, by row */
+        internal::IntervalList<SequenceActivation> m_activations; /**< activations */
+        internal::IntervalList<SequenceFragment>   m_fragments;   /**< combined fragments */
+
+    public:
+        /**
+         * \brief  adds a lifeline, to the right of all existing ones
+         *
+         * \param  [in] name name of the lifeline
+         *
+         * \return index of the lifeline
+         */
+        uint32_t addLifeline(StringId const name) {
+            SZSDK_MEMORY_SCOPE("model");
+
+            m_lifelines.push_back(name);
+            return static_cast<uint32_t>(m_lifelines.size() - 1);
+        }
+
+        uint32_t lifelineCount() const noexcept { return static_cast<uint32_t>(m_lifelines.size()); }
+        StringId lifelineName(uint32_t const lifeline) const noexcept { return m_lifelines[lifeline]; }
+
+        /**
+         * \brief  adds a message
+         *
+         * Messages added in order of time are appended; others are inserted after all messages of
+         * the same or an earlier time, which moves the rows of all later ones.
+         *
+         * \param  [in] time time the message is sent, e.g. a timestamp of the trace
+         * \param  [in] from sending lifeline
+         * \param  [in] to receiving lifeline; equal to *from* for messages to self
+         * \param  [in] kind kind of the message
+         * \param  [in] label (optional) label of the message
+         *
+         * \return row of the message, *suzu::sdk::ErrorCode::InvalidParameter* if either lifeline
+         *         does not exist, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out; the
+         *         model is unchanged then
+         */
+        Result<uint32_t> addMessage(double const time, uint32_t const from, uint32_t const to, MessageKind const kind, StringId const label = {}) noexcept {
+            if (from >= m_lifelines.size() || to >= m_lifelines.size())
+                return ErrorCode::InvalidParameter;
+
+            SZSDK_MEMORY_SCOPE("model");
+
+            size_t const row = m_times.empty() || m_times.back() <= time ? m_times.size() : static_cast<size_t>(std::upper_bound(m_times.begin(), m_times.end(), time) - m_times.begin());
+            try {
+                reserve(m_times.size() + 1);
+            } catch (...) {
+                return ErrorCode::CriticalResource;
+            }
+
+            /* Capacity is reserved, so none of the insertions can fail. */
+            m_times.insert(m_times.begin() + static_cast<ptrdiff_t>(row), time);
+            m_from.insert(m_from.begin() + static_cast<ptrdiff_t>(row), from);
+            m_to.insert(m_to.begin() + static_cast<ptrdiff_t>(row), to);
+            m_kinds.insert(m_kinds.begin() + static_cast<ptrdiff_t>(row), kind);
+            m_labels.insert(m_labels.begin() + static_cast<ptrdiff_t>(row), label);
+            return static_cast<uint32_t>(row);
+        }
+
+        /**
+         * \brief  adds an activation
+         *
+         * \param  [in] activation the activation; *end* is raised to *begin* if less
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the lifeline does not exist, or *suzu::sdk::ErrorCode::CriticalResource* if memory
+         *         ran out
+         */
+        ErrorCode addActivation(SequenceActivation activation) noexcept {
+            if (activation.lifeline >= m_lifelines.size())
+                return ErrorCode::InvalidParameter;
+
+            SZSDK_MEMORY_SCOPE("model");
+
+            activation.end = std::max(activation.end, activation.begin);
+            try {
+                m_activations.insert(activation);
+            } catch (...) {
+                return ErrorCode::CriticalResource;
+            }
+
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief  adds a combined fragment
+         *
+         * \param  [in] fragment the fragment; *end* is raised to *begin* if less
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         a lifeline does not exist or *first* is greater than *last*, or
+         *         *suzu::sdk::ErrorCode::CriticalResource* if memory ran out
+         */
+        ErrorCode addFragment(SequenceFragment fragment) noexcept {
+            if (fragment.last >= m_lifelines.size() || fragment.first > fragment.last)
+                return ErrorCode::InvalidParameter;
+
+            SZSDK_MEMORY_SCOPE("model");
+
+            fragment.end = std::max(fragment.end, fragment.begin);
+            try {
+                m_fragments.insert(fragment);
+            } catch (...) {
+                return ErrorCode::CriticalResource;
+            }
+
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief  adds a part of a diagram
+         *
+         * The entries of the batch are sorted and merged into the model in one pass, rather than
+         * inserted one by one; only the rows, activations and fragments later than the earliest
+         * new one move, once each. Batches that continue the diagram thus cost about their own
+         * size.
+         *
+         * \param  [in] batch lifelines, messages, activations and fragments to add
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::InvalidParameter*
+         *         if an entry refers to a lifeline that does not exist; nothing has been added then
+         * \throw  std::bad_alloc
+         */
+        ErrorCode append(SequenceBatch const &batch) {
+            size_t const lifelines = m_lifelines.size() + batch.lifelines.size();
+            for (SequenceMessage const &message : batch.messages)
+                if (message.from >= lifelines || message.to >= lifelines)
+                    return ErrorCode::InvalidParameter;
+            for (SequenceActivation const &activation : batch.activations)
+                if (activation.lifeline >= lifelines)
+                    return ErrorCode::InvalidParameter;
+            for (SequenceFragment const &fragment : batch.fragments)
+                if (fragment.last >= lifelines || fragment.first > fragment.last)
+                    return ErrorCode::InvalidParameter;
+
+            SZSDK_MEMORY_SCOPE("model");
+
+            m_lifelines.insert(m_lifelines.end(), batch.lifelines.begin(), batch.lifelines.end());
+            merge(batch.messages);
+
+            std::vector<SequenceActivation> activations(batch.activations);
+            for (SequenceActivation &activation : activations)
+                activation.end = std::max(activation.end, activation.begin);
+            m_activations.insert(std::move(activations));
+
+            std::vector<SequenceFragment> fragments(batch.fragments);
+            for (SequenceFragment &fragment : fragments)
+                fragment.end = std::max(fragment.end, fragment.begin);
+            m_fragments.insert(std::move(fragments));
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief reserves memory for *n* messages
+         *
+         * \param [in] n number of messages
+         */
+        void reserve(size_t const n) {
+            SZSDK_MEMORY_SCOPE("model");
+
+            m_times.reserve(n);
+            m_from.reserve(n);
+            m_to.reserve(n);
+            m_kinds.reserve(n);
+            m_labels.reserve(n);
+        }
+
+        /**
+         * \brief removes all lifelines, messages, activations and fragments and returns their memory to the heap
+         */
+        void clear() noexcept {
+            m_lifelines   = {};
+            m_times       = {};
+            m_from        = {};
+            m_to          = {};
+            m_kinds       = {};
+            m_labels      = {};
+            m_activations.clear();
+            m_fragments.clear();
+        }
+
+        /**
+         * \brief  retrieves the number of messages
+         *
+         * \return number of messages; rows range from 0 to *size() - 1*
+         */
+        uint32_t size() const noexcept { return static_cast<uint32_t>(m_times.size()); }
+
+        double const      *times() const noexcept  { return m_times.data(); }
+        uint32_t const    *from() const noexcept   { return m_from.data(); }
+        uint32_t const    *to() const noexcept     { return m_to.data(); }
+        MessageKind const *kinds() const noexcept  { return m_kinds.data(); }
+        StringId const    *labels() const noexcept { return m_labels.data(); }
+
+        /**
+         * \brief  finds the first row at or after a time
+         *
+         * \param  [in] time time to look for
+         *
+         * \return row of the first message sent at or after *time*; *size()* if there is none
+         */
+        uint32_t rowAt(double const time) const noexcept {
+            return static_cast<uint32_t>(std::lower_bound(m_times.begin(), m_times.end(), time) - m_times.begin());
+        }
+
+        uint32_t activationCount() const noexcept { return static_cast<uint32_t>(m_activations.size()); }
+        uint32_t fragmentCount() const noexcept   { return static_cast<uint32_t>(m_fragments.size()); }
+
+        /**
+         * \brief visits all activations overlapping a window of time
+         *
+         * \param [in] begin start of the window
+         * \param [in] end end of the window
+         * \param [in] fn called with every *SequenceActivation* that starts at or before *end* and
+         *             ends at or after *begin*, in order of start
+         */
+        template<class Fn> void activations(double const begin, double const end, Fn &&fn) const {
+            m_activations.visit(begin, end, std::forward<Fn>(fn));
+        }
+
+        /**
+         * \brief visits all combined fragments overlapping a window of time
+         *
+         * \param [in] begin start of the window
+         * \param [in] end end of the window
+         * \param [in] fn called with every *SequenceFragment* that starts at or before *end* and
+         *             ends at or after *begin*, in order of start
+         */
+        template<class Fn> void fragments(double const begin, double const end, Fn &&fn) const {
+            m_fragments.visit(begin, end, std::forward<Fn>(fn));
+        }
+
+    private:
+        /**
+         * \brief merges messages into the rows, each after all rows of the same or an earlier time
+         *
+         * \param [in] messages messages, in any order; equal times keep their order
+         * \throw std::bad_alloc
+         */
+        void merge(std::vector<SequenceMessage> const &messages) {
+            if (messages.empty())
+                return;
+
+            std::vector<uint32_t> order(messages.size());
+            for (uint32_t i = 0; i < order.size(); ++i)
+                order[i] = i;
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t const a, uint32_t const b) { return messages[a].time < messages[b].time; });
+
+            /* Merging from the back moves every later row once, into space that is already allocated. */
+            size_t i = m_times.size();
+            size_t j = messages.size();
+            resize(i + j);
+            for (size_t k = m_times.size(); j > 0; --k) {
+                if (i > 0 && m_times[i - 1] > messages[order[j - 1]].time) {
+                    --i;
+
+                    m_times[k - 1]  = m_times[i];
+                    m_from[k - 1]   = m_from[i];
+                    m_to[k - 1]     = m_to[i];
+                    m_kinds[k - 1]  = m_kinds[i];
+                    m_labels[k - 1] = m_labels[i];
+                } else {
+                    SequenceMessage const &message = messages[order[--j]];
+
+                    m_times[k - 1]  = message.time;
+                    m_from[k - 1]   = message.from;
+                    m_to[k - 1]     = message.to;
+                    m_kinds[k - 1]  = message.kind;
+                    m_labels[k - 1] = message.label;
+                }
+            }
+        }
+
+        /**
+         * \brief resizes the rows; new rows are uninitialized messages
+         *
+         * \param [in] n number of rows
+         * \throw std::bad_alloc
+         */
+        void resize(size_t const n) {
+            reserve(n);
+
+            m_times.resize(n);
+            m_from.resize(n);
+            m_to.resize(n);
+            m_kinds.resize(n);
+            m_labels.resize(n);
+        }
+    };
+}
+
+
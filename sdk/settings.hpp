@@ -0,0 +1,154 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  settings.hpp
+ * \brief typed, validated views of configuration documents
+ *
+ * A settings structure is generated from a settings list, i.e. a function-like macro that invokes
+ * its argument once per setting in the form *X(type, member, key, default)*:
+ *
+ *     #define MY_SETTINGS(X)                               \
+ *         X(std::string, logfile, "/logfile",   "")        \
+ *         X(bool,        async,   "/log/async", false)
+ *
+ *     SZSDK_DEFINE_SETTINGS(MySettings, MY_SETTINGS);
+ *
+ * The list acts as the schema of the document. *load()* validates all values against it once
+ * and stores them in plain data members; reading a setting afterwards is a member access.
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/config.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \struct suzu::sdk::SettingInfo
+     * \brief  compile-time description of a single setting
+     */
+    struct SettingInfo {
+        std::string_view key;  /**< JSON pointer of the setting */
+        std::string_view name; /**< name of the data member */
+        std::string_view type; /**< spelling of the member type */
+    };
+
+
+    namespace internal {
+        /**
+         * \brief  checks whether *val* can be stored in a setting of type *TargetVal*
+         *
+         * Matches the conversion rules of *suzu::sdk::JSONValueConverter::to()*.
+         *
+         * \param  [in] val raw JSON value
+         *
+         * \return *true* if the value has the right type
+         */
+        template<class TargetVal> bool MatchesSettingType(JSON const &val) noexcept {
+            if constexpr (std::is_enum_v<TargetVal>)
+                return MatchesSettingType<std::underlying_type_t<TargetVal>>(val);
+            else if constexpr (std::is_same_v<TargetVal, bool>)
+                return val.is_boolean();
+            else if constexpr (std::is_integral_v<TargetVal> && std::is_unsigned_v<TargetVal>)
+                return val.is_number_unsigned() || (val.is_number_integer() && val.template get<int64_t>() >= 0);
+            else if constexpr (std::is_integral_v<TargetVal>)
+                return val.is_number_integer();
+            else if constexpr (std::is_floating_point_v<TargetVal>)
+                return val.is_number_float();
+            else if constexpr (std::is_same_v<TargetVal, std::string>)
+                return val.is_string();
+            else
+                return TargetVal::not_implemented_handler;
+        }
+
+        /**
+         * \brief  reads a single setting from *snap*
+         *
+         * Missing values keep their current (default) value. Values of the wrong type are
+         * reported and keep their current value as well.
+         *
+         * \param  [in] snap configuration snapshot to read from
+         * \param  [in] path JSON pointer of the setting
+         * \param  [in,out] dest data member of the setting
+         * \param  [out] errors (optional) receives a message per invalid value
+         *
+         * \return *true* if the value is missing or valid
+         */
+        template<class TargetVal> bool LoadSetting(ConfigSnapshot const &snap, char const *const path, TargetVal &dest, std::vector<std::string> *errors) {
+            JSON const *val = snap.find(ConfigKey{ path });
+            if (val == nullptr)
+                return true;
+
+            if (!MatchesSettingType<TargetVal>(*val)) {
+                if (errors != nullptr)
+                    errors->push_back(std::string{ path } + ": unexpected value " + val->dump());
+
+                return false;
+            }
+
+            dest = JSONCVT::to(*val, std::move(dest));
+            return true;
+        }
+    }
+}
+
+
+/**
+ * \ingroup  Macros
+ * \brief    helpers expanding a single entry of a settings list
+ */
+#define SZSDK_SETTING_MEMBER(type, name, key, def) type name = def;
+#define SZSDK_SETTING_INFO(type, name, key, def)   suzu::sdk::SettingInfo{ key, #name, #type },
+#define SZSDK_SETTING_LOAD(type, name, key, def)   ok = suzu::sdk::internal::LoadSetting(snap, key, next.name, errors) && ok;
+
+/**
+ * \ingroup  Macros
+ * \brief    defines a settings structure from a settings list
+ *
+ * The structure has one data member per setting, initialized to its default value, a constexpr
+ * table *gl_settings* describing all settings, and a *load()* function which validates a
+ * configuration snapshot and populates the members.
+ *
+ * \param    [in] sname name of the structure
+ * \param    [in] list settings list macro
+ */
+#define SZSDK_DEFINE_SETTINGS(sname, list)                                                                      \
+    struct sname {                                                                                              \
+        list(SZSDK_SETTING_MEMBER)                                                                              \
+                                                                                                                \
+        static constexpr suzu::sdk::SettingInfo gl_settings[] = { list(SZSDK_SETTING_INFO) };                   \
+                                                                                                                \
+        /* Loads all settings from *snap*; invalid values are replaced by their defaults. */                    \
+        bool load(suzu::sdk::ConfigSnapshot const &snap, std::vector<std::string> *errors = nullptr) noexcept { \
+            if (!snap.isValid())                                                                                \
+                return false;                                                                                   \
+                                                                                                                \
+            try {                                                                                               \
+                sname next;                                                                                     \
+                bool  ok = true;                                                                                \
+                list(SZSDK_SETTING_LOAD)                                                                        \
+                                                                                                                \
+                *this = std::move(next);                                                                        \
+                return ok;                                                                                      \
+            } catch (...) { }                                                                                   \
+                                                                                                                \
+            return false;                                                                                       \
+        }                                                                                                       \
+    }
+
+
@@ -0,0 +1,772 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  sinks.hpp
+ * \brief custom log sinks provided by the SDK
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined _WIN32
+    #include <sdk/external/spdlog/details/windows_include.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+/* external includes */
+#include <sdk/external/spdlog/details/file_helper.h>
+#include <sdk/external/spdlog/sinks/base_sink.h>
+#include <sdk/external/spdlog/sinks/rotating_file_sink.h>
+#include <sdk/external/spdlog/sinks/sink.h>
+
+/* sdk includes */
+#include <sdk/compress.hpp>
+#include <sdk/error.hpp>
+
+
+/**
+ * \namespace suzu::sdk::sinks
+ * \brief     log sinks that can be attached to the loggers of an instance
+ */
+namespace suzu::sdk::sinks {
+    /**
+     * \class suzu::sdk::sinks::RingBufferSink
+     * \brief lock-free in-memory sink keeping the last *N* messages
+     *
+     * Messages are stored unformatted in a fixed number of pre-allocated slots; logging a message
+     * never allocates, never blocks, and never touches the file system. The buffer is only written
+     * to disk when *dump()* is called, either on demand or by the crash handler installed through
+     * *InstallCrashHandler()*. This makes it possible to record trace-level messages in production
+     * at practically no cost.
+     *
+     * \note  Messages longer than *gl_maxpayload* bytes are truncated. If two threads contend for the
+     *        same slot, the later message is dropped rather than waiting.
+     */
+    class RingBufferSink final : public spdlog::sinks::sink {
+    public:
+        static constexpr size_t gl_maxname    = 31;  /**< maximum stored length of logger names */
+        static constexpr size_t gl_maxpayload = 223; /**< maximum stored length of messages */
+
+#if defined _WIN32
+        using FileHandle = HANDLE; /**< handle of a file opened for dumping */
+#else
+        using FileHandle = int;    /**< descriptor of a file opened for dumping */
+#endif
+
+    private:
+        /**
+         * \struct suzu::sdk::sinks::RingBufferSink::Slot
+         * \brief  storage of a single message
+         *
+         * *seq* acts as a sequence lock: it is odd while the slot is being written, and *2 * (ticket + 1)*
+         * once the message with the given ticket has been stored completely.
+         */
+        struct Slot {
+            std::atomic<uint64_t>     seq;                        /**< sequence lock */
+            int64_t                   time;                       /**< timestamp, in milliseconds since the epoch */
+            size_t                    thread;                     /**< id of the logging thread */
+            spdlog::level::level_enum lvl;                        /**< message level */
+            char                      name[gl_maxname + 1];       /**< null-terminated logger name */
+            char                      payload[gl_maxpayload + 1]; /**< null-terminated message */
+        };
+
+        std::unique_ptr<Slot[]> m_slots; /**< message slots */
+        size_t                  m_cap;   /**< number of slots */
+        std::atomic<uint64_t>   m_next;  /**< ticket of the next message */
+
+    public:
+        /**
+         * \brief constructs a new ring buffer sink
+         *
+         * \param [in] capacity number of messages to keep; at least one
+         */
+        explicit RingBufferSink(size_t const capacity)
+            : m_slots(std::make_unique<Slot[]>(capacity == 0 ? 1 : capacity)), m_cap(capacity == 0 ? 1 : capacity), m_next(0)
+        {
+            for (size_t i = 0; i < m_cap; ++i)
+                m_slots[i].seq.store(0, std::memory_order_relaxed);
+        }
+
+
+        void log(spdlog::details::log_msg const &msg) override {
+            uint64_t const ticket = m_next.fetch_add(1, std::memory_order_relaxed);
+            Slot          &slot   = m_slots[ticket % m_cap];
+
+            /* Acquire the slot; drop the message if another writer currently owns it. */
+            uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+            if ((seq & 1) != 0 || !slot.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire))
+                return;
+
+            slot.time   = std::chrono::duration_cast<std::chrono::milliseconds>(msg.time.time_since_epoch()).count();
+            slot.thread = msg.thread_id;
+            slot.lvl    = msg.level;
+            Copy(slot.name, gl_maxname, msg.logger_name.data(), msg.logger_name.size());
+            Copy(slot.payload, gl_maxpayload, msg.payload.data(), msg.payload.size());
+
+            slot.seq.store(2 * (ticket + 1), std::memory_order_release);
+        }
+
+        /* Messages are formatted when dumped; flushing and formatting of the sink are therefore no-ops. */
+        void flush() override { }
+        void set_pattern(std::string const &) override { }
+        void set_formatter(std::unique_ptr<spdlog::formatter>) override { }
+
+
+        /**
+         * \brief  writes all messages currently held by the buffer to *path*, oldest first
+         *
+         * \param  [in] path file path of the dump file; overwritten if it exists
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success
+         * \note   Messages that are being written while the dump is in progress are skipped.
+         */
+        ErrorCode dump(char const *const path) const noexcept {
+            if (path == nullptr)
+                return ErrorCode::InvalidParameter;
+
+            FileHandle const file = Open(path);
+            if (file == gl_nofile)
+                return ErrorCode::OpenFile;
+
+            bool const ok = dump(file);
+            return Close(file) && ok ? ErrorCode::Ok : ErrorCode::WriteFile;
+        }
+
+        /**
+         * \brief  replaces the contents of an open file by all messages currently held by the
+         *         buffer, oldest first
+         *
+         * Messages are formatted in stack memory and written with *write()* (*WriteFile()* on
+         * Windows), so that the function can also be used from within crash handlers.
+         *
+         * \param  [in] file file opened for writing
+         *
+         * \return *true* on success
+         * \note   Messages that are being written while the dump is in progress are skipped.
+         */
+        bool dump(FileHandle const file) const noexcept {
+            if (!Rewind(file))
+                return false;
+
+            bool           ok    = true;
+            uint64_t const end   = m_next.load(std::memory_order_acquire);
+            uint64_t const begin = end > m_cap ? end - m_cap : 0;
+            for (uint64_t ticket = begin; ticket < end && ok; ++ticket) {
+                Slot const &slot = m_slots[ticket % m_cap];
+
+                /* Read the slot under the sequence lock; skip it if it changes in the meantime. */
+                uint64_t const seq = slot.seq.load(std::memory_order_acquire);
+                if (seq != 2 * (ticket + 1))
+                    continue;
+
+                int64_t const             time   = slot.time;
+                size_t const              thread = slot.thread;
+                spdlog::level::level_enum lvl    = slot.lvl;
+                char name[gl_maxname + 1], payload[gl_maxpayload + 1];
+                std::memcpy(name, slot.name, sizeof name);
+                std::memcpy(payload, slot.payload, sizeof payload);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.seq.load(std::memory_order_relaxed) != seq)
+                    continue;
+
+                /* "[<seconds>.<milliseconds>] [<thread>] <logger>::<level>: <message>" */
+                char                   line[gl_maxname + gl_maxpayload + 64];
+                size_t                 len     = 0;
+                uint64_t const         ms      = time < 0 ? 0 : static_cast<uint64_t>(time);
+                spdlog::string_view_t  lvlname = spdlog::level::to_string_view(lvl);
+                Append(line, len, "[", 1);
+                AppendNumber(line, len, ms / 1000, 1);
+                Append(line, len, ".", 1);
+                AppendNumber(line, len, ms % 1000, 3);
+                Append(line, len, "] [", 3);
+                AppendNumber(line, len, thread, 1);
+                Append(line, len, "] ", 2);
+                Append(line, len, name, std::strlen(name));
+                Append(line, len, "::", 2);
+                Append(line, len, lvlname.data(), lvlname.size());
+                Append(line, len, ": ", 2);
+                Append(line, len, payload, std::strlen(payload));
+                Append(line, len, "\n", 1);
+
+                ok = Write(file, line, len);
+            }
+
+            return Finish(file) && ok;
+        }
+
+        /**
+         * \brief  installs handlers that dump this buffer to *path* if the application crashes
+         *
+         * The dump is written on abnormal termination (*std::terminate()*) and on fatal signals
+         * (SIGSEGV, SIGILL, SIGFPE, SIGABRT). Afterwards, the default behavior is restored and the
+         * signal is raised again. The dump file is opened right away, creating it empty if it does
+         * not exist, so that the handlers only have to write to it.
+         *
+         * \param  [in] sink sink to dump; kept alive until the end of the program
+         * \param  [in] path file path of the dump file
+         *
+         * \return *true* if the handlers could be installed
+         * \note   Only one sink per module can be registered for dumping; later calls replace
+         *         earlier registrations.
+         */
+        static bool InstallCrashHandler(std::shared_ptr<RingBufferSink> sink, char const *const path) noexcept {
+            if (sink == nullptr || path == nullptr || *path == '\0')
+                return false;
+
+            FileHandle const file = OpenForCrash(path);
+            if (file == gl_nofile)
+                return false;
+
+            CrashState &state = CrashState::Instance();
+            if (state.file != gl_nofile)
+                Close(state.file);
+            state.file = file;
+            state.sink = std::move(sink);
+
+            std::set_terminate([]() {
+                DumpOnCrash();
+
+                std::abort();
+            });
+            for (int const sig : { SIGSEGV, SIGILL, SIGFPE, SIGABRT })
+                std::signal(sig, [](int const signum) {
+                    DumpOnCrash();
+
+                    std::signal(signum, SIG_DFL);
+                    std::raise(signum);
+                });
+
+            return true;
+        }
+
+    private:
+        /**
+         * \struct suzu::sdk::sinks::RingBufferSink::CrashState
+         * \brief  sink and destination registered for dumping on crashes
+         */
+        struct CrashState {
+            std::shared_ptr<RingBufferSink> sink;    /**< sink to dump */
+            FileHandle                      file;    /**< dump file, opened ahead of time */
+            std::atomic<bool>               dumped;  /**< whether or not the dump was written already */
+
+            static CrashState &Instance() noexcept {
+                static CrashState gl_state{ nullptr, gl_nofile, false };
+
+                return gl_state;
+            }
+        };
+
+#if defined _WIN32
+        static inline FileHandle const gl_nofile = INVALID_HANDLE_VALUE; /**< handle of no file */
+#else
+        static constexpr FileHandle    gl_nofile = -1;                   /**< descriptor of no file */
+#endif
+
+        /**
+         * \brief dumps the registered sink exactly once
+         */
+        static void DumpOnCrash() noexcept {
+            CrashState &state = CrashState::Instance();
+            if (state.sink == nullptr || state.file == gl_nofile || state.dumped.exchange(true))
+                return;
+
+            state.sink->dump(state.file);
+        }
+
+        /**
+         * \brief  opens a dump file for writing, truncating it
+         *
+         * \param  [in] path file path of the dump file
+         *
+         * \return handle of the file, or *gl_nofile* on failure
+         */
+        static FileHandle Open(char const *const path) noexcept {
+#if defined _WIN32
+            return ::CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+            return ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+        }
+
+        /**
+         * \brief  opens the dump file of the crash handlers, keeping the dump of an earlier crash
+         *
+         * \param  [in] path file path of the dump file
+         *
+         * \return handle of the file, or *gl_nofile* on failure
+         */
+        static FileHandle OpenForCrash(char const *const path) noexcept {
+#if defined _WIN32
+            return ::CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+            return ::open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+#endif
+        }
+
+        /**
+         * \brief  closes a dump file
+         *
+         * \param  [in] file file to close
+         *
+         * \return *true* on success
+         */
+        static bool Close(FileHandle const file) noexcept {
+#if defined _WIN32
+            return ::CloseHandle(file) != 0;
+#else
+            return ::close(file) == 0;
+#endif
+        }
+
+        /**
+         * \brief  moves to the beginning of a dump file
+         *
+         * \param  [in] file file to rewind
+         *
+         * \return *true* on success
+         */
+        static bool Rewind(FileHandle const file) noexcept {
+#if defined _WIN32
+            return ::SetFilePointer(file, 0, nullptr, FILE_BEGIN) != INVALID_SET_FILE_POINTER;
+#else
+            return ::lseek(file, 0, SEEK_SET) == 0;
+#endif
+        }
+
+        /**
+         * \brief  cuts a dump file off at the current position and flushes it to the storage device
+         *
+         * \param  [in] file file to finish
+         *
+         * \return *true* on success
+         */
+        static bool Finish(FileHandle const file) noexcept {
+#if defined _WIN32
+            return ::SetEndOfFile(file) != 0 && ::FlushFileBuffers(file) != 0;
+#else
+            off_t const end = ::lseek(file, 0, SEEK_CUR);
+
+            return end >= 0 && ::ftruncate(file, end) == 0 && ::fsync(file) == 0;
+#endif
+        }
+
+        /**
+         * \brief  writes *len* bytes of *data* to a dump file
+         *
+         * \param  [in] file file to write to
+         * \param  [in] data bytes to write
+         * \param  [in] len number of bytes to write
+         *
+         * \return *true* if all bytes were written
+         */
+        static bool Write(FileHandle const file, char const *data, size_t len) noexcept {
+            while (len != 0) {
+#if defined _WIN32
+                DWORD written = 0;
+                if (::WriteFile(file, data, static_cast<DWORD>(len), &written, nullptr) == 0)
+                    return false;
+#else
+                ssize_t const written = ::write(file, data, len);
+                if (written < 0 && errno == EINTR)
+                    continue;
+                else if (written <= 0)
+                    return false;
+#endif
+
+                data += written;
+                len  -= static_cast<size_t>(written);
+            }
+
+            return true;
+        }
+
+        /**
+         * \brief appends *len* bytes of *src* to a line buffer, as far as they fit
+         *
+         * \param [in,out] line line buffer of *gl_maxname + gl_maxpayload + 64* bytes
+         * \param [in,out] pos number of bytes used in *line*
+         * \param [in] src bytes to append
+         * \param [in] len number of bytes to append
+         */
+        static void Append(char *const line, size_t &pos, char const *const src, size_t len) noexcept {
+            size_t const cap = gl_maxname + gl_maxpayload + 64;
+
+            len = len < cap - pos ? len : cap - pos;
+            std::memcpy(line + pos, src, len);
+            pos += len;
+        }
+
+        /**
+         * \brief appends the decimal digits of *value* to a line buffer
+         *
+         * \param [in,out] line line buffer; see *Append()*
+         * \param [in,out] pos number of bytes used in *line*
+         * \param [in] value number to append
+         * \param [in] width minimum number of digits; padded with zeros
+         */
+        static void AppendNumber(char *const line, size_t &pos, uint64_t value, unsigned const width) noexcept {
+            char     digits[20];
+            unsigned count = 0;
+            do {
+                digits[sizeof digits - ++count] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while (value != 0 && count < sizeof digits);
+            while (count < width && count < sizeof digits)
+                digits[sizeof digits - ++count] = '0';
+
+            Append(line, pos, digits + sizeof digits - count, count);
+        }
+
+        /**
+         * \brief copies at most *cap* bytes of *src* into *dest* and null-terminates it
+         */
+        static void Copy(char *dest, size_t const cap, char const *src, size_t len) noexcept {
+            len = len < cap ? len : cap;
+
+            std::memcpy(dest, src, len);
+            dest[len] = '\0';
+        }
+    };
+
+
+    /**
+     * \class suzu::sdk::sinks::RotatingFileSink
+     * \brief file sink that starts a new segment once the current one is full, without ever
+     *        blocking the logging thread on the file system
+     *
+     * Segments are named like those of *spdlog::sinks::rotating_file_sink*: *logs/log.txt* is the
+     * current one, *logs/log.1.txt* the one before, and so on, up to *files* old segments. Old
+     * segments are optionally compressed into the LZ4 frame format (see *sdk/compress.hpp*), e.g.
+     * *logs/log.1.txt.lz4*, which the *lz4* command-line tool decompresses. The segment of the
+     * previous session is rotated on construction, so that it is kept instead of overwritten.
+     *
+     * Closing, renaming and compressing segments runs on a thread of the sink. The logging thread
+     * only hands the full segment over; messages logged until the thread has opened the next one
+     * are kept in memory, up to *gl_maxbacklog* bytes, and written first once it is open.
+     *
+     * \note  Messages that do not fit the backlog are dropped; their number is written in their
+     *        place.
+     */
+    class RotatingFileSink final : public spdlog::sinks::base_sink<std::mutex> {
+    public:
+        static constexpr size_t gl_maxbacklog = size_t(4) << 20; /**< largest size of the messages kept while rotating, in bytes */
+        static constexpr size_t gl_frameblock = size_t(4) << 20; /**< size of the blocks of compressed segments, in bytes; the largest LZ4 block size */
+
+    private:
+        using FilePtr = std::unique_ptr<spdlog::details::file_helper>;
+
+        std::string             m_path;     /**< path of the current segment */
+        size_t                  m_maxsize;  /**< size from which a segment is rotated, in bytes */
+        uint32_t                m_maxfiles; /**< number of old segments kept */
+        bool                    m_compress; /**< whether or not old segments are compressed */
+        FilePtr                 m_file;     /**< current segment; *nullptr* while rotating */
+        size_t                  m_size;     /**< size of the current segment, in bytes */
+        std::string             m_backlog;  /**< messages logged while rotating */
+        size_t                  m_dropped;  /**< number of messages dropped while rotating */
+        std::mutex              m_lock;     /**< guards *m_retired* and *m_stop* */
+        std::condition_variable m_wake;     /**< wakes the rotating thread */
+        FilePtr                 m_retired;  /**< full segment handed over to the rotating thread */
+        bool                    m_stop;     /**< whether or not the rotating thread shall exit */
+        std::thread             m_worker;   /**< rotating thread */
+
+    public:
+        /**
+         * \brief constructs a new sink and rotates the segment of the previous session, if any
+         *
+         * \param [in] path path of the current segment
+         * \param [in] maxsize size from which a segment is rotated, in bytes; at least 1
+         * \param [in] maxfiles number of old segments to keep
+         * \param [in] compress whether or not to compress old segments
+         * \throw spdlog::spdlog_ex if the segment cannot be opened
+         * \throw std::system_error if the thread cannot be started
+         */
+        RotatingFileSink(std::string path, size_t const maxsize, uint32_t const maxfiles, bool const compress)
+            : m_path(std::move(path)), m_maxsize(maxsize == 0 ? 1 : maxsize), m_maxfiles(maxfiles), m_compress(compress),
+              m_file(std::make_unique<spdlog::details::file_helper>()), m_size(0), m_dropped(0), m_stop(false)
+        {
+            m_file->open(m_path, false);
+            m_size = m_file->size();
+
+            m_worker = std::thread([this]() { run(); });
+            if (m_size != 0)
+                retire();
+        }
+
+        /**
+         * \brief finishes a pending rotation and stops the rotating thread
+         */
+        ~RotatingFileSink() {
+            {
+                std::lock_guard<std::mutex> const lock(m_lock);
+
+                m_stop = true;
+            }
+            m_wake.notify_one();
+            m_worker.join();
+
+            /* The messages of the last rotation were not written if no message followed it. */
+            std::lock_guard<std::mutex> const lock(mutex_);
+            try {
+                if (m_file != nullptr)
+                    resume();
+            } catch (...) { }
+        }
+
+    protected:
+        void sink_it_(spdlog::details::log_msg const &msg) override {
+            spdlog::memory_buf_t formatted;
+            formatter_->format(msg, formatted);
+
+            if (m_file == nullptr) {
+                if (m_backlog.size() + formatted.size() <= gl_maxbacklog)
+                    m_backlog.append(formatted.data(), formatted.size());
+                else
+                    ++m_dropped;
+
+                return;
+            }
+
+            resume();
+            m_file->write(formatted);
+            m_size += formatted.size();
+            if (m_size >= m_maxsize)
+                retire();
+        }
+
+        void flush_() override {
+            if (m_file != nullptr)
+                m_file->flush();
+        }
+
+    private:
+        /**
+         * \brief writes the messages logged while rotating to the current segment
+         *
+         * \note  The caller must hold *mutex_*.
+         */
+        void resume() {
+            if (m_dropped != 0) {
+                std::string const note = "[" + std::to_string(m_dropped) + " message(s) dropped while rotating " + m_path + "]\n";
+
+                m_backlog.append(note);
+                m_dropped = 0;
+            }
+            if (m_backlog.empty())
+                return;
+
+            spdlog::memory_buf_t buffer;
+            buffer.append(m_backlog.data(), m_backlog.data() + m_backlog.size());
+            m_file->write(buffer);
+            m_size += m_backlog.size();
+
+            m_backlog.clear();
+            m_backlog.shrink_to_fit();
+        }
+
+        /**
+         * \brief hands the current segment over to the rotating thread
+         *
+         * \note  The caller must hold *mutex_*, except during construction.
+         */
+        void retire() {
+            {
+                std::lock_guard<std::mutex> const lock(m_lock);
+
+                m_retired = std::move(m_file);
+            }
+            m_wake.notify_one();
+        }
+
+        /**
+         * \brief rotates every segment handed over until the sink is destroyed
+         */
+        void run() noexcept {
+            for (;;) {
+                FilePtr retired;
+                {
+                    std::unique_lock<std::mutex> lock(m_lock);
+
+                    m_wake.wait(lock, [this]() { return m_stop || m_retired != nullptr; });
+                    if (m_retired == nullptr)
+                        return;
+                    retired = std::move(m_retired);
+                }
+
+                rotate(std::move(retired));
+            }
+        }
+
+        /**
+         * \brief closes a full segment, opens the next one and moves the old segments along
+         *
+         * \param [in] retired full segment
+         */
+        void rotate(FilePtr retired) noexcept {
+            std::string const pending = m_path + ".rotating";
+            std::error_code   err;
+
+            /* If the segment cannot be moved away, logging continues in it rather than losing it. */
+            retired->close();
+            std::filesystem::rename(m_path, pending, err);
+            bool const moved = !err;
+
+            FilePtr fresh;
+            try {
+                fresh = std::make_unique<spdlog::details::file_helper>();
+                fresh->open(m_path, false);
+            } catch (...) {
+                fresh = nullptr;
+            }
+            {
+                std::lock_guard<std::mutex> const lock(mutex_);
+
+                m_file = std::move(fresh);
+                m_size = moved || m_file == nullptr ? 0 : m_file->size();
+                if (m_file == nullptr) {
+                    m_backlog.clear();
+                    m_dropped = 0;
+                }
+            }
+            if (!moved)
+                return;
+
+            /* Only now, after logging has resumed, are the old segments moved along. */
+            for (uint32_t i = m_maxfiles; i > 0; --i)
+                for (std::string const &suffix : { std::string(), std::string(".lz4") }) {
+                    std::string const from = SegmentOf(i) + suffix;
+                    if (i == m_maxfiles)
+                        std::filesystem::remove(from, err);
+                    else if (std::filesystem::exists(from, err))
+                        std::filesystem::rename(from, SegmentOf(i + 1) + suffix, err);
+                }
+
+            if (m_maxfiles == 0)
+                std::filesystem::remove(pending, err);
+            else if (!m_compress || !Compress(pending, SegmentOf(1) + ".lz4"))
+                std::filesystem::rename(pending, SegmentOf(1), err);
+            else
+                std::filesystem::remove(pending, err);
+        }
+
+        /**
+         * \brief  computes the path of an old segment
+         *
+         * \param  [in] index number of the segment; 1 for the newest
+         *
+         * \return path, e.g. *logs/log.1.txt*
+         */
+        std::string SegmentOf(uint32_t const index) const {
+            return spdlog::sinks::rotating_file_sink_mt::calc_filename(m_path, index);
+        }
+
+        /**
+         * \brief  computes the checksum of an LZ4 frame descriptor, i.e. the second byte of its
+         *         XXH32 hash
+         *
+         * \param  [in] data bytes of the descriptor
+         * \param  [in] size number of bytes; less than 16
+         *
+         * \return checksum byte
+         */
+        static uint8_t DescriptorChecksum(uint8_t const *const data, size_t const size) noexcept {
+            constexpr uint32_t gl_prime1 = 2654435761u;
+            constexpr uint32_t gl_prime2 = 2246822519u;
+            constexpr uint32_t gl_prime3 = 3266489917u;
+            constexpr uint32_t gl_prime5 = 374761393u;
+
+            auto const rotl = [](uint32_t const x, int const r) { return (x << r) | (x >> (32 - r)); };
+
+            /* XXH32 with seed 0; inputs shorter than 16 bytes skip the striped rounds, and the descriptor has no 4-byte words. */
+            uint32_t hash = gl_prime5 + static_cast<uint32_t>(size);
+            for (size_t i = 0; i < size; ++i)
+                hash = rotl(hash + data[i] * gl_prime5, 11) * gl_prime1;
+            hash ^= hash >> 15;
+            hash *= gl_prime2;
+            hash ^= hash >> 13;
+            hash *= gl_prime3;
+            hash ^= hash >> 16;
+
+            return static_cast<uint8_t>(hash >> 8);
+        }
+
+        /**
+         * \brief  compresses a file into an LZ4 frame of independent blocks
+         *
+         * \param  [in] from path of the file to compress
+         * \param  [in] to path of the compressed file; written through a temporary file
+         *
+         * \return *true* on success; *to* does not exist otherwise
+         */
+        static bool Compress(std::string const &from, std::string const &to) noexcept {
+            std::string const temp = to + ".tmp";
+            std::FILE *const  in   = std::fopen(from.c_str(), "rb");
+            std::FILE *const  out  = in != nullptr ? std::fopen(temp.c_str(), "wb") : nullptr;
+
+            bool ok = out != nullptr;
+            try {
+                /* Magic number, then version 1 with independent blocks and 4 MiB blocks, and no checksums. */
+                uint8_t header[7] = { 0x04, 0x22, 0x4D, 0x18, 0x60, 0x70, 0 };
+                header[6] = DescriptorChecksum(header + 4, 2);
+                ok = ok && std::fwrite(header, 1, sizeof header, out) == sizeof header;
+
+                std::vector<char> block(gl_frameblock), packed;
+                for (size_t count; ok && (count = std::fread(block.data(), 1, block.size(), in)) != 0; ) {
+                    packed.clear();
+                    CompressBlock(block.data(), count, Compression::Fast, packed);
+
+                    /* Blocks that do not shrink are stored as they are, marked by the highest bit of their size. */
+                    bool const raw  = packed.size() >= count;
+                    uint32_t   size = raw ? static_cast<uint32_t>(count) | 0x80000000u : static_cast<uint32_t>(packed.size());
+
+                    uint8_t const prefix[4] = { static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(size >> 16), static_cast<uint8_t>(size >> 24) };
+                    ok = std::fwrite(prefix, 1, 4, out) == 4 && std::fwrite(raw ? block.data() : packed.data(), 1, raw ? count : packed.size(), out) == (raw ? count : packed.size());
+                }
+
+                uint8_t const end[4] = { 0, 0, 0, 0 };
+                ok = ok && std::ferror(in) == 0 && std::fwrite(end, 1, 4, out) == 4;
+            } catch (...) {
+                ok = false;
+            }
+
+            if (in != nullptr)
+                std::fclose(in);
+            if (out != nullptr)
+                ok = std::fclose(out) == 0 && ok;
+
+            std::error_code err;
+            if (ok)
+                std::filesystem::rename(temp, to, err);
+            if (!ok || err)
+                std::filesystem::remove(temp, err);
+            return ok && !err;
+        }
+    };
+}
+
+
@@ -0,0 +1,360 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  spatial.hpp
+ * \brief spatial index over axis-aligned bounding boxes
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+
+namespace suzu::sdk {
+    /**
+     * \struct suzu::sdk::ElementRect
+     * \brief  axis-aligned bounding box of an element, in scene coordinates
+     */
+    struct ElementRect {
+        float x; /**< left edge */
+        float y; /**< top edge */
+        float w; /**< width */
+        float h; /**< height */
+
+        bool contains(float const px, float const py) const noexcept {
+            return px >= x && py >= y && px < x + w && py < y + h;
+        }
+        bool intersects(ElementRect const &other) const noexcept {
+            return x < other.x + other.w && other.x < x + w && y < other.y + other.h && other.y < y + h;
+        }
+    };
+
+
+    /**
+     * \class suzu::sdk::SpatialIndex
+     * \brief loose quadtree over the bounding boxes of objects identified by handles
+     *
+     * The tree is stored as one hash grid per level; cells double in size from one level to the
+     * next. An object is stored in the cell containing its center, on the lowest level whose cells
+     * are at least as large as the object. Since cells are *loose*, i.e. their objects may extend
+     * up to half a cell beyond them, the level and cell of an object only depend on its own
+     * bounds: inserting, removing and moving objects take constant time, and the tree never needs
+     * rebalancing. A query visits a bounded number of cells per level.
+     *
+     * Hash grids impose no bounds on the scene; objects too large for the topmost level are kept
+     * in a separate list that every query scans.
+     *
+     * \tparam H handle type, see *suzu::sdk::Handle*; handle indices key the index
+     * \note   The index is not thread-safe.
+     */
+    template<class H> class SpatialIndex {
+        static constexpr float    gl_mincell = 32.0f;      /**< cell size on the lowest level */
+        static constexpr uint32_t gl_nlevels = 16;         /**< number of levels */
+        static constexpr uint32_t gl_huge    = gl_nlevels; /**< pseudo-level of objects too large for any level */
+        static constexpr uint32_t gl_absent  = UINT32_MAX; /**< level of objects not in the index */
+
+        /**
+         * \struct suzu::sdk::SpatialIndex::Entry
+         * \brief  object stored in a cell
+         */
+        struct Entry {
+            H           handle; /**< handle of the object */
+            ElementRect bounds; /**< bounding box of the object */
+        };
+
+        /**
+         * \struct suzu::sdk::SpatialIndex::Location
+         * \brief  position of an object inside the index
+         */
+        struct Location {
+            uint32_t level; /**< level, *gl_huge*, or *gl_absent* */
+            uint32_t pos;   /**< position in the cell's entry list */
+            uint64_t cell;  /**< key of the cell */
+        };
+
+        using Grid = std::unordered_map<uint64_t, std::vector<Entry>>;
+
+        std::array<Grid, gl_nlevels> m_levels; /**< cells of every level */
+        std::vector<Entry>           m_huge;   /**< objects too large for any level */
+        std::vector<Location>        m_where;  /**< location of every object, by handle index */
+        size_t                       m_size;   /**< number of objects */
+
+    public:
+        SpatialIndex() noexcept
+            : m_size(0)
+        { }
+
+        /**
+         * \brief  retrieves the number of objects in the index
+         *
+         * \return number of objects
+         */
+        size_t size() const noexcept { return m_size; }
+
+        /**
+         * \brief reserves memory for objects with handle indices less than *n*
+         *
+         * \param [in] n number of objects
+         */
+        void reserve(size_t const n) { m_where.reserve(n); }
+
+        /**
+         * \brief adds an object to the index
+         *
+         * \param [in] handle handle of the object; must not be in the index yet
+         * \param [in] bounds bounding box of the object
+         */
+        void insert(H const handle, ElementRect const &bounds) {
+            size_t const idx = static_cast<size_t>(handle.index());
+            if (idx >= m_where.size())
+                m_where.resize(idx + 1, { gl_absent, 0, 0 });
+
+            uint32_t const level = LevelOf(bounds);
+            uint64_t const cell  = level == gl_huge ? 0 : CellOf(bounds, level);
+
+            std::vector<Entry> &entries = level == gl_huge ? m_huge : m_levels[level][cell];
+            entries.push_back({ handle, bounds });
+
+            m_where[idx] = { level, static_cast<uint32_t>(entries.size() - 1), cell };
+            ++m_size;
+        }
+
+        /**
+         * \brief adds many objects at once, e.g. after creating a batch of elements
+         *
+         * The location table and the grids of all levels are grown once for all objects, rather
+         * than rehashed over and over while the objects are added one at a time.
+         *
+         * \param [in] handles handles of the objects; none of them may be in the index yet
+         * \param [in] bounds bounding boxes of the objects, in the same order
+         * \param [in] n number of objects
+         * \note  If memory runs out, some of the objects may have been added; remove them with
+         *        *remove()*.
+         */
+        void insert(H const *const handles, ElementRect const *const bounds, size_t const n) {
+            std::array<size_t, gl_nlevels> counts = {};
+            size_t                         top    = m_where.size();
+            for (size_t i = 0; i < n; ++i) {
+                uint32_t const level = LevelOf(bounds[i]);
+                if (level != gl_huge)
+                    ++counts[level];
+
+                top = std::max(top, static_cast<size_t>(handles[i].index()) + 1);
+            }
+
+            /* Every object may open a cell of its own. */
+            m_where.resize(top, { gl_absent, 0, 0 });
+            for (uint32_t level = 0; level < gl_nlevels; ++level)
+                if (counts[level] != 0)
+                    m_levels[level].reserve(m_levels[level].size() + counts[level]);
+
+            for (size_t i = 0; i < n; ++i)
+                insert(handles[i], bounds[i]);
+        }
+
+        /**
+         * \brief removes an object from the index
+         *
+         * \param [in] handle handle of the object; ignored if the object is not in the index
+         */
+        void remove(H const handle) noexcept {
+            size_t const idx = static_cast<size_t>(handle.index());
+            if (idx >= m_where.size() || m_where[idx].level == gl_absent)
+                return;
+
+            Location const loc = m_where[idx];
+            auto const     it  = loc.level == gl_huge ? typename Grid::iterator{} : m_levels[loc.level].find(loc.cell);
+
+            std::vector<Entry> &entries = loc.level == gl_huge ? m_huge : it->second;
+            if (loc.pos + 1 != entries.size()) {
+                entries[loc.pos] = entries.back();
+
+                m_where[static_cast<size_t>(entries[loc.pos].handle.index())].pos = loc.pos;
+            }
+            entries.pop_back();
+
+            /* Drop empty cells so that sparse queries do not visit them. */
+            if (entries.empty() && loc.level != gl_huge)
+                m_levels[loc.level].erase(it);
+            m_where[idx].level = gl_absent;
+            --m_size;
+        }
+
+        /**
+         * \brief updates the bounding box of an object
+         *
+         * \param [in] handle handle of the object; must be in the index
+         * \param [in] bounds new bounding box
+         */
+        void update(H const handle, ElementRect const &bounds) {
+            Location const &loc = m_where[static_cast<size_t>(handle.index())];
+
+            /* Small moves usually keep the object in its cell. */
+            uint32_t const level = LevelOf(bounds);
+            if (level == loc.level && (level == gl_huge || CellOf(bounds, level) == loc.cell)) {
+                (level == gl_huge ? m_huge : m_levels[level].find(loc.cell)->second)[loc.pos].bounds = bounds;
+
+                return;
+            }
+
+            remove(handle);
+            insert(handle, bounds);
+        }
+
+        /**
+         * \brief updates the bounding boxes of many objects at once, e.g. after moving a selection
+         *
+         * Objects staying in their cells are updated in place; all others are removed first and
+         * then added in one go, like with the bulk *insert()*.
+         *
+         * \param [in] handles handles of the objects; all of them must be in the index
+         * \param [in] bounds new bounding boxes, in the same order
+         * \param [in] n number of objects
+         * \note  If memory runs out, some of the moved objects may be missing from the index.
+         */
+        void update(H const *const handles, ElementRect const *const bounds, size_t const n) {
+            std::vector<H>           moved;
+            std::vector<ElementRect> rects;
+            for (size_t i = 0; i < n; ++i) {
+                Location const &loc   = m_where[static_cast<size_t>(handles[i].index())];
+                uint32_t const  level = LevelOf(bounds[i]);
+
+                if (level == loc.level && (level == gl_huge || CellOf(bounds[i], level) == loc.cell)) {
+                    (level == gl_huge ? m_huge : m_levels[level].find(loc.cell)->second)[loc.pos].bounds = bounds[i];
+
+                    continue;
+                }
+
+                moved.push_back(handles[i]);
+                rects.push_back(bounds[i]);
+            }
+
+            for (H const handle : moved)
+                remove(handle);
+            insert(moved.data(), rects.data(), moved.size());
+        }
+
+        /**
+         * \brief removes all objects and releases all memory
+         */
+        void clear() noexcept {
+            for (Grid &grid : m_levels)
+                Grid().swap(grid);
+
+            m_huge  = {};
+            m_where = {};
+            m_size  = 0;
+        }
+
+        /**
+         * \brief invokes *fn(handle, bounds)* for all objects whose bounds touch *rect*
+         *
+         * Objects whose bounds merely share an edge with *rect* are reported as well; callers apply
+         * their own, exact test.
+         *
+         * \param [in] rect query rectangle; may have zero width and height for point queries
+         * \param [in] fn visitor
+         */
+        template<class Fn> void query(ElementRect const &rect, Fn &&fn) const {
+            auto const visit = [&](std::vector<Entry> const &entries) {
+                for (Entry const &entry : entries)
+                    if (Touches(entry.bounds, rect))
+                        fn(entry.handle, entry.bounds);
+            };
+
+            for (uint32_t level = 0; level < gl_nlevels; ++level) {
+                Grid const &grid = m_levels[level];
+                if (grid.empty())
+                    continue;
+
+                /* Cells may hold objects extending up to half a cell beyond them. */
+                float const   size = CellSize(level);
+                int64_t const x0   = static_cast<int64_t>(std::floor(rect.x / size - 0.5f)) - 1;
+                int64_t const y0   = static_cast<int64_t>(std::floor(rect.y / size - 0.5f)) - 1;
+                int64_t const x1   = static_cast<int64_t>(std::floor((rect.x + rect.w) / size + 0.5f));
+                int64_t const y1   = static_cast<int64_t>(std::floor((rect.y + rect.h) / size + 0.5f));
+
+                /* Large queries are cheaper to answer by visiting the (sparse) grid itself. */
+                if (static_cast<double>(x1 - x0 + 1) * static_cast<double>(y1 - y0 + 1) > static_cast<double>(grid.size())) {
+                    for (auto const &[cell, entries] : grid)
+                        visit(entries);
+
+                    continue;
+                }
+
+                for (int64_t cy = y0; cy <= y1; ++cy)
+                    for (int64_t cx = x0; cx <= x1; ++cx) {
+                        auto const it = grid.find(Key(cx, cy));
+
+                        if (it != grid.end())
+                            visit(it->second);
+                    }
+            }
+
+            visit(m_huge);
+        }
+
+    private:
+        static constexpr float CellSize(uint32_t const level) noexcept {
+            return gl_mincell * static_cast<float>(uint32_t(1) << level);
+        }
+
+        static constexpr uint64_t Key(int64_t const cx, int64_t const cy) noexcept {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
+        }
+
+        static bool Touches(ElementRect const &a, ElementRect const &b) noexcept {
+            return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h && b.y <= a.y + a.h;
+        }
+
+        /**
+         * \brief  determines the lowest level whose cells are at least as large as *bounds*
+         *
+         * \param  [in] bounds bounding box of an object
+         *
+         * \return level, or *gl_huge* if the object is too large for any level
+         */
+        static uint32_t LevelOf(ElementRect const &bounds) noexcept {
+            float const extent = std::max(bounds.w, bounds.h);
+
+            for (uint32_t level = 0; level < gl_nlevels; ++level)
+                if (extent <= CellSize(level))
+                    return level;
+
+            return gl_huge;
+        }
+
+        /**
+         * \brief  determines the cell containing the center of *bounds*
+         *
+         * \param  [in] bounds bounding box of an object
+         * \param  [in] level level of the object
+         *
+         * \return key of the cell
+         */
+        static uint64_t CellOf(ElementRect const &bounds, uint32_t const level) noexcept {
+            float const size = CellSize(level);
+
+            return Key(
+                static_cast<int64_t>(std::floor((bounds.x + bounds.w * 0.5f) / size)),
+                static_cast<int64_t>(std::floor((bounds.y + bounds.h * 0.5f) / size))
+            );
+        }
+    };
+}
+
+
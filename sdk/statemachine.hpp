@@ -0,0 +1,785 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  statemachine.hpp
+ * \brief compiled state machines and their simulation
+ *
+ * State machines are read in the following form:
+ *
+ *     {
+ *         "name": "Door",
+ *         "states": [
+ *             { "name": "Closed", "initial": true, "states": [ { "name": "Unlocked" }, { "name": "Locked" } ] },
+ *             { "name": "Open", "regions": [ [ { "name": "Swinging" }, { "name": "Held" } ], [ { "name": "Alarm" } ] ] }
+ *         ],
+ *         "transitions": [
+ *             { "from": "Unlocked", "event": "open", "to": "Open", "guard": "!jammed" },
+ *             { "from": "Open", "event": "close", "to": "Closed" }
+ *         ]
+ *     }
+ *
+ * A state holds either one region (*states*) or several orthogonal ones (*regions*); the machine
+ * itself is a state without name. The initial state of a region is the one marked *initial*, or
+ * else its first. State names are unique across the machine. Guards name boolean variables, all
+ * *false* at first, and are negated by a leading *!*. Events and variables need no declaration.
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/config.hpp>
+#include <sdk/error.hpp>
+
+
+namespace suzu::sdk {
+    constexpr uint32_t gl_nostate = UINT32_MAX; /**< no state, e.g. the parent of a top-level state */
+
+
+    /**
+     * \class suzu::sdk::StateMachine
+     * \brief state machine compiled into flat tables
+     *
+     * States are numbered in pre-order, regions one after the other, so that every region spans a
+     * contiguous range of states. Every transition is compiled ahead of time into the range of
+     * the region it leaves and the lists of states and leaves it enters, so firing it neither
+     * searches the hierarchy nor allocates. The transition table maps every pair of state and
+     * event onto the candidate transitions, those declared on the state itself first, then those
+     * inherited from its enclosing states, each with its guard.
+     *
+     * A transition leaves the innermost region that holds both its source and target; if they lie
+     * in different orthogonal regions of a state, that state is left and entered again. Entering a
+     * state enters the initial states of all its regions that do not lie on the way to the target.
+     */
+    class StateMachine {
+    public:
+        static constexpr uint32_t gl_noguard = UINT32_MAX; /**< guard of an unguarded transition */
+
+        /**
+         * \struct suzu::sdk::StateMachine::Transition
+         * \brief  compiled transition
+         */
+        struct Transition {
+            uint32_t source;  /**< state the transition is declared on */
+            uint32_t target;  /**< target state */
+            uint32_t guard;   /**< guarding variable, times two, plus one if negated; *gl_noguard* if unguarded */
+            uint32_t lo;      /**< first state of the region left */
+            uint32_t hi;      /**< one past the last state of the region left */
+            uint32_t entry;   /**< first of the states entered, in *entries()*, outermost first */
+            uint32_t nentry;  /**< number of states entered */
+            uint32_t leaves;  /**< first of the leaf states entered, in *leaves()*, ascending */
+            uint32_t nleaves; /**< number of leaf states entered */
+        };
+
+    private:
+        /**
+         * \struct suzu::sdk::StateMachine::Region
+         * \brief  region of a state, while compiling
+         */
+        struct Region {
+            uint32_t initial; /**< initial state */
+            uint32_t lo;      /**< first state */
+            uint32_t hi;      /**< one past the last state */
+        };
+
+        /**
+         * \struct suzu::sdk::StateMachine::Build
+         * \brief  state of the compilation
+         */
+        struct Build {
+            std::vector<std::vector<Region>> regions; /**< regions, by state */
+            std::vector<uint32_t>            region;  /**< index of the region holding a state, within its parent */
+            std::vector<Region>              root;    /**< regions of the machine */
+        };
+
+        std::string                               m_name;        /**< name of the machine */
+        std::vector<std::string>                  m_states;      /**< names, by state */
+        std::vector<uint32_t>                     m_parent;      /**< enclosing states, by state; *gl_nostate* for top-level states */
+        std::vector<std::string>                  m_events;      /**< names, by event */
+        std::vector<std::string>                  m_variables;   /**< names, by variable */
+        std::unordered_map<std::string, uint32_t> m_stateids;    /**< states, by name */
+        std::unordered_map<std::string, uint32_t> m_eventids;    /**< events, by name */
+        std::unordered_map<std::string, uint32_t> m_variableids; /**< variables, by name */
+        std::vector<Transition>                   m_transitions; /**< transitions, in order of declaration */
+        std::vector<uint32_t>                     m_offsets;     /**< first candidate, by *state × events + event*; one more at the end */
+        std::vector<uint32_t>                     m_candidates;  /**< transitions, by pair of state and event, innermost first */
+        std::vector<uint32_t>                     m_entries;     /**< states entered, by transition */
+        std::vector<uint32_t>                     m_leaves;      /**< leaf states entered, by transition */
+        Transition                                m_initial;     /**< pseudo transition entering the initial configuration */
+
+    public:
+        StateMachine() noexcept
+            : m_initial{ gl_nostate, gl_nostate, gl_noguard, 0, 0, 0, 0, 0, 0 }
+        { }
+
+        /**
+         * \brief  compiles a state machine
+         *
+         * \param  [in] doc definition of the machine (see *sdk/statemachine.hpp*)
+         * \param  [out] error (optional) receives a description of the error, if any
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter*
+         *         if the definition is invalid, or *suzu::sdk::ErrorCode::CriticalResource* if
+         *         memory ran out; the machine is empty then
+         */
+        ErrorCode compile(JSON const &doc, std::string *const error = nullptr) noexcept {
+            clear();
+
+            try {
+                if (!doc.is_object())
+                    throw std::invalid_argument("state machine must be an object");
+
+                Build build;
+                m_name     = doc.value("name", std::string());
+                build.root = addRegions(doc, gl_nostate, build);
+                if (build.root.empty())
+                    throw std::invalid_argument("state machine without states");
+
+                JSON const *const transitions = doc.contains("transitions") ? &doc["transitions"] : nullptr;
+                if (transitions != nullptr && !transitions->is_array())
+                    throw std::invalid_argument("transitions must be an array");
+
+                std::vector<uint32_t> events;
+                for (JSON const &transition : transitions != nullptr ? *transitions : JSON::array()) {
+                    events.push_back(IdOf(m_eventids, m_events, Text(transition, "event")));
+                    compileTransition(transition, build);
+                }
+
+                /* The initial configuration is entered like a transition into the machine as a whole. */
+                m_initial.entry  = static_cast<uint32_t>(m_entries.size());
+                m_initial.leaves = static_cast<uint32_t>(m_leaves.size());
+                for (Region const &region : build.root)
+                    enter(region.initial, build);
+                m_initial.nentry  = static_cast<uint32_t>(m_entries.size()) - m_initial.entry;
+                m_initial.nleaves = static_cast<uint32_t>(m_leaves.size()) - m_initial.leaves;
+                m_initial.hi      = stateCount();
+                std::sort(m_leaves.begin() + m_initial.leaves, m_leaves.end());
+
+                buildTable(events);
+                return ErrorCode::Ok;
+            } catch (std::bad_alloc const &) {
+                clear();
+
+                return ErrorCode::CriticalResource;
+            } catch (std::exception const &ex) {
+                if (error != nullptr)
+                    *error = ex.what();
+            } catch (...) { }
+
+            clear();
+            return ErrorCode::InvalidParameter;
+        }
+
+        /**
+         * \brief removes all states, events and transitions
+         */
+        void clear() noexcept {
+            m_name.clear();
+            m_states.clear();
+            m_parent.clear();
+            m_events.clear();
+            m_variables.clear();
+            m_stateids.clear();
+            m_eventids.clear();
+            m_variableids.clear();
+            m_transitions.clear();
+            m_offsets.clear();
+            m_candidates.clear();
+            m_entries.clear();
+            m_leaves.clear();
+            m_initial = { gl_nostate, gl_nostate, gl_noguard, 0, 0, 0, 0, 0, 0 };
+        }
+
+        std::string const &name() const noexcept            { return m_name; }
+        uint32_t           stateCount() const noexcept      { return static_cast<uint32_t>(m_states.size()); }
+        uint32_t           eventCount() const noexcept      { return static_cast<uint32_t>(m_events.size()); }
+        uint32_t           variableCount() const noexcept   { return static_cast<uint32_t>(m_variables.size()); }
+        uint32_t           transitionCount() const noexcept { return static_cast<uint32_t>(m_transitions.size()); }
+
+        std::string const &stateName(uint32_t const state) const noexcept       { return m_states[state]; }
+        std::string const &eventName(uint32_t const event) const noexcept       { return m_events[event]; }
+        std::string const &variableName(uint32_t const variable) const noexcept { return m_variables[variable]; }
+        uint32_t           parent(uint32_t const state) const noexcept          { return m_parent[state]; }
+
+        /**
+         * \brief  looks up a state, an event or a variable by name
+         *
+         * \param  [in] name name to look up
+         *
+         * \return index, or *gl_nostate* if there is none of that name
+         */
+        uint32_t state(std::string_view const name) const { return Find(m_stateids, name); }
+        uint32_t event(std::string_view const name) const { return Find(m_eventids, name); }
+        uint32_t variable(std::string_view const name) const { return Find(m_variableids, name); }
+
+        Transition const &transition(uint32_t const index) const noexcept { return m_transitions[index]; }
+        Transition const &initial() const noexcept                        { return m_initial; }
+        uint32_t const   *entries() const noexcept                        { return m_entries.data(); }
+        uint32_t const   *leaves() const noexcept                         { return m_leaves.data(); }
+
+        /**
+         * \brief  retrieves the candidate transitions of a state for an event
+         *
+         * \param  [in] state active state
+         * \param  [in] event dispatched event
+         *
+         * \return range of transition indices, in order of priority
+         */
+        std::pair<uint32_t const *, uint32_t const *> candidates(uint32_t const state, uint32_t const event) const noexcept {
+            size_t const slot = static_cast<size_t>(state) * m_events.size() + event;
+
+            return { m_candidates.data() + m_offsets[slot], m_candidates.data() + m_offsets[slot + 1] };
+        }
+
+    private:
+        static uint32_t Find(std::unordered_map<std::string, uint32_t> const &ids, std::string_view const name) {
+            auto const it = ids.find(std::string(name));
+
+            return it == ids.end() ? gl_nostate : it->second;
+        }
+
+        static std::string Text(JSON const &obj, char const *const key) {
+            auto const it = obj.find(key);
+            if (it == obj.end() || !it->is_string())
+                throw std::invalid_argument(std::string("missing \"") + key + "\"");
+
+            return it->get<std::string>();
+        }
+
+        static uint32_t IdOf(std::unordered_map<std::string, uint32_t> &ids, std::vector<std::string> &names, std::string name) {
+            auto const [it, added] = ids.try_emplace(name, static_cast<uint32_t>(names.size()));
+            if (added)
+                names.push_back(std::move(name));
+
+            return it->second;
+        }
+
+        /**
+         * \brief  adds the regions of a state, and all states within, in pre-order
+         *
+         * \param  [in] obj definition of the state, or of the machine
+         * \param  [in] parent the state; *gl_nostate* for the machine
+         * \param  [in,out] build state of the compilation
+         *
+         * \return regions of the state
+         * \throw  std::invalid_argument if the definition is invalid, std::bad_alloc
+         */
+        std::vector<Region> addRegions(JSON const &obj, uint32_t const parent, Build &build) {
+            bool const single   = obj.contains("states");
+            bool const multiple = obj.contains("regions");
+            if (single && multiple)
+                throw std::invalid_argument("state with both \"states\" and \"regions\"");
+            else if (!single && !multiple)
+                return {};
+
+            JSON const &list = single ? obj["states"] : obj["regions"];
+            if (!list.is_array())
+                throw std::invalid_argument("states and regions must be arrays");
+
+            std::vector<Region> res;
+            for (size_t r = 0; r < (single ? 1 : list.size()); ++r) {
+                JSON const &states = single ? list : list[r];
+                if (!states.is_array() || states.empty())
+                    throw std::invalid_argument("empty region");
+
+                Region region = { gl_nostate, stateCount(), 0 };
+                for (JSON const &state : states) {
+                    if (!state.is_object())
+                        throw std::invalid_argument("state must be an object");
+
+                    uint32_t const index = stateCount();
+                    std::string    name  = Text(state, "name");
+                    if (!m_stateids.try_emplace(name, index).second)
+                        throw std::invalid_argument("duplicate state \"" + name + "\"");
+
+                    m_states.push_back(std::move(name));
+                    m_parent.push_back(parent);
+                    build.region.push_back(static_cast<uint32_t>(r));
+                    build.regions.emplace_back();
+                    if (state.value("initial", false)) {
+                        if (region.initial != gl_nostate)
+                            throw std::invalid_argument("several initial states in one region");
+
+                        region.initial = index;
+                    }
+
+                    std::vector<Region> inner = addRegions(state, index, build);
+                    build.regions[index] = std::move(inner);
+                }
+
+                region.initial = region.initial == gl_nostate ? region.lo : region.initial;
+                region.hi      = stateCount();
+                res.push_back(region);
+            }
+
+            return res;
+        }
+
+        /**
+         * \brief  appends a state and the initial states of all its regions to the states entered
+         *
+         * \param  [in] state state to enter
+         * \param  [in] build state of the compilation
+         * \throw  std::bad_alloc
+         */
+        void enter(uint32_t const state, Build const &build) {
+            m_entries.push_back(state);
+            if (build.regions[state].empty())
+                m_leaves.push_back(state);
+
+            for (Region const &region : build.regions[state])
+                enter(region.initial, build);
+        }
+
+        /**
+         * \brief  compiles a transition
+         *
+         * \param  [in] obj definition of the transition
+         * \param  [in] build state of the compilation
+         * \throw  std::invalid_argument if the definition is invalid, std::bad_alloc
+         */
+        void compileTransition(JSON const &obj, Build const &build) {
+            uint32_t const source = state(Text(obj, "from"));
+            uint32_t const target = state(Text(obj, "to"));
+            if (source == gl_nostate || target == gl_nostate)
+                throw std::invalid_argument("transition between unknown states");
+
+            Transition res = { source, target, gl_noguard, 0, 0, 0, 0, 0, 0 };
+            if (obj.contains("guard")) {
+                std::string guard = Text(obj, "guard");
+                bool const  negated = !guard.empty() && guard.front() == '!';
+                if (guard.size() == (negated ? 1u : 0u))
+                    throw std::invalid_argument("empty guard");
+
+                res.guard = IdOf(m_variableids, m_variables, guard.substr(negated ? 1 : 0)) * 2 + (negated ? 1 : 0);
+            }
+
+            /*
+             * Find the innermost state enclosing both ends, and the states right below it on the way
+             * to them; source and target themselves count as left and entered again.
+             */
+            auto const contains = [this](uint32_t const outer, uint32_t const inner) {
+                for (uint32_t s = inner; s != gl_nostate; s = m_parent[s])
+                    if (s == outer)
+                        return true;
+                return false;
+            };
+            uint32_t domain = m_parent[source];
+            while (domain != gl_nostate && (domain == target || !contains(domain, target)))
+                domain = m_parent[domain];
+
+            auto const below = [this](uint32_t const outer, uint32_t state) {
+                while (m_parent[state] != outer)
+                    state = m_parent[state];
+                return state;
+            };
+            uint32_t from = below(domain, source);
+            uint32_t to   = below(domain, target);
+
+            /*
+             * Ends in different orthogonal regions leave the state holding them altogether; if that
+             * is the machine, all of it is left and its other regions are entered again.
+             */
+            bool const whole = build.region[from] != build.region[to] && domain == gl_nostate;
+            if (build.region[from] != build.region[to] && !whole) {
+                from   = domain;
+                to     = domain;
+                domain = m_parent[domain];
+            }
+
+            if (whole) {
+                res.lo = 0;
+                res.hi = stateCount();
+            } else {
+                Region const &left = (domain == gl_nostate ? build.root : build.regions[domain])[build.region[from]];
+                res.lo = left.lo;
+                res.hi = left.hi;
+            }
+
+            /* Enter the states on the way down, with the initial states of their other regions. */
+            std::vector<uint32_t> path;
+            for (uint32_t s = target; s != to; s = m_parent[s])
+                path.push_back(s);
+            path.push_back(to);
+            std::reverse(path.begin(), path.end());
+
+            res.entry  = static_cast<uint32_t>(m_entries.size());
+            res.leaves = static_cast<uint32_t>(m_leaves.size());
+            for (uint32_t r = 0; whole && r < build.root.size(); ++r)
+                if (r != build.region[to])
+                    enter(build.root[r].initial, build);
+            for (size_t i = 0; i + 1 < path.size(); ++i) {
+                m_entries.push_back(path[i]);
+
+                std::vector<Region> const &regions = build.regions[path[i]];
+                for (uint32_t r = 0; r < regions.size(); ++r)
+                    if (r != build.region[path[i + 1]])
+                        enter(regions[r].initial, build);
+            }
+            enter(target, build);
+            res.nentry  = static_cast<uint32_t>(m_entries.size()) - res.entry;
+            res.nleaves = static_cast<uint32_t>(m_leaves.size()) - res.leaves;
+            std::sort(m_leaves.begin() + res.leaves, m_leaves.end());
+
+            m_transitions.push_back(res);
+        }
+
+        /**
+         * \brief  fills the transition table
+         *
+         * \param  [in] events event of every transition
+         * \throw  std::bad_alloc
+         */
+        void buildTable(std::vector<uint32_t> const &events) {
+            size_t const nevents = m_events.size();
+
+            /* Transitions declared on every state, grouped by event. */
+            std::vector<uint32_t> declared(m_states.size() * nevents + 1, 0);
+            for (uint32_t t = 0; t < m_transitions.size(); ++t)
+                ++declared[m_transitions[t].source * nevents + events[t] + 1];
+            for (size_t i = 1; i < declared.size(); ++i)
+                declared[i] += declared[i - 1];
+
+            std::vector<uint32_t> order(m_transitions.size());
+            std::vector<uint32_t> fill(declared.begin(), declared.end() - 1);
+            for (uint32_t t = 0; t < m_transitions.size(); ++t)
+                order[fill[m_transitions[t].source * nevents + events[t]]++] = t;
+
+            /* Every state inherits the transitions of its enclosing states, after its own. */
+            m_offsets.assign(m_states.size() * nevents + 1, 0);
+            for (uint32_t s = 0; s < m_states.size(); ++s)
+                for (size_t e = 0; e < nevents; ++e) {
+                    m_offsets[s * nevents + e] = static_cast<uint32_t>(m_candidates.size());
+
+                    for (uint32_t a = s; a != gl_nostate; a = m_parent[a])
+                        m_candidates.insert(m_candidates.end(), order.begin() + declared[a * nevents + e], order.begin() + declared[a * nevents + e + 1]);
+                }
+            m_offsets.back() = static_cast<uint32_t>(m_candidates.size());
+        }
+    };
+
+
+    /**
+     * \class suzu::sdk::StateMachineSimulator
+     * \brief runs a compiled state machine against events
+     *
+     * The active configuration is kept as one flag per state and the active leaf states in
+     * ascending order. Dispatching an event looks up the candidates of every active leaf in the
+     * transition table and fires the first one whose guard holds, unless an earlier transition of
+     * the same step has left the leaf already; a transition inherited by leaves of several
+     * orthogonal regions thus fires once. As every region spans a range of states, firing removes
+     * the leaves of that range and inserts the leaves entered in their place. Dispatching never
+     * allocates.
+     *
+     * \note  The simulator is not thread-safe; simulators of the same machine may run concurrently.
+     */
+    class StateMachineSimulator {
+        StateMachine const   *m_machine;   /**< simulated machine */
+        std::vector<uint8_t>  m_active;    /**< whether or not a state is active, by state */
+        std::vector<uint8_t>  m_variables; /**< values, by variable */
+        std::vector<uint32_t> m_leaves;    /**< active leaf states, ascending */
+        std::vector<uint32_t> m_step;      /**< active leaf states at the start of a step */
+        uint64_t              m_events;    /**< events dispatched */
+        uint64_t              m_fired;     /**< transitions fired */
+
+    public:
+        /**
+         * \brief constructs a simulator in the initial configuration
+         *
+         * \param [in] machine machine to simulate; must outlive the simulator
+         * \throw std::bad_alloc
+         */
+        explicit StateMachineSimulator(StateMachine const &machine)
+            : m_machine(&machine), m_active(machine.stateCount(), 0), m_variables(machine.variableCount(), 0), m_events(0), m_fired(0)
+        {
+            m_leaves.reserve(machine.stateCount());
+            m_step.reserve(machine.stateCount());
+
+            reset();
+        }
+
+        /**
+         * \brief returns to the initial configuration, with all variables *false*
+         */
+        void reset() noexcept {
+            std::fill(m_active.begin(), m_active.end(), 0);
+            std::fill(m_variables.begin(), m_variables.end(), 0);
+            m_leaves.clear();
+            m_events = 0;
+            m_fired  = 0;
+
+            fire(m_machine->initial());
+        }
+
+        /**
+         * \brief  dispatches an event, firing at most one transition per active leaf state
+         *
+         * \param  [in] event the event
+         *
+         * \return number of transitions fired
+         */
+        uint32_t dispatch(uint32_t const event) noexcept {
+            ++m_events;
+
+            uint32_t res = 0;
+            m_step.assign(m_leaves.begin(), m_leaves.end());
+            for (uint32_t const leaf : m_step) {
+                if (!m_active[leaf])
+                    continue;
+
+                auto const [first, last] = m_machine->candidates(leaf, event);
+                for (uint32_t const *it = first; it != last; ++it) {
+                    StateMachine::Transition const &transition = m_machine->transition(*it);
+                    if (transition.guard != StateMachine::gl_noguard && m_variables[transition.guard >> 1] == (transition.guard & 1))
+                        continue;
+
+                    fire(transition);
+                    ++res;
+                    break;
+                }
+            }
+
+            m_fired += res;
+            return res;
+        }
+
+        void setVariable(uint32_t const variable, bool const value) noexcept { m_variables[variable] = value ? 1 : 0; }
+        bool isActive(uint32_t const state) const noexcept                   { return m_active[state] != 0; }
+
+        std::vector<uint32_t> const &leaves() const noexcept { return m_leaves; }
+        uint64_t                     events() const noexcept { return m_events; }
+        uint64_t                     fired() const noexcept  { return m_fired; }
+
+    private:
+        /**
+         * \brief leaves the region of a transition and enters its target
+         *
+         * \param [in] transition the transition
+         */
+        void fire(StateMachine::Transition const &transition) noexcept {
+            auto const first = std::lower_bound(m_leaves.begin(), m_leaves.end(), transition.lo);
+            auto const last  = std::lower_bound(first, m_leaves.end(), transition.hi);
+            for (auto it = first; it != last; ++it)
+                for (uint32_t s = *it; s != gl_nostate && s >= transition.lo && m_active[s]; s = m_machine->parent(s))
+                    m_active[s] = 0;
+
+            /* The leaves entered lie within the region left, so they take the place of the leaves removed. */
+            uint32_t const *const entered = m_machine->leaves() + transition.leaves;
+            auto const            pos     = m_leaves.erase(first, last);
+            m_leaves.insert(pos, entered, entered + transition.nleaves);
+
+            uint32_t const *const states = m_machine->entries() + transition.entry;
+            for (uint32_t i = 0; i < transition.nentry; ++i)
+                m_active[states[i]] = 1;
+        }
+    };
+
+
+    /**
+     * \class suzu::sdk::SimulationScript
+     * \brief script of events and expectations to run a state machine against, e.g. as a
+     *        regression test of the model
+     *
+     * Scripts hold one command per line; *#* starts a comment:
+     *
+     *     send open close     # dispatches events, in order
+     *     set jammed          # sets variables to true
+     *     clear jammed        # sets variables to false
+     *     expect Closed       # fails unless all states given are active
+     *     repeat 1000         # runs the commands up to the matching "end" that many times
+     *     end
+     *
+     * Names are resolved once when parsing, so running a script costs a table lookup per event.
+     */
+    class SimulationScript {
+        /**
+         * \struct suzu::sdk::SimulationScript::Op
+         * \brief  compiled command
+         */
+        struct Op {
+            enum Kind : uint32_t {
+                Send,   /**< dispatch event *arg* */
+                Set,    /**< set variable *arg* */
+                Clear,  /**< clear variable *arg* */
+                Expect, /**< expect state *arg* to be active */
+                Repeat, /**< start a loop of *arg* iterations */
+                End     /**< end of the loop starting at op *arg* */
+            };
+
+            Kind     kind; /**< command */
+            uint32_t arg;  /**< argument, see *Kind* */
+            uint32_t line; /**< line of the command, for messages */
+        };
+
+        std::vector<Op> m_ops; /**< commands */
+
+    public:
+        /**
+         * \brief  parses a script
+         *
+         * \param  [in] text text of the script
+         * \param  [in] machine machine to run the script against
+         * \param  [out] error (optional) receives a description of the error, if any
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter*
+         *         if the script is invalid or names unknown events or states, or
+         *         *suzu::sdk::ErrorCode::CriticalResource* if memory ran out
+         */
+        ErrorCode parse(std::string_view text, StateMachine const &machine, std::string *const error = nullptr) noexcept {
+            m_ops.clear();
+
+            try {
+                std::vector<uint32_t> loops;
+                for (uint32_t line = 1; !text.empty(); ++line) {
+                    size_t const     eol  = text.find('\n');
+                    std::string_view rest = text.substr(0, eol);
+                    text = eol == std::string_view::npos ? std::string_view() : text.substr(eol + 1);
+                    rest = rest.substr(0, rest.find('#'));
+
+                    std::string_view const command = Token(rest);
+                    if (command.empty())
+                        continue;
+
+                    auto const add = [&](Op::Kind const kind, uint32_t const arg) { m_ops.push_back({ kind, arg, line }); };
+                    if (command == "repeat") {
+                        std::string_view const count = Token(rest);
+                        uint64_t               n     = 0;
+                        for (char const c : count)
+                            n = c >= '0' && c <= '9' && n <= UINT32_MAX ? n * 10 + static_cast<uint64_t>(c - '0') : UINT64_MAX;
+                        if (n == 0 || n > UINT32_MAX || !Token(rest).empty() || loops.size() == 64)
+                            return Fail(error, line, "invalid repeat count");
+
+                        loops.push_back(static_cast<uint32_t>(m_ops.size()));
+                        add(Op::Repeat, static_cast<uint32_t>(n));
+                        continue;
+                    } else if (command == "end") {
+                        if (loops.empty() || !Token(rest).empty())
+                            return Fail(error, line, "unexpected end");
+
+                        add(Op::End, loops.back());
+                        loops.pop_back();
+                        continue;
+                    }
+
+                    Op::Kind const kind = command == "send" ? Op::Send : command == "set" ? Op::Set : command == "clear" ? Op::Clear : command == "expect" ? Op::Expect : Op::End;
+                    if (kind == Op::End)
+                        return Fail(error, line, "unknown command \"" + std::string(command) + "\"");
+
+                    for (std::string_view name = Token(rest); !name.empty(); name = Token(rest)) {
+                        uint32_t const arg = kind == Op::Send ? machine.event(name) : kind == Op::Expect ? machine.state(name) : machine.variable(name);
+                        if (arg == gl_nostate)
+                            return Fail(error, line, "unknown name \"" + std::string(name) + "\"");
+
+                        add(kind, arg);
+                    }
+                }
+
+                if (!loops.empty())
+                    return Fail(error, m_ops[loops.back()].line, "repeat without end");
+                return ErrorCode::Ok;
+            } catch (std::bad_alloc const &) {
+                m_ops.clear();
+
+                return ErrorCode::CriticalResource;
+            } catch (...) { }
+
+            m_ops.clear();
+            return Fail(error, 0, "invalid script");
+        }
+
+        /**
+         * \brief  runs the script
+         *
+         * \param  [in,out] sim simulator of the machine the script was parsed for; not reset
+         * \param  [out] error (optional) receives a description of the first failed expectation
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if all expectations held, or
+         *         *suzu::sdk::ErrorCode::InvalidState* at the first that did not
+         */
+        ErrorCode run(StateMachineSimulator &sim, std::string *const error = nullptr) const noexcept {
+            /* Remaining iterations of the loops running, innermost last; loops nest as deep as the script does. */
+            uint32_t remaining[64];
+            size_t   depth = 0;
+
+            for (size_t i = 0; i < m_ops.size(); ++i) {
+                Op const &op = m_ops[i];
+                switch (op.kind) {
+                    case Op::Send:
+                        sim.dispatch(op.arg);
+                        break;
+                    case Op::Set:
+                    case Op::Clear:
+                        sim.setVariable(op.arg, op.kind == Op::Set);
+                        break;
+                    case Op::Expect:
+                        if (!sim.isActive(op.arg)) {
+                            if (error != nullptr) {
+                                try {
+                                    *error = "line " + std::to_string(op.line) + ": expected state to be active";
+                                } catch (...) { }
+                            }
+
+                            return ErrorCode::InvalidState;
+                        }
+                        break;
+                    case Op::Repeat:
+                        remaining[depth++] = op.arg;
+                        break;
+                    case Op::End:
+                        if (--remaining[depth - 1] != 0)
+                            i = op.arg;
+                        else
+                            --depth;
+                        break;
+                }
+            }
+
+            return ErrorCode::Ok;
+        }
+
+    private:
+        static std::string_view Token(std::string_view &text) noexcept {
+            size_t const begin = text.find_first_not_of(" \t\r");
+            if (begin == std::string_view::npos) {
+                text = {};
+
+                return {};
+            }
+
+            size_t const           end = text.find_first_of(" \t\r", begin);
+            std::string_view const res = text.substr(begin, end == std::string_view::npos ? std::string_view::npos : end - begin);
+            text = end == std::string_view::npos ? std::string_view() : text.substr(end);
+            return res;
+        }
+
+        ErrorCode Fail(std::string *const error, uint32_t const line, std::string const &what) noexcept {
+            m_ops.clear();
+
+            if (error != nullptr) {
+                try {
+                    *error = "line " + std::to_string(line) + ": " + what;
+                } catch (...) { }
+            }
+            return ErrorCode::InvalidParameter;
+        }
+    };
+}
+
+
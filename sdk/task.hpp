@@ -0,0 +1,634 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  task.hpp
+ * \brief task API backed by a work-stealing thread pool shared by the application and all plug-ins
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \enum  suzu::sdk::TaskPriority
+     * \brief scheduling priority of a task
+     *
+     * Workers always take the most urgent task available before considering less urgent ones.
+     */
+    enum class TaskPriority : uint32_t {
+        High,   /**< latency-sensitive work, e.g. results the user waits for */
+        Normal, /**< default priority */
+        Low,    /**< background work, e.g. indexing or prefetching */
+
+        __NumPriorities__ /**< (only used internally) */
+    };
+    constexpr size_t gl_ntaskprios = static_cast<size_t>(TaskPriority::__NumPriorities__); /**< number of priorities */
+
+
+    /**
+     * \struct suzu::sdk::TaskSchedulerInterface
+     * \brief  ABI-stable view on the task scheduler owned by the host application
+     *
+     * Like *suzu::sdk::SinkRegistry*, this is a plain struct of raw pointers so that it can be passed
+     * to plug-ins regardless of their STL ABI. The scheduler only ever sees a function pointer and an
+     * opaque argument; both are owned by the submitting module.
+     */
+    struct TaskSchedulerInterface {
+        static constexpr uint32_t gl_version = 1; /**< current ABI version */
+
+        uint32_t version;                                                    /**< must be *gl_version* */
+        uint32_t nworkers;                                                   /**< number of worker threads */
+        void    *sched;                                                      /**< opaque scheduler object */
+        void   (*submit)(void *sched, uint32_t prio, void (*fn)(void *), void *arg); /**< queues *fn(arg)*; never blocks */
+        int    (*help)(void *sched);                                         /**< runs one queued task on the calling thread; returns 0 if there was none */
+    };
+
+
+    namespace internal {
+        /*
+         * Scheduler of the current instance, set by *InitializeInstanceTasks()*. Until then (or after
+         * the host detached the scheduler), tasks are run synchronously on the submitting thread.
+         */
+        inline TaskSchedulerInterface gl_tasks = { TaskSchedulerInterface::gl_version, 0, nullptr, nullptr, nullptr };
+
+        /**
+         * \struct suzu::sdk::internal::TaskState
+         * \brief  shared state of a single task; owned by the module that submitted it
+         */
+        struct TaskState {
+            std::mutex                              m_lock;      /**< guards all non-atomic members */
+            std::condition_variable                 m_cond;      /**< signalled when the task has finished */
+            bool                                    m_finished;  /**< whether or not the task has run (or was skipped) */
+            std::atomic<bool>                       m_cancelled; /**< whether or not cancellation was requested */
+            TaskPriority                            m_prio;      /**< scheduling priority */
+            std::function<void()>                   m_fn;        /**< task function; released once started */
+            std::vector<std::shared_ptr<TaskState>> m_next;      /**< continuations waiting for this task */
+
+            TaskState(std::function<void()> fn, TaskPriority prio)
+                : m_finished(false), m_cancelled(false), m_prio(prio), m_fn(std::move(fn))
+            { }
+        };
+
+        inline thread_local TaskState *gl_currtask = nullptr; /**< task running on the current thread */
+
+        inline void ScheduleTask(std::shared_ptr<TaskState> state) noexcept;
+
+        /**
+         * \brief executes a task and releases its continuations
+         *
+         * This is the function handed to the scheduler; *arg* is a heap-allocated reference to the
+         * task state, which is released here.
+         *
+         * \param [in] arg pointer to a *std::shared_ptr<TaskState>*
+         */
+        inline void ExecuteTask(void *arg) noexcept {
+            std::unique_ptr<std::shared_ptr<TaskState>> const ref(static_cast<std::shared_ptr<TaskState> *>(arg));
+            TaskState &state = **ref;
+
+            std::function<void()> fn;
+            {
+                std::lock_guard<std::mutex> lock(state.m_lock);
+
+                fn.swap(state.m_fn);
+            }
+
+            if (fn && !state.m_cancelled) {
+                TaskState *const prev = gl_currtask;
+                gl_currtask = &state;
+
+                try {
+                    fn();
+                } catch (...) { }
+
+                gl_currtask = prev;
+            }
+
+            std::vector<std::shared_ptr<TaskState>> next;
+            {
+                std::lock_guard<std::mutex> lock(state.m_lock);
+
+                state.m_finished = true;
+                next.swap(state.m_next);
+            }
+            state.m_cond.notify_all();
+
+            /* Continuations of a cancelled task are cancelled as well. */
+            for (std::shared_ptr<TaskState> &cont : next) {
+                if (state.m_cancelled)
+                    cont->m_cancelled = true;
+
+                ScheduleTask(std::move(cont));
+            }
+        }
+
+        /**
+         * \brief hands *state* over to the scheduler of the current instance
+         *
+         * \param [in] state task to schedule
+         */
+        inline void ScheduleTask(std::shared_ptr<TaskState> state) noexcept {
+            std::shared_ptr<TaskState> *ref = nullptr;
+            try {
+                ref = new std::shared_ptr<TaskState>(std::move(state));
+            } catch (...) {
+                return;
+            }
+
+            if (gl_tasks.submit == nullptr)
+                ExecuteTask(ref);
+            else
+                gl_tasks.submit(gl_tasks.sched, static_cast<uint32_t>((*ref)->m_prio), &ExecuteTask, ref);
+        }
+    }
+
+
+    /**
+     * \brief  sets the task scheduler used by the current instance
+     *
+     * The host calls this with the interface of its own scheduler, and passes the same interface to
+     * every plug-in upon invoking the plug-in's initialization function, so that all modules share one
+     * set of worker threads. Passing an interface without *submit* function detaches the scheduler;
+     * tasks then run synchronously on the submitting thread.
+     *
+     * \param  [in] iface scheduler interface provided by the host
+     *
+     * \return *true* if the interface was accepted
+     * \note   Must not be called while tasks of the current instance are being submitted.
+     */
+    inline bool InitializeInstanceTasks(TaskSchedulerInterface const &iface) noexcept {
+        if (iface.version != TaskSchedulerInterface::gl_version)
+            return false;
+
+        internal::gl_tasks = iface;
+        return true;
+    }
+
+    /**
+     * \brief  checks whether the task running on the calling thread has been cancelled
+     *
+     * Long-running tasks should poll this regularly and return early if it is set.
+     *
+     * \return *true* if cancellation of the current task was requested
+     */
+    inline bool IsTaskCancelled() noexcept {
+        return internal::gl_currtask != nullptr && internal::gl_currtask->m_cancelled;
+    }
+
+
+    /**
+     * \class suzu::sdk::TaskHandle
+     * \brief reference to a submitted task
+     *
+     * Handles are cheap to copy; all copies refer to the same task. Dropping all handles does not
+     * cancel the task.
+     */
+    class TaskHandle {
+        std::shared_ptr<internal::TaskState> m_state; /**< shared task state; *nullptr* if invalid */
+
+    public:
+        TaskHandle() noexcept = default;
+        explicit TaskHandle(std::shared_ptr<internal::TaskState> state) noexcept
+            : m_state(std::move(state))
+        { }
+
+        /**
+         * \brief  retrieves whether or not the handle refers to a task
+         *
+         * \return *true* if the handle is valid
+         */
+        bool isValid() const noexcept { return m_state != nullptr; }
+
+        /**
+         * \brief  retrieves whether or not the task has finished, either by running or by being skipped
+         *
+         * \return *true* if the task has finished
+         */
+        bool isFinished() const noexcept {
+            if (m_state == nullptr)
+                return true;
+
+            std::lock_guard<std::mutex> lock(m_state->m_lock);
+            return m_state->m_finished;
+        }
+
+        /**
+         * \brief requests cancellation of the task and of all of its continuations
+         *
+         * A task that has not started yet is skipped. A running task keeps running unless it polls
+         * *suzu::sdk::IsTaskCancelled()*.
+         */
+        void cancel() const noexcept {
+            if (m_state != nullptr)
+                m_state->m_cancelled = true;
+        }
+
+        /**
+         * \brief blocks until the task has finished
+         *
+         * While waiting, the calling thread runs other queued tasks, so waiting from within a task
+         * does not starve the pool.
+         */
+        void wait() const noexcept {
+            if (m_state == nullptr)
+                return;
+
+            for (;;) {
+                if (isFinished())
+                    return;
+
+                /* If there is nothing left to help with, the task is running on another thread. */
+                if (internal::gl_tasks.help == nullptr || internal::gl_tasks.help(internal::gl_tasks.sched) == 0)
+                    break;
+            }
+
+            std::unique_lock<std::mutex> lock(m_state->m_lock);
+            m_state->m_cond.wait(lock, [&]() { return m_state->m_finished; });
+        }
+
+        /**
+         * \brief  schedules *fn* to run once this task has finished
+         *
+         * \param  [in] fn continuation
+         * \param  [in] prio priority of the continuation
+         *
+         * \return handle of the continuation; invalid if it could not be created
+         */
+        TaskHandle then(std::function<void()> fn, TaskPriority prio = TaskPriority::Normal) const noexcept {
+            try {
+                auto next = std::make_shared<internal::TaskState>(std::move(fn), prio);
+                if (m_state != nullptr) {
+                    std::lock_guard<std::mutex> lock(m_state->m_lock);
+
+                    if (!m_state->m_finished) {
+                        m_state->m_next.push_back(next);
+
+                        return TaskHandle{ std::move(next) };
+                    }
+                    next->m_cancelled = m_state->m_cancelled.load();
+                }
+
+                internal::ScheduleTask(next);
+                return TaskHandle{ std::move(next) };
+            } catch (...) { }
+
+            return {};
+        }
+    };
+
+
+    /**
+     * \class suzu::sdk::RetiredTasks
+     * \brief cancelled tasks whose owner has to outlive them
+     *
+     * Cancelling a running task does not stop it, so a task referring to its owner, e.g. to post
+     * its result to it, may still run after the owner dropped its handle. Owners therefore retire
+     * such handles here instead of dropping them, and wait for them before they are destroyed.
+     * Finished tasks are removed whenever another one is retired.
+     */
+    class RetiredTasks {
+        std::vector<TaskHandle> m_tasks; /**< cancelled tasks that may not have finished yet */
+
+    public:
+        RetiredTasks() noexcept = default;
+        RetiredTasks(RetiredTasks const &) = delete;
+        RetiredTasks &operator =(RetiredTasks const &) = delete;
+        /**
+         * \brief waits for all retired tasks
+         */
+        ~RetiredTasks() { wait(); }
+
+        /**
+         * \brief cancels a task and keeps its handle until it has finished
+         *
+         * \param [in] task task to cancel; invalid and finished handles are ignored
+         * \note  If the handle cannot be kept, the task is waited for right away.
+         */
+        void retire(TaskHandle const &task) noexcept {
+            task.cancel();
+            if (task.isFinished())
+                return;
+
+            m_tasks.erase(std::remove_if(m_tasks.begin(), m_tasks.end(), [](TaskHandle const &retired) { return retired.isFinished(); }), m_tasks.end());
+            try {
+                m_tasks.push_back(task);
+            } catch (...) {
+                task.wait();
+            }
+        }
+
+        /**
+         * \brief blocks until all retired tasks have finished
+         */
+        void wait() noexcept {
+            for (TaskHandle const &task : m_tasks)
+                task.wait();
+
+            m_tasks.clear();
+        }
+    };
+
+
+    /**
+     * \brief  submits *fn* for asynchronous execution
+     *
+     * \param  [in] fn task function; exceptions escaping it are swallowed
+     * \param  [in] prio priority of the task
+     *
+     * \return handle of the task; invalid if it could not be created
+     */
+    inline TaskHandle SubmitTask(std::function<void()> fn, TaskPriority prio = TaskPriority::Normal) noexcept {
+        try {
+            auto state = std::make_shared<internal::TaskState>(std::move(fn), prio);
+
+            internal::ScheduleTask(state);
+            return TaskHandle{ std::move(state) };
+        } catch (...) { }
+
+        return {};
+    }
+
+    /**
+     * \brief invokes *fn(i)* for all *i* in [0, *n*), distributed over the task scheduler
+     *
+     * The range is split into a few contiguous chunks per worker, which balances uneven iterations
+     * without flooding the queues. The calling thread runs the first chunk and helps with the others
+     * while waiting. Without a scheduler, or with a single worker, the loop runs on the calling
+     * thread.
+     *
+     * \param [in] n number of iterations
+     * \param [in] fn loop body; iterations must be independent of each other
+     * \param [in] prio priority of the chunks
+     *
+     * \throw *std::bad_alloc* if any iteration threw, once all iterations have finished
+     */
+    template<class Fn> void ParallelFor(size_t const n, Fn &&fn, TaskPriority const prio = TaskPriority::High) {
+        size_t const nworkers = std::max<size_t>(1, internal::gl_tasks.nworkers);
+        if (n < 2 || internal::gl_tasks.submit == nullptr || nworkers < 2) {
+            for (size_t i = 0; i < n; ++i)
+                fn(i);
+
+            return;
+        }
+
+        size_t const      nchunks = std::min(n, nworkers * 4);
+        std::atomic<bool> failed(false);
+        auto const        chunk = [&](size_t const c) {
+            try {
+                for (size_t i = n * c / nchunks; i < n * (c + 1) / nchunks; ++i)
+                    fn(i);
+            } catch (...) {
+                failed = true;
+            }
+        };
+
+        std::vector<TaskHandle> tasks;
+        tasks.reserve(nchunks - 1);
+        for (size_t c = 1; c < nchunks; ++c) {
+            TaskHandle task = SubmitTask([&chunk, c]() { chunk(c); }, prio);
+
+            if (task.isValid())
+                tasks.push_back(std::move(task));
+            else
+                chunk(c);
+        }
+        chunk(0);
+
+        for (TaskHandle const &task : tasks)
+            task.wait();
+        if (failed)
+            throw std::bad_alloc();
+    }
+
+
+    /**
+     * \class suzu::sdk::TaskScheduler
+     * \brief work-stealing thread pool; owned by the host application
+     *
+     * Every worker owns one deque per priority. Tasks submitted from a worker are pushed onto its own
+     * deque and popped in LIFO order, which keeps related work on the same core; tasks submitted from
+     * other threads go to a shared injection queue. Idle workers steal the oldest tasks from the other
+     * workers before going to sleep.
+     *
+     * \note  Plug-ins never create a scheduler; they use the host's through *TaskSchedulerInterface*.
+     */
+    class TaskScheduler {
+        /**
+         * \struct suzu::sdk::TaskScheduler::Job
+         * \brief  a queued task, as received through the interface
+         */
+        struct Job {
+            void (*fn)(void *); /**< function to invoke */
+            void  *arg;         /**< argument of *fn* */
+        };
+
+        /**
+         * \struct suzu::sdk::TaskScheduler::Queue
+         * \brief  task deques of a single worker, or of the injection queue
+         */
+        struct Queue {
+            std::mutex      m_lock;                /**< guards *m_jobs* */
+            std::deque<Job> m_jobs[gl_ntaskprios];  /**< queued jobs, by priority */
+        };
+
+        static inline thread_local TaskScheduler *gl_currsched  = nullptr; /**< scheduler owning the current thread */
+        static inline thread_local size_t         gl_currworker = 0;       /**< index of the current worker */
+
+        std::vector<std::unique_ptr<Queue>> m_queues;  /**< one queue per worker */
+        Queue                               m_inject;  /**< tasks submitted from outside the pool */
+        std::mutex                          m_lock;    /**< guards *m_stop* and sleeping */
+        std::condition_variable             m_cond;    /**< signalled when tasks are queued */
+        std::atomic<int64_t>                m_pending; /**< number of queued tasks */
+        bool                                m_stop;    /**< whether or not the workers are to exit */
+        std::vector<std::thread>            m_threads; /**< worker threads */
+
+    public:
+        /**
+         * \brief constructs a new scheduler and starts its workers
+         *
+         * \param [in] nworkers number of worker threads; 0 uses one thread per core
+         */
+        explicit TaskScheduler(uint32_t nworkers = 0)
+            : m_pending(0), m_stop(false)
+        {
+            if (nworkers == 0)
+                nworkers = std::max(1u, std::thread::hardware_concurrency());
+
+            for (uint32_t i = 0; i < nworkers; ++i)
+                m_queues.push_back(std::make_unique<Queue>());
+            for (uint32_t i = 0; i < nworkers; ++i)
+                m_threads.emplace_back([this, i]() { loop(i); });
+        }
+        TaskScheduler(TaskScheduler const &) = delete;
+        TaskScheduler &operator =(TaskScheduler const &) = delete;
+        /**
+         * \brief runs all queued tasks and stops the workers
+         */
+        ~TaskScheduler() {
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+
+                m_stop = true;
+            }
+
+            m_cond.notify_all();
+            for (std::thread &thread : m_threads)
+                thread.join();
+        }
+
+        /**
+         * \brief  retrieves the interface to be passed to *suzu::sdk::InitializeInstanceTasks()*
+         *
+         * \return scheduler interface; valid for the lifetime of the scheduler
+         */
+        TaskSchedulerInterface abi() noexcept {
+            return {
+                TaskSchedulerInterface::gl_version,
+                static_cast<uint32_t>(m_threads.size()),
+                this,
+                [](void *sched, uint32_t prio, void (*fn)(void *), void *arg) { static_cast<TaskScheduler *>(sched)->submit(prio, fn, arg); },
+                [](void *sched) { return static_cast<TaskScheduler *>(sched)->help() ? 1 : 0; }
+            };
+        }
+
+        /**
+         * \brief queues *fn(arg)* for execution
+         *
+         * \param [in] prio priority of the task; out-of-range values are treated as *TaskPriority::Low*
+         * \param [in] fn function to invoke; must not throw
+         * \param [in] arg argument of *fn*
+         */
+        void submit(uint32_t prio, void (*fn)(void *), void *arg) noexcept {
+            Queue &queue = gl_currsched == this ? *m_queues[gl_currworker] : m_inject;
+            prio = std::min<uint32_t>(prio, gl_ntaskprios - 1);
+
+            try {
+                std::lock_guard<std::mutex> lock(queue.m_lock);
+
+                queue.m_jobs[prio].push_back({ fn, arg });
+            } catch (...) {
+                /* Out of memory; running the task right away is better than losing it. */
+                fn(arg);
+
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+
+                ++m_pending;
+            }
+            m_cond.notify_one();
+        }
+
+        /**
+         * \brief  runs one queued task on the calling thread
+         *
+         * \return *true* if a task was run
+         */
+        bool help() noexcept {
+            Job job;
+            if (!take(gl_currsched == this ? gl_currworker : m_queues.size(), job))
+                return false;
+
+            --m_pending;
+            job.fn(job.arg);
+            return true;
+        }
+
+    private:
+        /**
+         * \brief  retrieves the most urgent queued task
+         *
+         * For every priority, the own deque is tried first (newest task), then the injection queue
+         * and finally the deques of the other workers (oldest task).
+         *
+         * \param  [in] self index of the calling worker; out of range for non-worker threads
+         * \param  [out] job receives the task
+         *
+         * \return *true* if a task was found
+         */
+        bool take(size_t const self, Job &job) noexcept {
+            size_t const n = m_queues.size();
+
+            for (size_t prio = 0; prio < gl_ntaskprios; ++prio) {
+                if (self < n) {
+                    Queue &own = *m_queues[self];
+
+                    std::lock_guard<std::mutex> lock(own.m_lock);
+                    if (!own.m_jobs[prio].empty()) {
+                        job = own.m_jobs[prio].back();
+                        own.m_jobs[prio].pop_back();
+
+                        return true;
+                    }
+                }
+
+                for (size_t i = 0; i <= n; ++i) {
+                    Queue &other = i == 0 ? m_inject : *m_queues[(self + i) % n];
+                    if (&other == (self < n ? m_queues[self].get() : nullptr))
+                        continue;
+
+                    std::lock_guard<std::mutex> lock(other.m_lock);
+                    if (!other.m_jobs[prio].empty()) {
+                        job = other.m_jobs[prio].front();
+                        other.m_jobs[prio].pop_front();
+
+                        return true;
+                    }
+                }
+            }
+
+            return false;
+        }
+
+        /**
+         * \brief main loop of a worker
+         *
+         * \param [in] self index of the worker
+         */
+        void loop(size_t const self) noexcept {
+            gl_currsched  = this;
+            gl_currworker = self;
+
+            for (;;) {
+                Job job;
+                if (take(self, job)) {
+                    --m_pending;
+
+                    job.fn(job.arg);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(m_lock);
+                m_cond.wait(lock, [&]() { return m_stop || m_pending > 0; });
+                if (m_stop && m_pending <= 0)
+                    return;
+            }
+        }
+    };
+}
+
+
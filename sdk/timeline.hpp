@@ -0,0 +1,177 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  timeline.hpp
+ * \brief high-resolution timeline of named phases, e.g. for startup tracing
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* external includes */
+#include <sdk/external/json/nlohmann/json.hpp>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+#include <sdk/util.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \class suzu::sdk::Timeline
+     * \brief thread-safe recorder of timed spans
+     *
+     * All timestamps are measured with the steady clock relative to the origin of the timeline,
+     * which is set when the timeline is first used or when *reset()* is called. Recorded spans can
+     * be exported in the Chrome trace event format, which can be viewed with *chrome://tracing*
+     * or *Perfetto*.
+     */
+    class Timeline {
+    public:
+        /**
+         * \struct suzu::sdk::Timeline::Span
+         * \brief  a single recorded span
+         */
+        struct Span {
+            std::string name;   /**< name of the phase */
+            uint32_t    thread; /**< hashed id of the recording thread */
+            int64_t     begin;  /**< start time, in nanoseconds since the origin */
+            int64_t     end;    /**< end time, in nanoseconds since the origin */
+        };
+
+        /**
+         * \class suzu::sdk::Timeline::Scope
+         * \brief records a span covering the lifetime of this object
+         */
+        class Scope {
+            Timeline   *m_timeline; /**< owning timeline */
+            std::string m_name;     /**< name of the span */
+            int64_t     m_begin;    /**< start time */
+
+        public:
+            Scope(Timeline &timeline, std::string name) noexcept
+                : m_timeline(&timeline), m_name(std::move(name)), m_begin(timeline.now())
+            { }
+            Scope(Scope const &) = delete;
+            Scope &operator =(Scope const &) = delete;
+            ~Scope() { m_timeline->record(std::move(m_name), m_begin, m_timeline->now()); }
+        };
+
+    private:
+        mutable std::mutex                    m_lock;   /**< guards *m_spans* and *m_origin* */
+        std::vector<Span>                     m_spans;  /**< recorded spans, in order of completion */
+        std::chrono::steady_clock::time_point m_origin; /**< time point all timestamps are relative to */
+
+    public:
+        Timeline() noexcept
+            : m_origin(std::chrono::steady_clock::now())
+        { }
+
+
+        /**
+         * \brief  retrieves the startup timeline of the current module
+         *
+         * \return reference to the timeline
+         */
+        static Timeline &Startup() noexcept {
+            static Timeline gl_timeline;
+
+            return gl_timeline;
+        }
+
+        /**
+         * \brief discards all spans and moves the origin to the current time
+         */
+        void reset() noexcept {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            m_spans.clear();
+            m_origin = std::chrono::steady_clock::now();
+        }
+
+        /**
+         * \brief  retrieves the current time
+         *
+         * \return nanoseconds since the origin
+         */
+        int64_t now() const noexcept {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_origin).count();
+        }
+
+        /**
+         * \brief records a span on the calling thread
+         *
+         * \param [in] name name of the phase
+         * \param [in] begin start time, as returned by *now()*
+         * \param [in] end end time, as returned by *now()*
+         */
+        void record(std::string name, int64_t const begin, int64_t const end) noexcept {
+            try {
+                uint32_t const thread = static_cast<uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+                std::lock_guard<std::mutex> lock(m_lock);
+                m_spans.push_back({ std::move(name), thread, begin, end });
+            } catch (...) { }
+        }
+
+        /**
+         * \brief  retrieves a copy of all spans recorded so far
+         *
+         * \return recorded spans, in order of completion
+         */
+        std::vector<Span> spans() const {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            return m_spans;
+        }
+
+        /**
+         * \brief  writes all spans to *path* in the Chrome trace event format
+         *
+         * \param  [in] path file path of the trace file; overwritten if it exists
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success
+         */
+        ErrorCode exportChromeTrace(char const *const path) const noexcept {
+            if (path == nullptr)
+                return ErrorCode::InvalidParameter;
+
+            try {
+                nlohmann::json events = nlohmann::json::array();
+                for (Span const &span : spans())
+                    events.push_back({
+                        { "name", span.name },
+                        { "ph",   "X" },
+                        { "pid",  1 },
+                        { "tid",  span.thread },
+                        { "ts",   static_cast<double>(span.begin) / 1000.0 },
+                        { "dur",  static_cast<double>(span.end - span.begin) / 1000.0 }
+                    });
+
+                std::string const trace = nlohmann::json{ { "traceEvents", std::move(events) }, { "displayTimeUnit", "ms" } }.dump();
+                return util::WriteFileAtomic(path, trace.c_str(), trace.length());
+            } catch (...) { }
+
+            return ErrorCode::Unknown;
+        }
+    };
+}
+
+
@@ -0,0 +1,767 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  traceimport.hpp
+ * \brief streaming import of sequence diagrams from traces in the Chrome trace event format
+ *
+ * Traces are read in the form written by *chrome://tracing*, *Perfetto* and Suzu's own profiler
+ * (see *suzu::sdk::Profiler::exportChromeTrace()*):
+ *
+ *     {
+ *         "traceEvents": [
+ *             { "name": "load", "cat": "project", "ph": "B", "pid": 1, "tid": 3, "ts": 10.5 },
+ *             { "name": "parse", "cat": "json", "ph": "X", "pid": 1, "tid": 3, "ts": 11, "dur": 4 },
+ *             { "ph": "E", "pid": 1, "tid": 3, "ts": 20 }
+ *         ]
+ *     }
+ *
+ * A bare array of events is accepted as well, even if it is cut off, as allowed by the format.
+ * Only duration events (*ph* "B", "E" and "X") are used; all others, and keys that are not listed
+ * here, are skipped.
+ *
+ * Every thread and every component is a lifeline. The component of an event is its category
+ * (*cat*), or else the source file the event was recorded in (*args.file*, as written by the
+ * profiler), or else the thread itself. Each event becomes a synchronous call from the component
+ * of the enclosing event (or the thread) to its own component, an activation of the callee and
+ * a reply once it ends.
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/* external includes */
+#include <sdk/external/json/nlohmann/json.hpp>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+#include <sdk/intern.hpp>
+#include <sdk/sequence.hpp>
+#include <sdk/util.hpp>
+
+
+namespace suzu::sdk {
+    /**
+     * \class suzu::sdk::TraceSequenceImporter
+     * \brief SAX handler turning a trace into a sequence diagram while the document is parsed
+     *
+     * No DOM is built; only the duration events of every thread are kept, compactly. Tracers write
+     * events in order of time, but profilers write complete events (*ph* "X") once they end, i.e.
+     * nested calls before the calls enclosing them. The events of every thread are therefore
+     * sorted by time, enclosing events first, once the trace has been read, and the diagram is
+     * then handed over in batches (see *suzu::sdk::SequenceBatch*), so that it can be shown while
+     * the rest is still being built.
+     *
+     * Repeated calls are folded into loops: once the last *p* calls made by a call (or a thread),
+     * *p* being at most *gl_maxperiod*, repeat the *p* calls before them, including everything
+     * they called in turn, the repetition is dropped and a combined fragment is framing the first
+     * iteration instead (see *suzu::sdk::SequenceFragment*). Every further repetition only raises
+     * the number of iterations. To this end, the messages of every thread are held back until more
+     * than *gl_maxpending* are waiting, or until *gl_batchevents* events have been built since the
+     * last batch. An iteration that was partially handed over that way cannot be dropped anymore;
+     * it ends its loop and may start a new one.
+     */
+    class TraceSequenceImporter {
+    public:
+        static constexpr uint32_t gl_maxperiod   = 4;     /**< largest number of calls repeating as a loop body */
+        static constexpr size_t   gl_maxpending  = 4096;  /**< messages held back per thread before they are handed over */
+        static constexpr size_t   gl_batchevents = 16384; /**< events built between two batches */
+
+        /**
+         * \brief receives a batch of the diagram; returns *false* to stop the import
+         *
+         * The batch is cleared after the call, so it may as well be moved from.
+         */
+        using Sink = std::function<bool(SequenceBatch &)>;
+
+    private:
+        /**
+         * \enum  suzu::sdk::TraceSequenceImporter::State
+         * \brief position of the parser in the document
+         */
+        enum class State {
+            Root,     /**< before the document */
+            Document, /**< in the document object */
+            Events,   /**< in the *traceEvents* array */
+            Event,    /**< in an event object */
+            Args,     /**< in the *args* object of an event */
+            Done      /**< after the document */
+        };
+
+        /**
+         * \struct suzu::sdk::TraceSequenceImporter::Pending
+         * \brief  values of the event object being read
+         */
+        struct Pending {
+            std::string phase;     /**< phase of the event, e.g. "B" */
+            std::string name;      /**< name of the event */
+            std::string component; /**< category of the event */
+            std::string file;      /**< source file of the event */
+            std::string thread;    /**< process and thread of the event, as "pid.tid" */
+            std::string pid;       /**< process of the event */
+            std::string tid;       /**< thread of the event */
+            double      ts;        /**< time stamp, in microseconds */
+            double      dur;       /**< duration, in microseconds; negative if not given */
+            bool        hasts;     /**< whether or not *ts* was given */
+        };
+
+        /**
+         * \struct suzu::sdk::TraceSequenceImporter::Event
+         * \brief  duration event, as kept until the thread is built
+         */
+        struct Event {
+            double   ts;       /**< time stamp, in microseconds */
+            double   end;      /**< end of a complete event; infinity for "B" events and NaN for "E" events */
+            uint32_t lifeline; /**< component called; unused for "E" events */
+            StringId name;     /**< name of the call; unused for "E" events */
+        };
+
+        /**
+         * \struct suzu::sdk::TraceSequenceImporter::Mark
+         * \brief  position in the messages, activations and fragments produced by a thread
+         */
+        struct Mark {
+            size_t messages;    /**< number of messages */
+            size_t activations; /**< number of activations */
+            size_t fragments;   /**< number of fragments */
+        };
+
+        /**
+         * \struct suzu::sdk::TraceSequenceImporter::Call
+         * \brief  completed call, as remembered by its caller to detect repetitions
+         */
+        struct Call {
+            uint64_t hash;   /**< signature of the call and everything it called */
+            uint64_t before; /**< signature of the caller before the call */
+            Mark     mark;   /**< position of the call message */
+            double   begin;  /**< time of the call message */
+            double   end;    /**< time of the reply */
+            uint32_t first;  /**< leftmost lifeline involved */
+            uint32_t last;   /**< rightmost lifeline involved */
+        };
+
+        /**
+         * \struct suzu::sdk::TraceSequenceImporter::Frame
+         * \brief  open call of a thread
+         *
+         * While a loop is running, *calls* holds its body; otherwise the most recent calls made.
+         */
+        struct Frame {
+            uint32_t          lifeline;   /**< callee */
+            uint32_t          caller;     /**< caller */
+            double            begin;      /**< time of the call message */
+            double            end;        /**< end of a complete event; infinity if the end is still to come */
+            Mark              mark;       /**< position of the call message */
+            uint64_t          hash;       /**< signature of the call and the calls made so far */
+            uint32_t          first;      /**< leftmost lifeline involved so far */
+            uint32_t          last;       /**< rightmost lifeline involved so far */
+            std::vector<Call> calls;      /**< loop body or recent calls */
+            uint32_t          period;     /**< number of calls in the loop body; 0 if no loop is running */
+            uint32_t          phase;      /**< calls of the current iteration read so far */
+            uint32_t          iterations; /**< iterations of the loop so far */
+            Mark              iteration;  /**< position of the current iteration */
+            uint64_t          restore;    /**< signature to restore when dropping the current iteration */
+        };
+
+        /**
+         * \struct suzu::sdk::TraceSequenceImporter::Thread
+         * \brief  state of a traced thread
+         */
+        struct Thread {
+            std::vector<Event> events;  /**< duration events read, in order of arrival */
+            std::vector<Frame> stack;   /**< open calls; the first frame is the thread itself */
+            size_t             depth;   /**< number of frames in use; frames beyond are kept for reuse */
+            double             last;    /**< latest time stamp of the thread */
+            SequenceBatch      pending; /**< entries held back */
+            Mark               base;    /**< entries handed over so far */
+        };
+
+        static constexpr size_t gl_nodepth = 0; /**< *Thread::depth* of a thread that has not been set up yet */
+
+        Sink                                      m_sink;      /**< receives the batches */
+        size_t                                    m_size;      /**< size of the document, in bytes */
+        State                                     m_state;     /**< current position */
+        bool                                      m_bare;      /**< whether or not the document is a bare array of events */
+        uint32_t                                  m_skip;      /**< nesting depth within a skipped value; 0 if not skipping */
+        std::string                               m_key;       /**< key of the current value */
+        Pending                                   m_event;     /**< event being read */
+        std::unordered_map<std::string, uint32_t> m_lifelines; /**< lifelines, by name */
+        std::unordered_map<std::string, Thread>   m_threads;   /**< threads, by "pid.tid" */
+        SequenceBatch                             m_batch;     /**< entries to hand over next */
+        size_t                                    m_events;    /**< events read since the last batch */
+        bool                                      m_stopped;   /**< whether or not the sink stopped the import */
+        std::string                               m_error;     /**< description of the first error */
+
+    public:
+        /**
+         * \brief constructs a new importer
+         *
+         * \param [in] sink receives the batches
+         * \param [in] size size of the document, in bytes, to accept bare arrays of events that are
+         *            cut off; 0 if unknown
+         */
+        explicit TraceSequenceImporter(Sink sink, size_t const size = 0) noexcept
+            : m_sink(std::move(sink)), m_size(size), m_state(State::Root), m_bare(false), m_skip(0), m_event{ {}, {}, {}, {}, {}, {}, {}, 0.0, -1.0, false }, m_events(0), m_stopped(false)
+        { }
+
+        /**
+         * \brief  builds the diagram and hands it over, once the whole document has been read
+         *
+         * Calls without end are ended at the latest time stamp of their thread.
+         *
+         * \return *true* on success
+         * \throw  std::bad_alloc
+         */
+        bool finish() {
+            if (m_state != State::Done)
+                return fail("incomplete document");
+
+            for (auto &[key, thread] : m_threads) {
+                /* Ends go before begins at the same time; enclosing calls begin before the calls they enclose. */
+                std::stable_sort(thread.events.begin(), thread.events.end(), [](Event const &a, Event const &b) {
+                    if (a.ts != b.ts)
+                        return a.ts < b.ts;
+
+                    return std::isnan(a.end) ? !std::isnan(b.end) : !std::isnan(b.end) && a.end > b.end;
+                });
+
+                for (Event const &event : thread.events)
+                    if (!build(thread, event))
+                        return false;
+                thread.events = std::vector<Event>();
+
+                while (thread.depth > 1)
+                    end(thread, std::isinf(thread.stack[thread.depth - 1].end) ? thread.last : thread.stack[thread.depth - 1].end);
+
+                endLoop(thread, thread.stack[0]);
+                flush(thread);
+            }
+            return deliver();
+        }
+
+        bool               stopped() const noexcept { return m_stopped; }
+        std::string const &error() const noexcept   { return m_error; }
+
+        /*
+         * SAX interface, see *nlohmann::json_sax*. Returning *false* stops the parser.
+         */
+        bool null() { return scalar(); }
+        bool boolean(bool) { return scalar(); }
+        bool number_integer(nlohmann::json::number_integer_t const value) {
+            return number(static_cast<double>(value), std::to_string(value));
+        }
+        bool number_unsigned(nlohmann::json::number_unsigned_t const value) {
+            return number(static_cast<double>(value), std::to_string(value));
+        }
+        bool number_float(nlohmann::json::number_float_t const value, nlohmann::json::string_t const &) {
+            return number(value, {});
+        }
+        bool string(nlohmann::json::string_t &value) {
+            if (m_skip != 0)
+                return true;
+
+            if (m_state == State::Args) {
+                if (m_key == "file")
+                    m_event.file = std::move(value);
+                return true;
+            } else if (m_state != State::Event)
+                return scalar();
+
+            if (m_key == "ph")
+                m_event.phase = std::move(value);
+            else if (m_key == "name")
+                m_event.name = std::move(value);
+            else if (m_key == "cat")
+                m_event.component = std::move(value);
+            else if (m_key == "pid")
+                m_event.pid = std::move(value);
+            else if (m_key == "tid")
+                m_event.tid = std::move(value);
+            return true;
+        }
+        bool binary(nlohmann::json::binary_t &) { return scalar(); }
+
+        bool start_object(std::size_t) {
+            if (m_skip != 0) {
+                ++m_skip;
+
+                return true;
+            }
+
+            switch (m_state) {
+                case State::Root:
+                    m_state = State::Document;
+                    return true;
+                case State::Events:
+                    m_event = { {}, {}, {}, {}, {}, {}, {}, 0.0, -1.0, false };
+                    m_state = State::Event;
+                    return true;
+                case State::Event:
+                    if (m_key == "args")
+                        m_state = State::Args;
+                    else
+                        m_skip = 1;
+                    return true;
+                case State::Document:
+                case State::Args:
+                    m_skip = 1;
+                    return true;
+                default:
+                    return fail("unexpected object");
+            }
+        }
+        bool end_object() {
+            if (m_skip != 0) {
+                --m_skip;
+
+                return true;
+            }
+
+            switch (m_state) {
+                case State::Document:
+                    m_state = State::Done;
+                    return true;
+                case State::Args:
+                    m_state = State::Event;
+                    return true;
+                default:
+                    m_state = State::Events;
+                    return process();
+            }
+        }
+        bool start_array(std::size_t) {
+            if (m_skip != 0) {
+                ++m_skip;
+
+                return true;
+            }
+
+            if (m_state == State::Root || (m_state == State::Document && m_key == "traceEvents")) {
+                m_bare  = m_state == State::Root;
+                m_state = State::Events;
+            }
+            else if (m_state == State::Document || m_state == State::Event || m_state == State::Args)
+                m_skip = 1;
+            else
+                return fail("unexpected array");
+            return true;
+        }
+        bool end_array() {
+            if (m_skip != 0) {
+                --m_skip;
+
+                return true;
+            }
+
+            m_state = m_bare ? State::Done : State::Document;
+            return true;
+        }
+        bool key(nlohmann::json::string_t &key) {
+            if (m_skip == 0)
+                m_key = std::move(key);
+
+            return true;
+        }
+        bool parse_error(std::size_t const position, std::string const &, nlohmann::json::exception const &ex) {
+            if (m_bare && m_state == State::Events && m_skip == 0 && m_size != 0 && position >= m_size) {
+                m_state = State::Done;
+
+                return false;
+            }
+
+            return fail(ex.what());
+        }
+
+    private:
+        /**
+         * \brief  handles a number
+         *
+         * \param  [in] value value of the number
+         * \param  [in] text number as an id of a process or thread; empty if it is not an integer
+         *
+         * \return *true* to continue parsing
+         * \throw  std::bad_alloc
+         */
+        bool number(double const value, std::string text) {
+            if (m_skip != 0 || m_state == State::Args)
+                return true;
+            else if (m_state != State::Event)
+                return scalar();
+
+            if (m_key == "ts") {
+                m_event.ts    = value;
+                m_event.hasts = true;
+            } else if (m_key == "dur")
+                m_event.dur = std::max(value, 0.0);
+            else if (m_key == "pid")
+                m_event.pid = text.empty() ? std::to_string(value) : std::move(text);
+            else if (m_key == "tid")
+                m_event.tid = text.empty() ? std::to_string(value) : std::move(text);
+            return true;
+        }
+
+        /**
+         * \brief  handles a value that is not used
+         *
+         * \return *true* if the value may be skipped at the current position
+         */
+        bool scalar() {
+            return m_skip != 0 || m_state == State::Document || m_state == State::Event || m_state == State::Args || fail("unexpected value");
+        }
+
+        /**
+         * \brief  records an error
+         *
+         * \param  [in] error description of the error
+         *
+         * \return *false*, to stop the parser
+         */
+        bool fail(std::string error) {
+            if (m_error.empty())
+                m_error = std::move(error);
+
+            return false;
+        }
+
+
+        /**
+         * \brief  keeps the event that has just been read with its thread
+         *
+         * \return *true* to continue parsing
+         * \throw  std::bad_alloc
+         */
+        bool process() {
+            bool const begin = m_event.phase == "B" || m_event.phase == "X";
+            if (!begin && m_event.phase != "E")
+                return true;
+            else if (!m_event.hasts)
+                return fail("duration event without time stamp");
+
+            Thread &t = thread();
+            t.last           = std::max(t.last, m_event.ts);
+            t.stack[0].begin = std::min(t.stack[0].begin, m_event.ts);
+
+            if (begin) {
+                std::string_view const component = !m_event.component.empty() ? m_event.component : !m_event.file.empty() ? m_event.file : std::string_view(m_event.thread);
+                double const           until     = m_event.phase == "X" && m_event.dur >= 0.0 ? m_event.ts + m_event.dur : std::numeric_limits<double>::infinity();
+
+                t.events.push_back({ m_event.ts, until, lifeline(component), StringId(m_event.name) });
+            } else
+                t.events.push_back({ m_event.ts, std::numeric_limits<double>::quiet_NaN(), 0, {} });
+            return true;
+        }
+
+        /**
+         * \brief  adds an event to the diagram of its thread, in order of time
+         *
+         * \param  [in,out] t thread of the event
+         * \param  [in] event the event
+         *
+         * \return *false* if the sink stopped the import
+         * \throw  std::bad_alloc
+         */
+        bool build(Thread &t, Event const &event) {
+            /* Complete events have ended once their thread has moved past them. */
+            while (t.depth > 1 && t.stack[t.depth - 1].end <= event.ts)
+                end(t, t.stack[t.depth - 1].end);
+
+            if (!std::isnan(event.end))
+                call(t, event.lifeline, event.name, event.ts, event.end);
+            else if (t.depth > 1 && std::isinf(t.stack[t.depth - 1].end))
+                end(t, event.ts);
+
+            if (t.pending.messages.size() > gl_maxpending)
+                flush(t);
+            if (++m_events < gl_batchevents)
+                return true;
+
+            flush(t);
+            return deliver();
+        }
+
+        /**
+         * \brief  retrieves the thread of the current event, setting it up on first use
+         *
+         * \return the thread
+         * \throw  std::bad_alloc
+         */
+        Thread &thread() {
+            m_event.thread = m_event.pid + "." + m_event.tid;
+
+            Thread &t = m_threads[m_event.thread];
+            if (t.depth == gl_nodepth) {
+                uint32_t const self = lifeline("thread " + m_event.thread);
+
+                t.stack.push_back(Frame{ self, self, m_event.ts, std::numeric_limits<double>::infinity(), {}, 0, self, self, {}, 0, 0, 0, {}, 0 });
+                t.depth = 1;
+                t.last  = m_event.ts;
+                t.base  = {};
+            }
+            return t;
+        }
+
+        /**
+         * \brief  retrieves a lifeline, adding it on first use
+         *
+         * \param  [in] name name of the lifeline
+         *
+         * \return index of the lifeline
+         * \throw  std::bad_alloc
+         */
+        uint32_t lifeline(std::string_view const name) {
+            auto const [it, added] = m_lifelines.try_emplace(std::string(name), static_cast<uint32_t>(m_lifelines.size()));
+            if (added)
+                m_batch.lifelines.push_back(StringId(name));
+
+            return it->second;
+        }
+
+        static Mark MarkOf(Thread const &t) noexcept {
+            return { t.base.messages + t.pending.messages.size(), t.base.activations + t.pending.activations.size(), t.base.fragments + t.pending.fragments.size() };
+        }
+
+        /**
+         * \brief opens a call
+         *
+         * \param [in,out] t thread making the call
+         * \param [in] callee lifeline called
+         * \param [in] name name of the call
+         * \param [in] begin time of the call
+         * \param [in] end end of a complete event; infinity if the end is still to come
+         * \throw std::bad_alloc
+         */
+        void call(Thread &t, uint32_t const callee, StringId const name, double const begin, double const end) {
+            uint32_t const caller = t.stack[t.depth - 1].lifeline;
+            Mark const     mark   = MarkOf(t);
+
+            t.pending.messages.push_back({ begin, caller, callee, MessageKind::Sync, name });
+            if (t.depth == t.stack.size())
+                t.stack.emplace_back();
+
+            uint32_t const id[] = { callee, name.value() };
+            Frame         &f    = t.stack[t.depth++];
+            f.lifeline   = callee;
+            f.caller     = caller;
+            f.begin      = begin;
+            f.end        = end;
+            f.mark       = mark;
+            f.hash       = util::HashBytes(reinterpret_cast<char const *>(id), sizeof(id));
+            f.first      = std::min(caller, callee);
+            f.last       = std::max(caller, callee);
+            f.period     = 0;
+            f.phase      = 0;
+            f.iterations = 0;
+            f.calls.clear();
+        }
+
+        /**
+         * \brief ends the innermost open call of a thread
+         *
+         * \param [in,out] t thread
+         * \param [in] time time of the reply
+         * \throw std::bad_alloc
+         */
+        void end(Thread &t, double const time) {
+            Frame &f = t.stack[--t.depth];
+            endLoop(t, f);
+
+            t.pending.activations.push_back({ f.lifeline, f.begin, time });
+            t.pending.messages.push_back({ time, f.lifeline, f.caller, MessageKind::Reply, {} });
+
+            returned(t, t.stack[t.depth - 1], { f.hash, 0, f.mark, f.begin, time, f.first, f.last });
+        }
+
+        /**
+         * \brief  drops the entries of a thread from a position on
+         *
+         * \param  [in,out] t thread
+         * \param  [in] mark first entry to drop
+         *
+         * \return *false* if some of the entries have been handed over already; nothing is dropped then
+         */
+        static bool Drop(Thread &t, Mark const &mark) noexcept {
+            if (mark.messages < t.base.messages || mark.activations < t.base.activations || mark.fragments < t.base.fragments)
+                return false;
+
+            t.pending.messages.resize(mark.messages - t.base.messages);
+            t.pending.activations.resize(mark.activations - t.base.activations);
+            t.pending.fragments.resize(mark.fragments - t.base.fragments);
+            return true;
+        }
+
+        /**
+         * \brief records a completed call with its caller, folding repetitions into loops
+         *
+         * \param [in,out] t thread
+         * \param [in,out] f caller
+         * \param [in] c completed call
+         * \throw std::bad_alloc
+         */
+        void returned(Thread &t, Frame &f, Call c) {
+            f.first  = std::min(f.first, c.first);
+            f.last   = std::max(f.last, c.last);
+            c.before = f.hash;
+            f.hash   = util::HashBytes(reinterpret_cast<char const *>(&c.hash), sizeof(c.hash), f.hash);
+
+            if (f.period != 0) {
+                if (c.hash == f.calls[f.phase].hash) {
+                    if (f.phase == 0)
+                        f.iteration = c.mark;
+                    if (++f.phase < f.period)
+                        return;
+
+                    /* A full iteration has been read. */
+                    f.phase = 0;
+                    if (Drop(t, f.iteration)) {
+                        f.hash = f.restore;
+                        ++f.iterations;
+
+                        return;
+                    }
+                }
+
+                endLoop(t, f);
+            }
+
+            if (f.calls.size() == 2 * gl_maxperiod)
+                f.calls.erase(f.calls.begin());
+            f.calls.push_back(c);
+
+            size_t const n = f.calls.size();
+            for (uint32_t p = 1; p <= gl_maxperiod && 2 * p <= n; ++p) {
+                bool repeated = true;
+                for (uint32_t i = 0; i < p && repeated; ++i)
+                    repeated = f.calls[n - p + i].hash == f.calls[n - 2 * p + i].hash;
+
+                if (repeated && Drop(t, f.calls[n - p].mark)) {
+                    f.hash = f.calls[n - p].before;
+                    f.calls.erase(f.calls.end() - p, f.calls.end());
+                    f.calls.erase(f.calls.begin(), f.calls.end() - p);
+
+                    f.period     = p;
+                    f.phase      = 0;
+                    f.iterations = 2;
+                    f.restore    = f.hash;
+                    return;
+                }
+            }
+        }
+
+        /**
+         * \brief ends the loop running in a call, if any, adding its fragment
+         *
+         * \param [in,out] t thread
+         * \param [in,out] f call
+         * \throw std::bad_alloc
+         */
+        void endLoop(Thread &t, Frame &f) {
+            if (f.period == 0)
+                return;
+
+            SequenceFragment fragment = { f.lifeline, f.lifeline, f.iterations, f.calls.front().begin, f.calls[f.period - 1].end };
+            for (uint32_t i = 0; i < f.period; ++i) {
+                fragment.first = std::min(fragment.first, f.calls[i].first);
+                fragment.last  = std::max(fragment.last, f.calls[i].last);
+            }
+            t.pending.fragments.push_back(fragment);
+
+            /* The calls of an unfinished iteration are kept; only the body is forgotten. */
+            f.period = 0;
+            f.phase  = 0;
+            f.calls.clear();
+        }
+
+        /**
+         * \brief moves all entries held back by a thread to the next batch
+         *
+         * \param [in,out] t thread
+         * \throw std::bad_alloc
+         */
+        void flush(Thread &t) {
+            m_batch.messages.insert(m_batch.messages.end(), t.pending.messages.begin(), t.pending.messages.end());
+            m_batch.activations.insert(m_batch.activations.end(), t.pending.activations.begin(), t.pending.activations.end());
+            m_batch.fragments.insert(m_batch.fragments.end(), t.pending.fragments.begin(), t.pending.fragments.end());
+
+            t.base = MarkOf(t);
+            t.pending.clear();
+        }
+
+        /**
+         * \brief  hands the next batch over to the sink
+         *
+         * \return *false* if the sink stopped the import
+         */
+        bool deliver() {
+            m_events = 0;
+            if (m_batch.empty())
+                return true;
+
+            m_stopped = !m_sink(m_batch);
+            m_batch.clear();
+            return !m_stopped;
+        }
+    };
+
+
+    /**
+     * \brief  imports a sequence diagram from a trace, streaming it from a mapping of the file
+     *
+     * \param  [in] path path of the trace
+     * \param  [in] sink receives the diagram in batches, on the calling thread
+     * \param  [out] error (optional) receives a description of the error, if any
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::OpenFile* if the file
+     *         could not be opened, *suzu::sdk::ErrorCode::ReadFile* if it is not a valid trace,
+     *         *suzu::sdk::ErrorCode::NoOperation* if *sink* stopped the import, or
+     *         *suzu::sdk::ErrorCode::CriticalResource* if memory ran out; batches delivered before
+     *         an error remain valid
+     */
+    inline ErrorCode ImportTraceSequence(char const *const path, TraceSequenceImporter::Sink sink, std::string *const error = nullptr) noexcept {
+        try {
+            util::MappedFile file;
+            ErrorCode const  err = util::MapFile(path, file);
+            if (err != ErrorCode::Ok) {
+                if (error != nullptr)
+                    *error = "could not read file";
+
+                return err;
+            }
+
+            /* Cut off arrays stop the parser, but are complete for the importer. */
+            TraceSequenceImporter importer(std::move(sink), file.size());
+            nlohmann::json::sax_parse(file.data(), file.data() + file.size(), &importer);
+            if (importer.stopped())
+                return ErrorCode::NoOperation;
+            else if (importer.finish())
+                return ErrorCode::Ok;
+            else if (importer.stopped())
+                return ErrorCode::NoOperation;
+
+            if (error != nullptr)
+                *error = importer.error();
+            return ErrorCode::ReadFile;
+        } catch (...) { }
+
+        return ErrorCode::CriticalResource;
+    }
+}
+
+
@@ -16,9 +16,30 @@
 #pragma once
 
 /* stdlib includes */
+#include <deque>
+#include <mutex>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 #include <fstream>
 #include <sstream>
+#include <streambuf>
+#include <filesystem>
+#include <functional>
+#include <string_view>
+#include <condition_variable>
+
+#if defined _WIN32
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+/* external includes */
+#include <QFile>
 
 /* sdk includes */
 #include <sdk/error.hpp>
@@ -32,6 +53,28 @@
 namespace suzu::sdk::util {
     using FileBuffer = std::vector<char>; /**< used for result/input values of file I/O operations */
 
+    static constexpr uint64_t gl_hashseed = 0xCBF29CE484222325; /**< initial value of *HashBytes()* */
+
+
+    /**
+     * \brief  computes the 64-bit FNV-1a hash of the given bytes
+     *
+     * The hash can be computed incrementally by passing the result of the previous call as *hash*.
+     *
+     * \param  [in] data bytes to hash
+     * \param  [in] len number of bytes
+     * \param  [in] hash hash of the preceding bytes, or *gl_hashseed*
+     *
+     * \return updated hash
+     * \note   The hash is not cryptographically secure; it is only suited to detect changes.
+     */
+    constexpr uint64_t HashBytes(char const *data, size_t const len, uint64_t hash = gl_hashseed) noexcept {
+        for (size_t i = 0; i < len; ++i)
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001B3;
+
+        return hash;
+    }
+
 
     /**
      * \brief   reads the file at the given file path
@@ -56,12 +99,26 @@ namespace suzu::sdk::util {
 
         try {
             /* Open file stream. */
-            std::fstream stream(path, std::ios_base::in | (binary ? std::ios_base::binary : 0));
+            std::fstream stream(path, std::ios_base::in | (binary ? std::ios_base::binary : std::ios_base::openmode{}));
             if (stream.fail())
                 return ErrorCode::OpenFile;
 
-            /* Read file contents into buffer. */
-            result.assign(std::istreambuf_iterator<char>(stream), {});
+            /*
+             * Allocate the buffer exactly once, based on the file size, and read the file in bulk.
+             * In text mode, line-break transformations may cause fewer bytes to be read than the
+             * file size, so the buffer is shrunk to the actual number of bytes afterwards.
+             */
+            std::error_code ec;
+            uintmax_t const size = std::filesystem::file_size(path, ec);
+            if (ec)
+                return ErrorCode::ReadFile;
+
+            result.resize(static_cast<size_t>(size) + (binary ? 0 : 1));
+            stream.read(result.data(), static_cast<std::streamsize>(size));
+            if (stream.bad())
+                throw std::ios_base::failure("read error");
+
+            result.resize(static_cast<size_t>(stream.gcount()));
             if (!binary)
                 result.push_back('\0');
 
@@ -75,6 +132,170 @@ namespace suzu::sdk::util {
         return ErrorCode::Ok;
     }
 
+    /**
+     * \brief  reads the file at the given file path into a new buffer
+     *
+     * \param  [in] path file path of the file that is to be read
+     * \param  [in] binary whether or not to read the file in binary mode
+     *
+     * \return the file contents, or the error of the out-parameter overload above
+     * \note   The overload above reuses the capacity of an existing buffer; prefer it for reading
+     *         many files in a row.
+     */
+    inline Result<FileBuffer> ReadFile(char const *const path, bool binary = false) noexcept {
+        FileBuffer      res;
+        ErrorCode const err = ReadFile(path, res, binary);
+        if (err != ErrorCode::Ok)
+            return err;
+
+        return res;
+    }
+
+
+    /**
+     * \class suzu::sdk::util::MappedFile
+     * \brief read-only memory mapping of a file
+     *
+     * The mapping is owned by this object and released when it is destroyed. Mapped files are
+     * always mapped in binary form; no line-break transformations are performed.
+     *
+     * \note  Views into the mapping are valid for as long as this object exists. Modifying the
+     *        underlying file while it is mapped yields undefined contents.
+     */
+    class MappedFile {
+        std::unique_ptr<QFile> m_file; /**< underlying file; owns the mapping */
+        char const            *m_data; /**< pointer to the beginning of the mapping */
+        size_t                 m_size; /**< size of the mapping, in bytes */
+
+    public:
+        MappedFile() noexcept
+            : m_data(nullptr), m_size(0)
+        { }
+        /**
+         * \brief takes over the mapping of another object, leaving it closed
+         *
+         * \param [in,out] other object to take the mapping from
+         */
+        MappedFile(MappedFile &&other) noexcept
+            : m_file(std::move(other.m_file)), m_data(other.m_data), m_size(other.m_size)
+        {
+            other.m_data = nullptr;
+            other.m_size = 0;
+        }
+        /**
+         * \brief releases the own mapping and takes over the mapping of another object, leaving it
+         *        closed
+         *
+         * \param [in,out] other object to take the mapping from
+         */
+        MappedFile &operator =(MappedFile &&other) noexcept {
+            if (this != &other) {
+                close();
+
+                m_file       = std::move(other.m_file);
+                m_data       = other.m_data;
+                m_size       = other.m_size;
+                other.m_data = nullptr;
+                other.m_size = 0;
+            }
+
+            return *this;
+        }
+
+
+        /**
+         * \brief  retrieves whether or not a file is currently mapped
+         * 
+         * \return *true* if the object holds a mapping
+         * \note   Empty files are never mapped, but are considered open.
+         */
+        bool isOpen() const noexcept { return m_file != nullptr; }
+        /**
+         * \brief  retrieves a pointer to the first byte of the mapping
+         * 
+         * \return pointer to the mapped data; may be *nullptr* if the file is empty
+         */
+        char const *data() const noexcept { return m_data; }
+        /**
+         * \brief  retrieves the size of the mapping
+         * 
+         * \return number of mapped bytes
+         */
+        size_t size() const noexcept { return m_size; }
+        /**
+         * \brief  retrieves a view on the mapped bytes
+         * 
+         * \return view on the entire mapping
+         */
+        std::string_view view() const noexcept { return std::string_view{ m_data, m_size }; }
+
+        /**
+         * \brief  maps the file at *path* into memory
+         * 
+         * \param  [in] path file path of the file that is to be mapped
+         * 
+         * \return *suzu::sdk::ErrorCode::Ok* on success
+         * \note   Any previously held mapping is released, even if the function fails.
+         */
+        ErrorCode open(char const *const path) noexcept {
+            close();
+            if (path == nullptr)
+                return ErrorCode::InvalidParameter;
+
+            try {
+                auto file = std::make_unique<QFile>(QString::fromUtf8(path));
+                if (!file->open(QIODevice::ReadOnly))
+                    return ErrorCode::OpenFile;
+
+                qint64 const size = file->size();
+                if (size > 0) {
+                    uchar *mem = file->map(0, size);
+                    if (mem == nullptr)
+                        return ErrorCode::ReadFile;
+
+                    m_data = reinterpret_cast<char const *>(mem);
+                    m_size = static_cast<size_t>(size);
+                }
+
+                m_file = std::move(file);
+            } catch (...) {
+                close();
+
+                return ErrorCode::ReadFile;
+            }
+
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief releases the mapping, if any
+         * 
+         * \note  All views into the mapping are invalidated.
+         */
+        void close() noexcept {
+            m_file.reset();
+            m_data = nullptr;
+            m_size = 0;
+        }
+    };
+
+    /**
+     * \brief   maps the file at the given file path into memory
+     * 
+     * Contrary to *ReadFile()*, the file contents are not copied into a buffer. Pages are loaded on
+     * demand when they are accessed first, and can be shared with other processes mapping the same
+     * file. This is the preferred way of reading large files.
+     * 
+     * \param   [in] path file path of the file that is to be mapped
+     * \param   [out] result reference to a *suzu::sdk::util::MappedFile* that will own the mapping
+     * 
+     * \return  *suzu::sdk::ErrorCode::Ok* on success
+     * \note    The mapped data is not null-terminated.
+     */
+    inline ErrorCode MapFile(char const *const path, MappedFile &result) noexcept {
+        return result.open(path);
+    }
+
     /**
      * \brief   writes *len* bytes from the beginning of *data* into the file at *path*
      * 
@@ -114,6 +335,362 @@ namespace suzu::sdk::util {
 
         return ErrorCode::Ok;
     }
-}
 
 
+    /**
+     * \class suzu::sdk::util::AtomicFile
+     * \brief file that is written to a temporary location and atomically replaces the target
+     *
+     * All data is written to *<path>.tmp*. Only when *commit()* is called, the temporary file is
+     * renamed to *path*, replacing the previous file in a single step. If the application crashes
+     * before that, or if the object is destroyed without being committed, the previous file
+     * remains untouched.
+     *
+     * \note  Two atomic files targeting the same path must not be open at the same time.
+     */
+    class AtomicFile {
+        std::string  m_path;   /**< destination path */
+        std::string  m_tmp;    /**< temporary path */
+        std::FILE   *m_handle; /**< handle of the temporary file */
+
+    public:
+        AtomicFile() noexcept
+            : m_handle(nullptr)
+        { }
+        AtomicFile(AtomicFile const &) = delete;
+        AtomicFile &operator =(AtomicFile const &) = delete;
+        ~AtomicFile() { discard(); }
+
+
+        /**
+         * \brief  opens the temporary file for the destination *path*
+         * 
+         * \param  [in] path file path of the destination file
+         * \param  [in] binary whether or not to write the data as binary data
+         * 
+         * \return *suzu::sdk::ErrorCode::Ok* on success
+         */
+        ErrorCode open(char const *const path, bool binary = false) noexcept {
+            discard();
+            if (path == nullptr)
+                return ErrorCode::InvalidParameter;
+
+            try {
+                m_path = std::string{ path };
+                m_tmp  = m_path + ".tmp";
+
+                m_handle = std::fopen(m_tmp.c_str(), binary ? "wb" : "w");
+                if (m_handle == nullptr)
+                    return ErrorCode::OpenFile;
+            } catch (...) {
+                return ErrorCode::OpenFile;
+            }
+
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief  retrieves the C stream handle of the temporary file
+         * 
+         * \return stream handle; *nullptr* if the file is not open
+         */
+        std::FILE *handle() const noexcept { return m_handle; }
+
+        /**
+         * \brief  appends *len* bytes from the beginning of *data* to the temporary file
+         * 
+         * \param  [in] data pointer to a buffer of binary data with a size of at least *len* bytes
+         * \param  [in] len number of bytes that are to be written
+         * 
+         * \return *suzu::sdk::ErrorCode::Ok* on success
+         */
+        ErrorCode write(char const *data, size_t len) noexcept {
+            if (m_handle == nullptr)
+                return ErrorCode::InvalidState;
+            else if (data == nullptr && len != 0)
+                return ErrorCode::InvalidParameter;
+
+            return std::fwrite(data, 1, len, m_handle) == len ? ErrorCode::Ok : ErrorCode::WriteFile;
+        }
+
+        /**
+         * \brief  closes the temporary file and moves it to the destination path
+         * 
+         * \param  [in] durable whether or not to flush the file to the storage device before
+         *         renaming it; this guarantees that the new contents survive a power loss, at
+         *         the cost of blocking until the device has finished writing
+         * 
+         * \return *suzu::sdk::ErrorCode::Ok* on success
+         * \note   On failure, the destination file remains untouched.
+         */
+        ErrorCode commit(bool durable = false) noexcept {
+            if (m_handle == nullptr)
+                return ErrorCode::InvalidState;
+
+            bool ok = std::fflush(m_handle) == 0;
+            if (ok && durable)
+#if defined _WIN32
+                ok = _commit(_fileno(m_handle)) == 0;
+#else
+                ok = fsync(fileno(m_handle)) == 0;
+#endif
+            ok = std::fclose(m_handle) == 0 && ok;
+            m_handle = nullptr;
+
+            std::error_code ec;
+            if (ok)
+                std::filesystem::rename(m_tmp, m_path, ec);
+            if (!ok || ec) {
+                std::filesystem::remove(m_tmp, ec);
+
+                return ErrorCode::WriteFile;
+            }
+
+            return ErrorCode::Ok;
+        }
+
+        /**
+         * \brief closes and deletes the temporary file without touching the destination file
+         */
+        void discard() noexcept {
+            if (m_handle == nullptr)
+                return;
+
+            std::fclose(m_handle);
+            m_handle = nullptr;
+
+            std::error_code ec;
+            std::filesystem::remove(m_tmp, ec);
+        }
+    };
+
+    /**
+     * \class suzu::sdk::util::FileStreamBuffer
+     * \brief unbuffered output stream buffer writing to a C stream
+     *
+     * Allows serializers that write to *std::ostream*s to write directly to files opened through
+     * the C stream API, such as *suzu::sdk::util::AtomicFile*. The hash of all bytes written
+     * through the buffer is computed on the fly.
+     *
+     * \note  Buffering is left to the C stream.
+     */
+    class FileStreamBuffer : public std::streambuf {
+        std::FILE *m_handle; /**< destination stream */
+        uint64_t   m_hash;   /**< *HashBytes()* of all bytes written so far */
+
+    public:
+        /**
+         * \brief constructs a new stream buffer
+         *
+         * \param [in] handle destination stream; must stay open for the lifetime of the buffer
+         */
+        explicit FileStreamBuffer(std::FILE *handle) noexcept
+            : m_handle(handle), m_hash(gl_hashseed)
+        { }
+
+
+        /**
+         * \brief  retrieves the hash of all bytes written so far
+         *
+         * \return content hash, as computed by *HashBytes()*
+         */
+        uint64_t hash() const noexcept { return m_hash; }
+
+    protected:
+        std::streamsize xsputn(char const *data, std::streamsize const len) override {
+            if (m_handle == nullptr)
+                return 0;
+
+            size_t const written = std::fwrite(data, 1, static_cast<size_t>(len), m_handle);
+            m_hash = HashBytes(data, written, m_hash);
+
+            return static_cast<std::streamsize>(written);
+        }
+
+        int_type overflow(int_type const ch) override {
+            if (traits_type::eq_int_type(ch, traits_type::eof()))
+                return traits_type::not_eof(ch);
+
+            char const c = traits_type::to_char_type(ch);
+            return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+        }
+    };
+
+    /**
+     * \brief   atomically replaces the file at *path* with *len* bytes from the beginning of *data*
+     * 
+     * Contrary to *WriteFile()*, the file at *path* is never left in a partially written state. Either
+     * the previous contents or the new contents will be present after the function returns, even if the
+     * application crashes while writing.
+     * 
+     * \param   [in] path file path of the file that is to be written
+     * \param   [in] data pointer to a buffer of binary data with a size of at least *len* bytes
+     * \param   [in] len number of bytes that are to be written
+     * \param   [in] binary whether or not to write the data as binary data
+     * \param   [in] durable whether or not to flush the data to the storage device before replacing the
+     *          file (see *suzu::sdk::util::AtomicFile::commit()*)
+     * 
+     * \return  *suzu::sdk::ErrorCode::Ok* on success
+     */
+    inline ErrorCode WriteFileAtomic(char const *const path, char const *data, size_t len, bool binary = false, bool durable = false) noexcept {
+        if (path == nullptr || (data == nullptr && len != 0))
+            return ErrorCode::InvalidParameter;
+
+        AtomicFile file;
+        if (ErrorCode const code = file.open(path, binary); code != ErrorCode::Ok)
+            return code;
+        if (ErrorCode const code = file.write(data, len); code != ErrorCode::Ok)
+            return code;
+
+        return file.commit(durable);
+    }
+
+
+    /**
+     * \namespace suzu::sdk::util::internal
+     * \brief     implementation details of the utility functions
+     */
+    namespace internal {
+        /**
+         * \class suzu::sdk::util::internal::IOThread
+         * \brief background thread executing file I/O requests in submission order
+         *
+         * There is one I/O thread per module (application or plug-in), created on first use. It is
+         * to be stopped by *suzu::sdk::util::ShutdownIO()* before the module is unloaded; joining it
+         * from the destructor instead runs under the loader lock on Windows, which the exiting
+         * thread needs as well. Pending requests are completed before the thread exits.
+         */
+        class IOThread {
+            std::mutex                        m_lock;   /**< guards *m_queue* and *m_stop* */
+            std::condition_variable           m_cond;   /**< signalled when a request is queued */
+            std::deque<std::function<void()>> m_queue;  /**< pending requests */
+            bool                              m_stop;   /**< whether or not the thread is to exit */
+            std::thread                       m_thread; /**< worker thread */
+
+            IOThread()
+                : m_stop(false), m_thread([this]() { loop(); })
+            { }
+
+        public:
+            ~IOThread() { shutdown(); }
+
+            /**
+             * \brief  retrieves the I/O thread of the current module
+             * 
+             * \return reference to the I/O thread
+             */
+            static IOThread &Instance() {
+                static IOThread gl_thread;
+
+                return gl_thread;
+            }
+
+            /**
+             * \brief queues *fn* for execution on the I/O thread
+             * 
+             * \param [in] fn request to execute
+             */
+            void post(std::function<void()> fn) {
+                {
+                    std::lock_guard<std::mutex> lock(m_lock);
+
+                    if (!m_stop) {
+                        m_queue.push_back(std::move(fn));
+                        fn = nullptr;
+                    }
+                }
+
+                /* Requests queued after shutdown are run right away, so that no write is lost. */
+                if (fn)
+                    fn();
+                else
+                    m_cond.notify_one();
+            }
+
+            /**
+             * \brief completes all pending requests and stops the thread
+             *
+             * Requests queued afterwards are executed on the calling thread.
+             *
+             * \note  Must not be called concurrently with itself.
+             */
+            void shutdown() noexcept {
+                {
+                    std::lock_guard<std::mutex> lock(m_lock);
+
+                    m_stop = true;
+                }
+
+                m_cond.notify_one();
+                if (m_thread.joinable())
+                    m_thread.join();
+            }
+
+        private:
+            void loop() {
+                for (;;) {
+                    std::function<void()> fn;
+                    {
+                        std::unique_lock<std::mutex> lock(m_lock);
+                        m_cond.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+
+                        /* Drain all pending requests before exiting. */
+                        if (m_queue.empty())
+                            return;
+
+                        fn = std::move(m_queue.front());
+                        m_queue.pop_front();
+                    }
+
+                    fn();
+                }
+            }
+        };
+    }
+
+    /**
+     * \brief stops the I/O thread of the current module once all pending requests are completed
+     *
+     * The application calls this when it exits, plug-ins before their library is unloaded. Later
+     * requests are executed on the calling thread.
+     */
+    inline void ShutdownIO() noexcept { internal::IOThread::Instance().shutdown(); }
+
+    /**
+     * \brief   writes *data* to the file at *path* on a background thread
+     * 
+     * The buffer is moved to the I/O thread of the current module; the caller does not have to keep
+     * it alive. Requests are executed in submission order, so two writes to the same file will never
+     * overtake each other.
+     * 
+     * \param   [in] path file path of the file that is to be written
+     * \param   [in] data buffer to write; moved into the request
+     * \param   [in] binary whether or not to write the data as binary data
+     * \param   [in] atomic whether or not to replace the file atomically (see *WriteFileAtomic()*)
+     * \param   [in] durable whether or not to flush the data to the storage device; only used if
+     *          *atomic* is *true*
+     * 
+     * \return  future that becomes ready with the result of the write operation
+     * \note    If the request could not be queued, the returned future is immediately ready.
+     */
+    inline std::future<ErrorCode> WriteFileAsync(std::string path, FileBuffer &&data, bool binary = false, bool atomic = true, bool durable = false) noexcept {
+        try {
+            auto task = std::make_shared<std::packaged_task<ErrorCode()>>([path = std::move(path), data = std::move(data), binary, atomic, durable]() {
+                return atomic
+                    ? WriteFileAtomic(path.c_str(), data.data(), data.size(), binary, durable)
+                    : WriteFile(path.c_str(), data.data(), data.size(), binary)
+                ;
+            });
+
+            std::future<ErrorCode> res = task->get_future();
+            internal::IOThread::Instance().post([task]() { (*task)(); });
+
+            return res;
+        } catch (...) { }
+
+        std::promise<ErrorCode> failed;
+        failed.set_value(ErrorCode::Unknown);
+
+        return failed.get_future();
+    }
+}
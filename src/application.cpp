@@ -13,11 +13,30 @@
  */
 
 
+/* stdlib includes */
+#include <algorithm>
+#include <climits>
+
+/* external includes */
+#include <QApplication>
+
 /* sdk includes */
+#include <sdk/eventlog.hpp>
 #include <sdk/log.hpp>
+#include <sdk/sinks.hpp>
+#include <sdk/timeline.hpp>
+#include <sdk/util.hpp>
 
 /* app includes */
 #include <application.hpp>
+#include <autosave.hpp>
+#include <budget.hpp>
+#include <framemonitor.hpp>
+#include <projectsaver.hpp>
+#include <remoteproject.hpp>
+#include <startup.hpp>
+#include <textcache.hpp>
+#include <undo.hpp>
 
 
 namespace suzu {
@@ -29,76 +48,502 @@ namespace suzu {
      * internal functions.
      */
     namespace internal {
+        /**
+         * \brief  checks whether or not a string names a log level
+         *
+         * *spdlog::level::from_str()* maps unknown names to *off*, which would silence logging.
+         *
+         * \param  [in] name name to check, e.g. "warn"
+         *
+         * \return *true* if *name* is accepted by *spdlog::level::from_str()*
+         */
+        static bool IsLogLevel(std::string const &name) noexcept {
+            try {
+                return spdlog::level::from_str(name) != spdlog::level::off || name == "off";
+            } catch (...) { }
+
+            return false;
+        }
+
+        /**
+         * \brief replaces log levels of the global settings that are not level names by their defaults
+         *
+         * \param [in,out] settings global settings
+         * \param [out] errors (optional) receives a message per invalid level
+         */
+        static void ValidateLogLevels(GlobalSettings &settings, std::vector<std::string> *errors = nullptr) noexcept {
+            try {
+                GlobalSettings const defaults;
+
+                struct { char const *key; std::string *value; std::string const *def; } const levels[] = {
+                    { "/log/filelevel",  &settings.logfilelevel,  &defaults.logfilelevel  },
+                    { "/log/flushlevel", &settings.logflushlevel, &defaults.logflushlevel }
+                };
+                for (auto const &level : levels) {
+                    if (IsLogLevel(*level.value))
+                        continue;
+
+                    if (errors != nullptr)
+                        errors->push_back(std::string{ level.key } + ": unknown log level \"" + *level.value + "\", using \"" + *level.def + "\"");
+                    *level.value = *level.def;
+                }
+            } catch (...) { }
+        }
+
         /**
          * \brief  initializes suzu's global loggers
          *
          * This function is called before components are initialized. Loggers will be destroyed
          * after the application instance has been destroyed. Logging is therefore safe throughout
          * the entire lifetime of the application.
+         * The log file is rotated once it reaches the size at "/log/rotatesize" (in MiB), keeping
+         * "/log/rotatefiles" old segments, compressed if "/log/compress" is set; a size of 0
+         * truncates the file on startup instead.
+         * If the configuration enables it (key "/log/ringbuffer" greater than 0), an in-memory ring
+         * buffer sink keeping the most recent messages is added as well. Its contents are written to
+         * the file at "/log/crashdump" if the application crashes.
          *
-         * \param  [in] logfile pointer to a C-string which holds the path of the main logfile
+         * \param  [in] settings global settings
          *
-         * \return 2-tuple of a statically-allocated array holding sink pointers and the number of
-         *         initialized sinks
+         * \return registry referencing the statically-allocated sinks; empty if no sinks could be
+         *         initialized
          * \note   The return value of this function should be passed to plug-ins as well upon invoking
          *         the plugin's initialization function.
          */
-        static std::pair<spdlog::sink_ptr const *, size_t> RetrieveGlobalLoggerSinks(char const *const logfile) noexcept {
-            if (logfile == nullptr || *logfile == '\0')
-                return { nullptr, 0 };
+        static sdk::SinkRegistry RetrieveGlobalLoggerSinks(GlobalSettings const &settings) noexcept {
+            if (settings.logfile.empty())
+                return { sdk::SinkRegistry::gl_version, 0, nullptr };
 
             try {
                 /* Create logger sinks. */
-                static std::vector<spdlog::sink_ptr> const gl_sinks{
-                    std::make_shared<spdlog::sinks::basic_file_sink_mt>(logfile, true),
-                    std::make_shared<spdlog::sinks::ansicolor_stdout_sink_mt>(),
-                };
+                static std::vector<spdlog::sink_ptr> const gl_sinks = [&]() {
+                    /* Keep old log files around in rotated segments, unless rotation is disabled. */
+                    spdlog::sink_ptr file;
+                    if (settings.logrotsize != 0)
+                        file = std::make_shared<sdk::sinks::RotatingFileSink>(settings.logfile, size_t(settings.logrotsize) << 20, settings.logrotfiles, settings.logcompress);
+                    else
+                        file = std::make_shared<spdlog::sinks::basic_file_sink_mt>(settings.logfile, true);
 
-                return { gl_sinks.data(), gl_sinks.size() };
+                    std::vector<spdlog::sink_ptr> sinks{
+                        std::move(file),
+                        std::make_shared<spdlog::sinks::ansicolor_stdout_sink_mt>(),
+                    };
+                    spdlog::level::level_enum const filelvl = spdlog::level::from_str(settings.logfilelevel);
+                    for (spdlog::sink_ptr const &sink : sinks)
+                        sink->set_level(filelvl);
+
+                    /* Optionally keep the most recent messages in memory in case of crashes. */
+                    if (settings.logringbuffer != 0) {
+                        auto ring = std::make_shared<sdk::sinks::RingBufferSink>(settings.logringbuffer);
+
+                        sdk::sinks::RingBufferSink::InstallCrashHandler(ring, settings.logcrashdump.c_str());
+                        sinks.push_back(std::move(ring));
+                    }
+
+                    return sinks;
+                }();
+                static std::vector<spdlog::sinks::sink *> const gl_rawsinks = [&]() {
+                    std::vector<spdlog::sinks::sink *> raw;
+                    for (spdlog::sink_ptr const &sink : gl_sinks)
+                        raw.push_back(sink.get());
+
+                    return raw;
+                }();
+
+                return { sdk::SinkRegistry::gl_version, static_cast<uint32_t>(gl_rawsinks.size()), gl_rawsinks.data() };
             } catch (...) { }
 
-            return { nullptr, 0 };
+            return { sdk::SinkRegistry::gl_version, 0, nullptr };
+        }
+
+        /**
+         * \brief  reads the logger dispatch options from the global settings
+         *
+         * \param  [in] settings global settings
+         *
+         * \return logger options
+         */
+        static sdk::LoggerOptions RetrieveLoggerOptions(GlobalSettings const &settings) noexcept {
+            sdk::LoggerOptions opts;
+
+            opts.async         = settings.logasync;
+            opts.queuesize     = static_cast<size_t>(settings.logqueuesize);
+            opts.flushinterval = settings.logflushintvl;
+            opts.siterate      = settings.logsiterate;
+            opts.siteburst     = settings.logsiteburst;
+            opts.overflow      = settings.logoverflow == "overrun"
+                ? spdlog::async_overflow_policy::overrun_oldest
+                : spdlog::async_overflow_policy::block
+            ;
+
+            try {
+                opts.flushlvl = spdlog::level::from_str(settings.logflushlevel);
+            } catch (...) { }
+
+            return opts;
+        }
+
+        /**
+         * \brief  reads the compression level of project files from the global settings
+         *
+         * \param  [in] settings global settings
+         *
+         * \return compression level; unknown values disable compression
+         */
+        static sdk::Compression RetrieveCompression(GlobalSettings const &settings) noexcept {
+            if (settings.compression == "high")
+                return sdk::Compression::High;
+
+            return settings.compression == "fast" ? sdk::Compression::Fast : sdk::Compression::None;
+        }
+
+        /**
+         * \brief logs the phases of the startup timeline and checks the startup budget
+         *
+         * If configured, the timeline is also exported as a Chrome trace (key "/startup/trace").
+         *
+         * \param [in] settings global settings
+         */
+        static void ReportStartupTimeline(GlobalSettings const &settings) noexcept {
+            try {
+                sdk::Timeline &timeline = sdk::Timeline::Startup();
+
+                std::vector<sdk::Timeline::Span> spans = timeline.spans();
+                std::sort(spans.begin(), spans.end(), [](auto const &lhs, auto const &rhs) { return lhs.begin < rhs.begin; });
+
+                double const total = static_cast<double>(timeline.now()) / 1e6;
+                for (sdk::Timeline::Span const &span : spans)
+                    SZSDK_APP_INFO("Startup phase \"{}\": {:.2f} ms (at {:.2f} ms)", span.name, static_cast<double>(span.end - span.begin) / 1e6, static_cast<double>(span.begin) / 1e6);
+                SZSDK_APP_INFO("Startup finished after {:.2f} ms.", total);
+                Metrics::Local().set(Metrics::Local().add("startup.ms", Metrics::Kind::Gauge), timeline.now() / 1000000);
+
+                if (settings.startupbudget != 0 && total > settings.startupbudget)
+                    SZSDK_APP_WARNING("Startup exceeded its budget of {} ms by {:.2f} ms.", settings.startupbudget, total - settings.startupbudget);
+                if (!settings.startuptrace.empty() && timeline.exportChromeTrace(settings.startuptrace.c_str()) != sdk::ErrorCode::Ok)
+                    SZSDK_APP_WARNING("Could not write startup trace \"{}\".", settings.startuptrace);
+            } catch (...) { }
+        }
+
+        /**
+         * \brief  creates the Qt application object
+         *
+         * \param  [in] argc number of command-line parameters; must outlive the application object
+         * \param  [in] argv command-line parameters
+         * \param  [in] headless whether or not to omit GUI support
+         * \param  [in] job batch job; only used if *headless* is set
+         *
+         * \return *QCoreApplication* if *headless* is set, *QApplication* otherwise
+         * \note   Replaying a session needs widgets even in batch mode; they are shown on the
+         *         offscreen platform then, unless another one is requested.
+         */
+        static std::unique_ptr<QCoreApplication> CreateQtApplication(int &argc, char **argv, bool headless, BatchJob const &job) {
+            if (headless && job.command != "replay")
+                return std::make_unique<QCoreApplication>(argc, argv);
+
+            if (headless && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+                qputenv("QT_QPA_PLATFORM", "offscreen");
+            return std::make_unique<QApplication>(argc, argv);
         }
     }
 
 
     Application::Application(int argc, char **argv)
-        : QApplication(argc, argv), m_cfg(gl_glcfgpath.data(), true)
+        : m_argc(argc),
+          m_headless(BatchJob::Parse(argc, argv, m_job)),
+          m_qapp(internal::CreateQtApplication(m_argc, argv, m_headless, m_job)),
+          m_cfg(gl_glcfgpath.data(), true, sdk::Configuration::BinaryCache),
+          m_plugins(std::string{ gl_plugindir })
     {
-        using namespace std::string_literals;
-
-        /* If global config could not be read, exit the application. */
-        if (!m_cfg.isOk()) {
-            QApplication::exit(sdk::ErrorCode::CriticalResource);
+        /* Constructing the Qt application and loading the configuration happened before this point. */
+        sdk::Timeline::Startup().record("construct", 0, sdk::Timeline::Startup().now());
 
+        /* If global config could not be read, *run()* exits the application. */
+        if (!m_cfg.isOk())
             return;
+
+        /* Validate the configuration once; invalid values are replaced by their defaults. */
+        std::vector<std::string> errors;
+        {
+            sdk::Timeline::Scope const scope(sdk::Timeline::Startup(), "settings");
+
+            m_settings.load(m_cfg.snapshot(), &errors);
+            internal::ValidateLogLevels(m_settings, &errors);
         }
 
         /* Initialize logging facilities. */
-        auto [sinks, len] = internal::RetrieveGlobalLoggerSinks(sdk::JSONCVT::to(m_cfg.getValue("/logfile"), ""s).c_str());
-        if (sinks != nullptr && len != 0) {
-            suzu::sdk::InitializeInstanceLoggers(len, sinks);
+        {
+            sdk::Timeline::Scope const scope(sdk::Timeline::Startup(), "loggers");
 
-            SZSDK_APP_INFO("Successfully initialized application instance.");
+            sdk::SinkRegistry const sinks = internal::RetrieveGlobalLoggerSinks(m_settings);
+            if (sinks.nsinks != 0)
+                suzu::sdk::InitializeInstanceLoggers(sinks, spdlog::level::trace, internal::RetrieveLoggerOptions(m_settings));
         }
+        SZSDK_APP_INFO("Successfully initialized application instance.");
+        for (std::string const &error : errors)
+            SZSDK_APP_WARNING("Invalid configuration value: {}", error);
+
+        /* Record profiling zones of the application and all plug-ins if a trace is requested (key "/profile/trace"). */
+        sdk::Profiler::Local().setEnabled(!m_settings.profiletrace.empty());
+        sdk::Profiler::Local().setRetaining(!m_settings.profiletrace.empty());
+        /* Measure frame times and input latency for the heads-up display (F12; key "/hud/visible"). */
+        if (!m_headless) {
+            m_frames = std::make_unique<FrameMonitor>(m_settings.hudvisible, m_settings.hudtrace);
+            /* Hold back everything the first frame does not show until it has been painted. */
+            m_gate   = std::make_unique<FirstFrameGate>();
+        }
+
+        /* Log the usage of all memory accounts periodically (key "/memory/report", in seconds; 0 disables it). */
+        m_memory = std::make_unique<QTimer>();
+        QObject::connect(m_memory.get(), &QTimer::timeout, m_memory.get(), []() { LogMemoryUsage(); });
+        if (m_settings.memreport != 0)
+            m_memory->start(static_cast<int>(std::min<uint32_t>(m_settings.memreport, INT_MAX / 1000)) * 1000);
+
+        /* Report the progress of background jobs; the job manager must be created on the main thread. */
+        m_jobs = std::make_unique<JobManager>(m_settings.jobrate);
+        m_jobs->setListener([](JobStatus const &status) {
+            static constexpr char const *gl_states[] = { "running", "finished", "failed", "cancelled" };
+
+            SZSDK_APP_DEBUG("Job {} \"{}\" {}: {:.0f}% {}", status.id, status.name, gl_states[status.state], status.progress * 100.0, status.text);
+        });
+
+        /* Cap the memory of all caches together (key "/memory/budget", in MiB); trim them when the system runs low on memory. */
+        MemoryBudget::Shared().setBudget(static_cast<size_t>(m_settings.memorybudget) << 20);
+        m_pressure = std::make_unique<QTimer>();
+        QObject::connect(m_pressure.get(), &QTimer::timeout, m_pressure.get(), []() { MemoryBudget::Shared().poll(); });
+        m_pressure->start(MemoryBudget::gl_pollinterval);
+        /* Optionally cap the label cache shared by all canvases on its own (key "/text/cachesize", in MiB; 0 for no cap). */
+        TextLayoutCache::Shared().setBudget(static_cast<size_t>(m_settings.textcache) << 20);
+        /* Optionally cap the memory of all undo histories on their own (key "/undo/budget", in MiB; 0 for no cap). */
+        UndoStack::SetTotalBudget(static_cast<size_t>(m_settings.undobudget) << 20);
+        /* Fold project journals into their project files once they grow large (key "/project/compact", in MiB). */
+        ProjectSaver::SetCompactionThreshold(static_cast<uint64_t>(m_settings.compactsize) << 20);
+        /* Compress project files (key "/project/compress": "none", "fast" or "high"). */
+        ProjectSaver::SetCompression(internal::RetrieveCompression(m_settings));
+        /* Autosave open projects (keys "/autosave/interval" in seconds, "/autosave/maxsize" in MiB). */
+        AutosaveService::SetInterval(m_settings.autosaveintvl);
+        AutosaveService::SetSizeLimit(static_cast<uint64_t>(m_settings.autosavesize) << 20);
+        /* Cache chunks of remote projects (keys "/remote/cache", "/remote/cachesize" in MiB, "/remote/timeout" in seconds). */
+        RemoteProject::SetCacheDirectory(m_settings.remotecache);
+        RemoteProject::SetCacheLimit(static_cast<uint64_t>(m_settings.remotecachesz) << 20);
+        RemoteProject::SetTimeout(std::min<uint32_t>(m_settings.remotetimeout, UINT32_MAX / 1000) * 1000);
+
+        /* Keep the settings in sync with the configuration. */
+        m_cfg.subscribe("", [this](std::vector<std::string> const &) {
+            m_settings.load(m_cfg.snapshot());
+            internal::ValidateLogLevels(m_settings);
+
+            MemoryBudget::Shared().setBudget(static_cast<size_t>(m_settings.memorybudget) << 20);
+            TextLayoutCache::Shared().setBudget(static_cast<size_t>(m_settings.textcache) << 20);
+            UndoStack::SetTotalBudget(static_cast<size_t>(m_settings.undobudget) << 20);
+            ProjectSaver::SetCompactionThreshold(static_cast<uint64_t>(m_settings.compactsize) << 20);
+            ProjectSaver::SetCompression(internal::RetrieveCompression(m_settings));
+            AutosaveService::SetInterval(m_settings.autosaveintvl);
+            AutosaveService::SetSizeLimit(static_cast<uint64_t>(m_settings.autosavesize) << 20);
+            RemoteProject::SetCacheDirectory(m_settings.remotecache);
+            RemoteProject::SetCacheLimit(static_cast<uint64_t>(m_settings.remotecachesz) << 20);
+            RemoteProject::SetTimeout(std::min<uint32_t>(m_settings.remotetimeout, UINT32_MAX / 1000) * 1000);
+
+            if (m_settings.memreport != 0)
+                m_memory->start(static_cast<int>(std::min<uint32_t>(m_settings.memreport, INT_MAX / 1000)) * 1000);
+            else
+                m_memory->stop();
+        });
     }
 
     Application::~Application() {
+        /* Hiding the display restores the recording state the trace below depends on. */
+        m_frames.reset();
+
+        if (!m_headless && m_cfg.isOk()) {
+            try {
+                sdk::ConfigView view = m_cfg.view("/session");
+                if (m_session.save(view) != sdk::ErrorCode::Ok)
+                    SZSDK_APP_WARNING("Could not save session state.");
+            } catch (...) { }
+        }
+
+        if (m_plugins.profiler().isEnabled())
+            m_plugins.profiler().logReport();
+
+        /* Cancel background jobs, then detach the scheduler; pending tasks are run before the workers exit. */
+        m_jobs.reset();
+        sdk::InitializeInstanceTasks({ sdk::TaskSchedulerInterface::gl_version, 0, nullptr, nullptr, nullptr });
+        m_tasks.reset();
+
+        /* All workers have exited, so every zone has been left. */
+        if (sdk::Profiler::Local().isEnabled()) {
+            sdk::Profiler::Local().setEnabled(false);
+
+            std::string trace;
+            if (sdk::Profiler::Local().exportChromeTrace(trace) != sdk::ErrorCode::Ok || sdk::util::WriteFileAtomic(m_settings.profiletrace.c_str(), trace.c_str(), trace.length()) != sdk::ErrorCode::Ok)
+                SZSDK_APP_WARNING("Could not write profiling trace \"{}\".", m_settings.profiletrace);
+            else if (sdk::Profiler::Local().dropped() != 0)
+                SZSDK_APP_WARNING("Profiling trace \"{}\" lacks {} zones; their threads recorded faster than the trace was collected.", m_settings.profiletrace, sdk::Profiler::Local().dropped());
+        }
+
+        /* Pending writes are completed here rather than when the statics are destroyed. */
+        sdk::util::ShutdownIO();
+        sdk::events::CloseEventLog();
+
         SZSDK_APP_INFO("Shutdown application instance.");
     }
 
 
     bool Application::initialize() noexcept {
-        return true;
+        try {
+            StartupGraph graph;
+
+            /* Start recording telemetry events if requested. */
+            graph.add({ "eventlog", {}, false, [this]() {
+                if (!m_settings.logeventlog.empty() && sdk::events::OpenEventLog(m_settings.logeventlog.c_str()) != sdk::ErrorCode::Ok)
+                    SZSDK_APP_WARNING("Could not open event log \"{}\".", m_settings.logeventlog);
+
+                return true;
+            } });
+            /* Start the task scheduler shared by the application and all plug-ins. */
+            graph.add({ "tasks", {}, false, [this]() {
+                m_tasks = std::make_unique<sdk::TaskScheduler>(m_settings.taskthreads);
+
+                return sdk::InitializeInstanceTasks(m_tasks->abi());
+            } });
+            /* Discover plug-ins from their manifests; libraries are loaded once a capability is first used. */
+            graph.add({ "plugins", { "tasks" }, false, [this]() {
+                m_plugins.setHost({
+                    sdk::PluginHost::gl_version,
+                    internal::RetrieveGlobalLoggerSinks(m_settings),
+                    spdlog::level::trace,
+                    internal::RetrieveLoggerOptions(m_settings),
+                    m_tasks->abi(),
+                    sdk::ArenaInterface::Local(),
+                    sdk::StringTableInterface::Local(),
+                    sdk::ProfilerInterface::Local(),
+                    sdk::MemoryInterface::Local()
+                });
+
+                m_plugins.profiler().setEnabled(m_settings.pluginprofile);
+                m_plugins.setIsolation(m_settings.pluginisolate);
+
+                sdk::ErrorCode const res = m_plugins.scan();
+                if (res != sdk::ErrorCode::Ok && res != sdk::ErrorCode::NoOperation)
+                    SZSDK_APP_WARNING("Could not scan plug-in directory \"{}\" (error {}).", gl_plugindir, static_cast<int>(res));
+
+                return true;
+            } });
+            /* Open the last project of the previous session on a worker, so that its pages are read while the GUI starts. */
+            graph.add({ "session", {}, false, [this]() {
+                if (m_headless)
+                    return true;
+
+                try {
+                    m_session = Session::Load(m_cfg.view("/session"));
+                } catch (...) {
+                    SZSDK_APP_WARNING("Could not read session state.");
+
+                    return true;
+                }
+
+                if (m_settings.sessrestore && !m_session.projects.empty())
+                    m_prefetch = PrefetchProject(m_session.projects.front());
+
+                return true;
+            } });
+            /* Reload the configuration when it is edited on disk, if enabled; watchers live on the main thread. */
+            graph.add({ "configwatch", {}, true, [this]() {
+                if (m_settings.hotreload && !m_headless && m_cfg.watch() != sdk::ErrorCode::Ok)
+                    SZSDK_APP_WARNING("Could not watch configuration file \"{}\".", gl_glcfgpath);
+
+                return true;
+            } });
+
+            /* Accept command-lines of later launches; the server lives on the main thread. */
+            graph.add({ "instance", {}, true, [this]() {
+                if (!m_settings.singleinst || m_headless)
+                    return true;
+
+                sdk::ErrorCode const res = m_instance.listen([](std::vector<std::string> const &args) {
+                    SZSDK_APP_INFO("Received command-line of another launch with {} argument(s).", args.size());
+
+                    for (std::string const &arg : args)
+                        SZSDK_APP_INFO("    {}", arg);
+                });
+                if (res != sdk::ErrorCode::Ok)
+                    SZSDK_APP_WARNING("Could not start single-instance server (error {}).", static_cast<int>(res));
+
+                return true;
+            } });
+
+            return graph.run(*QThreadPool::globalInstance()) == sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return false;
+    }
+
+    void Application::afterFirstFrame(std::function<void()> fn) {
+        if (m_gate != nullptr)
+            m_gate->defer(std::move(fn));
+        else
+            fn();
     }
 
     int Application::run() {
+        if (!m_cfg.isOk())
+            return sdk::ErrorCode::CriticalResource;
+
         /* Initialize main components. */
-        if (!initialize())
-            return -1;
+        {
+            sdk::Timeline::Scope const scope(sdk::Timeline::Startup(), "initialize");
+
+            if (!initialize())
+                return -1;
+        }
+
+        /* Startup is complete once the event loop processes its first event. */
+        QMetaObject::invokeMethod(this, [this, begin = sdk::Timeline::Startup().now()]() {
+            sdk::Timeline::Startup().record("eventloop", begin, sdk::Timeline::Startup().now());
+
+            internal::ReportStartupTimeline(m_settings);
+        }, Qt::QueuedConnection);
+
+        /* Load plug-ins contributing user interface once the first frame is on the screen; batch jobs have none. */
+        if (!m_headless)
+            afterFirstFrame([this]() {
+                try {
+                    for (PluginManifest const &manifest : m_plugins.manifests())
+                        for (std::string const &capability : manifest.capabilities)
+                            if (capability.compare(0, gl_uicapability.size(), gl_uicapability) == 0) {
+                                sdk::ErrorCode const res = m_plugins.acquire(capability);
+                                if (res != sdk::ErrorCode::Ok)
+                                    SZSDK_APP_WARNING("Could not load user interface \"{}\" of plug-in \"{}\" (error {}).", capability, manifest.name, static_cast<int>(res));
+                            }
+                } catch (...) { }
+            });
+
+        /* In batch mode, process the job and exit. */
+        if (m_headless)
+            QMetaObject::invokeMethod(this, [this]() { QCoreApplication::exit(RunBatchJob(m_job, m_cfg, m_settings.batchthreads)); }, Qt::QueuedConnection);
+
+        /* Report stalls of the event loop (key "/watchdog/stall", in milliseconds); batch jobs block the loop on purpose. */
+        if (!m_headless) {
+            m_watchdog = std::make_unique<StallWatchdog>(m_settings.watchdogstall);
+
+            sdk::ErrorCode const res = m_watchdog->start();
+            if (res != sdk::ErrorCode::Ok && res != sdk::ErrorCode::NoOperation)
+                SZSDK_APP_WARNING("Could not start the event-loop watchdog (error {}).", static_cast<int>(res));
+        }
+
+        /* Export metrics for telemetry (keys "/metrics/target" and "/metrics/interval", in seconds); disabled unless a target is set. */
+        m_metrics = std::make_unique<MetricsExporter>(m_settings.metricstarget, m_settings.metricsintvl);
+        sdk::ErrorCode const err = m_metrics->start();
+        if (err != sdk::ErrorCode::Ok && err != sdk::ErrorCode::NoOperation)
+            SZSDK_APP_WARNING("Could not start exporting metrics (error {}).", static_cast<int>(err));
+
+        /* Start main loop and run application; once it has exited, heartbeats stop on purpose. */
+        int const res = QCoreApplication::exec();
 
-        /* Start main loop and run application. */
-        return QApplication::exec();
+        /* The last snapshot includes everything up to the end of the event loop. */
+        m_metrics.reset();
+        m_watchdog.reset();
+        return res;
     }
 }
 
@@ -0,0 +1,213 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  autosave.cpp
+ * \brief implementation of the background autosave service
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <climits>
+#include <filesystem>
+#include <system_error>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/project.hpp>
+
+/* app includes */
+#include <autosave.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \struct suzu::internal::AutosaveDiagram
+         * \brief  snapshot of a diagram, owned by an autosave task
+         */
+        struct AutosaveDiagram {
+            std::string       m_name;  /**< name of the diagram */
+            sdk::ElementStore m_store; /**< elements of the diagram */
+        };
+
+        /**
+         * \brief  combines the revisions of all diagrams into a value that changes with any of them
+         *
+         * \param  [in] diagrams diagrams of the project
+         *
+         * \return fingerprint
+         */
+        static uint64_t Fingerprint(std::vector<ProjectSaver::Diagram> const &diagrams) noexcept {
+            static constexpr uint64_t gl_prime = 1099511628211u;
+
+            uint64_t res = 14695981039346656037u ^ diagrams.size();
+            for (ProjectSaver::Diagram const &diagram : diagrams) {
+                res = (res ^ reinterpret_cast<uintptr_t>(diagram.store)) * gl_prime;
+                res = (res ^ diagram.store->revision()) * gl_prime;
+            }
+
+            return res;
+        }
+
+        /**
+         * \brief  writes the snapshot of a project as a project file
+         *
+         * \param  [in] path path of the autosave file
+         * \param  [in] diagrams snapshots of all diagrams
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or the error of writing the file; the
+         *         previous autosave remains untouched then
+         */
+        static sdk::ErrorCode WriteAutosave(std::string const &path, std::vector<AutosaveDiagram> const &diagrams) noexcept {
+            /* Autosaves are frequent and disposable; favour speed over size. */
+            sdk::ProjectWriter writer;
+            sdk::ErrorCode     err = writer.open(path.c_str(), sdk::Compression::Fast);
+            for (size_t i = 0; i < diagrams.size() && err == sdk::ErrorCode::Ok; ++i)
+                err = writer.addDiagram(diagrams[i].m_name, diagrams[i].m_store);
+
+            return err == sdk::ErrorCode::Ok ? writer.commit() : err;
+        }
+    }
+
+
+    AutosaveService::AutosaveService() noexcept
+        : m_saved(0), m_limited(false)
+    {
+        try {
+            m_timer = std::make_unique<QTimer>();
+
+            m_timer->setSingleShot(true);
+            QObject::connect(m_timer.get(), &QTimer::timeout, m_timer.get(), [this]() { tick(); });
+        } catch (...) { }
+    }
+
+    AutosaveService::~AutosaveService() {
+        stop();
+    }
+
+
+    void AutosaveService::SetInterval(uint32_t seconds) noexcept {
+        gl_interval = seconds;
+    }
+
+    void AutosaveService::SetSizeLimit(uint64_t bytes) noexcept {
+        gl_maxsize = bytes;
+    }
+
+    sdk::ErrorCode AutosaveService::start(std::string path, Source source) noexcept {
+        stop();
+        if (path.empty() || !source)
+            return sdk::ErrorCode::InvalidParameter;
+        if (m_timer == nullptr)
+            return sdk::ErrorCode::CriticalResource;
+
+        try {
+            /* The project has just been opened or saved; there is nothing to recover yet. */
+            m_saved   = internal::Fingerprint(source());
+            m_limited = false;
+            m_path    = std::move(path);
+            m_source  = std::move(source);
+        } catch (...) {
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        m_timer->start(TickInterval());
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode AutosaveService::trigger() noexcept {
+        if (!isRunning())
+            return sdk::ErrorCode::InvalidState;
+        if (isSaving())
+            return sdk::ErrorCode::NoOperation;
+
+        try {
+            std::vector<ProjectSaver::Diagram> const diagrams = m_source();
+
+            uint64_t const fingerprint = internal::Fingerprint(diagrams);
+            if (fingerprint == m_saved)
+                return sdk::ErrorCode::NoOperation;
+
+            uint64_t size = 0;
+            for (ProjectSaver::Diagram const &diagram : diagrams)
+                size += 8 + sdk::internal::gl_projecteltsize * static_cast<uint64_t>(diagram.store->size());
+            if (gl_maxsize != 0 && size > gl_maxsize) {
+                if (!m_limited)
+                    SZSDK_APP_WARNING("Project exceeds the autosave limit ({} of {} bytes); autosaving is suspended until it shrinks.", size, gl_maxsize);
+
+                m_limited = true;
+                return sdk::ErrorCode::NoOperation;
+            }
+            m_limited = false;
+
+            /* Only the snapshot is taken on the GUI thread; encoding and writing it is left to the task. */
+            auto snapshot = std::make_shared<std::vector<internal::AutosaveDiagram>>();
+            snapshot->reserve(diagrams.size());
+            for (ProjectSaver::Diagram const &diagram : diagrams)
+                snapshot->push_back({ std::string(diagram.name), diagram.store->snapshot() });
+
+            m_task = sdk::SubmitTask([path = m_path, snapshot]() {
+                sdk::ErrorCode const err = internal::WriteAutosave(path, *snapshot);
+
+                if (err != sdk::ErrorCode::Ok)
+                    SZSDK_APP_WARNING("Could not autosave to \"{}\" (error {}).", path, static_cast<int>(err));
+            }, sdk::TaskPriority::Low);
+            if (!m_task.isValid())
+                return sdk::ErrorCode::CriticalResource;
+
+            m_saved = fingerprint;
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    void AutosaveService::stop(bool discard) noexcept {
+        if (m_timer != nullptr)
+            m_timer->stop();
+
+        m_task.wait();
+        m_task = {};
+
+        if (discard && !m_path.empty()) {
+            std::error_code ec;
+
+            std::filesystem::remove(m_path, ec);
+        }
+        m_path.clear();
+        m_source = {};
+    }
+
+
+    int AutosaveService::TickInterval() noexcept {
+        if (gl_interval == 0)
+            return gl_idlepoll;
+
+        return static_cast<int>(std::min<uint64_t>(gl_interval * uint64_t(1000), INT_MAX));
+    }
+
+    void AutosaveService::tick() noexcept {
+        if (!isRunning())
+            return;
+
+        /* The interval may have been changed, or autosaving enabled, since the timer was armed. */
+        if (gl_interval != 0) {
+            sdk::ErrorCode const err = trigger();
+
+            if (err == sdk::ErrorCode::CriticalResource)
+                SZSDK_APP_WARNING("Could not take a snapshot for autosaving \"{}\".", m_path);
+        }
+
+        m_timer->start(TickInterval());
+    }
+}
+
+
@@ -0,0 +1,705 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  batch.cpp
+ * \brief implementation of the headless batch mode
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <string>
+
+/* external includes */
+#include <QThread>
+#include <QThreadPool>
+
+/* sdk includes */
+#include <sdk/config.hpp>
+#include <sdk/jsonimport.hpp>
+#include <sdk/log.hpp>
+#include <sdk/merge.hpp>
+#include <sdk/project.hpp>
+#include <sdk/query.hpp>
+#include <sdk/reverse.hpp>
+#include <sdk/statemachine.hpp>
+
+/* app includes */
+#include <batch.hpp>
+#include <diagramview.hpp>
+#include <globalsettings.hpp>
+#include <replay.hpp>
+#include <textexport.hpp>
+#include <xmi.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \brief processes a single file of a batch job
+         *
+         * Commands are invoked concurrently for different files. The configuration is shared by all
+         * invocations and must only be read.
+         *
+         * \param [in] path path of the file to process
+         * \param [in] cfg global configuration
+         * \param [out] msg receives a description of the error, if any
+         *
+         * \return *true* if the file was processed successfully
+         */
+        using BatchCommand = bool (*)(std::string const &path, sdk::Configuration const &cfg, std::string &msg);
+
+        /**
+         * \struct suzu::internal::BatchResult
+         * \brief  outcome of processing a single file
+         */
+        struct BatchResult {
+            bool        ok;  /**< whether or not the file was processed successfully */
+            std::string msg; /**< error description */
+        };
+
+
+        /**
+         * \brief  checks that the file at *path* is a well-formed JSON document
+         *
+         * \param  [in] path path of the file to check
+         * \param  [in] cfg global configuration; unused
+         * \param  [out] msg receives a description of the error, if any
+         *
+         * \return *true* if the file is valid
+         */
+        static bool ValidateFile(std::string const &path, sdk::Configuration const &, std::string &msg) noexcept {
+            try {
+                sdk::util::MappedFile file;
+                if (sdk::util::MapFile(path.c_str(), file) != sdk::ErrorCode::Ok) {
+                    msg = "could not read file";
+
+                    return false;
+                }
+
+                (void)sdk::JSON::parse(file.data(), file.data() + file.size(), nullptr, true, true);
+                return true;
+            } catch (sdk::JSON::exception const &e) {
+                msg = e.what();
+            } catch (...) {
+                msg = "unknown error";
+            }
+
+            return false;
+        }
+
+        /**
+         * \brief  converts the JSON or XMI diagram at *path* into a project file next to it
+         *
+         * The diagram is streamed from the file, so that even large exports of other tools are
+         * converted with bounded memory. *diagram.json* becomes *diagram.szp*; files ending in
+         * *.xmi* are read as XMI.
+         *
+         * \param  [in] path path of the diagram
+         * \param  [in] cfg global configuration; unused
+         * \param  [out] msg receives a description of the error, if any
+         *
+         * \return *true* if the file was converted
+         */
+        static bool ImportFile(std::string const &path, sdk::Configuration const &, std::string &msg) noexcept {
+            try {
+                sdk::ElementStore store;
+                std::string       name;
+                bool const        xmi = std::filesystem::path(path).extension() == ".xmi";
+                if ((xmi ? ImportXmi(path.c_str(), store, &name, &msg) : sdk::ImportJsonDiagram(path.c_str(), store, &name, &msg)) != sdk::ErrorCode::Ok)
+                    return false;
+
+                std::string const  output = std::filesystem::path(path).replace_extension(".szp").string();
+                sdk::ProjectWriter writer;
+                if (writer.open(output.c_str(), sdk::Compression::High) == sdk::ErrorCode::Ok && writer.addDiagram(name, store) == sdk::ErrorCode::Ok && writer.commit() == sdk::ErrorCode::Ok)
+                    return true;
+
+                msg = "could not write " + output;
+            } catch (...) {
+                msg = "unknown error";
+            }
+
+            return false;
+        }
+
+        /**
+         * \brief  builds the list of changed properties, e.g. *bounds, style*
+         *
+         * \param  [in] properties properties, as bits *1 << suzu::sdk::ChangeProperty*
+         *
+         * \return list
+         */
+        static std::string PropertiesOf(uint32_t const properties) {
+            static constexpr char const *gl_propnames[] = { "bounds", "style", "flags" }; /**< names of the compared properties */
+
+            std::string res;
+            for (size_t i = 0; i < std::size(gl_propnames); ++i)
+                if (properties & (1u << i))
+                    res.append(res.empty() ? "" : ", ").append(gl_propnames[i]);
+
+            return res;
+        }
+
+        /**
+         * \brief  prints the differences between two project files, one line per element
+         *
+         * \param  [in] files older and newer revision
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         not exactly two files were given, or the error of *suzu::sdk::DiffProjects()*
+         */
+        static sdk::ErrorCode DiffFiles(std::vector<std::string> const &files) noexcept {
+            if (files.size() != 2) {
+                std::fprintf(stderr, "usage: suzu %s diff <old> <new>\n", gl_batchflag.data());
+
+                return sdk::ErrorCode::InvalidParameter;
+            }
+
+            try {
+                std::vector<sdk::DiffEntry> entries;
+
+                sdk::ErrorCode const err = sdk::DiffProjects(files[0].c_str(), files[1].c_str(), entries);
+                if (err != sdk::ErrorCode::Ok) {
+                    std::fprintf(stderr, "FAILED  could not compare %s and %s\n", files[0].c_str(), files[1].c_str());
+
+                    return err;
+                }
+
+                for (sdk::DiffEntry const &entry : entries) {
+                    char const mark = entry.kind == sdk::DiffKind::Added ? '+' : entry.kind == sdk::DiffKind::Removed ? '-' : '~';
+
+                    if (entry.path.empty())
+                        std::fprintf(stdout, "%c %s\n", mark, entry.diagram.c_str());
+                    else if (entry.kind == sdk::DiffKind::Modified)
+                        std::fprintf(stdout, "%c %s: %s (%s)\n", mark, entry.diagram.c_str(), entry.path.c_str(), PropertiesOf(entry.properties).c_str());
+                    else
+                        std::fprintf(stdout, "%c %s: %s\n", mark, entry.diagram.c_str(), entry.path.c_str());
+                }
+
+                SZSDK_APP_INFO("Compared {} and {}: {} difference(s).", files[0], files[1], entries.size());
+                return sdk::ErrorCode::Ok;
+            } catch (...) { }
+
+            return sdk::ErrorCode::Unknown;
+        }
+
+        /**
+         * \brief  merges two revisions of a project file and prints the conflicts, one line each
+         *
+         * \param  [in] files common ancestor, ours, theirs, and optionally the output; ours is
+         *                   replaced if no output is given
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if the merge had no conflicts,
+         *         *suzu::sdk::ErrorCode::InvalidState* if it had, *suzu::sdk::ErrorCode::InvalidParameter*
+         *         if not three or four files were given, or the error of *suzu::sdk::MergeProjects()*
+         */
+        static sdk::ErrorCode MergeFiles(std::vector<std::string> const &files) noexcept {
+            static constexpr char const *gl_conflictnames[] = { "changed on both sides", "changed here, removed there", "removed here, changed there" }; /**< descriptions of the conflicts */
+
+            if (files.size() != 3 && files.size() != 4) {
+                std::fprintf(stderr, "usage: suzu %s merge <base> <ours> <theirs> [<output>]\n", gl_batchflag.data());
+
+                return sdk::ErrorCode::InvalidParameter;
+            }
+
+            try {
+                std::string const                output = files.size() == 4 ? files[3] : files[1];
+                std::vector<sdk::MergeConflict>  conflicts;
+
+                sdk::ErrorCode const err = sdk::MergeProjects(files[0].c_str(), files[1].c_str(), files[2].c_str(), output.c_str(), conflicts, sdk::Compression::High);
+                if (err != sdk::ErrorCode::Ok) {
+                    std::fprintf(stderr, "FAILED  could not merge into %s\n", output.c_str());
+
+                    return err;
+                }
+
+                for (sdk::MergeConflict const &conflict : conflicts) {
+                    std::string const what = conflict.kind == sdk::ConflictKind::BothModified && conflict.properties != 0
+                        ? std::string(gl_conflictnames[0]) + " (" + PropertiesOf(conflict.properties) + ")"
+                        : std::string(gl_conflictnames[static_cast<size_t>(conflict.kind)]);
+
+                    if (conflict.path.empty())
+                        std::fprintf(stdout, "CONFLICT  %s: %s\n", conflict.diagram.c_str(), what.c_str());
+                    else
+                        std::fprintf(stdout, "CONFLICT  %s: %s: %s\n", conflict.diagram.c_str(), conflict.path.c_str(), what.c_str());
+                }
+
+                SZSDK_APP_INFO("Merged into {} with {} conflict(s).", output, conflicts.size());
+                return conflicts.empty() ? sdk::ErrorCode::Ok : sdk::ErrorCode::InvalidState;
+            } catch (...) { }
+
+            return sdk::ErrorCode::Unknown;
+        }
+        /**
+         * \brief  runs simulation scripts against a state machine and prints one result line per
+         *         script
+         *
+         * Every script starts from the initial configuration of the machine (see
+         * *sdk/statemachine.hpp* for both formats).
+         *
+         * \param  [in] files the machine, followed by the scripts
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if all expectations of all scripts held,
+         *         *suzu::sdk::ErrorCode::InvalidParameter* if no script was given or the machine is
+         *         invalid, or *suzu::sdk::ErrorCode::ReadFile* if at least one script failed
+         */
+        static sdk::ErrorCode SimulateFiles(std::vector<std::string> const &files) noexcept {
+            if (files.size() < 2) {
+                std::fprintf(stderr, "usage: suzu %s simulate <machine> <script>...\n", gl_batchflag.data());
+
+                return sdk::ErrorCode::InvalidParameter;
+            }
+
+            try {
+                sdk::StateMachine     machine;
+                sdk::util::MappedFile file;
+                std::string           msg = "could not read file";
+                if (sdk::util::MapFile(files[0].c_str(), file) != sdk::ErrorCode::Ok
+                    || machine.compile(sdk::JSON::parse(file.data(), file.data() + file.size(), nullptr, true, true), &msg) != sdk::ErrorCode::Ok
+                ) {
+                    std::fprintf(stderr, "FAILED  %s: %s\n", files[0].c_str(), msg.c_str());
+
+                    return sdk::ErrorCode::InvalidParameter;
+                }
+
+                size_t nfailed = 0;
+                for (size_t i = 1; i < files.size(); ++i) {
+                    sdk::SimulationScript script;
+                    sdk::util::MappedFile text;
+                    msg = "could not read file";
+
+                    sdk::ErrorCode err = sdk::util::MapFile(files[i].c_str(), text);
+                    if (err == sdk::ErrorCode::Ok)
+                        err = script.parse(std::string_view(text.data(), text.size()), machine, &msg);
+
+                    sdk::StateMachineSimulator sim(machine);
+                    auto const                 start = std::chrono::steady_clock::now();
+                    if (err == sdk::ErrorCode::Ok)
+                        err = script.run(sim, &msg);
+                    double const secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                    if (err != sdk::ErrorCode::Ok) {
+                        std::fprintf(stdout, "FAILED  %s: %s\n", files[i].c_str(), msg.c_str());
+
+                        ++nfailed;
+                        continue;
+                    }
+
+                    std::fprintf(stdout, "OK      %s: %llu events, %llu transitions, %.0f events/s\n", files[i].c_str(),
+                        static_cast<unsigned long long>(sim.events()), static_cast<unsigned long long>(sim.fired()), secs > 0.0 ? static_cast<double>(sim.events()) / secs : 0.0
+                    );
+                }
+
+                SZSDK_APP_INFO("Simulated {} script(s) against {}: {} failed.", files.size() - 1, files[0], nfailed);
+                return nfailed == 0 ? sdk::ErrorCode::Ok : sdk::ErrorCode::ReadFile;
+            } catch (sdk::JSON::exception const &e) {
+                std::fprintf(stderr, "FAILED  %s: %s\n", files[0].c_str(), e.what());
+
+                return sdk::ErrorCode::InvalidParameter;
+            } catch (...) { }
+
+            return sdk::ErrorCode::Unknown;
+        }
+
+        /**
+         * \brief  reverse engineers C++ sources into a class diagram and writes it to a project file
+         *
+         * Directories are searched recursively for C++ sources and headers. The types found in every
+         * file are cached in *suzu::sdk::ReverseEngineer::gl_cachename* next to the project, so
+         * rerunning the command after a commit only scans the files it changed.
+         *
+         * \param  [in] files the project file, followed by the sources and directories
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         no source was given, *suzu::sdk::ErrorCode::ReadFile* if a source could not be
+         *         read, or the error of writing the project
+         */
+        static sdk::ErrorCode ReverseFiles(std::vector<std::string> const &files) noexcept {
+            static constexpr std::string_view gl_cppextensions[] = { ".h", ".hh", ".hpp", ".hxx", ".inl", ".ipp", ".c", ".cc", ".cpp", ".cxx" }; /**< extensions of the files searched in directories */
+
+            if (files.size() < 2) {
+                std::fprintf(stderr, "usage: suzu %s reverse <output> <source>...\n", gl_batchflag.data());
+
+                return sdk::ErrorCode::InvalidParameter;
+            }
+
+            try {
+                auto const               start = std::chrono::steady_clock::now();
+                std::vector<std::string> sources;
+                for (size_t i = 1; i < files.size(); ++i) {
+                    std::error_code err;
+                    if (!std::filesystem::is_directory(std::filesystem::u8path(files[i]), err)) {
+                        sources.push_back(files[i]);
+
+                        continue;
+                    }
+
+                    for (auto it = std::filesystem::recursive_directory_iterator(std::filesystem::u8path(files[i]), err); !err && it != std::filesystem::recursive_directory_iterator(); it.increment(err)) {
+                        std::string const ext = it->path().extension().u8string();
+
+                        if (it->is_regular_file(err) && std::find(std::begin(gl_cppextensions), std::end(gl_cppextensions), ext) != std::end(gl_cppextensions))
+                            sources.push_back(it->path().u8string());
+                    }
+                }
+                std::sort(sources.begin(), sources.end());
+
+                std::filesystem::path const output = std::filesystem::u8path(files[0]);
+                std::string const           cache  = (output.parent_path() / sdk::ReverseEngineer::gl_cachename).u8string();
+                sdk::ReverseEngineer        engineer;
+                sdk::ReverseStats           stats;
+                (void)engineer.load(cache.c_str());
+
+                sdk::ErrorCode err = engineer.run(sources, stats);
+                if (err != sdk::ErrorCode::Ok && err != sdk::ErrorCode::ReadFile)
+                    return err;
+
+                sdk::ElementBatch               batch;
+                sdk::ElementStore               store;
+                std::vector<sdk::ElementHandle> handles;
+                size_t                          edges = 0;
+                if ((err = engineer.build(batch, {}, &edges)) != sdk::ErrorCode::Ok || (err = store.insert(batch, handles)) != sdk::ErrorCode::Ok)
+                    return err;
+
+                sdk::ProjectWriter writer;
+                if (writer.open(files[0].c_str(), sdk::Compression::High) != sdk::ErrorCode::Ok || writer.addDiagram(output.stem().u8string(), store) != sdk::ErrorCode::Ok || writer.commit() != sdk::ErrorCode::Ok) {
+                    std::fprintf(stderr, "FAILED  could not write %s\n", files[0].c_str());
+
+                    return sdk::ErrorCode::WriteFile;
+                }
+                if (engineer.save(cache.c_str()) != sdk::ErrorCode::Ok)
+                    SZSDK_APP_WARNING("Could not write the reverse engineering cache {}.", cache);
+
+                double const secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::fprintf(stdout, "OK      %s: %llu files (%llu scanned, %llu cached, %llu failed), %llu types, %llu generalizations, %.2f s\n", files[0].c_str(),
+                    static_cast<unsigned long long>(stats.files), static_cast<unsigned long long>(stats.parsed), static_cast<unsigned long long>(stats.cached),
+                    static_cast<unsigned long long>(stats.failed), static_cast<unsigned long long>(stats.types), static_cast<unsigned long long>(edges), secs
+                );
+
+                SZSDK_APP_INFO("Reverse engineered {} file(s) into {}.", stats.files, files[0]);
+                return stats.failed == 0 ? sdk::ErrorCode::Ok : sdk::ErrorCode::ReadFile;
+            } catch (...) { }
+
+            return sdk::ErrorCode::Unknown;
+        }
+
+        /**
+         * \brief  runs a query against all diagrams of a project file and prints one line per match
+         *
+         * The plan chosen for every diagram is logged (see *suzu::sdk::ModelIndex::run()*).
+         *
+         * \param  [in] files the project file, followed by the words of the query (see
+         *              *sdk/query.hpp*)
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if anything matched, *suzu::sdk::ErrorCode::NoOperation*
+         *         if nothing did, *suzu::sdk::ErrorCode::InvalidParameter* if the query is malformed,
+         *         or the error of reading the project
+         */
+        static sdk::ErrorCode QueryFiles(std::vector<std::string> const &files) noexcept {
+            if (files.size() < 2) {
+                std::fprintf(stderr, "usage: suzu %s query <project> <query>...\n", gl_batchflag.data());
+
+                return sdk::ErrorCode::InvalidParameter;
+            }
+
+            try {
+                /* The query may be given as a single argument or split into words by the shell. */
+                std::string text;
+                for (size_t i = 1; i < files.size(); ++i)
+                    text.append(i > 1 ? " " : "").append(files[i]);
+
+                sdk::ModelQuery query;
+                std::string     msg;
+                if (query.parse(text, &msg) != sdk::ErrorCode::Ok) {
+                    std::fprintf(stderr, "FAILED  %s\n", msg.c_str());
+
+                    return sdk::ErrorCode::InvalidParameter;
+                }
+
+                sdk::ProjectReader reader;
+                sdk::ErrorCode     err = reader.open(files[0].c_str());
+                if (err != sdk::ErrorCode::Ok) {
+                    std::fprintf(stderr, "FAILED  could not read %s\n", files[0].c_str());
+
+                    return err;
+                }
+
+                size_t nmatches = 0;
+                for (uint32_t d = 0; d < reader.diagramCount(); ++d) {
+                    sdk::ElementStore               store;
+                    sdk::ModelIndex                 index;
+                    std::vector<sdk::ElementHandle> matches;
+                    std::string                     plan;
+                    if ((err = reader.loadDiagram(d, store)) != sdk::ErrorCode::Ok || (err = index.build(store)) != sdk::ErrorCode::Ok || (err = index.run(query, matches, &plan)) != sdk::ErrorCode::Ok) {
+                        std::fprintf(stderr, "FAILED  could not query %s: %s\n", files[0].c_str(), std::string(reader.diagramName(d)).c_str());
+
+                        return err;
+                    }
+
+                    SZSDK_APP_INFO("Queried {}: {}.", reader.diagramName(d), plan);
+                    for (sdk::ElementHandle const match : matches) {
+                        uint32_t const i = store.indexOf(match);
+
+                        std::fprintf(stdout, "%s: %s (%s)\n", std::string(reader.diagramName(d)).c_str(), std::string(store.names()[i].view()).c_str(), sdk::ModelQuery::KindName(store.kinds()[i]).data());
+                    }
+                    nmatches += matches.size();
+                }
+
+                return nmatches > 0 ? sdk::ErrorCode::Ok : sdk::ErrorCode::NoOperation;
+            } catch (...) { }
+
+            return sdk::ErrorCode::Unknown;
+        }
+
+        /**
+         * \brief  exports all diagrams of a project file as a single PlantUML or Mermaid file, e.g. to
+         *         publish them on a wiki
+         *
+         * The format is chosen by the extension of the output (see *suzu::TextFormatOf()*).
+         *
+         * \param  [in] files the project file, followed by the output file
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the arguments or the extension are wrong, or the error of reading the project or
+         *         writing the output
+         */
+        static sdk::ErrorCode PublishFiles(std::vector<std::string> const &files) noexcept {
+            TextFormat format;
+            if (files.size() != 2 || !TextFormatOf(files[1], format)) {
+                std::fprintf(stderr, "usage: suzu %s publish <project> <output.puml|output.md>\n", gl_batchflag.data());
+
+                return sdk::ErrorCode::InvalidParameter;
+            }
+
+            try {
+                auto const         start = std::chrono::steady_clock::now();
+                sdk::ProjectReader reader;
+                sdk::ErrorCode     err = reader.open(files[0].c_str());
+                if (err != sdk::ErrorCode::Ok) {
+                    std::fprintf(stderr, "FAILED  could not read %s\n", files[0].c_str());
+
+                    return err;
+                }
+
+                std::vector<sdk::ElementStore> stores(reader.diagramCount());
+                std::vector<TextDiagram>       diagrams(reader.diagramCount());
+                for (uint32_t d = 0; d < reader.diagramCount(); ++d) {
+                    if ((err = reader.loadDiagram(d, stores[d])) != sdk::ErrorCode::Ok) {
+                        std::fprintf(stderr, "FAILED  could not load %s: %s\n", files[0].c_str(), std::string(reader.diagramName(d)).c_str());
+
+                        return err;
+                    }
+
+                    diagrams[d] = { reader.diagramName(d), &stores[d] };
+                }
+
+                if ((err = ExportText(files[1].c_str(), format, diagrams)) != sdk::ErrorCode::Ok) {
+                    std::fprintf(stderr, "FAILED  could not write %s\n", files[1].c_str());
+
+                    return err;
+                }
+
+                double const secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::fprintf(stdout, "OK      %s: %llu diagrams, %.2f s\n", files[1].c_str(), static_cast<unsigned long long>(diagrams.size()), secs);
+
+                SZSDK_APP_INFO("Published {} diagram(s) of {} to {}.", diagrams.size(), files[0], files[1]);
+                return sdk::ErrorCode::Ok;
+            } catch (...) { }
+
+            return sdk::ErrorCode::Unknown;
+        }
+
+        /**
+         * \brief  replays recorded editing sessions and prints the latency distribution of every kind
+         *         of event
+         *
+         * Sessions are replayed one after another on the GUI thread, into a view created as
+         * configured by keys "/canvas/backend", "/lod/..." and "/tiles/budget".
+         *
+         * \param  [in] files options *--render* and *--paced* (see *suzu::SessionReplayer*),
+         *         followed by the recordings
+         * \param  [in] cfg global configuration
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if all sessions were replayed,
+         *         *suzu::sdk::ErrorCode::InvalidParameter* if no recording was given,
+         *         *suzu::sdk::ErrorCode::CriticalResource* if the view could not be created, or
+         *         *suzu::sdk::ErrorCode::ReadFile* if at least one recording failed
+         */
+        static sdk::ErrorCode ReplayFiles(std::vector<std::string> const &files, sdk::Configuration const &cfg) noexcept {
+            static constexpr char const *gl_kinds[] = { "press", "dblclick", "release", "move", "wheel", "keypress", "keyrelease", "resize" };
+            static_assert(std::size(gl_kinds) == static_cast<size_t>(InputKind::Count), "every kind of input needs a name");
+
+            bool   render = false;
+            bool   paced  = false;
+            size_t first  = 0;
+            for (; first < files.size(); ++first) {
+                if (files[first] == "--render")
+                    render = true;
+                else if (files[first] == "--paced")
+                    paced = true;
+                else
+                    break;
+            }
+            if (first == files.size()) {
+                std::fprintf(stderr, "usage: suzu %s replay [--render] [--paced] <recording>...\n", gl_batchflag.data());
+
+                return sdk::ErrorCode::InvalidParameter;
+            }
+
+            try {
+                GlobalSettings settings;
+                settings.load(cfg.snapshot());
+
+                LodThresholds const                lod  = { settings.lodnames, settings.lodoutlines, settings.lodclusters };
+                std::unique_ptr<DiagramView> const view(CreateDiagramView(settings.canvasbackend, lod, static_cast<size_t>(settings.tilebudget) << 20));
+                if (view == nullptr) {
+                    std::fprintf(stderr, "FAILED  could not create a view\n");
+
+                    return sdk::ErrorCode::CriticalResource;
+                }
+
+                size_t nfailed = 0;
+                for (size_t i = first; i < files.size(); ++i) {
+                    SessionReplayer replayer;
+                    ReplayResult    res;
+
+                    sdk::ErrorCode err = replayer.open(files[i].c_str());
+                    if (err == sdk::ErrorCode::Ok)
+                        err = replayer.run(*view, render, paced, res);
+                    view->setStore(nullptr);
+                    if (err != sdk::ErrorCode::Ok) {
+                        std::fprintf(stdout, "FAILED  %s: error %d\n", files[i].c_str(), static_cast<int>(err));
+
+                        ++nfailed;
+                        continue;
+                    }
+
+                    std::fprintf(stdout, "OK      %s: %llu events in %.3f s, recorded in %.3f s\n", files[i].c_str(),
+                        static_cast<unsigned long long>(replayer.eventCount()), static_cast<double>(res.elapsed) / 1e9, static_cast<double>(res.recorded) / 1e9
+                    );
+                    for (size_t k = 0; k <= static_cast<size_t>(InputKind::Count); ++k) {
+                        bool const         frames = k == static_cast<size_t>(InputKind::Count);
+                        LatencyStats const stats  = LatencyStats::Of(frames ? res.frames : res.latency[k]);
+                        if (stats.count == 0)
+                            continue;
+
+                        std::fprintf(stdout, "        %-10s n=%-8llu p50=%.3f ms  p90=%.3f ms  p99=%.3f ms  max=%.3f ms\n", frames ? "frame" : gl_kinds[k],
+                            static_cast<unsigned long long>(stats.count), stats.p50, stats.p90, stats.p99, stats.max
+                        );
+                    }
+                }
+
+                SZSDK_APP_INFO("Replayed {} session(s){}: {} failed.", files.size() - first, render ? " with rendering" : "", nfailed);
+                return nfailed == 0 ? sdk::ErrorCode::Ok : sdk::ErrorCode::ReadFile;
+            } catch (...) { }
+
+            return sdk::ErrorCode::Unknown;
+        }
+    }
+
+
+    bool BatchJob::Parse(int argc, char **argv, BatchJob &job) noexcept {
+        if (argc < 2 || argv[1] != gl_batchflag)
+            return false;
+
+        try {
+            BatchJob res;
+            if (argc > 2)
+                res.command = argv[2];
+            for (int i = 3; i < argc; ++i)
+                res.files.emplace_back(argv[i]);
+
+            job = std::move(res);
+        } catch (...) {
+            return false;
+        }
+
+        return true;
+    }
+
+
+    sdk::ErrorCode RunBatchJob(BatchJob const &job, sdk::Configuration const &cfg, uint32_t nthreads) noexcept {
+        /* Comparing, merging, simulating, reverse engineering, querying, publishing and replaying take several files at once, rather than processing every file on its own. */
+        if (job.command == "diff")
+            return internal::DiffFiles(job.files);
+        if (job.command == "merge")
+            return internal::MergeFiles(job.files);
+        if (job.command == "simulate")
+            return internal::SimulateFiles(job.files);
+        if (job.command == "reverse")
+            return internal::ReverseFiles(job.files);
+        if (job.command == "query")
+            return internal::QueryFiles(job.files);
+        if (job.command == "publish")
+            return internal::PublishFiles(job.files);
+        if (job.command == "replay")
+            return internal::ReplayFiles(job.files, cfg);
+
+        internal::BatchCommand command = nullptr;
+        if (job.command == "validate")
+            command = &internal::ValidateFile;
+        else if (job.command == "import")
+            command = &internal::ImportFile;
+
+        if (command == nullptr || job.files.empty()) {
+            std::fprintf(stderr, "usage: suzu %s validate|import <file>...\n       suzu %s diff <old> <new>\n       suzu %s merge <base> <ours> <theirs> [<output>]\n       suzu %s simulate <machine> <script>...\n       suzu %s reverse <output> <source>...\n       suzu %s query <project> <query>...\n       suzu %s publish <project> <output.puml|output.md>\n       suzu %s replay [--render] [--paced] <recording>...\n", gl_batchflag.data(), gl_batchflag.data(), gl_batchflag.data(), gl_batchflag.data(), gl_batchflag.data(), gl_batchflag.data(), gl_batchflag.data(), gl_batchflag.data());
+
+            return sdk::ErrorCode::InvalidParameter;
+        }
+
+        size_t nfailed = 0;
+        try {
+            /*
+             * Every worker repeatedly claims the next unprocessed file. Results are stored per file
+             * and printed in command-line order once all workers have finished.
+             */
+            std::vector<internal::BatchResult> results(job.files.size());
+            std::atomic<size_t>                next{ 0 };
+
+            int const nworkers = static_cast<int>(std::min<size_t>(nthreads == 0 ? static_cast<size_t>(QThread::idealThreadCount()) : nthreads, job.files.size()));
+            QThreadPool pool;
+            pool.setMaxThreadCount(nworkers);
+            for (int i = 0; i < nworkers; ++i)
+                pool.start([&]() {
+                    for (size_t curr = next++; curr < job.files.size(); curr = next++) {
+                        internal::BatchResult &res = results[curr];
+
+                        try {
+                            res.ok = command(job.files[curr], cfg, res.msg);
+                        } catch (...) {
+                            res.ok = false;
+                        }
+                    }
+                });
+            pool.waitForDone();
+
+            for (size_t i = 0; i < job.files.size(); ++i)
+                if (results[i].ok)
+                    std::fprintf(stdout, "OK      %s\n", job.files[i].c_str());
+                else {
+                    std::fprintf(stdout, "FAILED  %s: %s\n", job.files[i].c_str(), results[i].msg.c_str());
+
+                    ++nfailed;
+                }
+        } catch (...) {
+            return sdk::ErrorCode::Unknown;
+        }
+
+        SZSDK_APP_INFO("Batch command \"{}\" processed {} file(s), {} failed.", job.command, job.files.size(), nfailed);
+        return nfailed == 0 ? sdk::ErrorCode::Ok : sdk::ErrorCode::ReadFile;
+    }
+}
+
+
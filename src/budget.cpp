@@ -0,0 +1,218 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  budget.cpp
+ * \brief implementation of the memory budget shared by all caches
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <new>
+
+#if defined _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <Windows.h>
+#endif
+
+/* sdk includes */
+#include <sdk/log.hpp>
+
+/* app includes */
+#include <budget.hpp>
+
+
+namespace suzu {
+    /**
+     * \struct suzu::MemoryBudget::Platform
+     * \brief  memory notification of the system
+     */
+    struct MemoryBudget::Platform {
+#if defined _WIN32
+        HANDLE notification; /**< signaled while physical memory is low */
+#endif
+    };
+
+
+    MemoryBudget::MemoryBudget() noexcept
+        : m_next(1), m_budget(0), m_cap(0), m_pressure(false), m_platform(nullptr)
+    {
+#if defined _WIN32
+        if (HANDLE const notification = CreateMemoryResourceNotification(LowMemoryResourceNotification))
+            m_platform = new (std::nothrow) Platform{ notification };
+#endif
+    }
+
+    MemoryBudget::~MemoryBudget() {
+#if defined _WIN32
+        if (m_platform != nullptr)
+            CloseHandle(m_platform->notification);
+#endif
+        delete m_platform;
+    }
+
+    MemoryBudget &MemoryBudget::Shared() {
+        static MemoryBudget gl_budget;
+
+        return gl_budget;
+    }
+
+    int64_t MemoryBudget::Now() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+
+    uint32_t MemoryBudget::add(Consumer consumer) {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        m_slots.push_back({ m_next, std::move(consumer) });
+        return m_next++;
+    }
+
+    void MemoryBudget::remove(uint32_t id) noexcept {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        auto const it = std::find_if(m_slots.begin(), m_slots.end(), [id](Slot const &slot) { return slot.id == id; });
+        if (it != m_slots.end())
+            m_slots.erase(it);
+    }
+
+    void MemoryBudget::setBudget(size_t bytes) noexcept {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            m_budget = bytes;
+        }
+
+        enforce();
+    }
+
+    size_t MemoryBudget::budget() const noexcept {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        return m_budget;
+    }
+
+    size_t MemoryBudget::total() const noexcept {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        return used();
+    }
+
+
+    void MemoryBudget::enforce() noexcept {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        size_t limit = m_budget;
+        if (m_pressure)
+            limit = m_budget == 0 ? m_cap : std::min(m_budget, m_cap);
+        else if (m_budget == 0)
+            return;
+
+        size_t total = used();
+        if (total <= limit)
+            return;
+
+        try {
+            /* Consumers that report an entry but free nothing are not asked again. */
+            std::vector<bool> skip(m_slots.size(), false);
+
+            while (total > limit) {
+                size_t victim = m_slots.size();
+                double best   = -1.0;
+                for (size_t i = 0; i < m_slots.size(); ++i) {
+                    if (skip[i])
+                        continue;
+
+                    Consumer const &consumer = m_slots[i].consumer;
+                    int64_t const   idle     = consumer.idle();
+                    if (idle < 0)
+                        continue;
+
+                    double const score = static_cast<double>(idle) / consumer.cost;
+                    if (score > best) {
+                        victim = i;
+                        best   = score;
+                    }
+                }
+                if (victim == m_slots.size())
+                    break;
+
+                size_t const freed = m_slots[victim].consumer.evict();
+                if (freed == 0)
+                    skip[victim] = true;
+
+                total -= std::min(total, freed);
+            }
+        } catch (...) { }
+    }
+
+    void MemoryBudget::poll() noexcept {
+        bool const low = isMemoryLow();
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            if (low && !m_pressure) {
+                m_cap      = used() / 2;
+                m_pressure = true;
+
+                SZSDK_APP_WARNING("The system is low on memory; caches are trimmed to {:.1f} MiB.", static_cast<double>(m_cap) / (1 << 20));
+            } else if (!low && m_pressure) {
+                m_pressure = false;
+
+                SZSDK_APP_INFO("The system is no longer low on memory; caches may grow up to their budget again.");
+            }
+        }
+
+        enforce();
+    }
+
+
+    size_t MemoryBudget::used() const noexcept {
+        size_t res = 0;
+        for (Slot const &slot : m_slots)
+            res += slot.consumer.bytes();
+
+        return res;
+    }
+
+    bool MemoryBudget::isMemoryLow() const noexcept {
+#if defined _WIN32
+        BOOL low = FALSE;
+        if (m_platform == nullptr || !QueryMemoryResourceNotification(m_platform->notification, &low))
+            return false;
+
+        return low != FALSE;
+#elif defined __linux__
+        /* Free memory excludes the page cache, which the kernel drops on demand; available memory does not. */
+        std::FILE *const file = std::fopen("/proc/meminfo", "r");
+        if (file == nullptr)
+            return false;
+
+        unsigned long long total = 0;
+        unsigned long long avail = 0;
+        char               line[128];
+        while (std::fgets(line, sizeof(line), file) != nullptr) {
+            std::sscanf(line, "MemTotal: %llu kB", &total);
+            std::sscanf(line, "MemAvailable: %llu kB", &avail);
+        }
+        std::fclose(file);
+
+        return total != 0 && static_cast<double>(avail) < gl_lowmemory * static_cast<double>(total);
+#else
+        return false;
+#endif
+    }
+}
+
+
@@ -0,0 +1,428 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  bundler.cpp
+ * \brief implementation of the hierarchical edge bundler
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <utility>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/util.hpp>
+
+/* app includes */
+#include <bundler.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        using BundleTable = sdk::HandleTable<sdk::ElementHandle>;
+
+
+        /**
+         * \brief  computes the center of a rectangle
+         *
+         * \param  [in] rect rectangle
+         *
+         * \return center
+         */
+        static RoutePoint MidpointOf(sdk::ElementRect const &rect) noexcept {
+            return { rect.x + rect.w * 0.5f, rect.y + rect.h * 0.5f };
+        }
+
+        /**
+         * \brief collects an element and all packages enclosing it, innermost first
+         *
+         * \param [in] store diagram containing the element
+         * \param [in] dense dense index of the element
+         * \param [out] res receives the dense indices
+         */
+        static void ChainOf(sdk::ElementStore const &store, uint32_t dense, std::vector<uint32_t> &res) {
+            res.clear();
+
+            while (dense != BundleTable::gl_invalid && res.size() <= EdgeBundler::gl_maxdepth) {
+                res.push_back(dense);
+
+                sdk::ElementHandle const parent = store.parents()[dense];
+                dense = parent.isNull() ? BundleTable::gl_invalid : store.indexOf(parent);
+            }
+        }
+
+        /**
+         * \brief computes the control points of an edge: its end points and the packages on the
+         *        way between them, except for the innermost one containing both
+         *
+         * Leaving out the common package keeps edges between siblings straight and the bundles from
+         * converging in the middle of their common package.
+         *
+         * \param [in] source chain of the source, see *ChainOf()*
+         * \param [in] target chain of the target
+         * \param [in] store diagram containing the edge
+         * \param [out] res receives the control points
+         */
+        static void ControlsOf(std::vector<uint32_t> const &source, std::vector<uint32_t> const &target, sdk::ElementStore const &store, std::vector<RoutePoint> &res) {
+            size_t up   = source.size();
+            size_t down = target.size();
+            for (size_t i = 1; i < source.size() && up == source.size(); ++i)
+                for (size_t j = 1; j < target.size(); ++j)
+                    if (source[i] == target[j]) {
+                        up   = i;
+                        down = j;
+
+                        break;
+                    }
+
+            res.clear();
+            for (size_t i = 0; i < up; ++i)
+                res.push_back(MidpointOf(store.bounds()[source[i]]));
+            for (size_t j = down; j-- > 0; )
+                res.push_back(MidpointOf(store.bounds()[target[j]]));
+        }
+
+        /**
+         * \brief  evaluates a uniform cubic B-spline segment
+         *
+         * \param  [in] p0,p1,p2,p3 control points of the segment
+         * \param  [in] t position in [0, 1]
+         *
+         * \return point on the segment
+         */
+        static RoutePoint SplineAt(RoutePoint const &p0, RoutePoint const &p1, RoutePoint const &p2, RoutePoint const &p3, float const t) noexcept {
+            float const s  = 1.0f - t;
+            float const b0 = s * s * s / 6.0f;
+            float const b1 = (3.0f * t * t * t - 6.0f * t * t + 4.0f) / 6.0f;
+            float const b2 = (-3.0f * t * t * t + 3.0f * t * t + 3.0f * t + 1.0f) / 6.0f;
+            float const b3 = t * t * t / 6.0f;
+
+            return { b0 * p0.x + b1 * p1.x + b2 * p2.x + b3 * p3.x, b0 * p0.y + b1 * p1.y + b2 * p2.y + b3 * p3.y };
+        }
+
+        /**
+         * \brief  computes the bounding box of a polyline
+         *
+         * \param  [in] points vertices; at least one
+         *
+         * \return smallest rectangle containing all vertices
+         */
+        static sdk::ElementRect BoundsOf(std::vector<RoutePoint> const &points) noexcept {
+            float x0 = points.front().x, y0 = points.front().y;
+            float x1 = x0, y1 = y0;
+            for (RoutePoint const &pt : points) {
+                x0 = std::min(x0, pt.x);
+                y0 = std::min(y0, pt.y);
+                x1 = std::max(x1, pt.x);
+                y1 = std::max(y1, pt.y);
+            }
+
+            return { x0, y0, x1 - x0, y1 - y0 };
+        }
+
+        /**
+         * \brief adds a polyline to a path as a subpath of its own
+         *
+         * \param [in] points vertices
+         * \param [in,out] path path
+         */
+        static void AddPolyline(std::vector<RoutePoint> const &points, QPainterPath &path) {
+            if (points.size() < 2)
+                return;
+
+            path.moveTo(points.front().x, points.front().y);
+            for (size_t i = 1; i < points.size(); ++i)
+                path.lineTo(points[i].x, points[i].y);
+        }
+    }
+
+
+    EdgeBundler::EdgeBundler(float strength) noexcept
+        : m_strength(std::clamp(strength, 0.0f, 1.0f)), m_rev(UINT64_MAX), m_generation(0)
+    { }
+
+
+    sdk::ErrorCode EdgeBundler::connect(sdk::ElementHandle edge, sdk::ElementHandle source, sdk::ElementHandle target) noexcept {
+        if (edge.isNull() || source.isNull() || target.isNull())
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            auto const [it, inserted] = m_edges.try_emplace(edge, Edge{ source, target, {}, 0, 0, 0, true, false });
+            if (!inserted) {
+                it->second.source = source;
+                it->second.target = target;
+            }
+
+            markDirty(edge, it->second);
+            m_rev = UINT64_MAX;
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    sdk::ErrorCode EdgeBundler::disconnect(sdk::ElementHandle edge) noexcept {
+        auto const it = m_edges.find(edge);
+        if (it == m_edges.end())
+            return sdk::ErrorCode::InvalidParameter;
+
+        if (it->second.indexed)
+            m_curves.remove(edge);
+        m_pending.erase(edge);
+        m_edges.erase(it);
+        return sdk::ErrorCode::Ok;
+    }
+
+    void EdgeBundler::setStrength(float strength) noexcept {
+        strength = std::clamp(strength, 0.0f, 1.0f);
+        if (strength == m_strength)
+            return;
+
+        /* The strength is part of every fingerprint, so all edges are requested again. */
+        m_strength = strength;
+        m_rev      = UINT64_MAX;
+    }
+
+
+    std::vector<EdgeBundler::Request> EdgeBundler::prepare(sdk::ElementStore const &store) {
+        SZSDK_PROFILE_SCOPE("EdgeBundler::prepare");
+
+        std::vector<Request> res;
+        if (store.revision() == m_rev)
+            return res;
+
+        std::vector<uint32_t>   source, target;
+        std::vector<RoutePoint> controls;
+        uint64_t const          generation = m_generation + 1;
+        for (auto &[handle, edge] : m_edges) {
+            uint32_t const src = store.indexOf(edge.source);
+            uint32_t const dst = store.indexOf(edge.target);
+            if (src == internal::BundleTable::gl_invalid || dst == internal::BundleTable::gl_invalid) {
+                if (edge.indexed)
+                    m_curves.remove(handle);
+                m_pending.erase(handle);
+
+                edge.points.clear();
+                edge.print   = 0;
+                edge.dirty   = false;
+                edge.indexed = false;
+                continue;
+            }
+
+            internal::ChainOf(store, src, source);
+            internal::ChainOf(store, dst, target);
+            internal::ControlsOf(source, target, store, controls);
+
+            uint64_t print = sdk::util::HashBytes(reinterpret_cast<char const *>(&m_strength), sizeof m_strength);
+            print = sdk::util::HashBytes(reinterpret_cast<char const *>(controls.data()), controls.size() * sizeof(RoutePoint), print);
+            if (!edge.dirty && print == edge.print)
+                continue;
+
+            markDirty(handle, edge);
+            res.push_back({ handle, generation, m_strength, controls });
+
+            edge.print      = print;
+            edge.generation = generation;
+            edge.dirty      = false;
+        }
+
+        if (!res.empty())
+            m_generation = generation;
+        m_rev = store.revision();
+        return res;
+    }
+
+    EdgeBundler::Result EdgeBundler::Bundle(Request const &req) {
+        Result res{ req.edge, req.generation, {} };
+
+        std::vector<RoutePoint> const &ctrl = req.controls;
+        if (ctrl.size() < 3) {
+            res.points = ctrl;
+
+            return res;
+        }
+
+        /*
+         * Straighten the control polygon towards the line between the end points, then pad it with
+         * two extra copies of either end point so that the curve starts and ends exactly there.
+         */
+        size_t const            n = ctrl.size();
+        RoutePoint const        a = ctrl.front();
+        RoutePoint const        b = ctrl.back();
+        std::vector<RoutePoint> pts;
+        pts.reserve(n + 4);
+        pts.insert(pts.end(), 2, a);
+        for (size_t i = 0; i < n; ++i) {
+            float const t = static_cast<float>(i) / static_cast<float>(n - 1);
+
+            pts.push_back({
+                req.strength * ctrl[i].x + (1.0f - req.strength) * (a.x + t * (b.x - a.x)),
+                req.strength * ctrl[i].y + (1.0f - req.strength) * (a.y + t * (b.y - a.y))
+            });
+        }
+        pts.insert(pts.end(), 2, b);
+
+        res.points.reserve((pts.size() - 3) * gl_samples + 1);
+        for (size_t i = 0; i + 3 < pts.size(); ++i)
+            for (uint32_t k = 0; k < gl_samples; ++k)
+                res.points.push_back(internal::SplineAt(pts[i], pts[i + 1], pts[i + 2], pts[i + 3], static_cast<float>(k) / gl_samples));
+        res.points.push_back(b);
+        return res;
+    }
+
+    bool EdgeBundler::apply(Result res) {
+        auto const it = m_edges.find(res.edge);
+        if (it == m_edges.end() || it->second.dirty || it->second.generation != res.generation || res.points.empty())
+            return false;
+
+        Edge &edge = it->second;
+        m_curves.insert(res.edge, internal::BoundsOf(res.points));
+
+        edge.points  = std::move(res.points);
+        edge.bundled = res.generation;
+        edge.indexed = true;
+        m_pending.erase(res.edge);
+        return true;
+    }
+
+
+    size_t EdgeBundler::bundleAll(sdk::ElementStore const &store) {
+        size_t n = 0;
+
+        for (Request const &req : prepare(store))
+            n += apply(Bundle(req)) ? 1 : 0;
+        return n;
+    }
+
+    sdk::TaskHandle EdgeBundler::bundleAsync(sdk::ElementStore const &store, std::function<void(std::vector<Result>)> deliver) {
+        std::vector<Request> reqs = prepare(store);
+        if (reqs.empty())
+            return {};
+
+        std::vector<sdk::ElementHandle> edges;
+        edges.reserve(reqs.size());
+        for (Request const &req : reqs)
+            edges.push_back(req.edge);
+
+        sdk::TaskHandle task = sdk::SubmitTask([reqs = std::move(reqs), deliver = std::move(deliver)]() {
+            std::vector<Result> res(reqs.size());
+
+            sdk::ParallelFor(reqs.size(), [&](size_t const i) {
+                if (!sdk::IsTaskCancelled())
+                    res[i] = Bundle(reqs[i]);
+            });
+            if (sdk::IsTaskCancelled())
+                return;
+
+            deliver(std::move(res));
+        }, sdk::TaskPriority::High);
+
+        /* Edges that could not be submitted are requested again with the next generation. */
+        if (!task.isValid()) {
+            for (sdk::ElementHandle const handle : edges)
+                m_edges.find(handle)->second.dirty = true;
+            m_rev = UINT64_MAX;
+        }
+        return task;
+    }
+
+
+    bool EdgeBundler::curve(sdk::ElementStore const &store, sdk::ElementHandle edge, std::vector<RoutePoint> &res) const {
+        res.clear();
+
+        auto const it = m_edges.find(edge);
+        if (it == m_edges.end())
+            return false;
+
+        Edge const &state = it->second;
+        if (state.indexed) {
+            res = state.points;
+
+            return true;
+        }
+
+        /* Until the curve lands, a straight line between the end points is shown. */
+        uint32_t const src = store.indexOf(state.source);
+        uint32_t const dst = store.indexOf(state.target);
+        if (src != internal::BundleTable::gl_invalid && dst != internal::BundleTable::gl_invalid)
+            res = { internal::MidpointOf(store.bounds()[src]), internal::MidpointOf(store.bounds()[dst]) };
+
+        return false;
+    }
+
+    void EdgeBundler::collect(sdk::ElementStore const &store, QRectF const &region, QPainterPath &res) const {
+        SZSDK_PROFILE_SCOPE("EdgeBundler::collect");
+
+        sdk::ElementRect const area = {
+            static_cast<float>(region.x()),
+            static_cast<float>(region.y()),
+            static_cast<float>(region.width()),
+            static_cast<float>(region.height())
+        };
+
+        m_curves.query(area, [&](sdk::ElementHandle const handle, sdk::ElementRect const &) {
+            internal::AddPolyline(m_edges.find(handle)->second.points, res);
+        });
+
+        std::vector<RoutePoint> line;
+        for (sdk::ElementHandle const handle : m_pending) {
+            curve(store, handle, line);
+
+            if (line.size() == 2 && internal::BoundsOf(line).intersects(area))
+                internal::AddPolyline(line, res);
+        }
+    }
+
+
+    sdk::ElementHandle EdgeBundler::hitTest(sdk::ElementStore const &store, float const x, float const y, float const tolerance) const {
+        SZSDK_PROFILE_SCOPE("EdgeBundler::hitTest");
+
+        static_assert(sizeof(RoutePoint) == 2 * sizeof(float), "RoutePoint must be packed as two floats");
+
+        sdk::ElementRect const area = { x - tolerance, y - tolerance, 2.0f * tolerance, 2.0f * tolerance };
+        m_segments.clear();
+        m_hits.clear();
+
+        /* broad phase: only edges whose bounds come within the tolerance */
+        m_curves.query(area, [&](sdk::ElementHandle const handle, sdk::ElementRect const &) {
+            std::vector<RoutePoint> const &points = m_edges.find(handle)->second.points;
+
+            if (m_segments.add(static_cast<uint32_t>(m_hits.size()), &points.front().x, points.size()) == sdk::ErrorCode::Ok)
+                m_hits.push_back(handle);
+        });
+
+        std::vector<RoutePoint> line;
+        for (sdk::ElementHandle const handle : m_pending) {
+            curve(store, handle, line);
+
+            if (line.size() == 2 && internal::BoundsOf(line).intersects(area) && m_segments.add(static_cast<uint32_t>(m_hits.size()), &line.front().x, line.size()) == sdk::ErrorCode::Ok)
+                m_hits.push_back(handle);
+        }
+
+        /* narrow phase: exact distances to all packed segments at once */
+        sdk::SegmentHit const hit = m_segments.nearest(x, y);
+        if (hit.segment == UINT32_MAX || hit.dist2 > tolerance * tolerance)
+            return sdk::gl_nullelement;
+        return m_hits[hit.owner];
+    }
+
+
+    void EdgeBundler::markDirty(sdk::ElementHandle handle, Edge &edge) {
+        m_pending.insert(handle);
+
+        if (edge.indexed)
+            m_curves.remove(handle);
+        edge.indexed = false;
+        edge.dirty   = true;
+    }
+}
+
+
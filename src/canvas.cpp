@@ -0,0 +1,638 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  canvas.cpp
+ * \brief implementation of the diagram canvas
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+/* external includes */
+#include <QMetaObject>
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QPen>
+#include <QResizeEvent>
+#include <QWheelEvent>
+
+/* sdk includes */
+#include <sdk/profile.hpp>
+
+/* app includes */
+#include <canvas.hpp>
+#include <framemonitor.hpp>
+#include <metrics.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        constexpr double gl_strokemargin = 2.0; /**< margin around changed regions covering strokes, in scene units */
+        constexpr size_t gl_maxrestyled  = 256; /**< restyled elements above which their common bounds are invalidated at once */
+        constexpr double gl_maxlayer     = 4096.0 * 4096.0; /**< pixels of the drag layer above which it is rendered at a lower resolution */
+
+
+        /**
+         * \brief  expands a region of the scene by *gl_strokemargin* in every direction
+         *
+         * \param  [in] region region in scene coordinates
+         *
+         * \return expanded region
+         */
+        static QRectF WithStrokeMargin(QRectF const &region) noexcept {
+            return region.adjusted(-gl_strokemargin, -gl_strokemargin, gl_strokemargin, gl_strokemargin);
+        }
+
+        /**
+         * \brief  retrieves the time motions of the view are measured with
+         *
+         * \return seconds since the epoch of *std::chrono::steady_clock*
+         */
+        static double Seconds() noexcept {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /**
+         * \brief  renders a tile from a snapshot of its elements; may run on any thread
+         *
+         * \param  [in] render renderer to paint with
+         * \param  [in] items elements intersecting the tile
+         * \param  [in] key key of the tile; determines zoom factor and device pixel ratio
+         * \param  [in] detail level of detail
+         * \param  [in] background background color
+         *
+         * \return rendered tile, tagged with its device pixel ratio
+         */
+        static QImage RenderTile(DiagramRenderer const &render, std::vector<RenderItem> const &items, TileKey const &key, DetailLevel const detail, QColor const &background) {
+            double const scale = TileCache::ZoomOf(key) * TileCache::RatioOf(key);
+
+            QImage image(TileCache::gl_tilesize, TileCache::gl_tilesize, QImage::Format_ARGB32_Premultiplied);
+            image.fill(background);
+            {
+                QPainter painter(&image);
+                painter.setRenderHint(QPainter::Antialiasing, detail != DetailLevel::Outlines);
+                painter.scale(scale, scale);
+                painter.translate(-TileCache::SceneRect(key).topLeft());
+                render.render(painter, items, detail);
+            }
+
+            /* Drawn at its size in device-independent pixels, the tile maps one to one onto the screen. */
+            image.setDevicePixelRatio(TileCache::RatioOf(key));
+            return image;
+        }
+
+        /**
+         * \brief  renders dragged elements onto a transparent image
+         *
+         * \param  [in] render renderer to paint with
+         * \param  [in] items dragged elements, bottom-most first
+         * \param  [in] region region of the scene covered by the image
+         * \param  [in] scale pixels per scene unit
+         * \param  [in] detail level of detail
+         *
+         * \return rendered elements
+         */
+        static QImage RenderLayer(DiagramRenderer const &render, std::vector<RenderItem> const &items, QRectF const &region, double const scale, DetailLevel const detail) {
+            QImage image(static_cast<int>(std::ceil(region.width() * scale)), static_cast<int>(std::ceil(region.height() * scale)), QImage::Format_ARGB32_Premultiplied);
+            image.fill(Qt::transparent);
+
+            QPainter painter(&image);
+            painter.setRenderHint(QPainter::Antialiasing, detail != DetailLevel::Outlines);
+            painter.scale(scale, scale);
+            painter.translate(-region.topLeft());
+            render.render(painter, items, detail);
+
+            return image;
+        }
+    }
+
+
+    DiagramCanvas::DiagramCanvas(LodThresholds const &lod, size_t tilebudget, QWidget *parent) noexcept
+        : QWidget(parent), m_store(nullptr), m_lod(lod), m_tiles(tilebudget), m_seen(0), m_ticket(1), m_ratio(1.0)
+    {
+        setAttribute(Qt::WA_OpaquePaintEvent);
+        m_groups.setLegible(lod.clusters);
+
+        if (FrameMonitor *const hud = FrameMonitor::Instance())
+            hud->watch(this);
+    }
+
+    DiagramCanvas::~DiagramCanvas() {
+        /* Tasks refer to the canvas, including cancelled ones; results posted meanwhile are discarded along with it. */
+        for (auto const &[key, pending] : m_pending)
+            pending.task.cancel();
+        for (auto const &[key, pending] : m_pending)
+            pending.task.wait();
+        m_retired.wait();
+    }
+
+
+    void DiagramCanvas::setStore(sdk::ElementStore const *store) noexcept {
+        m_store = store;
+        m_seen  = store != nullptr ? store->revision() : 0;
+        m_marked.clear();
+        m_dragged.clear();
+        m_layer = {};
+        m_groups.clear();
+        m_motion.reset();
+
+        dropTiles();
+        update();
+    }
+
+    void DiagramCanvas::setLodThresholds(LodThresholds const &lod) noexcept {
+        m_lod = lod;
+        m_groups.setLegible(lod.clusters);
+
+        dropTiles();
+        update();
+    }
+
+    void DiagramCanvas::setStyles(std::shared_ptr<StyleSheet const> styles) noexcept {
+        StyleDelta delta;
+        bool const diffed = m_store != nullptr && StyleSheet::Diff(m_render.styles().get(), styles.get(), delta) == sdk::ErrorCode::Ok;
+
+        m_render.setStyles(std::move(styles));
+        if (!diffed) {
+            dropTiles();
+            update();
+
+            return;
+        }
+        if (delta.empty())
+            return;
+
+        /* Only tiles showing elements that look different are rendered again. */
+        try {
+            sdk::ElementKind const *const kinds  = m_store->kinds();
+            sdk::ElementRect const *const bounds = m_store->bounds();
+            uint32_t const *const         ids    = m_store->styles();
+            uint32_t const *const         flags  = m_store->flags();
+
+            std::vector<QRectF> regions;
+            QRectF              all;
+            for (uint32_t i = 0; i < m_store->size(); ++i) {
+                if ((flags[i] & sdk::ElementHidden) != 0 || !delta.changed(kinds[i], ids[i], flags[i]))
+                    continue;
+
+                QRectF const region = internal::WithStrokeMargin(QRectF(bounds[i].x, bounds[i].y, bounds[i].w, bounds[i].h));
+                if (regions.size() < internal::gl_maxrestyled)
+                    regions.push_back(region);
+                all = all.united(region);
+            }
+            if (regions.size() == internal::gl_maxrestyled)
+                regions.assign(1, all);
+
+            for (QRectF const &region : regions)
+                invalidate(region);
+            if (!regions.empty())
+                update();
+        } catch (...) {
+            dropTiles();
+            update();
+        }
+    }
+
+
+    void DiagramCanvas::setViewport(double const zoom, QPointF const &origin) noexcept {
+        m_view.setViewport(zoom, origin);
+        m_motion.reset();
+
+        update();
+        viewChanged();
+    }
+
+    void DiagramCanvas::setHighlight(std::vector<sdk::ElementHandle> const &elements) noexcept {
+        try {
+            m_marked.clear();
+            m_marked.insert(elements.begin(), elements.end());
+        } catch (...) {
+            m_marked.clear();
+        }
+
+        update();
+    }
+
+    bool DiagramCanvas::beginDrag(std::vector<sdk::ElementHandle> const &elements) noexcept {
+        if (m_store == nullptr)
+            return false;
+
+        try {
+            std::vector<uint32_t> dense;
+            dense.reserve(elements.size());
+            for (sdk::ElementHandle const handle : elements) {
+                uint32_t const at = m_store->indexOf(handle);
+
+                if (at != sdk::HandleTable<sdk::ElementHandle>::gl_invalid && (m_store->flags()[at] & sdk::ElementHidden) == 0)
+                    dense.push_back(at);
+            }
+            if (dense.empty())
+                return false;
+
+            /* The layer is painted in the same order as the tiles, bottom-most first. */
+            std::sort(dense.begin(), dense.end());
+            dense.erase(std::unique(dense.begin(), dense.end()), dense.end());
+
+            std::vector<RenderItem>                items;
+            std::unordered_set<sdk::ElementHandle> dragged;
+            QRectF                                 region;
+            items.reserve(dense.size());
+            for (uint32_t const at : dense) {
+                sdk::ElementRect const &r = m_store->bounds()[at];
+
+                items.push_back(m_render.itemOf(*m_store, at));
+                dragged.insert(m_store->handleAt(at));
+                region = region.united(QRectF(r.x, r.y, r.w, r.h));
+            }
+            region = internal::WithStrokeMargin(region);
+
+            /* Huge selections are rendered coarser; the layer only has to last for the drag. */
+            double const zoom  = m_view.zoom();
+            double const scale = std::min(zoom * devicePixelRatioF(), std::sqrt(internal::gl_maxlayer / std::max(1.0, region.width() * region.height())));
+            QImage       image = internal::RenderLayer(m_render, items, region, scale, m_lod.select(zoom));
+
+            m_dragged.swap(dragged);
+            m_layer = { std::move(image), region, QPointF(), false };
+        } catch (...) {
+            m_dragged.clear();
+            m_layer = {};
+
+            return false;
+        }
+
+        /* The tiles below are rendered again without the selection. */
+        invalidate(m_layer.bounds);
+        update();
+        return true;
+    }
+
+    void DiagramCanvas::dragTo(QPointF const &offset) noexcept {
+        if (!isDragging())
+            return;
+
+        m_layer.offset = offset;
+        update();
+    }
+
+    QPointF DiagramCanvas::endDrag() noexcept {
+        if (!isDragging())
+            return {};
+
+        /* The layer stays until the tiles show the selection again, wherever the owner puts it. */
+        m_dragged.clear();
+        m_layer.settling = true;
+
+        invalidate(m_layer.bounds);
+        update();
+        return m_layer.offset;
+    }
+
+    void DiagramCanvas::centerOn(QPointF const &pos) noexcept {
+        m_view.centerOn(pos, QSizeF(width(), height()));
+        m_motion.reset();
+
+        update();
+        viewChanged();
+    }
+
+
+    void DiagramCanvas::paintEvent(QPaintEvent *event) {
+        static uint32_t const gl_metric = Metrics::Local().add("frame.paint", Metrics::Kind::Histogram);
+        sdk::ProfileScope const zone(FrameMonitor::PaintZone());
+        MetricTimer const       timer(gl_metric);
+
+        /* After moving to a screen of another scaling, the tiles of the former one stand in until replaced. */
+        double const ratio = devicePixelRatioF();
+        if (ratio != m_ratio) {
+            m_ratio = ratio;
+            m_motion.reset();
+        }
+
+        QPainter painter(this);
+        painter.fillRect(event->rect(), palette().base());
+        if (m_store != nullptr) {
+            if (paintTiles(painter, event->rect()) && m_layer.settling)
+                m_layer = {};
+
+            paintDrag(painter);
+            paintHighlight(painter, event->rect());
+        }
+
+        if (FrameMonitor const *const hud = FrameMonitor::Instance())
+            hud->paintOverlay(painter, this->rect());
+    }
+
+    bool DiagramCanvas::paintTiles(QPainter &painter, QRect const &rect) {
+        syncTiles();
+
+        /* Only tiles intersecting the exposed part of the viewport are drawn; the grid is in device pixels. */
+        int const     size   = TileCache::gl_tilesize;
+        QPointF const offset = tileOffset();
+        int32_t const tx0    = static_cast<int32_t>(std::floor((offset.x() + rect.left() * m_ratio) / size));
+        int32_t const ty0    = static_cast<int32_t>(std::floor((offset.y() + rect.top() * m_ratio) / size));
+        int32_t const tx1    = static_cast<int32_t>(std::floor((offset.x() + (rect.left() + rect.width()) * m_ratio) / size));
+        int32_t const ty1    = static_cast<int32_t>(std::floor((offset.y() + (rect.top() + rect.height()) * m_ratio) / size));
+
+        bool complete = true;
+        for (int32_t ty = ty0; ty <= ty1; ++ty)
+            for (int32_t tx = tx0; tx <= tx1; ++tx) {
+                TileKey const          key  = TileCache::KeyOf(m_view.zoom(), m_ratio, tx, ty);
+                TileCache::Tile const *tile = m_tiles.find(key);
+
+                if (tile == nullptr || tile->dirty) {
+                    requestTile(key);
+
+                    complete = false;
+                }
+                if (tile != nullptr)
+                    painter.drawImage(tileRect(key, offset).topLeft(), tile->image);
+                else
+                    paintPlaceholder(painter, key, offset);
+            }
+
+        /* Tiles that have left the viewport, e.g. after zooming or moving to another screen, are no longer needed. */
+        int32_t const vx0  = static_cast<int32_t>(std::floor(offset.x() / size));
+        int32_t const vy0  = static_cast<int32_t>(std::floor(offset.y() / size));
+        int32_t const vx1  = static_cast<int32_t>(std::floor((offset.x() + width() * m_ratio) / size));
+        int32_t const vy1  = static_cast<int32_t>(std::floor((offset.y() + height() * m_ratio) / size));
+        TileKey const grid = TileCache::KeyOf(m_view.zoom(), m_ratio, 0, 0);
+
+        for (auto it = m_pending.begin(); it != m_pending.end();) {
+            TileKey const &key = it->first;
+
+            /* Predicted tiles are canceled by *prefetchTiles()* once the motion changes. */
+            if (!it->second.prefetch && (!TileCache::SameGrid(key, grid) || key.x < vx0 || key.x > vx1 || key.y < vy0 || key.y > vy1)) {
+                m_retired.retire(it->second.task);
+
+                it = m_pending.erase(it);
+            } else
+                ++it;
+        }
+
+        return complete;
+    }
+
+    void DiagramCanvas::paintDrag(QPainter &painter) const {
+        if (m_layer.image.isNull())
+            return;
+
+        /* The whole selection moves by a single offset; the layer is scaled if the zoom changed. */
+        double const  zoom   = m_view.zoom();
+        QPointF const offset = tileOffset() / m_ratio;
+        QPointF const at     = (m_layer.bounds.topLeft() + m_layer.offset) * zoom - offset;
+
+        painter.drawImage(QRectF(at, m_layer.bounds.size() * zoom), m_layer.image);
+    }
+
+    void DiagramCanvas::wheelEvent(QWheelEvent *event) {
+        QPointF const anchor = event->position();
+        double const  steps  = event->angleDelta().y() / 120.0;
+        m_view.wheel(event);
+
+        update();
+        viewChanged();
+        if (steps != 0.0)
+            prefetchTiles(m_motion.zoom(m_view, anchor, steps, internal::Seconds()));
+    }
+
+    void DiagramCanvas::mousePressEvent(QMouseEvent *event) {
+        if (!m_view.press(event))
+            QWidget::mousePressEvent(event);
+    }
+
+    void DiagramCanvas::mouseMoveEvent(QMouseEvent *event) {
+        if (m_view.move(event)) {
+            update();
+            viewChanged();
+            prefetchTiles(m_motion.pan(m_view, internal::Seconds()));
+        } else
+            QWidget::mouseMoveEvent(event);
+    }
+
+    void DiagramCanvas::mouseReleaseEvent(QMouseEvent *event) {
+        if (!m_view.release(event))
+            QWidget::mouseReleaseEvent(event);
+    }
+
+    void DiagramCanvas::resizeEvent(QResizeEvent *event) {
+        QWidget::resizeEvent(event);
+
+        viewChanged();
+    }
+
+
+    void DiagramCanvas::viewChanged() noexcept {
+        if (!m_viewfn)
+            return;
+
+        try {
+            m_viewfn(visibleRect());
+        } catch (...) { }
+    }
+
+    void DiagramCanvas::syncTiles() noexcept {
+        syncClusters(m_view.zoom());
+
+        uint64_t const rev = m_store->revision();
+        if (rev == m_seen)
+            return;
+
+        try {
+            m_changes.clear();
+
+            if (m_store->changesSince(m_seen, m_changes)) {
+                for (sdk::ElementRect const &change : m_changes)
+                    invalidate(internal::WithStrokeMargin(QRectF(change.x, change.y, change.w, change.h)));
+            } else
+                dropTiles();
+        } catch (...) {
+            dropTiles();
+        }
+
+        m_seen = rev;
+    }
+
+    void DiagramCanvas::syncClusters(double zoom) noexcept {
+        /* Collapsed packages span many tiles, so tiles showing them are redrawn as a whole. */
+        double const below = m_groups.sync(*m_store, zoom);
+        if (below > 0.0)
+            invalidateBelow(below);
+    }
+
+    void DiagramCanvas::invalidate(QRectF const &region) noexcept {
+        /* Pending tiles were rendered from an older snapshot. */
+        m_tiles.invalidate(region);
+        for (auto &[key, pending] : m_pending)
+            if (!pending.stale && TileCache::SceneRect(key).intersects(region))
+                pending.stale = true;
+    }
+
+    void DiagramCanvas::invalidateBelow(double zoom) noexcept {
+        m_tiles.invalidateBelow(zoom);
+        for (auto &[key, pending] : m_pending)
+            if (!pending.stale && TileCache::ZoomOf(key) < zoom)
+                pending.stale = true;
+    }
+
+    void DiagramCanvas::dropTiles() noexcept {
+        for (auto const &[key, pending] : m_pending)
+            m_retired.retire(pending.task);
+
+        m_pending.clear();
+        m_tiles.clear();
+    }
+
+    void DiagramCanvas::requestTile(TileKey const &key, bool const prefetch) noexcept {
+        auto const it = m_pending.find(key);
+        if (it != m_pending.end() && !it->second.stale && (prefetch || !it->second.prefetch))
+            return;
+
+        try {
+            /* The task only sees a snapshot, so the store may change while the tile is rendered. */
+            double const            zoom = TileCache::ZoomOf(key);
+            std::vector<RenderItem> items;
+            syncClusters(zoom);
+            m_groups.collect(*m_store, m_render, zoom, internal::WithStrokeMargin(TileCache::SceneRect(key)), items, m_dragged.empty() ? nullptr : &m_dragged);
+
+            uint64_t const ticket = m_ticket++;
+            sdk::TaskHandle task  = sdk::SubmitTask([this, key, ticket, items = std::move(items), render = m_render, detail = m_lod.select(zoom), background = palette().base().color()]() {
+                if (sdk::IsTaskCancelled())
+                    return;
+
+                QImage image = internal::RenderTile(render, items, key, detail, background);
+                QMetaObject::invokeMethod(this, [this, key, ticket, image = std::move(image)]() mutable {
+                    deliverTile(key, ticket, std::move(image));
+                }, Qt::QueuedConnection);
+            }, prefetch ? sdk::TaskPriority::Low : sdk::TaskPriority::High);
+            if (!task.isValid())
+                return;
+
+            if (it != m_pending.end())
+                m_retired.retire(it->second.task);
+            m_pending[key] = { std::move(task), ticket, false, prefetch };
+        } catch (...) { }
+    }
+
+    void DiagramCanvas::prefetchTiles(bool const changed) noexcept {
+        if (m_store == nullptr)
+            return;
+
+        try {
+            m_motion.predict(m_view, QSizeF(size()), m_ratio, internal::Seconds(), m_ahead);
+
+            /* Tiles predicted for an abandoned motion would only keep the workers busy. */
+            if (changed) {
+                std::unordered_set<TileKey, TileKeyHash> const keep(m_ahead.begin(), m_ahead.end());
+
+                for (auto it = m_pending.begin(); it != m_pending.end();) {
+                    if (it->second.prefetch && keep.find(it->first) == keep.end()) {
+                        m_retired.retire(it->second.task);
+
+                        it = m_pending.erase(it);
+                    } else
+                        ++it;
+                }
+            }
+
+            for (TileKey const &key : m_ahead) {
+                TileCache::Tile const *const tile = m_tiles.find(key);
+
+                if (tile == nullptr || tile->dirty)
+                    requestTile(key, true);
+            }
+        } catch (...) { }
+    }
+
+    void DiagramCanvas::deliverTile(TileKey const &key, uint64_t ticket, QImage image) noexcept {
+        auto const it = m_pending.find(key);
+        if (it == m_pending.end() || it->second.ticket != ticket)
+            return;
+
+        /* Stale tiles are still better than placeholders; they are requested again when painted. */
+        bool const stale = it->second.stale;
+        m_pending.erase(it);
+        try {
+            m_tiles.insert(key, std::move(image), stale);
+        } catch (...) {
+            return;
+        }
+
+        if (TileCache::SameGrid(key, TileCache::KeyOf(m_view.zoom(), m_ratio, 0, 0)))
+            update(tileRect(key, tileOffset()).toAlignedRect());
+    }
+
+    void DiagramCanvas::paintHighlight(QPainter &painter, QRect const &rect) const {
+        if (m_marked.empty())
+            return;
+
+        /* Outlines are drawn around the bounds, so elements just outside the exposed part count as well. */
+        double const           zoom    = m_view.zoom();
+        QPointF const          offset  = tileOffset() / m_ratio;
+        QRectF const           scene   = internal::WithStrokeMargin(QRectF(QPointF(offset + rect.topLeft()) / zoom, QSizeF(rect.size()) / zoom));
+        sdk::ElementRect const exposed = {
+            static_cast<float>(scene.x()), static_cast<float>(scene.y()), static_cast<float>(scene.width()), static_cast<float>(scene.height())
+        };
+
+        std::vector<sdk::ElementHandle> visible;
+        m_store->query(exposed, visible);
+
+        painter.save();
+        painter.setPen(QPen(palette().highlight().color(), 2.0));
+        painter.setBrush(Qt::NoBrush);
+        painter.setRenderHint(QPainter::Antialiasing);
+        sdk::ElementRect const *const bounds = m_store->bounds();
+        for (sdk::ElementHandle const handle : visible) {
+            if (m_marked.find(handle) == m_marked.end())
+                continue;
+
+            sdk::ElementRect const &r = bounds[m_store->indexOf(handle)];
+            painter.drawRect(QRectF(r.x * zoom - offset.x(), r.y * zoom - offset.y(), r.w * zoom, r.h * zoom).adjusted(-1.0, -1.0, 1.0, 1.0));
+        }
+        painter.restore();
+    }
+
+    void DiagramCanvas::paintPlaceholder(QPainter &painter, TileKey const &key, QPointF const &offset) const {
+        std::vector<std::pair<QRectF, QImage const *>> found;
+        m_tiles.visit(TileCache::SceneRect(key), [&](TileKey const &other, TileCache::Tile const &tile) {
+            if (!TileCache::SameGrid(other, key))
+                found.emplace_back(TileCache::SceneRect(other), &tile.image);
+        });
+        if (found.empty())
+            return;
+
+        /* Coarser tiles are painted first, so finer ones end up on top. */
+        std::sort(found.begin(), found.end(), [](auto const &a, auto const &b) { return a.first.width() > b.first.width(); });
+
+        painter.save();
+        painter.setClipRect(tileRect(key, offset));
+        for (auto const &[scene, image] : found)
+            painter.drawImage(QRectF(scene.topLeft() * m_view.zoom() - offset / m_ratio, scene.size() * m_view.zoom()), *image);
+        painter.restore();
+    }
+
+    QRectF DiagramCanvas::tileRect(TileKey const &key, QPointF const &offset) const noexcept {
+        double const size = TileCache::gl_tilesize;
+
+        return { (key.x * size - offset.x()) / m_ratio, (key.y * size - offset.y()) / m_ratio, size / m_ratio, size / m_ratio };
+    }
+
+    QPointF DiagramCanvas::tileOffset() const noexcept {
+        QPointF const origin = m_view.origin() * (m_view.zoom() * m_ratio);
+
+        return { std::round(origin.x()), std::round(origin.y()) };
+    }
+}
+
+
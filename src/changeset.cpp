@@ -0,0 +1,235 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  changeset.cpp
+ * \brief implementation of coalesced change notifications from the model to its views
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+
+/* external includes */
+#include <QMetaObject>
+
+/* app includes */
+#include <changeset.hpp>
+
+
+namespace suzu {
+    void ChangeSet::add(sdk::ChangeRecord const &change) {
+        if (m_all)
+            return;
+
+        auto const it = m_elements.try_emplace(change.element, Element{ gl_none, gl_none, {} }).first;
+        Element   &el = it->second;
+
+        uint32_t const next = static_cast<uint32_t>(m_records.size());
+        switch (change.kind) {
+            case sdk::ElementAdded:
+                m_records.push_back(change);
+                el.added = next;
+                break;
+            case sdk::ElementRemoved:
+                for (uint32_t const index : el.modified)
+                    drop(index);
+                if (el.moved != gl_none)
+                    drop(el.moved);
+
+                /* An element that was added and removed again never existed for the views. */
+                if (el.added != gl_none) {
+                    drop(el.added);
+
+                    m_elements.erase(it);
+                    break;
+                }
+
+                el.modified.clear();
+                el.moved = gl_none;
+                m_records.push_back(change);
+                break;
+            case sdk::ElementModified:
+                if (el.added != gl_none)
+                    break;
+                for (uint32_t const index : el.modified)
+                    if (m_records[index].args[0] == change.args[0])
+                        return;
+
+                el.modified.reserve(el.modified.size() + 1);
+                m_records.push_back(change);
+                el.modified.push_back(next);
+                break;
+            case sdk::ElementMoved:
+                if (el.added != gl_none) {
+                    m_records[el.added].parent = change.parent;
+                    break;
+                } else if (el.moved != gl_none) {
+                    m_records[el.moved].parent  = change.parent;
+                    m_records[el.moved].args[0] = change.args[0];
+                    m_records[el.moved].args[1] = change.args[1];
+                    break;
+                }
+
+                m_records.push_back(change);
+                el.moved = next;
+                break;
+            default:
+                m_records.push_back(change);
+                break;
+        }
+    }
+
+    void ChangeSet::clear() noexcept {
+        m_records.clear();
+        m_elements.clear();
+
+        m_dropped = 0;
+        m_all     = false;
+    }
+
+    void ChangeSet::invalidate() noexcept {
+        clear();
+
+        m_all = true;
+    }
+
+    void ChangeSet::compact() noexcept {
+        if (m_dropped == 0)
+            return;
+
+        m_records.erase(std::remove_if(m_records.begin(), m_records.end(), [](sdk::ChangeRecord const &rec) {
+            return rec.kind == sdk::__NumChangeKinds__;
+        }), m_records.end());
+
+        /* The indices of the remaining records have changed. */
+        m_elements.clear();
+        m_dropped = 0;
+    }
+
+    void ChangeSet::drop(uint32_t index) noexcept {
+        if (m_records[index].kind == sdk::__NumChangeKinds__)
+            return;
+
+        m_records[index].kind = sdk::__NumChangeKinds__;
+        ++m_dropped;
+    }
+
+
+    ChangeDispatcher::ChangeDispatcher() noexcept
+        : m_depth(0), m_posted(false), m_next(1)
+    {
+        try {
+            m_context = std::make_unique<QObject>();
+        } catch (...) { }
+    }
+
+    ChangeDispatcher::~ChangeDispatcher() {
+        /* Destroying the context discards a queued delivery. */
+        m_context.reset();
+    }
+
+
+    uint64_t ChangeDispatcher::subscribe(Listener listener) noexcept {
+        try {
+            m_listeners.emplace_back(m_next, std::move(listener));
+
+            return m_next++;
+        } catch (...) { }
+
+        return 0;
+    }
+
+    void ChangeDispatcher::unsubscribe(uint64_t id) noexcept {
+        m_listeners.erase(std::remove_if(m_listeners.begin(), m_listeners.end(), [id](auto const &entry) {
+            return entry.first == id;
+        }), m_listeners.end());
+    }
+
+
+    void ChangeDispatcher::begin() noexcept {
+        ++m_depth;
+    }
+
+    void ChangeDispatcher::end() noexcept {
+        if (m_depth == 0 || --m_depth != 0)
+            return;
+
+        if (!m_pending.empty())
+            post();
+    }
+
+
+    sdk::ErrorCode ChangeDispatcher::record(sdk::ChangeKind kind, sdk::ElementHandle element, sdk::ElementHandle parent, int64_t arg) noexcept {
+        sdk::ErrorCode res = sdk::ErrorCode::Ok;
+        try {
+            m_pending.add({ static_cast<uint32_t>(kind), 0, element.value(), parent.value(), { arg, 0 } });
+        } catch (...) {
+            m_pending.invalidate();
+
+            res = sdk::ErrorCode::CriticalResource;
+        }
+
+        if (m_depth == 0)
+            post();
+        return res;
+    }
+
+    void ChangeDispatcher::flush() noexcept {
+        if (m_depth != 0 || m_pending.empty())
+            return;
+
+        /* Listeners may record changes of their own; those go into the next delivery. */
+        ChangeSet changes;
+        changes.swap(m_pending);
+
+        changes.compact();
+        if (changes.empty())
+            return;
+
+        /* Listeners may unsubscribe while being called. */
+        std::vector<std::pair<uint64_t, Listener>> listeners;
+        try {
+            listeners = m_listeners;
+        } catch (...) {
+            return;
+        }
+
+        for (auto const &[id, listener] : listeners) {
+            try {
+                if (listener)
+                    listener(changes);
+            } catch (...) { }
+        }
+    }
+
+
+    void ChangeDispatcher::post() noexcept {
+        if (m_posted)
+            return;
+        else if (m_context == nullptr) {
+            flush();
+
+            return;
+        }
+
+        m_posted = true;
+        try {
+            QMetaObject::invokeMethod(m_context.get(), [this]() {
+                m_posted = false;
+
+                flush();
+            }, Qt::QueuedConnection);
+        } catch (...) {
+            m_posted = false;
+        }
+    }
+}
+
+
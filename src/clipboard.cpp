@@ -0,0 +1,418 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  clipboard.cpp
+ * \brief implementation of copying and pasting of diagram elements
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+/* external includes */
+#include <QClipboard>
+#include <QGuiApplication>
+#include <QMetaType>
+#include <QVariant>
+
+/* sdk includes */
+#include <sdk/config.hpp>
+#include <sdk/jsonimport.hpp>
+#include <sdk/project.hpp>
+
+/* app includes */
+#include <clipboard.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        constexpr char const *gl_textmime = "text/plain"; /**< MIME type of plain text; offered as JSON for text editors */
+
+        /**
+         * \brief  retrieves the dense index of the owner of an element
+         *
+         * \param  [in] store diagram
+         * \param  [in] index dense index of the element
+         *
+         * \return dense index of the owner; *UINT32_MAX* for top-level elements and stale owners
+         */
+        static uint32_t OwnerOf(sdk::ElementStore const &store, uint32_t const index) noexcept {
+            sdk::ElementHandle const parent = store.parents()[index];
+
+            return store.isValid(parent) ? store.indexOf(parent) : UINT32_MAX;
+        }
+
+        /**
+         * \brief  orders the elements of a diagram so that owners come before the elements they own
+         *
+         * \param  [in] store diagram
+         *
+         * \return dense indices; in painting order, except where an owner has to move up
+         * \throw  std::bad_alloc
+         */
+        static std::vector<uint32_t> OwnersFirst(sdk::ElementStore const &store) {
+            uint32_t const        n = store.size();
+            std::vector<uint32_t> order;
+            std::vector<uint32_t> chain;
+            std::vector<bool>     done(n, false);
+
+            order.reserve(n);
+            for (uint32_t i = 0; i < n; ++i) {
+                /* Elements are marked as they are walked, so cyclic ownership ends the chain. */
+                chain.clear();
+                for (uint32_t k = i; k != UINT32_MAX && !done[k]; k = OwnerOf(store, k)) {
+                    done[k] = true;
+                    chain.push_back(k);
+                }
+
+                order.insert(order.end(), chain.rbegin(), chain.rend());
+            }
+
+            return order;
+        }
+
+        /**
+         * \brief  creates copies of elements as a single undoable operation
+         *
+         * \param  [in] undo undo stack of the target diagram
+         * \param  [in] elements elements to copy
+         * \param  [in] dx horizontal offset added to the copies
+         * \param  [in] dy vertical offset added to the copies
+         * \param  [out] pasted (optional) receives the handles of the copies
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if there
+         *         are no elements, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out
+         */
+        static sdk::ErrorCode Insert(UndoStack &undo, sdk::ElementStore const &elements, float const dx, float const dy, std::vector<sdk::ElementHandle> *const pasted) noexcept {
+            if (elements.size() == 0)
+                return sdk::ErrorCode::NoOperation;
+
+            try {
+                /* Owners come first, so every copy refers to the copy of its owner by its index in the batch. */
+                std::vector<uint32_t> slots(elements.size(), sdk::ElementBatch::gl_nobatch);
+                sdk::ElementBatch     batch;
+                batch.reserve(elements.size());
+
+                for (uint32_t const i : OwnersFirst(elements)) {
+                    uint32_t const    owner  = OwnerOf(elements, i);
+                    sdk::ElementRect bounds = elements.bounds()[i];
+                    bounds.x += dx;
+                    bounds.y += dy;
+
+                    slots[i] = batch.add(elements.kinds()[i], bounds, elements.styles()[i], owner != UINT32_MAX ? slots[owner] : sdk::ElementBatch::gl_nobatch, elements.names()[i]);
+                    batch.setFlags(slots[i], elements.flags()[i] & ~static_cast<uint32_t>(sdk::ElementSelected));
+                }
+
+                std::vector<sdk::ElementHandle> copies;
+                sdk::ErrorCode const            err = undo.insert(batch, copies);
+                if (err == sdk::ErrorCode::Ok && pasted != nullptr)
+                    pasted->insert(pasted->end(), copies.begin(), copies.end());
+                return err;
+            } catch (...) { }
+
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        /**
+         * \brief  reads elements from a JSON document
+         *
+         * \param  [in] data document
+         * \param  [out] elements receives the elements; must be empty
+         *
+         * \return *true* if the document is a valid diagram
+         * \throw  std::bad_alloc
+         */
+        static bool ParseJson(QByteArray const &data, sdk::ElementStore &elements) {
+            sdk::JsonDiagramImporter importer(elements);
+
+            char const *const text = data.constData();
+            if (nlohmann::json::sax_parse(text, text + data.size(), &importer, nlohmann::json::input_format_t::json, true, true) && importer.finish())
+                return true;
+
+            elements.clear();
+            return false;
+        }
+    }
+
+
+    ElementMimeData::ElementMimeData(std::shared_ptr<sdk::ElementStore const> elements) noexcept
+        : m_elements(std::move(elements))
+    { }
+
+    bool ElementMimeData::hasFormat(QString const &mimetype) const {
+        return formats().contains(mimetype);
+    }
+
+    QStringList ElementMimeData::formats() const {
+        return { QString(gl_elementsmime), QString(gl_jsonmime), QString(internal::gl_textmime) };
+    }
+
+    QVariant ElementMimeData::retrieveData(QString const &mimetype, QMetaType type) const {
+        /* Only other applications ask for the data; pasting within the instance reads the snapshot. */
+        if (mimetype == QString(gl_elementsmime)) {
+            std::vector<char> encoded;
+            if (m_binary.isEmpty() && EncodeElements(*m_elements, encoded) == sdk::ErrorCode::Ok)
+                m_binary = QByteArray(encoded.data(), static_cast<qsizetype>(encoded.size()));
+
+            return m_binary;
+        } else if (mimetype == QString(gl_jsonmime) || mimetype == QString(internal::gl_textmime)) {
+            std::string json;
+            if (m_json.isEmpty() && EncodeElementsJson(*m_elements, json) == sdk::ErrorCode::Ok)
+                m_json = QByteArray(json.data(), static_cast<qsizetype>(json.size()));
+
+            return m_json;
+        }
+
+        return QMimeData::retrieveData(mimetype, type);
+    }
+
+
+    std::shared_ptr<sdk::ElementStore const> SnapshotElements(sdk::ElementStore const &store, std::vector<sdk::ElementHandle> const &handles) noexcept {
+        try {
+            std::vector<uint32_t> indices;
+            indices.reserve(handles.size());
+            for (sdk::ElementHandle const handle : handles)
+                if (store.isValid(handle))
+                    indices.push_back(store.indexOf(handle));
+            std::sort(indices.begin(), indices.end());
+            indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+            /* The snapshot is never hit-tested, so it goes without a spatial index. */
+            auto snap = std::make_shared<sdk::ElementStore>();
+            snap->setIndexed(false);
+            snap->reserve(static_cast<uint32_t>(indices.size()));
+
+            std::unordered_map<sdk::ElementHandle, sdk::ElementHandle> copies;
+            copies.reserve(indices.size());
+            for (uint32_t const i : indices) {
+                sdk::ElementHandle const copy = snap->create(store.kinds()[i], store.bounds()[i], store.styles()[i], sdk::gl_nullelement, store.names()[i]);
+
+                snap->flags()[snap->size() - 1] = store.flags()[i] & ~static_cast<uint32_t>(sdk::ElementSelected);
+                copies.emplace(store.handleAt(i), copy);
+            }
+            for (uint32_t k = 0; k < indices.size(); ++k) {
+                auto const it = copies.find(store.parents()[indices[k]]);
+
+                if (it != copies.end())
+                    snap->parents()[k] = it->second;
+            }
+
+            return snap;
+        } catch (...) { }
+
+        return nullptr;
+    }
+
+    sdk::ErrorCode EncodeElements(sdk::ElementStore const &elements, std::vector<char> &out) noexcept {
+        try {
+            std::vector<std::string_view>          strings(1);
+            std::unordered_map<uint32_t, uint32_t> ids;
+            std::vector<char>                      chunk;
+            std::vector<char>                      table;
+            sdk::internal::EncodeDiagram(elements, [&](sdk::StringId const str) { return sdk::internal::AddString(str, strings, ids); }, chunk);
+            sdk::internal::EncodeStrings(strings, table);
+
+            /* Both parts are padded to multiples of 8 bytes, like in the journal. */
+            size_t const strsize = (table.size() + 7) & ~size_t(7);
+            size_t const total   = strsize + ((chunk.size() + 7) & ~size_t(7));
+
+            out.assign(sizeof(sdk::JournalRecord) + total, 0);
+            char *const data = out.data() + sizeof(sdk::JournalRecord);
+            std::memcpy(data, table.data(), table.size());
+            std::memcpy(data + strsize, chunk.data(), chunk.size());
+
+            sdk::JournalRecord record = { sdk::gl_chunkdiagram, 0, 0, elements.size(), strsize, total, 0 };
+            record.hash = sdk::internal::HashRecord(record, data);
+            std::memcpy(out.data(), &record, sizeof(record));
+
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    sdk::ErrorCode DecodeElements(char const *data, size_t size, sdk::ElementStore &elements) noexcept {
+        elements.clear();
+
+        sdk::JournalRecord record;
+        if (size < sizeof(record))
+            return sdk::ErrorCode::ReadFile;
+        std::memcpy(&record, data, sizeof(record));
+
+        char const *const payload = data + sizeof(record);
+        uint64_t const    n       = record.count;
+        if (record.type != sdk::gl_chunkdiagram || record.size != size - sizeof(record) || record.strings > record.size || sdk::internal::HashRecord(record, payload) != record.hash)
+            return sdk::ErrorCode::ReadFile;
+        if (record.size - record.strings < 8 + sdk::internal::gl_projecteltsize * n)
+            return sdk::ErrorCode::ReadFile;
+
+        /* The string table holds the number of strings, their offsets plus the end offset, and the characters. */
+        uint64_t const count = record.strings >= 8 ? sdk::internal::GetValue<uint32_t>(payload, 0) : 0;
+        if (record.strings < 8 || (record.strings - 8) / 4 < count + 1)
+            return sdk::ErrorCode::ReadFile;
+
+        char const *const offsets = payload + 8;
+        char const *const text    = offsets + 4 * (count + 1);
+        uint64_t const    chars   = record.strings - 8 - 4 * (count + 1);
+
+        char const *const chunk   = payload + record.strings;
+        char const *const kinds   = chunk + 8;
+        char const *const bounds  = kinds + 4 * n;
+        char const *const styles  = bounds + 16 * n;
+        char const *const flags   = styles + 4 * n;
+        char const *const parents = flags + 4 * n;
+        char const *const names   = parents + 4 * n;
+        if (sdk::internal::GetValue<uint32_t>(chunk, 0) != n)
+            return sdk::ErrorCode::ReadFile;
+
+        try {
+            std::vector<sdk::StringId> strings(static_cast<size_t>(count));
+            for (uint64_t i = 0; i < count; ++i) {
+                uint32_t const first = sdk::internal::GetValue<uint32_t>(offsets, static_cast<size_t>(i));
+                uint32_t const last  = sdk::internal::GetValue<uint32_t>(offsets, static_cast<size_t>(i + 1));
+                if (first > last || last > chars) {
+                    elements.clear();
+
+                    return sdk::ErrorCode::ReadFile;
+                }
+
+                strings[static_cast<size_t>(i)] = sdk::StringId(std::string_view(text + first, last - first));
+            }
+
+            elements.reserve(static_cast<uint32_t>(n));
+            for (uint32_t i = 0; i < n; ++i) {
+                uint32_t const kind = sdk::internal::GetValue<uint32_t>(kinds, i);
+                uint32_t const name = sdk::internal::GetValue<uint32_t>(names, i);
+                if (kind >= static_cast<uint32_t>(sdk::ElementKind::__NumElementKinds__) || (name != 0 && name >= count)) {
+                    elements.clear();
+
+                    return sdk::ErrorCode::ReadFile;
+                }
+
+                elements.create(static_cast<sdk::ElementKind>(kind), sdk::internal::GetValue<sdk::ElementRect>(bounds, i), sdk::internal::GetValue<uint32_t>(styles, i), sdk::gl_nullelement, name != 0 ? strings[name] : sdk::StringId());
+                elements.flags()[i] = sdk::internal::GetValue<uint32_t>(flags, i);
+            }
+
+            /* Owners may come after the elements they own in the painting order. */
+            for (uint32_t i = 0; i < n; ++i) {
+                uint32_t const parent = sdk::internal::GetValue<uint32_t>(parents, i);
+
+                if (parent < n && parent != i)
+                    elements.parents()[i] = elements.handleAt(parent);
+            }
+        } catch (...) {
+            elements.clear();
+
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode EncodeElementsJson(sdk::ElementStore const &elements, std::string &out) noexcept {
+        try {
+            sdk::JSON list = sdk::JSON::array();
+
+            /* Elements are identified by their position in the list. */
+            for (uint32_t i = 0; i < elements.size(); ++i) {
+                sdk::ElementRect const &bounds = elements.bounds()[i];
+                uint32_t const          owner  = internal::OwnerOf(elements, i);
+                uint32_t const          flags  = elements.flags()[i];
+
+                sdk::JSON elem = {
+                    { "id",     i },
+                    { "kind",   sdk::gl_kindnames[static_cast<size_t>(elements.kinds()[i])] },
+                    { "bounds", { bounds.x, bounds.y, bounds.w, bounds.h } }
+                };
+                if (owner != UINT32_MAX)
+                    elem["parent"] = owner;
+                if (!elements.names()[i].empty())
+                    elem["name"] = elements.names()[i].view();
+                if (elements.styles()[i] != 0)
+                    elem["style"] = elements.styles()[i];
+                if (flags & sdk::ElementHidden)
+                    elem["hidden"] = true;
+                if (flags & sdk::ElementLocked)
+                    elem["locked"] = true;
+
+                list.push_back(std::move(elem));
+            }
+
+            out = sdk::JSON({ { "name", "" }, { "elements", std::move(list) } }).dump();
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+
+    sdk::ErrorCode CopyElements(sdk::ElementStore const &store, std::vector<sdk::ElementHandle> const &handles) noexcept {
+        std::shared_ptr<sdk::ElementStore const> snap = SnapshotElements(store, handles);
+        if (snap == nullptr)
+            return sdk::ErrorCode::CriticalResource;
+        else if (snap->size() == 0)
+            return sdk::ErrorCode::NoOperation;
+
+        try {
+            /* The clipboard takes ownership of the data. */
+            QGuiApplication::clipboard()->setMimeData(new ElementMimeData(std::move(snap)));
+        } catch (...) {
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        return sdk::ErrorCode::Ok;
+    }
+
+    bool CanPasteElements() noexcept {
+        QMimeData const *const mime = QGuiApplication::clipboard()->mimeData();
+
+        return mime != nullptr && (qobject_cast<ElementMimeData const *>(mime) != nullptr || mime->hasFormat(gl_elementsmime) || mime->hasFormat(gl_jsonmime));
+    }
+
+    sdk::ErrorCode PasteElements(UndoStack &undo, float dx, float dy, std::vector<sdk::ElementHandle> *pasted) noexcept {
+        if (pasted != nullptr)
+            pasted->clear();
+
+        QMimeData const *const mime = QGuiApplication::clipboard()->mimeData();
+        if (mime == nullptr)
+            return sdk::ErrorCode::NoOperation;
+
+        /* Elements copied within the instance are pasted from the snapshot itself. */
+        if (ElementMimeData const *const own = qobject_cast<ElementMimeData const *>(mime))
+            return internal::Insert(undo, *own->elements(), dx, dy, pasted);
+
+        try {
+            sdk::ElementStore elements;
+            elements.setIndexed(false);
+
+            if (mime->hasFormat(gl_elementsmime)) {
+                QByteArray const     data = mime->data(gl_elementsmime);
+                sdk::ErrorCode const err  = DecodeElements(data.constData(), static_cast<size_t>(data.size()), elements);
+                if (err != sdk::ErrorCode::Ok)
+                    return err;
+            } else if (mime->hasFormat(gl_jsonmime)) {
+                if (!internal::ParseJson(mime->data(gl_jsonmime), elements))
+                    return sdk::ErrorCode::ReadFile;
+            } else
+                return sdk::ErrorCode::NoOperation;
+
+            return internal::Insert(undo, elements, dx, dy, pasted);
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+}
+
+
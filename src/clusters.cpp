@@ -0,0 +1,551 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  clusters.cpp
+ * \brief implementation of the semantic zoom of packages
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/util.hpp>
+
+/* app includes */
+#include <clusters.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \brief  retrieves the center of a rectangle
+         *
+         * \param  [in] rect rectangle
+         * \param  [out] x receives the x-coordinate of the center
+         * \param  [out] y receives the y-coordinate of the center
+         */
+        static void CenterOf(sdk::ElementRect const &rect, float &x, float &y) noexcept {
+            x = rect.x + rect.w / 2.0f;
+            y = rect.y + rect.h / 2.0f;
+        }
+
+        /**
+         * \brief  computes the bounds of a line for *suzu::RenderItem*
+         *
+         * \param  [in] x0 x-coordinate of the start
+         * \param  [in] y0 y-coordinate of the start
+         * \param  [in] x1 x-coordinate of the end
+         * \param  [in] y1 y-coordinate of the end
+         *
+         * \return bounds; the extent may be negative
+         */
+        static sdk::ElementRect LineOf(float const x0, float const y0, float const x1, float const y1) noexcept {
+            return { x0, y0, x1 - x0, y1 - y0 };
+        }
+
+        /**
+         * \brief  normalizes bounds with a negative extent, e.g. of lines
+         *
+         * \param  [in] rect bounds
+         *
+         * \return bounds with the same corners and a non-negative extent
+         */
+        static sdk::ElementRect Normalized(sdk::ElementRect const &rect) noexcept {
+            return { std::min(rect.x, rect.x + rect.w), std::min(rect.y, rect.y + rect.h), std::abs(rect.w), std::abs(rect.h) };
+        }
+
+        /**
+         * \brief  checks whether or not two rectangles overlap or touch
+         *
+         * Unlike *suzu::sdk::ElementRect::intersects()*, this also holds for rectangles without
+         * an extent, e.g. the normalized bounds of straight lines.
+         *
+         * \param  [in] a first rectangle; its extent must not be negative
+         * \param  [in] b second rectangle; its extent must not be negative
+         *
+         * \return *true* if the rectangles have at least one point in common
+         */
+        static bool Touches(sdk::ElementRect const &a, sdk::ElementRect const &b) noexcept {
+            return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h && b.y <= a.y + a.h;
+        }
+
+        /**
+         * \brief  mixes a value into a fingerprint
+         *
+         * \param  [in] hash fingerprint so far
+         * \param  [in] value value to mix in
+         *
+         * \return new fingerprint
+         */
+        template<class T> static uint64_t Mix(uint64_t const hash, T const value) noexcept {
+            char bytes[sizeof(T)];
+            std::memcpy(bytes, &value, sizeof(T));
+
+            return sdk::util::HashBytes(bytes, sizeof(T), hash);
+        }
+    }
+
+
+
+
+    ClusterMap::ClusterMap() noexcept
+        : m_legible(gl_legible), m_rev(UINT64_MAX), m_print(0), m_size(0)
+    { }
+
+    void ClusterMap::setLegible(double pixels) noexcept {
+        if (pixels == m_legible)
+            return;
+
+        m_legible = pixels;
+        clear();
+    }
+
+    void ClusterMap::clear() noexcept {
+        m_clusters.clear();
+        m_links.clear();
+        m_owner.clear();
+        m_self.clear();
+        m_levels.clear();
+        m_cache.clear();
+
+        m_rev   = UINT64_MAX;
+        m_print = 0;
+        m_size  = 0;
+        m_last  = sdk::gl_nullelement;
+    }
+
+    double ClusterMap::sync(sdk::ElementStore const &store, double const zoom) noexcept {
+        uint64_t const rev = store.revision();
+        if (rev == m_rev)
+            return 0.0;
+
+        bool known = false;
+        try {
+            m_changes.clear();
+
+            known = m_rev != UINT64_MAX && store.changesSince(m_rev, m_changes) && m_changes.size() <= gl_maxpatch;
+        } catch (...) { }
+
+        /* New elements are created on top, so the same number of elements below the same top-most one
+         * means that none were added or removed; only those could form or dissolve clusters. */
+        uint32_t const           n    = store.size();
+        sdk::ElementHandle const last = n == 0 ? sdk::gl_nullelement : store.handleAt(n - 1);
+        if (known && !(zoom < threshold()) && n == m_size && last == m_last) {
+            bool const clear = std::none_of(m_changes.begin(), m_changes.end(), [&](sdk::ElementRect const &change) {
+                sdk::ElementRect const box = internal::Normalized(change);
+
+                return std::any_of(m_clusters.begin(), m_clusters.end(), [&](Cluster const &cluster) { return internal::Touches(cluster.box, box); });
+            });
+            if (clear)
+                return 0.0;
+        }
+
+        double const   before = threshold();
+        uint64_t const print  = m_print;
+        try {
+            build(store);
+        } catch (...) {
+            /* Without clusters, everything is drawn in full. */
+            clear();
+        }
+
+        m_rev  = rev;
+        m_size = n;
+        m_last = last;
+        if (print != m_print) {
+            m_cache.clear();
+
+            return std::max(before, threshold());
+        }
+
+        /* The same clusters collapse into the same primitives; only the elements around them may have changed. */
+        try {
+            if (!known)
+                m_cache.clear();
+            for (std::unique_ptr<Level> const &level : m_cache)
+                patch(store, *level, m_changes);
+        } catch (...) {
+            m_cache.clear();
+        }
+        return 0.0;
+    }
+
+    void ClusterMap::collect(sdk::ElementStore const &store, DiagramRenderer const &render, double zoom, QRectF const &region, std::vector<RenderItem> &res, std::unordered_set<sdk::ElementHandle> const *skip) {
+        if (!(zoom < threshold())) {
+            render.collect(store, region, res, skip);
+
+            return;
+        }
+
+        Level const           &level = levelOf(store, zoom);
+        sdk::ElementRect const rect  = { static_cast<float>(region.x()), static_cast<float>(region.y()), static_cast<float>(region.width()), static_cast<float>(region.height()) };
+
+        /* Every hit is the dense index of what is drawn, and the primitive drawn in its place, if any. */
+        std::vector<std::pair<uint32_t, uint32_t>> hits;
+        level.spatial.query(rect, [&](sdk::ElementHandle const handle, sdk::ElementRect const &bounds) {
+            uint32_t const prim = static_cast<uint32_t>(handle.index());
+
+            if (bounds.intersects(rect))
+                hits.emplace_back(store.indexOf(level.primitives[prim].element), prim);
+        });
+        level.plain.query(rect, [&](sdk::ElementHandle const handle, sdk::ElementRect const &bounds) {
+            if (bounds.intersects(rect) && (skip == nullptr || skip->find(handle) == skip->end()))
+                hits.emplace_back(store.indexOf(handle), gl_none);
+        });
+
+        /* Dense order is the painting order. */
+        std::sort(hits.begin(), hits.end());
+        res.reserve(res.size() + hits.size());
+        for (auto const &[dense, hit] : hits) {
+            if (hit == gl_none) {
+                res.push_back(render.itemOf(store, dense));
+
+                continue;
+            }
+
+            Primitive const &prim = level.primitives[hit];
+            if (skip != nullptr && prim.count == 0 && prim.label.empty() && skip->find(prim.element) != skip->end())
+                continue;
+
+            RenderItem item = render.itemOf(store, dense);
+
+            item.bounds = prim.bounds;
+            item.count  = prim.count;
+            if (!prim.label.empty())
+                item.name = prim.label;
+            res.push_back(item);
+        }
+    }
+
+    void ClusterMap::build(sdk::ElementStore const &store) {
+        SZSDK_PROFILE_SCOPE("ClusterMap::build");
+
+        m_clusters.clear();
+        m_links.clear();
+        m_levels.clear();
+        m_print = 0;
+
+        uint32_t const                  n       = store.size();
+        sdk::ElementKind const *const   kinds   = store.kinds();
+        sdk::ElementRect const *const   bounds  = store.bounds();
+        sdk::ElementHandle const *const parents = store.parents();
+        uint32_t const *const           flags   = store.flags();
+        if (m_legible <= 0.0 || n == 0) {
+            m_owner.clear();
+            m_self.clear();
+
+            return;
+        }
+
+        /* The nearest package around every element; all elements on a path of non-packages share it. */
+        uint32_t constexpr    gl_unknown = UINT32_MAX - 1;
+        std::vector<uint32_t> outer(n, gl_unknown);
+        std::vector<uint32_t> path;
+        for (uint32_t i = 0; i < n; ++i) {
+            if (outer[i] != gl_unknown)
+                continue;
+
+            uint32_t found = gl_none;
+            path.clear();
+            for (uint32_t j = i; ; ) {
+                path.push_back(j);
+
+                uint32_t const p = parents[j].isNull() || !store.isValid(parents[j]) ? gl_none : store.indexOf(parents[j]);
+                if (p == gl_none)
+                    break;
+                if (kinds[p] == sdk::ElementKind::Package || outer[p] != gl_unknown) {
+                    found = kinds[p] == sdk::ElementKind::Package ? p : outer[p];
+
+                    break;
+                }
+                j = p;
+            }
+            for (uint32_t const j : path)
+                outer[j] = found;
+        }
+
+        /* Packages count all elements inside of them, including those of nested packages. */
+        std::vector<uint32_t> members(n, 0);
+        std::vector<uint32_t> depth(n, 0);
+        std::vector<uint32_t> packages;
+        for (uint32_t i = 0; i < n; ++i) {
+            for (uint32_t q = outer[i]; q != gl_none; q = outer[q])
+                ++members[q];
+
+            if (kinds[i] == sdk::ElementKind::Package) {
+                for (uint32_t q = outer[i]; q != gl_none; q = outer[q])
+                    ++depth[i];
+
+                packages.push_back(i);
+            }
+        }
+
+        /* Clusters are sorted by depth, so enclosing ones come first. */
+        m_self.assign(n, gl_none);
+        packages.erase(std::remove_if(packages.begin(), packages.end(), [&](uint32_t const p) { return members[p] < gl_minmembers; }), packages.end());
+        std::stable_sort(packages.begin(), packages.end(), [&](uint32_t const a, uint32_t const b) { return depth[a] < depth[b]; });
+        for (uint32_t const p : packages) {
+            m_self[p] = static_cast<uint32_t>(m_clusters.size());
+
+            uint32_t parent = gl_none;
+            for (uint32_t q = outer[p]; q != gl_none && parent == gl_none; q = outer[q])
+                parent = m_self[q];
+
+            std::string_view const name  = store.names()[p].view();
+            std::string const      count = "(" + std::to_string(members[p]) + ")";
+            m_clusters.push_back({ p, parent, members[p], 0.0, sdk::StringId(name.empty() ? count : std::string(name) + " " + count), bounds[p] });
+        }
+        if (m_clusters.empty()) {
+            m_owner.clear();
+
+            return;
+        }
+
+        /* An element belongs to the innermost cluster around it. */
+        m_owner.assign(n, gl_none);
+        std::vector<std::vector<float>> sizes(m_clusters.size());
+        for (uint32_t i = 0; i < n; ++i) {
+            for (uint32_t q = outer[i]; q != gl_none && m_owner[i] == gl_none; q = outer[q])
+                m_owner[i] = m_self[q];
+
+            if (m_owner[i] != gl_none && kinds[i] != sdk::ElementKind::Association && (flags[i] & sdk::ElementHidden) == 0)
+                sizes[m_owner[i]].push_back(std::min(bounds[i].w, bounds[i].h));
+        }
+
+        /* A cluster expands once its median element is legible, and never before its parent. */
+        for (size_t c = 0; c < m_clusters.size(); ++c) {
+            Cluster &cluster = m_clusters[c];
+            if (!sizes[c].empty()) {
+                auto const mid = sizes[c].begin() + sizes[c].size() / 2;
+                std::nth_element(sizes[c].begin(), mid, sizes[c].end());
+
+                cluster.expand = m_legible / std::max(1.0, static_cast<double>(*mid));
+            }
+            if (cluster.parent != gl_none)
+                cluster.expand = std::max(cluster.expand, m_clusters[cluster.parent].expand);
+            if (cluster.expand > 0.0)
+                m_levels.push_back(cluster.expand);
+
+            sdk::ElementRect const &box = bounds[cluster.element];
+            m_print = internal::Mix(m_print, store.handleAt(cluster.element).value());
+            m_print = internal::Mix(m_print, cluster.members);
+            m_print = internal::Mix(m_print, cluster.expand);
+            m_print = internal::Mix(m_print, box);
+            m_print = internal::Mix(m_print, cluster.label.value());
+        }
+        std::sort(m_levels.begin(), m_levels.end());
+        m_levels.erase(std::unique(m_levels.begin(), m_levels.end()), m_levels.end());
+
+        /* The ends of associations are looked up among the clusters only; the deepest one containing an end wins. */
+        sdk::SpatialIndex<sdk::ElementHandle> spatial;
+        for (uint32_t c = 0; c < m_clusters.size(); ++c)
+            spatial.insert(sdk::ElementHandle(c, 0), bounds[m_clusters[c].element]);
+
+        auto const clusterAt = [&](float const x, float const y) {
+            uint32_t res = gl_none;
+            spatial.query({ x, y, 0.0f, 0.0f }, [&](sdk::ElementHandle const handle, sdk::ElementRect const &box) {
+                uint32_t const c = static_cast<uint32_t>(handle.index());
+
+                if (box.contains(x, y) && (res == gl_none || c > res))
+                    res = c;
+            });
+
+            return res;
+        };
+        for (uint32_t i = 0; i < n; ++i) {
+            if (kinds[i] != sdk::ElementKind::Association || (flags[i] & sdk::ElementHidden) != 0)
+                continue;
+
+            sdk::ElementRect const &line = bounds[i];
+            uint32_t const          from = clusterAt(line.x, line.y);
+            uint32_t const          to   = clusterAt(line.x + line.w, line.y + line.h);
+            if (from == gl_none && to == gl_none)
+                continue;
+
+            m_links.push_back({ i, from, to });
+            m_print = internal::Mix(m_print, store.handleAt(i).value());
+            m_print = internal::Mix(m_print, from);
+            m_print = internal::Mix(m_print, to);
+            m_print = internal::Mix(m_print, line);
+        }
+    }
+
+
+    ClusterMap::Level const &ClusterMap::levelOf(sdk::ElementStore const &store, double zoom) {
+        size_t const index = static_cast<size_t>(std::upper_bound(m_levels.begin(), m_levels.end(), zoom) - m_levels.begin());
+
+        auto const it = std::find_if(m_cache.begin(), m_cache.end(), [&](std::unique_ptr<Level> const &level) { return level->index == index; });
+        if (it != m_cache.end()) {
+            std::rotate(m_cache.begin(), it, it + 1);
+
+            return *m_cache.front();
+        }
+
+        auto level   = std::make_unique<Level>();
+        level->index = index;
+        fill(store, *level);
+
+        if (m_cache.size() == gl_maxlevels)
+            m_cache.pop_back();
+        m_cache.insert(m_cache.begin(), std::move(level));
+        return *m_cache.front();
+    }
+
+    bool ClusterMap::isPlain(sdk::ElementStore const &store, Level const &level, uint32_t const dense) const noexcept {
+        if ((store.flags()[dense] & sdk::ElementHidden) != 0)
+            return false;
+
+        /* Associations are drawn as they are only if neither end is inside of a collapsed cluster. */
+        auto const link = std::lower_bound(m_links.begin(), m_links.end(), dense, [](Link const &entry, uint32_t const element) { return entry.element < element; });
+        if (link != m_links.end() && link->element == dense)
+            return (link->from == gl_none || level.top[link->from] == gl_none) && (link->to == gl_none || level.top[link->to] == gl_none);
+
+        uint32_t const self = m_self.empty() ? gl_none : m_self[dense];
+        if (self != gl_none && level.top[self] == self)
+            return false;
+
+        uint32_t const owner = m_owner.empty() ? gl_none : m_owner[dense];
+        return owner == gl_none || level.top[owner] == gl_none;
+    }
+
+    void ClusterMap::patch(sdk::ElementStore const &store, Level &level, std::vector<sdk::ElementRect> const &changes) const {
+        SZSDK_PROFILE_SCOPE("ClusterMap::patch");
+
+        /* Everything in a changed region is taken out and put back as it is now; removed elements
+         * are found at their old bounds, moved and new ones at their new bounds. */
+        std::vector<sdk::ElementHandle> found;
+        for (sdk::ElementRect const &change : changes) {
+            sdk::ElementRect const box = internal::Normalized(change);
+
+            level.plain.query(box, [&](sdk::ElementHandle const handle, sdk::ElementRect const &bounds) {
+                if (internal::Touches(bounds, box))
+                    found.push_back(handle);
+            });
+            store.query(box, found);
+        }
+
+        std::sort(found.begin(), found.end(), [](sdk::ElementHandle const a, sdk::ElementHandle const b) { return a.value() < b.value(); });
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+        for (sdk::ElementHandle const handle : found)
+            level.plain.remove(handle);
+
+        for (sdk::ElementHandle const handle : found) {
+            if (!store.isValid(handle))
+                continue;
+
+            uint32_t const dense = store.indexOf(handle);
+            if (isPlain(store, level, dense))
+                level.plain.insert(handle, internal::Normalized(store.bounds()[dense]));
+        }
+    }
+
+    void ClusterMap::fill(sdk::ElementStore const &store, Level &level) const {
+        SZSDK_PROFILE_SCOPE("ClusterMap::fill");
+
+        /* At level *l*, the clusters expanding from *m_levels[l]* on are collapsed. Since clusters never
+         * expand before their parents, the outermost collapsed cluster around an element stands for it. */
+        double const          bound = m_levels[level.index];
+        std::vector<uint32_t> &top  = level.top;
+        top.assign(m_clusters.size(), gl_none);
+        for (uint32_t c = 0; c < m_clusters.size(); ++c) {
+            Cluster const &cluster = m_clusters[c];
+            if (cluster.expand < bound)
+                continue;
+
+            top[c] = cluster.parent != gl_none && top[cluster.parent] != gl_none ? top[cluster.parent] : c;
+        }
+
+        uint32_t const                n      = store.size();
+        sdk::ElementRect const *const bounds = store.bounds();
+        uint32_t const *const         flags  = store.flags();
+        std::vector<Primitive>       &prims  = level.primitives;
+
+        std::vector<sdk::ElementHandle> plain;
+        std::vector<sdk::ElementRect>   boxes;
+
+        std::unordered_map<uint64_t, uint32_t> edges;
+        size_t                                 link = 0;
+        for (uint32_t i = 0; i < n; ++i) {
+            if ((flags[i] & sdk::ElementHidden) != 0)
+                continue;
+
+            while (link < m_links.size() && m_links[link].element < i)
+                ++link;
+            if (link < m_links.size() && m_links[link].element == i) {
+                uint32_t const from = m_links[link].from == gl_none ? gl_none : top[m_links[link].from];
+                uint32_t const to   = m_links[link].to == gl_none ? gl_none : top[m_links[link].to];
+                if (from == to) {
+                    if (from == gl_none) {
+                        plain.push_back(store.handleAt(i));
+                        boxes.push_back(internal::Normalized(bounds[i]));
+                    }
+
+                    continue;
+                }
+
+                sdk::ElementRect const &line = bounds[i];
+                float                   x0   = line.x, y0 = line.y;
+                float                   x1   = line.x + line.w, y1 = line.y + line.h;
+                if (from != gl_none)
+                    internal::CenterOf(bounds[m_clusters[from].element], x0, y0);
+                if (to != gl_none)
+                    internal::CenterOf(bounds[m_clusters[to].element], x1, y1);
+                if (from == gl_none || to == gl_none) {
+                    prims.push_back({ store.handleAt(i), 0, internal::LineOf(x0, y0, x1, y1), {} });
+
+                    continue;
+                }
+
+                /* All associations between the same two collapsed clusters share one edge, whichever way they point. */
+                uint64_t const key = static_cast<uint64_t>(std::min(from, to)) << 32 | std::max(from, to);
+                auto const     it  = edges.find(key);
+                if (it != edges.end()) {
+                    ++prims[it->second].count;
+
+                    continue;
+                }
+
+                edges.emplace(key, static_cast<uint32_t>(prims.size()));
+                prims.push_back({ store.handleAt(i), 1, internal::LineOf(x0, y0, x1, y1), {} });
+                continue;
+            }
+
+            uint32_t const self = m_self.empty() ? gl_none : m_self[i];
+            if (self != gl_none && top[self] == self) {
+                prims.push_back({ store.handleAt(i), 0, bounds[i], m_clusters[self].label });
+
+                continue;
+            }
+
+            uint32_t const owner = m_owner.empty() ? gl_none : m_owner[i];
+            if (owner == gl_none || top[owner] == gl_none) {
+                plain.push_back(store.handleAt(i));
+                boxes.push_back(internal::Normalized(bounds[i]));
+            }
+        }
+        level.plain.insert(plain.data(), boxes.data(), plain.size());
+
+        std::vector<sdk::ElementHandle> handles(prims.size());
+        boxes.resize(prims.size());
+        for (uint32_t p = 0; p < prims.size(); ++p) {
+            handles[p] = sdk::ElementHandle(p, 0);
+            boxes[p]   = internal::Normalized(prims[p].bounds);
+        }
+        level.spatial.insert(handles.data(), boxes.data(), prims.size());
+    }
+}
+
+
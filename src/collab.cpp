@@ -0,0 +1,590 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  collab.cpp
+ * \brief implementation of real-time collaborative editing of a diagram
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <utility>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+
+/* app includes */
+#include <collab.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \brief  compares two bounding boxes bit by bit
+         *
+         * \param  [in] a first bounding box
+         * \param  [in] b second bounding box
+         *
+         * \return *true* if both are the same
+         */
+        static bool IsSameRect(sdk::ElementRect const &a, sdk::ElementRect const &b) noexcept {
+            return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+        }
+
+        /**
+         * \brief  strips the flags that are local to every editor
+         *
+         * \param  [in] flags *suzu::sdk::ElementFlags*
+         *
+         * \return flags without the selection
+         */
+        static constexpr uint32_t SharedFlags(uint32_t const flags) noexcept {
+            return flags & ~static_cast<uint32_t>(sdk::ElementSelected);
+        }
+    }
+
+
+    CollabSession::CollabSession(sdk::ElementStore &store, ChangeDispatcher &changes, QObject *parent) noexcept
+        : QObject(parent), m_store(store), m_changes(changes), m_listener(0), m_all(false), m_joined(false), m_nextsite(0)
+    {
+        try {
+            m_frame = std::make_unique<QTimer>();
+
+            m_frame->setSingleShot(true);
+            QObject::connect(m_frame.get(), &QTimer::timeout, this, [this]() { flush(); });
+        } catch (...) { }
+
+        m_listener = m_changes.subscribe([this](ChangeSet const &changes) { changed(changes); });
+    }
+
+    CollabSession::~CollabSession() {
+        stop();
+
+        m_changes.unsubscribe(m_listener);
+    }
+
+
+    sdk::ErrorCode CollabSession::host(uint16_t port) noexcept {
+        if (isActive())
+            return sdk::ErrorCode::InvalidState;
+        else if (m_frame == nullptr || m_listener == 0)
+            return sdk::ErrorCode::CriticalResource;
+
+        try {
+            m_server = std::make_unique<QTcpServer>();
+            if (!m_server->listen(QHostAddress::Any, port)) {
+                SZSDK_APP_ERROR("Could not listen for collaborators on port {}.", port);
+
+                m_server.reset();
+                return sdk::ErrorCode::CriticalResource;
+            }
+            QObject::connect(m_server.get(), &QTcpServer::newConnection, this, [this]() { accept(); });
+
+            /* The host is site 1 and replicates the diagram as it is; joining editors are sites 2 and up. */
+            m_replica.reset(1);
+            m_nextsite = 2;
+            m_all      = true;
+            reconcile();
+        } catch (...) {
+            close();
+
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        notify();
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode CollabSession::join(QString const &address, uint16_t port) noexcept {
+        if (isActive())
+            return sdk::ErrorCode::InvalidState;
+        else if (m_frame == nullptr || m_listener == 0)
+            return sdk::ErrorCode::CriticalResource;
+
+        try {
+            /* Until the host has assigned a site, local edits are not replicated; the diagram is replaced anyway. */
+            m_replica.reset(0);
+            m_joined = true;
+
+            attach(new QTcpSocket(this)).sock->connectToHost(address, port);
+        } catch (...) {
+            close();
+
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        notify();
+        return sdk::ErrorCode::Ok;
+    }
+
+    void CollabSession::stop() noexcept {
+        if (!isActive())
+            return;
+
+        flush();
+        close();
+    }
+
+
+    void CollabSession::changed(ChangeSet const &changes) noexcept {
+        if (!isActive() || m_replica.site() == 0)
+            return;
+
+        try {
+            if (changes.everything())
+                m_all = true;
+
+            /* Remote edits are reported here as well; compared against the replica, they yield no operations. */
+            for (sdk::ChangeRecord const &change : changes.records())
+                m_dirty.insert(sdk::ElementHandle::FromValue(change.element));
+        } catch (...) {
+            m_all = true;
+        }
+
+        schedule();
+    }
+
+    void CollabSession::flush() noexcept {
+        if (!isActive() || m_replica.site() == 0)
+            return;
+
+        try {
+            reconcile();
+
+            std::vector<uint8_t> frame;
+            for (std::unique_ptr<Link> const &link : m_links) {
+                if (link->out.empty())
+                    continue;
+
+                link->out.take(frame);
+                Send(*link, MessageOperations, frame);
+            }
+        } catch (...) {
+            /* Operations may have been lost, so the replicas can no longer be trusted to converge. */
+            SZSDK_APP_ERROR("Ran out of memory while sending edits; the collaboration session is left.");
+
+            close();
+        }
+    }
+
+    void CollabSession::reconcile() {
+        if (m_all) {
+            std::vector<sdk::ElementHandle> gone;
+            for (auto const &[handle, id] : m_ids)
+                if (!m_store.isValid(handle))
+                    gone.push_back(handle);
+
+            for (sdk::ElementHandle const handle : gone)
+                sync(handle);
+            for (uint32_t i = 0; i < m_store.size(); ++i)
+                sync(m_store.handleAt(i));
+        } else
+            for (sdk::ElementHandle const handle : m_dirty)
+                sync(handle);
+
+        m_dirty.clear();
+        m_all = false;
+    }
+
+    void CollabSession::sync(sdk::ElementHandle handle) {
+        auto const it = m_ids.find(handle);
+
+        if (!m_store.isValid(handle)) {
+            if (it == m_ids.end())
+                return;
+
+            sdk::crdt::ElementId const id = it->second;
+            m_handles.erase(id.key());
+            m_ids.erase(it);
+
+            issue({ sdk::crdt::OpRemove, sdk::crdt::FieldBounds, id, m_replica.tick() });
+            return;
+        } else if (it == m_ids.end()) {
+            idOf(handle);
+
+            return;
+        }
+
+        sdk::crdt::Replica::Element const *const elem = m_replica.find(it->second);
+        if (elem == nullptr || elem->removed)
+            return;
+
+        /* Only properties that differ from the replicated state become operations. */
+        uint32_t const                   index = m_store.indexOf(handle);
+        sdk::crdt::Replica::Element const cur  = *elem;
+        sdk::crdt::Operation              op   = {
+            sdk::crdt::OpSet, sdk::crdt::FieldBounds, it->second, {},
+            m_store.kinds()[index], m_store.bounds()[index], m_store.styles()[index], internal::SharedFlags(m_store.flags()[index]),
+            m_store.names()[index], idOf(m_store.parents()[index])
+        };
+
+        bool const differs[sdk::crdt::__NumFields__] = {
+            !internal::IsSameRect(op.bounds, cur.bounds), op.style != cur.style, op.flags != cur.flags, op.name != cur.name, op.parent != cur.parent
+        };
+        for (uint8_t f = 0; f < sdk::crdt::__NumFields__; ++f)
+            if (differs[f]) {
+                op.field = static_cast<sdk::crdt::Field>(f);
+                op.stamp = m_replica.tick();
+                issue(op);
+            }
+    }
+
+    sdk::crdt::ElementId CollabSession::idOf(sdk::ElementHandle handle) {
+        if (!m_store.isValid(handle))
+            return sdk::crdt::gl_noelement;
+
+        auto const it = m_ids.find(handle);
+        if (it != m_ids.end())
+            return it->second;
+
+        /* The element is mapped before its owner is resolved, so cyclic ownership ends here. */
+        sdk::crdt::ElementId const id = m_replica.next();
+        m_ids.emplace(handle, id);
+        m_handles.emplace(id.key(), handle);
+
+        uint32_t const             index  = m_store.indexOf(handle);
+        sdk::crdt::ElementId const parent = idOf(m_store.parents()[index]);
+        issue({
+            sdk::crdt::OpCreate, sdk::crdt::FieldBounds, id, m_replica.tick(),
+            m_store.kinds()[index], m_store.bounds()[index], m_store.styles()[index], internal::SharedFlags(m_store.flags()[index]),
+            m_store.names()[index], parent
+        });
+
+        return id;
+    }
+
+    sdk::ElementHandle CollabSession::handleOf(sdk::crdt::ElementId const id) const noexcept {
+        auto const it = m_handles.find(id.key());
+
+        return it != m_handles.end() ? it->second : sdk::gl_nullelement;
+    }
+
+    void CollabSession::issue(sdk::crdt::Operation const &op) {
+        m_replica.apply(op);
+
+        for (std::unique_ptr<Link> const &link : m_links)
+            link->out.put(op);
+    }
+
+    void CollabSession::apply(sdk::crdt::Operation const &op, Link const *from) {
+        if (!m_replica.apply(op))
+            return;
+
+        /* The host passes on every operation that changed its replica; stale ones are superseded by what it sent already. */
+        if (m_server != nullptr) {
+            for (std::unique_ptr<Link> const &link : m_links)
+                if (link.get() != from)
+                    link->out.put(op);
+
+            schedule();
+        }
+
+        sdk::ElementHandle const handle = handleOf(op.id);
+        if (op.type == sdk::crdt::OpCreate) {
+            sdk::ElementHandle const parent  = handleOf(op.parent);
+            sdk::ElementHandle const created = m_store.create(op.kind, op.bounds, op.style, parent, op.name);
+
+            m_store.flags()[m_store.indexOf(created)] = internal::SharedFlags(op.flags);
+            m_store.touch(created);
+            try {
+                m_ids.emplace(created, op.id);
+                m_handles.emplace(op.id.key(), created);
+            } catch (...) {
+                m_store.destroy(created);
+                m_ids.erase(created);
+
+                throw;
+            }
+
+            m_changes.record(sdk::ElementAdded, created, parent);
+            return;
+        } else if (!m_store.isValid(handle))
+            return;
+
+        uint32_t const           index  = m_store.indexOf(handle);
+        sdk::ElementHandle const parent = m_store.parents()[index];
+        if (op.type == sdk::crdt::OpRemove) {
+            m_ids.erase(handle);
+            m_handles.erase(op.id.key());
+            m_store.destroy(handle);
+
+            m_changes.record(sdk::ElementRemoved, handle, parent);
+            return;
+        }
+
+        switch (op.field) {
+            case sdk::crdt::FieldBounds:
+                m_store.setBounds(handle, op.bounds);
+
+                m_changes.record(sdk::ElementModified, handle, parent, sdk::PropertyBounds);
+                break;
+            case sdk::crdt::FieldStyle:
+                m_store.styles()[index] = op.style;
+                m_store.touch(handle);
+
+                m_changes.record(sdk::ElementModified, handle, parent, sdk::PropertyStyle);
+                break;
+            case sdk::crdt::FieldFlags:
+                m_store.flags()[index] = internal::SharedFlags(op.flags) | (m_store.flags()[index] & sdk::ElementSelected);
+                m_store.touch(handle);
+
+                m_changes.record(sdk::ElementModified, handle, parent, sdk::PropertyFlags);
+                break;
+            case sdk::crdt::FieldName:
+                m_store.names()[index] = op.name;
+                m_store.touch(handle);
+
+                m_changes.record(sdk::ElementModified, handle, parent, sdk::PropertyName);
+                break;
+            case sdk::crdt::FieldParent: {
+                sdk::ElementHandle const owner = handleOf(op.parent);
+
+                m_store.parents()[index] = owner;
+                m_store.touch(handle);
+
+                m_changes.record(sdk::ElementMoved, handle, owner);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+
+    void CollabSession::accept() noexcept {
+        if (m_server == nullptr)
+            return;
+
+        try {
+            /* Joining editors start from the replicated state, so it must include all local edits. */
+            reconcile();
+        } catch (...) {
+            m_all = true;
+        }
+
+        while (QTcpSocket *sock = m_server->nextPendingConnection()) {
+            Link *link = nullptr;
+
+            try {
+                link = &attach(sock);
+
+                std::vector<uint8_t> msg;
+                sdk::crdt::internal::PutVarint(msg, m_nextsite++);
+                Send(*link, MessageWelcome, msg);
+
+                m_replica.replay([link](sdk::crdt::Operation const &op) { link->out.put(op); });
+                link->out.take(msg);
+                Send(*link, MessageOperations, msg);
+
+                SZSDK_APP_INFO("An editor joined the collaboration session from {}.", sock->peerAddress().toString().toStdString());
+            } catch (...) {
+                SZSDK_APP_WARNING("Ran out of memory while welcoming an editor to the collaboration session.");
+
+                if (link != nullptr)
+                    drop(*link);
+                else
+                    sock->deleteLater();
+            }
+        }
+
+        notify();
+    }
+
+    CollabSession::Link &CollabSession::attach(QTcpSocket *sock) {
+        sock->setParent(this);
+
+        std::unique_ptr<Link> link;
+        try {
+            link = std::make_unique<Link>();
+            m_links.push_back(nullptr);
+        } catch (...) {
+            sock->deleteLater();
+
+            throw;
+        }
+        link->sock = sock;
+        m_links.back() = std::move(link);
+
+        /* Frames are small and latency-sensitive; they are sent as soon as they are written. */
+        Link *const raw = m_links.back().get();
+        sock->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        QObject::connect(sock, &QTcpSocket::readyRead, this, [this, raw]() { receive(*raw); });
+        QObject::connect(sock, &QTcpSocket::disconnected, this, [this, raw]() { drop(*raw); });
+        QObject::connect(sock, &QTcpSocket::errorOccurred, this, [this, raw](QAbstractSocket::SocketError) { drop(*raw); });
+
+        return *raw;
+    }
+
+    void CollabSession::receive(Link &link) noexcept {
+        bool valid = true;
+
+        try {
+            /* Pending local edits are stamped first, so that they compete with the remote ones. */
+            if (m_replica.site() != 0) {
+                m_changes.flush();
+                reconcile();
+            }
+
+            link.received.append(link.sock->readAll());
+
+            /* Every message is preceded by its length as a varint. */
+            uint8_t const *const data = reinterpret_cast<uint8_t const *>(link.received.constData());
+            uint8_t const *const end  = data + link.received.size();
+            uint8_t const       *done = data;
+            while (done != end) {
+                uint8_t const *pos = done;
+                uint64_t       len = 0;
+
+                if (!sdk::crdt::internal::GetVarint(pos, end, len)) {
+                    valid = end - done < 10;
+
+                    break;
+                } else if (len == 0 || len > gl_maxmessage) {
+                    valid = false;
+
+                    break;
+                } else if (len > static_cast<uint64_t>(end - pos))
+                    break;
+
+                if (!handle(link, pos, static_cast<size_t>(len))) {
+                    valid = false;
+
+                    break;
+                }
+                done = pos + len;
+            }
+
+            link.received.remove(0, static_cast<qsizetype>(done - data));
+        } catch (...) {
+            SZSDK_APP_ERROR("Ran out of memory while receiving edits; the connection is closed.");
+
+            valid = false;
+        }
+
+        if (!valid) {
+            SZSDK_APP_WARNING("Received a malformed message from a collaborator; the connection is closed.");
+
+            drop(link);
+        }
+    }
+
+    bool CollabSession::handle(Link &link, uint8_t const *data, size_t size) {
+        MessageType const type = static_cast<MessageType>(data[0]);
+
+        if (type == MessageWelcome) {
+            uint8_t const *pos  = data + 1;
+            uint64_t       site = 0;
+            if (!m_joined || m_replica.site() != 0 || !sdk::crdt::internal::GetVarint(pos, data + size, site) || site < 2 || site > UINT32_MAX || pos != data + size)
+                return false;
+
+            /* The diagram is replaced by that of the session, which follows right away. */
+            m_changes.begin();
+            for (uint32_t i = 0; i < m_store.size(); ++i)
+                m_changes.record(sdk::ElementRemoved, m_store.handleAt(i), m_store.parents()[i]);
+            m_store.clear();
+            m_changes.end();
+
+            m_replica.reset(static_cast<uint32_t>(site));
+            m_handles.clear();
+            m_ids.clear();
+            m_dirty.clear();
+            m_all = false;
+
+            SZSDK_APP_INFO("Joined the collaboration session as site {}.", site);
+            notify();
+            return true;
+        } else if (type != MessageOperations || m_replica.site() == 0)
+            return false;
+
+        /* Views observe every frame as a whole. */
+        m_changes.begin();
+        try {
+            bool const ok = link.in.decode(data + 1, size - 1, [&](sdk::crdt::Operation const &op) { apply(op, &link); });
+
+            m_changes.end();
+            return ok;
+        } catch (...) {
+            m_changes.end();
+
+            throw;
+        }
+    }
+
+    void CollabSession::Send(Link const &link, MessageType type, std::vector<uint8_t> const &payload) {
+        std::vector<uint8_t> msg;
+        msg.reserve(payload.size() + 11);
+
+        sdk::crdt::internal::PutVarint(msg, payload.size() + 1);
+        msg.push_back(type);
+        msg.insert(msg.end(), payload.begin(), payload.end());
+
+        link.sock->write(reinterpret_cast<char const *>(msg.data()), static_cast<qint64>(msg.size()));
+    }
+
+    void CollabSession::drop(Link const &link) noexcept {
+        auto const it = std::find_if(m_links.begin(), m_links.end(), [&link](std::unique_ptr<Link> const &other) { return other.get() == &link; });
+        if (it == m_links.end())
+            return;
+
+        /* The link may be dropped from within one of the socket's signals. */
+        QTcpSocket *const sock = link.sock;
+        sock->disconnect(this);
+        sock->disconnectFromHost();
+        sock->deleteLater();
+        m_links.erase(it);
+
+        if (m_joined) {
+            SZSDK_APP_WARNING("Lost the connection to the host of the collaboration session.");
+
+            close();
+            return;
+        }
+
+        SZSDK_APP_INFO("An editor left the collaboration session.");
+        notify();
+    }
+
+    void CollabSession::close() noexcept {
+        bool const active = isActive();
+
+        for (std::unique_ptr<Link> const &link : m_links) {
+            link->sock->disconnect(this);
+            link->sock->disconnectFromHost();
+            link->sock->deleteLater();
+        }
+        m_links.clear();
+        m_server.reset();
+
+        m_replica.reset(0);
+        m_handles.clear();
+        m_ids.clear();
+        m_dirty.clear();
+        m_all      = false;
+        m_joined   = false;
+        m_nextsite = 0;
+        if (m_frame != nullptr)
+            m_frame->stop();
+
+        if (active)
+            notify();
+    }
+
+    void CollabSession::schedule() noexcept {
+        if (m_frame != nullptr && !m_frame->isActive())
+            m_frame->start(gl_frameinterval);
+    }
+
+    void CollabSession::notify() noexcept {
+        if (m_state)
+            m_state();
+    }
+}
+
+
@@ -0,0 +1,125 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  deferredui.cpp
+ * \brief implementation of building user interface parts only once they are needed
+ */
+
+
+/* stdlib includes */
+#include <utility>
+
+/* external includes */
+#include <QCoreApplication>
+#include <QEvent>
+#include <QMetaObject>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/profile.hpp>
+#include <sdk/timeline.hpp>
+
+/* app includes */
+#include <deferredui.hpp>
+
+
+namespace suzu {
+    DeferredDock::DeferredDock(QString const &title, Factory factory, QWidget *parent)
+        : QDockWidget(title, parent), m_factory(std::move(factory))
+    { }
+
+    QWidget *DeferredDock::build() noexcept {
+        if (!m_factory)
+            return widget();
+
+        /* The factory runs once, even if it fails; a broken panel stays empty instead of retrying on every show. */
+        Factory const factory = std::move(m_factory);
+        m_factory = nullptr;
+
+        try {
+            SZSDK_PROFILE_SCOPE("DeferredDock::build");
+
+            QWidget *const contents = factory(this);
+            if (contents != nullptr)
+                setWidget(contents);
+            else
+                SZSDK_APP_WARNING("Could not build the contents of panel \"{}\".", windowTitle().toStdString());
+
+            return contents;
+        } catch (...) { }
+
+        SZSDK_APP_WARNING("Could not build the contents of panel \"{}\".", windowTitle().toStdString());
+        return nullptr;
+    }
+
+    void DeferredDock::showEvent(QShowEvent *const event) {
+        build();
+
+        QDockWidget::showEvent(event);
+    }
+
+
+    FirstFrameGate::FirstFrameGate()
+        : m_open(false)
+    {
+        QCoreApplication::instance()->installEventFilter(this);
+
+        m_timer.setSingleShot(true);
+        QObject::connect(&m_timer, &QTimer::timeout, this, [this]() {
+            SZSDK_APP_DEBUG("Nothing was painted within {} ms; running deferred startup work.", gl_fallback);
+
+            open();
+        });
+        /* Startup may take longer than the fallback, so it only counts once the event loop runs. */
+        QMetaObject::invokeMethod(this, [this]() {
+            if (!m_open)
+                m_timer.start(gl_fallback);
+        }, Qt::QueuedConnection);
+    }
+
+    FirstFrameGate::~FirstFrameGate() {
+        if (!m_open)
+            QCoreApplication::instance()->removeEventFilter(this);
+    }
+
+    void FirstFrameGate::defer(std::function<void()> fn) {
+        if (m_open)
+            QMetaObject::invokeMethod(this, std::move(fn), Qt::QueuedConnection);
+        else
+            m_pending.push_back(std::move(fn));
+    }
+
+    bool FirstFrameGate::eventFilter(QObject *const watched, QEvent *const event) {
+        if (event->type() == QEvent::Paint && watched->isWidgetType()) {
+            sdk::Timeline::Startup().record("firstframe", sdk::Timeline::Startup().now(), sdk::Timeline::Startup().now());
+
+            open();
+        }
+
+        return QObject::eventFilter(watched, event);
+    }
+
+    void FirstFrameGate::open() noexcept {
+        if (m_open)
+            return;
+
+        /* Filtering every event of the application is only worth it until the first paint. */
+        m_open = true;
+        m_timer.stop();
+        QCoreApplication::instance()->removeEventFilter(this);
+
+        /* Posting runs them after the paint being delivered, and lets input in between them. */
+        for (std::function<void()> &fn : m_pending)
+            QMetaObject::invokeMethod(this, std::move(fn), Qt::QueuedConnection);
+        m_pending.clear();
+    }
+}
+
+
@@ -0,0 +1,71 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  diagramview.cpp
+ * \brief implementation of the canvas backend selection
+ */
+
+
+/* stdlib includes */
+#include <cstdlib>
+
+#if defined _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <Windows.h>
+#endif
+
+/* sdk includes */
+#include <sdk/log.hpp>
+
+/* app includes */
+#include <canvas.hpp>
+#include <diagramview.hpp>
+#include <gpucanvas.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \brief  checks whether the application is displayed through a remote desktop session
+         *
+         * Remote sessions usually lack hardware acceleration and transfer rendered frames
+         * anyway, so the raster backend's cached tiles are cheaper there.
+         *
+         * \return *true* if the session is remote
+         */
+        static bool IsRemoteSession() noexcept {
+#if defined _WIN32
+            return GetSystemMetrics(SM_REMOTESESSION) != 0;
+#else
+            return std::getenv("SSH_CONNECTION") != nullptr;
+#endif
+        }
+    }
+
+
+    DiagramView *CreateDiagramView(std::string_view backend, LodThresholds const &lod, size_t tilebudget, QWidget *parent) noexcept {
+        try {
+            if (backend == "gpu") {
+                if (!internal::IsRemoteSession() && GpuCanvas::IsSupported())
+                    return new GpuCanvas(lod, parent);
+
+                SZSDK_APP_WARNING("GPU canvas is not available; falling back to raster canvas.");
+            } else if (backend != "raster")
+                SZSDK_APP_WARNING("Unknown canvas backend \"{}\"; using raster canvas.", backend);
+
+            return new DiagramCanvas(lod, tilebudget, parent);
+        } catch (...) { }
+
+        return nullptr;
+    }
+}
+
+
@@ -0,0 +1,273 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  explorer.cpp
+ * \brief implementation of the item model of the project explorer
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <iterator>
+
+/* external includes */
+#include <QColor>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+
+/* app includes */
+#include <explorer.hpp>
+
+
+namespace suzu {
+    ProjectExplorerModel::ProjectExplorerModel(QObject *parent) noexcept
+        : QAbstractItemModel(parent), m_store(nullptr), m_built(false), m_checks(nullptr)
+    { }
+
+
+    void ProjectExplorerModel::Attach(QTreeView &view, ProjectExplorerModel &model) {
+        view.setUniformRowHeights(true);
+        view.setHeaderHidden(true);
+        view.setModel(&model);
+    }
+
+    void ProjectExplorerModel::setStore(sdk::ElementStore const *store) {
+        beginResetModel();
+
+        m_store = store;
+        m_built = false;
+        m_fetched.clear();
+
+        endResetModel();
+    }
+
+    void ProjectExplorerModel::setValidator(ModelValidator const *checks) {
+        /* Items keep their rows; the views only have to repaint all of them. */
+        emit layoutAboutToBeChanged();
+        m_checks = checks;
+        emit layoutChanged();
+    }
+
+    void ProjectExplorerModel::refresh() {
+        setStore(m_store);
+    }
+
+    void ProjectExplorerModel::elementChanged(sdk::ElementHandle handle) {
+        if (m_store == nullptr || !m_built)
+            return;
+
+        /* Items that have not been revealed yet pick up the change when they are. */
+        uint32_t const dense = m_store->indexOf(handle);
+        if (dense >= m_row.size() || m_row[dense] >= fetchedCount(parentKey(dense)))
+            return;
+
+        QModelIndex const item = createIndex(static_cast<int>(m_row[dense]), 0, static_cast<quintptr>(dense) + 1);
+        emit dataChanged(item, item);
+    }
+
+    sdk::ElementHandle ProjectExplorerModel::handleOf(QModelIndex const &index) const noexcept {
+        uint32_t const key = KeyOf(index);
+        if (m_store == nullptr || key == 0 || key > m_store->size())
+            return sdk::gl_nullelement;
+
+        return m_store->handleAt(key - 1);
+    }
+
+
+    QModelIndex ProjectExplorerModel::index(int row, int column, QModelIndex const &parent) const {
+        build();
+
+        uint32_t const key = KeyOf(parent);
+        if (row < 0 || column != 0 || static_cast<uint32_t>(row) >= fetchedCount(key))
+            return QModelIndex();
+
+        return createIndex(row, 0, static_cast<quintptr>(m_children[m_first[key] + static_cast<uint32_t>(row)]) + 1);
+    }
+
+    QModelIndex ProjectExplorerModel::parent(QModelIndex const &child) const {
+        build();
+
+        uint32_t const key = KeyOf(child);
+        if (key == 0 || key > m_row.size())
+            return QModelIndex();
+
+        /* Parents are shown before their children, so their row is always revealed. */
+        uint32_t const parent = parentKey(key - 1);
+        if (parent == 0)
+            return QModelIndex();
+
+        return createIndex(static_cast<int>(m_row[parent - 1]), 0, static_cast<quintptr>(parent));
+    }
+
+    int ProjectExplorerModel::rowCount(QModelIndex const &parent) const {
+        if (parent.column() > 0)
+            return 0;
+
+        build();
+        return static_cast<int>(fetchedCount(KeyOf(parent)));
+    }
+
+    int ProjectExplorerModel::columnCount(QModelIndex const &) const {
+        return 1;
+    }
+
+    bool ProjectExplorerModel::hasChildren(QModelIndex const &parent) const {
+        if (parent.column() > 0)
+            return false;
+
+        build();
+        return childCount(KeyOf(parent)) != 0;
+    }
+
+    bool ProjectExplorerModel::canFetchMore(QModelIndex const &parent) const {
+        if (parent.column() > 0)
+            return false;
+
+        build();
+
+        uint32_t const key = KeyOf(parent);
+        return fetchedCount(key) < childCount(key);
+    }
+
+    void ProjectExplorerModel::fetchMore(QModelIndex const &parent) {
+        if (parent.column() > 0)
+            return;
+
+        build();
+
+        uint32_t const key     = KeyOf(parent);
+        uint32_t const fetched = fetchedCount(key);
+        uint32_t const count   = std::min(childCount(key) - fetched, gl_fetchbatch);
+        if (count == 0)
+            return;
+
+        beginInsertRows(parent, static_cast<int>(fetched), static_cast<int>(fetched + count - 1));
+        m_fetched[key] = fetched + count;
+        endInsertRows();
+    }
+
+    QVariant ProjectExplorerModel::data(QModelIndex const &index, int role) const {
+        uint32_t const key = KeyOf(index);
+        if (m_store == nullptr || key == 0 || key > m_store->size())
+            return QVariant();
+
+        uint32_t const    dense = key - 1;
+        char const *const kind  = sdk::gl_kindlabels[static_cast<size_t>(m_store->kinds()[dense])];
+        switch (role) {
+            case Qt::DisplayRole: {
+                std::string_view const name = m_store->names()[dense].view();
+
+                /* Unnamed elements, e.g. most associations, are listed by their kind. */
+                return name.empty() ? QString::fromUtf8(kind) : QString::fromUtf8(name.data(), static_cast<qsizetype>(name.size()));
+            }
+            case Qt::ToolTipRole: {
+                QString                        tip   = QString::fromUtf8(kind);
+                std::vector<Diagnostic> const *diags = m_checks != nullptr ? m_checks->find(m_store->handleAt(dense)) : nullptr;
+                if (diags != nullptr)
+                    for (Diagnostic const &diag : *diags)
+                        tip += QStringLiteral("\n") + QString::fromUtf8(ModelValidator::MessageOf(diag.rule));
+
+                return tip;
+            }
+            case Qt::ForegroundRole: {
+                std::vector<Diagnostic> const *diags = m_checks != nullptr ? m_checks->find(m_store->handleAt(dense)) : nullptr;
+                if (diags == nullptr)
+                    return QVariant();
+
+                bool const error = std::any_of(diags->begin(), diags->end(), [](Diagnostic const &diag) { return ModelValidator::SeverityOf(diag.rule) == DiagnosticSeverity::Error; });
+                return error ? QColor(Qt::red) : QColor(255, 140, 0);
+            }
+        }
+
+        return QVariant();
+    }
+
+    QVariant ProjectExplorerModel::headerData(int section, Qt::Orientation orientation, int role) const {
+        if (section != 0 || orientation != Qt::Horizontal || role != Qt::DisplayRole)
+            return QVariant();
+
+        return QStringLiteral("Name");
+    }
+
+    Qt::ItemFlags ProjectExplorerModel::flags(QModelIndex const &index) const {
+        if (!index.isValid())
+            return Qt::NoItemFlags;
+
+        Qt::ItemFlags res = Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+        if (!hasChildren(index))
+            res |= Qt::ItemNeverHasChildren;
+
+        return res;
+    }
+
+
+    void ProjectExplorerModel::build() const noexcept {
+        if (m_built)
+            return;
+
+        m_built = true;
+        m_first.clear();
+        m_children.clear();
+        m_row.clear();
+        if (m_store == nullptr)
+            return;
+
+        try {
+            /* Counting sort by parent key; children keep their drawing order. */
+            uint32_t const        n = m_store->size();
+            std::vector<uint32_t> first(static_cast<size_t>(n) + 2, 0);
+            std::vector<uint32_t> children(n);
+            std::vector<uint32_t> row(n);
+
+            for (uint32_t i = 0; i < n; ++i)
+                ++first[parentKey(i) + 1];
+            for (uint32_t key = 1; key < first.size(); ++key)
+                first[key] += first[key - 1];
+
+            std::vector<uint32_t> next(first.begin(), first.end() - 1);
+            for (uint32_t i = 0; i < n; ++i) {
+                uint32_t const key = parentKey(i);
+
+                row[i]                = next[key] - first[key];
+                children[next[key]++] = i;
+            }
+
+            m_first.swap(first);
+            m_children.swap(children);
+            m_row.swap(row);
+        } catch (...) {
+            SZSDK_APP_WARNING("Could not build the project explorer tree of {} elements.", m_store->size());
+        }
+    }
+
+    uint32_t ProjectExplorerModel::KeyOf(QModelIndex const &parent) noexcept {
+        return parent.isValid() ? static_cast<uint32_t>(parent.internalId()) : 0;
+    }
+
+    uint32_t ProjectExplorerModel::parentKey(uint32_t dense) const noexcept {
+        uint32_t const parent = m_store->indexOf(m_store->parents()[dense]);
+
+        /* Elements that are their own parent would never be reachable; show them at the top level. */
+        return parent < m_store->size() && parent != dense ? parent + 1 : 0;
+    }
+
+    uint32_t ProjectExplorerModel::childCount(uint32_t key) const noexcept {
+        return static_cast<size_t>(key) + 1 < m_first.size() ? m_first[key + 1] - m_first[key] : 0;
+    }
+
+    uint32_t ProjectExplorerModel::fetchedCount(uint32_t key) const noexcept {
+        auto const it = m_fetched.find(key);
+
+        return it != m_fetched.end() ? it->second : 0;
+    }
+}
+
+
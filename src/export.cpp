@@ -0,0 +1,510 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  export.cpp
+ * \brief implementation of the SVG, PDF and PNG exporters and of printing
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* external includes */
+#include <QFontMetricsF>
+#include <QPageSize>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QPicture>
+#include <QSaveFile>
+#include <QString>
+#include <QThread>
+
+/* sdk includes */
+#include <sdk/task.hpp>
+
+/* app includes */
+#include <export.hpp>
+#include <jobs.hpp>
+#include <pngwriter.hpp>
+#include <renderer.hpp>
+#include <textcache.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        constexpr size_t   gl_svgchunk     = 64 * 1024; /**< size at which the buffered output is written to the file, in bytes */
+        constexpr uint32_t gl_svgreport    = 4096;      /**< number of elements between two progress reports */
+        constexpr float    gl_exportmargin = 10.0f;     /**< blank space around the diagram, in scene units */
+        constexpr uint32_t gl_pngstrip     = 64;        /**< height of the strips PNG images are rendered in, in pixels */
+        constexpr uint32_t gl_pngstrips    = 2;         /**< number of strips rendered at once per worker */
+        constexpr double   gl_pngmaxside   = 1 << 30;   /**< largest width or height of PNG images, in pixels */
+        constexpr uint32_t gl_printpages   = 2;         /**< number of pages recorded at once per worker */
+        constexpr uint32_t gl_printmaxside = 1 << 12;   /**< largest number of pages in a row or column */
+
+        /**
+         * \brief  computes the union of the bounds of all visible elements
+         *
+         * \param  [in] store elements of the diagram
+         *
+         * \return bounds, in scene coordinates; empty if no element is visible
+         */
+        static sdk::ElementRect SceneBounds(sdk::ElementStore const &store) noexcept {
+            sdk::ElementRect const *const rects = store.bounds();
+            uint32_t const *const         flags = store.flags();
+
+            float left = 0.0f, top = 0.0f, right = 0.0f, bottom = 0.0f;
+            bool  any  = false;
+            for (uint32_t i = 0, n = store.size(); i < n; ++i) {
+                if ((flags[i] & sdk::ElementHidden) != 0)
+                    continue;
+
+                sdk::ElementRect const &rect = rects[i];
+                if (!any) {
+                    left   = rect.x;
+                    top    = rect.y;
+                    right  = rect.x + rect.w;
+                    bottom = rect.y + rect.h;
+                    any    = true;
+
+                    continue;
+                }
+                left   = std::min(left, rect.x);
+                top    = std::min(top, rect.y);
+                right  = std::max(right, rect.x + rect.w);
+                bottom = std::max(bottom, rect.y + rect.h);
+            }
+
+            return { left, top, right - left, bottom - top };
+        }
+
+        /**
+         * \brief appends a number in its shortest round-trip representation
+         *
+         * \param [in,out] out buffer to append to
+         * \param [in] value number to append
+         * \throw std::bad_alloc
+         */
+        static void AppendNumber(std::string &out, float const value) {
+            char buf[32];
+
+            std::to_chars_result const res = std::to_chars(buf, buf + sizeof(buf), value);
+            out.append(buf, res.ptr);
+        }
+
+        /**
+         * \brief appends text with the characters special to XML escaped
+         *
+         * \param [in,out] out buffer to append to
+         * \param [in] text UTF-8 text to append
+         * \throw std::bad_alloc
+         */
+        static void AppendEscaped(std::string &out, std::string_view const text) {
+            for (char const c : text) {
+                switch (c) {
+                    case '&': out += "&amp;";  break;
+                    case '<': out += "&lt;";   break;
+                    case '>': out += "&gt;";   break;
+                    case '"': out += "&quot;"; break;
+                    default:  out += c;        break;
+                }
+            }
+        }
+
+        /**
+         * \brief appends a line between two points
+         *
+         * \param [in,out] out buffer to append to
+         * \param [in] x1 x-coordinate of the first point
+         * \param [in] y1 y-coordinate of the first point
+         * \param [in] x2 x-coordinate of the second point
+         * \param [in] y2 y-coordinate of the second point
+         * \throw std::bad_alloc
+         */
+        static void AppendLine(std::string &out, float const x1, float const y1, float const x2, float const y2) {
+            out += "<line x1=\"";
+            AppendNumber(out, x1);
+            out += "\" y1=\"";
+            AppendNumber(out, y1);
+            out += "\" x2=\"";
+            AppendNumber(out, x2);
+            out += "\" y2=\"";
+            AppendNumber(out, y2);
+            out += "\"/>\n";
+        }
+
+        /**
+         * \brief appends the primitives of a single element, like *suzu::DiagramRenderer* paints it
+         *
+         * \param [in,out] out buffer to append to
+         * \param [in] kind kind of the element
+         * \param [in] rect bounds of the element
+         * \param [in] name name of the element
+         * \param [in] font font of the label
+         * \param [in] ascent ascent of *font*
+         * \throw std::bad_alloc
+         */
+        static void AppendElement(std::string &out, sdk::ElementKind const kind, sdk::ElementRect const &rect, sdk::StringId const name, QFont const &font, double const ascent) {
+            /* Associations are drawn as a line across their bounds. */
+            if (kind == sdk::ElementKind::Association) {
+                AppendLine(out, rect.x, rect.y, rect.x + rect.w, rect.y + rect.h);
+
+                return;
+            }
+
+            if (kind == sdk::ElementKind::Note) {
+                float const c = std::min(static_cast<float>(DiagramRenderer::gl_notecorner), std::min(rect.w, rect.h) / 2.0f);
+
+                out += "<polygon points=\"";
+                AppendNumber(out, rect.x);
+                out += ',';
+                AppendNumber(out, rect.y);
+                out += ' ';
+                AppendNumber(out, rect.x + rect.w - c);
+                out += ',';
+                AppendNumber(out, rect.y);
+                out += ' ';
+                AppendNumber(out, rect.x + rect.w);
+                out += ',';
+                AppendNumber(out, rect.y + c);
+                out += ' ';
+                AppendNumber(out, rect.x + rect.w);
+                out += ',';
+                AppendNumber(out, rect.y + rect.h);
+                out += ' ';
+                AppendNumber(out, rect.x);
+                out += ',';
+                AppendNumber(out, rect.y + rect.h);
+                out += "\"/>\n";
+            } else {
+                out += "<rect x=\"";
+                AppendNumber(out, rect.x);
+                out += "\" y=\"";
+                AppendNumber(out, rect.y);
+                out += "\" width=\"";
+                AppendNumber(out, rect.w);
+                out += "\" height=\"";
+                AppendNumber(out, rect.h);
+                out += "\"/>\n";
+            }
+
+            /* Classifiers separate their name from the (empty) member compartments. */
+            float const header = std::min(static_cast<float>(DiagramRenderer::gl_headerheight), rect.h);
+            if (DiagramRenderer::IsClassifier(kind) && rect.h > header)
+                AppendLine(out, rect.x, rect.y + header, rect.x + rect.w, rect.y + header);
+            if (name.empty())
+                return;
+
+            /* Labels are centered with the same layouts the canvas paints. */
+            QSizeF const size = TextLayoutCache::Shared().measure(name, font);
+            float const  area = DiagramRenderer::IsClassifier(kind) ? header : rect.h;
+
+            out += "<text x=\"";
+            AppendNumber(out, rect.x + static_cast<float>((rect.w - size.width()) / 2.0));
+            out += "\" y=\"";
+            AppendNumber(out, rect.y + static_cast<float>((area - size.height()) / 2.0 + ascent));
+            out += "\">";
+            AppendEscaped(out, name.view());
+            out += "</text>\n";
+        }
+
+        /**
+         * \brief  writes the buffered output to the file and empties the buffer
+         *
+         * \param  [in,out] file file to write to
+         * \param  [in,out] out buffered output
+         *
+         * \return *true* if the whole buffer was written
+         */
+        static bool Flush(QSaveFile &file, std::string &out) noexcept {
+            bool const ok = file.write(out.data(), static_cast<qint64>(out.size())) == static_cast<qint64>(out.size());
+
+            out.clear();
+            return ok;
+        }
+    }
+
+
+    sdk::ErrorCode ExportSvg(char const *path, sdk::ElementStore const &store, QFont const &font, JobContext *job) noexcept {
+        if (path == nullptr)
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            QSaveFile file(QString::fromUtf8(path));
+            if (!file.open(QIODevice::WriteOnly))
+                return sdk::ErrorCode::OpenFile;
+
+            sdk::ElementRect const scene  = internal::SceneBounds(store);
+            double const           ascent = QFontMetricsF(font).ascent();
+            std::string            out;
+            out.reserve(internal::gl_svgchunk + 4096);
+
+            out += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"";
+            internal::AppendNumber(out, scene.x - internal::gl_exportmargin);
+            out += ' ';
+            internal::AppendNumber(out, scene.y - internal::gl_exportmargin);
+            out += ' ';
+            internal::AppendNumber(out, scene.w + 2.0f * internal::gl_exportmargin);
+            out += ' ';
+            internal::AppendNumber(out, scene.h + 2.0f * internal::gl_exportmargin);
+            out += "\" width=\"";
+            internal::AppendNumber(out, scene.w + 2.0f * internal::gl_exportmargin);
+            out += "\" height=\"";
+            internal::AppendNumber(out, scene.h + 2.0f * internal::gl_exportmargin);
+            out += "\">\n<g fill=\"none\" stroke=\"black\" stroke-width=\"1\">\n";
+
+            /* Like on the canvas, shapes are outlined only; text is filled instead. */
+            QByteArray const family = font.family().toUtf8();
+            out += "<style>text { fill: black; stroke: none; font-family: \"";
+            internal::AppendEscaped(out, std::string_view(family.constData(), static_cast<size_t>(family.size())));
+            out += "\"; font-size: ";
+            internal::AppendNumber(out, static_cast<float>(font.pointSizeF() > 0.0 ? font.pointSizeF() : font.pixelSize()));
+            out += font.pointSizeF() > 0.0 ? "pt" : "px";
+            out += "; }</style>\n";
+
+            /* The elements are written in painting order, i.e. bottom-most first. */
+            sdk::ElementKind const *const kinds = store.kinds();
+            sdk::ElementRect const *const rects = store.bounds();
+            uint32_t const *const         flags = store.flags();
+            sdk::StringId const *const    names = store.names();
+            for (uint32_t i = 0, n = store.size(); i < n; ++i) {
+                if (job != nullptr && i % internal::gl_svgreport == 0 && i != 0) {
+                    if (job->isCancelled()) {
+                        file.cancelWriting();
+
+                        return sdk::ErrorCode::NoOperation;
+                    }
+
+                    job->report(static_cast<double>(i) / static_cast<double>(n), "Writing SVG");
+                }
+                if ((flags[i] & sdk::ElementHidden) != 0)
+                    continue;
+
+                internal::AppendElement(out, kinds[i], rects[i], names[i], font, ascent);
+                if (out.size() >= internal::gl_svgchunk && !internal::Flush(file, out))
+                    return sdk::ErrorCode::WriteFile;
+            }
+            out += "</g>\n</svg>\n";
+
+            if (!internal::Flush(file, out) || !file.commit())
+                return sdk::ErrorCode::WriteFile;
+
+            if (job != nullptr)
+                job->report(1.0, "Writing SVG");
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::WriteFile;
+    }
+
+    sdk::ErrorCode ExportPdf(char const *path, sdk::ElementStore const &store, QFont const &font) noexcept {
+        if (path == nullptr)
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            sdk::ElementRect const scene = internal::SceneBounds(store);
+            if (scene.w <= 0.0f || scene.h <= 0.0f)
+                return sdk::ErrorCode::NoOperation;
+
+            /* One scene unit becomes one point. */
+            QPdfWriter writer(QString::fromUtf8(path));
+            writer.setResolution(72);
+            writer.setPageSize(QPageSize(QSizeF(scene.w + 2.0f * internal::gl_exportmargin, scene.h + 2.0f * internal::gl_exportmargin), QPageSize::Point));
+            writer.setPageMargins(QMarginsF());
+
+            QPainter painter(&writer);
+            if (!painter.isActive())
+                return sdk::ErrorCode::WriteFile;
+
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.setFont(font);
+            painter.translate(internal::gl_exportmargin - scene.x, internal::gl_exportmargin - scene.y);
+            DiagramRenderer().render(painter, store, QRectF(scene.x, scene.y, scene.w, scene.h), DetailLevel::Full);
+
+            return painter.end() ? sdk::ErrorCode::Ok : sdk::ErrorCode::WriteFile;
+        } catch (...) { }
+
+        return sdk::ErrorCode::WriteFile;
+    }
+
+    sdk::ErrorCode ExportPng(char const *path, sdk::ElementStore const &store, QFont const &font, double scale, QColor const &background, JobContext *job) noexcept {
+        if (path == nullptr || !(scale > 0.0))
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            sdk::ElementRect const scene = internal::SceneBounds(store);
+            if (scene.w <= 0.0f || scene.h <= 0.0f)
+                return sdk::ErrorCode::NoOperation;
+
+            double const left   = static_cast<double>(scene.x) - internal::gl_exportmargin;
+            double const top    = static_cast<double>(scene.y) - internal::gl_exportmargin;
+            double const width  = std::ceil((static_cast<double>(scene.w) + 2.0 * internal::gl_exportmargin) * scale);
+            double const height = std::ceil((static_cast<double>(scene.h) + 2.0 * internal::gl_exportmargin) * scale);
+            if (width > internal::gl_pngmaxside || height > internal::gl_pngmaxside)
+                return sdk::ErrorCode::InvalidParameter;
+
+            PngWriter      writer;
+            sdk::ErrorCode err = writer.open(path, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+            if (err != sdk::ErrorCode::Ok)
+                return err;
+
+            /*
+             * Strips are rendered and encoded in batches. Only the strips of the current batch are
+             * held in memory; they are appended in order once the whole batch has been encoded.
+             */
+            uint32_t const                w       = static_cast<uint32_t>(width);
+            uint32_t const                h       = static_cast<uint32_t>(height);
+            uint32_t const                nstrips = (h + internal::gl_pngstrip - 1) / internal::gl_pngstrip;
+            uint32_t const                batch   = internal::gl_pngstrips * static_cast<uint32_t>(std::max(1, QThread::idealThreadCount()));
+            std::vector<PngWriter::Strip> strips(batch);
+            for (uint32_t first = 0; first < nstrips; first += batch) {
+                if (job != nullptr) {
+                    if (job->isCancelled())
+                        return sdk::ErrorCode::NoOperation;
+
+                    job->report(static_cast<double>(first) / static_cast<double>(nstrips), "Writing PNG");
+                }
+
+                uint32_t const count = std::min(batch, nstrips - first);
+                sdk::ParallelFor(count, [&](size_t const i) {
+                    uint32_t const y    = (first + static_cast<uint32_t>(i)) * internal::gl_pngstrip;
+                    uint32_t const rows = std::min(internal::gl_pngstrip, h - y);
+
+                    QImage image(static_cast<int>(w), static_cast<int>(rows), QImage::Format_RGB32);
+                    if (image.isNull())
+                        throw std::bad_alloc();
+                    image.fill(background);
+
+                    QPainter painter(&image);
+                    painter.setRenderHint(QPainter::Antialiasing);
+                    painter.setFont(font);
+                    painter.scale(scale, scale);
+                    painter.translate(-left, -(top + y / scale));
+                    DiagramRenderer().render(painter, store, QRectF(left, top + y / scale, w / scale, rows / scale), DetailLevel::Full);
+                    painter.end();
+
+                    PngWriter::Encode(image, strips[i]);
+                });
+
+                for (uint32_t i = 0; i < count; ++i) {
+                    err = writer.append(strips[i]);
+                    if (err != sdk::ErrorCode::Ok)
+                        return err;
+                }
+            }
+
+            err = writer.commit();
+            if (err == sdk::ErrorCode::Ok && job != nullptr)
+                job->report(1.0, "Writing PNG");
+            return err;
+        } catch (std::bad_alloc const &) {
+            return sdk::ErrorCode::CriticalResource;
+        } catch (...) { }
+
+        return sdk::ErrorCode::WriteFile;
+    }
+
+    sdk::ErrorCode PrintPages(QPagedPaintDevice &device, sdk::ElementStore const &store, QFont const &font, double scale, JobContext *job) noexcept {
+        if (!(scale > 0.0))
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            sdk::ElementRect const scene = internal::SceneBounds(store);
+            if (scene.w <= 0.0f || scene.h <= 0.0f)
+                return sdk::ErrorCode::NoOperation;
+
+            /* The paint rect is in device pixels; a point is 1/72 inch. */
+            QRect const  paint = device.pageLayout().paintRectPixels(device.resolution());
+            double const pixel = scale * device.resolution() / 72.0;
+            double const pagew = paint.width() / pixel;
+            double const pageh = paint.height() / pixel;
+            if (paint.isEmpty())
+                return sdk::ErrorCode::InvalidParameter;
+
+            double const left = static_cast<double>(scene.x) - internal::gl_exportmargin;
+            double const top  = static_cast<double>(scene.y) - internal::gl_exportmargin;
+            double const cols = std::ceil((static_cast<double>(scene.w) + 2.0 * internal::gl_exportmargin) / pagew);
+            double const rows = std::ceil((static_cast<double>(scene.h) + 2.0 * internal::gl_exportmargin) / pageh);
+            if (cols > internal::gl_printmaxside || rows > internal::gl_printmaxside)
+                return sdk::ErrorCode::InvalidParameter;
+
+            QPainter painter(&device);
+            if (!painter.isActive())
+                return sdk::ErrorCode::WriteFile;
+
+            /*
+             * Pages are recorded in batches, like the strips of PNG images. Recording does not
+             * depend on the device, so it runs on the workers; playing the pages back has to be
+             * done in order on the thread owning the painter.
+             */
+            uint32_t const        ncols  = static_cast<uint32_t>(cols);
+            uint32_t const        npages = ncols * static_cast<uint32_t>(rows);
+            uint32_t const        batch  = internal::gl_printpages * static_cast<uint32_t>(std::max(1, QThread::idealThreadCount()));
+            std::vector<QPicture> pages(batch);
+            for (uint32_t first = 0; first < npages; first += batch) {
+                if (job != nullptr) {
+                    if (job->isCancelled()) {
+                        painter.end();
+
+                        return sdk::ErrorCode::NoOperation;
+                    }
+
+                    job->report(static_cast<double>(first) / static_cast<double>(npages), "Printing");
+                }
+
+                uint32_t const count = std::min(batch, npages - first);
+                sdk::ParallelFor(count, [&](size_t const i) {
+                    uint32_t const page = first + static_cast<uint32_t>(i);
+                    QRectF const   region(left + (page % ncols) * pagew, top + (page / ncols) * pageh, pagew, pageh);
+
+                    pages[i] = QPicture();
+                    QPainter recorder(&pages[i]);
+                    recorder.setRenderHint(QPainter::Antialiasing);
+                    recorder.setFont(font);
+                    recorder.setClipRect(region);
+                    DiagramRenderer().render(recorder, store, region, DetailLevel::Full);
+                    recorder.end();
+                });
+
+                for (uint32_t i = 0; i < count; ++i) {
+                    uint32_t const page = first + i;
+                    if (page != 0 && !device.newPage())
+                        return sdk::ErrorCode::WriteFile;
+
+                    /* The painter starts at the paint rect, i.e. inside of the margins. */
+                    painter.save();
+                    painter.scale(pixel, pixel);
+                    painter.translate(-(left + (page % ncols) * pagew), -(top + (page / ncols) * pageh));
+                    painter.drawPicture(0, 0, pages[i]);
+                    painter.restore();
+
+                    pages[i] = QPicture();
+                }
+            }
+
+            if (!painter.end())
+                return sdk::ErrorCode::WriteFile;
+            if (job != nullptr)
+                job->report(1.0, "Printing");
+            return sdk::ErrorCode::Ok;
+        } catch (std::bad_alloc const &) {
+            return sdk::ErrorCode::CriticalResource;
+        } catch (...) { }
+
+        return sdk::ErrorCode::WriteFile;
+    }
+}
+
+
@@ -0,0 +1,221 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  forceanimator.cpp
+ * \brief implementation of the driver applying force-directed layouts to a diagram
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+/* external includes */
+#include <QGuiApplication>
+#include <QScreen>
+
+/* app includes */
+#include <forceanimator.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \struct suzu::internal::ForceFrames
+         * \brief  positions published by the simulation task
+         */
+        struct ForceFrames {
+            std::mutex         m_lock;  /**< guards all non-atomic members */
+            std::vector<float> m_x;     /**< center x-coordinates of the most recent frame */
+            std::vector<float> m_y;     /**< center y-coordinates of the most recent frame */
+            bool               m_fresh; /**< whether or not the GUI has not picked up the frame yet */
+            bool               m_done;  /**< whether or not the frame is the final one */
+            std::atomic<bool>  m_stop;  /**< whether or not the simulation is to stop */
+
+            ForceFrames() noexcept
+                : m_fresh(false), m_done(false), m_stop(false)
+            { }
+        };
+
+        /**
+         * \brief  determines the interval at which frames are shown
+         *
+         * \return interval, in milliseconds
+         */
+        static int GetFrameInterval() noexcept {
+            QScreen const *const screen = QGuiApplication::primaryScreen();
+            double const         rate   = screen != nullptr ? screen->refreshRate() : 0.0;
+
+            return static_cast<int>(1000.0 / (rate >= 1.0 ? rate : 60.0));
+        }
+    }
+
+
+    ForceAnimator::ForceAnimator() noexcept
+        : m_store(nullptr)
+    {
+        try {
+            m_timer = std::make_unique<QTimer>();
+
+            QObject::connect(m_timer.get(), &QTimer::timeout, m_timer.get(), [this]() { poll(); });
+        } catch (...) { }
+    }
+
+    ForceAnimator::~ForceAnimator() {
+        stop();
+    }
+
+
+    void ForceAnimator::setListener(Listener listener) noexcept {
+        m_listener = std::move(listener);
+    }
+
+    sdk::ErrorCode ForceAnimator::start(sdk::ElementStore &store, std::vector<std::pair<sdk::ElementHandle, sdk::ElementHandle>> const &edges, bool animated, sdk::ForceOptions const &opts) noexcept {
+        stop();
+
+        try {
+            /* Gather the nodes, and their index by dense index. */
+            uint32_t const                n      = store.size();
+            sdk::ElementKind const *const kinds  = store.kinds();
+            sdk::ElementRect const *const bounds = store.bounds();
+            uint32_t const *const         flags  = store.flags();
+            std::vector<uint32_t>         nodeof(n, UINT32_MAX);
+            std::vector<sdk::ElementRect> nodes;
+            std::vector<uint8_t>          pinned;
+            std::vector<sdk::LayoutEdge>  springs;
+
+            m_handles.clear();
+            for (uint32_t i = 0; i < n; ++i) {
+                if (kinds[i] == sdk::ElementKind::Association || (flags[i] & sdk::ElementHidden) != 0)
+                    continue;
+
+                nodeof[i] = static_cast<uint32_t>(nodes.size());
+                nodes.push_back(bounds[i]);
+                pinned.push_back(static_cast<uint8_t>((flags[i] & sdk::ElementLocked) != 0));
+                m_handles.push_back(store.handleAt(i));
+            }
+            if (nodes.empty())
+                return sdk::ErrorCode::NoOperation;
+
+            for (auto const &[a, b] : edges) {
+                uint32_t const ia = store.indexOf(a);
+                uint32_t const ib = store.indexOf(b);
+
+                if (ia < n && ib < n && nodeof[ia] != UINT32_MAX && nodeof[ib] != UINT32_MAX)
+                    springs.push_back({ nodeof[ia], nodeof[ib] });
+            }
+
+            auto const           layout = std::make_shared<sdk::ForceLayout>(opts);
+            sdk::ErrorCode const err    = layout->reset(nodes, springs, pinned);
+            if (err != sdk::ErrorCode::Ok)
+                return err;
+
+            m_store = &store;
+            if (!animated || m_timer == nullptr) {
+                layout->run(gl_maxsteps);
+
+                apply(layout->xs(), layout->ys());
+                if (m_listener)
+                    m_listener(true);
+                return sdk::ErrorCode::Ok;
+            }
+
+            auto frames = std::make_shared<internal::ForceFrames>();
+            m_task = sdk::SubmitTask([frames, layout]() {
+                uint32_t steps = 0;
+                bool     more  = true;
+
+                while (more && !frames->m_stop && !sdk::IsTaskCancelled()) {
+                    more = layout->step() && ++steps < gl_maxsteps;
+
+                    /* Frames the GUI has not picked up yet are replaced by the final one only. */
+                    std::lock_guard<std::mutex> lock(frames->m_lock);
+                    if (frames->m_fresh && more)
+                        continue;
+
+                    frames->m_x.assign(layout->xs(), layout->xs() + layout->size());
+                    frames->m_y.assign(layout->ys(), layout->ys() + layout->size());
+                    frames->m_fresh = true;
+                    frames->m_done  = !more;
+                }
+            });
+            if (!m_task.isValid())
+                return sdk::ErrorCode::CriticalResource;
+
+            m_frames = std::move(frames);
+            m_timer->start(internal::GetFrameInterval());
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    void ForceAnimator::stop() noexcept {
+        if (m_frames == nullptr)
+            return;
+
+        m_frames->m_stop = true;
+        m_task.cancel();
+        m_task.wait();
+
+        m_timer->stop();
+        m_frames.reset();
+        m_task = {};
+    }
+
+
+    void ForceAnimator::apply(float const *xs, float const *ys) noexcept {
+        for (size_t i = 0; i < m_handles.size(); ++i) {
+            uint32_t const dense = m_store->indexOf(m_handles[i]);
+            if (dense == UINT32_MAX)
+                continue;
+
+            /* Elements may have been resized since the layout started. */
+            sdk::ElementRect rect = m_store->bounds()[dense];
+            rect.x = xs[i] - rect.w * 0.5f;
+            rect.y = ys[i] - rect.h * 0.5f;
+
+            try {
+                m_store->setBounds(m_handles[i], rect);
+            } catch (...) { }
+        }
+    }
+
+    void ForceAnimator::poll() noexcept {
+        if (m_frames == nullptr)
+            return;
+
+        std::vector<float> xs;
+        std::vector<float> ys;
+        bool               done;
+        {
+            std::lock_guard<std::mutex> lock(m_frames->m_lock);
+            if (!m_frames->m_fresh)
+                return;
+
+            xs.swap(m_frames->m_x);
+            ys.swap(m_frames->m_y);
+            m_frames->m_fresh = false;
+            done = m_frames->m_done;
+        }
+        apply(xs.data(), ys.data());
+
+        if (done) {
+            m_timer->stop();
+            m_frames.reset();
+            m_task = {};
+        }
+        if (m_listener)
+            m_listener(done);
+    }
+}
+
+
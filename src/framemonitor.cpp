@@ -0,0 +1,401 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  framemonitor.cpp
+ * \brief implementation of the frame-time and input-latency overlay
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cstdio>
+
+/* external includes */
+#include <QCoreApplication>
+#include <QEvent>
+#include <QFont>
+#include <QFontMetrics>
+#include <QKeyEvent>
+#include <QMouseEvent>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/util.hpp>
+
+/* app includes */
+#include <framemonitor.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        static QEvent::Type const gl_probeevent = static_cast<QEvent::Type>(QEvent::registerEventType()); /**< type of the queue probes */
+        static constexpr int64_t  gl_inputttl   = 1000000000;                                             /**< time after which an input not followed by a paint is discarded, in nanoseconds */
+
+
+        /**
+         * \class suzu::internal::ProbeEvent
+         * \brief event posted to measure the delay of the event queue
+         */
+        class ProbeEvent final : public QEvent {
+        public:
+            int64_t const posted; /**< time of posting, on the profiler's clock */
+
+            explicit ProbeEvent(int64_t const time) noexcept
+                : QEvent(gl_probeevent), posted(time)
+            { }
+        };
+
+
+        /**
+         * \brief  converts nanoseconds to milliseconds
+         *
+         * \param  [in] ns nanoseconds
+         *
+         * \return milliseconds
+         */
+        static double ToMs(int64_t const ns) noexcept {
+            return static_cast<double>(ns) / 1e6;
+        }
+
+        /**
+         * \brief  retrieves whether or not an event is input that a view may respond to by repainting
+         *
+         * \param  [in] event event to check
+         *
+         * \return *true* for key presses, clicks, wheel turns and drags
+         */
+        static bool IsInput(QEvent const *const event) noexcept {
+            switch (event->type()) {
+                case QEvent::KeyPress:
+                case QEvent::MouseButtonPress:
+                case QEvent::MouseButtonRelease:
+                case QEvent::MouseButtonDblClick:
+                case QEvent::Wheel:
+                    return true;
+                case QEvent::MouseMove:
+                    return static_cast<QMouseEvent const *>(event)->buttons() != Qt::NoButton;
+                default:
+                    break;
+            }
+
+            return false;
+        }
+    }
+
+
+    FrameMonitor::FrameMonitor(bool const visible, std::string trace, QObject *const parent) noexcept
+        : QObject(parent), m_profiler(sdk::Profiler::Local()), m_trace(std::move(trace)), m_visible(false), m_wasrec(false),
+        m_stamp(0), m_thread(0), m_begin(-1), m_stats()
+    {
+        try {
+            m_timer = std::make_unique<QTimer>();
+            m_timer->setInterval(gl_tick);
+
+            QObject::connect(m_timer.get(), &QTimer::timeout, this, [this]() { tick(); });
+        } catch (...) {
+            SZSDK_APP_WARNING("Could not create the timer of the frame monitor.");
+        }
+
+        QCoreApplication::instance()->installEventFilter(this);
+        gl_instance = this;
+
+        setVisible(visible);
+    }
+
+    FrameMonitor::~FrameMonitor() {
+        setVisible(false);
+
+        QCoreApplication::instance()->removeEventFilter(this);
+        if (gl_instance == this)
+            gl_instance = nullptr;
+    }
+
+    uint32_t FrameMonitor::PaintZone() noexcept {
+        static uint32_t const gl_zone = sdk::Profiler::Local().zone("canvas paint", __FILE__, __LINE__);
+
+        return gl_zone;
+    }
+
+    void FrameMonitor::watch(QWidget *const view) noexcept {
+        try {
+            m_views.erase(std::remove_if(m_views.begin(), m_views.end(), [](QPointer<QWidget> const &ptr) { return ptr.isNull(); }), m_views.end());
+
+            m_views.emplace_back(view);
+        } catch (...) { }
+    }
+
+    void FrameMonitor::setVisible(bool const visible) noexcept {
+        if (visible == m_visible || m_timer == nullptr)
+            return;
+
+        m_visible = visible;
+        if (visible) {
+            m_wasrec = m_profiler.isEnabled();
+            m_profiler.setEnabled(true);
+
+            /* Events buffered while hidden are not part of the window; a trace being recorded keeps them. */
+            m_profiler.collect([](sdk::Profiler::Event const &) { });
+            m_timer->start();
+        } else {
+            m_timer->stop();
+            m_profiler.setEnabled(m_wasrec);
+
+            m_open.clear();
+            m_events.clear();
+            m_frames.clear();
+            m_probes.clear();
+            m_inputs.clear();
+            m_begin = -1;
+            m_stats = {};
+        }
+
+        for (QPointer<QWidget> const &view : m_views)
+            if (!view.isNull())
+                view->update();
+    }
+
+    void FrameMonitor::paintOverlay(QPainter &painter, QRect const &rect) const {
+        if (!m_visible)
+            return;
+
+        char lines[4][96];
+        std::snprintf(lines[0], sizeof(lines[0]), "paint  %6.2f ms avg  %6.2f ms max", m_stats.paintmean, m_stats.paintmax);
+        std::snprintf(lines[1], sizeof(lines[1]), "frame  p50 %5.1f p95 %5.1f p99 %5.1f", m_stats.interval[0], m_stats.interval[1], m_stats.interval[2]);
+        std::snprintf(lines[2], sizeof(lines[2]), "queue  %6.2f ms last %6.2f ms max", m_stats.queuelast, m_stats.queuemax);
+        if (m_stats.inputlast < 0.0)
+            std::snprintf(lines[3], sizeof(lines[3]), "input       - ms last      - ms max");
+        else
+            std::snprintf(lines[3], sizeof(lines[3]), "input  %6.1f ms last %6.1f ms max", m_stats.inputlast, m_stats.inputmax);
+
+        painter.save();
+        painter.resetTransform();
+        painter.setRenderHint(QPainter::Antialiasing, false);
+
+        QFont font(QStringLiteral("monospace"));
+        font.setStyleHint(QFont::Monospace);
+        font.setPointSize(9);
+        painter.setFont(font);
+
+        QFontMetrics const metrics(font);
+        int const          lineh = metrics.height();
+        int const          width = metrics.horizontalAdvance(QString::fromLatin1(lines[0]));
+        QRect const        box(rect.left() + 8, rect.top() + 8, width + 16, lineh * 4 + 12);
+
+        painter.fillRect(box, QColor(0, 0, 0, 160));
+        painter.setPen(Qt::white);
+        for (int i = 0; i < 4; ++i)
+            painter.drawText(box.left() + 8, box.top() + 6 + metrics.ascent() + i * lineh, QString::fromLatin1(lines[i]));
+
+        painter.restore();
+    }
+
+    sdk::ErrorCode FrameMonitor::dump() noexcept {
+        if (!m_visible || m_trace.empty())
+            return sdk::ErrorCode::InvalidState;
+
+        try {
+            /* Zones collected since the last tick belong to the window as well. */
+            tick();
+
+            std::vector<sdk::Profiler::Event> const events(m_events.begin(), m_events.end());
+            std::string                             trace;
+            if (m_profiler.exportChromeTrace(events.data(), events.size(), trace) != sdk::ErrorCode::Ok)
+                return sdk::ErrorCode::CriticalResource;
+
+            /* Measurements are added as counters, next to the zones they were derived from. */
+            std::string extra;
+            char        buf[128];
+            for (Probe const &probe : m_probes) {
+                std::snprintf(buf, sizeof(buf), ",{\"name\":\"queue delay\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"ms\":%.3f}}", static_cast<double>(probe.time) / 1000.0, internal::ToMs(probe.delay));
+                extra += buf;
+            }
+            for (Frame const &frame : m_frames)
+                if (frame.latency >= 0) {
+                    std::snprintf(buf, sizeof(buf), ",{\"name\":\"input latency\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"ms\":%.3f}}", static_cast<double>(frame.end) / 1000.0, internal::ToMs(frame.latency));
+                    extra += buf;
+                }
+            if (events.empty() && !extra.empty())
+                extra.erase(0, 1);
+            trace.insert(trace.size() - 2, extra);
+
+            if (sdk::util::WriteFileAtomic(m_trace.c_str(), trace.c_str(), trace.length()) != sdk::ErrorCode::Ok)
+                return sdk::ErrorCode::WriteFile;
+
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+
+    bool FrameMonitor::eventFilter(QObject *const watched, QEvent *const event) {
+        if (event->type() == QEvent::KeyPress && static_cast<QKeyEvent *>(event)->key() == Qt::Key_F12) {
+            QKeyEvent const *const key = static_cast<QKeyEvent *>(event);
+            if (key->isAutoRepeat())
+                return true;
+
+            if (key->modifiers() & Qt::ShiftModifier) {
+                sdk::ErrorCode const res = dump();
+                if (res == sdk::ErrorCode::Ok)
+                    SZSDK_APP_INFO("Wrote the last {} seconds of frames to \"{}\".", gl_window / 1000000000, m_trace);
+                else if (res != sdk::ErrorCode::InvalidState)
+                    SZSDK_APP_WARNING("Could not write frame trace \"{}\" (error {}).", m_trace, static_cast<int>(res));
+            } else
+                setVisible(!m_visible);
+
+            return true;
+        }
+
+        /*
+         * Input events are seen once per object they are delivered to, e.g. the window and then the
+         * widget under the cursor; their timestamp tells repeated deliveries apart.
+         */
+        if (m_visible && internal::IsInput(event)) {
+            quint64 const stamp = static_cast<QInputEvent *>(event)->timestamp();
+            if (stamp != m_stamp)
+                try {
+                    m_inputs.push_back(m_profiler.now());
+                    m_stamp = stamp;
+                } catch (...) { }
+        }
+
+        return QObject::eventFilter(watched, event);
+    }
+
+    void FrameMonitor::customEvent(QEvent *const event) {
+        if (event->type() != internal::gl_probeevent)
+            return;
+
+        int64_t const now = m_profiler.now();
+        try {
+            m_probes.push_back({ now, now - static_cast<internal::ProbeEvent *>(event)->posted });
+        } catch (...) { }
+    }
+
+
+    void FrameMonitor::tick() noexcept {
+        if (!m_visible)
+            return;
+
+        m_profiler.collect([this](sdk::Profiler::Event const &event) {
+            try {
+                m_events.push_back(event);
+            } catch (...) { }
+
+            process(event);
+        });
+
+        try {
+            QCoreApplication::postEvent(this, new internal::ProbeEvent(m_profiler.now()));
+        } catch (...) { }
+
+        refresh();
+
+        for (QPointer<QWidget> const &view : m_views)
+            if (!view.isNull() && view->isVisible())
+                view->update();
+    }
+
+    void FrameMonitor::process(sdk::Profiler::Event const &event) noexcept {
+        uint32_t const paint = PaintZone();
+        if (event.zone == paint && m_thread == 0)
+            m_thread = event.thread;
+        if (event.thread != m_thread || m_thread == 0)
+            return;
+
+        try {
+            if (event.zone != 0) {
+                m_open.push_back(event.zone);
+                if (event.zone == paint && m_begin < 0)
+                    m_begin = event.time;
+
+                return;
+            }
+
+            /* Zones entered before the display was shown have no beginning in the window. */
+            if (m_open.empty())
+                return;
+            uint32_t const zone = m_open.back();
+            m_open.pop_back();
+            if (zone != paint || std::find(m_open.begin(), m_open.end(), paint) != m_open.end())
+                return;
+
+            /* The paint serves all inputs that arrived before it started. */
+            Frame frame = { m_begin, event.time, -1 };
+            while (!m_inputs.empty() && m_inputs.front() <= m_begin) {
+                if (frame.latency < 0 && m_begin - m_inputs.front() <= internal::gl_inputttl)
+                    frame.latency = event.time - m_inputs.front();
+
+                m_inputs.pop_front();
+            }
+
+            m_frames.push_back(frame);
+            m_begin = -1;
+        } catch (...) { }
+    }
+
+    void FrameMonitor::refresh() noexcept {
+        int64_t const now    = m_profiler.now();
+        int64_t const oldest = now - gl_window;
+
+        while (!m_events.empty() && m_events.front().time < oldest)
+            m_events.pop_front();
+        while (!m_frames.empty() && m_frames.front().end < oldest)
+            m_frames.pop_front();
+        while (!m_probes.empty() && m_probes.front().time < oldest)
+            m_probes.pop_front();
+        while (!m_inputs.empty() && m_inputs.front() < now - internal::gl_inputttl)
+            m_inputs.pop_front();
+
+        Stats stats = {};
+        stats.frames    = static_cast<uint32_t>(m_frames.size());
+        stats.inputlast = -1.0;
+        stats.inputmax  = -1.0;
+
+        int64_t total = 0;
+        for (Frame const &frame : m_frames) {
+            total          += frame.end - frame.begin;
+            stats.paintmax  = std::max(stats.paintmax, internal::ToMs(frame.end - frame.begin));
+            if (frame.latency >= 0) {
+                stats.inputlast = internal::ToMs(frame.latency);
+                stats.inputmax  = std::max(stats.inputmax, stats.inputlast);
+            }
+        }
+        if (!m_frames.empty())
+            stats.paintmean = internal::ToMs(total) / static_cast<double>(m_frames.size());
+
+        try {
+            std::vector<int64_t> intervals;
+            intervals.reserve(m_frames.size());
+            for (size_t i = 1; i < m_frames.size(); ++i)
+                intervals.push_back(m_frames[i].end - m_frames[i - 1].end);
+
+            if (!intervals.empty()) {
+                static constexpr double gl_ranks[] = { 0.5, 0.95, 0.99 };
+
+                for (size_t i = 0; i < 3; ++i) {
+                    auto const nth = intervals.begin() + static_cast<ptrdiff_t>(gl_ranks[i] * static_cast<double>(intervals.size() - 1) + 0.5);
+
+                    std::nth_element(intervals.begin(), nth, intervals.end());
+                    stats.interval[i] = internal::ToMs(*nth);
+                }
+            }
+        } catch (...) { }
+
+        for (Probe const &probe : m_probes)
+            stats.queuemax = std::max(stats.queuemax, internal::ToMs(probe.delay));
+        if (!m_probes.empty())
+            stats.queuelast = internal::ToMs(m_probes.back().delay);
+
+        m_stats = stats;
+    }
+}
+
+
@@ -0,0 +1,427 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  gpucanvas.cpp
+ * \brief implementation of the OpenGL backend of the diagram view
+ */
+
+
+/* stdlib includes */
+#include <cstddef>
+#include <string>
+
+/* external includes */
+#include <QMouseEvent>
+#include <QOpenGLContext>
+#include <QPainter>
+#include <QWheelEvent>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/profile.hpp>
+
+/* app includes */
+#include <framemonitor.hpp>
+#include <gpucanvas.hpp>
+#include <metrics.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * Maps scene coordinates to clip space; shared by all vertex shaders.
+         */
+        constexpr char const gl_glsltransform[] = R"(
+            #version 330 core
+
+            uniform vec2  u_origin;
+            uniform float u_zoom;
+            uniform vec2  u_viewport;
+
+            vec4 ToClip(vec2 scene) {
+                vec2 px = (scene - u_origin) * u_zoom;
+
+                return vec4(px.x / u_viewport.x * 2.0 - 1.0, 1.0 - px.y / u_viewport.y * 2.0, 0.0, 1.0);
+            }
+        )";
+
+        /**
+         * Expands the unit square to the bounds of every box instance.
+         */
+        constexpr char const gl_glslboxvert[] = R"(
+            layout(location = 0) in vec2  a_corner;
+            layout(location = 1) in vec4  a_rect;
+            layout(location = 2) in float a_shape;
+
+            out vec2       v_local;
+            flat out vec2  v_size;
+            flat out float v_shape;
+
+            void main() {
+                v_local = a_corner * a_rect.zw;
+                v_size  = a_rect.zw;
+                v_shape = a_shape;
+
+                gl_Position = ToClip(a_rect.xy + v_local);
+            }
+        )";
+
+        /**
+         * Draws the outline of a box, plus the header line of classifiers and the folded corner of
+         * notes, with lines one device pixel wide. The interior is transparent, like in the raster
+         * backend.
+         */
+        constexpr char const gl_glslboxfrag[] = R"(
+            #version 330 core
+
+            uniform float u_scale;
+            uniform int   u_detail;
+            uniform vec4  u_stroke;
+            uniform float u_header;
+            uniform float u_corner;
+
+            in vec2       v_local;
+            flat in vec2  v_size;
+            flat in float v_shape;
+
+            out vec4 o_color;
+
+            float Cover(float dist) {
+                return clamp(1.0 - abs(dist), 0.0, 1.0);
+            }
+
+            void main() {
+                vec2 p = v_local * u_scale;
+                vec2 s = v_size * u_scale;
+
+                float alpha = Cover(min(min(p.x, p.y), min(s.x - p.x, s.y - p.y)) - 0.5);
+                if (v_shape == 1.0 && u_detail == 0) {
+                    float h = min(u_header, v_size.y) * u_scale;
+
+                    if (h < s.y)
+                        alpha = max(alpha, Cover(p.y - h));
+                }
+                if (v_shape == 2.0 && u_detail != 2) {
+                    float c    = min(u_corner, min(v_size.x, v_size.y) * 0.5) * u_scale;
+                    float diag = ((s.x - p.x) + p.y - c) * 0.70710678;
+
+                    alpha = diag < 0.0 ? Cover(diag - 0.5) : max(alpha, Cover(diag - 0.5));
+                }
+
+                if (alpha <= 0.0)
+                    discard;
+                o_color = vec4(u_stroke.rgb, u_stroke.a * alpha);
+            }
+        )";
+
+        /**
+         * Maps the unit line to the diagonal of every association instance.
+         */
+        constexpr char const gl_glsledgevert[] = R"(
+            layout(location = 0) in float a_t;
+            layout(location = 1) in vec4  a_rect;
+
+            void main() {
+                gl_Position = ToClip(a_rect.xy + a_t * a_rect.zw);
+            }
+        )";
+
+        /**
+         * Draws associations in the stroke color.
+         */
+        constexpr char const gl_glsledgefrag[] = R"(
+            #version 330 core
+
+            uniform vec4 u_stroke;
+
+            out vec4 o_color;
+
+            void main() {
+                o_color = u_stroke;
+            }
+        )";
+
+
+        /**
+         * \brief  compiles and links a shader program
+         *
+         * \param  [in] vert body of the vertex shader, appended to *gl_glsltransform*
+         * \param  [in] frag fragment shader
+         *
+         * \return linked program, or *nullptr* on failure
+         */
+        static std::unique_ptr<QOpenGLShaderProgram> CreateProgram(char const *vert, char const *frag) {
+            auto prog = std::make_unique<QOpenGLShaderProgram>();
+
+            std::string const source = std::string(gl_glsltransform) + vert;
+            if (!prog->addShaderFromSourceCode(QOpenGLShader::Vertex, source.c_str())
+                || !prog->addShaderFromSourceCode(QOpenGLShader::Fragment, frag)
+                || !prog->link()
+            ) {
+                SZSDK_APP_ERROR("Could not build shader program: {}", prog->log().toStdString());
+
+                return nullptr;
+            }
+
+            return prog;
+        }
+    }
+
+
+    GpuCanvas::GpuCanvas(LodThresholds const &lod, QWidget *parent) noexcept
+        : QOpenGLWidget(parent), m_store(nullptr), m_lod(lod), m_uploaded(0), m_stale(true), m_nboxes(0), m_nedges(0)
+    {
+        setFormat(Format());
+
+        if (FrameMonitor *const hud = FrameMonitor::Instance())
+            hud->watch(this);
+    }
+
+    GpuCanvas::~GpuCanvas() {
+        /* Resources belong to the widget's context, which must be current while destroying them. */
+        makeCurrent();
+
+        m_boxvao.destroy();
+        m_edgevao.destroy();
+        m_quad.destroy();
+        m_line.destroy();
+        m_boxbuf.destroy();
+        m_edgebuf.destroy();
+        m_boxprog.reset();
+        m_edgeprog.reset();
+        doneCurrent();
+    }
+
+
+    QSurfaceFormat GpuCanvas::Format() noexcept {
+        QSurfaceFormat fmt;
+        fmt.setVersion(3, 3);
+        fmt.setProfile(QSurfaceFormat::CoreProfile);
+
+        return fmt;
+    }
+
+    bool GpuCanvas::IsSupported() noexcept {
+        QOpenGLContext context;
+        context.setFormat(Format());
+        if (!context.create())
+            return false;
+
+        /* Drivers may silently fall back to an older version. */
+        QSurfaceFormat const fmt = context.format();
+        return fmt.majorVersion() > 3 || (fmt.majorVersion() == 3 && fmt.minorVersion() >= 3);
+    }
+
+
+    void GpuCanvas::setStore(sdk::ElementStore const *store) noexcept {
+        m_store = store;
+        m_stale = true;
+
+        update();
+    }
+
+    void GpuCanvas::setLodThresholds(LodThresholds const &lod) noexcept {
+        m_lod = lod;
+
+        update();
+    }
+
+    void GpuCanvas::setStyles(std::shared_ptr<StyleSheet const> styles) noexcept {
+        /* Shapes are drawn by the shaders; the sheet only colors the names. */
+        m_render.setStyles(std::move(styles));
+
+        update();
+    }
+
+    void GpuCanvas::setViewport(double const zoom, QPointF const &origin) noexcept {
+        m_view.setViewport(zoom, origin);
+
+        update();
+    }
+
+
+    void GpuCanvas::initializeGL() {
+        initializeOpenGLFunctions();
+
+        m_boxprog  = internal::CreateProgram(internal::gl_glslboxvert, internal::gl_glslboxfrag);
+        m_edgeprog = internal::CreateProgram(internal::gl_glsledgevert, internal::gl_glsledgefrag);
+
+        static constexpr GLfloat gl_quad[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+        static constexpr GLfloat gl_line[] = { 0.0f, 1.0f };
+
+        /* Boxes: the unit square per vertex, bounds and shape per instance. */
+        m_boxvao.create();
+        m_boxvao.bind();
+        m_quad.create();
+        m_quad.bind();
+        m_quad.allocate(gl_quad, static_cast<int>(sizeof gl_quad));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+        m_boxbuf.create();
+        m_boxbuf.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+        m_boxbuf.bind();
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(BoxInstance), reinterpret_cast<void const *>(offsetof(BoxInstance, rect)));
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(BoxInstance), reinterpret_cast<void const *>(offsetof(BoxInstance, shape)));
+        glVertexAttribDivisor(2, 1);
+        m_boxvao.release();
+
+        /* Associations: the unit line per vertex, bounds per instance. */
+        m_edgevao.create();
+        m_edgevao.bind();
+        m_line.create();
+        m_line.bind();
+        m_line.allocate(gl_line, static_cast<int>(sizeof gl_line));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, 0, nullptr);
+        m_edgebuf.create();
+        m_edgebuf.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+        m_edgebuf.bind();
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(sdk::ElementRect), nullptr);
+        glVertexAttribDivisor(1, 1);
+        m_edgevao.release();
+
+        m_stale = true;
+    }
+
+    void GpuCanvas::paintGL() {
+        static uint32_t const gl_metric = Metrics::Local().add("frame.paint", Metrics::Kind::Histogram);
+        sdk::ProfileScope const zone(FrameMonitor::PaintZone());
+        MetricTimer const       timer(gl_metric);
+
+        QColor const background = palette().base().color();
+        glClearColor(background.redF(), background.greenF(), background.blueF(), 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        if (m_store != nullptr && m_boxprog != nullptr && m_edgeprog != nullptr)
+            paintScene();
+
+        FrameMonitor const *const hud = FrameMonitor::Instance();
+        if (hud != nullptr && hud->isVisible()) {
+            QPainter painter(this);
+
+            hud->paintOverlay(painter, rect());
+        }
+    }
+
+    void GpuCanvas::paintScene() {
+        upload();
+
+        /* *QPainter* changes the state of the context, so it is restored on every frame. */
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        double const      zoom   = m_view.zoom();
+        QPointF const     origin = m_view.origin();
+        DetailLevel const detail = m_lod.select(zoom);
+        QColor const      stroke(Qt::black);
+
+        for (QOpenGLShaderProgram *prog : { m_edgeprog.get(), m_boxprog.get() }) {
+            prog->bind();
+            prog->setUniformValue("u_origin", static_cast<float>(origin.x()), static_cast<float>(origin.y()));
+            prog->setUniformValue("u_zoom", static_cast<float>(zoom));
+            prog->setUniformValue("u_viewport", static_cast<float>(width()), static_cast<float>(height()));
+            prog->setUniformValue("u_stroke", stroke.redF(), stroke.greenF(), stroke.blueF(), stroke.alphaF());
+        }
+
+        m_edgeprog->bind();
+        m_edgevao.bind();
+        glDrawArraysInstanced(GL_LINES, 0, 2, m_nedges);
+        m_edgevao.release();
+
+        m_boxprog->bind();
+        m_boxprog->setUniformValue("u_scale", static_cast<float>(zoom * devicePixelRatioF()));
+        m_boxprog->setUniformValue("u_detail", static_cast<int>(detail));
+        m_boxprog->setUniformValue("u_header", static_cast<float>(DiagramRenderer::gl_headerheight));
+        m_boxprog->setUniformValue("u_corner", static_cast<float>(DiagramRenderer::gl_notecorner));
+        m_boxvao.bind();
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, m_nboxes);
+        m_boxvao.release();
+        m_boxprog->release();
+
+        if (detail == DetailLevel::Outlines)
+            return;
+
+        /* Names are only laid out for elements intersecting the viewport. */
+        m_labels.clear();
+        m_render.collect(*m_store, QRectF(origin, QSizeF(size()) / zoom), m_labels);
+
+        QPainter painter(this);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.scale(zoom, zoom);
+        painter.translate(-origin);
+        m_render.renderLabels(painter, m_labels, detail);
+    }
+
+    void GpuCanvas::upload() {
+        if (!m_stale && m_uploaded == m_store->revision())
+            return;
+
+        m_boxes.clear();
+        m_edges.clear();
+
+        sdk::ElementKind const *const kinds  = m_store->kinds();
+        sdk::ElementRect const *const bounds = m_store->bounds();
+        uint32_t const *const         flags  = m_store->flags();
+        for (uint32_t i = 0, n = m_store->size(); i < n; ++i) {
+            if (flags[i] & sdk::ElementHidden)
+                continue;
+
+            sdk::ElementRect const &rect = bounds[i];
+            if (kinds[i] == sdk::ElementKind::Association) {
+                m_edges.push_back(rect);
+
+                continue;
+            }
+
+            float const shape = DiagramRenderer::IsClassifier(kinds[i]) ? 1.0f : kinds[i] == sdk::ElementKind::Note ? 2.0f : 0.0f;
+            m_boxes.push_back({ { rect.x, rect.y, rect.w, rect.h }, shape });
+        }
+
+        m_boxbuf.bind();
+        m_boxbuf.allocate(m_boxes.data(), static_cast<int>(m_boxes.size() * sizeof(BoxInstance)));
+        m_edgebuf.bind();
+        m_edgebuf.allocate(m_edges.data(), static_cast<int>(m_edges.size() * sizeof(sdk::ElementRect)));
+
+        m_nboxes   = static_cast<GLsizei>(m_boxes.size());
+        m_nedges   = static_cast<GLsizei>(m_edges.size());
+        m_uploaded = m_store->revision();
+        m_stale    = false;
+    }
+
+
+    void GpuCanvas::wheelEvent(QWheelEvent *event) {
+        m_view.wheel(event);
+
+        update();
+    }
+
+    void GpuCanvas::mousePressEvent(QMouseEvent *event) {
+        if (!m_view.press(event))
+            QOpenGLWidget::mousePressEvent(event);
+    }
+
+    void GpuCanvas::mouseMoveEvent(QMouseEvent *event) {
+        if (m_view.move(event))
+            update();
+        else
+            QOpenGLWidget::mouseMoveEvent(event);
+    }
+
+    void GpuCanvas::mouseReleaseEvent(QMouseEvent *event) {
+        if (!m_view.release(event))
+            QOpenGLWidget::mouseReleaseEvent(event);
+    }
+}
+
+
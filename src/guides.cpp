@@ -0,0 +1,284 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  guides.cpp
+ * \brief implementation of the snapping and alignment guides shown while dragging
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+
+/* app includes */
+#include <guides.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \brief  computes the positions of the anchors of a box on an axis
+         *
+         * \param  [in] rect box
+         * \param  [in] axis 0 for horizontal positions, 1 for vertical ones
+         *
+         * \return positions of the start, center and end, see *suzu::SnapGuides::Anchor*
+         */
+        static std::array<float, SnapGuides::__NumAnchors__> AnchorsOf(sdk::ElementRect const &rect, size_t const axis) noexcept {
+            float const pos  = axis == 0 ? rect.x : rect.y;
+            float const size = axis == 0 ? rect.w : rect.h;
+
+            return { pos, pos + size * 0.5f, pos + size };
+        }
+
+        /**
+         * \brief  checks whether two boxes overlap, including touching ones
+         *
+         * \param  [in] a first box
+         * \param  [in] b second box
+         *
+         * \return *true* if the boxes share at least one point
+         */
+        static bool Overlaps(sdk::ElementRect const &a, sdk::ElementRect const &b) noexcept {
+            return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h && b.y <= a.y + a.h;
+        }
+
+        /**
+         * \brief  retrieves whether an element is a snap target
+         *
+         * \param  [in] store diagram
+         * \param  [in] dense dense index of the element
+         *
+         * \return *true* for visible elements other than associations
+         */
+        static bool IsSnapTarget(sdk::ElementStore const &store, uint32_t const dense) noexcept {
+            return store.kinds()[dense] != sdk::ElementKind::Association && (store.flags()[dense] & sdk::ElementHidden) == 0;
+        }
+    }
+
+
+    void SnapGuides::clear() noexcept {
+        for (std::vector<Entry> &axis : m_axes)
+            axis.clear();
+        m_boxes.clear();
+        m_known.clear();
+
+        m_size = 0;
+        m_rev  = UINT64_MAX;
+    }
+
+    void SnapGuides::sync(sdk::ElementStore const &store) {
+        if (store.revision() == m_rev)
+            return;
+
+        SZSDK_PROFILE_SCOPE("SnapGuides::sync");
+
+        std::vector<sdk::ElementRect> regions;
+        if (m_rev == UINT64_MAX || !store.changesSince(m_rev, regions) || regions.size() > gl_maxregions) {
+            rebuild(store);
+
+            return;
+        }
+
+        /* Until all regions are processed, the arrays are inconsistent; a failure rebuilds them. */
+        m_rev = UINT64_MAX;
+
+        /*
+         * A region covers the old bounds of every box changed inside of it, so the boxes to look
+         * at again are the ones found in the store there plus the known ones whose left edge lies
+         * within the region's horizontal range.
+         */
+        std::vector<sdk::ElementHandle> found;
+        std::vector<Entry> const       &xs = m_axes[0];
+        for (sdk::ElementRect const &region : regions) {
+            auto it = std::lower_bound(xs.begin(), xs.end(), region.x - gl_epsilon, [](Entry const &entry, float const pos) { return entry.pos < pos; });
+            for (; it != xs.end() && it->pos <= region.x + region.w + gl_epsilon; ++it)
+                if (it->anchor == Start && internal::Overlaps(m_boxes[it->handle.index()], region))
+                    found.push_back(it->handle);
+
+            store.query(region, found);
+        }
+
+        std::sort(found.begin(), found.end(), [](sdk::ElementHandle const a, sdk::ElementHandle const b) { return a.value() < b.value(); });
+        found.erase(std::unique(found.begin(), found.end()), found.end());
+        for (sdk::ElementHandle const handle : found) {
+            uint32_t const dense = store.indexOf(handle);
+            size_t const   idx   = handle.index();
+            bool const     known = idx < m_known.size() && m_known[idx] == handle;
+
+            if (dense != sdk::HandleTable<sdk::ElementHandle>::gl_invalid && internal::IsSnapTarget(store, dense)) {
+                sdk::ElementRect const &bounds = store.bounds()[dense];
+
+                if (!known || std::memcmp(&m_boxes[idx], &bounds, sizeof bounds) != 0)
+                    update(handle, &bounds);
+            } else if (known)
+                update(handle, nullptr);
+        }
+
+        m_rev = store.revision();
+    }
+
+    SnapResult SnapGuides::snap(sdk::ElementRect const &moving, float const tolerance, std::unordered_set<sdk::ElementHandle> const *exclude) const {
+        SnapResult res{ 0.0f, 0.0f, {} };
+
+        bool const snapx = snapAxis(0, moving, tolerance, exclude, res.dx);
+        bool const snapy = snapAxis(1, moving, tolerance, exclude, res.dy);
+
+        sdk::ElementRect const snapped = { moving.x + res.dx, moving.y + res.dy, moving.w, moving.h };
+        if (snapx)
+            addGuides(0, snapped, exclude, res.guides);
+        if (snapy)
+            addGuides(1, snapped, exclude, res.guides);
+        return res;
+    }
+
+
+    void SnapGuides::rebuild(sdk::ElementStore const &store) {
+        SZSDK_PROFILE_SCOPE("SnapGuides::rebuild");
+
+        clear();
+
+        uint32_t const n = store.size();
+        for (std::vector<Entry> &axis : m_axes)
+            axis.reserve(static_cast<size_t>(n) * __NumAnchors__);
+
+        for (uint32_t dense = 0; dense < n; ++dense) {
+            if (!internal::IsSnapTarget(store, dense))
+                continue;
+
+            sdk::ElementHandle const handle = store.handleAt(dense);
+            sdk::ElementRect const  &bounds = store.bounds()[dense];
+            size_t const             idx    = handle.index();
+            if (idx >= m_known.size()) {
+                m_known.resize(idx + 1, sdk::gl_nullelement);
+                m_boxes.resize(idx + 1);
+            }
+            m_known[idx] = handle;
+            m_boxes[idx] = bounds;
+
+            for (size_t axis = 0; axis < m_axes.size(); ++axis) {
+                std::array<float, __NumAnchors__> const pos = internal::AnchorsOf(bounds, axis);
+
+                for (uint32_t anchor = 0; anchor < __NumAnchors__; ++anchor)
+                    m_axes[axis].push_back({ pos[anchor], static_cast<Anchor>(anchor), handle });
+            }
+            ++m_size;
+        }
+
+        for (std::vector<Entry> &axis : m_axes)
+            std::sort(axis.begin(), axis.end(), [](Entry const &a, Entry const &b) { return a.pos < b.pos; });
+        m_rev = store.revision();
+    }
+
+    void SnapGuides::update(sdk::ElementHandle const handle, sdk::ElementRect const *const bounds) {
+        size_t const idx = handle.index();
+
+        /* Whatever box is known under the handle's index, possibly of a destroyed element, goes. */
+        if (idx < m_known.size() && !m_known[idx].isNull()) {
+            sdk::ElementHandle const old = m_known[idx];
+
+            for (size_t axis = 0; axis < m_axes.size(); ++axis) {
+                std::vector<Entry>                     &entries = m_axes[axis];
+                std::array<float, __NumAnchors__> const pos     = internal::AnchorsOf(m_boxes[idx], axis);
+
+                for (float const at : pos) {
+                    auto it = std::lower_bound(entries.begin(), entries.end(), at, [](Entry const &entry, float const p) { return entry.pos < p; });
+                    while (it != entries.end() && it->pos == at && it->handle != old)
+                        ++it;
+                    if (it != entries.end() && it->pos == at)
+                        entries.erase(it);
+                }
+            }
+
+            m_known[idx] = sdk::gl_nullelement;
+            --m_size;
+        }
+        if (bounds == nullptr)
+            return;
+
+        if (idx >= m_known.size()) {
+            m_known.resize(idx + 1, sdk::gl_nullelement);
+            m_boxes.resize(idx + 1);
+        }
+        for (size_t axis = 0; axis < m_axes.size(); ++axis) {
+            std::vector<Entry>                     &entries = m_axes[axis];
+            std::array<float, __NumAnchors__> const pos     = internal::AnchorsOf(*bounds, axis);
+
+            for (uint32_t anchor = 0; anchor < __NumAnchors__; ++anchor) {
+                auto const it = std::upper_bound(entries.begin(), entries.end(), pos[anchor], [](float const p, Entry const &entry) { return p < entry.pos; });
+
+                entries.insert(it, { pos[anchor], static_cast<Anchor>(anchor), handle });
+            }
+        }
+
+        m_known[idx] = handle;
+        m_boxes[idx] = *bounds;
+        ++m_size;
+    }
+
+
+    bool SnapGuides::snapAxis(size_t const axis, sdk::ElementRect const &moving, float const tolerance, std::unordered_set<sdk::ElementHandle> const *exclude, float &offset) const {
+        std::vector<Entry> const &entries = m_axes[axis];
+        bool                      found   = false;
+
+        offset = 0.0f;
+        for (float const at : internal::AnchorsOf(moving, axis)) {
+            auto it = std::lower_bound(entries.begin(), entries.end(), at - tolerance, [](Entry const &entry, float const p) { return entry.pos < p; });
+
+            for (; it != entries.end() && it->pos <= at + tolerance; ++it) {
+                if (exclude != nullptr && exclude->count(it->handle) != 0)
+                    continue;
+
+                float const delta = it->pos - at;
+                if (!found || std::fabs(delta) < std::fabs(offset)) {
+                    offset = delta;
+                    found  = true;
+                }
+            }
+        }
+
+        return found;
+    }
+
+    void SnapGuides::addGuides(size_t const axis, sdk::ElementRect const &snapped, std::unordered_set<sdk::ElementHandle> const *exclude, std::vector<AlignmentGuide> &res) const {
+        std::vector<Entry> const &entries = m_axes[axis];
+        size_t const              first   = res.size();
+
+        /* A guide runs along the other axis, across the dragged bounds and all boxes aligned there. */
+        float const from = axis == 0 ? snapped.y : snapped.x;
+        float const to   = from + (axis == 0 ? snapped.h : snapped.w);
+        for (float const at : internal::AnchorsOf(snapped, axis)) {
+            AlignmentGuide guide{ axis == 0, at, from, to };
+            bool           aligned = false;
+
+            auto it = std::lower_bound(entries.begin(), entries.end(), at - gl_epsilon, [](Entry const &entry, float const p) { return entry.pos < p; });
+            for (; it != entries.end() && it->pos <= at + gl_epsilon; ++it) {
+                if (exclude != nullptr && exclude->count(it->handle) != 0)
+                    continue;
+
+                sdk::ElementRect const &box = m_boxes[it->handle.index()];
+                guide.from = std::min(guide.from, axis == 0 ? box.y : box.x);
+                guide.to   = std::max(guide.to, axis == 0 ? box.y + box.h : box.x + box.w);
+                aligned    = true;
+            }
+
+            /* Anchors of empty bounds coincide; they share one guide. */
+            bool const duplicate = res.size() > first && std::fabs(res.back().position - at) <= gl_epsilon;
+            if (aligned && !duplicate)
+                res.push_back(guide);
+        }
+    }
+}
+
+
@@ -0,0 +1,265 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  imagecache.cpp
+ * \brief implementation of the cache of images embedded in diagrams
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cmath>
+
+/* external includes */
+#include <QBuffer>
+#include <QImageReader>
+#include <QMetaObject>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+
+/* app includes */
+#include <budget.hpp>
+#include <imagecache.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \brief  decodes a level of an image; may run on any thread
+         *
+         * Image readers decode straight to the size of the level where the format supports it,
+         * e.g. JPEG; others decode the full image and scale it down.
+         *
+         * \param  [in] encoded encoded image
+         * \param  [in] pixels size the image is shown at, in device pixels
+         * \param  [in,out] level level to decode; if not less than *gl_levels*, receives the level
+         *                  *pixels* needs
+         * \param  [out] size receives the full size of the image
+         *
+         * \return decoded level; null if the image could not be decoded
+         */
+        static QImage DecodeLevel(QByteArray const &encoded, QSize const &pixels, uint32_t &level, QSize &size) {
+            QBuffer buffer;
+            buffer.setData(encoded);
+            if (!buffer.open(QIODevice::ReadOnly))
+                return QImage();
+
+            QImageReader reader(&buffer);
+            size = reader.size();
+            if (!size.isValid() || size.isEmpty()) {
+                /* Without a size in the header, the image is decoded first and scaled down afterwards. */
+                QImage const full = reader.read();
+                size  = full.size();
+                level = level < ImageCache::gl_levels ? level : ImageCache::LevelOf(size, pixels);
+
+                QSize const target = ImageCache::LevelSize(size, level);
+                return full.isNull() || target == size ? full : full.scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            }
+
+            level = level < ImageCache::gl_levels ? level : ImageCache::LevelOf(size, pixels);
+            QSize const target = ImageCache::LevelSize(size, level);
+            if (target != size)
+                reader.setScaledSize(target);
+
+            return reader.read();
+        }
+    }
+
+
+    ImageCache::ImageCache(QObject *parent) noexcept
+        : QObject(parent), m_bytes(0), m_gen(0), m_budget(0)
+    {
+        try {
+            m_budget = MemoryBudget::Shared().add({
+                "images", gl_cost,
+                [this]() { return m_bytes; },
+                [this]() {
+                    uint64_t const key = coldest();
+
+                    return key == UINT64_MAX ? int64_t(-1) : MemoryBudget::Now() - m_entries[key >> 32].used[key & 0xFFFFFFFF];
+                },
+                [this]() {
+                    uint64_t const key = coldest();
+                    if (key == UINT64_MAX)
+                        return size_t(0);
+
+                    QImage      &level = m_entries[key >> 32].levels[key & 0xFFFFFFFF];
+                    size_t const bytes = static_cast<size_t>(level.sizeInBytes());
+                    level    = QImage();
+                    m_bytes -= bytes;
+                    return bytes;
+                }
+            });
+        } catch (...) { }
+    }
+
+    ImageCache::~ImageCache() {
+        MemoryBudget::Shared().remove(m_budget);
+
+        /* Tasks refer to the cache; results posted meanwhile are discarded along with it. */
+        for (auto const &[key, task] : m_pending)
+            task.cancel();
+        for (auto const &[key, task] : m_pending)
+            task.wait();
+    }
+
+
+    ImageCache::SourceFn ImageCache::ChunkSource(sdk::ProjectReader const &reader, std::string name) {
+        return [&reader, name = std::move(name)]() {
+            std::vector<char>                   buffer;
+            sdk::Result<std::string_view> const chunk = reader.chunk(gl_chunkimage, name, buffer);
+
+            return chunk ? QByteArray(chunk->data(), static_cast<qsizetype>(chunk->size())) : QByteArray();
+        };
+    }
+
+    uint32_t ImageCache::add(SourceFn source) noexcept {
+        try {
+            Entry entry;
+            entry.source = std::move(source);
+            entry.broken = false;
+            std::fill(std::begin(entry.used), std::end(entry.used), int64_t(0));
+
+            m_entries.push_back(std::move(entry));
+            return static_cast<uint32_t>(m_entries.size() - 1);
+        } catch (...) { }
+
+        return UINT32_MAX;
+    }
+
+    void ImageCache::clear() noexcept {
+        /* Running tasks read through the sources, e.g. from the project about to be closed, and post to the cache. */
+        for (auto const &[key, task] : m_pending)
+            task.cancel();
+        for (auto const &[key, task] : m_pending)
+            task.wait();
+        m_pending.clear();
+        ++m_gen;
+
+        m_entries.clear();
+        m_bytes = 0;
+    }
+
+    QImage const *ImageCache::find(uint32_t id, QSize const &pixels) noexcept {
+        if (id >= m_entries.size() || m_entries[id].broken)
+            return nullptr;
+
+        Entry &entry = m_entries[id];
+        if (!entry.size.isValid()) {
+            request(id, gl_probe, pixels);
+
+            return nullptr;
+        }
+
+        uint32_t const level = LevelOf(entry.size, pixels);
+        int64_t const  now   = MemoryBudget::Now();
+        if (!entry.levels[level].isNull()) {
+            entry.used[level] = now;
+
+            return &entry.levels[level];
+        }
+        request(id, level, pixels);
+
+        /* Until the level is ready, the nearest cached one stands in, finer before coarser. */
+        for (uint32_t d = 1; d < gl_levels; ++d)
+            for (uint32_t const l : { level - d, level + d })
+                if (l < gl_levels && !entry.levels[l].isNull()) {
+                    entry.used[l] = now;
+
+                    return &entry.levels[l];
+                }
+
+        return nullptr;
+    }
+
+    uint32_t ImageCache::LevelOf(QSize const &size, QSize const &pixels) noexcept {
+        double const ratio = std::min(
+            static_cast<double>(size.width()) / std::max(1, pixels.width()),
+            static_cast<double>(size.height()) / std::max(1, pixels.height())
+        );
+        if (!(ratio >= 2.0))
+            return 0;
+
+        return std::min(gl_levels - 1, static_cast<uint32_t>(std::floor(std::log2(ratio))));
+    }
+
+    QSize ImageCache::LevelSize(QSize const &size, uint32_t level) noexcept {
+        int const scale = 1 << level;
+
+        return QSize(std::max(1, (size.width() + scale - 1) / scale), std::max(1, (size.height() + scale - 1) / scale));
+    }
+
+
+    void ImageCache::request(uint32_t id, uint32_t level, QSize const &pixels) noexcept {
+        uint64_t const key = static_cast<uint64_t>(id) << 32 | level;
+        if (m_pending.find(key) != m_pending.end())
+            return;
+
+        try {
+            /* The encoded bytes are only held while decoding; the source retrieves them again for every level, off the GUI thread. */
+            sdk::TaskHandle task = sdk::SubmitTask([this, id, level, pixels, gen = m_gen, source = m_entries[id].source]() {
+                if (sdk::IsTaskCancelled())
+                    return;
+
+                QByteArray const encoded = source ? source() : QByteArray();
+                uint32_t         decoded = level;
+                QSize            size;
+                QImage           image   = encoded.isEmpty() ? QImage() : internal::DecodeLevel(encoded, pixels, decoded, size);
+                QMetaObject::invokeMethod(this, [this, id, level, decoded, gen, size, image = std::move(image)]() mutable {
+                    deliver(id, level, decoded, gen, size, std::move(image));
+                }, Qt::QueuedConnection);
+            }, sdk::TaskPriority::Low);
+            if (task.isValid())
+                m_pending.emplace(key, std::move(task));
+        } catch (...) { }
+    }
+
+    void ImageCache::deliver(uint32_t id, uint32_t requested, uint32_t level, uint64_t gen, QSize size, QImage image) noexcept {
+        if (gen != m_gen)
+            return;
+
+        m_pending.erase(static_cast<uint64_t>(id) << 32 | requested);
+        if (id >= m_entries.size())
+            return;
+
+        Entry &entry = m_entries[id];
+        if (image.isNull() || level >= gl_levels) {
+            SZSDK_APP_WARNING("Could not read or decode embedded image {}.", id);
+
+            entry.broken = true;
+            return;
+        }
+
+        m_bytes            += static_cast<size_t>(image.sizeInBytes()) - static_cast<size_t>(entry.levels[level].sizeInBytes());
+        entry.size          = size;
+        entry.levels[level] = std::move(image);
+        entry.used[level]   = MemoryBudget::Now();
+        if (m_ready)
+            m_ready(id);
+
+        MemoryBudget::Shared().enforce();
+    }
+
+    uint64_t ImageCache::coldest() const noexcept {
+        uint64_t res  = UINT64_MAX;
+        int64_t  best = 0;
+        for (size_t i = 0; i < m_entries.size(); ++i)
+            for (uint32_t l = 0; l < gl_levels; ++l)
+                if (!m_entries[i].levels[l].isNull() && (res == UINT64_MAX || m_entries[i].used[l] < best)) {
+                    res  = static_cast<uint64_t>(i) << 32 | l;
+                    best = m_entries[i].used[l];
+                }
+
+        return res;
+    }
+}
+
+
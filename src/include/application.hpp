@@ -15,11 +15,30 @@
 
 #pragma once
 
+/* stdlib includes */
+#include <functional>
+#include <memory>
+
 /* external includes */
-#include <QApplication>
+#include <QCoreApplication>
+#include <QTimer>
 
 /* sdk includes */
 #include <sdk/config.hpp>
+#include <sdk/task.hpp>
+
+/* app includes */
+#include <batch.hpp>
+#include <deferredui.hpp>
+#include <framemonitor.hpp>
+#include <globalsettings.hpp>
+#include <instance.hpp>
+#include <jobs.hpp>
+#include <memoryview.hpp>
+#include <metrics.hpp>
+#include <plugins.hpp>
+#include <session.hpp>
+#include <watchdog.hpp>
 
 
 /**
@@ -28,6 +47,7 @@
  */
 namespace suzu {
     constexpr std::string_view gl_glcfgpath = "data/config.json"; /**< path to global config file; relative to root directory */
+    constexpr std::string_view gl_plugindir = "plugins";          /**< path to plug-in directory; relative to root directory */
 
 
     /**
@@ -36,11 +56,35 @@ namespace suzu {
      * 
      * The application class owns all of suzu's components. It behaves like a singleton and
      * cannot be instantiated more than once.
+     * 
+     * If the command-line starts with *--batch*, the application runs headless: the Qt
+     * application is a *QCoreApplication*, so no windowing system is required. The usual
+     * components are initialized, the batch job is processed, and the application exits.
+     * 
+     * Otherwise, the application listens for later launches (if key "/singleinstance" is set),
+     * which hand their command-line over to this instance instead of starting up themselves.
      */
-    class Application final : public QApplication {
+    class Application final : public QObject {
         Q_OBJECT
 
-        sdk::Configuration m_cfg; /**< global configuration */
+        int                                 m_argc;     /**< number of command-line parameters; referenced by *m_qapp* */
+        BatchJob                            m_job;      /**< batch job; only used if *m_headless* is set */
+        bool                                m_headless; /**< whether or not the application runs in batch mode */
+        std::unique_ptr<QCoreApplication>   m_qapp;     /**< Qt application; a *QApplication* unless running a batch job other than *replay* */
+        sdk::Configuration                  m_cfg;      /**< global configuration */
+        GlobalSettings                      m_settings; /**< validated contents of *m_cfg* */
+        InstanceServer                      m_instance; /**< receives command-lines of later launches */
+        std::unique_ptr<sdk::TaskScheduler> m_tasks;    /**< task scheduler shared with all plug-ins */
+        std::unique_ptr<JobManager>         m_jobs;     /**< background jobs; run on *m_tasks* */
+        PluginManager                       m_plugins;  /**< installed plug-ins; loaded on first use */
+        std::unique_ptr<FrameMonitor>       m_frames;   /**< frame-time and input-latency display; *nullptr* if headless */
+        std::unique_ptr<StallWatchdog>      m_watchdog; /**< reports stalls of the event loop; *nullptr* unless running */
+        std::unique_ptr<MetricsExporter>    m_metrics;  /**< exports metrics for telemetry; *nullptr* unless running */
+        std::unique_ptr<QTimer>             m_memory;   /**< writes the usage of all memory accounts to the debug log */
+        std::unique_ptr<QTimer>             m_pressure; /**< checks whether the system is low on memory and enforces the memory budget */
+        Session                             m_session;  /**< open and recently used projects; saved on shutdown */
+        std::unique_ptr<PrefetchedProject>  m_prefetch; /**< last project of the previous session, opened ahead of the main window; *nullptr* if none */
+        std::unique_ptr<FirstFrameGate>     m_gate;     /**< holds back work until the first frame; *nullptr* if headless */
 
     public:
         explicit Application() noexcept = delete;
@@ -55,6 +99,40 @@ namespace suzu {
         explicit Application(int argc, char **argv);
         ~Application();
 
+        /**
+         * \brief  retrieves whether or not the application runs in headless batch mode
+         * 
+         * \return *true* if no GUI is available
+         */
+        bool isHeadless() const noexcept { return m_headless; }
+
+        /**
+         * \brief  retrieves the session that is saved on shutdown
+         * 
+         * \return reference to the session
+         */
+        Session &session() noexcept { return m_session; }
+        /**
+         * \brief  retrieves the manager running background jobs, e.g. imports
+         * 
+         * \return job manager, or *nullptr* before initialization
+         */
+        JobManager *jobs() noexcept { return m_jobs.get(); }
+        /**
+         * \brief  takes the project of the previous session that was opened during startup
+         * 
+         * \return prefetched project, or *nullptr* if there is none or it was taken already
+         */
+        std::unique_ptr<PrefetchedProject> takePrefetchedProject() noexcept { return std::move(m_prefetch); }
+        /**
+         * \brief defers work the first frame does not need, e.g. building hidden panels, until
+         *        after the first frame (see *suzu::FirstFrameGate*)
+         * 
+         * \param [in] fn function to run on the main thread; run right away if headless
+         * \throw std::bad_alloc
+         */
+        void afterFirstFrame(std::function<void()> fn);
+
         /**
          * \brief  initializes the application's main components
          * 
@@ -68,6 +146,9 @@ namespace suzu {
         /**
          * \brief  starts the main-loop and runs the application
          * 
+         * In batch mode, the batch job is run from within the main-loop, which exits as soon as
+         * the job has finished.
+         * 
          * \return error code to be returned to host OS
          */
         int run();
@@ -0,0 +1,144 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  autosave.hpp
+ * \brief definition of the background autosave service
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* external includes */
+#include <QTimer>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/task.hpp>
+
+/* app includes */
+#include <projectsaver.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::AutosaveService
+     * \brief periodically saves a copy of the open project in the background
+     *
+     * On every tick (key "/autosave/interval"), the diagrams of the project are snapshotted on the
+     * GUI thread (see *suzu::sdk::ElementStore::snapshot()*), which only copies their component
+     * arrays; mapped kinds and bounds are shared. Encoding, compressing and writing the snapshot
+     * happens in a low-priority task, so editing is never held up by it. The autosave file is a
+     * regular project file that replaces the previous one atomically, so a crash while autosaving
+     * leaves the last complete autosave behind.
+     *
+     * Ticks are skipped while nothing has changed since the last autosave, while the previous
+     * autosave is still being written, and while the project is larger than the size limit (key
+     * "/autosave/maxsize").
+     *
+     * \note  The service must only be used on the GUI thread.
+     */
+    class AutosaveService {
+    public:
+        using Source = std::function<std::vector<ProjectSaver::Diagram>()>; /**< retrieves all diagrams of the project, in order */
+
+    private:
+        static constexpr int   gl_idlepoll = 5000;                /**< interval at which a disabled service checks whether it was enabled, in milliseconds */
+        static inline uint32_t gl_interval = 60;                  /**< interval between autosaves, in seconds; 0 for never */
+        static inline uint64_t gl_maxsize  = uint64_t(256) << 20; /**< largest project that is autosaved, in bytes of diagram data; 0 for no limit */
+
+        std::string             m_path;    /**< path of the autosave file; empty while stopped */
+        Source                  m_source;  /**< retrieves the diagrams to save */
+        std::unique_ptr<QTimer> m_timer;   /**< triggers the autosaves */
+        sdk::TaskHandle         m_task;    /**< running autosave, if any */
+        uint64_t                m_saved;   /**< fingerprint of the revisions of the last autosave */
+        bool                    m_limited; /**< whether or not the size limit was reported already */
+
+    public:
+        AutosaveService() noexcept;
+        AutosaveService(AutosaveService const &) = delete;
+        AutosaveService &operator =(AutosaveService const &) = delete;
+        /**
+         * \brief stops the service, keeping the autosave file
+         */
+        ~AutosaveService();
+
+        /**
+         * \brief sets the interval between autosaves
+         *
+         * \param [in] seconds interval, in seconds; 0 to disable autosaving
+         */
+        static void SetInterval(uint32_t seconds) noexcept;
+
+        /**
+         * \brief sets the size of the largest project that is autosaved
+         *
+         * \param [in] bytes limit, in bytes of uncompressed diagram data; 0 for no limit
+         */
+        static void SetSizeLimit(uint64_t bytes) noexcept;
+
+        /**
+         * \brief  starts autosaving a project
+         *
+         * \param  [in] path path of the autosave file, e.g. the path of the project with a
+         *              different extension
+         * \param  [in] source retrieves all diagrams of the project; the stores must stay valid
+         *              until the function is called again or the service is stopped
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         *path* or *source* are empty, or *suzu::sdk::ErrorCode::CriticalResource* if the
+         *         timer could not be started
+         */
+        sdk::ErrorCode start(std::string path, Source source) noexcept;
+
+        /**
+         * \brief  autosaves the project right away, unless it has not changed
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if an autosave was started, *suzu::sdk::ErrorCode::NoOperation*
+         *         if nothing changed, the previous autosave is still running or the project exceeds
+         *         the size limit, *suzu::sdk::ErrorCode::InvalidState* if the service is not running,
+         *         or *suzu::sdk::ErrorCode::CriticalResource* if the snapshot could not be taken
+         */
+        sdk::ErrorCode trigger() noexcept;
+
+        bool isRunning() const noexcept { return !m_path.empty(); }
+        bool isSaving() const noexcept  { return !m_task.isFinished(); }
+
+        /**
+         * \brief stops autosaving, waiting for a running autosave
+         *
+         * \param [in] discard whether or not to delete the autosave file, e.g. because the project
+         *             was just saved or closed without changes
+         */
+        void stop(bool discard = false) noexcept;
+
+    private:
+        /**
+         * \brief  retrieves the time until the next tick
+         *
+         * \return interval, in milliseconds
+         */
+        static int TickInterval() noexcept;
+
+        /**
+         * \brief autosaves the project if it is due and re-arms the timer
+         */
+        void tick() noexcept;
+    };
+}
+
+
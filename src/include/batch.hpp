@@ -0,0 +1,95 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  batch.hpp
+ * \brief definition of the headless batch mode
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/config.hpp>
+
+
+namespace suzu {
+    constexpr std::string_view gl_batchflag = "--batch"; /**< command-line flag selecting the batch mode */
+
+
+    /**
+     * \struct suzu::BatchJob
+     * \brief  batch command parsed from the command-line
+     *
+     * The command-line has the form *suzu --batch <command> <file>...*.
+     */
+    struct BatchJob {
+        std::string              command; /**< name of the command to run */
+        std::vector<std::string> files;   /**< files to process */
+
+        /**
+         * \brief  parses the batch command from the given command-line
+         *
+         * \param  [in] argc number of elements in *argv*
+         * \param  [in] argv command-line parameters
+         * \param  [out] job parsed job; untouched if the function returns *false*
+         *
+         * \return *true* if the command-line requests the batch mode
+         */
+        static bool Parse(int argc, char **argv, BatchJob &job) noexcept;
+    };
+
+
+    /**
+     * \brief  processes all files of *job* and prints one result line per file
+     *
+     * Files are processed concurrently on a dedicated thread pool; the results are printed in
+     * the order in which the files were given.
+     *
+     * Supported commands:
+     *  - *validate*: checks that every file is a well-formed JSON document
+     *  - *import*: converts every JSON diagram (see *sdk/jsonimport.hpp*) or XMI document (see
+     *    *xmi.hpp*) into a project file
+     *  - *diff <old> <new>*: prints the elements added, removed and changed between two revisions of
+     *    a project file (see *sdk/merge.hpp*)
+     *  - *merge <base> <ours> <theirs> [<output>]*: merges two revisions of a project file, writing
+     *    the result to *output* or over *ours*, and prints the conflicts; suitable as a git merge
+     *    driver (*driver = suzu --batch merge %O %A %B*) or merge tool (*cmd = suzu --batch merge
+     *    "$BASE" "$LOCAL" "$REMOTE" "$MERGED"* with *trustExitCode = true*)
+     *  - *simulate <machine> <script>...*: runs every script of events and expectations against a
+     *    state machine and prints the events simulated per second (see *sdk/statemachine.hpp*)
+     *  - *reverse <output> <source>...*: builds a class diagram from C++ sources and directories,
+     *    rescanning only the files changed since the last run (see *sdk/reverse.hpp*)
+     *  - *query <project> <query>...*: prints the elements of all diagrams matching a query, e.g.
+     *    *kind = class and in "Model" and children > 20* (see *sdk/query.hpp*)
+     *  - *publish <project> <output>*: exports all diagrams as a single PlantUML (*.puml*) or
+     *    Mermaid Markdown (*.md*) file for a wiki (see *textexport.hpp*)
+     *  - *replay [--render] [--paced] <recording>...*: replays editing sessions recorded by
+     *    *suzu::SessionRecorder* into an offscreen view and prints the latency distribution of
+     *    every kind of event, and of frames with *--render* (see *replay.hpp*)
+     *
+     * \param  [in] job batch job to run
+     * \param  [in] cfg global configuration; shared read-only by all workers
+     * \param  [in] nthreads maximum number of worker threads; 0 uses one thread per core
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* if all files were processed successfully,
+     *         *suzu::sdk::ErrorCode::InvalidParameter* if the command is unknown or no files were
+     *         given, *suzu::sdk::ErrorCode::ReadFile* if at least one file failed; *merge* returns
+     *         *suzu::sdk::ErrorCode::InvalidState* if it had conflicts, so that git reports them,
+     *         and *query* returns *suzu::sdk::ErrorCode::NoOperation* if nothing matched, like grep
+     */
+    sdk::ErrorCode RunBatchJob(BatchJob const &job, sdk::Configuration const &cfg, uint32_t nthreads = 0) noexcept;
+}
+
+
@@ -0,0 +1,172 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  budget.hpp
+ * \brief memory budget shared by all caches
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+namespace suzu {
+    /**
+     * \class suzu::MemoryBudget
+     * \brief caps the memory of all caches of the application together, e.g. tiles, text layouts,
+     *        thumbnails and undo histories
+     *
+     * Every cache registers as a *consumer* that reports its size and its least valuable entry.
+     * Once the total exceeds the budget (key "/memory/budget"), entries are evicted across all
+     * consumers by cost and benefit: the entry whose idle time, divided by the cost of its
+     * consumer, is the largest goes first. The cost expresses how expensive an entry is to get back,
+     * e.g. a tile is merely re-rendered, while a dropped undo entry is lost for good; an entry of a
+     * consumer with cost 8 is only evicted once it has been idle 8 times as long as an entry of a
+     * consumer with cost 1.
+     *
+     * When the operating system signals that physical memory runs low, the budget is lowered to
+     * half of what the caches use at that moment, until the pressure is over.
+     *
+     * \note  Registration is thread-safe. *enforce()* and *poll()* must only be called on the GUI
+     *        thread, as they call back into caches that are not thread-safe; consumers growing on
+     *        other threads are trimmed by the next *poll()*. The functions of a consumer must not
+     *        call back into the budget.
+     */
+    class MemoryBudget {
+    public:
+        static constexpr double gl_lowmemory    = 0.05; /**< share of physical memory available below which memory is considered low, where the system does not signal it */
+        static constexpr int    gl_pollinterval = 1000; /**< recommended interval between calls of *poll()*, in milliseconds */
+
+        using BytesFn = std::function<size_t()>;  /**< retrieves the memory used by a consumer, in bytes */
+        using IdleFn  = std::function<int64_t()>; /**< retrieves the idle time of the least recently used entry, in nanoseconds; negative if none can be evicted */
+        using EvictFn = std::function<size_t()>;  /**< evicts the least recently used entry; returns the number of bytes freed */
+
+        /**
+         * \struct suzu::MemoryBudget::Consumer
+         * \brief  a cache sharing the budget
+         */
+        struct Consumer {
+            std::string name;  /**< name of the cache, for diagnostics */
+            double      cost;  /**< relative cost of getting an evicted entry back; must be positive */
+            BytesFn     bytes; /**< reports the memory used */
+            IdleFn      idle;  /**< reports the idle time of the entry *evict* drops */
+            EvictFn     evict; /**< drops the least recently used entry */
+        };
+
+    private:
+        struct Platform;
+
+        /**
+         * \struct suzu::MemoryBudget::Slot
+         * \brief  a registered consumer
+         */
+        struct Slot {
+            uint32_t id;       /**< id returned by *add()* */
+            Consumer consumer; /**< the consumer */
+        };
+
+        mutable std::mutex m_lock;     /**< guards all other members */
+        std::vector<Slot>  m_slots;    /**< registered consumers */
+        uint32_t           m_next;     /**< id of the next consumer */
+        size_t             m_budget;   /**< memory budget of all consumers, in bytes; 0 for no limit */
+        size_t             m_cap;      /**< lowered budget while memory is low, in bytes */
+        bool               m_pressure; /**< whether or not memory is low */
+        Platform          *m_platform; /**< memory notification of the system; *nullptr* if there is none */
+
+    public:
+        /**
+         * \brief constructs a budget without limit
+         */
+        MemoryBudget() noexcept;
+        MemoryBudget(MemoryBudget const &) = delete;
+        MemoryBudget &operator =(MemoryBudget const &) = delete;
+        ~MemoryBudget();
+
+        /**
+         * \brief  retrieves the budget shared by all caches of the application
+         *
+         * \return reference to the budget
+         */
+        static MemoryBudget &Shared();
+
+        /**
+         * \brief  retrieves the clock consumers stamp the use of their entries with
+         *
+         * \return nanoseconds since the epoch of *std::chrono::steady_clock*
+         */
+        static int64_t Now() noexcept;
+
+        /**
+         * \brief  registers a consumer
+         *
+         * \param  [in] consumer the consumer; its functions must stay callable until it is removed
+         *
+         * \return id of the consumer, for *remove()*
+         * \throw  std::bad_alloc
+         */
+        uint32_t add(Consumer consumer);
+
+        /**
+         * \brief unregisters a consumer; does nothing if it is not registered
+         *
+         * \param [in] id id returned by *add()*
+         */
+        void remove(uint32_t id) noexcept;
+
+        /**
+         * \brief changes the budget and evicts entries if necessary
+         *
+         * \param [in] bytes budget, in bytes; 0 for no limit
+         */
+        void setBudget(size_t bytes) noexcept;
+        size_t budget() const noexcept;
+
+        /**
+         * \brief  retrieves the memory used by all consumers
+         *
+         * \return number of bytes
+         */
+        size_t total() const noexcept;
+
+        /**
+         * \brief evicts entries until all consumers fit into the budget
+         */
+        void enforce() noexcept;
+
+        /**
+         * \brief checks whether the system is low on memory and enforces the budget; called
+         *        periodically
+         */
+        void poll() noexcept;
+
+    private:
+        /**
+         * \brief  sums up the memory used by all consumers; the lock must be held
+         *
+         * \return number of bytes
+         */
+        size_t used() const noexcept;
+
+        /**
+         * \brief  asks the system whether it is low on physical memory
+         *
+         * \return *true* if memory is low
+         */
+        bool isMemoryLow() const noexcept;
+    };
+}
+
+
@@ -0,0 +1,281 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  bundler.hpp
+ * \brief definition of the hierarchical edge bundler
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* external includes */
+#include <QPainterPath>
+#include <QRectF>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/polyline.hpp>
+#include <sdk/spatial.hpp>
+#include <sdk/task.hpp>
+
+/* app includes */
+#include <router.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::EdgeBundler
+     * \brief bundles associations along the package hierarchy of a diagram
+     *
+     * Every edge is drawn as a B-spline whose control points are the centers of the packages on
+     * the way from its source up to the innermost package containing both end points, and down
+     * again to its target (hierarchical edge bundling). Edges between the same packages thus
+     * share their control points and are drawn as one bundle. The *strength* straightens the
+     * curves towards the line between the end points: 0 draws straight lines, 1 follows the
+     * hierarchy exactly.
+     *
+     * Each edge remembers a fingerprint of its control points and the strength. *prepare()* only
+     * requests the edges whose fingerprint changed since they were last bundled, i.e. whose end
+     * points or enclosing packages were moved or reparented; all edges requested at once form a
+     * new *layout generation*. Like with *suzu::EdgeRouter*, the curves are computed from the
+     * requests alone, possibly on the task scheduler, and stored by *apply()* unless the edge has
+     * been requested again meanwhile. Until then, the edge is drawn as a straight line.
+     *
+     * Bundled curves are kept in a spatial index, so *collect()* gathers the curves visible in a
+     * region into a single path that is stroked with one draw call.
+     *
+     * \note  All member functions must be called on the thread owning the store; only *Bundle()*
+     *        may be called from any thread.
+     */
+    class EdgeBundler {
+    public:
+        static constexpr float    gl_strength = 0.85f; /**< default bundling strength */
+        static constexpr uint32_t gl_samples  = 8;     /**< points computed per span of a curve */
+        static constexpr uint32_t gl_maxdepth = 64;    /**< maximum number of enclosing packages followed */
+
+        /**
+         * \struct suzu::EdgeBundler::Request
+         * \brief  snapshot of everything needed to bundle an edge
+         */
+        struct Request {
+            sdk::ElementHandle      edge;       /**< edge to bundle */
+            uint64_t                generation; /**< layout generation the snapshot belongs to */
+            float                   strength;   /**< bundling strength */
+            std::vector<RoutePoint> controls;   /**< control points, from source to target */
+        };
+
+        /**
+         * \struct suzu::EdgeBundler::Result
+         * \brief  computed curve of an edge
+         */
+        struct Result {
+            sdk::ElementHandle      edge;       /**< bundled edge */
+            uint64_t                generation; /**< generation of the request */
+            std::vector<RoutePoint> points;     /**< curve from source to target, as a polyline */
+        };
+
+    private:
+        /**
+         * \struct suzu::EdgeBundler::Edge
+         * \brief  state of a connected edge
+         */
+        struct Edge {
+            sdk::ElementHandle      source;     /**< source element */
+            sdk::ElementHandle      target;     /**< target element */
+            std::vector<RoutePoint> points;     /**< last computed curve; empty if none */
+            uint64_t                print;      /**< fingerprint of the control points and strength last requested */
+            uint64_t                generation; /**< generation of the last request */
+            uint64_t                bundled;    /**< generation *points* were computed in */
+            bool                    dirty;      /**< whether or not the edge has to be requested again */
+            bool                    indexed;    /**< whether or not the curve is in *m_curves* */
+        };
+
+        std::unordered_map<sdk::ElementHandle, Edge> m_edges;      /**< all connected edges */
+        std::unordered_set<sdk::ElementHandle>       m_pending;    /**< edges without an up-to-date curve */
+        sdk::SpatialIndex<sdk::ElementHandle>        m_curves;     /**< bounds of the up-to-date curves */
+        float                                        m_strength;   /**< bundling strength */
+        uint64_t                                     m_rev;        /**< revision of the store last prepared; *UINT64_MAX* if none */
+        uint64_t                                     m_generation; /**< most recent layout generation */
+        mutable sdk::SegmentArray                    m_segments;   /**< segments of the candidates of *hitTest()*, reused */
+        mutable std::vector<sdk::ElementHandle>      m_hits;       /**< candidates of *hitTest()*, by owner index, reused */
+
+    public:
+        /**
+         * \brief constructs a new bundler without edges
+         *
+         * \param [in] strength bundling strength in [0, 1]
+         */
+        explicit EdgeBundler(float strength = gl_strength) noexcept;
+
+        /**
+         * \brief  connects an edge to its end points; the edge is bundled with the next generation
+         *
+         * \param  [in] edge association element
+         * \param  [in] source source element
+         * \param  [in] target target element
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         a handle is null
+         */
+        sdk::ErrorCode connect(sdk::ElementHandle edge, sdk::ElementHandle source, sdk::ElementHandle target) noexcept;
+
+        /**
+         * \brief  forgets an edge and its curve
+         *
+         * \param  [in] edge edge to remove
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the edge is not connected
+         */
+        sdk::ErrorCode disconnect(sdk::ElementHandle edge) noexcept;
+
+        /**
+         * \brief sets the bundling strength; all edges are bundled again with the next generation
+         *
+         * \param [in] strength bundling strength, clamped to [0, 1]
+         */
+        void setStrength(float strength) noexcept;
+
+        /**
+         * \brief  retrieves the most recent layout generation
+         *
+         * \return generation; 0 if nothing has been requested yet
+         */
+        uint64_t generation() const noexcept { return m_generation; }
+
+        /**
+         * \brief  takes snapshots of all edges whose control points changed
+         *
+         * Returns immediately if neither the store nor the edges changed since the last call. Edges
+         * whose end points no longer exist lose their curve and are not requested.
+         *
+         * \param  [in] store diagram containing the edges
+         *
+         * \return one request per outdated edge, all of the same new generation
+         * \throw  std::bad_alloc
+         */
+        std::vector<Request> prepare(sdk::ElementStore const &store);
+
+        /**
+         * \brief  computes the curve of an edge from a snapshot; may be called from any thread
+         *
+         * \param  [in] req snapshot taken by *prepare()*
+         *
+         * \return curve of the edge
+         * \throw  std::bad_alloc
+         */
+        static Result Bundle(Request const &req);
+
+        /**
+         * \brief  stores a computed curve
+         *
+         * \param  [in] res curve computed by *Bundle()*
+         *
+         * \return *true* if the curve was stored, *false* if the edge was requested again or
+         *         disconnected after the snapshot was taken
+         * \throw  std::bad_alloc
+         */
+        bool apply(Result res);
+
+        /**
+         * \brief  bundles all outdated edges on the current thread
+         *
+         * \param  [in] store diagram containing the edges
+         *
+         * \return number of bundled edges
+         * \throw  std::bad_alloc
+         */
+        size_t bundleAll(sdk::ElementStore const &store);
+
+        /**
+         * \brief  bundles all outdated edges on the task scheduler
+         *
+         * The curves are computed in parallel. *deliver* is called on a worker thread with all
+         * results; it typically posts them to the owner's thread, which passes them to *apply()*.
+         *
+         * \param  [in] store diagram containing the edges
+         * \param  [in] deliver receives the results
+         *
+         * \return handle of the task; invalid if nothing is outdated or the task could not be
+         *         submitted
+         * \throw  std::bad_alloc
+         */
+        sdk::TaskHandle bundleAsync(sdk::ElementStore const &store, std::function<void(std::vector<Result>)> deliver);
+
+        /**
+         * \brief  retrieves the curve of an edge
+         *
+         * \param  [in] store diagram containing the edge
+         * \param  [in] edge connected edge
+         * \param  [out] res receives the curve; a straight line between the centers of the end
+         *         points while the edge is outdated
+         *
+         * \return *true* if *res* holds a computed curve, *false* if it holds a preview or the edge
+         *         is not connected
+         * \throw  std::bad_alloc
+         */
+        bool curve(sdk::ElementStore const &store, sdk::ElementHandle edge, std::vector<RoutePoint> &res) const;
+
+        /**
+         * \brief adds all edges intersecting a region to a path, so that they can be stroked at once
+         *
+         * Outdated edges are added as straight lines between the centers of their end points.
+         *
+         * \param [in] store diagram containing the edges
+         * \param [in] region region of the scene, in scene coordinates
+         * \param [in,out] res receives one subpath per edge
+         */
+        void collect(sdk::ElementStore const &store, QRectF const &region, QPainterPath &res) const;
+
+        /**
+         * \brief  finds the edge closest to a point, e.g. the one hovered by the cursor
+         *
+         * The spatial index of the curves yields the edges whose bounds lie within the tolerance;
+         * their segments are packed and compared with the vectorized kernels of
+         * *sdk::SegmentArray*. Outdated edges are tested as drawn by *collect()*.
+         *
+         * \param  [in] store diagram containing the edges
+         * \param  [in] x horizontal position, in scene coordinates
+         * \param  [in] y vertical position, in scene coordinates
+         * \param  [in] tolerance maximum distance, in scene units; typically a few pixels divided
+         *         by the zoom factor
+         *
+         * \return closest edge within the tolerance, or *sdk::gl_nullelement* if there is none
+         * \throw  std::bad_alloc
+         */
+        sdk::ElementHandle hitTest(sdk::ElementStore const &store, float x, float y, float tolerance) const;
+
+        /**
+         * \brief  retrieves whether or not any edge lacks an up-to-date curve
+         *
+         * \return *true* if edges wait for bundling
+         */
+        bool isDirty() const noexcept { return !m_pending.empty(); }
+
+    private:
+        /**
+         * \brief marks an edge as outdated and removes its curve from the index
+         *
+         * \param [in] handle edge
+         * \param [in] edge state of the edge
+         */
+        void markDirty(sdk::ElementHandle handle, Edge &edge);
+    };
+}
+
+
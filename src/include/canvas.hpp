@@ -0,0 +1,359 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  canvas.hpp
+ * \brief definition of the diagram canvas
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* external includes */
+#include <QImage>
+#include <QPointF>
+#include <QRectF>
+#include <QWidget>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/task.hpp>
+
+/* app includes */
+#include <clusters.hpp>
+#include <diagramview.hpp>
+#include <renderer.hpp>
+#include <prefetch.hpp>
+#include <tiles.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::DiagramCanvas
+     * \brief raster backend of the diagram view; the central widget of a diagram tab
+     *
+     * Only elements intersecting the viewport are painted. Below the zoom factors configured in
+     * *LodThresholds*, elements are drawn in simplified form. Navigation is handled by
+     * *ViewNavigator*.
+     *
+     * The diagram is rendered into tiles that are cached across repaints; panning and repainting
+     * unchanged regions only copy tiles. Before painting, the canvas collects the regions changed
+     * in the store since the last repaint and re-renders the tiles intersecting them. Owners call
+     * *update()* after modifying the store. Switching style sheets, e.g. between themes, only
+     * re-renders the tiles of elements whose resolved style differs.
+     *
+     * Tiles are rendered on the task scheduler from a snapshot of the elements they show, so the
+     * GUI thread only composites finished tiles. Until a tile is ready, its outdated contents or
+     * tiles of other zoom factors are shown in its place.
+     *
+     * Tiles are rendered in the device pixels of the screen showing the canvas and keyed by its
+     * device pixel ratio. When the window moves to a screen of another scaling, the tiles of the
+     * former one are shown scaled until the new ones are ready, and stay cached within the memory
+     * budget in case the window moves back.
+     *
+     * While the view is panned or zoomed by the wheel, *suzu::TilePrefetcher* predicts the tiles
+     * shown next; they are rendered at low priority, and requests of an abandoned motion are
+     * canceled.
+     *
+     * At low zoom factors, packages whose contents would be too small to tell apart are drawn
+     * collapsed, see *suzu::ClusterMap*; tiles then only contain the collapsed packages and the
+     * edges between them instead of all of their elements.
+     *
+     * Highlighted elements, e.g. those impacted by a change (see *suzu::sdk::DependencyGraph*),
+     * are outlined on top of the tiles, so changing the highlight renders no tiles again.
+     *
+     * While a selection is dragged, it is rendered once into a *drag layer* and left out of the
+     * tiles; moving the mouse only moves the layer, whatever the size of the selection. The store
+     * is not touched until the drop, when the owner moves all elements at once, e.g. through
+     * *suzu::UndoStack::translate()*. The layer is shown until the tiles reflect the drop.
+     */
+    class DiagramCanvas final : public QWidget, public DiagramView {
+        Q_OBJECT
+
+    public:
+        using ViewFn = std::function<void(QRectF const &)>; /**< called with the visible region after the view has moved */
+
+    private:
+        /**
+         * \struct suzu::DiagramCanvas::PendingTile
+         * \brief  tile being rendered on the task scheduler
+         */
+        struct PendingTile {
+            sdk::TaskHandle task;     /**< task rendering the tile */
+            uint64_t        ticket;   /**< identifies the request; results of older requests are discarded */
+            bool            stale;    /**< whether or not the store changed after the snapshot was taken */
+            bool            prefetch; /**< whether or not the tile was predicted rather than visible */
+        };
+
+        /**
+         * \struct suzu::DiagramCanvas::DragLayer
+         * \brief  image of the dragged elements, moved by a single offset
+         */
+        struct DragLayer {
+            QImage  image;    /**< rendered elements; null if there is no layer */
+            QRectF  bounds;   /**< region of the scene covered by the image, before the drag */
+            QPointF offset;   /**< offset of the drag, in scene units */
+            bool    settling; /**< whether or not the drag is over and the layer waits for the tiles */
+        };
+
+        sdk::ElementStore const                              *m_store;   /**< displayed diagram; not owned */
+        DiagramRenderer                                       m_render;  /**< paints the elements */
+        LodThresholds                                         m_lod;     /**< level-of-detail thresholds */
+        TileCache                                             m_tiles;   /**< rendered tiles */
+        uint64_t                                              m_seen;    /**< revision of the store the tiles reflect */
+        std::vector<sdk::ElementRect>                         m_changes; /**< regions changed since *m_seen*; reused across repaints */
+        std::unordered_map<TileKey, PendingTile, TileKeyHash> m_pending; /**< tiles being rendered */
+        sdk::RetiredTasks                                     m_retired; /**< cancelled tile tasks that may still be running */
+        uint64_t                                              m_ticket;  /**< ticket of the next request */
+        ViewNavigator                                         m_view;    /**< zoom factor and scroll position */
+        ViewFn                                                m_viewfn;  /**< receives the visible region, e.g. for the minimap */
+        ClusterMap                                            m_groups;  /**< packages collapsed at low zoom factors */
+        std::unordered_set<sdk::ElementHandle>                m_marked;  /**< highlighted elements */
+        std::unordered_set<sdk::ElementHandle>                m_dragged; /**< elements on the drag layer, left out of the tiles */
+        DragLayer                                             m_layer;   /**< dragged elements */
+        TilePrefetcher                                        m_motion;  /**< predicts the tiles shown next */
+        std::vector<TileKey>                                  m_ahead;   /**< tiles last predicted; reused */
+        double                                                m_ratio;   /**< device pixel ratio of the screen the tiles are rendered for */
+
+    public:
+        /**
+         * \brief constructs a new, empty canvas
+         *
+         * \param [in] lod level-of-detail thresholds
+         * \param [in] tilebudget maximum memory used by cached tiles, in bytes; key "/tiles/budget" holds MiB
+         * \param [in] parent (optional) parent widget
+         */
+        DiagramCanvas(LodThresholds const &lod, size_t tilebudget, QWidget *parent = nullptr) noexcept;
+        /**
+         * \brief cancels all pending tiles and waits for the tasks rendering them
+         */
+        ~DiagramCanvas() override;
+
+        QWidget *widget() noexcept override { return this; }
+        void setStore(sdk::ElementStore const *store) noexcept override;
+        void setLodThresholds(LodThresholds const &lod) noexcept override;
+        void setStyles(std::shared_ptr<StyleSheet const> styles) noexcept override;
+        ViewNavigator const &navigator() const noexcept override { return m_view; }
+        void setViewport(double zoom, QPointF const &origin) noexcept override;
+
+        /**
+         * \brief  retrieves the current zoom factor
+         *
+         * \return zoom factor; 1 is 100%
+         */
+        double zoom() const noexcept { return m_view.zoom(); }
+
+        /**
+         * \brief  maps a widget position to scene coordinates
+         *
+         * \param  [in] pos position in widget coordinates
+         *
+         * \return position in scene coordinates
+         */
+        QPointF mapToScene(QPointF const &pos) const noexcept { return m_view.mapToScene(pos); }
+
+        /**
+         * \brief  retrieves the visible region of the scene
+         *
+         * \return region in scene coordinates
+         */
+        QRectF visibleRect() const noexcept { return { m_view.origin(), QSizeF(width(), height()) / m_view.zoom() }; }
+
+        /**
+         * \brief scrolls the canvas so that a scene position is shown in its center, e.g. when the
+         *        minimap is clicked
+         *
+         * \param [in] pos position in scene coordinates
+         */
+        void centerOn(QPointF const &pos) noexcept;
+
+        /**
+         * \brief sets the function receiving the visible region whenever the view has moved
+         *
+         * \param [in] fn function; called on the GUI thread
+         */
+        void setViewHandler(ViewFn fn) noexcept { m_viewfn = std::move(fn); }
+
+        /**
+         * \brief replaces the highlighted elements, e.g. with the dependents of the selection
+         *
+         * \param [in] elements elements to outline; empty to remove the highlight
+         */
+        void setHighlight(std::vector<sdk::ElementHandle> const &elements) noexcept;
+
+        /**
+         * \brief  starts dragging elements: renders them into the drag layer and leaves them out of
+         *         the tiles
+         *
+         * \param  [in] elements selection to drag
+         *
+         * \return *true* if the drag started, *false* if there is nothing to drag or memory ran out
+         */
+        bool beginDrag(std::vector<sdk::ElementHandle> const &elements) noexcept;
+
+        /**
+         * \brief moves the dragged elements; only the drag layer is moved, the store is unchanged
+         *
+         * \param [in] offset offset from where the drag started, in scene units
+         */
+        void dragTo(QPointF const &offset) noexcept;
+
+        /**
+         * \brief  ends the drag; the owner moves the elements in the store afterwards, e.g. through
+         *         *suzu::UndoStack::translate()*, or leaves them to cancel the drag
+         *
+         * \return offset of the drag, in scene units
+         */
+        QPointF endDrag() noexcept;
+
+        /**
+         * \brief  retrieves whether or not elements are being dragged
+         *
+         * \return *true* between *beginDrag()* and *endDrag()*
+         */
+        bool isDragging() const noexcept { return !m_dragged.empty(); }
+
+    protected:
+        void paintEvent(QPaintEvent *event) override;
+        void wheelEvent(QWheelEvent *event) override;
+        void mousePressEvent(QMouseEvent *event) override;
+        void mouseMoveEvent(QMouseEvent *event) override;
+        void mouseReleaseEvent(QMouseEvent *event) override;
+        void resizeEvent(QResizeEvent *event) override;
+
+    private:
+        /**
+         * \brief reports the visible region to the view handler, if any
+         */
+        void viewChanged() noexcept;
+
+        /**
+         * \brief  paints the tiles intersecting the exposed part of the viewport and requests those
+         *         missing or outdated
+         *
+         * \param  [in] painter painter drawing the widget
+         * \param  [in] rect exposed part of the widget
+         *
+         * \return *true* if all tiles drawn were up to date
+         */
+        bool paintTiles(QPainter &painter, QRect const &rect);
+
+        /**
+         * \brief paints the drag layer at the offset of the drag, if any
+         *
+         * \param [in] painter painter drawing the widget
+         */
+        void paintDrag(QPainter &painter) const;
+
+        /**
+         * \brief outlines the highlighted elements intersecting the exposed part of the viewport
+         *
+         * \param [in] painter painter drawing the widget
+         * \param [in] rect exposed part of the widget
+         */
+        void paintHighlight(QPainter &painter, QRect const &rect) const;
+
+        /**
+         * \brief invalidates all tiles covering regions changed in the store since the last repaint
+         */
+        void syncTiles() noexcept;
+
+        /**
+         * \brief brings the collapsed packages up to date for tiles of a zoom factor, invalidating
+         *        all tiles they change
+         *
+         * \param [in] zoom zoom factor tiles are about to be rendered at
+         */
+        void syncClusters(double zoom) noexcept;
+
+        /**
+         * \brief marks all tiles intersecting a region of the scene as dirty, including pending ones
+         *
+         * \param [in] region changed region, in scene coordinates
+         */
+        void invalidate(QRectF const &region) noexcept;
+
+        /**
+         * \brief marks all tiles of zoom factors below a bound as dirty, including pending ones
+         *
+         * \param [in] zoom bound; tiles of this zoom factor and above are kept
+         */
+        void invalidateBelow(double zoom) noexcept;
+
+        /**
+         * \brief discards all tiles, including pending ones
+         */
+        void dropTiles() noexcept;
+
+        /**
+         * \brief submits a task rendering a tile at its zoom factor, unless one is pending
+         *
+         * A visible tile replaces a pending prefetch of the same tile, which was submitted at a
+         * lower priority.
+         *
+         * \param [in] key key of the tile
+         * \param [in] prefetch (optional) whether or not the tile is predicted rather than visible;
+         *        such tiles are rendered at low priority
+         */
+        void requestTile(TileKey const &key, bool prefetch = false) noexcept;
+
+        /**
+         * \brief requests the tiles predicted after the view has moved
+         *
+         * \param [in] changed whether or not the motion changed; pending prefetches no longer
+         *        predicted are canceled
+         */
+        void prefetchTiles(bool changed) noexcept;
+
+        /**
+         * \brief stores a tile rendered by a task; called on the GUI thread
+         *
+         * \param [in] key key of the tile
+         * \param [in] ticket ticket of the request
+         * \param [in] image rendered contents
+         */
+        void deliverTile(TileKey const &key, uint64_t ticket, QImage image) noexcept;
+
+        /**
+         * \brief paints cached tiles of other zoom factors in place of a missing tile
+         *
+         * \param [in] painter painter drawing the widget
+         * \param [in] key key of the missing tile
+         * \param [in] offset position of the widget's top-left corner in the scaled scene
+         */
+        void paintPlaceholder(QPainter &painter, TileKey const &key, QPointF const &offset) const;
+
+        /**
+         * \brief  computes the widget region covered by a tile of the current zoom factor
+         *
+         * \param  [in] key key of the tile
+         * \param  [in] offset position of the widget's top-left corner in the scaled scene
+         *
+         * \return region in widget coordinates
+         */
+        QRectF tileRect(TileKey const &key, QPointF const &offset) const noexcept;
+
+        /**
+         * \brief  computes the position of the widget's top-left corner in the scaled scene
+         *
+         * The position is rounded to whole pixels, so tiles are copied without resampling.
+         *
+         * \return position in device pixels
+         */
+        QPointF tileOffset() const noexcept;
+    };
+}
+
+
@@ -0,0 +1,225 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  changeset.hpp
+ * \brief definition of coalesced change notifications from the model to its views
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/* external includes */
+#include <QObject>
+
+/* sdk includes */
+#include <sdk/changes.hpp>
+#include <sdk/elements.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::ChangeSet
+     * \brief consolidated changes of one or more edits
+     *
+     * Changes are folded per element as they are added:
+     *  - changes of an element added in the same set are absorbed by its *ElementAdded* record,
+     *  - an element added and removed again in the same set does not appear at all,
+     *  - removing an element drops its earlier changes,
+     *  - every property of an element is reported once, and only its last move is kept.
+     *
+     * Views thus receive at most one record per element and property, no matter how many edits
+     * led to it. Records do not carry values; views read the current state from the model.
+     */
+    class ChangeSet {
+        /**
+         * \struct suzu::ChangeSet::Element
+         * \brief  indices of the records of a single element
+         */
+        struct Element {
+            uint32_t              added;    /**< index of the *ElementAdded* record; *gl_none* if there is none */
+            uint32_t              moved;    /**< index of the *ElementMoved* record; *gl_none* if there is none */
+            std::vector<uint32_t> modified; /**< indices of the *ElementModified* records */
+        };
+
+        static constexpr uint32_t gl_none = UINT32_MAX; /**< marks missing records */
+
+        std::vector<sdk::ChangeRecord>         m_records;  /**< consolidated records; dropped ones have kind *__NumChangeKinds__* */
+        std::unordered_map<uint64_t, Element>  m_elements; /**< records of every element, by handle */
+        uint32_t                               m_dropped;  /**< number of dropped records in *m_records* */
+        bool                                   m_all;      /**< whether or not everything is to be considered changed */
+
+    public:
+        ChangeSet() noexcept
+            : m_dropped(0), m_all(false)
+        { }
+
+        /**
+         * \brief adds a change, folding it into the changes of the same element
+         *
+         * \param [in] change change to add
+         * \throw std::bad_alloc
+         */
+        void add(sdk::ChangeRecord const &change);
+
+        /**
+         * \brief removes all changes
+         */
+        void clear() noexcept;
+
+        /**
+         * \brief exchanges the contents of two sets
+         *
+         * \param [in,out] other other set
+         */
+        void swap(ChangeSet &other) noexcept {
+            m_records.swap(other.m_records);
+            m_elements.swap(other.m_elements);
+            std::swap(m_dropped, other.m_dropped);
+            std::swap(m_all, other.m_all);
+        }
+
+        /**
+         * \brief marks the whole model as changed, e.g. because changes could not be recorded
+         */
+        void invalidate() noexcept;
+
+        /**
+         * \brief  retrieves whether or not the whole model is to be considered changed
+         *
+         * \return *true* if views have to refresh everything; *records()* is empty then
+         */
+        bool everything() const noexcept { return m_all; }
+
+        /**
+         * \brief  retrieves the consolidated changes
+         *
+         * \return changes, in the order they were first recorded
+         * \note   Call *compact()* first if changes have been dropped.
+         */
+        std::vector<sdk::ChangeRecord> const &records() const noexcept { return m_records; }
+
+        /**
+         * \brief removes the records dropped by folding, so that *records()* only holds live ones
+         */
+        void compact() noexcept;
+
+        size_t size() const noexcept  { return m_records.size() - m_dropped; }
+        bool   empty() const noexcept { return size() == 0 && !m_all; }
+
+    private:
+        /**
+         * \brief drops a record
+         *
+         * \param [in] index index of the record
+         */
+        void drop(uint32_t index) noexcept;
+    };
+
+
+    /**
+     * \class suzu::ChangeDispatcher
+     * \brief delivers consolidated model changes to views, once per event-loop turn
+     *
+     * Edits report their changes through *record()*. Instead of notifying every view about every
+     * change, the dispatcher collects the changes into a *ChangeSet* and posts a single delivery
+     * to the event loop. When it runs, each subscriber receives all changes of the turn at once.
+     * A rename touching hundreds of attributes thus costs one call per view.
+     *
+     * While a transaction is open (*begin()*, *end()*), deliveries are held back until the
+     * outermost transaction has ended, so that views never observe half an operation.
+     *
+     * \note  The dispatcher must only be used on the GUI thread.
+     */
+    class ChangeDispatcher {
+    public:
+        /**
+         * \brief receives the consolidated changes of an event-loop turn
+         */
+        using Listener = std::function<void(ChangeSet const &changes)>;
+
+    private:
+        ChangeSet                                  m_pending;   /**< undelivered changes */
+        uint32_t                                   m_depth;     /**< nesting depth of *begin()* */
+        bool                                       m_posted;    /**< whether or not a delivery is queued */
+        uint64_t                                   m_next;      /**< id of the next subscription */
+        std::vector<std::pair<uint64_t, Listener>> m_listeners; /**< subscribers, by subscription id */
+        std::unique_ptr<QObject>                   m_context;   /**< receives queued deliveries */
+
+    public:
+        ChangeDispatcher() noexcept;
+        ChangeDispatcher(ChangeDispatcher const &) = delete;
+        ChangeDispatcher &operator =(ChangeDispatcher const &) = delete;
+        /**
+         * \brief drops undelivered changes
+         */
+        ~ChangeDispatcher();
+
+        /**
+         * \brief  adds a subscriber
+         *
+         * \param  [in] listener listener, e.g. repainting a view
+         *
+         * \return subscription id; 0 if the listener could not be added
+         */
+        uint64_t subscribe(Listener listener) noexcept;
+        /**
+         * \brief removes a subscriber
+         *
+         * \param [in] id subscription id returned by *subscribe()*
+         */
+        void unsubscribe(uint64_t id) noexcept;
+
+        /**
+         * \brief starts a transaction; transactions may be nested
+         */
+        void begin() noexcept;
+        /**
+         * \brief ends a transaction started by *begin()*
+         */
+        void end() noexcept;
+
+        /**
+         * \brief  records a change of the model
+         *
+         * \param  [in] kind kind of change
+         * \param  [in] element changed element
+         * \param  [in] parent (new) parent of the element
+         * \param  [in] arg (optional) first argument, e.g. the *suzu::sdk::ChangeProperty*
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if the change could not be recorded; the views then receive a set with
+         *         *suzu::ChangeSet::everything()* set
+         */
+        sdk::ErrorCode record(sdk::ChangeKind kind, sdk::ElementHandle element, sdk::ElementHandle parent = sdk::gl_nullelement, int64_t arg = 0) noexcept;
+
+        /**
+         * \brief delivers the pending changes right away instead of on the next turn
+         *
+         * Does nothing while a transaction is open.
+         */
+        void flush() noexcept;
+
+    private:
+        /**
+         * \brief queues a delivery unless one is queued already
+         */
+        void post() noexcept;
+    };
+}
+
+
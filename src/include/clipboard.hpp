@@ -0,0 +1,173 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  clipboard.hpp
+ * \brief copying and pasting of diagram elements through the system clipboard
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <memory>
+#include <string>
+#include <vector>
+
+/* external includes */
+#include <QByteArray>
+#include <QMimeData>
+#include <QString>
+#include <QStringList>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+
+/* app includes */
+#include <undo.hpp>
+
+
+namespace suzu {
+    constexpr char const *gl_elementsmime = "application/x-suzu-elements"; /**< MIME type of copied elements in the binary format */
+    constexpr char const *gl_jsonmime     = "application/json";            /**< MIME type of copied elements as a JSON document */
+
+
+    /**
+     * \class suzu::ElementMimeData
+     * \brief clipboard contents holding a snapshot of copied elements
+     *
+     * The snapshot is an immutable store of its own, shared by reference: pasting within the same
+     * instance, e.g. into another window, reads it directly, without encoding or parsing anything.
+     * Other formats are only produced when another application asks for them, and cached: the
+     * binary format (*gl_elementsmime*) for other instances of Suzu, and a JSON document, as read by
+     * *suzu::sdk::JsonDiagramImporter*, for everything else.
+     */
+    class ElementMimeData final : public QMimeData {
+        Q_OBJECT
+
+        std::shared_ptr<sdk::ElementStore const> m_elements; /**< copied elements */
+        mutable QByteArray                       m_binary;   /**< elements in the binary format; empty until requested */
+        mutable QByteArray                       m_json;     /**< elements as a JSON document; empty until requested */
+
+    public:
+        /**
+         * \brief constructs new clipboard contents
+         *
+         * \param [in] elements copied elements, see *suzu::SnapshotElements()*
+         */
+        explicit ElementMimeData(std::shared_ptr<sdk::ElementStore const> elements) noexcept;
+
+        /**
+         * \brief  retrieves the copied elements
+         *
+         * \return snapshot; never *nullptr*
+         */
+        std::shared_ptr<sdk::ElementStore const> const &elements() const noexcept { return m_elements; }
+
+        bool hasFormat(QString const &mimetype) const override;
+        QStringList formats() const override;
+
+    protected:
+        QVariant retrieveData(QString const &mimetype, QMetaType type) const override;
+    };
+
+
+    /**
+     * \brief  copies elements into a store of their own
+     *
+     * The painting order of the elements is kept. Owners that are not copied along are dropped,
+     * and the selection state is cleared.
+     *
+     * \param  [in] store source diagram
+     * \param  [in] handles elements to copy; stale and duplicate handles are skipped
+     *
+     * \return snapshot, or *nullptr* if memory ran out
+     */
+    std::shared_ptr<sdk::ElementStore const> SnapshotElements(sdk::ElementStore const &store, std::vector<sdk::ElementHandle> const &handles) noexcept;
+
+    /**
+     * \brief  encodes elements in the binary clipboard format
+     *
+     * The format is that of a journal record (see *suzu::sdk::JournalRecord*): a header, the string
+     * table of the names, and the elements laid out like a diagram chunk. Names travel as strings,
+     * as other instances have string tables of their own.
+     *
+     * \param  [in] elements elements to encode
+     * \param  [out] out receives the encoded elements
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource* if
+     *         memory ran out
+     */
+    sdk::ErrorCode EncodeElements(sdk::ElementStore const &elements, std::vector<char> &out) noexcept;
+
+    /**
+     * \brief  decodes elements from the binary clipboard format
+     *
+     * \param  [in] data encoded elements
+     * \param  [in] size size of *data*, in bytes
+     * \param  [out] elements receives the elements; cleared first
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::ReadFile* if the data is
+     *         corrupt, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out; *elements* is
+     *         empty then
+     */
+    sdk::ErrorCode DecodeElements(char const *data, size_t size, sdk::ElementStore &elements) noexcept;
+
+    /**
+     * \brief  encodes elements as a JSON document, as read by *suzu::sdk::JsonDiagramImporter*
+     *
+     * \param  [in] elements elements to encode
+     * \param  [out] out receives the document
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource* if
+     *         memory ran out
+     */
+    sdk::ErrorCode EncodeElementsJson(sdk::ElementStore const &elements, std::string &out) noexcept;
+
+    /**
+     * \brief  puts elements onto the system clipboard
+     *
+     * \param  [in] store source diagram
+     * \param  [in] handles elements to copy
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if no
+     *         element was copied, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out
+     */
+    sdk::ErrorCode CopyElements(sdk::ElementStore const &store, std::vector<sdk::ElementHandle> const &handles) noexcept;
+
+    /**
+     * \brief  retrieves whether or not the system clipboard holds elements that can be pasted
+     *
+     * \return *true* for elements copied by any instance of Suzu, and for JSON documents
+     */
+    bool CanPasteElements() noexcept;
+
+    /**
+     * \brief  pastes the elements on the system clipboard as a single undoable operation
+     *
+     * Elements copied within this instance are read from their snapshot directly; those copied
+     * by another instance are decoded from the binary format, and JSON documents are only parsed
+     * if neither is available. Owners are created before the elements they own, and are thus
+     * painted below them.
+     *
+     * \param  [in] undo undo stack of the target diagram
+     * \param  [in] dx horizontal offset added to the pasted elements
+     * \param  [in] dy vertical offset added to the pasted elements
+     * \param  [out] pasted (optional) receives the handles of the pasted elements, e.g. to select them
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if the
+     *         clipboard holds no elements, *suzu::sdk::ErrorCode::ReadFile* if they are corrupt, or
+     *         *suzu::sdk::ErrorCode::CriticalResource* if memory ran out; elements pasted until
+     *         then are kept and can be undone
+     */
+    sdk::ErrorCode PasteElements(UndoStack &undo, float dx, float dy, std::vector<sdk::ElementHandle> *pasted = nullptr) noexcept;
+}
+
+
@@ -0,0 +1,252 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  clusters.hpp
+ * \brief definition of the semantic zoom of packages
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+/* external includes */
+#include <QRectF>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/intern.hpp>
+#include <sdk/spatial.hpp>
+
+/* app includes */
+#include <renderer.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::ClusterMap
+     * \brief semantic zoom: packages whose contents are too small to be told apart on screen are
+     *        drawn as one node, and the associations between them as one edge
+     *
+     * Every package containing at least *gl_minmembers* elements, directly or in nested packages,
+     * is a *cluster*. A cluster is *expanded* from the zoom factor at which the typical element
+     * directly inside of it is *LodThresholds::clusters* pixels large; nested clusters never expand
+     * before the clusters around them. Below that zoom factor, the cluster is *collapsed*: only
+     * its package is drawn, labeled with the number of its members. All associations between two
+     * collapsed clusters are drawn as one edge between their centers, the wider the more it stands
+     * for; associations with one end in a collapsed cluster end at its center.
+     *
+     * The expansion zoom factors divide the zoom range into *levels* in which the same clusters
+     * are collapsed. The primitives of a level, i.e. the elements outside of collapsed clusters,
+     * the collapsed clusters and the edges between them, are computed when a tile of the level is
+     * first rendered and kept in a spatial index of their own, so rendering a tile costs as much
+     * as the primitives it shows, however many elements the collapsed clusters contain.
+     *
+     * The clusters are only computed again when a zoom factor below *threshold()* is shown, or
+     * when an edit may change the threshold itself. If they turn out the same, the levels are
+     * kept, and only the elements in the regions changed since are looked up anew.
+     *
+     * \note  The map must only be used on the GUI thread.
+     */
+    class ClusterMap {
+    public:
+        static constexpr uint32_t gl_minmembers = 16;   /**< number of elements a package must contain to be a cluster */
+        static constexpr size_t   gl_maxlevels  = 4;    /**< number of levels whose primitives are kept */
+        static constexpr double   gl_legible    = 10.0; /**< default of *LodThresholds::clusters* */
+        static constexpr size_t   gl_maxpatch   = 256;  /**< number of changed regions up to which the levels are updated rather than dropped */
+
+    private:
+        static constexpr uint32_t gl_none = UINT32_MAX; /**< marks the absence of a cluster */
+
+        /**
+         * \struct suzu::ClusterMap::Cluster
+         * \brief  package large enough to be collapsed
+         */
+        struct Cluster {
+            uint32_t         element; /**< dense index of the package */
+            uint32_t         parent;  /**< innermost enclosing cluster; *gl_none* for outermost ones */
+            uint32_t         members; /**< number of elements inside, directly or nested */
+            double           expand;  /**< zoom factor from which the contents are drawn */
+            sdk::StringId    label;   /**< name of the package followed by the number of members */
+            sdk::ElementRect box;     /**< bounds of the package when the clusters were computed */
+        };
+
+        /**
+         * \struct suzu::ClusterMap::Link
+         * \brief  association with at least one end inside of a cluster
+         */
+        struct Link {
+            uint32_t element; /**< dense index of the association */
+            uint32_t from;    /**< innermost cluster containing the start; *gl_none* if outside of all */
+            uint32_t to;      /**< innermost cluster containing the end; *gl_none* if outside of all */
+        };
+
+        /**
+         * \struct suzu::ClusterMap::Primitive
+         * \brief  what is drawn in place of one or more elements at a level; elements drawn as they
+         *         are do not have one
+         */
+        struct Primitive {
+            sdk::ElementHandle element; /**< collapsed package, or the first association an edge stands for */
+            uint32_t           count;   /**< number of associations an edge between collapsed clusters stands for; 0 otherwise */
+            sdk::ElementRect   bounds;  /**< bounds as drawn, see *suzu::RenderItem::bounds* */
+            sdk::StringId      label;   /**< label of a collapsed cluster; empty for the element's own name */
+        };
+
+        /**
+         * \struct suzu::ClusterMap::Level
+         * \brief  primitives of a range of zoom factors
+         */
+        struct Level {
+            size_t                                index;      /**< index of the level, see *levelOf()* */
+            std::vector<uint32_t>                 top;        /**< outermost collapsed cluster around every cluster; *gl_none* if expanded */
+            std::vector<Primitive>                primitives; /**< collapsed clusters and the edges between them */
+            sdk::SpatialIndex<sdk::ElementHandle> spatial;    /**< bounds of the primitives, by index */
+            sdk::SpatialIndex<sdk::ElementHandle> plain;      /**< bounds of the elements drawn as they are, by handle */
+        };
+
+        std::vector<Cluster>                m_clusters; /**< clusters, enclosing ones first */
+        std::vector<Link>                   m_links;    /**< associations ending inside of clusters, in dense order */
+        std::vector<uint32_t>               m_owner;    /**< innermost cluster containing every element, by dense index; *gl_none* if outside of all */
+        std::vector<uint32_t>               m_self;     /**< cluster of every package, by dense index; *gl_none* for other elements */
+        std::vector<double>                 m_levels;   /**< distinct expansion zoom factors, ascending */
+        std::vector<std::unique_ptr<Level>> m_cache;    /**< primitives of recently used levels, most recent first */
+        double                              m_legible;  /**< see *LodThresholds::clusters* */
+        uint64_t                            m_rev;      /**< revision of the store the clusters reflect; *UINT64_MAX* if none */
+        uint64_t                            m_print;    /**< fingerprint of the clusters and the associations ending inside of them */
+        uint32_t                            m_size;     /**< number of elements in the store at revision *m_rev* */
+        sdk::ElementHandle                  m_last;     /**< top-most element at revision *m_rev*, which new elements are created above */
+        std::vector<sdk::ElementRect>       m_changes;  /**< regions changed since *m_rev*; reused across calls to *sync()* */
+
+    public:
+        /**
+         * \brief constructs a new, empty map
+         */
+        ClusterMap() noexcept;
+
+        /**
+         * \brief sets the size from which the contents of packages are drawn; the clusters are
+         *        computed again by the next call to *sync()*
+         *
+         * \param [in] pixels size of the typical element inside of a package, in pixels; 0 to
+         *                    never collapse packages
+         */
+        void setLegible(double pixels) noexcept;
+
+        /**
+         * \brief forgets all clusters, e.g. when another diagram is shown; they are computed again
+         *        by the next call to *sync()*
+         */
+        void clear() noexcept;
+
+        /**
+         * \brief  computes the clusters again if the store changed since they were last computed
+         *         and tiles of a zoom factor are about to be rendered
+         *
+         * As long as no cluster would be collapsed at *zoom*, edits that neither add nor remove
+         * elements and stay clear of all clusters are left for a later call.
+         *
+         * \param  [in] store shown diagram
+         * \param  [in] zoom smallest zoom factor tiles are about to be rendered at
+         *
+         * \return zoom factor below which tiles have to be rendered again because clusters or the
+         *         associations between them changed; 0 if none
+         */
+        double sync(sdk::ElementStore const &store, double zoom) noexcept;
+
+        /**
+         * \brief  retrieves the zoom factor from which no cluster is collapsed
+         *
+         * \return zoom factor; 0 if there are no clusters
+         */
+        double threshold() const noexcept { return m_levels.empty() ? 0.0 : m_levels.back(); }
+
+        /**
+         * \brief  retrieves the number of clusters
+         *
+         * \return number of packages that can be collapsed
+         */
+        size_t size() const noexcept { return m_clusters.size(); }
+
+        /**
+         * \brief takes a snapshot of what is drawn in a region of the scene at a zoom factor
+         *
+         * From *threshold()* on, this is the same as *DiagramRenderer::collect()*.
+         *
+         * \param [in] store shown diagram; the map must be in sync with it for *zoom*
+         * \param [in] render renderer resolving the styles of the elements
+         * \param [in] zoom zoom factor
+         * \param [in] region region of the scene, in scene coordinates
+         * \param [out] res receives the primitives, bottom-most first; existing contents are kept
+         * \param [in] skip (optional) elements to leave out, e.g. those being dragged; collapsed
+         *        packages are drawn whole
+         * \throw std::bad_alloc
+         */
+        void collect(sdk::ElementStore const &store, DiagramRenderer const &render, double zoom, QRectF const &region, std::vector<RenderItem> &res, std::unordered_set<sdk::ElementHandle> const *skip = nullptr);
+
+    private:
+        /**
+         * \brief computes the clusters and the associations between them
+         *
+         * \param [in] store shown diagram
+         * \throw std::bad_alloc
+         */
+        void build(sdk::ElementStore const &store);
+
+        /**
+         * \brief  retrieves the primitives of the level of a zoom factor, computing them if needed
+         *
+         * \param  [in] store shown diagram
+         * \param  [in] zoom zoom factor; less than *threshold()*
+         *
+         * \return primitives
+         * \throw  std::bad_alloc
+         */
+        Level const &levelOf(sdk::ElementStore const &store, double zoom);
+
+        /**
+         * \brief  checks whether or not an element is drawn as it is at a level
+         *
+         * \param  [in] store shown diagram
+         * \param  [in] level level; its *top* must be set
+         * \param  [in] dense dense index of the element
+         *
+         * \return *true* if the element is neither hidden, nor inside of a collapsed cluster, nor
+         *         drawn by a primitive
+         */
+        bool isPlain(sdk::ElementStore const &store, Level const &level, uint32_t dense) const noexcept;
+
+        /**
+         * \brief updates the elements drawn as they are at a level after the store changed
+         *
+         * \param [in] store shown diagram; the clusters must be the same as when the level was
+         *                  computed
+         * \param [in,out] level level
+         * \param [in] changes regions changed since the level reflects the store
+         * \throw std::bad_alloc
+         */
+        void patch(sdk::ElementStore const &store, Level &level, std::vector<sdk::ElementRect> const &changes) const;
+
+        /**
+         * \brief computes the primitives of a level
+         *
+         * \param [in] store shown diagram
+         * \param [in,out] level level; receives the primitives
+         * \throw std::bad_alloc
+         */
+        void fill(sdk::ElementStore const &store, Level &level) const;
+    };
+}
+
+
@@ -0,0 +1,311 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  collab.hpp
+ * \brief definition of real-time collaborative editing of a diagram
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* external includes */
+#include <QByteArray>
+#include <QHostAddress>
+#include <QObject>
+#include <QString>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+/* sdk includes */
+#include <sdk/crdt.hpp>
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+
+/* app includes */
+#include <changeset.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::CollabSession
+     * \brief keeps a diagram in sync with the same diagram edited by others
+     *
+     * One editor hosts the session (*host()*), the others join it over TCP (*join()*); every editor
+     * is a site of a replicated diagram (see *suzu::sdk::crdt*). Joining replaces the contents of
+     * the joining editor's diagram with those of the session.
+     *
+     * Local edits are picked up from the consolidated changes of the model, so every tool and
+     * command takes part without knowing about the session. Changed elements are collected and
+     * compared against the replicated state once per frame (*gl_frameinterval*); only properties
+     * that actually differ become operations, so dragging an element across the canvas sends one
+     * operation per frame, not one per mouse move. All operations of a frame are encoded into a
+     * single message per connection. The host applies the operations it receives and relays them to
+     * all other editors in its next frame, so every editor needs a single connection only, and
+     * remote edits are never echoed back.
+     *
+     * Remote edits are applied to the store in a transaction and reported through the change
+     * dispatcher like local ones. They bypass the undo stack, so undo only reverts one's own edits.
+     *
+     * \note  The stacking order of elements is not replicated; each editor keeps its own.
+     * \note  The session must only be used on the GUI thread.
+     */
+    class CollabSession final : public QObject {
+    public:
+        using StateFn = std::function<void()>; /**< called whenever the session starts or ends, or editors join or leave */
+
+        static constexpr int      gl_frameinterval = 16;       /**< time, in milliseconds, local edits are collected before they are sent */
+        static constexpr uint64_t gl_maxmessage    = 64 << 20; /**< largest message accepted, in bytes; larger ones drop the connection */
+
+    private:
+        /**
+         * \enum  suzu::CollabSession::MessageType
+         * \brief first byte of every message
+         */
+        enum MessageType : uint8_t {
+            MessageOperations = 0, /**< frame of encoded operations */
+            MessageWelcome         /**< site assigned to a joining editor, followed by operations rebuilding the diagram */
+        };
+
+        /**
+         * \struct suzu::CollabSession::Link
+         * \brief  connection to another editor
+         */
+        struct Link {
+            QTcpSocket         *sock;     /**< connection; owned by the link */
+            sdk::crdt::Encoder  out;      /**< encodes the operations sent */
+            sdk::crdt::Decoder  in;       /**< decodes the operations received */
+            QByteArray          received; /**< received bytes not yet forming a complete message */
+        };
+
+        sdk::ElementStore                                            &m_store;    /**< shared diagram */
+        ChangeDispatcher                                             &m_changes;  /**< reports remote edits; delivers local ones */
+        uint64_t                                                      m_listener; /**< subscription to *m_changes* */
+        std::unique_ptr<QTcpServer>                                   m_server;   /**< accepts editors; only while hosting */
+        std::vector<std::unique_ptr<Link>>                            m_links;    /**< connections; the host, when joined */
+        std::unique_ptr<QTimer>                                       m_frame;    /**< ends the current frame */
+        sdk::crdt::Replica                                            m_replica;  /**< replicated state of the diagram */
+        std::unordered_map<uint64_t, sdk::ElementHandle>              m_handles;  /**< local element of every replicated one, by *ElementId::key()* */
+        std::unordered_map<sdk::ElementHandle, sdk::crdt::ElementId>  m_ids;      /**< replicated element of every local one */
+        std::unordered_set<sdk::ElementHandle>                        m_dirty;    /**< local elements changed since the last frame */
+        bool                                                          m_all;      /**< whether or not all local elements are to be compared */
+        bool                                                          m_joined;   /**< whether or not the session was joined, as opposed to hosted */
+        uint32_t                                                      m_nextsite; /**< site assigned to the next editor joining; only while hosting */
+        StateFn                                                       m_state;    /**< receives changes of the session state */
+
+    public:
+        /**
+         * \brief constructs a new, inactive session
+         *
+         * \param [in] store shared diagram; must outlive the session
+         * \param [in] changes dispatcher of the changes of *store*; must outlive the session
+         * \param [in] parent (optional) parent object
+         */
+        CollabSession(sdk::ElementStore &store, ChangeDispatcher &changes, QObject *parent = nullptr) noexcept;
+        CollabSession(CollabSession const &) = delete;
+        CollabSession &operator =(CollabSession const &) = delete;
+        /**
+         * \brief leaves the session, if any
+         */
+        ~CollabSession();
+
+        /**
+         * \brief  starts hosting a session with the current contents of the diagram
+         *
+         * \param  [in] port TCP port to listen on
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if a
+         *         session is active already, or *suzu::sdk::ErrorCode::CriticalResource* if the
+         *         port could not be bound
+         */
+        sdk::ErrorCode host(uint16_t port) noexcept;
+
+        /**
+         * \brief  joins a session; the diagram is replaced once the host has answered
+         *
+         * \param  [in] address host name or address of the host
+         * \param  [in] port TCP port of the host
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if connecting has started, *suzu::sdk::ErrorCode::InvalidState*
+         *         if a session is active already, or *suzu::sdk::ErrorCode::CriticalResource* if
+         *         memory ran out
+         */
+        sdk::ErrorCode join(QString const &address, uint16_t port) noexcept;
+
+        /**
+         * \brief leaves or ends the session; the diagram keeps its contents
+         *
+         * Edits of the last frame are sent before.
+         */
+        void stop() noexcept;
+
+        /**
+         * \brief  retrieves whether or not a session is active
+         *
+         * \return *true* while hosting, or while joined or joining
+         */
+        bool isActive() const noexcept { return m_server != nullptr || m_joined; }
+
+        /**
+         * \brief  retrieves the number of connected editors
+         *
+         * \return number of editors that joined when hosting; 1 when joined, for the host
+         */
+        size_t peers() const noexcept { return m_links.size(); }
+
+        /**
+         * \brief sets the function receiving changes of the session state, e.g. to update the status bar
+         *
+         * \param [in] fn function; called on the GUI thread
+         */
+        void setStateHandler(StateFn fn) noexcept { m_state = std::move(fn); }
+
+    private:
+        /**
+         * \brief collects the local elements changed by an event-loop turn
+         *
+         * \param [in] changes consolidated changes
+         */
+        void changed(ChangeSet const &changes) noexcept;
+
+        /**
+         * \brief turns the collected local changes into operations and sends them to all editors
+         */
+        void flush() noexcept;
+
+        /**
+         * \brief  turns the collected local changes into operations
+         *
+         * \throw  std::bad_alloc
+         */
+        void reconcile();
+
+        /**
+         * \brief compares a local element against its replicated state and issues the operations
+         *        bringing the latter up-to-date
+         *
+         * \param [in] handle changed element; may be stale
+         * \throw std::bad_alloc
+         */
+        void sync(sdk::ElementHandle handle);
+
+        /**
+         * \brief  retrieves the replicated element of a local one, replicating it first if needed
+         *
+         * \param  [in] handle local element; may be *gl_nullelement* or stale
+         *
+         * \return id; *gl_noelement* for *gl_nullelement* and stale handles
+         * \throw  std::bad_alloc
+         */
+        sdk::crdt::ElementId idOf(sdk::ElementHandle handle);
+
+        /**
+         * \brief  retrieves the local element of a replicated one
+         *
+         * \param  [in] id replicated element
+         *
+         * \return handle; *gl_nullelement* if the element does not exist locally
+         */
+        sdk::ElementHandle handleOf(sdk::crdt::ElementId id) const noexcept;
+
+        /**
+         * \brief applies a local operation and queues it for all editors
+         *
+         * \param [in] op operation
+         * \throw std::bad_alloc
+         */
+        void issue(sdk::crdt::Operation const &op);
+
+        /**
+         * \brief applies a remote operation to the replicated state and the store
+         *
+         * \param [in] op operation
+         * \param [in] from link the operation was received from; it is relayed to all others when hosting
+         * \throw std::bad_alloc
+         */
+        void apply(sdk::crdt::Operation const &op, Link const *from);
+
+        /**
+         * \brief accepts pending connections of editors joining
+         */
+        void accept() noexcept;
+
+        /**
+         * \brief adds a connection and subscribes to its signals
+         *
+         * \param  [in] sock connection; owned by the session from now on
+         *
+         * \return link
+         * \throw  std::bad_alloc
+         */
+        Link &attach(QTcpSocket *sock);
+
+        /**
+         * \brief handles received bytes, message by message
+         *
+         * \param [in] link connection that received them
+         */
+        void receive(Link &link) noexcept;
+
+        /**
+         * \brief  handles a complete message
+         *
+         * \param  [in] link connection that received it
+         * \param  [in] data message
+         * \param  [in] size size of *data*, in bytes
+         *
+         * \return *false* if the message was malformed
+         * \throw  std::bad_alloc
+         */
+        bool handle(Link &link, uint8_t const *data, size_t size);
+
+        /**
+         * \brief sends a message
+         *
+         * \param [in] link connection to send it on
+         * \param [in] type message type
+         * \param [in] payload contents following the type
+         * \throw std::bad_alloc
+         */
+        static void Send(Link const &link, MessageType type, std::vector<uint8_t> const &payload);
+
+        /**
+         * \brief closes a connection, e.g. after the editor has left; ends the session when joined
+         *
+         * \param [in] link connection
+         */
+        void drop(Link const &link) noexcept;
+
+        /**
+         * \brief ends the session without sending the edits of the current frame
+         */
+        void close() noexcept;
+
+        /**
+         * \brief starts the frame timer unless it is running
+         */
+        void schedule() noexcept;
+
+        /**
+         * \brief notifies the state handler
+         */
+        void notify() noexcept;
+    };
+}
+
+
@@ -0,0 +1,127 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  deferredui.hpp
+ * \brief definition of building user interface parts only once they are needed
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <functional>
+#include <vector>
+
+/* external includes */
+#include <QDockWidget>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+
+namespace suzu {
+    /**
+     * \class suzu::DeferredDock
+     * \brief dock panel whose contents are built when it is first shown
+     *
+     * Until then, the dock only holds its title; the factory building the contents, e.g. the
+     * project explorer and its model, runs on the first show, which includes raising the dock to
+     * the front of a tab group. Docks that start hidden or behind another tab thus cost nothing
+     * before the first frame.
+     */
+    class DeferredDock final : public QDockWidget {
+    public:
+        using Factory = std::function<QWidget *(QWidget *parent)>; /**< builds the contents of the dock; returns *nullptr* on failure */
+
+    private:
+        Factory m_factory; /**< builds the contents; empty once it ran */
+
+    public:
+        /**
+         * \brief constructs a new dock without contents
+         *
+         * \param [in] title title of the dock
+         * \param [in] factory builds the contents on first show
+         * \param [in] parent (optional) parent widget, usually the main window
+         */
+        DeferredDock(QString const &title, Factory factory, QWidget *parent = nullptr);
+
+        /**
+         * \brief  builds the contents now, e.g. because another component needs the model of the
+         *         dock; does nothing if they are built already
+         *
+         * \return contents, or *nullptr* if the factory failed
+         */
+        QWidget *build() noexcept;
+
+        bool isBuilt() const noexcept { return !m_factory; }
+
+    protected:
+        void showEvent(QShowEvent *event) override;
+    };
+
+
+    /**
+     * \class suzu::FirstFrameGate
+     * \brief holds back work until the first frame of the application has been painted
+     *
+     * The gate watches the events of the application until any widget paints for the first time.
+     * The deferred functions are then posted to the event loop, so that they run after that paint
+     * has been put on the screen. If nothing is painted within *gl_fallback* milliseconds after
+     * the event loop started, e.g. because the application was started minimized, they run anyway.
+     *
+     * Used for everything the first frame does not show, like plug-in contributed user interface.
+     *
+     * \note  The gate must only be used on the GUI thread.
+     */
+    class FirstFrameGate final : public QObject {
+        Q_OBJECT
+
+    public:
+        static constexpr int gl_fallback = 3000; /**< time after which deferred functions run although nothing was painted, in milliseconds */
+
+    private:
+        std::vector<std::function<void()>> m_pending; /**< deferred functions, in the order they were deferred */
+        QTimer                             m_timer;   /**< opens the gate if nothing is painted */
+        bool                               m_open;    /**< whether or not the first frame has been painted */
+
+    public:
+        /**
+         * \brief constructs a new, closed gate and starts watching the application
+         *
+         * \throw std::bad_alloc
+         */
+        FirstFrameGate();
+        FirstFrameGate(FirstFrameGate const &) = delete;
+        FirstFrameGate &operator =(FirstFrameGate const &) = delete;
+        ~FirstFrameGate();
+
+        /**
+         * \brief defers a function until after the first frame
+         *
+         * \param [in] fn function to defer; posted right away if the gate is open already
+         * \throw std::bad_alloc
+         */
+        void defer(std::function<void()> fn);
+
+        bool isOpen() const noexcept { return m_open; }
+
+    protected:
+        bool eventFilter(QObject *watched, QEvent *event) override;
+
+    private:
+        /**
+         * \brief opens the gate and posts the deferred functions
+         */
+        void open() noexcept;
+    };
+}
+
+
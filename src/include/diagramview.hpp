@@ -0,0 +1,236 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  diagramview.hpp
+ * \brief definition of the interface shared by all canvas backends
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string_view>
+
+/* external includes */
+#include <QMouseEvent>
+#include <QPointF>
+#include <QSizeF>
+#include <QWheelEvent>
+#include <QWidget>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+
+/* app includes */
+#include <renderer.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::ViewNavigator
+     * \brief zoom factor and scroll position of a canvas, driven by mouse input
+     *
+     * The wheel zooms around the cursor, dragging with the middle mouse button pans the view.
+     */
+    class ViewNavigator {
+        static constexpr double gl_minzoom  = 0.01; /**< smallest zoom factor */
+        static constexpr double gl_maxzoom  = 16.0; /**< largest zoom factor */
+        static constexpr double gl_zoomstep = 1.15; /**< zoom factor per wheel step */
+
+        double  m_zoom;    /**< zoom factor; 1 is 100% */
+        QPointF m_origin;  /**< scene position shown in the top-left corner */
+        QPointF m_drag;    /**< last cursor position while panning */
+        bool    m_panning; /**< whether or not the view is being panned */
+
+    public:
+        ViewNavigator() noexcept
+            : m_zoom(1.0), m_panning(false)
+        { }
+
+        double  zoom() const noexcept   { return m_zoom; }
+        QPointF origin() const noexcept { return m_origin; }
+
+        /**
+         * \brief sets zoom factor and scroll position, e.g. when restoring a session
+         *
+         * \param [in] zoom zoom factor; clamped to the supported range
+         * \param [in] origin scene position shown in the top-left corner
+         */
+        void setViewport(double const zoom, QPointF const &origin) noexcept {
+            m_zoom   = std::clamp(zoom, gl_minzoom, gl_maxzoom);
+            m_origin = origin;
+        }
+
+        /**
+         * \brief  maps a widget position to scene coordinates
+         *
+         * \param  [in] pos position in widget coordinates
+         *
+         * \return position in scene coordinates
+         */
+        QPointF mapToScene(QPointF const &pos) const noexcept { return m_origin + pos / m_zoom; }
+
+        /**
+         * \brief scrolls the view so that a scene position is shown in its center
+         *
+         * \param [in] pos position in scene coordinates
+         * \param [in] size size of the widget
+         */
+        void centerOn(QPointF const &pos, QSizeF const &size) noexcept { m_origin = pos - QPointF(size.width(), size.height()) / (2.0 * m_zoom); }
+
+        /**
+         * \brief zooms around a widget position, keeping the scene position under it fixed
+         *
+         * \param [in] pos position in widget coordinates
+         * \param [in] steps wheel steps; positive values zoom in
+         */
+        void zoomAt(QPointF const &pos, double const steps) noexcept {
+            QPointF const anchor = mapToScene(pos);
+
+            m_zoom   = std::clamp(m_zoom * std::pow(gl_zoomstep, steps), gl_minzoom, gl_maxzoom);
+            m_origin = anchor - pos / m_zoom;
+        }
+
+        /**
+         * \brief zooms around the cursor, keeping the scene position under it fixed
+         *
+         * \param [in] event wheel event; accepted
+         */
+        void wheel(QWheelEvent *event) noexcept {
+            zoomAt(event->position(), event->angleDelta().y() / 120.0);
+
+            event->accept();
+        }
+
+        /**
+         * \brief  starts panning if the middle mouse button was pressed
+         *
+         * \param  [in] event mouse event; accepted if handled
+         *
+         * \return *true* if the event was handled
+         */
+        bool press(QMouseEvent *event) noexcept {
+            if (event->button() != Qt::MiddleButton)
+                return false;
+
+            m_panning = true;
+            m_drag    = event->position();
+            event->accept();
+            return true;
+        }
+
+        /**
+         * \brief  pans the view while the middle mouse button is held
+         *
+         * \param  [in] event mouse event; accepted if handled
+         *
+         * \return *true* if the view has moved
+         */
+        bool move(QMouseEvent *event) noexcept {
+            if (!m_panning)
+                return false;
+
+            m_origin -= (event->position() - m_drag) / m_zoom;
+            m_drag    = event->position();
+            event->accept();
+            return true;
+        }
+
+        /**
+         * \brief  stops panning if the middle mouse button was released
+         *
+         * \param  [in] event mouse event; accepted if handled
+         *
+         * \return *true* if the event was handled
+         */
+        bool release(QMouseEvent *event) noexcept {
+            if (event->button() != Qt::MiddleButton)
+                return false;
+
+            m_panning = false;
+            event->accept();
+            return true;
+        }
+    };
+
+
+    /**
+     * \class suzu::DiagramView
+     * \brief interface of a widget displaying a diagram, implemented by every canvas backend
+     */
+    class DiagramView {
+    public:
+        virtual ~DiagramView() = default;
+
+        /**
+         * \brief  retrieves the widget of the view
+         *
+         * \return widget; owned by its parent
+         */
+        virtual QWidget *widget() noexcept = 0;
+
+        /**
+         * \brief sets the displayed diagram
+         *
+         * \param [in] store elements to display; must outlive the view or be reset before
+         */
+        virtual void setStore(sdk::ElementStore const *store) noexcept = 0;
+
+        /**
+         * \brief sets the level-of-detail thresholds, e.g. after the configuration changed
+         *
+         * \param [in] lod new thresholds
+         */
+        virtual void setLodThresholds(LodThresholds const &lod) noexcept = 0;
+
+        /**
+         * \brief sets the style sheet, e.g. after it was edited
+         *
+         * \param [in] styles compiled style sheet; *nullptr* for the default appearance
+         */
+        virtual void setStyles(std::shared_ptr<StyleSheet const> styles) noexcept = 0;
+
+        /**
+         * \brief  retrieves zoom factor and scroll position
+         *
+         * \return navigator of the view
+         */
+        virtual ViewNavigator const &navigator() const noexcept = 0;
+
+        /**
+         * \brief sets zoom factor and scroll position, e.g. when restoring a session
+         *
+         * \param [in] zoom zoom factor
+         * \param [in] origin scene position shown in the top-left corner
+         */
+        virtual void setViewport(double zoom, QPointF const &origin) noexcept = 0;
+    };
+
+
+    /**
+     * \brief  creates a diagram view
+     *
+     * The GPU backend is only used if OpenGL 3.3 is available and the application does not run in
+     * a remote desktop session; otherwise, the raster backend is used.
+     *
+     * \param  [in] backend "raster" or "gpu"; key "/canvas/backend"
+     * \param  [in] lod level-of-detail thresholds
+     * \param  [in] tilebudget maximum memory used by cached tiles of the raster backend, in bytes
+     * \param  [in] parent (optional) parent widget
+     *
+     * \return new view, or *nullptr* on failure
+     */
+    DiagramView *CreateDiagramView(std::string_view backend, LodThresholds const &lod, size_t tilebudget, QWidget *parent = nullptr) noexcept;
+}
+
+
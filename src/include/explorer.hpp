@@ -0,0 +1,179 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  explorer.hpp
+ * \brief definition of the item model of the project explorer
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/* external includes */
+#include <QAbstractItemModel>
+#include <QTreeView>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+
+/* app includes */
+#include <validator.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::ProjectExplorerModel
+     * \brief tree of the elements of a diagram, by their parent elements, for the project explorer
+     *
+     * The model reads the store directly and keeps no item per element. The tree is derived from
+     * the parents of the elements on first use: children are grouped by their parent in a single
+     * array (in drawing order), and every element remembers its row, which costs 12 bytes per
+     * element and makes *index()* and *parent()* constant-time.
+     *
+     * Rows are revealed lazily: a parent reports its children through *hasChildren()* right away,
+     * but the view only receives them in batches, as it scrolls, through *canFetchMore()* and
+     * *fetchMore()*. Expanding a package with tens of thousands of elements thus only creates the
+     * rows that are visible. Attach the model with *Attach()*, so that the view does not measure
+     * every row either.
+     *
+     * \note  Dense indices identify the items, so the model has to be refreshed (see *refresh()*)
+     *        after elements were created, destroyed or reparented, which resets it. Renames only
+     *        require *elementChanged()*; moves and other changes require nothing.
+     */
+    class ProjectExplorerModel final : public QAbstractItemModel {
+        static constexpr uint32_t gl_fetchbatch = 256; /**< rows revealed per *fetchMore()* */
+
+        sdk::ElementStore const               *m_store;    /**< elements shown; *nullptr* for none */
+        mutable std::vector<uint32_t>          m_first;    /**< position of the first child in *m_children*, by parent key; one past the last parent key at the end */
+        mutable std::vector<uint32_t>          m_children; /**< dense indices of all elements, grouped by parent */
+        mutable std::vector<uint32_t>          m_row;      /**< row of each element below its parent, by dense index */
+        mutable bool                           m_built;    /**< whether or not the tree reflects the store */
+        std::unordered_map<uint32_t, uint32_t> m_fetched;  /**< number of rows revealed, by parent key */
+        ModelValidator const                  *m_checks;   /**< diagnostics shown with the elements; *nullptr* for none */
+
+    public:
+        explicit ProjectExplorerModel(QObject *parent = nullptr) noexcept;
+
+        /**
+         * \brief attaches a model to a view, with settings suited to large trees
+         *
+         * All rows have the same height, so the view computes its scroll range without laying out
+         * the rows.
+         *
+         * \param [in,out] view view of the project explorer
+         * \param [in] model model to show
+         */
+        static void Attach(QTreeView &view, ProjectExplorerModel &model);
+
+        /**
+         * \brief shows the elements of another store
+         *
+         * \param [in] store elements to show; *nullptr* to show none
+         * \note  The store must outlive the model, or be replaced before it is destroyed.
+         */
+        void setStore(sdk::ElementStore const *store);
+
+        /**
+         * \brief shows the diagnostics of a validator with the elements
+         *
+         * Elements with errors are shown in red, those with warnings in orange; their tool tips
+         * list the violated rules. Forward the elements reported by the validator to
+         * *elementChanged()*, so that their items are updated.
+         *
+         * \param [in] checks validator of the shown store; *nullptr* to show no diagnostics
+         * \note  The validator must outlive the model, or be replaced before it is destroyed.
+         */
+        void setValidator(ModelValidator const *checks);
+
+        /**
+         * \brief rebuilds the tree after the set of elements or their parents changed
+         *
+         * All items are collapsed and serve their rows lazily again.
+         */
+        void refresh();
+
+        /**
+         * \brief updates the item of an element, e.g. after it was renamed
+         *
+         * \param [in] handle changed element
+         */
+        void elementChanged(sdk::ElementHandle handle);
+
+        /**
+         * \brief  retrieves the element of an item
+         *
+         * \param  [in] index item of the model
+         *
+         * \return handle of the element, or *suzu::sdk::gl_nullelement* if the index is invalid
+         */
+        sdk::ElementHandle handleOf(QModelIndex const &index) const noexcept;
+
+        QModelIndex   index(int row, int column, QModelIndex const &parent = QModelIndex()) const override;
+        QModelIndex   parent(QModelIndex const &child) const override;
+        int           rowCount(QModelIndex const &parent = QModelIndex()) const override;
+        int           columnCount(QModelIndex const &parent = QModelIndex()) const override;
+        bool          hasChildren(QModelIndex const &parent = QModelIndex()) const override;
+        bool          canFetchMore(QModelIndex const &parent) const override;
+        void          fetchMore(QModelIndex const &parent) override;
+        QVariant      data(QModelIndex const &index, int role = Qt::DisplayRole) const override;
+        QVariant      headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+        Qt::ItemFlags flags(QModelIndex const &index) const override;
+
+    private:
+        /**
+         * \brief derives the tree from the parents of the elements, unless it is up to date
+         *
+         * \note  If memory runs out, the tree is left empty.
+         */
+        void build() const noexcept;
+
+        /**
+         * \brief  retrieves the key under which the children of an item are stored
+         *
+         * \param  [in] parent item; invalid for the top level
+         *
+         * \return 0 for the top level, or the dense index of the element plus one
+         */
+        static uint32_t KeyOf(QModelIndex const &parent) noexcept;
+
+        /**
+         * \brief  retrieves the key of the parent of an element
+         *
+         * \param  [in] dense dense index of the element
+         *
+         * \return key of its parent; elements with stale parents are shown at the top level
+         */
+        uint32_t parentKey(uint32_t dense) const noexcept;
+
+        /**
+         * \brief  retrieves the number of children below a key
+         *
+         * \param  [in] key key of the parent
+         *
+         * \return number of children, revealed or not
+         */
+        uint32_t childCount(uint32_t key) const noexcept;
+
+        /**
+         * \brief  retrieves the number of children below a key that were revealed to the view
+         *
+         * \param  [in] key key of the parent
+         *
+         * \return number of revealed rows
+         */
+        uint32_t fetchedCount(uint32_t key) const noexcept;
+    };
+}
+
+
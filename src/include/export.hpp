@@ -0,0 +1,121 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  export.hpp
+ * \brief definition of the SVG, PDF and PNG exporters and of printing
+ */
+
+
+#pragma once
+
+/* external includes */
+#include <QColor>
+#include <QFont>
+#include <QPagedPaintDevice>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+
+
+namespace suzu {
+    class JobContext;
+
+
+    /**
+     * \brief  writes a diagram as an SVG document
+     *
+     * Elements are read straight from the store, in painting order, and written as primitives
+     * without building a scene or a copy of the diagram. The document is assembled in chunks of
+     * bounded size that are flushed to the file as soon as they are full, so memory does not grow
+     * with the diagram. Labels are positioned with the layouts of the shared
+     * *suzu::TextLayoutCache*, like on the canvas.
+     *
+     * \param  [in] path path of the SVG file
+     * \param  [in] store elements of the diagram; hidden elements are skipped
+     * \param  [in] font font of the labels
+     * \param  [in] job (optional) job receiving the progress; cancelling it stops the export
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::OpenFile* if the file
+     *         could not be created, *suzu::sdk::ErrorCode::WriteFile* if it could not be written,
+     *         or *suzu::sdk::ErrorCode::NoOperation* if the job was cancelled; the previous file
+     *         remains untouched then
+     * \note   The store must not be modified during the export.
+     */
+    sdk::ErrorCode ExportSvg(char const *path, sdk::ElementStore const &store, QFont const &font, JobContext *job = nullptr) noexcept;
+
+    /**
+     * \brief  writes a diagram as a single-page PDF document
+     *
+     * The page is sized to fit the diagram. Elements are painted straight from the store through
+     * *suzu::DiagramRenderer*; the PDF engine streams them to the file.
+     *
+     * \param  [in] path path of the PDF file
+     * \param  [in] store elements of the diagram; hidden elements are skipped
+     * \param  [in] font font of the labels
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if the
+     *         diagram is empty, or *suzu::sdk::ErrorCode::WriteFile* if the file could not be
+     *         written
+     * \note   The store must not be modified during the export.
+     */
+    sdk::ErrorCode ExportPdf(char const *path, sdk::ElementStore const &store, QFont const &font) noexcept;
+
+    /**
+     * \brief  writes a diagram as a PNG image
+     *
+     * The image is rendered in horizontal strips, several at once on the task scheduler, which
+     * are encoded on the workers as well and then streamed to the file in order (see
+     * *suzu::PngWriter*). Memory is bounded by a few strips per worker, no matter how large the
+     * image gets.
+     *
+     * \param  [in] path path of the PNG file
+     * \param  [in] store elements of the diagram; hidden elements are skipped
+     * \param  [in] font font of the labels
+     * \param  [in] scale pixels per scene unit
+     * \param  [in] background color of the background
+     * \param  [in] job (optional) job receiving the progress; cancelling it stops the export
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+     *         *scale* is not positive or the image would be too large, *suzu::sdk::ErrorCode::NoOperation*
+     *         if the diagram is empty or the job was cancelled, *suzu::sdk::ErrorCode::OpenFile* if
+     *         the file could not be created, *suzu::sdk::ErrorCode::WriteFile* if it could not be
+     *         written, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out; the previous
+     *         file remains untouched unless the export succeeded
+     * \note   The store must not be modified during the export.
+     */
+    sdk::ErrorCode ExportPng(char const *path, sdk::ElementStore const &store, QFont const &font, double scale, QColor const &background, JobContext *job = nullptr) noexcept;
+
+    /**
+     * \brief  prints a diagram across as many pages as it takes, e.g. as poster tiles
+     *
+     * The diagram is cut into pages the size of the device's paint rect, left to right and top
+     * to bottom. Pages are recorded as *QPicture*s in batches, several at once on the task
+     * scheduler, and then played back onto the device in order, so only the pages of the current
+     * batch are held in memory. Works with every paged device, e.g. *QPdfWriter* or *QPrinter*;
+     * the page layout and resolution must be set before.
+     *
+     * \param  [in,out] device device receiving the pages; must not be painted on by anyone else
+     * \param  [in] store elements of the diagram; hidden elements are skipped
+     * \param  [in] font font of the labels
+     * \param  [in] scale points per scene unit; 1 prints the diagram at the size of *ExportPdf()*
+     * \param  [in] job (optional) job receiving the progress; cancelling it stops printing
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+     *         *scale* is not positive or the pages of the device are empty, *suzu::sdk::ErrorCode::NoOperation*
+     *         if the diagram is empty or the job was cancelled, *suzu::sdk::ErrorCode::CriticalResource*
+     *         if memory ran out, or *suzu::sdk::ErrorCode::WriteFile* if the device could not be
+     *         painted on; the pages played back before remain on the device
+     * \note   The store must not be modified while printing.
+     */
+    sdk::ErrorCode PrintPages(QPagedPaintDevice &device, sdk::ElementStore const &store, QFont const &font, double scale, JobContext *job = nullptr) noexcept;
+}
+
+
@@ -0,0 +1,129 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  forceanimator.hpp
+ * \brief definition of the driver applying force-directed layouts to a diagram
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/* external includes */
+#include <QTimer>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/forcelayout.hpp>
+#include <sdk/task.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        struct ForceFrames;
+    }
+
+
+    /**
+     * \class suzu::ForceAnimator
+     * \brief lays out package and component diagrams with *suzu::sdk::ForceLayout*
+     *
+     * All visible elements except associations take part; locked elements stay in place. In
+     * animated mode, the simulation runs as a task and publishes its positions after every step.
+     * A timer on the GUI thread picks up the most recent positions at the display's refresh rate
+     * and moves the elements, so the canvas shows the layout unfolding without the simulation
+     * ever waiting for the GUI. Steps finishing between two frames are simply not shown.
+     *
+     * \note  The animator must only be used on the GUI thread.
+     */
+    class ForceAnimator {
+    public:
+        /**
+         * \brief receives every applied frame on the GUI thread; *finished* is set for the last one
+         */
+        using Listener = std::function<void(bool finished)>;
+
+        static constexpr uint32_t gl_maxsteps = 1000; /**< maximum number of simulation steps */
+
+    private:
+        sdk::ElementStore                     *m_store;    /**< diagram being laid out; not owned */
+        std::vector<sdk::ElementHandle>        m_handles;  /**< laid-out elements, by node */
+        std::shared_ptr<internal::ForceFrames> m_frames;   /**< positions shared with the simulation task */
+        sdk::TaskHandle                        m_task;     /**< simulation task in animated mode */
+        std::unique_ptr<QTimer>                m_timer;    /**< picks up frames at display rate */
+        Listener                               m_listener; /**< listener; may be empty */
+
+    public:
+        ForceAnimator() noexcept;
+        ForceAnimator(ForceAnimator const &) = delete;
+        ForceAnimator &operator =(ForceAnimator const &) = delete;
+        /**
+         * \brief stops a running animation
+         */
+        ~ForceAnimator();
+
+        /**
+         * \brief sets the listener receiving applied frames
+         *
+         * \param [in] listener listener, e.g. repainting the diagram views
+         */
+        void setListener(Listener listener) noexcept;
+
+        /**
+         * \brief  lays out a diagram
+         *
+         * A running animation is stopped first.
+         *
+         * \param  [in,out] store diagram to lay out; must outlive the animation or *stop()* must be
+         *         called before it is destroyed
+         * \param  [in] edges pairs of connected elements; pairs with an element that does not take part are ignored
+         * \param  [in] animated whether to animate the layout or to apply the settled positions at once
+         * \param  [in] opts layout parameters
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if no
+         *         element takes part, or *suzu::sdk::ErrorCode::CriticalResource* if the layout could
+         *         not be started
+         */
+        sdk::ErrorCode start(sdk::ElementStore &store, std::vector<std::pair<sdk::ElementHandle, sdk::ElementHandle>> const &edges, bool animated, sdk::ForceOptions const &opts = {}) noexcept;
+
+        /**
+         * \brief stops a running animation; elements keep the positions shown last
+         */
+        void stop() noexcept;
+
+        /**
+         * \brief  retrieves whether or not an animation is running
+         *
+         * \return *true* if the simulation task has not delivered its final frame yet
+         */
+        bool isRunning() const noexcept { return m_frames != nullptr; }
+
+    private:
+        /**
+         * \brief moves the laid-out elements to the given center positions
+         *
+         * \param [in] xs center x-coordinates, by node
+         * \param [in] ys center y-coordinates, by node
+         */
+        void apply(float const *xs, float const *ys) noexcept;
+
+        /**
+         * \brief picks up the most recent frame of the simulation task
+         */
+        void poll() noexcept;
+    };
+}
+
+
@@ -0,0 +1,217 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  framemonitor.hpp
+ * \brief frame-time and input-latency overlay of the diagram views
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* external includes */
+#include <QObject>
+#include <QPainter>
+#include <QPointer>
+#include <QTimer>
+#include <QWidget>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+#include <sdk/profile.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::FrameMonitor
+     * \brief measures how responsive the diagram views are and shows it in a heads-up display
+     *
+     * The views enter the zone returned by *PaintZone()* while painting. While the display is
+     * shown, the monitor records all profiling zones of the application and its plug-ins (see
+     * *suzu::sdk::Profiler*), and collects them on every tick, keeping those of the last
+     * *gl_window* nanoseconds. From the paint zones, it derives
+     *
+     *  - *paint*: time spent painting a view, on average and at most;
+     *  - *frame*: interval between the ends of consecutive paints, as 50th, 95th and 99th
+     *    percentile;
+     *  - *input*: time from an input event (key presses, clicks, wheel turns and drags) to the end
+     *    of the first paint started after it; inputs not followed by a paint within a second are
+     *    discarded.
+     *
+     * On every tick, the monitor also posts an event to itself: the time until the event loop
+     * delivers it (*queue*) is the delay every other posted event suffers as well. Inputs are seen
+     * by an event filter on the application, i.e., inside *QApplication::exec()*, before they
+     * reach any widget.
+     *
+     * F12 toggles the display (initially key "/hud/visible"); Shift+F12 writes the zones and
+     * measurements of the last *gl_window* nanoseconds to the trace file at key "/hud/trace", in
+     * the Chrome trace event format.
+     *
+     * \note  While the display is shown, zones are collected by the monitor; the profiler keeps a
+     *        copy of them for a trace requested with key "/profile/trace" (see
+     *        *suzu::sdk::Profiler::setRetaining()*).
+     * \note  The monitor must only be used on the GUI thread.
+     */
+    class FrameMonitor final : public QObject {
+        Q_OBJECT
+
+    public:
+        static constexpr int64_t gl_window = int64_t(10) * 1000000000; /**< time span kept for statistics and traces, in nanoseconds */
+        static constexpr int     gl_tick   = 100;                      /**< interval between collections and queue probes, in milliseconds */
+
+    private:
+        /**
+         * \struct suzu::FrameMonitor::Frame
+         * \brief  a single paint of a view
+         */
+        struct Frame {
+            int64_t begin;   /**< start of the paint, on the profiler's clock */
+            int64_t end;     /**< end of the paint, on the profiler's clock */
+            int64_t latency; /**< time from the input the paint served to its end; negative if none */
+        };
+
+        /**
+         * \struct suzu::FrameMonitor::Probe
+         * \brief  a measured delay of the event queue
+         */
+        struct Probe {
+            int64_t time;  /**< delivery of the probe event, on the profiler's clock */
+            int64_t delay; /**< time from posting to delivery */
+        };
+
+        /**
+         * \struct suzu::FrameMonitor::Stats
+         * \brief  statistics shown in the display, updated on every tick
+         */
+        struct Stats {
+            uint32_t frames;      /**< number of paints in the window */
+            double   paintmean;   /**< mean paint time, in milliseconds */
+            double   paintmax;    /**< longest paint time, in milliseconds */
+            double   interval[3]; /**< 50th, 95th and 99th percentile of the frame interval, in milliseconds */
+            double   queuelast;   /**< last queue delay, in milliseconds */
+            double   queuemax;    /**< longest queue delay, in milliseconds */
+            double   inputlast;   /**< last input-to-paint latency, in milliseconds; negative if none */
+            double   inputmax;    /**< longest input-to-paint latency, in milliseconds; negative if none */
+        };
+
+        static inline FrameMonitor *gl_instance = nullptr; /**< monitor of the application, if any */
+
+        sdk::Profiler                    &m_profiler; /**< profiler the zones are recorded in */
+        std::string                      m_trace;    /**< path of the trace file; empty to disable writing traces */
+        std::unique_ptr<QTimer>          m_timer;    /**< collects zones and posts probes */
+        bool                             m_visible;  /**< whether or not the display is shown */
+        bool                             m_wasrec;   /**< whether or not the profiler recorded before the display was shown */
+        quint64                          m_stamp;    /**< timestamp of the last input event */
+        uint32_t                         m_thread;   /**< id of the thread that paints, i.e., the GUI thread; 0 until the first paint */
+        std::vector<uint32_t>            m_open;     /**< zones entered and not left yet by the GUI thread */
+        int64_t                          m_begin;    /**< start of the paint being collected; negative if none */
+        std::deque<sdk::Profiler::Event> m_events;   /**< collected events of the window */
+        std::deque<Frame>                m_frames;   /**< paints of the window */
+        std::deque<Probe>                m_probes;   /**< queue delays of the window */
+        std::deque<int64_t>              m_inputs;   /**< inputs not served by a paint yet */
+        std::vector<QPointer<QWidget>>   m_views;    /**< views repainted on every tick while the display is shown */
+        Stats                            m_stats;    /**< shown statistics */
+
+    public:
+        /**
+         * \brief constructs the monitor and installs its event filter on the application
+         *
+         * \param [in] visible whether or not the display is shown initially
+         * \param [in] trace path of the trace file written by Shift+F12; empty to disable it
+         * \param [in] parent (optional) parent object
+         */
+        FrameMonitor(bool visible, std::string trace, QObject *parent = nullptr) noexcept;
+        FrameMonitor(FrameMonitor const &) = delete;
+        FrameMonitor &operator =(FrameMonitor const &) = delete;
+        /**
+         * \brief removes the event filter and restores the previous recording state of the profiler
+         */
+        ~FrameMonitor() override;
+
+        /**
+         * \brief  retrieves the monitor of the application
+         *
+         * \return monitor, or *nullptr* if the application runs without one, e.g. headless
+         */
+        static FrameMonitor *Instance() noexcept { return gl_instance; }
+
+        /**
+         * \brief  retrieves the zone the views enter while painting
+         *
+         * \return id of the zone in *suzu::sdk::Profiler::Local()*, or 0 on failure
+         */
+        static uint32_t PaintZone() noexcept;
+
+        /**
+         * \brief adds a view to repaint on every tick while the display is shown, so that the
+         *        statistics it shows stay current; views destroyed later are dropped
+         *
+         * \param [in] view view painting the display with *paintOverlay()*
+         */
+        void watch(QWidget *view) noexcept;
+
+        /**
+         * \brief shows or hides the display
+         *
+         * \param [in] visible whether or not to show the display
+         */
+        void setVisible(bool visible) noexcept;
+        bool isVisible() const noexcept { return m_visible; }
+
+        /**
+         * \brief paints the display into the top-left corner of a view, if it is shown
+         *
+         * \param [in] painter painter drawing the view, in widget coordinates
+         * \param [in] rect widget rectangle of the view
+         */
+        void paintOverlay(QPainter &painter, QRect const &rect) const;
+
+        /**
+         * \brief  writes the zones and measurements of the last *gl_window* nanoseconds to the trace file
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if the
+         *         display is hidden or no trace file is set, *suzu::sdk::ErrorCode::WriteFile* if the
+         *         file could not be written, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran
+         *         out
+         */
+        sdk::ErrorCode dump() noexcept;
+
+    protected:
+        bool eventFilter(QObject *watched, QEvent *event) override;
+        void customEvent(QEvent *event) override;
+
+    private:
+        /**
+         * \brief collects the recorded zones, posts a probe, updates the statistics and repaints the
+         *        watched views
+         */
+        void tick() noexcept;
+
+        /**
+         * \brief derives paints and input latencies from a collected event
+         *
+         * \param [in] event event collected from the profiler
+         */
+        void process(sdk::Profiler::Event const &event) noexcept;
+
+        /**
+         * \brief drops everything older than the window and recomputes the statistics
+         */
+        void refresh() noexcept;
+    };
+}
+
+
@@ -0,0 +1,86 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ * 
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ * 
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  globalsettings.hpp
+ * \brief schema of the global configuration file
+ */
+
+
+#pragma once
+
+/* sdk includes */
+#include <sdk/settings.hpp>
+
+
+/**
+ * \brief settings list of the global configuration file (see *suzu::sdk::SZSDK_DEFINE_SETTINGS*)
+ * 
+ * Every key read from *data/config.json* must be listed here, together with its type and its
+ * default value.
+ */
+#define SUZU_GLOBAL_SETTINGS(X)                                                   \
+    X(std::string, logfile,       "/logfile",           "")                      \
+    X(bool,        hotreload,     "/hotreload",         false)                   \
+    X(bool,        logasync,      "/log/async",         false)                   \
+    X(uint64_t,    logqueuesize,  "/log/queuesize",     8192)                    \
+    X(std::string, logoverflow,   "/log/overflow",      "block")                 \
+    X(std::string, logflushlevel, "/log/flushlevel",    "warn")                  \
+    X(uint32_t,    logflushintvl, "/log/flushinterval", 3)                       \
+    X(std::string, logfilelevel,  "/log/filelevel",     "trace")                 \
+    X(uint32_t,    logringbuffer, "/log/ringbuffer",    0)                       \
+    X(std::string, logcrashdump,  "/log/crashdump",     "logs/crash.txt")        \
+    X(std::string, logeventlog,   "/log/eventlog",      "")                      \
+    X(uint32_t,    logsiterate,   "/log/siterate",      0)                       \
+    X(uint32_t,    logsiteburst,  "/log/siteburst",     1)                       \
+    X(uint32_t,    logrotsize,    "/log/rotatesize",    16)                      \
+    X(uint32_t,    logrotfiles,   "/log/rotatefiles",   5)                       \
+    X(bool,        logcompress,   "/log/compress",      true)                    \
+    X(uint32_t,    startupbudget, "/startup/budget",    0)                       \
+    X(std::string, startuptrace,  "/startup/trace",     "")                      \
+    X(std::string, profiletrace,  "/profile/trace",     "")                      \
+    X(bool,        hudvisible,    "/hud/visible",       false)                   \
+    X(std::string, hudtrace,      "/hud/trace",         "logs/hud.json")         \
+    X(uint32_t,    watchdogstall, "/watchdog/stall",    500)                     \
+    X(uint32_t,    memreport,     "/memory/report",     60)                      \
+    X(uint32_t,    memorybudget,  "/memory/budget",     256)                     \
+    X(std::string, metricstarget, "/metrics/target",    "")                      \
+    X(uint32_t,    metricsintvl,  "/metrics/interval",  60)                      \
+    X(uint32_t,    batchthreads,  "/batch/threads",     0)                       \
+    X(bool,        singleinst,    "/singleinstance",    true)                    \
+    X(uint32_t,    taskthreads,   "/tasks/threads",     0)                       \
+    X(uint32_t,    jobrate,       "/jobs/maxrate",      10)                      \
+    X(bool,        pluginprofile, "/plugins/profile",   false)                   \
+    X(bool,        pluginisolate, "/plugins/isolate",   false)                   \
+    X(double,      lodnames,      "/lod/names",         0.5)                     \
+    X(double,      lodoutlines,   "/lod/outlines",      0.2)                     \
+    X(double,      lodclusters,   "/lod/clusters",      10.0)                    \
+    X(uint32_t,    tilebudget,    "/tiles/budget",      0)                       \
+    X(std::string, canvasbackend, "/canvas/backend",    "raster")                \
+    X(uint32_t,    textcache,     "/text/cachesize",    0)                       \
+    X(uint32_t,    undobudget,    "/undo/budget",       0)                       \
+    X(uint32_t,    compactsize,   "/project/compact",   16)                      \
+    X(std::string, compression,   "/project/compress",  "none")                  \
+    X(uint32_t,    autosaveintvl, "/autosave/interval", 60)                      \
+    X(uint32_t,    autosavesize,  "/autosave/maxsize",  256)                     \
+    X(bool,        sessrestore,   "/session/restore",   true)                    \
+    X(std::string, remotecache,   "/remote/cache",      "cache/remote")          \
+    X(uint32_t,    remotecachesz, "/remote/cachesize",  1024)                    \
+    X(uint32_t,    remotetimeout, "/remote/timeout",    30)
+
+
+namespace suzu {
+    /**
+     * \struct suzu::GlobalSettings
+     * \brief  validated contents of the global configuration file
+     */
+    SZSDK_DEFINE_SETTINGS(GlobalSettings, SUZU_GLOBAL_SETTINGS);
+}
+
+
@@ -0,0 +1,138 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  gpucanvas.hpp
+ * \brief definition of the OpenGL backend of the diagram view
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <memory>
+#include <vector>
+
+/* external includes */
+#include <QOpenGLBuffer>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+#include <QOpenGLWidget>
+#include <QSurfaceFormat>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+
+/* app includes */
+#include <diagramview.hpp>
+#include <renderer.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::GpuCanvas
+     * \brief OpenGL backend of the diagram view, for very large diagrams
+     *
+     * Element shapes are drawn with two instanced draw calls per frame: one for all boxes, whose
+     * outlines, header lines and folded corners are computed in the fragment shader, and one for
+     * all associations. The instance buffers are only rebuilt when the store's revision changes;
+     * zooming and panning merely update uniforms. Names are painted with *QPainter* on top, and
+     * only for elements intersecting the viewport.
+     *
+     * \note  Requires OpenGL 3.3 (core profile); see *IsSupported()*.
+     */
+    class GpuCanvas final : public QOpenGLWidget, public DiagramView, protected QOpenGLExtraFunctions {
+        Q_OBJECT
+
+        /**
+         * \struct suzu::GpuCanvas::BoxInstance
+         * \brief  per-instance attributes of a box
+         */
+        struct BoxInstance {
+            float rect[4]; /**< bounds of the element, in scene coordinates */
+            float shape;   /**< 0 for plain boxes, 1 for classifiers, 2 for notes */
+        };
+
+        sdk::ElementStore const              *m_store;    /**< displayed diagram; not owned */
+        DiagramRenderer                       m_render;   /**< paints the names */
+        LodThresholds                         m_lod;      /**< level-of-detail thresholds */
+        ViewNavigator                         m_view;     /**< zoom factor and scroll position */
+        uint64_t                              m_uploaded; /**< revision of the store in the instance buffers */
+        bool                                  m_stale;    /**< whether or not the instance buffers have to be rebuilt */
+        std::vector<BoxInstance>              m_boxes;    /**< box instances; reused across uploads */
+        std::vector<sdk::ElementRect>         m_edges;    /**< association instances; reused across uploads */
+        std::vector<RenderItem>               m_labels;   /**< visible elements; reused across frames */
+        std::unique_ptr<QOpenGLShaderProgram> m_boxprog;  /**< draws boxes */
+        std::unique_ptr<QOpenGLShaderProgram> m_edgeprog; /**< draws associations */
+        QOpenGLVertexArrayObject              m_boxvao;   /**< vertex layout of boxes */
+        QOpenGLVertexArrayObject              m_edgevao;  /**< vertex layout of associations */
+        QOpenGLBuffer                         m_quad;     /**< corners of the unit square */
+        QOpenGLBuffer                         m_line;     /**< end points of the unit line */
+        QOpenGLBuffer                         m_boxbuf;   /**< box instances */
+        QOpenGLBuffer                         m_edgebuf;  /**< association instances */
+        GLsizei                               m_nboxes;   /**< number of box instances */
+        GLsizei                               m_nedges;   /**< number of association instances */
+
+    public:
+        /**
+         * \brief constructs a new, empty canvas
+         *
+         * \param [in] lod level-of-detail thresholds
+         * \param [in] parent (optional) parent widget
+         */
+        explicit GpuCanvas(LodThresholds const &lod, QWidget *parent = nullptr) noexcept;
+        /**
+         * \brief releases all OpenGL resources
+         */
+        ~GpuCanvas() override;
+
+        /**
+         * \brief  retrieves the surface format requested by the canvas
+         *
+         * \return OpenGL 3.3 core profile format
+         */
+        static QSurfaceFormat Format() noexcept;
+
+        /**
+         * \brief  checks whether the canvas can be used on this system
+         *
+         * \return *true* if an OpenGL 3.3 context can be created
+         */
+        static bool IsSupported() noexcept;
+
+        QWidget *widget() noexcept override { return this; }
+        void setStore(sdk::ElementStore const *store) noexcept override;
+        void setLodThresholds(LodThresholds const &lod) noexcept override;
+        void setStyles(std::shared_ptr<StyleSheet const> styles) noexcept override;
+        ViewNavigator const &navigator() const noexcept override { return m_view; }
+        void setViewport(double zoom, QPointF const &origin) noexcept override;
+
+    protected:
+        void initializeGL() override;
+        void paintGL() override;
+        void wheelEvent(QWheelEvent *event) override;
+        void mousePressEvent(QMouseEvent *event) override;
+        void mouseMoveEvent(QMouseEvent *event) override;
+        void mouseReleaseEvent(QMouseEvent *event) override;
+
+    private:
+        /**
+         * \brief draws the elements and their names; the store and the shader programs must be set
+         */
+        void paintScene();
+
+        /**
+         * \brief rebuilds the instance buffers if the store has changed since the last upload
+         */
+        void upload();
+    };
+}
+
+
@@ -0,0 +1,190 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  guides.hpp
+ * \brief definition of the snapping and alignment guides shown while dragging
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <array>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/spatial.hpp>
+
+
+namespace suzu {
+    /**
+     * \struct suzu::AlignmentGuide
+     * \brief  line shown while dragging where the dragged bounds align with other elements
+     */
+    struct AlignmentGuide {
+        bool  vertical; /**< whether the guide is a vertical line, i.e. aligns horizontal positions */
+        float position; /**< horizontal position of a vertical guide, vertical position otherwise */
+        float from;     /**< start of the line along the guide, in scene coordinates */
+        float to;       /**< end of the line along the guide */
+    };
+
+    /**
+     * \struct suzu::SnapResult
+     * \brief  outcome of snapping dragged bounds to the other elements
+     */
+    struct SnapResult {
+        float                       dx;     /**< horizontal offset to add to the dragged bounds; 0 if not snapped */
+        float                       dy;     /**< vertical offset to add to the dragged bounds; 0 if not snapped */
+        std::vector<AlignmentGuide> guides; /**< guides to show at the snapped bounds */
+    };
+
+
+    /**
+     * \class suzu::SnapGuides
+     * \brief finds the alignments of dragged bounds with the boxes of a diagram
+     *
+     * The left edges, centers and right edges of all boxes are kept in one array sorted by
+     * position, and their top edges, centers and bottom edges in another. Snapping the three
+     * anchors of the dragged bounds on an axis is thus a binary search for every anchor followed
+     * by a scan of the positions within the tolerance, however many boxes the diagram contains.
+     *
+     * *sync()* follows the changes of the store: only the boxes inside regions changed since the
+     * last call are looked at again, each costing one removal from and insertion into the sorted
+     * arrays. Associations and hidden elements are no snap targets.
+     *
+     * \note  The guides are not thread-safe.
+     */
+    class SnapGuides {
+    public:
+        static constexpr size_t gl_maxregions = 256;   /**< changed regions from which the arrays are built anew */
+        static constexpr float  gl_epsilon    = 1e-3f; /**< positions closer than this are treated as equal */
+
+        /**
+         * \enum  suzu::SnapGuides::Anchor
+         * \brief position on a box that aligns with other boxes
+         */
+        enum Anchor : uint32_t {
+            Start,  /**< left or top edge */
+            Center, /**< horizontal or vertical center */
+            End,    /**< right or bottom edge */
+
+            __NumAnchors__ /**< (only used internally) */
+        };
+
+    private:
+        /**
+         * \struct suzu::SnapGuides::Entry
+         * \brief  position of an anchor of a box
+         */
+        struct Entry {
+            float              pos;    /**< position on the axis */
+            Anchor             anchor; /**< anchor the position belongs to */
+            sdk::ElementHandle handle; /**< element the box belongs to */
+        };
+
+        std::array<std::vector<Entry>, 2> m_axes;  /**< anchors sorted by position, horizontal ones first */
+        std::vector<sdk::ElementRect>     m_boxes; /**< bounds of every box, by handle index */
+        std::vector<sdk::ElementHandle>   m_known; /**< handle of every box, by handle index; null if none */
+        size_t                            m_size;  /**< number of boxes */
+        uint64_t                          m_rev;   /**< revision of the store the arrays reflect; *UINT64_MAX* if none */
+
+    public:
+        SnapGuides() noexcept
+            : m_size(0), m_rev(UINT64_MAX)
+        { }
+
+        /**
+         * \brief  retrieves the number of boxes
+         *
+         * \return number of snap targets
+         */
+        size_t size() const noexcept { return m_size; }
+
+        /**
+         * \brief forgets all boxes, e.g. when another diagram is shown
+         */
+        void clear() noexcept;
+
+        /**
+         * \brief brings the boxes up to date with a store
+         *
+         * Looks only at the regions changed since the last call; builds the arrays anew if the
+         * store's change log no longer reaches back that far, or too many regions changed.
+         *
+         * \param [in] store diagram
+         * \throw std::bad_alloc
+         */
+        void sync(sdk::ElementStore const &store);
+
+        /**
+         * \brief  snaps dragged bounds to the closest alignments within a tolerance
+         *
+         * Each axis is snapped on its own, to the alignment of any anchor of the dragged bounds that
+         * needs the smallest offset. All boxes aligned at the snapped position on either axis
+         * contribute to the guides there.
+         *
+         * \param  [in] moving dragged bounds, before snapping
+         * \param  [in] tolerance maximum offset, in scene units; typically a few pixels divided by
+         *         the zoom factor
+         * \param  [in] exclude (optional) elements that are no snap targets, e.g. the dragged ones
+         *
+         * \return offsets and guides
+         * \throw  std::bad_alloc
+         */
+        SnapResult snap(sdk::ElementRect const &moving, float tolerance, std::unordered_set<sdk::ElementHandle> const *exclude = nullptr) const;
+
+    private:
+        /**
+         * \brief builds the arrays anew from all boxes of a store
+         *
+         * \param [in] store diagram
+         * \throw std::bad_alloc
+         */
+        void rebuild(sdk::ElementStore const &store);
+
+        /**
+         * \brief adds, moves or removes the box of an element
+         *
+         * \param [in] handle element
+         * \param [in] bounds new bounds; *nullptr* to remove the box
+         * \throw std::bad_alloc
+         */
+        void update(sdk::ElementHandle handle, sdk::ElementRect const *bounds);
+
+        /**
+         * \brief  snaps one axis of dragged bounds
+         *
+         * \param  [in] axis 0 for horizontal positions, 1 for vertical ones
+         * \param  [in] moving dragged bounds
+         * \param  [in] tolerance maximum offset
+         * \param  [in] exclude elements that are no snap targets; may be *nullptr*
+         * \param  [out] offset receives the offset; 0 if not snapped
+         *
+         * \return *true* if the axis was snapped
+         */
+        bool snapAxis(size_t axis, sdk::ElementRect const &moving, float tolerance, std::unordered_set<sdk::ElementHandle> const *exclude, float &offset) const;
+
+        /**
+         * \brief adds the guides of one snapped axis
+         *
+         * \param [in] axis 0 for horizontal positions, 1 for vertical ones
+         * \param [in] snapped dragged bounds, after snapping
+         * \param [in] exclude elements that are no snap targets; may be *nullptr*
+         * \param [in,out] res receives the guides
+         * \throw std::bad_alloc
+         */
+        void addGuides(size_t axis, sdk::ElementRect const &snapped, std::unordered_set<sdk::ElementHandle> const *exclude, std::vector<AlignmentGuide> &res) const;
+    };
+}
+
+
@@ -0,0 +1,210 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  imagecache.hpp
+ * \brief definition of the cache of images embedded in diagrams
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* external includes */
+#include <QByteArray>
+#include <QImage>
+#include <QObject>
+#include <QSize>
+
+/* sdk includes */
+#include <sdk/project.hpp>
+#include <sdk/task.hpp>
+
+
+namespace suzu {
+    constexpr uint32_t gl_chunkimage = sdk::MakeChunkType("IMAG"); /**< type of chunks holding an embedded image, encoded e.g. as PNG or JPEG, named by the image */
+
+
+    /**
+     * \class suzu::ImageCache
+     * \brief decoded images embedded in diagrams, e.g. screenshots and logos, at the resolutions
+     *        they are shown at
+     *
+     * Images are only registered with a function retrieving their encoded bytes (*add()*), so
+     * opening a project decodes nothing. An image is decoded once it is first shown (*find()*), in
+     * a low-priority task, and only at the *level* its size on screen needs: level *l* is the image
+     * downscaled by *2^l*, the coarsest level still at least as large as requested. JPEG images are
+     * decoded at that size directly; other formats are decoded and scaled down within the task, so
+     * full-size bitmaps are only kept while the image is shown that large.
+     *
+     * Until the level requested is ready, the nearest level cached stands in, finer ones first;
+     * painters draw it into the same rectangle. The levels are evicted to meet the memory budget
+     * shared by all caches (see *suzu::MemoryBudget*) and decoded again when they are requested.
+     *
+     * \note  The cache must only be used on the GUI thread.
+     */
+    class ImageCache final : public QObject {
+    public:
+        static constexpr uint32_t gl_levels = 8;   /**< number of levels, i.e. down to 1/128 of the full size */
+        static constexpr double   gl_cost   = 2.0; /**< cost of an evicted level for *suzu::MemoryBudget*; it is decoded again */
+
+        using SourceFn = std::function<QByteArray()>;    /**< retrieves the encoded image; called on a worker thread whenever a level is decoded, so it must be thread-safe */
+        using ReadyFn  = std::function<void(uint32_t)>; /**< called with the id of an image of which a level became ready */
+
+    private:
+        static constexpr uint32_t gl_probe = UINT32_MAX; /**< level of the first request of an image, while its full size is unknown */
+
+        /**
+         * \struct suzu::ImageCache::Entry
+         * \brief  registered image
+         */
+        struct Entry {
+            SourceFn source;            /**< retrieves the encoded image */
+            QSize    size;              /**< full size, in pixels; invalid until the image was first decoded */
+            bool     broken;            /**< whether or not the image could not be decoded */
+            QImage   levels[gl_levels]; /**< decoded levels; null unless cached */
+            int64_t  used[gl_levels];   /**< time every level was last requested, see *suzu::MemoryBudget::Now()* */
+        };
+
+        std::vector<Entry>                            m_entries; /**< images, by id */
+        std::unordered_map<uint64_t, sdk::TaskHandle> m_pending; /**< tasks decoding levels, by *id << 32 | level* */
+        size_t                                        m_bytes;   /**< memory used by all levels, in bytes */
+        uint64_t                                      m_gen;     /**< generation of the images; results of older ones are discarded */
+        ReadyFn                                       m_ready;   /**< receives finished levels */
+        uint32_t                                      m_budget;  /**< id of the cache in *suzu::MemoryBudget::Shared()*; 0 if not registered */
+
+    public:
+        /**
+         * \brief constructs a new, empty cache
+         *
+         * \param [in] parent (optional) parent object
+         */
+        explicit ImageCache(QObject *parent = nullptr) noexcept;
+        /**
+         * \brief cancels all pending levels and waits for the tasks decoding them, and leaves the
+         *        shared memory budget
+         */
+        ~ImageCache() override;
+
+        /**
+         * \brief  creates a source reading an image from a chunk of a project file
+         *
+         * \param  [in] reader reader of the project; must stay open as long as the image is
+         *                     registered
+         * \param  [in] name name of the chunk (type *gl_chunkimage*)
+         *
+         * \return source; retrieves an empty array if the chunk is missing or corrupt
+         */
+        static SourceFn ChunkSource(sdk::ProjectReader const &reader, std::string name);
+
+        /**
+         * \brief  registers an image; nothing is decoded yet
+         *
+         * \param  [in] source retrieves the encoded image
+         *
+         * \return id of the image, or *UINT32_MAX* if memory ran out
+         */
+        uint32_t add(SourceFn source) noexcept;
+
+        /**
+         * \brief removes all images, cancels the pending levels and waits for the tasks decoding
+         *        them, e.g. before the project is closed
+         */
+        void clear() noexcept;
+
+        /**
+         * \brief sets the function receiving finished levels, e.g. to repaint the canvas
+         *
+         * \param [in] fn function; called on the GUI thread
+         */
+        void setReadyHandler(ReadyFn fn) noexcept { m_ready = std::move(fn); }
+
+        /**
+         * \brief  retrieves an image for the size it is shown at, requesting the level that size
+         *         needs if it is not ready yet
+         *
+         * \param  [in] id id of the image
+         * \param  [in] pixels size the image is shown at, in device pixels
+         *
+         * \return the level needed, or the nearest cached level while it is being decoded; *nullptr*
+         *         if no level is ready or the image cannot be decoded; valid until the next call to
+         *         *clear()* or until the shared memory budget is enforced
+         */
+        QImage const *find(uint32_t id, QSize const &pixels) noexcept;
+
+        /**
+         * \brief  retrieves the full size of an image without decoding it
+         *
+         * \param  [in] id id of the image
+         *
+         * \return size in pixels; invalid if the image was not decoded yet
+         */
+        QSize sizeOf(uint32_t id) const noexcept { return id < m_entries.size() ? m_entries[id].size : QSize(); }
+
+        size_t size() const noexcept  { return m_entries.size(); }
+        size_t bytes() const noexcept { return m_bytes; }
+
+        /**
+         * \brief  computes the level of an image needed for the size it is shown at
+         *
+         * \param  [in] size full size of the image, in pixels
+         * \param  [in] pixels size the image is shown at, in device pixels
+         *
+         * \return level, less than *gl_levels*
+         */
+        static uint32_t LevelOf(QSize const &size, QSize const &pixels) noexcept;
+
+        /**
+         * \brief  computes the size of a level
+         *
+         * \param  [in] size full size of the image, in pixels
+         * \param  [in] level level
+         *
+         * \return size of the level, in pixels; at least 1 x 1
+         */
+        static QSize LevelSize(QSize const &size, uint32_t level) noexcept;
+
+    private:
+        /**
+         * \brief starts decoding a level unless it is pending already
+         *
+         * \param [in] id id of the image
+         * \param [in] level level to decode; *gl_probe* while the full size is unknown
+         * \param [in] pixels size the image is shown at, in device pixels
+         */
+        void request(uint32_t id, uint32_t level, QSize const &pixels) noexcept;
+
+        /**
+         * \brief stores a decoded level; called on the GUI thread
+         *
+         * \param [in] id id of the image
+         * \param [in] requested level requested, as in *m_pending*
+         * \param [in] level level decoded
+         * \param [in] gen generation of the images it was requested in
+         * \param [in] size full size of the image; invalid if it could not be decoded
+         * \param [in] image decoded level; null if it could not be decoded
+         */
+        void deliver(uint32_t id, uint32_t requested, uint32_t level, uint64_t gen, QSize size, QImage image) noexcept;
+
+        /**
+         * \brief  finds the least recently requested level that is cached
+         *
+         * \return *id << 32 | level*, or *UINT64_MAX* if no level is cached
+         */
+        uint64_t coldest() const noexcept;
+    };
+}
+
+
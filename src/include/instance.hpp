@@ -0,0 +1,87 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  instance.hpp
+ * \brief definition of the single-instance mode
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* external includes */
+#include <QLocalServer>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+
+
+namespace suzu {
+    constexpr std::string_view gl_newinstflag = "--new-instance"; /**< command-line flag disabling the single-instance mode */
+    constexpr int              gl_insttimeout = 500;              /**< time, in milliseconds, to wait for the running instance */
+
+
+    /**
+     * \brief  forwards the command-line to an already running instance
+     *
+     * Relative file paths are made absolute so that the receiving instance can resolve them
+     * regardless of its working directory. The function is meant to be called before anything
+     * else is initialized, so that a second launch exits right away.
+     *
+     * \param  [in] argc number of elements in *argv*
+     * \param  [in] argv command-line parameters
+     *
+     * \return *true* if a running instance accepted the command-line, *false* if there is no
+     *         running instance or the command-line contains *--new-instance*
+     */
+    bool ForwardToRunningInstance(int argc, char **argv) noexcept;
+
+
+    /**
+     * \class suzu::InstanceServer
+     * \brief receives the command-lines of subsequent launches
+     *
+     * While the server is listening, later launches of the application hand their command-line
+     * over to this instance and exit, see *suzu::ForwardToRunningInstance()*.
+     *
+     * \note  The server must be created and destroyed on the main thread.
+     */
+    class InstanceServer {
+    public:
+        /**
+         * \brief receives the command-line of a later launch, without the program name
+         */
+        using Handler = std::function<void(std::vector<std::string> const &)>;
+
+    private:
+        std::unique_ptr<QLocalServer> m_server;  /**< local socket server */
+        Handler                       m_handler; /**< invoked for every received command-line */
+
+    public:
+        /**
+         * \brief  starts listening for subsequent launches
+         *
+         * \param  [in] handler function invoked on the main thread for every received command-line
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if
+         *         the server is already listening, *suzu::sdk::ErrorCode::CriticalResource* if the
+         *         local socket could not be created
+         */
+        sdk::ErrorCode listen(Handler handler) noexcept;
+    };
+}
+
+
@@ -0,0 +1,182 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  jobs.hpp
+ * \brief definition of the background job manager
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/* external includes */
+#include <QObject>
+
+/* sdk includes */
+#include <sdk/task.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        struct JobRecord;
+    }
+
+
+    /**
+     * \struct suzu::JobStatus
+     * \brief  progress of a background job, as delivered to the GUI thread
+     */
+    struct JobStatus {
+        /**
+         * \enum  suzu::JobStatus::State
+         * \brief life-cycle state of a job
+         */
+        enum State {
+            Running,   /**< job is queued or running */
+            Finished,  /**< job has completed successfully */
+            Failed,    /**< job function returned *false* or threw */
+            Cancelled  /**< job was cancelled */
+        };
+
+        uint64_t    id;       /**< id of the job, as returned by *suzu::JobManager::start()* */
+        std::string name;     /**< human-readable name of the job */
+        State       state;    /**< current state */
+        double      progress; /**< progress in [0, 1] */
+        std::string text;     /**< description of the current step */
+    };
+
+
+    /**
+     * \class suzu::JobContext
+     * \brief interface of a running job to the job manager
+     *
+     * \note  All functions may be called from any thread.
+     */
+    class JobContext {
+        std::shared_ptr<internal::JobRecord> m_rec; /**< state of the job */
+
+    public:
+        explicit JobContext(std::shared_ptr<internal::JobRecord> rec) noexcept
+            : m_rec(std::move(rec))
+        { }
+
+        /**
+         * \brief  retrieves whether or not the job has been asked to stop
+         *
+         * Jobs should poll this regularly and return early once it is set.
+         *
+         * \return *true* if the job was cancelled
+         */
+        bool isCancelled() const noexcept;
+
+        /**
+         * \brief reports the progress of the job
+         *
+         * Updates are coalesced: the GUI thread only ever receives the most recent progress, at
+         * most at the rate configured for the job manager. Reporting is therefore cheap enough to
+         * be done for every processed item.
+         *
+         * \param [in] progress progress in [0, 1]
+         * \param [in] text (optional) description of the current step
+         */
+        void report(double progress, std::string text = {}) noexcept;
+    };
+
+
+    /**
+     * \class suzu::JobManager
+     * \brief runs long operations off the event loop and reports their progress to the GUI thread
+     *
+     * Jobs run as tasks on the SDK's task scheduler. Status updates are posted to the thread that
+     * created the job manager (i.e., the main thread) and delivered to the listener there; they are
+     * throttled so that busy jobs do not flood the Qt event queue.
+     */
+    class JobManager {
+        friend class JobContext;
+
+    public:
+        /**
+         * \brief job function; returns *false* if the job failed
+         */
+        using Job      = std::function<bool(JobContext &)>;
+        /**
+         * \brief receives status updates on the GUI thread
+         */
+        using Listener = std::function<void(JobStatus const &)>;
+
+    private:
+        std::unique_ptr<QObject>                                           m_context;  /**< receiver of posted updates; lives on the GUI thread */
+        int64_t                                                            m_interval; /**< minimum time between two updates of a job, in nanoseconds */
+        Listener                                                           m_listener; /**< listener; only accessed on the GUI thread */
+        std::mutex                                                         m_lock;     /**< guards *m_jobs* and *m_nextid* */
+        std::unordered_map<uint64_t, std::shared_ptr<internal::JobRecord>> m_jobs;     /**< jobs whose final status has not been delivered yet */
+        uint64_t                                                           m_nextid;   /**< id of the next job */
+
+    public:
+        /**
+         * \brief constructs a new job manager
+         *
+         * \param [in] maxrate maximum number of status updates delivered per job and second; 0 for no limit
+         */
+        explicit JobManager(uint32_t maxrate = 10);
+        JobManager(JobManager const &) = delete;
+        JobManager &operator =(JobManager const &) = delete;
+        /**
+         * \brief cancels all jobs and waits for them to finish
+         *
+         * Updates that have not been delivered yet are discarded.
+         */
+        ~JobManager();
+
+        /**
+         * \brief sets the listener receiving all status updates
+         *
+         * \param [in] listener listener; invoked on the GUI thread
+         */
+        void setListener(Listener listener) noexcept;
+
+        /**
+         * \brief  starts a new background job
+         *
+         * \param  [in] name human-readable name of the job
+         * \param  [in] job job function
+         * \param  [in] prio scheduling priority of the job
+         *
+         * \return id of the job; 0 if the job could not be started
+         */
+        uint64_t start(std::string name, Job job, sdk::TaskPriority prio = sdk::TaskPriority::Normal) noexcept;
+
+        /**
+         * \brief  requests cancellation of a job
+         *
+         * \param  [in] id id of the job
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         there is no unfinished job with the given id
+         */
+        sdk::ErrorCode cancel(uint64_t id) noexcept;
+
+    private:
+        /**
+         * \brief posts the current status of *rec* to the GUI thread, unless an update is pending already
+         *
+         * \param [in] rec job to post the status of
+         */
+        void post(std::shared_ptr<internal::JobRecord> const &rec) noexcept;
+    };
+}
+
+
@@ -0,0 +1,90 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  memoryview.hpp
+ * \brief diagnostics of the memory used by every subsystem
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <vector>
+
+/* external includes */
+#include <QAbstractTableModel>
+#include <QTreeView>
+
+/* sdk includes */
+#include <sdk/memory.hpp>
+
+
+namespace suzu {
+    /**
+     * \enum  suzu::MemoryColumn
+     * \brief columns of the memory diagnostics, in order
+     */
+    enum class MemoryColumn {
+        Account, /**< name of the account */
+        Tracked, /**< explicitly reported memory */
+        Heap,    /**< live heap memory */
+        Peak,    /**< largest live heap memory */
+        Allocs,  /**< number of heap allocations */
+
+        __NumMemoryColumns__ /**< (only used internally) */
+    };
+
+
+    /**
+     * \class suzu::MemoryUsageModel
+     * \brief snapshot of the memory accounts of the application and its plug-ins (see
+     *        *suzu::sdk::MemoryAccounts*), one row per account
+     *
+     * Sizes are shown in KiB. Heap columns stay at zero unless the application or a plug-in is
+     * built with *SZSDK_MEMTRACK*, as the Debug configuration of the application is.
+     *
+     * \note  The model does not observe the accounts. Call *refresh()* to take a new snapshot,
+     *        e.g. from a timer.
+     */
+    class MemoryUsageModel final : public QAbstractTableModel {
+        static constexpr int gl_columns = static_cast<int>(MemoryColumn::__NumMemoryColumns__); /**< number of columns */
+
+        std::vector<sdk::MemoryAccounts::Usage> m_rows; /**< shown snapshot, by account id */
+
+    public:
+        explicit MemoryUsageModel(QObject *parent = nullptr) noexcept;
+
+        /**
+         * \brief attaches a model to a view, with settings suited to the memory diagnostics
+         *
+         * \param [in,out] view view of the diagnostics
+         * \param [in] model model to show
+         */
+        static void Attach(QTreeView &view, MemoryUsageModel &model);
+
+        /**
+         * \brief takes a new snapshot of all accounts
+         */
+        void refresh();
+
+        int      rowCount(QModelIndex const &parent = QModelIndex()) const override;
+        int      columnCount(QModelIndex const &parent = QModelIndex()) const override;
+        QVariant data(QModelIndex const &index, int role = Qt::DisplayRole) const override;
+        QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    };
+
+
+    /**
+     * \brief writes the usage of every account that holds memory or allocated any to the debug log
+     */
+    void LogMemoryUsage() noexcept;
+}
+
+
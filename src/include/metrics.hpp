@@ -0,0 +1,303 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  metrics.hpp
+ * \brief counters, gauges and histograms of the application, and their export for telemetry
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* external includes */
+#include <QTimer>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::Metrics
+     * \brief registry of the metrics of the application, accumulated per thread without locks
+     *
+     * Metrics are registered by name and kind; the returned id is used to update them:
+     *
+     *  - *counters* only grow, e.g. the number of saves;
+     *  - *gauges* hold the last value set, e.g. the startup time;
+     *  - *histograms* count durations in *gl_buckets* buckets of fixed bounds: bucket 0 holds
+     *    durations below 1 µs, bucket *i* those below 2^*i* µs, and the last bucket all longer
+     *    ones. The sum of all durations is kept as well.
+     *
+     * Every thread updating a counter or histogram does so in a shard of its own, with plain
+     * loads and stores; shards are allocated on first use and kept for the lifetime of the
+     * registry. *snapshot()* sums up all shards while threads keep updating them.
+     *
+     * \note  The registry must outlive all threads updating it.
+     */
+    class Metrics {
+    public:
+        static constexpr uint32_t gl_maxcells = 1024; /**< number of values per shard; a counter takes one, a histogram *gl_buckets* + 1 */
+        static constexpr uint32_t gl_buckets  = 24;   /**< number of buckets of every histogram */
+
+        /**
+         * \enum  suzu::Metrics::Kind
+         * \brief kind of a metric
+         */
+        enum class Kind : uint8_t {
+            Counter,  /**< growing count */
+            Gauge,    /**< last value set */
+            Histogram /**< distribution of durations */
+        };
+
+        /**
+         * \struct suzu::Metrics::Value
+         * \brief  snapshot of a single metric
+         */
+        struct Value {
+            std::string                         name;    /**< name of the metric */
+            Kind                                kind;    /**< kind of the metric */
+            int64_t                             value;   /**< count of a counter or value of a gauge; sum of all durations of a histogram, in nanoseconds */
+            std::array<uint64_t, gl_buckets>    buckets; /**< counts of a histogram, by bucket; zero otherwise */
+        };
+
+    private:
+        /**
+         * \struct suzu::Metrics::Metric
+         * \brief  registered metric
+         */
+        struct Metric {
+            std::string name; /**< name of the metric */
+            Kind        kind; /**< kind of the metric */
+            uint32_t    cell; /**< first value of the metric in every shard */
+        };
+
+        /**
+         * \struct suzu::Metrics::Shard
+         * \brief  values of all metrics updated by a single thread; gauges live in *m_gauges*
+         */
+        struct Shard {
+            std::atomic<int64_t> cells[gl_maxcells]; /**< values; only written by the owning thread */
+        };
+
+        mutable std::mutex                  m_lock;    /**< guards registration and *m_shards* */
+        std::vector<Metric>                 m_metrics; /**< registered metrics */
+        std::vector<std::unique_ptr<Shard>> m_shards;  /**< shards of all threads that updated a metric */
+        std::unique_ptr<Shard>              m_gauges;  /**< values of all gauges, written by any thread */
+        uint32_t                            m_ncells;  /**< number of values assigned to metrics */
+
+    public:
+        Metrics() noexcept;
+        Metrics(Metrics const &) = delete;
+        Metrics &operator =(Metrics const &) = delete;
+
+        /**
+         * \brief  retrieves the registry of the application
+         *
+         * \return reference to the registry
+         */
+        static Metrics &Local() noexcept;
+
+        /**
+         * \brief  registers a metric, or retrieves it if it is registered already
+         *
+         * \param  [in] name name of the metric, e.g. "project.save"
+         * \param  [in] kind kind of the metric
+         *
+         * \return id of the metric, or 0 if a metric of the same name but another kind exists or
+         *         all values are assigned; updating metric 0 does nothing
+         */
+        uint32_t add(std::string_view name, Kind kind) noexcept;
+
+        /**
+         * \brief increments a counter
+         *
+         * \param [in] id id of the counter
+         * \param [in] delta (optional) increment
+         */
+        void count(uint32_t const id, int64_t const delta = 1) noexcept {
+            if (Shard *const shard = id != 0 ? this->shard() : nullptr)
+                Accumulate(shard->cells[id - 1], delta);
+        }
+
+        /**
+         * \brief sets a gauge
+         *
+         * \param [in] id id of the gauge
+         * \param [in] value new value
+         */
+        void set(uint32_t const id, int64_t const value) noexcept {
+            if (id != 0)
+                m_gauges->cells[id - 1].store(value, std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief adds a duration to a histogram
+         *
+         * \param [in] id id of the histogram
+         * \param [in] ns duration, in nanoseconds
+         */
+        void observe(uint32_t const id, int64_t const ns) noexcept {
+            if (Shard *const shard = id != 0 ? this->shard() : nullptr) {
+                Accumulate(shard->cells[id - 1 + BucketOf(ns)], 1);
+                Accumulate(shard->cells[id - 1 + gl_buckets], ns);
+            }
+        }
+
+        /**
+         * \brief  sums up the values of all metrics, over all threads
+         *
+         * \return one entry per metric, in order of registration
+         * \throw  std::bad_alloc
+         */
+        std::vector<Value> snapshot() const;
+
+        /**
+         * \brief  maps a duration onto its histogram bucket
+         *
+         * \param  [in] ns duration, in nanoseconds
+         *
+         * \return bucket index
+         */
+        static uint32_t BucketOf(int64_t ns) noexcept;
+
+    private:
+        /**
+         * \brief adds to a value only written by the calling thread
+         *
+         * \param [in,out] cell value
+         * \param [in] delta increment
+         */
+        static void Accumulate(std::atomic<int64_t> &cell, int64_t const delta) noexcept {
+            cell.store(cell.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief  retrieves the shard of the calling thread, allocating it on first use
+         *
+         * \return shard, or *nullptr* if it could not be allocated
+         */
+        Shard *shard() noexcept;
+    };
+
+
+    /**
+     * \class suzu::MetricTimer
+     * \brief adds the lifetime of this object to a histogram
+     */
+    class MetricTimer {
+        uint32_t                              m_id;    /**< id of the histogram */
+        std::chrono::steady_clock::time_point m_begin; /**< construction time */
+
+    public:
+        explicit MetricTimer(uint32_t const id) noexcept
+            : m_id(id), m_begin(std::chrono::steady_clock::now())
+        { }
+        MetricTimer(MetricTimer const &) = delete;
+        MetricTimer &operator =(MetricTimer const &) = delete;
+        ~MetricTimer() {
+            Metrics::Local().observe(m_id, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_begin).count());
+        }
+    };
+
+
+    /**
+     * \class suzu::MetricsExporter
+     * \brief periodically writes a snapshot of all metrics to a file or UDP target, for fleet
+     *        telemetry
+     *
+     * The target (key "/metrics/target") is either a path, or *udp://<IPv4 address>:<port>*; the
+     * export is disabled while it is empty. Every *interval* (key "/metrics/interval", in seconds)
+     * and once more when stopped, a snapshot is written as a single line of JSON:
+     *
+     *     {"time":<ms since the Unix epoch>,"host":"<host name>","counters":{"<name>":<count>,...},
+     *      "gauges":{"<name>":<value>,...},"histograms":{"<name>":{"sum":<ms>,"buckets":[...]},...}}
+     *
+     * Trailing empty buckets are omitted. Files are replaced atomically, so they always hold the
+     * latest complete snapshot; every datagram holds one snapshot.
+     *
+     * \note  The exporter must only be used on the GUI thread.
+     */
+    class MetricsExporter {
+        struct Transport;
+
+        std::string                m_target;    /**< file path or UDP target */
+        uint32_t                   m_interval;  /**< interval between snapshots, in seconds */
+        std::unique_ptr<QTimer>    m_timer;     /**< writes snapshots */
+        std::unique_ptr<Transport> m_transport; /**< UDP socket; *nullptr* for files */
+
+    public:
+        /**
+         * \brief constructs a stopped exporter
+         *
+         * \param [in] target file path or UDP target; empty to disable the exporter
+         * \param [in] interval interval between snapshots, in seconds; 0 to only write one when
+         *             stopped
+         */
+        MetricsExporter(std::string target, uint32_t interval) noexcept;
+        MetricsExporter(MetricsExporter const &) = delete;
+        MetricsExporter &operator =(MetricsExporter const &) = delete;
+        /**
+         * \brief stops the exporter, writing a last snapshot
+         */
+        ~MetricsExporter();
+
+        /**
+         * \brief  starts writing snapshots
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if the
+         *         exporter is disabled, *suzu::sdk::ErrorCode::InvalidParameter* if the UDP target is
+         *         malformed, or *suzu::sdk::ErrorCode::CriticalResource* if the socket could not be
+         *         created
+         */
+        sdk::ErrorCode start() noexcept;
+
+        /**
+         * \brief stops writing snapshots and writes a last one, if started
+         */
+        void stop() noexcept;
+
+        bool isRunning() const noexcept { return m_timer != nullptr; }
+
+        /**
+         * \brief  writes a snapshot of all metrics to the target
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if the
+         *         exporter is not running, *suzu::sdk::ErrorCode::WriteFile* if the snapshot could
+         *         not be written or sent, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran
+         *         out
+         */
+        sdk::ErrorCode write() noexcept;
+
+        /**
+         * \brief  formats a snapshot as described above
+         *
+         * \param  [in] values values of all metrics
+         * \param  [in] host name of the host
+         * \param  [in] time time of the snapshot, in milliseconds since the Unix epoch
+         *
+         * \return single line of JSON
+         * \throw  std::bad_alloc
+         */
+        static std::string Format(std::vector<Metrics::Value> const &values, std::string_view host, int64_t time);
+    };
+}
+
+
@@ -0,0 +1,156 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  minimap.hpp
+ * \brief definition of the minimap, an overview of the whole diagram
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/* external includes */
+#include <QImage>
+#include <QPointF>
+#include <QRectF>
+#include <QWidget>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+
+/* app includes */
+#include <renderer.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::MinimapWidget
+     * \brief overview of the whole diagram with the visible part of the canvas, e.g. in a dock
+     *
+     * The diagram is kept as a single downscaled rendering, sized to the widget, which painting
+     * only copies. Like the canvas, the minimap collects the regions changed in the store since its
+     * last repaint and re-renders only those parts of the image, so keeping it current costs about
+     * as much as the edits themselves. The image is rendered from scratch only when the widget is
+     * resized, the style sheet changes, or an element moves beyond the region it covers; the region
+     * includes a margin, so growing the diagram rarely does so. Owners call *update()* after
+     * modifying the store.
+     *
+     * Clicking or dragging reports the scene position under the cursor to the navigation handler,
+     * which is expected to center the canvas on it (see *suzu::DiagramCanvas::centerOn()*).
+     */
+    class MinimapWidget final : public QWidget {
+        Q_OBJECT
+
+    public:
+        using NavigateFn = std::function<void(QPointF const &)>; /**< called with the scene position to center the canvas on */
+
+    private:
+        static constexpr double gl_margin     = 0.1; /**< space added around the diagram on every side, relative to its size */
+        static constexpr size_t gl_maxpatches = 64;  /**< changed regions above which their common bounds are rendered at once */
+
+        sdk::ElementStore const      *m_store;    /**< displayed diagram; not owned */
+        DiagramRenderer               m_render;   /**< paints the elements */
+        QImage                        m_image;    /**< downscaled rendering of *m_extent* */
+        QRectF                        m_extent;   /**< region of the scene covered by *m_image* */
+        double                        m_scale;    /**< device pixels of *m_image* per scene unit */
+        bool                          m_valid;    /**< whether or not *m_image* reflects revision *m_seen* */
+        uint64_t                      m_seen;     /**< revision of the store the image reflects */
+        std::vector<sdk::ElementRect> m_changes;  /**< regions changed since *m_seen*; reused across repaints */
+        QRectF                        m_viewport; /**< visible part of the canvas, in scene coordinates */
+        NavigateFn                    m_navigate; /**< receives the positions clicked */
+
+    public:
+        /**
+         * \brief constructs a new, empty minimap
+         *
+         * \param [in] parent (optional) parent widget
+         */
+        explicit MinimapWidget(QWidget *parent = nullptr) noexcept;
+
+        /**
+         * \brief sets the displayed diagram
+         *
+         * \param [in] store elements to display; must outlive the minimap or be reset before
+         */
+        void setStore(sdk::ElementStore const *store) noexcept;
+
+        /**
+         * \brief sets the style sheet, e.g. that of the canvas
+         *
+         * \param [in] styles compiled style sheet; *nullptr* for the default appearance
+         */
+        void setStyles(std::shared_ptr<StyleSheet const> styles) noexcept;
+
+        /**
+         * \brief sets the visible part of the canvas, e.g. after it was scrolled or zoomed
+         *
+         * \param [in] visible visible region, in scene coordinates
+         */
+        void setViewport(QRectF const &visible) noexcept;
+
+        /**
+         * \brief sets the function receiving the positions clicked
+         *
+         * \param [in] fn function; called on the GUI thread
+         */
+        void setNavigateHandler(NavigateFn fn) noexcept { m_navigate = std::move(fn); }
+
+        QSize sizeHint() const override { return { 200, 150 }; }
+
+    protected:
+        void paintEvent(QPaintEvent *event) override;
+        void resizeEvent(QResizeEvent *event) override;
+        void mousePressEvent(QMouseEvent *event) override;
+        void mouseMoveEvent(QMouseEvent *event) override;
+
+    private:
+        /**
+         * \brief brings the image up-to-date with the store, rendering only the changed regions
+         */
+        void sync() noexcept;
+
+        /**
+         * \brief renders the whole diagram into a new image sized to the widget
+         */
+        void rebuild() noexcept;
+
+        /**
+         * \brief renders a region of the scene into the image again
+         *
+         * \param [in] region changed region, in scene coordinates; inside of *m_extent*
+         */
+        void patch(QRectF const &region) noexcept;
+
+        /**
+         * \brief  maps a widget position to scene coordinates
+         *
+         * \param  [in] pos position in widget coordinates
+         *
+         * \return position in scene coordinates
+         */
+        QPointF mapToScene(QPointF const &pos) const noexcept;
+
+        /**
+         * \brief  maps a scene region to widget coordinates
+         *
+         * \param  [in] region region in scene coordinates
+         *
+         * \return region in widget coordinates
+         */
+        QRectF mapFromScene(QRectF const &region) const noexcept;
+    };
+}
+
+
@@ -0,0 +1,141 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  modelcache.hpp
+ * \brief warm-start cache of opened projects
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/project.hpp>
+
+/* app includes */
+#include <search.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::ModelCache
+     * \brief warm-start cache of the state a project is opened into, so that reopening an unchanged
+     *        project skips decoding and indexing
+     *
+     * The cache of *<project>* is kept in *<project>.model*, itself a project file (see
+     * *sdk/project.hpp*) that is never compressed and has the journal folded in. Its diagrams can
+     * therefore always be mapped (see *suzu::sdk::ProjectReader::mapDiagram()*), even if the
+     * project is compressed, and no journal records are overlaid. Two more chunks hold the content
+     * hash of the project it was written for (see *suzu::sdk::ProjectReader::contentHash()*), and
+     * the search index (see *suzu::SearchIndex::serialize()*), which is restored without splitting
+     * a single name into trigrams. A cache of another hash is stale and ignored.
+     *
+     * The spatial index is not cached, as its grids are hash tables that would have to be filled
+     * from cached cells just like from the mapped bounds. Names are interned as the diagrams are
+     * mapped, since string ids are only valid within a process.
+     *
+     * \note  The cache is not thread-safe. On Windows, writing the cache fails while diagrams of the
+     *        previous cache are mapped.
+     */
+    class ModelCache {
+    public:
+        static constexpr uint32_t gl_version = 1; /**< format of the cache; bumped whenever the layout of the search index changes */
+
+        /**
+         * \struct suzu::ModelCache::Diagram
+         * \brief  diagram to cache
+         */
+        struct Diagram {
+            std::string_view         name;  /**< name of the diagram */
+            sdk::ElementStore const *store; /**< elements of the diagram */
+        };
+
+    private:
+        sdk::ProjectReader m_reader; /**< opened cache */
+
+    public:
+        ModelCache() noexcept = default;
+        ModelCache(ModelCache const &) = delete;
+        ModelCache &operator =(ModelCache const &) = delete;
+
+        /**
+         * \brief  retrieves the path of the cache of a project
+         *
+         * \param  [in] project path of the project file
+         *
+         * \return path of the cache
+         * \throw  std::bad_alloc
+         */
+        static std::string PathOf(std::string_view project);
+
+        /**
+         * \brief  writes the cache of a project, replacing the previous one
+         *
+         * \param  [in] project path of the project file
+         * \param  [in] hash content hash of the project as saved
+         * \param  [in] diagrams all diagrams of the project, in order, as saved
+         * \param  [in] search (optional) search index of the project; not cached if *nullptr*,
+         *         still being built or out of date
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::WriteFile* if the
+         *         cache could not be written; the previous cache remains untouched then
+         */
+        static sdk::ErrorCode Write(char const *project, uint64_t hash, std::vector<Diagram> const &diagrams, SearchIndex const *search = nullptr) noexcept;
+
+        /**
+         * \brief  opens the cache of a project
+         *
+         * \param  [in] project path of the project file
+         * \param  [in] hash content hash of the project as opened
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::OpenFile* if there is
+         *         no cache, *suzu::sdk::ErrorCode::ReadFile* if it is corrupt, or
+         *         *suzu::sdk::ErrorCode::InvalidState* if it is stale; the cache is closed then
+         */
+        sdk::ErrorCode open(char const *project, uint64_t hash) noexcept;
+
+        /**
+         * \brief closes the cache
+         *
+         * \note  Mapped diagrams are not affected.
+         */
+        void close() noexcept { m_reader.close(); }
+
+        bool isOpen() const noexcept { return m_reader.isOpen(); }
+
+        /**
+         * \brief  retrieves the diagrams of the cache
+         *
+         * \return reader of the cache; diagrams are in the order of the project
+         */
+        sdk::ProjectReader &reader() noexcept { return m_reader; }
+
+        /**
+         * \brief  restores the search index of the project
+         *
+         * \param  [in] diagrams all diagrams of the project, opened from the cache
+         * \param  [out] search receives the index
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the cache holds no search index, or the error of
+         *         *suzu::SearchIndex::restore()*; the index has to be built then
+         */
+        sdk::ErrorCode restoreSearch(std::vector<SearchIndex::Diagram> const &diagrams, SearchIndex &search) noexcept;
+    };
+}
+
+
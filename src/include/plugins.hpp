@@ -0,0 +1,278 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  plugins.hpp
+ * \brief definition of the plug-in manager
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/* external includes */
+#include <QLibrary>
+
+/* sdk includes */
+#include <sdk/changes.hpp>
+#include <sdk/plugin.hpp>
+
+/* app includes */
+#include <profiler.hpp>
+#include <remoteplugin.hpp>
+
+
+namespace suzu {
+    constexpr std::string_view gl_manifestname  = "manifest.json"; /**< file name of plug-in manifests */
+    constexpr std::string_view gl_pluginindex   = "index.cache";   /**< file name of the manifest index; stored in the plug-in directory */
+    constexpr int              gl_remotetimeout = 5000;            /**< time, in milliseconds, to wait for out-of-process plug-ins to start */
+    constexpr std::string_view gl_uicapability  = "ui.";           /**< prefix of capabilities contributing user interface; acquired after the first frame */
+
+
+    /**
+     * \struct suzu::PluginManifest
+     * \brief  static description of a plug-in, read without loading its library
+     *
+     * Manifests are stored as *manifest.json* in the plug-in's directory:
+     *
+     *     {
+     *         "name":         "uml-class",
+     *         "version":      "1.0.0",
+     *         "library":      "umlclass",
+     *         "capabilities": [ "diagram.class" ],
+     *         "extensions":   [ ".scd" ],
+     *         "toolbox":      [ "Class", "Interface" ],
+     *         "isolated":     false
+     *     }
+     *
+     * *library* is the base name of the shared library, relative to the plug-in's directory; the
+     * platform-specific prefix and suffix are added automatically. Plug-ins marked as *isolated*
+     * are run in a separate plug-in host process (see *suzu::RemotePlugin*). Plug-ins with a
+     * capability starting with *gl_uicapability*, e.g. "ui.panel", contribute user interface and are
+     * loaded once the first frame has been painted.
+     */
+    struct PluginManifest {
+        std::string              dir;          /**< directory of the plug-in */
+        std::string              name;         /**< unique name of the plug-in */
+        std::string              version;      /**< version string */
+        std::string              library;      /**< base name of the shared library */
+        std::vector<std::string> capabilities; /**< capabilities provided by the plug-in */
+        std::vector<std::string> extensions;   /**< file extensions handled by the plug-in */
+        std::vector<std::string> toolbox;      /**< toolbox entries contributed by the plug-in */
+        bool                     isolated;     /**< whether or not to run the plug-in out-of-process */
+    };
+
+
+    /**
+     * \class suzu::PluginManager
+     * \brief discovers plug-ins from their manifests and loads them on first use
+     *
+     * Discovering plug-ins only reads their manifests; the results are kept in a binary index so
+     * that unchanged manifests are not parsed again on the next start. A plug-in's library is only
+     * loaded once one of its capabilities is requested via *acquire()*. Startup cost therefore does
+     * not grow with the number of installed plug-ins.
+     *
+     * Every call into a plug-in goes through *invoke()*, which accounts its cost to the plug-in in
+     * the manager's profiler.
+     *
+     * In-process plug-ins can be reloaded while the application runs, e.g. after they were rebuilt;
+     * plug-ins exporting *gl_pluginsave* and *gl_pluginrestore* keep their state across reloading.
+     *
+     * \note  All functions are thread-safe.
+     */
+    class PluginManager {
+        /**
+         * \struct suzu::PluginManager::Entry
+         * \brief  a discovered plug-in
+         */
+        struct Entry {
+            PluginManifest                manifest;  /**< manifest of the plug-in */
+            std::unique_ptr<QLibrary>     library;   /**< loaded library; *nullptr* until first use */
+            std::unique_ptr<RemotePlugin> remote;    /**< plug-in host; *nullptr* unless isolated and in use */
+            sdk::ChangeBatchFn            onchanges; /**< change callback of a loaded library; may be *nullptr* */
+            std::vector<uint8_t>          state;     /**< state of an unloaded instance, restored by the next load; empty if none */
+            bool                          failed;    /**< whether or not loading the library failed before */
+        };
+
+        mutable std::mutex m_lock;     /**< guards *m_entries* and *m_host* */
+        std::string        m_dir;      /**< plug-in directory */
+        sdk::PluginHost    m_host;     /**< host resources passed to loaded plug-ins */
+        std::vector<Entry> m_entries;  /**< discovered plug-ins */
+        bool               m_isolate;  /**< whether or not to run all plug-ins out-of-process */
+        CallProfiler       m_profiler; /**< cost of all calls into plug-ins */
+
+    public:
+        /**
+         * \brief constructs a new plug-in manager
+         *
+         * \param [in] dir directory containing one sub-directory per plug-in
+         */
+        explicit PluginManager(std::string dir) noexcept;
+        PluginManager(PluginManager const &) = delete;
+        PluginManager &operator =(PluginManager const &) = delete;
+
+        /**
+         * \brief sets the host resources passed to plug-ins upon loading them
+         *
+         * \param [in] host host resources
+         */
+        void setHost(sdk::PluginHost const &host) noexcept;
+
+        /**
+         * \brief sets whether or not all plug-ins run out-of-process, regardless of their manifest
+         *
+         * \param [in] isolate whether or not to isolate all plug-ins
+         * \note  Only affects plug-ins that are loaded afterwards.
+         */
+        void setIsolation(bool isolate) noexcept;
+
+        /**
+         * \brief  discovers all plug-ins in the plug-in directory
+         *
+         * Manifests that are unchanged since the last scan are taken from the index; the index is
+         * rewritten if anything changed. Libraries are not loaded.
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if the
+         *         plug-in directory does not exist
+         */
+        sdk::ErrorCode scan() noexcept;
+
+        /**
+         * \brief  retrieves the manifests of all discovered plug-ins
+         *
+         * \return copy of all manifests
+         */
+        std::vector<PluginManifest> manifests() const;
+
+        /**
+         * \brief  loads the plug-in providing *capability*, unless it is loaded already
+         *
+         * \param  [in] capability capability to acquire
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         no plug-in provides the capability, *suzu::sdk::ErrorCode::CriticalResource* if the
+         *         plug-in could not be loaded or initialized
+         */
+        sdk::ErrorCode acquire(std::string_view capability) noexcept;
+
+        /**
+         * \brief  retrieves the name of the plug-in handling files with the given extension
+         *
+         * \param  [in] ext file extension, including the leading dot
+         *
+         * \return name of the plug-in; empty if there is none
+         * \note   The plug-in is not loaded by this function.
+         */
+        std::string findByExtension(std::string_view ext) const;
+
+        /**
+         * \brief  notifies all loaded plug-ins of the changes made by a single operation
+         *
+         * Every plug-in receives all changes in one call, regardless of their number. Plug-ins are
+         * notified in order of discovery; the first plug-in that rejects the batch stops the
+         * notification, and the caller is expected to roll back the entire operation.
+         *
+         * \param  [in] records changes, in the order they were applied
+         * \param  [in] count number of elements in *records*
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if all plug-ins accepted the changes,
+         *         *suzu::sdk::ErrorCode::NoOperation* if *count* is 0, otherwise the error returned
+         *         by the rejecting plug-in
+         * \note   Out-of-process plug-ins receive batches that do not fit into their message ring in
+         *         several parts.
+         */
+        sdk::ErrorCode notifyChanges(sdk::ChangeRecord const *records, size_t count) noexcept;
+
+        /**
+         * \brief  unloads the library of an in-process plug-in and loads it again
+         *
+         * No other call into plug-ins runs meanwhile. The plug-in drains its tasks and writes its
+         * state into a buffer of the manager (see *suzu::sdk::PluginSaveFn*), the library is
+         * unloaded and loaded again, its entry point is run with the same host resources, i.e. the
+         * loggers of the new instance write to the existing sinks, and the state is handed to the
+         * new instance (see *suzu::sdk::PluginRestoreFn*). If the library cannot be loaded, e.g.
+         * because it is being rebuilt, the state is kept until the next call to *reload()* loads
+         * it; *acquire()* does not retry the plug-in meanwhile.
+         *
+         * \param  [in] name name of the plug-in
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         there is no such plug-in or it runs out-of-process, *suzu::sdk::ErrorCode::NoOperation*
+         *         if it is not loaded, *suzu::sdk::ErrorCode::InvalidState* if it does not export a
+         *         serializer, or the error returned by the serializer; the old library stays loaded
+         *         then. *suzu::sdk::ErrorCode::CriticalResource* if the new library could not be
+         *         loaded or initialized; the old library has been unloaded by then.
+         *         *suzu::sdk::ErrorCode::InvalidState* if the new instance rejected the state; it
+         *         runs without it then.
+         * \note   On Windows, a loaded library cannot be overwritten; the build has to replace it
+         *         while it is unloaded, or the old file has to be renamed first.
+         */
+        sdk::ErrorCode reload(std::string_view name) noexcept;
+
+        /**
+         * \brief  retrieves the profiler accounting the cost of calls into plug-ins
+         *
+         * \return reference to the profiler; disabled by default
+         */
+        CallProfiler &profiler() noexcept { return m_profiler; }
+
+        /**
+         * \brief  calls into a plug-in, accounting the cost of the call
+         *
+         * Scratch memory allocated by the plug-in during the call (see *suzu::sdk::ScratchAllocate()*)
+         * is released once *fn* returns, so *fn* must consume all results stored there.
+         * Memory allocated during the call is charged to the account *"plugin/<name>"* (see
+         * *suzu::sdk::MemoryAccounts*).
+         *
+         * \param  [in] plugin name of the plug-in
+         * \param  [in] callback name of the callback
+         * \param  [in] fn function performing the call
+         *
+         * \return return value of *fn*
+         */
+        template<class Fn> decltype(auto) invoke(std::string_view plugin, std::string_view callback, Fn &&fn) {
+            sdk::Arena::Scope const scratch(sdk::Arena::ThreadLocal());
+            sdk::MemoryScope const  memory(MemoryAccount(plugin));
+
+            return m_profiler.measure(plugin, callback, std::forward<Fn>(fn));
+        }
+
+    private:
+        /**
+         * \brief  loads the library of an in-process plug-in, runs its entry point and restores the
+         *         state kept from the previous instance, if any
+         *
+         * \param  [in,out] entry plug-in; must not be loaded; *m_lock* must be held
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::CriticalResource* if
+         *         the library could not be loaded or initialized, *suzu::sdk::ErrorCode::InvalidState*
+         *         if it rejected the state; it is loaded nonetheless then
+         */
+        sdk::ErrorCode load(Entry &entry) noexcept;
+
+        /**
+         * \brief  retrieves the memory account of a plug-in
+         *
+         * \param  [in] plugin name of the plug-in
+         *
+         * \return id of the account *"plugin/<name>"*
+         */
+        static uint32_t MemoryAccount(std::string_view plugin) noexcept;
+    };
+}
+
+
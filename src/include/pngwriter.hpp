@@ -0,0 +1,136 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  pngwriter.hpp
+ * \brief definition of the streaming PNG encoder
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/* external includes */
+#include <QImage>
+#include <QSaveFile>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::PngWriter
+     * \brief writes a PNG image strip by strip, without ever holding the whole image
+     *
+     * Strips are horizontal bands of the image, encoded independently of each other by
+     * *Encode()*, so that they can be encoded on several threads at once, and then appended to the
+     * file in order. Each strip is compressed into its own deflate blocks that end on a byte
+     * boundary; appended one after another, they form the single zlib stream PNG requires.
+     *
+     * Images are written as 8-bit RGB. Compression is tuned for diagrams: every row is filtered
+     * (PNG filters *None*, *Sub* and *Up*) and runs of equal bytes are encoded as back-references,
+     * which shrinks the large uniform areas of diagrams to a small fraction of their size.
+     */
+    class PngWriter {
+    public:
+        /**
+         * \struct suzu::PngWriter::Strip
+         * \brief  encoded band of rows
+         */
+        struct Strip {
+            std::string data;  /**< compressed, filtered rows */
+            uint32_t    rows;  /**< number of rows */
+            uint32_t    adler; /**< Adler-32 checksum of the filtered rows */
+            uint64_t    size;  /**< size of the filtered rows, in bytes */
+        };
+
+    private:
+        std::unique_ptr<QSaveFile> m_file;   /**< file being written; *nullptr* if none is open */
+        uint32_t                   m_width;  /**< width of the image, in pixels */
+        uint32_t                   m_height; /**< height of the image, in pixels */
+        uint32_t                   m_rows;   /**< number of rows appended so far */
+        uint32_t                   m_adler;  /**< Adler-32 checksum of all rows appended so far */
+
+    public:
+        PngWriter() noexcept;
+        PngWriter(PngWriter const &) = delete;
+        PngWriter &operator =(PngWriter const &) = delete;
+        /**
+         * \brief discards an image that has not been committed
+         */
+        ~PngWriter();
+
+        /**
+         * \brief encodes a band of rows
+         *
+         * \param [in] image rows to encode, in *QImage::Format_RGB32*; as wide as the image
+         * \param [out] res receives the encoded rows
+         * \throw std::bad_alloc
+         * \note  This function is thread-safe.
+         */
+        static void Encode(QImage const &image, Strip &res);
+
+        /**
+         * \brief  starts writing an image
+         *
+         * \param  [in] path path of the PNG file
+         * \param  [in] width width of the image, in pixels
+         * \param  [in] height height of the image, in pixels
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the image is empty, or *suzu::sdk::ErrorCode::OpenFile* if the file could not be
+         *         created
+         */
+        sdk::ErrorCode open(char const *path, uint32_t width, uint32_t height) noexcept;
+
+        /**
+         * \brief  appends the next strip of the image
+         *
+         * \param  [in] strip strip returned by *Encode()*
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if no
+         *         image is open or the strip exceeds it, or *suzu::sdk::ErrorCode::WriteFile* if the
+         *         strip could not be written
+         */
+        sdk::ErrorCode append(Strip const &strip) noexcept;
+
+        /**
+         * \brief  finishes the image and replaces the file with it
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if no
+         *         image is open or rows are missing, or *suzu::sdk::ErrorCode::WriteFile* if the file
+         *         could not be written; the previous file remains untouched then
+         */
+        sdk::ErrorCode commit() noexcept;
+
+        /**
+         * \brief discards the image; the previous file remains untouched
+         */
+        void cancel() noexcept;
+
+    private:
+        /**
+         * \brief  writes a PNG chunk
+         *
+         * \param  [in] type type of the chunk; four characters
+         * \param  [in] data contents of the chunk
+         * \param  [in] size size of *data*, in bytes
+         *
+         * \return *true* if the chunk was written
+         */
+        bool writeChunk(char const *type, char const *data, size_t size) noexcept;
+    };
+}
+
+
@@ -0,0 +1,123 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  prefetch.hpp
+ * \brief definition of the predictive prefetching of diagram tiles
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <vector>
+
+/* external includes */
+#include <QPointF>
+#include <QSizeF>
+
+/* app includes */
+#include <diagramview.hpp>
+#include <tiles.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::TilePrefetcher
+     * \brief predicts the tiles a canvas is about to show from how its view moves
+     *
+     * While panning, the velocity of the view is smoothed over the last movements; the tiles the
+     * viewport will cover within *gl_lookahead* seconds are predicted, nearest first. After a wheel
+     * step, the tiles of the zoom factor that the next step in the same direction leads to are
+     * predicted, with the view zoomed around the same position. The predicted tiles are meant to
+     * be rendered at low priority, so they never delay the visible ones.
+     *
+     * *pan()* and *zoom()* report when the motion changes, i.e. the view starts moving, turns by
+     * more than *gl_maxturn*, or switches between panning and zooming; the requests of the former
+     * motion are then unlikely to be needed and should be canceled.
+     *
+     * \note  The prefetcher must only be used on the GUI thread.
+     */
+    class TilePrefetcher {
+    public:
+        static constexpr double gl_lookahead = 0.3;  /**< seconds of motion the tiles are predicted for */
+        static constexpr double gl_smoothing = 0.3;  /**< weight of the newest movement in the velocity */
+        static constexpr double gl_idle      = 0.2;  /**< seconds without movement after which the motion has ended */
+        static constexpr double gl_minspeed  = 50.0; /**< speed below which the view is still, in pixels per second */
+        static constexpr double gl_maxturn   = 0.7;  /**< cosine of the largest turn that continues a motion */
+        static constexpr size_t gl_maxtiles  = 64;   /**< maximum number of tiles predicted at once */
+
+    private:
+        /**
+         * \enum  suzu::TilePrefetcher::Motion
+         * \brief kind of the current motion
+         */
+        enum class Motion : uint32_t {
+            Still,   /**< the view does not move */
+            Panning, /**< the view is being panned */
+            Zooming  /**< the view is zoomed by the wheel */
+        };
+
+        Motion  m_motion;   /**< current motion */
+        QPointF m_origin;   /**< scene position shown in the top-left corner at the last movement */
+        QPointF m_velocity; /**< smoothed velocity of the origin, in scene units per second */
+        QPointF m_anchor;   /**< widget position of the last wheel step */
+        double  m_steps;    /**< wheel steps of the last wheel step */
+        double  m_time;     /**< time of the last movement, in seconds; negative if none */
+
+    public:
+        TilePrefetcher() noexcept
+            : m_motion(Motion::Still), m_steps(0.0), m_time(-1.0)
+        { }
+
+        /**
+         * \brief forgets the motion, e.g. after the view has jumped to another position
+         */
+        void reset() noexcept;
+
+        /**
+         * \brief  records that the view was panned
+         *
+         * \param  [in] view navigator after panning
+         * \param  [in] seconds time of the movement, in seconds
+         *
+         * \return *true* if the motion changed and earlier predictions should be canceled
+         */
+        bool pan(ViewNavigator const &view, double seconds) noexcept;
+
+        /**
+         * \brief  records that the view was zoomed by the wheel
+         *
+         * \param  [in] view navigator after zooming
+         * \param  [in] anchor widget position the view was zoomed around
+         * \param  [in] steps wheel steps; positive values zoom in
+         * \param  [in] seconds time of the step, in seconds
+         *
+         * \return *true* if the motion changed and earlier predictions should be canceled
+         */
+        bool zoom(ViewNavigator const &view, QPointF const &anchor, double steps, double seconds) noexcept;
+
+        /**
+         * \brief predicts the tiles likely to be shown next, excluding the visible ones
+         *
+         * \param [in] view current navigator
+         * \param [in] size size of the widget
+         * \param [in] ratio device pixel ratio of the screen showing the widget
+         * \param [in] seconds current time, in seconds; nothing is predicted once the motion has
+         *        ended
+         * \param [out] res receives at most *gl_maxtiles* keys, most likely next first; existing
+         *        contents are discarded
+         * \throw std::bad_alloc
+         */
+        void predict(ViewNavigator const &view, QSizeF const &size, double ratio, double seconds, std::vector<TileKey> &res) const;
+    };
+}
+
+
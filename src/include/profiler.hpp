@@ -0,0 +1,202 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  profiler.hpp
+ * \brief definition of the plug-in call profiler
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/memory.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::CallStats
+     * \brief thread-safe statistics of a single kind of call
+     *
+     * Latencies are recorded in a histogram with eight buckets per power of two, so percentiles
+     * are accurate to within about 12%.
+     */
+    class CallStats {
+        static constexpr size_t gl_nbuckets = 512; /**< number of histogram buckets */
+
+        std::atomic<uint64_t>                          m_count;  /**< number of calls */
+        std::atomic<uint64_t>                          m_total;  /**< total latency, in nanoseconds */
+        std::atomic<uint64_t>                          m_max;    /**< maximum latency, in nanoseconds */
+        std::atomic<uint64_t>                          m_allocs; /**< number of allocations */
+        std::atomic<uint64_t>                          m_bytes;  /**< number of bytes allocated */
+        std::array<std::atomic<uint64_t>, gl_nbuckets> m_hist;   /**< latency histogram */
+
+    public:
+        CallStats() noexcept;
+
+        /**
+         * \brief records a single call
+         *
+         * \param [in] ns latency of the call, in nanoseconds
+         * \param [in] allocs number of allocations made during the call
+         * \param [in] bytes number of bytes allocated during the call
+         */
+        void add(uint64_t ns, uint64_t allocs, uint64_t bytes) noexcept;
+
+        uint64_t count() const noexcept { return m_count.load(std::memory_order_relaxed); }
+        uint64_t total() const noexcept { return m_total.load(std::memory_order_relaxed); }
+        uint64_t max() const noexcept { return m_max.load(std::memory_order_relaxed); }
+        uint64_t allocs() const noexcept { return m_allocs.load(std::memory_order_relaxed); }
+        uint64_t bytes() const noexcept { return m_bytes.load(std::memory_order_relaxed); }
+
+        /**
+         * \brief  estimates a latency percentile
+         *
+         * \param  [in] p percentile in [0, 1]
+         *
+         * \return upper bound of the histogram bucket containing the percentile, in nanoseconds;
+         *         0 if no calls were recorded
+         */
+        uint64_t percentile(double p) const noexcept;
+    };
+
+
+    /**
+     * \class suzu::CallProfiler
+     * \brief per-plug-in cost accounting of host-to-plug-in calls
+     *
+     * Every call into a plug-in should go through *measure()*. When the profiler is disabled, this
+     * costs a single relaxed load; otherwise, two clock reads and a handful of atomic increments.
+     * Allocations are counted through the allocation hook of the SDK (see
+     * *suzu::sdk::MemoryAccounts::ThreadAllocations()*), which charges the host's accounts from
+     * every module built with *SZSDK_MEMTRACK*, including plug-ins that link their own C runtime.
+     * Other builds count no allocations, and allocating costs nothing extra there.
+     */
+    class CallProfiler {
+    public:
+        /**
+         * \struct suzu::CallProfiler::Row
+         * \brief  report of a single plug-in callback
+         */
+        struct Row {
+            std::string plugin;   /**< name of the plug-in */
+            std::string callback; /**< name of the callback */
+            uint64_t    count;    /**< number of calls */
+            uint64_t    total;    /**< total latency, in nanoseconds */
+            uint64_t    p50;      /**< median latency, in nanoseconds */
+            uint64_t    p99;      /**< 99th percentile latency, in nanoseconds */
+            uint64_t    max;      /**< maximum latency, in nanoseconds */
+            uint64_t    allocs;   /**< number of allocations */
+            uint64_t    bytes;    /**< number of bytes allocated */
+        };
+
+        /**
+         * \class suzu::CallProfiler::Scope
+         * \brief records a call covering the lifetime of this object
+         */
+        class Scope {
+            CallStats                            *m_stats; /**< statistics to update; *nullptr* if disabled */
+            std::chrono::steady_clock::time_point m_begin; /**< start time */
+            sdk::MemoryAccounts::Allocations      m_alloc; /**< allocation counters at start */
+
+        public:
+            Scope(CallProfiler &profiler, std::string_view plugin, std::string_view callback) noexcept;
+            Scope(Scope const &) = delete;
+            Scope &operator =(Scope const &) = delete;
+            ~Scope();
+        };
+
+    private:
+        /**
+         * \struct suzu::CallProfiler::KeyLess
+         * \brief  orders (plug-in, callback) keys; allows lookups without allocating a key
+         */
+        struct KeyLess {
+            using is_transparent = void;
+
+            template<class Lhs, class Rhs> bool operator ()(Lhs const &lhs, Rhs const &rhs) const noexcept {
+                int const cmp = std::string_view{ lhs.first }.compare(rhs.first);
+
+                return cmp < 0 || (cmp == 0 && std::string_view{ lhs.second } < std::string_view{ rhs.second });
+            }
+        };
+        using Key = std::pair<std::string, std::string>;
+
+        mutable std::mutex                                 m_lock;    /**< guards *m_stats* */
+        std::map<Key, std::unique_ptr<CallStats>, KeyLess> m_stats;   /**< statistics by plug-in and callback */
+        std::atomic<bool>                                  m_enabled; /**< whether or not calls are recorded */
+
+    public:
+        CallProfiler() noexcept
+            : m_enabled(false)
+        { }
+
+        /**
+         * \brief enables or disables recording
+         *
+         * \param [in] enabled whether or not to record calls
+         */
+        void setEnabled(bool enabled) noexcept { m_enabled.store(enabled, std::memory_order_relaxed); }
+        bool isEnabled() const noexcept { return m_enabled.load(std::memory_order_relaxed); }
+
+        /**
+         * \brief  invokes *fn* and records its cost for the given plug-in callback
+         *
+         * \param  [in] plugin name of the plug-in
+         * \param  [in] callback name of the callback
+         * \param  [in] fn function calling into the plug-in
+         *
+         * \return return value of *fn*
+         */
+        template<class Fn> decltype(auto) measure(std::string_view plugin, std::string_view callback, Fn &&fn) {
+            SZSDK_PROFILE_SCOPE("plug-in call");
+            Scope const scope(*this, plugin, callback);
+
+            return fn();
+        }
+
+        /**
+         * \brief  retrieves the statistics of all callbacks recorded so far
+         *
+         * \return one row per plug-in callback, sorted by total latency in descending order
+         */
+        std::vector<Row> report() const;
+
+        /**
+         * \brief logs the report, one line per plug-in callback
+         */
+        void logReport() const noexcept;
+
+    private:
+        /**
+         * \brief  retrieves the statistics of a callback, creating them if necessary
+         *
+         * \param  [in] plugin name of the plug-in
+         * \param  [in] callback name of the callback
+         *
+         * \return statistics; valid for the lifetime of the profiler; *nullptr* on error
+         */
+        CallStats *stats(std::string_view plugin, std::string_view callback) noexcept;
+    };
+}
+
+
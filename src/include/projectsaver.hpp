@@ -0,0 +1,164 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  projectsaver.hpp
+ * \brief definition of incremental project saving
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/compress.hpp>
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/task.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        struct SaverState;
+    }
+
+
+    /**
+     * \class suzu::ProjectSaver
+     * \brief saves a project incrementally, compacting its journal in the background
+     *
+     * Saving only appends the changed diagrams to the journal of the project (see
+     * *suzu::sdk::ProjectJournal*), so its cost depends on the size of the changes, not on the size
+     * of the project. Once the journal grows beyond the compaction threshold (key
+     * "/project/compact"), a background task folds it into a new project file. Saves may go on
+     * meanwhile; they are only held back while the new file replaces the old one. Project files
+     * are compressed as configured (key "/project/compress"); the journal is not compressed, so
+     * that saving stays cheap. Whenever the project file is written as a whole, by *saveAs()* or
+     * a compaction, its warm-start cache is written along (see *suzu::ModelCache*).
+     *
+     * \note  The saver must only be used on the GUI thread. On Windows, compaction fails while
+     *        diagrams of the project are mapped (see *suzu::sdk::ProjectReader::mapDiagram()*); it
+     *        is retried with the next save.
+     */
+    class ProjectSaver {
+    public:
+        /**
+         * \struct suzu::ProjectSaver::Diagram
+         * \brief  diagram to save
+         */
+        struct Diagram {
+            uint32_t                 index; /**< index of the diagram in the project; the number of diagrams to add one */
+            std::string_view         name;  /**< name of the diagram */
+            sdk::ElementStore const *store; /**< elements of the diagram */
+        };
+
+    private:
+        static inline uint64_t         gl_threshold   = uint64_t(16) << 20;      /**< journal size starting a compaction, in bytes; 0 for never */
+        static inline sdk::Compression gl_compression = sdk::Compression::None; /**< how hard to compress project files */
+
+        std::shared_ptr<internal::SaverState> m_state;      /**< project and journal; shared with the compaction task */
+        sdk::TaskHandle                       m_compaction; /**< running compaction, if any */
+
+    public:
+        ProjectSaver() noexcept = default;
+        ProjectSaver(ProjectSaver const &) = delete;
+        ProjectSaver &operator =(ProjectSaver const &) = delete;
+        /**
+         * \brief waits for a running compaction
+         */
+        ~ProjectSaver();
+
+        /**
+         * \brief sets the journal size at which projects are compacted
+         *
+         * \param [in] bytes threshold, in bytes; 0 to never compact in the background
+         */
+        static void SetCompactionThreshold(uint64_t bytes) noexcept;
+
+        /**
+         * \brief sets how hard project files are compressed by *saveAs()* and compactions
+         *
+         * \param [in] level compression level
+         */
+        static void SetCompression(sdk::Compression level) noexcept;
+
+        /**
+         * \brief  starts saving an existing project incrementally
+         *
+         * \param  [in] path path of the project file
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or the error of reading the project or
+         *         opening its journal
+         */
+        sdk::ErrorCode open(char const *path) noexcept;
+
+        /**
+         * \brief  writes a project as a whole and starts saving it incrementally
+         *
+         * \param  [in] path path of the project file
+         * \param  [in] diagrams all diagrams of the project, in order
+         * \param  [in] durable whether or not to flush the file to the storage device
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::WriteFile* if the
+         *         project could not be written; the previous file remains untouched then
+         */
+        sdk::ErrorCode saveAs(char const *path, std::vector<Diagram> const &diagrams, bool durable = false) noexcept;
+
+        /**
+         * \brief  saves changed diagrams by appending them to the journal
+         *
+         * \param  [in] diagrams changed diagrams
+         * \param  [in] durable whether or not to flush the journal to the storage device
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if no
+         *         project is open or its journal was lost, or *suzu::sdk::ErrorCode::WriteFile* if a
+         *         diagram could not be saved; the project has to be saved with *saveAs()* then
+         */
+        sdk::ErrorCode save(std::vector<Diagram> const &diagrams, bool durable = false) noexcept;
+
+        /**
+         * \brief  folds the journal into the project file, blocking until done
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if the
+         *         journal is empty, or the error that stopped the compaction; the journal is kept then
+         */
+        sdk::ErrorCode compact() noexcept;
+
+        bool isCompacting() const noexcept { return !m_compaction.isFinished(); }
+
+        /**
+         * \brief stops saving the project, waiting for a running compaction
+         */
+        void close() noexcept;
+
+    private:
+        /**
+         * \brief starts a background compaction if the journal has outgrown the threshold
+         */
+        void schedule() noexcept;
+
+        /**
+         * \brief  folds the journal of a project into a new project file
+         *
+         * \param  [in,out] state project and journal
+         * \param  [in] compression how hard to compress the new project file
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if the
+         *         journal is empty, or the error that stopped the compaction
+         */
+        static sdk::ErrorCode Compact(internal::SaverState &state, sdk::Compression compression) noexcept;
+    };
+}
+
+
@@ -0,0 +1,145 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  projectwatcher.hpp
+ * \brief definition of reloading open diagrams when their project file changes on disk
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/config.hpp>
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/project.hpp>
+
+/* app includes */
+#include <undo.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::ProjectWatcher
+     * \brief watches an open project file and applies changes made to it by other programs, e.g.
+     *        a *git checkout*, to the open diagrams
+     *
+     * The watcher keeps the version of the project it last synchronized with, the *base*. Once
+     * the file has not changed for a moment, its index is read again and the digest of every
+     * diagram (see *suzu::sdk::ProjectReader::diagramDigest()*) compared with that of the base;
+     * diagrams with equal digests are not even read. Only the changed diagrams that are open are
+     * loaded, from both versions, and compared element by element (see *suzu::sdk::DiffDiagrams()*).
+     *
+     * The differences are applied to the open diagram through its undo stack, as a single
+     * operation, so views, tile caches and indexes are updated from the consolidated changes like
+     * after any other edit, and the reload can be undone. Properties the user changed since the
+     * base, and elements the user changed or removed, are kept as they are, like the side *ours*
+     * of *suzu::sdk::MergeDiagrams()*. Saves of the application itself thus never revert newer
+     * edits. Kept elements keep their drawing order; added elements are drawn on top.
+     *
+     * Diagrams that were added, removed or renamed are only reported; the owner rereads the list
+     * of diagrams from *reader()* then, as for diagrams opened later.
+     *
+     * \note  The watcher requires an application instance and must only be used on its thread.
+     *        The journal of the project is read along with it, but changes of the journal alone
+     *        are not watched; only the application itself writes it.
+     */
+    class ProjectWatcher {
+    public:
+        /**
+         * \struct suzu::ProjectWatcher::Diagram
+         * \brief  open diagram of the project
+         */
+        struct Diagram {
+            std::string_view         name;  /**< name of the diagram */
+            sdk::ElementStore const *store; /**< elements of the diagram */
+            UndoStack               *undo;  /**< undo stack editing *store* */
+        };
+
+        /**
+         * \struct suzu::ProjectWatcher::Report
+         * \brief  outcome of a reload
+         */
+        struct Report {
+            uint32_t changed; /**< number of diagrams whose digest changed */
+            uint32_t patched; /**< number of open diagrams that were edited */
+            uint32_t edits;   /**< number of edits applied to them */
+            bool     listed;  /**< whether or not diagrams were added, removed or renamed */
+        };
+
+        using Source   = std::function<std::vector<Diagram>()>;    /**< retrieves the open diagrams of the project */
+        using Listener = std::function<void(Report const &report)>; /**< receives the outcome of reloads that changed anything */
+
+    private:
+        static constexpr uint32_t gl_debounce = 500; /**< quiet period before reloading, in milliseconds */
+
+        std::string                                m_path;     /**< path of the project file; empty while stopped */
+        Source                                     m_source;   /**< retrieves the open diagrams */
+        Listener                                   m_listener; /**< receives the outcome of reloads */
+        sdk::ProjectReader                         m_base;     /**< version of the project last synchronized with */
+        std::unique_ptr<sdk::internal::ConfigWatcher> m_watcher;  /**< file watcher; *nullptr* while stopped */
+
+    public:
+        ProjectWatcher() noexcept = default;
+        ProjectWatcher(ProjectWatcher const &) = delete;
+        ProjectWatcher &operator =(ProjectWatcher const &) = delete;
+        ~ProjectWatcher();
+
+        /**
+         * \brief  starts watching a project
+         *
+         * \param  [in] path path of the project file; the version on disk becomes the base
+         * \param  [in] source retrieves the open diagrams of the project; called on every reload
+         * \param  [in] listener (optional) receives the outcome of reloads that changed anything
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         *path* or *source* are empty, the error of reading the project, or
+         *         *suzu::sdk::ErrorCode::CriticalResource* if the file could not be watched
+         */
+        sdk::ErrorCode start(std::string path, Source source, Listener listener = {}) noexcept;
+
+        /**
+         * \brief  synchronizes the open diagrams with the project file right away
+         *
+         * \param  [out] report (optional) receives the outcome
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if the
+         *         project did not change, *suzu::sdk::ErrorCode::InvalidState* if not watching, the
+         *         error of reading the project, e.g. while it is still being written, or
+         *         *suzu::sdk::ErrorCode::CriticalResource* if a diagram could not be patched; its
+         *         edits are reverted then, and the base is kept so that the next reload retries
+         */
+        sdk::ErrorCode reload(Report *report = nullptr) noexcept;
+
+        /**
+         * \brief  retrieves the version of the project last synchronized with
+         *
+         * \return reader; diagrams opened from it reflect the file as of the last reload
+         */
+        sdk::ProjectReader &reader() noexcept { return m_base; }
+
+        bool isRunning() const noexcept { return !m_path.empty(); }
+
+        /**
+         * \brief stops watching the project; the open diagrams are not affected
+         */
+        void stop() noexcept;
+    };
+}
+
+
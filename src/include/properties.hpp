@@ -0,0 +1,148 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  properties.hpp
+ * \brief definition of the item model of the property editor
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+
+/* external includes */
+#include <QAbstractTableModel>
+#include <QTreeView>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/intern.hpp>
+
+/* app includes */
+#include <undo.hpp>
+
+
+namespace suzu {
+    /**
+     * \enum  suzu::PropertyRow
+     * \brief properties shown by the property editor, in the order of its rows
+     */
+    enum class PropertyRow {
+        Kind,   /**< kind of the elements; read-only */
+        Name,   /**< name */
+        X,      /**< left edge, in scene units */
+        Y,      /**< top edge, in scene units */
+        Width,  /**< width, in scene units */
+        Height, /**< height, in scene units */
+        Style,  /**< style id */
+        Hidden, /**< *suzu::sdk::ElementHidden* */
+        Locked, /**< *suzu::sdk::ElementLocked* */
+
+        __NumPropertyRows__ /**< (only used internally) */
+    };
+
+
+    /**
+     * \class suzu::PropertyEditorModel
+     * \brief properties of the selected elements of a diagram, for the property editor
+     *
+     * Each row is a property, aggregated over all selected elements: if they disagree, the value
+     * is shown as mixed (and flags as partially checked). The aggregates are computed in a single
+     * pass over the component arrays of the store, whatever the size of the selection; the model
+     * keeps no item per element. Editors are created by the view's delegate only for the cell
+     * being edited, so a selection of thousands of elements costs as many widgets as a single one.
+     *
+     * An edit applies the new value to all selected elements as a single entry of the undo stack,
+     * which is also delivered to the views as a single transaction. If it fails half-way, the
+     * elements changed so far are restored.
+     *
+     * \note  The model does not observe the store. Call *refresh()* after the selection or the
+     *        selected elements changed, e.g. when the consolidated changes are delivered.
+     */
+    class PropertyEditorModel final : public QAbstractTableModel {
+        static constexpr int gl_rows = static_cast<int>(PropertyRow::__NumPropertyRows__); /**< number of rows */
+
+        sdk::ElementStore const *m_store;          /**< diagram whose selection is shown; *nullptr* for none */
+        UndoStack               *m_undo;           /**< undo stack editing *m_store* */
+        uint32_t                 m_count;          /**< number of selected elements */
+        double                   m_value[gl_rows]; /**< value of every property of the first selected element; the name is kept in *m_name* */
+        bool                     m_mixed[gl_rows]; /**< whether or not the selected elements disagree on a property */
+        sdk::StringId            m_name;           /**< name of the first selected element */
+
+    public:
+        explicit PropertyEditorModel(QObject *parent = nullptr) noexcept;
+
+        /**
+         * \brief attaches a model to a view, with settings suited to the property editor
+         *
+         * \param [in,out] view view of the property editor
+         * \param [in] model model to show
+         */
+        static void Attach(QTreeView &view, PropertyEditorModel &model);
+
+        /**
+         * \brief shows the selection of another diagram
+         *
+         * \param [in] store diagram whose selected elements to show; *nullptr* for none
+         * \param [in] undo undo stack editing *store*; receives all edits
+         * \note  Both must outlive the model, or be replaced before they are destroyed.
+         */
+        void setStore(sdk::ElementStore const *store, UndoStack *undo);
+
+        /**
+         * \brief recomputes the aggregates after the selection or the selected elements changed
+         */
+        void refresh();
+
+        /**
+         * \brief  applies a value to all selected elements
+         *
+         * \param  [in] row property to change
+         * \param  [in] value new value; names are given as UTF-8, flags as 0 or 1
+         * \param  [in] name new name, for *suzu::PropertyRow::Name*
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if no
+         *         element changed, *suzu::sdk::ErrorCode::InvalidParameter* if the property is
+         *         read-only or the value is invalid, *suzu::sdk::ErrorCode::InvalidState* if no
+         *         diagram is shown, or *suzu::sdk::ErrorCode::CriticalResource* if an edit failed;
+         *         the elements are unchanged then
+         */
+        sdk::ErrorCode commit(PropertyRow row, double value, sdk::StringId name = {}) noexcept;
+
+        uint32_t selectionSize() const noexcept { return m_count; }
+
+        int           rowCount(QModelIndex const &parent = QModelIndex()) const override;
+        int           columnCount(QModelIndex const &parent = QModelIndex()) const override;
+        QVariant      data(QModelIndex const &index, int role = Qt::DisplayRole) const override;
+        bool          setData(QModelIndex const &index, QVariant const &value, int role = Qt::EditRole) override;
+        QVariant      headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+        Qt::ItemFlags flags(QModelIndex const &index) const override;
+
+    private:
+        /**
+         * \brief computes the aggregates of all properties in one pass over the store
+         */
+        void aggregate() noexcept;
+
+        /**
+         * \brief  retrieves the value of a property of an element
+         *
+         * \param  [in] row property, except *suzu::PropertyRow::Name*
+         * \param  [in] dense dense index of the element
+         *
+         * \return value
+         */
+        double valueOf(PropertyRow row, uint32_t dense) const noexcept;
+    };
+}
+
+
@@ -0,0 +1,192 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  remoteplugin.hpp
+ * \brief definition of out-of-process plug-ins
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/* external includes */
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QSharedMemory>
+#include <QThread>
+
+/* sdk includes */
+#include <sdk/changes.hpp>
+#include <sdk/error.hpp>
+#include <sdk/ipcring.hpp>
+
+
+namespace suzu {
+    constexpr std::string_view gl_pluginhostexe = "suzu-pluginhost"; /**< file name of the plug-in host executable */
+
+
+    /**
+     * \class suzu::RemotePlugin
+     * \brief plug-in running in a separate plug-in host process
+     *
+     * A crashing or hanging plug-in only takes down its host process. Requests and replies are
+     * exchanged through message rings in shared memory: *post()* only copies a message into the
+     * ring, *flush()* publishes all posted messages at once. A signal through a local socket is only
+     * sent if the other side is asleep, so a batch of requests costs at most one system call.
+     *
+     * The segment, the server, the socket and the process are created, used and destroyed on a
+     * thread of their own, whose event loop notices when the host exits. Calls from other threads
+     * are handed over to it, blocking; only the rings are accessed directly.
+     *
+     * \note  An instance must only be used by one thread at a time.
+     */
+    class RemotePlugin {
+        static constexpr int gl_spincount = 2000; /**< number of empty polls before waiting for a signal */
+
+        std::unique_ptr<QThread>       m_thread;   /**< thread owning all Qt objects below; *nullptr* until started */
+        std::unique_ptr<QObject>       m_context;  /**< object living on *m_thread*, which calls are handed over to */
+        std::unique_ptr<QSharedMemory> m_shm;      /**< segment holding both rings */
+        std::unique_ptr<QLocalServer>  m_server;   /**< server the host connects to */
+        QLocalSocket                  *m_sock;     /**< connection to the host; owned by *m_server* */
+        std::unique_ptr<QProcess>      m_proc;     /**< host process */
+        std::atomic<bool>              m_running;  /**< whether or not the host is running; updated on *m_thread* */
+        sdk::ipc::MessageRing          m_requests; /**< ring to the host */
+        sdk::ipc::MessageRing          m_replies;  /**< ring from the host */
+
+    public:
+        RemotePlugin() noexcept;
+        RemotePlugin(RemotePlugin const &) = delete;
+        RemotePlugin &operator =(RemotePlugin const &) = delete;
+        /**
+         * \brief asks the host to exit; kills it if it does not exit in time
+         */
+        ~RemotePlugin();
+
+        /**
+         * \brief  starts the host process and loads the plug-in there
+         *
+         * \param  [in] hostexe path of the plug-in host executable
+         * \param  [in] library path of the plug-in library
+         * \param  [in] timeout time, in milliseconds, to wait for the plug-in to be loaded
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::CriticalResource* if
+         *         the host could not be started or did not respond, otherwise the error returned by
+         *         the plug-in's entry point
+         */
+        sdk::ErrorCode start(std::string const &hostexe, std::string const &library, int timeout) noexcept;
+
+        /**
+         * \brief  retrieves whether or not the host process is running
+         *
+         * \return *true* if the host is running
+         */
+        bool isRunning() const noexcept { return m_running.load(std::memory_order_acquire); }
+
+        /**
+         * \brief  appends a request to the ring to the host; not visible to the host until *flush()*
+         *
+         * \param  [in] type message type
+         * \param  [in] data payload
+         * \param  [in] size size of the payload, in bytes
+         *
+         * \return *true* on success, *false* if the ring is full
+         */
+        bool post(uint32_t type, void const *data, uint32_t size) noexcept;
+
+        /**
+         * \brief publishes all posted requests and wakes the host if necessary
+         */
+        void flush() noexcept;
+
+        /**
+         * \brief  waits for replies and invokes *fn(type, data, size)* for each of them
+         *
+         * Returns as soon as at least one reply has been handled.
+         *
+         * \param  [in] fn reply handler
+         * \param  [in] timeout maximum time to wait, in milliseconds
+         *
+         * \return number of replies handled; 0 on timeout or if the host has exited
+         */
+        template<class Fn> size_t receive(Fn &&fn, int timeout) {
+            auto const deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+
+            for (int spin = 0;; ++spin) {
+                if (size_t const n = m_replies.drain(fn))
+                    return n;
+
+                /* Replies usually arrive within microseconds; only sleep if they do not. */
+                int const left = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count());
+                if (left <= 0 || !isRunning())
+                    return 0;
+                else if (spin < gl_spincount) {
+                    std::this_thread::yield();
+
+                    continue;
+                }
+
+                if (m_replies.prepareSleep())
+                    sleep(left);
+            }
+        }
+
+        /**
+         * \brief  measures the round-trip time to the host
+         *
+         * \param  [in] timeout maximum time to wait, in milliseconds
+         * \param  [out] rtt (optional) receives the round-trip time, in nanoseconds
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::CriticalResource* if
+         *         the host did not respond in time
+         */
+        sdk::ErrorCode ping(int timeout, int64_t *rtt = nullptr) noexcept;
+
+        /**
+         * \brief  delivers a batch of changes to the plug-in and waits for its verdict
+         *
+         * The records are copied into the ring as a single message. Batches larger than a quarter
+         * of the ring are split; delivery stops at the first part the plug-in rejects.
+         *
+         * \param  [in] batch changes to deliver
+         * \param  [in] timeout maximum time to wait for each part, in milliseconds
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if the plug-in accepted all changes,
+         *         *suzu::sdk::ErrorCode::CriticalResource* if the host did not respond in time,
+         *         otherwise the error returned by the plug-in
+         */
+        sdk::ErrorCode notifyChanges(sdk::ChangeBatch const &batch, int timeout) noexcept;
+
+    private:
+        /**
+         * \brief runs a function on the thread owning the Qt objects, waiting for it to return
+         *
+         * \param [in] fn function to run; must not throw
+         */
+        void run(std::function<void()> const &fn) noexcept;
+
+        /**
+         * \brief waits for a wake-up signal from the host
+         *
+         * \param [in] timeout maximum time to wait, in milliseconds
+         */
+        void sleep(int timeout) noexcept;
+    };
+}
+
+
@@ -0,0 +1,306 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  remoteproject.hpp
+ * \brief definition of reading project files from HTTP servers chunk by chunk
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* external includes */
+#include <QFile>
+#include <QNetworkAccessManager>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/project.hpp>
+#include <sdk/util.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::RemoteProject
+     * \brief reads a project file from an HTTP server, fetching only the chunks that are used
+     *
+     * Opening a project fetches its header and index with HTTP range requests, then the string
+     * table; diagrams and other chunks are fetched once they are first needed. Fetched bytes are
+     * written to a cache file on disk (key "/remote/cache") at the position they have in the
+     * project file, so the cache file is a sparse copy of the project that an ordinary
+     * *suzu::sdk::ProjectReader* reads, and diagrams are mapped from it like from any local file.
+     * Opening a project and showing one of its diagrams thus costs a few requests and the bytes
+     * of that diagram, regardless of the size of the project.
+     *
+     * Cache files are named after the identity of the project (see
+     * *suzu::sdk::ProjectReader::identity()*), which changes with every save, so a project that
+     * changed on the server never reads stale chunks. Chunks are validated against their hash
+     * before they are used; those already in the cache are not fetched again, even across
+     * sessions. Once the cache directory outgrows its limit (key "/remote/cachesize"), the least
+     * recently used cache files are deleted.
+     *
+     * Missing chunks that lie close together in the file are fetched with a single request, and
+     * the requests of one fetch run in parallel.
+     *
+     * Opening and fetching never block: the requests run on the event loop of the thread that
+     * created the object, and a callback is called on that thread once they are done. The object
+     * can thus be used on the GUI thread.
+     *
+     * \note  Remote projects are read-only. The object must only be used on the thread that
+     *        created it, which has to run an event loop. Closing the project ends the fetches
+     *        still running without calling their callbacks.
+     */
+    class RemoteProject {
+        static constexpr uint64_t gl_maxgap = uint64_t(64) << 10; /**< largest gap between missing chunks that are fetched with one request, in bytes */
+
+        static inline std::string gl_cachedir   = "cache/remote";        /**< directory of the cache files */
+        static inline uint64_t    gl_cachelimit = uint64_t(1024) << 20; /**< size of the cache directory from which old files are deleted, in bytes; 0 for no limit */
+        static inline int         gl_timeout    = 30000;                /**< time without progress after which a request fails, in milliseconds */
+
+        /**
+         * \struct suzu::RemoteProject::Range
+         * \brief  bytes of the project file fetched with one request
+         */
+        struct Range {
+            uint64_t              offset; /**< position of the first byte */
+            uint64_t              size;   /**< number of bytes */
+            std::vector<uint32_t> chunks; /**< index entries of the chunks in the range */
+        };
+
+        struct Fetch;
+
+        std::string                            m_url;     /**< URL of the project file; empty if none is open */
+        std::unique_ptr<QNetworkAccessManager> m_net;     /**< sends the requests; created on first use */
+        std::vector<QNetworkReply *>           m_replies; /**< requests still running */
+        uint64_t                               m_session; /**< incremented whenever a project is closed; replies to requests of an earlier value are ignored */
+        std::unique_ptr<QFile>                 m_cache;   /**< cache file, open for writing */
+        sdk::util::MappedFile                  m_view;    /**< mapping of the cache file, to validate chunks */
+        std::vector<sdk::ProjectChunk>         m_index;   /**< index of the project file */
+        std::vector<uint32_t>                  m_diagram; /**< index entry of every diagram, in file order */
+        std::vector<uint8_t>                   m_present; /**< whether or not every index entry is known to be in the cache */
+        sdk::ProjectReader                     m_reader;  /**< reads the cache file */
+        uint64_t                               m_fetched; /**< number of bytes fetched since the project was opened */
+
+    public:
+        using Done = std::function<void(sdk::ErrorCode)>; /**< called on the thread of the object once opening or fetching has ended, with its result */
+
+        RemoteProject() noexcept;
+        RemoteProject(RemoteProject const &) = delete;
+        RemoteProject &operator =(RemoteProject const &) = delete;
+        ~RemoteProject();
+
+        /**
+         * \brief sets the directory of the cache files
+         *
+         * \param [in] dir path of the directory; created on demand
+         */
+        static void SetCacheDirectory(std::string dir) noexcept;
+
+        /**
+         * \brief sets the size of the cache directory from which old cache files are deleted
+         *
+         * \param [in] bytes limit, in bytes; 0 for no limit
+         */
+        static void SetCacheLimit(uint64_t bytes) noexcept;
+
+        /**
+         * \brief sets the time without progress after which a request fails
+         *
+         * \param [in] msecs timeout, in milliseconds; 0 for none
+         */
+        static void SetTimeout(uint32_t msecs) noexcept;
+
+        /**
+         * \brief  retrieves whether or not a path names a remote project
+         *
+         * \param  [in] path path or URL
+         *
+         * \return *true* for HTTP and HTTPS URLs
+         */
+        static bool IsRemote(std::string_view path) noexcept;
+
+        /**
+         * \brief  starts opening a remote project, fetching its header, index and string table
+         *
+         * \param  [in] url URL of the project file; the server must support range requests
+         * \param  [in] done called once the project is open, with *suzu::sdk::ErrorCode::Ok*, or
+         *         once opening failed, with *suzu::sdk::ErrorCode::ReadFile* if a request failed or
+         *         the file is not a valid project file of a supported version, *suzu::sdk::ErrorCode::WriteFile*
+         *         if the cache file could not be written, or *suzu::sdk::ErrorCode::CriticalResource*
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if opening has started, *suzu::sdk::ErrorCode::InvalidParameter*
+         *         if *url* is not remote or *done* is empty, or *suzu::sdk::ErrorCode::CriticalResource*;
+         *         *done* is not called then
+         * \note   Any previously opened project is closed, even if the function fails.
+         */
+        sdk::ErrorCode open(std::string url, Done done) noexcept;
+
+        /**
+         * \brief closes the project; the cache file is kept
+         *
+         * \note  Diagrams mapped from the project stay valid.
+         */
+        void close() noexcept;
+
+        bool isOpen() const noexcept { return m_reader.isOpen(); }
+
+        /**
+         * \brief  starts fetching diagrams that are not in the cache yet
+         *
+         * \param  [in] diagrams indices of the diagrams, e.g. of all visible ones
+         * \param  [in] done called with the result of fetching them once they are in the cache,
+         *         or right away if they already are; diagrams fetched before an error stay in
+         *         the cache
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if fetching has started, *suzu::sdk::ErrorCode::InvalidParameter*
+         *         if an index is out of range or *done* is empty, *suzu::sdk::ErrorCode::InvalidState*
+         *         if no project is open, or *suzu::sdk::ErrorCode::CriticalResource*; *done* is not
+         *         called then
+         */
+        sdk::ErrorCode fetchDiagrams(std::vector<uint32_t> const &diagrams, Done done) noexcept;
+
+        /**
+         * \brief  starts fetching a chunk of a type other than diagrams and strings, so that
+         *         *reader()* can retrieve it
+         *
+         * \param  [in] type type of the chunk
+         * \param  [in] name name of the chunk
+         * \param  [in] done called with the result of fetching it, or right away if it is in the
+         *         cache already
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if fetching has started, *suzu::sdk::ErrorCode::InvalidParameter*
+         *         if there is no such chunk or *done* is empty, *suzu::sdk::ErrorCode::InvalidState*
+         *         if no project is open, or *suzu::sdk::ErrorCode::CriticalResource*; *done* is not
+         *         called then
+         */
+        sdk::ErrorCode fetchChunk(uint32_t type, std::string_view name, Done done) noexcept;
+
+        /**
+         * \brief  starts fetching a diagram if needed, then opens it (see *suzu::sdk::ProjectReader::mapDiagram()*)
+         *
+         * \param  [in] diagram index of the diagram
+         * \param  [out] store receives the elements; cleared first, and has to outlive the fetch
+         * \param  [in] done called with the result of fetching and opening the diagram
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if fetching has started, or the error of
+         *         *fetchDiagrams()*; *done* is not called then
+         */
+        sdk::ErrorCode mapDiagram(uint32_t diagram, sdk::ElementStore &store, Done done) noexcept;
+
+        /**
+         * \brief  retrieves the reader of the cache file
+         *
+         * \return reader; only the diagrams and chunks fetched so far can be read from it
+         */
+        sdk::ProjectReader &reader() noexcept { return m_reader; }
+
+        /**
+         * \brief  retrieves the number of bytes fetched since the project was opened
+         *
+         * \return number of bytes
+         */
+        uint64_t fetchedBytes() const noexcept { return m_fetched; }
+
+    private:
+        using Handler = std::function<void(QNetworkReply &)>; /**< called with the finished reply to a request */
+
+        /**
+         * \brief sends a range request for the project file
+         *
+         * \param [in] offset position of the first byte
+         * \param [in] size number of bytes; at least 1
+         * \param [in] handler called with the reply once it has finished, unless the project
+         *        has been closed by then
+         * \throw std::bad_alloc
+         */
+        void get(uint64_t offset, uint64_t size, Handler handler);
+
+        /**
+         * \brief reads the header of the project file and requests its index
+         *
+         * \param [in] reply finished reply to the request of the header
+         * \param [in] done called if opening fails, or passed on
+         */
+        void readHeader(QNetworkReply &reply, Done const &done) noexcept;
+
+        /**
+         * \brief reads the index of the project file, creates the cache file and fetches the
+         *        string table
+         *
+         * \param [in] header header of the project file
+         * \param [in] total size of the project file
+         * \param [in] reply finished reply to the request of the index; *nullptr* if it is empty
+         * \param [in] done called once opening has ended
+         */
+        void readIndex(sdk::ProjectHeader const &header, uint64_t total, QNetworkReply *reply, Done const &done) noexcept;
+
+        /**
+         * \brief closes the project because opening it failed
+         *
+         * \param [in] err why opening failed
+         * \param [in] done called with *err*
+         */
+        void fail(sdk::ErrorCode err, Done const &done) noexcept;
+
+        /**
+         * \brief starts fetching the chunks of index entries that are not in the cache yet
+         *
+         * \param [in] entries index entries
+         * \param [in] done called once, possibly before the function returns, with
+         *        *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::ReadFile* if a
+         *        request failed or a chunk does not match its hash, *suzu::sdk::ErrorCode::WriteFile*
+         *        if the cache file could not be written, or *suzu::sdk::ErrorCode::CriticalResource*
+         */
+        void fetch(std::vector<uint32_t> entries, Done done) noexcept;
+
+        /**
+         * \brief validates the chunks of a fetched range and writes them to the cache file
+         *
+         * \param [in,out] fetch fetch the range belongs to
+         * \param [in] range the range
+         * \param [in] reply finished reply to the request of the range
+         */
+        void store(Fetch &fetch, Range const &range, QNetworkReply &reply) noexcept;
+
+        /**
+         * \brief ends one part of a fetch, and calls its callback once all parts have ended
+         *
+         * \param [in,out] fetch the fetch
+         */
+        void settle(Fetch &fetch) noexcept;
+
+        /**
+         * \brief  checks whether or not the chunk of an index entry is in the cache
+         *
+         * \param  [in] entry index entry
+         *
+         * \return *true* if the bytes in the cache file match the hash of the chunk
+         */
+        bool isCached(uint32_t entry) noexcept;
+
+        /**
+         * \brief deletes the least recently used cache files until the cache directory is within
+         *        its limit
+         *
+         * \param [in] keep path of the cache file in use, which is never deleted
+         */
+        static void TrimCache(std::string const &keep) noexcept;
+    };
+}
+
+
@@ -0,0 +1,174 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  renderer.hpp
+ * \brief definition of the diagram renderer
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+/* external includes */
+#include <QPainter>
+#include <QRectF>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+
+/* app includes */
+#include <styles.hpp>
+
+
+namespace suzu {
+    /**
+     * \enum  suzu::DetailLevel
+     * \brief how much of an element is drawn
+     */
+    enum class DetailLevel {
+        Full,    /**< complete representation, including compartments */
+        Names,   /**< boxes with names only */
+        Outlines /**< plain rectangles */
+    };
+
+    /**
+     * \struct suzu::LodThresholds
+     * \brief  zoom factors below which simplified representations are drawn
+     */
+    struct LodThresholds {
+        double names;    /**< below this zoom, only names are drawn; key "/lod/names" */
+        double outlines; /**< below this zoom, only outlines are drawn; key "/lod/outlines" */
+        double clusters; /**< size on screen, in pixels, from which the contents of packages are drawn, see *suzu::ClusterMap*; key "/lod/clusters" */
+
+        /**
+         * \brief  selects the level of detail for a zoom factor
+         *
+         * \param  [in] zoom zoom factor; 1 is 100%
+         *
+         * \return level of detail
+         */
+        DetailLevel select(double const zoom) const noexcept {
+            return zoom < outlines ? DetailLevel::Outlines : zoom < names ? DetailLevel::Names : DetailLevel::Full;
+        }
+    };
+
+
+    /**
+     * \struct suzu::RenderItem
+     * \brief  copy of everything the renderer reads from an element
+     *
+     * Lists of items are snapshots of a part of the diagram; they can be painted on another thread
+     * while the store is being modified.
+     */
+    struct RenderItem {
+        sdk::ElementKind kind;   /**< kind of the element */
+        sdk::ElementRect bounds; /**< bounds of the element; associations run from *(x, y)* to *(x + w, y + h)*, so edges of collapsed clusters may have a negative extent */
+        sdk::StringId    name;   /**< name of the element */
+        StyleHandle      style;  /**< resolved style of the element; 0 if the renderer has no style sheet */
+        uint32_t         count;  /**< number of associations an edge between collapsed clusters stands for; 0 for elements */
+    };
+
+
+    /**
+     * \class suzu::DiagramRenderer
+     * \brief paints the elements of a diagram
+     *
+     * Apart from the style sheet, which is immutable and shared by all copies, the renderer does not
+     * keep any state of its own and only reads from the element store, so it can paint into any
+     * device, on any thread, as long as the store is not modified meanwhile. Without a style sheet,
+     * elements are drawn with the pen and brush of the painter.
+     */
+    class DiagramRenderer {
+        std::shared_ptr<StyleSheet const> m_styles; /**< style sheet, if any */
+
+    public:
+        static constexpr double gl_headerheight = 24.0; /**< height of the name compartment of classifiers, in scene units */
+        static constexpr double gl_notecorner   = 10.0; /**< size of the folded corner of notes, in scene units */
+
+        /**
+         * \brief  checks whether elements of a kind have a name compartment
+         *
+         * \param  [in] kind kind of the element
+         *
+         * \return *true* for classes, interfaces and enumerations
+         */
+        static constexpr bool IsClassifier(sdk::ElementKind const kind) noexcept {
+            return kind == sdk::ElementKind::Class || kind == sdk::ElementKind::Interface || kind == sdk::ElementKind::Enumeration;
+        }
+
+        /**
+         * \brief sets the style sheet used for painting
+         *
+         * \param [in] styles compiled style sheet; *nullptr* to use the painter's pen and brush
+         * \note  Snapshots taken by *collect()* refer to the styles of the sheet; they must be painted
+         *        by a renderer with the same sheet.
+         */
+        void setStyles(std::shared_ptr<StyleSheet const> styles) noexcept { m_styles = std::move(styles); }
+
+        std::shared_ptr<StyleSheet const> const &styles() const noexcept { return m_styles; }
+
+        /**
+         * \brief paints all visible elements intersecting a region of the scene
+         *
+         * Elements outside of *region* are culled through the store's spatial index. The painter
+         * must already map scene coordinates to device coordinates.
+         *
+         * \param [in] painter painter to draw with
+         * \param [in] store elements to draw
+         * \param [in] region region of the scene to draw, in scene coordinates
+         * \param [in] detail level of detail
+         */
+        void render(QPainter &painter, sdk::ElementStore const &store, QRectF const &region, DetailLevel detail) const;
+
+        /**
+         * \brief paints a snapshot taken by *collect()*
+         *
+         * \param [in] painter painter to draw with
+         * \param [in] items elements to draw, bottom-most first
+         * \param [in] detail level of detail
+         */
+        void render(QPainter &painter, std::vector<RenderItem> const &items, DetailLevel detail) const;
+
+        /**
+         * \brief paints only the names of a snapshot, e.g. on top of shapes drawn by the GPU backend
+         *
+         * \param [in] painter painter to draw with
+         * \param [in] items elements whose names to draw
+         * \param [in] detail level of detail; nothing is drawn for outlines
+         */
+        void renderLabels(QPainter &painter, std::vector<RenderItem> const &items, DetailLevel detail) const;
+
+        /**
+         * \brief  copies an element for a snapshot
+         *
+         * \param  [in] store elements
+         * \param  [in] dense dense index of the element
+         *
+         * \return copy of the element, with its style resolved
+         */
+        RenderItem itemOf(sdk::ElementStore const &store, uint32_t dense) const noexcept;
+
+        /**
+         * \brief takes a snapshot of all visible elements intersecting a region of the scene
+         *
+         * \param [in] store elements to copy
+         * \param [in] region region of the scene, in scene coordinates
+         * \param [out] res receives the elements, bottom-most first; existing contents are kept
+         * \param [in] skip (optional) elements to leave out, e.g. those being dragged
+         */
+        void collect(sdk::ElementStore const &store, QRectF const &region, std::vector<RenderItem> &res, std::unordered_set<sdk::ElementHandle> const *skip = nullptr) const;
+    };
+}
+
+
@@ -0,0 +1,98 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  replace.hpp
+ * \brief definition of project-wide find and replace
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/intern.hpp>
+
+/* app includes */
+#include <changeset.hpp>
+#include <search.hpp>
+#include <undo.hpp>
+
+
+namespace suzu {
+    /**
+     * \struct suzu::Replacement
+     * \brief  planned rename of a single element, e.g. for a preview
+     */
+    struct Replacement {
+        uint32_t           diagram; /**< index of the diagram in the project */
+        sdk::ElementHandle element; /**< renamed element */
+        sdk::StringId      before;  /**< current name */
+        sdk::StringId      after;   /**< new name */
+    };
+
+    /**
+     * \struct suzu::ReplaceTarget
+     * \brief  diagram receiving renames
+     */
+    struct ReplaceTarget {
+        sdk::ElementStore const *store; /**< elements of the diagram */
+        UndoStack               *undo;  /**< undo stack editing *store* */
+    };
+
+
+    /**
+     * \brief  computes the renames that replace a string in the names of all elements of a project
+     *
+     * Candidates are taken from the search index, if it is ready, and otherwise by scanning every
+     * diagram. The new names of each diagram are then computed in parallel on the task scheduler.
+     * Nothing is changed yet; the result can be shown as a preview and passed to *ApplyReplace()*.
+     *
+     * \param  [in] index search index of the project; may be still building
+     * \param  [in] diagrams all diagrams of the project
+     * \param  [in] find string to replace; every non-overlapping occurrence is replaced
+     * \param  [in] replace replacement
+     * \param  [in] matchcase whether or not to compare ASCII letters case-sensitively
+     * \param  [out] res receives the renames, by diagram and in drawing order; existing contents
+     *               are dropped
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+     *         *find* is empty, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out
+     * \note   The diagrams must not be modified until the function returns.
+     */
+    sdk::ErrorCode PlanReplace(SearchIndex const &index, std::vector<SearchIndex::Diagram> const &diagrams, std::string_view find, std::string_view replace, bool matchcase, std::vector<Replacement> &res) noexcept;
+
+    /**
+     * \brief  applies the renames planned by *PlanReplace()*
+     *
+     * The renames of each diagram form a single entry of its undo stack. All of them are reported
+     * within one transaction of *changes*, so that views are notified once. Renames of elements
+     * that have been destroyed or renamed since the plan was made are skipped. If a rename fails,
+     * all renames applied so far are undone.
+     *
+     * \param  [in] plan renames returned by *PlanReplace()*
+     * \param  [in] targets all diagrams, by diagram index
+     * \param  [in] changes (optional) dispatcher receiving the changes of all stacks
+     * \param  [out] applied (optional) receives the number of elements renamed
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if no
+     *         element was renamed, *suzu::sdk::ErrorCode::InvalidParameter* if a target is missing,
+     *         or *suzu::sdk::ErrorCode::CriticalResource* if a rename failed; the project is
+     *         unchanged then
+     */
+    sdk::ErrorCode ApplyReplace(std::vector<Replacement> const &plan, std::vector<ReplaceTarget> const &targets, ChangeDispatcher *changes = nullptr, size_t *applied = nullptr) noexcept;
+}
+
+
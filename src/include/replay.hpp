@@ -0,0 +1,256 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  replay.hpp
+ * \brief definition of recording editing sessions and replaying them to measure performance
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+/* external includes */
+#include <QObject>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+
+/* app includes */
+#include <diagramview.hpp>
+
+
+namespace suzu {
+    /**
+     * \enum  suzu::InputKind
+     * \brief kind of a recorded input event; stored in recordings, so values must not change
+     */
+    enum class InputKind : uint32_t {
+        Press,       /**< a mouse button was pressed */
+        DoubleClick, /**< a mouse button was double-clicked */
+        Release,     /**< a mouse button was released */
+        Move,        /**< the mouse was moved */
+        Wheel,       /**< the wheel was turned */
+        KeyPress,    /**< a key was pressed */
+        KeyRelease,  /**< a key was released */
+        Resize,      /**< the view was resized */
+
+        Count        /**< number of kinds */
+    };
+
+
+    /**
+     * \struct suzu::InputRecord
+     * \brief  a single recorded input event, stored as is in recordings
+     */
+    struct InputRecord {
+        int64_t   time;      /**< time since the start of the recording, in nanoseconds */
+        InputKind kind;      /**< kind of the event */
+        uint32_t  button;    /**< button that caused a mouse event */
+        uint32_t  buttons;   /**< buttons held during a mouse or wheel event */
+        uint32_t  modifiers; /**< keyboard modifiers held during the event */
+        double    x;         /**< position in the widget; width of a resized view */
+        double    y;         /**< position in the widget; height of a resized view */
+        int32_t   dx;        /**< horizontal angle delta of a wheel event */
+        int32_t   dy;        /**< vertical angle delta of a wheel event */
+        int32_t   key;       /**< key of a key event */
+        uint32_t  text;      /**< first UTF-16 code unit of the text of a key event; 0 if none */
+    };
+    static_assert(sizeof(InputRecord) == 56, "InputRecord is stored as is in recordings");
+
+
+    /**
+     * \struct suzu::SessionHeader
+     * \brief  state of the view when a recording started, stored as is in recordings
+     */
+    struct SessionHeader {
+        static constexpr uint32_t gl_version = 1; /**< current version of recordings */
+
+        uint32_t version;  /**< version of the recording */
+        int32_t  width;    /**< width of the view */
+        int32_t  height;   /**< height of the view */
+        uint32_t reserved; /**< always 0 */
+        double   zoom;     /**< zoom factor of the view */
+        double   x;        /**< scene position shown in the top-left corner */
+        double   y;        /**< scene position shown in the top-left corner */
+        int64_t  duration; /**< length of the recording, in nanoseconds */
+    };
+    static_assert(sizeof(SessionHeader) == 48, "SessionHeader is stored as is in recordings");
+
+
+    /**
+     * \class suzu::SessionRecorder
+     * \brief records the input events of a view together with the diagram it showed
+     *
+     * A recording is a project file holding the diagram as it was when recording started, a
+     * chunk with the *suzu::SessionHeader* and a chunk with all *suzu::InputRecord*s. Since it is a
+     * regular project, the diagram of a recording can be opened, and a recording can be committed
+     * next to the benchmarks it belongs to.
+     *
+     * Only events delivered to the widget of the view are recorded; edits made through other
+     * widgets are not part of the recording.
+     *
+     * \note  The recorder must only be used on the GUI thread.
+     */
+    class SessionRecorder final : public QObject {
+        Q_OBJECT
+
+    public:
+        static constexpr size_t gl_maxevents = size_t(1) << 22; /**< largest number of events recorded; later ones are dropped */
+
+    private:
+        DiagramView                          *m_view;   /**< recorded view; *nullptr* if not recording */
+        sdk::ElementStore                     m_store;  /**< diagram when recording started */
+        SessionHeader                         m_header; /**< view when recording started */
+        std::vector<InputRecord>              m_events; /**< recorded events */
+        std::chrono::steady_clock::time_point m_begin;  /**< start of the recording */
+
+    public:
+        explicit SessionRecorder(QObject *parent = nullptr) noexcept;
+        ~SessionRecorder();
+
+        /**
+         * \brief  starts recording, discarding any earlier recording that was not saved
+         *
+         * \param  [in] view view to record; must outlive the recording
+         * \param  [in] store diagram shown by *view*; a snapshot is taken
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if a
+         *         recording is running, or *suzu::sdk::ErrorCode::CriticalResource* if the snapshot
+         *         could not be taken
+         */
+        sdk::ErrorCode start(DiagramView &view, sdk::ElementStore const &store) noexcept;
+
+        /**
+         * \brief  stops recording and writes the recording to a project file
+         *
+         * \param  [in] path path of the recording; an existing file is replaced
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if
+         *         not recording, or *suzu::sdk::ErrorCode::WriteFile* if the file could not be
+         *         written; the recording is discarded in any case
+         */
+        sdk::ErrorCode stop(char const *path) noexcept;
+
+        /**
+         * \brief  retrieves whether or not a recording is running
+         *
+         * \return *true* if recording
+         */
+        bool isRecording() const noexcept { return m_view != nullptr; }
+
+        /**
+         * \brief  retrieves the number of events recorded so far
+         *
+         * \return number of events
+         */
+        size_t eventCount() const noexcept { return m_events.size(); }
+
+    protected:
+        bool eventFilter(QObject *watched, QEvent *event) override;
+    };
+
+
+    /**
+     * \struct suzu::LatencyStats
+     * \brief  distribution of measured durations
+     */
+    struct LatencyStats {
+        size_t count; /**< number of samples */
+        double p50;   /**< median, in milliseconds */
+        double p90;   /**< 90th percentile, in milliseconds */
+        double p99;   /**< 99th percentile, in milliseconds */
+        double max;   /**< longest sample, in milliseconds */
+
+        /**
+         * \brief  computes the distribution of samples
+         *
+         * \param  [in] samples durations, in nanoseconds; reordered
+         *
+         * \return distribution; all zero if there are no samples
+         */
+        static LatencyStats Of(std::vector<int64_t> &samples) noexcept;
+    };
+
+
+    /**
+     * \struct suzu::ReplayResult
+     * \brief  measurements of a replay
+     */
+    struct ReplayResult {
+        std::vector<int64_t> latency[static_cast<size_t>(InputKind::Count)]; /**< time taken by every event, by kind, in nanoseconds; includes the paint in rendering mode */
+        std::vector<int64_t> frames;                                          /**< time taken by every paint, in nanoseconds; empty if not rendering */
+        int64_t              recorded;                                        /**< length of the recording, in nanoseconds */
+        int64_t              elapsed;                                         /**< length of the replay, in nanoseconds */
+    };
+
+
+    /**
+     * \class suzu::SessionReplayer
+     * \brief replays a recording made by *suzu::SessionRecorder* into a view
+     *
+     * The view is reset to the recorded diagram and viewport, then the events are sent to its
+     * widget directly, one after another, as fast as they are handled. Without rendering, the
+     * widget stays hidden and only the event handlers are measured; with rendering, the widget is
+     * shown and repainted after every event, so that the latency of an event covers all work up
+     * to its pixels. Pacing waits for the recorded time of every event instead, for handlers that
+     * depend on how fast the input arrives, such as the prefetching of tiles.
+     *
+     * \note  The replayer must only be used on the GUI thread.
+     */
+    class SessionReplayer {
+        sdk::ElementStore        m_store;  /**< recorded diagram */
+        SessionHeader            m_header; /**< recorded view */
+        std::vector<InputRecord> m_events; /**< recorded events */
+
+    public:
+        SessionReplayer() noexcept;
+
+        /**
+         * \brief  reads a recording
+         *
+         * \param  [in] path path of the recording
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the file is no recording or of an unknown version, or the error of reading the
+         *         project
+         */
+        sdk::ErrorCode open(char const *path) noexcept;
+
+        /**
+         * \brief  replays the recording into a view
+         *
+         * The view shows the recorded diagram afterwards, until the replayer is destroyed or opens
+         * another recording; call *setStore(nullptr)* on the view before then.
+         *
+         * \param  [in] view view to replay into
+         * \param  [in] render whether or not to show the widget and repaint it after every event
+         * \param  [in] paced whether or not to wait for the recorded time of every event
+         * \param  [out] res receives the measurements
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if no
+         *         recording is open, or *suzu::sdk::ErrorCode::CriticalResource* on failure
+         */
+        sdk::ErrorCode run(DiagramView &view, bool render, bool paced, ReplayResult &res) noexcept;
+
+        /**
+         * \brief  retrieves the number of recorded events
+         *
+         * \return number of events
+         */
+        size_t eventCount() const noexcept { return m_events.size(); }
+    };
+}
+
+
@@ -0,0 +1,230 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  router.hpp
+ * \brief definition of the incremental orthogonal edge router
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/spatial.hpp>
+#include <sdk/task.hpp>
+
+
+namespace suzu {
+    /**
+     * \struct suzu::RoutePoint
+     * \brief  vertex of a route, in scene coordinates
+     */
+    struct RoutePoint {
+        float x; /**< horizontal position */
+        float y; /**< vertical position */
+    };
+
+
+    /**
+     * \class suzu::EdgeRouter
+     * \brief routes associations orthogonally around the boxes of a diagram
+     *
+     * Every routed edge has a *corridor*, the region its route depends on: the bounds of its end
+     * points plus a margin, which is also the region searched for a route. Corridors are kept in
+     * a spatial index, so after a change only the edges whose corridors intersect the changed
+     * region are rerouted.
+     *
+     * Routing is split into three steps, so that the expensive part can run on a worker thread:
+     * *prepare()* takes a snapshot of the obstacles around every outdated edge, *Route()* computes
+     * the routes from the snapshots alone, and *apply()* stores the results unless the edge has
+     * been invalidated again meanwhile. Until then, *route()* returns a straight line between the
+     * end points as a preview.
+     *
+     * \note  All member functions must be called on the thread owning the store; only *Route()*
+     *        may be called from any thread.
+     */
+    class EdgeRouter {
+    public:
+        static constexpr float gl_clearance = 12.0f;  /**< minimum distance between routes and boxes, in scene units */
+        static constexpr float gl_search    = 120.0f; /**< margin around the end points searched for obstacles, in scene units */
+        static constexpr float gl_bendcost  = 40.0f;  /**< cost of a bend, in scene units of length */
+
+        /**
+         * \struct suzu::EdgeRouter::Request
+         * \brief  snapshot of everything needed to route an edge
+         */
+        struct Request {
+            sdk::ElementHandle            edge;      /**< edge to route */
+            uint64_t                      ticket;    /**< identifies the snapshot */
+            sdk::ElementRect              source;    /**< bounds of the source element */
+            sdk::ElementRect              target;    /**< bounds of the target element */
+            sdk::ElementRect              area;      /**< region searched for a route */
+            std::vector<sdk::ElementRect> obstacles; /**< boxes inside *area*, except source and target */
+        };
+
+        /**
+         * \struct suzu::EdgeRouter::Result
+         * \brief  computed route of an edge
+         */
+        struct Result {
+            sdk::ElementHandle      edge;   /**< routed edge */
+            uint64_t                ticket; /**< ticket of the request */
+            std::vector<RoutePoint> points; /**< route from source to target */
+        };
+
+    private:
+        /**
+         * \struct suzu::EdgeRouter::Edge
+         * \brief  state of a connected edge
+         */
+        struct Edge {
+            sdk::ElementHandle      source;  /**< source element */
+            sdk::ElementHandle      target;  /**< target element */
+            std::vector<RoutePoint> points;  /**< last computed route; empty if none */
+            uint64_t                ticket;  /**< ticket of the last request */
+            uint64_t                routed;  /**< ticket of the request *points* were computed from */
+            bool                    dirty;   /**< whether or not the edge has to be requested again */
+            bool                    indexed; /**< whether or not the corridor is in *m_corridors* */
+        };
+
+        std::unordered_map<sdk::ElementHandle, Edge> m_edges;     /**< all connected edges */
+        sdk::SpatialIndex<sdk::ElementHandle>        m_corridors; /**< corridors of routed edges */
+        uint64_t                                     m_ticket;    /**< ticket of the next request */
+
+    public:
+        EdgeRouter() noexcept
+            : m_ticket(1)
+        { }
+
+        /**
+         * \brief  connects an edge to its end points; the edge is routed with the next batch
+         *
+         * \param  [in] edge association element
+         * \param  [in] source source element
+         * \param  [in] target target element
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         a handle is null
+         */
+        sdk::ErrorCode connect(sdk::ElementHandle edge, sdk::ElementHandle source, sdk::ElementHandle target) noexcept;
+
+        /**
+         * \brief  forgets an edge and its route
+         *
+         * \param  [in] edge edge to remove
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the edge is not connected
+         */
+        sdk::ErrorCode disconnect(sdk::ElementHandle edge) noexcept;
+
+        /**
+         * \brief marks all edges whose corridors intersect a changed region as outdated
+         *
+         * \param [in] region changed region, e.g. from *suzu::sdk::ElementStore::changesSince()*
+         */
+        void invalidate(sdk::ElementRect const &region);
+
+        /**
+         * \brief  takes snapshots of all outdated edges
+         *
+         * Edges whose end points no longer exist lose their route and are not requested.
+         *
+         * \param  [in] store diagram containing the edges
+         *
+         * \return one request per outdated edge
+         */
+        std::vector<Request> prepare(sdk::ElementStore const &store);
+
+        /**
+         * \brief  computes an orthogonal route from a snapshot; may be called from any thread
+         *
+         * The route leaves and enters the end points perpendicularly at the middle of one of their
+         * sides and minimizes its length plus a penalty per bend. If the obstacles leave no way
+         * through the searched area, an L-shaped route ignoring them is returned.
+         *
+         * \param  [in] req snapshot taken by *prepare()*
+         *
+         * \return route of the edge
+         */
+        static Result Route(Request const &req);
+
+        /**
+         * \brief  stores a computed route
+         *
+         * \param  [in] res route computed by *Route()*
+         *
+         * \return *true* if the route was stored, *false* if the edge was invalidated again or
+         *         disconnected after the snapshot was taken
+         */
+        bool apply(Result res);
+
+        /**
+         * \brief  routes all outdated edges on the current thread
+         *
+         * \param  [in] store diagram containing the edges
+         *
+         * \return number of routed edges
+         */
+        size_t routeAll(sdk::ElementStore const &store);
+
+        /**
+         * \brief  routes all outdated edges on the task scheduler
+         *
+         * *deliver* is called on a worker thread with all results; it typically posts them to the
+         * owner's thread, which passes them to *apply()*.
+         *
+         * \param  [in] store diagram containing the edges
+         * \param  [in] deliver receives the results
+         *
+         * \return handle of the task; invalid if nothing is outdated or the task could not be
+         *         submitted
+         */
+        sdk::TaskHandle routeAsync(sdk::ElementStore const &store, std::function<void(std::vector<Result>)> deliver);
+
+        /**
+         * \brief  retrieves the route of an edge
+         *
+         * \param  [in] store diagram containing the edge
+         * \param  [in] edge connected edge
+         * \param  [out] res receives the route; a straight line between the centers of the end
+         *         points while the edge is outdated
+         *
+         * \return *true* if *res* holds a computed route, *false* if it holds a preview or the edge
+         *         is not connected
+         */
+        bool route(sdk::ElementStore const &store, sdk::ElementHandle edge, std::vector<RoutePoint> &res) const;
+
+        /**
+         * \brief  retrieves whether or not any edge is outdated
+         *
+         * \return *true* if edges wait for routing
+         */
+        bool isDirty() const noexcept;
+
+    private:
+        /**
+         * \brief marks an edge as outdated and removes its corridor from the index
+         *
+         * \param [in] handle edge
+         * \param [in] edge state of the edge
+         */
+        void markDirty(sdk::ElementHandle handle, Edge &edge) noexcept;
+    };
+}
+
+
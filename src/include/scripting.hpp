@@ -0,0 +1,197 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  scripting.hpp
+ * \brief definition of the scripting interface to a diagram
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/* external includes */
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/query.hpp>
+
+/* app includes */
+#include <undo.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::ScriptModel
+     * \brief diagram as seen by scripts, exposed as *model* to the JavaScript engine
+     *
+     * Every call from a script into the application costs far more than the work behind most
+     * single-element operations, so the interface works on *selections* instead of elements: a
+     * query returns the id of a selection kept on the C++ side, and all getters and setters take
+     * a selection and read or write the property of all of its elements in one call. A script
+     * renaming 10,000 classes thus makes three calls, not 10,000:
+     *
+     *     var sel   = model.query('kind = class and in "Model"');
+     *     var names = model.names(sel).map(function (name) { return name.toUpperCase(); });
+     *     model.setNames(sel, names);
+     *
+     * Getters return one value per element, in the order of the selection; bounds are flattened
+     * into *[x, y, w, h, x, y, w, h, ...]*. Elements destroyed after a selection was made are
+     * skipped by setters and reported as empty values by getters.
+     *
+     * Every setter is a single undoable operation, reported to views in one transaction. A script
+     * may group several of them with *begin()* and *commit()*; *rollback()* reverts all edits
+     * since *begin()*. A script run by *run()* is one operation as a whole.
+     *
+     * Queries use the language of *sdk/query.hpp*, answered from secondary indexes that are built
+     * again once the diagram changed.
+     *
+     * \note  The model must only be used on the GUI thread.
+     */
+    class ScriptModel : public QObject {
+        Q_OBJECT
+
+        static constexpr size_t gl_maxselections = 1 << 16; /**< largest number of selections held at once */
+
+        sdk::ElementStore                                             &m_store;     /**< edited diagram */
+        UndoStack                                                     &m_undo;      /**< receives all edits */
+        sdk::ModelIndex                                               m_index;      /**< secondary indexes answering queries */
+        uint64_t                                                      m_indexed;    /**< revision of the store *m_index* reflects; *UINT64_MAX* if none */
+        std::vector<std::unique_ptr<std::vector<sdk::ElementHandle>>> m_selections; /**< elements of every selection, by id; *nullptr* once released */
+        std::vector<int>                                              m_free;       /**< ids of released selections, to be reused */
+        uint32_t                                                      m_depth;      /**< nesting depth of *begin()* */
+        bool                                                          m_edited;     /**< whether or not an edit was applied since the outermost *begin()* */
+        mutable QString                                               m_error;      /**< description of the last error */
+
+    public:
+        /**
+         * \brief constructs a new scripting interface
+         *
+         * \param [in] store diagram; must outlive the model
+         * \param [in] undo undo stack of *store*; must outlive the model
+         * \param [in] parent (optional) parent object
+         */
+        ScriptModel(sdk::ElementStore &store, UndoStack &undo, QObject *parent = nullptr) noexcept;
+        ~ScriptModel();
+
+        /**
+         * \brief  runs a script with this model exposed as *model*
+         *
+         * All edits of the script form one undoable operation. Selections made by the script are
+         * released afterwards.
+         *
+         * \param  [in] source JavaScript source
+         * \param  [out] result (optional) receives the value of the script's last statement, or
+         *               the description of the error it raised
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the script raised an error; its edits are reverted then
+         */
+        sdk::ErrorCode run(QString const &source, QString *result = nullptr) noexcept;
+
+        /*
+         * Selections. Each returns the id of a new selection, or -1 on failure; see *lastError()*.
+         */
+        Q_INVOKABLE int query(QString const &text) noexcept;
+        Q_INVOKABLE int all() noexcept;
+        Q_INVOKABLE int within(double x, double y, double w, double h) noexcept;
+        Q_INVOKABLE int children(int selection) noexcept;
+        Q_INVOKABLE int count(int selection) const noexcept;
+        Q_INVOKABLE void release(int selection) noexcept;
+
+        /*
+         * Bulk getters. They return one value per element of the selection, or an empty list if
+         * the selection does not exist.
+         */
+        Q_INVOKABLE QStringList  names(int selection) const noexcept;
+        Q_INVOKABLE QStringList  kinds(int selection) const noexcept;
+        Q_INVOKABLE QVariantList styles(int selection) const noexcept;
+        Q_INVOKABLE QVariantList bounds(int selection) const noexcept;
+
+        /*
+         * Bulk setters. Lists of values hold one value per element of the selection. They return
+         * *false* if the selection does not exist, the values do not match it, or an edit
+         * failed; see *lastError()*. Edits applied before a failure are kept unless the script
+         * rolls back.
+         */
+        Q_INVOKABLE bool setNames(int selection, QStringList const &names) noexcept;
+        Q_INVOKABLE bool setStyle(int selection, int style) noexcept;
+        Q_INVOKABLE bool setStyles(int selection, QVariantList const &styles) noexcept;
+        Q_INVOKABLE bool setBounds(int selection, QVariantList const &bounds) noexcept;
+        Q_INVOKABLE bool setFlag(int selection, QString const &flag, bool set) noexcept;
+        Q_INVOKABLE bool translate(int selection, double dx, double dy) noexcept;
+        Q_INVOKABLE bool destroy(int selection) noexcept;
+
+        /*
+         * Transactions. *begin()* may be nested; only the outermost *commit()* ends the operation.
+         * *rollback()* ends all open transactions and reverts their edits; they cannot be redone.
+         */
+        Q_INVOKABLE void begin() noexcept;
+        Q_INVOKABLE bool commit() noexcept;
+        Q_INVOKABLE bool rollback() noexcept;
+
+        /**
+         * \brief  retrieves the description of the last error
+         *
+         * \return description; empty if no call failed yet
+         */
+        Q_INVOKABLE QString lastError() const noexcept { return m_error; }
+
+    private:
+        /**
+         * \brief  stores a new selection
+         *
+         * \param  [in] handles elements of the selection
+         *
+         * \return id of the selection, or -1 if too many selections are held
+         */
+        int add(std::vector<sdk::ElementHandle> handles) noexcept;
+
+        /**
+         * \brief  retrieves a selection
+         *
+         * \param  [in] selection id of the selection
+         *
+         * \return elements of the selection, or *nullptr* if it does not exist; the error is set then
+         */
+        std::vector<sdk::ElementHandle> const *find(int selection) const noexcept;
+
+        /**
+         * \brief  applies an edit to every live element of a selection as one operation
+         *
+         * \param  [in] selection id of the selection
+         * \param  [in] values number of values given for the selection; *SIZE_MAX* if one value
+         *              applies to all elements
+         * \param  [in] fn edit; receives the handle and its index in the selection and returns
+         *              the result of the *suzu::UndoStack* edit
+         *
+         * \return *true* if all edits succeeded
+         */
+        template<class Fn> bool edit(int selection, size_t values, Fn &&fn) noexcept;
+
+        /**
+         * \brief  sets the description of the last error
+         *
+         * \param  [in] text description
+         *
+         * \return *false*, for convenience
+         */
+        bool fail(QString text) const noexcept;
+    };
+}
+
+
@@ -0,0 +1,186 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  search.hpp
+ * \brief definition of the project-wide search index
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/task.hpp>
+
+/* app includes */
+#include <changeset.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        struct SearchState;
+    }
+
+
+    /**
+     * \class suzu::SearchIndex
+     * \brief trigram index over the names of all elements of a project, for type-ahead search
+     *
+     * Every name is split into its overlapping three-byte sequences (trigrams), compared without
+     * regard to ASCII case. The index maps each trigram to the elements whose names contain it.
+     * A query only intersects the lists of its own trigrams, starting with the shortest, and
+     * checks the few remaining candidates against the query; its cost thus depends on the number
+     * of matches rather than on the size of the project. Queries shorter than three bytes have no
+     * trigram and scan all names instead.
+     *
+     * The index is built in a low-priority task once the project has been opened (*build()*);
+     * only the names are collected on the GUI thread. Afterwards, it is kept up to date with the
+     * consolidated changes of the diagrams (*apply()*). Changes that arrive while the index is
+     * being built are replayed once it is done. Queries may run on any thread, at any time; they
+     * see the project as of the last change applied.
+     *
+     * Changed elements are not updated in place: their old entry is retired and a new one is
+     * appended, which keeps all lists sorted. Retired entries are purged once they make up half
+     * the index.
+     *
+     * \note  Except for *query()*, the index must only be used on the GUI thread.
+     */
+    class SearchIndex {
+    public:
+        /**
+         * \struct suzu::SearchIndex::Diagram
+         * \brief  diagram to index
+         */
+        struct Diagram {
+            uint32_t                 index; /**< index of the diagram in the project */
+            sdk::ElementStore const *store; /**< elements of the diagram */
+        };
+
+        /**
+         * \struct suzu::SearchIndex::Hit
+         * \brief  element whose name contains the query
+         */
+        struct Hit {
+            uint32_t           diagram; /**< index of the diagram in the project */
+            sdk::ElementHandle element; /**< matching element */
+        };
+
+    private:
+        std::shared_ptr<internal::SearchState> m_state; /**< index; shared with the build task, replaced atomically for *query()* */
+        sdk::TaskHandle                        m_build; /**< running build, if any */
+
+    public:
+        SearchIndex() noexcept;
+        SearchIndex(SearchIndex const &) = delete;
+        SearchIndex &operator =(SearchIndex const &) = delete;
+        /**
+         * \brief waits for a running build
+         */
+        ~SearchIndex();
+
+        /**
+         * \brief  starts building the index of a project in the background
+         *
+         * The previous contents are dropped. Queries find nothing until the build is done.
+         *
+         * \param  [in] diagrams all diagrams of the project
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* if the build was started, or
+         *         *suzu::sdk::ErrorCode::CriticalResource* if the names could not be collected
+         */
+        sdk::ErrorCode build(std::vector<Diagram> const &diagrams) noexcept;
+
+        /**
+         * \brief  writes the index in a relocatable form, e.g. for *suzu::ModelCache*
+         *
+         * Elements are stored by dense index, which stays valid as long as the diagrams are saved
+         * and opened again without changes. Retired entries are dropped. All values are u32 in
+         * little-endian byte order:
+         *
+         *     n, t                            number of entries and of trigrams
+         *     n x (diagram, dense index)      entries, by entry id
+         *     t x trigram                     trigrams, ascending
+         *     (t + 1) x offset                positions of the entry ids of every trigram
+         *     offsets[t] x entry id           ascending entry ids, by trigram
+         *
+         * The entry ids of trigram *i* span the positions from *offsets[i]* to *offsets[i + 1]*.
+         *
+         * \param  [in] diagrams all diagrams of the project, as passed to *build()*
+         * \param  [out] out receives the index; existing contents are dropped
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if the
+         *         index has not been built, is still being built, or does not match *diagrams*, or
+         *         *suzu::sdk::ErrorCode::CriticalResource* if memory ran out
+         */
+        sdk::ErrorCode serialize(std::vector<Diagram> const &diagrams, std::vector<char> &out) const noexcept;
+
+        /**
+         * \brief  replaces the index by one written with *serialize()*, without building it
+         *
+         * No name is split into trigrams; the lists are copied as they are. A running build is
+         * waited for and discarded.
+         *
+         * \param  [in] diagrams all diagrams of the project, opened from the same saved state as
+         *         when the index was written
+         * \param  [in] data index written by *serialize()*
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::ReadFile* if *data*
+         *         is malformed or does not match *diagrams*, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if memory ran out; the index is empty then and has to be built
+         */
+        sdk::ErrorCode restore(std::vector<Diagram> const &diagrams, std::string_view data) noexcept;
+
+        /**
+         * \brief  updates the index with the changes of a diagram
+         *
+         * Additions, removals and renames are applied; other changes are ignored.
+         *
+         * \param  [in] diagram changed diagram
+         * \param  [in] changes consolidated changes of the diagram, e.g. delivered by a
+         *              *suzu::ChangeDispatcher*
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if memory ran out; the index has to be rebuilt then
+         */
+        sdk::ErrorCode apply(Diagram const &diagram, ChangeSet const &changes) noexcept;
+
+        /**
+         * \brief  finds the elements whose names contain a string, ignoring ASCII case
+         *
+         * \param  [in] text string to find; UTF-8
+         * \param  [out] res receives the matches, in the order they were indexed;
+         *               existing contents are dropped
+         * \param  [in] limit (optional) largest number of matches to collect
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         *text* is empty, *suzu::sdk::ErrorCode::InvalidState* if the index has not been
+         *         built or is still being built, or *suzu::sdk::ErrorCode::CriticalResource* if
+         *         memory ran out
+         * \note   This function is thread-safe.
+         */
+        sdk::ErrorCode query(std::string_view text, std::vector<Hit> &res, size_t limit = 256) const noexcept;
+
+        bool isBuilding() const noexcept { return !m_build.isFinished(); }
+
+        /**
+         * \brief drops the index, waiting for a running build
+         */
+        void clear() noexcept;
+    };
+}
+
+
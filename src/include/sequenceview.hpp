@@ -0,0 +1,154 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  sequenceview.hpp
+ * \brief definition of the sequence diagram view
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+
+/* external includes */
+#include <QPointF>
+#include <QRectF>
+#include <QWidget>
+
+/* sdk includes */
+#include <sdk/sequence.hpp>
+
+/* app includes */
+#include <diagramview.hpp>
+#include <renderer.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::SequenceView
+     * \brief widget displaying a sequence diagram of any length, e.g. generated from a trace
+     *
+     * Lifelines are laid out side by side, *gl_lifelinegap* apart; every message takes a row of
+     * *gl_rowheight* below the header, in order of time. Painting only visits the rows and
+     * lifelines inside the viewport, and the activations and loops overlapping the visible window
+     * of time (see *suzu::sdk::SequenceModel::activations()*); messages whose ends lie outside of the
+     * visible lifelines are only drawn if they cross them. The cost of a frame thus depends on the
+     * size of the widget, not of the diagram. Once rows are less than *gl_minrowpixels* high, only
+     * every *n*-th message is drawn, so that no more messages are drawn than the widget has pixel
+     * rows.
+     *
+     * The lifeline headers stay pinned to the top of the widget while scrolling. The wheel scrolls
+     * through the messages and zooms while Ctrl is held; dragging with the middle mouse button pans
+     * the view. Below the zoom factor *LodThresholds::names*, labels are left out. Owners call
+     * *update()* after modifying the model.
+     */
+    class SequenceView final : public QWidget {
+        Q_OBJECT
+
+    public:
+        static constexpr double gl_lifelinegap  = 160.0; /**< distance between lifelines, in scene units */
+        static constexpr double gl_rowheight    = 24.0;  /**< distance between messages, in scene units */
+        static constexpr double gl_barwidth     = 10.0;  /**< width of activation bars, in scene units */
+        static constexpr double gl_headerheight = 32.0;  /**< height of the pinned lifeline headers, in pixels */
+        static constexpr double gl_minrowpixels = 3.0;   /**< height of a row below which messages are thinned out, in pixels */
+        static constexpr int    gl_scrollrows   = 3;     /**< rows scrolled per wheel step */
+
+    private:
+        sdk::SequenceModel const *m_model; /**< displayed diagram; not owned */
+        LodThresholds             m_lod;   /**< level-of-detail thresholds */
+        ViewNavigator             m_view;  /**< zoom factor and scroll position; scene y 0 is the top of the first row */
+
+    public:
+        /**
+         * \brief constructs a new, empty view
+         *
+         * \param [in] lod level-of-detail thresholds
+         * \param [in] parent (optional) parent widget
+         */
+        explicit SequenceView(LodThresholds const &lod, QWidget *parent = nullptr) noexcept;
+
+        /**
+         * \brief sets the displayed diagram
+         *
+         * \param [in] model diagram to display; must outlive the view or be reset before
+         */
+        void setModel(sdk::SequenceModel const *model) noexcept;
+
+        /**
+         * \brief sets the level-of-detail thresholds, e.g. after the configuration changed
+         *
+         * \param [in] lod new thresholds
+         */
+        void setLodThresholds(LodThresholds const &lod) noexcept;
+
+        ViewNavigator const &navigator() const noexcept { return m_view; }
+
+        /**
+         * \brief sets zoom factor and scroll position
+         *
+         * \param [in] zoom zoom factor
+         * \param [in] origin scene position shown in the top-left corner, below the header
+         */
+        void setViewport(double zoom, QPointF const &origin) noexcept;
+
+        /**
+         * \brief scrolls the view so that a message is shown at the top, e.g. when jumping to a
+         *        time of the trace
+         *
+         * \param [in] row row of the message
+         */
+        void scrollToRow(uint32_t row) noexcept;
+
+        /**
+         * \brief  retrieves the visible region of the scene, without the header
+         *
+         * \return region in scene coordinates
+         */
+        QRectF visibleRect() const noexcept;
+
+    protected:
+        void paintEvent(QPaintEvent *event) override;
+        void wheelEvent(QWheelEvent *event) override;
+        void mousePressEvent(QMouseEvent *event) override;
+        void mouseMoveEvent(QMouseEvent *event) override;
+        void mouseReleaseEvent(QMouseEvent *event) override;
+
+    private:
+        /**
+         * \brief  maps a scene position to widget coordinates
+         *
+         * \param  [in] pos position in scene coordinates
+         *
+         * \return position in widget coordinates
+         */
+        QPointF mapFromScene(QPointF const &pos) const noexcept;
+
+        /**
+         * \brief paints the lifelines, activations, loops and messages inside the viewport
+         *
+         * \param [in] painter painter drawing the widget
+         * \param [in] l0 first visible lifeline
+         * \param [in] l1 one past the last visible lifeline
+         */
+        void paintBody(QPainter &painter, uint32_t l0, uint32_t l1) const;
+
+        /**
+         * \brief paints the pinned headers of the visible lifelines
+         *
+         * \param [in] painter painter drawing the widget
+         * \param [in] l0 first visible lifeline
+         * \param [in] l1 one past the last visible lifeline
+         */
+        void paintHeaders(QPainter &painter, uint32_t l0, uint32_t l1) const;
+    };
+}
+
+
@@ -0,0 +1,124 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  session.hpp
+ * \brief session state that is restored on the next launch, and prefetching of its last project
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <memory>
+#include <string>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/config.hpp>
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/project.hpp>
+
+/* app includes */
+#include <modelcache.hpp>
+
+
+namespace suzu {
+    /**
+     * \struct suzu::SessionProject
+     * \brief  an open project and the viewport of its visible diagram
+     */
+    struct SessionProject {
+        std::string path;    /**< path of the project file */
+        std::string diagram; /**< name of the visible diagram; empty for the first one */
+        double      zoom;    /**< zoom factor of the visible diagram */
+        double      x;       /**< scene x-coordinate shown in the top-left corner */
+        double      y;       /**< scene y-coordinate shown in the top-left corner */
+    };
+
+
+    /**
+     * \struct suzu::Session
+     * \brief  state of the previous session, kept in the configuration under "/session"
+     *
+     * The section holds the open projects and the recently used project files:
+     *
+     *     "session": {
+     *         "restore": true,
+     *         "projects": [ { "path": "...", "diagram": "...", "zoom": 1.0, "x": 0.0, "y": 0.0 } ],
+     *         "recent": [ "..." ]
+     *     }
+     *
+     * Both lists are ordered by the time of last use, most recent first.
+     */
+    struct Session {
+        static constexpr size_t gl_maxrecent = 10; /**< number of recently used files that are kept */
+
+        std::vector<SessionProject> projects; /**< projects that were open */
+        std::vector<std::string>    recent;   /**< recently used project files */
+
+        /**
+         * \brief  reads the session from the configuration; malformed entries are skipped
+         *
+         * \param  [in] cfg view of the "/session" section
+         *
+         * \return session; empty on error
+         */
+        static Session Load(sdk::ConfigView const &cfg) noexcept;
+
+        /**
+         * \brief  writes the session into the configuration
+         *
+         * \param  [in] cfg view of the "/session" section
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success
+         */
+        sdk::ErrorCode save(sdk::ConfigView &cfg) const noexcept;
+
+        /**
+         * \brief moves a project file to the front of the recently used files
+         *
+         * \param [in] path path of the project file
+         * \throw std::bad_alloc
+         */
+        void touch(std::string const &path);
+    };
+
+
+    /**
+     * \struct suzu::PrefetchedProject
+     * \brief  project opened ahead of the main window, with its visible diagram
+     */
+    struct PrefetchedProject {
+        SessionProject     project; /**< restored project and viewport */
+        sdk::ProjectReader reader;  /**< reader holding the mapping of the project */
+        ModelCache         cache;   /**< warm-start cache of the project; closed if missing or stale */
+        uint32_t           diagram; /**< index of the visible diagram */
+        sdk::ElementStore  store;   /**< elements of the visible diagram; mapped from *cache* if it is open */
+    };
+
+    /**
+     * \brief  opens a project and its visible diagram, reading their pages ahead of use
+     *
+     * The project index is read and the visible diagram is mapped (see
+     * *suzu::sdk::ProjectReader::mapDiagram()*), from the warm-start cache of the project if it is
+     * up to date (see *suzu::ModelCache*); then every page of its bounds, which the first frame
+     * reads, is touched, so that the main window shows the diagram without waiting for disk.
+     * Meant to be run on a worker thread while the GUI is being initialized.
+     *
+     * \param  [in] project project to open; falls back to the first diagram if the named one is
+     *         missing
+     *
+     * \return prefetched project, or *nullptr* if it could not be opened
+     */
+    std::unique_ptr<PrefetchedProject> PrefetchProject(SessionProject const &project) noexcept;
+}
+
+
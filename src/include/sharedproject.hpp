@@ -0,0 +1,265 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  sharedproject.hpp
+ * \brief definition of project models shared by all windows and views showing them
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+#include <sdk/project.hpp>
+
+/* app includes */
+#include <changeset.hpp>
+#include <diagramview.hpp>
+#include <projectwatcher.hpp>
+#include <session.hpp>
+#include <undo.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::SharedProject
+     * \brief model of an open project, shared by every window and split view showing it
+     *
+     * *Open()* returns the instance already open for a project file, if any, so that a project
+     * opened in several windows is read and held in memory once. Windows keep the instance alive
+     * by holding the returned pointer; the project is closed once the last one releases it.
+     *
+     * Every diagram has a single store, undo stack and dispatcher (see *suzu::ChangeDispatcher*),
+     * loaded when a view first asks for it. Edits made through any view thus show up in all
+     * others, and undoing them works from every window. Views only share the model; zoom factor,
+     * scroll position (see *suzu::DiagramView::navigator()*) and tile caches stay per view.
+     *
+     * Work on other threads, e.g. exporting or printing, reads a *snapshot()* of a diagram instead
+     * of the live store, so that it never holds up editing in another window. A snapshot is taken
+     * at most once per revision of the diagram and shared by all readers; it stays valid as long
+     * as a reader holds it, even after the project was closed.
+     *
+     * \note  Instances must only be used on the GUI thread, except for the snapshots they hand
+     *        out, which may be read on any thread.
+     */
+    class SharedProject {
+        /**
+         * \struct suzu::SharedProject::Diagram
+         * \brief  diagram of the project, loaded on first use
+         */
+        struct Diagram {
+            std::string                              name;     /**< name of the diagram */
+            std::unique_ptr<sdk::ElementStore>       store;    /**< elements of the diagram; *nullptr* until loaded */
+            std::unique_ptr<ChangeDispatcher>        changes;  /**< delivers the edits of *undo* to the attached views */
+            std::unique_ptr<UndoStack>               undo;     /**< undo stack editing *store*; destroyed before *changes* */
+            std::shared_ptr<sdk::ElementStore const> snapshot; /**< most recent snapshot of *store*; *nullptr* if none */
+        };
+
+        /**
+         * \struct suzu::SharedProject::Attachment
+         * \brief  view showing a diagram of the project
+         */
+        struct Attachment {
+            uint64_t     id;           /**< id returned by *attach()* */
+            uint32_t     diagram;      /**< index of the shown diagram */
+            DiagramView *view;         /**< the view; not owned */
+            uint64_t     subscription; /**< subscription of the view to the dispatcher of the diagram */
+        };
+
+        static inline std::vector<std::weak_ptr<SharedProject>> gl_open; /**< all open projects */
+
+        std::string                            m_path;     /**< normalized path of the project file */
+        sdk::ProjectReader                     m_reader;   /**< reader holding the mapping of the project */
+        std::vector<std::unique_ptr<Diagram>>  m_diagrams; /**< all diagrams, in project order */
+        std::vector<Attachment>                m_views;    /**< attached views */
+        uint64_t                               m_next;     /**< id of the next attachment */
+
+    public:
+        SharedProject() noexcept;
+        SharedProject(SharedProject const &) = delete;
+        SharedProject &operator =(SharedProject const &) = delete;
+        /**
+         * \brief detaches all views that are still attached
+         */
+        ~SharedProject();
+
+        /**
+         * \brief  opens a project, or retrieves the instance already open for it
+         *
+         * \param  [in] path path of the project file
+         * \param  [out] err (optional) receives *suzu::sdk::ErrorCode::Ok* on success, or the error
+         *         of reading the project
+         *
+         * \return shared instance, or *nullptr* on failure
+         */
+        static std::shared_ptr<SharedProject> Open(std::string const &path, sdk::ErrorCode *err = nullptr) noexcept;
+
+        /**
+         * \brief  takes over a project opened ahead of the main window (see *suzu::PrefetchProject()*)
+         *
+         * The prefetched diagram becomes the loaded diagram of the project. If the project is
+         * open already, the prefetched one is dropped and the open instance returned.
+         *
+         * \param  [in] prefetched prefetched project
+         *
+         * \return shared instance, or *nullptr* on failure
+         */
+        static std::shared_ptr<SharedProject> Adopt(std::unique_ptr<PrefetchedProject> prefetched) noexcept;
+
+        /**
+         * \brief  retrieves all open projects
+         *
+         * \return projects, in the order they were opened
+         * \throw  std::bad_alloc
+         */
+        static std::vector<std::shared_ptr<SharedProject>> OpenProjects();
+
+        /**
+         * \brief  retrieves the path of the project file
+         *
+         * \return normalized path
+         */
+        std::string const &path() const noexcept { return m_path; }
+
+        /**
+         * \brief  retrieves the reader of the project file
+         *
+         * \return reader
+         */
+        sdk::ProjectReader &reader() noexcept { return m_reader; }
+
+        uint32_t         diagramCount() const noexcept                 { return static_cast<uint32_t>(m_diagrams.size()); }
+        std::string_view diagramName(uint32_t diagram) const noexcept { return m_diagrams[diagram]->name; }
+
+        /**
+         * \brief  retrieves a diagram, loading it on first use
+         *
+         * \param  [in] diagram index of the diagram; less than *diagramCount()*
+         *
+         * \return elements of the diagram, or *nullptr* if it could not be loaded; valid until the
+         *         project is destroyed. Edit the diagram through *undo()* only, so that every view
+         *         is notified.
+         */
+        sdk::ElementStore *diagram(uint32_t diagram) noexcept;
+
+        /**
+         * \brief  retrieves the undo stack of a diagram, loading it on first use
+         *
+         * \param  [in] diagram index of the diagram
+         *
+         * \return undo stack, shared by all views of the diagram; *nullptr* if it could not be loaded
+         */
+        UndoStack *undo(uint32_t diagram) noexcept;
+
+        /**
+         * \brief  retrieves the dispatcher delivering the edits of a diagram, e.g. to subscribe a
+         *         property editor
+         *
+         * \param  [in] diagram index of the diagram
+         *
+         * \return dispatcher; *nullptr* if the diagram could not be loaded
+         */
+        ChangeDispatcher *dispatcher(uint32_t diagram) noexcept;
+
+        /**
+         * \brief  retrieves the current contents of a diagram for reading on another thread
+         *
+         * \param  [in] diagram index of the diagram
+         *
+         * \return snapshot (see *suzu::sdk::ElementStore::snapshot()*), shared with other readers of
+         *         the same revision; *nullptr* if the diagram could not be loaded or the snapshot not
+         *         be taken
+         */
+        std::shared_ptr<sdk::ElementStore const> snapshot(uint32_t diagram) noexcept;
+
+        /**
+         * \brief  retrieves the loaded diagrams, e.g. for the *suzu::ProjectWatcher* of the project
+         *
+         * \return loaded diagrams with their undo stacks
+         * \throw  std::bad_alloc
+         */
+        std::vector<ProjectWatcher::Diagram> loadedDiagrams() const;
+
+        /**
+         * \brief  shows a diagram in a view, repainting it after every edit
+         *
+         * \param  [in] diagram index of the diagram
+         * \param  [in] view view; its viewport and caches are its own. Must be detached before it is
+         *         destroyed.
+         *
+         * \return attachment id for *detach()*; 0 if the diagram could not be loaded
+         */
+        uint64_t attach(uint32_t diagram, DiagramView &view) noexcept;
+
+        /**
+         * \brief removes a view, resetting its store; does nothing if the id is unknown
+         *
+         * \param [in] id attachment id returned by *attach()*
+         */
+        void detach(uint64_t id) noexcept;
+
+        /**
+         * \brief  retrieves the number of views showing a diagram
+         *
+         * \param  [in] diagram index of the diagram
+         *
+         * \return number of views
+         */
+        uint32_t viewCount(uint32_t diagram) const noexcept;
+
+    private:
+        /**
+         * \brief  looks up an open project
+         *
+         * \param  [in] path normalized path of the project file
+         *
+         * \return instance, or *nullptr* if the project is not open
+         */
+        static std::shared_ptr<SharedProject> Find(std::string const &path) noexcept;
+
+        /**
+         * \brief  normalizes a path, so that different spellings of it compare equal
+         *
+         * \param  [in] path path of a project file
+         *
+         * \return normalized path
+         * \throw  std::bad_alloc
+         */
+        static std::string Normalize(std::string const &path);
+
+        /**
+         * \brief  lists the diagrams of the opened reader and registers the project
+         *
+         * \param  [in] self the project
+         *
+         * \throw  std::bad_alloc
+         */
+        static void Register(std::shared_ptr<SharedProject> const &self);
+
+        /**
+         * \brief  creates the undo stack and dispatcher of a loaded diagram
+         *
+         * \param  [in,out] diagram the diagram; its store must be set
+         *
+         * \throw  std::bad_alloc
+         */
+        static void Prepare(Diagram &diagram);
+    };
+}
+
+
@@ -0,0 +1,85 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  startup.hpp
+ * \brief definition of the component startup graph
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <functional>
+#include <string>
+#include <vector>
+
+/* external includes */
+#include <QThreadPool>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+
+
+namespace suzu {
+    /**
+     * \struct suzu::StartupStep
+     * \brief  initialization of a single component
+     */
+    struct StartupStep {
+        std::string              name; /**< unique name of the component */
+        std::vector<std::string> deps; /**< names of the components that must be initialized first */
+        bool                     gui;  /**< whether or not the step must run on the main thread */
+        std::function<bool()>    fn;   /**< initialization function; returns *false* on fatal errors */
+    };
+
+
+    /**
+     * \class suzu::StartupGraph
+     * \brief dependency graph of all components that are initialized during startup
+     *
+     * Every step is started as soon as all of its dependencies have finished. Steps that do not
+     * depend on each other run concurrently on a thread pool; steps marked as *gui* run on the
+     * calling (main) thread. The total startup time is therefore bounded by the longest chain of
+     * dependencies rather than by the sum of all steps.
+     *
+     * \note  Steps running on the pool must not touch GUI objects.
+     */
+    class StartupGraph {
+        std::vector<StartupStep> m_steps; /**< registered steps */
+
+    public:
+        /**
+         * \brief  registers a new startup step
+         *
+         * \param  [in] step step to register; dependencies may be registered later
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the step has no name or function, or if a step of the same name exists already
+         */
+        sdk::ErrorCode add(StartupStep step) noexcept;
+
+        /**
+         * \brief  runs all registered steps in dependency order
+         *
+         * Blocks until all steps have finished or until a step has failed. Once a step has failed,
+         * no further steps are started; steps that are already running are waited for.
+         *
+         * \param  [in] pool thread pool to run non-GUI steps on
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if a
+         *         dependency is missing or the dependencies are cyclic,
+         *         *suzu::sdk::ErrorCode::CriticalResource* if a step failed
+         * \note   Must be called from the main thread.
+         */
+        sdk::ErrorCode run(QThreadPool &pool) noexcept;
+    };
+}
+
+
@@ -0,0 +1,270 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  styles.hpp
+ * \brief definition of compiled style sheets
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/* external includes */
+#include <QBrush>
+#include <QColor>
+#include <QFont>
+#include <QPen>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+
+
+namespace suzu {
+    /**
+     * \struct suzu::ElementStyle
+     * \brief  resolved appearance of an element
+     *
+     * Properties that no rule sets are left invalid; Qt's defaults apply to them.
+     */
+    struct ElementStyle {
+        QColor fill;     /**< fill of the shape */
+        QColor stroke;   /**< outline of the shape */
+        QColor text;     /**< color of the name */
+        double width;    /**< width of the outline, in scene units; negative if not set */
+        double fontsize; /**< size of the name, in points; negative if not set */
+        int    bold;     /**< 1 for bold names, 0 for regular ones; negative if not set */
+    };
+
+    /**
+     * \struct suzu::StyleRecord
+     * \brief  resolved style, with the painter objects built from it
+     *
+     * Records are shared by all elements of the same appearance, so painting only has to switch
+     * objects when the record changes, and never builds them.
+     */
+    struct StyleRecord {
+        ElementStyle props;    /**< resolved properties */
+        QPen         shape;    /**< pen for the outline */
+        QPen         text;     /**< pen for the name */
+        QBrush       fill;     /**< brush for the shape; no brush if no fill is set */
+        QFont        font;     /**< font for the name; only used if *ownfont* is set */
+        bool         ownfont;  /**< whether or not the record sets a font; otherwise, the painter's is kept */
+        bool         textpen;  /**< whether or not *text* differs from *shape* */
+    };
+
+    /**
+     * \brief handle of a *suzu::StyleRecord* within its *suzu::StyleSheet*
+     */
+    using StyleHandle = uint32_t;
+
+    class StyleDelta;
+
+
+    /**
+     * \class suzu::StyleSheet
+     * \brief style sheet compiled into a table of resolved styles
+     *
+     * Sheets are JSON documents with a list of rules:
+     *
+     *     { "rules": [
+     *         { "kind": "class", "fill": "#fffbe6", "stroke": "#7a5c00" },
+     *         { "style": 3, "selected": true, "stroke": "#1a73e8", "width": 2 }
+     *     ] }
+     *
+     * A rule applies to an element if all of its selectors match: *kind*, *style* (the style id
+     * of the element) and the states *selected* and *locked* (*true* to require the state, *false*
+     * to rule it out). Like in CSS, a more specific rule overrides a less specific one, no matter
+     * their order: the style id counts most, then each state, then the kind. Among rules of equal
+     * specificity, the later one wins.
+     *
+     * Besides colors, rules may set the *width* of outlines and the *fontsize* (in points) and
+     * *bold* weight of names.
+     *
+     * Compiling sorts the rules by specificity once and then resolves the style of every possible
+     * combination of kind, state and style id: all style ids that no rule names share a single
+     * set of styles. Identical results are merged into one *suzu::StyleRecord*, which also holds
+     * the pens, brush and font for painting; the table itself only stores handles. Resolving the
+     * style of an element is thus a single lookup, and a sheet mostly holds a handful of records
+     * however many elements use them.
+     *
+     * Compiled sheets are immutable, so views and their render tasks can share them freely;
+     * changing the sheet means compiling a new one, while edits of elements never require any.
+     * When switching themes, *Diff()* tells which elements actually look different.
+     */
+    class StyleSheet {
+        friend class StyleDelta;
+
+        static constexpr uint32_t gl_states = 4; /**< combinations of the states that rules can select */
+
+        std::unordered_map<uint32_t, uint32_t> m_slots;   /**< slot of every style id named by a rule; all others use slot 0 */
+        std::vector<StyleHandle>               m_table;   /**< resolved styles, by slot, kind and state */
+        std::vector<StyleRecord>               m_records; /**< distinct resolved styles */
+        size_t                                 m_rules;   /**< number of rules */
+
+    public:
+        StyleSheet() noexcept;
+
+        /**
+         * \brief  compiles a style sheet
+         *
+         * \param  [in] json text of the style sheet
+         * \param  [out] res receives the compiled sheet
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+         *         the sheet is malformed, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran
+         *         out
+         */
+        static sdk::ErrorCode Compile(std::string_view json, std::shared_ptr<StyleSheet const> &res) noexcept;
+
+        /**
+         * \brief  reads and compiles a style sheet
+         *
+         * \param  [in] path path of the style sheet
+         * \param  [out] res receives the compiled sheet
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::ReadFile* if the
+         *         file could not be read, or the error of *Compile()*
+         */
+        static sdk::ErrorCode Load(char const *path, std::shared_ptr<StyleSheet const> &res) noexcept;
+
+        /**
+         * \brief  retrieves the style of an element
+         *
+         * \param  [in] kind kind of the element
+         * \param  [in] style style id of the element
+         * \param  [in] flags *suzu::sdk::ElementFlags* of the element
+         *
+         * \return handle of the resolved style
+         * \note   This function is thread-safe.
+         */
+        StyleHandle resolve(sdk::ElementKind const kind, uint32_t const style, uint32_t const flags) const noexcept {
+            auto const it = m_slots.find(style);
+
+            return m_table[CellOf(it != m_slots.end() ? it->second : 0, static_cast<size_t>(kind), StateOf(flags))];
+        }
+
+        /**
+         * \brief  retrieves a resolved style
+         *
+         * \param  [in] handle handle returned by *resolve()*
+         *
+         * \return style record; valid for the lifetime of the sheet
+         * \note   This function is thread-safe.
+         */
+        StyleRecord const &record(StyleHandle const handle) const noexcept { return m_records[handle]; }
+
+        size_t ruleCount() const noexcept   { return m_rules; }
+        size_t recordCount() const noexcept { return m_records.size(); }
+
+        /**
+         * \brief  compares the styles of two sheets, e.g. when switching themes
+         *
+         * \param  [in] old sheet used so far; *nullptr* for the default appearance
+         * \param  [in] now sheet to switch to; *nullptr* for the default appearance
+         * \param  [out] res receives the combinations of kind, style id and state whose resolved
+         *              style differs
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if memory ran out
+         */
+        static sdk::ErrorCode Diff(StyleSheet const *old, StyleSheet const *now, StyleDelta &res) noexcept;
+
+    private:
+        /**
+         * \brief  maps the flags of an element to the states that rules can select
+         *
+         * \param  [in] flags *suzu::sdk::ElementFlags* of the element
+         *
+         * \return bit 0 for the selection, bit 1 for the lock
+         */
+        static constexpr uint32_t StateOf(uint32_t const flags) noexcept {
+            return ((flags & sdk::ElementSelected) != 0 ? 1 : 0) | ((flags & sdk::ElementLocked) != 0 ? 2 : 0);
+        }
+
+        /**
+         * \brief  computes the position of a combination of slot, kind and state in a table
+         *
+         * \param  [in] slot slot of the style id
+         * \param  [in] kind kind of the element
+         * \param  [in] state state returned by *StateOf()*
+         *
+         * \return index into the table
+         */
+        static constexpr size_t CellOf(uint32_t const slot, size_t const kind, uint32_t const state) noexcept {
+            return (static_cast<size_t>(slot) * static_cast<size_t>(sdk::ElementKind::__NumElementKinds__) + kind) * gl_states + state;
+        }
+
+        /**
+         * \brief  retrieves the resolved style of a combination of style id, kind and state
+         *
+         * \param  [in] style style id; *std::nullopt* for one that no rule names
+         * \param  [in] kind kind of the element
+         * \param  [in] state state returned by *StateOf()*
+         *
+         * \return resolved properties
+         */
+        ElementStyle const &propsOf(std::optional<uint32_t> style, size_t kind, uint32_t state) const noexcept;
+    };
+
+
+    /**
+     * \class suzu::StyleDelta
+     * \brief styles that differ between two style sheets, computed by *suzu::StyleSheet::Diff()*
+     *
+     * Like a style sheet, the delta is a table over kind, state and style id, so checking an
+     * element is a single lookup. Views use it to re-render only the elements that look different.
+     */
+    class StyleDelta {
+        friend class StyleSheet;
+
+        std::unordered_map<uint32_t, uint32_t> m_slots;   /**< slot of every style id named by either sheet; all others use slot 0 */
+        std::vector<uint8_t>                   m_changed; /**< whether or not the style differs, by slot, kind and state */
+        size_t                                 m_count;   /**< number of differing combinations */
+
+    public:
+        StyleDelta() noexcept
+            : m_count(0)
+        { }
+
+        /**
+         * \brief  checks whether an element looks different with the new sheet
+         *
+         * \param  [in] kind kind of the element
+         * \param  [in] style style id of the element
+         * \param  [in] flags *suzu::sdk::ElementFlags* of the element
+         *
+         * \return *true* if its resolved style has changed
+         */
+        bool changed(sdk::ElementKind const kind, uint32_t const style, uint32_t const flags) const noexcept {
+            if (m_count == 0)
+                return false;
+
+            auto const it = m_slots.find(style);
+            return m_changed[StyleSheet::CellOf(it != m_slots.end() ? it->second : 0, static_cast<size_t>(kind), StyleSheet::StateOf(flags))] != 0;
+        }
+
+        /**
+         * \brief  checks whether the sheets resolve every element alike
+         *
+         * \return *true* if no element looks different
+         */
+        bool empty() const noexcept { return m_count == 0; }
+    };
+}
+
+
@@ -0,0 +1,207 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  textcache.hpp
+ * \brief definition of the cache of laid-out element labels
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/* external includes */
+#include <QFont>
+#include <QPainter>
+#include <QSizeF>
+#include <QStaticText>
+
+/* sdk includes */
+#include <sdk/intern.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::TextLayoutCache
+     * \brief keeps shaped and laid-out text runs, e.g. element names, for reuse across repaints
+     *
+     * Entries are keyed by interned string, font and width constraint, so the same label is only
+     * shaped once, no matter how often it is painted or measured. When the estimated size of all
+     * entries exceeds the budget, the least recently used entries are evicted first. Entries are
+     * also evicted to meet the memory budget shared by all caches (see *suzu::MemoryBudget*).
+     *
+     * Static text must not be painted from several threads at once, and is laid out again whenever
+     * it is painted with another transform. Entries are therefore also keyed by the calling thread
+     * and the scale they are prepared for, and *Draw()* paints them without laying them out again.
+     *
+     * \note  All functions are thread-safe; tiles rendered on worker threads share the cache with
+     *        the GUI thread, but not its entries. Text is laid out outside of the lock.
+     */
+    class TextLayoutCache {
+        static constexpr size_t gl_glyphbytes = 32; /**< estimated memory per character of a laid-out run */
+
+    public:
+        static constexpr size_t gl_defaultbudget = 8 * 1024 * 1024; /**< default memory budget, in bytes */
+        static constexpr double gl_cost          = 2.0;             /**< cost of an evicted entry for *suzu::MemoryBudget*; shaping costs more than rendering a tile */
+
+        /**
+         * \struct suzu::TextLayoutCache::Layout
+         * \brief  laid-out text run
+         */
+        struct Layout {
+            QStaticText text;  /**< prepared text; implicitly shared, so copies are cheap, but must only be painted on the thread it was retrieved on */
+            QSizeF      size;  /**< size of the laid-out text, in the font's units */
+            double      scale; /**< scale of the painters the text is prepared for */
+        };
+
+    private:
+        /**
+         * \struct suzu::TextLayoutCache::Key
+         * \brief  identifies a text run
+         */
+        struct Key {
+            uint32_t text;   /**< id of the interned string */
+            uint32_t font;   /**< index into *m_fonts* */
+            float    width;  /**< width constraint; negative if unconstrained */
+            float    scale;  /**< scale the text is prepared for */
+            uint32_t thread; /**< thread the text is painted on */
+
+            bool operator ==(Key const &other) const noexcept {
+                return text == other.text && font == other.font && width == other.width && scale == other.scale && thread == other.thread;
+            }
+        };
+
+        /**
+         * \struct suzu::TextLayoutCache::KeyHash
+         * \brief  hash function for *suzu::TextLayoutCache::Key*
+         */
+        struct KeyHash {
+            size_t operator ()(Key const &key) const noexcept {
+                return std::hash<uint64_t>{}((static_cast<uint64_t>(key.text) << 32 | key.font) ^ std::hash<float>{}(key.width) ^ (std::hash<float>{}(key.scale) << 1) ^ (static_cast<size_t>(key.thread) << 7));
+            }
+        };
+
+        /**
+         * \struct suzu::TextLayoutCache::Entry
+         * \brief  cached text run
+         */
+        struct Entry {
+            Key     key;    /**< key of the run */
+            Layout  layout; /**< laid-out text */
+            size_t  bytes;  /**< estimated memory used by the run */
+            int64_t used;   /**< time the run was last used, see *suzu::MemoryBudget::Now()* */
+        };
+
+        mutable std::mutex                                           m_lock;     /**< guards all other members */
+        std::list<Entry>                                             m_lru;      /**< entries, most recently used first */
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> m_index;    /**< entries, by key */
+        std::vector<QFont>                                           m_fonts;    /**< fonts referenced by keys */
+        size_t                                                       m_budget;   /**< maximum memory used by all entries, in bytes; 0 for no limit of its own */
+        size_t                                                       m_bytes;    /**< estimated memory used by all entries, in bytes */
+        uint32_t                                                     m_consumer; /**< id of the cache in *suzu::MemoryBudget::Shared()*; 0 if not registered */
+
+    public:
+        /**
+         * \brief constructs a new, empty cache
+         *
+         * \param [in] budget maximum memory used by all entries, in bytes; 0 to only be limited by
+         *             the budget shared by all caches
+         */
+        explicit TextLayoutCache(size_t budget = gl_defaultbudget) noexcept;
+        TextLayoutCache(TextLayoutCache const &) = delete;
+        TextLayoutCache &operator =(TextLayoutCache const &) = delete;
+        ~TextLayoutCache();
+
+        /**
+         * \brief  retrieves the cache shared by all renderers of the application
+         *
+         * \return reference to the cache
+         */
+        static TextLayoutCache &Shared();
+
+        /**
+         * \brief  retrieves the layout of a text run for the calling thread, laying it out on first
+         *         use
+         *
+         * \param  [in] text text to lay out
+         * \param  [in] font font to use
+         * \param  [in] width (optional) width at which the text wraps; negative for no wrapping
+         * \param  [in] scale (optional) scale of the painters the text is painted with, e.g.
+         *                   *QPainter::worldTransform().m11()*
+         *
+         * \return layout of the text; it must only be painted on the calling thread
+         */
+        Layout get(sdk::StringId text, QFont const &font, double width = -1.0, double scale = 1.0);
+
+        /**
+         * \brief paints a layout without laying it out again
+         *
+         * The translation of the painter is moved into the position, so that the transform matches
+         * the one the text was prepared for. Painters that rotate, shear, or scale differently than
+         * the layout was prepared for still paint the text, but lay it out again every time.
+         *
+         * \param [in] painter painter to paint with
+         * \param [in] position top-left corner of the text, in the painter's coordinates
+         * \param [in] layout layout retrieved by *get()* on the calling thread
+         */
+        static void Draw(QPainter &painter, QPointF const &position, Layout const &layout);
+
+        /**
+         * \brief  computes the size of a text run, e.g. while sizing elements during layout
+         *
+         * \param  [in] text text to measure
+         * \param  [in] font font to use
+         * \param  [in] width (optional) width at which the text wraps; negative for no wrapping
+         *
+         * \return size of the laid-out text
+         */
+        QSizeF measure(sdk::StringId text, QFont const &font, double width = -1.0) { return get(text, font, width).size; }
+
+        /**
+         * \brief changes the memory budget and evicts entries if necessary
+         *
+         * \param [in] budget maximum memory used by all entries, in bytes; 0 for no limit of its own
+         */
+        void setBudget(size_t budget) noexcept;
+
+        /**
+         * \brief removes all entries, e.g. after the fonts have changed
+         */
+        void clear() noexcept;
+
+        /**
+         * \brief  retrieves the number of cached runs
+         *
+         * \return number of entries
+         */
+        size_t size() const noexcept;
+
+        /**
+         * \brief  retrieves the estimated memory used by all entries
+         *
+         * \return memory, in bytes
+         */
+        size_t bytes() const noexcept;
+
+    private:
+        /**
+         * \brief evicts the least recently used entries until the budget is met; expects *m_lock*
+         *        to be held
+         */
+        void evict() noexcept;
+    };
+}
+
+
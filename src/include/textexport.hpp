@@ -0,0 +1,117 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  textexport.hpp
+ * \brief definition of the PlantUML and Mermaid exporters
+ *
+ * Diagrams are published to wikis as text that the wiki renders. Classes, interfaces and
+ * enumerations become classifiers, packages enclose their children, notes become notes, and
+ * associations connect the elements at the two corners of their bounds, like on the canvas.
+ * Names are written as labels; the identifiers in the text are derived from the position of the
+ * elements in the diagram. Bounds and styles are not written; the renderer of the wiki lays the
+ * diagram out anew.
+ *
+ * A PlantUML export is a single *.puml* file with one *@startuml* block per diagram. A Mermaid
+ * export is a single Markdown file with one section and fenced *mermaid* block per diagram.
+ * Mermaid has no nested namespaces, so nested packages are written flat, each as a namespace of
+ * its own.
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/* external includes */
+#include <spdlog/fmt/fmt.h>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+
+
+namespace suzu {
+    class JobContext;
+
+
+    /**
+     * \enum  suzu::TextFormat
+     * \brief text formats diagrams can be exported to
+     */
+    enum class TextFormat : uint32_t {
+        PlantUml, /**< PlantUML class diagrams */
+        Mermaid   /**< Mermaid class diagrams in Markdown */
+    };
+
+    /**
+     * \struct suzu::TextDiagram
+     * \brief  diagram to export as text
+     */
+    struct TextDiagram {
+        std::string_view         name;  /**< name of the diagram */
+        sdk::ElementStore const *store; /**< elements of the diagram */
+    };
+
+
+    /**
+     * \brief  retrieves the text format of an export file from its extension
+     *
+     * \param  [in] path path of the export file
+     * \param  [out] format receives the format: PlantUML for *.puml* and *.plantuml*, Mermaid for
+     *               *.md* and *.markdown*
+     *
+     * \return *true* if the extension is known
+     */
+    bool TextFormatOf(std::string_view path, TextFormat &format) noexcept;
+
+    /**
+     * \brief  appends the text of a diagram to a buffer
+     *
+     * \param  [in,out] out buffer to append to
+     * \param  [in] format format of the text
+     * \param  [in] name name of the diagram
+     * \param  [in] store elements of the diagram; hidden elements are skipped
+     *
+     * \throw  std::bad_alloc
+     * \note   May be called on any thread, as long as the store is not modified meanwhile.
+     */
+    void AppendDiagramText(fmt::memory_buffer &out, TextFormat format, std::string_view name, sdk::ElementStore const &store);
+
+    /**
+     * \brief  writes diagrams as a single PlantUML or Mermaid file
+     *
+     * The text of the diagrams is generated in parallel on the task scheduler, in batches of a few
+     * diagrams per worker. Every batch is generated into a pool of buffers that is reused by the
+     * next batch, so buffers only grow to the size of the largest diagrams instead of being
+     * allocated per diagram, and written in order with one write per diagram. Only the text of the
+     * current batch is held in memory. The file is only replaced once it has been written
+     * completely.
+     *
+     * \param  [in] path path of the export file
+     * \param  [in] format format of the file
+     * \param  [in] diagrams diagrams to export, in order
+     * \param  [in] job (optional) job receiving the progress; cancelling it stops the export
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidParameter* if
+     *         *path* or a store is *nullptr*, *suzu::sdk::ErrorCode::OpenFile* if the file could
+     *         not be created, *suzu::sdk::ErrorCode::WriteFile* if it could not be written,
+     *         *suzu::sdk::ErrorCode::NoOperation* if the job was cancelled, or
+     *         *suzu::sdk::ErrorCode::CriticalResource* if memory ran out; the previous file
+     *         remains untouched then
+     * \note   The stores must not be modified during the export; pass snapshots of diagrams that
+     *         are being edited (see *suzu::SharedProject::snapshot()*).
+     */
+    sdk::ErrorCode ExportText(char const *path, TextFormat format, std::vector<TextDiagram> const &diagrams, JobContext *job = nullptr) noexcept;
+}
+
+
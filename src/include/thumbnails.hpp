@@ -0,0 +1,207 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  thumbnails.hpp
+ * \brief definition of the thumbnail cache of the toolbox
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* external includes */
+#include <QImage>
+#include <QObject>
+
+/* sdk includes */
+#include <sdk/task.hpp>
+
+/* app includes */
+#include <plugins.hpp>
+#include <styles.hpp>
+
+
+namespace suzu {
+    /**
+     * \struct suzu::ToolboxEntry
+     * \brief  shape offered by the toolbox
+     */
+    struct ToolboxEntry {
+        std::string plugin;  /**< name of the contributing plug-in; empty for built-in shapes */
+        std::string version; /**< version of the plug-in */
+        std::string name;    /**< name of the entry, e.g. "Class" */
+    };
+
+
+    /**
+     * \class suzu::ThumbnailCache
+     * \brief preview images of the toolbox entries, cached in memory and on disk
+     *
+     * Thumbnails are requested lazily, when the toolbox shows an entry (*find()*). Missing ones
+     * are loaded from the disk cache or rendered in low-priority tasks, so the toolbox appears
+     * right away and fills in its previews as they become ready. Rendered thumbnails are written
+     * to the disk cache, so later launches only have to load them.
+     *
+     * Files are named by a hash of everything that affects the image: the plug-in and its
+     * version, the entry, the theme, the device pixel ratio and the size. Updating a plug-in or
+     * switching themes thus never shows outdated previews. Files of old versions are not removed.
+     *
+     * Thumbnails in memory are evicted to meet the memory budget shared by all caches (see
+     * *suzu::MemoryBudget*); they are loaded again from the disk cache once they are requested.
+     *
+     * When the toolbox moves to a screen of another scaling, the thumbnails of the former device
+     * pixel ratio are kept: they are shown scaled until the new ones are ready, and become current
+     * again at once if the toolbox moves back. They are evicted first, being used least recently.
+     *
+     * \note  The cache must only be used on the GUI thread.
+     */
+    class ThumbnailCache final : public QObject {
+    public:
+        static constexpr int    gl_thumbsize = 48;  /**< width and height of thumbnails, in device-independent pixels */
+        static constexpr double gl_cost      = 4.0; /**< cost of an evicted thumbnail for *suzu::MemoryBudget*; it is loaded from disk or rendered again */
+
+        using ReadyFn = std::function<void(size_t)>; /**< called with the index of an entry whose thumbnail became ready */
+
+    private:
+        std::string                                 m_dir;     /**< directory of the disk cache */
+        std::vector<ToolboxEntry>                   m_entries; /**< entries of the toolbox */
+        std::vector<QImage>                         m_images;  /**< thumbnails, by entry; null until ready */
+        std::vector<int64_t>                        m_used;    /**< time every thumbnail was last requested, by entry; see *suzu::MemoryBudget::Now()* */
+        std::vector<QImage>                         m_former;  /**< thumbnails of the previous device pixel ratio, by entry; null if none */
+        std::vector<int64_t>                        m_fused;   /**< time every thumbnail of *m_former* was last used, by entry */
+        size_t                                      m_bytes;   /**< memory used by all thumbnails, in bytes */
+        std::unordered_map<size_t, sdk::TaskHandle> m_pending; /**< tasks preparing thumbnails, by entry */
+        sdk::RetiredTasks                           m_retired; /**< cancelled tasks that may still be running */
+        std::shared_ptr<StyleSheet const>           m_styles;  /**< style sheet of the theme */
+        std::string                                 m_theme;   /**< name of the theme */
+        double                                      m_ratio;   /**< device pixel ratio */
+        double                                      m_fratio;  /**< device pixel ratio of *m_former*; 0 if none */
+        uint64_t                                    m_gen;     /**< generation of the settings; results of older ones are discarded */
+        ReadyFn                                     m_ready;   /**< receives finished thumbnails */
+        uint32_t                                    m_budget;  /**< id of the cache in *suzu::MemoryBudget::Shared()*; 0 if not registered */
+
+    public:
+        /**
+         * \brief constructs a new, empty cache
+         *
+         * \param [in] dir directory of the disk cache; created on demand
+         * \param [in] parent (optional) parent object
+         */
+        explicit ThumbnailCache(std::string dir, QObject *parent = nullptr) noexcept;
+        /**
+         * \brief cancels all pending thumbnails and waits for the tasks preparing them, and leaves the
+         *        shared memory budget
+         */
+        ~ThumbnailCache() override;
+
+        /**
+         * \brief  lists the entries of the toolbox: all element kinds, then the entries of all plug-ins
+         *
+         * \param  [in] manifests manifests of the discovered plug-ins
+         *
+         * \return entries, in toolbox order
+         * \throw  std::bad_alloc
+         */
+        static std::vector<ToolboxEntry> EntriesOf(std::vector<PluginManifest> const &manifests);
+
+        /**
+         * \brief sets the entries of the toolbox; all thumbnails are dropped
+         *
+         * \param [in] entries entries, in toolbox order
+         */
+        void setEntries(std::vector<ToolboxEntry> entries) noexcept;
+
+        /**
+         * \brief sets the theme the thumbnails are drawn in; all thumbnails are dropped
+         *
+         * \param [in] styles style sheet of the theme; *nullptr* for the default appearance
+         * \param [in] theme name of the theme, e.g. "dark"; identifies it in the disk cache
+         */
+        void setTheme(std::shared_ptr<StyleSheet const> styles, std::string theme) noexcept;
+
+        /**
+         * \brief sets the device pixel ratio of the toolbox, e.g. after it moved to another screen
+         *
+         * The thumbnails of the current ratio are kept for the case the toolbox moves back; those
+         * kept for the ratio set before become current again.
+         *
+         * \param [in] ratio device pixel ratio, e.g. 2 on high-DPI screens
+         */
+        void setPixelRatio(double ratio) noexcept;
+
+        /**
+         * \brief sets the function receiving finished thumbnails, e.g. to repaint the toolbox
+         *
+         * \param [in] fn function; called on the GUI thread
+         */
+        void setReadyHandler(ReadyFn fn) noexcept { m_ready = std::move(fn); }
+
+        /**
+         * \brief  retrieves the thumbnail of an entry, requesting it if it is not ready yet
+         *
+         * \param  [in] index index of the entry
+         *
+         * \return thumbnail, the one of the previous device pixel ratio while the current one is
+         *         not ready yet, or *nullptr* if neither is; valid until the settings change or the
+         *         shared memory budget is enforced
+         */
+        QImage const *find(size_t index) noexcept;
+
+        size_t size() const noexcept { return m_entries.size(); }
+
+    private:
+        /**
+         * \brief drops all thumbnails, including those of the previous device pixel ratio, and
+         *        cancels the pending ones
+         */
+        void reset() noexcept;
+
+        /**
+         * \brief cancels the pending thumbnails; results of tasks still running are discarded, and
+         *        the destructor waits for them
+         */
+        void cancel() noexcept;
+
+        /**
+         * \brief stores a finished thumbnail; called on the GUI thread
+         *
+         * \param [in] index index of the entry
+         * \param [in] gen generation of the settings it was prepared with
+         * \param [in] image thumbnail; null if it could not be rendered
+         */
+        void deliver(size_t index, uint64_t gen, QImage image) noexcept;
+
+        /**
+         * \brief  finds the least recently requested thumbnail that is ready, of either ratio
+         *
+         * \return index of its entry in *m_images*, the index plus *m_images.size()* for one in
+         *         *m_former*, or *2 * m_images.size()* if no thumbnail is ready
+         */
+        size_t coldest() const noexcept;
+
+        /**
+         * \brief  drops a thumbnail
+         *
+         * \param  [in] slot index as returned by *coldest()*
+         *
+         * \return memory freed, in bytes
+         */
+        size_t drop(size_t slot) noexcept;
+    };
+}
+
+
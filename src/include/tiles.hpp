@@ -0,0 +1,238 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  tiles.hpp
+ * \brief definition of the cache of rendered diagram tiles
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+/* external includes */
+#include <QImage>
+#include <QRectF>
+
+
+namespace suzu {
+    /**
+     * \struct suzu::TileKey
+     * \brief  identifies a tile by zoom factor, device pixel ratio and position in the tile grid
+     *
+     * At zoom factor *z* and device pixel ratio *r*, tile *(x, y)* covers the device pixels
+     * *[x, x + 1) * gl_tilesize* and *[y, y + 1) * gl_tilesize* of the scene scaled by *z * r*.
+     * Tiles of every ratio thus have the same size in memory, and windows moved between screens
+     * of different scaling keep the tiles of both.
+     */
+    struct TileKey {
+        uint64_t zoom;  /**< bit pattern of the zoom factor */
+        int32_t  x;     /**< column in the tile grid */
+        int32_t  y;     /**< row in the tile grid */
+        uint64_t ratio; /**< bit pattern of the device pixel ratio */
+
+        bool operator ==(TileKey const &other) const noexcept {
+            return zoom == other.zoom && x == other.x && y == other.y && ratio == other.ratio;
+        }
+    };
+
+    /**
+     * \struct suzu::TileKeyHash
+     * \brief  hash function for *suzu::TileKey*
+     */
+    struct TileKeyHash {
+        size_t operator ()(TileKey const &key) const noexcept {
+            uint64_t const pos = (static_cast<uint64_t>(static_cast<uint32_t>(key.x)) << 32) | static_cast<uint32_t>(key.y);
+
+            return std::hash<uint64_t>{}((key.zoom ^ key.ratio * 0xC2B2AE3D27D4EB4Full) * 0x9E3779B97F4A7C15ull ^ pos);
+        }
+    };
+
+
+    /**
+     * \class suzu::TileCache
+     * \brief keeps rendered square tiles of a diagram, for all recently used zoom factors and device
+     *        pixel ratios
+     *
+     * Tiles are only re-rendered if an element intersecting them has changed; panning over rendered
+     * tiles merely copies images. Dirty tiles are kept until they are replaced, so that they can be
+     * shown while their replacement is being rendered. When the images exceed the memory budget, the
+     * least recently used tiles are evicted first. Tiles are also evicted to meet the memory budget
+     * shared by all caches (see *suzu::MemoryBudget*).
+     *
+     * \note  The cache is not thread-safe.
+     */
+    class TileCache {
+    public:
+        static constexpr int    gl_tilesize = 256; /**< width and height of a tile, in device pixels */
+        static constexpr double gl_cost     = 1.0; /**< cost of an evicted tile for *suzu::MemoryBudget*; tiles are merely re-rendered */
+
+        /**
+         * \struct suzu::TileCache::Tile
+         * \brief  a rendered tile
+         */
+        struct Tile {
+            QImage   image;   /**< rendered contents */
+            bool     dirty;   /**< whether or not the contents are outdated */
+            int64_t  lastuse; /**< time the tile was last drawn, see *suzu::MemoryBudget::Now()* */
+        };
+
+    private:
+        using TileMap = std::unordered_map<TileKey, Tile, TileKeyHash>;
+
+        TileMap  m_tiles;    /**< all tiles */
+        size_t   m_budget;   /**< maximum size of all images, in bytes; 0 for no limit of its own */
+        size_t   m_bytes;    /**< current size of all images, in bytes */
+        uint32_t m_consumer; /**< id of the cache in *suzu::MemoryBudget::Shared()*; 0 if not registered */
+
+    public:
+        /**
+         * \brief constructs a new, empty cache
+         *
+         * \param [in] budget maximum size of all images, in bytes; 0 to only be limited by the
+         *             budget shared by all caches
+         */
+        explicit TileCache(size_t budget) noexcept;
+        TileCache(TileCache const &) = delete;
+        TileCache &operator =(TileCache const &) = delete;
+        ~TileCache();
+
+        /**
+         * \brief  computes the key of a tile
+         *
+         * \param  [in] zoom zoom factor
+         * \param  [in] ratio device pixel ratio of the screen, e.g. 2 for 200% scaling
+         * \param  [in] x column in the tile grid
+         * \param  [in] y row in the tile grid
+         *
+         * \return key of the tile
+         */
+        static TileKey KeyOf(double zoom, double ratio, int32_t x, int32_t y) noexcept;
+
+        /**
+         * \brief  computes the region of the scene covered by a tile
+         *
+         * \param  [in] key key of the tile
+         *
+         * \return region in scene coordinates
+         */
+        static QRectF SceneRect(TileKey const &key) noexcept;
+
+        /**
+         * \brief  retrieves the zoom factor of a tile
+         *
+         * \param  [in] key key of the tile
+         *
+         * \return zoom factor; 1 is 100%
+         */
+        static double ZoomOf(TileKey const &key) noexcept;
+
+        /**
+         * \brief  retrieves the device pixel ratio of a tile
+         *
+         * \param  [in] key key of the tile
+         *
+         * \return device pixel ratio
+         */
+        static double RatioOf(TileKey const &key) noexcept;
+
+        /**
+         * \brief  checks whether two tiles belong to the same grid, i.e. zoom factor and ratio
+         *
+         * \param  [in] a first tile
+         * \param  [in] b second tile
+         *
+         * \return *true* if the tiles only differ in their position
+         */
+        static bool SameGrid(TileKey const &a, TileKey const &b) noexcept { return a.zoom == b.zoom && a.ratio == b.ratio; }
+
+        /**
+         * \brief  looks up a tile and marks it as used
+         *
+         * \param  [in] key key of the tile
+         *
+         * \return pointer to the tile, or *nullptr* if it is not cached; valid until the next
+         *         call to *insert()* or *clear()*, or until the shared budget is enforced
+         */
+        Tile const *find(TileKey const &key) noexcept;
+
+        /**
+         * \brief adds or replaces a tile, evicting the least recently used tiles if necessary
+         *
+         * \param [in] key key of the tile
+         * \param [in] image rendered contents
+         * \param [in] dirty whether or not the contents are already outdated
+         */
+        void insert(TileKey const &key, QImage image, bool dirty = false);
+
+        /**
+         * \brief invokes *fn(key, tile)* for all tiles intersecting a region of the scene, at every
+         *        zoom factor
+         *
+         * Used to find placeholders for tiles that are still being rendered. Tiles are not marked
+         * as used.
+         *
+         * \param [in] region region of the scene, in scene coordinates
+         * \param [in] fn visitor
+         */
+        template<class Fn> void visit(QRectF const &region, Fn &&fn) const {
+            for (auto const &[key, tile] : m_tiles)
+                if (SceneRect(key).intersects(region))
+                    fn(key, tile);
+        }
+
+        /**
+         * \brief marks all tiles intersecting a region of the scene as dirty, at every zoom factor
+         *
+         * \param [in] region changed region, in scene coordinates
+         */
+        void invalidate(QRectF const &region) noexcept;
+
+        /**
+         * \brief marks all tiles of zoom factors below a bound as dirty, e.g. after packages drawn
+         *        collapsed at those zoom factors changed
+         *
+         * \param [in] zoom bound; tiles of this zoom factor and above are kept
+         */
+        void invalidateBelow(double zoom) noexcept;
+
+        /**
+         * \brief changes the memory budget and evicts tiles if necessary
+         *
+         * \param [in] budget maximum size of all images, in bytes; 0 for no limit of its own
+         */
+        void setBudget(size_t budget) noexcept;
+
+        /**
+         * \brief removes all tiles
+         */
+        void clear() noexcept;
+
+    private:
+        /**
+         * \brief evicts the least recently used tiles until the images fit into *limit* bytes
+         *
+         * \param [in] limit maximum size of all remaining images, in bytes
+         */
+        void evict(size_t limit) noexcept;
+
+        /**
+         * \brief  finds the least recently used tile
+         *
+         * \return iterator to the tile, or *m_tiles.end()* if the cache is empty
+         */
+        TileMap::iterator coldest() noexcept;
+    };
+}
+
+
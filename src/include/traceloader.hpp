@@ -0,0 +1,115 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  traceloader.hpp
+ * \brief definition of the background import of traces into sequence diagrams
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+/* external includes */
+#include <QTimer>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+#include <sdk/sequence.hpp>
+
+/* app includes */
+#include <jobs.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        struct TraceQueue;
+    }
+
+
+    /**
+     * \class suzu::TraceLoader
+     * \brief imports a trace into a sequence diagram, which grows while the import is running
+     *
+     * The trace is parsed by a background job (see *suzu::sdk::ImportTraceSequence()*), which
+     * queues the diagram in batches as it builds it. Every *gl_interval* milliseconds, the batches
+     * queued so far are added to the model on the GUI thread, in slices of at most *gl_slice*
+     * entries and for at most *gl_budget* milliseconds, so that a view can show and scroll through the beginning of the diagram
+     * while the rest is loading (see *suzu::SequenceView*).
+     *
+     * \note  The import must only be used on the GUI thread. The model must not be modified by
+     *        anything else while the import is running.
+     */
+    class TraceLoader {
+    public:
+        static constexpr int    gl_interval = 50;   /**< interval at which queued batches are added to the model, in milliseconds */
+        static constexpr double gl_budget   = 8.0;  /**< longest time spent adding batches per interval, in milliseconds */
+        static constexpr size_t gl_slice    = 2048; /**< most messages, activations and fragments each added at once, between checks of the budget */
+
+        using Changed = std::function<void()>;                /**< called after batches were added to the model, e.g. to repaint the view */
+        using Done    = std::function<void(sdk::ErrorCode)>;  /**< called once the import has ended, with its result */
+
+    private:
+        JobManager                           &m_jobs;    /**< runs the import */
+        sdk::SequenceModel                   &m_model;   /**< receives the diagram */
+        Changed                               m_changed; /**< notified of growth */
+        Done                                  m_done;    /**< notified of the end */
+        std::shared_ptr<internal::TraceQueue> m_queue;   /**< batches read by the running import; *nullptr* if none is running */
+        std::unique_ptr<QTimer>               m_timer;   /**< takes queued batches over */
+        uint64_t                              m_job;     /**< job running the import; 0 if none */
+
+    public:
+        /**
+         * \brief constructs a new, idle import
+         *
+         * \param [in] jobs runs the import; must outlive the import
+         * \param [in] model receives the diagram; must outlive the import
+         */
+        TraceLoader(JobManager &jobs, sdk::SequenceModel &model) noexcept;
+        TraceLoader(TraceLoader const &) = delete;
+        TraceLoader &operator =(TraceLoader const &) = delete;
+        /**
+         * \brief cancels a running import; the part of the diagram added so far is kept
+         */
+        ~TraceLoader();
+
+        /**
+         * \brief  starts importing a trace, replacing the contents of the model
+         *
+         * \param  [in] path path of the trace
+         * \param  [in] changed (optional) notified whenever the model has grown
+         * \param  [in] done (optional) notified once the import has ended, unless it was cancelled
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::InvalidState* if an
+         *         import is running already, or *suzu::sdk::ErrorCode::CriticalResource* if the job
+         *         could not be started
+         */
+        sdk::ErrorCode start(std::string path, Changed changed = {}, Done done = {}) noexcept;
+
+        /**
+         * \brief cancels the running import, if any; the part of the diagram added so far is kept
+         */
+        void cancel() noexcept;
+
+        bool isRunning() const noexcept { return m_queue != nullptr; }
+
+    private:
+        /**
+         * \brief adds queued batches to the model and ends the import once all have been added
+         */
+        void drain() noexcept;
+    };
+}
+
+
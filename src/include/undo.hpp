@@ -0,0 +1,366 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  undo.hpp
+ * \brief definition of the command-log undo stack
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/changes.hpp>
+#include <sdk/elements.hpp>
+
+/* app includes */
+#include <changeset.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::UndoStack
+     * \brief undoable editing of an element store
+     *
+     * Instead of snapshotting element state, every edit is recorded as a compact, reversible delta,
+     * e.g. a move stores the handle and the old and new bounds (42 bytes). The deltas of one
+     * operation are packed back-to-back into a single byte buffer, the *entry*. Names are recorded
+     * as interned *suzu::sdk::StringId*s, so deleted elements share their strings with the string
+     * table instead of copying them.
+     *
+     * Consecutive edits passing the same non-zero *merge* id, e.g. all mouse moves of one drag,
+     * are folded into a single entry: later moves of an element only update the new bounds of its
+     * first move. A drag thus costs one delta per element, no matter how long it lasts.
+     *
+     * The memory of all undo stacks is capped by a common budget (key "/undo/budget"). Once it
+     * is exceeded, the oldest entries of all stacks are dropped. Oldest entries are also dropped to
+     * meet the memory budget shared by all caches (see *suzu::MemoryBudget*), though only once they
+     * have been idle far longer than the entries of the other caches.
+     *
+     * Undoing the creation of an element and redoing it creates a new element, with a new handle.
+     * Deltas therefore refer to elements by the handle they had when they were first recorded;
+     * *resolve()* maps such a handle to the current one.
+     *
+     * If a *suzu::ChangeDispatcher* is set, every edit, undo and redo is reported to it, and
+     * groups are reported as transactions.
+     *
+     * \note  All edits of the store have to go through the stack to be undoable. The stack must
+     *        only be used on the GUI thread.
+     */
+    class UndoStack {
+    public:
+        static constexpr double gl_cost = 16.0; /**< cost of a dropped entry for *suzu::MemoryBudget*; it is lost for good */
+
+    private:
+        /**
+         * \struct suzu::UndoStack::Entry
+         * \brief  deltas of a single operation
+         */
+        struct Entry {
+            std::vector<uint8_t> data;   /**< encoded deltas, in the order they were applied */
+            uint64_t             merge;  /**< merge id of the operation; 0 if it cannot be merged */
+            uint64_t             serial; /**< age of the entry across all stacks */
+            int64_t              time;   /**< time the entry was recorded, see *suzu::MemoryBudget::Now()* */
+        };
+
+        static inline std::vector<UndoStack *> gl_stacks;     /**< all undo stacks */
+        static inline size_t                   gl_budget = 0; /**< memory budget of all stacks, in bytes; 0 for no limit */
+        static inline size_t                   gl_total  = 0; /**< memory used by all stacks, in bytes */
+        static inline uint64_t                 gl_serial = 0; /**< serial of the most recent entry */
+
+        sdk::ElementStore                                &m_store;   /**< edited diagram */
+        ChangeDispatcher                                 *m_changes; /**< receives all changes; may be *nullptr* */
+        std::deque<Entry>                                 m_undo;    /**< undoable entries, oldest first */
+        std::vector<Entry>                                m_redo;    /**< redoable entries, most recently undone last */
+        size_t                                            m_bytes;   /**< memory used by all entries */
+        uint32_t                                          m_depth;   /**< nesting depth of *beginGroup()* */
+        uint64_t                                          m_merge;   /**< merge id of the open group */
+        bool                                              m_grouped; /**< whether or not the open group has its entry already */
+        bool                                              m_open;    /**< whether or not edits may still be merged into the newest entry */
+        std::unordered_map<uint64_t, uint32_t>            m_moves;   /**< offset of the move delta of every element in the newest entry */
+        std::unordered_map<uint64_t, sdk::ElementHandle>  m_current; /**< current handle, by recorded handle; only for recreated elements */
+        std::unordered_map<uint64_t, sdk::ElementHandle>  m_origin;  /**< recorded handle, by current handle; only for recreated elements */
+        uint32_t                                          m_budget;  /**< id of the stack in *suzu::MemoryBudget::Shared()* */
+
+    public:
+        /**
+         * \brief constructs a new, empty undo stack
+         *
+         * \param [in] store diagram to edit; must outlive the stack
+         * \throw std::bad_alloc
+         */
+        explicit UndoStack(sdk::ElementStore &store);
+        UndoStack(UndoStack const &) = delete;
+        UndoStack &operator =(UndoStack const &) = delete;
+        ~UndoStack();
+
+        /**
+         * \brief sets the memory budget shared by all undo stacks
+         *
+         * \param [in] bytes budget, in bytes; 0 for no limit
+         */
+        static void SetTotalBudget(size_t bytes) noexcept;
+
+        /**
+         * \brief  retrieves the memory used by all undo stacks
+         *
+         * \return number of bytes
+         */
+        static size_t TotalBytes() noexcept { return gl_total; }
+
+        /**
+         * \brief sets the dispatcher receiving the changes of all edits
+         *
+         * \param [in] dispatcher dispatcher; *nullptr* to report no changes. Must outlive the stack.
+         * \note  Must not be changed while a group is open.
+         */
+        void setDispatcher(ChangeDispatcher *dispatcher) noexcept { m_changes = dispatcher; }
+
+        /**
+         * \brief starts an operation; all edits until the matching *endGroup()* are undone at once
+         *
+         * Groups may be nested; only the outermost group forms an entry.
+         *
+         * \param [in] merge (optional) merge id; a group with the same id as the newest entry is
+         *        merged into it
+         */
+        void beginGroup(uint64_t merge = 0) noexcept;
+        /**
+         * \brief ends an operation started by *beginGroup()*
+         */
+        void endGroup() noexcept;
+
+        /*
+         * Edits. They take current handles and behave like the functions of the same name of
+         * *suzu::sdk::ElementStore*, except that they do not throw: *create()* returns
+         * *suzu::sdk::gl_nullelement* and the others *suzu::sdk::ErrorCode::CriticalResource* if
+         * the edit could not be applied or recorded. Failed edits leave the diagram unchanged. Each
+         * edit outside of a group forms an entry of its own.
+         */
+        sdk::ElementHandle create(sdk::ElementKind kind, sdk::ElementRect const &bounds, uint32_t style = 0, sdk::ElementHandle parent = sdk::gl_nullelement, sdk::StringId name = {}) noexcept;
+        sdk::ErrorCode     destroy(sdk::ElementHandle handle) noexcept;
+        sdk::ErrorCode     setBounds(sdk::ElementHandle handle, sdk::ElementRect const &bounds, uint64_t merge = 0) noexcept;
+        sdk::ErrorCode     setStyle(sdk::ElementHandle handle, uint32_t style) noexcept;
+        sdk::ErrorCode     setFlags(sdk::ElementHandle handle, uint32_t flags) noexcept;
+        sdk::ErrorCode     setName(sdk::ElementHandle handle, sdk::StringId name) noexcept;
+        sdk::ErrorCode     raise(sdk::ElementHandle handle) noexcept;
+
+        /**
+         * \brief  creates all elements of a batch as a single undoable operation, e.g. for an
+         *         importer or a plug-in
+         *
+         * The elements are created in one pass (see *suzu::sdk::ElementStore::insert()*), recorded
+         * in one entry, and reported to the dispatcher in one transaction, so views and indexes are
+         * updated once for the whole batch.
+         *
+         * \param  [in] batch elements to create
+         * \param  [out] handles receives the handles of the new elements, by index in the batch
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if the
+         *         batch is empty, or the error of *suzu::sdk::ElementStore::insert()*; the diagram is
+         *         unchanged then
+         */
+        sdk::ErrorCode insert(sdk::ElementBatch const &batch, std::vector<sdk::ElementHandle> &handles) noexcept;
+
+        /**
+         * \brief  moves many elements by the same offset as a single undoable operation, e.g. when a
+         *         dragged selection is dropped
+         *
+         * The elements are moved in one pass (see *suzu::sdk::ElementStore::translate()*), recorded
+         * in one entry, and reported to the dispatcher in one transaction.
+         *
+         * \param  [in] handles elements to move; each at most once
+         * \param  [in] dx horizontal offset
+         * \param  [in] dy vertical offset
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or the error of
+         *         *suzu::sdk::ElementStore::translate()*; the diagram is unchanged then
+         */
+        sdk::ErrorCode translate(std::vector<sdk::ElementHandle> const &handles, float dx, float dy) noexcept;
+
+        /**
+         * \brief  reverts the newest entry
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if
+         *         there is nothing to undo, *suzu::sdk::ErrorCode::InvalidState* if a group is
+         *         open, or *suzu::sdk::ErrorCode::CriticalResource* if memory ran out
+         */
+        sdk::ErrorCode undo() noexcept;
+        /**
+         * \brief  re-applies the most recently undone entry
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if
+         *         there is nothing to redo, or *suzu::sdk::ErrorCode::InvalidState* if a group is
+         *         open
+         */
+        sdk::ErrorCode redo() noexcept;
+        /**
+         * \brief  reverts the newest entry and drops it, e.g. once the operation it recorded failed
+         *
+         * Unlike *undo()*, the entry is not put on the redo stack.
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if
+         *         there is nothing to revert, or *suzu::sdk::ErrorCode::InvalidState* if a group is
+         *         open
+         */
+        sdk::ErrorCode abort() noexcept;
+
+        bool canUndo() const noexcept { return !m_undo.empty() && m_depth == 0; }
+        bool canRedo() const noexcept { return !m_redo.empty() && m_depth == 0; }
+
+        /**
+         * \brief  maps the handle an element had when it was recorded to its current handle
+         *
+         * \param  [in] handle handle returned by an edit of this stack
+         *
+         * \return current handle; stale if the element does not exist at the moment
+         */
+        sdk::ElementHandle resolve(sdk::ElementHandle handle) const noexcept;
+
+        /**
+         * \brief drops all entries
+         */
+        void clear() noexcept;
+
+        /**
+         * \brief  retrieves the memory used by this stack
+         *
+         * \return number of bytes
+         */
+        size_t bytes() const noexcept { return m_bytes; }
+
+    private:
+        /**
+         * \brief  reports a change of an element to the dispatcher, if any
+         *
+         * \param  [in] kind kind of change
+         * \param  [in] handle current handle of the element
+         * \param  [in] prop changed property, for *suzu::sdk::ElementModified*
+         */
+        void notify(sdk::ChangeKind kind, sdk::ElementHandle handle, sdk::ChangeProperty prop = sdk::PropertyBounds) noexcept;
+
+        /**
+         * \brief  retrieves the handle under which an element is recorded
+         *
+         * \param  [in] handle current handle of the element
+         *
+         * \return recorded handle
+         */
+        sdk::ElementHandle origin(sdk::ElementHandle handle) const noexcept;
+
+        /**
+         * \brief  remembers that a recorded element was recreated under a new handle
+         *
+         * \param  [in] recorded recorded handle
+         * \param  [in] current new handle
+         */
+        void remap(sdk::ElementHandle recorded, sdk::ElementHandle current);
+
+        /**
+         * \brief  retrieves the entry receiving the next delta, creating it if necessary
+         *
+         * Space for *size* more bytes is reserved, so that appending them cannot fail.
+         *
+         * \param  [in] merge merge id of the edit
+         * \param  [in] size size of the encoded delta
+         *
+         * \return entry
+         * \throw  std::bad_alloc
+         */
+        Entry &prepare(uint64_t merge, size_t size);
+
+        /**
+         * \brief  records a change of a 32-bit component (style, flags or name)
+         *
+         * \param  [in] op kind of the delta
+         * \param  [in] handle current handle of the element
+         * \param  [in] before old value
+         * \param  [in] after new value
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if the delta could not be recorded
+         */
+        sdk::ErrorCode recordValue(uint8_t op, sdk::ElementHandle handle, uint32_t before, uint32_t after) noexcept;
+
+        /**
+         * \brief drops the newest entry if no delta was written to it
+         */
+        void abandon() noexcept;
+
+        /**
+         * \brief finishes recording a delta: drops the redoable entries and enforces the budget
+         */
+        void commit() noexcept;
+
+        /**
+         * \brief releases the spare capacity of an entry that will not receive more deltas
+         *
+         * \param [in,out] entry entry
+         */
+        void seal(Entry &entry) noexcept;
+
+        /**
+         * \brief updates the memory accounting after an entry has changed
+         *
+         * \param [in] before memory used by the entry before the change; 0 for new entries
+         * \param [in] after memory used by the entry after the change; 0 for dropped entries
+         */
+        void account(size_t before, size_t after) noexcept;
+
+        /**
+         * \brief drops all redoable entries
+         */
+        void dropRedo() noexcept;
+
+        /**
+         * \brief  applies the deltas of an entry
+         *
+         * \param  [in] entry entry to apply
+         * \param  [in] forward *true* to redo, *false* to undo
+         */
+        void play(Entry const &entry, bool forward) noexcept;
+
+        /**
+         * \brief  drops the oldest entry, unless it is still being recorded
+         *
+         * \return memory released, in bytes; 0 if no entry was dropped
+         */
+        size_t dropOldest() noexcept;
+
+        /**
+         * \brief  checks whether *dropOldest()* would drop an entry
+         *
+         * \return *true* if the oldest entry is not being recorded
+         */
+        bool canDropOldest() const noexcept { return m_undo.size() > static_cast<size_t>(m_depth > 0 && m_grouped); }
+
+        /**
+         * \brief drops the oldest entries of all stacks until the budget is met, then enforces the
+         *        budget shared by all caches
+         */
+        static void Enforce() noexcept;
+
+        /**
+         * \brief  computes the memory used by an entry
+         *
+         * \param  [in] entry entry
+         *
+         * \return number of bytes
+         */
+        static size_t SizeOf(Entry const &entry) noexcept { return sizeof(Entry) + entry.data.capacity(); }
+    };
+}
+
+
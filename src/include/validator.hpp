@@ -0,0 +1,236 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  validator.hpp
+ * \brief definition of the live well-formedness validator of diagrams
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* external includes */
+#include <QObject>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/task.hpp>
+
+/* app includes */
+#include <changeset.hpp>
+
+
+namespace suzu {
+    /**
+     * \enum  suzu::DiagnosticRule
+     * \brief well-formedness rules checked by *suzu::ModelValidator*
+     */
+    enum class DiagnosticRule {
+        CyclicOwnership, /**< the element is (indirectly) owned by itself */
+        DanglingOwner,   /**< the owner of the element no longer exists */
+        InvalidOwner,    /**< the element is owned by a note or an association */
+        DuplicateName,   /**< another member of the same namespace has the same name */
+        UnnamedElement,  /**< a classifier or package has no name */
+
+        __NumDiagnosticRules__ /**< (only used internally) */
+    };
+
+    /**
+     * \enum  suzu::DiagnosticSeverity
+     * \brief severity of a violated rule
+     */
+    enum class DiagnosticSeverity {
+        Warning, /**< the diagram is usable, but likely not what was intended */
+        Error    /**< the diagram is not a well-formed UML model */
+    };
+
+    /**
+     * \struct suzu::Diagnostic
+     * \brief  violation of a rule by an element
+     */
+    struct Diagnostic {
+        sdk::ElementHandle element; /**< offending element */
+        DiagnosticRule     rule;    /**< violated rule */
+        sdk::ElementHandle related; /**< other element involved, e.g. the member of the same name; *gl_nullelement* if none */
+    };
+
+
+    /**
+     * \class suzu::ModelValidator
+     * \brief checks the well-formedness of a diagram while it is edited
+     *
+     * The rules concern the ownership of elements, which forms the namespaces of the model: no
+     * element may own itself, owners must exist and be packages or classifiers, the members of a
+     * namespace must be distinguishable by name, and classifiers and packages should be named.
+     *
+     * Validation is incremental. The validator subscribes to the consolidated changes of the model
+     * (see *changed()*) and re-checks only the namespaces the changes touched: that of every added,
+     * renamed or moved element, the one a moved element left (through its earlier diagnostics),
+     * and the elements a removed owner leaves behind. Every check runs on the task scheduler, on a
+     * snapshot of kinds, owners and names taken on the GUI thread; the namespaces to be checked are
+     * distributed over the workers, so validating a whole diagram, e.g. after loading it, runs in
+     * parallel as well. At most one validation is in flight; changes arriving meanwhile are
+     * collected and checked in a single run once it has finished.
+     *
+     * Diagnostics are merged on the GUI thread, and the elements whose diagnostics changed are
+     * reported to the report handler, e.g. to update their items in the project explorer (see
+     * *suzu::ProjectExplorerModel::setValidator()*).
+     *
+     * \note  The validator must only be used on the GUI thread.
+     */
+    class ModelValidator final : public QObject {
+    public:
+        using ReportFn = std::function<void(std::vector<sdk::ElementHandle> const &)>; /**< called with the elements whose diagnostics changed */
+
+        /**
+         * \brief  retrieves the severity of a rule
+         *
+         * \param  [in] rule rule
+         *
+         * \return *suzu::DiagnosticSeverity::Warning* for unnamed elements; errors otherwise
+         */
+        static constexpr DiagnosticSeverity SeverityOf(DiagnosticRule const rule) noexcept {
+            return rule == DiagnosticRule::UnnamedElement ? DiagnosticSeverity::Warning : DiagnosticSeverity::Error;
+        }
+
+        /**
+         * \brief  retrieves the description of a rule, for tool tips and logs
+         *
+         * \param  [in] rule rule
+         *
+         * \return description; a static string
+         */
+        static char const *MessageOf(DiagnosticRule rule) noexcept;
+
+    private:
+        static constexpr uint32_t gl_stalescope = UINT32_MAX; /**< scope of elements whose owner no longer exists */
+
+        /**
+         * \struct suzu::ModelValidator::Snapshot
+         * \brief  structure of the model, as seen by validation tasks
+         */
+        struct Snapshot {
+            std::vector<sdk::ElementKind>   kinds;   /**< kinds, by dense index */
+            std::vector<uint32_t>           scopes;  /**< dense index of the owner plus one, by dense index; 0 for top-level elements, *gl_stalescope* for stale owners */
+            std::vector<sdk::StringId>      names;   /**< names, by dense index */
+            std::vector<sdk::ElementHandle> handles; /**< handles, by dense index */
+        };
+
+        /**
+         * \struct suzu::ModelValidator::Result
+         * \brief  outcome of a validation task
+         */
+        struct Result {
+            std::vector<sdk::ElementHandle> checked; /**< elements checked; their earlier diagnostics are replaced */
+            std::vector<Diagnostic>         found;   /**< diagnostics of the checked elements */
+            bool                            failed;  /**< whether or not memory ran out; nothing was checked then */
+        };
+
+        sdk::ElementStore const                                         *m_store;   /**< validated diagram; not owned */
+        std::unordered_map<sdk::ElementHandle, std::vector<Diagnostic>>  m_diags;   /**< current diagnostics, by element */
+        std::unordered_set<sdk::ElementHandle>                           m_dirty;   /**< owners of the namespaces to be checked; *gl_nullelement* for the top level */
+        bool                                                             m_stale;   /**< whether or not elements of removed owners are to be checked */
+        bool                                                             m_all;     /**< whether or not everything is to be checked */
+        sdk::TaskHandle                                                  m_task;    /**< validation in flight, if any */
+        sdk::RetiredTasks                                                m_retired; /**< cancelled validations that may still be running */
+        uint64_t                                                         m_gen;     /**< generation of the store; results for older ones are discarded */
+        ReportFn                                                         m_report;  /**< receives the elements whose diagnostics changed */
+
+    public:
+        explicit ModelValidator(QObject *parent = nullptr) noexcept;
+        /**
+         * \brief cancels the validation in flight and waits for it
+         */
+        ~ModelValidator() override;
+
+        /**
+         * \brief sets the validated diagram and validates it as a whole
+         *
+         * \param [in] store elements to validate; *nullptr* for none. Must outlive the validator,
+         *                   or be replaced before it is destroyed.
+         */
+        void setStore(sdk::ElementStore const *store) noexcept;
+
+        /**
+         * \brief sets the function receiving the elements whose diagnostics changed
+         *
+         * \param [in] fn function; called on the GUI thread
+         */
+        void setReportHandler(ReportFn fn) noexcept { m_report = std::move(fn); }
+
+        /**
+         * \brief schedules the namespaces touched by changes of the model for validation
+         *
+         * Meant to be subscribed to the *suzu::ChangeDispatcher* of the store.
+         *
+         * \param [in] changes consolidated changes
+         */
+        void changed(ChangeSet const &changes) noexcept;
+
+        /**
+         * \brief  retrieves the diagnostics of an element
+         *
+         * \param  [in] handle element
+         *
+         * \return diagnostics, or *nullptr* if the element has none; valid until the next merge
+         */
+        std::vector<Diagnostic> const *find(sdk::ElementHandle handle) const noexcept;
+
+        size_t size() const noexcept { return m_diags.size(); }
+
+        /**
+         * \brief  checks whether a validation is in flight or scheduled
+         *
+         * \return *true* if the diagnostics may not reflect the latest changes yet
+         */
+        bool busy() const noexcept { return m_task.isValid() || m_all || m_stale || !m_dirty.empty(); }
+
+    private:
+        /**
+         * \brief marks the namespace an element belongs to as to be checked
+         *
+         * \param [in] handle element; stale handles are ignored
+         */
+        void touch(sdk::ElementHandle handle);
+
+        /**
+         * \brief starts a validation of everything marked, unless one is in flight
+         */
+        void schedule() noexcept;
+
+        /**
+         * \brief  checks the namespaces of a snapshot; may run on any thread
+         *
+         * \param  [in] snap snapshot of the model
+         * \param  [in] scopes scopes to check, see *Snapshot::scopes*; ignored if *all* is set
+         * \param  [in] all whether or not to check every namespace
+         *
+         * \return checked elements and their diagnostics
+         */
+        static Result Validate(Snapshot const &snap, std::unordered_set<uint32_t> const &scopes, bool all);
+
+        /**
+         * \brief merges the outcome of a validation; called on the GUI thread
+         *
+         * \param [in] gen generation of the store it was taken from
+         * \param [in] res outcome
+         */
+        void deliver(uint64_t gen, Result res) noexcept;
+    };
+}
+
+
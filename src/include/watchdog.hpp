@@ -0,0 +1,123 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  watchdog.hpp
+ * \brief detection of stalls of the GUI event loop
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/* external includes */
+#include <QTimer>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+
+
+namespace suzu {
+    /**
+     * \class suzu::StallWatchdog
+     * \brief reports when the GUI event loop stops processing events, e.g. because of a UI freeze
+     *
+     * A timer on the GUI thread updates a heartbeat several times per threshold. A thread of the
+     * watchdog checks the heartbeat; once it is older than the threshold (key
+     * "/watchdog/stall"), the stack of the GUI thread and the profiling zone it is in (see
+     * *suzu::sdk::Profiler::active()*) are captured and logged as a warning. Every stall is
+     * reported once; when the event loop resumes, its total duration is logged as well.
+     *
+     * Stacks are captured while the GUI thread is interrupted: on Windows by suspending it and
+     * copying its registers and the top of its stack, which takes no lock the thread could hold,
+     * and unwinding the copy once the thread runs again (x64 only); elsewhere by a signal whose
+     * handler records the stack. Symbols are resolved afterwards, on the thread of the watchdog. Profiling zones are only
+     * known while the profiler records (keys "/profile/trace" and "/hud/visible").
+     *
+     * If the watchdog thread itself wakes up late, e.g. after the system was suspended, the
+     * missed heartbeats are not reported as a stall.
+     */
+    class StallWatchdog {
+    public:
+        static constexpr int      gl_minbeat   = 10; /**< shortest interval between heartbeats, in milliseconds */
+        static constexpr uint32_t gl_maxframes = 64; /**< maximum number of captured stack frames */
+        static constexpr size_t   gl_maxstack  = size_t(256) << 10; /**< most bytes of the GUI thread's stack copied to unwind it */
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Platform;
+
+        uint32_t                  m_threshold; /**< time without heartbeat after which the event loop is considered stalled, in milliseconds */
+        std::unique_ptr<QTimer>   m_timer;     /**< updates the heartbeat on the GUI thread */
+        std::atomic<int64_t>      m_beat;      /**< time of the last heartbeat, in nanoseconds since the epoch of *Clock* */
+        uint32_t                  m_thread;    /**< profiler id of the GUI thread */
+        std::unique_ptr<Platform> m_platform;  /**< handle of the GUI thread and state of stack captures */
+        std::thread               m_worker;    /**< checks the heartbeat */
+        std::mutex                m_lock;      /**< guards *m_stop* */
+        std::condition_variable   m_wake;      /**< wakes the worker when stopping */
+        bool                      m_stop;      /**< whether or not the worker has to exit */
+
+    public:
+        /**
+         * \brief constructs a stopped watchdog
+         *
+         * \param [in] threshold time without heartbeat after which the event loop is considered
+         *             stalled, in milliseconds; 0 disables the watchdog
+         */
+        explicit StallWatchdog(uint32_t threshold) noexcept;
+        StallWatchdog(StallWatchdog const &) = delete;
+        StallWatchdog &operator =(StallWatchdog const &) = delete;
+        /**
+         * \brief stops the watchdog
+         */
+        ~StallWatchdog();
+
+        /**
+         * \brief  starts watching the event loop of the calling thread, i.e., the GUI thread
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::NoOperation* if the
+         *         watchdog is disabled, *suzu::sdk::ErrorCode::InvalidState* if it is running
+         *         already, or *suzu::sdk::ErrorCode::CriticalResource* if the thread could not be
+         *         started
+         */
+        sdk::ErrorCode start() noexcept;
+
+        /**
+         * \brief stops watching and waits for the worker to exit; called on the GUI thread
+         */
+        void stop() noexcept;
+
+        bool isRunning() const noexcept { return m_worker.joinable(); }
+
+    private:
+        /**
+         * \brief checks the heartbeat until the watchdog is stopped; runs on the worker
+         */
+        void run() noexcept;
+
+        /**
+         * \brief  captures and symbolizes the stack of the GUI thread; called by the worker
+         *
+         * \return one line per frame, innermost first; empty if the stack could not be captured
+         */
+        std::string captureStack() noexcept;
+    };
+}
+
+
@@ -0,0 +1,85 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  xmi.hpp
+ * \brief definition of the streaming XMI encoder and decoder
+ *
+ * Diagrams are exchanged with other UML tools as XMI 2.5. Elements become *packagedElement*s
+ * (*nestedClassifier*s within classifiers, *ownedComment*s for notes) of a single *uml:Model*,
+ * nested like their parents. Bounds, styles and flags, which UML has no place for, are written
+ * to an *xmi:Extension* with *extender="Suzu"* that other tools ignore:
+ *
+ *     <xmi:Extension extender="Suzu">
+ *         <shape element="e0" x="0" y="0" width="120" height="80" style="0" flags="0"/>
+ *     </xmi:Extension>
+ */
+
+
+#pragma once
+
+/* stdlib includes */
+#include <string>
+#include <string_view>
+
+/* sdk includes */
+#include <sdk/elements.hpp>
+#include <sdk/error.hpp>
+
+
+namespace suzu {
+    class JobContext;
+
+
+    /**
+     * \brief  writes a diagram as an XMI document
+     *
+     * The document is written element by element; nothing but the nesting of the elements is
+     * held in memory. The file is only replaced once it has been written completely.
+     *
+     * \param  [in] path path of the XMI file
+     * \param  [in] name name of the model
+     * \param  [in] store elements of the diagram
+     * \param  [in] job (optional) job receiving the progress; cancelling it stops the export
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::OpenFile* if the file
+     *         could not be created, *suzu::sdk::ErrorCode::WriteFile* if it could not be written,
+     *         or *suzu::sdk::ErrorCode::NoOperation* if the job was cancelled; the previous file
+     *         remains untouched then
+     * \note   The drawing order is not preserved; parents are drawn below their children.
+     */
+    sdk::ErrorCode ExportXmi(char const *path, std::string_view name, sdk::ElementStore const &store, JobContext *job = nullptr) noexcept;
+
+    /**
+     * \brief  reads a diagram from an XMI document
+     *
+     * The document is streamed; no DOM is built. Elements are created as soon as their start tag
+     * has been read. References (the shapes of the Suzu extension) are collected in a first pass
+     * and resolved through a table of all *xmi:id*s in a second one, so memory stays proportional
+     * to the model rather than to the XML text. Elements without a shape, e.g. from other tools,
+     * are placed on a grid.
+     *
+     * Classes, interfaces, enumerations, packages, associations and comments are imported; all
+     * other UML elements are skipped, but their nested elements are not.
+     *
+     * \param  [in] path path of the XMI file
+     * \param  [out] store receives the elements; cleared first
+     * \param  [out] name (optional) receives the name of the model
+     * \param  [out] error (optional) receives a description of the error, if any
+     * \param  [in] job (optional) job receiving the progress; cancelling it stops the import
+     *
+     * \return *suzu::sdk::ErrorCode::Ok* on success, *suzu::sdk::ErrorCode::OpenFile* if the file
+     *         could not be opened, *suzu::sdk::ErrorCode::ReadFile* if it is not well-formed,
+     *         *suzu::sdk::ErrorCode::NoOperation* if the job was cancelled, or
+     *         *suzu::sdk::ErrorCode::CriticalResource* if memory ran out; *store* is empty then
+     */
+    sdk::ErrorCode ImportXmi(char const *path, sdk::ElementStore &store, std::string *name = nullptr, std::string *error = nullptr, JobContext *job = nullptr) noexcept;
+}
+
+
@@ -0,0 +1,120 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  instance.cpp
+ * \brief implementation of the single-instance mode
+ */
+
+
+/* external includes */
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QLocalSocket>
+
+/* app includes */
+#include <instance.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \brief  retrieves the name of the local socket shared by all instances of the current user
+         *
+         * \return socket name
+         */
+        static QString GetInstanceSocketName() {
+            return QStringLiteral("suzu-%1").arg(qHash(QDir::homePath()));
+        }
+    }
+
+
+    bool ForwardToRunningInstance(int argc, char **argv) noexcept {
+        try {
+            QStringList args;
+            for (int i = 1; i < argc; ++i) {
+                if (argv[i] == gl_newinstflag)
+                    return false;
+
+                QString const arg = QString::fromLocal8Bit(argv[i]);
+                args.push_back(arg.startsWith(QLatin1Char('-')) ? arg : QFileInfo(arg).absoluteFilePath());
+            }
+
+            QLocalSocket sock;
+            sock.connectToServer(internal::GetInstanceSocketName());
+            if (!sock.waitForConnected(gl_insttimeout))
+                return false;
+
+            /* Send the command-line and wait for the acknowledgement. */
+            QByteArray  msg;
+            QDataStream out(&msg, QIODevice::WriteOnly);
+            out << args;
+
+            sock.write(msg);
+            if (!sock.waitForBytesWritten(gl_insttimeout) || !sock.waitForReadyRead(gl_insttimeout))
+                return false;
+
+            return sock.read(1) == QByteArray(1, '\x01');
+        } catch (...) { }
+
+        return false;
+    }
+
+
+    sdk::ErrorCode InstanceServer::listen(Handler handler) noexcept {
+        if (m_server != nullptr)
+            return sdk::ErrorCode::InvalidState;
+
+        try {
+            auto server = std::make_unique<QLocalServer>();
+            QString const name = internal::GetInstanceSocketName();
+
+            /* A crashed instance may have left its socket file behind. */
+            if (!server->listen(name) && !(QLocalServer::removeServer(name) && server->listen(name)))
+                return sdk::ErrorCode::CriticalResource;
+
+            QLocalServer *const raw = server.get();
+            QObject::connect(raw, &QLocalServer::newConnection, raw, [this, raw]() {
+                while (QLocalSocket *const sock = raw->nextPendingConnection()) {
+                    QObject::connect(sock, &QLocalSocket::disconnected, sock, &QObject::deleteLater);
+                    QObject::connect(sock, &QLocalSocket::readyRead, sock, [this, sock]() {
+                        /* The command-line may arrive in several chunks. */
+                        QStringList args;
+                        QDataStream in(sock);
+                        in.startTransaction();
+                        in >> args;
+                        if (!in.commitTransaction())
+                            return;
+
+                        sock->write(QByteArray(1, '\x01'));
+                        sock->disconnectFromServer();
+
+                        try {
+                            std::vector<std::string> res;
+                            for (QString const &arg : args)
+                                res.push_back(arg.toStdString());
+
+                            m_handler(res);
+                        } catch (...) { }
+                    });
+                }
+            });
+
+            m_handler = std::move(handler);
+            m_server  = std::move(server);
+        } catch (...) {
+            return sdk::ErrorCode::Unknown;
+        }
+
+        return sdk::ErrorCode::Ok;
+    }
+}
+
+
@@ -0,0 +1,202 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  jobs.cpp
+ * \brief implementation of the background job manager
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+/* external includes */
+#include <QMetaObject>
+
+/* app includes */
+#include <jobs.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \struct suzu::internal::JobRecord
+         * \brief  shared state of a single job
+         */
+        struct JobRecord {
+            JobManager          *m_mgr;       /**< owning job manager */
+            std::mutex           m_lock;      /**< guards *m_status* and *m_task* */
+            JobStatus            m_status;    /**< most recent status */
+            sdk::TaskHandle      m_task;      /**< task running the job */
+            std::atomic<bool>    m_cancelled; /**< whether or not cancellation was requested */
+            std::atomic<bool>    m_posted;    /**< whether or not an update is on its way to the GUI thread */
+            std::atomic<int64_t> m_lastpost;  /**< time of the last posted update */
+
+            JobRecord(JobManager *mgr, JobStatus status)
+                : m_mgr(mgr), m_status(std::move(status)), m_cancelled(false), m_posted(false), m_lastpost(0)
+            { }
+        };
+
+        /**
+         * \brief  retrieves the current time for throttling purposes
+         *
+         * \return steady-clock time, in nanoseconds
+         */
+        static int64_t GetJobClock() noexcept {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+
+    bool JobContext::isCancelled() const noexcept {
+        return m_rec->m_cancelled || sdk::IsTaskCancelled();
+    }
+
+    void JobContext::report(double progress, std::string text) noexcept {
+        {
+            std::lock_guard<std::mutex> lock(m_rec->m_lock);
+
+            m_rec->m_status.progress = std::clamp(progress, 0.0, 1.0);
+            m_rec->m_status.text.swap(text);
+        }
+
+        if (internal::GetJobClock() - m_rec->m_lastpost >= m_rec->m_mgr->m_interval)
+            m_rec->m_mgr->post(m_rec);
+    }
+
+
+    JobManager::JobManager(uint32_t maxrate)
+        : m_context(std::make_unique<QObject>()),
+          m_interval(maxrate == 0 ? 0 : 1000000000 / static_cast<int64_t>(maxrate)),
+          m_nextid(1)
+    { }
+
+    JobManager::~JobManager() {
+        std::vector<std::shared_ptr<internal::JobRecord>> jobs;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            for (auto const &[id, rec] : m_jobs)
+                jobs.push_back(rec);
+        }
+
+        for (std::shared_ptr<internal::JobRecord> const &rec : jobs)
+            rec->m_cancelled = true;
+        for (std::shared_ptr<internal::JobRecord> const &rec : jobs) {
+            sdk::TaskHandle task;
+            {
+                std::lock_guard<std::mutex> lock(rec->m_lock);
+
+                task = rec->m_task;
+            }
+
+            task.wait();
+        }
+    }
+
+
+    void JobManager::setListener(Listener listener) noexcept {
+        m_listener = std::move(listener);
+    }
+
+    uint64_t JobManager::start(std::string name, Job job, sdk::TaskPriority prio) noexcept {
+        if (!job)
+            return 0;
+
+        try {
+            std::shared_ptr<internal::JobRecord> rec;
+            {
+                std::lock_guard<std::mutex> lock(m_lock);
+
+                rec = std::make_shared<internal::JobRecord>(this, JobStatus{ m_nextid, std::move(name), JobStatus::Running, 0.0, {} });
+                m_jobs.emplace(m_nextid++, rec);
+            }
+            post(rec);
+
+            sdk::TaskHandle task = sdk::SubmitTask([rec, job = std::move(job)]() {
+                bool ok = false;
+                if (!rec->m_cancelled) {
+                    try {
+                        JobContext ctx(rec);
+
+                        ok = job(ctx);
+                    } catch (...) { }
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(rec->m_lock);
+
+                    JobStatus &status = rec->m_status;
+                    status.state = rec->m_cancelled ? JobStatus::Cancelled : (ok ? JobStatus::Finished : JobStatus::Failed);
+                    if (status.state == JobStatus::Finished)
+                        status.progress = 1.0;
+                }
+
+                /* The final status is always delivered, regardless of the rate limit. */
+                rec->m_mgr->post(rec);
+            }, prio);
+
+            std::lock_guard<std::mutex> lock(rec->m_lock);
+            rec->m_task = std::move(task);
+            return rec->m_status.id;
+        } catch (...) { }
+
+        return 0;
+    }
+
+    sdk::ErrorCode JobManager::cancel(uint64_t id) noexcept {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        auto const it = m_jobs.find(id);
+        if (it == m_jobs.end())
+            return sdk::ErrorCode::InvalidParameter;
+
+        it->second->m_cancelled = true;
+        return sdk::ErrorCode::Ok;
+    }
+
+
+    void JobManager::post(std::shared_ptr<internal::JobRecord> const &rec) noexcept {
+        /* Updates are coalesced; the pending update picks up the most recent status on delivery. */
+        if (rec->m_posted.exchange(true))
+            return;
+        rec->m_lastpost = internal::GetJobClock();
+
+        try {
+            QMetaObject::invokeMethod(m_context.get(), [this, rec]() {
+                rec->m_posted = false;
+
+                JobStatus status;
+                {
+                    std::lock_guard<std::mutex> lock(rec->m_lock);
+
+                    status = rec->m_status;
+                }
+
+                if (status.state != JobStatus::Running) {
+                    std::lock_guard<std::mutex> lock(m_lock);
+
+                    m_jobs.erase(status.id);
+                }
+
+                try {
+                    if (m_listener)
+                        m_listener(status);
+                } catch (...) { }
+            }, Qt::QueuedConnection);
+        } catch (...) {
+            rec->m_posted = false;
+        }
+    }
+}
+
+
@@ -13,11 +13,24 @@
  */
 
 
+/* sdk includes */
+#include <sdk/timeline.hpp>
+
 /* app includes */
 #include <application.hpp>
+#include <instance.hpp>
 
 
 int main(int argc, char **argv) {
+    /* Startup phases are measured relative to this point. */
+    suzu::sdk::Timeline::Startup().reset();
+
+    /* Hand the command-line over to a running instance, if there is one. */
+    if (argc < 2 || argv[1] != suzu::gl_batchflag) {
+        if (suzu::ForwardToRunningInstance(argc, argv))
+            return 0;
+    }
+
     /* Construct and initialize application instance. */
     suzu::Application app(argc, argv);
 
@@ -0,0 +1,122 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  memoryview.cpp
+ * \brief implementation of the memory diagnostics
+ */
+
+
+/* stdlib includes */
+#include <iterator>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+
+/* app includes */
+#include <memoryview.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        static constexpr char const *gl_memcolumns[] = { "Account", "Tracked (KiB)", "Heap (KiB)", "Peak (KiB)", "Allocations" }; /**< labels of the columns */
+
+        static_assert(std::size(gl_memcolumns) == static_cast<size_t>(MemoryColumn::__NumMemoryColumns__), "every column needs a label");
+
+        /**
+         * \brief  converts a size for display
+         *
+         * \param  [in] bytes size, in bytes
+         *
+         * \return size, in KiB
+         */
+        static constexpr double ToKiB(int64_t const bytes) noexcept {
+            return static_cast<double>(bytes) / 1024.0;
+        }
+    }
+
+
+    MemoryUsageModel::MemoryUsageModel(QObject *parent) noexcept
+        : QAbstractTableModel(parent)
+    { }
+
+
+    void MemoryUsageModel::Attach(QTreeView &view, MemoryUsageModel &model) {
+        view.setRootIsDecorated(false);
+        view.setUniformRowHeights(true);
+        view.setModel(&model);
+    }
+
+    void MemoryUsageModel::refresh() {
+        std::vector<sdk::MemoryAccounts::Usage> rows = sdk::MemoryAccounts::Local().usage();
+
+        /* Accounts are never removed, so rows only ever get appended. */
+        if (rows.size() > m_rows.size()) {
+            beginInsertRows(QModelIndex(), static_cast<int>(m_rows.size()), static_cast<int>(rows.size()) - 1);
+            m_rows.swap(rows);
+            endInsertRows();
+        } else
+            m_rows.swap(rows);
+
+        if (!m_rows.empty())
+            emit dataChanged(index(0, 1), index(static_cast<int>(m_rows.size()) - 1, gl_columns - 1));
+    }
+
+
+    int MemoryUsageModel::rowCount(QModelIndex const &parent) const {
+        return parent.isValid() ? 0 : static_cast<int>(m_rows.size());
+    }
+
+    int MemoryUsageModel::columnCount(QModelIndex const &parent) const {
+        return parent.isValid() ? 0 : gl_columns;
+    }
+
+    QVariant MemoryUsageModel::data(QModelIndex const &index, int role) const {
+        if (!index.isValid() || index.row() < 0 || static_cast<size_t>(index.row()) >= m_rows.size())
+            return QVariant();
+
+        sdk::MemoryAccounts::Usage const &row = m_rows[static_cast<size_t>(index.row())];
+        if (role == Qt::TextAlignmentRole)
+            return index.column() == 0 ? QVariant() : QVariant(static_cast<int>(Qt::AlignRight | Qt::AlignVCenter));
+        if (role != Qt::DisplayRole)
+            return QVariant();
+
+        switch (static_cast<MemoryColumn>(index.column())) {
+            case MemoryColumn::Account: return QString::fromUtf8(row.name.data(), static_cast<qsizetype>(row.name.size()));
+            case MemoryColumn::Tracked: return QString::number(internal::ToKiB(row.tracked), 'f', 1);
+            case MemoryColumn::Heap:    return QString::number(internal::ToKiB(row.heap), 'f', 1);
+            case MemoryColumn::Peak:    return QString::number(internal::ToKiB(row.peak), 'f', 1);
+            case MemoryColumn::Allocs:  return QString::number(static_cast<qulonglong>(row.allocs));
+            default:                    return QVariant();
+        }
+    }
+
+    QVariant MemoryUsageModel::headerData(int section, Qt::Orientation orientation, int role) const {
+        if (orientation != Qt::Horizontal || role != Qt::DisplayRole || section < 0 || section >= gl_columns)
+            return QVariant();
+
+        return QString::fromUtf8(internal::gl_memcolumns[section]);
+    }
+
+
+    void LogMemoryUsage() noexcept {
+        try {
+            for (sdk::MemoryAccounts::Usage const &usage : sdk::MemoryAccounts::Local().usage()) {
+                if (usage.tracked == 0 && usage.heap == 0 && usage.allocs == 0)
+                    continue;
+
+                SZSDK_APP_DEBUG("Memory account \"{}\": {:.1f} KiB tracked, {:.1f} KiB heap (peak {:.1f} KiB), {} allocations.",
+                    usage.name, internal::ToKiB(usage.tracked), internal::ToKiB(usage.heap), internal::ToKiB(usage.peak), usage.allocs
+                );
+            }
+        } catch (...) { }
+    }
+}
+
+
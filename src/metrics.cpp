@@ -0,0 +1,308 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  metrics.cpp
+ * \brief implementation of the metrics registry and its exporter
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <new>
+
+/* external includes */
+#include <QSysInfo>
+
+#include <sdk/external/json/nlohmann/json.hpp>
+#if defined _WIN32
+    #include <sdk/external/spdlog/details/udp_client-windows.h>
+#else
+    #include <sdk/external/spdlog/details/udp_client.h>
+#endif
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/util.hpp>
+
+/* app includes */
+#include <metrics.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        constexpr std::string_view gl_udpscheme = "udp://"; /**< prefix of UDP targets */
+
+
+        /**
+         * \brief  splits a UDP target into address and port
+         *
+         * \param  [in] target target, without *gl_udpscheme*
+         * \param  [out] host IPv4 address
+         * \param  [out] port port
+         *
+         * \return *true* if the target is well-formed
+         * \throw  std::bad_alloc
+         */
+        static bool ParseUdpTarget(std::string_view const target, std::string &host, uint16_t &port) {
+            size_t const colon = target.rfind(':');
+            if (colon == std::string_view::npos || colon == 0)
+                return false;
+
+            unsigned int num  = 0;
+            int          read = 0;
+            std::string const rest(target.substr(colon + 1));
+            if (std::sscanf(rest.c_str(), "%u%n", &num, &read) != 1 || static_cast<size_t>(read) != rest.length() || num == 0 || num > 0xFFFF)
+                return false;
+
+            host = std::string(target.substr(0, colon));
+            port = static_cast<uint16_t>(num);
+            return true;
+        }
+    }
+
+
+    Metrics::Metrics() noexcept
+        : m_gauges(new (std::nothrow) Shard()), m_ncells(0)
+    { }
+
+    Metrics &Metrics::Local() noexcept {
+        static Metrics gl_metrics;
+
+        return gl_metrics;
+    }
+
+    uint32_t Metrics::add(std::string_view const name, Kind const kind) noexcept {
+        try {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            auto const it = std::find_if(m_metrics.begin(), m_metrics.end(), [name](Metric const &metric) { return metric.name == name; });
+            if (it != m_metrics.end())
+                return it->kind == kind ? it->cell + 1 : 0;
+
+            uint32_t const ncells = kind == Kind::Histogram ? gl_buckets + 1 : 1;
+            if (m_gauges == nullptr || m_ncells + ncells > gl_maxcells)
+                return 0;
+
+            m_metrics.push_back({ std::string(name), kind, m_ncells });
+            m_ncells += ncells;
+            return m_metrics.back().cell + 1;
+        } catch (...) { }
+
+        return 0;
+    }
+
+    std::vector<Metrics::Value> Metrics::snapshot() const {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        std::vector<Value> res;
+        res.reserve(m_metrics.size());
+        for (Metric const &metric : m_metrics) {
+            Value value = { metric.name, metric.kind, 0, {} };
+            switch (metric.kind) {
+                case Kind::Counter:
+                    for (auto const &shard : m_shards)
+                        value.value += shard->cells[metric.cell].load(std::memory_order_relaxed);
+
+                    break;
+                case Kind::Gauge:
+                    value.value = m_gauges->cells[metric.cell].load(std::memory_order_relaxed);
+
+                    break;
+                case Kind::Histogram:
+                    for (auto const &shard : m_shards) {
+                        for (uint32_t i = 0; i < gl_buckets; ++i)
+                            value.buckets[i] += static_cast<uint64_t>(shard->cells[metric.cell + i].load(std::memory_order_relaxed));
+
+                        value.value += shard->cells[metric.cell + gl_buckets].load(std::memory_order_relaxed);
+                    }
+
+                    break;
+            }
+
+            res.push_back(std::move(value));
+        }
+
+        return res;
+    }
+
+    uint32_t Metrics::BucketOf(int64_t const ns) noexcept {
+        uint64_t const us = ns > 0 ? static_cast<uint64_t>(ns) / 1000 : 0;
+
+        uint32_t res = 0;
+        while (res < gl_buckets - 1 && (us >> res) != 0)
+            ++res;
+
+        return res;
+    }
+
+    Metrics::Shard *Metrics::shard() noexcept {
+        thread_local Metrics *tl_owner = nullptr;
+        thread_local Shard   *tl_shard = nullptr;
+        if (tl_owner == this)
+            return tl_shard;
+
+        try {
+            auto shard = std::make_unique<Shard>();
+
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_shards.push_back(std::move(shard));
+
+            tl_owner = this;
+            tl_shard = m_shards.back().get();
+            return tl_shard;
+        } catch (...) { }
+
+        return nullptr;
+    }
+
+
+    /**
+     * \struct suzu::MetricsExporter::Transport
+     * \brief  socket snapshots are sent with
+     */
+    struct MetricsExporter::Transport {
+        spdlog::details::udp_client client; /**< connected UDP socket */
+
+        Transport(std::string const &host, uint16_t const port)
+            : client(host, port)
+        { }
+    };
+
+
+    MetricsExporter::MetricsExporter(std::string target, uint32_t const interval) noexcept
+        : m_target(std::move(target)), m_interval(interval)
+    { }
+
+    MetricsExporter::~MetricsExporter() {
+        stop();
+    }
+
+    sdk::ErrorCode MetricsExporter::start() noexcept {
+        if (m_target.empty())
+            return sdk::ErrorCode::NoOperation;
+        if (isRunning())
+            return sdk::ErrorCode::InvalidState;
+
+        try {
+            if (std::string_view(m_target).substr(0, internal::gl_udpscheme.length()) == internal::gl_udpscheme) {
+                std::string host;
+                uint16_t    port = 0;
+                if (!internal::ParseUdpTarget(std::string_view(m_target).substr(internal::gl_udpscheme.length()), host, port)) {
+                    SZSDK_APP_WARNING("Metrics target \"{}\" is malformed; expected udp://<IPv4 address>:<port>.", m_target);
+
+                    return sdk::ErrorCode::InvalidParameter;
+                }
+
+                try {
+                    m_transport = std::make_unique<Transport>(host, port);
+                } catch (spdlog::spdlog_ex const &ex) {
+                    SZSDK_APP_WARNING("Could not open a socket for metrics target \"{}\": {}", m_target, ex.what());
+
+                    return sdk::ErrorCode::CriticalResource;
+                }
+            }
+
+            m_timer = std::make_unique<QTimer>();
+            if (m_interval != 0) {
+                m_timer->setInterval(static_cast<int>(std::min<uint32_t>(m_interval, INT_MAX / 1000) * 1000));
+                QObject::connect(m_timer.get(), &QTimer::timeout, m_timer.get(), [this]() { write(); });
+                m_timer->start();
+            }
+
+            SZSDK_APP_INFO("Exporting metrics to \"{}\" every {} s.", m_target, m_interval);
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        m_transport.reset();
+        m_timer.reset();
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    void MetricsExporter::stop() noexcept {
+        if (!isRunning())
+            return;
+
+        write();
+
+        m_timer.reset();
+        m_transport.reset();
+    }
+
+    sdk::ErrorCode MetricsExporter::write() noexcept {
+        if (!isRunning())
+            return sdk::ErrorCode::InvalidState;
+
+        try {
+            int64_t const time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            std::string   line = Format(Metrics::Local().snapshot(), QSysInfo::machineHostName().toStdString(), time);
+
+            if (m_transport != nullptr) {
+                try {
+                    m_transport->client.send(line.data(), line.length());
+                } catch (spdlog::spdlog_ex const &ex) {
+                    SZSDK_APP_WARNING("Could not send metrics to \"{}\": {}", m_target, ex.what());
+
+                    return sdk::ErrorCode::WriteFile;
+                }
+
+                return sdk::ErrorCode::Ok;
+            }
+
+            line += '\n';
+            if (sdk::util::WriteFileAtomic(m_target.c_str(), line.c_str(), line.length()) != sdk::ErrorCode::Ok) {
+                SZSDK_APP_WARNING("Could not write metrics to \"{}\".", m_target);
+
+                return sdk::ErrorCode::WriteFile;
+            }
+
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    std::string MetricsExporter::Format(std::vector<Metrics::Value> const &values, std::string_view const host, int64_t const time) {
+        nlohmann::json counters   = nlohmann::json::object();
+        nlohmann::json gauges     = nlohmann::json::object();
+        nlohmann::json histograms = nlohmann::json::object();
+        for (Metrics::Value const &value : values) {
+            switch (value.kind) {
+                case Metrics::Kind::Counter:   counters[value.name] = value.value; break;
+                case Metrics::Kind::Gauge:     gauges[value.name]   = value.value; break;
+                case Metrics::Kind::Histogram: {
+                    size_t nbuckets = value.buckets.size();
+                    while (nbuckets != 0 && value.buckets[nbuckets - 1] == 0)
+                        --nbuckets;
+
+                    histograms[value.name] = {
+                        { "sum",     static_cast<double>(value.value) / 1e6 },
+                        { "buckets", std::vector<uint64_t>(value.buckets.begin(), value.buckets.begin() + nbuckets) }
+                    };
+
+                    break;
+                }
+            }
+        }
+
+        nlohmann::json const res = {
+            { "time",       time                  },
+            { "host",       std::string(host)     },
+            { "counters",   std::move(counters)   },
+            { "gauges",     std::move(gauges)     },
+            { "histograms", std::move(histograms) }
+        };
+        return res.dump();
+    }
+}
+
+
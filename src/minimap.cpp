@@ -0,0 +1,231 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  minimap.cpp
+ * \brief implementation of the minimap, an overview of the whole diagram
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cmath>
+
+/* external includes */
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+
+/* app includes */
+#include <minimap.hpp>
+
+
+namespace suzu {
+    MinimapWidget::MinimapWidget(QWidget *parent) noexcept
+        : QWidget(parent), m_store(nullptr), m_scale(1.0), m_valid(false), m_seen(0)
+    {
+        setAttribute(Qt::WA_OpaquePaintEvent);
+    }
+
+
+    void MinimapWidget::setStore(sdk::ElementStore const *store) noexcept {
+        m_store = store;
+        m_valid = false;
+
+        update();
+    }
+
+    void MinimapWidget::setStyles(std::shared_ptr<StyleSheet const> styles) noexcept {
+        m_render.setStyles(std::move(styles));
+        m_valid = false;
+
+        update();
+    }
+
+    void MinimapWidget::setViewport(QRectF const &visible) noexcept {
+        if (visible == m_viewport)
+            return;
+
+        m_viewport = visible;
+        update();
+    }
+
+
+    void MinimapWidget::paintEvent(QPaintEvent *event) {
+        QPainter painter(this);
+        painter.fillRect(event->rect(), palette().base());
+        if (m_store == nullptr)
+            return;
+
+        sync();
+
+        /* The image has the widget's size in device pixels, so it is copied without resampling. */
+        painter.drawImage(QRectF(0.0, 0.0, width(), height()), m_image);
+        if (!m_viewport.isEmpty()) {
+            painter.setPen(palette().highlight().color());
+            painter.setBrush(Qt::NoBrush);
+            painter.drawRect(mapFromScene(m_viewport));
+        }
+    }
+
+    void MinimapWidget::resizeEvent(QResizeEvent *event) {
+        m_valid = false;
+
+        QWidget::resizeEvent(event);
+    }
+
+    void MinimapWidget::mousePressEvent(QMouseEvent *event) {
+        if (event->button() != Qt::LeftButton || m_store == nullptr || !m_navigate) {
+            QWidget::mousePressEvent(event);
+
+            return;
+        }
+
+        m_navigate(mapToScene(event->position()));
+        event->accept();
+    }
+
+    void MinimapWidget::mouseMoveEvent(QMouseEvent *event) {
+        if ((event->buttons() & Qt::LeftButton) == 0 || m_store == nullptr || !m_navigate) {
+            QWidget::mouseMoveEvent(event);
+
+            return;
+        }
+
+        m_navigate(mapToScene(event->position()));
+        event->accept();
+    }
+
+
+    void MinimapWidget::sync() noexcept {
+        double const ratio = devicePixelRatioF();
+        int const    w     = static_cast<int>(std::lround(width() * ratio));
+        int const    h     = static_cast<int>(std::lround(height() * ratio));
+        if (!m_valid || m_image.width() != w || m_image.height() != h) {
+            rebuild();
+
+            return;
+        }
+
+        uint64_t const rev = m_store->revision();
+        if (rev == m_seen)
+            return;
+
+        try {
+            m_changes.clear();
+            if (!m_store->changesSince(m_seen, m_changes)) {
+                rebuild();
+
+                return;
+            }
+
+            /* Elements that left the covered region need a new extent, and thus a new image. */
+            QRectF all;
+            for (sdk::ElementRect const &change : m_changes) {
+                QRectF const region(change.x, change.y, change.w, change.h);
+                if (!m_extent.contains(region)) {
+                    rebuild();
+
+                    return;
+                }
+
+                all = all.united(region);
+            }
+
+            if (m_changes.size() > gl_maxpatches)
+                patch(all);
+            else
+                for (sdk::ElementRect const &change : m_changes)
+                    patch(QRectF(change.x, change.y, change.w, change.h));
+        } catch (...) {
+            rebuild();
+
+            return;
+        }
+
+        m_seen = rev;
+    }
+
+    void MinimapWidget::rebuild() noexcept {
+        double const ratio = devicePixelRatioF();
+        int const    w     = static_cast<int>(std::lround(width() * ratio));
+        int const    h     = static_cast<int>(std::lround(height() * ratio));
+
+        m_seen  = m_store->revision();
+        m_valid = true;
+        if (w <= 0 || h <= 0) {
+            m_image = QImage();
+
+            return;
+        }
+
+        /* The extent is the bounds of all visible elements plus a margin, widened to the widget's aspect ratio. */
+        sdk::ElementRect const *const bounds = m_store->bounds();
+        uint32_t const *const         flags  = m_store->flags();
+
+        QRectF extent;
+        for (uint32_t i = 0; i < m_store->size(); ++i)
+            if ((flags[i] & sdk::ElementHidden) == 0)
+                extent = extent.united(QRectF(bounds[i].x, bounds[i].y, bounds[i].w, bounds[i].h));
+        if (extent.isEmpty())
+            extent = QRectF(0.0, 0.0, w, h);
+
+        double const margin = std::max(extent.width(), extent.height()) * gl_margin;
+        extent  = extent.adjusted(-margin, -margin, margin, margin);
+        m_scale = std::min(w / extent.width(), h / extent.height());
+
+        QSizeF const size(w / m_scale, h / m_scale);
+        m_extent = QRectF(extent.center() - QPointF(size.width(), size.height()) / 2.0, size);
+
+        try {
+            m_image = QImage(w, h, QImage::Format_ARGB32_Premultiplied);
+            m_image.fill(palette().base().color());
+
+            QPainter painter(&m_image);
+            painter.scale(m_scale, m_scale);
+            painter.translate(-m_extent.topLeft());
+            m_render.render(painter, *m_store, m_extent, DetailLevel::Outlines);
+        } catch (...) {
+            m_image = QImage();
+            m_valid = false;
+        }
+    }
+
+    void MinimapWidget::patch(QRectF const &region) noexcept {
+        /* The region is widened to whole pixels, plus one for the outlines. */
+        QRectF const mapped((region.topLeft() - m_extent.topLeft()) * m_scale, region.size() * m_scale);
+        QRect const  device = mapped.toAlignedRect().adjusted(-1, -1, 1, 1).intersected(m_image.rect());
+        if (device.isEmpty())
+            return;
+
+        QRectF const scene(m_extent.topLeft() + QPointF(device.x(), device.y()) / m_scale, QSizeF(device.width(), device.height()) / m_scale);
+        try {
+            QPainter painter(&m_image);
+            painter.setClipRect(device);
+            painter.fillRect(device, palette().base().color());
+            painter.scale(m_scale, m_scale);
+            painter.translate(-m_extent.topLeft());
+            m_render.render(painter, *m_store, scene, DetailLevel::Outlines);
+        } catch (...) {
+            m_valid = false;
+        }
+    }
+
+    QPointF MinimapWidget::mapToScene(QPointF const &pos) const noexcept {
+        return m_extent.topLeft() + pos * devicePixelRatioF() / m_scale;
+    }
+
+    QRectF MinimapWidget::mapFromScene(QRectF const &region) const noexcept {
+        double const factor = m_scale / devicePixelRatioF();
+
+        return { (region.topLeft() - m_extent.topLeft()) * factor, region.size() * factor };
+    }
+}
+
+
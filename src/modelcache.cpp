@@ -0,0 +1,115 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  modelcache.cpp
+ * \brief implementation of the warm-start cache of opened projects
+ */
+
+
+/* stdlib includes */
+#include <cstring>
+
+/* app includes */
+#include <modelcache.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        constexpr uint32_t gl_chunkcachekey = sdk::MakeChunkType("MKEY"); /**< type of the chunk holding the *suzu::internal::CacheKey* */
+        constexpr uint32_t gl_chunksearch   = sdk::MakeChunkType("SRCH"); /**< type of the chunk holding the search index */
+
+        /**
+         * \struct suzu::internal::CacheKey
+         * \brief  identifies the project state a cache was written for
+         */
+        struct CacheKey {
+            uint64_t hash;     /**< *suzu::sdk::ProjectReader::contentHash()* of the project */
+            uint32_t version;  /**< *suzu::ModelCache::gl_version* */
+            uint32_t reserved; /**< reserved; 0 */
+        };
+        static_assert(sizeof(CacheKey) == 16, "cache key layout must not change");
+    }
+
+
+    std::string ModelCache::PathOf(std::string_view const project) {
+        return std::string(project) + ".model";
+    }
+
+    sdk::ErrorCode ModelCache::Write(char const *const project, uint64_t const hash, std::vector<Diagram> const &diagrams, SearchIndex const *const search) noexcept {
+        try {
+            sdk::ProjectWriter writer;
+            if (writer.open(PathOf(project).c_str()) != sdk::ErrorCode::Ok)
+                return sdk::ErrorCode::WriteFile;
+
+            for (Diagram const &diagram : diagrams)
+                if (writer.addDiagram(diagram.name, *diagram.store) != sdk::ErrorCode::Ok)
+                    return sdk::ErrorCode::WriteFile;
+
+            /* A search index that is out of date is left out; it is built on opening as usual. */
+            std::vector<char> index;
+            if (search != nullptr) {
+                std::vector<SearchIndex::Diagram> indexed;
+                for (size_t i = 0; i < diagrams.size(); ++i)
+                    indexed.push_back({ static_cast<uint32_t>(i), diagrams[i].store });
+
+                if (search->serialize(indexed, index) == sdk::ErrorCode::Ok && writer.addChunk(internal::gl_chunksearch, {}, index.data(), index.size(), 0) != sdk::ErrorCode::Ok)
+                    return sdk::ErrorCode::WriteFile;
+            }
+
+            internal::CacheKey const key = { hash, gl_version, 0 };
+            if (writer.addChunk(internal::gl_chunkcachekey, {}, reinterpret_cast<char const *>(&key), sizeof(key), 1) != sdk::ErrorCode::Ok)
+                return sdk::ErrorCode::WriteFile;
+
+            return writer.commit() == sdk::ErrorCode::Ok ? sdk::ErrorCode::Ok : sdk::ErrorCode::WriteFile;
+        } catch (...) { }
+
+        return sdk::ErrorCode::WriteFile;
+    }
+
+    sdk::ErrorCode ModelCache::open(char const *const project, uint64_t const hash) noexcept {
+        try {
+            sdk::ErrorCode const err = m_reader.open(PathOf(project).c_str());
+            if (err != sdk::ErrorCode::Ok)
+                return err;
+
+            std::vector<char>                   buffer;
+            sdk::Result<std::string_view> const chunk = m_reader.chunk(internal::gl_chunkcachekey, {}, buffer);
+            if (!chunk || chunk->size() != sizeof(internal::CacheKey)) {
+                m_reader.close();
+
+                return sdk::ErrorCode::ReadFile;
+            }
+
+            internal::CacheKey key;
+            std::memcpy(&key, chunk->data(), sizeof(key));
+            if (key.hash != hash || key.version != gl_version || m_reader.journalSize() != 0) {
+                m_reader.close();
+
+                return sdk::ErrorCode::InvalidState;
+            }
+
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        m_reader.close();
+        return sdk::ErrorCode::ReadFile;
+    }
+
+    sdk::ErrorCode ModelCache::restoreSearch(std::vector<SearchIndex::Diagram> const &diagrams, SearchIndex &search) noexcept {
+        std::vector<char>                   buffer;
+        sdk::Result<std::string_view> const chunk = m_reader.chunk(internal::gl_chunksearch, {}, buffer);
+        if (!chunk)
+            return chunk.error();
+
+        return search.restore(diagrams, *chunk);
+    }
+}
+
+
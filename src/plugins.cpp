@@ -0,0 +1,478 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  plugins.cpp
+ * \brief implementation of the plug-in manager
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <unordered_map>
+
+/* external includes */
+#include <QCoreApplication>
+
+/* sdk includes */
+#include <sdk/config.hpp>
+#include <sdk/log.hpp>
+#include <sdk/util.hpp>
+
+/* app includes */
+#include <plugins.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \struct suzu::internal::PluginIndexHeader
+         * \brief  header of the manifest index; followed by the CBOR-encoded entries
+         */
+        struct PluginIndexHeader {
+            static constexpr uint32_t gl_magic   = 0x49505A53; /**< "SZPI" */
+            static constexpr uint32_t gl_version = 1;          /**< current index version */
+
+            uint32_t magic;   /**< must be *gl_magic* */
+            uint32_t version; /**< must be *gl_version* */
+        };
+
+        /**
+         * \struct suzu::internal::PluginIndexEntry
+         * \brief  cached manifest, together with the stamp of its file
+         */
+        struct PluginIndexEntry {
+            int64_t   mtime; /**< modification time of the manifest file */
+            uint64_t  size;  /**< size of the manifest file, in bytes */
+            sdk::JSON doc;   /**< manifest document */
+        };
+
+        /**
+         * \brief  reads the manifest index of the plug-in directory *dir*
+         *
+         * \param  [in] dir plug-in directory
+         *
+         * \return cached manifests by manifest path; empty if the index is missing or invalid
+         */
+        static std::unordered_map<std::string, PluginIndexEntry> ReadPluginIndex(std::filesystem::path const &dir) noexcept {
+            std::unordered_map<std::string, PluginIndexEntry> res;
+
+            try {
+                sdk::util::MappedFile file;
+                if (sdk::util::MapFile((dir / gl_pluginindex).string().c_str(), file) != sdk::ErrorCode::Ok || file.size() < sizeof(PluginIndexHeader))
+                    return res;
+
+                PluginIndexHeader header;
+                std::memcpy(&header, file.data(), sizeof(PluginIndexHeader));
+                if (header.magic != PluginIndexHeader::gl_magic || header.version != PluginIndexHeader::gl_version)
+                    return res;
+
+                sdk::JSON const doc = sdk::JSON::from_cbor(file.data() + sizeof(PluginIndexHeader), file.data() + file.size(), true, false);
+                if (!doc.is_array())
+                    return res;
+
+                for (sdk::JSON const &entry : doc)
+                    res.emplace(entry.at("path").get<std::string>(), PluginIndexEntry{ entry.at("mtime").get<int64_t>(), entry.at("size").get<uint64_t>(), entry.at("manifest") });
+            } catch (...) {
+                res.clear();
+            }
+
+            return res;
+        }
+
+        /**
+         * \brief writes the manifest index of the plug-in directory *dir*
+         *
+         * \param [in] dir plug-in directory
+         * \param [in] entries manifests to cache, by manifest path
+         *
+         * \note  Failing to write the index is not an error.
+         */
+        static void WritePluginIndex(std::filesystem::path const &dir, std::unordered_map<std::string, PluginIndexEntry> const &entries) noexcept {
+            try {
+                sdk::JSON doc = sdk::JSON::array();
+                for (auto const &[path, entry] : entries)
+                    doc.push_back({ { "path", path }, { "mtime", entry.mtime }, { "size", entry.size }, { "manifest", entry.doc } });
+
+                PluginIndexHeader const header = { PluginIndexHeader::gl_magic, PluginIndexHeader::gl_version };
+                sdk::util::FileBuffer buf(sizeof(PluginIndexHeader));
+                std::memcpy(buf.data(), &header, sizeof(PluginIndexHeader));
+                sdk::JSON::to_cbor(doc, buf);
+
+                sdk::util::WriteFileAtomic((dir / gl_pluginindex).string().c_str(), buf.data(), buf.size(), true);
+            } catch (...) { }
+        }
+
+        /**
+         * \brief  converts a manifest document into a *PluginManifest*
+         *
+         * \param  [in] doc manifest document
+         * \param  [in] dir directory of the plug-in
+         * \param  [out] res receives the manifest
+         *
+         * \return *true* if the manifest has a name and a library
+         */
+        static bool ConvertManifest(sdk::JSON const &doc, std::string dir, PluginManifest &res) noexcept {
+            try {
+                auto const strings = [&](char const *key) {
+                    std::vector<std::string> vals;
+                    if (auto const it = doc.find(key); it != doc.end() && it->is_array())
+                        for (sdk::JSON const &val : *it)
+                            if (val.is_string())
+                                vals.push_back(val.get<std::string>());
+
+                    return vals;
+                };
+
+                res = {
+                    std::move(dir),
+                    doc.value("name", std::string{}),
+                    doc.value("version", std::string{}),
+                    doc.value("library", std::string{}),
+                    strings("capabilities"),
+                    strings("extensions"),
+                    strings("toolbox"),
+                    doc.value("isolated", false)
+                };
+                return !res.name.empty() && !res.library.empty();
+            } catch (...) { }
+
+            return false;
+        }
+    }
+
+
+    PluginManager::PluginManager(std::string dir) noexcept
+        : m_dir(std::move(dir)), m_host{ sdk::PluginHost::gl_version, { sdk::SinkRegistry::gl_version, 0, nullptr }, spdlog::level::trace, {}, sdk::internal::gl_tasks, sdk::ArenaInterface::Local(), sdk::StringTableInterface::Local(), sdk::ProfilerInterface::Local(), sdk::MemoryInterface::Local() }, m_isolate(false)
+    { }
+
+    void PluginManager::setHost(sdk::PluginHost const &host) noexcept {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        m_host = host;
+    }
+
+    void PluginManager::setIsolation(bool isolate) noexcept {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        m_isolate = isolate;
+    }
+
+
+    sdk::ErrorCode PluginManager::scan() noexcept {
+        try {
+            std::filesystem::path const dir = m_dir;
+
+            std::error_code ec;
+            if (!std::filesystem::is_directory(dir, ec))
+                return sdk::ErrorCode::NoOperation;
+
+            std::unordered_map<std::string, internal::PluginIndexEntry> cached = internal::ReadPluginIndex(dir);
+            std::unordered_map<std::string, internal::PluginIndexEntry> index;
+            std::vector<Entry> entries;
+            bool changed = false;
+
+            for (std::filesystem::directory_entry const &sub : std::filesystem::directory_iterator(dir, ec)) {
+                if (!sub.is_directory(ec))
+                    continue;
+
+                std::string const path = (sub.path() / gl_manifestname).string();
+                auto const mtime = std::filesystem::last_write_time(path, ec);
+                if (ec)
+                    continue;
+                auto const size = std::filesystem::file_size(path, ec);
+                if (ec)
+                    continue;
+
+                /* Only parse manifests that changed since the index was written. */
+                internal::PluginIndexEntry entry = { static_cast<int64_t>(mtime.time_since_epoch().count()), static_cast<uint64_t>(size), {} };
+                if (auto const it = cached.find(path); it != cached.end() && it->second.mtime == entry.mtime && it->second.size == entry.size)
+                    entry.doc = std::move(it->second.doc);
+                else {
+                    changed = true;
+
+                    sdk::util::MappedFile file;
+                    if (sdk::util::MapFile(path.c_str(), file) == sdk::ErrorCode::Ok)
+                        entry.doc = sdk::JSON::parse(file.data(), file.data() + file.size(), nullptr, false, true);
+                }
+
+                PluginManifest manifest;
+                if (!internal::ConvertManifest(entry.doc, sub.path().string(), manifest)) {
+                    SZSDK_APP_WARNING("Ignoring invalid plug-in manifest \"{}\".", path);
+
+                    continue;
+                }
+                if (std::any_of(entries.begin(), entries.end(), [&](Entry const &other) { return other.manifest.name == manifest.name; })) {
+                    SZSDK_APP_WARNING("Ignoring duplicate plug-in \"{}\" in \"{}\".", manifest.name, sub.path().string());
+
+                    continue;
+                }
+
+                entries.push_back({ std::move(manifest), nullptr, nullptr, nullptr, {}, false });
+                index.emplace(path, std::move(entry));
+            }
+
+            if (changed || index.size() != cached.size())
+                internal::WritePluginIndex(dir, index);
+
+            /* Plug-ins that are loaded already stay loaded. */
+            std::lock_guard<std::mutex> lock(m_lock);
+            for (Entry &entry : entries)
+                for (Entry &old : m_entries)
+                    if (old.manifest.name == entry.manifest.name) {
+                        entry.library = std::move(old.library);
+                        entry.remote  = std::move(old.remote);
+                        entry.state   = std::move(old.state);
+                        entry.failed  = old.failed;
+                    }
+
+            m_entries = std::move(entries);
+            SZSDK_APP_INFO("Discovered {} plug-in(s) in \"{}\".", m_entries.size(), m_dir);
+        } catch (...) {
+            return sdk::ErrorCode::Unknown;
+        }
+
+        return sdk::ErrorCode::Ok;
+    }
+
+    std::vector<PluginManifest> PluginManager::manifests() const {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        std::vector<PluginManifest> res;
+        for (Entry const &entry : m_entries)
+            res.push_back(entry.manifest);
+
+        return res;
+    }
+
+
+    sdk::ErrorCode PluginManager::acquire(std::string_view capability) noexcept {
+        try {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            auto const it = std::find_if(m_entries.begin(), m_entries.end(), [&](Entry const &entry) {
+                auto const &caps = entry.manifest.capabilities;
+
+                return std::find(caps.begin(), caps.end(), capability) != caps.end();
+            });
+            if (it == m_entries.end())
+                return sdk::ErrorCode::InvalidParameter;
+            else if (it->library != nullptr || it->remote != nullptr)
+                return sdk::ErrorCode::Ok;
+            else if (it->failed)
+                return sdk::ErrorCode::CriticalResource;
+            std::string const path = (std::filesystem::path(it->manifest.dir) / it->manifest.library).string();
+
+            /* Isolated plug-ins are loaded by a plug-in host next to the application's executable. */
+            if (m_isolate || it->manifest.isolated) {
+                std::string const exe = (QCoreApplication::applicationDirPath() + QLatin1Char('/') + QString::fromUtf8(gl_pluginhostexe.data(), static_cast<qsizetype>(gl_pluginhostexe.size()))).toStdString();
+
+                auto remote = std::make_unique<RemotePlugin>();
+                sdk::ErrorCode const res = invoke(it->manifest.name, "initialize", [&]() { return remote->start(exe, path, gl_remotetimeout); });
+                if (res != sdk::ErrorCode::Ok) {
+                    SZSDK_APP_ERROR("Could not start plug-in \"{}\" out-of-process (error {}).", it->manifest.name, static_cast<int>(res));
+
+                    it->failed = true;
+                    return sdk::ErrorCode::CriticalResource;
+                }
+
+                SZSDK_APP_INFO("Started plug-in \"{}\" {} out-of-process for capability \"{}\".", it->manifest.name, it->manifest.version, capability);
+                it->remote = std::move(remote);
+                return sdk::ErrorCode::Ok;
+            }
+
+            sdk::ErrorCode const res = load(*it);
+            if (res == sdk::ErrorCode::CriticalResource)
+                return res;
+
+            SZSDK_APP_INFO("Loaded plug-in \"{}\" {} for capability \"{}\".", it->manifest.name, it->manifest.version, capability);
+        } catch (...) {
+            return sdk::ErrorCode::Unknown;
+        }
+
+        return sdk::ErrorCode::Ok;
+    }
+
+    std::string PluginManager::findByExtension(std::string_view ext) const {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        for (Entry const &entry : m_entries) {
+            auto const &exts = entry.manifest.extensions;
+
+            if (std::find(exts.begin(), exts.end(), ext) != exts.end())
+                return entry.manifest.name;
+        }
+
+        return {};
+    }
+
+    sdk::ErrorCode PluginManager::notifyChanges(sdk::ChangeRecord const *records, size_t count) noexcept {
+        if (count == 0)
+            return sdk::ErrorCode::NoOperation;
+        else if (records == nullptr || count > UINT32_MAX)
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            sdk::ChangeBatch const batch = { sdk::ChangeBatch::gl_version, static_cast<uint32_t>(count), records };
+            for (Entry const &entry : m_entries) {
+                sdk::ErrorCode res = sdk::ErrorCode::Ok;
+                if (entry.remote != nullptr)
+                    res = invoke(entry.manifest.name, "changes", [&]() { return entry.remote->notifyChanges(batch, gl_remotetimeout); });
+                else if (entry.onchanges != nullptr)
+                    res = invoke(entry.manifest.name, "changes", [&]() { return entry.onchanges(&batch); });
+
+                if (res != sdk::ErrorCode::Ok) {
+                    SZSDK_APP_WARNING("Plug-in \"{}\" rejected {} change(s): {}.", entry.manifest.name, count, sdk::ErrorDescription(res));
+
+                    return res;
+                }
+            }
+        } catch (...) {
+            return sdk::ErrorCode::Unknown;
+        }
+
+        return sdk::ErrorCode::Ok;
+    }
+
+
+    sdk::ErrorCode PluginManager::reload(std::string_view name) noexcept {
+        try {
+            /* Holding the lock keeps all other calls into plug-ins out until the new instance is ready. */
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            auto const it = std::find_if(m_entries.begin(), m_entries.end(), [&](Entry const &entry) { return entry.manifest.name == name; });
+            if (it == m_entries.end() || it->remote != nullptr)
+                return sdk::ErrorCode::InvalidParameter;
+
+            /* A library that failed to load, e.g. in the middle of a rebuild, is tried again. */
+            if (it->library == nullptr) {
+                if (!it->failed)
+                    return sdk::ErrorCode::NoOperation;
+
+                it->failed = false;
+                return load(*it);
+            }
+
+            /* The serializer is the only point where the plug-in drains its tasks; without it, queued tasks would run unmapped code. */
+            auto const save = reinterpret_cast<sdk::PluginSaveFn>(it->library->resolve(sdk::gl_pluginsave));
+            if (save == nullptr) {
+                SZSDK_APP_ERROR("Plug-in \"{}\" does not export {}; it cannot be reloaded.", it->manifest.name, sdk::gl_pluginsave);
+
+                return sdk::ErrorCode::InvalidState;
+            }
+
+            /* The state is collected in a buffer of the manager; it outlives the library. */
+            {
+                std::vector<uint8_t> state;
+
+                sdk::PluginStateWriter const writer = {
+                    sdk::PluginStateWriter::gl_version, &state,
+                    [](void *context, void const *data, size_t size) noexcept {
+                        try {
+                            auto *const buf = static_cast<std::vector<uint8_t> *>(context);
+
+                            if (size != 0)
+                                buf->insert(buf->end(), static_cast<uint8_t const *>(data), static_cast<uint8_t const *>(data) + size);
+                            return sdk::ErrorCode::Ok;
+                        } catch (...) { }
+
+                        return sdk::ErrorCode::CriticalResource;
+                    }
+                };
+                sdk::ErrorCode const res = invoke(it->manifest.name, "save", [&]() { return save(&writer); });
+                if (res != sdk::ErrorCode::Ok) {
+                    SZSDK_APP_ERROR("Plug-in \"{}\" could not save its state (error {}); it is not reloaded.", it->manifest.name, static_cast<int>(res));
+
+                    return res;
+                }
+                it->state = std::move(state);
+            }
+
+            it->onchanges = nullptr;
+            it->library->unload();
+            it->library.reset();
+
+            sdk::ErrorCode const res = load(*it);
+            if (res == sdk::ErrorCode::CriticalResource)
+                return res;
+
+            SZSDK_APP_INFO("Reloaded plug-in \"{}\" {}.", it->manifest.name, it->manifest.version);
+            return res;
+        } catch (...) { }
+
+        return sdk::ErrorCode::Unknown;
+    }
+
+
+    sdk::ErrorCode PluginManager::load(Entry &entry) noexcept {
+        try {
+            std::string const path = (std::filesystem::path(entry.manifest.dir) / entry.manifest.library).string();
+
+            /* Load the library and run its entry point. */
+            auto library = std::make_unique<QLibrary>(QString::fromStdString(path));
+            if (!library->load()) {
+                SZSDK_APP_ERROR("Could not load plug-in \"{}\": {}", entry.manifest.name, library->errorString().toStdString());
+
+                entry.failed = true;
+                return sdk::ErrorCode::CriticalResource;
+            }
+
+            auto const init = reinterpret_cast<sdk::PluginEntryFn>(library->resolve(sdk::gl_pluginentry));
+            sdk::ErrorCode const res = init != nullptr
+                ? invoke(entry.manifest.name, "initialize", [&]() { return init(&m_host); })
+                : sdk::ErrorCode::CriticalResource
+            ;
+            if (res != sdk::ErrorCode::Ok) {
+                SZSDK_APP_ERROR("Could not initialize plug-in \"{}\" (error {}).", entry.manifest.name, static_cast<int>(res));
+
+                library->unload();
+                entry.failed = true;
+                return sdk::ErrorCode::CriticalResource;
+            }
+
+            entry.onchanges = reinterpret_cast<sdk::ChangeBatchFn>(library->resolve(sdk::gl_pluginchanges));
+            entry.library   = std::move(library);
+            if (entry.state.empty())
+                return sdk::ErrorCode::Ok;
+
+            /* The state is handed over once; a new instance rejecting it starts afresh. */
+            std::vector<uint8_t> const state   = std::move(entry.state);
+            auto const                 restore = reinterpret_cast<sdk::PluginRestoreFn>(entry.library->resolve(sdk::gl_pluginrestore));
+            entry.state.clear();
+
+            sdk::PluginState const view = { sdk::PluginState::gl_version, state.size(), state.data() };
+            if (restore == nullptr || invoke(entry.manifest.name, "restore", [&]() { return restore(&view); }) != sdk::ErrorCode::Ok) {
+                SZSDK_APP_WARNING("Plug-in \"{}\" did not restore its state of {} byte(s).", entry.manifest.name, state.size());
+
+                return sdk::ErrorCode::InvalidState;
+            }
+        } catch (...) {
+            return sdk::ErrorCode::Unknown;
+        }
+
+        return sdk::ErrorCode::Ok;
+    }
+
+    uint32_t PluginManager::MemoryAccount(std::string_view plugin) noexcept {
+        constexpr std::string_view prefix = "plugin/";
+
+        char         name[sdk::MemoryAccounts::gl_maxname];
+        size_t const len = std::min(plugin.size(), sizeof(name) - prefix.size() - 1);
+        std::memcpy(name, prefix.data(), prefix.size());
+        std::memcpy(name + prefix.size(), plugin.data(), len);
+
+        return sdk::MemoryAccounts::Local().account({ name, prefix.size() + len });
+    }
+}
+
+
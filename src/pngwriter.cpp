@@ -0,0 +1,422 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  pngwriter.cpp
+ * \brief implementation of the streaming PNG encoder
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <vector>
+
+/* external includes */
+#include <QString>
+
+/* app includes */
+#include <pngwriter.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        constexpr uint32_t gl_adlerbase = 65521; /**< modulus of Adler-32 */
+        constexpr uint32_t gl_adlerrun  = 5552;  /**< number of bytes that can be summed before the sums could overflow */
+        constexpr uint32_t gl_maxmatch  = 258;   /**< longest back-reference of deflate */
+
+        /**
+         * \struct suzu::internal::DeflateTables
+         * \brief  fixed Huffman codes of deflate (RFC 1951, 3.2.6), bit-reversed for LSB-first output
+         */
+        struct DeflateTables {
+            std::array<uint16_t, 288>             code;     /**< codes of literals and length symbols */
+            std::array<uint8_t, 288>              bits;     /**< lengths of *code*, in bits */
+            std::array<uint16_t, gl_maxmatch + 1> lensym;   /**< symbol of every match length */
+            std::array<uint8_t, gl_maxmatch + 1>  lenbits;  /**< number of extra bits of every match length */
+            std::array<uint16_t, gl_maxmatch + 1> lenextra; /**< value of the extra bits of every match length */
+            std::array<uint32_t, 256>             crc;      /**< CRC-32 of every byte, for PNG chunks */
+        };
+
+        /**
+         * \brief  reverses the order of the lowest bits of a code
+         *
+         * \param  [in] code code to reverse
+         * \param  [in] bits number of bits of *code*
+         *
+         * \return reversed code
+         */
+        static uint16_t ReverseBits(uint32_t code, uint32_t const bits) noexcept {
+            uint32_t res = 0;
+            for (uint32_t i = 0; i < bits; ++i, code >>= 1)
+                res = res << 1 | (code & 1);
+
+            return static_cast<uint16_t>(res);
+        }
+
+        /**
+         * \brief  retrieves the tables, building them on first use
+         *
+         * \return reference to the tables
+         */
+        static DeflateTables const &Tables() noexcept {
+            static DeflateTables const tables = []() {
+                static constexpr uint16_t base[29]  = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+                static constexpr uint8_t  extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+                DeflateTables res = {};
+                for (uint32_t sym = 0; sym < 288; ++sym) {
+                    uint32_t code, bits;
+                    if (sym < 144) {
+                        code = 0x30 + sym;
+                        bits = 8;
+                    } else if (sym < 256) {
+                        code = 0x190 + sym - 144;
+                        bits = 9;
+                    } else if (sym < 280) {
+                        code = sym - 256;
+                        bits = 7;
+                    } else {
+                        code = 0xC0 + sym - 280;
+                        bits = 8;
+                    }
+
+                    res.code[sym] = ReverseBits(code, bits);
+                    res.bits[sym] = static_cast<uint8_t>(bits);
+                }
+                for (uint32_t len = 3, i = 0; len <= gl_maxmatch; ++len) {
+                    while (i + 1 < 29 && base[i + 1] <= len)
+                        ++i;
+
+                    res.lensym[len]   = static_cast<uint16_t>(257 + i);
+                    res.lenbits[len]  = extra[i];
+                    res.lenextra[len] = static_cast<uint16_t>(len - base[i]);
+                }
+                for (uint32_t byte = 0; byte < 256; ++byte) {
+                    uint32_t crc = byte;
+                    for (uint32_t i = 0; i < 8; ++i)
+                        crc = (crc & 1) != 0 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+
+                    res.crc[byte] = crc;
+                }
+
+                return res;
+            }();
+
+            return tables;
+        }
+
+        /**
+         * \class suzu::internal::BitWriter
+         * \brief appends bits to a buffer, least significant bit first, as deflate requires
+         */
+        class BitWriter {
+            std::string &m_out;   /**< buffer to append to */
+            uint64_t     m_bits;  /**< pending bits */
+            uint32_t     m_count; /**< number of pending bits */
+
+        public:
+            explicit BitWriter(std::string &out) noexcept
+                : m_out(out), m_bits(0), m_count(0)
+            { }
+
+            /**
+             * \brief appends bits
+             *
+             * \param [in] bits bits to append
+             * \param [in] count number of bits; at most 32
+             * \throw std::bad_alloc
+             */
+            void put(uint32_t const bits, uint32_t const count) {
+                m_bits  |= static_cast<uint64_t>(bits) << m_count;
+                m_count += count;
+                for (; m_count >= 8; m_count -= 8, m_bits >>= 8)
+                    m_out += static_cast<char>(m_bits & 0xFF);
+            }
+
+            /**
+             * \brief pads the pending bits with zeros to a whole byte and appends them
+             *
+             * \throw std::bad_alloc
+             */
+            void align() {
+                if (m_count > 0)
+                    put(0, 8 - m_count);
+            }
+        };
+
+        /**
+         * \brief  updates an Adler-32 checksum
+         *
+         * \param  [in] adler checksum of the preceding bytes; 1 for none
+         * \param  [in] data bytes to add
+         * \param  [in] size number of bytes
+         *
+         * \return updated checksum
+         */
+        static uint32_t Adler32(uint32_t const adler, uint8_t const *data, size_t size) noexcept {
+            uint32_t a = adler & 0xFFFF, b = adler >> 16;
+            while (size > 0) {
+                size_t const run = std::min<size_t>(size, gl_adlerrun);
+                for (size_t i = 0; i < run; ++i) {
+                    a += data[i];
+                    b += a;
+                }
+
+                a %= gl_adlerbase;
+                b %= gl_adlerbase;
+                data += run;
+                size -= run;
+            }
+
+            return b << 16 | a;
+        }
+
+        /**
+         * \brief  combines the Adler-32 checksums of two consecutive runs of bytes
+         *
+         * \param  [in] first checksum of the first run
+         * \param  [in] second checksum of the second run
+         * \param  [in] size size of the second run, in bytes
+         *
+         * \return checksum of both runs
+         */
+        static uint32_t CombineAdler32(uint32_t const first, uint32_t const second, uint64_t const size) noexcept {
+            uint32_t const rem = static_cast<uint32_t>(size % gl_adlerbase);
+
+            uint32_t a = first & 0xFFFF;
+            uint32_t b = static_cast<uint32_t>(static_cast<uint64_t>(rem) * a % gl_adlerbase);
+            a += (second & 0xFFFF) + gl_adlerbase - 1;
+            b += (first >> 16) + (second >> 16) + gl_adlerbase - rem;
+            if (a >= gl_adlerbase)
+                a -= gl_adlerbase;
+            if (a >= gl_adlerbase)
+                a -= gl_adlerbase;
+            if (b >= 2 * gl_adlerbase)
+                b -= 2 * gl_adlerbase;
+            if (b >= gl_adlerbase)
+                b -= gl_adlerbase;
+
+            return b << 16 | a;
+        }
+
+        /**
+         * \brief compresses bytes into a fixed-Huffman deflate block, followed by an empty stored
+         *        block that ends the output on a byte boundary
+         *
+         * Runs of equal bytes are encoded as back-references at distance 1; after filtering, the
+         * uniform areas of diagrams consist of little else.
+         *
+         * \param [in] data bytes to compress
+         * \param [in] size number of bytes
+         * \param [out] out buffer to append the compressed bytes to
+         * \throw std::bad_alloc
+         */
+        static void Deflate(uint8_t const *const data, size_t const size, std::string &out) {
+            DeflateTables const &tables = Tables();
+            BitWriter            bits(out);
+
+            bits.put(1 << 1, 3); /* not final, fixed Huffman codes */
+            for (size_t i = 0; i < size; ) {
+                size_t run = 0;
+                if (i > 0)
+                    while (run < gl_maxmatch && i + run < size && data[i + run] == data[i - 1])
+                        ++run;
+
+                if (run >= 3) {
+                    uint16_t const sym = tables.lensym[run];
+
+                    bits.put(tables.code[sym], tables.bits[sym]);
+                    bits.put(tables.lenextra[run], tables.lenbits[run]);
+                    bits.put(0, 5); /* distance 1 */
+                    i += run;
+
+                    continue;
+                }
+
+                bits.put(tables.code[data[i]], tables.bits[data[i]]);
+                ++i;
+            }
+            bits.put(tables.code[256], tables.bits[256]);
+
+            /* An empty stored block aligns the stream, so that strips can be concatenated. */
+            bits.put(0, 3);
+            bits.align();
+            out.append("\x00\x00\xFF\xFF", 4);
+        }
+
+        /**
+         * \brief  computes the cost of a filtered row, i.e. the sum of its bytes as signed numbers
+         *
+         * \param  [in] row filtered bytes
+         * \param  [in] size number of bytes
+         *
+         * \return cost; lower costs usually compress better
+         */
+        static uint64_t FilterCost(uint8_t const *const row, size_t const size) noexcept {
+            uint64_t cost = 0;
+            for (size_t i = 0; i < size; ++i)
+                cost += static_cast<uint64_t>(std::abs(static_cast<int>(static_cast<int8_t>(row[i]))));
+
+            return cost;
+        }
+
+        /**
+         * \brief stores a value as four big-endian bytes
+         *
+         * \param [out] out pointer to the bytes
+         * \param [in] value value to store
+         */
+        static void PutBigEndian(char *const out, uint32_t const value) noexcept {
+            out[0] = static_cast<char>(value >> 24);
+            out[1] = static_cast<char>(value >> 16);
+            out[2] = static_cast<char>(value >> 8);
+            out[3] = static_cast<char>(value);
+        }
+    }
+
+
+    PngWriter::PngWriter() noexcept
+        : m_width(0), m_height(0), m_rows(0), m_adler(1)
+    { }
+
+    PngWriter::~PngWriter() {
+        cancel();
+    }
+
+
+    void PngWriter::Encode(QImage const &image, Strip &res) {
+        size_t const width  = static_cast<size_t>(image.width());
+        size_t const stride = 3 * width;
+
+        /* Every row is preceded by the filter that suits it best. */
+        std::vector<uint8_t> filtered((stride + 1) * static_cast<size_t>(image.height()));
+        std::vector<uint8_t> prev(stride), curr(stride), sub(stride), up(stride);
+        for (int y = 0; y < image.height(); ++y) {
+            QRgb const *const line = reinterpret_cast<QRgb const *>(image.constScanLine(y));
+            for (size_t x = 0; x < width; ++x) {
+                curr[3 * x]     = static_cast<uint8_t>(qRed(line[x]));
+                curr[3 * x + 1] = static_cast<uint8_t>(qGreen(line[x]));
+                curr[3 * x + 2] = static_cast<uint8_t>(qBlue(line[x]));
+            }
+
+            for (size_t i = 0; i < stride; ++i) {
+                sub[i] = static_cast<uint8_t>(curr[i] - (i >= 3 ? curr[i - 3] : 0));
+                up[i]  = static_cast<uint8_t>(curr[i] - prev[i]);
+            }
+
+            /* The first row of a strip cannot refer to the last row of the previous strip. */
+            uint64_t const costs[3] = {
+                internal::FilterCost(curr.data(), stride),
+                internal::FilterCost(sub.data(), stride),
+                y > 0 ? internal::FilterCost(up.data(), stride) : UINT64_MAX
+            };
+            uint8_t const filter = static_cast<uint8_t>(std::min_element(costs, costs + 3) - costs);
+
+            uint8_t *const out = filtered.data() + static_cast<size_t>(y) * (stride + 1);
+            out[0] = filter;
+            std::copy_n(filter == 0 ? curr.data() : filter == 1 ? sub.data() : up.data(), stride, out + 1);
+            std::swap(prev, curr);
+        }
+
+        res.data.clear();
+        internal::Deflate(filtered.data(), filtered.size(), res.data);
+        res.rows  = static_cast<uint32_t>(image.height());
+        res.adler = internal::Adler32(1, filtered.data(), filtered.size());
+        res.size  = filtered.size();
+    }
+
+
+    sdk::ErrorCode PngWriter::open(char const *path, uint32_t width, uint32_t height) noexcept {
+        cancel();
+        if (path == nullptr || width == 0 || height == 0 || width > INT32_MAX || height > INT32_MAX)
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            m_file = std::make_unique<QSaveFile>(QString::fromUtf8(path));
+            if (!m_file->open(QIODevice::WriteOnly)) {
+                m_file.reset();
+
+                return sdk::ErrorCode::OpenFile;
+            }
+
+            m_width  = width;
+            m_height = height;
+            m_rows   = 0;
+            m_adler  = 1;
+
+            /* 8-bit RGB, deflate, adaptive filtering, no interlacing */
+            char header[13] = {};
+            internal::PutBigEndian(header, width);
+            internal::PutBigEndian(header + 4, height);
+            header[8] = 8;
+            header[9] = 2;
+
+            /* The zlib header opens the stream that the strips continue. */
+            if (m_file->write("\x89PNG\r\n\x1A\n", 8) == 8 && writeChunk("IHDR", header, sizeof(header)) && writeChunk("IDAT", "\x78\x01", 2))
+                return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        cancel();
+        return sdk::ErrorCode::WriteFile;
+    }
+
+    sdk::ErrorCode PngWriter::append(Strip const &strip) noexcept {
+        if (m_file == nullptr || strip.rows > m_height - m_rows)
+            return sdk::ErrorCode::InvalidState;
+        if (!writeChunk("IDAT", strip.data.data(), strip.data.size()))
+            return sdk::ErrorCode::WriteFile;
+
+        m_rows += strip.rows;
+        m_adler = internal::CombineAdler32(m_adler, strip.adler, strip.size);
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode PngWriter::commit() noexcept {
+        if (m_file == nullptr || m_rows != m_height)
+            return sdk::ErrorCode::InvalidState;
+
+        /* An empty final block ends the stream, followed by its checksum. */
+        char trailer[6] = { 0x03, 0x00 };
+        internal::PutBigEndian(trailer + 2, m_adler);
+
+        bool const ok = writeChunk("IDAT", trailer, sizeof(trailer)) && writeChunk("IEND", nullptr, 0) && m_file->commit();
+        m_file.reset();
+
+        return ok ? sdk::ErrorCode::Ok : sdk::ErrorCode::WriteFile;
+    }
+
+    void PngWriter::cancel() noexcept {
+        if (m_file != nullptr)
+            m_file->cancelWriting();
+
+        m_file.reset();
+    }
+
+
+    bool PngWriter::writeChunk(char const *type, char const *data, size_t size) noexcept {
+        if (size > INT32_MAX)
+            return false;
+
+        internal::DeflateTables const &tables = internal::Tables();
+        uint32_t                       crc    = 0xFFFFFFFFu;
+        for (char const *p : { type, data })
+            for (size_t i = 0, n = p == type ? 4 : size; i < n; ++i)
+                crc = tables.crc[(crc ^ static_cast<uint8_t>(p[i])) & 0xFF] ^ (crc >> 8);
+
+        char length[4], checksum[4];
+        internal::PutBigEndian(length, static_cast<uint32_t>(size));
+        internal::PutBigEndian(checksum, ~crc);
+
+        return m_file->write(length, 4) == 4 && m_file->write(type, 4) == 4 && (size == 0 || m_file->write(data, static_cast<qint64>(size)) == static_cast<qint64>(size)) && m_file->write(checksum, 4) == 4;
+    }
+}
+
+
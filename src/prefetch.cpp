@@ -0,0 +1,185 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  prefetch.cpp
+ * \brief implementation of the predictive prefetching of diagram tiles
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+/* app includes */
+#include <prefetch.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \struct suzu::internal::TileSpan
+         * \brief  range of tiles covering a viewport, inclusive
+         */
+        struct TileSpan {
+            int32_t x0; /**< first column */
+            int32_t y0; /**< first row */
+            int32_t x1; /**< last column */
+            int32_t y1; /**< last row */
+
+            bool contains(int32_t const x, int32_t const y) const noexcept { return x >= x0 && x <= x1 && y >= y0 && y <= y1; }
+        };
+
+        /**
+         * \brief  computes the tiles covering the viewport of a view, as the canvas paints them
+         *
+         * \param  [in] zoom zoom factor
+         * \param  [in] ratio device pixel ratio
+         * \param  [in] origin scene position shown in the top-left corner
+         * \param  [in] size size of the widget
+         *
+         * \return covered tiles
+         */
+        static TileSpan SpanOf(double const zoom, double const ratio, QPointF const &origin, QSizeF const &size) noexcept {
+            double const tile = TileCache::gl_tilesize;
+            double const x    = std::round(origin.x() * (zoom * ratio));
+            double const y    = std::round(origin.y() * (zoom * ratio));
+
+            return {
+                static_cast<int32_t>(std::floor(x / tile)),
+                static_cast<int32_t>(std::floor(y / tile)),
+                static_cast<int32_t>(std::floor((x + size.width() * ratio) / tile)),
+                static_cast<int32_t>(std::floor((y + size.height() * ratio) / tile))
+            };
+        }
+
+        /**
+         * \brief adds the tiles of a span that are not visible, nearest to a point first
+         *
+         * \param [in] zoom zoom factor of the tiles
+         * \param [in] ratio device pixel ratio of the tiles
+         * \param [in] span tiles to add
+         * \param [in] visible tiles to leave out; only if at the same zoom factor
+         * \param [in] center position the distance is measured from, in tile units
+         * \param [in,out] res receives at most *TilePrefetcher::gl_maxtiles* keys
+         */
+        static void AddTiles(double const zoom, double const ratio, TileSpan const &span, TileSpan const *visible, QPointF const &center, std::vector<TileKey> &res) {
+            std::vector<std::pair<double, TileKey>> found;
+            for (int32_t y = span.y0; y <= span.y1; ++y)
+                for (int32_t x = span.x0; x <= span.x1; ++x) {
+                    if (visible != nullptr && visible->contains(x, y))
+                        continue;
+
+                    double const dx = x + 0.5 - center.x();
+                    double const dy = y + 0.5 - center.y();
+                    found.emplace_back(dx * dx + dy * dy, TileCache::KeyOf(zoom, ratio, x, y));
+                }
+
+            size_t const n = std::min(found.size(), TilePrefetcher::gl_maxtiles - res.size());
+            std::partial_sort(found.begin(), found.begin() + n, found.end(), [](auto const &a, auto const &b) { return a.first < b.first; });
+            for (size_t i = 0; i < n; ++i)
+                res.push_back(found[i].second);
+        }
+    }
+
+
+    void TilePrefetcher::reset() noexcept {
+        m_motion   = Motion::Still;
+        m_velocity = QPointF();
+        m_steps    = 0.0;
+        m_time     = -1.0;
+    }
+
+    bool TilePrefetcher::pan(ViewNavigator const &view, double const seconds) noexcept {
+        double const dt     = seconds - m_time;
+        bool const   resume = m_motion != Motion::Panning || m_time < 0.0 || dt > gl_idle;
+
+        QPointF const origin = view.origin();
+        if (resume) {
+            m_motion   = Motion::Panning;
+            m_origin   = origin;
+            m_velocity = QPointF();
+            m_time     = seconds;
+
+            return true;
+        }
+        /* Events of the same instant are merged into the next movement. */
+        if (dt <= 0.0)
+            return false;
+
+        QPointF const measured = (origin - m_origin) / dt;
+        QPointF const previous = m_velocity;
+        m_velocity = previous * (1.0 - gl_smoothing) + measured * gl_smoothing;
+        m_origin   = origin;
+        m_time     = seconds;
+
+        /* A view starting to move or turning sharply leaves the earlier predictions behind. */
+        double const minspeed = gl_minspeed / view.zoom();
+        double const before   = std::hypot(previous.x(), previous.y());
+        double const after    = std::hypot(m_velocity.x(), m_velocity.y());
+        if (after < minspeed)
+            return false;
+        if (before < minspeed)
+            return true;
+        return QPointF::dotProduct(previous, m_velocity) < gl_maxturn * before * after;
+    }
+
+    bool TilePrefetcher::zoom(ViewNavigator const &view, QPointF const &anchor, double const steps, double const seconds) noexcept {
+        bool const changed = m_motion != Motion::Zooming || m_time < 0.0 || seconds - m_time > gl_idle || (steps > 0.0) != (m_steps > 0.0);
+
+        m_motion   = Motion::Zooming;
+        m_origin   = view.origin();
+        m_velocity = QPointF();
+        m_anchor   = anchor;
+        m_steps    = steps;
+        m_time     = seconds;
+        return changed;
+    }
+
+    void TilePrefetcher::predict(ViewNavigator const &view, QSizeF const &size, double const ratio, double const seconds, std::vector<TileKey> &res) const {
+        res.clear();
+        if (m_motion == Motion::Still || m_time < 0.0 || seconds - m_time > gl_idle || size.isEmpty())
+            return;
+
+        double const             zoom    = view.zoom();
+        internal::TileSpan const visible = internal::SpanOf(zoom, ratio, view.origin(), size);
+        double const             tile    = TileCache::gl_tilesize;
+
+        if (m_motion == Motion::Panning) {
+            if (std::hypot(m_velocity.x(), m_velocity.y()) < gl_minspeed / zoom)
+                return;
+
+            /* All tiles swept over until the viewport reaches its predicted position, at most one viewport ahead. */
+            QSizeF const             reach = size / zoom;
+            QPointF const            shift = m_velocity * gl_lookahead;
+            QPointF const            limit = { std::clamp(shift.x(), -reach.width(), reach.width()), std::clamp(shift.y(), -reach.height(), reach.height()) };
+            internal::TileSpan const ahead = internal::SpanOf(zoom, ratio, view.origin() + limit, size);
+            internal::TileSpan const swept = {
+                std::min(visible.x0, ahead.x0), std::min(visible.y0, ahead.y0), std::max(visible.x1, ahead.x1), std::max(visible.y1, ahead.y1)
+            };
+            QPointF const center = (view.origin() + QPointF(size.width(), size.height()) / (2.0 * zoom)) * (zoom * ratio) / tile;
+
+            internal::AddTiles(zoom, ratio, swept, &visible, center, res);
+            return;
+        }
+
+        /* The next wheel step in the same direction, around the same position, as *ViewNavigator::wheel()* computes it. */
+        ViewNavigator next = view;
+        next.zoomAt(m_anchor, m_steps);
+        if (next.zoom() == zoom)
+            return;
+
+        internal::TileSpan const span   = internal::SpanOf(next.zoom(), ratio, next.origin(), size);
+        QPointF const            center = (next.origin() * next.zoom() + m_anchor) * ratio / tile;
+        internal::AddTiles(next.zoom(), ratio, span, nullptr, center, res);
+    }
+}
+
+
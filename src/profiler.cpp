@@ -0,0 +1,188 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  profiler.cpp
+ * \brief implementation of the plug-in call profiler
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <new>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/memory.hpp>
+
+/* app includes */
+#include <profiler.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \brief  maps a latency onto its histogram bucket
+         *
+         * Values below 8 have a bucket each; above, every power of two is split into eight buckets.
+         *
+         * \param  [in] ns latency, in nanoseconds
+         *
+         * \return bucket index
+         */
+        static size_t GetLatencyBucket(uint64_t ns) noexcept {
+            if (ns < 8)
+                return static_cast<size_t>(ns);
+
+            unsigned msb = 0;
+            for (uint64_t val = ns; val > 1; val >>= 1)
+                ++msb;
+
+            return 8 + (msb - 3) * 8 + static_cast<size_t>((ns >> (msb - 3)) & 7);
+        }
+
+        /**
+         * \brief  retrieves the largest latency mapped onto a histogram bucket
+         *
+         * \param  [in] bucket bucket index
+         *
+         * \return upper bound, in nanoseconds
+         */
+        static uint64_t GetBucketUpperBound(size_t bucket) noexcept {
+            if (bucket < 8)
+                return bucket;
+
+            unsigned const shift = static_cast<unsigned>((bucket - 8) / 8);
+            uint64_t const lower = (8 + (bucket - 8) % 8) << shift;
+            return lower + ((uint64_t{ 1 } << shift) - 1);
+        }
+    }
+
+
+    CallStats::CallStats() noexcept
+        : m_count(0), m_total(0), m_max(0), m_allocs(0), m_bytes(0)
+    {
+        for (std::atomic<uint64_t> &bucket : m_hist)
+            bucket.store(0, std::memory_order_relaxed);
+    }
+
+    void CallStats::add(uint64_t ns, uint64_t allocs, uint64_t bytes) noexcept {
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_total.fetch_add(ns, std::memory_order_relaxed);
+        m_allocs.fetch_add(allocs, std::memory_order_relaxed);
+        m_bytes.fetch_add(bytes, std::memory_order_relaxed);
+        m_hist[internal::GetLatencyBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t prev = m_max.load(std::memory_order_relaxed);
+        while (prev < ns && !m_max.compare_exchange_weak(prev, ns, std::memory_order_relaxed))
+            ;
+    }
+
+    uint64_t CallStats::percentile(double p) const noexcept {
+        uint64_t total = 0;
+        for (std::atomic<uint64_t> const &bucket : m_hist)
+            total += bucket.load(std::memory_order_relaxed);
+        if (total == 0)
+            return 0;
+
+        uint64_t const rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::clamp(p, 0.0, 1.0) * static_cast<double>(total) + 0.5));
+        uint64_t       seen = 0;
+        for (size_t i = 0; i < gl_nbuckets; ++i) {
+            seen += m_hist[i].load(std::memory_order_relaxed);
+
+            if (seen >= rank)
+                return std::min(internal::GetBucketUpperBound(i), max());
+        }
+
+        return max();
+    }
+
+
+    CallProfiler::Scope::Scope(CallProfiler &profiler, std::string_view plugin, std::string_view callback) noexcept
+        : m_stats(profiler.isEnabled() ? profiler.stats(plugin, callback) : nullptr)
+    {
+        if (m_stats == nullptr)
+            return;
+
+        m_alloc = sdk::MemoryAccounts::ThreadAllocations();
+        m_begin = std::chrono::steady_clock::now();
+    }
+
+    CallProfiler::Scope::~Scope() {
+        if (m_stats == nullptr)
+            return;
+
+        auto const                             ns    = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_begin).count();
+        sdk::MemoryAccounts::Allocations const alloc = sdk::MemoryAccounts::ThreadAllocations();
+        m_stats->add(static_cast<uint64_t>(ns), alloc.count - m_alloc.count, alloc.bytes - m_alloc.bytes);
+    }
+
+
+    std::vector<CallProfiler::Row> CallProfiler::report() const {
+        std::vector<Row> rows;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            for (auto const &[key, stats] : m_stats)
+                rows.push_back({
+                    key.first,
+                    key.second,
+                    stats->count(),
+                    stats->total(),
+                    stats->percentile(0.5),
+                    stats->percentile(0.99),
+                    stats->max(),
+                    stats->allocs(),
+                    stats->bytes()
+                });
+        }
+
+        std::sort(rows.begin(), rows.end(), [](Row const &lhs, Row const &rhs) { return lhs.total > rhs.total; });
+        return rows;
+    }
+
+    void CallProfiler::logReport() const noexcept {
+        try {
+            for (Row const &row : report())
+                SZSDK_APP_INFO(
+                    "Plug-in \"{}\" callback \"{}\": {} call(s), total {:.3f} ms, p50 {:.1f} us, p99 {:.1f} us, max {:.1f} us, {} allocation(s) ({} bytes)",
+                    row.plugin,
+                    row.callback,
+                    row.count,
+                    static_cast<double>(row.total) / 1e6,
+                    static_cast<double>(row.p50) / 1e3,
+                    static_cast<double>(row.p99) / 1e3,
+                    static_cast<double>(row.max) / 1e3,
+                    row.allocs,
+                    row.bytes
+                );
+        } catch (...) { }
+    }
+
+    CallStats *CallProfiler::stats(std::string_view plugin, std::string_view callback) noexcept {
+        try {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            auto it = m_stats.find(std::pair<std::string_view, std::string_view>{ plugin, callback });
+            if (it == m_stats.end())
+                it = m_stats.emplace(Key{ plugin, callback }, std::make_unique<CallStats>()).first;
+
+            return it->second.get();
+        } catch (...) { }
+
+        return nullptr;
+    }
+}
+
+
+/*
+ * Charge heap allocations of the host to the active memory account, which also counts them for
+ * *suzu::CallProfiler*; expands to nothing unless *SZSDK_MEMTRACK* is defined.
+ */
+SZSDK_DEFINE_ALLOCATION_HOOK()
@@ -0,0 +1,274 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  projectsaver.cpp
+ * \brief implementation of incremental project saving
+ */
+
+
+/* stdlib includes */
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/project.hpp>
+
+/* app includes */
+#include <metrics.hpp>
+#include <modelcache.hpp>
+#include <projectsaver.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \struct suzu::internal::SaverState
+         * \brief  project saved by a *suzu::ProjectSaver*
+         */
+        struct SaverState {
+            std::mutex          m_lock;    /**< guards the journal */
+            std::string         m_path;    /**< path of the project file */
+            sdk::ProjectJournal m_journal; /**< journal of the project */
+        };
+
+        /**
+         * \brief writes the warm-start cache of a project that has just been written as a whole
+         *
+         * A cache that cannot be written only costs the next open its warm start, so the save
+         * succeeds regardless.
+         *
+         * \param [in] path path of the project file
+         * \param [in] diagrams all diagrams of the project, in order, as written
+         */
+        static void WriteCache(std::string const &path, std::vector<ModelCache::Diagram> const &diagrams) noexcept {
+            SZSDK_PROFILE_SCOPE("ProjectSaver::WriteCache");
+
+            sdk::ProjectReader reader;
+            sdk::ErrorCode     err = reader.open(path.c_str());
+            if (err == sdk::ErrorCode::Ok)
+                err = ModelCache::Write(path.c_str(), reader.contentHash(), diagrams);
+
+            if (err != sdk::ErrorCode::Ok)
+                SZSDK_APP_WARNING("Could not write the cache of project \"{}\" (error {}); it is opened without a warm start.", path, static_cast<int>(err));
+        }
+    }
+
+
+    ProjectSaver::~ProjectSaver() {
+        close();
+    }
+
+
+    void ProjectSaver::SetCompactionThreshold(uint64_t bytes) noexcept {
+        gl_threshold = bytes;
+    }
+
+    void ProjectSaver::SetCompression(sdk::Compression level) noexcept {
+        gl_compression = level;
+    }
+
+    sdk::ErrorCode ProjectSaver::open(char const *path) noexcept {
+        static uint32_t const gl_metric = Metrics::Local().add("project.open", Metrics::Kind::Histogram);
+        MetricTimer const     timer(gl_metric);
+
+        close();
+        if (path == nullptr)
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            sdk::ProjectReader reader;
+            sdk::ErrorCode     err = reader.open(path);
+            if (err != sdk::ErrorCode::Ok)
+                return err;
+
+            auto state    = std::make_shared<internal::SaverState>();
+            state->m_path = path;
+
+            /* The reader has to release the journal before it can be truncated. */
+            uint64_t const identity = reader.identity();
+            uint64_t const valid    = reader.journalSize();
+            reader.close();
+
+            err = state->m_journal.open(path, identity, valid);
+            if (err == sdk::ErrorCode::Ok)
+                m_state = std::move(state);
+            return err;
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    sdk::ErrorCode ProjectSaver::saveAs(char const *path, std::vector<Diagram> const &diagrams, bool durable) noexcept {
+        SZSDK_PROFILE_SCOPE("ProjectSaver::saveAs");
+
+        static uint32_t const gl_metric = Metrics::Local().add("project.saveas", Metrics::Kind::Histogram);
+        MetricTimer const     timer(gl_metric);
+
+        close();
+        if (path == nullptr)
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            auto state    = std::make_shared<internal::SaverState>();
+            state->m_path = path;
+
+            sdk::ProjectWriter writer;
+            sdk::ErrorCode     err = writer.open(path, gl_compression);
+            for (size_t i = 0; i < diagrams.size() && err == sdk::ErrorCode::Ok; ++i)
+                err = writer.addDiagram(diagrams[i].name, *diagrams[i].store);
+
+            /* The previous journal does not apply to the new file; start an empty one. */
+            uint64_t identity = 0;
+            if (err == sdk::ErrorCode::Ok)
+                err = writer.commit(durable, [&identity](uint64_t id) {
+                    identity = id;
+
+                    return sdk::ErrorCode::Ok;
+                });
+            if (err == sdk::ErrorCode::Ok)
+                err = state->m_journal.open(path, identity, 0);
+            if (err != sdk::ErrorCode::Ok)
+                return err;
+
+            std::vector<ModelCache::Diagram> cached;
+            for (Diagram const &diagram : diagrams)
+                cached.push_back({ diagram.name, diagram.store });
+            internal::WriteCache(state->m_path, cached);
+
+            m_state = std::move(state);
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::WriteFile;
+    }
+
+    sdk::ErrorCode ProjectSaver::save(std::vector<Diagram> const &diagrams, bool durable) noexcept {
+        SZSDK_PROFILE_SCOPE("ProjectSaver::save");
+
+        static uint32_t const gl_metric = Metrics::Local().add("project.save", Metrics::Kind::Histogram);
+        MetricTimer const     timer(gl_metric);
+
+        if (m_state == nullptr)
+            return sdk::ErrorCode::InvalidState;
+
+        {
+            std::lock_guard<std::mutex> lock(m_state->m_lock);
+            if (!m_state->m_journal.isOpen())
+                return sdk::ErrorCode::InvalidState;
+
+            for (Diagram const &diagram : diagrams) {
+                sdk::ErrorCode const err = m_state->m_journal.append(diagram.index, diagram.name, *diagram.store, durable);
+                if (err != sdk::ErrorCode::Ok)
+                    return err;
+            }
+        }
+
+        schedule();
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode ProjectSaver::compact() noexcept {
+        if (m_state == nullptr)
+            return sdk::ErrorCode::InvalidState;
+
+        m_compaction.wait();
+        m_compaction = {};
+        return Compact(*m_state, gl_compression);
+    }
+
+    void ProjectSaver::close() noexcept {
+        m_compaction.wait();
+        m_compaction = {};
+
+        m_state.reset();
+    }
+
+
+    void ProjectSaver::schedule() noexcept {
+        if (gl_threshold == 0 || isCompacting())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(m_state->m_lock);
+            if (m_state->m_journal.size() < gl_threshold)
+                return;
+        }
+
+        /* The task keeps the state alive, so closing the saver does not have to cancel it. */
+        std::shared_ptr<internal::SaverState> state = m_state;
+        m_compaction = sdk::SubmitTask([state, compression = gl_compression]() {
+            sdk::ErrorCode const err = Compact(*state, compression);
+
+            if (err != sdk::ErrorCode::Ok && err != sdk::ErrorCode::NoOperation)
+                SZSDK_APP_WARNING("Could not compact project \"{}\" (error {}); the journal is kept.", state->m_path, static_cast<int>(err));
+        }, sdk::TaskPriority::Low);
+    }
+
+    sdk::ErrorCode ProjectSaver::Compact(internal::SaverState &state, sdk::Compression compression) noexcept {
+        SZSDK_PROFILE_SCOPE("ProjectSaver::Compact");
+
+        try {
+            /* Records appended while the new file is written lie beyond *from* and are carried over. */
+            sdk::ProjectReader reader;
+            sdk::ErrorCode     err = reader.open(state.m_path.c_str());
+            if (err != sdk::ErrorCode::Ok)
+                return err;
+
+            uint64_t const from = reader.journalSize();
+            if (from <= sizeof(sdk::JournalHeader))
+                return sdk::ErrorCode::NoOperation;
+
+            /* The diagrams are kept for the cache of the new file. */
+            sdk::ProjectWriter               writer;
+            std::vector<sdk::ElementStore>   stores(reader.diagramCount());
+            std::vector<std::string>         names(reader.diagramCount());
+            std::vector<ModelCache::Diagram> cached;
+            err = writer.open(state.m_path.c_str(), compression);
+            for (uint32_t i = 0; i < reader.diagramCount() && err == sdk::ErrorCode::Ok; ++i) {
+                names[i] = reader.diagramName(i);
+
+                err = reader.loadDiagram(i, stores[i]);
+                if (err == sdk::ErrorCode::Ok)
+                    err = writer.addDiagram(names[i], stores[i]);
+                cached.push_back({ names[i], &stores[i] });
+            }
+            reader.close();
+            if (err != sdk::ErrorCode::Ok)
+                return err;
+
+            /* Saves are held back until the journal matches the new file. */
+            std::lock_guard<std::mutex> lock(state.m_lock);
+            if (!state.m_journal.isOpen())
+                return sdk::ErrorCode::InvalidState;
+
+            /* Both files are flushed to the storage device before the old journal is dropped, or a
+             * crash right after could lose the records it held. */
+            err = writer.commit(true, [&state, from](uint64_t identity) {
+                return state.m_journal.stage(identity, from, true);
+            });
+            if (err == sdk::ErrorCode::Ok)
+                err = state.m_journal.promote();
+            if (err != sdk::ErrorCode::Ok)
+                return err;
+
+            /* Records carried over would make the cache stale right away. Saves stay held back, so
+             * that the hash the cache is written with is the one of the diagrams it holds. */
+            if (state.m_journal.size() <= sizeof(sdk::JournalHeader))
+                internal::WriteCache(state.m_path, cached);
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+}
+
+
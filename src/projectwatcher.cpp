@@ -0,0 +1,346 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  projectwatcher.cpp
+ * \brief implementation of reloading open diagrams when their project file changes on disk
+ */
+
+
+/* stdlib includes */
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/merge.hpp>
+
+/* app includes */
+#include <projectwatcher.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \struct suzu::internal::ExternalEdits
+         * \brief  differences between two versions of a diagram, by identity
+         */
+        struct ExternalEdits {
+            std::vector<std::pair<uint32_t, uint32_t>> modified; /**< element in the base and the new version */
+            std::vector<uint32_t>                      removed;  /**< element in the base */
+            std::vector<uint32_t>                      added;    /**< element in the new version; owners first */
+        };
+
+        static constexpr uint32_t gl_selected = static_cast<uint32_t>(sdk::ElementSelected); /**< flag that is not part of the diagram */
+
+        /**
+         * \brief  finds a diagram by name
+         *
+         * \param  [in] reader project
+         * \param  [in] name name of the diagram
+         *
+         * \return index of the diagram, or *UINT32_MAX* if there is none
+         */
+        static uint32_t FindDiagram(sdk::ProjectReader const &reader, std::string_view const name) noexcept {
+            for (uint32_t i = 0; i < reader.diagramCount(); ++i)
+                if (reader.diagramName(i) == name)
+                    return i;
+
+            return UINT32_MAX;
+        }
+
+        /**
+         * \brief  collects an element and everything it owns, owners first
+         *
+         * \param  [in] tree tree of the element
+         * \param  [in] node element
+         * \param  [out] out receives the elements; appended to
+         *
+         * \throw  std::bad_alloc
+         */
+        static void CollectSubtree(sdk::DiagramTree const &tree, uint32_t const node, std::vector<uint32_t> &out) {
+            size_t const first = out.size();
+
+            out.push_back(node);
+            for (size_t k = first; k < out.size(); ++k)
+                for (auto [it, end] = tree.childrenOf(out[k]); it != end; ++it)
+                    out.push_back(*it);
+        }
+
+        /**
+         * \brief  compares two versions of a diagram, like *suzu::sdk::DiffDiagrams()*, but keeps
+         *         the nodes instead of describing them
+         *
+         * \param  [in] base older version
+         * \param  [in] theirs newer version
+         * \param  [out] out receives the differences
+         *
+         * \throw  std::bad_alloc
+         */
+        static void CollectEdits(sdk::DiagramTree const &base, sdk::DiagramTree const &theirs, ExternalEdits &out) {
+            if (base.digest() == theirs.digest())
+                return;
+
+            sdk::DiagramTree const *const               trees[2] = { &base, &theirs };
+            std::vector<std::pair<uint32_t, uint32_t>> stack    = { { base.root(), theirs.root() } };
+            while (!stack.empty()) {
+                uint32_t const nodes[2] = { stack.back().first, stack.back().second };
+                stack.pop_back();
+
+                sdk::internal::JoinChildren(trees, nodes, [&](uint32_t const (&match)[2]) {
+                    if (match[1] == sdk::DiagramTree::gl_none)
+                        CollectSubtree(base, match[0], out.removed);
+                    else if (match[0] == sdk::DiagramTree::gl_none)
+                        CollectSubtree(theirs, match[1], out.added);
+                    else if (base.hashOf(match[0]) != theirs.hashOf(match[1])) {
+                        if (base.compare(match[0], theirs, match[1]) != 0)
+                            out.modified.emplace_back(match[0], match[1]);
+
+                        stack.emplace_back(match[0], match[1]);
+                    }
+                });
+            }
+        }
+
+        /**
+         * \brief  applies the external changes of a diagram to its open version
+         *
+         * Every change is applied only where the open version still matches the base, so that
+         * edits made since the base win.
+         *
+         * \param  [in] base diagram as of the base
+         * \param  [in] theirs diagram as of the changed file
+         * \param  [in] diagram open diagram
+         * \param  [out] edits receives the number of edits applied
+         *
+         * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource*
+         *         if an edit failed; all edits are reverted then
+         */
+        static sdk::ErrorCode PatchDiagram(sdk::ElementStore const &base, sdk::ElementStore const &theirs, ProjectWatcher::Diagram const &diagram, uint32_t &edits) noexcept {
+            edits = 0;
+
+            UndoStack               &undo = *diagram.undo;
+            sdk::ElementStore const &live = *diagram.store;
+            try {
+                sdk::DiagramTree btree, ttree, ltree;
+                btree.build(base);
+                ttree.build(theirs);
+
+                ExternalEdits changes;
+                CollectEdits(btree, ttree, changes);
+                if (changes.modified.empty() && changes.removed.empty() && changes.added.empty())
+                    return sdk::ErrorCode::Ok;
+
+                /* Elements of the open version are looked up by identity; handles stay valid while editing, dense indices do not. */
+                ltree.build(live);
+
+                std::unordered_map<uint64_t, sdk::ElementHandle> current;
+                current.reserve(ltree.size());
+                for (uint32_t i = 0; i < ltree.size(); ++i)
+                    current.emplace(ltree.keyOf(i), live.handleAt(i));
+
+                auto const find = [&](uint64_t const key) -> uint32_t {
+                    auto const it = current.find(key);
+
+                    return it != current.end() && live.isValid(it->second) ? live.indexOf(it->second) : sdk::DiagramTree::gl_none;
+                };
+
+                sdk::ErrorCode err = sdk::ErrorCode::Ok;
+                auto const     apply = [&](sdk::ErrorCode const res) {
+                    if (res == sdk::ErrorCode::Ok)
+                        ++edits;
+                    else if (err == sdk::ErrorCode::Ok)
+                        err = res;
+                };
+
+                undo.beginGroup();
+                for (auto const &[b, t] : changes.modified) {
+                    uint32_t const l = find(btree.keyOf(b));
+                    if (l == sdk::DiagramTree::gl_none || err != sdk::ErrorCode::Ok)
+                        continue;
+
+                    sdk::ElementHandle const handle = live.handleAt(l);
+                    if (std::memcmp(&live.bounds()[l], &base.bounds()[b], sizeof(sdk::ElementRect)) == 0 && std::memcmp(&base.bounds()[b], &theirs.bounds()[t], sizeof(sdk::ElementRect)) != 0)
+                        apply(undo.setBounds(handle, theirs.bounds()[t]));
+                    if (live.styles()[l] == base.styles()[b] && base.styles()[b] != theirs.styles()[t])
+                        apply(undo.setStyle(handle, theirs.styles()[t]));
+
+                    uint32_t const flags = live.flags()[l];
+                    if ((flags & ~gl_selected) == (base.flags()[b] & ~gl_selected) && (base.flags()[b] & ~gl_selected) != (theirs.flags()[t] & ~gl_selected))
+                        apply(undo.setFlags(handle, (theirs.flags()[t] & ~gl_selected) | (flags & gl_selected)));
+                }
+
+                /* Elements changed since the base are kept, and so are the elements they own. */
+                for (uint32_t const b : changes.removed) {
+                    uint32_t const l = find(btree.keyOf(b));
+
+                    if (l != sdk::DiagramTree::gl_none && err == sdk::ErrorCode::Ok && btree.compare(b, ltree, l) == 0)
+                        apply(undo.destroy(live.handleAt(l)));
+                }
+
+                /* Owners come first, so that the owner of every added element exists already. */
+                for (uint32_t const t : changes.added) {
+                    uint64_t const key = ttree.keyOf(t);
+                    if (err != sdk::ErrorCode::Ok || find(key) != sdk::DiagramTree::gl_none)
+                        continue;
+
+                    sdk::ElementHandle       parent = sdk::gl_nullelement;
+                    sdk::ElementHandle const owner  = theirs.parents()[t];
+                    if (theirs.isValid(owner)) {
+                        uint32_t const l = find(ttree.keyOf(theirs.indexOf(owner)));
+
+                        if (l != sdk::DiagramTree::gl_none)
+                            parent = live.handleAt(l);
+                    }
+
+                    sdk::ElementHandle const handle = undo.create(theirs.kinds()[t], theirs.bounds()[t], theirs.styles()[t], parent, theirs.names()[t]);
+                    if (handle == sdk::gl_nullelement) {
+                        apply(sdk::ErrorCode::CriticalResource);
+
+                        continue;
+                    }
+                    ++edits;
+                    current[key] = handle;
+
+                    if ((theirs.flags()[t] & ~gl_selected) != 0)
+                        apply(undo.setFlags(handle, theirs.flags()[t] & ~gl_selected));
+                }
+                undo.endGroup();
+
+                if (err == sdk::ErrorCode::Ok)
+                    return sdk::ErrorCode::Ok;
+            } catch (...) {
+                undo.endGroup();
+            }
+
+            /* The failed operation is reverted as a whole; there is none if not a single edit succeeded. */
+            if (edits != 0)
+                undo.undo();
+            edits = 0;
+
+            return sdk::ErrorCode::CriticalResource;
+        }
+    }
+
+
+    ProjectWatcher::~ProjectWatcher() {
+        stop();
+    }
+
+
+    sdk::ErrorCode ProjectWatcher::start(std::string path, Source source, Listener listener) noexcept {
+        stop();
+        if (path.empty() || !source)
+            return sdk::ErrorCode::InvalidParameter;
+
+        sdk::ErrorCode const err = m_base.open(path.c_str());
+        if (err != sdk::ErrorCode::Ok)
+            return err;
+
+        try {
+            m_watcher = std::make_unique<sdk::internal::ConfigWatcher>(path, gl_debounce, [this]() {
+                Report report;
+
+                sdk::ErrorCode const res = reload(&report);
+                if (res != sdk::ErrorCode::Ok && res != sdk::ErrorCode::NoOperation)
+                    SZSDK_APP_WARNING("Could not reload project \"{}\" after it changed on disk (error {}).", m_path, static_cast<int>(res));
+                else if (res == sdk::ErrorCode::Ok && m_listener)
+                    m_listener(report);
+            });
+
+            m_path     = std::move(path);
+            m_source   = std::move(source);
+            m_listener = std::move(listener);
+        } catch (...) {
+            stop();
+
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode ProjectWatcher::reload(Report *report) noexcept {
+        if (!isRunning())
+            return sdk::ErrorCode::InvalidState;
+
+        Report res = { 0, 0, 0, false };
+        if (report != nullptr)
+            *report = res;
+
+        /* A file that is still being written does not read as a project; the next change retries. */
+        sdk::ProjectReader   theirs;
+        sdk::ErrorCode const err = theirs.open(m_path.c_str());
+        if (err != sdk::ErrorCode::Ok)
+            return err;
+        if (theirs.contentHash() == m_base.contentHash())
+            return sdk::ErrorCode::NoOperation;
+
+        try {
+            std::vector<Diagram> const open = m_source();
+
+            res.listed = theirs.diagramCount() != m_base.diagramCount();
+            for (uint32_t i = 0; i < theirs.diagramCount(); ++i) {
+                uint32_t const b = internal::FindDiagram(m_base, theirs.diagramName(i));
+                if (b == UINT32_MAX) {
+                    res.listed = true;
+
+                    continue;
+                } else if (m_base.diagramDigest(b) == theirs.diagramDigest(i))
+                    continue;
+                ++res.changed;
+
+                /* Diagrams that are not open are read from the new version once they are opened. */
+                Diagram const *diagram = nullptr;
+                for (Diagram const &candidate : open)
+                    if (candidate.name == theirs.diagramName(i) && candidate.store != nullptr && candidate.undo != nullptr)
+                        diagram = &candidate;
+                if (diagram == nullptr)
+                    continue;
+
+                sdk::ElementStore before, after;
+                sdk::ErrorCode    loaded = m_base.mapDiagram(b, before);
+                if (loaded == sdk::ErrorCode::Ok)
+                    loaded = theirs.mapDiagram(i, after);
+                if (loaded != sdk::ErrorCode::Ok)
+                    return loaded;
+
+                /* Diagrams patched before a failure stay patched; patching them again from the kept base is a no-op. */
+                uint32_t             edits   = 0;
+                sdk::ErrorCode const patched = internal::PatchDiagram(before, after, *diagram, edits);
+                if (patched != sdk::ErrorCode::Ok)
+                    return patched;
+
+                res.patched += edits != 0;
+                res.edits   += edits;
+            }
+        } catch (...) {
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        m_base = std::move(theirs);
+        if (report != nullptr)
+            *report = res;
+
+        SZSDK_APP_INFO("Reloaded project \"{}\": {} diagram(s) changed on disk, {} edit(s) applied to {} open diagram(s).", m_path, res.changed, res.edits, res.patched);
+        return sdk::ErrorCode::Ok;
+    }
+
+    void ProjectWatcher::stop() noexcept {
+        m_watcher.reset();
+        m_base.close();
+
+        m_path.clear();
+        m_source   = {};
+        m_listener = {};
+    }
+}
+
+
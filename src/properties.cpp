@@ -0,0 +1,334 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  properties.cpp
+ * \brief implementation of the item model of the property editor
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <vector>
+
+/* app includes */
+#include <properties.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        static constexpr char const *gl_propnames[] = { "Kind", "Name", "X", "Y", "Width", "Height", "Style", "Hidden", "Locked" }; /**< labels of the rows */
+
+        static_assert(std::size(gl_propnames) == static_cast<size_t>(PropertyRow::__NumPropertyRows__), "every property needs a label");
+
+        /**
+         * \brief  checks whether a property is a flag, shown as a check box
+         *
+         * \param  [in] row property
+         *
+         * \return *true* for *suzu::PropertyRow::Hidden* and *suzu::PropertyRow::Locked*
+         */
+        static constexpr bool IsFlag(PropertyRow const row) noexcept {
+            return row == PropertyRow::Hidden || row == PropertyRow::Locked;
+        }
+    }
+
+
+    PropertyEditorModel::PropertyEditorModel(QObject *parent) noexcept
+        : QAbstractTableModel(parent), m_store(nullptr), m_undo(nullptr), m_count(0), m_value(), m_mixed()
+    { }
+
+
+    void PropertyEditorModel::Attach(QTreeView &view, PropertyEditorModel &model) {
+        view.setRootIsDecorated(false);
+        view.setUniformRowHeights(true);
+        view.setModel(&model);
+    }
+
+    void PropertyEditorModel::setStore(sdk::ElementStore const *store, UndoStack *undo) {
+        beginResetModel();
+
+        m_store = store;
+        m_undo  = undo;
+        aggregate();
+
+        endResetModel();
+    }
+
+    void PropertyEditorModel::refresh() {
+        aggregate();
+
+        emit dataChanged(index(0, 1), index(gl_rows - 1, 1));
+    }
+
+    sdk::ErrorCode PropertyEditorModel::commit(PropertyRow row, double value, sdk::StringId name) noexcept {
+        if (m_store == nullptr || m_undo == nullptr)
+            return sdk::ErrorCode::InvalidState;
+
+        /* Values are validated up front, so that invalid input does not leave half an edit. */
+        bool valid = std::isfinite(value);
+        switch (row) {
+            case PropertyRow::Name:
+            case PropertyRow::X:
+            case PropertyRow::Y:
+                break;
+            case PropertyRow::Width:
+            case PropertyRow::Height:
+                valid = valid && value >= 0.0;
+                break;
+            case PropertyRow::Style:
+                valid = valid && value >= 0.0 && value <= static_cast<double>(UINT32_MAX) && value == std::floor(value);
+                break;
+            case PropertyRow::Hidden:
+            case PropertyRow::Locked:
+                valid = value == 0.0 || value == 1.0;
+                break;
+            default:
+                valid = false;
+        }
+        if (!valid)
+            return sdk::ErrorCode::InvalidParameter;
+
+        std::vector<sdk::ElementHandle> selected;
+        try {
+            selected.reserve(m_count);
+
+            uint32_t const *const flags = m_store->flags();
+            for (uint32_t i = 0; i < m_store->size(); ++i)
+                if ((flags[i] & sdk::ElementSelected) != 0)
+                    selected.push_back(m_store->handleAt(i));
+        } catch (...) {
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        /* All elements form a single undo entry and a single transaction. */
+        sdk::ErrorCode err     = sdk::ErrorCode::Ok;
+        size_t         changed = 0;
+        m_undo->beginGroup();
+        for (sdk::ElementHandle const handle : selected) {
+            uint32_t const dense = m_store->indexOf(handle);
+
+            switch (row) {
+                case PropertyRow::Name:
+                    if (m_store->names()[dense] == name)
+                        continue;
+
+                    err = m_undo->setName(handle, name);
+                    break;
+                case PropertyRow::X:
+                case PropertyRow::Y:
+                case PropertyRow::Width:
+                case PropertyRow::Height: {
+                    sdk::ElementRect rect = m_store->bounds()[dense];
+                    float &component      = row == PropertyRow::X ? rect.x : row == PropertyRow::Y ? rect.y : row == PropertyRow::Width ? rect.w : rect.h;
+                    if (component == static_cast<float>(value))
+                        continue;
+
+                    component = static_cast<float>(value);
+                    err       = m_undo->setBounds(handle, rect);
+                    break;
+                }
+                case PropertyRow::Style:
+                    if (m_store->styles()[dense] == static_cast<uint32_t>(value))
+                        continue;
+
+                    err = m_undo->setStyle(handle, static_cast<uint32_t>(value));
+                    break;
+                default: {
+                    uint32_t const bit   = row == PropertyRow::Hidden ? sdk::ElementHidden : sdk::ElementLocked;
+                    uint32_t const flags = m_store->flags()[dense];
+                    uint32_t const next  = value != 0.0 ? flags | bit : flags & ~bit;
+                    if (next == flags)
+                        continue;
+
+                    err = m_undo->setFlags(handle, next);
+                    break;
+                }
+            }
+            if (err != sdk::ErrorCode::Ok)
+                break;
+
+            ++changed;
+        }
+        m_undo->endGroup();
+
+        if (err != sdk::ErrorCode::Ok && changed != 0)
+            m_undo->undo();
+        refresh();
+
+        if (err != sdk::ErrorCode::Ok)
+            return sdk::ErrorCode::CriticalResource;
+        return changed != 0 ? sdk::ErrorCode::Ok : sdk::ErrorCode::NoOperation;
+    }
+
+
+    int PropertyEditorModel::rowCount(QModelIndex const &parent) const {
+        return parent.isValid() ? 0 : gl_rows;
+    }
+
+    int PropertyEditorModel::columnCount(QModelIndex const &parent) const {
+        return parent.isValid() ? 0 : 2;
+    }
+
+    QVariant PropertyEditorModel::data(QModelIndex const &index, int role) const {
+        if (!index.isValid() || index.row() < 0 || index.row() >= gl_rows)
+            return QVariant();
+
+        PropertyRow const row = static_cast<PropertyRow>(index.row());
+        if (index.column() == 0)
+            return role == Qt::DisplayRole ? QVariant(QString::fromUtf8(internal::gl_propnames[index.row()])) : QVariant();
+        if (m_count == 0)
+            return QVariant();
+
+        bool const   mixed = m_mixed[index.row()];
+        double const value = m_value[index.row()];
+        if (internal::IsFlag(row)) {
+            if (role != Qt::CheckStateRole)
+                return QVariant();
+
+            return static_cast<int>(mixed ? Qt::PartiallyChecked : value != 0.0 ? Qt::Checked : Qt::Unchecked);
+        }
+
+        switch (role) {
+            case Qt::DisplayRole:
+                if (mixed)
+                    return QStringLiteral("(mixed)");
+
+                [[fallthrough]];
+            case Qt::EditRole:
+                /* Mixed values are edited starting from the first element, except names. */
+                switch (row) {
+                    case PropertyRow::Kind:
+                        return QString::fromUtf8(sdk::gl_kindlabels[static_cast<size_t>(value)]);
+                    case PropertyRow::Name: {
+                        std::string_view const name = mixed ? std::string_view() : m_name.view();
+
+                        return QString::fromUtf8(name.data(), static_cast<qsizetype>(name.size()));
+                    }
+                    case PropertyRow::Style:
+                        return static_cast<uint>(value);
+                    default:
+                        return value;
+                }
+            case Qt::ToolTipRole:
+                if (mixed)
+                    return QStringLiteral("The %1 selected elements have different values.").arg(m_count);
+        }
+
+        return QVariant();
+    }
+
+    bool PropertyEditorModel::setData(QModelIndex const &index, QVariant const &value, int role) {
+        if (!index.isValid() || index.column() != 1 || index.row() < 0 || index.row() >= gl_rows)
+            return false;
+
+        PropertyRow const row = static_cast<PropertyRow>(index.row());
+        sdk::ErrorCode    err;
+        if (internal::IsFlag(row)) {
+            if (role != Qt::CheckStateRole)
+                return false;
+
+            err = commit(row, value.toInt() == static_cast<int>(Qt::Checked) ? 1.0 : 0.0);
+        } else if (role != Qt::EditRole)
+            return false;
+        else if (row == PropertyRow::Name)
+            err = commit(row, 0.0, sdk::StringId(value.toString().toStdString()));
+        else {
+            bool         ok     = false;
+            double const number = value.toDouble(&ok);
+            if (!ok)
+                return false;
+
+            err = commit(row, number);
+        }
+
+        return err == sdk::ErrorCode::Ok || err == sdk::ErrorCode::NoOperation;
+    }
+
+    QVariant PropertyEditorModel::headerData(int section, Qt::Orientation orientation, int role) const {
+        if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+            return QVariant();
+
+        switch (section) {
+            case 0:  return QStringLiteral("Property");
+            case 1:  return QStringLiteral("Value");
+            default: return QVariant();
+        }
+    }
+
+    Qt::ItemFlags PropertyEditorModel::flags(QModelIndex const &index) const {
+        if (!index.isValid())
+            return Qt::NoItemFlags;
+
+        Qt::ItemFlags res = Qt::ItemIsEnabled | Qt::ItemNeverHasChildren;
+        if (index.column() != 1 || m_count == 0)
+            return res;
+
+        PropertyRow const row = static_cast<PropertyRow>(index.row());
+        if (internal::IsFlag(row))
+            res |= Qt::ItemIsUserCheckable;
+        else if (row != PropertyRow::Kind)
+            res |= Qt::ItemIsSelectable | Qt::ItemIsEditable;
+
+        return res;
+    }
+
+
+    void PropertyEditorModel::aggregate() noexcept {
+        m_count = 0;
+        m_name  = sdk::StringId();
+        std::fill(std::begin(m_value), std::end(m_value), 0.0);
+        std::fill(std::begin(m_mixed), std::end(m_mixed), false);
+        if (m_store == nullptr)
+            return;
+
+        uint32_t const *const      flags = m_store->flags();
+        sdk::StringId const *const names = m_store->names();
+        for (uint32_t i = 0; i < m_store->size(); ++i) {
+            if ((flags[i] & sdk::ElementSelected) == 0)
+                continue;
+
+            if (m_count++ == 0) {
+                for (int row = 0; row < gl_rows; ++row)
+                    if (static_cast<PropertyRow>(row) != PropertyRow::Name)
+                        m_value[row] = valueOf(static_cast<PropertyRow>(row), i);
+                m_name = names[i];
+
+                continue;
+            }
+
+            for (int row = 0; row < gl_rows; ++row)
+                if (!m_mixed[row] && static_cast<PropertyRow>(row) != PropertyRow::Name && valueOf(static_cast<PropertyRow>(row), i) != m_value[row])
+                    m_mixed[row] = true;
+            if (names[i] != m_name)
+                m_mixed[static_cast<int>(PropertyRow::Name)] = true;
+        }
+    }
+
+    double PropertyEditorModel::valueOf(PropertyRow row, uint32_t dense) const noexcept {
+        sdk::ElementRect const &bounds = m_store->bounds()[dense];
+        uint32_t const          flags  = m_store->flags()[dense];
+
+        switch (row) {
+            case PropertyRow::Kind:   return static_cast<double>(m_store->kinds()[dense]);
+            case PropertyRow::X:      return bounds.x;
+            case PropertyRow::Y:      return bounds.y;
+            case PropertyRow::Width:  return bounds.w;
+            case PropertyRow::Height: return bounds.h;
+            case PropertyRow::Style:  return m_store->styles()[dense];
+            case PropertyRow::Hidden: return (flags & sdk::ElementHidden) != 0 ? 1.0 : 0.0;
+            case PropertyRow::Locked: return (flags & sdk::ElementLocked) != 0 ? 1.0 : 0.0;
+            default:                  return 0.0;
+        }
+    }
+}
+
+
@@ -0,0 +1,250 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  remoteplugin.cpp
+ * \brief implementation of out-of-process plug-ins
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+/* external includes */
+#include <QCoreApplication>
+#include <QMetaObject>
+
+/* app includes */
+#include <remoteplugin.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        constexpr uint32_t gl_maxchanges = static_cast<uint32_t>(sdk::ipc::ChannelLayout::gl_capacity / 4 / sizeof(sdk::ChangeRecord)); /**< maximum number of changes per message */
+
+
+        /**
+         * \brief  generates a channel name unique to this process
+         *
+         * \return channel name
+         */
+        static QString GenerateChannelName() {
+            static std::atomic<uint32_t> gl_next = 0;
+
+            return QStringLiteral("suzu-plugin-%1-%2").arg(QCoreApplication::applicationPid()).arg(gl_next++);
+        }
+    }
+
+
+    RemotePlugin::RemotePlugin() noexcept
+        : m_sock(nullptr), m_running(false)
+    { }
+
+    RemotePlugin::~RemotePlugin() {
+        if (m_thread == nullptr)
+            return;
+
+        run([this]() {
+            if (isRunning()) {
+                uint32_t const none = 0;
+                if (post(sdk::ipc::MessageType::Shutdown, &none, 0))
+                    flush();
+
+                if (!m_proc->waitForFinished(1000)) {
+                    m_proc->kill();
+                    m_proc->waitForFinished(1000);
+                }
+            }
+
+            m_requests = {};
+            m_replies  = {};
+            m_sock     = nullptr;
+            m_proc.reset();
+            m_server.reset();
+            m_shm.reset();
+        });
+
+        /* Once its thread has finished, the context can be destroyed here. */
+        m_thread->quit();
+        m_thread->wait();
+        m_context.reset();
+    }
+
+
+    sdk::ErrorCode RemotePlugin::start(std::string const &hostexe, std::string const &library, int timeout) noexcept {
+        if (isRunning())
+            return sdk::ErrorCode::InvalidState;
+
+        try {
+            if (m_thread == nullptr) {
+                auto thread  = std::make_unique<QThread>();
+                auto context = std::make_unique<QObject>();
+                context->moveToThread(thread.get());
+                thread->start();
+
+                m_thread  = std::move(thread);
+                m_context = std::move(context);
+            }
+        } catch (...) {
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        sdk::ErrorCode res = sdk::ErrorCode::Unknown;
+        run([&]() {
+            try {
+                /* The rings of a previous host must not outlive its segment. */
+                m_requests = {};
+                m_replies  = {};
+                m_sock     = nullptr;
+                m_proc.reset();
+                m_server.reset();
+                m_shm.reset();
+
+                /* Create the channel before the host is started; the host attaches to it. */
+                QString const channel = internal::GenerateChannelName();
+                m_shm = std::make_unique<QSharedMemory>();
+                m_shm->setKey(channel);
+                if (!m_shm->create(static_cast<qsizetype>(sdk::ipc::ChannelLayout::Size()))) {
+                    res = sdk::ErrorCode::CriticalResource;
+
+                    return;
+                }
+
+                m_requests = sdk::ipc::MessageRing::Create(sdk::ipc::ChannelLayout::Requests(m_shm->data()), sdk::ipc::ChannelLayout::gl_capacity);
+                m_replies  = sdk::ipc::MessageRing::Create(sdk::ipc::ChannelLayout::Replies(m_shm->data()), sdk::ipc::ChannelLayout::gl_capacity);
+
+                m_server = std::make_unique<QLocalServer>();
+                if (!m_server->listen(channel)) {
+                    res = sdk::ErrorCode::CriticalResource;
+
+                    return;
+                }
+
+                m_proc = std::make_unique<QProcess>();
+                QObject::connect(m_proc.get(), &QProcess::stateChanged, m_context.get(), [this](QProcess::ProcessState const state) {
+                    m_running.store(state == QProcess::Running, std::memory_order_release);
+                });
+                m_proc->start(QString::fromStdString(hostexe), { channel, QString::fromStdString(library) });
+                if (!m_proc->waitForStarted(timeout) || !m_server->waitForNewConnection(timeout)) {
+                    res = sdk::ErrorCode::CriticalResource;
+
+                    return;
+                }
+                m_sock = m_server->nextPendingConnection();
+
+                /* The first reply reports whether the plug-in could be loaded. */
+                int32_t hello = sdk::ErrorCode::CriticalResource;
+                receive([&](uint32_t type, void const *data, uint32_t size) {
+                    if (type == sdk::ipc::MessageType::Hello && size == sizeof hello)
+                        std::memcpy(&hello, data, sizeof hello);
+                }, timeout);
+
+                res = static_cast<sdk::ErrorCode>(hello);
+            } catch (...) {
+                res = sdk::ErrorCode::Unknown;
+            }
+        });
+
+        return res;
+    }
+
+
+    bool RemotePlugin::post(uint32_t type, void const *data, uint32_t size) noexcept {
+        if (!m_requests.isValid())
+            return false;
+
+        return m_requests.push(type, data, size);
+    }
+
+    void RemotePlugin::flush() noexcept {
+        if (!m_requests.isValid() || !m_requests.flush() || m_sock == nullptr)
+            return;
+
+        run([this]() {
+            m_sock->write("\x01", 1);
+            m_sock->flush();
+        });
+    }
+
+
+    sdk::ErrorCode RemotePlugin::ping(int timeout, int64_t *rtt) noexcept {
+        auto const begin = std::chrono::steady_clock::now();
+
+        int64_t const token = begin.time_since_epoch().count();
+        if (!post(sdk::ipc::MessageType::Ping, &token, sizeof token))
+            return sdk::ErrorCode::CriticalResource;
+        flush();
+
+        bool ok = false;
+        while (!ok) {
+            size_t const n = receive([&](uint32_t type, void const *data, uint32_t size) {
+                ok = ok || (type == sdk::ipc::MessageType::Pong && size == sizeof token && std::memcmp(data, &token, sizeof token) == 0);
+            }, timeout);
+
+            if (n == 0)
+                return sdk::ErrorCode::CriticalResource;
+        }
+
+        if (rtt != nullptr)
+            *rtt = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode RemotePlugin::notifyChanges(sdk::ChangeBatch const &batch, int timeout) noexcept {
+        for (uint32_t offset = 0; offset < batch.count; ) {
+            uint32_t const n = std::min(batch.count - offset, internal::gl_maxchanges);
+            if (!post(sdk::ipc::MessageType::Changes, batch.records + offset, n * static_cast<uint32_t>(sizeof(sdk::ChangeRecord))))
+                return sdk::ErrorCode::CriticalResource;
+            flush();
+
+            bool    replied = false;
+            int32_t res     = sdk::ErrorCode::CriticalResource;
+            while (!replied) {
+                size_t const nreplies = receive([&](uint32_t type, void const *data, uint32_t size) {
+                    if (type != sdk::ipc::MessageType::ChangeResult || size != sizeof res)
+                        return;
+
+                    std::memcpy(&res, data, sizeof res);
+                    replied = true;
+                }, timeout);
+
+                if (nreplies == 0)
+                    return sdk::ErrorCode::CriticalResource;
+            }
+
+            if (res != sdk::ErrorCode::Ok)
+                return static_cast<sdk::ErrorCode>(res);
+            offset += n;
+        }
+
+        return sdk::ErrorCode::Ok;
+    }
+
+
+    void RemotePlugin::run(std::function<void()> const &fn) noexcept {
+        if (m_thread == nullptr || QThread::currentThread() == m_thread.get()) {
+            fn();
+
+            return;
+        }
+
+        QMetaObject::invokeMethod(m_context.get(), fn, Qt::BlockingQueuedConnection);
+    }
+
+    void RemotePlugin::sleep(int timeout) noexcept {
+        run([this, timeout]() {
+            if (m_sock != nullptr && m_sock->waitForReadyRead(timeout))
+                m_sock->readAll();
+        });
+    }
+}
+
+
@@ -0,0 +1,573 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  remoteproject.cpp
+ * \brief implementation of reading project files from HTTP servers chunk by chunk
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+#if defined _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <Windows.h>
+    #include <winioctl.h>
+#else
+    #include <sys/stat.h>
+#endif
+
+/* external includes */
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QUrl>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+
+/* app includes */
+#include <remoteproject.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \brief  builds the range header of a request
+         *
+         * \param  [in] offset position of the first byte
+         * \param  [in] size number of bytes; at least 1
+         *
+         * \return header value, e.g. *bytes=0-31*
+         */
+        static QByteArray RangeOf(uint64_t const offset, uint64_t const size) {
+            char buffer[64];
+            std::snprintf(buffer, sizeof buffer, "bytes=%llu-%llu", static_cast<unsigned long long>(offset), static_cast<unsigned long long>(offset + size - 1));
+
+            return QByteArray(buffer);
+        }
+
+        /**
+         * \brief  reads the size of the whole file from the *Content-Range* header of a reply
+         *
+         * \param  [in] header header value, e.g. *bytes 0-31/1048576*
+         *
+         * \return size of the file; 0 if unknown
+         */
+        static uint64_t TotalOf(QByteArray const &header) noexcept {
+            std::string_view const text(header.constData(), static_cast<size_t>(header.size()));
+
+            size_t const   slash = text.rfind('/');
+            uint64_t       total = 0;
+            if (slash == std::string_view::npos || std::from_chars(text.data() + slash + 1, text.data() + text.size(), total).ec != std::errc())
+                return 0;
+
+            return total;
+        }
+
+        /**
+         * \brief  marks a file as sparse, creating it if needed, so that the parts that have never
+         *         been written take no space on the disk
+         *
+         * NTFS allocates and zeroes every byte a file is resized to, unless the file is sparse.
+         * Other file systems leave the parts that have not been written unallocated anyway.
+         *
+         * \param  [in] path path of the file
+         *
+         * \return *true* if the file is sparse
+         */
+        static bool MakeSparse(std::filesystem::path const &path) noexcept {
+#if defined _WIN32
+            HANDLE const file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                return false;
+
+            DWORD      bytes = 0;
+            bool const ok    = DeviceIoControl(file, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &bytes, nullptr) != FALSE;
+            CloseHandle(file);
+
+            return ok;
+#else
+            (void)path;
+
+            return true;
+#endif
+        }
+
+        /**
+         * \brief  retrieves the space a file takes on the disk, which for a sparse file is less than
+         *         its size
+         *
+         * \param  [in] path path of the file
+         *
+         * \return bytes allocated for the file; its size if unknown
+         */
+        static uint64_t AllocatedSize(std::filesystem::path const &path) noexcept {
+#if defined _WIN32
+            DWORD       high = 0;
+            DWORD const low  = GetCompressedFileSizeW(path.c_str(), &high);
+            if (low != INVALID_FILE_SIZE || GetLastError() == NO_ERROR)
+                return (static_cast<uint64_t>(high) << 32) | low;
+#else
+            struct stat info;
+            if (stat(path.c_str(), &info) == 0)
+                return static_cast<uint64_t>(info.st_blocks) * 512;
+#endif
+
+            std::error_code ec;
+            uint64_t const  size = std::filesystem::file_size(path, ec);
+            return ec ? 0 : size;
+        }
+
+        /**
+         * \brief  validates a reply to a range request
+         *
+         * \param  [in] reply finished reply
+         * \param  [in] url requested URL, for the log
+         * \param  [in] size number of requested bytes
+         * \param  [out] data receives the bytes
+         *
+         * \return *true* if the server answered with exactly the range
+         */
+        static bool ReadReply(QNetworkReply &reply, std::string const &url, uint64_t const size, QByteArray &data) {
+            int const status = reply.attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if (reply.error() != QNetworkReply::NoError) {
+                SZSDK_APP_WARNING("Could not fetch {} from \"{}\": {}.", reply.request().rawHeader("Range").toStdString(), url, reply.errorString().toStdString());
+
+                return false;
+            } else if (status != 206) {
+                /* A server ignoring the range sends the whole file, which is exactly what this class avoids. */
+                SZSDK_APP_WARNING("Server of \"{}\" does not support range requests (status {}).", url, status);
+
+                return false;
+            }
+
+            data = reply.readAll();
+            return static_cast<uint64_t>(data.size()) == size;
+        }
+    }
+
+
+    /**
+     * \struct suzu::RemoteProject::Fetch
+     * \brief  state of a fetch whose requests are running
+     */
+    struct RemoteProject::Fetch {
+        std::vector<Range> ranges;  /**< ranges requested */
+        size_t             pending; /**< number of requests not finished yet, plus one while they are being sent */
+        sdk::ErrorCode     result;  /**< result so far */
+        Done               done;    /**< called once all requests have finished */
+    };
+
+
+    RemoteProject::RemoteProject() noexcept
+        : m_session(0), m_fetched(0)
+    { }
+
+    RemoteProject::~RemoteProject() {
+        close();
+    }
+
+
+    void RemoteProject::SetCacheDirectory(std::string dir) noexcept {
+        gl_cachedir = std::move(dir);
+    }
+
+    void RemoteProject::SetCacheLimit(uint64_t bytes) noexcept {
+        gl_cachelimit = bytes;
+    }
+
+    void RemoteProject::SetTimeout(uint32_t msecs) noexcept {
+        gl_timeout = static_cast<int>(std::min<uint32_t>(msecs, INT_MAX));
+    }
+
+    bool RemoteProject::IsRemote(std::string_view path) noexcept {
+        return path.substr(0, 7) == "http://" || path.substr(0, 8) == "https://";
+    }
+
+    sdk::ErrorCode RemoteProject::open(std::string url, Done done) noexcept {
+        close();
+        if (!IsRemote(url) || done == nullptr)
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            if (m_net == nullptr)
+                m_net = std::make_unique<QNetworkAccessManager>();
+            m_url = std::move(url);
+
+            /* The header tells where the index is; the index tells where everything else is. */
+            get(0, sizeof(sdk::ProjectHeader), [this, done = std::move(done)](QNetworkReply &reply) { readHeader(reply, done); });
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        close();
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    void RemoteProject::close() noexcept {
+        /* Aborting emits the signals of the replies right away; the new session makes them ignored. */
+        ++m_session;
+
+        std::vector<QNetworkReply *> replies;
+        replies.swap(m_replies);
+        for (QNetworkReply *const reply : replies)
+            reply->abort();
+
+        m_reader.close();
+        m_view.close();
+        m_cache.reset();
+
+        m_url.clear();
+        m_index.clear();
+        m_diagram.clear();
+        m_present.clear();
+        m_fetched = 0;
+    }
+
+    sdk::ErrorCode RemoteProject::fetchDiagrams(std::vector<uint32_t> const &diagrams, Done done) noexcept {
+        if (!isOpen())
+            return sdk::ErrorCode::InvalidState;
+        else if (done == nullptr)
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            std::vector<uint32_t> entries;
+            entries.reserve(diagrams.size());
+            for (uint32_t const diagram : diagrams) {
+                if (diagram >= m_diagram.size())
+                    return sdk::ErrorCode::InvalidParameter;
+
+                entries.push_back(m_diagram[diagram]);
+            }
+
+            fetch(std::move(entries), std::move(done));
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    sdk::ErrorCode RemoteProject::fetchChunk(uint32_t type, std::string_view name, Done done) noexcept {
+        if (!isOpen())
+            return sdk::ErrorCode::InvalidState;
+        else if (done == nullptr)
+            return sdk::ErrorCode::InvalidParameter;
+
+        /* Names are looked up in the string table, which is always fetched. */
+        sdk::ProjectChunk const *const found = m_reader.findChunk(type, name);
+        if (found == nullptr)
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            for (uint32_t i = 0; i < m_index.size(); ++i)
+                if (m_index[i].type == type && m_index[i].offset == found->offset && m_index[i].size == found->size) {
+                    fetch({ i }, std::move(done));
+
+                    return sdk::ErrorCode::Ok;
+                }
+        } catch (...) {
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        return sdk::ErrorCode::InvalidParameter;
+    }
+
+    sdk::ErrorCode RemoteProject::mapDiagram(uint32_t diagram, sdk::ElementStore &store, Done done) noexcept {
+        if (done == nullptr)
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            return fetchDiagrams({ diagram }, [this, diagram, &store, done = std::move(done)](sdk::ErrorCode const err) {
+                done(err == sdk::ErrorCode::Ok ? m_reader.mapDiagram(diagram, store) : err);
+            });
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+
+    void RemoteProject::get(uint64_t offset, uint64_t size, Handler handler) {
+        QNetworkRequest req(QUrl(QString::fromStdString(m_url)));
+        req.setRawHeader("Range", internal::RangeOf(offset, size));
+        req.setTransferTimeout(gl_timeout);
+
+        m_replies.reserve(m_replies.size() + 1);
+        QNetworkReply *const reply = m_net->get(req);
+        m_replies.push_back(reply);
+
+        QObject::connect(reply, &QNetworkReply::finished, m_net.get(), [this, reply, session = m_session, handler = std::move(handler)]() {
+            /* The reply must not be deleted while it emits the signal. */
+            reply->deleteLater();
+            if (session != m_session)
+                return;
+
+            m_replies.erase(std::remove(m_replies.begin(), m_replies.end(), reply), m_replies.end());
+            handler(*reply);
+        });
+    }
+
+    void RemoteProject::readHeader(QNetworkReply &reply, Done const &done) noexcept {
+        try {
+            QByteArray         bytes;
+            sdk::ProjectHeader header;
+            uint64_t const     total = internal::TotalOf(reply.rawHeader("Content-Range"));
+            if (!internal::ReadReply(reply, m_url, sizeof(header), bytes) || total == 0) {
+                fail(sdk::ErrorCode::ReadFile, done);
+
+                return;
+            }
+            std::memcpy(&header, bytes.constData(), sizeof(header));
+            m_fetched += sizeof(header);
+
+            uint64_t const size = static_cast<uint64_t>(header.chunks) * sizeof(sdk::ProjectChunk);
+            if (std::memcmp(header.magic, sdk::ProjectHeader::gl_magic, sizeof(header.magic)) != 0 || header.version > sdk::ProjectHeader::gl_version || header.index > total || size > total - header.index) {
+                fail(sdk::ErrorCode::ReadFile, done);
+
+                return;
+            }
+
+            if (size == 0)
+                readIndex(header, total, nullptr, done);
+            else
+                get(header.index, size, [this, header, total, done](QNetworkReply &reply) { readIndex(header, total, &reply, done); });
+            return;
+        } catch (...) { }
+
+        fail(sdk::ErrorCode::CriticalResource, done);
+    }
+
+    void RemoteProject::readIndex(sdk::ProjectHeader const &header, uint64_t total, QNetworkReply *reply, Done const &done) noexcept {
+        try {
+            uint64_t const size  = static_cast<uint64_t>(header.chunks) * sizeof(sdk::ProjectChunk);
+            QByteArray     bytes;
+            if (reply != nullptr && !internal::ReadReply(*reply, m_url, size, bytes)) {
+                fail(sdk::ErrorCode::ReadFile, done);
+
+                return;
+            }
+            m_fetched += size;
+
+            if (sdk::util::HashBytes(bytes.constData(), static_cast<size_t>(size)) != header.indexhash) {
+                fail(sdk::ErrorCode::ReadFile, done);
+
+                return;
+            }
+
+            m_index.resize(header.chunks);
+            std::memcpy(m_index.data(), bytes.constData(), m_index.size() * sizeof(sdk::ProjectChunk));
+            m_present.assign(m_index.size(), 0);
+            for (uint32_t i = 0; i < m_index.size(); ++i) {
+                if (m_index[i].offset > total || m_index[i].size > total - m_index[i].offset) {
+                    fail(sdk::ErrorCode::ReadFile, done);
+
+                    return;
+                }
+                if (m_index[i].type == sdk::gl_chunkdiagram)
+                    m_diagram.push_back(i);
+            }
+
+            /* The cache file has the size of the project; only the fetched ranges hold data and take space on the disk. */
+            char name[32];
+            std::snprintf(name, sizeof name, "%016llx.suzu", static_cast<unsigned long long>(header.indexhash));
+
+            std::error_code ec;
+            std::filesystem::create_directories(gl_cachedir, ec);
+            std::string const path = (std::filesystem::path(gl_cachedir) / name).string();
+            if (!internal::MakeSparse(path))
+                SZSDK_APP_WARNING("Could not make cache file \"{}\" sparse; it takes the whole size of the project on the disk.", path);
+
+            m_cache = std::make_unique<QFile>(QString::fromStdString(path));
+            bool written = m_cache->open(QIODevice::ReadWrite)
+                && (static_cast<uint64_t>(m_cache->size()) == total || m_cache->resize(static_cast<qint64>(total)))
+                && m_cache->seek(0) && m_cache->write(reinterpret_cast<char const *>(&header), sizeof(header)) == sizeof(header)
+                && m_cache->seek(static_cast<qint64>(header.index)) && m_cache->write(bytes) == bytes.size()
+                && m_cache->flush();
+            if (!written || m_view.open(path.c_str()) != sdk::ErrorCode::Ok || m_view.size() != total) {
+                fail(sdk::ErrorCode::WriteFile, done);
+
+                return;
+            }
+
+            /* Opening the reader validates the string table, so it has to be there first. */
+            std::vector<uint32_t> strings;
+            for (uint32_t i = 0; i < m_index.size(); ++i)
+                if (m_index[i].type == sdk::gl_chunkstrings)
+                    strings.push_back(i);
+
+            fetch(std::move(strings), [this, path, total, done](sdk::ErrorCode err) {
+                if (err == sdk::ErrorCode::Ok)
+                    err = m_reader.open(path.c_str());
+                if (err != sdk::ErrorCode::Ok) {
+                    fail(err, done);
+
+                    return;
+                }
+
+                TrimCache(path);
+                SZSDK_APP_INFO("Opened remote project \"{}\" ({} bytes, {} diagram(s)) with {} bytes fetched.", m_url, total, m_diagram.size(), m_fetched);
+                done(sdk::ErrorCode::Ok);
+            });
+            return;
+        } catch (...) { }
+
+        fail(sdk::ErrorCode::CriticalResource, done);
+    }
+
+    void RemoteProject::fail(sdk::ErrorCode err, Done const &done) noexcept {
+        close();
+
+        done(err);
+    }
+
+    void RemoteProject::fetch(std::vector<uint32_t> entries, Done done) noexcept {
+        std::shared_ptr<Fetch> state;
+        try {
+            entries.erase(std::remove_if(entries.begin(), entries.end(), [this](uint32_t const entry) { return m_index[entry].size == 0 || isCached(entry); }), entries.end());
+            if (entries.empty()) {
+                done(sdk::ErrorCode::Ok);
+
+                return;
+            }
+
+            /* Chunks close to each other are fetched together; the gap between them is fetched along. */
+            std::sort(entries.begin(), entries.end(), [this](uint32_t const a, uint32_t const b) { return m_index[a].offset < m_index[b].offset; });
+            entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+            state          = std::make_shared<Fetch>();
+            state->pending = 1;
+            state->result  = sdk::ErrorCode::Ok;
+            state->done    = std::move(done);
+            for (uint32_t const entry : entries) {
+                sdk::ProjectChunk const &chunk = m_index[entry];
+
+                if (!state->ranges.empty() && chunk.offset <= state->ranges.back().offset + state->ranges.back().size + gl_maxgap) {
+                    Range &last = state->ranges.back();
+
+                    last.size = std::max(last.size, chunk.offset + chunk.size - last.offset);
+                    last.chunks.push_back(entry);
+                } else
+                    state->ranges.push_back({ chunk.offset, chunk.size, { entry } });
+            }
+
+            /* All ranges are requested at once; the network access manager limits the connections per server. */
+            for (size_t r = 0; r < state->ranges.size(); ++r) {
+                get(state->ranges[r].offset, state->ranges[r].size, [this, state, r](QNetworkReply &reply) { store(*state, state->ranges[r], reply); });
+
+                ++state->pending;
+            }
+        } catch (...) {
+            if (state == nullptr) {
+                done(sdk::ErrorCode::CriticalResource);
+
+                return;
+            }
+
+            state->result = sdk::ErrorCode::CriticalResource;
+        }
+
+        /* The requests sent so far end the fetch once they have all finished. */
+        settle(*state);
+    }
+
+    void RemoteProject::store(Fetch &fetch, Range const &range, QNetworkReply &reply) noexcept {
+        try {
+            QByteArray data;
+            if (!internal::ReadReply(reply, m_url, range.size, data))
+                fetch.result = sdk::ErrorCode::ReadFile;
+            else {
+                m_fetched += range.size;
+
+                /* Chunks are validated before they are written, so the cache never holds a corrupt chunk at a valid place. */
+                for (uint32_t const entry : range.chunks) {
+                    sdk::ProjectChunk const &chunk = m_index[entry];
+                    char const *const        bytes = data.constData() + (chunk.offset - range.offset);
+
+                    if (sdk::util::HashBytes(bytes, static_cast<size_t>(chunk.size)) != chunk.hash) {
+                        SZSDK_APP_WARNING("Chunk at {} of \"{}\" does not match its hash; the project changed on the server?", chunk.offset, m_url);
+
+                        fetch.result = sdk::ErrorCode::ReadFile;
+                    } else if (!m_cache->seek(static_cast<qint64>(chunk.offset)) || m_cache->write(bytes, static_cast<qint64>(chunk.size)) != static_cast<qint64>(chunk.size))
+                        fetch.result = sdk::ErrorCode::WriteFile;
+                    else
+                        m_present[entry] = 1;
+                }
+            }
+        } catch (...) {
+            fetch.result = sdk::ErrorCode::CriticalResource;
+        }
+
+        settle(fetch);
+    }
+
+    void RemoteProject::settle(Fetch &fetch) noexcept {
+        if (--fetch.pending != 0)
+            return;
+
+        if (!m_cache->flush() && fetch.result == sdk::ErrorCode::Ok)
+            fetch.result = sdk::ErrorCode::WriteFile;
+
+        /* The callback may close the project or start another fetch. */
+        Done const done = std::move(fetch.done);
+        done(fetch.result);
+    }
+
+    bool RemoteProject::isCached(uint32_t entry) noexcept {
+        if (m_present[entry] != 0)
+            return true;
+
+        /* Sparse parts of the cache file read as zeros, which never match the hash. */
+        sdk::ProjectChunk const &chunk = m_index[entry];
+        if (sdk::util::HashBytes(m_view.data() + chunk.offset, static_cast<size_t>(chunk.size)) != chunk.hash)
+            return false;
+
+        m_present[entry] = 1;
+        return true;
+    }
+
+    void RemoteProject::TrimCache(std::string const &keep) noexcept {
+        if (gl_cachelimit == 0)
+            return;
+
+        try {
+            /* Opening a cache file counts as using it. */
+            std::error_code ec;
+            std::filesystem::last_write_time(keep, std::filesystem::file_time_type::clock::now(), ec);
+
+            std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> files;
+            uint64_t                                                                        used = 0;
+            for (std::filesystem::directory_entry const &entry : std::filesystem::directory_iterator(gl_cachedir, ec)) {
+                if (!entry.is_regular_file(ec) || entry.path().extension() != ".suzu")
+                    continue;
+
+                used += internal::AllocatedSize(entry.path());
+                if (entry.path() != std::filesystem::path(keep))
+                    files.emplace_back(entry.last_write_time(ec), entry.path());
+            }
+
+            /* Cache files are sparse, so only the bytes fetched into them count. */
+            std::sort(files.begin(), files.end());
+            for (size_t i = 0; i < files.size() && used > gl_cachelimit; ++i) {
+                uint64_t const size = internal::AllocatedSize(files[i].second);
+
+                if (std::filesystem::remove(files[i].second, ec))
+                    used -= std::min(used, size);
+            }
+        } catch (...) { }
+    }
+}
+
+
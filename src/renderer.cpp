@@ -0,0 +1,251 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  renderer.cpp
+ * \brief implementation of the diagram renderer
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/* external includes */
+#include <QBrush>
+#include <QPen>
+#include <QPolygonF>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+
+/* app includes */
+#include <renderer.hpp>
+#include <textcache.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \brief  converts the bounds of an element to a Qt rectangle
+         *
+         * \param  [in] rect bounds of the element
+         *
+         * \return rectangle in scene coordinates
+         */
+        static QRectF ToQRectF(sdk::ElementRect const &rect) noexcept {
+            return { rect.x, rect.y, rect.w, rect.h };
+        }
+
+        /**
+         * \class suzu::internal::StylePainter
+         * \brief applies the resolved styles of elements to a painter
+         *
+         * Consecutive elements mostly share their style, so the painter objects of a record are
+         * only switched when the record changes. Records that do not set a font keep the font the
+         * painter had when painting started.
+         */
+        class StylePainter {
+            QPainter                &m_painter; /**< painter to style */
+            StyleSheet const *const  m_sheet;   /**< style sheet; *nullptr* to keep the painter's style */
+            StyleRecord const       *m_current; /**< record applied last */
+            QPen const               m_basepen; /**< pen of the painter */
+            QBrush const             m_basebr;  /**< brush of the painter */
+            QFont const              m_basefnt; /**< font of the painter */
+            bool                     m_texton;  /**< whether or not the painter holds the text pen of *m_current* */
+
+        public:
+            StylePainter(QPainter &painter, StyleSheet const *const sheet)
+                : m_painter(painter), m_sheet(sheet), m_current(nullptr), m_basepen(painter.pen()), m_basebr(painter.brush()),
+                  m_basefnt(painter.font()), m_texton(false)
+            { }
+            /**
+             * \brief restores the pen, brush and font of the painter
+             */
+            ~StylePainter() {
+                if (m_current != nullptr) {
+                    m_painter.setPen(m_basepen);
+                    m_painter.setBrush(m_basebr);
+                    m_painter.setFont(m_basefnt);
+                }
+            }
+
+            /**
+             * \brief selects the style of an element for painting its shape
+             *
+             * \param [in] item element to paint
+             */
+            void shape(RenderItem const &item) {
+                if (m_sheet == nullptr)
+                    return;
+
+                StyleRecord const &record = m_sheet->record(item.style);
+                if (&record != m_current) {
+                    if (m_current == nullptr || record.ownfont || m_current->ownfont)
+                        m_painter.setFont(record.ownfont ? record.font : m_basefnt);
+
+                    m_current = &record;
+                    m_painter.setBrush(record.fill);
+                    m_painter.setPen(record.shape);
+                    m_texton = false;
+                } else if (m_texton) {
+                    m_painter.setPen(record.shape);
+                    m_texton = false;
+                }
+            }
+
+            /**
+             * \brief selects the style of the current element for painting its name
+             */
+            void text() {
+                if (m_current != nullptr && !m_texton && m_current->textpen) {
+                    m_painter.setPen(m_current->text);
+                    m_texton = true;
+                }
+            }
+        };
+
+        /**
+         * \brief paints the name of an element
+         *
+         * \param [in] painter painter to draw with
+         * \param [in] kind kind of the element
+         * \param [in] rect bounds of the element
+         * \param [in] name name of the element
+         * \param [in] styles (optional) styles of the painted elements
+         */
+        static void RenderLabel(QPainter &painter, sdk::ElementKind const kind, QRectF const &rect, sdk::StringId const name, StylePainter *styles = nullptr) {
+            if (name.empty() || kind == sdk::ElementKind::Association)
+                return;
+            if (styles != nullptr)
+                styles->text();
+
+            double const header = std::min(DiagramRenderer::gl_headerheight, rect.height());
+            QRectF const area   = DiagramRenderer::IsClassifier(kind) ? QRectF(rect.left(), rect.top(), rect.width(), header) : rect;
+
+            /* Labels are shaped once per thread and zoom factor, and reused across repaints and tiles. */
+            TextLayoutCache::Layout const layout = TextLayoutCache::Shared().get(name, painter.font(), -1.0, painter.worldTransform().m11());
+            TextLayoutCache::Draw(painter, QPointF(
+                area.left() + (area.width() - layout.size.width()) / 2.0,
+                area.top() + (area.height() - layout.size.height()) / 2.0
+            ), layout);
+        }
+
+        /**
+         * \brief paints a single element
+         *
+         * \param [in] painter painter to draw with
+         * \param [in] kind kind of the element
+         * \param [in] rect bounds of the element
+         * \param [in] name name of the element
+         * \param [in] detail level of detail
+         * \param [in] styles (optional) styles of the painted elements; already selected for the element
+         */
+        static void RenderElement(QPainter &painter, sdk::ElementKind const kind, QRectF const &rect, sdk::StringId const name, DetailLevel const detail, StylePainter *styles = nullptr) {
+            /* Associations are drawn as a line across their bounds. */
+            if (kind == sdk::ElementKind::Association) {
+                painter.drawLine(rect.topLeft(), rect.bottomRight());
+
+                return;
+            }
+
+            if (kind == sdk::ElementKind::Note && detail != DetailLevel::Outlines) {
+                double const c = std::min(DiagramRenderer::gl_notecorner, std::min(rect.width(), rect.height()) / 2.0);
+
+                painter.drawPolygon(QPolygonF({
+                    rect.topLeft(),
+                    QPointF(rect.right() - c, rect.top()),
+                    QPointF(rect.right(), rect.top() + c),
+                    rect.bottomRight(),
+                    rect.bottomLeft()
+                }));
+            } else
+                painter.drawRect(rect);
+            if (detail == DetailLevel::Outlines)
+                return;
+
+            /* Classifiers separate their name from the (empty) member compartments. */
+            double const header = std::min(DiagramRenderer::gl_headerheight, rect.height());
+            if (DiagramRenderer::IsClassifier(kind) && detail == DetailLevel::Full && rect.height() > header)
+                painter.drawLine(QPointF(rect.left(), rect.top() + header), QPointF(rect.right(), rect.top() + header));
+
+            RenderLabel(painter, kind, rect, name, styles);
+        }
+    }
+
+
+    void DiagramRenderer::render(QPainter &painter, sdk::ElementStore const &store, QRectF const &region, DetailLevel detail) const {
+        SZSDK_PROFILE_SCOPE("DiagramRenderer::render");
+
+        std::vector<sdk::ElementHandle> visible;
+        store.query({ static_cast<float>(region.x()), static_cast<float>(region.y()), static_cast<float>(region.width()), static_cast<float>(region.height()) }, visible);
+
+        /* Results are ordered bottom-most first, which is the painting order. */
+        internal::StylePainter styles(painter, m_styles.get());
+        for (sdk::ElementHandle const handle : visible) {
+            RenderItem const item = itemOf(store, store.indexOf(handle));
+
+            styles.shape(item);
+            internal::RenderElement(painter, item.kind, internal::ToQRectF(item.bounds), item.name, detail, &styles);
+        }
+    }
+
+    void DiagramRenderer::render(QPainter &painter, std::vector<RenderItem> const &items, DetailLevel detail) const {
+        SZSDK_PROFILE_SCOPE("DiagramRenderer::render (snapshot)");
+
+        internal::StylePainter styles(painter, m_styles.get());
+        for (RenderItem const &item : items) {
+            styles.shape(item);
+            if (item.count < 2) {
+                internal::RenderElement(painter, item.kind, internal::ToQRectF(item.bounds), item.name, detail, &styles);
+
+                continue;
+            }
+
+            /* Edges between collapsed clusters grow with the number of associations they stand for. */
+            QPen pen = painter.pen();
+            pen.setWidthF(std::max(1.0, pen.widthF()) * (1.0 + std::log2(static_cast<double>(item.count))));
+
+            painter.save();
+            painter.setPen(pen);
+            internal::RenderElement(painter, item.kind, internal::ToQRectF(item.bounds), item.name, detail, &styles);
+            painter.restore();
+        }
+    }
+
+    void DiagramRenderer::renderLabels(QPainter &painter, std::vector<RenderItem> const &items, DetailLevel detail) const {
+        if (detail == DetailLevel::Outlines)
+            return;
+
+        internal::StylePainter styles(painter, m_styles.get());
+        for (RenderItem const &item : items) {
+            styles.shape(item);
+            internal::RenderLabel(painter, item.kind, internal::ToQRectF(item.bounds), item.name, &styles);
+        }
+    }
+
+    void DiagramRenderer::collect(sdk::ElementStore const &store, QRectF const &region, std::vector<RenderItem> &res, std::unordered_set<sdk::ElementHandle> const *skip) const {
+        std::vector<sdk::ElementHandle> visible;
+        store.query({ static_cast<float>(region.x()), static_cast<float>(region.y()), static_cast<float>(region.width()), static_cast<float>(region.height()) }, visible);
+
+        res.reserve(res.size() + visible.size());
+        for (sdk::ElementHandle const handle : visible)
+            if (skip == nullptr || skip->find(handle) == skip->end())
+                res.push_back(itemOf(store, store.indexOf(handle)));
+    }
+
+    RenderItem DiagramRenderer::itemOf(sdk::ElementStore const &store, uint32_t dense) const noexcept {
+        sdk::ElementKind const kind = store.kinds()[dense];
+
+        return { kind, store.bounds()[dense], store.names()[dense], m_styles != nullptr ? m_styles->resolve(kind, store.styles()[dense], store.flags()[dense]) : 0, 0 };
+    }
+}
+
+
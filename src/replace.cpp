@@ -0,0 +1,213 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  replace.cpp
+ * \brief implementation of project-wide find and replace
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+#include <sdk/log.hpp>
+#include <sdk/task.hpp>
+
+/* app includes */
+#include <replace.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        static char FoldCase(char const c) noexcept {
+            return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+        /**
+         * \brief  replaces every non-overlapping occurrence of a string in a name
+         *
+         * \param  [in] name name to rewrite
+         * \param  [in] find string to replace; in lower case unless *matchcase* is set
+         * \param  [in] replace replacement
+         * \param  [in] matchcase whether or not to compare ASCII letters case-sensitively
+         * \param  [out] out receives the new name
+         *
+         * \return *true* if *find* occurred in *name*
+         * \throw  std::bad_alloc
+         */
+        static bool ReplaceAll(std::string_view const name, std::string_view const find, std::string_view const replace, bool const matchcase, std::string &out) {
+            out.clear();
+
+            bool   found = false;
+            size_t done  = 0;
+            for (size_t i = 0; i + find.size() <= name.size(); ) {
+                size_t j = 0;
+                while (j < find.size() && (matchcase ? name[i + j] : FoldCase(name[i + j])) == find[j])
+                    ++j;
+                if (j != find.size()) {
+                    ++i;
+
+                    continue;
+                }
+
+                out.append(name.data() + done, i - done);
+                out.append(replace);
+                found = true;
+                i    += find.size();
+                done  = i;
+            }
+
+            out.append(name.data() + done, name.size() - done);
+            return found;
+        }
+    }
+
+
+    sdk::ErrorCode PlanReplace(SearchIndex const &index, std::vector<SearchIndex::Diagram> const &diagrams, std::string_view find, std::string_view replace, bool matchcase, std::vector<Replacement> &res) noexcept {
+        res.clear();
+        if (find.empty())
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            std::string folded(find);
+            if (!matchcase)
+                std::transform(folded.begin(), folded.end(), folded.begin(), internal::FoldCase);
+
+            /* The index narrows every diagram down to its candidates; without it, all names are checked. */
+            std::vector<SearchIndex::Hit>                hits;
+            bool const                                   indexed = index.query(find, hits, SIZE_MAX) == sdk::ErrorCode::Ok;
+            std::vector<std::vector<sdk::ElementHandle>> candidates(diagrams.size());
+            if (indexed) {
+                std::unordered_map<uint32_t, size_t> position;
+                for (size_t i = 0; i < diagrams.size(); ++i)
+                    position[diagrams[i].index] = i;
+
+                for (SearchIndex::Hit const &hit : hits) {
+                    auto const it = position.find(hit.diagram);
+                    if (it != position.end())
+                        candidates[it->second].push_back(hit.element);
+                }
+            }
+
+            std::vector<std::vector<Replacement>> parts(diagrams.size());
+            sdk::ParallelFor(diagrams.size(), [&](size_t const i) {
+                sdk::ElementStore const   &store = *diagrams[i].store;
+                sdk::StringId const *const names = store.names();
+                std::vector<uint32_t>      dense;
+                std::string                name;
+
+                if (indexed) {
+                    for (sdk::ElementHandle const element : candidates[i]) {
+                        uint32_t const at = store.indexOf(element);
+                        if (at < store.size())
+                            dense.push_back(at);
+                    }
+                    std::sort(dense.begin(), dense.end());
+                } else {
+                    dense.resize(store.size());
+                    for (uint32_t j = 0; j < store.size(); ++j)
+                        dense[j] = j;
+                }
+
+                for (uint32_t const j : dense)
+                    if (internal::ReplaceAll(names[j].view(), folded, replace, matchcase, name))
+                        parts[i].push_back({ diagrams[i].index, store.handleAt(j), names[j], sdk::StringId(name) });
+            });
+
+            size_t total = 0;
+            for (std::vector<Replacement> const &part : parts)
+                total += part.size();
+            res.reserve(total);
+            for (std::vector<Replacement> const &part : parts)
+                res.insert(res.end(), part.begin(), part.end());
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        res.clear();
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    sdk::ErrorCode ApplyReplace(std::vector<Replacement> const &plan, std::vector<ReplaceTarget> const &targets, ChangeDispatcher *changes, size_t *applied) noexcept {
+        if (applied != nullptr)
+            *applied = 0;
+
+        for (Replacement const &item : plan)
+            if (item.diagram >= targets.size() || targets[item.diagram].store == nullptr || targets[item.diagram].undo == nullptr)
+                return sdk::ErrorCode::InvalidParameter;
+
+        /* Stacks that received an entry, in order, so that a failure can be rolled back. */
+        std::vector<UndoStack *> entries;
+        try {
+            entries.reserve(plan.size());
+        } catch (...) {
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        if (changes != nullptr)
+            changes->begin();
+
+        sdk::ErrorCode     err     = sdk::ErrorCode::Ok;
+        size_t             renamed = 0;
+        sdk::ErrorTrail<8> trail;
+        for (size_t i = 0; i < plan.size() && err == sdk::ErrorCode::Ok; ) {
+            uint32_t const       diagram = plan[i].diagram;
+            ReplaceTarget const &target  = targets[diagram];
+            size_t               count   = 0;
+
+            target.undo->beginGroup();
+            for (; i < plan.size() && plan[i].diagram == diagram; ++i) {
+                uint32_t const dense = target.store->indexOf(plan[i].element);
+                if (dense >= target.store->size() || target.store->names()[dense] != plan[i].before)
+                    continue;
+
+                err = target.undo->setName(plan[i].element, plan[i].after);
+                if (err != sdk::ErrorCode::Ok) {
+                    trail.add(SZSDK_ERROR_CONTEXT(err, i));
+
+                    break;
+                }
+                ++count;
+            }
+            target.undo->endGroup();
+
+            if (count != 0)
+                entries.push_back(target.undo);
+            renamed += count;
+        }
+
+        if (err != sdk::ErrorCode::Ok) {
+            for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+                if (sdk::ErrorCode const res = (*it)->undo(); res != sdk::ErrorCode::Ok)
+                    trail.add(SZSDK_ERROR_CONTEXT(res, entries.rend() - it - 1));
+
+            /* Messages are only formatted once the rollback is complete. */
+            for (sdk::ErrorContext const &ctx : trail)
+                SZSDK_APP_WARNING("Replace rolled back: {} (item {}) at {}:{} in {}.", sdk::ErrorDescription(ctx.code), ctx.payload, ctx.file, ctx.line, ctx.function);
+            if (trail.dropped() != 0)
+                SZSDK_APP_WARNING("Replace rolled back: {} more error(s) not recorded.", trail.dropped());
+
+            renamed = 0;
+        }
+        if (changes != nullptr)
+            changes->end();
+
+        if (applied != nullptr)
+            *applied = renamed;
+        if (err != sdk::ErrorCode::Ok)
+            return sdk::ErrorCode::CriticalResource;
+
+        return renamed != 0 ? sdk::ErrorCode::Ok : sdk::ErrorCode::NoOperation;
+    }
+}
+
+
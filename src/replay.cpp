@@ -0,0 +1,382 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  replay.cpp
+ * \brief implementation of recording editing sessions and replaying them to measure performance
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+/* external includes */
+#include <QCoreApplication>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QResizeEvent>
+#include <QWheelEvent>
+#include <QWidget>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/project.hpp>
+
+/* app includes */
+#include <replay.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        constexpr uint32_t gl_chunksession = sdk::MakeChunkType("SESS"); /**< type of the chunk holding the *suzu::SessionHeader* */
+        constexpr uint32_t gl_chunkinput   = sdk::MakeChunkType("SINP"); /**< type of the chunk holding the *suzu::InputRecord*s */
+        constexpr auto     gl_pacingstep   = std::chrono::milliseconds(1);  /**< longest sleep while waiting for a paced event */
+
+
+        /**
+         * \brief  retrieves the time elapsed since a point in time
+         *
+         * \param  [in] begin point in time
+         *
+         * \return elapsed time, in nanoseconds
+         */
+        static int64_t NsSince(std::chrono::steady_clock::time_point const begin) noexcept {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+        }
+
+        /**
+         * \brief waits for a point in time while processing the events of the application
+         *
+         * \param [in] due point in time
+         */
+        static void WaitUntil(std::chrono::steady_clock::time_point const due) {
+            for (auto now = std::chrono::steady_clock::now(); now < due; now = std::chrono::steady_clock::now()) {
+                QCoreApplication::processEvents();
+
+                std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(due - now, gl_pacingstep));
+            }
+        }
+
+        /**
+         * \brief sends a recorded event to a widget and returns once it was handled
+         *
+         * \param [in] widget widget to send the event to
+         * \param [in] rec recorded event
+         */
+        static void Deliver(QWidget &widget, InputRecord const &rec) {
+            QPointF const               pos       = { rec.x, rec.y };
+            Qt::KeyboardModifiers const modifiers = Qt::KeyboardModifiers::fromInt(static_cast<int>(rec.modifiers));
+            Qt::MouseButtons const      buttons   = Qt::MouseButtons::fromInt(static_cast<int>(rec.buttons));
+
+            switch (rec.kind) {
+                case InputKind::Press:
+                case InputKind::DoubleClick:
+                case InputKind::Release:
+                case InputKind::Move: {
+                    static constexpr QEvent::Type gl_types[] = { QEvent::MouseButtonPress, QEvent::MouseButtonDblClick, QEvent::MouseButtonRelease, QEvent::MouseMove };
+
+                    QMouseEvent event(gl_types[static_cast<size_t>(rec.kind)], pos, widget.mapToGlobal(pos), static_cast<Qt::MouseButton>(rec.button), buttons, modifiers);
+                    QCoreApplication::sendEvent(&widget, &event);
+                    break;
+                }
+                case InputKind::Wheel: {
+                    QWheelEvent event(pos, widget.mapToGlobal(pos), QPoint(), QPoint(rec.dx, rec.dy), buttons, modifiers, Qt::NoScrollPhase, false);
+                    QCoreApplication::sendEvent(&widget, &event);
+                    break;
+                }
+                case InputKind::KeyPress:
+                case InputKind::KeyRelease: {
+                    QString const text = rec.text != 0 ? QString(QChar(static_cast<char16_t>(rec.text))) : QString();
+
+                    QKeyEvent event(rec.kind == InputKind::KeyPress ? QEvent::KeyPress : QEvent::KeyRelease, rec.key, modifiers, text);
+                    QCoreApplication::sendEvent(&widget, &event);
+                    break;
+                }
+                case InputKind::Resize: {
+                    QSize const size = { static_cast<int>(rec.x), static_cast<int>(rec.y) };
+                    QSize const old  = widget.size();
+
+                    /* Hidden widgets only receive the resize event once shown; it is sent right away to measure it. */
+                    widget.resize(size);
+                    if (!widget.isVisible()) {
+                        QResizeEvent event(size, old);
+                        QCoreApplication::sendEvent(&widget, &event);
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+
+    SessionRecorder::SessionRecorder(QObject *const parent) noexcept
+        : QObject(parent), m_view(nullptr), m_header{}
+    { }
+
+    SessionRecorder::~SessionRecorder() {
+        if (m_view != nullptr)
+            m_view->widget()->removeEventFilter(this);
+    }
+
+    sdk::ErrorCode SessionRecorder::start(DiagramView &view, sdk::ElementStore const &store) noexcept {
+        if (m_view != nullptr)
+            return sdk::ErrorCode::InvalidState;
+
+        try {
+            m_store = store.snapshot();
+            m_events.clear();
+        } catch (...) {
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        QWidget *const widget = view.widget();
+        m_header         = {};
+        m_header.version = SessionHeader::gl_version;
+        m_header.width   = widget->width();
+        m_header.height  = widget->height();
+        m_header.zoom    = view.navigator().zoom();
+        m_header.x       = view.navigator().origin().x();
+        m_header.y       = view.navigator().origin().y();
+
+        m_view  = &view;
+        m_begin = std::chrono::steady_clock::now();
+        widget->installEventFilter(this);
+
+        SZSDK_APP_INFO("Started recording a session of {} element(s).", m_store.size());
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode SessionRecorder::stop(char const *const path) noexcept {
+        if (m_view == nullptr)
+            return sdk::ErrorCode::InvalidState;
+
+        m_view->widget()->removeEventFilter(this);
+        m_view            = nullptr;
+        m_header.duration = internal::NsSince(m_begin);
+
+        sdk::ErrorCode err = sdk::ErrorCode::WriteFile;
+        try {
+            sdk::ProjectWriter writer;
+            if (writer.open(path) == sdk::ErrorCode::Ok
+                && writer.addDiagram("session", m_store) == sdk::ErrorCode::Ok
+                && writer.addChunk(internal::gl_chunksession, {}, reinterpret_cast<char const *>(&m_header), sizeof(m_header), 1) == sdk::ErrorCode::Ok
+                && writer.addChunk(internal::gl_chunkinput, {}, reinterpret_cast<char const *>(m_events.data()), m_events.size() * sizeof(InputRecord), static_cast<uint32_t>(m_events.size())) == sdk::ErrorCode::Ok
+                && writer.commit() == sdk::ErrorCode::Ok
+            )
+                err = sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        if (err == sdk::ErrorCode::Ok)
+            SZSDK_APP_INFO("Recorded {} event(s) over {:.1f} s to {}.", m_events.size(), static_cast<double>(m_header.duration) / 1e9, path);
+        else
+            SZSDK_APP_ERROR("Could not write the recorded session to {}.", path);
+
+        m_store = sdk::ElementStore();
+        m_events.clear();
+        m_events.shrink_to_fit();
+        return err;
+    }
+
+    bool SessionRecorder::eventFilter(QObject *const watched, QEvent *const event) {
+        if (m_view == nullptr || watched != m_view->widget() || m_events.size() >= gl_maxevents)
+            return QObject::eventFilter(watched, event);
+
+        InputRecord rec = {};
+        rec.time = internal::NsSince(m_begin);
+        switch (event->type()) {
+            case QEvent::MouseButtonPress:
+            case QEvent::MouseButtonDblClick:
+            case QEvent::MouseButtonRelease:
+            case QEvent::MouseMove: {
+                auto const *const mouse = static_cast<QMouseEvent const *>(event);
+
+                rec.kind      = event->type() == QEvent::MouseButtonPress ? InputKind::Press
+                              : event->type() == QEvent::MouseButtonDblClick ? InputKind::DoubleClick
+                              : event->type() == QEvent::MouseButtonRelease ? InputKind::Release
+                              : InputKind::Move;
+                rec.button    = static_cast<uint32_t>(mouse->button());
+                rec.buttons   = static_cast<uint32_t>(mouse->buttons().toInt());
+                rec.modifiers = static_cast<uint32_t>(mouse->modifiers().toInt());
+                rec.x         = mouse->position().x();
+                rec.y         = mouse->position().y();
+                break;
+            }
+            case QEvent::Wheel: {
+                auto const *const wheel = static_cast<QWheelEvent const *>(event);
+
+                rec.kind      = InputKind::Wheel;
+                rec.buttons   = static_cast<uint32_t>(wheel->buttons().toInt());
+                rec.modifiers = static_cast<uint32_t>(wheel->modifiers().toInt());
+                rec.x         = wheel->position().x();
+                rec.y         = wheel->position().y();
+                rec.dx        = wheel->angleDelta().x();
+                rec.dy        = wheel->angleDelta().y();
+                break;
+            }
+            case QEvent::KeyPress:
+            case QEvent::KeyRelease: {
+                auto const *const key = static_cast<QKeyEvent const *>(event);
+
+                rec.kind      = event->type() == QEvent::KeyPress ? InputKind::KeyPress : InputKind::KeyRelease;
+                rec.modifiers = static_cast<uint32_t>(key->modifiers().toInt());
+                rec.key       = key->key();
+                rec.text      = key->text().isEmpty() ? 0 : key->text().at(0).unicode();
+                break;
+            }
+            case QEvent::Resize: {
+                auto const *const resize = static_cast<QResizeEvent const *>(event);
+
+                rec.kind = InputKind::Resize;
+                rec.x    = resize->size().width();
+                rec.y    = resize->size().height();
+                break;
+            }
+            default:
+                return QObject::eventFilter(watched, event);
+        }
+
+        try {
+            m_events.push_back(rec);
+            if (m_events.size() == gl_maxevents)
+                SZSDK_APP_WARNING("Recorded session reached {} events; later events are not recorded.", gl_maxevents);
+        } catch (...) { }
+        return QObject::eventFilter(watched, event);
+    }
+
+
+    LatencyStats LatencyStats::Of(std::vector<int64_t> &samples) noexcept {
+        LatencyStats res = {};
+        if (samples.empty())
+            return res;
+
+        auto const rank = [&samples](double const p) {
+            auto const nth = samples.begin() + static_cast<ptrdiff_t>(p * static_cast<double>(samples.size() - 1) + 0.5);
+
+            std::nth_element(samples.begin(), nth, samples.end());
+            return static_cast<double>(*nth) / 1e6;
+        };
+        res.count = samples.size();
+        res.p50   = rank(0.5);
+        res.p90   = rank(0.9);
+        res.p99   = rank(0.99);
+        res.max   = static_cast<double>(*std::max_element(samples.begin(), samples.end())) / 1e6;
+        return res;
+    }
+
+
+    SessionReplayer::SessionReplayer() noexcept
+        : m_header{}
+    { }
+
+    sdk::ErrorCode SessionReplayer::open(char const *const path) noexcept {
+        m_header = {};
+        try {
+            m_store = sdk::ElementStore();
+            m_events.clear();
+
+            sdk::ProjectReader reader;
+            sdk::ErrorCode     err = reader.open(path);
+            if (err != sdk::ErrorCode::Ok)
+                return err;
+
+            std::vector<char>                   buffer;
+            sdk::Result<std::string_view> const header = reader.chunk(internal::gl_chunksession, {}, buffer);
+            if (!header || header->size() != sizeof(SessionHeader))
+                return sdk::ErrorCode::InvalidParameter;
+
+            SessionHeader read;
+            std::memcpy(&read, header->data(), sizeof(read));
+            if (read.version != SessionHeader::gl_version || reader.diagramCount() == 0)
+                return sdk::ErrorCode::InvalidParameter;
+
+            sdk::Result<std::string_view> const input = reader.chunk(internal::gl_chunkinput, {}, buffer);
+            if (!input || input->size() % sizeof(InputRecord) != 0)
+                return sdk::ErrorCode::InvalidParameter;
+
+            m_events.resize(input->size() / sizeof(InputRecord));
+            std::memcpy(m_events.data(), input->data(), input->size());
+            bool const valid = std::all_of(m_events.begin(), m_events.end(), [](InputRecord const &rec) { return rec.kind < InputKind::Count; });
+            if (!valid || (err = reader.loadDiagram(0, m_store)) != sdk::ErrorCode::Ok) {
+                m_events.clear();
+
+                return valid ? err : sdk::ErrorCode::InvalidParameter;
+            }
+            m_header = read;
+        } catch (...) {
+            m_events.clear();
+
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode SessionReplayer::run(DiagramView &view, bool const render, bool const paced, ReplayResult &res) noexcept {
+        if (m_header.version == 0)
+            return sdk::ErrorCode::InvalidState;
+
+        QWidget *const widget = view.widget();
+        try {
+            size_t counts[static_cast<size_t>(InputKind::Count)] = {};
+            for (InputRecord const &rec : m_events)
+                ++counts[static_cast<size_t>(rec.kind)];
+
+            res = {};
+            for (size_t i = 0; i < static_cast<size_t>(InputKind::Count); ++i)
+                res.latency[i].reserve(counts[i]);
+            if (render)
+                res.frames.reserve(m_events.size());
+
+            view.setStore(&m_store);
+            widget->resize(m_header.width, m_header.height);
+            view.setViewport(m_header.zoom, QPointF(m_header.x, m_header.y));
+            if (render) {
+                widget->show();
+                QCoreApplication::processEvents();
+                widget->repaint();
+            }
+
+            auto const begin = std::chrono::steady_clock::now();
+            for (InputRecord const &rec : m_events) {
+                if (paced)
+                    internal::WaitUntil(begin + std::chrono::nanoseconds(rec.time));
+
+                /* In rendering mode, the latency covers delivering tiles finished meanwhile, as the event loop would before painting. */
+                auto const start = std::chrono::steady_clock::now();
+                internal::Deliver(*widget, rec);
+                if (render) {
+                    QCoreApplication::processEvents();
+
+                    auto const paint = std::chrono::steady_clock::now();
+                    widget->repaint();
+                    res.frames.push_back(internal::NsSince(paint));
+                }
+                res.latency[static_cast<size_t>(rec.kind)].push_back(internal::NsSince(start));
+            }
+            res.elapsed  = internal::NsSince(begin);
+            res.recorded = m_header.duration;
+
+            if (render)
+                widget->hide();
+        } catch (...) {
+            if (render)
+                widget->hide();
+
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        return sdk::ErrorCode::Ok;
+    }
+}
+
+
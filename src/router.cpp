@@ -0,0 +1,507 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  router.cpp
+ * \brief implementation of the incremental orthogonal edge router
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <queue>
+#include <utility>
+
+/* app includes */
+#include <router.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \struct suzu::internal::RoutePort
+         * \brief  point where a route leaves or enters a box
+         */
+        struct RoutePort {
+            RoutePoint attach;     /**< point on the box's side */
+            RoutePoint exit;       /**< point at clearance distance from the side */
+            bool       horizontal; /**< whether or not the route leaves the side horizontally */
+        };
+
+
+        /**
+         * \brief  grows a rectangle by *margin* in every direction
+         *
+         * \param  [in] rect rectangle
+         * \param  [in] margin margin
+         *
+         * \return grown rectangle
+         */
+        static sdk::ElementRect Inflate(sdk::ElementRect const &rect, float const margin) noexcept {
+            return { rect.x - margin, rect.y - margin, rect.w + 2.0f * margin, rect.h + 2.0f * margin };
+        }
+
+        /**
+         * \brief  computes the bounding box of two rectangles
+         *
+         * \param  [in] a first rectangle
+         * \param  [in] b second rectangle
+         *
+         * \return smallest rectangle containing both
+         */
+        static sdk::ElementRect Unite(sdk::ElementRect const &a, sdk::ElementRect const &b) noexcept {
+            float const x0 = std::min(a.x, b.x);
+            float const y0 = std::min(a.y, b.y);
+
+            return { x0, y0, std::max(a.x + a.w, b.x + b.w) - x0, std::max(a.y + a.h, b.y + b.h) - y0 };
+        }
+
+        /**
+         * \brief  computes the ports at the middle of the four sides of a box
+         *
+         * \param  [in] box bounds of the box
+         *
+         * \return ports of the top, bottom, left and right side
+         */
+        static std::array<RoutePort, 4> PortsOf(sdk::ElementRect const &box) noexcept {
+            float const cx = box.x + box.w * 0.5f;
+            float const cy = box.y + box.h * 0.5f;
+
+            /* Exit points must lie exactly on the grid lines of the inflated box. */
+            sdk::ElementRect const out = Inflate(box, EdgeRouter::gl_clearance);
+            return { {
+                { { cx, box.y },         { cx, out.y },         false },
+                { { cx, box.y + box.h }, { cx, out.y + out.h }, false },
+                { { box.x, cy },         { out.x, cy },         true  },
+                { { box.x + box.w, cy }, { out.x + out.w, cy }, true  }
+            } };
+        }
+
+        /**
+         * \brief  builds an L-shaped route between the centers of two boxes, ignoring obstacles
+         *
+         * \param  [in] source bounds of the source element
+         * \param  [in] target bounds of the target element
+         *
+         * \return route
+         */
+        static std::vector<RoutePoint> FallbackRoute(sdk::ElementRect const &source, sdk::ElementRect const &target) {
+            float const scx = source.x + source.w * 0.5f, scy = source.y + source.h * 0.5f;
+            float const tcx = target.x + target.w * 0.5f, tcy = target.y + target.h * 0.5f;
+
+            /* Boxes facing each other are connected by a straight line. */
+            float const top = std::max(source.y, target.y), bottom = std::min(source.y + source.h, target.y + target.h);
+            if (top <= bottom) {
+                float const y = (top + bottom) * 0.5f;
+
+                return tcx >= scx
+                    ? std::vector<RoutePoint>{ { source.x + source.w, y }, { target.x, y } }
+                    : std::vector<RoutePoint>{ { source.x, y }, { target.x + target.w, y } };
+            }
+            float const left = std::max(source.x, target.x), right = std::min(source.x + source.w, target.x + target.w);
+            if (left <= right) {
+                float const x = (left + right) * 0.5f;
+
+                return tcy >= scy
+                    ? std::vector<RoutePoint>{ { x, source.y + source.h }, { x, target.y } }
+                    : std::vector<RoutePoint>{ { x, source.y }, { x, target.y + target.h } };
+            }
+
+            return {
+                { tcx >= scx ? source.x + source.w : source.x, scy },
+                { tcx, scy },
+                { tcx, tcy >= scy ? target.y : target.y + target.h }
+            };
+        }
+
+        /**
+         * \brief  removes vertices lying on a straight line between their neighbors
+         *
+         * \param  [in] points route
+         *
+         * \return simplified route
+         */
+        static std::vector<RoutePoint> Simplify(std::vector<RoutePoint> const &points) {
+            std::vector<RoutePoint> res;
+            res.reserve(points.size());
+
+            for (RoutePoint const &pt : points) {
+                if (!res.empty() && res.back().x == pt.x && res.back().y == pt.y)
+                    continue;
+
+                if (res.size() >= 2) {
+                    RoutePoint const &a = res[res.size() - 2];
+                    RoutePoint const &b = res.back();
+
+                    if ((a.x == b.x && b.x == pt.x) || (a.y == b.y && b.y == pt.y))
+                        res.pop_back();
+                }
+                res.push_back(pt);
+            }
+
+            return res;
+        }
+    }
+
+
+    sdk::ErrorCode EdgeRouter::connect(sdk::ElementHandle edge, sdk::ElementHandle source, sdk::ElementHandle target) noexcept {
+        if (edge.isNull() || source.isNull() || target.isNull())
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            auto const [it, inserted] = m_edges.try_emplace(edge, Edge{ source, target, {}, 0, 0, true, false });
+            if (!inserted) {
+                it->second.source = source;
+                it->second.target = target;
+
+                markDirty(edge, it->second);
+            }
+
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    sdk::ErrorCode EdgeRouter::disconnect(sdk::ElementHandle edge) noexcept {
+        auto const it = m_edges.find(edge);
+        if (it == m_edges.end())
+            return sdk::ErrorCode::InvalidParameter;
+
+        if (it->second.indexed)
+            m_corridors.remove(edge);
+        m_edges.erase(it);
+        return sdk::ErrorCode::Ok;
+    }
+
+    void EdgeRouter::invalidate(sdk::ElementRect const &region) {
+        std::vector<sdk::ElementHandle> hits;
+        m_corridors.query(region, [&](sdk::ElementHandle const handle, sdk::ElementRect const &) { hits.push_back(handle); });
+
+        for (sdk::ElementHandle const handle : hits)
+            markDirty(handle, m_edges.find(handle)->second);
+    }
+
+
+    std::vector<EdgeRouter::Request> EdgeRouter::prepare(sdk::ElementStore const &store) {
+        std::vector<Request>            res;
+        std::vector<sdk::ElementHandle> found;
+
+        for (auto &[handle, edge] : m_edges) {
+            if (!edge.dirty)
+                continue;
+
+            uint32_t const src = store.indexOf(edge.source);
+            uint32_t const dst = store.indexOf(edge.target);
+            if (src == sdk::HandleTable<sdk::ElementHandle>::gl_invalid || dst == sdk::HandleTable<sdk::ElementHandle>::gl_invalid) {
+                edge.points.clear();
+                edge.dirty = false;
+
+                continue;
+            }
+
+            Request req{ handle, m_ticket++, store.bounds()[src], store.bounds()[dst], {}, {} };
+            req.area = internal::Inflate(internal::Unite(req.source, req.target), gl_search);
+
+            /* Other associations are not obstacles; routes may cross them. */
+            found.clear();
+            store.query(req.area, found);
+            for (sdk::ElementHandle const other : found) {
+                uint32_t const dense = store.indexOf(other);
+
+                if (other != edge.source && other != edge.target && store.kinds()[dense] != sdk::ElementKind::Association)
+                    req.obstacles.push_back(store.bounds()[dense]);
+            }
+
+            /* The search area is the corridor: nothing outside of it can affect the route. */
+            m_corridors.insert(handle, req.area);
+            edge.indexed = true;
+            edge.ticket  = req.ticket;
+            edge.dirty   = false;
+            res.push_back(std::move(req));
+        }
+
+        return res;
+    }
+
+    EdgeRouter::Result EdgeRouter::Route(Request const &req) {
+        Result res{ req.edge, req.ticket, {} };
+
+        /* Routes keep their clearance from all boxes, including their own end points. */
+        std::vector<sdk::ElementRect> boxes;
+        boxes.reserve(req.obstacles.size() + 2);
+        for (sdk::ElementRect const &box : req.obstacles)
+            boxes.push_back(internal::Inflate(box, gl_clearance));
+        boxes.push_back(internal::Inflate(req.source, gl_clearance));
+        boxes.push_back(internal::Inflate(req.target, gl_clearance));
+
+        std::array<internal::RoutePort, 4> const from = internal::PortsOf(req.source);
+        std::array<internal::RoutePort, 4> const to   = internal::PortsOf(req.target);
+
+        /*
+         * The route runs along a grid made of the sides of all boxes, the ports and the bounds of
+         * the area. Between adjacent grid lines, a segment is either completely inside a box or
+         * not at all.
+         */
+        std::vector<float> xs = { req.area.x, req.area.x + req.area.w };
+        std::vector<float> ys = { req.area.y, req.area.y + req.area.h };
+        for (sdk::ElementRect const &box : boxes) {
+            xs.insert(xs.end(), { box.x, box.x + box.w });
+            ys.insert(ys.end(), { box.y, box.y + box.h });
+        }
+        for (auto const *ports : { &from, &to })
+            for (internal::RoutePort const &port : *ports) {
+                xs.push_back(port.exit.x);
+                ys.push_back(port.exit.y);
+            }
+        /* Routes stay inside the area; obstacles beyond it are unknown. */
+        auto const prune = [](std::vector<float> &axis, float const lo, float const hi) {
+            axis.erase(std::remove_if(axis.begin(), axis.end(), [&](float const v) { return v < lo || v > hi; }), axis.end());
+            std::sort(axis.begin(), axis.end());
+
+            axis.erase(std::unique(axis.begin(), axis.end()), axis.end());
+        };
+        prune(xs, req.area.x, req.area.x + req.area.w);
+        prune(ys, req.area.y, req.area.y + req.area.h);
+
+        size_t const nx = xs.size();
+        size_t const ny = ys.size();
+
+        /* Blocked nodes, and blocked segments to the right of and below every node. */
+        std::vector<uint8_t> node(nx * ny, 0), right(nx * ny, 0), down(nx * ny, 0);
+        for (sdk::ElementRect const &box : boxes) {
+            float const x0 = box.x, x1 = box.x + box.w;
+            float const y0 = box.y, y1 = box.y + box.h;
+
+            size_t const i0 = static_cast<size_t>(std::lower_bound(xs.begin(), xs.end(), x0) - xs.begin());
+            size_t const i1 = static_cast<size_t>(std::upper_bound(xs.begin(), xs.end(), x1) - xs.begin());
+            size_t const j0 = static_cast<size_t>(std::lower_bound(ys.begin(), ys.end(), y0) - ys.begin());
+            size_t const j1 = static_cast<size_t>(std::upper_bound(ys.begin(), ys.end(), y1) - ys.begin());
+
+            /* Lines along the sides of a box are free; only its interior is blocked. */
+            for (size_t j = j0; j < j1; ++j)
+                for (size_t i = i0; i < i1; ++i) {
+                    bool const insidex = xs[i] > x0 && xs[i] < x1;
+                    bool const insidey = ys[j] > y0 && ys[j] < y1;
+
+                    if (insidex && insidey)
+                        node[j * nx + i] = 1;
+                    if (insidey && i + 1 < i1)
+                        right[j * nx + i] = 1;
+                    if (insidex && j + 1 < j1)
+                        down[j * nx + i] = 1;
+                }
+        }
+
+        auto const indexOf = [&](RoutePoint const &pt) {
+            size_t const i = static_cast<size_t>(std::lower_bound(xs.begin(), xs.end(), pt.x) - xs.begin());
+            size_t const j = static_cast<size_t>(std::lower_bound(ys.begin(), ys.end(), pt.y) - ys.begin());
+
+            return j * nx + i;
+        };
+
+        std::array<uint32_t, 4> goals;
+        for (size_t k = 0; k < to.size(); ++k)
+            goals[k] = static_cast<uint32_t>(indexOf(to[k].exit));
+
+        /* The Manhattan distance to the closest exit point of the target never overestimates. */
+        auto const estimate = [&](size_t const idx) {
+            float res = std::numeric_limits<float>::infinity();
+            for (internal::RoutePort const &port : to)
+                res = std::min(res, std::abs(xs[idx % nx] - port.exit.x) + std::abs(ys[idx / nx] - port.exit.y));
+
+            return res;
+        };
+
+        /* A* over (node, direction); changing the direction costs a bend. */
+        size_t const          nstates = nx * ny * 2;
+        float const           inf     = std::numeric_limits<float>::infinity();
+        std::vector<float>    dist(nstates, inf);
+        std::vector<uint32_t> prev(nstates, UINT32_MAX);
+
+        using Item = std::pair<float, uint32_t>;
+        std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+        for (internal::RoutePort const &port : from) {
+            uint32_t const state = static_cast<uint32_t>(indexOf(port.exit) * 2 + (port.horizontal ? 0 : 1));
+            if (node[state / 2] != 0)
+                continue;
+
+            /* The stub from the side to the exit point is part of the route. */
+            dist[state] = gl_clearance;
+            queue.push({ gl_clearance + estimate(state / 2), state });
+        }
+
+        float    best      = inf;
+        uint32_t beststate = UINT32_MAX;
+        size_t   bestport  = 0;
+        while (!queue.empty()) {
+            auto const [bound, state] = queue.top();
+            queue.pop();
+            if (bound >= best)
+                break;
+
+            size_t const idx  = state / 2;
+            float const  cost = dist[state];
+            if (bound > cost + estimate(idx))
+                continue;
+
+            bool const   hor = state % 2 == 0;
+            for (size_t k = 0; k < goals.size(); ++k)
+                if (goals[k] == idx) {
+                    float const total = cost + gl_clearance + (hor == to[k].horizontal ? 0.0f : gl_bendcost);
+
+                    if (total < best) {
+                        best      = total;
+                        beststate = state;
+                        bestport  = k;
+                    }
+                }
+
+            size_t const i = idx % nx;
+            size_t const j = idx / nx;
+            auto const relax = [&](bool const ok, size_t const next, bool const nhor, float const len) {
+                if (!ok || node[next] != 0)
+                    return;
+
+                uint32_t const nstate = static_cast<uint32_t>(next * 2 + (nhor ? 0 : 1));
+                float const    ncost  = cost + len + (nhor == hor ? 0.0f : gl_bendcost);
+                if (ncost < dist[nstate]) {
+                    dist[nstate] = ncost;
+                    prev[nstate] = state;
+                    queue.push({ ncost + estimate(next), nstate });
+                }
+            };
+            relax(i + 1 < nx && right[idx] == 0, idx + 1, true, i + 1 < nx ? xs[i + 1] - xs[i] : 0.0f);
+            relax(i > 0 && right[idx - 1] == 0, idx - 1, true, i > 0 ? xs[i] - xs[i - 1] : 0.0f);
+            relax(j + 1 < ny && down[idx] == 0, idx + nx, false, j + 1 < ny ? ys[j + 1] - ys[j] : 0.0f);
+            relax(j > 0 && down[idx - nx] == 0, idx - nx, false, j > 0 ? ys[j] - ys[j - 1] : 0.0f);
+        }
+
+        if (beststate == UINT32_MAX) {
+            res.points = internal::FallbackRoute(req.source, req.target);
+
+            return res;
+        }
+
+        /* Walk back from the goal; the first state is one of the source's exit points. */
+        std::vector<RoutePoint> points = { to[bestport].attach };
+        for (uint32_t state = beststate; state != UINT32_MAX; state = prev[state])
+            points.push_back({ xs[(state / 2) % nx], ys[(state / 2) / nx] });
+
+        RoutePoint const start = points.back();
+        for (internal::RoutePort const &port : from)
+            if (port.exit.x == start.x && port.exit.y == start.y) {
+                points.push_back(port.attach);
+
+                break;
+            }
+
+        std::reverse(points.begin(), points.end());
+        res.points = internal::Simplify(points);
+        return res;
+    }
+
+    bool EdgeRouter::apply(Result res) {
+        auto const it = m_edges.find(res.edge);
+        if (it == m_edges.end() || it->second.dirty || it->second.ticket != res.ticket)
+            return false;
+
+        it->second.points = std::move(res.points);
+        it->second.routed = res.ticket;
+        return true;
+    }
+
+
+    size_t EdgeRouter::routeAll(sdk::ElementStore const &store) {
+        size_t n = 0;
+
+        for (Request const &req : prepare(store))
+            n += apply(Route(req)) ? 1 : 0;
+        return n;
+    }
+
+    sdk::TaskHandle EdgeRouter::routeAsync(sdk::ElementStore const &store, std::function<void(std::vector<Result>)> deliver) {
+        std::vector<Request> reqs = prepare(store);
+        if (reqs.empty())
+            return {};
+
+        std::vector<sdk::ElementHandle> edges;
+        edges.reserve(reqs.size());
+        for (Request const &req : reqs)
+            edges.push_back(req.edge);
+
+        sdk::TaskHandle task = sdk::SubmitTask([reqs = std::move(reqs), deliver = std::move(deliver)]() {
+            std::vector<Result> res;
+            res.reserve(reqs.size());
+
+            for (Request const &req : reqs) {
+                if (sdk::IsTaskCancelled())
+                    return;
+
+                res.push_back(Route(req));
+            }
+            deliver(std::move(res));
+        }, sdk::TaskPriority::High);
+
+        /* Edges that could not be submitted are requested again with the next batch. */
+        if (!task.isValid())
+            for (sdk::ElementHandle const handle : edges)
+                markDirty(handle, m_edges.find(handle)->second);
+        return task;
+    }
+
+
+    bool EdgeRouter::route(sdk::ElementStore const &store, sdk::ElementHandle edge, std::vector<RoutePoint> &res) const {
+        res.clear();
+
+        auto const it = m_edges.find(edge);
+        if (it == m_edges.end())
+            return false;
+
+        Edge const &state = it->second;
+        if (!state.dirty && state.routed == state.ticket && !state.points.empty()) {
+            res = state.points;
+
+            return true;
+        }
+
+        /* Until the route lands, a straight line between the end points is shown. */
+        uint32_t const src = store.indexOf(state.source);
+        uint32_t const dst = store.indexOf(state.target);
+        if (src != sdk::HandleTable<sdk::ElementHandle>::gl_invalid && dst != sdk::HandleTable<sdk::ElementHandle>::gl_invalid) {
+            sdk::ElementRect const &a = store.bounds()[src];
+            sdk::ElementRect const &b = store.bounds()[dst];
+
+            res = { { a.x + a.w * 0.5f, a.y + a.h * 0.5f }, { b.x + b.w * 0.5f, b.y + b.h * 0.5f } };
+        }
+
+        return false;
+    }
+
+    bool EdgeRouter::isDirty() const noexcept {
+        for (auto const &[handle, edge] : m_edges)
+            if (edge.dirty || edge.routed != edge.ticket)
+                return true;
+
+        return false;
+    }
+
+
+    void EdgeRouter::markDirty(sdk::ElementHandle handle, Edge &edge) noexcept {
+        if (edge.indexed)
+            m_corridors.remove(handle);
+
+        edge.indexed = false;
+        edge.dirty   = true;
+    }
+}
+
+
@@ -0,0 +1,496 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  scripting.cpp
+ * \brief implementation of the scripting interface to a diagram
+ */
+
+
+/* stdlib includes */
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <utility>
+
+/* external includes */
+#include <QJSEngine>
+#include <QJSValue>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+
+/* app includes */
+#include <scripting.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \brief  converts a flag name of scripts to the flag
+         *
+         * \param  [in] name *"hidden"*, *"selected"* or *"locked"*, as in queries
+         *
+         * \return flag, or 0 if the name is unknown
+         */
+        static uint32_t FlagOf(QString const &name) noexcept {
+            if (name == QLatin1String("hidden"))
+                return sdk::ElementHidden;
+            else if (name == QLatin1String("selected"))
+                return sdk::ElementSelected;
+            else if (name == QLatin1String("locked"))
+                return sdk::ElementLocked;
+
+            return 0;
+        }
+    }
+
+
+    ScriptModel::ScriptModel(sdk::ElementStore &store, UndoStack &undo, QObject *parent) noexcept
+        : QObject(parent), m_store(store), m_undo(undo), m_indexed(UINT64_MAX), m_depth(0), m_edited(false)
+    { }
+
+    ScriptModel::~ScriptModel() {
+        /* A script that left a transaction open still forms one operation. */
+        while (m_depth > 0)
+            commit();
+    }
+
+
+    sdk::ErrorCode ScriptModel::run(QString const &source, QString *result) noexcept {
+        try {
+            QJSEngine engine;
+            QJSEngine::setObjectOwnership(this, QJSEngine::CppOwnership);
+            engine.globalObject().setProperty(QStringLiteral("model"), engine.newQObject(this));
+
+            begin();
+            QJSValue const value = engine.evaluate(source);
+            if (value.isError()) {
+                SZSDK_APP_WARNING("Script failed: {}", value.toString().toStdString());
+
+                rollback();
+                m_selections.clear();
+                m_free.clear();
+                if (result != nullptr)
+                    *result = value.toString();
+                return sdk::ErrorCode::InvalidParameter;
+            }
+
+            while (m_depth > 0)
+                commit();
+            m_selections.clear();
+            m_free.clear();
+            if (result != nullptr)
+                *result = value.isUndefined() ? QString() : value.toString();
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        rollback();
+        m_selections.clear();
+        m_free.clear();
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+
+    int ScriptModel::query(QString const &text) noexcept {
+        try {
+            sdk::ModelQuery query;
+            std::string     msg;
+            if (query.parse(text.toStdString(), &msg) != sdk::ErrorCode::Ok) {
+                fail(QString::fromStdString(msg));
+
+                return -1;
+            }
+
+            /* The indexes are built once for all queries between two edits. */
+            if (m_indexed != m_store.revision()) {
+                m_indexed = UINT64_MAX;
+                if (m_index.build(m_store) != sdk::ErrorCode::Ok) {
+                    fail(QStringLiteral("out of memory"));
+
+                    return -1;
+                }
+
+                m_indexed = m_store.revision();
+            }
+
+            std::vector<sdk::ElementHandle> res;
+            if (m_index.run(query, res) != sdk::ErrorCode::Ok) {
+                fail(QStringLiteral("out of memory"));
+
+                return -1;
+            }
+
+            return add(std::move(res));
+        } catch (...) { }
+
+        fail(QStringLiteral("out of memory"));
+        return -1;
+    }
+
+    int ScriptModel::all() noexcept {
+        try {
+            std::vector<sdk::ElementHandle> res(m_store.size());
+            for (uint32_t i = 0; i < m_store.size(); ++i)
+                res[i] = m_store.handleAt(i);
+
+            return add(std::move(res));
+        } catch (...) { }
+
+        fail(QStringLiteral("out of memory"));
+        return -1;
+    }
+
+    int ScriptModel::within(double x, double y, double w, double h) noexcept {
+        try {
+            std::vector<sdk::ElementHandle> res;
+            m_store.query({ static_cast<float>(x), static_cast<float>(y), static_cast<float>(w), static_cast<float>(h) }, res);
+
+            return add(std::move(res));
+        } catch (...) { }
+
+        fail(QStringLiteral("out of memory"));
+        return -1;
+    }
+
+    int ScriptModel::children(int selection) noexcept {
+        std::vector<sdk::ElementHandle> const *const owners = find(selection);
+        if (owners == nullptr)
+            return -1;
+
+        try {
+            std::unordered_set<uint64_t> set;
+            for (sdk::ElementHandle const owner : *owners)
+                set.insert(owner.value());
+
+            /* One pass over all elements, however large the selection is. */
+            std::vector<sdk::ElementHandle> res;
+            sdk::ElementHandle const *const parents = m_store.parents();
+            for (uint32_t i = 0; i < m_store.size(); ++i)
+                if (!parents[i].isNull() && set.count(parents[i].value()) != 0)
+                    res.push_back(m_store.handleAt(i));
+
+            return add(std::move(res));
+        } catch (...) { }
+
+        fail(QStringLiteral("out of memory"));
+        return -1;
+    }
+
+    int ScriptModel::count(int selection) const noexcept {
+        std::vector<sdk::ElementHandle> const *const handles = find(selection);
+
+        return handles == nullptr ? -1 : static_cast<int>(handles->size());
+    }
+
+    void ScriptModel::release(int selection) noexcept {
+        if (selection < 0 || static_cast<size_t>(selection) >= m_selections.size() || m_selections[static_cast<size_t>(selection)] == nullptr)
+            return;
+
+        try {
+            m_free.push_back(selection);
+            m_selections[static_cast<size_t>(selection)].reset();
+        } catch (...) { }
+    }
+
+
+    QStringList ScriptModel::names(int selection) const noexcept {
+        QStringList res;
+
+        try {
+            if (std::vector<sdk::ElementHandle> const *const handles = find(selection)) {
+                res.reserve(static_cast<qsizetype>(handles->size()));
+
+                for (sdk::ElementHandle const handle : *handles) {
+                    uint32_t const dense = m_store.indexOf(handle);
+
+                    if (dense == sdk::HandleTable<sdk::ElementHandle>::gl_invalid)
+                        res.push_back(QString());
+                    else {
+                        std::string_view const name = m_store.names()[dense].view();
+
+                        res.push_back(QString::fromUtf8(name.data(), static_cast<qsizetype>(name.size())));
+                    }
+                }
+            }
+        } catch (...) {
+            res.clear();
+        }
+
+        return res;
+    }
+
+    QStringList ScriptModel::kinds(int selection) const noexcept {
+        QStringList res;
+
+        try {
+            if (std::vector<sdk::ElementHandle> const *const handles = find(selection)) {
+                res.reserve(static_cast<qsizetype>(handles->size()));
+
+                for (sdk::ElementHandle const handle : *handles) {
+                    uint32_t const dense = m_store.indexOf(handle);
+
+                    if (dense == sdk::HandleTable<sdk::ElementHandle>::gl_invalid)
+                        res.push_back(QString());
+                    else {
+                        std::string_view const kind = sdk::ModelQuery::KindName(m_store.kinds()[dense]);
+
+                        res.push_back(QString::fromLatin1(kind.data(), static_cast<qsizetype>(kind.size())));
+                    }
+                }
+            }
+        } catch (...) {
+            res.clear();
+        }
+
+        return res;
+    }
+
+    QVariantList ScriptModel::styles(int selection) const noexcept {
+        QVariantList res;
+
+        try {
+            if (std::vector<sdk::ElementHandle> const *const handles = find(selection)) {
+                res.reserve(static_cast<qsizetype>(handles->size()));
+
+                for (sdk::ElementHandle const handle : *handles) {
+                    uint32_t const dense = m_store.indexOf(handle);
+
+                    res.push_back(dense == sdk::HandleTable<sdk::ElementHandle>::gl_invalid ? QVariant() : QVariant(static_cast<int>(m_store.styles()[dense])));
+                }
+            }
+        } catch (...) {
+            res.clear();
+        }
+
+        return res;
+    }
+
+    QVariantList ScriptModel::bounds(int selection) const noexcept {
+        QVariantList res;
+
+        try {
+            if (std::vector<sdk::ElementHandle> const *const handles = find(selection)) {
+                res.reserve(static_cast<qsizetype>(handles->size() * 4));
+
+                for (sdk::ElementHandle const handle : *handles) {
+                    uint32_t const dense = m_store.indexOf(handle);
+                    if (dense == sdk::HandleTable<sdk::ElementHandle>::gl_invalid) {
+                        for (int i = 0; i < 4; ++i)
+                            res.push_back(QVariant());
+
+                        continue;
+                    }
+
+                    sdk::ElementRect const &rect = m_store.bounds()[dense];
+                    res.push_back(static_cast<double>(rect.x));
+                    res.push_back(static_cast<double>(rect.y));
+                    res.push_back(static_cast<double>(rect.w));
+                    res.push_back(static_cast<double>(rect.h));
+                }
+            }
+        } catch (...) {
+            res.clear();
+        }
+
+        return res;
+    }
+
+
+    bool ScriptModel::setNames(int selection, QStringList const &names) noexcept {
+        return edit(selection, static_cast<size_t>(names.size()), [&](sdk::ElementHandle const handle, size_t const i) {
+            return m_undo.setName(handle, sdk::StringId(names[static_cast<qsizetype>(i)].toStdString()));
+        });
+    }
+
+    bool ScriptModel::setStyle(int selection, int style) noexcept {
+        if (style < 0)
+            return fail(QStringLiteral("invalid style %1").arg(style));
+
+        return edit(selection, SIZE_MAX, [&](sdk::ElementHandle const handle, size_t) {
+            return m_undo.setStyle(handle, static_cast<uint32_t>(style));
+        });
+    }
+
+    bool ScriptModel::setStyles(int selection, QVariantList const &styles) noexcept {
+        for (QVariant const &style : styles)
+            if (!style.canConvert<int>() || style.toInt() < 0)
+                return fail(QStringLiteral("invalid style %1").arg(style.toString()));
+
+        return edit(selection, static_cast<size_t>(styles.size()), [&](sdk::ElementHandle const handle, size_t const i) {
+            return m_undo.setStyle(handle, static_cast<uint32_t>(styles[static_cast<qsizetype>(i)].toInt()));
+        });
+    }
+
+    bool ScriptModel::setBounds(int selection, QVariantList const &bounds) noexcept {
+        if (bounds.size() % 4 != 0)
+            return fail(QStringLiteral("bounds need four values per element"));
+
+        return edit(selection, static_cast<size_t>(bounds.size() / 4), [&](sdk::ElementHandle const handle, size_t const i) {
+            qsizetype const at = static_cast<qsizetype>(i * 4);
+            float const     w  = bounds[at + 2].toFloat();
+            float const     h  = bounds[at + 3].toFloat();
+            if (!(w >= 0.0f) || !(h >= 0.0f))
+                return sdk::ErrorCode::InvalidParameter;
+
+            return m_undo.setBounds(handle, { bounds[at].toFloat(), bounds[at + 1].toFloat(), w, h });
+        });
+    }
+
+    bool ScriptModel::setFlag(int selection, QString const &flag, bool set) noexcept {
+        uint32_t const bit = internal::FlagOf(flag);
+        if (bit == 0)
+            return fail(QStringLiteral("unknown flag \"%1\"").arg(flag));
+
+        return edit(selection, SIZE_MAX, [&](sdk::ElementHandle const handle, size_t) {
+            uint32_t const flags = m_store.flags()[m_store.indexOf(handle)];
+            uint32_t const after = set ? flags | bit : flags & ~bit;
+
+            return after == flags ? sdk::ErrorCode::Ok : m_undo.setFlags(handle, after);
+        });
+    }
+
+    bool ScriptModel::translate(int selection, double dx, double dy) noexcept {
+        std::vector<sdk::ElementHandle> const *const handles = find(selection);
+        if (handles == nullptr)
+            return false;
+
+        try {
+            /* The undo stack moves all elements in one pass, but only live ones. */
+            std::vector<sdk::ElementHandle> live;
+            live.reserve(handles->size());
+            for (sdk::ElementHandle const handle : *handles)
+                if (m_store.isValid(handle))
+                    live.push_back(handle);
+            if (live.empty())
+                return true;
+
+            if (m_undo.translate(live, static_cast<float>(dx), static_cast<float>(dy)) != sdk::ErrorCode::Ok)
+                return fail(QStringLiteral("could not move the elements"));
+
+            m_edited = true;
+            return true;
+        } catch (...) { }
+
+        return fail(QStringLiteral("out of memory"));
+    }
+
+    bool ScriptModel::destroy(int selection) noexcept {
+        /* Owners destroy what they own, so elements may be gone by the time they are reached. */
+        return edit(selection, SIZE_MAX, [&](sdk::ElementHandle const handle, size_t) {
+            return m_store.isValid(handle) ? m_undo.destroy(handle) : sdk::ErrorCode::Ok;
+        });
+    }
+
+
+    void ScriptModel::begin() noexcept {
+        if (m_depth++ == 0)
+            m_edited = false;
+
+        m_undo.beginGroup();
+    }
+
+    bool ScriptModel::commit() noexcept {
+        if (m_depth == 0)
+            return fail(QStringLiteral("no transaction to commit"));
+
+        --m_depth;
+        m_undo.endGroup();
+        return true;
+    }
+
+    bool ScriptModel::rollback() noexcept {
+        if (m_depth == 0)
+            return fail(QStringLiteral("no transaction to roll back"));
+
+        while (m_depth > 0) {
+            --m_depth;
+            m_undo.endGroup();
+        }
+
+        /* Without edits, the group formed no entry; undoing would revert an older operation. */
+        if (!m_edited)
+            return true;
+
+        m_edited = false;
+        return m_undo.abort() == sdk::ErrorCode::Ok || fail(QStringLiteral("could not revert the transaction"));
+    }
+
+
+    int ScriptModel::add(std::vector<sdk::ElementHandle> handles) noexcept {
+        try {
+            auto selection = std::make_unique<std::vector<sdk::ElementHandle>>(std::move(handles));
+
+            /* Released ids are reused, so long scripts do not run out of them. */
+            if (!m_free.empty()) {
+                int const id = m_free.back();
+
+                m_free.pop_back();
+                m_selections[static_cast<size_t>(id)] = std::move(selection);
+                return id;
+            }
+            if (m_selections.size() >= gl_maxselections) {
+                fail(QStringLiteral("too many selections; release some"));
+
+                return -1;
+            }
+
+            m_selections.push_back(std::move(selection));
+            return static_cast<int>(m_selections.size() - 1);
+        } catch (...) { }
+
+        fail(QStringLiteral("out of memory"));
+        return -1;
+    }
+
+    std::vector<sdk::ElementHandle> const *ScriptModel::find(int selection) const noexcept {
+        if (selection < 0 || static_cast<size_t>(selection) >= m_selections.size() || m_selections[static_cast<size_t>(selection)] == nullptr) {
+            fail(QStringLiteral("unknown selection %1").arg(selection));
+
+            return nullptr;
+        }
+
+        return m_selections[static_cast<size_t>(selection)].get();
+    }
+
+    template<class Fn> bool ScriptModel::edit(int selection, size_t values, Fn &&fn) noexcept {
+        std::vector<sdk::ElementHandle> const *const handles = find(selection);
+        if (handles == nullptr)
+            return false;
+        if (values != SIZE_MAX && values != handles->size())
+            return fail(QStringLiteral("%1 value(s) given for %2 element(s)").arg(values).arg(handles->size()));
+
+        /* All edits of one call are one operation, and one transaction for the views. */
+        begin();
+        bool ok = true;
+        try {
+            for (size_t i = 0; i < handles->size() && ok; ++i) {
+                if (!m_store.isValid((*handles)[i]))
+                    continue;
+
+                bool const done = fn((*handles)[i], i) == sdk::ErrorCode::Ok;
+                m_edited = m_edited || done;
+                ok       = done;
+            }
+        } catch (...) {
+            ok = false;
+        }
+        commit();
+
+        return ok || fail(QStringLiteral("could not edit the elements"));
+    }
+
+    bool ScriptModel::fail(QString text) const noexcept {
+        m_error = std::move(text);
+
+        return false;
+    }
+}
+
+
@@ -0,0 +1,598 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  search.cpp
+ * \brief implementation of the project-wide search index
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+
+/* app includes */
+#include <search.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        static constexpr size_t gl_minpurge = 4096; /**< retired entries that are always tolerated */
+
+        /**
+         * \enum  suzu::internal::SearchOpKind
+         * \brief kind of an update of the search index
+         */
+        enum class SearchOpKind : uint32_t {
+            Set,    /**< (re-)indexes the name of an element */
+            Remove, /**< drops an element */
+            Reset   /**< drops all elements of a diagram */
+        };
+
+        /**
+         * \struct suzu::internal::SearchOp
+         * \brief  update of the search index
+         */
+        struct SearchOp {
+            SearchOpKind       kind;    /**< kind of update */
+            uint32_t           diagram; /**< index of the diagram */
+            sdk::ElementHandle element; /**< element; unused by *SearchOpKind::Reset* */
+            sdk::StringId      name;    /**< name of the element; only used by *SearchOpKind::Set* */
+        };
+
+        /**
+         * \struct suzu::internal::SearchEntry
+         * \brief  indexed name of an element
+         */
+        struct SearchEntry {
+            sdk::ElementHandle element; /**< element */
+            sdk::StringId      name;    /**< name of the element */
+            uint32_t           diagram; /**< index of the diagram */
+        };
+
+        /**
+         * \struct suzu::internal::SearchTable
+         * \brief  contents of a search index
+         */
+        struct SearchTable {
+            std::vector<SearchEntry>                            m_entries;  /**< all entries, by entry id; retired ones have an empty name */
+            std::vector<std::unordered_map<uint64_t, uint32_t>> m_ids;      /**< entry ids of the live entries, by handle value, by diagram */
+            std::unordered_map<uint32_t, std::vector<uint32_t>> m_postings; /**< ascending entry ids, by trigram */
+            size_t                                              m_retired;  /**< number of retired entries */
+
+            SearchTable() noexcept
+                : m_retired(0)
+            { }
+        };
+
+        /**
+         * \struct suzu::internal::SearchState
+         * \brief  search index, shared by a *suzu::SearchIndex* and its build task
+         */
+        struct SearchState {
+            mutable std::shared_mutex m_lock;     /**< guards all other members */
+            SearchTable               m_table;    /**< index */
+            std::vector<SearchOp>     m_pending;  /**< updates that arrived during the build */
+            bool                      m_building; /**< whether or not the index is being built */
+
+            SearchState() noexcept
+                : m_building(false)
+            { }
+        };
+
+
+        static char FoldCase(char const c) noexcept {
+            return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+        static uint32_t Trigram(char const *const pos) noexcept {
+            return static_cast<uint32_t>(static_cast<unsigned char>(FoldCase(pos[0]))) << 16
+                | static_cast<uint32_t>(static_cast<unsigned char>(FoldCase(pos[1]))) << 8
+                | static_cast<uint32_t>(static_cast<unsigned char>(FoldCase(pos[2])))
+            ;
+        }
+
+        /**
+         * \brief  checks whether a name contains a string, ignoring ASCII case
+         *
+         * \param  [in] name name to search
+         * \param  [in] folded string to find, in lower case
+         *
+         * \return *true* if *folded* occurs in *name*
+         */
+        static bool ContainsFolded(std::string_view const name, std::string_view const folded) noexcept {
+            if (folded.size() > name.size())
+                return false;
+
+            for (size_t i = 0, last = name.size() - folded.size(); i <= last; ++i) {
+                size_t j = 0;
+                while (j < folded.size() && FoldCase(name[i + j]) == folded[j])
+                    ++j;
+                if (j == folded.size())
+                    return true;
+            }
+
+            return false;
+        }
+
+        /**
+         * \brief retires the entry of an element, if any
+         *
+         * \param [in,out] table index
+         * \param [in] diagram index of the diagram
+         * \param [in] element element to drop
+         */
+        static void RetireEntry(SearchTable &table, uint32_t const diagram, sdk::ElementHandle const element) noexcept {
+            if (diagram >= table.m_ids.size())
+                return;
+
+            auto const it = table.m_ids[diagram].find(element.value());
+            if (it == table.m_ids[diagram].end())
+                return;
+
+            table.m_entries[it->second].name = {};
+            table.m_ids[diagram].erase(it);
+            ++table.m_retired;
+        }
+
+        /**
+         * \brief indexes the name of an element, replacing its previous entry
+         *
+         * \param [in,out] table index
+         * \param [in] diagram index of the diagram
+         * \param [in] element element to index
+         * \param [in] name name of the element; unnamed elements are not indexed
+         * \param [in,out] trigrams scratch buffer
+         * \throw std::bad_alloc
+         */
+        static void SetEntry(SearchTable &table, uint32_t const diagram, sdk::ElementHandle const element, sdk::StringId const name, std::vector<uint32_t> &trigrams) {
+            RetireEntry(table, diagram, element);
+            if (name.empty())
+                return;
+
+            std::string_view const str = name.view();
+            trigrams.clear();
+            for (size_t i = 0; i + 3 <= str.size(); ++i)
+                trigrams.push_back(Trigram(str.data() + i));
+            std::sort(trigrams.begin(), trigrams.end());
+            trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+            /* New entries get the largest id so far, so appending keeps every list sorted. */
+            uint32_t const id = static_cast<uint32_t>(table.m_entries.size());
+            if (diagram >= table.m_ids.size())
+                table.m_ids.resize(static_cast<size_t>(diagram) + 1);
+            table.m_entries.push_back({ element, name, diagram });
+            table.m_ids[diagram][element.value()] = id;
+            for (uint32_t const trigram : trigrams)
+                table.m_postings[trigram].push_back(id);
+        }
+
+        /**
+         * \brief rebuilds an index from its live entries, dropping the retired ones
+         *
+         * \param [in,out] table index
+         * \throw std::bad_alloc
+         */
+        static void Purge(SearchTable &table) {
+            SearchTable           res;
+            std::vector<uint32_t> trigrams;
+
+            res.m_entries.reserve(table.m_entries.size() - table.m_retired);
+            for (SearchEntry const &entry : table.m_entries)
+                if (!entry.name.empty())
+                    SetEntry(res, entry.diagram, entry.element, entry.name, trigrams);
+
+            std::swap(table, res);
+        }
+
+        /**
+         * \brief applies updates to an index
+         *
+         * \param [in,out] table index
+         * \param [in] ops updates, in order
+         * \throw std::bad_alloc
+         */
+        static void ApplyOps(SearchTable &table, std::vector<SearchOp> const &ops) {
+            std::vector<uint32_t> trigrams;
+
+            for (SearchOp const &op : ops) {
+                switch (op.kind) {
+                    case SearchOpKind::Set:
+                        SetEntry(table, op.diagram, op.element, op.name, trigrams);
+                        break;
+                    case SearchOpKind::Remove:
+                        RetireEntry(table, op.diagram, op.element);
+                        break;
+                    case SearchOpKind::Reset:
+                        if (op.diagram < table.m_ids.size()) {
+                            for (auto const &[element, id] : table.m_ids[op.diagram])
+                                table.m_entries[id].name = {};
+
+                            table.m_retired += table.m_ids[op.diagram].size();
+                            table.m_ids[op.diagram].clear();
+                        }
+                        break;
+                }
+            }
+
+            if (table.m_retired > gl_minpurge && table.m_retired * 2 > table.m_entries.size())
+                Purge(table);
+        }
+
+        /**
+         * \brief collects the names of all elements of a diagram
+         *
+         * \param [in] diagram diagram to index
+         * \param [in,out] ops receives an update per named element
+         * \throw std::bad_alloc
+         */
+        static void CollectNames(SearchIndex::Diagram const &diagram, std::vector<SearchOp> &ops) {
+            sdk::StringId const *const names = diagram.store->names();
+
+            for (uint32_t i = 0, n = diagram.store->size(); i < n; ++i)
+                if (!names[i].empty())
+                    ops.push_back({ SearchOpKind::Set, diagram.index, diagram.store->handleAt(i), names[i] });
+        }
+
+        /**
+         * \brief  maps diagram indices onto their stores
+         *
+         * \param  [in] diagrams diagrams of the project
+         *
+         * \return store of every diagram, by index; *nullptr* for missing ones
+         * \throw  std::bad_alloc
+         */
+        static std::vector<sdk::ElementStore const *> StoresOf(std::vector<SearchIndex::Diagram> const &diagrams) {
+            std::vector<sdk::ElementStore const *> res;
+
+            for (SearchIndex::Diagram const &diagram : diagrams) {
+                if (diagram.index >= res.size())
+                    res.resize(static_cast<size_t>(diagram.index) + 1, nullptr);
+
+                res[diagram.index] = diagram.store;
+            }
+
+            return res;
+        }
+
+        static uint32_t GetWord(std::string_view const data, size_t const index) noexcept {
+            uint32_t value;
+            std::memcpy(&value, data.data() + index * sizeof(value), sizeof(value));
+
+            return value;
+        }
+    }
+
+
+    SearchIndex::SearchIndex() noexcept
+        : m_state(nullptr)
+    { }
+
+    SearchIndex::~SearchIndex() {
+        clear();
+    }
+
+
+    sdk::ErrorCode SearchIndex::build(std::vector<Diagram> const &diagrams) noexcept {
+        try {
+            /* Only the names are read on the GUI thread; the store must not be touched by the task. */
+            auto ops = std::make_shared<std::vector<internal::SearchOp>>();
+            for (Diagram const &diagram : diagrams)
+                internal::CollectNames(diagram, *ops);
+
+            /* A build that is still running finishes on the old state and is discarded with it. */
+            auto state        = std::make_shared<internal::SearchState>();
+            state->m_building = true;
+
+            m_build = sdk::SubmitTask([state, ops]() {
+                internal::SearchTable table;
+                bool                  ok = true;
+
+                try {
+                    internal::ApplyOps(table, *ops);
+                } catch (...) {
+                    ok = false;
+                }
+
+                std::unique_lock<std::shared_mutex> lock(state->m_lock);
+                try {
+                    if (ok) {
+                        std::swap(state->m_table, table);
+
+                        internal::ApplyOps(state->m_table, state->m_pending);
+                    }
+                } catch (...) {
+                    ok = false;
+                }
+                if (!ok) {
+                    state->m_table = {};
+
+                    SZSDK_APP_WARNING("Could not build the search index of {} elements; search finds nothing.", ops->size());
+                }
+
+                state->m_pending.clear();
+                state->m_pending.shrink_to_fit();
+                state->m_building = false;
+            }, sdk::TaskPriority::Low);
+            if (!m_build.isValid())
+                return sdk::ErrorCode::CriticalResource;
+
+            std::atomic_store_explicit(&m_state, std::move(state), std::memory_order_release);
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    sdk::ErrorCode SearchIndex::serialize(std::vector<Diagram> const &diagrams, std::vector<char> &out) const noexcept {
+        out.clear();
+        if (m_state == nullptr)
+            return sdk::ErrorCode::InvalidState;
+
+        try {
+            std::vector<sdk::ElementStore const *> const stores = internal::StoresOf(diagrams);
+
+            std::shared_lock<std::shared_mutex> lock(m_state->m_lock);
+            if (m_state->m_building)
+                return sdk::ErrorCode::InvalidState;
+            internal::SearchTable const &table = m_state->m_table;
+
+            /* Live entries keep their order, so renumbering them keeps every list sorted. */
+            std::vector<uint32_t> ids(table.m_entries.size(), UINT32_MAX);
+            std::vector<uint32_t> entries;
+            entries.reserve(2 * (table.m_entries.size() - table.m_retired));
+            for (uint32_t id = 0; id < table.m_entries.size(); ++id) {
+                internal::SearchEntry const &entry = table.m_entries[id];
+                if (entry.name.empty())
+                    continue;
+
+                sdk::ElementStore const *const store = entry.diagram < stores.size() ? stores[entry.diagram] : nullptr;
+                uint32_t const                 dense = store != nullptr ? store->indexOf(entry.element) : UINT32_MAX;
+                if (store == nullptr || dense >= store->size() || store->names()[dense] != entry.name)
+                    return sdk::ErrorCode::InvalidState;
+
+                ids[id] = static_cast<uint32_t>(entries.size() / 2);
+                entries.push_back(entry.diagram);
+                entries.push_back(dense);
+            }
+
+            std::vector<uint32_t> trigrams;
+            trigrams.reserve(table.m_postings.size());
+            for (auto const &[trigram, list] : table.m_postings)
+                trigrams.push_back(trigram);
+            std::sort(trigrams.begin(), trigrams.end());
+
+            /* Trigrams only retired entries had are dropped. */
+            std::vector<uint32_t> kept;
+            std::vector<uint32_t> offsets = { 0 };
+            std::vector<uint32_t> postings;
+            for (uint32_t const trigram : trigrams) {
+                for (uint32_t const id : table.m_postings.find(trigram)->second)
+                    if (ids[id] != UINT32_MAX)
+                        postings.push_back(ids[id]);
+
+                if (postings.size() != offsets.back()) {
+                    kept.push_back(trigram);
+                    offsets.push_back(static_cast<uint32_t>(postings.size()));
+                }
+            }
+
+            std::vector<uint32_t> counts = { static_cast<uint32_t>(entries.size() / 2), static_cast<uint32_t>(kept.size()) };
+            out.reserve(sizeof(uint32_t) * (counts.size() + entries.size() + kept.size() + offsets.size() + postings.size()));
+            for (std::vector<uint32_t> const *const words : { &counts, &entries, &kept, &offsets, &postings })
+                out.insert(out.end(), reinterpret_cast<char const *>(words->data()), reinterpret_cast<char const *>(words->data() + words->size()));
+
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        out.clear();
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    sdk::ErrorCode SearchIndex::restore(std::vector<Diagram> const &diagrams, std::string_view const data) noexcept {
+        clear();
+
+        try {
+            std::vector<sdk::ElementStore const *> const stores = internal::StoresOf(diagrams);
+
+            size_t const nwords = data.size() / sizeof(uint32_t);
+            if (data.size() % sizeof(uint32_t) != 0 || nwords < 2)
+                return sdk::ErrorCode::ReadFile;
+
+            uint32_t const n        = internal::GetWord(data, 0);
+            uint32_t const t        = internal::GetWord(data, 1);
+            size_t const   entries  = 2;
+            size_t const   trigrams = entries + 2 * static_cast<size_t>(n);
+            size_t const   offsets  = trigrams + t;
+            size_t const   ids      = offsets + t + 1;
+            if (ids > nwords || ids + internal::GetWord(data, offsets + t) != nwords)
+                return sdk::ErrorCode::ReadFile;
+
+            auto                   state = std::make_shared<internal::SearchState>();
+            internal::SearchTable &table = state->m_table;
+
+            table.m_entries.reserve(n);
+            for (uint32_t id = 0; id < n; ++id) {
+                uint32_t const diagram = internal::GetWord(data, entries + 2 * static_cast<size_t>(id));
+                uint32_t const dense   = internal::GetWord(data, entries + 2 * static_cast<size_t>(id) + 1);
+
+                sdk::ElementStore const *const store = diagram < stores.size() ? stores[diagram] : nullptr;
+                if (store == nullptr || dense >= store->size() || store->names()[dense].empty())
+                    return sdk::ErrorCode::ReadFile;
+
+                sdk::ElementHandle const element = store->handleAt(dense);
+                if (diagram >= table.m_ids.size())
+                    table.m_ids.resize(static_cast<size_t>(diagram) + 1);
+                table.m_entries.push_back({ element, store->names()[dense], diagram });
+                table.m_ids[diagram][element.value()] = id;
+            }
+
+            table.m_postings.reserve(t);
+            for (uint32_t i = 0; i < t; ++i) {
+                uint32_t const trigram = internal::GetWord(data, trigrams + i);
+                uint32_t const begin   = internal::GetWord(data, offsets + i);
+                uint32_t const end     = internal::GetWord(data, offsets + i + 1);
+                if (begin >= end || ids + end > nwords || (i != 0 && trigram <= internal::GetWord(data, trigrams + i - 1)))
+                    return sdk::ErrorCode::ReadFile;
+
+                std::vector<uint32_t> &list = table.m_postings[trigram];
+                list.resize(end - begin);
+                std::memcpy(list.data(), data.data() + (ids + begin) * sizeof(uint32_t), list.size() * sizeof(uint32_t));
+                for (size_t j = 0; j < list.size(); ++j)
+                    if (list[j] >= n || (j != 0 && list[j] <= list[j - 1]))
+                        return sdk::ErrorCode::ReadFile;
+            }
+
+            std::atomic_store_explicit(&m_state, std::move(state), std::memory_order_release);
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    sdk::ErrorCode SearchIndex::apply(Diagram const &diagram, ChangeSet const &changes) noexcept {
+        if (m_state == nullptr || changes.empty())
+            return sdk::ErrorCode::Ok;
+
+        try {
+            std::vector<internal::SearchOp> ops;
+            sdk::ElementStore const        &store = *diagram.store;
+
+            if (changes.everything()) {
+                ops.push_back({ internal::SearchOpKind::Reset, diagram.index, sdk::gl_nullelement, {} });
+
+                internal::CollectNames(diagram, ops);
+            } else
+                for (sdk::ChangeRecord const &record : changes.records()) {
+                    sdk::ElementHandle const element = sdk::ElementHandle::FromValue(record.element);
+
+                    switch (record.kind) {
+                        case sdk::ElementAdded:
+                        case sdk::ElementModified: {
+                            if (record.kind == sdk::ElementModified && record.args[0] != sdk::PropertyName)
+                                break;
+
+                            uint32_t const dense = store.indexOf(element);
+                            if (dense < store.size())
+                                ops.push_back({ internal::SearchOpKind::Set, diagram.index, element, store.names()[dense] });
+                            break;
+                        }
+                        case sdk::ElementRemoved:
+                            ops.push_back({ internal::SearchOpKind::Remove, diagram.index, element, {} });
+                            break;
+                    }
+                }
+            if (ops.empty())
+                return sdk::ErrorCode::Ok;
+
+            std::unique_lock<std::shared_mutex> lock(m_state->m_lock);
+            if (m_state->m_building)
+                m_state->m_pending.insert(m_state->m_pending.end(), ops.begin(), ops.end());
+            else
+                internal::ApplyOps(m_state->m_table, ops);
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    sdk::ErrorCode SearchIndex::query(std::string_view text, std::vector<Hit> &res, size_t limit) const noexcept {
+        res.clear();
+        if (text.empty())
+            return sdk::ErrorCode::InvalidParameter;
+
+        /* The GUI thread may replace the state meanwhile; the copy keeps this one alive. */
+        std::shared_ptr<internal::SearchState> const state = std::atomic_load_explicit(&m_state, std::memory_order_acquire);
+        if (state == nullptr)
+            return sdk::ErrorCode::InvalidState;
+        if (limit == 0)
+            return sdk::ErrorCode::Ok;
+
+        try {
+            std::string folded(text);
+            std::transform(folded.begin(), folded.end(), folded.begin(), internal::FoldCase);
+
+            std::shared_lock<std::shared_mutex> lock(state->m_lock);
+            if (state->m_building)
+                return sdk::ErrorCode::InvalidState;
+
+            internal::SearchTable const &table = state->m_table;
+            auto const                   check = [&](uint32_t const id) {
+                internal::SearchEntry const &entry = table.m_entries[id];
+
+                if (!entry.name.empty() && internal::ContainsFolded(entry.name.view(), folded))
+                    res.push_back({ entry.diagram, entry.element });
+                return res.size() < limit;
+            };
+
+            if (folded.size() < 3) {
+                for (uint32_t id = 0; id < table.m_entries.size(); ++id)
+                    if (!check(id))
+                        break;
+
+                return sdk::ErrorCode::Ok;
+            }
+
+            std::vector<uint32_t> trigrams;
+            for (size_t i = 0; i + 3 <= folded.size(); ++i)
+                trigrams.push_back(internal::Trigram(folded.data() + i));
+            std::sort(trigrams.begin(), trigrams.end());
+            trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+            /* Every candidate is in all lists; walk the shortest and look it up in the others. */
+            std::vector<std::vector<uint32_t> const *> lists;
+            for (uint32_t const trigram : trigrams) {
+                auto const it = table.m_postings.find(trigram);
+                if (it == table.m_postings.end())
+                    return sdk::ErrorCode::Ok;
+
+                lists.push_back(&it->second);
+            }
+            std::sort(lists.begin(), lists.end(), [](auto const *lhs, auto const *rhs) { return lhs->size() < rhs->size(); });
+
+            std::vector<std::vector<uint32_t>::const_iterator> cursors;
+            for (auto const *list : lists)
+                cursors.push_back(list->begin());
+
+            for (uint32_t const id : *lists[0]) {
+                bool found = true;
+                for (size_t i = 1; i < lists.size() && found; ++i) {
+                    cursors[i] = std::lower_bound(cursors[i], lists[i]->end(), id);
+                    found      = cursors[i] != lists[i]->end() && *cursors[i] == id;
+                }
+
+                if (found && !check(id))
+                    break;
+            }
+
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        res.clear();
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    void SearchIndex::clear() noexcept {
+        m_build.wait();
+        m_build = {};
+
+        std::atomic_store_explicit(&m_state, std::shared_ptr<internal::SearchState>{}, std::memory_order_release);
+    }
+}
+
+
@@ -0,0 +1,304 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  sequenceview.cpp
+ * \brief implementation of the sequence diagram view
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+/* external includes */
+#include <QMouseEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QPolygonF>
+#include <QWheelEvent>
+
+/* sdk includes */
+#include <sdk/profile.hpp>
+
+/* app includes */
+#include <framemonitor.hpp>
+#include <metrics.hpp>
+#include <sequenceview.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        constexpr double gl_arrowsize      = 6.0;   /**< length of arrow heads, in pixels */
+        constexpr double gl_selfloop       = 0.25;  /**< width of messages to self, relative to the lifeline gap */
+        constexpr double gl_maxheader      = 140.0; /**< largest width of lifeline headers, in pixels */
+        constexpr double gl_fragmentmargin = 0.4;   /**< margin of combined fragments around their lifelines, relative to the lifeline gap */
+
+
+        /**
+         * \brief  clamps a scene coordinate, divided by a step, onto a range of indices
+         *
+         * \param  [in] pos scene coordinate
+         * \param  [in] step distance between indices, in scene units
+         * \param  [in] count number of indices
+         *
+         * \return index in [0, *count*]
+         */
+        static uint32_t IndexAt(double const pos, double const step, uint32_t const count) noexcept {
+            double const index = std::floor(pos / step);
+
+            return index <= 0.0 ? 0 : index >= count ? count : static_cast<uint32_t>(index);
+        }
+
+        static double LifelineX(uint32_t const lifeline) noexcept { return (lifeline + 0.5) * SequenceView::gl_lifelinegap; }
+        static double RowY(uint32_t const row) noexcept           { return (row + 0.5) * SequenceView::gl_rowheight; }
+    }
+
+
+    SequenceView::SequenceView(LodThresholds const &lod, QWidget *parent) noexcept
+        : QWidget(parent), m_model(nullptr), m_lod(lod)
+    {
+        setAttribute(Qt::WA_OpaquePaintEvent);
+
+        if (FrameMonitor *const hud = FrameMonitor::Instance())
+            hud->watch(this);
+    }
+
+
+    void SequenceView::setModel(sdk::SequenceModel const *model) noexcept {
+        m_model = model;
+
+        update();
+    }
+
+    void SequenceView::setLodThresholds(LodThresholds const &lod) noexcept {
+        m_lod = lod;
+
+        update();
+    }
+
+    void SequenceView::setViewport(double const zoom, QPointF const &origin) noexcept {
+        m_view.setViewport(zoom, origin);
+
+        update();
+    }
+
+    void SequenceView::scrollToRow(uint32_t const row) noexcept {
+        m_view.setViewport(m_view.zoom(), QPointF(m_view.origin().x(), row * gl_rowheight));
+
+        update();
+    }
+
+    QRectF SequenceView::visibleRect() const noexcept {
+        return { m_view.origin(), QSizeF(width(), std::max(0.0, height() - gl_headerheight)) / m_view.zoom() };
+    }
+
+
+    void SequenceView::paintEvent(QPaintEvent *event) {
+        static uint32_t const gl_metric = Metrics::Local().add("frame.paint", Metrics::Kind::Histogram);
+        sdk::ProfileScope const zone(FrameMonitor::PaintZone());
+        MetricTimer const       timer(gl_metric);
+
+        QPainter painter(this);
+        painter.fillRect(event->rect(), palette().base());
+        if (m_model != nullptr) {
+            QRectF const   visible = visibleRect();
+            uint32_t const l0      = internal::IndexAt(visible.left(), gl_lifelinegap, m_model->lifelineCount());
+            uint32_t const l1      = std::min(internal::IndexAt(visible.right(), gl_lifelinegap, m_model->lifelineCount()) + 1, m_model->lifelineCount());
+
+            paintBody(painter, l0, l1);
+            paintHeaders(painter, l0, l1);
+        }
+
+        if (FrameMonitor const *const hud = FrameMonitor::Instance())
+            hud->paintOverlay(painter, this->rect());
+    }
+
+    void SequenceView::paintBody(QPainter &painter, uint32_t const l0, uint32_t const l1) const {
+        QRectF const   visible = visibleRect();
+        uint32_t const n       = m_model->size();
+        double const   zoom    = m_view.zoom();
+        double const   rowpx   = gl_rowheight * zoom;
+
+        painter.save();
+        painter.setClipRect(QRectF(0.0, gl_headerheight, width(), std::max(0.0, height() - gl_headerheight)));
+        painter.setRenderHint(QPainter::Antialiasing, rowpx >= gl_minrowpixels);
+
+        /* Lifelines run from the header down to the last message. */
+        double const end = std::min(mapFromScene(QPointF(0.0, n * gl_rowheight)).y(), static_cast<double>(height()));
+        painter.setPen(QPen(palette().mid().color(), 1.0, Qt::DashLine));
+        for (uint32_t l = l0; l < l1; ++l) {
+            double const x = mapFromScene(QPointF(internal::LifelineX(l), 0.0)).x();
+
+            painter.drawLine(QPointF(x, gl_headerheight), QPointF(x, end));
+        }
+        if (n == 0) {
+            painter.restore();
+
+            return;
+        }
+
+        uint32_t const r0 = internal::IndexAt(visible.top(), gl_rowheight, n);
+        uint32_t const r1 = std::min(internal::IndexAt(visible.bottom(), gl_rowheight, n) + 1, n);
+        if (r0 >= r1) {
+            painter.restore();
+
+            return;
+        }
+
+        /* Activations overlapping the visible window of time; bars span the rows of their messages. */
+        double const *const times = m_model->times();
+        painter.setPen(palette().text().color());
+        painter.setBrush(palette().alternateBase());
+        m_model->activations(times[r0], times[r1 - 1], [&](sdk::SequenceActivation const &activation) {
+            if (activation.lifeline < l0 || activation.lifeline >= l1)
+                return;
+
+            uint32_t const first = std::min(m_model->rowAt(activation.begin), n - 1);
+            uint32_t const last  = std::min(std::max(m_model->rowAt(activation.end), first), n - 1);
+            QPointF const  tl    = mapFromScene(QPointF(internal::LifelineX(activation.lifeline) - gl_barwidth / 2.0, internal::RowY(first)));
+            QPointF const  br    = mapFromScene(QPointF(internal::LifelineX(activation.lifeline) + gl_barwidth / 2.0, internal::RowY(last)));
+
+            painter.drawRect(QRectF(tl, br));
+        });
+
+        /* Once rows get thinner than a few pixels, only every n-th message is drawn. */
+        uint32_t const stride = rowpx >= gl_minrowpixels ? 1 : static_cast<uint32_t>(std::ceil(gl_minrowpixels / rowpx));
+        bool const     labels = stride == 1 && m_lod.select(zoom) == DetailLevel::Full;
+
+        /* Loops frame the rows of their first iteration, from the first to the last lifeline involved. */
+        painter.setBrush(Qt::NoBrush);
+        m_model->fragments(times[r0], times[r1 - 1], [&](sdk::SequenceFragment const &fragment) {
+            if (fragment.last < l0 || fragment.first >= l1)
+                return;
+
+            uint32_t const first = std::min(m_model->rowAt(fragment.begin), n - 1);
+            uint32_t const last  = std::max(m_model->rowAt(std::nextafter(fragment.end, HUGE_VAL)), first + 1) - 1;
+            QPointF const  tl    = mapFromScene(QPointF(internal::LifelineX(fragment.first) - gl_lifelinegap * internal::gl_fragmentmargin, first * gl_rowheight));
+            QPointF const  br    = mapFromScene(QPointF(internal::LifelineX(fragment.last) + gl_lifelinegap * internal::gl_fragmentmargin, (last + 1) * gl_rowheight));
+
+            painter.drawRect(QRectF(tl, br));
+            if (labels)
+                painter.drawText(QRectF(tl + QPointF(4.0, 0.0), br), Qt::AlignLeft | Qt::AlignTop, QString::fromUtf8(("loop \u00d7" + std::to_string(fragment.iterations)).c_str()));
+        });
+        double const   arrow  = std::min(internal::gl_arrowsize, rowpx / 2.0);
+
+        uint32_t const *const           from  = m_model->from();
+        uint32_t const *const           to    = m_model->to();
+        sdk::MessageKind const *const   kinds = m_model->kinds();
+        sdk::StringId const *const      names = m_model->labels();
+        QColor const                    color = palette().text().color();
+        for (uint32_t r = r0 - r0 % stride; r < r1; r += stride) {
+            uint32_t const lo = std::min(from[r], to[r]);
+            uint32_t const hi = std::max(from[r], to[r]);
+            if (hi < l0 || lo >= l1)
+                continue;
+
+            QPointF const a = mapFromScene(QPointF(internal::LifelineX(from[r]), internal::RowY(r)));
+            QPointF       b = mapFromScene(QPointF(internal::LifelineX(to[r]), internal::RowY(r)));
+            painter.setPen(QPen(color, 1.0, kinds[r] == sdk::MessageKind::Reply ? Qt::DashLine : Qt::SolidLine));
+            painter.setBrush(color);
+
+            /* Messages to self leave to the right and come back one half row further down. */
+            double direction = b.x() >= a.x() ? 1.0 : -1.0;
+            if (from[r] == to[r]) {
+                double const loop = gl_lifelinegap * internal::gl_selfloop * zoom;
+
+                b = a + QPointF(0.0, rowpx / 2.0);
+                painter.drawPolyline(QPolygonF({ a, a + QPointF(loop, 0.0), b + QPointF(loop, 0.0), b }));
+                direction = -1.0;
+            } else
+                painter.drawLine(a, b);
+
+            if (arrow >= 1.0) {
+                QPointF const back  = b - QPointF(direction * arrow, 0.0);
+                QPointF const upper = back - QPointF(0.0, arrow / 2.0);
+                QPointF const lower = back + QPointF(0.0, arrow / 2.0);
+
+                painter.setPen(QPen(color, 1.0));
+                if (kinds[r] == sdk::MessageKind::Sync)
+                    painter.drawPolygon(QPolygonF({ b, upper, lower }));
+                else
+                    painter.drawPolyline(QPolygonF({ upper, b, lower }));
+            }
+
+            if (labels && !names[r].empty()) {
+                double const    left  = std::min(a.x(), b.x());
+                double const    width = std::max(std::abs(b.x() - a.x()), gl_lifelinegap * internal::gl_selfloop * zoom);
+                QRectF const    rect(from[r] == to[r] ? a.x() + 2.0 : left, a.y() - rowpx / 2.0, width, rowpx / 2.0);
+                QString const   text = QString::fromUtf8(names[r].view().data(), static_cast<qsizetype>(names[r].view().size()));
+
+                painter.drawText(rect, Qt::AlignHCenter | Qt::AlignBottom, painter.fontMetrics().elidedText(text, Qt::ElideRight, static_cast<int>(rect.width())));
+            }
+        }
+
+        painter.restore();
+    }
+
+    void SequenceView::paintHeaders(QPainter &painter, uint32_t const l0, uint32_t const l1) const {
+        QRectF const header(0.0, 0.0, width(), gl_headerheight);
+        painter.fillRect(header, palette().window());
+        painter.setPen(palette().mid().color());
+        painter.drawLine(header.bottomLeft(), header.bottomRight());
+
+        double const boxwidth = std::min(gl_lifelinegap * m_view.zoom() - 8.0, internal::gl_maxheader);
+        if (boxwidth < 4.0)
+            return;
+
+        painter.setPen(palette().text().color());
+        painter.setBrush(palette().base());
+        for (uint32_t l = l0; l < l1; ++l) {
+            double const  x = mapFromScene(QPointF(internal::LifelineX(l), 0.0)).x();
+            QRectF const  box(x - boxwidth / 2.0, 4.0, boxwidth, gl_headerheight - 8.0);
+            std::string_view const name = m_model->lifelineName(l).view();
+
+            painter.drawRect(box);
+            painter.drawText(box, Qt::AlignCenter, painter.fontMetrics().elidedText(QString::fromUtf8(name.data(), static_cast<qsizetype>(name.size())), Qt::ElideRight, static_cast<int>(box.width()) - 4));
+        }
+    }
+
+
+    void SequenceView::wheelEvent(QWheelEvent *event) {
+        if (event->modifiers() & Qt::ControlModifier)
+            m_view.wheel(event);
+        else {
+            QPointF const steps = QPointF(event->angleDelta()) / 120.0;
+
+            m_view.setViewport(m_view.zoom(), m_view.origin() - QPointF(steps.x() * gl_lifelinegap, steps.y() * gl_scrollrows * gl_rowheight));
+            event->accept();
+        }
+
+        update();
+    }
+
+    void SequenceView::mousePressEvent(QMouseEvent *event) {
+        if (!m_view.press(event))
+            QWidget::mousePressEvent(event);
+    }
+
+    void SequenceView::mouseMoveEvent(QMouseEvent *event) {
+        if (m_view.move(event))
+            update();
+        else
+            QWidget::mouseMoveEvent(event);
+    }
+
+    void SequenceView::mouseReleaseEvent(QMouseEvent *event) {
+        if (!m_view.release(event))
+            QWidget::mouseReleaseEvent(event);
+    }
+
+
+    QPointF SequenceView::mapFromScene(QPointF const &pos) const noexcept {
+        return { (pos.x() - m_view.origin().x()) * m_view.zoom(), gl_headerheight + (pos.y() - m_view.origin().y()) * m_view.zoom() };
+    }
+}
+
+
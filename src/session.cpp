@@ -0,0 +1,151 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  session.cpp
+ * \brief implementation of session state and project prefetching
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/profile.hpp>
+
+/* app includes */
+#include <session.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        constexpr size_t gl_pagesize = 4096; /**< stride of touching prefetched pages, in bytes */
+
+
+        /**
+         * \brief  reads a number, accepting integers as well
+         *
+         * \param  [in] val raw JSON value
+         * \param  [in] fallback value returned if *val* is not a number
+         *
+         * \return number or *fallback*
+         */
+        static double ReadNumber(sdk::JSON const &val, double const fallback) noexcept {
+            return val.is_number() ? val.get<double>() : fallback;
+        }
+    }
+
+
+    Session Session::Load(sdk::ConfigView const &cfg) noexcept {
+        Session res;
+
+        try {
+            if (sdk::Result<sdk::JSON> const projects = cfg.lookup("/projects"); projects && projects->is_array())
+                for (sdk::JSON const &entry : *projects) {
+                    if (!entry.is_object() || !entry.contains("path") || !entry["path"].is_string())
+                        continue;
+
+                    res.projects.push_back({
+                        entry["path"].get<std::string>(),
+                        sdk::JSONCVT::to(entry.value("diagram", sdk::JSON()), std::string{}),
+                        internal::ReadNumber(entry.value("zoom", sdk::JSON()), 1.0),
+                        internal::ReadNumber(entry.value("x", sdk::JSON()), 0.0),
+                        internal::ReadNumber(entry.value("y", sdk::JSON()), 0.0)
+                    });
+                }
+
+            if (sdk::Result<sdk::JSON> const recent = cfg.lookup("/recent"); recent && recent->is_array())
+                for (sdk::JSON const &entry : *recent)
+                    if (entry.is_string() && res.recent.size() < gl_maxrecent)
+                        res.recent.push_back(entry.get<std::string>());
+
+            return res;
+        } catch (...) { }
+
+        return Session{};
+    }
+
+    sdk::ErrorCode Session::save(sdk::ConfigView &cfg) const noexcept {
+        try {
+            sdk::JSON open = sdk::JSON::array();
+            for (SessionProject const &project : projects)
+                open.push_back({
+                    { "path",    project.path    },
+                    { "diagram", project.diagram },
+                    { "zoom",    project.zoom    },
+                    { "x",       project.x       },
+                    { "y",       project.y       }
+                });
+
+            return cfg.apply({ { "/projects", std::move(open) }, { "/recent", recent } });
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    void Session::touch(std::string const &path) {
+        auto const it = std::find(recent.begin(), recent.end(), path);
+        if (it != recent.end())
+            recent.erase(it);
+
+        recent.insert(recent.begin(), path);
+        if (recent.size() > gl_maxrecent)
+            recent.resize(gl_maxrecent);
+    }
+
+
+    std::unique_ptr<PrefetchedProject> PrefetchProject(SessionProject const &project) noexcept {
+        SZSDK_PROFILE_SCOPE("PrefetchProject");
+
+        try {
+            auto res     = std::make_unique<PrefetchedProject>();
+            res->project = project;
+            res->diagram = 0;
+
+            sdk::ErrorCode err = res->reader.open(project.path.c_str());
+            if (err != sdk::ErrorCode::Ok) {
+                SZSDK_APP_WARNING("Could not reopen project \"{}\" of the previous session (error {}).", project.path, static_cast<int>(err));
+
+                return nullptr;
+            }
+            if (res->reader.diagramCount() == 0)
+                return nullptr;
+
+            for (uint32_t i = 0; i < res->reader.diagramCount(); ++i)
+                if (res->reader.diagramName(i) == project.diagram) {
+                    res->diagram = i;
+
+                    break;
+                }
+
+            /* The cache has the journal folded in and is never compressed, so its diagrams are always mapped. */
+            sdk::ProjectReader &source = res->cache.open(project.path.c_str(), res->reader.contentHash()) == sdk::ErrorCode::Ok ? res->cache.reader() : res->reader;
+            err = source.mapDiagram(res->diagram, res->store);
+            if (err != sdk::ErrorCode::Ok) {
+                SZSDK_APP_WARNING("Could not reopen diagram \"{}\" of project \"{}\" (error {}).", project.diagram, project.path, static_cast<int>(err));
+
+                return nullptr;
+            }
+
+            /* Fault in the pages the first frame culls against, while the GUI is still starting. */
+            char const *const bytes = reinterpret_cast<char const *>(res->store.bounds());
+            size_t const      len   = static_cast<size_t>(res->store.size()) * sizeof(sdk::ElementRect);
+            volatile char     sink  = 0;
+            for (size_t i = 0; i < len; i += internal::gl_pagesize)
+                sink = sink + bytes[i];
+
+            return res;
+        } catch (...) { }
+
+        return nullptr;
+    }
+}
+
+
@@ -0,0 +1,263 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  sharedproject.cpp
+ * \brief implementation of project models shared by all windows and views showing them
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+/* external includes */
+#include <QWidget>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+
+/* app includes */
+#include <sharedproject.hpp>
+
+
+namespace suzu {
+    SharedProject::SharedProject() noexcept
+        : m_next(1)
+    { }
+
+    SharedProject::~SharedProject() {
+        while (!m_views.empty())
+            detach(m_views.back().id);
+    }
+
+
+    std::shared_ptr<SharedProject> SharedProject::Open(std::string const &path, sdk::ErrorCode *err) noexcept {
+        sdk::ErrorCode res = sdk::ErrorCode::CriticalResource;
+
+        try {
+            std::string const              normalized = Normalize(path);
+            std::shared_ptr<SharedProject> project    = Find(normalized);
+            if (project != nullptr) {
+                if (err != nullptr)
+                    *err = sdk::ErrorCode::Ok;
+
+                return project;
+            }
+
+            project         = std::make_shared<SharedProject>();
+            project->m_path = normalized;
+            if ((res = project->m_reader.open(path.c_str())) == sdk::ErrorCode::Ok) {
+                Register(project);
+
+                if (err != nullptr)
+                    *err = sdk::ErrorCode::Ok;
+                return project;
+            }
+        } catch (...) { }
+
+        SZSDK_APP_WARNING("Could not open project \"{}\" (error {}).", path, static_cast<int>(res));
+        if (err != nullptr)
+            *err = res;
+        return nullptr;
+    }
+
+    std::shared_ptr<SharedProject> SharedProject::Adopt(std::unique_ptr<PrefetchedProject> prefetched) noexcept {
+        if (prefetched == nullptr)
+            return nullptr;
+
+        try {
+            std::string const              normalized = Normalize(prefetched->project.path);
+            std::shared_ptr<SharedProject> project    = Find(normalized);
+            if (project != nullptr)
+                return project;
+
+            project           = std::make_shared<SharedProject>();
+            project->m_path   = normalized;
+            project->m_reader = std::move(prefetched->reader);
+            Register(project);
+
+            /* The prefetched store may be mapped from the warm-start cache, whose mapping it keeps alive. */
+            if (prefetched->diagram < project->m_diagrams.size()) {
+                Diagram &diagram = *project->m_diagrams[prefetched->diagram];
+
+                diagram.store = std::make_unique<sdk::ElementStore>(std::move(prefetched->store));
+                Prepare(diagram);
+            }
+
+            return project;
+        } catch (...) { }
+
+        return nullptr;
+    }
+
+    std::vector<std::shared_ptr<SharedProject>> SharedProject::OpenProjects() {
+        std::vector<std::shared_ptr<SharedProject>> res;
+
+        for (std::weak_ptr<SharedProject> const &entry : gl_open)
+            if (std::shared_ptr<SharedProject> project = entry.lock(); project != nullptr)
+                res.push_back(std::move(project));
+
+        return res;
+    }
+
+    sdk::ElementStore *SharedProject::diagram(uint32_t diagram) noexcept {
+        if (diagram >= m_diagrams.size())
+            return nullptr;
+        Diagram &entry = *m_diagrams[diagram];
+        if (entry.store != nullptr)
+            return entry.store.get();
+
+        try {
+            auto                 store = std::make_unique<sdk::ElementStore>();
+            sdk::ErrorCode const err   = m_reader.mapDiagram(diagram, *store);
+            if (err != sdk::ErrorCode::Ok) {
+                SZSDK_APP_WARNING("Could not load diagram \"{}\" of project \"{}\" (error {}).", entry.name, m_path, static_cast<int>(err));
+
+                return nullptr;
+            }
+
+            entry.store = std::move(store);
+            Prepare(entry);
+            return entry.store.get();
+        } catch (...) { }
+
+        entry.store.reset();
+        entry.undo.reset();
+        entry.changes.reset();
+        return nullptr;
+    }
+
+    UndoStack *SharedProject::undo(uint32_t diagram) noexcept {
+        return this->diagram(diagram) != nullptr ? m_diagrams[diagram]->undo.get() : nullptr;
+    }
+
+    ChangeDispatcher *SharedProject::dispatcher(uint32_t diagram) noexcept {
+        return this->diagram(diagram) != nullptr ? m_diagrams[diagram]->changes.get() : nullptr;
+    }
+
+    std::shared_ptr<sdk::ElementStore const> SharedProject::snapshot(uint32_t diagram) noexcept {
+        sdk::ElementStore const *const store = this->diagram(diagram);
+        if (store == nullptr)
+            return nullptr;
+
+        /* Readers of the same revision share one snapshot; it is only copied again after an edit. */
+        std::shared_ptr<sdk::ElementStore const> &cached = m_diagrams[diagram]->snapshot;
+        if (cached != nullptr && cached->revision() == store->revision())
+            return cached;
+
+        try {
+            cached = std::make_shared<sdk::ElementStore const>(store->snapshot());
+
+            return cached;
+        } catch (...) { }
+
+        return nullptr;
+    }
+
+    std::vector<ProjectWatcher::Diagram> SharedProject::loadedDiagrams() const {
+        std::vector<ProjectWatcher::Diagram> res;
+
+        for (std::unique_ptr<Diagram> const &diagram : m_diagrams)
+            if (diagram->store != nullptr)
+                res.push_back({ diagram->name, diagram->store.get(), diagram->undo.get() });
+
+        return res;
+    }
+
+    uint64_t SharedProject::attach(uint32_t diagram, DiagramView &view) noexcept {
+        ChangeDispatcher *const changes = dispatcher(diagram);
+        if (changes == nullptr)
+            return 0;
+
+        try {
+            m_views.reserve(m_views.size() + 1);
+
+            /* Each view tracks the revisions it has seen itself, so a repaint only re-renders its own stale tiles. */
+            uint64_t const subscription = changes->subscribe([&view](ChangeSet const &) { view.widget()->update(); });
+            if (subscription == 0)
+                return 0;
+
+            view.setStore(m_diagrams[diagram]->store.get());
+            m_views.push_back({ m_next, diagram, &view, subscription });
+            return m_next++;
+        } catch (...) { }
+
+        return 0;
+    }
+
+    void SharedProject::detach(uint64_t id) noexcept {
+        auto const it = std::find_if(m_views.begin(), m_views.end(), [id](Attachment const &view) { return view.id == id; });
+        if (it == m_views.end())
+            return;
+
+        m_diagrams[it->diagram]->changes->unsubscribe(it->subscription);
+        it->view->setStore(nullptr);
+        m_views.erase(it);
+    }
+
+    uint32_t SharedProject::viewCount(uint32_t diagram) const noexcept {
+        return static_cast<uint32_t>(std::count_if(m_views.begin(), m_views.end(), [diagram](Attachment const &view) { return view.diagram == diagram; }));
+    }
+
+
+    std::shared_ptr<SharedProject> SharedProject::Find(std::string const &path) noexcept {
+        /* Expired entries of closed projects are dropped on the way. */
+        std::shared_ptr<SharedProject> res;
+
+        gl_open.erase(std::remove_if(gl_open.begin(), gl_open.end(), [&](std::weak_ptr<SharedProject> const &entry) {
+            std::shared_ptr<SharedProject> project = entry.lock();
+            if (project != nullptr && project->m_path == path)
+                res = std::move(project);
+
+            return entry.expired();
+        }), gl_open.end());
+
+        return res;
+    }
+
+    std::string SharedProject::Normalize(std::string const &path) {
+        std::error_code             ec;
+        std::filesystem::path const absolute = std::filesystem::absolute(path, ec);
+        std::filesystem::path       res      = std::filesystem::weakly_canonical(ec ? std::filesystem::path(path) : absolute, ec);
+        if (ec)
+            res = absolute.lexically_normal();
+
+        std::string str = res.generic_string();
+#if defined _WIN32
+        /* Paths are case-insensitive on Windows. */
+        std::transform(str.begin(), str.end(), str.begin(), [](unsigned char const c) { return static_cast<char>(std::tolower(c)); });
+#endif
+        return str;
+    }
+
+    void SharedProject::Register(std::shared_ptr<SharedProject> const &self) {
+        self->m_diagrams.reserve(self->m_reader.diagramCount());
+        for (uint32_t i = 0; i < self->m_reader.diagramCount(); ++i) {
+            self->m_diagrams.push_back(std::make_unique<Diagram>());
+
+            self->m_diagrams.back()->name = std::string(self->m_reader.diagramName(i));
+        }
+
+        gl_open.push_back(self);
+        SZSDK_APP_INFO("Opened project \"{}\" with {} diagram(s).", self->m_path, self->m_diagrams.size());
+    }
+
+    void SharedProject::Prepare(Diagram &diagram) {
+        diagram.undo    = std::make_unique<UndoStack>(*diagram.store);
+        diagram.changes = std::make_unique<ChangeDispatcher>();
+
+        diagram.undo->setDispatcher(diagram.changes.get());
+    }
+}
+
+
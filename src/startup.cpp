@@ -0,0 +1,198 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  startup.cpp
+ * \brief implementation of the component startup graph
+ */
+
+
+/* stdlib includes */
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/timeline.hpp>
+
+/* app includes */
+#include <startup.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \brief  invokes the initialization function of *step*
+         *
+         * \param  [in] step step to run
+         *
+         * \return *true* if the step succeeded; exceptions are treated as failures
+         */
+        static bool InvokeStartupStep(StartupStep const &step) noexcept {
+            try {
+                sdk::Timeline::Scope const scope(sdk::Timeline::Startup(), step.name);
+
+                return step.fn();
+            } catch (...) { }
+
+            return false;
+        }
+    }
+
+
+    sdk::ErrorCode StartupGraph::add(StartupStep step) noexcept {
+        if (step.name.empty() || !step.fn)
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            for (StartupStep const &other : m_steps)
+                if (other.name == step.name)
+                    return sdk::ErrorCode::InvalidParameter;
+
+            m_steps.push_back(std::move(step));
+        } catch (...) {
+            return sdk::ErrorCode::Unknown;
+        }
+
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode StartupGraph::run(QThreadPool &pool) noexcept {
+        try {
+            size_t const n = m_steps.size();
+
+            /* Resolve dependencies by name. */
+            std::unordered_map<std::string, size_t> index;
+            for (size_t i = 0; i < n; ++i)
+                index.emplace(m_steps[i].name, i);
+
+            std::vector<std::vector<size_t>> dependents(n);
+            std::vector<size_t>              pending(n, 0);
+            for (size_t i = 0; i < n; ++i)
+                for (std::string const &dep : m_steps[i].deps) {
+                    auto const it = index.find(dep);
+                    if (it == index.end()) {
+                        SZSDK_APP_ERROR("Startup step \"{}\" depends on unknown step \"{}\".", m_steps[i].name, dep);
+
+                        return sdk::ErrorCode::InvalidState;
+                    }
+
+                    dependents[it->second].push_back(i);
+                    ++pending[i];
+                }
+
+            /* Reject cycles before anything is started. */
+            {
+                std::vector<size_t> indeg = pending;
+                std::vector<size_t> queue;
+                for (size_t i = 0; i < n; ++i)
+                    if (indeg[i] == 0)
+                        queue.push_back(i);
+
+                size_t visited = 0;
+                while (!queue.empty()) {
+                    size_t const curr = queue.back();
+                    queue.pop_back();
+
+                    ++visited;
+                    for (size_t const dep : dependents[curr])
+                        if (--indeg[dep] == 0)
+                            queue.push_back(dep);
+                }
+
+                if (visited != n) {
+                    SZSDK_APP_ERROR("Startup steps have cyclic dependencies.");
+
+                    return sdk::ErrorCode::InvalidState;
+                }
+            }
+
+            /*
+             * Completions of pool steps are reported back to this thread, which then releases the
+             * dependents of the finished step. GUI steps are executed here directly.
+             */
+            std::mutex                           lock;
+            std::condition_variable              cond;
+            std::vector<std::pair<size_t, bool>> finished;
+            std::deque<size_t>                   guiready;
+            size_t                               inflight = 0;
+            bool                                 failed   = false;
+
+            auto const dispatch = [&](size_t const i) {
+                if (m_steps[i].gui) {
+                    guiready.push_back(i);
+
+                    return;
+                }
+
+                ++inflight;
+                pool.start([&, i]() {
+                    bool const ok = internal::InvokeStartupStep(m_steps[i]);
+
+                    /* Notify under the lock; the waiting thread may return as soon as it is released. */
+                    std::lock_guard<std::mutex> guard(lock);
+                    finished.emplace_back(i, ok);
+                    cond.notify_one();
+                });
+            };
+            auto const complete = [&](size_t const i, bool const ok) {
+                if (!ok) {
+                    SZSDK_APP_ERROR("Startup step \"{}\" failed.", m_steps[i].name);
+
+                    failed = true;
+                }
+                if (failed)
+                    return;
+
+                for (size_t const dep : dependents[i])
+                    if (--pending[dep] == 0)
+                        dispatch(dep);
+            };
+
+            for (size_t i = 0; i < n; ++i)
+                if (pending[i] == 0)
+                    dispatch(i);
+
+            for (;;) {
+                if (!failed && !guiready.empty()) {
+                    size_t const i = guiready.front();
+                    guiready.pop_front();
+
+                    complete(i, internal::InvokeStartupStep(m_steps[i]));
+                    continue;
+                }
+                if (inflight == 0)
+                    break;
+
+                std::vector<std::pair<size_t, bool>> batch;
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    cond.wait(guard, [&]() { return !finished.empty(); });
+
+                    batch.swap(finished);
+                }
+
+                for (auto const &[i, ok] : batch) {
+                    --inflight;
+
+                    complete(i, ok);
+                }
+            }
+
+            return failed ? sdk::ErrorCode::CriticalResource : sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::Unknown;
+    }
+}
+
+
@@ -0,0 +1,349 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  styles.cpp
+ * \brief implementation of compiled style sheets
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <optional>
+
+/* external includes */
+#include <QFile>
+
+/* sdk includes */
+#include <sdk/config.hpp>
+
+/* app includes */
+#include <styles.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        constexpr uint32_t gl_stylespecificity = 100; /**< weight of a style id selector */
+        constexpr uint32_t gl_statespecificity = 10;  /**< weight of each state selector */
+        constexpr uint32_t gl_kindspecificity  = 1;   /**< weight of a kind selector */
+
+        static ElementStyle const gl_unstyled = { QColor(), QColor(), QColor(), -1.0, -1.0, -1 }; /**< style without any property set */
+
+        /**
+         * \struct suzu::internal::StyleRule
+         * \brief  rule of a style sheet, as parsed
+         */
+        struct StyleRule {
+            std::optional<sdk::ElementKind> kind;        /**< kind selector */
+            std::optional<uint32_t>         style;       /**< style id selector */
+            std::optional<bool>             selected;    /**< selection state selector */
+            std::optional<bool>             locked;      /**< lock state selector */
+            ElementStyle                    props;       /**< properties set by the rule; invalid if not set */
+            uint32_t                        specificity; /**< weight of the selectors */
+            size_t                          order;       /**< position in the sheet */
+
+            /**
+             * \brief  checks whether the rule applies to an element
+             *
+             * \param  [in] kind kind of the element
+             * \param  [in] style style id of the element, or *std::nullopt* for one that no rule names
+             * \param  [in] state state of the element; bit 0 is the selection, bit 1 the lock
+             *
+             * \return *true* if all selectors match
+             */
+            bool matches(sdk::ElementKind const kind, std::optional<uint32_t> const style, uint32_t const state) const noexcept {
+                return (!this->kind || *this->kind == kind)
+                    && (!this->style || this->style == style)
+                    && (!selected || *selected == ((state & 1) != 0))
+                    && (!locked || *locked == ((state & 2) != 0));
+            }
+        };
+
+        /**
+         * \brief  parses a color in the form "#rrggbb" or "#rrggbbaa"
+         *
+         * \param  [in] text text of the color
+         * \param  [out] res receives the color
+         *
+         * \return *true* on success
+         */
+        static bool ParseColor(std::string_view const text, QColor &res) noexcept {
+            if (text.empty() || text[0] != '#' || (text.size() != 7 && text.size() != 9))
+                return false;
+
+            uint32_t value = 0;
+            for (size_t i = 1; i < text.size(); ++i) {
+                char const c = text[i];
+
+                uint32_t digit;
+                if (c >= '0' && c <= '9')
+                    digit = static_cast<uint32_t>(c - '0');
+                else if (c >= 'a' && c <= 'f')
+                    digit = static_cast<uint32_t>(c - 'a' + 10);
+                else if (c >= 'A' && c <= 'F')
+                    digit = static_cast<uint32_t>(c - 'A' + 10);
+                else
+                    return false;
+                value = value << 4 | digit;
+            }
+            if (text.size() == 7)
+                value = value << 8 | 0xFF;
+
+            res = QColor(static_cast<int>(value >> 24), static_cast<int>(value >> 16 & 0xFF), static_cast<int>(value >> 8 & 0xFF), static_cast<int>(value & 0xFF));
+            return true;
+        }
+
+        /**
+         * \brief  parses a single rule
+         *
+         * \param  [in] json rule object
+         * \param  [out] res receives the rule
+         *
+         * \return *true* if the rule is well-formed
+         * \throw  std::bad_alloc
+         */
+        static bool ParseRule(sdk::JSON const &json, StyleRule &res) {
+            if (!json.is_object())
+                return false;
+
+            res.props       = gl_unstyled;
+            res.specificity = 0;
+            for (auto const &[key, value] : json.items()) {
+                if (key == "kind") {
+                    sdk::ElementKind kind;
+                    if (!value.is_string() || !sdk::KindOfName(value.get_ref<std::string const &>(), kind))
+                        return false;
+
+                    res.kind         = kind;
+                    res.specificity += gl_kindspecificity;
+                } else if (key == "style") {
+                    if (!value.is_number_unsigned() || value.get<uint64_t>() > UINT32_MAX)
+                        return false;
+
+                    res.style        = value.get<uint32_t>();
+                    res.specificity += gl_stylespecificity;
+                } else if (key == "selected" || key == "locked") {
+                    if (!value.is_boolean())
+                        return false;
+
+                    (key == "selected" ? res.selected : res.locked) = value.get<bool>();
+                    res.specificity += gl_statespecificity;
+                } else if (key == "fill" || key == "stroke" || key == "text") {
+                    QColor &color = key == "fill" ? res.props.fill : key == "stroke" ? res.props.stroke : res.props.text;
+                    if (!value.is_string() || !ParseColor(value.get_ref<std::string const &>(), color))
+                        return false;
+                } else if (key == "width") {
+                    if (!value.is_number() || value.get<double>() < 0.0)
+                        return false;
+
+                    res.props.width = value.get<double>();
+                } else if (key == "fontsize") {
+                    if (!value.is_number() || value.get<double>() <= 0.0)
+                        return false;
+
+                    res.props.fontsize = value.get<double>();
+                } else if (key == "bold") {
+                    if (!value.is_boolean())
+                        return false;
+
+                    res.props.bold = value.get<bool>() ? 1 : 0;
+                } else
+                    return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * \brief  packs the properties of a resolved style, so that equal styles compare equal
+         *
+         * \param  [in] style resolved style
+         *
+         * \return key of the style
+         */
+        static std::array<uint64_t, 6> StyleKeyOf(ElementStyle const &style) noexcept {
+            auto const color = [](QColor const &c) -> uint64_t {
+                return c.isValid() ? uint64_t(1) << 32 | c.rgba() : 0;
+            };
+            auto const bits = [](double const d) -> uint64_t {
+                uint64_t res;
+                std::memcpy(&res, &d, sizeof res);
+
+                return d < 0.0 ? 0 : res;
+            };
+
+            return { color(style.fill), color(style.stroke), color(style.text), bits(style.width), bits(style.fontsize), static_cast<uint64_t>(style.bold + 1) };
+        }
+
+        /**
+         * \brief  builds the painter objects of a resolved style
+         *
+         * \param  [in] style resolved style
+         *
+         * \return record of the style
+         * \throw  std::bad_alloc
+         */
+        static StyleRecord MakeRecord(ElementStyle const &style) {
+            StyleRecord res = { style, QPen(), QPen(), QBrush(), QFont(), style.fontsize > 0.0 || style.bold >= 0, false };
+
+            if (style.stroke.isValid())
+                res.shape.setColor(style.stroke);
+            if (style.width >= 0.0)
+                res.shape.setWidthF(style.width);
+            if (style.text.isValid())
+                res.text.setColor(style.text);
+            if (style.fill.isValid())
+                res.fill = QBrush(style.fill);
+            if (style.fontsize > 0.0)
+                res.font.setPointSizeF(style.fontsize);
+            if (style.bold >= 0)
+                res.font.setBold(style.bold != 0);
+
+            res.textpen = res.text != res.shape;
+            return res;
+        }
+    }
+
+
+    StyleSheet::StyleSheet() noexcept
+        : m_rules(0)
+    { }
+
+    sdk::ErrorCode StyleSheet::Compile(std::string_view json, std::shared_ptr<StyleSheet const> &res) noexcept {
+        try {
+            sdk::JSON const doc = sdk::JSON::parse(json.begin(), json.end(), nullptr, false, true);
+            if (doc.is_discarded() || !doc.is_object())
+                return sdk::ErrorCode::InvalidParameter;
+
+            auto const list = doc.find("rules");
+            if (list == doc.end() || !list->is_array())
+                return sdk::ErrorCode::InvalidParameter;
+
+            std::vector<internal::StyleRule> rules(list->size());
+            for (size_t i = 0; i < rules.size(); ++i) {
+                if (!internal::ParseRule((*list)[i], rules[i]))
+                    return sdk::ErrorCode::InvalidParameter;
+
+                rules[i].order = i;
+            }
+
+            /* Applying the rules from least to most specific lets every property end up with the winner. */
+            std::sort(rules.begin(), rules.end(), [](internal::StyleRule const &l, internal::StyleRule const &r) {
+                return l.specificity != r.specificity ? l.specificity < r.specificity : l.order < r.order;
+            });
+
+            auto sheet = std::make_shared<StyleSheet>();
+
+            std::vector<std::optional<uint32_t>> slots = { std::nullopt };
+            for (internal::StyleRule const &rule : rules)
+                if (rule.style && sheet->m_slots.try_emplace(*rule.style, static_cast<uint32_t>(slots.size())).second)
+                    slots.push_back(rule.style);
+
+            /* Most cells resolve to one of a few styles; each gets a single record. */
+            std::map<std::array<uint64_t, 6>, StyleHandle> records;
+            size_t const                                   kinds = static_cast<size_t>(sdk::ElementKind::__NumElementKinds__);
+            sheet->m_table.resize(slots.size() * kinds * gl_states);
+            for (size_t slot = 0; slot < slots.size(); ++slot)
+                for (size_t kind = 0; kind < kinds; ++kind)
+                    for (uint32_t state = 0; state < gl_states; ++state) {
+                        ElementStyle style = internal::gl_unstyled;
+
+                        for (internal::StyleRule const &rule : rules) {
+                            if (!rule.matches(static_cast<sdk::ElementKind>(kind), slots[slot], state))
+                                continue;
+
+                            if (rule.props.fill.isValid())
+                                style.fill = rule.props.fill;
+                            if (rule.props.stroke.isValid())
+                                style.stroke = rule.props.stroke;
+                            if (rule.props.text.isValid())
+                                style.text = rule.props.text;
+                            if (rule.props.width >= 0.0)
+                                style.width = rule.props.width;
+                            if (rule.props.fontsize > 0.0)
+                                style.fontsize = rule.props.fontsize;
+                            if (rule.props.bold >= 0)
+                                style.bold = rule.props.bold;
+                        }
+
+                        auto const [it, added] = records.try_emplace(internal::StyleKeyOf(style), static_cast<StyleHandle>(sheet->m_records.size()));
+                        if (added)
+                            sheet->m_records.push_back(internal::MakeRecord(style));
+                        sheet->m_table[CellOf(static_cast<uint32_t>(slot), kind, state)] = it->second;
+                    }
+
+            sheet->m_rules = rules.size();
+            res            = std::move(sheet);
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    sdk::ErrorCode StyleSheet::Diff(StyleSheet const *old, StyleSheet const *now, StyleDelta &res) noexcept {
+        res = StyleDelta();
+
+        try {
+            /* Style ids named by neither sheet resolve alike in both; all others are compared one by one. */
+            std::vector<std::optional<uint32_t>> ids = { std::nullopt };
+            for (StyleSheet const *sheet : { old, now })
+                if (sheet != nullptr)
+                    for (auto const &[id, slot] : sheet->m_slots)
+                        if (res.m_slots.try_emplace(id, static_cast<uint32_t>(ids.size())).second)
+                            ids.push_back(id);
+
+            size_t const kinds = static_cast<size_t>(sdk::ElementKind::__NumElementKinds__);
+            res.m_changed.resize(ids.size() * kinds * gl_states);
+            for (size_t slot = 0; slot < ids.size(); ++slot)
+                for (size_t kind = 0; kind < kinds; ++kind)
+                    for (uint32_t state = 0; state < gl_states; ++state) {
+                        ElementStyle const &before = old != nullptr ? old->propsOf(ids[slot], kind, state) : internal::gl_unstyled;
+                        ElementStyle const &after  = now != nullptr ? now->propsOf(ids[slot], kind, state) : internal::gl_unstyled;
+                        if (internal::StyleKeyOf(before) == internal::StyleKeyOf(after))
+                            continue;
+
+                        res.m_changed[CellOf(static_cast<uint32_t>(slot), kind, state)] = 1;
+                        ++res.m_count;
+                    }
+
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        res = StyleDelta();
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    ElementStyle const &StyleSheet::propsOf(std::optional<uint32_t> style, size_t kind, uint32_t state) const noexcept {
+        auto const it = style ? m_slots.find(*style) : m_slots.end();
+
+        return m_records[m_table[CellOf(it != m_slots.end() ? it->second : 0, kind, state)]].props;
+    }
+
+    sdk::ErrorCode StyleSheet::Load(char const *path, std::shared_ptr<StyleSheet const> &res) noexcept {
+        try {
+            QFile file(QString::fromUtf8(path));
+            if (!file.open(QIODevice::ReadOnly))
+                return sdk::ErrorCode::ReadFile;
+
+            QByteArray const text = file.readAll();
+            if (file.error() != QFileDevice::NoError)
+                return sdk::ErrorCode::ReadFile;
+
+            return Compile(std::string_view(text.constData(), static_cast<size_t>(text.size())), res);
+        } catch (...) { }
+
+        return sdk::ErrorCode::CriticalResource;
+    }
+}
+
+
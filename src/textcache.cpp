@@ -0,0 +1,215 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  textcache.cpp
+ * \brief implementation of the cache of laid-out element labels
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <atomic>
+#include <string_view>
+
+/* external includes */
+#include <QString>
+#include <QTransform>
+
+/* sdk includes */
+#include <sdk/memory.hpp>
+
+/* app includes */
+#include <budget.hpp>
+#include <textcache.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \brief  retrieves the memory account of text layouts
+         *
+         * \return id of the account *"text cache"*
+         */
+        static uint32_t GetMemoryAccount() noexcept {
+            static uint32_t const gl_account = sdk::internal::RegisterAccount("text cache");
+
+            return gl_account;
+        }
+
+        /**
+         * \brief  retrieves a small number identifying the calling thread
+         *
+         * \return number of the thread; numbers are not reused
+         */
+        static uint32_t GetThreadNumber() noexcept {
+            static std::atomic<uint32_t> gl_next(0);
+            thread_local uint32_t const  gl_number = gl_next.fetch_add(1, std::memory_order_relaxed);
+
+            return gl_number;
+        }
+    }
+
+
+    TextLayoutCache::TextLayoutCache(size_t budget) noexcept
+        : m_budget(budget), m_bytes(0), m_consumer(0)
+    {
+        /* The most recent entry is kept, like when evicting for the budget of the cache. */
+        try {
+            m_consumer = MemoryBudget::Shared().add({
+                "text layouts", gl_cost,
+                [this]() {
+                    std::lock_guard<std::mutex> lock(m_lock);
+
+                    return m_bytes;
+                },
+                [this]() {
+                    std::lock_guard<std::mutex> lock(m_lock);
+
+                    return m_lru.size() > 1 ? MemoryBudget::Now() - m_lru.back().used : int64_t(-1);
+                },
+                [this]() {
+                    std::lock_guard<std::mutex> lock(m_lock);
+                    if (m_lru.size() <= 1)
+                        return size_t(0);
+
+                    Entry const &entry = m_lru.back();
+                    size_t const bytes = entry.bytes;
+                    m_bytes -= bytes;
+                    sdk::internal::TrackMemory(internal::GetMemoryAccount(), -static_cast<int64_t>(bytes));
+                    m_index.erase(entry.key);
+                    m_lru.pop_back();
+                    return bytes;
+                }
+            });
+        } catch (...) { }
+    }
+
+    TextLayoutCache::~TextLayoutCache() {
+        MemoryBudget::Shared().remove(m_consumer);
+    }
+
+    TextLayoutCache &TextLayoutCache::Shared() {
+        static TextLayoutCache gl_cache;
+
+        return gl_cache;
+    }
+
+
+    TextLayoutCache::Layout TextLayoutCache::get(sdk::StringId text, QFont const &font, double width, double scale) {
+        Key key{ text.value(), 0, width < 0.0 ? -1.0f : static_cast<float>(width), static_cast<float>(scale), internal::GetThreadNumber() };
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            /* Diagrams use a handful of fonts, so a linear search is fine. */
+            auto const fit = std::find(m_fonts.begin(), m_fonts.end(), font);
+            key.font = static_cast<uint32_t>(fit - m_fonts.begin());
+            if (fit == m_fonts.end())
+                m_fonts.push_back(font);
+
+            auto const it = m_index.find(key);
+            if (it != m_index.end()) {
+                m_lru.splice(m_lru.begin(), m_lru, it->second);
+                it->second->used = MemoryBudget::Now();
+
+                return it->second->layout;
+            }
+        }
+
+        /* Shaping is the expensive part and must not block other threads. */
+        std::string_view const str = text.view();
+
+        Layout layout;
+        layout.text = QStaticText(QString::fromUtf8(str.data(), static_cast<qsizetype>(str.length())));
+        layout.text.setTextFormat(Qt::PlainText);
+        layout.text.setTextWidth(key.width);
+        layout.text.prepare(QTransform::fromScale(key.scale, key.scale), font);
+        layout.size  = layout.text.size();
+        layout.scale = key.scale;
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (m_index.find(key) == m_index.end()) {
+            size_t const bytes = sizeof(Entry) + str.length() * gl_glyphbytes;
+
+            m_lru.push_front({ key, layout, bytes, MemoryBudget::Now() });
+            try {
+                m_index.emplace(key, m_lru.begin());
+            } catch (...) {
+                m_lru.pop_front();
+
+                throw;
+            }
+
+            m_bytes += bytes;
+            sdk::internal::TrackMemory(internal::GetMemoryAccount(), static_cast<int64_t>(bytes));
+            evict();
+        }
+
+        return layout;
+    }
+
+
+    void TextLayoutCache::Draw(QPainter &painter, QPointF const &position, Layout const &layout) {
+        QTransform const world = painter.worldTransform();
+        if (layout.scale <= 0.0 || world.type() > QTransform::TxScale || world.m11() != layout.scale || world.m22() != layout.scale) {
+            painter.drawStaticText(position, layout.text);
+
+            return;
+        }
+
+        /* Static text compares the whole transform, so painting at another translation would lay it out again. */
+        painter.setWorldTransform(QTransform::fromScale(layout.scale, layout.scale));
+        painter.drawStaticText(position + QPointF(world.dx(), world.dy()) / layout.scale, layout.text);
+        painter.setWorldTransform(world);
+    }
+
+
+    void TextLayoutCache::setBudget(size_t budget) noexcept {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        m_budget = budget;
+        evict();
+    }
+
+    void TextLayoutCache::clear() noexcept {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        m_index.clear();
+        m_lru.clear();
+        sdk::internal::TrackMemory(internal::GetMemoryAccount(), -static_cast<int64_t>(m_bytes));
+        m_bytes = 0;
+    }
+
+    size_t TextLayoutCache::size() const noexcept {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        return m_index.size();
+    }
+
+    size_t TextLayoutCache::bytes() const noexcept {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        return m_bytes;
+    }
+
+
+    void TextLayoutCache::evict() noexcept {
+        /* The most recent entry is kept even if it exceeds the budget on its own. */
+        while (m_budget != 0 && m_bytes > m_budget && m_lru.size() > 1) {
+            Entry const &entry = m_lru.back();
+
+            m_bytes -= entry.bytes;
+            sdk::internal::TrackMemory(internal::GetMemoryAccount(), -static_cast<int64_t>(entry.bytes));
+            m_index.erase(entry.key);
+            m_lru.pop_back();
+        }
+    }
+}
+
+
@@ -0,0 +1,465 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  textexport.cpp
+ * \brief implementation of the PlantUML and Mermaid exporters
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iterator>
+#include <new>
+#include <string>
+#include <vector>
+
+/* external includes */
+#include <QSaveFile>
+#include <QString>
+#include <QThread>
+
+/* sdk includes */
+#include <sdk/spatial.hpp>
+#include <sdk/task.hpp>
+
+/* app includes */
+#include <jobs.hpp>
+#include <textexport.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        constexpr uint32_t gl_textnone  = UINT32_MAX; /**< marks missing elements, e.g. the container of top-level elements */
+        constexpr uint32_t gl_textbatch = 4;          /**< number of diagrams per worker and batch */
+
+        /**
+         * \brief PlantUML keyword of every element kind; associations have none
+         */
+        static constexpr char const *gl_plantkinds[] = { "class", "interface", "enum", "package", nullptr, "note" };
+        static_assert(std::size(gl_plantkinds) == static_cast<size_t>(sdk::ElementKind::__NumElementKinds__), "every element kind needs a keyword");
+
+        /**
+         * \brief Mermaid annotation of every element kind; empty if there is none
+         */
+        static constexpr char const *gl_mermaidkinds[] = { "", "<<interface>>", "<<enumeration>>", "", "", "" };
+        static_assert(std::size(gl_mermaidkinds) == static_cast<size_t>(sdk::ElementKind::__NumElementKinds__), "every element kind needs an annotation");
+
+        /**
+         * \struct suzu::internal::TextLink
+         * \brief  association whose ends were found
+         */
+        struct TextLink {
+            uint32_t element; /**< dense index of the association */
+            uint32_t source;  /**< dense index of the element at the top-left corner */
+            uint32_t target;  /**< dense index of the element at the bottom-right corner */
+        };
+
+        /**
+         * \struct suzu::internal::TextOutline
+         * \brief  structure of a diagram, as written by both formats
+         */
+        struct TextOutline {
+            std::vector<uint32_t> container; /**< dense index of the enclosing visible package of every element; *gl_textnone* at the top level */
+            std::vector<uint32_t> offsets;   /**< start of the members of every package in *members*, by dense index; one more entry for the top level */
+            std::vector<uint32_t> members;   /**< visible elements other than associations, grouped by container, in dense order */
+            std::vector<TextLink> links;     /**< associations with both ends */
+        };
+
+        static bool IsVisible(sdk::ElementStore const &store, uint32_t const dense) noexcept {
+            return (store.flags()[dense] & sdk::ElementHidden) == 0;
+        }
+
+        /**
+         * \brief  appends text, replacing the characters a format cannot have in a quoted label
+         *
+         * \param  [in,out] out buffer to append to
+         * \param  [in] format format of the text
+         * \param  [in] text text to append
+         *
+         * \throw  std::bad_alloc
+         */
+        static void AppendLabel(fmt::memory_buffer &out, TextFormat const format, std::string_view const text) {
+            for (char const c : text)
+                switch (c) {
+                case '"':
+                    /* PlantUML cannot escape quotes in quoted names. */
+                    if (format == TextFormat::Mermaid)
+                        out.append(std::string_view("#quot;"));
+                    else
+                        out.push_back('\'');
+                    break;
+                case '\n':
+                    out.append(format == TextFormat::Mermaid ? std::string_view("<br>") : std::string_view("\\n"));
+                    break;
+                case '\r':
+                    break;
+                default:
+                    out.push_back(c);
+                }
+        }
+
+        /**
+         * \brief  appends a name as a Mermaid identifier, e.g. of a namespace
+         *
+         * \param  [in,out] out buffer to append to
+         * \param  [in] name name
+         * \param  [in] dense dense index of the element, for names without any letter or digit
+         *
+         * \throw  std::bad_alloc
+         */
+        static void AppendIdentifier(fmt::memory_buffer &out, std::string_view const name, uint32_t const dense) {
+            size_t const size = out.size();
+
+            for (char const c : name)
+                out.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+            if (std::none_of(out.begin() + static_cast<ptrdiff_t>(size), out.end(), [](char const c) { return c != '_'; })) {
+                out.resize(size);
+                fmt::format_to(fmt::appender(out), "P{}", dense);
+            }
+        }
+
+        /**
+         * \brief  finds the enclosing visible package of every element, groups the elements by it and
+         *         resolves the ends of the associations
+         *
+         * \param  [in] store elements of the diagram
+         * \param  [out] outline receives the structure
+         *
+         * \throw  std::bad_alloc
+         */
+        static void Outline(sdk::ElementStore const &store, TextOutline &outline) {
+            uint32_t const                   n       = store.size();
+            sdk::ElementKind const *const    kinds   = store.kinds();
+            sdk::ElementHandle const *const  parents = store.parents();
+
+            /* Parents are usually added before their children, so most walks end one step up. */
+            outline.container.assign(n, gl_textnone);
+            std::vector<uint8_t>  known(n, 0);
+            std::vector<uint32_t> chain;
+            for (uint32_t i = 0; i < n; ++i) {
+                uint32_t at = i;
+                while (!known[at] && chain.size() <= n) {
+                    chain.push_back(at);
+
+                    uint32_t const parent = parents[at] == sdk::gl_nullelement ? gl_textnone : store.indexOf(parents[at]);
+                    if (parent >= n) {
+                        at = gl_textnone;
+
+                        break;
+                    } else if (kinds[parent] == sdk::ElementKind::Package && IsVisible(store, parent)) {
+                        known[at]             = 1;
+                        outline.container[at] = parent;
+                    }
+                    at = parent;
+                }
+
+                /* Every element of the chain shares the container of the first known one; cycles end at the top level. */
+                uint32_t container = at < n && known[at] ? outline.container[at] : gl_textnone;
+                for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+                    if (known[*it])
+                        container = outline.container[*it];
+                    else {
+                        known[*it]             = 1;
+                        outline.container[*it] = container;
+                    }
+                }
+                chain.clear();
+            }
+
+            /* Members are grouped by container with a counting sort; the top level comes last. */
+            outline.offsets.assign(static_cast<size_t>(n) + 2, 0);
+            for (uint32_t i = 0; i < n; ++i)
+                if (kinds[i] != sdk::ElementKind::Association && IsVisible(store, i))
+                    ++outline.offsets[(outline.container[i] == gl_textnone ? n : outline.container[i]) + 1];
+            for (uint32_t i = 0; i <= n; ++i)
+                outline.offsets[i + 1] += outline.offsets[i];
+
+            outline.members.resize(outline.offsets[n + 1]);
+            std::vector<uint32_t> next(outline.offsets.begin(), outline.offsets.end() - 1);
+            for (uint32_t i = 0; i < n; ++i)
+                if (kinds[i] != sdk::ElementKind::Association && IsVisible(store, i))
+                    outline.members[next[outline.container[i] == gl_textnone ? n : outline.container[i]]++] = i;
+
+            /* Like the canvas, an association connects the topmost elements at the corners of its bounds; packages only if nothing else is there. */
+            outline.links.clear();
+            if (std::none_of(kinds, kinds + n, [](sdk::ElementKind const kind) { return kind == sdk::ElementKind::Association; }))
+                return;
+
+            sdk::SpatialIndex<sdk::ElementHandle> spatial;
+            for (uint32_t const i : outline.members)
+                spatial.insert(store.handleAt(i), store.bounds()[i]);
+
+            auto const endAt = [&](float const x, float const y) {
+                uint32_t best = gl_textnone;
+
+                spatial.query({ x, y, 0.0f, 0.0f }, [&](sdk::ElementHandle const handle, sdk::ElementRect const &box) {
+                    uint32_t const dense = store.indexOf(handle);
+                    if (!box.contains(x, y))
+                        return;
+
+                    bool const package = kinds[dense] == sdk::ElementKind::Package;
+                    if (best == gl_textnone || (package == (kinds[best] == sdk::ElementKind::Package) ? dense > best : !package))
+                        best = dense;
+                });
+
+                return best;
+            };
+            for (uint32_t i = 0; i < n; ++i) {
+                if (kinds[i] != sdk::ElementKind::Association || !IsVisible(store, i))
+                    continue;
+
+                sdk::ElementRect const &line   = store.bounds()[i];
+                uint32_t const          source = endAt(line.x, line.y);
+                uint32_t const          target = endAt(line.x + line.w, line.y + line.h);
+                if (source != gl_textnone && target != gl_textnone && source != target)
+                    outline.links.push_back({ i, source, target });
+            }
+        }
+
+        /**
+         * \brief  appends a diagram as a PlantUML block
+         *
+         * \param  [in,out] out buffer to append to
+         * \param  [in] name name of the diagram
+         * \param  [in] store elements of the diagram
+         * \param  [in] outline structure of the diagram
+         *
+         * \throw  std::bad_alloc
+         */
+        static void AppendPlantUml(fmt::memory_buffer &out, std::string_view const name, sdk::ElementStore const &store, TextOutline const &outline) {
+            uint32_t const                n     = store.size();
+            sdk::ElementKind const *const kinds = store.kinds();
+            sdk::StringId const *const    names = store.names();
+
+            out.append(std::string_view("@startuml\ntitle "));
+            AppendLabel(out, TextFormat::PlantUml, name);
+            out.append(std::string_view("\n"));
+
+            /* Packages are written depth-first with an explicit stack, so deep nesting cannot overflow the call stack. */
+            struct Frame { uint32_t container; uint32_t pos; };
+            std::vector<Frame> stack = { { n, outline.offsets[n] } };
+            while (!stack.empty()) {
+                Frame &frame = stack.back();
+                if (frame.pos == outline.offsets[frame.container + 1]) {
+                    stack.pop_back();
+                    if (!stack.empty())
+                        fmt::format_to(fmt::appender(out), "{:{}}}}\n", "", 2 * (stack.size() - 1));
+
+                    continue;
+                }
+
+                uint32_t const i      = outline.members[frame.pos++];
+                size_t const   indent = 2 * (stack.size() - 1);
+                fmt::format_to(fmt::appender(out), "{:{}}{} ", "", indent, gl_plantkinds[static_cast<uint32_t>(kinds[i])]);
+                if (!names[i].empty()) {
+                    out.push_back('"');
+                    AppendLabel(out, TextFormat::PlantUml, names[i].view());
+                    out.append(std::string_view("\" as "));
+                }
+                fmt::format_to(fmt::appender(out), "E{}", i);
+
+                if (kinds[i] == sdk::ElementKind::Package) {
+                    out.append(std::string_view(" {\n"));
+                    stack.push_back({ i, outline.offsets[i] });
+                } else
+                    out.push_back('\n');
+            }
+
+            for (TextLink const &link : outline.links) {
+                bool const note = kinds[link.source] == sdk::ElementKind::Note || kinds[link.target] == sdk::ElementKind::Note;
+
+                fmt::format_to(fmt::appender(out), "E{} {} E{}", link.source, note ? ".." : "--", link.target);
+                if (!names[link.element].empty()) {
+                    out.append(std::string_view(" : "));
+                    AppendLabel(out, TextFormat::PlantUml, names[link.element].view());
+                }
+                out.push_back('\n');
+            }
+
+            out.append(std::string_view("@enduml\n\n"));
+        }
+
+        /**
+         * \brief  appends a diagram as a Markdown section with a Mermaid block
+         *
+         * \param  [in,out] out buffer to append to
+         * \param  [in] name name of the diagram
+         * \param  [in] store elements of the diagram
+         * \param  [in] outline structure of the diagram
+         *
+         * \throw  std::bad_alloc
+         */
+        static void AppendMermaid(fmt::memory_buffer &out, std::string_view const name, sdk::ElementStore const &store, TextOutline const &outline) {
+            uint32_t const                n     = store.size();
+            sdk::ElementKind const *const kinds = store.kinds();
+            sdk::StringId const *const    names = store.names();
+
+            out.append(std::string_view("## "));
+            AppendLabel(out, TextFormat::Mermaid, name);
+            out.append(std::string_view("\n\n```mermaid\nclassDiagram\n"));
+
+            auto const appendClass = [&](uint32_t const i, std::string_view const indent) {
+                fmt::format_to(fmt::appender(out), "{}class E{}", indent, i);
+                if (!names[i].empty()) {
+                    out.append(std::string_view("[\""));
+                    AppendLabel(out, TextFormat::Mermaid, names[i].view());
+                    out.append(std::string_view("\"]"));
+                }
+                out.push_back('\n');
+            };
+
+            /* Namespaces cannot be nested; every package lists its own classifiers only. */
+            for (uint32_t container = 0; container <= n; ++container) {
+                uint32_t const begin = outline.offsets[container];
+                uint32_t const end   = outline.offsets[container + 1];
+                bool const     top   = container == n;
+                bool           open  = false;
+                for (uint32_t m = begin; m < end; ++m) {
+                    uint32_t const i = outline.members[m];
+                    if (kinds[i] == sdk::ElementKind::Package || kinds[i] == sdk::ElementKind::Note)
+                        continue;
+
+                    if (!top && !open) {
+                        out.append(std::string_view("    namespace "));
+                        AppendIdentifier(out, names[container].view(), container);
+                        out.append(std::string_view(" {\n"));
+                        open = true;
+                    }
+                    appendClass(i, top ? "    " : "        ");
+                }
+                if (open)
+                    out.append(std::string_view("    }\n"));
+            }
+
+            for (uint32_t i = 0; i < n; ++i)
+                if (*gl_mermaidkinds[static_cast<uint32_t>(kinds[i])] != '\0' && IsVisible(store, i))
+                    fmt::format_to(fmt::appender(out), "    {} E{}\n", gl_mermaidkinds[static_cast<uint32_t>(kinds[i])], i);
+
+            /* Notes attached by an association belong to the classifier; packages cannot be connected. */
+            std::vector<uint32_t> attached(n, gl_textnone);
+            for (TextLink const &link : outline.links) {
+                bool const sourcenote = kinds[link.source] == sdk::ElementKind::Note;
+                bool const targetnote = kinds[link.target] == sdk::ElementKind::Note;
+                if (sourcenote != targetnote) {
+                    uint32_t const note  = sourcenote ? link.source : link.target;
+                    uint32_t const other = sourcenote ? link.target : link.source;
+                    if (kinds[other] != sdk::ElementKind::Package && attached[note] == gl_textnone)
+                        attached[note] = other;
+
+                    continue;
+                }
+                if (sourcenote || kinds[link.source] == sdk::ElementKind::Package || kinds[link.target] == sdk::ElementKind::Package)
+                    continue;
+
+                fmt::format_to(fmt::appender(out), "    E{} -- E{}", link.source, link.target);
+                if (!names[link.element].empty()) {
+                    out.append(std::string_view(" : "));
+                    AppendLabel(out, TextFormat::Mermaid, names[link.element].view());
+                }
+                out.push_back('\n');
+            }
+
+            for (uint32_t const i : outline.members) {
+                if (kinds[i] != sdk::ElementKind::Note)
+                    continue;
+
+                out.append(std::string_view("    note "));
+                if (attached[i] != gl_textnone)
+                    fmt::format_to(fmt::appender(out), "for E{} ", attached[i]);
+                out.push_back('"');
+                AppendLabel(out, TextFormat::Mermaid, names[i].view());
+                out.append(std::string_view("\"\n"));
+            }
+
+            out.append(std::string_view("```\n\n"));
+        }
+    }
+
+
+    bool TextFormatOf(std::string_view path, TextFormat &format) noexcept {
+        try {
+            std::string ext = std::filesystem::path(path).extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char const c) { return static_cast<char>(std::tolower(c)); });
+
+            if (ext == ".puml" || ext == ".plantuml")
+                format = TextFormat::PlantUml;
+            else if (ext == ".md" || ext == ".markdown")
+                format = TextFormat::Mermaid;
+            else
+                return false;
+
+            return true;
+        } catch (...) { }
+
+        return false;
+    }
+
+    void AppendDiagramText(fmt::memory_buffer &out, TextFormat format, std::string_view name, sdk::ElementStore const &store) {
+        internal::TextOutline outline;
+        internal::Outline(store, outline);
+
+        if (format == TextFormat::Mermaid)
+            internal::AppendMermaid(out, name, store, outline);
+        else
+            internal::AppendPlantUml(out, name, store, outline);
+    }
+
+    sdk::ErrorCode ExportText(char const *path, TextFormat format, std::vector<TextDiagram> const &diagrams, JobContext *job) noexcept {
+        if (path == nullptr || std::any_of(diagrams.begin(), diagrams.end(), [](TextDiagram const &diagram) { return diagram.store == nullptr; }))
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            QSaveFile file(QString::fromUtf8(path));
+            if (!file.open(QIODevice::WriteOnly))
+                return sdk::ErrorCode::OpenFile;
+
+            /* Buffers keep their capacity from one batch to the next; text is never concatenated into strings. */
+            size_t const                    batch = internal::gl_textbatch * static_cast<size_t>(std::max(1, QThread::idealThreadCount()));
+            std::vector<fmt::memory_buffer> pool(std::min(batch, std::max<size_t>(diagrams.size(), 1)));
+            for (size_t first = 0; first < diagrams.size(); first += pool.size()) {
+                if (job != nullptr) {
+                    if (job->isCancelled()) {
+                        file.cancelWriting();
+
+                        return sdk::ErrorCode::NoOperation;
+                    }
+
+                    job->report(static_cast<double>(first) / static_cast<double>(diagrams.size()), "Writing text");
+                }
+
+                size_t const count = std::min(pool.size(), diagrams.size() - first);
+                sdk::ParallelFor(count, [&](size_t const i) {
+                    pool[i].clear();
+
+                    AppendDiagramText(pool[i], format, diagrams[first + i].name, *diagrams[first + i].store);
+                });
+
+                for (size_t i = 0; i < count; ++i)
+                    if (file.write(pool[i].data(), static_cast<qint64>(pool[i].size())) != static_cast<qint64>(pool[i].size()))
+                        return sdk::ErrorCode::WriteFile;
+            }
+
+            if (!file.commit())
+                return sdk::ErrorCode::WriteFile;
+
+            if (job != nullptr)
+                job->report(1.0, "Writing text");
+            return sdk::ErrorCode::Ok;
+        } catch (std::bad_alloc const &) {
+            return sdk::ErrorCode::CriticalResource;
+        } catch (...) { }
+
+        return sdk::ErrorCode::WriteFile;
+    }
+}
+
+
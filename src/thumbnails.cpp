@@ -0,0 +1,355 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  thumbnails.cpp
+ * \brief implementation of the thumbnail cache of the toolbox
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <system_error>
+
+/* external includes */
+#include <QMetaObject>
+#include <QPainter>
+#include <QSaveFile>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/util.hpp>
+
+/* app includes */
+#include <budget.hpp>
+#include <renderer.hpp>
+#include <thumbnails.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        constexpr uint32_t gl_thumbformat = 1;     /**< version of the way thumbnails are drawn; part of every file name */
+        constexpr double   gl_thumbwidth  = 120.0; /**< width of the element drawn, in scene units */
+        constexpr double   gl_thumbheight = 80.0;  /**< height of the element drawn, in scene units */
+        constexpr double   gl_thumbmargin = 3.0;   /**< space around the element, in device-independent pixels */
+
+        /**
+         * \brief  computes the file name of a thumbnail in the disk cache
+         *
+         * \param  [in] entry entry of the toolbox
+         * \param  [in] theme name of the theme
+         * \param  [in] ratio device pixel ratio
+         *
+         * \return file name, without the directory
+         * \throw  std::bad_alloc
+         */
+        static std::string ThumbFileOf(ToolboxEntry const &entry, std::string const &theme, double const ratio) {
+            uint64_t hash = sdk::util::gl_hashseed;
+            for (std::string const *field : { &entry.plugin, &entry.version, &entry.name, &theme })
+                hash = sdk::util::HashBytes(field->c_str(), field->size() + 1, hash);
+
+            uint64_t const params[] = { static_cast<uint64_t>(std::lround(ratio * 100.0)), static_cast<uint64_t>(ThumbnailCache::gl_thumbsize), gl_thumbformat };
+            hash = sdk::util::HashBytes(reinterpret_cast<char const *>(params), sizeof params, hash);
+
+            char name[32];
+            std::snprintf(name, sizeof name, "%016" PRIx64 ".png", hash);
+            return name;
+        }
+
+        /**
+         * \brief  maps the name of a toolbox entry to the kind of element it creates
+         *
+         * \param  [in] name name of the entry, e.g. "Class"; compared without regard to ASCII case
+         *
+         * \return kind of the element; entries of other shapes are drawn as classes
+         */
+        static sdk::ElementKind ThumbKindOf(std::string const &name) noexcept {
+            for (size_t i = 0; i < std::size(sdk::gl_kindlabels); ++i) {
+                char const *const kind = sdk::gl_kindlabels[i];
+
+                size_t j = 0;
+                while (j < name.size() && kind[j] != '\0' && (name[j] | 0x20) == (kind[j] | 0x20))
+                    ++j;
+                if (j == name.size() && kind[j] == '\0')
+                    return static_cast<sdk::ElementKind>(i);
+            }
+
+            return sdk::ElementKind::Class;
+        }
+
+        /**
+         * \brief  draws the thumbnail of a toolbox entry
+         *
+         * \param  [in] entry entry of the toolbox
+         * \param  [in] styles style sheet of the theme; may be *nullptr*
+         * \param  [in] ratio device pixel ratio
+         *
+         * \return thumbnail
+         */
+        static QImage RenderThumbnail(ToolboxEntry const &entry, std::shared_ptr<StyleSheet const> const &styles, double const ratio) {
+            int const size = static_cast<int>(std::lround(ThumbnailCache::gl_thumbsize * ratio));
+
+            QImage image(size, size, QImage::Format_ARGB32_Premultiplied);
+            image.fill(Qt::transparent);
+
+            /* The element is scaled to fit, centered, like a diagram zoomed out to fit the box. */
+            double const           avail = ThumbnailCache::gl_thumbsize - 2.0 * gl_thumbmargin;
+            double const           scale = avail / std::max(gl_thumbwidth, gl_thumbheight) * ratio;
+            sdk::ElementKind const kind  = ThumbKindOf(entry.name);
+
+            DiagramRenderer render;
+            render.setStyles(styles);
+
+            std::vector<RenderItem> const items = { { kind, { 0.0f, 0.0f, static_cast<float>(gl_thumbwidth), static_cast<float>(gl_thumbheight) }, sdk::StringId(), styles != nullptr ? styles->resolve(kind, 0, 0) : 0, 0 } };
+            {
+                QPainter painter(&image);
+                painter.setRenderHint(QPainter::Antialiasing);
+                painter.translate((size - gl_thumbwidth * scale) / 2.0, (size - gl_thumbheight * scale) / 2.0);
+                painter.scale(scale, scale);
+                render.render(painter, items, DetailLevel::Full);
+            }
+
+            image.setDevicePixelRatio(ratio);
+            return image;
+        }
+
+        /**
+         * \brief  loads a thumbnail from the disk cache, or draws and stores it; may run on any thread
+         *
+         * \param  [in] dir directory of the disk cache
+         * \param  [in] file file name of the thumbnail
+         * \param  [in] entry entry of the toolbox
+         * \param  [in] styles style sheet of the theme; may be *nullptr*
+         * \param  [in] ratio device pixel ratio
+         *
+         * \return thumbnail
+         */
+        static QImage PrepareThumbnail(std::string const &dir, std::string const &file, ToolboxEntry const &entry, std::shared_ptr<StyleSheet const> const &styles, double const ratio) {
+            std::string const path = dir + '/' + file;
+            int const         size = static_cast<int>(std::lround(ThumbnailCache::gl_thumbsize * ratio));
+
+            QImage cached;
+            if (cached.load(QString::fromUtf8(path.c_str()), "PNG") && cached.width() == size && cached.height() == size) {
+                cached.setDevicePixelRatio(ratio);
+
+                return cached;
+            }
+
+            QImage image = RenderThumbnail(entry, styles, ratio);
+
+            /* The disk cache is only an optimization; the thumbnail is used even if it cannot be stored. */
+            std::error_code err;
+            std::filesystem::create_directories(std::filesystem::u8path(dir), err);
+
+            QSaveFile out(QString::fromUtf8(path.c_str()));
+            if (!out.open(QIODevice::WriteOnly) || !image.save(&out, "PNG") || !out.commit())
+                SZSDK_APP_WARNING("Could not store the thumbnail of toolbox entry \"{}\" in \"{}\".", entry.name, path);
+
+            return image;
+        }
+    }
+
+
+    ThumbnailCache::ThumbnailCache(std::string dir, QObject *parent) noexcept
+        : QObject(parent), m_dir(std::move(dir)), m_bytes(0), m_ratio(1.0), m_fratio(0.0), m_gen(0), m_budget(0)
+    {
+        try {
+            m_budget = MemoryBudget::Shared().add({
+                "thumbnails", gl_cost,
+                [this]() { return m_bytes; },
+                [this]() {
+                    size_t const n    = m_images.size();
+                    size_t const slot = coldest();
+
+                    if (slot == 2 * n)
+                        return int64_t(-1);
+                    return MemoryBudget::Now() - (slot < n ? m_used[slot] : m_fused[slot - n]);
+                },
+                [this]() { return drop(coldest()); }
+            });
+        } catch (...) { }
+    }
+
+    ThumbnailCache::~ThumbnailCache() {
+        MemoryBudget::Shared().remove(m_budget);
+
+        /* Tasks refer to the cache, including cancelled ones; results posted meanwhile are discarded along with it. */
+        for (auto const &[index, task] : m_pending)
+            task.cancel();
+        for (auto const &[index, task] : m_pending)
+            task.wait();
+        m_retired.wait();
+    }
+
+
+    std::vector<ToolboxEntry> ThumbnailCache::EntriesOf(std::vector<PluginManifest> const &manifests) {
+        std::vector<ToolboxEntry> res;
+        for (char const *kind : sdk::gl_kindlabels)
+            res.push_back({ std::string(), std::string(), kind });
+
+        for (PluginManifest const &manifest : manifests)
+            for (std::string const &name : manifest.toolbox)
+                res.push_back({ manifest.name, manifest.version, name });
+
+        return res;
+    }
+
+    void ThumbnailCache::setEntries(std::vector<ToolboxEntry> entries) noexcept {
+        m_entries = std::move(entries);
+
+        reset();
+    }
+
+    void ThumbnailCache::setTheme(std::shared_ptr<StyleSheet const> styles, std::string theme) noexcept {
+        m_styles = std::move(styles);
+        m_theme  = std::move(theme);
+
+        reset();
+    }
+
+    void ThumbnailCache::setPixelRatio(double ratio) noexcept {
+        if (ratio == m_ratio || !(ratio > 0.0))
+            return;
+
+        SZSDK_APP_DEBUG("Thumbnails switch from device pixel ratio {} to {}.", m_ratio, ratio);
+
+        /* Thumbnails being rendered for the current ratio would be delivered into the wrong slot. */
+        cancel();
+
+        /* The current thumbnails are kept; those of the ratio before are only of use if it returns. */
+        std::swap(m_images, m_former);
+        std::swap(m_used, m_fused);
+        if (m_fratio != ratio)
+            for (size_t i = 0; i < m_images.size(); ++i)
+                drop(i);
+        m_fratio = m_ratio;
+        m_ratio  = ratio;
+
+        /* The former slot is empty before the first change. */
+        if (m_images.size() != m_entries.size()) {
+            try {
+                m_images.assign(m_entries.size(), QImage());
+                m_used.assign(m_entries.size(), 0);
+            } catch (...) {
+                reset();
+            }
+        }
+    }
+
+    QImage const *ThumbnailCache::find(size_t index) noexcept {
+        if (index >= m_images.size())
+            return nullptr;
+        if (!m_images[index].isNull()) {
+            m_used[index] = MemoryBudget::Now();
+
+            return &m_images[index];
+        }
+
+        /* While the thumbnail renders, the one of the previous ratio stands in, scaled. */
+        QImage *const former = index < m_former.size() && !m_former[index].isNull() ? &m_former[index] : nullptr;
+        if (former != nullptr)
+            m_fused[index] = MemoryBudget::Now();
+        if (m_pending.find(index) != m_pending.end())
+            return former;
+
+        try {
+            sdk::TaskHandle task = sdk::SubmitTask([this, index, gen = m_gen, dir = m_dir, file = internal::ThumbFileOf(m_entries[index], m_theme, m_ratio), entry = m_entries[index], styles = m_styles, ratio = m_ratio]() {
+                if (sdk::IsTaskCancelled())
+                    return;
+
+                QImage image = internal::PrepareThumbnail(dir, file, entry, styles, ratio);
+                QMetaObject::invokeMethod(this, [this, index, gen, image = std::move(image)]() mutable {
+                    deliver(index, gen, std::move(image));
+                }, Qt::QueuedConnection);
+            }, sdk::TaskPriority::Low);
+            if (task.isValid())
+                m_pending.emplace(index, std::move(task));
+        } catch (...) { }
+
+        return former;
+    }
+
+
+    void ThumbnailCache::reset() noexcept {
+        cancel();
+
+        m_bytes  = 0;
+        m_fratio = 0.0;
+        m_former.clear();
+        m_fused.clear();
+        try {
+            m_images.assign(m_entries.size(), QImage());
+            m_used.assign(m_entries.size(), 0);
+        } catch (...) {
+            m_images.clear();
+            m_used.clear();
+        }
+    }
+
+    void ThumbnailCache::cancel() noexcept {
+        for (auto const &[index, task] : m_pending)
+            m_retired.retire(task);
+        m_pending.clear();
+        ++m_gen;
+    }
+
+    void ThumbnailCache::deliver(size_t index, uint64_t gen, QImage image) noexcept {
+        if (gen != m_gen)
+            return;
+
+        m_pending.erase(index);
+        if (index >= m_images.size() || image.isNull())
+            return;
+
+        m_bytes        += static_cast<size_t>(image.sizeInBytes()) - static_cast<size_t>(m_images[index].sizeInBytes());
+        m_images[index] = std::move(image);
+        m_used[index]   = MemoryBudget::Now();
+        if (m_ready)
+            m_ready(index);
+
+        MemoryBudget::Shared().enforce();
+    }
+
+    size_t ThumbnailCache::coldest() const noexcept {
+        size_t const n    = m_images.size();
+        size_t       res  = 2 * n;
+        int64_t      used = 0;
+        for (size_t i = 0; i < n; ++i)
+            if (!m_images[i].isNull() && (res == 2 * n || m_used[i] < used)) {
+                res  = i;
+                used = m_used[i];
+            }
+        for (size_t i = 0; i < m_former.size() && i < n; ++i)
+            if (!m_former[i].isNull() && (res == 2 * n || m_fused[i] < used)) {
+                res  = n + i;
+                used = m_fused[i];
+            }
+
+        return res;
+    }
+
+    size_t ThumbnailCache::drop(size_t slot) noexcept {
+        size_t const n = m_images.size();
+        if (slot >= 2 * n || (slot >= n && slot - n >= m_former.size()))
+            return 0;
+
+        QImage      &image = slot < n ? m_images[slot] : m_former[slot - n];
+        size_t const bytes = static_cast<size_t>(image.sizeInBytes());
+        image    = QImage();
+        m_bytes -= bytes;
+        return bytes;
+    }
+}
+
+
@@ -0,0 +1,195 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  tiles.cpp
+ * \brief implementation of the cache of rendered diagram tiles
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/memory.hpp>
+
+/* app includes */
+#include <budget.hpp>
+#include <tiles.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \brief  retrieves the memory account of rendered tiles
+         *
+         * \return id of the account *"tiles"*
+         */
+        static uint32_t GetMemoryAccount() noexcept {
+            static uint32_t const gl_account = sdk::internal::RegisterAccount("tiles");
+
+            return gl_account;
+        }
+    }
+
+
+    TileCache::TileCache(size_t budget) noexcept
+        : m_budget(budget), m_bytes(0), m_consumer(0)
+    {
+        try {
+            m_consumer = MemoryBudget::Shared().add({
+                "tiles", gl_cost,
+                [this]() { return m_bytes; },
+                [this]() {
+                    auto const it = coldest();
+
+                    return it == m_tiles.end() ? int64_t(-1) : MemoryBudget::Now() - it->second.lastuse;
+                },
+                [this]() {
+                    auto const it = coldest();
+                    if (it == m_tiles.end())
+                        return size_t(0);
+
+                    size_t const bytes = static_cast<size_t>(it->second.image.sizeInBytes());
+                    m_bytes -= bytes;
+                    sdk::internal::TrackMemory(internal::GetMemoryAccount(), -static_cast<int64_t>(bytes));
+                    m_tiles.erase(it);
+                    return bytes;
+                }
+            });
+        } catch (...) { }
+    }
+
+    TileCache::~TileCache() {
+        MemoryBudget::Shared().remove(m_consumer);
+
+        clear();
+    }
+
+
+    TileKey TileCache::KeyOf(double zoom, double ratio, int32_t x, int32_t y) noexcept {
+        uint64_t bits = 0, rbits = 0;
+        std::memcpy(&bits, &zoom, sizeof bits);
+        std::memcpy(&rbits, &ratio, sizeof rbits);
+
+        return { bits, x, y, rbits };
+    }
+
+    QRectF TileCache::SceneRect(TileKey const &key) noexcept {
+        double const size = gl_tilesize / (ZoomOf(key) * RatioOf(key));
+
+        return { key.x * size, key.y * size, size, size };
+    }
+
+    double TileCache::ZoomOf(TileKey const &key) noexcept {
+        double zoom = 0.0;
+        std::memcpy(&zoom, &key.zoom, sizeof zoom);
+
+        return zoom;
+    }
+
+    double TileCache::RatioOf(TileKey const &key) noexcept {
+        double ratio = 0.0;
+        std::memcpy(&ratio, &key.ratio, sizeof ratio);
+
+        return ratio;
+    }
+
+
+    TileCache::Tile const *TileCache::find(TileKey const &key) noexcept {
+        auto const it = m_tiles.find(key);
+        if (it == m_tiles.end())
+            return nullptr;
+
+        it->second.lastuse = MemoryBudget::Now();
+        return &it->second;
+    }
+
+    void TileCache::insert(TileKey const &key, QImage image, bool dirty) {
+        size_t const bytes = static_cast<size_t>(image.sizeInBytes());
+
+        auto const it = m_tiles.find(key);
+        if (it != m_tiles.end()) {
+            m_bytes -= static_cast<size_t>(it->second.image.sizeInBytes());
+            sdk::internal::TrackMemory(internal::GetMemoryAccount(), -static_cast<int64_t>(it->second.image.sizeInBytes()));
+
+            m_tiles.erase(it);
+        }
+        if (m_budget != 0)
+            evict(m_budget - std::min(m_budget, bytes));
+
+        m_tiles.emplace(key, Tile{ std::move(image), dirty, MemoryBudget::Now() });
+        m_bytes += bytes;
+        sdk::internal::TrackMemory(internal::GetMemoryAccount(), static_cast<int64_t>(bytes));
+
+        MemoryBudget::Shared().enforce();
+    }
+
+    void TileCache::invalidate(QRectF const &region) noexcept {
+        for (auto &[key, tile] : m_tiles)
+            if (!tile.dirty && SceneRect(key).intersects(region))
+                tile.dirty = true;
+    }
+
+    void TileCache::invalidateBelow(double zoom) noexcept {
+        for (auto &[key, tile] : m_tiles)
+            if (!tile.dirty && ZoomOf(key) < zoom)
+                tile.dirty = true;
+    }
+
+    void TileCache::setBudget(size_t budget) noexcept {
+        m_budget = budget;
+
+        if (budget != 0)
+            evict(budget);
+    }
+
+    void TileCache::clear() noexcept {
+        m_tiles.clear();
+
+        sdk::internal::TrackMemory(internal::GetMemoryAccount(), -static_cast<int64_t>(m_bytes));
+        m_bytes = 0;
+    }
+
+
+    void TileCache::evict(size_t limit) noexcept {
+        if (m_bytes <= limit)
+            return;
+
+        try {
+            std::vector<std::pair<int64_t, TileKey>> order;
+            order.reserve(m_tiles.size());
+            for (auto const &[key, tile] : m_tiles)
+                order.emplace_back(tile.lastuse, key);
+            std::sort(order.begin(), order.end(), [](auto const &a, auto const &b) { return a.first < b.first; });
+
+            for (auto const &[lastuse, key] : order) {
+                if (m_bytes <= limit)
+                    break;
+
+                auto const it = m_tiles.find(key);
+                m_bytes -= static_cast<size_t>(it->second.image.sizeInBytes());
+                sdk::internal::TrackMemory(internal::GetMemoryAccount(), -static_cast<int64_t>(it->second.image.sizeInBytes()));
+                m_tiles.erase(it);
+            }
+        } catch (...) {
+            /* Without memory to sort, drop everything. */
+            clear();
+        }
+    }
+
+    TileCache::TileMap::iterator TileCache::coldest() noexcept {
+        return std::min_element(m_tiles.begin(), m_tiles.end(), [](auto const &a, auto const &b) { return a.second.lastuse < b.second.lastuse; });
+    }
+}
+
+
@@ -0,0 +1,242 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  traceloader.cpp
+ * \brief implementation of the background import of traces into sequence diagrams
+ */
+
+
+/* stdlib includes */
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/traceimport.hpp>
+
+/* app includes */
+#include <traceloader.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \struct suzu::internal::TraceQueue
+         * \brief  batches handed from the import job to the GUI thread
+         */
+        struct TraceQueue {
+            std::mutex                     m_lock;    /**< guards all other members */
+            std::deque<sdk::SequenceBatch> m_batches; /**< batches read but not added yet */
+            bool                           m_done;    /**< whether or not the job has ended */
+            sdk::ErrorCode                 m_result;  /**< result of the job, once done */
+            std::string                    m_error;   /**< description of the error, if any */
+            std::string                    m_path;    /**< path of the trace */
+        };
+
+
+        /**
+         * \brief  takes at most a number of entries from the back of a vector
+         *
+         * \param [in,out] from entries; loses the ones taken
+         * \param [in] n most entries to take
+         * \return entries taken
+         * \throw std::bad_alloc
+         */
+        template<class T> static std::vector<T> TakeBack(std::vector<T> &from, size_t const n) {
+            std::vector<T> result;
+            if (from.size() <= n) {
+                result.swap(from);
+            } else {
+                result.assign(from.end() - static_cast<ptrdiff_t>(n), from.end());
+                from.resize(from.size() - n);
+            }
+
+            return result;
+        }
+
+        /**
+         * \brief  takes a slice of a batch, small enough to be added to the model within the budget
+         *
+         * The slice contains all new lifelines, so that the rest of the batch only refers to lifelines
+         * that have been added by then.
+         *
+         * \param [in,out] batch batch; loses the entries taken
+         * \param [in] n most messages, activations and fragments each to take
+         * \return slice
+         * \throw std::bad_alloc
+         */
+        static sdk::SequenceBatch TakeSlice(sdk::SequenceBatch &batch, size_t const n) {
+            sdk::SequenceBatch slice;
+
+            slice.lifelines.swap(batch.lifelines);
+            slice.messages    = TakeBack(batch.messages, n);
+            slice.activations = TakeBack(batch.activations, n);
+            slice.fragments   = TakeBack(batch.fragments, n);
+            return slice;
+        }
+    }
+
+
+    TraceLoader::TraceLoader(JobManager &jobs, sdk::SequenceModel &model) noexcept
+        : m_jobs(jobs), m_model(model), m_job(0)
+    {
+        try {
+            m_timer = std::make_unique<QTimer>();
+
+            QObject::connect(m_timer.get(), &QTimer::timeout, m_timer.get(), [this]() { drain(); });
+        } catch (...) { }
+    }
+
+    TraceLoader::~TraceLoader() {
+        cancel();
+    }
+
+
+    sdk::ErrorCode TraceLoader::start(std::string path, Changed changed, Done done) noexcept {
+        if (isRunning())
+            return sdk::ErrorCode::InvalidState;
+        if (m_timer == nullptr)
+            return sdk::ErrorCode::CriticalResource;
+
+        try {
+            auto queue = std::make_shared<internal::TraceQueue>();
+            queue->m_done   = false;
+            queue->m_result = sdk::ErrorCode::Ok;
+            queue->m_path   = std::move(path);
+
+            uint64_t const job = m_jobs.start("Import trace \"" + queue->m_path + "\"", [queue](JobContext &ctx) {
+                uint64_t    messages = 0;
+                std::string error;
+
+                sdk::ErrorCode const err = sdk::ImportTraceSequence(queue->m_path.c_str(), [&](sdk::SequenceBatch &batch) {
+                    if (ctx.isCancelled())
+                        return false;
+
+                    messages += batch.messages.size();
+                    {
+                        std::lock_guard<std::mutex> lock(queue->m_lock);
+
+                        queue->m_batches.push_back(std::move(batch));
+                    }
+                    ctx.report(0.0, std::to_string(messages) + " messages read");
+                    return true;
+                }, &error);
+
+                std::lock_guard<std::mutex> lock(queue->m_lock);
+                queue->m_done   = true;
+                queue->m_result = err;
+                queue->m_error  = std::move(error);
+                return err == sdk::ErrorCode::Ok;
+            }, sdk::TaskPriority::Low);
+            if (job == 0)
+                return sdk::ErrorCode::CriticalResource;
+
+            m_model.clear();
+            m_changed = std::move(changed);
+            m_done    = std::move(done);
+            m_queue   = std::move(queue);
+            m_job     = job;
+        } catch (...) {
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        m_timer->start(gl_interval);
+        return sdk::ErrorCode::Ok;
+    }
+
+    void TraceLoader::cancel() noexcept {
+        if (!isRunning())
+            return;
+
+        /* The job may still hold the queue; it stops at the next batch. */
+        m_jobs.cancel(m_job);
+        m_timer->stop();
+
+        m_queue.reset();
+        m_job = 0;
+    }
+
+
+    void TraceLoader::drain() noexcept {
+        using Clock = std::chrono::steady_clock;
+
+        if (!isRunning())
+            return;
+
+        Clock::time_point const begin = Clock::now();
+        bool                    grown = false;
+        bool                    done  = false;
+        sdk::ErrorCode          err   = sdk::ErrorCode::Ok;
+        try {
+            for (;;) {
+                sdk::SequenceBatch batch;
+                {
+                    std::lock_guard<std::mutex> lock(m_queue->m_lock);
+
+                    if (m_queue->m_batches.empty()) {
+                        done = m_queue->m_done;
+
+                        break;
+                    }
+                    /* Large batches are added in slices, so that the budget is checked in between. */
+                    batch = internal::TakeSlice(m_queue->m_batches.front(), gl_slice);
+                    if (m_queue->m_batches.front().empty())
+                        m_queue->m_batches.pop_front();
+                }
+
+                /* Entries referring to lifelines the trace never declared leave the model unchanged. */
+                err = m_model.append(batch);
+                if (err != sdk::ErrorCode::Ok)
+                    break;
+
+                grown = true;
+                if (std::chrono::duration<double, std::milli>(Clock::now() - begin).count() >= gl_budget)
+                    break;
+            }
+        } catch (...) {
+            err = sdk::ErrorCode::CriticalResource;
+        }
+        if (err != sdk::ErrorCode::Ok) {
+            SZSDK_APP_WARNING("Could not add trace \"{}\" to the sequence diagram (error {}); the import was cancelled.", m_queue->m_path, static_cast<int>(err));
+
+            cancel();
+            if (m_changed)
+                m_changed();
+            return;
+        }
+
+        if (grown && m_changed)
+            m_changed();
+        if (!done)
+            return;
+
+        sdk::ErrorCode result;
+        {
+            std::lock_guard<std::mutex> lock(m_queue->m_lock);
+
+            result = m_queue->m_result;
+            if (result == sdk::ErrorCode::Ok)
+                SZSDK_APP_INFO("Imported trace \"{}\": {} lifelines, {} messages, {} loops.", m_queue->m_path, m_model.lifelineCount(), m_model.size(), m_model.fragmentCount());
+            else
+                SZSDK_APP_WARNING("Could not import trace \"{}\": {}", m_queue->m_path, m_queue->m_error.empty() ? sdk::ErrorDescription(result) : std::string_view(m_queue->m_error));
+        }
+
+        m_timer->stop();
+        m_queue.reset();
+        m_job = 0;
+
+        if (m_done)
+            m_done(result);
+    }
+}
+
+
@@ -0,0 +1,851 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  undo.cpp
+ * \brief implementation of the command-log undo stack
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cstring>
+
+/* sdk includes */
+#include <sdk/memory.hpp>
+
+/* app includes */
+#include <budget.hpp>
+#include <undo.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \enum  suzu::internal::UndoOp
+         * \brief kind of a recorded delta
+         *
+         * Every delta is encoded as *[op][payload][op]*. The trailing op lets entries be played
+         * backwards without an index.
+         */
+        enum class UndoOp : uint8_t {
+            Create,  /**< element created; element payload */
+            Destroy, /**< element destroyed; element payload */
+            Move,    /**< bounds changed; handle, old bounds, new bounds */
+            Style,   /**< style changed; handle, old style, new style */
+            Flags,   /**< flags changed; handle, old flags, new flags */
+            Name,    /**< name changed; handle, old name, new name */
+            Raise    /**< element raised; handle, old dense index */
+        };
+
+        /**
+         * \struct suzu::internal::ElementRecord
+         * \brief  payload of *UndoOp::Create* and *UndoOp::Destroy*
+         */
+        struct ElementRecord {
+            uint64_t         handle;    /**< recorded handle of the element */
+            uint64_t         parent;    /**< recorded handle of the parent element */
+            uint64_t         displaced; /**< recorded handle of the element that moved into the hole */
+            sdk::ElementRect bounds;    /**< bounding box */
+            uint32_t         kind;      /**< *suzu::sdk::ElementKind* */
+            uint32_t         style;     /**< style id */
+            uint32_t         flags;     /**< *suzu::sdk::ElementFlags* */
+            uint32_t         name;      /**< interned name */
+            uint32_t         depth;     /**< dense index */
+        };
+
+        static_assert(sizeof(sdk::ElementRect) == 16, "the delta sizes assume 16-byte bounding boxes");
+
+        /**
+         * \brief size of an encoded delta, by *UndoOp*
+         */
+        static constexpr size_t gl_deltasizes[] = { 62, 62, 42, 18, 18, 18, 14 };
+        /**
+         * \brief initial capacity of entries that are likely to receive more deltas
+         */
+        static constexpr size_t gl_minreserve   = 256;
+
+        /**
+         * \brief  retrieves the size of an encoded delta
+         *
+         * \param  [in] op kind of the delta
+         *
+         * \return size, in bytes, including both op bytes
+         */
+        static constexpr size_t GetDeltaSize(UndoOp const op) noexcept {
+            return gl_deltasizes[static_cast<uint8_t>(op)];
+        }
+
+        /**
+         * \brief appends a value to an encoded entry
+         *
+         * \param [in,out] data entry data; must have enough spare capacity
+         * \param [in] value value to append
+         */
+        template<class T> static void Put(std::vector<uint8_t> &data, T const &value) noexcept {
+            uint8_t const *const bytes = reinterpret_cast<uint8_t const *>(&value);
+
+            data.insert(data.end(), bytes, bytes + sizeof(T));
+        }
+
+        /**
+         * \brief  reads a value from an encoded entry
+         *
+         * \param  [in,out] pos read position; advanced past the value
+         *
+         * \return value
+         */
+        template<class T> static T Get(uint8_t const *&pos) noexcept {
+            T value;
+            std::memcpy(&value, pos, sizeof(T));
+
+            pos += sizeof(T);
+            return value;
+        }
+
+        static void PutElement(std::vector<uint8_t> &data, UndoOp const op, ElementRecord const &rec) noexcept {
+            Put(data, op);
+            Put(data, rec.handle);
+            Put(data, rec.parent);
+            Put(data, rec.displaced);
+            Put(data, rec.bounds);
+            Put(data, rec.kind);
+            Put(data, rec.style);
+            Put(data, rec.flags);
+            Put(data, rec.name);
+            Put(data, rec.depth);
+            Put(data, op);
+        }
+
+        static ElementRecord GetElement(uint8_t const *pos) noexcept {
+            ElementRecord rec;
+            rec.handle    = Get<uint64_t>(pos);
+            rec.parent    = Get<uint64_t>(pos);
+            rec.displaced = Get<uint64_t>(pos);
+            rec.bounds    = Get<sdk::ElementRect>(pos);
+            rec.kind      = Get<uint32_t>(pos);
+            rec.style     = Get<uint32_t>(pos);
+            rec.flags     = Get<uint32_t>(pos);
+            rec.name      = Get<uint32_t>(pos);
+            rec.depth     = Get<uint32_t>(pos);
+
+            return rec;
+        }
+
+        /**
+         * \brief  retrieves the memory account of undo history
+         *
+         * \return id of the account *"undo"*
+         */
+        static uint32_t GetMemoryAccount() noexcept {
+            static uint32_t const gl_account = sdk::internal::RegisterAccount("undo");
+
+            return gl_account;
+        }
+    }
+
+
+    UndoStack::UndoStack(sdk::ElementStore &store)
+        : m_store(store), m_changes(nullptr), m_bytes(0), m_depth(0), m_merge(0), m_grouped(false), m_open(false), m_budget(0)
+    {
+        gl_stacks.push_back(this);
+
+        try {
+            m_budget = MemoryBudget::Shared().add({
+                "undo", gl_cost,
+                [this]() { return m_bytes; },
+                [this]() { return canDropOldest() ? MemoryBudget::Now() - m_undo.front().time : int64_t(-1); },
+                [this]() { return dropOldest(); }
+            });
+        } catch (...) {
+            gl_stacks.pop_back();
+
+            throw;
+        }
+    }
+
+    UndoStack::~UndoStack() {
+        MemoryBudget::Shared().remove(m_budget);
+        clear();
+
+        gl_stacks.erase(std::find(gl_stacks.begin(), gl_stacks.end(), this));
+    }
+
+
+    void UndoStack::SetTotalBudget(size_t bytes) noexcept {
+        gl_budget = bytes;
+
+        Enforce();
+    }
+
+
+    void UndoStack::beginGroup(uint64_t merge) noexcept {
+        if (m_changes != nullptr)
+            m_changes->begin();
+        if (m_depth++ != 0)
+            return;
+
+        m_merge   = merge;
+        m_grouped = false;
+    }
+
+    void UndoStack::endGroup() noexcept {
+        if (m_depth == 0)
+            return;
+        if (m_changes != nullptr)
+            m_changes->end();
+        if (--m_depth != 0)
+            return;
+
+        m_grouped = false;
+        Enforce();
+    }
+
+
+    sdk::ElementHandle UndoStack::create(sdk::ElementKind kind, sdk::ElementRect const &bounds, uint32_t style, sdk::ElementHandle parent, sdk::StringId name) noexcept {
+        Entry              *entry = nullptr;
+        sdk::ElementHandle  handle;
+        try {
+            entry  = &prepare(0, internal::GetDeltaSize(internal::UndoOp::Create));
+            handle = m_store.create(kind, bounds, style, parent, name);
+        } catch (...) {
+            abandon();
+
+            return sdk::gl_nullelement;
+        }
+
+        internal::ElementRecord rec;
+        rec.handle    = handle.value();
+        rec.parent    = origin(parent).value();
+        rec.displaced = sdk::gl_nullelement.value();
+        rec.bounds    = bounds;
+        rec.kind      = static_cast<uint32_t>(kind);
+        rec.style     = style;
+        rec.flags     = 0;
+        rec.name      = name.value();
+        rec.depth     = m_store.indexOf(handle);
+        internal::PutElement(entry->data, internal::UndoOp::Create, rec);
+
+        notify(sdk::ElementAdded, handle);
+        commit();
+        return handle;
+    }
+
+    sdk::ErrorCode UndoStack::insert(sdk::ElementBatch const &batch, std::vector<sdk::ElementHandle> &handles) noexcept {
+        handles.clear();
+        if (batch.empty())
+            return sdk::ErrorCode::NoOperation;
+
+        Entry *entry = nullptr;
+        try {
+            entry = &prepare(0, internal::GetDeltaSize(internal::UndoOp::Create) * batch.size());
+        } catch (...) {
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        uint32_t const       base = m_store.size();
+        sdk::ErrorCode const err  = m_store.insert(batch, handles);
+        if (err != sdk::ErrorCode::Ok) {
+            abandon();
+
+            return err;
+        }
+
+        for (uint32_t i = 0; i < batch.size(); ++i) {
+            sdk::ElementBatch::Item const &item = batch.items()[i];
+
+            internal::ElementRecord rec;
+            rec.handle    = handles[i].value();
+            rec.parent    = item.parent != sdk::ElementBatch::gl_nobatch ? handles[item.parent].value() : origin(item.outer).value();
+            rec.displaced = sdk::gl_nullelement.value();
+            rec.bounds    = item.bounds;
+            rec.kind      = static_cast<uint32_t>(item.kind);
+            rec.style     = item.style;
+            rec.flags     = item.flags;
+            rec.name      = item.name.value();
+            rec.depth     = base + i;
+            internal::PutElement(entry->data, internal::UndoOp::Create, rec);
+        }
+
+        if (m_changes != nullptr)
+            m_changes->begin();
+        for (sdk::ElementHandle const handle : handles)
+            notify(sdk::ElementAdded, handle);
+        if (m_changes != nullptr)
+            m_changes->end();
+
+        commit();
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode UndoStack::translate(std::vector<sdk::ElementHandle> const &handles, float dx, float dy) noexcept {
+        if (handles.empty() || (dx == 0.0f && dy == 0.0f))
+            return sdk::ErrorCode::NoOperation;
+
+        Entry                        *entry = nullptr;
+        std::vector<sdk::ElementRect> before;
+        sdk::ErrorCode                err   = sdk::ErrorCode::Ok;
+        try {
+            before.reserve(handles.size());
+            for (sdk::ElementHandle const handle : handles) {
+                uint32_t const dense = m_store.indexOf(handle);
+                if (dense == UINT32_MAX)
+                    return sdk::ErrorCode::InvalidParameter;
+
+                before.push_back(m_store.bounds()[dense]);
+            }
+
+            entry = &prepare(0, internal::GetDeltaSize(internal::UndoOp::Move) * handles.size());
+            err   = m_store.translate(handles.data(), handles.size(), dx, dy);
+        } catch (...) {
+            err = sdk::ErrorCode::CriticalResource;
+        }
+        if (err != sdk::ErrorCode::Ok) {
+            abandon();
+
+            return err;
+        }
+
+        /* Like with *setBounds()*, moves of elements already moved in the entry are folded. */
+        for (size_t i = 0; i < handles.size(); ++i) {
+            sdk::ElementRect const after = m_store.bounds()[m_store.indexOf(handles[i])];
+            uint64_t const         key   = origin(handles[i]).value();
+
+            auto const it = m_moves.find(key);
+            if (it != m_moves.end()) {
+                std::memcpy(entry->data.data() + it->second + 1 + sizeof(uint64_t) + sizeof(sdk::ElementRect), &after, sizeof(sdk::ElementRect));
+
+                continue;
+            }
+
+            uint32_t const offset = static_cast<uint32_t>(entry->data.size());
+            internal::Put(entry->data, internal::UndoOp::Move);
+            internal::Put(entry->data, key);
+            internal::Put(entry->data, before[i]);
+            internal::Put(entry->data, after);
+            internal::Put(entry->data, internal::UndoOp::Move);
+
+            try {
+                m_moves.emplace(key, offset);
+            } catch (...) { }
+        }
+
+        if (m_changes != nullptr)
+            m_changes->begin();
+        for (sdk::ElementHandle const handle : handles)
+            notify(sdk::ElementModified, handle, sdk::PropertyBounds);
+        if (m_changes != nullptr)
+            m_changes->end();
+
+        commit();
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode UndoStack::destroy(sdk::ElementHandle handle) noexcept {
+        uint32_t const dense = m_store.indexOf(handle);
+        if (dense == UINT32_MAX)
+            return sdk::ErrorCode::InvalidParameter;
+
+        Entry *entry = nullptr;
+        try {
+            entry = &prepare(0, internal::GetDeltaSize(internal::UndoOp::Destroy));
+        } catch (...) {
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        /* The last element fills the hole; undoing has to put it back. */
+        uint32_t const last = m_store.size() - 1;
+
+        internal::ElementRecord rec;
+        rec.handle    = origin(handle).value();
+        rec.parent    = origin(m_store.parents()[dense]).value();
+        rec.displaced = (dense != last ? origin(m_store.handleAt(last)) : sdk::gl_nullelement).value();
+        rec.bounds    = m_store.bounds()[dense];
+        rec.kind      = static_cast<uint32_t>(m_store.kinds()[dense]);
+        rec.style     = m_store.styles()[dense];
+        rec.flags     = m_store.flags()[dense];
+        rec.name      = m_store.names()[dense].value();
+        rec.depth     = dense;
+        internal::PutElement(entry->data, internal::UndoOp::Destroy, rec);
+
+        notify(sdk::ElementRemoved, handle);
+        m_store.destroy(handle);
+        if (dense != last)
+            notify(sdk::ElementModified, m_store.handleAt(dense), sdk::PropertyOrder);
+        commit();
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode UndoStack::setBounds(sdk::ElementHandle handle, sdk::ElementRect const &bounds, uint64_t merge) noexcept {
+        uint32_t const dense = m_store.indexOf(handle);
+        if (dense == UINT32_MAX)
+            return sdk::ErrorCode::InvalidParameter;
+
+        sdk::ElementRect const before = m_store.bounds()[dense];
+        uint64_t const         key    = origin(handle).value();
+        Entry                 *entry  = nullptr;
+        try {
+            entry = &prepare(merge, internal::GetDeltaSize(internal::UndoOp::Move));
+
+            m_store.setBounds(handle, bounds);
+        } catch (...) {
+            abandon();
+
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        /* Fold repeated moves of an element into its first move in the entry. */
+        auto const it = m_moves.find(key);
+        if (it != m_moves.end()) {
+            std::memcpy(entry->data.data() + it->second + 1 + sizeof(uint64_t) + sizeof(sdk::ElementRect), &bounds, sizeof(sdk::ElementRect));
+
+            notify(sdk::ElementModified, handle, sdk::PropertyBounds);
+            commit();
+            return sdk::ErrorCode::Ok;
+        }
+
+        uint32_t const offset = static_cast<uint32_t>(entry->data.size());
+        internal::Put(entry->data, internal::UndoOp::Move);
+        internal::Put(entry->data, key);
+        internal::Put(entry->data, before);
+        internal::Put(entry->data, bounds);
+        internal::Put(entry->data, internal::UndoOp::Move);
+
+        /* Without the index, later moves are simply recorded as deltas of their own. */
+        try {
+            m_moves.emplace(key, offset);
+        } catch (...) { }
+
+        notify(sdk::ElementModified, handle, sdk::PropertyBounds);
+        commit();
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode UndoStack::setStyle(sdk::ElementHandle handle, uint32_t style) noexcept {
+        uint32_t const dense = m_store.indexOf(handle);
+        if (dense == UINT32_MAX)
+            return sdk::ErrorCode::InvalidParameter;
+
+        sdk::ErrorCode const err = recordValue(static_cast<uint8_t>(internal::UndoOp::Style), handle, m_store.styles()[dense], style);
+        if (err != sdk::ErrorCode::Ok)
+            return err;
+
+        m_store.styles()[dense] = style;
+        notify(sdk::ElementModified, handle, sdk::PropertyStyle);
+        return m_store.touch(handle);
+    }
+
+    sdk::ErrorCode UndoStack::setFlags(sdk::ElementHandle handle, uint32_t flags) noexcept {
+        uint32_t const dense = m_store.indexOf(handle);
+        if (dense == UINT32_MAX)
+            return sdk::ErrorCode::InvalidParameter;
+
+        sdk::ErrorCode const err = recordValue(static_cast<uint8_t>(internal::UndoOp::Flags), handle, m_store.flags()[dense], flags);
+        if (err != sdk::ErrorCode::Ok)
+            return err;
+
+        m_store.flags()[dense] = flags;
+        notify(sdk::ElementModified, handle, sdk::PropertyFlags);
+        return m_store.touch(handle);
+    }
+
+    sdk::ErrorCode UndoStack::setName(sdk::ElementHandle handle, sdk::StringId name) noexcept {
+        uint32_t const dense = m_store.indexOf(handle);
+        if (dense == UINT32_MAX)
+            return sdk::ErrorCode::InvalidParameter;
+
+        sdk::ErrorCode const err = recordValue(static_cast<uint8_t>(internal::UndoOp::Name), handle, m_store.names()[dense].value(), name.value());
+        if (err != sdk::ErrorCode::Ok)
+            return err;
+
+        m_store.names()[dense] = name;
+        notify(sdk::ElementModified, handle, sdk::PropertyName);
+        return m_store.touch(handle);
+    }
+
+    sdk::ErrorCode UndoStack::raise(sdk::ElementHandle handle) noexcept {
+        uint32_t const dense = m_store.indexOf(handle);
+        if (dense == UINT32_MAX)
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            Entry &entry = prepare(0, internal::GetDeltaSize(internal::UndoOp::Raise));
+
+            internal::Put(entry.data, internal::UndoOp::Raise);
+            internal::Put(entry.data, origin(handle).value());
+            internal::Put(entry.data, dense);
+            internal::Put(entry.data, internal::UndoOp::Raise);
+        } catch (...) {
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        m_store.raise(handle);
+        notify(sdk::ElementModified, handle, sdk::PropertyOrder);
+        commit();
+        return sdk::ErrorCode::Ok;
+    }
+
+
+    sdk::ErrorCode UndoStack::undo() noexcept {
+        if (m_depth != 0)
+            return sdk::ErrorCode::InvalidState;
+        if (m_undo.empty())
+            return sdk::ErrorCode::NoOperation;
+
+        try {
+            m_redo.reserve(m_redo.size() + 1);
+        } catch (...) {
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        seal(m_undo.back());
+        m_redo.push_back(std::move(m_undo.back()));
+        m_undo.pop_back();
+        m_open = false;
+        m_moves.clear();
+
+        if (m_changes != nullptr)
+            m_changes->begin();
+        play(m_redo.back(), false);
+        if (m_changes != nullptr)
+            m_changes->end();
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode UndoStack::redo() noexcept {
+        if (m_depth != 0)
+            return sdk::ErrorCode::InvalidState;
+        if (m_redo.empty())
+            return sdk::ErrorCode::NoOperation;
+
+        try {
+            m_undo.push_back(std::move(m_redo.back()));
+        } catch (...) {
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        m_redo.pop_back();
+        m_open = false;
+        m_moves.clear();
+
+        if (m_changes != nullptr)
+            m_changes->begin();
+        play(m_undo.back(), true);
+        if (m_changes != nullptr)
+            m_changes->end();
+        return sdk::ErrorCode::Ok;
+    }
+
+    sdk::ErrorCode UndoStack::abort() noexcept {
+        if (m_depth != 0)
+            return sdk::ErrorCode::InvalidState;
+        if (m_undo.empty())
+            return sdk::ErrorCode::NoOperation;
+
+        Entry const entry = std::move(m_undo.back());
+        m_undo.pop_back();
+        m_open = false;
+        m_moves.clear();
+
+        if (m_changes != nullptr)
+            m_changes->begin();
+        play(entry, false);
+        if (m_changes != nullptr)
+            m_changes->end();
+
+        account(SizeOf(entry), 0);
+        return sdk::ErrorCode::Ok;
+    }
+
+
+    sdk::ElementHandle UndoStack::resolve(sdk::ElementHandle handle) const noexcept {
+        auto const it = m_current.find(handle.value());
+
+        return it != m_current.end() ? it->second : handle;
+    }
+
+    void UndoStack::clear() noexcept {
+        for (Entry const &entry : m_undo)
+            account(SizeOf(entry), 0);
+        m_undo.clear();
+        dropRedo();
+
+        m_grouped = false;
+        m_open    = false;
+        m_moves.clear();
+    }
+
+
+    void UndoStack::notify(sdk::ChangeKind kind, sdk::ElementHandle handle, sdk::ChangeProperty prop) noexcept {
+        if (m_changes == nullptr)
+            return;
+
+        uint32_t const           dense  = m_store.indexOf(handle);
+        sdk::ElementHandle const parent = dense != UINT32_MAX ? m_store.parents()[dense] : sdk::gl_nullelement;
+
+        m_changes->record(kind, handle, parent, prop);
+    }
+
+    sdk::ElementHandle UndoStack::origin(sdk::ElementHandle handle) const noexcept {
+        auto const it = m_origin.find(handle.value());
+
+        return it != m_origin.end() ? it->second : handle;
+    }
+
+    void UndoStack::remap(sdk::ElementHandle recorded, sdk::ElementHandle current) {
+        auto const it = m_current.find(recorded.value());
+        if (it != m_current.end())
+            m_origin.erase(it->second.value());
+
+        m_current[recorded.value()] = current;
+        m_origin[current.value()]   = recorded;
+    }
+
+    UndoStack::Entry &UndoStack::prepare(uint64_t merge, size_t size) {
+        uint64_t const key = m_depth > 0 ? m_merge : merge;
+
+        /* Continue the open group, or merge into the newest entry. */
+        if (!m_undo.empty() && ((m_depth > 0 && m_grouped) || (key != 0 && m_open && m_undo.back().merge == key))) {
+            Entry       &entry = m_undo.back();
+            size_t const need  = entry.data.size() + size;
+            if (need > entry.data.capacity()) {
+                size_t const before = SizeOf(entry);
+                entry.data.reserve(std::max(need, entry.data.capacity() * 2));
+
+                account(before, SizeOf(entry));
+            }
+
+            m_grouped = m_depth > 0;
+            return entry;
+        }
+
+        Entry entry = { {}, key, 0, MemoryBudget::Now() };
+        entry.data.reserve(m_depth > 0 || key != 0 ? std::max(size, internal::gl_minreserve) : size);
+        m_undo.push_back(std::move(entry));
+
+        /* The previous entry is complete; give back its spare capacity. */
+        if (m_undo.size() > 1)
+            seal(m_undo[m_undo.size() - 2]);
+
+        m_undo.back().serial = ++gl_serial;
+        m_grouped = m_depth > 0;
+        m_open    = key != 0;
+        m_moves.clear();
+
+        account(0, SizeOf(m_undo.back()));
+        return m_undo.back();
+    }
+
+    sdk::ErrorCode UndoStack::recordValue(uint8_t op, sdk::ElementHandle handle, uint32_t before, uint32_t after) noexcept {
+        internal::UndoOp const kind = static_cast<internal::UndoOp>(op);
+
+        try {
+            Entry &entry = prepare(0, internal::GetDeltaSize(kind));
+
+            internal::Put(entry.data, kind);
+            internal::Put(entry.data, origin(handle).value());
+            internal::Put(entry.data, before);
+            internal::Put(entry.data, after);
+            internal::Put(entry.data, kind);
+        } catch (...) {
+            return sdk::ErrorCode::CriticalResource;
+        }
+
+        commit();
+        return sdk::ErrorCode::Ok;
+    }
+
+    void UndoStack::abandon() noexcept {
+        if (m_undo.empty() || !m_undo.back().data.empty())
+            return;
+
+        account(SizeOf(m_undo.back()), 0);
+        m_undo.pop_back();
+
+        m_grouped = false;
+        m_open    = false;
+        m_moves.clear();
+    }
+
+    void UndoStack::commit() noexcept {
+        dropRedo();
+
+        /* Budget checks of an open group wait until it is complete. */
+        if (m_depth == 0)
+            Enforce();
+    }
+
+    void UndoStack::seal(Entry &entry) noexcept {
+        if (entry.data.capacity() == entry.data.size())
+            return;
+
+        size_t const before = SizeOf(entry);
+        try {
+            entry.data.shrink_to_fit();
+        } catch (...) { }
+
+        account(before, SizeOf(entry));
+    }
+
+    void UndoStack::account(size_t before, size_t after) noexcept {
+        m_bytes  = m_bytes - before + after;
+        gl_total = gl_total - before + after;
+
+        sdk::internal::TrackMemory(internal::GetMemoryAccount(), static_cast<int64_t>(after) - static_cast<int64_t>(before));
+    }
+
+    void UndoStack::dropRedo() noexcept {
+        for (Entry const &entry : m_redo)
+            account(SizeOf(entry), 0);
+
+        m_redo.clear();
+    }
+
+    void UndoStack::play(Entry const &entry, bool forward) noexcept {
+        uint8_t const *const begin = entry.data.data();
+        uint8_t const *const end   = begin + entry.data.size();
+        uint8_t const       *pos   = forward ? begin : end;
+
+        /* Undoing plays the deltas back to front. */
+        while (pos != (forward ? end : begin)) {
+            internal::UndoOp op;
+            uint8_t const   *payload;
+            if (forward) {
+                op      = static_cast<internal::UndoOp>(*pos);
+                payload = pos + 1;
+                pos    += internal::GetDeltaSize(op);
+            } else {
+                op      = static_cast<internal::UndoOp>(pos[-1]);
+                pos    -= internal::GetDeltaSize(op);
+                payload = pos + 1;
+            }
+
+            try {
+                switch (op) {
+                    case internal::UndoOp::Create:
+                    case internal::UndoOp::Destroy: {
+                        internal::ElementRecord const rec    = internal::GetElement(payload);
+                        sdk::ElementHandle const      handle = sdk::ElementHandle::FromValue(rec.handle);
+
+                        if (forward == (op == internal::UndoOp::Destroy)) {
+                            sdk::ElementHandle const now   = resolve(handle);
+                            uint32_t const           dense = m_store.indexOf(now);
+
+                            notify(sdk::ElementRemoved, now);
+                            if (m_store.destroy(now) == sdk::ErrorCode::Ok && dense < m_store.size())
+                                notify(sdk::ElementModified, m_store.handleAt(dense), sdk::PropertyOrder);
+                            break;
+                        }
+
+                        /* Recreate the element, at its old position in the drawing order. */
+                        sdk::ElementHandle const now = m_store.create(
+                            static_cast<sdk::ElementKind>(rec.kind),
+                            rec.bounds,
+                            rec.style,
+                            resolve(sdk::ElementHandle::FromValue(rec.parent)),
+                            sdk::StringId::FromValue(rec.name)
+                        );
+                        m_store.flags()[m_store.indexOf(now)] = rec.flags;
+                        notify(sdk::ElementAdded, now);
+                        remap(handle, now);
+
+                        if (rec.depth < m_store.size() - 1) {
+                            sdk::ElementHandle const displaced = resolve(sdk::ElementHandle::FromValue(rec.displaced));
+
+                            m_store.reorder(now, rec.depth);
+                            m_store.reorder(displaced, m_store.size() - 1);
+                            notify(sdk::ElementModified, displaced, sdk::PropertyOrder);
+                        }
+                        break;
+                    }
+                    case internal::UndoOp::Move: {
+                        sdk::ElementHandle const handle = resolve(sdk::ElementHandle::FromValue(internal::Get<uint64_t>(payload)));
+                        sdk::ElementRect const   before = internal::Get<sdk::ElementRect>(payload);
+                        sdk::ElementRect const   after  = internal::Get<sdk::ElementRect>(payload);
+
+                        m_store.setBounds(handle, forward ? after : before);
+                        notify(sdk::ElementModified, handle, sdk::PropertyBounds);
+                        break;
+                    }
+                    case internal::UndoOp::Style:
+                    case internal::UndoOp::Flags:
+                    case internal::UndoOp::Name: {
+                        sdk::ElementHandle const handle = resolve(sdk::ElementHandle::FromValue(internal::Get<uint64_t>(payload)));
+                        uint32_t const           before = internal::Get<uint32_t>(payload);
+                        uint32_t const           after  = internal::Get<uint32_t>(payload);
+                        uint32_t const           value  = forward ? after : before;
+                        uint32_t const           dense  = m_store.indexOf(handle);
+                        if (dense == UINT32_MAX)
+                            break;
+
+                        if (op == internal::UndoOp::Style)
+                            m_store.styles()[dense] = value;
+                        else if (op == internal::UndoOp::Flags)
+                            m_store.flags()[dense] = value;
+                        else
+                            m_store.names()[dense] = sdk::StringId::FromValue(value);
+                        m_store.touch(handle);
+
+                        notify(sdk::ElementModified, handle, static_cast<sdk::ChangeProperty>(static_cast<uint32_t>(op) - static_cast<uint32_t>(internal::UndoOp::Style) + sdk::PropertyStyle));
+                        break;
+                    }
+                    case internal::UndoOp::Raise: {
+                        sdk::ElementHandle const handle = resolve(sdk::ElementHandle::FromValue(internal::Get<uint64_t>(payload)));
+                        uint32_t const           depth  = internal::Get<uint32_t>(payload);
+
+                        if (forward)
+                            m_store.raise(handle);
+                        else
+                            m_store.reorder(handle, depth);
+                        notify(sdk::ElementModified, handle, sdk::PropertyOrder);
+                        break;
+                    }
+                }
+            } catch (...) { }
+        }
+    }
+
+    size_t UndoStack::dropOldest() noexcept {
+        if (!canDropOldest())
+            return 0;
+
+        size_t const bytes = SizeOf(m_undo.front());
+        account(bytes, 0);
+        m_undo.pop_front();
+        if (m_undo.empty()) {
+            m_open = false;
+            m_moves.clear();
+        }
+
+        return bytes;
+    }
+
+    void UndoStack::Enforce() noexcept {
+        while (gl_budget != 0 && gl_total > gl_budget) {
+            /* Drop the oldest entry of all stacks; entries of open groups are still being recorded. */
+            UndoStack *victim = nullptr;
+            for (UndoStack *const stack : gl_stacks)
+                if (stack->canDropOldest() && (victim == nullptr || stack->m_undo.front().serial < victim->m_undo.front().serial))
+                    victim = stack;
+
+            if (victim == nullptr) {
+                for (UndoStack *const stack : gl_stacks)
+                    stack->dropRedo();
+
+                break;
+            }
+
+            victim->dropOldest();
+        }
+
+        MemoryBudget::Shared().enforce();
+    }
+}
+
+
@@ -0,0 +1,363 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  validator.cpp
+ * \brief implementation of the live well-formedness validator of diagrams
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <iterator>
+#include <tuple>
+#include <utility>
+
+/* external includes */
+#include <QMetaObject>
+
+/* sdk includes */
+#include <sdk/log.hpp>
+
+/* app includes */
+#include <renderer.hpp>
+#include <validator.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        constexpr uint32_t gl_maxdepth = 4096; /**< deepest chain of owners followed when looking for cycles */
+
+        static constexpr char const *gl_rulemessages[] = {
+            "The element is owned by itself, directly or through its owners.",
+            "The owner of the element no longer exists.",
+            "Only packages and classifiers can own other elements.",
+            "Another member of the same namespace has the same name.",
+            "Classifiers and packages should have a name."
+        }; /**< descriptions of the rules */
+
+        static_assert(std::size(gl_rulemessages) == static_cast<size_t>(DiagnosticRule::__NumDiagnosticRules__), "every rule needs a description");
+
+        /**
+         * \brief  checks whether elements of a kind form namespaces, i.e. may own other elements
+         *
+         * \param  [in] kind kind of the element
+         *
+         * \return *true* for packages and classifiers
+         */
+        static constexpr bool IsNamespace(sdk::ElementKind const kind) noexcept {
+            return kind == sdk::ElementKind::Package || DiagramRenderer::IsClassifier(kind);
+        }
+    }
+
+
+    char const *ModelValidator::MessageOf(DiagnosticRule rule) noexcept {
+        return internal::gl_rulemessages[static_cast<size_t>(rule)];
+    }
+
+
+    ModelValidator::ModelValidator(QObject *parent) noexcept
+        : QObject(parent), m_store(nullptr), m_stale(false), m_all(false), m_gen(0)
+    { }
+
+    ModelValidator::~ModelValidator() {
+        /* Tasks refer to the validator, including cancelled ones; results posted meanwhile are discarded along with it. */
+        m_task.cancel();
+        m_task.wait();
+        m_retired.wait();
+    }
+
+
+    void ModelValidator::setStore(sdk::ElementStore const *store) noexcept {
+        /* The task may still be running and post to the validator. */
+        m_retired.retire(m_task);
+        m_task = sdk::TaskHandle();
+        ++m_gen;
+
+        std::vector<sdk::ElementHandle> cleared;
+        try {
+            cleared.reserve(m_diags.size());
+
+            for (auto const &[handle, diags] : m_diags)
+                cleared.push_back(handle);
+        } catch (...) { }
+
+        m_store = store;
+        m_diags.clear();
+        m_dirty.clear();
+        m_stale = false;
+        m_all   = store != nullptr;
+
+        if (m_report && !cleared.empty())
+            m_report(cleared);
+        schedule();
+    }
+
+    void ModelValidator::changed(ChangeSet const &changes) noexcept {
+        if (m_store == nullptr)
+            return;
+
+        try {
+            if (changes.everything())
+                m_all = true;
+
+            bool moved = false;
+            for (sdk::ChangeRecord const &change : changes.records()) {
+                sdk::ElementHandle const element = sdk::ElementHandle::FromValue(change.element);
+
+                switch (change.kind) {
+                    case sdk::ElementAdded:
+                        touch(element);
+                        break;
+                    case sdk::ElementMoved:
+                        touch(element);
+                        moved = true;
+                        break;
+                    case sdk::ElementModified:
+                        if (change.args[0] == sdk::PropertyName)
+                            touch(element);
+                        break;
+                    case sdk::ElementRemoved: {
+                        /* The children of the element, if any, are left with a stale owner. */
+                        sdk::ElementHandle const parent = sdk::ElementHandle::FromValue(change.parent);
+                        if (parent == sdk::gl_nullelement || m_store->isValid(parent))
+                            m_dirty.insert(parent);
+                        m_stale = true;
+                        break;
+                    }
+                    default:
+                        continue;
+                }
+
+                /* Elements involved in earlier diagnostics, e.g. the namesake in the namespace an element has left, are checked again as well. */
+                auto const it = m_diags.find(element);
+                if (it == m_diags.end())
+                    continue;
+
+                for (Diagnostic const &diag : it->second)
+                    if (diag.related != sdk::gl_nullelement)
+                        touch(diag.related);
+                if (change.kind == sdk::ElementRemoved)
+                    m_diags.erase(it);
+            }
+
+            /* A move may also have broken a cycle further up the chain of owners. */
+            if (moved)
+                for (auto const &[handle, diags] : m_diags)
+                    for (Diagnostic const &diag : diags)
+                        if (diag.rule == DiagnosticRule::CyclicOwnership)
+                            touch(handle);
+        } catch (...) {
+            m_all = true;
+        }
+
+        schedule();
+    }
+
+    std::vector<Diagnostic> const *ModelValidator::find(sdk::ElementHandle handle) const noexcept {
+        auto const it = m_diags.find(handle);
+
+        return it != m_diags.end() ? &it->second : nullptr;
+    }
+
+
+    void ModelValidator::touch(sdk::ElementHandle handle) {
+        if (!m_store->isValid(handle))
+            return;
+
+        sdk::ElementHandle const parent = m_store->parents()[m_store->indexOf(handle)];
+        if (parent != sdk::gl_nullelement && !m_store->isValid(parent))
+            m_stale = true;
+        else
+            m_dirty.insert(parent);
+    }
+
+    void ModelValidator::schedule() noexcept {
+        if (m_store == nullptr || m_task.isValid() || (!m_all && !m_stale && m_dirty.empty()))
+            return;
+
+        try {
+            /* The snapshot only copies the components the rules need, so the store may change while the task runs. */
+            auto           snap = std::make_shared<Snapshot>();
+            uint32_t const n    = m_store->size();
+
+            snap->kinds.assign(m_store->kinds(), m_store->kinds() + n);
+            snap->names.assign(m_store->names(), m_store->names() + n);
+            snap->scopes.resize(n);
+            snap->handles.resize(n);
+            for (uint32_t i = 0; i < n; ++i) {
+                sdk::ElementHandle const parent = m_store->parents()[i];
+
+                snap->handles[i] = m_store->handleAt(i);
+                snap->scopes[i]  = parent == sdk::gl_nullelement ? 0 : m_store->isValid(parent) ? m_store->indexOf(parent) + 1 : gl_stalescope;
+            }
+
+            std::unordered_set<uint32_t> scopes;
+            if (!m_all) {
+                for (sdk::ElementHandle const owner : m_dirty)
+                    if (owner == sdk::gl_nullelement)
+                        scopes.insert(0);
+                    else if (m_store->isValid(owner))
+                        scopes.insert(m_store->indexOf(owner) + 1);
+                if (m_stale)
+                    scopes.insert(gl_stalescope);
+            }
+
+            sdk::TaskHandle task = sdk::SubmitTask([this, snap = std::move(snap), scopes = std::move(scopes), all = m_all, gen = m_gen]() {
+                if (sdk::IsTaskCancelled())
+                    return;
+
+                Result res;
+                try {
+                    res = Validate(*snap, scopes, all);
+                } catch (...) {
+                    res        = Result();
+                    res.failed = true;
+                }
+
+                QMetaObject::invokeMethod(this, [this, gen, res = std::move(res)]() mutable {
+                    deliver(gen, std::move(res));
+                }, Qt::QueuedConnection);
+            }, sdk::TaskPriority::Low);
+            if (!task.isValid())
+                return;
+
+            m_task = std::move(task);
+            m_dirty.clear();
+            m_stale = false;
+            m_all   = false;
+        } catch (...) { }
+    }
+
+    ModelValidator::Result ModelValidator::Validate(Snapshot const &snap, std::unordered_set<uint32_t> const &scopes, bool all) {
+        uint32_t const n = static_cast<uint32_t>(snap.kinds.size());
+
+        /* Members are grouped by namespace, and by name within it, so that namesakes are adjacent. */
+        std::vector<uint32_t> members;
+        for (uint32_t i = 0; i < n; ++i)
+            if (all || scopes.count(snap.scopes[i]) != 0)
+                members.push_back(i);
+        std::sort(members.begin(), members.end(), [&](uint32_t const a, uint32_t const b) {
+            return std::make_tuple(snap.scopes[a], snap.names[a].value(), a) < std::make_tuple(snap.scopes[b], snap.names[b].value(), b);
+        });
+
+        std::vector<size_t> groups;
+        for (size_t k = 0; k < members.size(); ++k)
+            if (k == 0 || snap.scopes[members[k]] != snap.scopes[members[k - 1]])
+                groups.push_back(k);
+        groups.push_back(members.size());
+
+        /* Namespaces are independent of each other, so they are checked in parallel. */
+        std::vector<std::vector<Diagnostic>> found(groups.size() - 1);
+        sdk::ParallelFor(groups.size() - 1, [&](size_t const g) {
+            std::vector<Diagnostic> &res   = found[g];
+            size_t const             first = groups[g];
+            size_t const             last  = groups[g + 1];
+            uint32_t const           scope = snap.scopes[members[first]];
+
+            for (size_t k = first; k < last; ++k) {
+                uint32_t const           i      = members[k];
+                sdk::ElementHandle const handle = snap.handles[i];
+
+                if (scope == gl_stalescope)
+                    res.push_back({ handle, DiagnosticRule::DanglingOwner, sdk::gl_nullelement });
+                else if (scope != 0) {
+                    uint32_t const owner = scope - 1;
+                    if (!internal::IsNamespace(snap.kinds[owner]))
+                        res.push_back({ handle, DiagnosticRule::InvalidOwner, snap.handles[owner] });
+
+                    /* Only elements on the cycle are reported, not those owned by one of them. */
+                    uint32_t next  = owner;
+                    uint32_t depth = 0;
+                    while (next != i && depth++ < std::min(n, internal::gl_maxdepth) && snap.scopes[next] != 0 && snap.scopes[next] != gl_stalescope)
+                        next = snap.scopes[next] - 1;
+                    if (next == i)
+                        res.push_back({ handle, DiagnosticRule::CyclicOwnership, snap.handles[owner] });
+                }
+
+                if (internal::IsNamespace(snap.kinds[i]) && snap.names[i].view().empty())
+                    res.push_back({ handle, DiagnosticRule::UnnamedElement, sdk::gl_nullelement });
+            }
+
+            /* Notes and associations do not take part in the namespace, even if named alike. */
+            for (size_t k = first; k < last;) {
+                sdk::StringId const name = snap.names[members[k]];
+
+                size_t end   = k;
+                size_t count = 0;
+                size_t a     = last;
+                size_t b     = last;
+                for (; end < last && snap.names[members[end]] == name; ++end)
+                    if (internal::IsNamespace(snap.kinds[members[end]]) && count++ < 2)
+                        (count == 1 ? a : b) = end;
+
+                if (count >= 2 && !name.view().empty())
+                    for (size_t m = k; m < end; ++m)
+                        if (internal::IsNamespace(snap.kinds[members[m]]))
+                            res.push_back({ snap.handles[members[m]], DiagnosticRule::DuplicateName, snap.handles[members[m == a ? b : a]] });
+
+                k = end;
+            }
+        }, sdk::TaskPriority::Low);
+
+        Result res;
+        res.failed = false;
+        res.checked.reserve(members.size());
+        for (uint32_t const i : members)
+            res.checked.push_back(snap.handles[i]);
+        for (std::vector<Diagnostic> const &diags : found)
+            res.found.insert(res.found.end(), diags.begin(), diags.end());
+
+        return res;
+    }
+
+    void ModelValidator::deliver(uint64_t gen, Result res) noexcept {
+        if (gen != m_gen)
+            return;
+
+        m_task = sdk::TaskHandle();
+        if (res.failed) {
+            SZSDK_APP_WARNING("Validation of the diagram ran out of memory; it is retried with the next change.");
+
+            m_all = true;
+            return;
+        }
+
+        std::vector<sdk::ElementHandle> changed;
+        try {
+            /* Checked elements that had or have diagnostics are reported; all others are unaffected. */
+            for (sdk::ElementHandle const handle : res.checked) {
+                auto const it = m_diags.find(handle);
+                if (it == m_diags.end())
+                    continue;
+
+                changed.push_back(handle);
+                m_diags.erase(it);
+            }
+            for (Diagnostic const &diag : res.found) {
+                std::vector<Diagnostic> &diags = m_diags[diag.element];
+                if (diags.empty())
+                    changed.push_back(diag.element);
+
+                diags.push_back(diag);
+            }
+
+            std::sort(changed.begin(), changed.end(), [](sdk::ElementHandle const a, sdk::ElementHandle const b) { return a.value() < b.value(); });
+            changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+        } catch (...) {
+            m_all = true;
+        }
+
+        if (m_report && !changed.empty())
+            m_report(changed);
+        schedule();
+    }
+}
+
+
@@ -0,0 +1,342 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  watchdog.cpp
+ * \brief implementation of the event-loop stall watchdog
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if defined _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <Windows.h>
+    #include <DbgHelp.h>
+
+    #pragma comment(lib, "Dbghelp.lib")
+#else
+    #include <csignal>
+    #include <cstdlib>
+    #include <execinfo.h>
+    #include <pthread.h>
+#endif
+
+/* sdk includes */
+#include <sdk/log.hpp>
+#include <sdk/profile.hpp>
+
+/* app includes */
+#include <watchdog.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        /**
+         * \brief  retrieves the current time
+         *
+         * \return nanoseconds since the epoch of *std::chrono::steady_clock*
+         */
+        static int64_t Now() noexcept {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+#if !defined _WIN32
+        constexpr int gl_capturesignal = SIGUSR2; /**< signal interrupting the GUI thread to record its stack */
+
+        static void                *gl_frames[StallWatchdog::gl_maxframes]; /**< stack recorded by the signal handler */
+        static std::atomic<int>     gl_nframes(0);                          /**< number of frames in *gl_frames* */
+        static std::atomic<bool>    gl_captured(false);                     /**< whether or not the signal handler has recorded the stack */
+
+
+        /**
+         * \brief records the stack of the interrupted thread; only async-signal-safe work is done here
+         *
+         * \param [in] signum number of the signal
+         */
+        static void CaptureHandler(int const signum) noexcept {
+            static_cast<void>(signum);
+
+            gl_nframes.store(backtrace(gl_frames, static_cast<int>(StallWatchdog::gl_maxframes)), std::memory_order_relaxed);
+            gl_captured.store(true, std::memory_order_release);
+        }
+#endif
+    }
+
+
+    /**
+     * \struct suzu::StallWatchdog::Platform
+     * \brief  platform-specific handle of the GUI thread
+     */
+    struct StallWatchdog::Platform {
+#if defined _WIN32
+        HANDLE                     thread;  /**< GUI thread, opened for suspending it and reading its context */
+        bool                       symbols; /**< whether or not the symbol handler was initialized */
+        ULONG_PTR                  low;     /**< lowest address of the stack of the GUI thread */
+        ULONG_PTR                  high;    /**< address above the stack of the GUI thread */
+        std::unique_ptr<uint8_t[]> stack;   /**< copy of the top of the stack, *gl_maxstack* bytes; allocated up front */
+#else
+        pthread_t thread; /**< GUI thread */
+#endif
+    };
+
+
+    StallWatchdog::StallWatchdog(uint32_t const threshold) noexcept
+        : m_threshold(threshold), m_beat(0), m_thread(0), m_stop(false)
+    { }
+
+    StallWatchdog::~StallWatchdog() {
+        stop();
+    }
+
+    sdk::ErrorCode StallWatchdog::start() noexcept {
+        if (m_threshold == 0)
+            return sdk::ErrorCode::NoOperation;
+        if (isRunning())
+            return sdk::ErrorCode::InvalidState;
+
+        try {
+            m_platform = std::make_unique<Platform>();
+#if defined _WIN32
+            m_platform->thread  = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION, FALSE, GetCurrentThreadId());
+            m_platform->symbols = false;
+            m_platform->stack   = std::make_unique<uint8_t[]>(gl_maxstack);
+            GetCurrentThreadStackLimits(&m_platform->low, &m_platform->high);
+            if (m_platform->thread == nullptr)
+                SZSDK_APP_WARNING("Could not open the GUI thread (error {}); stalls are reported without stacks.", GetLastError());
+#else
+            m_platform->thread = pthread_self();
+
+            /* The first use of *backtrace()* may allocate, which must not happen in the signal handler. */
+            void *frame = nullptr;
+            backtrace(&frame, 1);
+
+            struct sigaction action = {};
+            action.sa_handler = internal::CaptureHandler;
+            action.sa_flags   = SA_RESTART;
+            sigemptyset(&action.sa_mask);
+            if (sigaction(internal::gl_capturesignal, &action, nullptr) != 0)
+                SZSDK_APP_WARNING("Could not install the stack capture handler; stalls are reported without stacks.");
+#endif
+
+            m_thread = sdk::Profiler::Local().thread();
+            m_beat.store(internal::Now(), std::memory_order_relaxed);
+
+            /* Heartbeats are a few times more frequent than the threshold, so that a stall is noticed early. */
+            m_timer = std::make_unique<QTimer>();
+            m_timer->setInterval(std::max(gl_minbeat, static_cast<int>(m_threshold / 4)));
+            QObject::connect(m_timer.get(), &QTimer::timeout, m_timer.get(), [this]() { m_beat.store(internal::Now(), std::memory_order_relaxed); });
+            m_timer->start();
+
+            m_stop   = false;
+            m_worker = std::thread([this]() { run(); });
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        m_timer.reset();
+        return sdk::ErrorCode::CriticalResource;
+    }
+
+    void StallWatchdog::stop() noexcept {
+        if (!isRunning())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        m_worker.join();
+        m_timer.reset();
+
+#if defined _WIN32
+        if (m_platform->symbols)
+            SymCleanup(GetCurrentProcess());
+        if (m_platform->thread != nullptr)
+            CloseHandle(m_platform->thread);
+#endif
+        m_platform.reset();
+    }
+
+
+    void StallWatchdog::run() noexcept {
+        int64_t const        threshold = static_cast<int64_t>(m_threshold) * 1000000;
+        Clock::duration const interval = std::chrono::milliseconds(std::max(gl_minbeat, static_cast<int>(m_threshold / 4)));
+
+        int64_t           stalled = -1; /* heartbeat the reported stall began after */
+        int64_t           ignored = -1; /* heartbeat missed while the worker did not run either */
+        Clock::time_point last    = Clock::now();
+
+        std::unique_lock<std::mutex> lock(m_lock);
+        while (!m_wake.wait_for(lock, interval, [this]() { return m_stop; })) {
+            Clock::time_point const now  = Clock::now();
+            int64_t const           beat = m_beat.load(std::memory_order_relaxed);
+            int64_t const           idle = internal::Now() - beat;
+
+            bool const late = now - last > interval + std::chrono::nanoseconds(threshold);
+            last = now;
+
+            if (stalled >= 0 && beat != stalled) {
+                SZSDK_APP_INFO("GUI event loop resumed after a stall of {:.0f} ms.", static_cast<double>(beat - stalled) / 1e6);
+
+                stalled = -1;
+            }
+            if (late) {
+                ignored = beat;
+
+                continue;
+            }
+            if (idle <= threshold || beat == stalled || beat == ignored)
+                continue;
+
+            sdk::Profiler const           &profiler = sdk::Profiler::Local();
+            sdk::Profiler::Zone const *const zone   = profiler.info(profiler.active(m_thread));
+            std::string const                stack  = captureStack();
+
+            SZSDK_APP_WARNING("GUI event loop has not responded for {:.0f} ms (threshold {} ms); active profiling zone: {}. Stack of the GUI thread:\n{}",
+                static_cast<double>(idle) / 1e6, m_threshold,
+                zone != nullptr ? zone->name : std::string(profiler.isEnabled() ? "none" : "unknown, profiler is not recording"),
+                stack.empty() ? std::string("    (not available)") : stack
+            );
+            stalled = beat;
+        }
+    }
+
+    std::string StallWatchdog::captureStack() noexcept {
+        try {
+            std::string res;
+            char        line[512];
+
+#if defined _WIN32 && defined _M_X64
+            HANDLE const thread = m_platform->thread;
+            if (thread == nullptr)
+                return {};
+
+            /*
+             * While the thread is suspended, nothing may be done that could wait for a lock it holds:
+             * not allocating, and not looking up unwind data, which takes the lock of the loader's
+             * function tables. Its registers and the top of its stack are copied instead.
+             */
+            if (SuspendThread(thread) == static_cast<DWORD>(-1))
+                return {};
+
+            CONTEXT ctx      = {};
+            ctx.ContextFlags = CONTEXT_FULL;
+            size_t  size     = 0;
+            if (GetThreadContext(thread, &ctx) && ctx.Rsp >= m_platform->low && ctx.Rsp < m_platform->high) {
+                size = std::min<size_t>(static_cast<size_t>(m_platform->high - ctx.Rsp), gl_maxstack);
+
+                std::memcpy(m_platform->stack.get(), reinterpret_cast<void const *>(ctx.Rsp), size);
+            }
+            ResumeThread(thread);
+            if (size == 0)
+                return {};
+
+            /* The copy is unwound in place of the stack, so addresses into the stack are moved by the same offset. */
+            DWORD64 const first = ctx.Rsp;
+            DWORD64 const last  = ctx.Rsp + size;
+            DWORD64 const delta = reinterpret_cast<DWORD64>(m_platform->stack.get()) - first;
+            auto const    move  = [&](DWORD64 &reg) {
+                if (reg >= first && reg < last)
+                    reg += delta;
+            };
+
+            DWORD64  frames[gl_maxframes];
+            uint32_t nframes = 0;
+            move(ctx.Rsp);
+            move(ctx.Rbp);
+            while (nframes < gl_maxframes && ctx.Rip != 0) {
+                frames[nframes++] = ctx.Rip;
+
+                DWORD64                 base = 0;
+                PRUNTIME_FUNCTION const fn   = RtlLookupFunctionEntry(ctx.Rip, &base, nullptr);
+                if (fn == nullptr) {
+                    /* Leaf functions have no unwind data; their return address is on top of the stack. */
+                    if (ctx.Rsp + 8 > last + delta)
+                        break;
+
+                    ctx.Rip  = *reinterpret_cast<DWORD64 const *>(ctx.Rsp);
+                    ctx.Rsp += 8;
+
+                    continue;
+                }
+
+                PVOID   data        = nullptr;
+                DWORD64 establisher = 0;
+                RtlVirtualUnwind(UNW_FLAG_NHANDLER, base, ctx.Rip, fn, &ctx, &data, &establisher, nullptr);
+
+                /* Frame pointers restored from the copy still point into the stack. */
+                move(ctx.Rbp);
+                if (ctx.Rsp < first + delta || ctx.Rsp >= last + delta)
+                    break;
+            }
+
+            HANDLE const process = GetCurrentProcess();
+            if (!m_platform->symbols) {
+                SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS);
+
+                m_platform->symbols = SymInitialize(process, nullptr, TRUE) != FALSE;
+            }
+
+            alignas(SYMBOL_INFO) char buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME];
+            SYMBOL_INFO *const        symbol = reinterpret_cast<SYMBOL_INFO *>(buffer);
+            for (uint32_t i = 0; i < nframes; ++i) {
+                symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+                symbol->MaxNameLen   = MAX_SYM_NAME;
+
+                DWORD64 offset = 0;
+                if (m_platform->symbols && SymFromAddr(process, frames[i], &offset, symbol))
+                    std::snprintf(line, sizeof(line), "    #%-2u %s+0x%llx\n", i, symbol->Name, static_cast<unsigned long long>(offset));
+                else
+                    std::snprintf(line, sizeof(line), "    #%-2u 0x%016llx\n", i, static_cast<unsigned long long>(frames[i]));
+                res += line;
+            }
+#elif defined _WIN32
+            static_cast<void>(line);
+
+            return {};
+#else
+            internal::gl_captured.store(false, std::memory_order_relaxed);
+            if (pthread_kill(m_platform->thread, internal::gl_capturesignal) != 0)
+                return {};
+
+            /* A thread blocked in a system call handles the signal as soon as it is scheduled. */
+            for (int i = 0; i < 200 && !internal::gl_captured.load(std::memory_order_acquire); ++i)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            if (!internal::gl_captured.load(std::memory_order_acquire))
+                return {};
+
+            /* The first frame is the signal handler itself. */
+            int const    nframes = internal::gl_nframes.load(std::memory_order_relaxed);
+            char **const symbols = backtrace_symbols(internal::gl_frames, nframes);
+            for (int i = 1; i < nframes; ++i) {
+                if (symbols != nullptr)
+                    std::snprintf(line, sizeof(line), "    #%-2d %s\n", i - 1, symbols[i]);
+                else
+                    std::snprintf(line, sizeof(line), "    #%-2d %p\n", i - 1, internal::gl_frames[i]);
+                res += line;
+            }
+            std::free(symbols);
+#endif
+
+            if (!res.empty())
+                res.pop_back();
+            return res;
+        } catch (...) { }
+
+        return {};
+    }
+}
+
+
@@ -0,0 +1,400 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  xmi.cpp
+ * \brief implementation of the streaming XMI encoder and decoder
+ */
+
+
+/* stdlib includes */
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+/* external includes */
+#include <QFile>
+#include <QSaveFile>
+#include <QString>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+/* sdk includes */
+#include <sdk/intern.hpp>
+
+/* app includes */
+#include <jobs.hpp>
+#include <xmi.hpp>
+
+
+namespace suzu {
+    namespace internal {
+        static constexpr uint32_t gl_xminone     = UINT32_MAX; /**< marks missing elements and unknown kinds */
+        static constexpr uint32_t gl_xmireport   = 4096;       /**< number of elements or tokens between progress reports */
+        static constexpr uint32_t gl_xmigridcols = 16;         /**< columns of the grid elements without a shape are placed on */
+
+        /**
+         * \brief UML metaclass of every element kind
+         */
+        static constexpr char16_t const *gl_umltypes[] = { u"Class", u"Interface", u"Enumeration", u"Package", u"Association", u"Comment" };
+        static_assert(std::size(gl_umltypes) == static_cast<size_t>(sdk::ElementKind::__NumElementKinds__), "every element kind needs a metaclass");
+
+        /**
+         * \struct suzu::internal::XmiShape
+         * \brief  shape read from the Suzu extension, referring to an element by its *xmi:id*
+         */
+        struct XmiShape {
+            std::string      element; /**< *xmi:id* of the element */
+            sdk::ElementRect bounds;  /**< bounding box */
+            uint32_t         style;   /**< style id */
+            uint32_t         flags;   /**< *suzu::sdk::ElementFlags* */
+        };
+
+        static QString XmiNamespace() { return QStringLiteral("http://www.omg.org/spec/XMI/20131001"); }
+        static QString UmlNamespace() { return QStringLiteral("http://www.omg.org/spec/UML/20161101"); }
+
+        /**
+         * \brief  checks whether a namespace is one of the XMI namespaces of the various XMI versions
+         *
+         * \param  [in] uri namespace URI
+         *
+         * \return *true* if *uri* is an XMI namespace
+         */
+        static bool IsXmi(QStringView uri) noexcept {
+            return uri.contains(u"/XMI");
+        }
+
+        /**
+         * \brief  retrieves the value of an attribute
+         *
+         * \param  [in] attrs attributes of an element
+         * \param  [in] name local name of the attribute
+         * \param  [in] xmi whether the attribute is in the XMI namespace (e.g. *xmi:id*) or in none
+         *
+         * \return value; empty if the attribute is missing. Valid for as long as *attrs*.
+         */
+        static QStringView Attribute(QXmlStreamAttributes const &attrs, QStringView name, bool xmi) noexcept {
+            for (QXmlStreamAttribute const &attr : attrs)
+                if (attr.name() == name && (xmi ? IsXmi(attr.namespaceUri()) : attr.namespaceUri().isEmpty()))
+                    return attr.value();
+
+            return {};
+        }
+
+        /**
+         * \brief  maps an *xmi:type* to an element kind
+         *
+         * \param  [in] type type, e.g. "uml:Class"
+         *
+         * \return *suzu::sdk::ElementKind*; *gl_xminone* if the type is not imported
+         */
+        static uint32_t KindOf(QStringView type) noexcept {
+            type = type.sliced(type.indexOf(u':') + 1);
+
+            for (uint32_t i = 0; i < std::size(gl_umltypes); ++i)
+                if (type == QStringView(gl_umltypes[i]))
+                    return i;
+
+            return gl_xminone;
+        }
+
+        /**
+         * \brief  interns text read from the document
+         *
+         * \param  [in] text text
+         *
+         * \return interned string
+         * \throw  std::bad_alloc
+         */
+        static sdk::StringId Intern(QStringView text) {
+            QByteArray const utf8 = text.toUtf8();
+
+            return sdk::StringId(std::string_view(utf8.constData(), static_cast<size_t>(utf8.size())));
+        }
+
+        /**
+         * \brief reads the shapes of the Suzu extension; the reader is left at its end tag
+         *
+         * \param [in,out] xml reader, positioned at the start tag of the extension
+         * \param [in,out] shapes receives the shapes
+         * \throw std::bad_alloc
+         */
+        static void ReadShapes(QXmlStreamReader &xml, std::vector<XmiShape> &shapes) {
+            while (xml.readNextStartElement()) {
+                if (xml.name() == u"shape") {
+                    QXmlStreamAttributes const attrs = xml.attributes();
+
+                    shapes.push_back({
+                        Attribute(attrs, u"element", false).toString().toStdString(),
+                        {
+                            Attribute(attrs, u"x", false).toFloat(),
+                            Attribute(attrs, u"y", false).toFloat(),
+                            Attribute(attrs, u"width", false).toFloat(),
+                            Attribute(attrs, u"height", false).toFloat()
+                        },
+                        Attribute(attrs, u"style", false).toUInt(),
+                        Attribute(attrs, u"flags", false).toUInt() & ~static_cast<uint32_t>(sdk::ElementSelected)
+                    });
+                }
+
+                xml.skipCurrentElement();
+            }
+        }
+
+        /**
+         * \brief  reads the elements of an XMI document
+         *
+         * \param  [in] file opened XMI file
+         * \param  [out] store receives the elements
+         * \param  [out] name (optional) receives the name of the model
+         * \param  [out] error (optional) receives a description of the error, if any
+         * \param  [in] job (optional) job receiving the progress
+         *
+         * \return see *suzu::ImportXmi()*
+         * \throw  std::bad_alloc, std::length_error
+         */
+        static sdk::ErrorCode ReadXmi(QFile &file, sdk::ElementStore &store, std::string *name, std::string *error, JobContext *job) {
+            /* First pass: create the elements and collect their ids and all references. */
+            std::unordered_map<std::string, sdk::ElementHandle> ids;
+            std::vector<XmiShape>                               shapes;
+            std::vector<sdk::ElementHandle>                     enclosing; /* innermost element around every open tag */
+
+            QXmlStreamReader xml(&file);
+            for (uint64_t tokens = 1; !xml.atEnd(); ++tokens) {
+                xml.readNext();
+
+                if (job != nullptr && tokens % gl_xmireport == 0) {
+                    if (job->isCancelled())
+                        return sdk::ErrorCode::NoOperation;
+
+                    job->report(file.size() > 0 ? 0.9 * static_cast<double>(file.pos()) / static_cast<double>(file.size()) : 0.0, "Reading XMI");
+                }
+
+                if (xml.isEndElement()) {
+                    if (!enclosing.empty())
+                        enclosing.pop_back();
+
+                    continue;
+                } else if (!xml.isStartElement())
+                    continue;
+
+                QXmlStreamAttributes const attrs  = xml.attributes();
+                sdk::ElementHandle const   parent = enclosing.empty() ? sdk::gl_nullelement : enclosing.back();
+                if (xml.name() == u"Extension" && IsXmi(xml.namespaceUri())) {
+                    if (Attribute(attrs, u"extender", false) == u"Suzu")
+                        ReadShapes(xml, shapes);
+                    else
+                        xml.skipCurrentElement();
+
+                    continue;
+                } else if (xml.name() == u"body" && store.isValid(parent) && store.kinds()[store.indexOf(parent)] == sdk::ElementKind::Note) {
+                    store.names()[store.indexOf(parent)] = Intern(xml.readElementText());
+
+                    continue;
+                } else if (xml.name() == u"Model" && name != nullptr && name->empty())
+                    *name = Attribute(attrs, u"name", false).toString().toStdString();
+
+                /* Elements that are not imported may still contain elements that are. */
+                uint32_t const kind = KindOf(Attribute(attrs, u"type", true));
+                if (kind == gl_xminone) {
+                    enclosing.push_back(parent);
+
+                    continue;
+                }
+
+                uint32_t const           slot   = store.size();
+                sdk::ElementRect const   bounds = { static_cast<float>(slot % gl_xmigridcols) * 160.0f, static_cast<float>(slot / gl_xmigridcols) * 100.0f, 120.0f, 60.0f };
+                QStringView const        label  = Attribute(attrs, kind == static_cast<uint32_t>(sdk::ElementKind::Note) ? u"body" : u"name", false);
+                sdk::ElementHandle const handle = store.create(static_cast<sdk::ElementKind>(kind), bounds, 0, parent, Intern(label));
+
+                QStringView const id = Attribute(attrs, u"id", true);
+                if (!id.isEmpty())
+                    ids.try_emplace(id.toString().toStdString(), handle);
+                enclosing.push_back(handle);
+            }
+            if (xml.hasError()) {
+                if (error != nullptr)
+                    *error = "line " + std::to_string(xml.lineNumber()) + ": " + xml.errorString().toStdString();
+
+                return sdk::ErrorCode::ReadFile;
+            }
+
+            /* Second pass: resolve the references through the id table. */
+            for (XmiShape const &shape : shapes) {
+                auto const it = ids.find(shape.element);
+                if (it == ids.end())
+                    continue;
+
+                uint32_t const dense = store.indexOf(it->second);
+                store.setBounds(it->second, shape.bounds);
+                store.styles()[dense] = shape.style;
+                store.flags()[dense]  = shape.flags;
+            }
+
+            if (job != nullptr)
+                job->report(1.0, "Reading XMI");
+            return sdk::ErrorCode::Ok;
+        }
+    }
+
+
+    sdk::ErrorCode ExportXmi(char const *path, std::string_view name, sdk::ElementStore const &store, JobContext *job) noexcept {
+        if (path == nullptr)
+            return sdk::ErrorCode::InvalidParameter;
+
+        try {
+            QSaveFile file(QString::fromUtf8(path));
+            if (!file.open(QIODevice::WriteOnly))
+                return sdk::ErrorCode::OpenFile;
+
+            /* Children of every element, as lists in drawing order. */
+            uint32_t const                n     = store.size();
+            sdk::ElementKind const *const kinds = store.kinds();
+            std::vector<uint32_t>         parent(n, internal::gl_xminone);
+            std::vector<uint32_t>         first(n, internal::gl_xminone);
+            std::vector<uint32_t>         last(n, internal::gl_xminone);
+            std::vector<uint32_t>         next(n, internal::gl_xminone);
+            std::vector<uint8_t>          written(n, 0);
+            for (uint32_t i = 0; i < n; ++i) {
+                uint32_t const p = store.indexOf(store.parents()[i]);
+                if (p >= n || p == i)
+                    continue;
+
+                parent[i] = p;
+                (last[p] == internal::gl_xminone ? first[p] : next[last[p]]) = i;
+                last[p] = i;
+            }
+
+            QString const    xmins = internal::XmiNamespace();
+            QXmlStreamWriter xml(&file);
+            xml.setAutoFormatting(true);
+            xml.writeStartDocument();
+            xml.writeNamespace(xmins, QStringLiteral("xmi"));
+            xml.writeNamespace(internal::UmlNamespace(), QStringLiteral("uml"));
+            xml.writeStartElement(xmins, QStringLiteral("XMI"));
+            xml.writeStartElement(internal::UmlNamespace(), QStringLiteral("Model"));
+            xml.writeAttribute(xmins, QStringLiteral("id"), QStringLiteral("model"));
+            xml.writeAttribute(QStringLiteral("name"), QString::fromUtf8(name.data(), static_cast<qsizetype>(name.size())));
+
+            uint32_t count     = 0;
+            bool     cancelled = false;
+            auto     open      = [&](uint32_t const i) {
+                uint32_t const         p     = parent[i];
+                bool const             inner = p != internal::gl_xminone && (kinds[p] == sdk::ElementKind::Class || kinds[p] == sdk::ElementKind::Interface || kinds[p] == sdk::ElementKind::Enumeration);
+                bool const             note  = kinds[i] == sdk::ElementKind::Note;
+                std::string_view const label = store.names()[i].view();
+
+                xml.writeStartElement(note ? QStringLiteral("ownedComment") : inner ? QStringLiteral("nestedClassifier") : QStringLiteral("packagedElement"));
+                xml.writeAttribute(xmins, QStringLiteral("type"), QStringLiteral("uml:") + QStringView(internal::gl_umltypes[static_cast<uint32_t>(kinds[i])]).toString());
+                xml.writeAttribute(xmins, QStringLiteral("id"), QStringLiteral("e") + QString::number(i));
+                if (!label.empty())
+                    xml.writeAttribute(note ? QStringLiteral("body") : QStringLiteral("name"), QString::fromUtf8(label.data(), static_cast<qsizetype>(label.size())));
+
+                written[i] = 1;
+                if (job != nullptr && ++count % internal::gl_xmireport == 0) {
+                    cancelled = cancelled || job->isCancelled();
+
+                    job->report(0.9 * static_cast<double>(count) / static_cast<double>(n), "Writing XMI");
+                }
+            };
+
+            /* Walk every tree in pre-order, without recursion. */
+            for (uint32_t root = 0; root < n && !cancelled; ++root) {
+                if (parent[root] != internal::gl_xminone)
+                    continue;
+
+                uint32_t curr = root;
+                for (;;) {
+                    open(curr);
+                    if (first[curr] != internal::gl_xminone) {
+                        curr = first[curr];
+
+                        continue;
+                    }
+
+                    xml.writeEndElement();
+                    while (curr != root && next[curr] == internal::gl_xminone) {
+                        curr = parent[curr];
+
+                        xml.writeEndElement();
+                    }
+                    if (curr == root)
+                        break;
+                    curr = next[curr];
+                }
+            }
+            /* Elements whose parents form a cycle are written without nesting. */
+            for (uint32_t i = 0; i < n && !cancelled; ++i) {
+                if (written[i] != 0)
+                    continue;
+
+                open(i);
+                xml.writeEndElement();
+            }
+            xml.writeEndElement();
+
+            xml.writeStartElement(xmins, QStringLiteral("Extension"));
+            xml.writeAttribute(QStringLiteral("extender"), QStringLiteral("Suzu"));
+            for (uint32_t i = 0; i < n && !cancelled; ++i) {
+                sdk::ElementRect const &rect = store.bounds()[i];
+
+                xml.writeEmptyElement(QStringLiteral("shape"));
+                xml.writeAttribute(QStringLiteral("element"), QStringLiteral("e") + QString::number(i));
+                xml.writeAttribute(QStringLiteral("x"), QString::number(rect.x, 'g', 9));
+                xml.writeAttribute(QStringLiteral("y"), QString::number(rect.y, 'g', 9));
+                xml.writeAttribute(QStringLiteral("width"), QString::number(rect.w, 'g', 9));
+                xml.writeAttribute(QStringLiteral("height"), QString::number(rect.h, 'g', 9));
+                xml.writeAttribute(QStringLiteral("style"), QString::number(store.styles()[i]));
+                xml.writeAttribute(QStringLiteral("flags"), QString::number(store.flags()[i] & ~static_cast<uint32_t>(sdk::ElementSelected)));
+            }
+            xml.writeEndElement();
+            xml.writeEndDocument();
+
+            if (cancelled) {
+                file.cancelWriting();
+
+                return sdk::ErrorCode::NoOperation;
+            } else if (xml.hasError() || !file.commit())
+                return sdk::ErrorCode::WriteFile;
+
+            if (job != nullptr)
+                job->report(1.0, "Writing XMI");
+            return sdk::ErrorCode::Ok;
+        } catch (...) { }
+
+        return sdk::ErrorCode::WriteFile;
+    }
+
+    sdk::ErrorCode ImportXmi(char const *path, sdk::ElementStore &store, std::string *name, std::string *error, JobContext *job) noexcept {
+        store.clear();
+        if (path == nullptr)
+            return sdk::ErrorCode::InvalidParameter;
+
+        sdk::ErrorCode err = sdk::ErrorCode::CriticalResource;
+        try {
+            QFile file(QString::fromUtf8(path));
+            if (!file.open(QIODevice::ReadOnly)) {
+                if (error != nullptr)
+                    *error = "could not open file";
+
+                return sdk::ErrorCode::OpenFile;
+            }
+
+            err = internal::ReadXmi(file, store, name, error, job);
+        } catch (...) {
+            err = sdk::ErrorCode::CriticalResource;
+        }
+
+        if (err != sdk::ErrorCode::Ok)
+            store.clear();
+        return err;
+    }
+}
+
+
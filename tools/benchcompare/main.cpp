@@ -0,0 +1,381 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  main.cpp
+ * \brief entry-point of the benchmark comparison and regression gate
+ *
+ * Usage: *benchcompare [--threshold <percent>] [--confidence <percent>] <baseline>... -- <candidate>...*
+ * Compares the results of two builds and prints one CSV line per metric with the medians of both,
+ * the relative change of the candidate and its confidence interval. Every file is one run of a
+ * benchmark: a JSON document as written by *scalebench measure*, or the CSV tables printed by
+ * *sdkbench* and *layoutbench*. Giving several runs per build makes the intervals meaningful;
+ * with a single run, the interval is the change itself.
+ *
+ * Metrics are recognized by the unit at the end of their name: times (*_ms*, *_ns*, *ns_per_...*)
+ * and sizes (*_mb*, *_bytes*) are better when lower, throughputs (*_mb_s*, *_per_s*) when higher.
+ * All other values, such as the number of elements of a run or the threads of a CSV row, name the
+ * metrics they belong to, e.g. *runs[...,elements=1000,...]/pan/p95_ms* or *benchmark=log,mode=async,
+ * threads=4/ns_per_message*.
+ *
+ * The confidence interval of the change (95% by default) is estimated by resampling the runs of
+ * both builds. A metric has regressed if it got worse by more than the threshold (5% by default)
+ * and the whole interval lies on the worse side, so that noise alone does not fail a build. The
+ * tool exits with *suzu::sdk::ErrorCode::InvalidState* if any metric regressed, and with
+ * *suzu::sdk::ErrorCode::Ok* otherwise.
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/* external includes */
+#include <sdk/external/json/nlohmann/json.hpp>
+
+/* sdk includes */
+#include <sdk/error.hpp>
+
+
+constexpr uint32_t gl_resamples = 2000; /**< number of resamples estimating a confidence interval */
+constexpr uint32_t gl_seed      = 42;   /**< seed of the resampling, so that results are reproducible */
+
+using JSON     = nlohmann::json;
+using MetricFn = std::function<void(std::string const &name, int direction, double value)>;
+
+
+/**
+ * \struct Metric
+ * \brief  runs of a single metric in both builds
+ */
+struct Metric {
+    int                 direction; /**< 1 if lower values are better, -1 if higher values are */
+    std::vector<double> baseline;  /**< values of the baseline runs */
+    std::vector<double> candidate; /**< values of the candidate runs */
+};
+
+
+/**
+ * \brief  determines whether a value is a metric from its name
+ *
+ * \param  [in] name name of the value
+ *
+ * \return 1 if lower values are better, -1 if higher values are, or 0 if the value is no metric
+ */
+static int DirectionOf(std::string_view const name) noexcept {
+    auto const ends = [name](std::string_view const suffix) {
+        return name.size() >= suffix.size() && name.substr(name.size() - suffix.size()) == suffix;
+    };
+
+    if (ends("_mb_s") || ends("_per_s"))
+        return -1;
+    if (ends("_ms") || ends("_ns") || ends("_mb") || ends("_bytes") || name.rfind("ns_per_", 0) == 0)
+        return 1;
+    return 0;
+}
+
+/**
+ * \brief  reads a whole file
+ *
+ * \param  [in] path path of the file
+ * \param  [out] res receives the contents
+ *
+ * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::ReadFile* on failure
+ */
+static suzu::sdk::ErrorCode ReadText(char const *const path, std::string &res) {
+    std::FILE *const file = std::fopen(path, "rb");
+    if (file == nullptr)
+        return suzu::sdk::ErrorCode::ReadFile;
+
+    char   buffer[1 << 14];
+    size_t count;
+    res.clear();
+    while ((count = std::fread(buffer, 1, sizeof buffer, file)) != 0)
+        res.append(buffer, count);
+
+    bool const failed = std::ferror(file) != 0;
+    std::fclose(file);
+    return failed ? suzu::sdk::ErrorCode::ReadFile : suzu::sdk::ErrorCode::Ok;
+}
+
+/**
+ * \brief  formats a scalar JSON value as part of a metric name
+ *
+ * \param  [in] value scalar value
+ *
+ * \return text of the value; strings without quotes
+ */
+static std::string ScalarText(JSON const &value) {
+    return value.is_string() ? value.get<std::string>() : value.dump();
+}
+
+/**
+ * \brief  names an element of an array by the values in it that are no metrics
+ *
+ * \param  [in] element element of the array
+ * \param  [in] index index of the element, used if it has no such values
+ *
+ * \return label, e.g. *elements=1000*
+ */
+static std::string LabelOf(JSON const &element, size_t const index) {
+    std::string res;
+    if (element.is_object())
+        for (auto const &[key, value] : element.items()) {
+            if (!value.is_primitive() || value.is_null() || DirectionOf(key) != 0)
+                continue;
+
+            res.append(res.empty() ? "" : ",").append(key).append("=").append(ScalarText(value));
+        }
+
+    return res.empty() ? std::to_string(index) : res;
+}
+
+/**
+ * \brief adds the metrics of a JSON value and of all values nested in it
+ *
+ * \param [in] value JSON value
+ * \param [in] prefix name of *value*, ending in '/' unless empty
+ * \param [in] add receives every metric
+ */
+static void CollectJson(JSON const &value, std::string const &prefix, MetricFn const &add) {
+    for (auto const &[key, item] : value.items()) {
+        if (item.is_number() && DirectionOf(key) != 0)
+            add(prefix + key, DirectionOf(key), item.get<double>());
+        else if (item.is_object())
+            CollectJson(item, prefix + key + "/", add);
+        else if (item.is_array())
+            for (size_t i = 0; i < item.size(); ++i) {
+                if (item[i].is_number() && DirectionOf(key) != 0)
+                    add(prefix + key + "[" + std::to_string(i) + "]", DirectionOf(key), item[i].get<double>());
+                else if (item[i].is_structured())
+                    CollectJson(item[i], prefix + key + "[" + LabelOf(item[i], i) + "]/", add);
+            }
+    }
+}
+
+/**
+ * \brief adds the metrics of CSV tables; tables start with a header line and are separated by
+ *        empty lines
+ *
+ * \param [in] text CSV tables
+ * \param [in] add receives every metric
+ */
+static void CollectCsv(std::string_view text, MetricFn const &add) {
+    auto const split = [](std::string_view line) {
+        std::vector<std::string_view> res;
+        for (size_t comma; (comma = line.find(',')) != std::string_view::npos; line.remove_prefix(comma + 1))
+            res.push_back(line.substr(0, comma));
+        res.push_back(line);
+
+        return res;
+    };
+
+    std::vector<std::string_view> header;
+    while (!text.empty()) {
+        size_t const     end  = std::min(text.find('\n'), text.size());
+        std::string_view line = text.substr(0, end);
+        text.remove_prefix(std::min(end + 1, text.size()));
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+        if (line.empty()) {
+            header.clear();
+            continue;
+        }
+        if (header.empty()) {
+            header = split(line);
+            continue;
+        }
+
+        std::vector<std::string_view> const cells = split(line);
+        std::string                         key;
+        for (size_t i = 0; i < std::min(cells.size(), header.size()); ++i)
+            if (DirectionOf(header[i]) == 0)
+                key.append(key.empty() ? "" : ",").append(header[i]).append("=").append(cells[i]);
+
+        for (size_t i = 0; i < std::min(cells.size(), header.size()); ++i) {
+            if (DirectionOf(header[i]) == 0)
+                continue;
+
+            std::string const cell(cells[i]);
+            char             *end   = nullptr;
+            double const      value = std::strtod(cell.c_str(), &end);
+            if (end != cell.c_str() && std::isfinite(value))
+                add(key + "/" + std::string(header[i]), DirectionOf(header[i]), value);
+        }
+    }
+}
+
+/**
+ * \brief  computes the median of values
+ *
+ * \param  [in] values values; at least one
+ *
+ * \return median
+ */
+static double Median(std::vector<double> values) {
+    size_t const mid = values.size() / 2;
+
+    std::nth_element(values.begin(), values.begin() + mid, values.end());
+    if (values.size() % 2 != 0)
+        return values[mid];
+
+    return 0.5 * (values[mid] + *std::max_element(values.begin(), values.begin() + mid));
+}
+
+/**
+ * \brief  estimates the confidence interval of the relative change of the median by resampling
+ *
+ * \param  [in] metric runs of both builds; at least one each
+ * \param  [in] confidence confidence level, between 0 and 1
+ * \param  [out] low receives the lower end of the interval
+ * \param  [out] high receives the upper end of the interval
+ */
+static void ConfidenceOf(Metric const &metric, double const confidence, double &low, double &high) {
+    std::mt19937        rng(gl_seed);
+    std::vector<double> changes, a(metric.baseline.size()), b(metric.candidate.size());
+
+    auto const resample = [&rng](std::vector<double> const &from, std::vector<double> &to) {
+        std::uniform_int_distribution<size_t> pick(0, from.size() - 1);
+        for (double &value : to)
+            value = from[pick(rng)];
+    };
+    for (uint32_t r = 0; r < gl_resamples; ++r) {
+        resample(metric.baseline, a);
+        resample(metric.candidate, b);
+
+        double const base = Median(a);
+        if (base != 0.0)
+            changes.push_back(Median(b) / base - 1.0);
+    }
+    if (changes.empty()) {
+        low = high = 0.0;
+
+        return;
+    }
+
+    std::sort(changes.begin(), changes.end());
+    double const tail = 0.5 * (1.0 - confidence) * static_cast<double>(changes.size() - 1);
+    low  = changes[static_cast<size_t>(std::floor(tail))];
+    high = changes[static_cast<size_t>(std::ceil(static_cast<double>(changes.size() - 1) - tail))];
+}
+
+
+int main(int argc, char **argv) {
+    using namespace suzu::sdk;
+
+    double threshold  = 5.0;
+    double confidence = 95.0;
+    int    i          = 1;
+    for (; i + 1 < argc && (std::string_view(argv[i]) == "--threshold" || std::string_view(argv[i]) == "--confidence"); i += 2)
+        (std::string_view(argv[i]) == "--threshold" ? threshold : confidence) = std::strtod(argv[i + 1], nullptr);
+
+    int split = i;
+    while (split < argc && std::string_view(argv[split]) != "--")
+        ++split;
+    if (split == i || split + 1 >= argc || threshold < 0.0 || confidence <= 0.0 || confidence >= 100.0) {
+        std::fprintf(stderr, "usage: %s [--threshold <percent>] [--confidence <percent>] <baseline>... -- <candidate>...\n", argv[0]);
+
+        return ErrorCode::InvalidParameter;
+    }
+
+    std::map<std::string, Metric> metrics;
+    try {
+        for (int f = i; f < argc; ++f) {
+            if (f == split)
+                continue;
+
+            std::string text;
+            if (ReadText(argv[f], text) != ErrorCode::Ok) {
+                std::fprintf(stderr, "error: could not read '%s'\n", argv[f]);
+
+                return ErrorCode::ReadFile;
+            }
+
+            /* Metrics are collected separately per file, so that a file repeating a name does not count as several runs. */
+            std::map<std::string, std::pair<int, double>> run;
+            MetricFn const                                add = [&run](std::string const &name, int const direction, double const value) { run.emplace(name, std::make_pair(direction, value)); };
+
+            size_t const first = text.find_first_not_of(" \t\r\n");
+            if (first != std::string::npos && text[first] == '{')
+                CollectJson(JSON::parse(text), {}, add);
+            else
+                CollectCsv(text, add);
+            if (run.empty()) {
+                std::fprintf(stderr, "error: '%s' holds no metrics\n", argv[f]);
+
+                return ErrorCode::InvalidParameter;
+            }
+
+            for (auto const &[name, value] : run) {
+                Metric &metric = metrics.try_emplace(name, Metric{ value.first, {}, {} }).first->second;
+
+                (f < split ? metric.baseline : metric.candidate).push_back(value.second);
+            }
+        }
+    } catch (JSON::exception const &e) {
+        std::fprintf(stderr, "error: invalid results: %s\n", e.what());
+
+        return ErrorCode::InvalidParameter;
+    } catch (...) {
+        return ErrorCode::CriticalResource;
+    }
+
+    size_t nregressed = 0;
+    size_t nimproved  = 0;
+    std::printf("metric,baseline,candidate,change_pct,ci_low_pct,ci_high_pct,verdict\n");
+    for (auto const &[name, metric] : metrics) {
+        if (metric.baseline.empty() || metric.candidate.empty()) {
+            std::printf("%s,,,,,,%s\n", name.c_str(), metric.baseline.empty() ? "added" : "removed");
+
+            continue;
+        }
+
+        double const base = Median(metric.baseline);
+        double const cand = Median(metric.candidate);
+        if (base == 0.0) {
+            std::printf("%s,%g,%g,,,,n/a\n", name.c_str(), base, cand);
+
+            continue;
+        }
+
+        double low, high;
+        ConfidenceOf(metric, confidence / 100.0, low, high);
+
+        /* Worse means higher for times and sizes, and lower for throughputs; the interval is turned the same way. */
+        double const change    = cand / base - 1.0;
+        double const worse     = metric.direction * change;
+        double const worselow  = metric.direction > 0 ? low : -high;
+        double const worsehigh = metric.direction > 0 ? high : -low;
+        char const  *verdict   = "unchanged";
+        if (worse * 100.0 > threshold && worselow > 0.0) {
+            verdict = "regressed";
+            ++nregressed;
+        } else if (worse * 100.0 < -threshold && worsehigh < 0.0) {
+            verdict = "improved";
+            ++nimproved;
+        }
+
+        std::printf("%s,%g,%g,%.2f,%.2f,%.2f,%s\n", name.c_str(), base, cand, 100.0 * change, 100.0 * low, 100.0 * high, verdict);
+    }
+
+    std::fprintf(stderr, "%zu metric(s) compared: %zu regressed, %zu improved by more than %.1f%%\n", metrics.size(), nregressed, nimproved, threshold);
+    return nregressed == 0 ? ErrorCode::Ok : ErrorCode::InvalidState;
+}
+
+
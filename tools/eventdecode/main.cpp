@@ -0,0 +1,96 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  main.cpp
+ * \brief entry-point of the offline event log decoder
+ *
+ * Usage: *eventdecode <event log> [<output file>]*
+ * Writes one line per recorded event in the format *time,thread,id,arg0,arg1,arg2*, where *time*
+ * is the wall-clock time of the event in microseconds since the epoch. If no output file is given,
+ * the events are written to the standard output.
+ */
+
+
+/* stdlib includes */
+#include <cinttypes>
+#include <cstdio>
+
+/* sdk includes */
+#include <sdk/eventlog.hpp>
+
+
+/**
+ * \brief  decodes the event log *in* and writes it as text to *out*
+ *
+ * \param  [in] in event log file, opened in binary mode
+ * \param  [in] out destination stream
+ *
+ * \return *suzu::sdk::ErrorCode::Ok* on success
+ */
+static suzu::sdk::ErrorCode DecodeEventLog(std::FILE *in, std::FILE *out) noexcept {
+    using namespace suzu::sdk;
+
+    events::EventLogHeader header;
+    if (std::fread(&header, sizeof header, 1, in) != 1)
+        return ErrorCode::ReadFile;
+    if (header.magic != events::EventLogHeader::gl_magic || header.version != events::EventLogHeader::gl_version)
+        return ErrorCode::InvalidParameter;
+
+    std::fprintf(out, "time,thread,id,arg0,arg1,arg2\n");
+
+    /* Records are read in blocks; a truncated trailing record is ignored. */
+    events::EventRecord records[512];
+    size_t              count;
+    while ((count = std::fread(records, sizeof(events::EventRecord), sizeof records / sizeof *records, in)) != 0)
+        for (size_t i = 0; i < count; ++i) {
+            events::EventRecord const &rec  = records[i];
+            int64_t const              time = header.systemref + static_cast<int64_t>(rec.time - header.steadyref);
+
+            std::fprintf(out, "%" PRId64 ",%" PRIu32 ",%" PRIu32 ",%" PRId64 ",%" PRId64 ",%" PRId64 "\n",
+                time / 1000, rec.thread, rec.id, rec.args[0], rec.args[1], rec.args[2]
+            );
+        }
+
+    return std::ferror(in) ? ErrorCode::ReadFile : ErrorCode::Ok;
+}
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <event log> [<output file>]\n", argv[0]);
+
+        return suzu::sdk::ErrorCode::InvalidParameter;
+    }
+
+    std::FILE *in = std::fopen(argv[1], "rb");
+    if (in == nullptr) {
+        std::fprintf(stderr, "error: could not open '%s'\n", argv[1]);
+
+        return suzu::sdk::ErrorCode::OpenFile;
+    }
+    std::FILE *out = argc > 2 ? std::fopen(argv[2], "w") : stdout;
+    if (out == nullptr) {
+        std::fprintf(stderr, "error: could not open '%s'\n", argv[2]);
+
+        std::fclose(in);
+        return suzu::sdk::ErrorCode::OpenFile;
+    }
+
+    suzu::sdk::ErrorCode const res = DecodeEventLog(in, out);
+    if (res != suzu::sdk::ErrorCode::Ok)
+        std::fprintf(stderr, "error: '%s' is not a valid event log (code %i)\n", argv[1], static_cast<int>(res));
+
+    std::fclose(in);
+    if (out != stdout)
+        std::fclose(out);
+    return res;
+}
+
+
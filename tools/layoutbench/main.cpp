@@ -0,0 +1,225 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  main.cpp
+ * \brief entry-point of the auto-layout benchmark
+ *
+ * Usage: *layoutbench [<nodes> [<threads> [<runs>]]]*
+ * Generates synthetic class diagrams of *nodes* classes (10000 by default) and lays them out with
+ * *suzu::sdk::HierarchicalLayout*, once on the calling thread and once on a task scheduler with
+ * *threads* workers (one per core by default). Every configuration is run *runs* times (5 by
+ * default); the fastest run is reported per stage, in milliseconds.
+ *
+ * Afterwards, *Update()* is timed for adding single classes, one at a time, to each diagram after a
+ * full layout; the mean and maximum time per update are reported.
+ *
+ * Two graph shapes are measured: a *forest* of many inheritance trees of 20 to 400 classes, whose
+ * components are laid out in parallel, and a single *tree* spanning all classes, whose layers are
+ * reordered in parallel. In both, every tenth class additionally realizes an interface higher up
+ * in its tree, which creates edges spanning several layers.
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+/* sdk includes */
+#include <sdk/layout.hpp>
+#include <sdk/task.hpp>
+
+
+/**
+ * \brief generates a synthetic class diagram
+ *
+ * \param [in] n number of classes
+ * \param [in] forest whether to generate many small trees rather than a single one
+ * \param [out] nodes class boxes
+ * \param [out] edges generalizations and realizations, from the more general class
+ */
+static void GenerateDiagram(uint32_t const n, bool const forest, std::vector<suzu::sdk::ElementRect> &nodes, std::vector<suzu::sdk::LayoutEdge> &edges) {
+    std::mt19937                            rng(n);
+    std::uniform_int_distribution<uint32_t> treesize(20, 400);
+    std::uniform_real_distribution<float>   width(80.0f, 220.0f);
+    std::uniform_real_distribution<float>   height(40.0f, 160.0f);
+
+    nodes.clear();
+    edges.clear();
+    uint32_t root = 0;
+    uint32_t end  = forest ? std::min(n, treesize(rng)) : n;
+    for (uint32_t v = 0; v < n; ++v) {
+        if (v == end) {
+            root = v;
+            end  = std::min(n, v + treesize(rng));
+        }
+        nodes.push_back({ 0.0f, 0.0f, width(rng), height(rng) });
+
+        if (v == root)
+            continue;
+        /* Uniformly chosen base classes yield hierarchies of logarithmic depth, as in real models. */
+        uint32_t const span = v - root;
+        edges.push_back({ root + std::uniform_int_distribution<uint32_t>(0, span - 1)(rng), v });
+
+        if (v % 10 == 0 && span > 8)
+            edges.push_back({ root + std::uniform_int_distribution<uint32_t>(0, span / 2)(rng), v });
+    }
+}
+
+/**
+ * \brief  lays out a diagram *runs* times and keeps the fastest time per stage
+ *
+ * \param  [in] nodes class boxes
+ * \param  [in] edges edges of the diagram
+ * \param  [in] parallel whether or not to use the task scheduler
+ * \param  [in] runs number of runs
+ * \param  [out] best fastest time per stage
+ *
+ * \return *suzu::sdk::ErrorCode::Ok* on success
+ */
+static suzu::sdk::ErrorCode Measure(std::vector<suzu::sdk::ElementRect> const &nodes, std::vector<suzu::sdk::LayoutEdge> const &edges, bool const parallel, uint32_t const runs, suzu::sdk::LayoutTimings &best) noexcept {
+    using namespace suzu::sdk;
+
+    LayoutOptions opts;
+    opts.parallel = parallel;
+
+    best = { INT64_MAX, INT64_MAX, INT64_MAX };
+    for (uint32_t r = 0; r < runs; ++r) {
+        std::vector<ElementRect> res;
+        try {
+            res = nodes;
+        } catch (...) {
+            return ErrorCode::CriticalResource;
+        }
+
+        LayoutTimings   timings;
+        ErrorCode const err = HierarchicalLayout::Run(res, edges, opts, &timings);
+        if (err != ErrorCode::Ok)
+            return err;
+
+        best.components = std::min(best.components, timings.components);
+        best.layout     = std::min(best.layout, timings.layout);
+        best.packing    = std::min(best.packing, timings.packing);
+    }
+    return ErrorCode::Ok;
+}
+
+
+/**
+ * \brief  adds classes to a laid-out diagram one at a time and times every incremental update
+ *
+ * \param  [in] nodes class boxes
+ * \param  [in] edges edges of the diagram
+ * \param  [in] updates number of classes to add
+ * \param  [out] mean mean time per update, in microseconds
+ * \param  [out] worst maximum time per update, in microseconds
+ *
+ * \return *suzu::sdk::ErrorCode::Ok* on success
+ */
+static suzu::sdk::ErrorCode MeasureUpdates(std::vector<suzu::sdk::ElementRect> nodes, std::vector<suzu::sdk::LayoutEdge> edges, uint32_t const updates, double &mean, double &worst) noexcept {
+    using namespace suzu::sdk;
+
+    LayoutState     state;
+    ErrorCode const err = HierarchicalLayout::Run(nodes, edges, {}, nullptr, &state);
+    if (err != ErrorCode::Ok)
+        return err;
+
+    std::mt19937 rng(updates);
+    double       total = 0.0;
+    worst = 0.0;
+    for (uint32_t i = 0; i < updates; ++i) {
+        try {
+            uint32_t const base = std::uniform_int_distribution<uint32_t>(0, static_cast<uint32_t>(nodes.size() - 1))(rng);
+
+            edges.push_back({ base, static_cast<uint32_t>(nodes.size()) });
+            nodes.push_back({ 0.0f, 0.0f, 140.0f, 80.0f });
+        } catch (...) {
+            return ErrorCode::CriticalResource;
+        }
+
+        auto const      start = std::chrono::steady_clock::now();
+        ErrorCode const res   = HierarchicalLayout::Update(nodes, edges, {}, state);
+        double const    us    = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        if (res != ErrorCode::Ok)
+            return res;
+
+        total += us;
+        worst  = std::max(worst, us);
+    }
+
+    mean = total / updates;
+    return ErrorCode::Ok;
+}
+
+
+int main(int argc, char **argv) {
+    using namespace suzu::sdk;
+
+    uint32_t const nodes   = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 10000;
+    uint32_t const threads = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 0;
+    uint32_t const runs    = argc > 3 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 5;
+    if (nodes == 0 || runs == 0) {
+        std::fprintf(stderr, "usage: %s [<nodes> [<threads> [<runs>]]]\n", argv[0]);
+
+        return ErrorCode::InvalidParameter;
+    }
+
+    TaskScheduler sched(threads);
+    std::printf("shape,nodes,edges,threads,components_ms,layout_ms,packing_ms\n");
+
+    for (bool const forest : { true, false }) {
+        std::vector<ElementRect> boxes;
+        std::vector<LayoutEdge>  edges;
+        GenerateDiagram(nodes, forest, boxes, edges);
+
+        for (bool const parallel : { false, true }) {
+            /* Without a scheduler, tasks run on the calling thread. */
+            InitializeInstanceTasks(parallel ? sched.abi() : TaskSchedulerInterface{ TaskSchedulerInterface::gl_version, 0, nullptr, nullptr, nullptr });
+
+            LayoutTimings   best;
+            ErrorCode const err = Measure(boxes, edges, parallel, runs, best);
+            if (err != ErrorCode::Ok) {
+                std::fprintf(stderr, "error: could not lay out the diagram (code %i)\n", static_cast<int>(err));
+
+                return err;
+            }
+
+            std::printf("%s,%u,%zu,%u,%.3f,%.3f,%.3f\n", forest ? "forest" : "tree", nodes, edges.size(),
+                parallel ? sched.abi().nworkers : 1u, best.components / 1000.0, best.layout / 1000.0, best.packing / 1000.0
+            );
+        }
+    }
+
+    std::printf("\nshape,nodes,updates,update_mean_ms,update_max_ms\n");
+    for (bool const forest : { true, false }) {
+        std::vector<ElementRect> boxes;
+        std::vector<LayoutEdge>  edges;
+        GenerateDiagram(nodes, forest, boxes, edges);
+
+        double          mean  = 0.0;
+        double          worst = 0.0;
+        ErrorCode const err   = MeasureUpdates(std::move(boxes), std::move(edges), 100, mean, worst);
+        if (err != ErrorCode::Ok) {
+            std::fprintf(stderr, "error: could not update the layout (code %i)\n", static_cast<int>(err));
+
+            return err;
+        }
+
+        std::printf("%s,%u,100,%.3f,%.3f\n", forest ? "forest" : "tree", nodes, mean / 1000.0, worst / 1000.0);
+    }
+
+    InitializeInstanceTasks({ TaskSchedulerInterface::gl_version, 0, nullptr, nullptr, nullptr });
+    return ErrorCode::Ok;
+}
+
+
@@ -0,0 +1,176 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  main.cpp
+ * \brief entry-point of the out-of-process plug-in host
+ *
+ * Usage: *suzu-pluginhost <channel> <library>*
+ * Launched by the application for plug-ins that are to run isolated. *channel* names both the
+ * shared memory segment holding the message rings and the local socket used for wake-up signals.
+ * The host exits when it receives *Shutdown* or when the application disconnects. Between
+ * batches of requests, the event loop of the host sleeps until the application signals more.
+ */
+
+
+/* stdlib includes */
+#include <cstdio>
+#include <thread>
+
+/* external includes */
+#include <QCoreApplication>
+#include <QLibrary>
+#include <QLocalSocket>
+#include <QMetaObject>
+#include <QSharedMemory>
+
+/* sdk includes */
+#include <sdk/changes.hpp>
+#include <sdk/ipcring.hpp>
+#include <sdk/plugin.hpp>
+
+
+namespace {
+    constexpr int gl_spincount = 2000; /**< number of empty polls before the host goes to sleep */
+    constexpr int gl_timeout   = 5000; /**< time, in milliseconds, to wait for the application */
+
+
+    /**
+     * \brief publishes the replies and wakes the application if it is waiting for them
+     *
+     * \param [in] replies ring to the application
+     * \param [in] sock wake-up socket
+     */
+    void FlushReplies(suzu::sdk::ipc::MessageRing &replies, QLocalSocket &sock) {
+        if (replies.flush()) {
+            sock.write("\x01", 1);
+            sock.flush();
+        }
+    }
+}
+
+
+int main(int argc, char **argv) {
+    using namespace suzu::sdk;
+
+    /* The socket and the library need an application object and its event loop. */
+    QCoreApplication app(argc, argv);
+    if (argc != 3) {
+        std::fprintf(stderr, "usage: suzu-pluginhost <channel> <library>\n");
+
+        return ErrorCode::InvalidParameter;
+    }
+
+    /* Attach to the channel created by the application. */
+    QString const channel = QString::fromLocal8Bit(argv[1]);
+    QSharedMemory shm(channel);
+    if (!shm.attach() || static_cast<size_t>(shm.size()) < ipc::ChannelLayout::Size())
+        return ErrorCode::CriticalResource;
+
+    QLocalSocket sock;
+    sock.connectToServer(channel);
+    if (!sock.waitForConnected(gl_timeout))
+        return ErrorCode::CriticalResource;
+
+    ipc::MessageRing requests = ipc::MessageRing::Attach(ipc::ChannelLayout::Requests(shm.data()));
+    ipc::MessageRing replies  = ipc::MessageRing::Attach(ipc::ChannelLayout::Replies(shm.data()));
+
+    /* Load the plug-in; its result is the first message the application receives. */
+    QLibrary      library(QString::fromLocal8Bit(argv[2]));
+    ChangeBatchFn onchanges = nullptr;
+    int32_t       res       = ErrorCode::CriticalResource;
+    if (library.load()) {
+        PluginHost const host = {
+            PluginHost::gl_version,
+            { SinkRegistry::gl_version, 0, nullptr },
+            spdlog::level::trace,
+            {},
+            { TaskSchedulerInterface::gl_version, 0, nullptr, nullptr, nullptr },
+            ArenaInterface::Local(),
+            StringTableInterface::Local(),
+            ProfilerInterface::Local(),
+            MemoryInterface::Local()
+        };
+
+        if (auto const entry = reinterpret_cast<PluginEntryFn>(library.resolve(gl_pluginentry))) {
+            Arena::Scope const scratch(Arena::ThreadLocal());
+
+            res = entry(&host);
+        }
+        onchanges = reinterpret_cast<ChangeBatchFn>(library.resolve(gl_pluginchanges));
+    }
+    replies.push(ipc::MessageType::Hello, &res, sizeof res);
+    FlushReplies(replies, sock);
+    if (res != ErrorCode::Ok)
+        return res;
+
+    /* Serve requests in batches until asked to exit. */
+    bool       running = true;
+    auto const serve   = [&]() {
+        for (int idle = 0; running; ) {
+            size_t const n = requests.drain([&](uint32_t type, void const *data, uint32_t size) {
+                Arena::Scope const scratch(Arena::ThreadLocal());
+
+                switch (type) {
+                    case ipc::MessageType::Shutdown:
+                        running = false;
+                        break;
+                    case ipc::MessageType::Ping:
+                        replies.push(ipc::MessageType::Pong, data, size);
+                        break;
+                    case ipc::MessageType::Changes: {
+                        /* The records are used in place; messages in the ring are 8-byte aligned. */
+                        ChangeBatch const batch = {
+                            ChangeBatch::gl_version,
+                            static_cast<uint32_t>(size / sizeof(ChangeRecord)),
+                            static_cast<ChangeRecord const *>(data)
+                        };
+
+                        int32_t const verdict = onchanges != nullptr ? onchanges(&batch) : ErrorCode::Ok;
+                        replies.push(ipc::MessageType::ChangeResult, &verdict, sizeof verdict);
+                        break;
+                    }
+                }
+            });
+
+            if (n != 0) {
+                FlushReplies(replies, sock);
+
+                idle = 0;
+                continue;
+            }
+
+            /* Spin briefly, then return to the event loop until the application signals new requests. */
+            if (++idle < gl_spincount) {
+                std::this_thread::yield();
+
+                continue;
+            }
+
+            if (requests.prepareSleep())
+                return;
+            idle = 0;
+        }
+
+        QCoreApplication::quit();
+    };
+
+    QObject::connect(&sock, &QLocalSocket::readyRead, &app, [&]() {
+        sock.readAll();
+        serve();
+    });
+    QObject::connect(&sock, &QLocalSocket::disconnected, &app, &QCoreApplication::quit);
+    QMetaObject::invokeMethod(&app, serve, Qt::QueuedConnection);
+    app.exec();
+
+    library.unload();
+    return ErrorCode::Ok;
+}
+
+
@@ -0,0 +1,563 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  main.cpp
+ * \brief entry-point of the synthetic project generator and scale benchmark
+ *
+ * Usage: *scalebench generate <project> [<elements> [<associations> [<diagrams> [<depth>]]]]*
+ * Writes a synthetic project of *elements* classifiers and notes (10000 by default) spread over
+ * *diagrams* diagrams (1 by default), connected by *associations* associations (as many as there
+ * are elements by default). Elements are nested in packages *depth* levels deep (3 by default).
+ * The same arguments always produce the same project.
+ *
+ * Usage: *scalebench measure <results> [<elements>...]*
+ * Generates projects of each size (1000, 10000 and 100000 elements by default), each with as many
+ * associations as elements, 4 diagrams and packages 3 levels deep, and measures, per size:
+ *
+ *  - *save_ms*: writing the project file;
+ *  - *open_ms*: opening the file, mapping all diagrams and indexing the first one for viewing;
+ *  - *first_paint_ms*: opening plus painting the first frame of the first diagram;
+ *  - *pan* and *zoom*: frame times while panning across the first diagram at 100%, and while
+ *    zooming out until all of it is visible and back in;
+ *  - *layout_ms*: laying out the classifiers and associations of the first diagram with
+ *    *suzu::sdk::HierarchicalLayout*;
+ *  - *peak_rss_mb*: peak resident memory of the process so far.
+ *
+ * Frames are painted into an offscreen image of 1920x1080 pixels with *suzu::DiagramRenderer*.
+ * Sizes run in the order given; since the peak memory of a process never decreases, sizes are
+ * best given in ascending order, or one per process. Results are written to *results* as a JSON
+ * document, one entry per size, for tracking them over time.
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#if defined _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <Windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+/* external includes */
+#include <QGuiApplication>
+#include <QImage>
+#include <QPainter>
+#include <QRectF>
+
+/* sdk includes */
+#include <sdk/config.hpp>
+#include <sdk/elements.hpp>
+#include <sdk/layout.hpp>
+#include <sdk/project.hpp>
+#include <sdk/task.hpp>
+#include <sdk/util.hpp>
+
+/* app includes */
+#include <renderer.hpp>
+
+
+/**
+ * \struct GeneratorOptions
+ * \brief  shape of a synthetic project
+ */
+struct GeneratorOptions {
+    uint32_t elements;     /**< number of classifiers and notes, in all diagrams */
+    uint32_t associations; /**< number of associations, in all diagrams */
+    uint32_t diagrams;     /**< number of diagrams */
+    uint32_t depth;        /**< nesting depth of packages; 0 for none */
+};
+
+/**
+ * \struct GeneratedDiagram
+ * \brief  diagram of a synthetic project
+ */
+struct GeneratedDiagram {
+    std::string                         name;  /**< name of the diagram */
+    suzu::sdk::ElementStore             store; /**< elements of the diagram */
+    std::vector<uint32_t>               nodes; /**< dense indices of the classifiers and notes */
+    std::vector<suzu::sdk::LayoutEdge>  edges; /**< associations, between indices into *nodes* */
+};
+
+/**
+ * \struct FrameTimes
+ * \brief  statistics of a series of frames
+ */
+struct FrameTimes {
+    uint32_t frames; /**< number of frames */
+    double   mean;   /**< mean time per frame, in milliseconds */
+    double   p95;    /**< 95th percentile, in milliseconds */
+    double   worst;  /**< slowest frame, in milliseconds */
+};
+
+
+constexpr float    gl_cellwidth  = 260.0f; /**< width of a grid cell holding one element */
+constexpr float    gl_cellheight = 180.0f; /**< height of a grid cell holding one element */
+constexpr uint32_t gl_leafcells  = 4;      /**< width and height of the packages of the innermost level, in cells */
+constexpr int      gl_viewwidth  = 1920;   /**< width of the painted frames, in pixels */
+constexpr int      gl_viewheight = 1080;   /**< height of the painted frames, in pixels */
+constexpr uint32_t gl_frames     = 120;    /**< frames per series */
+
+
+/**
+ * \brief  retrieves the time elapsed since a point in time
+ *
+ * \param  [in] start point in time
+ *
+ * \return elapsed time, in milliseconds
+ */
+static double Elapsed(std::chrono::steady_clock::time_point const start) noexcept {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * \brief  retrieves the peak resident memory of the process
+ *
+ * \return peak working set, in MiB; 0 if unknown
+ */
+static double PeakMemory() noexcept {
+#if defined _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0.0;
+
+    return static_cast<double>(counters.PeakWorkingSetSize) / (1024.0 * 1024.0);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0.0;
+
+    return static_cast<double>(usage.ru_maxrss) / 1024.0;
+#endif
+}
+
+
+/**
+ * \brief generates one diagram of a synthetic project
+ *
+ * Elements are laid out on a grid, a tenth of them being notes and the rest mostly classes. Every
+ * level of packages groups 2x2 packages of the level below; the innermost ones hold 4x4 elements.
+ * Three in four associations connect elements at most two cells apart, the others any two.
+ * Owners are created before the elements they own, so they are painted below.
+ *
+ * \param [in] rng random number generator
+ * \param [in] elements number of classifiers and notes
+ * \param [in] associations number of associations
+ * \param [in] depth nesting depth of packages
+ * \param [out] res receives the diagram
+ * \throw std::bad_alloc
+ */
+static void GenerateDiagram(std::mt19937 &rng, uint32_t const elements, uint32_t const associations, uint32_t const depth, GeneratedDiagram &res) {
+    using namespace suzu::sdk;
+
+    std::uniform_real_distribution<float> width(80.0f, 220.0f);
+    std::uniform_real_distribution<float> height(40.0f, 150.0f);
+    std::uniform_int_distribution<int>    kind(0, 99);
+
+    uint32_t const columns = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(elements)))));
+    res.store.clear();
+    res.store.setIndexed(false);
+    res.store.reserve(elements + associations + elements / 8 + 1);
+    res.nodes.clear();
+    res.edges.clear();
+
+    /* Packages are keyed by level and position; only those holding elements are created. */
+    uint32_t const rows = (elements + columns - 1) / columns;
+    std::map<std::tuple<uint32_t, uint32_t, uint32_t>, ElementHandle> packages;
+    for (uint32_t level = 0; level < depth; ++level) {
+        uint32_t const cells = gl_leafcells << (depth - 1 - level);
+        float const    inset = 12.0f * static_cast<float>(level + 1);
+
+        for (uint32_t by = 0; by * cells < rows; ++by)
+            for (uint32_t bx = 0; bx * cells < columns && by * cells * columns + bx * cells < elements; ++bx) {
+                ElementHandle const parent = level == 0 ? gl_nullelement : packages.at({ level - 1, bx / 2, by / 2 });
+                ElementRect const   bounds = { bx * cells * gl_cellwidth + inset, by * cells * gl_cellheight + inset, cells * gl_cellwidth - 2.0f * inset, cells * gl_cellheight - 2.0f * inset };
+
+                packages[{ level, bx, by }] = res.store.create(ElementKind::Package, bounds, 0, parent, StringId("package" + std::to_string(packages.size())));
+            }
+    }
+
+    for (uint32_t i = 0; i < elements; ++i) {
+        int const         roll  = kind(rng);
+        ElementKind const which = roll < 70 ? ElementKind::Class : roll < 82 ? ElementKind::Interface : roll < 90 ? ElementKind::Enumeration : ElementKind::Note;
+        uint32_t const    cx    = i % columns;
+        uint32_t const    cy    = i / columns;
+
+        ElementHandle const parent = depth == 0 ? gl_nullelement : packages.at({ depth - 1, cx / gl_leafcells, cy / gl_leafcells });
+        ElementRect const   bounds = { cx * gl_cellwidth + 30.0f, cy * gl_cellheight + 24.0f, width(rng), height(rng) };
+
+        res.nodes.push_back(res.store.indexOf(res.store.create(which, bounds, 0, parent, StringId((which == ElementKind::Note ? "note" : "Class") + std::to_string(i)))));
+    }
+
+    if (elements > 1) {
+        std::uniform_int_distribution<uint32_t> any(0, elements - 1);
+        std::uniform_int_distribution<int>      near(-2, 2);
+
+        for (uint32_t i = 0; i < associations; ++i) {
+            uint32_t const from = any(rng);
+            uint32_t       to   = any(rng);
+            if (i % 4 != 0) {
+                int64_t const cx = std::clamp<int64_t>(static_cast<int64_t>(from % columns) + near(rng), 0, columns - 1);
+                int64_t const cy = static_cast<int64_t>(from / columns) + near(rng);
+
+                to = static_cast<uint32_t>(std::clamp<int64_t>(cy * columns + cx, 0, elements - 1));
+            }
+            if (to == from)
+                to = (from + 1) % elements;
+
+            /* Associations are drawn as a line across their bounds, from center to center. */
+            ElementRect const a  = res.store.bounds()[res.nodes[from]];
+            ElementRect const b  = res.store.bounds()[res.nodes[to]];
+            float const       ax = a.x + a.w / 2.0f, ay = a.y + a.h / 2.0f;
+            float const       bx = b.x + b.w / 2.0f, by = b.y + b.h / 2.0f;
+
+            res.store.create(ElementKind::Association, { std::min(ax, bx), std::min(ay, by), std::max(1.0f, std::abs(bx - ax)), std::max(1.0f, std::abs(by - ay)) });
+            res.edges.push_back({ from, to });
+        }
+    }
+}
+
+/**
+ * \brief  generates a synthetic project
+ *
+ * \param  [in] opts shape of the project
+ * \param  [out] res receives the diagrams
+ *
+ * \return *suzu::sdk::ErrorCode::Ok* on success, or *suzu::sdk::ErrorCode::CriticalResource* if
+ *         memory ran out
+ */
+static suzu::sdk::ErrorCode GenerateProject(GeneratorOptions const &opts, std::vector<GeneratedDiagram> &res) noexcept {
+    using namespace suzu::sdk;
+
+    try {
+        /* Seeding with the shape makes every project reproducible. */
+        std::seed_seq seed = { opts.elements, opts.associations, opts.diagrams, opts.depth };
+        std::mt19937  rng(seed);
+
+        res.clear();
+        res.resize(opts.diagrams);
+        for (uint32_t d = 0; d < opts.diagrams; ++d) {
+            /* The first diagrams receive the remainders, so the first one is the largest. */
+            uint32_t const elements     = opts.elements / opts.diagrams + (d < opts.elements % opts.diagrams ? 1 : 0);
+            uint32_t const associations = opts.associations / opts.diagrams + (d < opts.associations % opts.diagrams ? 1 : 0);
+
+            res[d].name = "Diagram " + std::to_string(d + 1);
+            GenerateDiagram(rng, elements, associations, opts.depth, res[d]);
+        }
+    } catch (...) {
+        res.clear();
+
+        return ErrorCode::CriticalResource;
+    }
+
+    return ErrorCode::Ok;
+}
+
+/**
+ * \brief  writes the diagrams of a synthetic project into a project file
+ *
+ * \param  [in] path path of the project file
+ * \param  [in] diagrams diagrams to write
+ *
+ * \return *suzu::sdk::ErrorCode::Ok* on success, or the error of *suzu::sdk::ProjectWriter*
+ */
+static suzu::sdk::ErrorCode SaveProject(char const *const path, std::vector<GeneratedDiagram> const &diagrams) noexcept {
+    using namespace suzu::sdk;
+
+    ProjectWriter writer;
+    ErrorCode     err = writer.open(path);
+    for (size_t d = 0; d < diagrams.size() && err == ErrorCode::Ok; ++d)
+        err = writer.addDiagram(diagrams[d].name, diagrams[d].store);
+
+    return err == ErrorCode::Ok ? writer.commit() : err;
+}
+
+
+/**
+ * \brief  paints a series of frames and computes their statistics
+ *
+ * \param  [in] store diagram to paint
+ * \param  [in] frames views, one per frame: position of the top-left corner in the scene, and zoom
+ * \param  [in,out] image device to paint into
+ *
+ * \return statistics of the frames
+ */
+static FrameTimes PaintFrames(suzu::sdk::ElementStore const &store, std::vector<std::tuple<double, double, double>> const &frames, QImage &image) {
+    suzu::DiagramRenderer const renderer;
+    suzu::LodThresholds const   lod = { 0.5, 0.2 };
+    std::vector<double>         times;
+
+    for (auto const &[x, y, zoom] : frames) {
+        auto const start = std::chrono::steady_clock::now();
+        {
+            QPainter painter(&image);
+            painter.fillRect(image.rect(), Qt::white);
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.scale(zoom, zoom);
+            painter.translate(-x, -y);
+
+            renderer.render(painter, store, QRectF(x, y, gl_viewwidth / zoom, gl_viewheight / zoom), lod.select(zoom));
+        }
+        times.push_back(Elapsed(start));
+    }
+    if (times.empty())
+        return { 0, 0.0, 0.0, 0.0 };
+
+    double total = 0.0;
+    for (double const time : times)
+        total += time;
+    std::sort(times.begin(), times.end());
+
+    return { static_cast<uint32_t>(times.size()), total / times.size(), times[std::min(times.size() - 1, times.size() * 95 / 100)], times.back() };
+}
+
+/**
+ * \brief  converts frame statistics into a JSON object
+ *
+ * \param  [in] times statistics
+ *
+ * \return JSON object
+ */
+static suzu::sdk::JSON FrameJson(FrameTimes const &times) {
+    return { { "frames", times.frames }, { "mean_ms", times.mean }, { "p95_ms", times.p95 }, { "max_ms", times.worst } };
+}
+
+/**
+ * \brief  generates a project of the given size and measures it
+ *
+ * \param  [in] elements number of classifiers and notes
+ * \param  [in] path path of the temporary project file
+ * \param  [out] res receives the results
+ *
+ * \return *suzu::sdk::ErrorCode::Ok* on success, or the error of the failed step
+ */
+static suzu::sdk::ErrorCode Measure(uint32_t const elements, std::string const &path, suzu::sdk::JSON &res) noexcept {
+    using namespace suzu::sdk;
+
+    try {
+        GeneratorOptions const        opts = { elements, elements, 4, 3 };
+        std::vector<GeneratedDiagram> diagrams;
+        ErrorCode                     err  = GenerateProject(opts, diagrams);
+        if (err != ErrorCode::Ok)
+            return err;
+
+        size_t total = 0;
+        for (GeneratedDiagram const &diagram : diagrams)
+            total += diagram.store.size();
+
+        auto start = std::chrono::steady_clock::now();
+        if ((err = SaveProject(path.c_str(), diagrams)) != ErrorCode::Ok)
+            return err;
+        double const save = Elapsed(start);
+
+        /* The layout works on the generated diagram, which knows the ends of every association. */
+        std::vector<ElementRect> nodes;
+        for (uint32_t const node : diagrams[0].nodes)
+            nodes.push_back(diagrams[0].store.bounds()[node]);
+        start = std::chrono::steady_clock::now();
+        if ((err = HierarchicalLayout::Run(nodes, diagrams[0].edges)) != ErrorCode::Ok)
+            return err;
+        double const layout = Elapsed(start);
+        diagrams.clear();
+
+        /* The same steps as opening a project in the editor: map everything, index what is shown. */
+        start = std::chrono::steady_clock::now();
+        ProjectReader reader;
+        if ((err = reader.open(path.c_str())) != ErrorCode::Ok)
+            return err;
+
+        std::vector<ElementStore> stores(reader.diagramCount());
+        for (uint32_t d = 0; d < reader.diagramCount(); ++d)
+            if ((err = reader.mapDiagram(d, stores[d])) != ErrorCode::Ok)
+                return err;
+        stores[0].setIndexed(true);
+        double const open = Elapsed(start);
+
+        QImage image(gl_viewwidth, gl_viewheight, QImage::Format_ARGB32_Premultiplied);
+        FrameTimes const first = PaintFrames(stores[0], { { 0.0, 0.0, 1.0 } }, image);
+
+        ElementRect extent = { 0.0f, 0.0f, 1.0f, 1.0f };
+        for (uint32_t i = 0, n = static_cast<uint32_t>(stores[0].size()); i < n; ++i) {
+            ElementRect const &bounds = stores[0].bounds()[i];
+
+            extent.w = std::max(extent.w, bounds.x + bounds.w);
+            extent.h = std::max(extent.h, bounds.y + bounds.h);
+        }
+
+        /* Panning moves diagonally across the diagram; zooming goes down to fit all of it and back. */
+        std::vector<std::tuple<double, double, double>> pan, zoom;
+        double const fit = std::min(1.0, std::min(gl_viewwidth / static_cast<double>(extent.w), gl_viewheight / static_cast<double>(extent.h)));
+        for (uint32_t f = 0; f < gl_frames; ++f) {
+            double const t = static_cast<double>(f) / (gl_frames - 1);
+            double const z = std::pow(fit, 1.0 - std::abs(2.0 * t - 1.0));
+
+            pan.emplace_back(t * std::max(0.0, extent.w - static_cast<double>(gl_viewwidth)), t * std::max(0.0, extent.h - static_cast<double>(gl_viewheight)), 1.0);
+            zoom.emplace_back(0.0, 0.0, z);
+        }
+        FrameTimes const panned = PaintFrames(stores[0], pan, image);
+        FrameTimes const zoomed = PaintFrames(stores[0], zoom, image);
+
+        std::error_code fserr;
+        res = {
+            { "elements",       elements },
+            { "associations",   opts.associations },
+            { "diagrams",       opts.diagrams },
+            { "depth",          opts.depth },
+            { "total_elements", total },
+            { "file_bytes",     std::filesystem::file_size(path, fserr) },
+            { "save_ms",        save },
+            { "open_ms",        open },
+            { "first_paint_ms", open + first.mean },
+            { "pan",            FrameJson(panned) },
+            { "zoom",           FrameJson(zoomed) },
+            { "layout_ms",      layout },
+            { "peak_rss_mb",    PeakMemory() }
+        };
+    } catch (...) {
+        return ErrorCode::CriticalResource;
+    }
+
+    return ErrorCode::Ok;
+}
+
+
+/**
+ * \brief  writes a synthetic project
+ *
+ * \param  [in] argc number of command-line arguments
+ * \param  [in] argv command-line arguments
+ *
+ * \return *suzu::sdk::ErrorCode::Ok* on success
+ */
+static suzu::sdk::ErrorCode RunGenerate(int const argc, char **const argv) noexcept {
+    using namespace suzu::sdk;
+
+    GeneratorOptions opts;
+    opts.elements     = argc > 3 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)) : 10000;
+    opts.associations = argc > 4 ? static_cast<uint32_t>(std::strtoul(argv[4], nullptr, 10)) : opts.elements;
+    opts.diagrams     = argc > 5 ? static_cast<uint32_t>(std::strtoul(argv[5], nullptr, 10)) : 1;
+    opts.depth        = argc > 6 ? static_cast<uint32_t>(std::strtoul(argv[6], nullptr, 10)) : 3;
+    if (opts.diagrams == 0 || opts.depth > 16) {
+        std::fprintf(stderr, "error: there must be at least one diagram, and packages can be nested at most 16 levels deep\n");
+
+        return ErrorCode::InvalidParameter;
+    }
+
+    std::vector<GeneratedDiagram> diagrams;
+    ErrorCode err = GenerateProject(opts, diagrams);
+    if (err == ErrorCode::Ok)
+        err = SaveProject(argv[2], diagrams);
+    if (err != ErrorCode::Ok) {
+        std::fprintf(stderr, "error: could not write project \"%s\" (code %i)\n", argv[2], static_cast<int>(err));
+
+        return err;
+    }
+
+    return ErrorCode::Ok;
+}
+
+/**
+ * \brief  measures projects of several sizes and writes the results
+ *
+ * \param  [in] argc number of command-line arguments
+ * \param  [in] argv command-line arguments
+ *
+ * \return *suzu::sdk::ErrorCode::Ok* on success
+ */
+static suzu::sdk::ErrorCode RunMeasure(int const argc, char **const argv) noexcept {
+    using namespace suzu::sdk;
+
+    std::vector<uint32_t> sizes;
+    for (int i = 3; i < argc; ++i)
+        sizes.push_back(static_cast<uint32_t>(std::strtoul(argv[i], nullptr, 10)));
+    if (sizes.empty())
+        sizes = { 1000, 10000, 100000 };
+
+    std::error_code             fserr;
+    std::filesystem::path const path = std::filesystem::temp_directory_path(fserr) / "suzu-scalebench.suzu";
+
+    TaskScheduler sched(0);
+    InitializeInstanceTasks(sched.abi());
+
+    try {
+        char              stamp[32] = { 0 };
+        std::time_t const now       = std::time(nullptr);
+        std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+        JSON doc = { { "version", 1 }, { "timestamp", stamp }, { "threads", sched.abi().nworkers }, { "viewport", { gl_viewwidth, gl_viewheight } }, { "runs", JSON::array() } };
+        ErrorCode err = ErrorCode::Ok;
+        std::printf("elements,save_ms,open_ms,first_paint_ms,pan_p95_ms,zoom_p95_ms,layout_ms,peak_rss_mb\n");
+        for (uint32_t const size : sizes) {
+            JSON run;
+            if ((err = Measure(size, path.u8string(), run)) != ErrorCode::Ok) {
+                std::fprintf(stderr, "error: could not measure %u elements (code %i)\n", size, static_cast<int>(err));
+
+                break;
+            }
+
+            std::printf("%u,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f\n", size, run["save_ms"].get<double>(), run["open_ms"].get<double>(), run["first_paint_ms"].get<double>(),
+                run["pan"]["p95_ms"].get<double>(), run["zoom"]["p95_ms"].get<double>(), run["layout_ms"].get<double>(), run["peak_rss_mb"].get<double>()
+            );
+            doc["runs"].push_back(std::move(run));
+        }
+        std::filesystem::remove(path, fserr);
+        InitializeInstanceTasks({ TaskSchedulerInterface::gl_version, 0, nullptr, nullptr, nullptr });
+
+        std::string const text = doc.dump(2);
+        if (util::WriteFile(argv[2], text.data(), text.size()) != ErrorCode::Ok) {
+            std::fprintf(stderr, "error: could not write results \"%s\"\n", argv[2]);
+
+            return ErrorCode::WriteFile;
+        }
+
+        return err;
+    } catch (...) { }
+
+    InitializeInstanceTasks({ TaskSchedulerInterface::gl_version, 0, nullptr, nullptr, nullptr });
+    return ErrorCode::CriticalResource;
+}
+
+
+int main(int argc, char **argv) {
+    using namespace suzu::sdk;
+
+    std::string const mode = argc > 2 ? argv[1] : "";
+    if (mode != "generate" && mode != "measure") {
+        std::fprintf(stderr, "usage: %s generate <project> [<elements> [<associations> [<diagrams> [<depth>]]]]\n", argv[0]);
+        std::fprintf(stderr, "       %s measure <results> [<elements>...]\n", argv[0]);
+
+        return ErrorCode::InvalidParameter;
+    }
+    if (mode == "generate")
+        return RunGenerate(argc, argv);
+
+    /* Fonts and painting need a GUI application, but no display. */
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    return RunMeasure(argc, argv);
+}
+
+
@@ -0,0 +1,373 @@
+/*
+ * Suzu - (UML) diagram editor created with Qt
+ *
+ * (c) 2023 TophUwO <tophuwo01@gmail.com>. All rights reserved.
+ *
+ * For information on licensing, please refer to the LICENSE file in the project's
+ * root directory.
+ */
+
+/**
+ * \file  main.cpp
+ * \brief entry-point of the SDK microbenchmarks
+ *
+ * Usage: *sdkbench [<threads> [<runs>]]*
+ * Measures the primitives of the SDK the application relies on most, and prints one CSV table
+ * per group. Multi-threaded measurements use 1, 2, 4, ... up to *threads* threads (one per core
+ * by default). Every configuration is run *runs* times (5 by default); the fastest run is
+ * reported.
+ *
+ *  - *config*: *Configuration::getValue()* with a compiled key and with a path, by all threads,
+ *    alone and while one of them keeps calling *setValue()*;
+ *  - *file*: *util::WriteFile()* and *util::ReadFile()* of 4 KiB to 16 MiB, in text and binary
+ *    mode;
+ *  - *convert*: *JSONCVT::to()* and *JSONCVT::from()* for integers, floating-point numbers and
+ *    strings;
+ *  - *log*: throughput of *SZSDK_APP_INFO()* into a discarding sink, synchronously and
+ *    asynchronously; for the latter, the time until the queue has drained is reported as well;
+ *  - *hittest*: *SegmentArray::nearest()* over 16 to 64Ki random segments, with plain C++, SSE2
+ *    and AVX where compiled in.
+ */
+
+
+/* stdlib includes */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* external includes */
+#include <spdlog/sinks/null_sink.h>
+
+/* sdk includes */
+#include <sdk/config.hpp>
+#include <sdk/log.hpp>
+#include <sdk/polyline.hpp>
+#include <sdk/util.hpp>
+
+
+/**
+ * \brief  runs a function on several threads at once and measures the time until all have finished
+ *
+ * \param  [in] threads number of threads
+ * \param  [in] fn function; receives the index of the thread
+ *
+ * \return elapsed time, in nanoseconds
+ */
+static double RunThreads(uint32_t const threads, std::function<void(uint32_t)> const &fn) {
+    std::atomic<uint32_t>    ready(0);
+    std::atomic<bool>        go(false);
+    std::vector<std::thread> pool;
+
+    /* Threads are started first and released together, so that thread creation is not measured. */
+    for (uint32_t t = 0; t < threads; ++t)
+        pool.emplace_back([&, t]() {
+            ++ready;
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+
+            fn(t);
+        });
+    while (ready.load() != threads)
+        std::this_thread::yield();
+
+    auto const start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (std::thread &thread : pool)
+        thread.join();
+
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * \brief  measures a function *runs* times and keeps the fastest time
+ *
+ * \param  [in] runs number of runs
+ * \param  [in] fn measured function; returns the elapsed time, in nanoseconds
+ *
+ * \return fastest time, in nanoseconds
+ */
+static double Best(uint32_t const runs, std::function<double()> const &fn) {
+    double best = HUGE_VAL;
+    for (uint32_t r = 0; r < runs; ++r)
+        best = std::min(best, fn());
+
+    return best;
+}
+
+
+/**
+ * \brief measures lookups in the configuration, with and without a concurrent writer
+ *
+ * \param [in] maxthreads largest number of threads
+ * \param [in] runs number of runs per configuration
+ */
+static void BenchConfig(uint32_t const maxthreads, uint32_t const runs) {
+    using namespace suzu::sdk;
+
+    constexpr uint32_t gl_reads = 200000; /**< lookups per thread */
+
+    Configuration config;
+    config.apply({
+        { "/editor/grid/size",    JSONCVT::from(16) },
+        { "/editor/grid/visible", JSONCVT::from(true) },
+        { "/undo/budget",         JSONCVT::from(uint64_t(64) << 20) },
+        { "/log/level",           JSONCVT::from("info") }
+    });
+    ConfigKey const key("/editor/grid/size");
+
+    std::printf("benchmark,threads,writer,ns_per_read\n");
+    for (bool const writer : { false, true })
+        for (uint32_t threads = 1; threads <= maxthreads; threads *= 2) {
+            /* With a writer, the last thread only writes; every write publishes a new generation. */
+            if (writer && threads == 1)
+                continue;
+            uint32_t const readers = writer ? threads - 1 : threads;
+
+            for (bool const compiled : { true, false }) {
+                double const ns = Best(runs, [&]() {
+                    std::atomic<bool>     done(false);
+                    std::atomic<uint32_t> left(readers);
+                    std::atomic<int64_t>  sink(0);
+
+                    return RunThreads(threads, [&](uint32_t const t) {
+                        if (t >= readers) {
+                            for (int32_t i = 0; !done.load(std::memory_order_relaxed); ++i)
+                                config.setValue("/editor/grid/size", JSONCVT::from(16 + (i & 7)));
+
+                            return;
+                        }
+
+                        int64_t sum = 0;
+                        for (uint32_t i = 0; i < gl_reads; ++i)
+                            sum += JSONCVT::to(compiled ? config.getValue(key) : config.getValue("/editor/grid/size"), 0);
+                        sink += sum;
+
+                        if (--left == 0)
+                            done = true;
+                    });
+                });
+
+                std::printf("%s,%u,%s,%.1f\n", compiled ? "get_key" : "get_path", threads, writer ? "yes" : "no", ns / gl_reads);
+            }
+        }
+}
+
+/**
+ * \brief measures writing and reading files of various sizes
+ *
+ * \param [in] runs number of runs per configuration
+ */
+static void BenchFiles(uint32_t const runs) {
+    using namespace suzu::sdk;
+
+    std::error_code             err;
+    std::filesystem::path const path = std::filesystem::temp_directory_path(err) / "suzu-sdkbench.tmp";
+    std::string const           file = path.u8string();
+
+    std::printf("\nbenchmark,bytes,mode,write_mb_s,read_mb_s\n");
+    for (size_t const size : { size_t(4) << 10, size_t(64) << 10, size_t(1) << 20, size_t(16) << 20 }) {
+        /* Text of short lines, so that text mode has line endings to translate. */
+        std::string data(size, 'x');
+        for (size_t i = 79; i < size; i += 80)
+            data[i] = '\n';
+
+        for (bool const binary : { false, true }) {
+            /* Small files are repeated, so that every run takes long enough to be timed. */
+            uint32_t const reps = static_cast<uint32_t>(std::max<size_t>(1, (size_t(64) << 20) / size / 16));
+
+            double const write = Best(runs, [&]() {
+                auto const start = std::chrono::steady_clock::now();
+                for (uint32_t i = 0; i < reps; ++i)
+                    util::WriteFile(file.c_str(), data.data(), data.size(), binary);
+
+                return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            });
+            double const read = Best(runs, [&]() {
+                util::FileBuffer buffer;
+
+                auto const start = std::chrono::steady_clock::now();
+                for (uint32_t i = 0; i < reps; ++i)
+                    util::ReadFile(file.c_str(), buffer, binary);
+
+                return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            });
+
+            double const bytes = static_cast<double>(size) * reps;
+            std::printf("%s,%zu,%s,%.1f,%.1f\n", "file", size, binary ? "binary" : "text", bytes / write * 1e3, bytes / read * 1e3);
+        }
+    }
+
+    std::filesystem::remove(path, err);
+}
+
+/**
+ * \brief measures conversions between JSON values and native values
+ *
+ * \param [in] runs number of runs per configuration
+ */
+static void BenchConvert(uint32_t const runs) {
+    using namespace suzu::sdk;
+
+    constexpr uint32_t gl_conversions = 1000000; /**< conversions per run */
+
+    auto const Measure = [runs](std::function<void()> const &fn) {
+        return Best(runs, [&]() {
+            auto const start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < gl_conversions; ++i)
+                fn();
+
+            return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        }) / gl_conversions;
+    };
+
+    JSON const integer = 42;
+    JSON const number  = 0.5;
+    JSON const text    = "Courier New";
+
+    volatile int64_t sink = 0;
+    std::printf("\nbenchmark,type,ns_per_op\n");
+    std::printf("to,int32,%.1f\n", Measure([&]() { sink += JSONCVT::to(integer, int32_t(0)); }));
+    std::printf("to,double,%.1f\n", Measure([&]() { sink += static_cast<int64_t>(JSONCVT::to(number, 0.0)); }));
+    std::printf("to,string,%.1f\n", Measure([&]() { sink += static_cast<int64_t>(JSONCVT::to(text, std::string()).size()); }));
+    std::printf("to,string_view,%.1f\n", Measure([&]() { sink += static_cast<int64_t>(JSONCVT::to(text, std::string_view()).size()); }));
+    std::printf("to,mismatch,%.1f\n", Measure([&]() { sink += JSONCVT::to(text, int32_t(0)); }));
+    std::printf("from,int32,%.1f\n", Measure([&]() { sink += JSONCVT::from(int32_t(42)).is_number() ? 1 : 0; }));
+    std::printf("from,double,%.1f\n", Measure([&]() { sink += JSONCVT::from(0.5).is_number() ? 1 : 0; }));
+    std::printf("from,string,%.1f\n", Measure([&]() { sink += JSONCVT::from(std::string_view("Courier New")).is_string() ? 1 : 0; }));
+}
+
+/**
+ * \brief measures the throughput of the logging macros
+ *
+ * \param [in] maxthreads largest number of threads
+ * \param [in] runs number of runs per configuration
+ */
+static void BenchLog(uint32_t const maxthreads, uint32_t const runs) {
+    using namespace suzu::sdk;
+
+    constexpr uint32_t gl_messages = 100000; /**< messages per thread */
+
+    /* The sink discards everything, so only formatting and dispatch are measured. */
+    spdlog::sink_ptr const sink = std::make_shared<spdlog::sinks::null_sink_mt>();
+
+    std::printf("\nbenchmark,mode,threads,ns_per_message,drain_ms\n");
+    for (bool const async : { false, true })
+        for (uint32_t threads = 1; threads <= maxthreads; threads *= 2) {
+            double best  = HUGE_VAL;
+            double drain = 0.0;
+
+            for (uint32_t r = 0; r < runs; ++r) {
+                LoggerOptions opts;
+                opts.async         = async;
+                opts.queuesize     = 1 << 16;
+                opts.flushinterval = 0;
+
+                /* Every run starts with fresh loggers and, in asynchronous mode, an empty queue. */
+                spdlog::shutdown();
+                if (!InitializeInstanceLoggers(1, &sink, spdlog::level::trace, opts)) {
+                    std::fprintf(stderr, "error: could not initialize the loggers\n");
+
+                    return;
+                }
+
+                double const ns = RunThreads(threads, [](uint32_t const t) {
+                    for (uint32_t i = 0; i < gl_messages; ++i)
+                        SZSDK_APP_INFO("message {} of thread {}: {:.2f}", i, t, i * 0.5);
+                });
+
+                /* Shutting down waits for the logging thread to empty the queue. */
+                auto const start = std::chrono::steady_clock::now();
+                spdlog::shutdown();
+                double const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+                if (ns < best) {
+                    best  = ns;
+                    drain = ms;
+                }
+            }
+
+            std::printf("log,%s,%u,%.1f,%.3f\n", async ? "async" : "sync", threads, best / (static_cast<double>(gl_messages) * threads), drain);
+        }
+
+    suzu::sdk::internal::gl_applogger    = nullptr;
+    suzu::sdk::internal::gl_pluginlogger = nullptr;
+}
+
+/**
+ * \brief measures the narrow phase of hit-testing edges, i.e. finding the closest segment
+ *
+ * \param [in] runs number of runs per configuration
+ */
+static void BenchHitTest(uint32_t const runs) {
+    using namespace suzu::sdk;
+
+    constexpr uint32_t gl_queries = 1 << 12; /**< points tested per run */
+    constexpr uint32_t gl_points  = 4;       /**< vertices per polyline */
+
+    std::mt19937                          rng(42);
+    std::uniform_real_distribution<float> pos(0.0f, 1000.0f);
+
+    std::vector<float> queries(2 * gl_queries);
+    for (float &q : queries)
+        q = pos(rng);
+
+    char const *const names[] = { "scalar", "sse", "avx" };
+    std::printf("\nbenchmark,segments,simd,ns_per_query\n");
+    for (uint32_t segments = 16; segments <= (1u << 16); segments *= 16) {
+        SegmentArray arr;
+        float        line[2 * gl_points];
+
+        arr.reserve(segments);
+        for (uint32_t i = 0; arr.size() < segments; ++i) {
+            for (float &c : line)
+                c = pos(rng);
+
+            arr.add(i, line, std::min<size_t>(gl_points, segments - arr.size() + 1));
+        }
+
+        for (uint32_t level = 0; level < static_cast<uint32_t>(SimdLevel::__NumSimdLevels__); ++level) {
+            volatile uint32_t sink = 0;
+
+            double const ns = Best(runs, [&]() {
+                auto const start = std::chrono::steady_clock::now();
+                for (uint32_t q = 0; q < gl_queries; ++q)
+                    sink += arr.nearest(queries[2 * q], queries[2 * q + 1], static_cast<SimdLevel>(level)).segment;
+
+                return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            });
+            std::printf("hittest,%u,%s,%.1f\n", segments, names[level], ns / gl_queries);
+        }
+    }
+}
+
+
+int main(int argc, char **argv) {
+    using namespace suzu::sdk;
+
+    uint32_t const cores   = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t const threads = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : cores;
+    uint32_t const runs    = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 5;
+    if (threads == 0 || runs == 0) {
+        std::fprintf(stderr, "usage: %s [<threads> [<runs>]]\n", argv[0]);
+
+        return ErrorCode::InvalidParameter;
+    }
+
+    BenchConfig(threads, runs);
+    BenchFiles(runs);
+    BenchConvert(runs);
+    BenchLog(threads, runs);
+    BenchHitTest(runs);
+
+    return ErrorCode::Ok;
+}
+
+